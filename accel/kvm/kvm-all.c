@@ -37,6 +37,7 @@
 #include "exec/address-spaces.h"
 #include "qemu/event_notifier.h"
 #include "qemu/main-loop.h"
+#include "qemu/timer.h"
 #include "trace.h"
 #include "hw/irq.h"
 #include "qapi/visitor.h"
@@ -45,7 +46,9 @@
 #include "sysemu/reset.h"
 #include "qemu/guest-random.h"
 #include "sysemu/hw_accel.h"
+#include "sysemu/dirtylimit.h"
 #include "kvm-cpus.h"
+#include "monitor/stats.h"
 
 #include "hw/boards.h"
 
@@ -117,6 +120,12 @@ struct KVMState
     int nr_allocated_irq_routes;
     unsigned long *used_gsi_bitmap;
     unsigned int gsi_count;
+    /* gsi -> index of its (last added) entry in irq_routes, or -1 */
+    int *irq_route_index;
+    /* irq_routes differs from what KVM has */
+    bool irq_routes_dirty;
+    /* nesting of kvm_irqchip_begin_route_changes() */
+    int irq_routes_batch;
     QTAILQ_HEAD(, KVMMSIRoute) msi_hashtab[KVM_MSI_HASHTAB_SIZE];
 #endif
     KVMMemoryListener memory_listener;
@@ -128,6 +137,9 @@ struct KVMState
         KVMMemoryListener *ml;
         AddressSpace *as;
     } *as;
+    uint64_t kvm_dirty_ring_bytes;  /* Size of the per-vcpu dirty ring */
+    uint32_t kvm_dirty_ring_size;   /* Number of dirty GFNs per ring */
+    struct KVMDirtyRingReaper reaper;
 };
 
 KVMState *kvm_state;
@@ -174,8 +186,23 @@ typedef struct KVMResampleFd KVMResampleFd;
 static QLIST_HEAD(, KVMResampleFd) kvm_resample_fd_list =
     QLIST_HEAD_INITIALIZER(kvm_resample_fd_list);
 
-#define kvm_slots_lock(kml)      qemu_mutex_lock(&(kml)->slots_lock)
-#define kvm_slots_unlock(kml)    qemu_mutex_unlock(&(kml)->slots_lock)
+/* Protects all the KVMSlots of all the KVMMemoryListeners */
+static QemuMutex kml_slots_lock;
+
+#define kvm_slots_lock()    qemu_mutex_lock(&kml_slots_lock)
+#define kvm_slots_unlock()  qemu_mutex_unlock(&kml_slots_lock)
+
+/*
+ * Keeps the vCPUs out of KVM_RUN while a memory transaction replaces
+ * slots, so that the guest never runs between the removal of a slot and
+ * the addition of its replacement.  The count of vCPUs inside KVM_RUN is
+ * only touched with atomics; the lock and condition variable are used
+ * only while the gate is closed.
+ */
+static QemuMutex kvm_run_gate_lock;
+static QemuCond kvm_run_gate_cond;
+static bool kvm_run_gate_closed;
+static int kvm_run_gate_count;
 
 static inline void kvm_resample_fd_remove(int gsi)
 {
@@ -220,7 +247,7 @@ int kvm_get_max_memslots(void)
     return s->nr_slots;
 }
 
-/* Called with KVMMemoryListener.slots_lock held */
+/* Called with kml_slots_lock held */
 static KVMSlot *kvm_get_free_slot(KVMMemoryListener *kml)
 {
     KVMState *s = kvm_state;
@@ -241,14 +268,14 @@ bool kvm_has_free_slot(MachineState *ms)
     bool result;
     KVMMemoryListener *kml = &s->memory_listener;
 
-    kvm_slots_lock(kml);
+    kvm_slots_lock();
     result = !!kvm_get_free_slot(kml);
-    kvm_slots_unlock(kml);
+    kvm_slots_unlock();
 
     return result;
 }
 
-/* Called with KVMMemoryListener.slots_lock held */
+/* Called with kml_slots_lock held */
 static KVMSlot *kvm_alloc_slot(KVMMemoryListener *kml)
 {
     KVMSlot *slot = kvm_get_free_slot(kml);
@@ -309,7 +336,7 @@ int kvm_physical_memory_addr_from_host(KVMState *s, void *ram,
     KVMMemoryListener *kml = &s->memory_listener;
     int i, ret = 0;
 
-    kvm_slots_lock(kml);
+    kvm_slots_lock();
     for (i = 0; i < s->nr_slots; i++) {
         KVMSlot *mem = &kml->slots[i];
 
@@ -319,7 +346,7 @@ int kvm_physical_memory_addr_from_host(KVMState *s, void *ram,
             break;
         }
     }
-    kvm_slots_unlock(kml);
+    kvm_slots_unlock();
 
     return ret;
 }
@@ -359,6 +386,103 @@ err:
     return ret;
 }
 
+enum {
+    KVM_EXIT_STAT_IO,
+    KVM_EXIT_STAT_MMIO,
+    KVM_EXIT_STAT_IRQ_WINDOW_OPEN,
+    KVM_EXIT_STAT_DIRTY_RING_FULL,
+    KVM_EXIT_STAT_SHUTDOWN,
+    KVM_EXIT_STAT_SYSTEM_EVENT,
+    KVM_EXIT_STAT_INTERRUPTED,
+    KVM_EXIT_STAT_OTHER,
+    KVM_EXIT_STAT__MAX,
+};
+
+static const char *const kvm_exit_stat_names[KVM_EXIT_STAT__MAX] = {
+    [KVM_EXIT_STAT_IO] = "exits-io",
+    [KVM_EXIT_STAT_MMIO] = "exits-mmio",
+    [KVM_EXIT_STAT_IRQ_WINDOW_OPEN] = "exits-irq-window",
+    [KVM_EXIT_STAT_DIRTY_RING_FULL] = "exits-dirty-ring-full",
+    [KVM_EXIT_STAT_SHUTDOWN] = "exits-shutdown",
+    [KVM_EXIT_STAT_SYSTEM_EVENT] = "exits-system-event",
+    [KVM_EXIT_STAT_INTERRUPTED] = "exits-interrupted",
+    [KVM_EXIT_STAT_OTHER] = "exits-other",
+};
+
+/*
+ * Written only by the vCPU thread, so size_t counters updated with
+ * qatomic_set are enough for query-stats to read them without tearing.
+ */
+struct KVMExitStats {
+    size_t count[KVM_EXIT_STAT__MAX];
+};
+
+static void kvm_account_exit(CPUState *cpu, int stat)
+{
+    size_t *count = &cpu->kvm_exit_stats->count[stat];
+
+    qatomic_set(count, *count + 1);
+}
+
+static int kvm_exit_stat(uint32_t exit_reason)
+{
+    switch (exit_reason) {
+    case KVM_EXIT_IO:
+        return KVM_EXIT_STAT_IO;
+    case KVM_EXIT_MMIO:
+        return KVM_EXIT_STAT_MMIO;
+    case KVM_EXIT_IRQ_WINDOW_OPEN:
+        return KVM_EXIT_STAT_IRQ_WINDOW_OPEN;
+    case KVM_EXIT_DIRTY_RING_FULL:
+        return KVM_EXIT_STAT_DIRTY_RING_FULL;
+    case KVM_EXIT_SHUTDOWN:
+        return KVM_EXIT_STAT_SHUTDOWN;
+    case KVM_EXIT_SYSTEM_EVENT:
+        return KVM_EXIT_STAT_SYSTEM_EVENT;
+    default:
+        return KVM_EXIT_STAT_OTHER;
+    }
+}
+
+static void kvm_stats_cb(StatsResultList **result, strList *names,
+                         Error **errp)
+{
+    CPUState *cpu;
+
+    CPU_FOREACH(cpu) {
+        g_autofree char *path = NULL;
+        StatsList *stats = NULL;
+        uint64_t total = 0;
+        int i;
+
+        if (!cpu->kvm_exit_stats) {
+            continue;
+        }
+        for (i = KVM_EXIT_STAT__MAX - 1; i >= 0; i--) {
+            size_t count = qatomic_read(&cpu->kvm_exit_stats->count[i]);
+
+            stats_add(&stats, names, kvm_exit_stat_names[i], count);
+            total += count;
+        }
+        stats_add(&stats, names, "exits", total);
+
+        path = object_get_canonical_path(OBJECT(cpu));
+        stats_result_add(result, STATS_PROVIDER_KVM, path, stats);
+    }
+}
+
+static void kvm_stats_schemas_cb(StatsSchemaValueList **result)
+{
+    int i;
+
+    for (i = KVM_EXIT_STAT__MAX - 1; i >= 0; i--) {
+        stats_schema_add(result, kvm_exit_stat_names[i],
+                         STATS_TYPE_CUMULATIVE, STATS_UNIT__MAX);
+    }
+    stats_schema_add(result, "exits", STATS_TYPE_CUMULATIVE,
+                     STATS_UNIT__MAX);
+}
+
 static int do_kvm_destroy_vcpu(CPUState *cpu)
 {
     KVMState *s = kvm_state;
@@ -385,6 +509,17 @@ static int do_kvm_destroy_vcpu(CPUState *cpu)
         goto err;
     }
 
+    if (cpu->kvm_dirty_gfns) {
+        ret = munmap(cpu->kvm_dirty_gfns, s->kvm_dirty_ring_bytes);
+        if (ret < 0) {
+            goto err;
+        }
+        cpu->kvm_dirty_gfns = NULL;
+    }
+
+    g_free(cpu->kvm_exit_stats);
+    cpu->kvm_exit_stats = NULL;
+
     vcpu = g_malloc0(sizeof(*vcpu));
     vcpu->vcpu_id = kvm_arch_vcpu_id(cpu);
     vcpu->kvm_fd = cpu->kvm_fd;
@@ -461,12 +596,31 @@ int kvm_init_vcpu(CPUState *cpu, Error **errp)
             (void *)cpu->kvm_run + s->coalesced_mmio * PAGE_SIZE;
     }
 
+    if (s->kvm_dirty_ring_size) {
+        /* Use MAP_SHARED to share pages with the kernel */
+        cpu->kvm_dirty_gfns = mmap(NULL, s->kvm_dirty_ring_bytes,
+                                   PROT_READ | PROT_WRITE, MAP_SHARED,
+                                   cpu->kvm_fd,
+                                   PAGE_SIZE * KVM_DIRTY_LOG_PAGE_OFFSET);
+        if (cpu->kvm_dirty_gfns == MAP_FAILED) {
+            ret = -errno;
+            error_setg_errno(errp, -ret,
+                             "kvm_init_vcpu: mmap'ing vcpu dirty gfns "
+                             "failed (%lu)", kvm_arch_vcpu_id(cpu));
+            cpu->kvm_dirty_gfns = NULL;
+            goto err;
+        }
+    }
+
     ret = kvm_arch_init_vcpu(cpu);
     if (ret < 0) {
         error_setg_errno(errp, -ret,
                          "kvm_init_vcpu: kvm_arch_init_vcpu failed (%lu)",
                          kvm_arch_vcpu_id(cpu));
+        goto err;
     }
+
+    cpu->kvm_exit_stats = g_new0(struct KVMExitStats, 1);
 err:
     return ret;
 }
@@ -475,6 +629,34 @@ err:
  * dirty pages logging control
  */
 
+#define ALIGN(x, y)  (((x)+(y)-1) & ~((y)-1))
+
+/* Allocate the dirty bitmap for a slot  */
+static void kvm_memslot_init_dirty_bitmap(KVMSlot *mem)
+{
+    /*
+     * XXX bad kernel interface alert
+     * For dirty bitmap, kernel allocates array of size aligned to
+     * bits-per-long.  But for case when the kernel is 64bits and
+     * the userspace is 32bits, userspace can't align to the same
+     * bits-per-long, since sizeof(long) is different between kernel
+     * and user space.  This way, userspace will provide buffer which
+     * may be 4 bytes less than the kernel will use, resulting in
+     * userspace memory corruption (which is not detectable by valgrind
+     * too, in most cases).
+     * So for now, let's align to 64 instead of HOST_LONG_BITS here, in
+     * a hope that sizeof(long) won't become >8 any time soon.
+     *
+     * Note: the granule of kvm dirty log is qemu_real_host_page_size.
+     * And mem->memory_size is aligned to it (otherwise this mem can't
+     * be registered to KVM).
+     */
+    hwaddr bitmap_size = ALIGN(mem->memory_size / qemu_real_host_page_size,
+                                        /*HOST_LONG_BITS*/ 64) / 8;
+    mem->dirty_bmap = g_malloc0(bitmap_size);
+    mem->dirty_bmap_size = bitmap_size;
+}
+
 static int kvm_mem_flags(MemoryRegion *mr)
 {
     bool readonly = mr->readonly || memory_region_is_romd(mr);
@@ -489,7 +671,7 @@ static int kvm_mem_flags(MemoryRegion *mr)
     return flags;
 }
 
-/* Called with KVMMemoryListener.slots_lock held */
+/* Called with kml_slots_lock held */
 static int kvm_slot_update_flags(KVMMemoryListener *kml, KVMSlot *mem,
                                  MemoryRegion *mr)
 {
@@ -500,6 +682,14 @@ static int kvm_slot_update_flags(KVMMemoryListener *kml, KVMSlot *mem,
         return 0;
     }
 
+    /*
+     * The dirty ring pushes dirty bits into the slot bitmap as soon as
+     * dirty logging is enabled, so it must exist beforehand.
+     */
+    if ((mem->flags & KVM_MEM_LOG_DIRTY_PAGES) && !mem->dirty_bmap) {
+        kvm_memslot_init_dirty_bitmap(mem);
+    }
+
     return kvm_set_user_memory_region(kml, mem, false);
 }
 
@@ -515,7 +705,7 @@ static int kvm_section_update_flags(KVMMemoryListener *kml,
         return 0;
     }
 
-    kvm_slots_lock(kml);
+    kvm_slots_lock();
 
     while (size && !ret) {
         slot_size = MIN(kvm_max_slot_size, size);
@@ -531,7 +721,7 @@ static int kvm_section_update_flags(KVMMemoryListener *kml,
     }
 
 out:
-    kvm_slots_unlock(kml);
+    kvm_slots_unlock();
     return ret;
 }
 
@@ -581,31 +771,23 @@ static int kvm_get_dirty_pages_log_range(MemoryRegionSection *section,
     return 0;
 }
 
-#define ALIGN(x, y)  (((x)+(y)-1) & ~((y)-1))
+/*
+ * Push the dirty bits collected in the slot's dirty bitmap into QEMU's
+ * ram_list dirty bitmaps.
+ *
+ * NOTE: caller must be with kml_slots_lock held.
+ */
+static void kvm_slot_sync_dirty_pages(KVMSlot *slot)
+{
+    ram_addr_t start = qemu_ram_addr_from_host(slot->ram);
+    ram_addr_t pages = slot->memory_size / qemu_real_host_page_size;
 
-/* Allocate the dirty bitmap for a slot  */
-static void kvm_memslot_init_dirty_bitmap(KVMSlot *mem)
+    cpu_physical_memory_set_dirty_lebitmap(slot->dirty_bmap, start, pages);
+}
+
+static void kvm_slot_reset_dirty_pages(KVMSlot *slot)
 {
-    /*
-     * XXX bad kernel interface alert
-     * For dirty bitmap, kernel allocates array of size aligned to
-     * bits-per-long.  But for case when the kernel is 64bits and
-     * the userspace is 32bits, userspace can't align to the same
-     * bits-per-long, since sizeof(long) is different between kernel
-     * and user space.  This way, userspace will provide buffer which
-     * may be 4 bytes less than the kernel will use, resulting in
-     * userspace memory corruption (which is not detectable by valgrind
-     * too, in most cases).
-     * So for now, let's align to 64 instead of HOST_LONG_BITS here, in
-     * a hope that sizeof(long) won't become >8 any time soon.
-     *
-     * Note: the granule of kvm dirty log is qemu_real_host_page_size.
-     * And mem->memory_size is aligned to it (otherwise this mem can't
-     * be registered to KVM).
-     */
-    hwaddr bitmap_size = ALIGN(mem->memory_size / qemu_real_host_page_size,
-                                        /*HOST_LONG_BITS*/ 64) / 8;
-    mem->dirty_bmap = g_malloc0(bitmap_size);
+    memset(slot->dirty_bmap, 0, slot->dirty_bmap_size);
 }
 
 /**
@@ -614,7 +796,7 @@ static void kvm_memslot_init_dirty_bitmap(KVMSlot *mem)
  * This function will first try to fetch dirty bitmap from the kernel,
  * and then updates qemu's dirty bitmap.
  *
- * NOTE: caller must be with kml->slots_lock held.
+ * NOTE: caller must be with kml_slots_lock held.
  *
  * @kml: the KVM memory listener object
  * @section: the memory section to sync the dirty bitmap with
@@ -668,6 +850,172 @@ out:
     return ret;
 }
 
+/* Should be with all slots_lock held for the address spaces. */
+static void kvm_dirty_ring_mark_page(KVMState *s, uint32_t as_id,
+                                     uint32_t slot_id, uint64_t offset)
+{
+    KVMMemoryListener *kml;
+    KVMSlot *mem;
+
+    if (as_id >= s->nr_as) {
+        return;
+    }
+
+    kml = s->as[as_id].ml;
+    mem = &kml->slots[slot_id];
+
+    if (!mem->memory_size || !mem->dirty_bmap || offset >=
+        (mem->memory_size / qemu_real_host_page_size)) {
+        return;
+    }
+
+    set_bit(offset, mem->dirty_bmap);
+}
+
+static bool dirty_gfn_is_dirtied(struct kvm_dirty_gfn *gfn)
+{
+    return gfn->flags == KVM_DIRTY_GFN_F_DIRTY;
+}
+
+static void dirty_gfn_set_collected(struct kvm_dirty_gfn *gfn)
+{
+    gfn->flags = KVM_DIRTY_GFN_F_RESET;
+}
+
+/*
+ * Should be with all slots_lock held for the address spaces.  It returns
+ * the dirty page we've collected on this dirty ring.
+ */
+static uint32_t kvm_dirty_ring_reap_one(KVMState *s, CPUState *cpu)
+{
+    struct kvm_dirty_gfn *dirty_gfns = cpu->kvm_dirty_gfns, *cur;
+    uint32_t ring_size = s->kvm_dirty_ring_size;
+    uint32_t count = 0, fetch = cpu->kvm_fetch_index;
+
+    assert(dirty_gfns && ring_size);
+    trace_kvm_dirty_ring_reap_vcpu(cpu->cpu_index);
+
+    while (true) {
+        cur = &dirty_gfns[fetch % ring_size];
+        if (!dirty_gfn_is_dirtied(cur)) {
+            break;
+        }
+        kvm_dirty_ring_mark_page(s, cur->slot >> 16, cur->slot & 0xffff,
+                                 cur->offset);
+        dirty_gfn_set_collected(cur);
+        trace_kvm_dirty_ring_page(cpu->cpu_index, fetch, cur->offset);
+        fetch++;
+        count++;
+    }
+    cpu->kvm_fetch_index = fetch;
+    cpu->dirty_pages += count;
+
+    return count;
+}
+
+/* Must be with slots_lock held */
+static uint64_t kvm_dirty_ring_reap_locked(KVMState *s)
+{
+    int ret;
+    CPUState *cpu;
+    uint64_t total = 0;
+    int64_t stamp;
+
+    stamp = get_clock();
+
+    CPU_FOREACH(cpu) {
+        total += kvm_dirty_ring_reap_one(s, cpu);
+    }
+
+    if (total) {
+        ret = kvm_vm_ioctl(s, KVM_RESET_DIRTY_RINGS);
+        assert(ret == total);
+    }
+
+    stamp = get_clock() - stamp;
+
+    if (total) {
+        trace_kvm_dirty_ring_reap(total, stamp / 1000);
+    }
+
+    return total;
+}
+
+/*
+ * Currently for simplicity, we must hold BQL before calling this.  We can
+ * consider to drop the BQL if we're clear with all the race conditions.
+ */
+static uint64_t kvm_dirty_ring_reap(KVMState *s)
+{
+    uint64_t total;
+
+    /*
+     * We need to lock all kvm slots for all address spaces here,
+     * because:
+     *
+     * (1) We need to mark dirty for dirty bitmaps in multiple slots
+     *     and for tons of pages, so it's better to take the lock here
+     *     once rather than once per page.  And more importantly,
+     *
+     * (2) We must _NOT_ publish dirty bits to the other threads
+     *     (e.g., the migration thread) via the kvm memory slot dirty
+     *     bitmaps before correctly re-protect those dirtied pages.
+     *     Otherwise we can have potential risk of data corruption if
+     *     the page data is read in the other thread before we do
+     *     reset below.
+     */
+    kvm_slots_lock();
+    total = kvm_dirty_ring_reap_locked(s);
+    kvm_slots_unlock();
+
+    return total;
+}
+
+static void do_kvm_cpu_synchronize_kick(CPUState *cpu, run_on_cpu_data arg)
+{
+    /* No need to do anything */
+}
+
+/*
+ * Kick all vcpus out in a synchronized way.  When returned, we
+ * guarantee that every vcpu has been kicked and at least returned to
+ * userspace once.
+ */
+static void kvm_cpu_synchronize_kick_all(void)
+{
+    CPUState *cpu;
+
+    CPU_FOREACH(cpu) {
+        run_on_cpu(cpu, do_kvm_cpu_synchronize_kick, RUN_ON_CPU_NULL);
+    }
+}
+
+/*
+ * Flush all the existing dirty pages to the KVM slot buffers.  When
+ * this call returns, we guarantee that all the touched dirty pages
+ * before calling this function have been put into the per-kvmslot
+ * dirty bitmap.
+ *
+ * This function must be called with BQL held.
+ */
+static void kvm_dirty_ring_flush(void)
+{
+    trace_kvm_dirty_ring_flush(0);
+    /*
+     * The function needs to be serialized.  Since this function
+     * should always be with BQL held, serialization is guaranteed.
+     * However, let's be sure of it.
+     */
+    assert(qemu_mutex_iothread_locked());
+    /*
+     * First make sure to flush the hardware buffers by kicking all
+     * vcpus out in a synchronous way.
+     */
+    kvm_cpu_synchronize_kick_all();
+    kvm_dirty_ring_reap(kvm_state);
+    trace_kvm_dirty_ring_flush(1);
+}
+
 /* Alignment requirement for KVM_CLEAR_DIRTY_LOG - 64 pages */
 #define KVM_CLEAR_LOG_SHIFT  6
 #define KVM_CLEAR_LOG_ALIGN  (qemu_real_host_page_size << KVM_CLEAR_LOG_SHIFT)
@@ -812,7 +1160,7 @@ static int kvm_physical_log_clear(KVMMemoryListener *kml,
         return ret;
     }
 
-    kvm_slots_lock(kml);
+    kvm_slots_lock();
 
     for (i = 0; i < s->nr_slots; i++) {
         mem = &kml->slots[i];
@@ -838,7 +1186,7 @@ static int kvm_physical_log_clear(KVMMemoryListener *kml,
         }
     }
 
-    kvm_slots_unlock(kml);
+    kvm_slots_unlock();
 
     return ret;
 }
@@ -1143,7 +1491,7 @@ static void kvm_set_phys_mem(KVMMemoryListener *kml,
     ram = memory_region_get_ram_ptr(mr) + section->offset_within_region +
           (start_addr - section->offset_within_address_space);
 
-    kvm_slots_lock(kml);
+    kvm_slots_lock();
 
     if (!add) {
         do {
@@ -1153,7 +1501,26 @@ static void kvm_set_phys_mem(KVMMemoryListener *kml,
                 goto out;
             }
             if (mem->flags & KVM_MEM_LOG_DIRTY_PAGES) {
-                kvm_physical_sync_dirty_bitmap(kml, section);
+                if (kvm_state->kvm_dirty_ring_size) {
+                    /*
+                     * NOTE: We should be aware of the fact that here we're
+                     * only doing a best effort to sync dirty bits.  No
+                     * matter whether we're using dirty log or dirty ring,
+                     * we ignored two facts:
+                     *
+                     * (1) dirty bits can reside in hardware buffers (PML)
+                     *
+                     * (2) after we collected dirty bits here, pages can
+                     *     be dirtied again before we do the final
+                     *     KVM_SET_USER_MEMORY_REGION to remove the slot.
+                     *
+                     * Not easy.  Let's cross the fingers until it's fixed.
+                     */
+                    kvm_dirty_ring_reap_locked(kvm_state);
+                    kvm_slot_sync_dirty_pages(mem);
+                } else {
+                    kvm_physical_sync_dirty_bitmap(kml, section);
+                }
             }
 
             /* unregister the slot */
@@ -1181,6 +1548,7 @@ static void kvm_set_phys_mem(KVMMemoryListener *kml,
         mem->start_addr = start_addr;
         mem->ram = ram;
         mem->flags = kvm_mem_flags(mr);
+        mem->as_id = kml->as_id;
 
         if (mem->flags & KVM_MEM_LOG_DIRTY_PAGES) {
             /*
@@ -1201,25 +1569,135 @@ static void kvm_set_phys_mem(KVMMemoryListener *kml,
     } while (size);
 
 out:
-    kvm_slots_unlock(kml);
+    kvm_slots_unlock();
+}
+
+static void kvm_run_gate_exit(void)
+{
+    if (qatomic_fetch_dec(&kvm_run_gate_count) == 1 &&
+        qatomic_read(&kvm_run_gate_closed)) {
+        qemu_mutex_lock(&kvm_run_gate_lock);
+        qemu_cond_broadcast(&kvm_run_gate_cond);
+        qemu_mutex_unlock(&kvm_run_gate_lock);
+    }
+}
+
+static void kvm_run_gate_enter(void)
+{
+    qatomic_inc(&kvm_run_gate_count);
+    while (unlikely(qatomic_read(&kvm_run_gate_closed))) {
+        kvm_run_gate_exit();
+        qemu_mutex_lock(&kvm_run_gate_lock);
+        while (qatomic_read(&kvm_run_gate_closed)) {
+            qemu_cond_wait(&kvm_run_gate_cond, &kvm_run_gate_lock);
+        }
+        qemu_mutex_unlock(&kvm_run_gate_lock);
+        qatomic_inc(&kvm_run_gate_count);
+    }
+}
+
+/* Called with the BQL held, so only one memory transaction closes it */
+static void kvm_run_gate_close(void)
+{
+    CPUState *cpu;
+
+    qemu_mutex_lock(&kvm_run_gate_lock);
+    qatomic_set(&kvm_run_gate_closed, true);
+    smp_mb();
+    CPU_FOREACH(cpu) {
+        if (!qemu_cpu_is_self(cpu)) {
+            qemu_cpu_kick(cpu);
+        }
+    }
+    while (qatomic_read(&kvm_run_gate_count)) {
+        qemu_cond_wait(&kvm_run_gate_cond, &kvm_run_gate_lock);
+    }
+    qemu_mutex_unlock(&kvm_run_gate_lock);
+}
+
+static void kvm_run_gate_open(void)
+{
+    qemu_mutex_lock(&kvm_run_gate_lock);
+    qatomic_set(&kvm_run_gate_closed, false);
+    qemu_cond_broadcast(&kvm_run_gate_cond);
+    qemu_mutex_unlock(&kvm_run_gate_lock);
+}
+
+static bool kvm_sections_overlap(MemoryRegionSection *a,
+                                 MemoryRegionSection *b)
+{
+    Int128 a_start = int128_make64(a->offset_within_address_space);
+    Int128 b_start = int128_make64(b->offset_within_address_space);
+
+    return int128_lt(a_start, int128_add(b_start, b->size)) &&
+           int128_lt(b_start, int128_add(a_start, a->size));
 }
 
 static void kvm_region_add(MemoryListener *listener,
                            MemoryRegionSection *section)
 {
     KVMMemoryListener *kml = container_of(listener, KVMMemoryListener, listener);
+    KVMMemoryUpdate *update = g_new0(KVMMemoryUpdate, 1);
 
     memory_region_ref(section->mr);
-    kvm_set_phys_mem(kml, section, true);
+    update->section = *section;
+    QSIMPLEQ_INSERT_TAIL(&kml->transaction_add, update, next);
 }
 
 static void kvm_region_del(MemoryListener *listener,
                            MemoryRegionSection *section)
 {
     KVMMemoryListener *kml = container_of(listener, KVMMemoryListener, listener);
+    KVMMemoryUpdate *update = g_new0(KVMMemoryUpdate, 1);
+
+    update->section = *section;
+    QSIMPLEQ_INSERT_TAIL(&kml->transaction_del, update, next);
+}
+
+/*
+ * Apply all the slot changes of a memory transaction at once.  KVM can
+ * only change one slot per ioctl, and resizing or splitting a slot means
+ * deleting it and adding it back; if the deleted range comes back in the
+ * same transaction, keep the vCPUs out of the guest meanwhile so that
+ * they do not fault on the temporary hole.
+ */
+static void kvm_region_commit(MemoryListener *listener)
+{
+    KVMMemoryListener *kml = container_of(listener, KVMMemoryListener, listener);
+    KVMMemoryUpdate *u1, *u2;
+    bool need_gate = false;
+
+    QSIMPLEQ_FOREACH(u1, &kml->transaction_del, next) {
+        QSIMPLEQ_FOREACH(u2, &kml->transaction_add, next) {
+            if (kvm_sections_overlap(&u1->section, &u2->section)) {
+                need_gate = true;
+                break;
+            }
+        }
+        if (need_gate) {
+            break;
+        }
+    }
 
-    kvm_set_phys_mem(kml, section, false);
-    memory_region_unref(section->mr);
+    if (need_gate) {
+        kvm_run_gate_close();
+    }
+
+    while ((u1 = QSIMPLEQ_FIRST(&kml->transaction_del))) {
+        QSIMPLEQ_REMOVE_HEAD(&kml->transaction_del, next);
+        kvm_set_phys_mem(kml, &u1->section, false);
+        memory_region_unref(u1->section.mr);
+        g_free(u1);
+    }
+    while ((u1 = QSIMPLEQ_FIRST(&kml->transaction_add))) {
+        QSIMPLEQ_REMOVE_HEAD(&kml->transaction_add, next);
+        kvm_set_phys_mem(kml, &u1->section, true);
+        g_free(u1);
+    }
+
+    if (need_gate) {
+        kvm_run_gate_open();
+    }
 }
 
 static void kvm_log_sync(MemoryListener *listener,
@@ -1228,14 +1706,45 @@ static void kvm_log_sync(MemoryListener *listener,
     KVMMemoryListener *kml = container_of(listener, KVMMemoryListener, listener);
     int r;
 
-    kvm_slots_lock(kml);
+    kvm_slots_lock();
     r = kvm_physical_sync_dirty_bitmap(kml, section);
-    kvm_slots_unlock(kml);
+    kvm_slots_unlock();
     if (r < 0) {
         abort();
     }
 }
 
+static void kvm_log_sync_global(MemoryListener *l)
+{
+    KVMMemoryListener *kml = container_of(l, KVMMemoryListener, listener);
+    KVMState *s = kvm_state;
+    KVMSlot *mem;
+    int i;
+
+    /* Flush all kernel dirty addresses into KVMSlot dirty bitmap */
+    kvm_dirty_ring_flush();
+
+    /*
+     * TODO: make this faster when nr_slot is big while there are
+     * only a few used slots (small VMs).
+     */
+    kvm_slots_lock();
+    for (i = 0; i < s->nr_slots; i++) {
+        mem = &kml->slots[i];
+        if (mem->memory_size && mem->dirty_bmap &&
+            mem->flags & KVM_MEM_LOG_DIRTY_PAGES) {
+            kvm_slot_sync_dirty_pages(mem);
+            /*
+             * This is not needed by KVM_GET_DIRTY_LOG because the
+             * ioctl will unconditionally overwrite the whole region.
+             * However kvm dirty ring has no such side effect.
+             */
+            kvm_slot_reset_dirty_pages(mem);
+        }
+    }
+    kvm_slots_unlock();
+}
+
 static void kvm_log_clear(MemoryListener *listener,
                           MemoryRegionSection *section)
 {
@@ -1330,7 +1839,6 @@ void kvm_memory_listener_register(KVMState *s, KVMMemoryListener *kml,
 {
     int i;
 
-    qemu_mutex_init(&kml->slots_lock);
     kml->slots = g_malloc0(s->nr_slots * sizeof(KVMSlot));
     kml->as_id = as_id;
 
@@ -1338,14 +1846,23 @@ void kvm_memory_listener_register(KVMState *s, KVMMemoryListener *kml,
         kml->slots[i].slot = i;
     }
 
+    QSIMPLEQ_INIT(&kml->transaction_add);
+    QSIMPLEQ_INIT(&kml->transaction_del);
+
     kml->listener.region_add = kvm_region_add;
     kml->listener.region_del = kvm_region_del;
+    kml->listener.commit = kvm_region_commit;
     kml->listener.log_start = kvm_log_start;
     kml->listener.log_stop = kvm_log_stop;
-    kml->listener.log_sync = kvm_log_sync;
-    kml->listener.log_clear = kvm_log_clear;
     kml->listener.priority = 10;
 
+    if (s->kvm_dirty_ring_size) {
+        kml->listener.log_sync_global = kvm_log_sync_global;
+    } else {
+        kml->listener.log_sync = kvm_log_sync;
+        kml->listener.log_clear = kvm_log_clear;
+    }
+
     memory_listener_register(&kml->listener, as);
 
     for (i = 0; i < s->nr_as; ++i) {
@@ -1406,10 +1923,16 @@ void kvm_init_irq_routing(KVMState *s)
         /* Round up so we can search ints using ffs */
         s->used_gsi_bitmap = bitmap_new(gsi_count);
         s->gsi_count = gsi_count;
+        s->irq_route_index = g_new(int, gsi_count);
+        for (i = 0; i < gsi_count; i++) {
+            s->irq_route_index[i] = -1;
+        }
     }
 
     s->irq_routes = g_malloc0(sizeof(*s->irq_routes));
     s->nr_allocated_irq_routes = 0;
+    /* the first commit replaces whatever default routing KVM set up */
+    s->irq_routes_dirty = true;
 
     if (!kvm_direct_msi_allowed) {
         for (i = 0; i < KVM_MSI_HASHTAB_SIZE; i++) {
@@ -1420,7 +1943,7 @@ void kvm_init_irq_routing(KVMState *s)
     kvm_arch_init_irq_routing(s);
 }
 
-void kvm_irqchip_commit_routes(KVMState *s)
+static void kvm_irqchip_push_routes(KVMState *s)
 {
     int ret;
 
@@ -1428,7 +1951,7 @@ void kvm_irqchip_commit_routes(KVMState *s)
         return;
     }
 
-    if (!kvm_gsi_routing_enabled()) {
+    if (!kvm_gsi_routing_enabled() || !s->irq_routes_dirty) {
         return;
     }
 
@@ -1436,6 +1959,46 @@ void kvm_irqchip_commit_routes(KVMState *s)
     trace_kvm_irqchip_commit_routes();
     ret = kvm_vm_ioctl(s, KVM_SET_GSI_ROUTING, s->irq_routes);
     assert(ret == 0);
+    s->irq_routes_dirty = false;
+}
+
+/*
+ * KVM_SET_GSI_ROUTING replaces the whole table, so changes to many
+ * vectors in a row are only pushed once: between begin and end,
+ * kvm_irqchip_commit_routes() just leaves the table dirty.
+ */
+void kvm_irqchip_begin_route_changes(KVMState *s)
+{
+    if (!kvm_gsi_routing_enabled()) {
+        return;
+    }
+    s->irq_routes_batch++;
+}
+
+void kvm_irqchip_end_route_changes(KVMState *s)
+{
+    if (!kvm_gsi_routing_enabled()) {
+        return;
+    }
+    assert(s->irq_routes_batch > 0);
+    if (--s->irq_routes_batch == 0) {
+        kvm_irqchip_push_routes(s);
+    }
+}
+
+void kvm_irqchip_sync_routes(KVMState *s)
+{
+    if (!kvm_gsi_routing_enabled()) {
+        return;
+    }
+    kvm_irqchip_push_routes(s);
+}
+
+void kvm_irqchip_commit_routes(KVMState *s)
+{
+    if (!s->irq_routes_batch) {
+        kvm_irqchip_push_routes(s);
+    }
 }
 
 static void kvm_add_routing_entry(KVMState *s,
@@ -1460,6 +2023,8 @@ static void kvm_add_routing_entry(KVMState *s,
     *new = *entry;
 
     set_gsi(s, entry->gsi);
+    s->irq_route_index[entry->gsi] = n;
+    s->irq_routes_dirty = true;
 }
 
 static int kvm_update_routing_entry(KVMState *s,
@@ -1468,22 +2033,24 @@ static int kvm_update_routing_entry(KVMState *s,
     struct kvm_irq_routing_entry *entry;
     int n;
 
-    for (n = 0; n < s->irq_routes->nr; n++) {
-        entry = &s->irq_routes->entries[n];
-        if (entry->gsi != new_entry->gsi) {
-            continue;
-        }
-
-        if(!memcmp(entry, new_entry, sizeof *entry)) {
-            return 0;
-        }
-
-        *entry = *new_entry;
+    if (new_entry->gsi >= s->gsi_count) {
+        return -ESRCH;
+    }
+    n = s->irq_route_index[new_entry->gsi];
+    if (n < 0) {
+        return -ESRCH;
+    }
 
+    entry = &s->irq_routes->entries[n];
+    assert(entry->gsi == new_entry->gsi);
+    if (!memcmp(entry, new_entry, sizeof *entry)) {
         return 0;
     }
 
-    return -ESRCH;
+    *entry = *new_entry;
+    s->irq_routes_dirty = true;
+
+    return 0;
 }
 
 void kvm_irqchip_add_irq_route(KVMState *s, int irq, int irqchip, int pin)
@@ -1514,8 +2081,11 @@ void kvm_irqchip_release_virq(KVMState *s, int virq)
         if (e->gsi == virq) {
             s->irq_routes->nr--;
             *e = s->irq_routes->entries[s->irq_routes->nr];
+            s->irq_route_index[e->gsi] = i;
+            s->irq_routes_dirty = true;
         }
     }
+    s->irq_route_index[virq] = -1;
     clear_gsi(s, virq);
     kvm_arch_release_virq_post(virq);
     trace_kvm_irqchip_release_virq(virq);
@@ -1628,7 +2198,7 @@ int kvm_irqchip_send_msi(KVMState *s, MSIMessage msg)
         route->kroute.u.msi.data = le32_to_cpu(msg.data);
 
         kvm_add_routing_entry(s, &route->kroute);
-        kvm_irqchip_commit_routes(s);
+        kvm_irqchip_push_routes(s);
 
         QTAILQ_INSERT_TAIL(&s->msi_hashtab[kvm_hash_msi(msg.data)], route,
                            entry);
@@ -1766,6 +2336,11 @@ static int kvm_irqchip_assign_irqfd(KVMState *s, EventNotifier *event,
         return -ENOSYS;
     }
 
+    /* Never let an irqfd fire through a route KVM does not know yet */
+    if (assign) {
+        kvm_irqchip_push_routes(s);
+    }
+
     return kvm_vm_ioctl(s, KVM_IRQFD, &irqfd);
 }
 
@@ -1831,6 +2406,18 @@ void kvm_init_irq_routing(KVMState *s)
 {
 }
 
+void kvm_irqchip_begin_route_changes(KVMState *s)
+{
+}
+
+void kvm_irqchip_end_route_changes(KVMState *s)
+{
+}
+
+void kvm_irqchip_sync_routes(KVMState *s)
+{
+}
+
 void kvm_irqchip_release_virq(KVMState *s, int virq)
 {
 }
@@ -1982,6 +2569,60 @@ bool kvm_vcpu_id_is_valid(int vcpu_id)
     return vcpu_id >= 0 && vcpu_id < kvm_max_vcpu_id(s);
 }
 
+static void *kvm_dirty_ring_reaper_thread(void *data)
+{
+    KVMState *s = data;
+    struct KVMDirtyRingReaper *r = &s->reaper;
+
+    rcu_register_thread();
+
+    trace_kvm_dirty_ring_reaper("init");
+
+    while (true) {
+        r->reaper_state = KVM_DIRTY_RING_REAPER_WAIT;
+        trace_kvm_dirty_ring_reaper("wait");
+        /*
+         * Vcpus hitting a full ring reap synchronously, so this only
+         * needs to keep the rings from filling up in the common case.
+         */
+        sleep(1);
+
+        /*
+         * The dirty limit throttles vCPUs when their rings are full, so
+         * leave the rings alone while it's in service.
+         */
+        if (dirtylimit_in_service()) {
+            continue;
+        }
+
+        trace_kvm_dirty_ring_reaper("wakeup");
+        r->reaper_state = KVM_DIRTY_RING_REAPER_REAPING;
+
+        qemu_mutex_lock_iothread();
+        kvm_dirty_ring_reap(s);
+        qemu_mutex_unlock_iothread();
+
+        r->reaper_iteration++;
+    }
+
+    trace_kvm_dirty_ring_reaper("exit");
+
+    rcu_unregister_thread();
+
+    return NULL;
+}
+
+static int kvm_dirty_ring_reaper_init(KVMState *s)
+{
+    struct KVMDirtyRingReaper *r = &s->reaper;
+
+    qemu_thread_create(&r->reaper_thr, "kvm-reaper",
+                       kvm_dirty_ring_reaper_thread,
+                       s, QEMU_THREAD_JOINABLE);
+
+    return 0;
+}
+
 static int kvm_init(MachineState *ms)
 {
     MachineClass *mc = MACHINE_GET_CLASS(ms);
@@ -2019,6 +2660,9 @@ static int kvm_init(MachineState *ms)
     QTAILQ_INIT(&s->kvm_sw_breakpoints);
 #endif
     QLIST_INIT(&s->kvm_parked_vcpus);
+    qemu_mutex_init(&kml_slots_lock);
+    qemu_mutex_init(&kvm_run_gate_lock);
+    qemu_cond_init(&kvm_run_gate_cond);
     s->vmfd = -1;
     s->fd = qemu_open_old("/dev/kvm", O_RDWR);
     if (s->fd == -1) {
@@ -2127,10 +2771,54 @@ static int kvm_init(MachineState *ms)
     s->coalesced_pio = s->coalesced_mmio &&
                        kvm_check_extension(s, KVM_CAP_COALESCED_PIO);
 
+    /*
+     * Enable KVM dirty ring if supported, otherwise fall back to
+     * dirty logging mode
+     */
+    if (s->kvm_dirty_ring_size > 0) {
+        uint64_t ring_bytes;
+
+        ring_bytes = s->kvm_dirty_ring_size * sizeof(struct kvm_dirty_gfn);
+
+        /* Read the max supported pages */
+        ret = kvm_vm_check_extension(s, KVM_CAP_DIRTY_LOG_RING);
+        if (ret > 0) {
+            if (ring_bytes > ret) {
+                error_report("KVM dirty ring size %" PRIu32 " too big "
+                             "(maximum is %ld).  Please use a smaller value.",
+                             s->kvm_dirty_ring_size,
+                             (long)ret / sizeof(struct kvm_dirty_gfn));
+                ret = -EINVAL;
+                goto err;
+            }
+
+            ret = kvm_vm_enable_cap(s, KVM_CAP_DIRTY_LOG_RING, 0, ring_bytes);
+            if (ret) {
+                error_report("Enabling of KVM dirty ring failed: %s. "
+                             "Suggested minimum value is 1024.",
+                             strerror(-ret));
+                goto err;
+            }
+
+            s->kvm_dirty_ring_bytes = ring_bytes;
+        } else {
+            warn_report("KVM dirty ring not available, using bitmap method");
+            s->kvm_dirty_ring_size = 0;
+        }
+    }
+
+    /*
+     * KVM_CAP_DIRTY_LOG_RING can't be used together with
+     * KVM_CAP_MANUAL_DIRTY_LOG_PROTECT2, and the ring has no use for it
+     * anyway since pages are re-protected by KVM_RESET_DIRTY_RINGS.
+     */
     dirty_log_manual_caps =
         kvm_check_extension(s, KVM_CAP_MANUAL_DIRTY_LOG_PROTECT2);
     dirty_log_manual_caps &= (KVM_DIRTY_LOG_MANUAL_PROTECT_ENABLE |
                               KVM_DIRTY_LOG_INITIALLY_SET);
+    if (s->kvm_dirty_ring_size) {
+        dirty_log_manual_caps = 0;
+    }
     s->manual_dirty_log_protect = dirty_log_manual_caps;
     if (dirty_log_manual_caps) {
         ret = kvm_vm_enable_cap(s, KVM_CAP_MANUAL_DIRTY_LOG_PROTECT2, 0,
@@ -2226,6 +2914,17 @@ static int kvm_init(MachineState *ms)
         ret = ram_block_discard_disable(true);
         assert(!ret);
     }
+
+    if (s->kvm_dirty_ring_size) {
+        ret = kvm_dirty_ring_reaper_init(s);
+        if (ret) {
+            goto err;
+        }
+    }
+
+    add_stats_callbacks(STATS_PROVIDER_KVM, kvm_stats_cb,
+                        kvm_stats_schemas_cb);
+
     return 0;
 
 err:
@@ -2464,7 +3163,9 @@ int kvm_cpu_exec(CPUState *cpu)
          */
         smp_rmb();
 
+        kvm_run_gate_enter();
         run_ret = kvm_vcpu_ioctl(cpu, KVM_RUN, 0);
+        kvm_run_gate_exit();
 
         attrs = kvm_arch_post_run(cpu, run);
 
@@ -2482,6 +3183,7 @@ int kvm_cpu_exec(CPUState *cpu)
             if (run_ret == -EINTR || run_ret == -EAGAIN) {
                 DPRINTF("io window exit\n");
                 kvm_eat_signals(cpu);
+                kvm_account_exit(cpu, KVM_EXIT_STAT_INTERRUPTED);
                 ret = EXCP_INTERRUPT;
                 break;
             }
@@ -2500,6 +3202,7 @@ int kvm_cpu_exec(CPUState *cpu)
         }
 
         trace_kvm_run_exit(cpu->cpu_index, run->exit_reason);
+        kvm_account_exit(cpu, kvm_exit_stat(run->exit_reason));
         switch (run->exit_reason) {
         case KVM_EXIT_IO:
             DPRINTF("handle_io\n");
@@ -2525,6 +3228,18 @@ int kvm_cpu_exec(CPUState *cpu)
             DPRINTF("irq_window_open\n");
             ret = EXCP_INTERRUPT;
             break;
+        case KVM_EXIT_DIRTY_RING_FULL:
+            /*
+             * We shouldn't continue if the dirty ring of this vcpu is
+             * still full.  Got kicked by KVM_RESET_DIRTY_RINGS.
+             */
+            trace_kvm_dirty_ring_full(cpu->cpu_index);
+            qemu_mutex_lock_iothread();
+            kvm_dirty_ring_reap(kvm_state);
+            qemu_mutex_unlock_iothread();
+            dirtylimit_vcpu_execute(cpu);
+            ret = 0;
+            break;
         case KVM_EXIT_SHUTDOWN:
             DPRINTF("shutdown\n");
             qemu_system_reset_request(SHUTDOWN_CAUSE_GUEST_RESET);
@@ -2708,6 +3423,11 @@ bool kvm_has_sync_mmu(void)
     return kvm_state->sync_mmu;
 }
 
+bool kvm_dirty_ring_enabled(void)
+{
+    return kvm_state->kvm_dirty_ring_size != 0;
+}
+
 int kvm_has_vcpu_events(void)
 {
     return kvm_state->vcpu_events;
@@ -3170,13 +3890,50 @@ bool kvm_kernel_irqchip_split(void)
     return kvm_state->kernel_irqchip_split == ON_OFF_AUTO_ON;
 }
 
+static void kvm_get_dirty_ring_size(Object *obj, Visitor *v,
+                                    const char *name, void *opaque,
+                                    Error **errp)
+{
+    KVMState *s = KVM_STATE(obj);
+    uint32_t value = s->kvm_dirty_ring_size;
+
+    visit_type_uint32(v, name, &value, errp);
+}
+
+static void kvm_set_dirty_ring_size(Object *obj, Visitor *v,
+                                    const char *name, void *opaque,
+                                    Error **errp)
+{
+    KVMState *s = KVM_STATE(obj);
+    uint32_t value;
+
+    if (s->fd != -1) {
+        error_setg(errp, "Cannot set properties after the accelerator "
+                   "has been initialized");
+        return;
+    }
+
+    if (!visit_type_uint32(v, name, &value, errp)) {
+        return;
+    }
+    if (value & (value - 1)) {
+        error_setg(errp, "dirty-ring-size must be a power of two.");
+        return;
+    }
+
+    s->kvm_dirty_ring_size = value;
+}
+
 static void kvm_accel_instance_init(Object *obj)
 {
     KVMState *s = KVM_STATE(obj);
 
+    s->fd = -1;
     s->kvm_shadow_mem = -1;
     s->kernel_irqchip_allowed = true;
     s->kernel_irqchip_split = ON_OFF_AUTO_AUTO;
+    /* KVM dirty ring is by default off */
+    s->kvm_dirty_ring_size = 0;
 }
 
 static void kvm_accel_class_init(ObjectClass *oc, void *data)
@@ -3198,6 +3955,12 @@ static void kvm_accel_class_init(ObjectClass *oc, void *data)
         NULL, NULL);
     object_class_property_set_description(oc, "kvm-shadow-mem",
         "KVM shadow MMU size");
+
+    object_class_property_add(oc, "dirty-ring-size", "uint32",
+        kvm_get_dirty_ring_size, kvm_set_dirty_ring_size,
+        NULL, NULL);
+    object_class_property_set_description(oc, "dirty-ring-size",
+        "Size of KVM dirty page ring buffer (default: 0, i.e. use bitmap)");
 }
 
 static const TypeInfo kvm_accel_type = {
@@ -28,6 +28,7 @@
 #include "tcg/tcg.h"
 #include "qemu/atomic.h"
 #include "qemu/compiler.h"
+#include "qemu/host-utils.h"
 #include "qemu/timer.h"
 #include "qemu/rcu.h"
 #include "exec/tb-hash.h"
@@ -39,6 +40,7 @@
 #endif
 #include "sysemu/cpus.h"
 #include "exec/cpu-all.h"
+#include "exec/tb-stats.h"
 #include "sysemu/cpu-timers.h"
 #include "sysemu/replay.h"
 #include "internal.h"
@@ -202,6 +204,11 @@ cpu_tb_exec(CPUState *cpu, TranslationBlock *itb, int *tb_exit)
 
     trace_exec_tb_exit(last_tb, *tb_exit);
 
+    /* exit_tb(NULL) leaves no last_tb; that is not counted */
+    if (last_tb && last_tb->tb_stats && *tb_exit <= TB_EXIT_IDX1) {
+        last_tb->tb_stats->exits++;
+    }
+
     if (*tb_exit > TB_EXIT_IDX1) {
         /* We didn't start executing this TB (eg because the instruction
          * counter hit zero); we must restore the guest PC to the address
@@ -430,6 +437,18 @@ static inline TranslationBlock *tb_find(CPUState *cpu,
         mmap_unlock();
         /* We add the TB in the virtual pc hash table for the fast lookup */
         qatomic_set(&cpu->tb_jmp_cache[tb_jmp_cache_hash_func(pc)], tb);
+    } else if (unlikely(qatomic_read(&tb->hot_countdown) > 0)) {
+        /*
+         * Quick TBs are never chained to, so that each of their executions
+         * goes through here.  Only the vCPU that brings the count to zero
+         * retranslates the TB.
+         */
+        if (qatomic_fetch_dec(&tb->hot_countdown) == 1) {
+            mmap_lock();
+            tb = tb_gen_code_hot(cpu, tb, cflags);
+            mmap_unlock();
+            qatomic_set(&cpu->tb_jmp_cache[tb_jmp_cache_hash_func(pc)], tb);
+        }
     }
 #ifndef CONFIG_USER_ONLY
     /* We don't take care of direct jumps when address mapping changes in
@@ -441,7 +460,7 @@ static inline TranslationBlock *tb_find(CPUState *cpu,
     }
 #endif
     /* See if we can patch the calling TB. */
-    if (last_tb) {
+    if (last_tb && !qatomic_read(&tb->hot_countdown)) {
         tb_add_jump(last_tb, tb_exit, tb);
     }
     return tb;
@@ -560,6 +579,28 @@ static inline bool need_replay_interrupt(int interrupt_request)
 #endif
 }
 
+/*
+ * Return true if none of the requests in cpu->interrupt_request can be
+ * acted upon now, which can be decided without the BQL: everything is
+ * left to the target hook, and the hook says that all of it is masked.
+ * A request posted after this check makes the next TB exit again.
+ */
+static inline bool cpu_interrupts_masked(CPUState *cpu, CPUClass *cc)
+{
+    int interrupt_request = qatomic_read(&cpu->interrupt_request);
+
+    if (!cc->tcg_ops->cpu_exec_interrupt_pending ||
+        cpu->singlestep_enabled ||
+        replay_mode != REPLAY_MODE_NONE) {
+        return false;
+    }
+    if (interrupt_request & (CPU_INTERRUPT_DEBUG | CPU_INTERRUPT_HALT |
+                             CPU_INTERRUPT_EXITTB | CPU_INTERRUPT_RESET)) {
+        return false;
+    }
+    return !cc->tcg_ops->cpu_exec_interrupt_pending(cpu, interrupt_request);
+}
+
 static inline bool cpu_handle_interrupt(CPUState *cpu,
                                         TranslationBlock **last_tb)
 {
@@ -572,7 +613,8 @@ static inline bool cpu_handle_interrupt(CPUState *cpu,
      */
     qatomic_mb_set(&cpu_neg(cpu)->icount_decr.u16.high, 0);
 
-    if (unlikely(qatomic_read(&cpu->interrupt_request))) {
+    if (unlikely(qatomic_read(&cpu->interrupt_request)) &&
+        !cpu_interrupts_masked(cpu, cc)) {
         int interrupt_request;
         qemu_mutex_lock_iothread();
         interrupt_request = cpu->interrupt_request;
@@ -701,11 +743,18 @@ static inline void cpu_loop_exec_tb(CPUState *cpu, TranslationBlock *tb,
 
     /*
      * If the next tb has more instructions than we have left to
-     * execute we need to ensure we find/generate a TB with exactly
-     * insns_left instructions in it.
+     * execute we need to stop exactly at the end of the budget.
+     * Do so with TBs of power-of-two lengths rather than one TB of
+     * insns_left instructions: the budget ends at a different point
+     * every time, and exact-length TBs would almost never be found
+     * again, so each deadline would cost a translation.  With powers
+     * of two there are at most a handful of variants of each TB, they
+     * stay in the cache, and the budget runs out after at most
+     * log2(TCG_MAX_INSNS) of them.
      */
     if (!cpu->icount_extra && insns_left > 0 && insns_left < tb->icount)  {
-        cpu->cflags_next_tb = (tb->cflags & ~CF_COUNT_MASK) | insns_left;
+        cpu->cflags_next_tb = (tb->cflags & ~CF_COUNT_MASK) |
+                              pow2floor(insns_left);
     }
 #endif
 }
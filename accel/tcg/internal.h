@@ -14,6 +14,10 @@
 TranslationBlock *tb_gen_code(CPUState *cpu, target_ulong pc,
                               target_ulong cs_base, uint32_t flags,
                               int cflags);
+TranslationBlock *tb_gen_code_hot(CPUState *cpu, TranslationBlock *tb,
+                                  uint32_t cflags);
+
+extern bool tcg_tiered;
 
 void QEMU_NORETURN cpu_io_recompile(CPUState *cpu, uintptr_t retaddr);
 
@@ -62,6 +62,8 @@
  * 0: enum plugin_gen_from
  * 1: enum plugin_gen_cb
  * 2: set to 1 for mem callback that is a write, 0 otherwise.
+ * 3: for PLUGIN_GEN_FROM_MEM trace records, the address temp
+ * 4: for PLUGIN_GEN_FROM_MEM trace records, the qemu_plugin_meminfo_t
  */
 
 enum plugin_gen_from {
@@ -76,6 +78,7 @@ enum plugin_gen_cb {
     PLUGIN_GEN_CB_UDATA,
     PLUGIN_GEN_CB_INLINE,
     PLUGIN_GEN_CB_MEM,
+    PLUGIN_GEN_CB_TRACE,
     PLUGIN_GEN_ENABLE_MEM_HELPER,
     PLUGIN_GEN_DISABLE_MEM_HELPER,
     PLUGIN_GEN_N_CBS,
@@ -93,6 +96,29 @@ void HELPER(plugin_vcpu_mem_cb)(unsigned int vcpu_index,
                                 void *userdata)
 { }
 
+void HELPER(plugin_trace_flush)(uint32_t cpu_index, void *trace, uint32_t n)
+{
+    qemu_plugin_trace_make_room(trace, cpu_index, n);
+}
+
+static TCGArg tcgv_tl_arg(TCGv v)
+{
+#if TARGET_LONG_BITS == 32
+    return tcgv_i32_arg(v);
+#else
+    return tcgv_i64_arg(v);
+#endif
+}
+
+static TCGv arg_tcgv_tl(TCGArg a)
+{
+#if TARGET_LONG_BITS == 32
+    return temp_tcgv_i32(arg_temp(a));
+#else
+    return temp_tcgv_i64(arg_temp(a));
+#endif
+}
+
 static void do_gen_mem_cb(TCGv vaddr, uint32_t info)
 {
     TCGv_i32 cpu_index = tcg_temp_new_i32();
@@ -126,8 +152,8 @@ static void gen_empty_udata_cb(void)
 }
 
 /*
- * For now we only support addi_i64.
- * When we support more ops, we can generate one empty inline cb for each.
+ * The empty inline cb covers the common case of adding to a fixed address.
+ * Scoreboard entries and stores are generated directly, see gen_inline_op().
  */
 static void gen_empty_inline_cb(void)
 {
@@ -147,6 +173,10 @@ static void gen_empty_mem_cb(TCGv addr, uint32_t info)
     do_gen_mem_cb(addr, info);
 }
 
+/* trace records are generated from scratch, see gen_trace_record() */
+static void gen_empty_trace(void)
+{ }
+
 /*
  * Share the same function for enable/disable. When enabling, the NULL
  * pointer will be overwritten later.
@@ -198,6 +228,7 @@ static inline void plugin_gen_empty_callback(enum plugin_gen_from from)
     case PLUGIN_GEN_FROM_TB:
         gen_wrapped(from, PLUGIN_GEN_CB_UDATA, gen_empty_udata_cb);
         gen_wrapped(from, PLUGIN_GEN_CB_INLINE, gen_empty_inline_cb);
+        gen_wrapped(from, PLUGIN_GEN_CB_TRACE, gen_empty_trace);
         break;
     default:
         g_assert_not_reached();
@@ -227,12 +258,20 @@ static void gen_mem_wrapped(enum plugin_gen_cb type,
 void plugin_gen_empty_mem_callback(TCGv addr, uint32_t info)
 {
     union mem_gen_fn fn;
+    TCGOp *op;
 
     fn.mem_fn = gen_empty_mem_cb;
     gen_mem_wrapped(PLUGIN_GEN_CB_MEM, &fn, addr, info, true);
 
     fn.inline_fn = gen_empty_inline_cb;
     gen_mem_wrapped(PLUGIN_GEN_CB_INLINE, &fn, 0, info, false);
+
+    gen_plugin_cb_start(PLUGIN_GEN_FROM_MEM, PLUGIN_GEN_CB_TRACE,
+                        !!(info & TRACE_MEM_ST));
+    op = tcg_last_op();
+    op->args[3] = tcgv_tl_arg(addr);
+    op->args[4] = info;
+    tcg_gen_plugin_cb_end();
 }
 
 static TCGOp *find_op(TCGOp *op, TCGOpcode opc)
@@ -418,6 +457,258 @@ static TCGOp *copy_call(TCGOp **begin_op, TCGOp *op, void *empty_func,
     return op;
 }
 
+/*
+ * Move the ops that follow @last, i.e. those generated since @last was
+ * the last op, to just after @op. Returns the last op moved.
+ */
+static TCGOp *move_ops_after(TCGOp *op, TCGOp *last)
+{
+    TCGOp *next;
+
+    tcg_debug_assert(op != last);
+    while ((next = QTAILQ_NEXT(last, link)) != NULL) {
+        QTAILQ_REMOVE(&tcg_ctx->ops, next, link);
+        QTAILQ_INSERT_AFTER(&tcg_ctx->ops, op, next, link);
+        op = next;
+    }
+    return op;
+}
+
+/*
+ * Generate the ops for @cb at the end of the op stream, then move them to
+ * just after @op. Returns the last op moved.
+ */
+static TCGOp *splice_ops(TCGOp *op,
+                         void (*gen)(const struct qemu_plugin_dyn_cb *cb),
+                         const struct qemu_plugin_dyn_cb *cb)
+{
+    TCGOp *last = tcg_last_op();
+
+    gen(cb);
+    return move_ops_after(op, last);
+}
+
+/*
+ * Compute the address of the running vCPU's copy of @entry. The base of
+ * the scoreboard is loaded at run time, so that the core can grow it when
+ * new vCPUs are created without invalidating translated code.
+ */
+static TCGv_ptr gen_plugin_u64_ptr(qemu_plugin_u64 entry)
+{
+    GArray *arr = entry.score->data;
+    TCGv_ptr ptr = tcg_temp_new_ptr();
+    TCGv_ptr base = tcg_const_ptr(&arr->data);
+    TCGv_i32 cpu_index = tcg_temp_new_i32();
+
+    tcg_gen_ld_i32(cpu_index, cpu_env,
+                   -offsetof(ArchCPU, env) + offsetof(CPUState, cpu_index));
+    tcg_gen_muli_i32(cpu_index, cpu_index, g_array_get_element_size(arr));
+    tcg_gen_ext_i32_ptr(ptr, cpu_index);
+    tcg_gen_ld_ptr(base, base, 0);
+    tcg_gen_add_ptr(ptr, ptr, base);
+    tcg_gen_addi_ptr(ptr, ptr, entry.offset);
+
+    tcg_temp_free_i32(cpu_index);
+    tcg_temp_free_ptr(base);
+    return ptr;
+}
+
+static TCGv_ptr gen_inline_ptr(const struct qemu_plugin_dyn_cb *cb)
+{
+    if (cb->userp) {
+        return tcg_const_ptr(cb->userp);
+    }
+    return gen_plugin_u64_ptr(cb->inline_insn.entry);
+}
+
+static void gen_inline_op(const struct qemu_plugin_dyn_cb *cb)
+{
+    TCGv_ptr ptr = gen_inline_ptr(cb);
+    TCGv_i64 val;
+
+    switch (cb->inline_insn.op) {
+    case QEMU_PLUGIN_INLINE_ADD_U64:
+        val = tcg_temp_new_i64();
+        tcg_gen_ld_i64(val, ptr, 0);
+        tcg_gen_addi_i64(val, val, cb->inline_insn.imm);
+        break;
+    case QEMU_PLUGIN_INLINE_STORE_U64:
+        val = tcg_const_i64(cb->inline_insn.imm);
+        break;
+    default:
+        g_assert_not_reached();
+    }
+    tcg_gen_st_i64(val, ptr, 0);
+
+    tcg_temp_free_i64(val);
+    tcg_temp_free_ptr(ptr);
+}
+
+static TCGCond plugin_cond_to_tcgcond(enum qemu_plugin_cond cond)
+{
+    switch (cond) {
+    case QEMU_PLUGIN_COND_EQ:
+        return TCG_COND_EQ;
+    case QEMU_PLUGIN_COND_NE:
+        return TCG_COND_NE;
+    case QEMU_PLUGIN_COND_LT:
+        return TCG_COND_LTU;
+    case QEMU_PLUGIN_COND_LE:
+        return TCG_COND_LEU;
+    case QEMU_PLUGIN_COND_GT:
+        return TCG_COND_GTU;
+    case QEMU_PLUGIN_COND_GE:
+        return TCG_COND_GEU;
+    default:
+        /* ALWAYS and NEVER are resolved at registration time */
+        g_assert_not_reached();
+    }
+}
+
+/*
+ * Call @cb's udata callback only if its scoreboard entry satisfies the
+ * condition. The branch ends the basic block, so callers must not rely on
+ * temporaries computed before these ops.
+ */
+static void gen_cond_udata_cb(const struct qemu_plugin_dyn_cb *cb)
+{
+    TCGv_ptr ptr = gen_plugin_u64_ptr(cb->cond.entry);
+    TCGv_i64 val = tcg_temp_new_i64();
+    TCGv_i32 cpu_index;
+    TCGv_ptr udata;
+    TCGLabel *skip = gen_new_label();
+    TCGOp *op;
+    int i;
+
+    tcg_gen_ld_i64(val, ptr, 0);
+    tcg_gen_brcondi_i64(tcg_invert_cond(plugin_cond_to_tcgcond(cb->cond.cond)),
+                        val, cb->cond.imm, skip);
+    tcg_temp_free_i64(val);
+    tcg_temp_free_ptr(ptr);
+
+    cpu_index = tcg_temp_new_i32();
+    udata = tcg_const_ptr(cb->userp);
+    tcg_gen_ld_i32(cpu_index, cpu_env,
+                   -offsetof(ArchCPU, env) + offsetof(CPUState, cpu_index));
+    gen_helper_plugin_vcpu_udata_cb(cpu_index, udata);
+    tcg_temp_free_ptr(udata);
+    tcg_temp_free_i32(cpu_index);
+
+    /* point the call at the plugin's callback, as copy_call() does */
+    op = tcg_last_op();
+    tcg_debug_assert(op->opc == INDEX_op_call);
+    for (i = 0; i < MAX_OPC_PARAM_ARGS; i++) {
+        if ((uintptr_t)op->args[i] == (uintptr_t)HELPER(plugin_vcpu_udata_cb)) {
+            op->args[i] = (uintptr_t)cb->f.vcpu_udata;
+            op->args[i + 1] = cb->tcg_flags;
+            break;
+        }
+    }
+    tcg_debug_assert(i < MAX_OPC_PARAM_ARGS);
+
+    gen_set_label(skip);
+}
+
+/* Load the ring of the running vCPU */
+static TCGv_ptr gen_trace_ring(struct qemu_plugin_trace *trace)
+{
+    qemu_plugin_u64 entry = {
+        .score = trace->vcpus,
+        .offset = offsetof(struct qemu_plugin_trace_vcpu, ring),
+    };
+    TCGv_ptr ring = gen_plugin_u64_ptr(entry);
+
+    tcg_gen_ld_ptr(ring, ring, 0);
+    return ring;
+}
+
+#define TRACE_RING_OFS(field) offsetof(struct qemu_plugin_trace_ring, field)
+#define TRACE_RECORD_OFS(field)                         \
+    (offsetof(struct qemu_plugin_trace_ring, records) + \
+     offsetof(struct qemu_plugin_trace_record, field))
+
+/*
+ * Append a record to the ring of the running vCPU. There is no check
+ * for a full ring here: the TB made room for all of its records when
+ * it was entered, see gen_trace_reserve().
+ */
+static void gen_trace_record(struct qemu_plugin_trace *trace, uint64_t pc,
+                             TCGv vaddr, uint32_t info, uint32_t flags)
+{
+    TCGv_ptr ring = gen_trace_ring(trace);
+    TCGv_ptr rec = tcg_temp_new_ptr();
+    TCGv_i64 head = tcg_temp_new_i64();
+    TCGv_i64 val = tcg_temp_new_i64();
+    TCGv_i32 val32 = tcg_temp_new_i32();
+
+    tcg_gen_ld_i64(head, ring, TRACE_RING_OFS(head));
+    tcg_gen_andi_i64(val, head, trace->size - 1);
+    tcg_gen_muli_i64(val, val, sizeof(struct qemu_plugin_trace_record));
+    tcg_gen_trunc_i64_ptr(rec, val);
+    tcg_gen_add_ptr(rec, rec, ring);
+
+    tcg_gen_movi_i64(val, pc);
+    tcg_gen_st_i64(val, rec, TRACE_RECORD_OFS(pc));
+    if (flags & QEMU_PLUGIN_TRACE_MEM) {
+        tcg_gen_extu_tl_i64(val, vaddr);
+    } else {
+        tcg_gen_movi_i64(val, 0);
+    }
+    tcg_gen_st_i64(val, rec, TRACE_RECORD_OFS(vaddr));
+    tcg_gen_movi_i32(val32, info);
+    tcg_gen_st_i32(val32, rec, TRACE_RECORD_OFS(info));
+    tcg_gen_movi_i32(val32, flags);
+    tcg_gen_st_i32(val32, rec, TRACE_RECORD_OFS(flags));
+
+    /*
+     * Without a drain callback the consumer runs concurrently, so it
+     * must not see the new @head before the record itself.
+     */
+    if (!trace->cb) {
+        tcg_gen_op1(INDEX_op_mb, TCG_MO_ST_ST | TCG_BAR_SC);
+    }
+    tcg_gen_addi_i64(head, head, 1);
+    tcg_gen_st_i64(head, ring, TRACE_RING_OFS(head));
+
+    tcg_temp_free_i32(val32);
+    tcg_temp_free_i64(val);
+    tcg_temp_free_i64(head);
+    tcg_temp_free_ptr(rec);
+    tcg_temp_free_ptr(ring);
+}
+
+/* Make room for the @n records that the TB appends to @trace */
+static void gen_trace_reserve(struct qemu_plugin_trace *trace, uint32_t n)
+{
+    TCGv_ptr ring = gen_trace_ring(trace);
+    TCGv_i64 head = tcg_temp_new_i64();
+    TCGv_i64 tail = tcg_temp_new_i64();
+    TCGv_i32 cpu_index;
+    TCGv_ptr ptr;
+    TCGv_i32 count;
+    TCGLabel *skip = gen_new_label();
+
+    tcg_gen_ld_i64(head, ring, TRACE_RING_OFS(head));
+    tcg_gen_ld_i64(tail, ring, TRACE_RING_OFS(tail));
+    tcg_gen_sub_i64(head, head, tail);
+    tcg_gen_brcondi_i64(TCG_COND_LEU, head, trace->size - n, skip);
+    tcg_temp_free_i64(tail);
+    tcg_temp_free_i64(head);
+    tcg_temp_free_ptr(ring);
+
+    cpu_index = tcg_temp_new_i32();
+    ptr = tcg_const_ptr(trace);
+    count = tcg_const_i32(n);
+    tcg_gen_ld_i32(cpu_index, cpu_env,
+                   -offsetof(ArchCPU, env) + offsetof(CPUState, cpu_index));
+    gen_helper_plugin_trace_flush(cpu_index, ptr, count);
+    tcg_temp_free_i32(count);
+    tcg_temp_free_ptr(ptr);
+    tcg_temp_free_i32(cpu_index);
+
+    gen_set_label(skip);
+}
+
 /*
  * When we append/replace ops here we are sensitive to changing patterns of
  * TCGOps generated by the tcg_gen_FOO calls when we generated the
@@ -427,6 +718,12 @@ static TCGOp *copy_call(TCGOp **begin_op, TCGOp *op, void *empty_func,
 static TCGOp *append_udata_cb(const struct qemu_plugin_dyn_cb *cb,
                               TCGOp *begin_op, TCGOp *op, int *cb_idx)
 {
+    if (cb->cond.cond != QEMU_PLUGIN_COND_ALWAYS) {
+        /* the cpu_index loaded before the branch is dead after it */
+        *cb_idx = -1;
+        return splice_ops(op, gen_cond_udata_cb, cb);
+    }
+
     /* const_ptr */
     op = copy_const_ptr(&begin_op, op, cb->userp);
 
@@ -449,6 +746,10 @@ static TCGOp *append_inline_cb(const struct qemu_plugin_dyn_cb *cb,
                                TCGOp *begin_op, TCGOp *op,
                                int *unused)
 {
+    if (!cb->userp || cb->inline_insn.op != QEMU_PLUGIN_INLINE_ADD_U64) {
+        return splice_ops(op, gen_inline_op, cb);
+    }
+
     /* const_ptr */
     op = copy_const_ptr(&begin_op, op, cb->userp);
 
@@ -562,6 +863,38 @@ inject_mem_cb(const GArray *cbs, TCGOp *begin_op)
     inject_cb_type(cbs, begin_op, append_mem_cb, op_rw);
 }
 
+static void inject_trace(const GArray *cbs, TCGOp *begin_op, uint32_t flags)
+{
+    bool is_mem = flags & QEMU_PLUGIN_TRACE_MEM;
+    TCGv vaddr = is_mem ? arg_tcgv_tl(begin_op->args[3]) : NULL;
+    uint32_t info = is_mem ? begin_op->args[4] : 0;
+    TCGOp *end_op;
+    TCGOp *op;
+    int i;
+
+    if (cbs->len == 0) {
+        rm_ops(begin_op);
+        return;
+    }
+
+    end_op = find_op(begin_op, INDEX_op_plugin_cb_end);
+    tcg_debug_assert(end_op);
+
+    op = end_op;
+    for (i = 0; i < cbs->len; i++) {
+        struct qemu_plugin_dyn_cb *cb =
+            &g_array_index(cbs, struct qemu_plugin_dyn_cb, i);
+        TCGOp *last = tcg_last_op();
+
+        if (is_mem && !op_rw(begin_op, cb)) {
+            continue;
+        }
+        gen_trace_record(cb->userp, cb->trace.pc, vaddr, info, flags);
+        op = move_ops_after(op, last);
+    }
+    rm_ops_range(begin_op, end_op);
+}
+
 /* we could change the ops in place, but we can reuse more code by copying */
 static void inject_mem_helper(TCGOp *begin_op, GArray *arr)
 {
@@ -596,12 +929,13 @@ static void inject_mem_helper(TCGOp *begin_op, GArray *arr)
 static void inject_mem_enable_helper(struct qemu_plugin_insn *plugin_insn,
                                      TCGOp *begin_op)
 {
-    GArray *cbs[2];
+    GArray *cbs[3];
     GArray *arr;
     size_t n_cbs, i;
 
     cbs[0] = plugin_insn->cbs[PLUGIN_CB_MEM][PLUGIN_CB_REGULAR];
     cbs[1] = plugin_insn->cbs[PLUGIN_CB_MEM][PLUGIN_CB_INLINE];
+    cbs[2] = plugin_insn->cbs[PLUGIN_CB_MEM][PLUGIN_CB_TRACE];
 
     n_cbs = 0;
     for (i = 0; i < ARRAY_SIZE(cbs); i++) {
@@ -663,6 +997,90 @@ static void plugin_gen_tb_inline(const struct qemu_plugin_tb *ptb,
     inject_inline_cb(ptb->cbs[PLUGIN_CB_INLINE], begin_op, op_ok);
 }
 
+struct trace_count {
+    struct qemu_plugin_trace *trace;
+    uint32_t n;
+};
+
+static void trace_count_add(GArray *counts, struct qemu_plugin_trace *trace)
+{
+    struct trace_count c = { .trace = trace };
+    int i;
+
+    for (i = 0; i < counts->len; i++) {
+        struct trace_count *p = &g_array_index(counts, struct trace_count, i);
+
+        if (p->trace == trace) {
+            p->n++;
+            return;
+        }
+    }
+    c.n = 1;
+    g_array_append_val(counts, c);
+}
+
+/*
+ * Records are appended without checking for room, so on entry a TB
+ * checks that each of its traces has room for all of its records, and
+ * calls out to drain or wait for the consumer if not. Accesses done by
+ * helpers are recorded by qemu_plugin_vcpu_mem_cb() and are not counted.
+ */
+static void plugin_gen_tb_trace(const struct qemu_plugin_tb *ptb,
+                                TCGOp *begin_op)
+{
+    g_autoptr(GArray) counts = g_array_new(false, false,
+                                           sizeof(struct trace_count));
+    TCGOp *end_op;
+    TCGOp *op;
+    int insn_idx = -1;
+    int i;
+
+    QSIMPLEQ_FOREACH(op, &tcg_ctx->plugin_ops, plugin_link) {
+        enum plugin_gen_from from = op->args[0];
+        enum plugin_gen_cb type = op->args[1];
+        struct qemu_plugin_insn *insn;
+        const GArray *cbs;
+
+        if (from == PLUGIN_GEN_FROM_INSN &&
+            type == PLUGIN_GEN_ENABLE_MEM_HELPER) {
+            insn_idx++;
+        }
+        if (type != PLUGIN_GEN_CB_TRACE || from == PLUGIN_GEN_FROM_TB) {
+            continue;
+        }
+        insn = g_ptr_array_index(ptb->insns, insn_idx);
+        if (from == PLUGIN_GEN_FROM_MEM) {
+            cbs = insn->cbs[PLUGIN_CB_MEM][PLUGIN_CB_TRACE];
+        } else {
+            cbs = insn->cbs[PLUGIN_CB_INSN][PLUGIN_CB_TRACE];
+        }
+        for (i = 0; i < cbs->len; i++) {
+            struct qemu_plugin_dyn_cb *cb =
+                &g_array_index(cbs, struct qemu_plugin_dyn_cb, i);
+
+            if (from == PLUGIN_GEN_FROM_MEM && !op_rw(op, cb)) {
+                continue;
+            }
+            trace_count_add(counts, cb->userp);
+        }
+    }
+
+    end_op = find_op(begin_op, INDEX_op_plugin_cb_end);
+    tcg_debug_assert(end_op);
+
+    op = end_op;
+    for (i = 0; i < counts->len; i++) {
+        struct trace_count *c = &g_array_index(counts, struct trace_count, i);
+        TCGOp *last = tcg_last_op();
+
+        /* plugin_trace_write() keeps the other half of the ring free */
+        g_assert(c->n <= c->trace->size / 2);
+        gen_trace_reserve(c->trace, c->n);
+        op = move_ops_after(op, last);
+    }
+    rm_ops_range(begin_op, end_op);
+}
+
 static void plugin_gen_insn_udata(const struct qemu_plugin_tb *ptb,
                                   TCGOp *begin_op, int insn_idx)
 {
@@ -679,6 +1097,15 @@ static void plugin_gen_insn_inline(const struct qemu_plugin_tb *ptb,
                      begin_op, op_ok);
 }
 
+static void plugin_gen_insn_trace(const struct qemu_plugin_tb *ptb,
+                                  TCGOp *begin_op, int insn_idx)
+{
+    struct qemu_plugin_insn *insn = g_ptr_array_index(ptb->insns, insn_idx);
+
+    inject_trace(insn->cbs[PLUGIN_CB_INSN][PLUGIN_CB_TRACE], begin_op,
+                 QEMU_PLUGIN_TRACE_INSN);
+}
+
 static void plugin_gen_mem_regular(const struct qemu_plugin_tb *ptb,
                                    TCGOp *begin_op, int insn_idx)
 {
@@ -696,6 +1123,15 @@ static void plugin_gen_mem_inline(const struct qemu_plugin_tb *ptb,
     inject_inline_cb(cbs, begin_op, op_rw);
 }
 
+static void plugin_gen_mem_trace(const struct qemu_plugin_tb *ptb,
+                                 TCGOp *begin_op, int insn_idx)
+{
+    struct qemu_plugin_insn *insn = g_ptr_array_index(ptb->insns, insn_idx);
+
+    inject_trace(insn->cbs[PLUGIN_CB_MEM][PLUGIN_CB_TRACE], begin_op,
+                 QEMU_PLUGIN_TRACE_MEM);
+}
+
 static void plugin_gen_enable_mem_helper(const struct qemu_plugin_tb *ptb,
                                          TCGOp *begin_op, int insn_idx)
 {
@@ -725,6 +1161,9 @@ static void plugin_inject_cb(const struct qemu_plugin_tb *ptb, TCGOp *begin_op,
         case PLUGIN_GEN_CB_INLINE:
             plugin_gen_tb_inline(ptb, begin_op);
             return;
+        case PLUGIN_GEN_CB_TRACE:
+            plugin_gen_tb_trace(ptb, begin_op);
+            return;
         default:
             g_assert_not_reached();
         }
@@ -736,6 +1175,9 @@ static void plugin_inject_cb(const struct qemu_plugin_tb *ptb, TCGOp *begin_op,
         case PLUGIN_GEN_CB_INLINE:
             plugin_gen_insn_inline(ptb, begin_op, insn_idx);
             return;
+        case PLUGIN_GEN_CB_TRACE:
+            plugin_gen_insn_trace(ptb, begin_op, insn_idx);
+            return;
         case PLUGIN_GEN_ENABLE_MEM_HELPER:
             plugin_gen_enable_mem_helper(ptb, begin_op, insn_idx);
             return;
@@ -750,6 +1192,9 @@ static void plugin_inject_cb(const struct qemu_plugin_tb *ptb, TCGOp *begin_op,
         case PLUGIN_GEN_CB_INLINE:
             plugin_gen_mem_inline(ptb, begin_op, insn_idx);
             return;
+        case PLUGIN_GEN_CB_TRACE:
+            plugin_gen_mem_trace(ptb, begin_op, insn_idx);
+            return;
         default:
             g_assert_not_reached();
         }
@@ -804,6 +1249,9 @@ static void pr_ops(void)
             case PLUGIN_GEN_CB_MEM:
                 type = "mem";
                 break;
+            case PLUGIN_GEN_CB_TRACE:
+                type = "trace";
+                break;
             case PLUGIN_GEN_ENABLE_MEM_HELPER:
                 type = "enable mem helper";
                 break;
@@ -2,4 +2,5 @@
 /* Note: no TCG flags because those are overwritten later */
 DEF_HELPER_2(plugin_vcpu_udata_cb, void, i32, ptr)
 DEF_HELPER_4(plugin_vcpu_mem_cb, void, i32, i32, i64, ptr)
+DEF_HELPER_FLAGS_3(plugin_trace_flush, TCG_CALL_NO_RWG, void, i32, ptr, i32)
 #endif
@@ -0,0 +1,237 @@
+/*
+ * Translation block statistics
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/qht.h"
+#include "qemu/xxhash.h"
+#include "qapi/error.h"
+#include "cpu.h"
+#include "exec/exec-all.h"
+#include "exec/tb-stats.h"
+#include "sysemu/tcg.h"
+#ifndef CONFIG_USER_ONLY
+#include "qapi/qapi-commands-machine.h"
+#endif
+
+#define TB_STATS_HTABLE_SIZE     (1 << 12)
+
+bool tb_stats_enabled;
+
+static struct qht tb_stats_htable;
+static QemuMutex tb_stats_lock;
+static bool tb_stats_initialized;
+
+static bool tb_stats_cmp(const void *ap, const void *bp)
+{
+    const TBStatistics *a = ap;
+    const TBStatistics *b = bp;
+
+    return a->phys_pc == b->phys_pc &&
+           a->pc == b->pc &&
+           a->cs_base == b->cs_base &&
+           a->flags == b->flags;
+}
+
+static uint32_t tb_stats_hash(uint64_t phys_pc, uint64_t pc, uint64_t cs_base,
+                              uint32_t flags)
+{
+    return qemu_xxhash6(phys_pc, pc, flags, (uint32_t)cs_base);
+}
+
+static void __attribute__((constructor)) tb_stats_init(void)
+{
+    qemu_mutex_init(&tb_stats_lock);
+}
+
+TBStatistics *tb_stats_get(uint64_t phys_pc, uint64_t pc, uint64_t cs_base,
+                           uint32_t flags)
+{
+    TBStatistics key = {
+        .phys_pc = phys_pc,
+        .pc = pc,
+        .cs_base = cs_base,
+        .flags = flags,
+    };
+    uint32_t hash = tb_stats_hash(phys_pc, pc, cs_base, flags);
+    TBStatistics *s;
+    void *existing = NULL;
+
+    s = qht_lookup(&tb_stats_htable, &key, hash);
+    if (s) {
+        return s;
+    }
+
+    s = g_new0(TBStatistics, 1);
+    *s = key;
+    if (!qht_insert(&tb_stats_htable, s, hash, &existing)) {
+        /* another vCPU translated the same block at the same time */
+        g_free(s);
+        s = existing;
+    }
+    return s;
+}
+
+void tb_stats_record_translation(TBStatistics *s, uint32_t guest_insns,
+                                 uint32_t guest_bytes, uint32_t tcg_ops,
+                                 uint32_t host_bytes, uint32_t spills)
+{
+    QEMU_LOCK_GUARD(&tb_stats_lock);
+    s->translations++;
+    s->guest_insns = guest_insns;
+    s->guest_bytes = guest_bytes;
+    s->tcg_ops = tcg_ops;
+    s->host_bytes = host_bytes;
+    s->spills = spills;
+}
+
+void tb_stats_record_invalidation(TBStatistics *s)
+{
+    QEMU_LOCK_GUARD(&tb_stats_lock);
+    s->invalidations++;
+}
+
+static void tb_stats_reset_iter(void *p, uint32_t hash, void *userp)
+{
+    TBStatistics *s = p;
+
+    s->executions = 0;
+    s->exits = 0;
+    s->translations = 0;
+    s->invalidations = 0;
+}
+
+void tb_stats_control(TBStatsAction action)
+{
+    QEMU_LOCK_GUARD(&tb_stats_lock);
+
+    switch (action) {
+    case TB_STATS_ACTION_START:
+        if (!tb_stats_initialized) {
+            qht_init(&tb_stats_htable, tb_stats_cmp, TB_STATS_HTABLE_SIZE,
+                     QHT_MODE_AUTO_RESIZE);
+            tb_stats_initialized = true;
+        }
+        if (!tb_stats_enabled) {
+            /* pairs with the load-acquire in tb_gen_code() */
+            qatomic_store_release(&tb_stats_enabled, true);
+            tb_flush(first_cpu);
+        }
+        break;
+    case TB_STATS_ACTION_STOP:
+        if (tb_stats_enabled) {
+            qatomic_set(&tb_stats_enabled, false);
+            tb_flush(first_cpu);
+        }
+        break;
+    case TB_STATS_ACTION_RESET:
+        if (tb_stats_initialized) {
+            qht_iter(&tb_stats_htable, tb_stats_reset_iter, NULL);
+        }
+        break;
+    default:
+        g_assert_not_reached();
+    }
+}
+
+static uint64_t tb_stats_sort_value(const TBStatistics *s,
+                                    TBStatsSortKey sort_by)
+{
+    switch (sort_by) {
+    case TB_STATS_SORT_KEY_EXECUTIONS:
+        return s->executions;
+    case TB_STATS_SORT_KEY_EXITS:
+        return s->exits;
+    case TB_STATS_SORT_KEY_SPILLS:
+        return s->spills;
+    case TB_STATS_SORT_KEY_TRANSLATIONS:
+        return s->translations;
+    default:
+        g_assert_not_reached();
+    }
+}
+
+static gint tb_stats_compare(gconstpointer ap, gconstpointer bp,
+                             gpointer user_data)
+{
+    TBStatsSortKey sort_by = GPOINTER_TO_INT(user_data);
+    uint64_t a = tb_stats_sort_value(*(TBStatistics **)ap, sort_by);
+    uint64_t b = tb_stats_sort_value(*(TBStatistics **)bp, sort_by);
+
+    /* highest first */
+    return a < b ? 1 : a > b ? -1 : 0;
+}
+
+static void tb_stats_collect_iter(void *p, uint32_t hash, void *userp)
+{
+    g_ptr_array_add(userp, p);
+}
+
+TBStatsInfoList *tb_stats_query(int count, TBStatsSortKey sort_by)
+{
+    g_autoptr(GPtrArray) all = g_ptr_array_new();
+    TBStatsInfoList *head = NULL, **tail = &head;
+    int i;
+
+    QEMU_LOCK_GUARD(&tb_stats_lock);
+    if (!tb_stats_initialized) {
+        return NULL;
+    }
+
+    qht_iter(&tb_stats_htable, tb_stats_collect_iter, all);
+    g_ptr_array_sort_with_data(all, tb_stats_compare,
+                               GINT_TO_POINTER(sort_by));
+
+    for (i = 0; i < all->len && i < count; i++) {
+        TBStatistics *s = g_ptr_array_index(all, i);
+        TBStatsInfo *info = g_new0(TBStatsInfo, 1);
+
+        info->pc = s->pc;
+        info->phys_pc = s->phys_pc;
+        info->cs_base = s->cs_base;
+        info->flags = s->flags;
+        info->executions = s->executions;
+        info->exits = s->exits;
+        info->translations = s->translations;
+        info->invalidations = s->invalidations;
+        info->guest_insns = s->guest_insns;
+        info->guest_bytes = s->guest_bytes;
+        info->tcg_ops = s->tcg_ops;
+        info->host_bytes = s->host_bytes;
+        info->spills = s->spills;
+        QAPI_LIST_APPEND(tail, info);
+    }
+    return head;
+}
+
+#ifndef CONFIG_USER_ONLY
+void qmp_x_tb_stats(TBStatsAction action, Error **errp)
+{
+    if (!tcg_enabled()) {
+        error_setg(errp, "TB statistics are only available with accel=tcg");
+        return;
+    }
+    tb_stats_control(action);
+}
+
+TBStatsInfoList *qmp_x_query_tb_stats(bool has_count, int64_t count,
+                                      bool has_sort_by,
+                                      TBStatsSortKey sort_by, Error **errp)
+{
+    if (!tcg_enabled()) {
+        error_setg(errp, "TB statistics are only available with accel=tcg");
+        return NULL;
+    }
+    if (!has_count) {
+        count = 10;
+    } else if (count < 1) {
+        error_setg(errp, "Parameter 'count' must be positive");
+        return NULL;
+    }
+    return tb_stats_query(MIN(count, INT_MAX),
+                          has_sort_by ? sort_by : TB_STATS_SORT_KEY_EXECUTIONS);
+}
+#endif
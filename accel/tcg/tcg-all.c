@@ -27,16 +27,19 @@
 #include "qemu-common.h"
 #include "sysemu/tcg.h"
 #include "sysemu/cpu-timers.h"
+#include "sysemu/replay.h"
 #include "tcg/tcg.h"
 #include "qapi/error.h"
 #include "qemu/error-report.h"
 #include "qemu/accel.h"
 #include "qapi/qapi-builtin-visit.h"
+#include "internal.h"
 
 struct TCGState {
     AccelState parent_obj;
 
     bool mttcg_enabled;
+    bool tiered_enabled;
     int splitwx_enabled;
     unsigned long tb_size;
 };
@@ -111,6 +114,7 @@ static int tcg_init(MachineState *ms)
 
     tcg_exec_init(s->tb_size * 1024 * 1024, s->splitwx_enabled);
     mttcg_enabled = s->mttcg_enabled;
+    tcg_tiered = s->tiered_enabled;
 
     /*
      * Initialize TCG regions only for softmmu.
@@ -134,11 +138,17 @@ static char *tcg_get_thread(Object *obj, Error **errp)
 
 static void tcg_set_thread(Object *obj, const char *value, Error **errp)
 {
+    ERRP_GUARD();
     TCGState *s = TCG_STATE(obj);
 
     if (strcmp(value, "multi") == 0) {
         if (TCG_OVERSIZED_GUEST) {
             error_setg(errp, "No MTTCG when guest word size > hosts");
+        } else if (replay_mode != REPLAY_MODE_NONE) {
+            error_setg(errp, "No MTTCG with record/replay");
+            error_append_hint(errp, "The replay log orders the execution of "
+                              "all vCPUs by a single instruction counter; "
+                              "SMP guests are replayed with thread=single.\n");
         } else if (icount_enabled()) {
             error_setg(errp, "No MTTCG when icount is enabled");
         } else {
@@ -196,6 +206,18 @@ static void tcg_set_splitwx(Object *obj, bool value, Error **errp)
     s->splitwx_enabled = value;
 }
 
+static bool tcg_get_tiered(Object *obj, Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    return s->tiered_enabled;
+}
+
+static void tcg_set_tiered(Object *obj, bool value, Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    s->tiered_enabled = value;
+}
+
 static void tcg_accel_class_init(ObjectClass *oc, void *data)
 {
     AccelClass *ac = ACCEL_CLASS(oc);
@@ -217,6 +239,11 @@ static void tcg_accel_class_init(ObjectClass *oc, void *data)
         tcg_get_splitwx, tcg_set_splitwx);
     object_class_property_set_description(oc, "split-wx",
         "Map jit pages into separate RW and RX regions");
+
+    object_class_property_add_bool(oc, "tiered",
+        tcg_get_tiered, tcg_set_tiered);
+    object_class_property_set_description(oc, "tiered",
+        "Only optimize translation blocks once they are hot");
 }
 
 static const TypeInfo tcg_accel_type = {
@@ -155,7 +155,8 @@ const void *HELPER(lookup_tb_ptr)(CPUArchState *env)
     cpu_get_tb_cpu_state(env, &pc, &cs_base, &flags);
 
     tb = tb_lookup(cpu, pc, cs_base, flags, curr_cflags(cpu));
-    if (tb == NULL) {
+    /* Quick TBs are entered from cpu_exec so that they get counted */
+    if (tb == NULL || qatomic_read(&tb->hot_countdown) > 0) {
         return tcg_code_gen_epilogue;
     }
     qemu_log_mask_and_addr(CPU_LOG_EXEC, pc,
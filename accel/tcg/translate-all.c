@@ -45,11 +45,13 @@
 #endif
 #else
 #include "exec/ram_addr.h"
+#include "monitor/stats.h"
 #endif
 
 #include "exec/cputlb.h"
 #include "exec/tb-hash.h"
 #include "exec/translate-all.h"
+#include "exec/tb-stats.h"
 #include "qemu/bitmap.h"
 #include "qemu/error-report.h"
 #include "qemu/qemu-print.h"
@@ -225,6 +227,9 @@ TCGContext tcg_init_ctx;
 __thread TCGContext *tcg_ctx;
 TBContext tb_ctx;
 
+/* Translate without the optimizer first, see TB_HOT_THRESHOLD */
+bool tcg_tiered;
+
 static void page_table_config_init(void)
 {
     uint32_t v_l1_bits;
@@ -557,6 +562,71 @@ static inline PageDesc *page_find(tb_page_addr_t index)
     return page_find_alloc(index, 0);
 }
 
+#ifdef CONFIG_USER_ONLY
+/*
+ * Flat bitmaps of the guest pages that can be read and written without
+ * further ado, so that page_check_range(), which validates every syscall
+ * buffer, tests a word of pages at a time rather than walking the page
+ * table for each page.  They cover all of a 32-bit guest, or the
+ * reserved_va area of a larger one; pages beyond take the slow path.
+ * Updated atomically, as disjoint ranges may share a word.
+ */
+static unsigned long *page_readable_map;
+static unsigned long *page_writable_map;
+static target_ulong page_map_pages;
+
+/* Don't spend more than 2 * 4 MiB on the bitmaps */
+#define PAGE_MAP_MAX_PAGES  (32 * MiB)
+
+/*
+ * Called on each page_set_flags().  reserved_va is only known once the
+ * command line has been parsed, and the first mapping is made before
+ * there are any other threads.
+ */
+static void page_map_init(void)
+{
+    static bool done;
+
+    if (likely(done)) {
+        return;
+    }
+    done = true;
+
+    if (TARGET_ABI_BITS <= 32) {
+        page_map_pages = (target_ulong)1 << (TARGET_ABI_BITS -
+                                             TARGET_PAGE_BITS);
+    } else {
+        page_map_pages = reserved_va >> TARGET_PAGE_BITS;
+    }
+    if (page_map_pages > PAGE_MAP_MAX_PAGES) {
+        page_map_pages = 0;
+    }
+    if (page_map_pages) {
+        page_readable_map = bitmap_new(page_map_pages);
+        page_writable_map = bitmap_new(page_map_pages);
+    }
+}
+
+static void page_map_update(target_ulong addr, int flags)
+{
+    target_ulong index = addr >> TARGET_PAGE_BITS;
+
+    if (index >= page_map_pages) {
+        return;
+    }
+    if ((flags & (PAGE_VALID | PAGE_READ)) == (PAGE_VALID | PAGE_READ)) {
+        set_bit_atomic(index, page_readable_map);
+    } else {
+        clear_bit_atomic(index, page_readable_map);
+    }
+    if ((flags & (PAGE_VALID | PAGE_WRITE)) == (PAGE_VALID | PAGE_WRITE)) {
+        set_bit_atomic(index, page_writable_map);
+    } else {
+        clear_bit_atomic(index, page_writable_map);
+    }
+}
+#endif
+
 static void page_lock_pair(PageDesc **ret_p1, tb_page_addr_t phys1,
                            PageDesc **ret_p2, tb_page_addr_t phys2, int alloc);
 
@@ -1323,6 +1393,49 @@ static void tb_htable_init(void)
     qht_init(&tb_ctx.htable, tb_cmp, CODE_GEN_HTABLE_SIZE, mode);
 }
 
+#ifndef CONFIG_USER_ONLY
+static void tcg_stats_cb(StatsResultList **result, strList *names,
+                         Error **errp)
+{
+    size_t flush_full, flush_part, flush_elide;
+    StatsList *stats = NULL;
+
+    tlb_flush_counts(&flush_full, &flush_part, &flush_elide);
+    stats_add(&stats, names, "tlb-flushes-elided", flush_elide);
+    stats_add(&stats, names, "tlb-flushes-partial", flush_part);
+    stats_add(&stats, names, "tlb-flushes-full", flush_full);
+    stats_add(&stats, names, "tb-invalidations",
+              tcg_tb_phys_invalidate_count());
+    stats_add(&stats, names, "tb-evictions",
+              qatomic_read(&tb_ctx.tb_evict_count));
+    stats_add(&stats, names, "tb-flushes",
+              qatomic_read(&tb_ctx.tb_flush_count));
+    stats_add(&stats, names, "code-size", tcg_code_size());
+    stats_add(&stats, names, "tb-count", tcg_nb_tbs());
+    stats_result_add(result, STATS_PROVIDER_TCG, NULL, stats);
+}
+
+static void tcg_stats_schemas_cb(StatsSchemaValueList **result)
+{
+    stats_schema_add(result, "tlb-flushes-elided", STATS_TYPE_CUMULATIVE,
+                     STATS_UNIT__MAX);
+    stats_schema_add(result, "tlb-flushes-partial", STATS_TYPE_CUMULATIVE,
+                     STATS_UNIT__MAX);
+    stats_schema_add(result, "tlb-flushes-full", STATS_TYPE_CUMULATIVE,
+                     STATS_UNIT__MAX);
+    stats_schema_add(result, "tb-invalidations", STATS_TYPE_CUMULATIVE,
+                     STATS_UNIT__MAX);
+    stats_schema_add(result, "tb-evictions", STATS_TYPE_CUMULATIVE,
+                     STATS_UNIT__MAX);
+    stats_schema_add(result, "tb-flushes", STATS_TYPE_CUMULATIVE,
+                     STATS_UNIT__MAX);
+    stats_schema_add(result, "code-size", STATS_TYPE_INSTANT,
+                     STATS_UNIT_BYTES);
+    stats_schema_add(result, "tb-count", STATS_TYPE_INSTANT,
+                     STATS_UNIT__MAX);
+}
+#endif
+
 /* Must be called before using the QEMU cpus. 'tb_size' is the size
    (in bytes) allocated to the translation buffer. Zero means default
    size. */
@@ -1344,6 +1457,11 @@ void tcg_exec_init(unsigned long tb_size, int splitwx)
        initialize the prologue now.  */
     tcg_prologue_init(tcg_ctx);
 #endif
+
+#ifndef CONFIG_USER_ONLY
+    add_stats_callbacks(STATS_PROVIDER_TCG, tcg_stats_cb,
+                        tcg_stats_schemas_cb);
+#endif
 }
 
 /* call with @p->lock held */
@@ -1457,6 +1575,47 @@ void tb_flush(CPUState *cpu)
     }
 }
 
+static void tb_evict_invalidate(TranslationBlock *tb)
+{
+    tb_phys_invalidate(tb, -1);
+}
+
+/*
+ * Reclaim the oldest code regions instead of flushing the whole cache.
+ * This still runs as safe work, since vCPUs may be executing in the
+ * regions being recycled, but it keeps the hot part of the cache alive.
+ */
+static void do_tb_evict(CPUState *cpu, run_on_cpu_data tb_evict_count)
+{
+    size_t avail = 1;
+
+    mmap_lock();
+    /* If it is already been done on request of another CPU, just retry. */
+    if (tb_ctx.tb_evict_count == tb_evict_count.host_int) {
+        avail = tcg_region_evict(tb_evict_invalidate);
+        qatomic_mb_set(&tb_ctx.tb_evict_count, tb_ctx.tb_evict_count + 1);
+    }
+    mmap_unlock();
+
+    if (!avail) {
+        do_tb_flush(cpu, RUN_ON_CPU_HOST_INT(
+                        qatomic_mb_read(&tb_ctx.tb_flush_count)));
+    }
+}
+
+/* Make room in a full code_gen_buffer, falling back to tb_flush. */
+static void tb_evict(CPUState *cpu)
+{
+    unsigned tb_evict_count = qatomic_mb_read(&tb_ctx.tb_evict_count);
+
+    if (cpu_in_exclusive_context(cpu)) {
+        do_tb_evict(cpu, RUN_ON_CPU_HOST_INT(tb_evict_count));
+    } else {
+        async_safe_run_on_cpu(cpu, do_tb_evict,
+                              RUN_ON_CPU_HOST_INT(tb_evict_count));
+    }
+}
+
 /*
  * Formerly ifdef DEBUG_TB_CHECK. These debug functions are user-mode-only,
  * so in order to prevent bit rot we compile them unconditionally in user-mode,
@@ -1632,6 +1791,10 @@ static void do_tb_phys_invalidate(TranslationBlock *tb, bool rm_from_page_list)
         return;
     }
 
+    if (tb->tb_stats) {
+        tb_stats_record_invalidation(tb->tb_stats);
+    }
+
     /* remove the TB from the page list */
     if (rm_from_page_list) {
         p = page_find(tb->page_addr[0] >> TARGET_PAGE_BITS);
@@ -1755,6 +1918,7 @@ static inline void tb_page_add(PageDesc *p, TranslationBlock *tb,
             }
             prot |= p2->flags;
             p2->flags &= ~PAGE_WRITE;
+            page_map_update(addr, p2->flags);
           }
         mprotect(g2h_untagged(page_addr), qemu_host_page_size,
                  (prot & PAGE_BITS) & ~PAGE_WRITE);
@@ -1840,17 +2004,88 @@ tb_link_page(TranslationBlock *tb, tb_page_addr_t phys_pc,
     return tb;
 }
 
+#ifndef CONFIG_USER_ONLY
+/*
+ * When several vCPUs miss on the same block at the same time, which is
+ * what happens while an SMP guest boots, each of them would translate it
+ * and all but one would throw their work away in tb_link_page(). Instead,
+ * the first vCPU claims the block's hash in tb_gen_slots and the others
+ * wait for the result to show up in the hash table.
+ *
+ * The slots are a small direct-mapped table of hints: a collision just
+ * means that both vCPUs translate, and the wait is bounded so that a
+ * translation that is abandoned (e.g. on a fault while fetching code)
+ * cannot hold the others up for long. User-mode emulation serializes
+ * translation under mmap_lock and has no use for this.
+ */
+#define TB_GEN_SLOTS      256
+#define TB_GEN_WAIT_SPINS (1 << 16)
+
+static uint32_t tb_gen_slots[TB_GEN_SLOTS];
+static __thread uint32_t *tb_gen_claimed;
+
+static void tb_gen_release(void)
+{
+    if (tb_gen_claimed) {
+        qatomic_store_release(tb_gen_claimed, 0);
+        tb_gen_claimed = NULL;
+    }
+}
+
+/*
+ * Return the TB for the block if another vCPU has just translated it, or
+ * NULL if the caller should translate it.
+ */
+static TranslationBlock *tb_gen_claim(CPUState *cpu, tb_page_addr_t phys_pc,
+                                      target_ulong pc, target_ulong cs_base,
+                                      uint32_t flags, uint32_t cflags)
+{
+    /* 0 marks a free slot */
+    uint32_t h = tb_hash_func(phys_pc, pc, flags, cflags,
+                              *cpu->trace_dstate) | 1;
+    uint32_t *slot = &tb_gen_slots[h % TB_GEN_SLOTS];
+    uint32_t old;
+    int spins;
+
+    /* drop a claim left behind by a longjmp out of the translator */
+    tb_gen_release();
+
+    old = qatomic_cmpxchg(slot, 0, h);
+    if (old == 0) {
+        tb_gen_claimed = slot;
+        return NULL;
+    }
+    if (old != h) {
+        return NULL;
+    }
+
+    for (spins = 0; spins < TB_GEN_WAIT_SPINS; spins++) {
+        if (qatomic_load_acquire(slot) != h) {
+            TranslationBlock *tb;
+
+            tb = tb_htable_lookup(cpu, pc, cs_base, flags, cflags);
+            if (tb) {
+                qatomic_inc(&tb_ctx.tb_gen_shared_count);
+            }
+            return tb;
+        }
+        cpu_relax();
+    }
+    return NULL;
+}
+#endif
+
 /* Called with mmap_lock held for user mode emulation.  */
-TranslationBlock *tb_gen_code(CPUState *cpu,
-                              target_ulong pc, target_ulong cs_base,
-                              uint32_t flags, int cflags)
+static TranslationBlock *do_tb_gen_code(CPUState *cpu,
+                                        target_ulong pc, target_ulong cs_base,
+                                        uint32_t flags, int cflags, bool quick)
 {
     CPUArchState *env = cpu->env_ptr;
     TranslationBlock *tb, *existing_tb;
     tb_page_addr_t phys_pc, phys_page2;
     target_ulong virt_page2;
     tcg_insn_unit *gen_code_buf;
-    int gen_code_size, search_size, max_insns;
+    int gen_code_size, search_size, max_insns, tcg_ops;
 #ifdef CONFIG_PROFILER
     TCGProfile *prof = &tcg_ctx->prof;
     int64_t ti;
@@ -1866,6 +2101,15 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
         cflags = (cflags & ~CF_COUNT_MASK) | CF_LAST_IO | 1;
     }
 
+    /*
+     * One-shot TBs (single step, I/O recompilation, uncached code) are
+     * thrown away soon after they are run; there is nothing to gain from
+     * counting their executions.
+     */
+    if (cflags & (CF_COUNT_MASK | CF_LAST_IO | CF_MEMI_ONLY)) {
+        quick = false;
+    }
+
     max_insns = cflags & CF_COUNT_MASK;
     if (max_insns == 0) {
         max_insns = CF_COUNT_MASK;
@@ -1877,11 +2121,23 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
         max_insns = 1;
     }
 
+#ifndef CONFIG_USER_ONLY
+    if (phys_pc != -1) {
+        existing_tb = tb_gen_claim(cpu, phys_pc, pc, cs_base, flags, cflags);
+        if (existing_tb) {
+            return existing_tb;
+        }
+    }
+#endif
+
  buffer_overflow:
     tb = tcg_tb_alloc(tcg_ctx);
     if (unlikely(!tb)) {
-        /* flush must be done */
-        tb_flush(cpu);
+        /* some old code must be evicted */
+#ifndef CONFIG_USER_ONLY
+        tb_gen_release();
+#endif
+        tb_evict(cpu);
         mmap_unlock();
         /* Make the execution loop process the flush as soon as possible.  */
         cpu->exception_index = EXCP_INTERRUPT;
@@ -1895,6 +2151,12 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
     tb->flags = flags;
     tb->cflags = cflags;
     tb->trace_vcpu_dstate = *cpu->trace_dstate;
+    tb->hot_countdown = quick ? TB_HOT_THRESHOLD : 0;
+    tb->tb_stats = NULL;
+    /* pairs with the store-release in tb_stats_control() */
+    if (phys_pc != -1 && qatomic_load_acquire(&tb_stats_enabled)) {
+        tb->tb_stats = tb_stats_get(phys_pc, pc, cs_base, flags);
+    }
     tcg_ctx->tb_cflags = cflags;
  tb_overflow:
 
@@ -1915,6 +2177,7 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
     gen_intermediate_code(cpu, tb, max_insns);
     tcg_ctx->cpu = NULL;
     max_insns = tb->icount;
+    tcg_ops = tcg_ctx->nb_ops;
 
     trace_translate_block(tb, tb->pc, tb->tc.ptr);
 
@@ -1984,6 +2247,12 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
     }
     tb->tc.size = gen_code_size;
 
+    if (tb->tb_stats) {
+        tb_stats_record_translation(tb->tb_stats, tb->icount, tb->size,
+                                    tcg_ops, gen_code_size,
+                                    tcg_ctx->nb_spills);
+    }
+
 #ifdef CONFIG_PROFILER
     qatomic_set(&prof->code_time, prof->code_time + profile_getclock() - ti);
     qatomic_set(&prof->code_in_len, prof->code_in_len + tb->size);
@@ -2095,6 +2364,9 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
      * TB visible in a consistent state.
      */
     existing_tb = tb_link_page(tb, phys_pc, phys_page2);
+#ifndef CONFIG_USER_ONLY
+    tb_gen_release();
+#endif
     /* if the TB already exists, discard what we just translated */
     if (unlikely(existing_tb != tb)) {
         uintptr_t orig_aligned = (uintptr_t)gen_code_buf;
@@ -2108,6 +2380,29 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
     return tb;
 }
 
+TranslationBlock *tb_gen_code(CPUState *cpu,
+                              target_ulong pc, target_ulong cs_base,
+                              uint32_t flags, int cflags)
+{
+    return do_tb_gen_code(cpu, pc, cs_base, flags, cflags, tcg_tiered);
+}
+
+/*
+ * Replace @tb, a quickly translated TB that has become hot, with a
+ * translation that goes through the full optimizer.
+ *
+ * Called with mmap_lock held for user-mode emulation.
+ */
+TranslationBlock *tb_gen_code_hot(CPUState *cpu, TranslationBlock *tb,
+                                  uint32_t cflags)
+{
+    assert_memory_lock();
+
+    qemu_thread_jit_write();
+    tb_phys_invalidate(tb, -1);
+    return do_tb_gen_code(cpu, tb->pc, tb->cs_base, tb->flags, cflags, false);
+}
+
 /*
  * @p must be non-NULL.
  * user-mode: call with mmap_lock held.
@@ -2260,6 +2555,37 @@ void tb_invalidate_phys_range(target_ulong start, target_ulong end)
 }
 
 #ifdef CONFIG_SOFTMMU
+/*
+ * Return false if a write of @len bytes at @start is known not to touch
+ * any translated code, so that the caller can skip page_collection_lock()
+ * and tb_invalidate_phys_page_fast() altogether.  Only the lock of the
+ * written page is taken, which keeps stores to data that shares a page
+ * with code from serializing against every page of the TBs on it.
+ *
+ * len must be <= 8 and start must be a multiple of len.
+ */
+bool tb_invalidate_phys_page_needed(tb_page_addr_t start, int len)
+{
+    PageDesc *p;
+    bool ret = true;
+
+    p = page_find(start >> TARGET_PAGE_BITS);
+    if (!p) {
+        return false;
+    }
+
+    page_lock(p);
+    if (p->code_bitmap) {
+        unsigned int nr = start & ~TARGET_PAGE_MASK;
+        unsigned long b;
+
+        b = p->code_bitmap[BIT_WORD(nr)] >> (nr & (BITS_PER_LONG - 1));
+        ret = b & ((1 << len) - 1);
+    }
+    page_unlock(p);
+    return ret;
+}
+
 /* len must be <= 8 and start must be a multiple of len.
  * Called via softmmu_template.h when code areas are written to with
  * iothread mutex not held.
@@ -2480,6 +2806,7 @@ static void print_qht_statistics(struct qht_stats hst)
     qemu_printf("TB hash avg chain   %0.3f buckets. Histogram: %s\n",
                 qdist_avg(&hst.chain), hgram);
     g_free(hgram);
+    qemu_printf("TB hash resizes     %zu\n", hst.resizes);
 }
 
 struct tb_tree_stats {
@@ -2520,6 +2847,8 @@ void dump_exec_info(void)
     struct tb_tree_stats tst = {};
     struct qht_stats hst;
     size_t nb_tbs, flush_full, flush_part, flush_elide;
+    size_t victim_hits, fills;
+    int mmu_idx;
 
     tcg_tb_foreach(tb_tree_stats_iter, &tst);
     nb_tbs = tst.nb_tbs;
@@ -2554,6 +2883,10 @@ void dump_exec_info(void)
     qemu_printf("\nStatistics:\n");
     qemu_printf("TB flush count      %u\n",
                 qatomic_read(&tb_ctx.tb_flush_count));
+    qemu_printf("TB evict count      %u\n",
+                qatomic_read(&tb_ctx.tb_evict_count));
+    qemu_printf("TB shared count     %u\n",
+                qatomic_read(&tb_ctx.tb_gen_shared_count));
     qemu_printf("TB invalidate count %zu\n",
                 tcg_tb_phys_invalidate_count());
 
@@ -2561,6 +2894,13 @@ void dump_exec_info(void)
     qemu_printf("TLB full flushes    %zu\n", flush_full);
     qemu_printf("TLB partial flushes %zu\n", flush_part);
     qemu_printf("TLB elided flushes  %zu\n", flush_elide);
+    for (mmu_idx = 0; mmu_idx < NB_MMU_MODES; mmu_idx++) {
+        tlb_mmu_counts(mmu_idx, &victim_hits, &fills);
+        if (victim_hits || fills) {
+            qemu_printf("TLB mmu_idx %-2d      victim hits %zu, fills %zu\n",
+                        mmu_idx, victim_hits, fills);
+        }
+    }
     tcg_dump_info();
 }
 
@@ -2727,6 +3067,8 @@ void page_set_flags(target_ulong start, target_ulong end, int flags)
     reset_target_data = !(flags & PAGE_VALID) || (flags & PAGE_RESET);
     flags &= ~PAGE_RESET;
 
+    page_map_init();
+
     for (addr = start, len = end - start;
          len != 0;
          len -= TARGET_PAGE_SIZE, addr += TARGET_PAGE_SIZE) {
@@ -2747,7 +3089,34 @@ void page_set_flags(target_ulong start, target_ulong end, int flags)
             /* Using mprotect on a page does not change MAP_ANON. */
             p->flags = (p->flags & PAGE_ANON) | flags;
         }
+        page_map_update(addr, p->flags);
+    }
+}
+
+/*
+ * Return true if any page in [start, end) holds translated code.
+ * TBs are only added with the whole mmap_lock held, so the answer
+ * stays valid for as long as the caller holds a range of it.
+ */
+bool page_range_has_code(target_ulong start, target_ulong end)
+{
+    target_ulong addr, len;
+
+    assert_memory_lock();
+
+    start = start & TARGET_PAGE_MASK;
+    end = TARGET_PAGE_ALIGN(end);
+
+    for (addr = start, len = end - start;
+         len != 0;
+         len -= TARGET_PAGE_SIZE, addr += TARGET_PAGE_SIZE) {
+        PageDesc *p = page_find(addr >> TARGET_PAGE_BITS);
+
+        if (p && p->first_tb) {
+            return true;
+        }
     }
+    return false;
 }
 
 void *page_get_target_data(target_ulong address)
@@ -2795,6 +3164,24 @@ int page_check_range(target_ulong start, target_ulong len, int flags)
     end = TARGET_PAGE_ALIGN(start + len);
     start = start & TARGET_PAGE_MASK;
 
+    /*
+     * Fast path: all pages are in the bitmap and already have the
+     * access.  Anything else, including a write to a page that is
+     * protected because it holds code, is sorted out below.
+     */
+    if ((flags & (PAGE_READ | PAGE_WRITE)) && end > start &&
+        (end - 1) >> TARGET_PAGE_BITS < page_map_pages) {
+        target_ulong first = start >> TARGET_PAGE_BITS;
+        target_ulong last = (end - 1) >> TARGET_PAGE_BITS;
+
+        if ((!(flags & PAGE_READ) ||
+             find_next_zero_bit(page_readable_map, last + 1, first) > last) &&
+            (!(flags & PAGE_WRITE) ||
+             find_next_zero_bit(page_writable_map, last + 1, first) > last)) {
+            return 0;
+        }
+    }
+
     for (addr = start, len = end - start;
          len != 0;
          len -= TARGET_PAGE_SIZE, addr += TARGET_PAGE_SIZE) {
@@ -2873,6 +3260,7 @@ int page_unprotect(target_ulong address, uintptr_t pc)
                 p = page_find(addr >> TARGET_PAGE_BITS);
                 p->flags |= PAGE_WRITE;
                 prot |= p->flags;
+                page_map_update(addr, p->flags);
 
                 /* and since the content will be modified, we must invalidate
                    the corresponding translated code. */
@@ -17,6 +17,7 @@
 #include "exec/log.h"
 #include "exec/translator.h"
 #include "exec/plugin-gen.h"
+#include "exec/tb-stats.h"
 #include "sysemu/replay.h"
 
 /* Pairs with tcg_clear_temp_count.
@@ -32,6 +33,37 @@ void translator_loop_temp_check(DisasContextBase *db)
     }
 }
 
+bool translator_follow_jump(DisasContextBase *db, target_ulong insn_end,
+                            target_ulong dest)
+{
+    /* The jump itself counts against max_insns */
+    if (db->singlestep_enabled || db->num_insns >= db->max_insns) {
+        return false;
+    }
+    /* The last insn of a CF_LAST_IO TB is the one allowed to do I/O */
+    if (tb_cflags(db->tb) & CF_LAST_IO) {
+        return false;
+    }
+    if (dest < insn_end ||
+        (dest & TARGET_PAGE_MASK) != (db->pc_first & TARGET_PAGE_MASK)) {
+        return false;
+    }
+    return !tcg_op_buf_full();
+}
+
+/* Count the executions of @tb for its TB statistics */
+static void gen_tb_exec_count(TranslationBlock *tb)
+{
+    TCGv_ptr ptr = tcg_const_ptr(&tb->tb_stats->executions);
+    TCGv_i64 count = tcg_temp_new_i64();
+
+    tcg_gen_ld_i64(count, ptr, 0);
+    tcg_gen_addi_i64(count, count, 1);
+    tcg_gen_st_i64(count, ptr, 0);
+    tcg_temp_free_i64(count);
+    tcg_temp_free_ptr(ptr);
+}
+
 void translator_loop(const TranslatorOps *ops, DisasContextBase *db,
                      CPUState *cpu, TranslationBlock *tb, int max_insns)
 {
@@ -55,6 +87,9 @@ void translator_loop(const TranslatorOps *ops, DisasContextBase *db,
 
     /* Start translating.  */
     gen_tb_start(db->tb);
+    if (tb->tb_stats) {
+        gen_tb_exec_count(tb);
+    }
     ops->tb_start(db, cpu);
     tcg_debug_assert(db->is_jmp == DISAS_NEXT);  /* no early exit */
 
@@ -31,7 +31,10 @@
 #include "qapi/qobject-input-visitor.h"
 #include "qapi/qapi-visit-audio.h"
 #include "qemu/cutils.h"
+#include "qemu/error-report.h"
 #include "qemu/module.h"
+#include "qemu/main-loop.h"
+#include "sysemu/iothread.h"
 #include "sysemu/replay.h"
 #include "sysemu/runstate.h"
 #include "ui/qemu-spice.h"
@@ -800,12 +803,13 @@ static int audio_is_timer_needed(AudioState *s)
 
 static void audio_reset_timer (AudioState *s)
 {
-    if (audio_is_timer_needed(s)) {
+    /* Unlike the virtual clock, the realtime clock runs with the VM stopped */
+    if (audio_is_timer_needed(s) && (!s->iothread || s->vm_running)) {
         timer_mod_anticipate_ns(s->ts,
-            qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) + s->period_ticks);
+            qemu_clock_get_ns(s->clock) + s->period_ticks);
         if (!s->timer_running) {
             s->timer_running = true;
-            s->timer_last = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
+            s->timer_last = qemu_clock_get_ns(s->clock);
             trace_audio_timer_start(s->period_ticks / SCALE_MS);
         }
     } else {
@@ -822,7 +826,7 @@ static void audio_timer (void *opaque)
     int64_t now, diff;
     AudioState *s = opaque;
 
-    now = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
+    now = qemu_clock_get_ns(s->clock);
     diff = now - s->timer_last;
     if (diff > s->period_ticks * 3 / 2) {
         trace_audio_timer_delayed(diff / SCALE_MS);
@@ -833,6 +837,53 @@ static void audio_timer (void *opaque)
     audio_reset_timer(s);
 }
 
+/* The devices and the backends expect to be called with the BQL held */
+static void audio_thread_timer(void *opaque)
+{
+    qemu_mutex_lock_iothread();
+    audio_timer(opaque);
+    qemu_mutex_unlock_iothread();
+}
+
+static void audio_thread_init(AudioState *s, Audiodev *dev)
+{
+    Error *local_err = NULL;
+    g_autofree char *id = g_strdup_printf("audio-%s", dev->id);
+
+    if (replay_mode != REPLAY_MODE_NONE) {
+        dolog("warning: audio thread not supported with record/replay\n");
+        return;
+    }
+
+    s->iothread = iothread_create(id, &local_err);
+    if (!s->iothread) {
+        error_report_err(local_err);
+        return;
+    }
+    s->clock = QEMU_CLOCK_REALTIME;
+    s->ts = aio_timer_new(iothread_get_aio_context(s->iothread), s->clock,
+                          SCALE_NS, audio_thread_timer, s);
+}
+
+static void audio_thread_fini(AudioState *s)
+{
+    bool locked = qemu_mutex_iothread_locked();
+
+    timer_del(s->ts);
+    /* Let a timer callback that waits for the BQL complete */
+    if (locked) {
+        qemu_mutex_unlock_iothread();
+    }
+    iothread_stop(s->iothread);
+    if (locked) {
+        qemu_mutex_lock_iothread();
+    }
+    timer_free(s->ts);
+    s->ts = NULL;
+    iothread_destroy(s->iothread);
+    s->iothread = NULL;
+}
+
 /*
  * Public API
  */
@@ -1604,6 +1655,9 @@ static void free_audio_state(AudioState *s)
         s->dev = NULL;
     }
 
+    if (s->iothread) {
+        audio_thread_fini(s);
+    }
     if (s->ts) {
         timer_free(s->ts);
         s->ts = NULL;
@@ -1717,7 +1771,13 @@ static AudioState *audio_init(Audiodev *dev, const char *name)
     }
     QTAILQ_INSERT_TAIL(&audio_states, s, list);
 
-    s->ts = timer_new_ns(QEMU_CLOCK_VIRTUAL, audio_timer, s);
+    s->clock = QEMU_CLOCK_VIRTUAL;
+    if (dev->has_thread && dev->thread) {
+        audio_thread_init(s, dev);
+    }
+    if (!s->ts) {
+        s->ts = timer_new_ns(s->clock, audio_timer, s);
+    }
 
     s->nb_hw_voices_out = audio_get_pdo_out(dev)->voices;
     s->nb_hw_voices_in = audio_get_pdo_in(dev)->voices;
@@ -213,6 +213,9 @@ typedef struct AudioState {
     void *drv_opaque;
 
     QEMUTimer *ts;
+    /* with the thread option, ts runs in this thread on the realtime clock */
+    struct IOThread *iothread;
+    QEMUClockType clock;
     QLIST_HEAD (card_listhead, QEMUSoundCard) card_head;
     QLIST_HEAD (hw_in_listhead, HWVoiceIn) hw_head_in;
     QLIST_HEAD (hw_out_listhead, HWVoiceOut) hw_head_out;
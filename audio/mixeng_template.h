@@ -83,11 +83,11 @@ static inline int64_t glue (conv_, ET) (IN_T v)
 
 static inline IN_T glue (clip_, ET) (int64_t v)
 {
-    if (v >= 0x7fffffffLL) {
-        return IN_MAX;
-    } else if (v < -2147483648LL) {
-        return IN_MIN;
-    }
+    /*
+     * Saturating gives exactly IN_MAX and IN_MIN after the shift below.
+     * Without branches the compiler can vectorize the loops over samples.
+     */
+    v = MIN(MAX(v, -2147483648LL), 0x7fffffffLL);
 
 #ifdef SIGNED
     return ENDIAN_CONVERT ((IN_T) (v >> (32 - SHIFT)));
@@ -26,6 +26,10 @@
 #include "qapi/error.h"
 #include "standard-headers/linux/virtio_crypto.h"
 #include "crypto/cipher.h"
+#include "block/aio-wait.h"
+#include "block/thread-pool.h"
+#include "qemu/error-report.h"
+#include "qemu/main-loop.h"
 #include "qom/object.h"
 
 
@@ -43,6 +47,14 @@ typedef struct CryptoDevBackendBuiltinSession {
     uint8_t direction; /* encryption or decryption */
     uint8_t type; /* cipher? hash? aead? */
     QTAILQ_ENTRY(CryptoDevBackendBuiltinSession) next;
+    /*
+     * The cipher keeps the IV between setiv and encrypt, so operations
+     * on the same session are serialized by @lock.  Operations in the
+     * thread pool hold a reference, so that the session survives
+     * being closed while they run.
+     */
+    QemuMutex lock;
+    int refcnt;
 } CryptoDevBackendBuiltinSession;
 
 /* Max number of symmetric sessions */
@@ -55,8 +67,21 @@ struct CryptoDevBackendBuiltin {
     CryptoDevBackend parent_obj;
 
     CryptoDevBackendBuiltinSession *sessions[MAX_NUM_SESSIONS];
+    /* Encrypt and decrypt in the thread pool */
+    bool async;
+    unsigned int inflight;
 };
 
+typedef struct CryptoDevBackendBuiltinOp {
+    CryptoDevBackendBuiltin *builtin;
+    CryptoDevBackendBuiltinSession *sess;
+    CryptoDevBackendSymOpInfo *op_info;
+    CryptoDevCompletionFunc *cb;
+    void *opaque;
+    int ret;
+    Error *err;
+} CryptoDevBackendBuiltinOp;
+
 static void cryptodev_builtin_init(
              CryptoDevBackend *backend, Error **errp)
 {
@@ -234,6 +259,8 @@ static int cryptodev_builtin_create_cipher_session(
     sess->cipher = cipher;
     sess->direction = sess_info->direction;
     sess->type = sess_info->op_type;
+    qemu_mutex_init(&sess->lock);
+    sess->refcnt = 1;
 
     builtin->sessions[index] = sess;
 
@@ -271,6 +298,16 @@ static int64_t cryptodev_builtin_sym_create_session(
     return session_id;
 }
 
+static void
+cryptodev_builtin_session_unref(CryptoDevBackendBuiltinSession *sess)
+{
+    if (--sess->refcnt == 0) {
+        qcrypto_cipher_free(sess->cipher);
+        qemu_mutex_destroy(&sess->lock);
+        g_free(sess);
+    }
+}
+
 static int cryptodev_builtin_sym_close_session(
            CryptoDevBackend *backend,
            uint64_t session_id,
@@ -281,36 +318,40 @@ static int cryptodev_builtin_sym_close_session(
 
     assert(session_id < MAX_NUM_SESSIONS && builtin->sessions[session_id]);
 
-    qcrypto_cipher_free(builtin->sessions[session_id]->cipher);
-    g_free(builtin->sessions[session_id]);
+    cryptodev_builtin_session_unref(builtin->sessions[session_id]);
     builtin->sessions[session_id] = NULL;
     return 0;
 }
 
-static int cryptodev_builtin_sym_operation(
-                 CryptoDevBackend *backend,
-                 CryptoDevBackendSymOpInfo *op_info,
-                 uint32_t queue_index, Error **errp)
+static CryptoDevBackendBuiltinSession *
+cryptodev_builtin_get_sym_session(CryptoDevBackendBuiltin *builtin,
+                                  CryptoDevBackendSymOpInfo *op_info,
+                                  int *ret, Error **errp)
 {
-    CryptoDevBackendBuiltin *builtin =
-                      CRYPTODEV_BACKEND_BUILTIN(backend);
-    CryptoDevBackendBuiltinSession *sess;
-    int ret;
-
     if (op_info->session_id >= MAX_NUM_SESSIONS ||
               builtin->sessions[op_info->session_id] == NULL) {
         error_setg(errp, "Cannot find a valid session id: %" PRIu64 "",
                    op_info->session_id);
-        return -VIRTIO_CRYPTO_INVSESS;
+        *ret = -VIRTIO_CRYPTO_INVSESS;
+        return NULL;
     }
 
     if (op_info->op_type == VIRTIO_CRYPTO_SYM_OP_ALGORITHM_CHAINING) {
         error_setg(errp,
                "Algorithm chain is unsupported for cryptdoev-builtin");
-        return -VIRTIO_CRYPTO_NOTSUPP;
+        *ret = -VIRTIO_CRYPTO_NOTSUPP;
+        return NULL;
     }
 
-    sess = builtin->sessions[op_info->session_id];
+    return builtin->sessions[op_info->session_id];
+}
+
+/* Called with sess->lock held */
+static int cryptodev_builtin_sym_do(CryptoDevBackendBuiltinSession *sess,
+                                    CryptoDevBackendSymOpInfo *op_info,
+                                    Error **errp)
+{
+    int ret;
 
     if (op_info->iv_len > 0) {
         ret = qcrypto_cipher_setiv(sess->cipher, op_info->iv,
@@ -336,6 +377,99 @@ static int cryptodev_builtin_sym_operation(
     return VIRTIO_CRYPTO_OK;
 }
 
+static int cryptodev_builtin_sym_operation(
+                 CryptoDevBackend *backend,
+                 CryptoDevBackendSymOpInfo *op_info,
+                 uint32_t queue_index, Error **errp)
+{
+    CryptoDevBackendBuiltin *builtin =
+                      CRYPTODEV_BACKEND_BUILTIN(backend);
+    CryptoDevBackendBuiltinSession *sess;
+    int ret;
+
+    sess = cryptodev_builtin_get_sym_session(builtin, op_info, &ret, errp);
+    if (!sess) {
+        return ret;
+    }
+
+    qemu_mutex_lock(&sess->lock);
+    ret = cryptodev_builtin_sym_do(sess, op_info, errp);
+    qemu_mutex_unlock(&sess->lock);
+    return ret;
+}
+
+/* Runs in a worker thread of the thread pool */
+static int cryptodev_builtin_sym_worker(void *opaque)
+{
+    CryptoDevBackendBuiltinOp *op = opaque;
+
+    qemu_mutex_lock(&op->sess->lock);
+    op->ret = cryptodev_builtin_sym_do(op->sess, op->op_info, &op->err);
+    qemu_mutex_unlock(&op->sess->lock);
+    return 0;
+}
+
+static void cryptodev_builtin_sym_complete(void *opaque, int ret)
+{
+    CryptoDevBackendBuiltinOp *op = opaque;
+
+    if (op->err) {
+        error_report_err(op->err);
+    }
+    op->cb(op->opaque, op->ret);
+
+    cryptodev_builtin_session_unref(op->sess);
+    op->builtin->inflight--;
+    g_free(op);
+}
+
+static void cryptodev_builtin_sym_operation_async(
+                 CryptoDevBackend *backend,
+                 CryptoDevBackendSymOpInfo *op_info,
+                 uint32_t queue_index,
+                 CryptoDevCompletionFunc *cb, void *opaque)
+{
+    CryptoDevBackendBuiltin *builtin =
+                      CRYPTODEV_BACKEND_BUILTIN(backend);
+    CryptoDevBackendBuiltinSession *sess;
+    CryptoDevBackendBuiltinOp *op;
+    Error *local_err = NULL;
+    ThreadPool *pool;
+    int ret;
+
+    if (!builtin->async) {
+        ret = cryptodev_builtin_sym_operation(backend, op_info,
+                                              queue_index, &local_err);
+        if (local_err) {
+            error_report_err(local_err);
+        }
+        cb(opaque, ret);
+        return;
+    }
+
+    sess = cryptodev_builtin_get_sym_session(builtin, op_info, &ret,
+                                             &local_err);
+    if (!sess) {
+        error_report_err(local_err);
+        cb(opaque, ret);
+        return;
+    }
+
+    op = g_new0(CryptoDevBackendBuiltinOp, 1);
+    op->builtin = builtin;
+    op->sess = sess;
+    op->op_info = op_info;
+    op->cb = cb;
+    op->opaque = opaque;
+    sess->refcnt++;
+    builtin->inflight++;
+
+    pool = aio_get_thread_pool(qemu_get_aio_context());
+    thread_pool_submit_aio_prio(pool, THREAD_POOL_PRIO_BULK,
+                                cryptodev_builtin_sym_worker, op,
+                                cryptodev_builtin_sym_complete, op);
+}
+
 static void cryptodev_builtin_cleanup(
              CryptoDevBackend *backend,
              Error **errp)
@@ -346,6 +480,9 @@ static void cryptodev_builtin_cleanup(
     int queues = backend->conf.peers.queues;
     CryptoDevBackendClient *cc;
 
+    /* The operations in the thread pool point to the backend */
+    AIO_WAIT_WHILE(NULL, builtin->inflight > 0);
+
     for (i = 0; i < MAX_NUM_SESSIONS; i++) {
         if (builtin->sessions[i] != NULL) {
             cryptodev_builtin_sym_close_session(backend, i, 0, &error_abort);
@@ -363,6 +500,17 @@ static void cryptodev_builtin_cleanup(
     cryptodev_backend_set_ready(backend, false);
 }
 
+static bool cryptodev_builtin_get_async(Object *obj, Error **errp)
+{
+    return CRYPTODEV_BACKEND_BUILTIN(obj)->async;
+}
+
+static void cryptodev_builtin_set_async(Object *obj, bool value,
+                                        Error **errp)
+{
+    CRYPTODEV_BACKEND_BUILTIN(obj)->async = value;
+}
+
 static void
 cryptodev_builtin_class_init(ObjectClass *oc, void *data)
 {
@@ -373,6 +521,11 @@ cryptodev_builtin_class_init(ObjectClass *oc, void *data)
     bc->create_session = cryptodev_builtin_sym_create_session;
     bc->close_session = cryptodev_builtin_sym_close_session;
     bc->do_sym_op = cryptodev_builtin_sym_operation;
+    bc->do_sym_op_async = cryptodev_builtin_sym_operation_async;
+
+    object_class_property_add_bool(oc, "async",
+                                   cryptodev_builtin_get_async,
+                                   cryptodev_builtin_set_async);
 }
 
 static const TypeInfo cryptodev_builtin_info = {
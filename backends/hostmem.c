@@ -204,6 +204,37 @@ static void host_memory_backend_set_dump(Object *obj, bool value, Error **errp)
     }
 }
 
+static void host_memory_backend_do_prealloc(HostMemoryBackend *backend,
+                                            uint64_t offset, uint64_t size,
+                                            bool async, Error **errp)
+{
+    int fd = memory_region_get_fd(&backend->mr);
+    char *ptr = memory_region_get_ram_ptr(&backend->mr);
+    unsigned long lastbit = find_last_bit(backend->host_nodes, MAX_NODES);
+    /* lastbit == MAX_NODES means maxnode = 0 */
+    unsigned long maxnode = (lastbit + 1) % (MAX_NODES + 1);
+
+    /* Run the threads on the nodes the memory is bound to, if any */
+    os_mem_prealloc(fd, ptr + offset, size, backend->prealloc_threads,
+                    maxnode ? backend->host_nodes : NULL, maxnode, async,
+                    errp);
+}
+
+static void host_memory_backend_prealloc(HostMemoryBackend *backend,
+                                         bool async, Error **errp)
+{
+    host_memory_backend_do_prealloc(backend, 0,
+                                    memory_region_size(&backend->mr),
+                                    async, errp);
+}
+
+void host_memory_backend_prealloc_range(HostMemoryBackend *backend,
+                                        uint64_t offset, uint64_t size,
+                                        Error **errp)
+{
+    host_memory_backend_do_prealloc(backend, offset, size, false, errp);
+}
+
 static bool host_memory_backend_get_prealloc(Object *obj, Error **errp)
 {
     HostMemoryBackend *backend = MEMORY_BACKEND(obj);
@@ -223,11 +254,7 @@ static void host_memory_backend_set_prealloc(Object *obj, bool value,
     }
 
     if (value && !backend->prealloc) {
-        int fd = memory_region_get_fd(&backend->mr);
-        void *ptr = memory_region_get_ram_ptr(&backend->mr);
-        uint64_t sz = memory_region_size(&backend->mr);
-
-        os_mem_prealloc(fd, ptr, sz, backend->prealloc_threads, &local_err);
+        host_memory_backend_prealloc(backend, false, &local_err);
         if (local_err) {
             error_propagate(errp, local_err);
             return;
@@ -268,7 +295,7 @@ static void host_memory_backend_init(Object *obj)
     /* TODO: convert access to globals to compat properties */
     backend->merge = machine_mem_merge(machine);
     backend->dump = machine_dump_guest_core(machine);
-    backend->prealloc_threads = 1;
+    backend->prealloc_threads = machine->smp.cpus;
 }
 
 static void host_memory_backend_post_init(Object *obj)
@@ -385,10 +412,15 @@ host_memory_backend_memory_complete(UserCreatable *uc, Error **errp)
         /* Preallocate memory after the NUMA policy has been instantiated.
          * This is necessary to guarantee memory is allocated with
          * specified NUMA policy in place.
+         *
+         * While the machine is being created, let the preallocation run
+         * in the background; qemu_machine_creation_done() waits for it
+         * before the guest can run.
          */
         if (backend->prealloc) {
-            os_mem_prealloc(memory_region_get_fd(&backend->mr), ptr, sz,
-                            backend->prealloc_threads, &local_err);
+            host_memory_backend_prealloc(backend,
+                                         !phase_check(PHASE_MACHINE_READY),
+                                         &local_err);
             if (local_err) {
                 goto out;
             }
@@ -1684,6 +1684,12 @@ QemuOptsList bdrv_runtime_opts = {
             .type = QEMU_OPT_BOOL,
             .help = "always accept other writers (default: off)",
         },
+        {
+            .name = BDRV_OPT_ALLOC_INDEX,
+            .type = QEMU_OPT_BOOL,
+            .help = "remember unallocated backing chain layers "
+                    "(default: off)",
+        },
         { /* end of list */ }
     },
 };
@@ -1748,6 +1754,10 @@ static int bdrv_open_common(BlockDriverState *bs, BlockBackend *file,
         goto fail_opts;
     }
 
+    if (qemu_opt_get_bool(opts, BDRV_OPT_ALLOC_INDEX, false)) {
+        bs->alloc_index = bdrv_alloc_index_new();
+    }
+
     if (file != NULL) {
         bdrv_refresh_filename(blk_bs(file));
         filename = blk_bs(file)->filename;
@@ -2673,6 +2683,13 @@ static void bdrv_replace_child_noperm(BdrvChild *child,
         QLIST_REMOVE(child, next_parent);
     }
 
+    if (child->klass == &child_of_bds &&
+        (child->role & (BDRV_CHILD_COW | BDRV_CHILD_FILTERED)))
+    {
+        /* The backing chain below the parent changes */
+        bdrv_alloc_index_invalidate(child->opaque);
+    }
+
     child->bs = new_bs;
 
     if (new_bs) {
@@ -4608,6 +4625,8 @@ static void bdrv_close(BlockDriverState *bs)
     bs->file = NULL;
     g_free(bs->opaque);
     bs->opaque = NULL;
+    bdrv_alloc_index_free(bs->alloc_index);
+    bs->alloc_index = NULL;
     qatomic_set(&bs->copy_on_read, 0);
     bs->backing_file[0] = '\0';
     bs->backing_format[0] = '\0';
@@ -4975,6 +4994,7 @@ static void bdrv_delete(BlockDriverState *bs)
 
     bdrv_close(bs);
 
+    assert(!bs->multiqueue_contexts);
     g_free(bs);
 }
 
@@ -6140,6 +6160,9 @@ int coroutine_fn bdrv_co_invalidate_cache(BlockDriverState *bs, Error **errp)
             bdrv_dirty_bitmap_skip_store(bm, false);
         }
 
+        /* Another process may have written to the image meanwhile */
+        bdrv_alloc_index_invalidate(bs);
+
         ret = refresh_total_sectors(bs, bs->total_sectors);
         if (ret < 0) {
             bs->open_flags |= BDRV_O_INACTIVE;
@@ -6634,6 +6657,81 @@ AioContext *bdrv_get_aio_context(BlockDriverState *bs)
     return bs ? bs->aio_context : qemu_get_aio_context();
 }
 
+AioContext *bdrv_get_request_aio_context(BlockDriverState *bs)
+{
+    AioContext *ctx;
+
+    if (!bs || !bs->multiqueue_contexts) {
+        return bdrv_get_aio_context(bs);
+    }
+
+    ctx = qemu_get_current_aio_context();
+    if (ctx != bs->aio_context && g_slist_find(bs->multiqueue_contexts, ctx)) {
+        return ctx;
+    }
+    return bs->aio_context;
+}
+
+/*
+ * Return true if requests to @bs may be submitted from several threads at
+ * once, which needs all nodes in the subtree to support it.
+ */
+bool bdrv_supports_multiqueue(BlockDriverState *bs)
+{
+    BdrvChild *child;
+
+    if (!bs->drv || !bs->drv->supports_multiqueue) {
+        return false;
+    }
+
+    QLIST_FOREACH(child, &bs->children, next) {
+        if (!bdrv_supports_multiqueue(child->bs)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Allow requests to @bs and its children to be submitted from @ctx.  Calls
+ * nest, @ctx is dropped again by the matching bdrv_del_multiqueue_context().
+ *
+ * Must be called in a drained section with the BQL held.
+ */
+void bdrv_add_multiqueue_context(BlockDriverState *bs, AioContext *ctx)
+{
+    BdrvChild *child;
+
+    QLIST_FOREACH(child, &bs->children, next) {
+        bdrv_add_multiqueue_context(child->bs, ctx);
+    }
+
+    if (!g_slist_find(bs->multiqueue_contexts, ctx) &&
+        bs->drv && bs->drv->bdrv_attach_multiqueue_context) {
+        bs->drv->bdrv_attach_multiqueue_context(bs, ctx);
+    }
+    bs->multiqueue_contexts = g_slist_prepend(bs->multiqueue_contexts, ctx);
+}
+
+void bdrv_del_multiqueue_context(BlockDriverState *bs, AioContext *ctx)
+{
+    BdrvChild *child;
+
+    /* The node may have been attached after @ctx was added */
+    if (!g_slist_find(bs->multiqueue_contexts, ctx)) {
+        return;
+    }
+    bs->multiqueue_contexts = g_slist_remove(bs->multiqueue_contexts, ctx);
+    if (!g_slist_find(bs->multiqueue_contexts, ctx) &&
+        bs->drv && bs->drv->bdrv_detach_multiqueue_context) {
+        bs->drv->bdrv_detach_multiqueue_context(bs, ctx);
+    }
+
+    QLIST_FOREACH(child, &bs->children, next) {
+        bdrv_del_multiqueue_context(child->bs, ctx);
+    }
+}
+
 AioContext *coroutine_fn bdrv_co_enter(BlockDriverState *bs)
 {
     Coroutine *self = qemu_coroutine_self();
@@ -7414,6 +7512,7 @@ int bdrv_make_empty(BdrvChild *c, Error **errp)
     }
 
     ret = drv->bdrv_make_empty(c->bs);
+    bdrv_alloc_index_invalidate_above(c->bs);
     if (ret < 0) {
         error_setg_errno(errp, -ret, "Failed to empty %s",
                          c->bs->filename);
@@ -27,13 +27,28 @@
 #include "block/accounting.h"
 #include "block/block_int.h"
 #include "qemu/timer.h"
+#include "qemu/host-utils.h"
 #include "sysemu/qtest.h"
 
 static QEMUClockType clock_type = QEMU_CLOCK_REALTIME;
 static const int qtest_latency_ns = NANOSECONDS_PER_SECOND / 1000;
 
+static unsigned next_shard;
+static __thread int current_shard = -1;
+
+/* The counters updated by the calling thread */
+static BlockAcctShard *block_acct_shard(BlockAcctStats *stats)
+{
+    if (current_shard < 0) {
+        current_shard = qatomic_fetch_inc(&next_shard) % BLOCK_ACCT_SHARDS;
+    }
+    return &stats->shards[current_shard];
+}
+
 void block_acct_init(BlockAcctStats *stats)
 {
+    memset(stats->shards, 0, sizeof(stats->shards));
+    memset(stats->latency_bins, 0, sizeof(stats->latency_bins));
     qemu_mutex_init(&stats->lock);
     if (qtest_enabled()) {
         clock_type = QEMU_CLOCK_VIRTUAL;
@@ -155,6 +170,7 @@ int block_latency_histogram_set(BlockAcctStats *stats, enum BlockAcctType type,
         prev = entry->value;
     }
 
+    qemu_mutex_lock(&stats->lock);
     hist->nbins = new_nbins;
     g_free(hist->boundaries);
     hist->boundaries = g_new(uint64_t, hist->nbins - 1);
@@ -165,7 +181,8 @@ int block_latency_histogram_set(BlockAcctStats *stats, enum BlockAcctType type,
     }
 
     g_free(hist->bins);
-    hist->bins = g_new0(uint64_t, hist->nbins);
+    qatomic_set(&hist->bins, g_new0(uint64_t, hist->nbins));
+    qemu_mutex_unlock(&stats->lock);
 
     return 0;
 }
@@ -174,20 +191,115 @@ void block_latency_histograms_clear(BlockAcctStats *stats)
 {
     int i;
 
+    qemu_mutex_lock(&stats->lock);
     for (i = 0; i < BLOCK_MAX_IOTYPE; i++) {
         BlockLatencyHistogram *hist = &stats->latency_histogram[i];
         g_free(hist->bins);
         g_free(hist->boundaries);
         memset(hist, 0, sizeof(*hist));
     }
+    qemu_mutex_unlock(&stats->lock);
+}
+
+/* The clock used for all latencies */
+int64_t block_acct_clock_ns(void)
+{
+    return qemu_clock_get_ns(clock_type);
+}
+
+static int block_acct_latency_bin(int64_t latency_ns)
+{
+    uint64_t v = MAX(latency_ns, 0);
+    int shift;
+
+    if (v < (1 << BLOCK_ACCT_LAT_SUB_BITS)) {
+        return v;
+    }
+
+    shift = 63 - clz64(v);
+    if (shift > BLOCK_ACCT_LAT_MAX_SHIFT) {
+        return BLOCK_ACCT_LAT_BINS - 1;
+    }
+
+    return ((shift - BLOCK_ACCT_LAT_SUB_BITS + 1) << BLOCK_ACCT_LAT_SUB_BITS) +
+           ((v >> (shift - BLOCK_ACCT_LAT_SUB_BITS)) &
+            ((1 << BLOCK_ACCT_LAT_SUB_BITS) - 1));
+}
+
+/* The middle of the latencies that go into @bin */
+static uint64_t block_acct_latency_bin_value(int bin)
+{
+    int shift;
+    uint64_t sub;
+
+    if (bin < (1 << BLOCK_ACCT_LAT_SUB_BITS)) {
+        return bin;
+    }
+
+    shift = (bin >> BLOCK_ACCT_LAT_SUB_BITS) - 1;
+    sub = bin & ((1 << BLOCK_ACCT_LAT_SUB_BITS) - 1);
+
+    return (((1 << BLOCK_ACCT_LAT_SUB_BITS) + sub) << shift) +
+           (1ULL << shift) / 2;
+}
+
+void block_acct_latency(BlockAcctStats *stats, enum BlockAcctPhase phase,
+                        enum BlockAcctType type, int64_t latency_ns)
+{
+    assert(phase < BLOCK_ACCT_PHASE_MAX && type < BLOCK_MAX_IOTYPE);
+
+    stat64_add(&stats->latency_bins[phase][type]
+                                   [block_acct_latency_bin(latency_ns)], 1);
+}
+
+/*
+ * Compute the latencies below which the given @percentiles (in ascending
+ * order, between 0 and 100) of the operations of @type were in @phase.
+ * Returns the number of operations; if it is zero, @latencies_ns is not
+ * written.
+ */
+uint64_t block_acct_latency_percentiles(BlockAcctStats *stats,
+                                        enum BlockAcctPhase phase,
+                                        enum BlockAcctType type,
+                                        const double *percentiles,
+                                        uint64_t *latencies_ns, int n)
+{
+    uint64_t bins[BLOCK_ACCT_LAT_BINS];
+    uint64_t count = 0, seen = 0;
+    int i, bin;
+
+    assert(phase < BLOCK_ACCT_PHASE_MAX && type < BLOCK_MAX_IOTYPE);
+
+    for (bin = 0; bin < BLOCK_ACCT_LAT_BINS; bin++) {
+        bins[bin] = stat64_get(&stats->latency_bins[phase][type][bin]);
+        count += bins[bin];
+    }
+    if (!count) {
+        return 0;
+    }
+
+    bin = -1;
+    for (i = 0; i < n; i++) {
+        /* The rank of the operation at this percentile, starting at 1 */
+        uint64_t rank = MAX((uint64_t)(percentiles[i] / 100 * count + 0.5), 1);
+
+        while (seen < MIN(rank, count)) {
+            seen += bins[++bin];
+        }
+        latencies_ns[i] = block_acct_latency_bin_value(MAX(bin, 0));
+    }
+
+    return count;
 }
 
 static void block_account_one_io(BlockAcctStats *stats, BlockAcctCookie *cookie,
                                  bool failed)
 {
+    BlockAcctShard *shard = block_acct_shard(stats);
     BlockAcctTimedStats *s;
     int64_t time_ns = qemu_clock_get_ns(clock_type);
     int64_t latency_ns = time_ns - cookie->start_time_ns;
+    bool account_time = !failed || stats->account_failed;
 
     if (qtest_enabled()) {
         latency_ns = qtest_latency_ns;
@@ -199,27 +311,41 @@ static void block_account_one_io(BlockAcctStats *stats, BlockAcctCookie *cookie,
         return;
     }
 
-    WITH_QEMU_LOCK_GUARD(&stats->lock) {
-        if (failed) {
-            stats->failed_ops[cookie->type]++;
-        } else {
-            stats->nr_bytes[cookie->type] += cookie->bytes;
-            stats->nr_ops[cookie->type]++;
-        }
+    if (failed) {
+        stat64_add(&shard->failed_ops[cookie->type], 1);
+    } else {
+        stat64_add(&shard->nr_bytes[cookie->type], cookie->bytes);
+        stat64_add(&shard->nr_ops[cookie->type], 1);
+    }
+    if (account_time) {
+        stat64_add(&shard->total_time_ns[cookie->type], latency_ns);
+        stat64_max(&shard->last_access_time_ns, time_ns);
+        block_acct_latency(stats, BLOCK_ACCT_PHASE_TOTAL, cookie->type,
+                           latency_ns);
+    }
+
+    /*
+     * Histograms and intervals are configured by the user and off by
+     * default, only take the lock when one of them is in use.
+     */
+    if (!qatomic_read(&stats->latency_histogram[cookie->type].bins) &&
+        !qatomic_read(&stats->intervals.slh_first)) {
+        goto out;
+    }
 
+    WITH_QEMU_LOCK_GUARD(&stats->lock) {
         block_latency_histogram_account(&stats->latency_histogram[cookie->type],
                                         latency_ns);
 
-        if (!failed || stats->account_failed) {
-            stats->total_time_ns[cookie->type] += latency_ns;
-            stats->last_access_time_ns = time_ns;
-
+        if (account_time) {
             QSLIST_FOREACH(s, &stats->intervals, entries) {
                 timed_average_account(&s->latency[cookie->type], latency_ns);
             }
         }
     }
 
+out:
+
     cookie->type = BLOCK_ACCT_NONE;
 }
 
@@ -235,19 +361,21 @@ void block_acct_failed(BlockAcctStats *stats, BlockAcctCookie *cookie)
 
 void block_acct_invalid(BlockAcctStats *stats, enum BlockAcctType type)
 {
+    BlockAcctShard *shard;
+
     assert(type < BLOCK_MAX_IOTYPE);
 
     /* block_account_one_io() updates total_time_ns[], but this one does
      * not.  The reason is that invalid requests are accounted during their
      * submission, therefore there's no actual I/O involved.
      */
-    qemu_mutex_lock(&stats->lock);
-    stats->invalid_ops[type]++;
+    shard = block_acct_shard(stats);
+    stat64_add(&shard->invalid_ops[type], 1);
 
     if (stats->account_invalid) {
-        stats->last_access_time_ns = qemu_clock_get_ns(clock_type);
+        stat64_max(&shard->last_access_time_ns,
+                   qemu_clock_get_ns(clock_type));
     }
-    qemu_mutex_unlock(&stats->lock);
 }
 
 void block_acct_merge_done(BlockAcctStats *stats, enum BlockAcctType type,
@@ -255,14 +383,42 @@ void block_acct_merge_done(BlockAcctStats *stats, enum BlockAcctType type,
 {
     assert(type < BLOCK_MAX_IOTYPE);
 
-    qemu_mutex_lock(&stats->lock);
-    stats->merged[type] += num_requests;
-    qemu_mutex_unlock(&stats->lock);
+    stat64_add(&block_acct_shard(stats)->merged[type], num_requests);
+}
+
+/*
+ * Sum up the counters of all shards.  The result is not a snapshot, it may
+ * include only part of the requests that complete meanwhile.
+ */
+void block_acct_get_counters(BlockAcctStats *stats,
+                             BlockAcctCounters *counters)
+{
+    int i, j;
+
+    memset(counters, 0, sizeof(*counters));
+    for (i = 0; i < BLOCK_ACCT_SHARDS; i++) {
+        BlockAcctShard *shard = &stats->shards[i];
+
+        for (j = 0; j < BLOCK_MAX_IOTYPE; j++) {
+            counters->nr_bytes[j] += stat64_get(&shard->nr_bytes[j]);
+            counters->nr_ops[j] += stat64_get(&shard->nr_ops[j]);
+            counters->invalid_ops[j] += stat64_get(&shard->invalid_ops[j]);
+            counters->failed_ops[j] += stat64_get(&shard->failed_ops[j]);
+            counters->total_time_ns[j] += stat64_get(&shard->total_time_ns[j]);
+            counters->merged[j] += stat64_get(&shard->merged[j]);
+        }
+        counters->last_access_time_ns =
+            MAX(counters->last_access_time_ns,
+                stat64_get(&shard->last_access_time_ns));
+    }
 }
 
 int64_t block_acct_idle_time_ns(BlockAcctStats *stats)
 {
-    return qemu_clock_get_ns(clock_type) - stats->last_access_time_ns;
+    BlockAcctCounters counters;
+
+    block_acct_get_counters(stats, &counters);
+    return qemu_clock_get_ns(clock_type) - counters.last_access_time_ns;
 }
 
 double block_acct_queue_depth(BlockAcctTimedStats *stats,
@@ -0,0 +1,191 @@
+/*
+ * Backing chain allocation index
+ *
+ * Block status queries on a node with a long backing chain ask every
+ * layer in turn until one of them has the data allocated.  With
+ * allocation-index=on, the node remembers for which ranges the first
+ * layers below it were found to be unallocated, so that later queries
+ * can go straight to the first layer that may have the data.
+ *
+ * The top node itself is always queried, so writes to it don't affect
+ * the index.  Writes to the layers below and changes of the backing
+ * chain clear the indexes of the nodes above.  Changes made to the
+ * images by other processes are not noticed.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/thread.h"
+#include "block/block_int.h"
+
+/* The index is simply cleared when it grows beyond this */
+#define BDRV_ALLOC_INDEX_MAX_EXTENTS 65536
+
+typedef struct BdrvAllocExtent {
+    int64_t offset;
+    int64_t bytes;
+    int skip;   /* number of layers below the node unallocated here */
+} BdrvAllocExtent;
+
+struct BdrvAllocIndex {
+    QemuMutex lock;
+    GTree *extents;     /* BdrvAllocExtent, non-overlapping, by offset */
+    /*
+     * Incremented whenever the index is cleared, so that lookups that
+     * started before don't insert stale results afterwards.
+     */
+    uint64_t gen;
+};
+
+static gint alloc_extent_cmp(gconstpointer a, gconstpointer b,
+                             gpointer opaque)
+{
+    const BdrvAllocExtent *ea = a;
+    const BdrvAllocExtent *eb = b;
+
+    return ea->offset < eb->offset ? -1 : ea->offset > eb->offset;
+}
+
+/* Find an extent that overlaps the range @opaque */
+static gint alloc_extent_search(gconstpointer key, gconstpointer opaque)
+{
+    const BdrvAllocExtent *e = key;
+    const BdrvAllocExtent *range = opaque;
+
+    if (range->offset + range->bytes <= e->offset) {
+        return -1;
+    }
+    if (e->offset + e->bytes <= range->offset) {
+        return 1;
+    }
+    return 0;
+}
+
+static BdrvAllocExtent *alloc_extent_find(BdrvAllocIndex *idx,
+                                          int64_t offset, int64_t bytes)
+{
+    BdrvAllocExtent range = { .offset = offset, .bytes = bytes };
+
+    return g_tree_search(idx->extents, alloc_extent_search, &range);
+}
+
+BdrvAllocIndex *bdrv_alloc_index_new(void)
+{
+    BdrvAllocIndex *idx = g_new0(BdrvAllocIndex, 1);
+
+    qemu_mutex_init(&idx->lock);
+    idx->extents = g_tree_new_full(alloc_extent_cmp, NULL, NULL, g_free);
+    return idx;
+}
+
+void bdrv_alloc_index_free(BdrvAllocIndex *idx)
+{
+    if (idx) {
+        g_tree_destroy(idx->extents);
+        qemu_mutex_destroy(&idx->lock);
+        g_free(idx);
+    }
+}
+
+static void bdrv_alloc_index_clear(BdrvAllocIndex *idx)
+{
+    QEMU_LOCK_GUARD(&idx->lock);
+    if (g_tree_nnodes(idx->extents)) {
+        g_tree_destroy(idx->extents);
+        idx->extents = g_tree_new_full(alloc_extent_cmp, NULL, NULL, g_free);
+    }
+    idx->gen++;
+}
+
+int bdrv_alloc_index_lookup(BdrvAllocIndex *idx, int64_t offset,
+                            int64_t *bytes, uint64_t *gen)
+{
+    BdrvAllocExtent *e;
+
+    QEMU_LOCK_GUARD(&idx->lock);
+    *gen = idx->gen;
+    e = alloc_extent_find(idx, offset, 1);
+    if (!e) {
+        return 0;
+    }
+    *bytes = MIN(*bytes, e->offset + e->bytes - offset);
+    return e->skip;
+}
+
+void bdrv_alloc_index_insert(BdrvAllocIndex *idx, uint64_t gen,
+                             int64_t offset, int64_t bytes, int skip)
+{
+    BdrvAllocExtent *e;
+    int64_t end = offset + bytes;
+
+    QEMU_LOCK_GUARD(&idx->lock);
+    if (gen != idx->gen) {
+        return;
+    }
+
+    /* The new result is at least as recent as anything in the range */
+    while ((e = alloc_extent_find(idx, offset, bytes))) {
+        BdrvAllocExtent *tail = NULL;
+
+        if (e->offset + e->bytes > end) {
+            tail = g_new(BdrvAllocExtent, 1);
+            tail->offset = end;
+            tail->bytes = e->offset + e->bytes - end;
+            tail->skip = e->skip;
+        }
+        if (e->offset < offset) {
+            e->bytes = offset - e->offset;
+        } else {
+            g_tree_remove(idx->extents, e);
+        }
+        if (tail) {
+            g_tree_insert(idx->extents, tail, tail);
+        }
+    }
+
+    /* Merge with the neighbours if they skip as many layers */
+    e = offset ? alloc_extent_find(idx, offset - 1, 1) : NULL;
+    if (e && e->skip == skip) {
+        offset = e->offset;
+        g_tree_remove(idx->extents, e);
+    }
+    e = alloc_extent_find(idx, end, 1);
+    if (e && e->skip == skip) {
+        end = e->offset + e->bytes;
+        g_tree_remove(idx->extents, e);
+    }
+
+    if (g_tree_nnodes(idx->extents) >= BDRV_ALLOC_INDEX_MAX_EXTENTS) {
+        g_tree_destroy(idx->extents);
+        idx->extents = g_tree_new_full(alloc_extent_cmp, NULL, NULL, g_free);
+    }
+
+    e = g_new(BdrvAllocExtent, 1);
+    e->offset = offset;
+    e->bytes = end - offset;
+    e->skip = skip;
+    g_tree_insert(idx->extents, e, e);
+}
+
+void bdrv_alloc_index_invalidate_above(BlockDriverState *bs)
+{
+    BdrvChild *c;
+
+    QLIST_FOREACH(c, &bs->parents, next_parent) {
+        if (c->klass == &child_of_bds &&
+            (c->role & (BDRV_CHILD_COW | BDRV_CHILD_FILTERED)))
+        {
+            bdrv_alloc_index_invalidate(c->opaque);
+        }
+    }
+}
+
+void bdrv_alloc_index_invalidate(BlockDriverState *bs)
+{
+    if (bs->alloc_index) {
+        bdrv_alloc_index_clear(bs->alloc_index);
+    }
+    bdrv_alloc_index_invalidate_above(bs);
+}
@@ -83,9 +83,15 @@ struct BlockBackend {
     QLIST_HEAD(, BlockBackendAioNotifier) aio_notifiers;
 
     int quiesce_counter;
+    /* Requests may queue from several threads, see blk_enable_multiqueue() */
+    QemuMutex queued_requests_lock;
     CoQueue queued_requests;
     bool disable_request_queuing;
 
+    /* AioContexts besides ctx that submit requests, one entry per
+     * blk_enable_multiqueue() call.  Protected by the BQL. */
+    GSList *multiqueue_contexts;
+
     VMChangeStateEntry *vmsh;
     bool force_allow_inactivate;
 
@@ -272,6 +278,7 @@ static void blk_root_attach(BdrvChild *child)
 {
     BlockBackend *blk = child->opaque;
     BlockBackendAioNotifier *notifier;
+    GSList *l;
 
     trace_blk_root_attach(child, blk, child->bs);
 
@@ -281,15 +288,24 @@ static void blk_root_attach(BdrvChild *child)
                 notifier->detach_aio_context,
                 notifier->opaque);
     }
+
+    for (l = blk->multiqueue_contexts; l; l = l->next) {
+        bdrv_add_multiqueue_context(child->bs, l->data);
+    }
 }
 
 static void blk_root_detach(BdrvChild *child)
 {
     BlockBackend *blk = child->opaque;
     BlockBackendAioNotifier *notifier;
+    GSList *l;
 
     trace_blk_root_detach(child, blk, child->bs);
 
+    for (l = blk->multiqueue_contexts; l; l = l->next) {
+        bdrv_del_multiqueue_context(child->bs, l->data);
+    }
+
     QLIST_FOREACH(notifier, &blk->aio_notifiers, list) {
         bdrv_remove_aio_context_notifier(child->bs,
                 notifier->attached_aio_context,
@@ -356,6 +372,7 @@ BlockBackend *blk_new(AioContext *ctx, uint64_t perm, uint64_t shared_perm)
 
     block_acct_init(&blk->stats);
 
+    qemu_mutex_init(&blk->queued_requests_lock);
     qemu_co_queue_init(&blk->queued_requests);
     notifier_list_init(&blk->remove_bs_notifiers);
     notifier_list_init(&blk->insert_bs_notifiers);
@@ -469,9 +486,11 @@ static void blk_delete(BlockBackend *blk)
     assert(QLIST_EMPTY(&blk->remove_bs_notifiers.notifiers));
     assert(QLIST_EMPTY(&blk->insert_bs_notifiers.notifiers));
     assert(QLIST_EMPTY(&blk->aio_notifiers));
+    assert(!blk->multiqueue_contexts);
     QTAILQ_REMOVE(&block_backends, blk, link);
     drive_info_del(blk->legacy_dinfo);
     block_acct_cleanup(&blk->stats);
+    qemu_mutex_destroy(&blk->queued_requests_lock);
     g_free(blk);
 }
 
@@ -1191,10 +1210,45 @@ static void coroutine_fn blk_wait_while_drained(BlockBackend *blk)
     assert(blk->in_flight > 0);
 
     if (blk->quiesce_counter && !blk->disable_request_queuing) {
-        blk_dec_in_flight(blk);
-        qemu_co_queue_wait(&blk->queued_requests, NULL);
-        blk_inc_in_flight(blk);
+        qemu_mutex_lock(&blk->queued_requests_lock);
+        /* quiesce_counter may have dropped while taking the lock */
+        if (blk->quiesce_counter) {
+            blk_dec_in_flight(blk);
+            qemu_co_queue_wait(&blk->queued_requests,
+                               &blk->queued_requests_lock);
+            blk_inc_in_flight(blk);
+        }
+        qemu_mutex_unlock(&blk->queued_requests_lock);
+    }
+}
+
+/*
+ * Wait for I/O throttling if it is enabled, accounting the time spent
+ * waiting for the latency percentiles.
+ */
+static void coroutine_fn blk_co_throttle(BlockBackend *blk, int64_t bytes,
+                                         bool is_write)
+{
+    ThrottleGroupMember *tgm = &blk->public.throttle_group_member;
+    int64_t start_ns;
+
+    if (!tgm->throttle_state) {
+        return;
     }
+
+    start_ns = block_acct_clock_ns();
+    throttle_group_co_io_limits_intercept(tgm, bytes, is_write);
+    block_acct_latency(&blk->stats, BLOCK_ACCT_PHASE_THROTTLE,
+                       is_write ? BLOCK_ACCT_WRITE : BLOCK_ACCT_READ,
+                       block_acct_clock_ns() - start_ns);
+}
+
+/* Accounts the time since @start_ns as spent in the block drivers */
+static void blk_acct_driver_latency(BlockBackend *blk,
+                                    enum BlockAcctType type, int64_t start_ns)
+{
+    block_acct_latency(&blk->stats, BLOCK_ACCT_PHASE_DRIVER, type,
+                       block_acct_clock_ns() - start_ns);
 }
 
 /* To be called between exactly one pair of blk_inc/dec_in_flight() */
@@ -1203,6 +1257,7 @@ blk_do_preadv(BlockBackend *blk, int64_t offset, unsigned int bytes,
               QEMUIOVector *qiov, BdrvRequestFlags flags)
 {
     int ret;
+    int64_t start_ns;
     BlockDriverState *bs;
 
     blk_wait_while_drained(blk);
@@ -1219,12 +1274,11 @@ blk_do_preadv(BlockBackend *blk, int64_t offset, unsigned int bytes,
     bdrv_inc_in_flight(bs);
 
     /* throttling disk I/O */
-    if (blk->public.throttle_group_member.throttle_state) {
-        throttle_group_co_io_limits_intercept(&blk->public.throttle_group_member,
-                bytes, false);
-    }
+    blk_co_throttle(blk, bytes, false);
 
+    start_ns = block_acct_clock_ns();
     ret = bdrv_co_preadv(blk->root, offset, bytes, qiov, flags);
+    blk_acct_driver_latency(blk, BLOCK_ACCT_READ, start_ns);
     bdrv_dec_in_flight(bs);
     return ret;
 }
@@ -1249,6 +1303,7 @@ blk_do_pwritev_part(BlockBackend *blk, int64_t offset, unsigned int bytes,
                     BdrvRequestFlags flags)
 {
     int ret;
+    int64_t start_ns;
     BlockDriverState *bs;
 
     blk_wait_while_drained(blk);
@@ -1264,17 +1319,16 @@ blk_do_pwritev_part(BlockBackend *blk, int64_t offset, unsigned int bytes,
 
     bdrv_inc_in_flight(bs);
     /* throttling disk I/O */
-    if (blk->public.throttle_group_member.throttle_state) {
-        throttle_group_co_io_limits_intercept(&blk->public.throttle_group_member,
-                bytes, true);
-    }
+    blk_co_throttle(blk, bytes, true);
 
     if (!blk->enable_write_cache) {
         flags |= BDRV_REQ_FUA;
     }
 
+    start_ns = block_acct_clock_ns();
     ret = bdrv_co_pwritev_part(blk->root, offset, bytes, qiov, qiov_offset,
                                flags);
+    blk_acct_driver_latency(blk, BLOCK_ACCT_WRITE, start_ns);
     bdrv_dec_in_flight(bs);
     return ret;
 }
@@ -1306,6 +1360,18 @@ typedef struct BlkRwCo {
     void *iobuf;
     int ret;
     BdrvRequestFlags flags;
+    union {
+        struct {
+            unsigned int *nr_zones;
+            BlockZoneDescriptor *zones;
+        } zone_report;
+        struct {
+            BlockZoneOp op;
+            int64_t len;
+        } zone_mgmt;
+        /* updated with the offset the data was written to */
+        int64_t *zone_append_offset;
+    };
 } BlkRwCo;
 
 static void blk_read_entry(void *opaque)
@@ -1328,6 +1394,25 @@ static void blk_write_entry(void *opaque)
     aio_wait_kick();
 }
 
+static int blk_run_rwco(BlkRwCo *rwco, CoroutineEntry co_entry)
+{
+    BlockBackend *blk = rwco->blk;
+
+    rwco->ret = NOT_DONE;
+    blk_inc_in_flight(blk);
+    if (qemu_in_coroutine()) {
+        /* Fast-path if already in coroutine context */
+        co_entry(rwco);
+    } else {
+        Coroutine *co = qemu_coroutine_create(co_entry, rwco);
+        bdrv_coroutine_enter(blk_bs(blk), co);
+        BDRV_POLL_WHILE(blk_bs(blk), rwco->ret == NOT_DONE);
+    }
+    blk_dec_in_flight(blk);
+
+    return rwco->ret;
+}
+
 static int blk_prw(BlockBackend *blk, int64_t offset, uint8_t *buf,
                    int64_t bytes, CoroutineEntry co_entry,
                    BdrvRequestFlags flags)
@@ -1338,21 +1423,9 @@ static int blk_prw(BlockBackend *blk, int64_t offset, uint8_t *buf,
         .offset = offset,
         .iobuf  = &qiov,
         .flags  = flags,
-        .ret    = NOT_DONE,
     };
 
-    blk_inc_in_flight(blk);
-    if (qemu_in_coroutine()) {
-        /* Fast-path if already in coroutine context */
-        co_entry(&rwco);
-    } else {
-        Coroutine *co = qemu_coroutine_create(co_entry, &rwco);
-        bdrv_coroutine_enter(blk_bs(blk), co);
-        BDRV_POLL_WHILE(blk_bs(blk), rwco.ret == NOT_DONE);
-    }
-    blk_dec_in_flight(blk);
-
-    return rwco.ret;
+    return blk_run_rwco(&rwco, co_entry);
 }
 
 int blk_pwrite_zeroes(BlockBackend *blk, int64_t offset,
@@ -1406,6 +1479,7 @@ BlockAIOCB *blk_abort_aio_request(BlockBackend *blk,
 typedef struct BlkAioEmAIOCB {
     BlockAIOCB common;
     BlkRwCo rwco;
+    AioContext *ctx;    /* where the request runs and completes */
     int bytes;
     bool has_returned;
 } BlkAioEmAIOCB;
@@ -1414,7 +1488,7 @@ static AioContext *blk_aio_em_aiocb_get_aio_context(BlockAIOCB *acb_)
 {
     BlkAioEmAIOCB *acb = container_of(acb_, BlkAioEmAIOCB, common);
 
-    return blk_get_aio_context(acb->rwco.blk);
+    return acb->ctx;
 }
 
 static const AIOCBInfo blk_aio_em_aiocb_info = {
@@ -1438,38 +1512,53 @@ static void blk_aio_complete_bh(void *opaque)
     blk_aio_complete(acb);
 }
 
-static BlockAIOCB *blk_aio_prwv(BlockBackend *blk, int64_t offset, int bytes,
-                                void *iobuf, CoroutineEntry co_entry,
-                                BdrvRequestFlags flags,
+static BlockAIOCB *blk_aio_rwco(const BlkRwCo *rwco, int bytes,
+                                CoroutineEntry co_entry,
                                 BlockCompletionFunc *cb, void *opaque)
 {
+    BlockBackend *blk = rwco->blk;
     BlkAioEmAIOCB *acb;
     Coroutine *co;
 
     blk_inc_in_flight(blk);
     acb = blk_aio_get(&blk_aio_em_aiocb_info, blk, cb, opaque);
-    acb->rwco = (BlkRwCo) {
-        .blk    = blk,
-        .offset = offset,
-        .iobuf  = iobuf,
-        .flags  = flags,
-        .ret    = NOT_DONE,
-    };
+    acb->rwco = *rwco;
+    acb->rwco.ret = NOT_DONE;
+    acb->ctx = blk_get_request_aio_context(blk);
     acb->bytes = bytes;
     acb->has_returned = false;
 
     co = qemu_coroutine_create(co_entry, acb);
-    bdrv_coroutine_enter(blk_bs(blk), co);
+    if (acb->ctx == blk_get_aio_context(blk)) {
+        bdrv_coroutine_enter(blk_bs(blk), co);
+    } else {
+        /* Multiqueue, stay in the submitting thread */
+        aio_co_enter(acb->ctx, co);
+    }
 
     acb->has_returned = true;
     if (acb->rwco.ret != NOT_DONE) {
-        replay_bh_schedule_oneshot_event(blk_get_aio_context(blk),
-                                         blk_aio_complete_bh, acb);
+        replay_bh_schedule_oneshot_event(acb->ctx, blk_aio_complete_bh, acb);
     }
 
     return &acb->common;
 }
 
+static BlockAIOCB *blk_aio_prwv(BlockBackend *blk, int64_t offset, int bytes,
+                                void *iobuf, CoroutineEntry co_entry,
+                                BdrvRequestFlags flags,
+                                BlockCompletionFunc *cb, void *opaque)
+{
+    BlkRwCo rwco = {
+        .blk    = blk,
+        .offset = offset,
+        .iobuf  = iobuf,
+        .flags  = flags,
+    };
+
+    return blk_aio_rwco(&rwco, bytes, co_entry, cb, opaque);
+}
+
 static void blk_aio_read_entry(void *opaque)
 {
     BlkAioEmAIOCB *acb = opaque;
@@ -1623,6 +1712,7 @@ static int coroutine_fn
 blk_do_pdiscard(BlockBackend *blk, int64_t offset, int bytes)
 {
     int ret;
+    int64_t start_ns;
 
     blk_wait_while_drained(blk);
 
@@ -1631,7 +1721,10 @@ blk_do_pdiscard(BlockBackend *blk, int64_t offset, int bytes)
         return ret;
     }
 
-    return bdrv_co_pdiscard(blk->root, offset, bytes);
+    start_ns = block_acct_clock_ns();
+    ret = bdrv_co_pdiscard(blk->root, offset, bytes);
+    blk_acct_driver_latency(blk, BLOCK_ACCT_UNMAP, start_ns);
+    return ret;
 }
 
 static void blk_aio_pdiscard_entry(void *opaque)
@@ -1676,16 +1769,216 @@ int blk_pdiscard(BlockBackend *blk, int64_t offset, int bytes)
     return blk_prw(blk, offset, NULL, bytes, blk_pdiscard_entry, 0);
 }
 
+/* To be called between exactly one pair of blk_inc/dec_in_flight() */
+static int coroutine_fn
+blk_do_zone_report(BlockBackend *blk, int64_t offset,
+                   unsigned int *nr_zones, BlockZoneDescriptor *zones)
+{
+    blk_wait_while_drained(blk);
+
+    if (!blk_is_available(blk)) {
+        return -ENOMEDIUM;
+    }
+
+    return bdrv_co_zone_report(blk_bs(blk), offset, nr_zones, zones);
+}
+
+/* To be called between exactly one pair of blk_inc/dec_in_flight() */
+static int coroutine_fn
+blk_do_zone_mgmt(BlockBackend *blk, BlockZoneOp op, int64_t offset,
+                 int64_t len)
+{
+    int ret;
+
+    blk_wait_while_drained(blk);
+
+    ret = blk_check_byte_request(blk, offset, len);
+    if (ret < 0) {
+        return ret;
+    }
+
+    if (!(blk->perm & BLK_PERM_WRITE)) {
+        return -EPERM;
+    }
+
+    return bdrv_co_zone_mgmt(blk_bs(blk), op, offset, len);
+}
+
+/* To be called between exactly one pair of blk_inc/dec_in_flight() */
+static int coroutine_fn
+blk_do_zone_append(BlockBackend *blk, int64_t *offset, QEMUIOVector *qiov,
+                   BdrvRequestFlags flags)
+{
+    int ret;
+    int64_t start_ns;
+
+    blk_wait_while_drained(blk);
+
+    ret = blk_check_byte_request(blk, *offset, qiov->size);
+    if (ret < 0) {
+        return ret;
+    }
+
+    if (!(blk->perm & BLK_PERM_WRITE)) {
+        return -EPERM;
+    }
+
+    start_ns = block_acct_clock_ns();
+    ret = bdrv_co_zone_append(blk_bs(blk), offset, qiov, flags);
+    blk_acct_driver_latency(blk, BLOCK_ACCT_WRITE, start_ns);
+    return ret;
+}
+
+int coroutine_fn blk_co_zone_report(BlockBackend *blk, int64_t offset,
+                                    unsigned int *nr_zones,
+                                    BlockZoneDescriptor *zones)
+{
+    int ret;
+
+    blk_inc_in_flight(blk);
+    ret = blk_do_zone_report(blk, offset, nr_zones, zones);
+    blk_dec_in_flight(blk);
+
+    return ret;
+}
+
+int coroutine_fn blk_co_zone_mgmt(BlockBackend *blk, BlockZoneOp op,
+                                  int64_t offset, int64_t len)
+{
+    int ret;
+
+    blk_inc_in_flight(blk);
+    ret = blk_do_zone_mgmt(blk, op, offset, len);
+    blk_dec_in_flight(blk);
+
+    return ret;
+}
+
+int coroutine_fn blk_co_zone_append(BlockBackend *blk, int64_t *offset,
+                                    QEMUIOVector *qiov,
+                                    BdrvRequestFlags flags)
+{
+    int ret;
+
+    blk_inc_in_flight(blk);
+    ret = blk_do_zone_append(blk, offset, qiov, flags);
+    blk_dec_in_flight(blk);
+
+    return ret;
+}
+
+static void blk_zone_report_entry(void *opaque)
+{
+    BlkRwCo *rwco = opaque;
+
+    rwco->ret = blk_do_zone_report(rwco->blk, rwco->offset,
+                                   rwco->zone_report.nr_zones,
+                                   rwco->zone_report.zones);
+    aio_wait_kick();
+}
+
+int blk_zone_report(BlockBackend *blk, int64_t offset,
+                    unsigned int *nr_zones, BlockZoneDescriptor *zones)
+{
+    BlkRwCo rwco = {
+        .blk            = blk,
+        .offset         = offset,
+        .zone_report    = { nr_zones, zones },
+    };
+
+    return blk_run_rwco(&rwco, blk_zone_report_entry);
+}
+
+static void blk_aio_zone_report_entry(void *opaque)
+{
+    BlkAioEmAIOCB *acb = opaque;
+    BlkRwCo *rwco = &acb->rwco;
+
+    rwco->ret = blk_do_zone_report(rwco->blk, rwco->offset,
+                                   rwco->zone_report.nr_zones,
+                                   rwco->zone_report.zones);
+    blk_aio_complete(acb);
+}
+
+BlockAIOCB *blk_aio_zone_report(BlockBackend *blk, int64_t offset,
+                                unsigned int *nr_zones,
+                                BlockZoneDescriptor *zones,
+                                BlockCompletionFunc *cb, void *opaque)
+{
+    BlkRwCo rwco = {
+        .blk            = blk,
+        .offset         = offset,
+        .zone_report    = { nr_zones, zones },
+    };
+
+    return blk_aio_rwco(&rwco, 0, blk_aio_zone_report_entry, cb, opaque);
+}
+
+static void blk_aio_zone_mgmt_entry(void *opaque)
+{
+    BlkAioEmAIOCB *acb = opaque;
+    BlkRwCo *rwco = &acb->rwco;
+
+    rwco->ret = blk_do_zone_mgmt(rwco->blk, rwco->zone_mgmt.op,
+                                 rwco->offset, rwco->zone_mgmt.len);
+    blk_aio_complete(acb);
+}
+
+BlockAIOCB *blk_aio_zone_mgmt(BlockBackend *blk, BlockZoneOp op,
+                              int64_t offset, int64_t len,
+                              BlockCompletionFunc *cb, void *opaque)
+{
+    BlkRwCo rwco = {
+        .blk            = blk,
+        .offset         = offset,
+        .zone_mgmt      = { op, len },
+    };
+
+    return blk_aio_rwco(&rwco, 0, blk_aio_zone_mgmt_entry, cb, opaque);
+}
+
+static void blk_aio_zone_append_entry(void *opaque)
+{
+    BlkAioEmAIOCB *acb = opaque;
+    BlkRwCo *rwco = &acb->rwco;
+
+    rwco->ret = blk_do_zone_append(rwco->blk, rwco->zone_append_offset,
+                                   rwco->iobuf, rwco->flags);
+    blk_aio_complete(acb);
+}
+
+BlockAIOCB *blk_aio_zone_append(BlockBackend *blk, int64_t *offset,
+                                QEMUIOVector *qiov, BdrvRequestFlags flags,
+                                BlockCompletionFunc *cb, void *opaque)
+{
+    BlkRwCo rwco = {
+        .blk                = blk,
+        .offset             = *offset,
+        .iobuf              = qiov,
+        .flags              = flags,
+        .zone_append_offset = offset,
+    };
+
+    return blk_aio_rwco(&rwco, qiov->size, blk_aio_zone_append_entry,
+                        cb, opaque);
+}
+
 /* To be called between exactly one pair of blk_inc/dec_in_flight() */
 static int coroutine_fn blk_do_flush(BlockBackend *blk)
 {
+    int ret;
+    int64_t start_ns;
+
     blk_wait_while_drained(blk);
 
     if (!blk_is_available(blk)) {
         return -ENOMEDIUM;
     }
 
-    return bdrv_co_flush(blk_bs(blk));
+    start_ns = block_acct_clock_ns();
+    ret = bdrv_co_flush(blk_bs(blk));
+    blk_acct_driver_latency(blk, BLOCK_ACCT_FLUSH, start_ns);
+    return ret;
 }
 
 static void blk_aio_flush_entry(void *opaque)
@@ -1972,6 +2265,34 @@ int blk_get_max_iov(BlockBackend *blk)
     return blk->root->bs->bl.max_iov;
 }
 
+BlockZoneModel blk_get_zone_model(BlockBackend *blk)
+{
+    BlockDriverState *bs = blk_bs(blk);
+
+    return bs ? bs->bl.zoned : BLK_Z_NONE;
+}
+
+uint64_t blk_get_zone_size(BlockBackend *blk)
+{
+    BlockDriverState *bs = blk_bs(blk);
+
+    return bs ? bs->bl.zone_size : 0;
+}
+
+uint32_t blk_get_max_open_zones(BlockBackend *blk)
+{
+    BlockDriverState *bs = blk_bs(blk);
+
+    return bs ? bs->bl.max_open_zones : 0;
+}
+
+uint32_t blk_get_max_active_zones(BlockBackend *blk)
+{
+    BlockDriverState *bs = blk_bs(blk);
+
+    return bs ? bs->bl.max_active_zones : 0;
+}
+
 void blk_set_guest_block_size(BlockBackend *blk, int align)
 {
     blk->guest_block_size = align;
@@ -2037,6 +2358,85 @@ AioContext *blk_get_aio_context(BlockBackend *blk)
     return blk->ctx;
 }
 
+/*
+ * Return the AioContext in which a request submitted from the current thread
+ * runs and completes: the one of the calling thread if it was added with
+ * blk_enable_multiqueue(), the one of @blk otherwise.
+ */
+AioContext *blk_get_request_aio_context(BlockBackend *blk)
+{
+    AioContext *ctx;
+
+    if (!blk->multiqueue_contexts) {
+        return blk_get_aio_context(blk);
+    }
+
+    ctx = qemu_get_current_aio_context();
+    if (ctx != blk->ctx && g_slist_find(blk->multiqueue_contexts, ctx)) {
+        return ctx;
+    }
+    return blk_get_aio_context(blk);
+}
+
+/*
+ * Let @ctx submit requests to @blk concurrently with the AioContext of @blk.
+ * Requests submitted from a thread running @ctx run and complete in @ctx, so
+ * a device can serve each of its queues from a different IOThread.  All nodes
+ * below @blk must support this and I/O throttling cannot be used.
+ *
+ * Must be called with the BQL and the AioContext of @blk held.
+ */
+int blk_enable_multiqueue(BlockBackend *blk, AioContext *ctx, Error **errp)
+{
+    BlockDriverState *bs = blk_bs(blk);
+
+    if (!bs) {
+        error_setg(errp, "No medium inserted");
+        return -ENOMEDIUM;
+    }
+    if (!bdrv_supports_multiqueue(bs)) {
+        error_setg(errp, "Node '%s' does not support multiqueue",
+                   bdrv_get_node_name(bs));
+        return -ENOTSUP;
+    }
+    if (blk->public.throttle_group_member.throttle_state) {
+        error_setg(errp, "I/O throttling does not support multiqueue");
+        return -ENOTSUP;
+    }
+
+    bdrv_drained_begin(bs);
+    bdrv_add_multiqueue_context(bs, ctx);
+    blk->multiqueue_contexts = g_slist_prepend(blk->multiqueue_contexts, ctx);
+    bdrv_drained_end(bs);
+    return 0;
+}
+
+/*
+ * Undo blk_enable_multiqueue().
+ *
+ * Must be called with the BQL and the AioContext of @blk held.
+ */
+void blk_disable_multiqueue(BlockBackend *blk, AioContext *ctx)
+{
+    BlockDriverState *bs = blk_bs(blk);
+
+    assert(g_slist_find(blk->multiqueue_contexts, ctx));
+
+    if (bs) {
+        bdrv_drained_begin(bs);
+    }
+    blk->multiqueue_contexts = g_slist_remove(blk->multiqueue_contexts, ctx);
+    if (bs) {
+        bdrv_del_multiqueue_context(bs, ctx);
+        bdrv_drained_end(bs);
+    }
+}
+
+bool blk_is_multiqueue(BlockBackend *blk)
+{
+    return blk->multiqueue_contexts != NULL;
+}
+
 static AioContext *blk_aiocb_get_aio_context(BlockAIOCB *acb)
 {
     BlockBackendAIOCB *blk_acb = DO_UPCAST(BlockBackendAIOCB, common, acb);
@@ -2159,24 +2559,6 @@ void blk_add_insert_bs_notifier(BlockBackend *blk, Notifier *notify)
     notifier_list_add(&blk->insert_bs_notifiers, notify);
 }
 
-void blk_io_plug(BlockBackend *blk)
-{
-    BlockDriverState *bs = blk_bs(blk);
-
-    if (bs) {
-        bdrv_io_plug(bs);
-    }
-}
-
-void blk_io_unplug(BlockBackend *blk)
-{
-    BlockDriverState *bs = blk_bs(blk);
-
-    if (bs) {
-        bdrv_io_unplug(bs);
-    }
-}
-
 BlockAcctStats *blk_get_stats(BlockBackend *blk)
 {
     return &blk->stats;
@@ -2350,6 +2732,7 @@ void blk_io_limits_disable(BlockBackend *blk)
 void blk_io_limits_enable(BlockBackend *blk, const char *group)
 {
     assert(!blk->public.throttle_group_member.throttle_state);
+    assert(!blk_is_multiqueue(blk));
     throttle_group_register_tgm(&blk->public.throttle_group_member,
                                 group, blk_get_aio_context(blk));
 }
@@ -2406,14 +2789,19 @@ static void blk_root_drained_end(BdrvChild *child, int *drained_end_counter)
     assert(blk->public.throttle_group_member.io_limits_disabled);
     qatomic_dec(&blk->public.throttle_group_member.io_limits_disabled);
 
+    qemu_mutex_lock(&blk->queued_requests_lock);
     if (--blk->quiesce_counter == 0) {
+        qemu_mutex_unlock(&blk->queued_requests_lock);
         if (blk->dev_ops && blk->dev_ops->drained_end) {
             blk->dev_ops->drained_end(blk->dev_opaque);
         }
-        while (qemu_co_enter_next(&blk->queued_requests, NULL)) {
+        qemu_mutex_lock(&blk->queued_requests_lock);
+        while (qemu_co_enter_next(&blk->queued_requests,
+                                  &blk->queued_requests_lock)) {
             /* Resume all queued requests */
         }
     }
+    qemu_mutex_unlock(&blk->queued_requests_lock);
 }
 
 void blk_register_buf(BlockBackend *blk, void *host, size_t size)
@@ -17,6 +17,7 @@
 #include "trace.h"
 #include "block/block_int.h"
 #include "block/blockjob_int.h"
+#include "block/aio_task.h"
 #include "qapi/error.h"
 #include "qapi/qmp/qerror.h"
 #include "qemu/ratelimit.h"
@@ -29,6 +30,15 @@ enum {
      * contiguous regions of the image is efficient.
      */
     COMMIT_BUFFER_SIZE = 512 * 1024, /* in bytes */
+
+    /*
+     * Chunks grow up to this size while the allocated extents are
+     * contiguous, so that fully allocated images need fewer requests.
+     */
+    COMMIT_MAX_CHUNK = 8 * 1024 * 1024, /* in bytes */
+
+    /* Number of chunks copied in parallel */
+    COMMIT_MAX_WORKERS = 8,
 };
 
 typedef struct CommitBlockJob {
@@ -42,8 +52,22 @@ typedef struct CommitBlockJob {
     bool base_read_only;
     bool chain_frozen;
     char *backing_file_str;
+
+    /* First chunk that failed since the last retry, or INT64_MAX */
+    int64_t error_offset;
+    int error_ret;
+    bool error_in_source;
+    /* Bytes of all chunks that failed since the last retry */
+    int64_t error_bytes;
 } CommitBlockJob;
 
+typedef struct CommitTask {
+    AioTask task;
+    CommitBlockJob *s;
+    int64_t offset;
+    int64_t bytes;
+} CommitTask;
+
 static int commit_prepare(Job *job)
 {
     CommitBlockJob *s = container_of(job, CommitBlockJob, common.job);
@@ -112,14 +136,82 @@ static void commit_clean(Job *job)
     blk_unref(s->top);
 }
 
+static void commit_chunk_failed(CommitBlockJob *s, int64_t offset,
+                                int64_t bytes, int ret, bool error_in_source)
+{
+    s->error_bytes += bytes;
+    if (offset < s->error_offset) {
+        s->error_offset = offset;
+        s->error_ret = ret;
+        s->error_in_source = error_in_source;
+    }
+}
+
+static int coroutine_fn commit_task_entry(AioTask *task)
+{
+    CommitTask *t = container_of(task, CommitTask, task);
+    CommitBlockJob *s = t->s;
+    bool error_in_source = true;
+    void *buf;
+    int ret;
+
+    buf = blk_blockalign(s->top, t->bytes);
+    ret = blk_co_pread(s->top, t->offset, t->bytes, buf, 0);
+    if (ret >= 0) {
+        ret = blk_co_pwrite(s->base, t->offset, t->bytes, buf, 0);
+        if (ret < 0) {
+            error_in_source = false;
+        }
+    }
+    qemu_vfree(buf);
+
+    if (ret < 0) {
+        commit_chunk_failed(s, t->offset, t->bytes, ret, error_in_source);
+        return ret;
+    }
+    job_progress_update(&s->common.job, t->bytes);
+    return 0;
+}
+
+/*
+ * Wait for the chunks in flight after a failure, then either fail the job
+ * or go back to the first chunk that failed.  The chunks that were copied
+ * after it are copied again, so their size is added to the remaining work.
+ */
+static int coroutine_fn commit_handle_error(CommitBlockJob *s,
+                                            AioTaskPool **pool,
+                                            int64_t *offset)
+{
+    BlockErrorAction action;
+
+    aio_task_pool_wait_all(*pool);
+    action = block_job_error_action(&s->common, s->on_error,
+                                    s->error_in_source, -s->error_ret);
+    if (action == BLOCK_ERROR_ACTION_REPORT) {
+        return s->error_ret;
+    }
+
+    job_progress_increase_remaining(&s->common.job, *offset - s->error_offset -
+                                                    s->error_bytes);
+    *offset = s->error_offset;
+    s->error_offset = INT64_MAX;
+    s->error_bytes = 0;
+
+    /* The pool remembers the error, start over with a new one */
+    aio_task_pool_free(*pool);
+    *pool = aio_task_pool_new(COMMIT_MAX_WORKERS);
+    return 0;
+}
+
 static int coroutine_fn commit_run(Job *job, Error **errp)
 {
     CommitBlockJob *s = container_of(job, CommitBlockJob, common.job);
-    int64_t offset;
+    AioTaskPool *pool = NULL;
+    int64_t offset = 0;
+    int64_t chunk = COMMIT_BUFFER_SIZE;
     uint64_t delay_ns = 0;
     int ret = 0;
     int64_t n = 0; /* bytes */
-    void *buf = NULL;
     int64_t len, base_len;
 
     ret = len = blk_getlength(s->top);
@@ -140,11 +232,24 @@ static int coroutine_fn commit_run(Job *job, Error **errp)
         }
     }
 
-    buf = blk_blockalign(s->top, COMMIT_BUFFER_SIZE);
+    pool = aio_task_pool_new(COMMIT_MAX_WORKERS);
+    s->error_offset = INT64_MAX;
 
-    for (offset = 0; offset < len; offset += n) {
+    while (true) {
         bool copy;
-        bool error_in_source = true;
+
+        if (offset >= len) {
+            aio_task_pool_wait_all(pool);
+        }
+        if (s->error_offset != INT64_MAX) {
+            ret = commit_handle_error(s, &pool, &offset);
+            if (ret < 0) {
+                goto out;
+            }
+        }
+        if (offset >= len) {
+            break;
+        }
 
         /* Note that even when no rate limit is applied we need to yield
          * with no pending I/O here so that bdrv_drain_all() returns.
@@ -155,45 +260,45 @@ static int coroutine_fn commit_run(Job *job, Error **errp)
         }
         /* Copy if allocated above the base */
         ret = bdrv_is_allocated_above(blk_bs(s->top), s->base_overlay, true,
-                                      offset, COMMIT_BUFFER_SIZE, &n);
+                                      offset, chunk, &n);
         copy = (ret > 0);
         trace_commit_one_iteration(s, offset, n, ret);
-        if (copy) {
-            assert(n < SIZE_MAX);
-
-            ret = blk_co_pread(s->top, offset, n, buf, 0);
-            if (ret >= 0) {
-                ret = blk_co_pwrite(s->base, offset, n, buf, 0);
-                if (ret < 0) {
-                    error_in_source = false;
-                }
-            }
-        }
         if (ret < 0) {
-            BlockErrorAction action =
-                block_job_error_action(&s->common, s->on_error,
-                                       error_in_source, -ret);
-            if (action == BLOCK_ERROR_ACTION_REPORT) {
-                goto out;
-            } else {
-                n = 0;
-                continue;
-            }
+            commit_chunk_failed(s, offset, 0, ret, true);
+            continue;
         }
-        /* Publish progress */
-        job_progress_update(&s->common.job, n);
 
         if (copy) {
+            CommitTask *t = g_new(CommitTask, 1);
+
+            assert(n < SIZE_MAX);
+            *t = (CommitTask) {
+                .task.func = commit_task_entry,
+                .s = s,
+                .offset = offset,
+                .bytes = n,
+            };
+            aio_task_pool_start_task(pool, &t->task);
+
+            /* Use larger chunks while the allocated extents are large */
+            chunk = n == chunk ? MIN(chunk * 2, COMMIT_MAX_CHUNK)
+                               : COMMIT_BUFFER_SIZE;
             delay_ns = block_job_ratelimit_get_delay(&s->common, n);
         } else {
+            /* Publish progress */
+            job_progress_update(&s->common.job, n);
             delay_ns = 0;
         }
+        offset += n;
     }
 
     ret = 0;
 
 out:
-    qemu_vfree(buf);
+    if (pool) {
+        aio_task_pool_wait_all(pool);
+        aio_task_pool_free(pool);
+    }
 
     return ret;
 }
@@ -21,7 +21,9 @@
 #include "qemu/osdep.h"
 
 #include "block/block_int.h"
+#include "block/aio_task.h"
 #include "block/qdict.h"
+#include "block/thread-pool.h"
 #include "sysemu/block-backend.h"
 #include "crypto/block.h"
 #include "qapi/opts-visitor.h"
@@ -35,9 +37,18 @@
 
 typedef struct BlockCrypto BlockCrypto;
 
+/* Cipher instances, and so parallel encryption jobs, per image */
+#define BLOCK_CRYPTO_MAX_THREADS 4
+
 struct BlockCrypto {
     QCryptoBlock *block;
     bool updating_keys;
+
+    /* Encryption jobs are run here, at most BLOCK_CRYPTO_MAX_THREADS */
+    ThreadPool *thread_pool;
+    CoMutex lock;
+    CoQueue thread_task_queue;
+    int nb_threads;
 };
 
 
@@ -294,7 +305,7 @@ static int block_crypto_open_generic(QCryptoBlockFormat format,
                                        block_crypto_read_func,
                                        bs,
                                        cflags,
-                                       1,
+                                       BLOCK_CRYPTO_MAX_THREADS,
                                        errp);
 
     if (!crypto->block) {
@@ -303,6 +314,8 @@ static int block_crypto_open_generic(QCryptoBlockFormat format,
     }
 
     bs->encrypted = true;
+    qemu_co_mutex_init(&crypto->lock);
+    qemu_co_queue_init(&crypto->thread_task_queue);
 
     ret = 0;
  cleanup:
@@ -380,9 +393,21 @@ block_crypto_co_truncate(BlockDriverState *bs, int64_t offset, bool exact,
 static void block_crypto_close(BlockDriverState *bs)
 {
     BlockCrypto *crypto = bs->opaque;
+
+    thread_pool_free(crypto->thread_pool);
+    crypto->thread_pool = NULL;
     qcrypto_block_free(crypto->block);
 }
 
+static void block_crypto_detach_aio_context(BlockDriverState *bs)
+{
+    BlockCrypto *crypto = bs->opaque;
+
+    /* Created again in the new AioContext when it is needed */
+    thread_pool_free(crypto->thread_pool);
+    crypto->thread_pool = NULL;
+}
+
 static int block_crypto_reopen_prepare(BDRVReopenState *state,
                                        BlockReopenQueue *queue, Error **errp)
 {
@@ -391,136 +416,262 @@ static int block_crypto_reopen_prepare(BDRVReopenState *state,
 }
 
 /*
- * 1 MB bounce buffer gives good performance / memory tradeoff
- * when using cache=none|directsync.
+ * Requests are split into chunks of this size, each with its own bounce
+ * buffer, which are encrypted in the thread pool and written (or read
+ * and decrypted) in parallel; the cipher work of one chunk then overlaps
+ * the I/O of the others.  BLOCK_CRYPTO_MAX_WORKERS chunks in flight keep
+ * to the memory of the single 1 MB bounce buffer that gave good
+ * performance with cache=none|directsync.
  */
-#define BLOCK_CRYPTO_MAX_IO_SIZE (1024 * 1024)
+#define BLOCK_CRYPTO_CHUNK_SIZE (256 * 1024)
+#define BLOCK_CRYPTO_MAX_WORKERS BLOCK_CRYPTO_MAX_THREADS
 
-static coroutine_fn int
-block_crypto_co_preadv(BlockDriverState *bs, uint64_t offset, uint64_t bytes,
-                       QEMUIOVector *qiov, int flags)
+/*
+ * BlockCryptoEncDecFunc: common prototype of qcrypto_block_encrypt() and
+ * qcrypto_block_decrypt() functions.
+ */
+typedef int (*BlockCryptoEncDecFunc)(QCryptoBlock *block, uint64_t offset,
+                                     uint8_t *buf, size_t len, Error **errp);
+
+typedef struct BlockCryptoEncDecData {
+    QCryptoBlock *block;
+    uint64_t offset;
+    uint8_t *buf;
+    size_t len;
+
+    BlockCryptoEncDecFunc func;
+} BlockCryptoEncDecData;
+
+static int block_crypto_encdec_pool_func(void *opaque)
+{
+    BlockCryptoEncDecData *data = opaque;
+
+    return data->func(data->block, data->offset, data->buf, data->len, NULL);
+}
+
+/*
+ * Run @func on @buf in the image's thread pool.  There are only
+ * BLOCK_CRYPTO_MAX_THREADS ciphers, see qcrypto_block_open(), so at
+ * most that many jobs of this image run at the same time.
+ */
+static int coroutine_fn
+block_crypto_co_encdec(BlockDriverState *bs, uint64_t offset,
+                       uint8_t *buf, size_t len, BlockCryptoEncDecFunc func)
 {
     BlockCrypto *crypto = bs->opaque;
-    uint64_t cur_bytes; /* number of bytes in current iteration */
-    uint64_t bytes_done = 0;
-    uint8_t *cipher_data = NULL;
-    QEMUIOVector hd_qiov;
-    int ret = 0;
-    uint64_t sector_size = qcrypto_block_get_sector_size(crypto->block);
-    uint64_t payload_offset = qcrypto_block_get_payload_offset(crypto->block);
+    BlockCryptoEncDecData arg = {
+        .block = crypto->block,
+        .offset = offset,
+        .buf = buf,
+        .len = len,
+        .func = func,
+    };
+    int ret;
 
-    assert(!flags);
-    assert(payload_offset < INT64_MAX);
-    assert(QEMU_IS_ALIGNED(offset, sector_size));
-    assert(QEMU_IS_ALIGNED(bytes, sector_size));
+    qemu_co_mutex_lock(&crypto->lock);
+    while (crypto->nb_threads >= BLOCK_CRYPTO_MAX_THREADS) {
+        qemu_co_queue_wait(&crypto->thread_task_queue, &crypto->lock);
+    }
+    crypto->nb_threads++;
+    if (!crypto->thread_pool) {
+        crypto->thread_pool = thread_pool_new(bdrv_get_aio_context(bs));
+    }
+    qemu_co_mutex_unlock(&crypto->lock);
 
-    qemu_iovec_init(&hd_qiov, qiov->niov);
+    ret = thread_pool_submit_co(crypto->thread_pool,
+                                block_crypto_encdec_pool_func, &arg);
 
-    /* Bounce buffer because we don't wish to expose cipher text
-     * in qiov which points to guest memory.
-     */
-    cipher_data =
-        qemu_try_blockalign(bs->file->bs, MIN(BLOCK_CRYPTO_MAX_IO_SIZE,
-                                              qiov->size));
-    if (cipher_data == NULL) {
-        ret = -ENOMEM;
-        goto cleanup;
+    qemu_co_mutex_lock(&crypto->lock);
+    crypto->nb_threads--;
+    qemu_co_queue_next(&crypto->thread_task_queue);
+    qemu_co_mutex_unlock(&crypto->lock);
+
+    return ret < 0 ? -EIO : 0;
+}
+
+typedef struct BlockCryptoAioTask {
+    AioTask task;
+
+    BlockDriverState *bs;
+    uint64_t offset;
+    uint64_t bytes;
+    QEMUIOVector *qiov;
+    uint64_t qiov_offset;
+    int flags; /* only for write */
+} BlockCryptoAioTask;
+
+static coroutine_fn int block_crypto_add_task(BlockDriverState *bs,
+                                              AioTaskPool *pool,
+                                              AioTaskFunc func,
+                                              uint64_t offset,
+                                              uint64_t bytes,
+                                              QEMUIOVector *qiov,
+                                              uint64_t qiov_offset,
+                                              int flags)
+{
+    BlockCryptoAioTask local_task;
+    BlockCryptoAioTask *task = pool ? g_new(BlockCryptoAioTask, 1)
+                                    : &local_task;
+
+    *task = (BlockCryptoAioTask) {
+        .task.func = func,
+        .bs = bs,
+        .offset = offset,
+        .bytes = bytes,
+        .qiov = qiov,
+        .qiov_offset = qiov_offset,
+        .flags = flags,
+    };
+
+    if (!pool) {
+        return func(&task->task);
     }
 
-    while (bytes) {
-        cur_bytes = MIN(bytes, BLOCK_CRYPTO_MAX_IO_SIZE);
+    aio_task_pool_start_task(pool, &task->task);
 
-        qemu_iovec_reset(&hd_qiov);
-        qemu_iovec_add(&hd_qiov, cipher_data, cur_bytes);
+    return 0;
+}
 
-        ret = bdrv_co_preadv(bs->file, payload_offset + offset + bytes_done,
-                             cur_bytes, &hd_qiov, 0);
-        if (ret < 0) {
-            goto cleanup;
-        }
+static coroutine_fn int block_crypto_co_preadv_task_entry(AioTask *task)
+{
+    BlockCryptoAioTask *t = container_of(task, BlockCryptoAioTask, task);
+    BlockDriverState *bs = t->bs;
+    BlockCrypto *crypto = bs->opaque;
+    uint64_t payload_offset = qcrypto_block_get_payload_offset(crypto->block);
+    uint8_t *cipher_data;
+    int ret;
 
-        if (qcrypto_block_decrypt(crypto->block, offset + bytes_done,
-                                  cipher_data, cur_bytes, NULL) < 0) {
-            ret = -EIO;
-            goto cleanup;
-        }
+    /* Bounce buffer because we don't wish to expose cipher text
+     * in qiov which points to guest memory.
+     */
+    cipher_data = qemu_try_blockalign(bs->file->bs, t->bytes);
+    if (cipher_data == NULL) {
+        return -ENOMEM;
+    }
 
-        qemu_iovec_from_buf(qiov, bytes_done, cipher_data, cur_bytes);
+    ret = bdrv_co_pread(bs->file, payload_offset + t->offset, t->bytes,
+                        cipher_data, 0);
+    if (ret < 0) {
+        goto cleanup;
+    }
 
-        bytes -= cur_bytes;
-        bytes_done += cur_bytes;
+    ret = block_crypto_co_encdec(bs, t->offset, cipher_data, t->bytes,
+                                 qcrypto_block_decrypt);
+    if (ret < 0) {
+        goto cleanup;
     }
 
+    qemu_iovec_from_buf(t->qiov, t->qiov_offset, cipher_data, t->bytes);
+
  cleanup:
-    qemu_iovec_destroy(&hd_qiov);
     qemu_vfree(cipher_data);
-
     return ret;
 }
 
-
-static coroutine_fn int
-block_crypto_co_pwritev(BlockDriverState *bs, uint64_t offset, uint64_t bytes,
-                        QEMUIOVector *qiov, int flags)
+static coroutine_fn int block_crypto_co_pwritev_task_entry(AioTask *task)
 {
+    BlockCryptoAioTask *t = container_of(task, BlockCryptoAioTask, task);
+    BlockDriverState *bs = t->bs;
     BlockCrypto *crypto = bs->opaque;
-    uint64_t cur_bytes; /* number of bytes in current iteration */
-    uint64_t bytes_done = 0;
-    uint8_t *cipher_data = NULL;
-    QEMUIOVector hd_qiov;
-    int ret = 0;
-    uint64_t sector_size = qcrypto_block_get_sector_size(crypto->block);
     uint64_t payload_offset = qcrypto_block_get_payload_offset(crypto->block);
-
-    assert(!(flags & ~BDRV_REQ_FUA));
-    assert(payload_offset < INT64_MAX);
-    assert(QEMU_IS_ALIGNED(offset, sector_size));
-    assert(QEMU_IS_ALIGNED(bytes, sector_size));
-
-    qemu_iovec_init(&hd_qiov, qiov->niov);
+    uint8_t *cipher_data;
+    int ret;
 
     /* Bounce buffer because we're not permitted to touch
      * contents of qiov - it points to guest memory.
      */
-    cipher_data =
-        qemu_try_blockalign(bs->file->bs, MIN(BLOCK_CRYPTO_MAX_IO_SIZE,
-                                              qiov->size));
+    cipher_data = qemu_try_blockalign(bs->file->bs, t->bytes);
     if (cipher_data == NULL) {
-        ret = -ENOMEM;
+        return -ENOMEM;
+    }
+
+    qemu_iovec_to_buf(t->qiov, t->qiov_offset, cipher_data, t->bytes);
+
+    ret = block_crypto_co_encdec(bs, t->offset, cipher_data, t->bytes,
+                                 qcrypto_block_encrypt);
+    if (ret < 0) {
         goto cleanup;
     }
 
-    while (bytes) {
-        cur_bytes = MIN(bytes, BLOCK_CRYPTO_MAX_IO_SIZE);
+    ret = bdrv_co_pwrite(bs->file, payload_offset + t->offset, t->bytes,
+                         cipher_data, t->flags);
 
-        qemu_iovec_to_buf(qiov, bytes_done, cipher_data, cur_bytes);
+ cleanup:
+    qemu_vfree(cipher_data);
+    return ret;
+}
 
-        if (qcrypto_block_encrypt(crypto->block, offset + bytes_done,
-                                  cipher_data, cur_bytes, NULL) < 0) {
-            ret = -EIO;
-            goto cleanup;
-        }
+static coroutine_fn int
+block_crypto_co_prwv(BlockDriverState *bs, uint64_t offset, uint64_t bytes,
+                     QEMUIOVector *qiov, int flags, AioTaskFunc func)
+{
+    uint64_t cur_bytes; /* number of bytes in current iteration */
+    uint64_t bytes_done = 0;
+    AioTaskPool *aio = NULL;
+    int ret = 0;
 
-        qemu_iovec_reset(&hd_qiov);
-        qemu_iovec_add(&hd_qiov, cipher_data, cur_bytes);
+    while (bytes && aio_task_pool_status(aio) == 0) {
+        cur_bytes = MIN(bytes, BLOCK_CRYPTO_CHUNK_SIZE);
 
-        ret = bdrv_co_pwritev(bs->file, payload_offset + offset + bytes_done,
-                              cur_bytes, &hd_qiov, flags);
+        if (!aio && cur_bytes != bytes) {
+            aio = aio_task_pool_new(BLOCK_CRYPTO_MAX_WORKERS);
+        }
+        ret = block_crypto_add_task(bs, aio, func, offset + bytes_done,
+                                    cur_bytes, qiov, bytes_done, flags);
         if (ret < 0) {
-            goto cleanup;
+            break;
         }
 
         bytes -= cur_bytes;
         bytes_done += cur_bytes;
     }
 
- cleanup:
-    qemu_iovec_destroy(&hd_qiov);
-    qemu_vfree(cipher_data);
+    if (aio) {
+        aio_task_pool_wait_all(aio);
+        if (ret == 0) {
+            ret = aio_task_pool_status(aio);
+        }
+        g_free(aio);
+    }
 
     return ret;
 }
 
+static coroutine_fn int
+block_crypto_co_preadv(BlockDriverState *bs, uint64_t offset, uint64_t bytes,
+                       QEMUIOVector *qiov, int flags)
+{
+    BlockCrypto *crypto = bs->opaque;
+    uint64_t sector_size = qcrypto_block_get_sector_size(crypto->block);
+    uint64_t payload_offset = qcrypto_block_get_payload_offset(crypto->block);
+
+    assert(!flags);
+    assert(payload_offset < INT64_MAX);
+    assert(QEMU_IS_ALIGNED(offset, sector_size));
+    assert(QEMU_IS_ALIGNED(bytes, sector_size));
+
+    return block_crypto_co_prwv(bs, offset, bytes, qiov, 0,
+                                block_crypto_co_preadv_task_entry);
+}
+
+
+static coroutine_fn int
+block_crypto_co_pwritev(BlockDriverState *bs, uint64_t offset, uint64_t bytes,
+                        QEMUIOVector *qiov, int flags)
+{
+    BlockCrypto *crypto = bs->opaque;
+    uint64_t sector_size = qcrypto_block_get_sector_size(crypto->block);
+    uint64_t payload_offset = qcrypto_block_get_payload_offset(crypto->block);
+
+    assert(!(flags & ~BDRV_REQ_FUA));
+    assert(payload_offset < INT64_MAX);
+    assert(QEMU_IS_ALIGNED(offset, sector_size));
+    assert(QEMU_IS_ALIGNED(bytes, sector_size));
+
+    return block_crypto_co_prwv(bs, offset, bytes, qiov, flags,
+                                block_crypto_co_pwritev_task_entry);
+}
+
 static void block_crypto_refresh_limits(BlockDriverState *bs, Error **errp)
 {
     BlockCrypto *crypto = bs->opaque;
@@ -914,6 +1065,7 @@ static BlockDriver bdrv_crypto_luks = {
     .bdrv_probe         = block_crypto_probe_luks,
     .bdrv_open          = block_crypto_open_luks,
     .bdrv_close         = block_crypto_close,
+    .bdrv_detach_aio_context = block_crypto_detach_aio_context,
     .bdrv_child_perm    = block_crypto_child_perms,
     .bdrv_co_create     = block_crypto_co_create_luks,
     .bdrv_co_create_opts = block_crypto_co_create_opts_luks,
@@ -40,10 +40,13 @@
 #define PROTOCOLS (CURLPROTO_HTTP | CURLPROTO_HTTPS | \
                    CURLPROTO_FTP | CURLPROTO_FTPS)
 
-#define CURL_NUM_STATES 8
+#define CURL_NUM_STATES_MAX 64
 #define CURL_NUM_ACB    8
 #define CURL_TIMEOUT_MAX 10000
 
+/* Reads that must follow each other before prefetching starts */
+#define CURL_SEQ_READS_BEFORE_PREFETCH 2
+
 #define CURL_BLOCK_OPT_URL       "url"
 #define CURL_BLOCK_OPT_READAHEAD "readahead"
 #define CURL_BLOCK_OPT_SSLVERIFY "sslverify"
@@ -54,10 +57,14 @@
 #define CURL_BLOCK_OPT_PASSWORD_SECRET "password-secret"
 #define CURL_BLOCK_OPT_PROXY_USERNAME "proxy-username"
 #define CURL_BLOCK_OPT_PROXY_PASSWORD_SECRET "proxy-password-secret"
+#define CURL_BLOCK_OPT_CONNECTIONS "connections"
+#define CURL_BLOCK_OPT_PREFETCH "prefetch"
 
 #define CURL_BLOCK_OPT_READAHEAD_DEFAULT (256 * 1024)
 #define CURL_BLOCK_OPT_SSLVERIFY_DEFAULT true
 #define CURL_BLOCK_OPT_TIMEOUT_DEFAULT 5
+#define CURL_BLOCK_OPT_CONNECTIONS_DEFAULT 8
+#define CURL_BLOCK_OPT_PREFETCH_DEFAULT 4
 
 struct BDRVCURLState;
 struct CURLState;
@@ -93,16 +100,24 @@ typedef struct CURLState
     char range[128];
     char errmsg[CURL_ERROR_SIZE];
     char in_use;
+    bool prefetch;      /* the request was not started by a guest read */
+    uint64_t last_used; /* for picking the least recently used buffer */
 } CURLState;
 
 typedef struct BDRVCURLState {
     CURLM *multi;
     QEMUTimer timer;
     uint64_t len;
-    CURLState states[CURL_NUM_STATES];
+    CURLState *states;
+    int num_states;
     GHashTable *sockets; /* GINT_TO_POINTER(fd) -> socket */
     char *url;
     size_t readahead_size;
+    int prefetch;       /* maximum number of prefetch requests in flight */
+    int num_prefetch;   /* prefetch requests in flight */
+    uint64_t last_end;  /* end of the last read, to detect sequential reads */
+    int seq_reads;
+    uint64_t use_counter;
     bool sslverify;
     uint64_t timeout;
     char *cookie;
@@ -269,7 +284,7 @@ static bool curl_find_buf(BDRVCURLState *s, uint64_t start, uint64_t len,
     uint64_t clamped_end = MIN(end, s->len);
     uint64_t clamped_len = clamped_end - start;
 
-    for (i=0; i<CURL_NUM_STATES; i++) {
+    for (i = 0; i < s->num_states; i++) {
         CURLState *state = &s->states[i];
         uint64_t buf_end = (state->buf_start + state->buf_off);
         uint64_t buf_fend = (state->buf_start + state->buf_len);
@@ -292,6 +307,7 @@ static bool curl_find_buf(BDRVCURLState *s, uint64_t start, uint64_t len,
                 qemu_iovec_memset(acb->qiov, clamped_len, 0, len - clamped_len);
             }
             acb->ret = 0;
+            state->last_used = ++s->use_counter;
             return true;
         }
 
@@ -310,6 +326,7 @@ static bool curl_find_buf(BDRVCURLState *s, uint64_t start, uint64_t len,
             for (j=0; j<CURL_NUM_ACB; j++) {
                 if (!state->acb[j]) {
                     state->acb[j] = acb;
+                    state->last_used = ++s->use_counter;
                     return true;
                 }
             }
@@ -354,6 +371,9 @@ static void curl_multi_check_completion(BDRVCURLState *s)
                         error_report("curl: further errors suppressed");
                     }
                 }
+
+                /* Don't serve later reads from an incomplete buffer */
+                state->buf_off = 0;
             }
 
             for (i = 0; i < CURL_NUM_ACB; i++) {
@@ -440,13 +460,16 @@ static CURLState *curl_find_state(BDRVCURLState *s)
     CURLState *state = NULL;
     int i;
 
-    for (i = 0; i < CURL_NUM_STATES; i++) {
-        if (!s->states[i].in_use) {
+    /* Reuse the free state whose buffer was used least recently */
+    for (i = 0; i < s->num_states; i++) {
+        if (!s->states[i].in_use &&
+            (!state || s->states[i].last_used < state->last_used)) {
             state = &s->states[i];
-            state->in_use = 1;
-            break;
         }
     }
+    if (state) {
+        state->in_use = 1;
+    }
     return state;
 }
 
@@ -502,6 +525,19 @@ static int curl_init_state(BDRVCURLState *s, CURLState *state)
         curl_easy_setopt(state->curl, CURLOPT_REDIR_PROTOCOLS, PROTOCOLS);
 #endif
 
+        /*
+         * Prefer HTTP/2 over TLS, and let new requests wait for a
+         * connection that they can be multiplexed on rather than opening
+         * another one.
+         */
+#if LIBCURL_VERSION_NUM >= 0x072b00
+        curl_easy_setopt(state->curl, CURLOPT_PIPEWAIT, 1L);
+#endif
+#if LIBCURL_VERSION_NUM >= 0x072f00
+        curl_easy_setopt(state->curl, CURLOPT_HTTP_VERSION,
+                         (long)CURL_HTTP_VERSION_2TLS);
+#endif
+
 #ifdef DEBUG_VERBOSE
         curl_easy_setopt(state->curl, CURLOPT_VERBOSE, 1);
 #endif
@@ -523,6 +559,10 @@ static void curl_clean_state(CURLState *s)
     if (s->s->multi)
         curl_multi_remove_handle(s->s->multi, s->curl);
 
+    if (s->prefetch) {
+        s->prefetch = false;
+        s->s->num_prefetch--;
+    }
     s->in_use = 0;
 
     qemu_co_enter_next(&s->s->free_state_waitq, &s->s->mutex);
@@ -541,7 +581,7 @@ static void curl_detach_aio_context(BlockDriverState *bs)
 
     WITH_QEMU_LOCK_GUARD(&s->mutex) {
         curl_drop_all_sockets(s->sockets);
-        for (i = 0; i < CURL_NUM_STATES; i++) {
+        for (i = 0; i < s->num_states; i++) {
             if (s->states[i].in_use) {
                 curl_clean_state(&s->states[i]);
             }
@@ -576,6 +616,9 @@ static void curl_attach_aio_context(BlockDriverState *bs,
     curl_multi_setopt(s->multi, CURLMOPT_SOCKETFUNCTION, curl_sock_cb);
     curl_multi_setopt(s->multi, CURLMOPT_TIMERDATA, s);
     curl_multi_setopt(s->multi, CURLMOPT_TIMERFUNCTION, curl_timer_cb);
+#if LIBCURL_VERSION_NUM >= 0x072b00
+    curl_multi_setopt(s->multi, CURLMOPT_PIPELINING, (long)CURLPIPE_MULTIPLEX);
+#endif
 }
 
 static QemuOptsList runtime_opts = {
@@ -632,6 +675,17 @@ static QemuOptsList runtime_opts = {
             .type = QEMU_OPT_STRING,
             .help = "ID of secret used as password for HTTP proxy auth",
         },
+        {
+            .name = CURL_BLOCK_OPT_CONNECTIONS,
+            .type = QEMU_OPT_NUMBER,
+            .help = "Maximum number of concurrent requests",
+        },
+        {
+            .name = CURL_BLOCK_OPT_PREFETCH,
+            .type = QEMU_OPT_NUMBER,
+            .help = "Maximum number of readahead requests for sequential "
+                    "reads",
+        },
         { /* end of list */ }
     },
 };
@@ -687,6 +741,22 @@ static int curl_open(BlockDriverState *bs, QDict *options, int flags,
         goto out_noclean;
     }
 
+    s->num_states = qemu_opt_get_number(opts, CURL_BLOCK_OPT_CONNECTIONS,
+                                        CURL_BLOCK_OPT_CONNECTIONS_DEFAULT);
+    if (s->num_states < 1 || s->num_states > CURL_NUM_STATES_MAX) {
+        error_setg(errp, "connections must be between 1 and %d",
+                   CURL_NUM_STATES_MAX);
+        goto out_noclean;
+    }
+
+    s->prefetch = qemu_opt_get_number(opts, CURL_BLOCK_OPT_PREFETCH,
+                                      MIN(CURL_BLOCK_OPT_PREFETCH_DEFAULT,
+                                          s->num_states - 1));
+    if (s->prefetch < 0 || s->prefetch >= s->num_states) {
+        error_setg(errp, "prefetch must be less than connections");
+        goto out_noclean;
+    }
+
     s->sslverify = qemu_opt_get_bool(opts, CURL_BLOCK_OPT_SSLVERIFY,
                                      CURL_BLOCK_OPT_SSLVERIFY_DEFAULT);
 
@@ -748,6 +818,7 @@ static int curl_open(BlockDriverState *bs, QDict *options, int flags,
     s->aio_context = bdrv_get_aio_context(bs);
     s->url = g_strdup(file);
     s->sockets = g_hash_table_new_full(NULL, NULL, NULL, g_free);
+    s->states = g_new0(CURLState, s->num_states);
     qemu_mutex_lock(&s->mutex);
     state = curl_find_state(s);
     qemu_mutex_unlock(&s->mutex);
@@ -821,28 +892,127 @@ out_noclean:
     g_free(s->username);
     g_free(s->proxyusername);
     g_free(s->proxypassword);
+    g_free(s->states);
     curl_drop_all_sockets(s->sockets);
     g_hash_table_destroy(s->sockets);
     qemu_opts_del(opts);
     return -EINVAL;
 }
 
+/*
+ * Start reading [@start, @start + @len) into the buffer of @state.
+ * Called with s->mutex held.
+ */
+static int curl_start_request(BDRVCURLState *s, CURLState *state,
+                              uint64_t start, uint64_t len)
+{
+    uint64_t end = start + len - 1;
+
+    if (curl_init_state(s, state) < 0) {
+        return -EIO;
+    }
+
+    state->buf_off = 0;
+    g_free(state->orig_buf);
+    state->buf_start = start;
+    state->buf_len = len;
+    state->orig_buf = g_try_malloc(state->buf_len);
+    if (state->buf_len && state->orig_buf == NULL) {
+        return -ENOMEM;
+    }
+    state->last_used = ++s->use_counter;
+
+    snprintf(state->range, 127, "%" PRIu64 "-%" PRIu64, start, end);
+    curl_easy_setopt(state->curl, CURLOPT_RANGE, state->range);
+
+    if (curl_multi_add_handle(s->multi, state->curl) != CURLM_OK) {
+        return -EIO;
+    }
+    return 0;
+}
+
+/*
+ * Return the end of the buffer that holds or is being filled with the
+ * data at @pos, or @pos if there is none.  Called with s->mutex held.
+ */
+static uint64_t curl_buffered_end(BDRVCURLState *s, uint64_t pos)
+{
+    int i;
+
+    for (i = 0; i < s->num_states; i++) {
+        CURLState *state = &s->states[i];
+        uint64_t buf_end = state->buf_start +
+                           (state->in_use ? state->buf_len : state->buf_off);
+
+        if (state->orig_buf && pos >= state->buf_start && pos < buf_end) {
+            return buf_end;
+        }
+    }
+    return pos;
+}
+
+/*
+ * The guest is reading sequentially: keep up to s->prefetch readahead
+ * windows after @pos in flight, so that the link is busy while the guest
+ * consumes the data.  Called with s->mutex held.
+ */
+static void curl_prefetch(BDRVCURLState *s, uint64_t pos)
+{
+    uint64_t limit = MIN(pos + s->prefetch * s->readahead_size, s->len);
+
+    if (!s->readahead_size) {
+        return;
+    }
+
+    while (pos < limit && s->num_prefetch < s->prefetch) {
+        uint64_t end = curl_buffered_end(s, pos);
+        CURLState *state;
+        uint64_t len;
+
+        if (end > pos) {
+            pos = end;
+            continue;
+        }
+
+        state = curl_find_state(s);
+        if (!state) {
+            break;
+        }
+        len = MIN(s->readahead_size, s->len - pos);
+        if (curl_start_request(s, state, pos, len) < 0) {
+            curl_clean_state(state);
+            break;
+        }
+        trace_curl_prefetch(pos, state->range);
+        state->prefetch = true;
+        s->num_prefetch++;
+        pos += len;
+    }
+}
+
 static void curl_setup_preadv(BlockDriverState *bs, CURLAIOCB *acb)
 {
     CURLState *state;
     int running;
+    int ret;
 
     BDRVCURLState *s = bs->opaque;
 
     uint64_t start = acb->offset;
-    uint64_t end;
 
     qemu_mutex_lock(&s->mutex);
 
+    if (start == s->last_end) {
+        s->seq_reads++;
+    } else {
+        s->seq_reads = 0;
+    }
+    s->last_end = start + acb->bytes;
+
     // In case we have the requested data already (e.g. read-ahead),
     // we can just call the callback and be done.
     if (curl_find_buf(s, start, acb->bytes, acb)) {
-        goto out;
+        goto prefetch;
     }
 
     // No cache found, so let's start a new request
@@ -854,38 +1024,23 @@ static void curl_setup_preadv(BlockDriverState *bs, CURLAIOCB *acb)
         qemu_co_queue_wait(&s->free_state_waitq, &s->mutex);
     }
 
-    if (curl_init_state(s, state) < 0) {
-        curl_clean_state(state);
-        acb->ret = -EIO;
-        goto out;
-    }
-
     acb->start = 0;
     acb->end = MIN(acb->bytes, s->len - start);
 
-    state->buf_off = 0;
-    g_free(state->orig_buf);
-    state->buf_start = start;
-    state->buf_len = MIN(acb->end + s->readahead_size, s->len - start);
-    end = start + state->buf_len - 1;
-    state->orig_buf = g_try_malloc(state->buf_len);
-    if (state->buf_len && state->orig_buf == NULL) {
+    ret = curl_start_request(s, state, start,
+                             MIN(acb->end + s->readahead_size,
+                                 s->len - start));
+    if (ret < 0) {
         curl_clean_state(state);
-        acb->ret = -ENOMEM;
+        acb->ret = ret;
         goto out;
     }
     state->acb[0] = acb;
-
-    snprintf(state->range, 127, "%" PRIu64 "-%" PRIu64, start, end);
     trace_curl_setup_preadv(acb->bytes, start, state->range);
-    curl_easy_setopt(state->curl, CURLOPT_RANGE, state->range);
-
-    if (curl_multi_add_handle(s->multi, state->curl) != CURLM_OK) {
-        state->acb[0] = NULL;
-        acb->ret = -EIO;
 
-        curl_clean_state(state);
-        goto out;
+prefetch:
+    if (s->seq_reads >= CURL_SEQ_READS_BEFORE_PREFETCH) {
+        curl_prefetch(s, start + acb->bytes);
     }
 
     /* Tell curl it needs to kick things off */
@@ -922,6 +1077,7 @@ static void curl_close(BlockDriverState *bs)
     qemu_mutex_destroy(&s->mutex);
 
     g_hash_table_destroy(s->sockets);
+    g_free(s->states);
     g_free(s->cookie);
     g_free(s->url);
     g_free(s->username);
@@ -939,8 +1095,8 @@ static void curl_refresh_filename(BlockDriverState *bs)
 {
     BDRVCURLState *s = bs->opaque;
 
-    /* "readahead" and "timeout" do not change the guest-visible data,
-     * so ignore them */
+    /* "readahead", "timeout", "connections" and "prefetch" do not change
+     * the guest-visible data, so ignore them */
     if (s->sslverify != CURL_BLOCK_OPT_SSLVERIFY_DEFAULT ||
         s->cookie || s->username || s->password || s->proxyusername ||
         s->proxypassword)
@@ -51,6 +51,9 @@ struct BdrvDirtyBitmap {
     bool skip_store;            /* We are either migrating or deleting this
                                  * bitmap; it should not be stored on the next
                                  * inactivation. */
+    bool stored;                /* The owner disk image holds a copy of this
+                                   bitmap as of stored_generation */
+    uint64_t stored_generation;
     QLIST_ENTRY(BdrvDirtyBitmap) list;
 };
 
@@ -664,6 +667,7 @@ void bdrv_clear_dirty_bitmap(BdrvDirtyBitmap *bitmap, HBitmap **out)
         HBitmap *backup = bitmap->bitmap;
         bitmap->bitmap = hbitmap_alloc(bitmap->size,
                                        hbitmap_granularity(backup));
+        bitmap->stored = false;
         *out = backup;
     }
     bdrv_dirty_bitmaps_unlock(bitmap->bs);
@@ -674,6 +678,7 @@ void bdrv_restore_dirty_bitmap(BdrvDirtyBitmap *bitmap, HBitmap *backup)
     HBitmap *tmp = bitmap->bitmap;
     assert(!bdrv_dirty_bitmap_readonly(bitmap));
     bitmap->bitmap = backup;
+    bitmap->stored = false;
     hbitmap_free(tmp);
 }
 
@@ -830,6 +835,35 @@ void bdrv_dirty_bitmap_skip_store(BdrvDirtyBitmap *bitmap, bool skip)
     bdrv_dirty_bitmaps_unlock(bitmap->bs);
 }
 
+/*
+ * Record that the owner disk image now holds the current contents of
+ * @bitmap, or that it no longer does.  Called with BQL taken.
+ */
+void bdrv_dirty_bitmap_set_stored(BdrvDirtyBitmap *bitmap, bool stored)
+{
+    bdrv_dirty_bitmaps_lock(bitmap->bs);
+    bitmap->stored = stored;
+    bitmap->stored_generation = hbitmap_generation(bitmap->bitmap);
+    bdrv_dirty_bitmaps_unlock(bitmap->bs);
+}
+
+/*
+ * Return true if @bitmap has not changed since bdrv_dirty_bitmap_set_stored()
+ * was last called on it, so that the copy in the image is still current.
+ * Called with BQL taken.
+ */
+bool bdrv_dirty_bitmap_stored_is_current(BdrvDirtyBitmap *bitmap)
+{
+    bool ret;
+
+    bdrv_dirty_bitmaps_lock(bitmap->bs);
+    ret = bitmap->stored &&
+          bitmap->stored_generation == hbitmap_generation(bitmap->bitmap);
+    bdrv_dirty_bitmaps_unlock(bitmap->bs);
+
+    return ret;
+}
+
 bool bdrv_dirty_bitmap_get_persistence(BdrvDirtyBitmap *bitmap)
 {
     return bitmap->persistent && !bitmap->skip_store;
@@ -943,6 +977,7 @@ bool bdrv_dirty_bitmap_merge_internal(BdrvDirtyBitmap *dest,
     if (backup) {
         *backup = dest->bitmap;
         dest->bitmap = hbitmap_alloc(dest->size, hbitmap_granularity(*backup));
+        dest->stored = false;
         ret = hbitmap_merge(*backup, src->bitmap, dest->bitmap);
     } else {
         ret = hbitmap_merge(dest->bitmap, src->bitmap, dest->bitmap);
@@ -26,7 +26,9 @@
 #include "block/qapi.h"
 #include "qapi/error.h"
 #include "qapi/qapi-commands-block.h"
+#include "qemu/coroutine.h"
 #include "sysemu/block-backend.h"
+#include "sysemu/iothread.h"
 
 #include <fuse.h>
 #include <fuse_lowlevel.h>
@@ -35,18 +37,57 @@
 /* Prevent overly long bounce buffer allocations */
 #define FUSE_MAX_BOUNCE_BYTES (MIN(BDRV_REQUEST_MAX_BYTES, 64 * 1024 * 1024))
 
+/*
+ * How many asynchronous requests (readahead, async direct I/O) the kernel
+ * may have outstanding.  The kernel default of 12 is too small now that
+ * requests are processed concurrently.
+ */
+#define FUSE_MAX_BACKGROUND 64
+
+/* Number of request buffers each FuseQueue keeps for reuse */
+#define FUSE_MAX_SPARE_REQUESTS 16
+
 
-typedef struct FuseExport {
+typedef struct FuseExport FuseExport;
+typedef struct FuseQueue FuseQueue;
+
+/* A request read from the FUSE session, processed in its own coroutine */
+typedef struct FuseRequest {
+    FuseQueue *q;
+    struct fuse_buf buf;
+    QSLIST_ENTRY(FuseRequest) next;
+} FuseRequest;
+
+/*
+ * An AioContext that reads requests from the FUSE session fd.  All queues
+ * share the fd, the kernel hands each request to one of the readers.  The
+ * reply is written from the thread that has received the request.
+ */
+struct FuseQueue {
+    FuseExport *exp;
+    AioContext *ctx;
+    bool multiqueue; /* blk_enable_multiqueue() was called for ctx */
+    bool fd_handler_set_up;
+
+    /* Only accessed in ctx */
+    QSLIST_HEAD(, FuseRequest) spare_reqs;
+    int nb_spare_reqs;
+};
+
+struct FuseExport {
     BlockExport common;
 
     struct fuse_session *fuse_session;
-    struct fuse_buf fuse_buf;
-    bool mounted, fd_handler_set_up;
+    bool mounted;
+
+    /* queues[0] runs in common.ctx */
+    FuseQueue *queues;
+    int nb_queues;
 
     char *mountpoint;
     bool writable;
     bool growable;
-} FuseExport;
+};
 
 static GHashTable *exports;
 static const struct fuse_lowlevel_ops fuse_ops;
@@ -56,6 +97,8 @@ static void fuse_export_delete(BlockExport *exp);
 
 static void init_exports_table(void);
 
+static int setup_fuse_queues(FuseExport *exp, strList *iothreads,
+                             Error **errp);
 static int setup_fuse_export(FuseExport *exp, const char *mountpoint,
                              Error **errp);
 static void read_from_fuse_export(void *opaque);
@@ -118,6 +161,12 @@ static int fuse_export_create(BlockExport *blk_exp,
     exp->writable = blk_exp_args->writable;
     exp->growable = args->growable;
 
+    ret = setup_fuse_queues(exp, args->has_iothreads ? args->iothreads : NULL,
+                            errp);
+    if (ret < 0) {
+        goto fail;
+    }
+
     ret = setup_fuse_export(exp, args->mountpoint, errp);
     if (ret < 0) {
         goto fail;
@@ -142,6 +191,66 @@ static void init_exports_table(void)
     exports = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
 }
 
+/**
+ * Create one queue for the export's AioContext and one for each IOThread
+ * in @iothreads, which are allowed to submit requests to the export's
+ * BlockBackend.
+ */
+static int setup_fuse_queues(FuseExport *exp, strList *iothreads,
+                             Error **errp)
+{
+    strList *e;
+    int n = 1;
+    int ret;
+
+    for (e = iothreads; e; e = e->next) {
+        n++;
+    }
+
+    exp->queues = g_new0(FuseQueue, n);
+    exp->queues[0] = (FuseQueue) {
+        .exp = exp,
+        .ctx = exp->common.ctx,
+    };
+    exp->nb_queues = 1;
+
+    for (e = iothreads; e; e = e->next) {
+        IOThread *iothread = iothread_by_id(e->value);
+        FuseQueue *q;
+        AioContext *ctx;
+        int i;
+
+        if (!iothread) {
+            error_setg(errp, "IOThread '%s' not found", e->value);
+            return -ENOENT;
+        }
+        ctx = iothread_get_aio_context(iothread);
+
+        for (i = 0; i < exp->nb_queues; i++) {
+            if (exp->queues[i].ctx == ctx) {
+                break;
+            }
+        }
+        if (i < exp->nb_queues) {
+            continue;
+        }
+
+        q = &exp->queues[exp->nb_queues++];
+        *q = (FuseQueue) {
+            .exp = exp,
+            .ctx = ctx,
+        };
+
+        ret = blk_enable_multiqueue(exp->common.blk, ctx, errp);
+        if (ret < 0) {
+            return ret;
+        }
+        q->multiqueue = true;
+    }
+
+    return 0;
+}
+
 /**
  * Create exp->fuse_session and mount it.
  */
@@ -152,6 +261,7 @@ static int setup_fuse_export(FuseExport *exp, const char *mountpoint,
     char *mount_opts;
     struct fuse_args fuse_args;
     int ret;
+    int i;
 
     /* Needs to match what fuse_init() sets.  Only max_read must be supplied. */
     mount_opts = g_strdup_printf("max_read=%zu", FUSE_MAX_BOUNCE_BYTES);
@@ -181,10 +291,18 @@ static int setup_fuse_export(FuseExport *exp, const char *mountpoint,
 
     g_hash_table_insert(exports, g_strdup(mountpoint), NULL);
 
-    aio_set_fd_handler(exp->common.ctx,
-                       fuse_session_fd(exp->fuse_session), true,
-                       read_from_fuse_export, NULL, NULL, exp);
-    exp->fd_handler_set_up = true;
+    /* Readers that lose the race for a request must not block */
+    if (exp->nb_queues > 1) {
+        qemu_set_nonblock(fuse_session_fd(exp->fuse_session));
+    }
+
+    for (i = 0; i < exp->nb_queues; i++) {
+        FuseQueue *q = &exp->queues[i];
+
+        aio_set_fd_handler(q->ctx, fuse_session_fd(exp->fuse_session), true,
+                           read_from_fuse_export, NULL, NULL, q);
+        q->fd_handler_set_up = true;
+    }
 
     return 0;
 
@@ -193,42 +311,124 @@ fail:
     return ret;
 }
 
+/**
+ * blk_exp_ref() and blk_exp_unref() need the export's AioContext lock,
+ * which the queues in other IOThreads do not hold.
+ */
+static void fuse_export_ref(FuseExport *exp)
+{
+    aio_context_acquire(exp->common.ctx);
+    blk_exp_ref(&exp->common);
+    aio_context_release(exp->common.ctx);
+}
+
+static void fuse_export_unref(FuseExport *exp)
+{
+    aio_context_acquire(exp->common.ctx);
+    blk_exp_unref(&exp->common);
+    aio_context_release(exp->common.ctx);
+}
+
+static FuseRequest *fuse_request_get(FuseQueue *q)
+{
+    FuseRequest *req = QSLIST_FIRST(&q->spare_reqs);
+
+    if (req) {
+        QSLIST_REMOVE_HEAD(&q->spare_reqs, next);
+        q->nb_spare_reqs--;
+    } else {
+        req = g_new0(FuseRequest, 1);
+        req->q = q;
+    }
+    return req;
+}
+
+static void fuse_request_free(FuseRequest *req)
+{
+    /* Allocated by libfuse */
+    free(req->buf.mem);
+    g_free(req);
+}
+
+/**
+ * Keep the buffer of @req for the next request, so that not every request
+ * has to allocate a buffer of the size of the largest possible request.
+ */
+static void fuse_request_put(FuseRequest *req)
+{
+    FuseQueue *q = req->q;
+
+    if (q->nb_spare_reqs >= FUSE_MAX_SPARE_REQUESTS) {
+        fuse_request_free(req);
+        return;
+    }
+
+    QSLIST_INSERT_HEAD(&q->spare_reqs, req, next);
+    q->nb_spare_reqs++;
+}
+
+/**
+ * Process a single request.  The request handlers run in this coroutine,
+ * so that the block layer functions they call yield instead of blocking
+ * the AioContext, and other requests can be processed in the meantime.
+ */
+static void coroutine_fn fuse_co_process_request(void *opaque)
+{
+    FuseRequest *req = opaque;
+    FuseExport *exp = req->q->exp;
+
+    fuse_session_process_buf(exp->fuse_session, &req->buf);
+
+    fuse_request_put(req);
+    fuse_export_unref(exp);
+}
+
 /**
  * Callback to be invoked when the FUSE session FD can be read from.
  * (This is basically the FUSE event loop.)
  */
 static void read_from_fuse_export(void *opaque)
 {
-    FuseExport *exp = opaque;
+    FuseQueue *q = opaque;
+    FuseExport *exp = q->exp;
+    FuseRequest *req;
+    Coroutine *co;
     int ret;
 
-    blk_exp_ref(&exp->common);
+    fuse_export_ref(exp);
 
+    req = fuse_request_get(q);
     do {
-        ret = fuse_session_receive_buf(exp->fuse_session, &exp->fuse_buf);
+        ret = fuse_session_receive_buf(exp->fuse_session, &req->buf);
     } while (ret == -EINTR);
-    if (ret < 0) {
-        goto out;
+    if (ret <= 0) {
+        /* -EAGAIN if the request has been taken by another queue */
+        fuse_request_put(req);
+        fuse_export_unref(exp);
+        return;
     }
 
-    fuse_session_process_buf(exp->fuse_session, &exp->fuse_buf);
-
-out:
-    blk_exp_unref(&exp->common);
+    co = qemu_coroutine_create(fuse_co_process_request, req);
+    qemu_coroutine_enter(co);
 }
 
 static void fuse_export_shutdown(BlockExport *blk_exp)
 {
     FuseExport *exp = container_of(blk_exp, FuseExport, common);
+    int i;
 
     if (exp->fuse_session) {
         fuse_session_exit(exp->fuse_session);
 
-        if (exp->fd_handler_set_up) {
-            aio_set_fd_handler(exp->common.ctx,
-                               fuse_session_fd(exp->fuse_session), true,
-                               NULL, NULL, NULL, NULL);
-            exp->fd_handler_set_up = false;
+        for (i = 0; i < exp->nb_queues; i++) {
+            FuseQueue *q = &exp->queues[i];
+
+            if (q->fd_handler_set_up) {
+                aio_set_fd_handler(q->ctx,
+                                   fuse_session_fd(exp->fuse_session), true,
+                                   NULL, NULL, NULL, NULL);
+                q->fd_handler_set_up = false;
+            }
         }
     }
 
@@ -244,6 +444,7 @@ static void fuse_export_shutdown(BlockExport *blk_exp)
 static void fuse_export_delete(BlockExport *blk_exp)
 {
     FuseExport *exp = container_of(blk_exp, FuseExport, common);
+    int i;
 
     if (exp->fuse_session) {
         if (exp->mounted) {
@@ -253,7 +454,20 @@ static void fuse_export_delete(BlockExport *blk_exp)
         fuse_session_destroy(exp->fuse_session);
     }
 
-    free(exp->fuse_buf.mem);
+    /* No request is in flight any more, so the queues are idle */
+    for (i = 0; i < exp->nb_queues; i++) {
+        FuseQueue *q = &exp->queues[i];
+        FuseRequest *req, *next_req;
+
+        QSLIST_FOREACH_SAFE(req, &q->spare_reqs, next, next_req) {
+            fuse_request_free(req);
+        }
+        if (q->multiqueue) {
+            blk_disable_multiqueue(exp->common.blk, q->ctx);
+        }
+    }
+    g_free(exp->queues);
+
     g_free(exp->mountpoint);
 }
 
@@ -294,7 +508,18 @@ static void fuse_init(void *userdata, struct fuse_conn_info *conn)
      */
     conn->max_read = FUSE_MAX_BOUNCE_BYTES;
 
+    /*
+     * libfuse limits max_write to the size of its request buffer, which
+     * it has already sized for the largest request the kernel can send.
+     */
     conn->max_write = MIN_NON_ZERO(BDRV_REQUEST_MAX_BYTES, conn->max_write);
+
+    /* Requests are processed concurrently, let the kernel send more */
+    conn->max_background = FUSE_MAX_BACKGROUND;
+    conn->congestion_threshold = FUSE_MAX_BACKGROUND * 3 / 4;
+    if (conn->capable & FUSE_CAP_ASYNC_DIO) {
+        conn->want |= FUSE_CAP_ASYNC_DIO;
+    }
 }
 
 /**
@@ -356,10 +581,14 @@ static void fuse_getattr(fuse_req_t req, fuse_ino_t inode,
 static int fuse_do_truncate(const FuseExport *exp, int64_t size,
                             bool req_zero_write, PreallocMode prealloc)
 {
+    AioContext *ctx = qemu_get_current_aio_context();
     uint64_t blk_perm, blk_shared_perm;
     BdrvRequestFlags truncate_flags = 0;
     int ret;
 
+    /* Permissions can only be changed in the export's AioContext */
+    aio_co_reschedule_self(exp->common.ctx);
+
     if (req_zero_write) {
         truncate_flags |= BDRV_REQ_ZERO_WRITE;
     }
@@ -371,7 +600,7 @@ static int fuse_do_truncate(const FuseExport *exp, int64_t size,
         ret = blk_set_perm(exp->common.blk, blk_perm | BLK_PERM_RESIZE,
                            blk_shared_perm, NULL);
         if (ret < 0) {
-            return ret;
+            goto out;
         }
     }
 
@@ -383,6 +612,8 @@ static int fuse_do_truncate(const FuseExport *exp, int64_t size,
         blk_set_perm(exp->common.blk, blk_perm, blk_shared_perm, &error_abort);
     }
 
+out:
+    aio_co_reschedule_self(ctx);
     return ret;
 }
 
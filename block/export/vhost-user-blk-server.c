@@ -18,6 +18,7 @@
 #include "qapi/error.h"
 #include "qom/object_interfaces.h"
 #include "sysemu/block-backend.h"
+#include "sysemu/iothread.h"
 #include "util/block-helpers.h"
 
 /*
@@ -44,6 +45,7 @@ typedef struct VuBlkReq {
     struct virtio_blk_outhdr out;
     VuServer *server;
     struct VuVirtq *vq;
+    bool in_flight; /* accounted with vhost_user_server_inc_in_flight() */
 } VuBlkReq;
 
 /* vhost user block device */
@@ -54,8 +56,24 @@ typedef struct {
     QIOChannelSocket *sioc;
     struct virtio_blk_config blkcfg;
     bool writable;
+
+    /* AioContexts of the virtqueues, empty if all run in export.ctx */
+    AioContext **vq_ctx;
+    bool *vq_ctx_multiqueue; /* blk_enable_multiqueue() was called */
+    int nb_vq_ctx;
 } VuBlkExport;
 
+static void vu_blk_req_free(VuBlkReq *req)
+{
+    VuServer *server = req->server;
+    bool in_flight = req->in_flight;
+
+    free(req);
+    if (in_flight) {
+        vhost_user_server_dec_in_flight(server);
+    }
+}
+
 static void vu_blk_req_complete(VuBlkReq *req)
 {
     VuDev *vu_dev = &req->server->vu_dev;
@@ -64,7 +82,7 @@ static void vu_blk_req_complete(VuBlkReq *req)
     vu_queue_push(vu_dev, req->vq, &req->elem, req->size + 1);
     vu_queue_notify(vu_dev, req->vq);
 
-    free(req);
+    vu_blk_req_free(req);
 }
 
 static bool vu_blk_sect_range_ok(VuBlkExport *vexp, uint64_t sector,
@@ -282,7 +300,7 @@ static void coroutine_fn vu_blk_virtio_process_req(void *opaque)
     return;
 
 err:
-    free(req);
+    vu_blk_req_free(req);
 }
 
 static void vu_blk_process_vq(VuDev *vu_dev, int idx)
@@ -301,6 +319,15 @@ static void vu_blk_process_vq(VuDev *vu_dev, int idx)
         req->server = server;
         req->vq = vq;
 
+        /*
+         * Requests outside of the server's AioContext must complete before
+         * the server handles the next vhost-user message
+         */
+        req->in_flight = qemu_get_current_aio_context() != server->ctx;
+        if (req->in_flight) {
+            vhost_user_server_inc_in_flight(server);
+        }
+
         Coroutine *co =
             qemu_coroutine_create(vu_blk_virtio_process_req, req);
         qemu_coroutine_enter(co);
@@ -459,6 +486,79 @@ static void vu_blk_exp_request_shutdown(BlockExport *exp)
     vhost_user_server_stop(&vexp->vu_server);
 }
 
+static void vu_blk_exp_free_queue_contexts(VuBlkExport *vexp)
+{
+    BlockExport *exp = &vexp->export;
+    int i;
+
+    for (i = 0; i < vexp->nb_vq_ctx; i++) {
+        if (vexp->vq_ctx_multiqueue[i]) {
+            blk_disable_multiqueue(exp->blk, vexp->vq_ctx[i]);
+        }
+    }
+    g_free(vexp->vq_ctx);
+    g_free(vexp->vq_ctx_multiqueue);
+    vexp->vq_ctx = NULL;
+    vexp->vq_ctx_multiqueue = NULL;
+    vexp->nb_vq_ctx = 0;
+}
+
+/*
+ * Look up the IOThreads that process the virtqueues and let them submit
+ * requests to the export's BlockBackend.
+ */
+static int vu_blk_exp_init_queue_contexts(VuBlkExport *vexp,
+                                          strList *iothreads, Error **errp)
+{
+    BlockExport *exp = &vexp->export;
+    strList *e;
+    int n = 0;
+    int ret;
+
+    for (e = iothreads; e; e = e->next) {
+        n++;
+    }
+    vexp->vq_ctx = g_new0(AioContext *, n);
+    vexp->vq_ctx_multiqueue = g_new0(bool, n);
+
+    for (e = iothreads; e; e = e->next) {
+        IOThread *iothread = iothread_by_id(e->value);
+        AioContext *ctx;
+        int i;
+
+        if (!iothread) {
+            error_setg(errp, "IOThread '%s' not found", e->value);
+            ret = -ENOENT;
+            goto fail;
+        }
+        ctx = iothread_get_aio_context(iothread);
+
+        /* Enable each AioContext only once */
+        for (i = 0; i < vexp->nb_vq_ctx; i++) {
+            if (vexp->vq_ctx[i] == ctx) {
+                break;
+            }
+        }
+        if (i < vexp->nb_vq_ctx) {
+            continue;
+        }
+        if (ctx != exp->ctx) {
+            ret = blk_enable_multiqueue(exp->blk, ctx, errp);
+            if (ret < 0) {
+                goto fail;
+            }
+            vexp->vq_ctx_multiqueue[i] = true;
+        }
+        vexp->vq_ctx[vexp->nb_vq_ctx++] = ctx;
+    }
+
+    return 0;
+
+fail:
+    vu_blk_exp_free_queue_contexts(vexp);
+    return ret;
+}
+
 static int vu_blk_exp_create(BlockExport *exp, BlockExportOptions *opts,
                              Error **errp)
 {
@@ -467,6 +567,7 @@ static int vu_blk_exp_create(BlockExport *exp, BlockExportOptions *opts,
     Error *local_err = NULL;
     uint64_t logical_block_size;
     uint16_t num_queues = VHOST_USER_BLK_NUM_QUEUES_DEFAULT;
+    int ret;
 
     vexp->writable = opts->writable;
     vexp->blkcfg.wce = 0;
@@ -493,6 +594,17 @@ static int vu_blk_exp_create(BlockExport *exp, BlockExportOptions *opts,
         return -EINVAL;
     }
 
+    if (vu_opts->has_iothreads) {
+        if (!vu_opts->iothreads) {
+            error_setg(errp, "iothreads must not be empty");
+            return -EINVAL;
+        }
+        ret = vu_blk_exp_init_queue_contexts(vexp, vu_opts->iothreads, errp);
+        if (ret < 0) {
+            return ret;
+        }
+    }
+
     vu_blk_initialize_config(blk_bs(exp->blk), &vexp->blkcfg,
                              logical_block_size, num_queues);
 
@@ -503,9 +615,15 @@ static int vu_blk_exp_create(BlockExport *exp, BlockExportOptions *opts,
                                  num_queues, &vu_blk_iface, errp)) {
         blk_remove_aio_context_notifier(exp->blk, blk_aio_attached,
                                         blk_aio_detach, vexp);
+        vu_blk_exp_free_queue_contexts(vexp);
         return -EADDRNOTAVAIL;
     }
 
+    if (vexp->nb_vq_ctx) {
+        vhost_user_server_set_queue_contexts(&vexp->vu_server, vexp->vq_ctx,
+                                             vexp->nb_vq_ctx);
+    }
+
     return 0;
 }
 
@@ -515,6 +633,7 @@ static void vu_blk_exp_delete(BlockExport *exp)
 
     blk_remove_aio_context_notifier(exp->blk, blk_aio_attached, blk_aio_detach,
                                     vexp);
+    vu_blk_exp_free_queue_contexts(vexp);
 }
 
 const BlockExportDriver blk_exp_vhost_user_blk = {
@@ -69,6 +69,9 @@
 #include <linux/hdreg.h>
 #include <linux/magic.h>
 #include <scsi/sg.h>
+#ifdef CONFIG_BLKZONED
+#include <linux/blkzoned.h>
+#endif
 #ifdef __s390__
 #include <asm/dasd.h>
 #endif
@@ -132,6 +135,20 @@
 #define RAW_LOCK_PERM_BASE             100
 #define RAW_LOCK_SHARED_BASE           200
 
+/* Maximum number of extents looked up at once by raw_find_allocation() */
+#define RAW_EXTENT_CACHE_SIZE          32
+
+typedef struct RawExtent {
+    int64_t end;
+    bool data;
+} RawExtent;
+
+/* Zones per BLKREPORTZONE call */
+#define RAW_ZONE_REPORT_BATCH 128
+
+/* Locks that serialize the writes to a zone, zones are hashed onto them */
+#define RAW_ZONE_LOCKS 64
+
 typedef struct BDRVRawState {
     int fd;
     bool use_lock;
@@ -160,8 +177,13 @@ typedef struct BDRVRawState {
     bool discard_zeroes:1;
     bool use_linux_aio:1;
     bool use_linux_io_uring:1;
+    bool io_uring_fixed_buffers:1;
+    bool io_uring_sqpoll:1;
+    bool io_uring_iopoll:1;
+    bool io_uring_iopoll_unsupported:1;
     bool page_cache_inconsistent:1;
     bool has_fallocate;
+    bool has_clone_range;
     bool needs_alignment;
     bool drop_cache;
     bool check_cache_dropped;
@@ -171,7 +193,33 @@ typedef struct BDRVRawState {
         uint64_t discard_bytes_ok;
     } stats;
 
+    /*
+     * Consecutive data and hole extents starting at @start, as found by
+     * find_allocation().  A trailing hole ends at INT64_MAX.  Requests
+     * through this node drop the extents they may change, see
+     * raw_extent_cache_invalidate().
+     */
+    struct {
+        QemuMutex lock;
+        /* Incremented by every invalidation */
+        uint64_t generation;
+        int64_t start;
+        int nb_extents;
+        RawExtent extents[RAW_EXTENT_CACHE_SIZE];
+    } extent_cache;
+
     PRManager *pr_mgr;
+
+#ifdef CONFIG_BLKZONED
+    /*
+     * Write pointers of the zones of a zoned host device, UINT64_MAX for
+     * conventional zones.  Linux has no zone append for user space, so
+     * appends are written at the write pointer; the entry of a zone is
+     * protected by its zone lock, which is held across the write.
+     */
+    uint64_t *wps;
+    CoMutex zone_locks[RAW_ZONE_LOCKS];
+#endif
 } BDRVRawState;
 
 typedef struct BDRVRawReopenState {
@@ -208,6 +256,10 @@ typedef struct RawPosixAIOData {
             PreallocMode prealloc;
             Error **errp;
         } truncate;
+        struct {
+            unsigned int *nr_zones;
+            BlockZoneDescriptor *zones;
+        } zone_report;
     };
 } RawPosixAIOData;
 
@@ -518,6 +570,26 @@ static QemuOptsList raw_runtime_opts = {
             .type = QEMU_OPT_STRING,
             .help = "host AIO implementation (threads, native, io_uring)",
         },
+#ifdef CONFIG_LINUX_IO_URING
+        {
+            .name = "io-uring-fixed-buffers",
+            .type = QEMU_OPT_BOOL,
+            .help = "register guest RAM as io_uring fixed buffers "
+                    "(default: off)",
+        },
+        {
+            .name = "io-uring-sqpoll",
+            .type = QEMU_OPT_BOOL,
+            .help = "use an io_uring submission queue polling thread "
+                    "(default: off)",
+        },
+        {
+            .name = "io-uring-iopoll",
+            .type = QEMU_OPT_BOOL,
+            .help = "busy poll for io_uring completions, needs "
+                    "cache.direct=on (default: off)",
+        },
+#endif
         {
             .name = "locking",
             .type = QEMU_OPT_STRING,
@@ -559,6 +631,9 @@ static int raw_open_common(BlockDriverState *bs, QDict *options,
     int fd, ret;
     struct stat st;
     OnOffAuto locking;
+#ifdef CONFIG_BLKZONED
+    int i;
+#endif
 
     opts = qemu_opts_create(&raw_runtime_opts, NULL, 0, &error_abort);
     if (!qemu_opts_absorb_qdict(opts, options, errp)) {
@@ -595,6 +670,23 @@ static int raw_open_common(BlockDriverState *bs, QDict *options,
     s->use_linux_aio = (aio == BLOCKDEV_AIO_OPTIONS_NATIVE);
 #ifdef CONFIG_LINUX_IO_URING
     s->use_linux_io_uring = (aio == BLOCKDEV_AIO_OPTIONS_IO_URING);
+    s->io_uring_fixed_buffers = qemu_opt_get_bool(opts,
+                                                  "io-uring-fixed-buffers",
+                                                  false);
+    s->io_uring_sqpoll = qemu_opt_get_bool(opts, "io-uring-sqpoll", false);
+    s->io_uring_iopoll = qemu_opt_get_bool(opts, "io-uring-iopoll", false);
+    if ((s->io_uring_fixed_buffers || s->io_uring_sqpoll ||
+         s->io_uring_iopoll) && !s->use_linux_io_uring) {
+        error_setg(errp, "io-uring-fixed-buffers, io-uring-sqpoll and "
+                   "io-uring-iopoll require aio=io_uring");
+        ret = -EINVAL;
+        goto fail;
+    }
+    if (s->io_uring_iopoll && !(bdrv_flags & BDRV_O_NOCACHE)) {
+        error_setg(errp, "io-uring-iopoll requires cache.direct=on");
+        ret = -EINVAL;
+        goto fail;
+    }
 #endif
 
     locking = qapi_enum_parse(&OnOffAuto_lookup,
@@ -665,6 +757,12 @@ static int raw_open_common(BlockDriverState *bs, QDict *options,
 
     s->perm = 0;
     s->shared_perm = BLK_PERM_ALL;
+    qemu_mutex_init(&s->extent_cache.lock);
+#ifdef CONFIG_BLKZONED
+    for (i = 0; i < RAW_ZONE_LOCKS; i++) {
+        qemu_co_mutex_init(&s->zone_locks[i]);
+    }
+#endif
 
 #ifdef CONFIG_LINUX_AIO
      /* Currently Linux does AIO only for files opened with O_DIRECT */
@@ -691,10 +789,34 @@ static int raw_open_common(BlockDriverState *bs, QDict *options,
 
 #ifdef CONFIG_LINUX_IO_URING
     if (s->use_linux_io_uring) {
-        if (!aio_setup_linux_io_uring(bdrv_get_aio_context(bs), errp)) {
+        LuringState *aio = aio_setup_linux_io_uring(bdrv_get_aio_context(bs),
+                                                    s->io_uring_sqpoll, errp);
+        if (!aio) {
             error_prepend(errp, "Unable to use io_uring: ");
             goto fail;
         }
+        if (s->io_uring_fixed_buffers) {
+            ret = luring_enable_fixed_buffers(aio, errp);
+            if (ret < 0) {
+                goto fail;
+            }
+        }
+    }
+    if (s->io_uring_iopoll) {
+        LuringState *aio =
+            aio_setup_linux_io_uring_iopoll(bdrv_get_aio_context(bs),
+                                            s->io_uring_sqpoll, errp);
+        if (!aio) {
+            error_prepend(errp, "Unable to use polled io_uring: ");
+            ret = -EINVAL;
+            goto fail;
+        }
+        if (s->io_uring_fixed_buffers) {
+            ret = luring_enable_fixed_buffers(aio, errp);
+            if (ret < 0) {
+                goto fail;
+            }
+        }
     }
 #else
     if (s->use_linux_io_uring) {
@@ -726,6 +848,7 @@ static int raw_open_common(BlockDriverState *bs, QDict *options,
         } else {
             s->discard_zeroes = true;
             s->has_fallocate = true;
+            s->has_clone_range = true;
         }
     } else {
         if (!(S_ISCHR(st.st_mode) || S_ISBLK(st.st_mode))) {
@@ -1215,9 +1338,206 @@ out:
 #endif
 }
 
+#ifdef CONFIG_BLKZONED
+/* Read a queue attribute of the block device @st from sysfs */
+static char *get_sysfs_queue_attr(struct stat *st, const char *attr)
+{
+    g_autofree char *path = NULL;
+    char *val;
+
+    path = g_strdup_printf("/sys/dev/block/%u:%u/queue/%s",
+                           major(st->st_rdev), minor(st->st_rdev), attr);
+    if (!g_file_get_contents(path, &val, NULL, NULL)) {
+        return NULL;
+    }
+    return g_strchomp(val);
+}
+
+static int64_t get_sysfs_queue_long(struct stat *st, const char *attr)
+{
+    g_autofree char *val = get_sysfs_queue_attr(st, attr);
+    int64_t ret;
+
+    if (!val || qemu_strtoi64(val, NULL, 10, &ret) < 0) {
+        return -1;
+    }
+    return ret;
+}
+
+static int handle_aiocb_zone_report(void *opaque)
+{
+    RawPosixAIOData *aiocb = opaque;
+    unsigned int nr_zones = *aiocb->zone_report.nr_zones;
+    BlockZoneDescriptor *zones = aiocb->zone_report.zones;
+    uint64_t sector = aiocb->aio_offset >> BDRV_SECTOR_BITS;
+    unsigned int batch = MIN(nr_zones, RAW_ZONE_REPORT_BATCH);
+    size_t rep_size = sizeof(struct blk_zone_report) +
+                      batch * sizeof(struct blk_zone);
+    g_autofree struct blk_zone_report *rep = g_malloc(rep_size);
+    unsigned int n = 0, i;
+
+    while (n < nr_zones) {
+        struct blk_zone *blkz;
+
+        memset(rep, 0, rep_size);
+        rep->sector = sector;
+        rep->nr_zones = MIN(nr_zones - n, batch);
+        if (ioctl(aiocb->aio_fildes, BLKREPORTZONE, rep) < 0) {
+            return -errno;
+        }
+        if (!rep->nr_zones) {
+            break;
+        }
+
+        for (i = 0; i < rep->nr_zones; i++, n++) {
+            uint64_t cap;
+
+            blkz = &rep->zones[i];
+            cap = rep->flags & BLK_ZONE_REP_CAPACITY ? blkz->capacity
+                                                      : blkz->len;
+            /* BlockZoneType and BlockZoneState use the Linux values */
+            zones[n] = (BlockZoneDescriptor) {
+                .start  = blkz->start << BDRV_SECTOR_BITS,
+                .length = blkz->len << BDRV_SECTOR_BITS,
+                .cap    = cap << BDRV_SECTOR_BITS,
+                .wp     = blkz->wp << BDRV_SECTOR_BITS,
+                .type   = blkz->type,
+                .state  = blkz->cond,
+            };
+        }
+        sector = blkz->start + blkz->len;
+    }
+
+    *aiocb->zone_report.nr_zones = n;
+    return 0;
+}
+
+static CoMutex *raw_zone_lock(BDRVRawState *s, unsigned int index)
+{
+    return &s->zone_locks[index % RAW_ZONE_LOCKS];
+}
+
+/*
+ * Reload the write pointers of @nr zones starting at @offset from the
+ * device.  This blocks, but is only needed when opening the device and
+ * after failed writes.
+ */
+static int raw_update_wps(BlockDriverState *bs, int64_t offset,
+                          unsigned int nr)
+{
+    BDRVRawState *s = bs->opaque;
+    g_autofree BlockZoneDescriptor *zones = g_new(BlockZoneDescriptor, nr);
+    unsigned int first = offset / bs->bl.zone_size;
+    RawPosixAIOData acb = {
+        .bs             = bs,
+        .aio_fildes     = s->fd,
+        .aio_type       = QEMU_AIO_ZONE_REPORT,
+        .aio_offset     = offset,
+        .zone_report    = {
+            .nr_zones       = &nr,
+            .zones          = zones,
+        },
+    };
+    unsigned int i;
+    int ret;
+
+    ret = handle_aiocb_zone_report(&acb);
+    if (ret < 0) {
+        return ret;
+    }
+
+    for (i = 0; i < nr; i++) {
+        if (zones[i].type == BLK_ZT_CONV) {
+            s->wps[first + i] = UINT64_MAX;
+        } else if (zones[i].state == BLK_ZS_FULL) {
+            s->wps[first + i] = zones[i].start + zones[i].length;
+        } else {
+            s->wps[first + i] = zones[i].wp;
+        }
+    }
+    return 0;
+}
+
+static void raw_refresh_zoned_limits(BlockDriverState *bs, struct stat *st,
+                                     Error **errp)
+{
+    BDRVRawState *s = bs->opaque;
+    g_autofree char *model = get_sysfs_queue_attr(st, "zoned");
+    BlockZoneModel zoned;
+    int64_t val;
+    int ret;
+
+    if (!model || !strcmp(model, "none")) {
+        return;
+    } else if (!strcmp(model, "host-managed")) {
+        zoned = BLK_Z_HM;
+    } else if (!strcmp(model, "host-aware")) {
+        zoned = BLK_Z_HA;
+    } else {
+        return;
+    }
+
+    val = get_sysfs_queue_long(st, "chunk_sectors");
+    if (val <= 0 || !is_power_of_2(val)) {
+        error_setg(errp, "Zoned device has an invalid zone size");
+        return;
+    }
+    bs->bl.zone_size = val << BDRV_SECTOR_BITS;
+
+    val = get_sysfs_queue_long(st, "nr_zones");
+    if (val <= 0 || val > UINT32_MAX) {
+        error_setg(errp, "Zoned device has an invalid number of zones");
+        return;
+    }
+    bs->bl.nr_zones = val;
+
+    val = get_sysfs_queue_long(st, "max_open_zones");
+    bs->bl.max_open_zones = MAX(val, 0);
+    val = get_sysfs_queue_long(st, "max_active_zones");
+    bs->bl.max_active_zones = MAX(val, 0);
+
+    /* Appends are regular writes, so they are only limited by the zone */
+    bs->bl.max_append_bytes = MIN(bs->bl.zone_size, BDRV_REQUEST_MAX_BYTES);
+
+    if (!s->wps) {
+        s->wps = g_new(uint64_t, bs->bl.nr_zones);
+        ret = raw_update_wps(bs, 0, bs->bl.nr_zones);
+        if (ret < 0) {
+            error_setg_errno(errp, -ret, "Could not report the zones");
+            g_free(s->wps);
+            s->wps = NULL;
+            return;
+        }
+    }
+
+    bs->bl.zoned = zoned;
+}
+
+/*
+ * Move the write pointer after a regular write to a zoned device.  Called
+ * with the zone lock held.
+ */
+static void raw_zone_update_wp(BlockDriverState *bs, int64_t offset,
+                               int64_t bytes, int ret)
+{
+    BDRVRawState *s = bs->opaque;
+    unsigned int index = offset / bs->bl.zone_size;
+    uint64_t *wp = &s->wps[index];
+
+    if (ret < 0) {
+        raw_update_wps(bs, (int64_t)index * bs->bl.zone_size, 1);
+    } else if (*wp != UINT64_MAX && offset <= *wp && offset + bytes > *wp) {
+        *wp = offset + bytes;
+    }
+}
+#endif /* CONFIG_BLKZONED */
+
 static void raw_refresh_limits(BlockDriverState *bs, Error **errp)
 {
     BDRVRawState *s = bs->opaque;
+#ifdef CONFIG_BLKZONED
+    struct stat st;
+#endif
 
     if (bs->sg) {
         int ret = sg_get_max_transfer_length(s->fd);
@@ -1236,6 +1556,12 @@ static void raw_refresh_limits(BlockDriverState *bs, Error **errp)
     raw_probe_alignment(bs, s->fd, errp);
     bs->bl.min_mem_alignment = s->buf_align;
     bs->bl.opt_mem_alignment = MAX(s->buf_align, qemu_real_host_page_size);
+
+#ifdef CONFIG_BLKZONED
+    if (!fstat(s->fd, &st) && S_ISBLK(st.st_mode)) {
+        raw_refresh_zoned_limits(bs, &st, errp);
+    }
+#endif
 }
 
 static int check_for_dasd(int fd)
@@ -1713,6 +2039,52 @@ static off_t copy_file_range(int in_fd, off_t *in_off, int out_fd,
 }
 #endif
 
+/*
+ * Try to share the extents of the source range with the destination
+ * (reflink).  Unlike copy_file_range(), which may silently fall back to
+ * copying the data in the kernel, this is guaranteed not to move any
+ * data, so try it first.  It only works within a filesystem that supports
+ * it and for ranges aligned to its block size; returns -ENOTSUP otherwise.
+ */
+static int handle_aiocb_clone_range(RawPosixAIOData *aiocb)
+{
+#ifdef FICLONERANGE
+    BDRVRawState *s = aiocb->bs->opaque;
+    struct file_clone_range range = {
+        .src_fd = aiocb->aio_fildes,
+        .src_offset = aiocb->aio_offset,
+        .src_length = aiocb->aio_nbytes,
+        .dest_offset = aiocb->copy_range.aio_offset2,
+    };
+    int ret;
+
+    if (!s->has_clone_range) {
+        return -ENOTSUP;
+    }
+
+    do {
+        ret = ioctl(aiocb->copy_range.aio_fd2, FICLONERANGE, &range);
+    } while (ret < 0 && errno == EINTR);
+    ret = ret < 0 ? -errno : 0;
+    trace_file_clone_range(aiocb->bs, aiocb->aio_fildes, aiocb->aio_offset,
+                           aiocb->copy_range.aio_fd2,
+                           aiocb->copy_range.aio_offset2, aiocb->aio_nbytes,
+                           ret);
+
+    switch (ret) {
+    case 0:
+        return 0;
+    case -EOPNOTSUPP:
+    case -ENOTTY:
+    case -EXDEV:
+        /* Not supported by this filesystem (pair), don't try again */
+        s->has_clone_range = false;
+        break;
+    }
+#endif
+    return -ENOTSUP;
+}
+
 static int handle_aiocb_copy_range(void *opaque)
 {
     RawPosixAIOData *aiocb = opaque;
@@ -1720,6 +2092,10 @@ static int handle_aiocb_copy_range(void *opaque)
     off_t in_off = aiocb->aio_offset;
     off_t out_off = aiocb->copy_range.aio_offset2;
 
+    if (handle_aiocb_clone_range(aiocb) == 0) {
+        return 0;
+    }
+
     while (bytes) {
         ssize_t ret = copy_file_range(aiocb->aio_fildes, &in_off,
                                       aiocb->copy_range.aio_fd2, &out_off,
@@ -1954,13 +2330,59 @@ out:
     return result;
 }
 
+static int coroutine_fn raw_thread_pool_submit_prio(BlockDriverState *bs,
+                                                    ThreadPoolPriority prio,
+                                                    ThreadPoolFunc func,
+                                                    void *arg)
+{
+    /*
+     * @bs can be NULL, bdrv_get_request_aio_context() returns the main
+     * context then
+     */
+    ThreadPool *pool = aio_get_thread_pool(bdrv_get_request_aio_context(bs));
+    return thread_pool_submit_co_prio(pool, prio, func, arg);
+}
+
 static int coroutine_fn raw_thread_pool_submit(BlockDriverState *bs,
                                                ThreadPoolFunc func, void *arg)
 {
-    /* @bs can be NULL, bdrv_get_aio_context() returns the main context then */
-    ThreadPool *pool = aio_get_thread_pool(bdrv_get_aio_context(bs));
-    return thread_pool_submit_co(pool, func, arg);
+    return raw_thread_pool_submit_prio(bs, THREAD_POOL_PRIO_NORMAL, func, arg);
+}
+
+#ifdef CONFIG_LINUX_IO_URING
+/*
+ * Reads and writes of O_DIRECT images go to the polled ring if requested.
+ * Flushes always use the normal ring, IOPOLL does not support them.
+ */
+static int coroutine_fn raw_co_prw_io_uring(BlockDriverState *bs,
+                                            uint64_t offset,
+                                            QEMUIOVector *qiov, int type)
+{
+    BDRVRawState *s = bs->opaque;
+    AioContext *ctx = bdrv_get_request_aio_context(bs);
+    int ret;
+
+    if (s->io_uring_iopoll && !s->io_uring_iopoll_unsupported &&
+        (s->open_flags & O_DIRECT)) {
+        LuringState *aio = aio_get_linux_io_uring_iopoll(ctx);
+
+        ret = luring_co_submit(bs, aio, s->fd, offset, qiov, type);
+        if (ret != -EOPNOTSUPP) {
+            return ret;
+        }
+
+        /* The device has no poll queues, e.g. nvme.poll_queues=0 */
+        if (!s->io_uring_iopoll_unsupported) {
+            warn_report("io_uring: %s does not support polled I/O, "
+                        "falling back to interrupt driven completion",
+                        bs->filename);
+            s->io_uring_iopoll_unsupported = true;
+        }
+    }
+    return luring_co_submit(bs, aio_get_linux_io_uring(ctx), s->fd, offset,
+                            qiov, type);
 }
+#endif
 
 static int coroutine_fn raw_co_prw(BlockDriverState *bs, uint64_t offset,
                                    uint64_t bytes, QEMUIOVector *qiov, int type)
@@ -1981,13 +2403,13 @@ static int coroutine_fn raw_co_prw(BlockDriverState *bs, uint64_t offset,
         type |= QEMU_AIO_MISALIGNED;
 #ifdef CONFIG_LINUX_IO_URING
     } else if (s->use_linux_io_uring) {
-        LuringState *aio = aio_get_linux_io_uring(bdrv_get_aio_context(bs));
         assert(qiov->size == bytes);
-        return luring_co_submit(bs, aio, s->fd, offset, qiov, type);
+        return raw_co_prw_io_uring(bs, offset, qiov, type);
 #endif
 #ifdef CONFIG_LINUX_AIO
     } else if (s->use_linux_aio) {
-        LinuxAioState *aio = aio_get_linux_aio(bdrv_get_aio_context(bs));
+        LinuxAioState *aio =
+            aio_get_linux_aio(bdrv_get_request_aio_context(bs));
         assert(qiov->size == bytes);
         return laio_co_submit(bs, aio, s->fd, offset, qiov, type);
 #endif
@@ -2020,42 +2442,33 @@ static int coroutine_fn raw_co_pwritev(BlockDriverState *bs, uint64_t offset,
                                        uint64_t bytes, QEMUIOVector *qiov,
                                        int flags)
 {
-    assert(flags == 0);
-    return raw_co_prw(bs, offset, bytes, qiov, QEMU_AIO_WRITE);
-}
+    BDRVRawState *s = bs->opaque;
+    int ret;
+#ifdef CONFIG_BLKZONED
+    CoMutex *zone_lock = NULL;
 
-static void raw_aio_plug(BlockDriverState *bs)
-{
-    BDRVRawState __attribute__((unused)) *s = bs->opaque;
-#ifdef CONFIG_LINUX_AIO
-    if (s->use_linux_aio) {
-        LinuxAioState *aio = aio_get_linux_aio(bdrv_get_aio_context(bs));
-        laio_io_plug(bs, aio);
-    }
-#endif
-#ifdef CONFIG_LINUX_IO_URING
-    if (s->use_linux_io_uring) {
-        LuringState *aio = aio_get_linux_io_uring(bdrv_get_aio_context(bs));
-        luring_io_plug(bs, aio);
+    /*
+     * Host-managed devices fail writes that don't start at the write
+     * pointer, so the writes to a zone must reach the device in the order
+     * they were submitted, like the kernel's zone write locking does.
+     */
+    if (s->wps && bs->bl.zoned != BLK_Z_NONE) {
+        zone_lock = raw_zone_lock(s, offset / bs->bl.zone_size);
+        qemu_co_mutex_lock(zone_lock);
     }
 #endif
-}
 
-static void raw_aio_unplug(BlockDriverState *bs)
-{
-    BDRVRawState __attribute__((unused)) *s = bs->opaque;
-#ifdef CONFIG_LINUX_AIO
-    if (s->use_linux_aio) {
-        LinuxAioState *aio = aio_get_linux_aio(bdrv_get_aio_context(bs));
-        laio_io_unplug(bs, aio);
-    }
-#endif
-#ifdef CONFIG_LINUX_IO_URING
-    if (s->use_linux_io_uring) {
-        LuringState *aio = aio_get_linux_io_uring(bdrv_get_aio_context(bs));
-        luring_io_unplug(bs, aio);
+    assert(flags == 0);
+    raw_extent_cache_invalidate(s, offset, bytes, true);
+    ret = raw_co_prw(bs, offset, bytes, qiov, QEMU_AIO_WRITE);
+    raw_extent_cache_invalidate(s, offset, bytes, true);
+#ifdef CONFIG_BLKZONED
+    if (zone_lock) {
+        raw_zone_update_wp(bs, offset, bytes, ret);
+        qemu_co_mutex_unlock(zone_lock);
     }
 #endif
+    return ret;
 }
 
 static int raw_co_flush_to_disk(BlockDriverState *bs)
@@ -2077,7 +2490,8 @@ static int raw_co_flush_to_disk(BlockDriverState *bs)
 
 #ifdef CONFIG_LINUX_IO_URING
     if (s->use_linux_io_uring) {
-        LuringState *aio = aio_get_linux_io_uring(bdrv_get_aio_context(bs));
+        LuringState *aio =
+            aio_get_linux_io_uring(bdrv_get_request_aio_context(bs));
         return luring_co_submit(bs, aio, s->fd, 0, NULL, QEMU_AIO_FLUSH);
     }
 #endif
@@ -2101,23 +2515,108 @@ static void raw_aio_attach_aio_context(BlockDriverState *bs,
 #ifdef CONFIG_LINUX_IO_URING
     if (s->use_linux_io_uring) {
         Error *local_err = NULL;
-        if (!aio_setup_linux_io_uring(new_context, &local_err)) {
+        LuringState *aio = aio_setup_linux_io_uring(new_context,
+                                                    s->io_uring_sqpoll,
+                                                    &local_err);
+        if (!aio) {
             error_reportf_err(local_err, "Unable to use linux io_uring, "
                                          "falling back to thread pool: ");
             s->use_linux_io_uring = false;
+            s->io_uring_iopoll = false;
+        } else if (s->io_uring_fixed_buffers &&
+                   luring_enable_fixed_buffers(aio, &local_err) < 0) {
+            error_reportf_err(local_err, "Unable to use io_uring fixed "
+                                         "buffers: ");
+            s->io_uring_fixed_buffers = false;
         }
     }
+    if (s->use_linux_io_uring && s->io_uring_iopoll) {
+        Error *local_err = NULL;
+        LuringState *aio = aio_setup_linux_io_uring_iopoll(new_context,
+                                                           s->io_uring_sqpoll,
+                                                           &local_err);
+        if (!aio) {
+            error_reportf_err(local_err, "Unable to use polled io_uring: ");
+            s->io_uring_iopoll = false;
+        } else if (s->io_uring_fixed_buffers &&
+                   luring_enable_fixed_buffers(aio, &local_err) < 0) {
+            error_reportf_err(local_err, "Unable to use io_uring fixed "
+                                         "buffers: ");
+            s->io_uring_fixed_buffers = false;
+        }
+    }
+#endif
+}
+
+static void raw_io_uring_forget_fd_in(BlockDriverState *bs, AioContext *ctx,
+                                      int fd)
+{
+#ifdef CONFIG_LINUX_IO_URING
+    BDRVRawState *s = bs->opaque;
+
+    if (s->use_linux_io_uring && fd >= 0) {
+        luring_unregister_fd(aio_get_linux_io_uring(ctx), fd);
+    }
+    if (s->use_linux_io_uring && s->io_uring_iopoll && fd >= 0) {
+        luring_unregister_fd(aio_get_linux_io_uring_iopoll(ctx), fd);
+    }
 #endif
 }
 
+/*
+ * The io_uring rings of the AioContexts may have registered the descriptor
+ * as a fixed file, drop it before the descriptor is closed or the node moves
+ * to another AioContext.
+ */
+static void raw_io_uring_forget_fd(BlockDriverState *bs, int fd)
+{
+    GSList *l;
+
+    raw_io_uring_forget_fd_in(bs, bdrv_get_aio_context(bs), fd);
+    for (l = bs->multiqueue_contexts; l; l = l->next) {
+        raw_io_uring_forget_fd_in(bs, l->data, fd);
+    }
+}
+
+static void raw_aio_detach_aio_context(BlockDriverState *bs)
+{
+    BDRVRawState *s = bs->opaque;
+
+    raw_io_uring_forget_fd_in(bs, bdrv_get_aio_context(bs), s->fd);
+}
+
+/*
+ * Requests from another AioContext use the thread pool, Linux AIO context
+ * and io_uring rings of that AioContext, set them up like for a new home.
+ */
+static void raw_aio_attach_multiqueue_context(BlockDriverState *bs,
+                                              AioContext *ctx)
+{
+    raw_aio_attach_aio_context(bs, ctx);
+}
+
+static void raw_aio_detach_multiqueue_context(BlockDriverState *bs,
+                                              AioContext *ctx)
+{
+    BDRVRawState *s = bs->opaque;
+
+    raw_io_uring_forget_fd_in(bs, ctx, s->fd);
+}
+
 static void raw_close(BlockDriverState *bs)
 {
     BDRVRawState *s = bs->opaque;
 
     if (s->fd >= 0) {
+        raw_io_uring_forget_fd(bs, s->fd);
         qemu_close(s->fd);
         s->fd = -1;
     }
+    qemu_mutex_destroy(&s->extent_cache.lock);
+#ifdef CONFIG_BLKZONED
+    g_free(s->wps);
+    s->wps = NULL;
+#endif
 }
 
 /**
@@ -2143,7 +2642,9 @@ raw_regular_truncate(BlockDriverState *bs, int fd, int64_t offset,
         },
     };
 
-    return raw_thread_pool_submit(bs, handle_aiocb_truncate, &acb);
+    /* Preallocation can write the whole image */
+    return raw_thread_pool_submit_prio(bs, THREAD_POOL_PRIO_BULK,
+                                       handle_aiocb_truncate, &acb);
 }
 
 static int coroutine_fn raw_co_truncate(BlockDriverState *bs, int64_t offset,
@@ -2161,8 +2662,12 @@ static int coroutine_fn raw_co_truncate(BlockDriverState *bs, int64_t offset,
     }
 
     if (S_ISREG(st.st_mode)) {
+        /* The trailing hole moves, so drop everything */
+        raw_extent_cache_invalidate(s, 0, INT64_MAX, false);
         /* Always resizes to the exact @offset */
-        return raw_regular_truncate(bs, s->fd, offset, prealloc, errp);
+        ret = raw_regular_truncate(bs, s->fd, offset, prealloc, errp);
+        raw_extent_cache_invalidate(s, 0, INT64_MAX, false);
+        return ret;
     }
 
     if (prealloc != PREALLOC_MODE_OFF) {
@@ -2669,6 +3174,157 @@ static int find_allocation(BlockDriverState *bs, off_t start,
 #endif
 }
 
+/*
+ * Drops the cached extents that a request to [@offset, @offset + @bytes)
+ * may change.  Writing to data extents doesn't change anything, but
+ * everything else may allocate or deallocate space.
+ */
+static void raw_extent_cache_invalidate(BDRVRawState *s, int64_t offset,
+                                        int64_t bytes, bool write)
+{
+    int64_t end = bytes > INT64_MAX - offset ? INT64_MAX : offset + bytes;
+    int64_t start;
+    int i;
+
+    qemu_mutex_lock(&s->extent_cache.lock);
+    s->extent_cache.generation++;
+    start = s->extent_cache.start;
+    for (i = 0; i < s->extent_cache.nb_extents; i++) {
+        RawExtent *e = &s->extent_cache.extents[i];
+
+        if (start >= end) {
+            break;
+        }
+        if (e->end > offset && (!write || !e->data)) {
+            /* Keep the extents before the one that changes */
+            s->extent_cache.nb_extents = i;
+            break;
+        }
+        start = e->end;
+    }
+    qemu_mutex_unlock(&s->extent_cache.lock);
+}
+
+/* Looks up @start in the cache, returns false if it isn't cached */
+static bool raw_extent_cache_find(BDRVRawState *s, int64_t start,
+                                  int *ret, off_t *data, off_t *hole)
+{
+    int64_t ext_start;
+    bool found = false;
+    int i;
+
+    qemu_mutex_lock(&s->extent_cache.lock);
+    ext_start = s->extent_cache.start;
+    for (i = 0; i < s->extent_cache.nb_extents; i++) {
+        RawExtent *e = &s->extent_cache.extents[i];
+
+        if (start < ext_start) {
+            break;
+        }
+        if (start < e->end) {
+            if (e->end == INT64_MAX) {
+                *ret = -ENXIO;
+            } else if (e->data) {
+                *data = start;
+                *hole = e->end;
+                *ret = 0;
+            } else {
+                *hole = start;
+                *data = e->end;
+                *ret = 0;
+            }
+            found = true;
+            break;
+        }
+        ext_start = e->end;
+    }
+    qemu_mutex_unlock(&s->extent_cache.lock);
+
+    return found;
+}
+
+/*
+ * Like find_allocation(), but looks up several extents at once and caches
+ * them, so that walking the file section by section (as qemu-img convert,
+ * mirror and NBD block status do) takes a fraction of the lseek() calls.
+ *
+ * Allocation changes that don't go through this node can't be seen, so
+ * the cache is only used while nobody else may write to the file.  Unlike
+ * FIEMAP, this keeps the exact semantics of SEEK_DATA/SEEK_HOLE, e.g. for
+ * unwritten extents, and works on NFS.
+ */
+static int raw_find_allocation(BlockDriverState *bs, off_t start,
+                               off_t *data, off_t *hole)
+{
+    BDRVRawState *s = bs->opaque;
+    RawExtent extents[RAW_EXTENT_CACHE_SIZE];
+    int64_t pos = start;
+    int nb_extents = 0;
+    uint64_t generation;
+    int ret;
+
+    if ((s->shared_perm & BLK_PERM_WRITE) || s->type != FTYPE_FILE) {
+        return find_allocation(bs, start, data, hole);
+    }
+
+    if (raw_extent_cache_find(s, start, &ret, data, hole)) {
+        return ret;
+    }
+
+    qemu_mutex_lock(&s->extent_cache.lock);
+    generation = s->extent_cache.generation;
+    qemu_mutex_unlock(&s->extent_cache.lock);
+
+    while (nb_extents < RAW_EXTENT_CACHE_SIZE) {
+        off_t d, h;
+
+        ret = find_allocation(bs, pos, &d, &h);
+        if (ret == -ENXIO) {
+            extents[nb_extents++] = (RawExtent) { .end = INT64_MAX };
+            break;
+        } else if (ret < 0) {
+            break;
+        }
+        if (d == pos) {
+            extents[nb_extents++] = (RawExtent) { .end = h, .data = true };
+            pos = h;
+        } else {
+            extents[nb_extents++] = (RawExtent) { .end = d, .data = false };
+            pos = d;
+        }
+    }
+
+    trace_file_extent_cache_fill(bs, start, nb_extents, ret);
+    if (!nb_extents) {
+        return ret;
+    }
+
+    /*
+     * Requests invalidate both before they are submitted and after they
+     * complete, so if none did in the meantime, our lseek() calls can't
+     * have seen an intermediate state.
+     */
+    qemu_mutex_lock(&s->extent_cache.lock);
+    if (s->extent_cache.generation == generation) {
+        s->extent_cache.start = start;
+        s->extent_cache.nb_extents = nb_extents;
+        memcpy(s->extent_cache.extents, extents,
+               nb_extents * sizeof(extents[0]));
+    }
+    qemu_mutex_unlock(&s->extent_cache.lock);
+
+    if (extents[0].end == INT64_MAX) {
+        return -ENXIO;
+    } else if (extents[0].data) {
+        *data = start;
+        *hole = extents[0].end;
+    } else {
+        *hole = start;
+        *data = extents[0].end;
+    }
+    return 0;
+}
+
 /*
  * Returns the allocation status of the specified offset.
  *
@@ -2704,7 +3360,7 @@ static int coroutine_fn raw_co_block_status(BlockDriverState *bs,
         return BDRV_BLOCK_DATA | BDRV_BLOCK_OFFSET_VALID;
     }
 
-    ret = find_allocation(bs, offset, &data, &hole);
+    ret = raw_find_allocation(bs, offset, &data, &hole);
     if (ret == -ENXIO) {
         /* Trailing hole */
         *pnum = bytes;
@@ -2893,7 +3549,9 @@ raw_do_pdiscard(BlockDriverState *bs, int64_t offset, int bytes, bool blkdev)
         acb.aio_type |= QEMU_AIO_BLKDEV;
     }
 
+    raw_extent_cache_invalidate(s, offset, bytes, false);
     ret = raw_thread_pool_submit(bs, handle_aiocb_discard, &acb);
+    raw_extent_cache_invalidate(s, offset, bytes, false);
     raw_account_discard(s, bytes, ret);
     return ret;
 }
@@ -2911,6 +3569,7 @@ raw_do_pwrite_zeroes(BlockDriverState *bs, int64_t offset, int bytes,
     BDRVRawState *s = bs->opaque;
     RawPosixAIOData acb;
     ThreadPoolFunc *handler;
+    int ret;
 
 #ifdef CONFIG_FALLOCATE
     if (offset + bytes > bs->total_sectors * BDRV_SECTOR_SIZE) {
@@ -2968,7 +3627,10 @@ raw_do_pwrite_zeroes(BlockDriverState *bs, int64_t offset, int bytes,
         handler = handle_aiocb_write_zeroes;
     }
 
-    return raw_thread_pool_submit(bs, handler, &acb);
+    raw_extent_cache_invalidate(s, offset, bytes, false);
+    ret = raw_thread_pool_submit(bs, handler, &acb);
+    raw_extent_cache_invalidate(s, offset, bytes, false);
+    return ret;
 }
 
 static int coroutine_fn raw_co_pwrite_zeroes(
@@ -3108,6 +3770,7 @@ static void raw_set_perm(BlockDriverState *bs, uint64_t perm, uint64_t shared)
     /* For reopen, we have already switched to the new fd (.bdrv_set_perm is
      * called after .bdrv_reopen_commit) */
     if (s->perm_change_fd && s->fd != s->perm_change_fd) {
+        raw_io_uring_forget_fd(bs, s->fd);
         qemu_close(s->fd);
         s->fd = s->perm_change_fd;
         s->open_flags = s->perm_change_flags;
@@ -3154,6 +3817,7 @@ static int coroutine_fn raw_co_copy_range_to(BlockDriverState *bs,
     RawPosixAIOData acb;
     BDRVRawState *s = bs->opaque;
     BDRVRawState *src_s;
+    int ret;
 
     assert(dst->bs == bs);
     if (src->bs->drv->bdrv_co_copy_range_to != raw_co_copy_range_to) {
@@ -3177,7 +3841,12 @@ static int coroutine_fn raw_co_copy_range_to(BlockDriverState *bs,
         },
     };
 
-    return raw_thread_pool_submit(bs, handle_aiocb_copy_range, &acb);
+    /* Cloned ranges take the allocation of the source */
+    raw_extent_cache_invalidate(s, dst_offset, bytes, false);
+    ret = raw_thread_pool_submit_prio(bs, THREAD_POOL_PRIO_BULK,
+                                      handle_aiocb_copy_range, &acb);
+    raw_extent_cache_invalidate(s, dst_offset, bytes, false);
+    return ret;
 }
 
 BlockDriver bdrv_file = {
@@ -3207,9 +3876,11 @@ BlockDriver bdrv_file = {
     .bdrv_co_copy_range_from = raw_co_copy_range_from,
     .bdrv_co_copy_range_to  = raw_co_copy_range_to,
     .bdrv_refresh_limits = raw_refresh_limits,
-    .bdrv_io_plug = raw_aio_plug,
-    .bdrv_io_unplug = raw_aio_unplug,
     .bdrv_attach_aio_context = raw_aio_attach_aio_context,
+    .bdrv_detach_aio_context = raw_aio_detach_aio_context,
+    .bdrv_attach_multiqueue_context = raw_aio_attach_multiqueue_context,
+    .bdrv_detach_multiqueue_context = raw_aio_detach_multiqueue_context,
+    .supports_multiqueue = true,
 
     .bdrv_co_truncate = raw_co_truncate,
     .bdrv_getlength = raw_getlength,
@@ -3519,6 +4190,156 @@ hdev_co_ioctl(BlockDriverState *bs, unsigned long int req, void *buf)
 }
 #endif /* linux */
 
+#ifdef CONFIG_BLKZONED
+static int coroutine_fn hdev_co_zone_report(BlockDriverState *bs,
+                                            int64_t offset,
+                                            unsigned int *nr_zones,
+                                            BlockZoneDescriptor *zones)
+{
+    BDRVRawState *s = bs->opaque;
+    RawPosixAIOData acb = {
+        .bs             = bs,
+        .aio_fildes     = s->fd,
+        .aio_type       = QEMU_AIO_ZONE_REPORT,
+        .aio_offset     = offset,
+        .zone_report    = {
+            .nr_zones       = nr_zones,
+            .zones          = zones,
+        },
+    };
+
+    return raw_thread_pool_submit(bs, handle_aiocb_zone_report, &acb);
+}
+
+/*
+ * Lock the zone locks of the zones @first..@last-1 in index order, so
+ * that operations on overlapping ranges can't deadlock.
+ */
+static void coroutine_fn hdev_zone_lock_range(BDRVRawState *s,
+                                              unsigned int first,
+                                              unsigned int last, bool lock)
+{
+    unsigned int i;
+
+    for (i = 0; i < RAW_ZONE_LOCKS; i++) {
+        if (last - first >= RAW_ZONE_LOCKS ||
+            (i + RAW_ZONE_LOCKS - first % RAW_ZONE_LOCKS) % RAW_ZONE_LOCKS <
+            last - first) {
+            if (lock) {
+                qemu_co_mutex_lock(&s->zone_locks[i]);
+            } else {
+                qemu_co_mutex_unlock(&s->zone_locks[i]);
+            }
+        }
+    }
+}
+
+static int coroutine_fn hdev_co_zone_mgmt(BlockDriverState *bs,
+                                          BlockZoneOp op,
+                                          int64_t offset, int64_t len)
+{
+    BDRVRawState *s = bs->opaque;
+    uint64_t zone_size = bs->bl.zone_size;
+    unsigned int first = offset / zone_size;
+    unsigned int last = DIV_ROUND_UP(offset + len, zone_size);
+    struct blk_zone_range range = {
+        .sector     = offset >> BDRV_SECTOR_BITS,
+        .nr_sectors = len >> BDRV_SECTOR_BITS,
+    };
+    RawPosixAIOData acb;
+    unsigned long cmd;
+    unsigned int i;
+    int ret;
+
+    switch (op) {
+    case BLK_ZO_OPEN:
+        cmd = BLKOPENZONE;
+        break;
+    case BLK_ZO_CLOSE:
+        cmd = BLKCLOSEZONE;
+        break;
+    case BLK_ZO_FINISH:
+        cmd = BLKFINISHZONE;
+        break;
+    case BLK_ZO_RESET:
+        cmd = BLKRESETZONE;
+        break;
+    default:
+        return -ENOTSUP;
+    }
+
+    acb = (RawPosixAIOData) {
+        .bs         = bs,
+        .aio_type   = QEMU_AIO_ZONE_MGMT,
+        .aio_fildes = s->fd,
+        .aio_offset = offset,
+        .aio_nbytes = len,
+        .ioctl      = {
+            .buf        = &range,
+            .cmd        = cmd,
+        },
+    };
+
+    /* No appends may run while the write pointers move */
+    hdev_zone_lock_range(s, first, last, true);
+    raw_extent_cache_invalidate(s, offset, len, true);
+    ret = raw_thread_pool_submit(bs, handle_aiocb_ioctl, &acb);
+    raw_extent_cache_invalidate(s, offset, len, true);
+
+    if (ret < 0) {
+        raw_update_wps(bs, (int64_t)first * zone_size, last - first);
+    } else if (op == BLK_ZO_RESET || op == BLK_ZO_FINISH) {
+        for (i = first; i < last; i++) {
+            if (s->wps[i] == UINT64_MAX) {
+                continue;
+            }
+            s->wps[i] = (uint64_t)i * zone_size;
+            if (op == BLK_ZO_FINISH) {
+                s->wps[i] += zone_size;
+            }
+        }
+    }
+    hdev_zone_lock_range(s, first, last, false);
+
+    return ret;
+}
+
+static int coroutine_fn hdev_co_zone_append(BlockDriverState *bs,
+                                            int64_t *offset,
+                                            QEMUIOVector *qiov,
+                                            BdrvRequestFlags flags)
+{
+    BDRVRawState *s = bs->opaque;
+    unsigned int index = *offset / bs->bl.zone_size;
+    CoMutex *lock = raw_zone_lock(s, index);
+    uint64_t *wp = &s->wps[index];
+    int ret;
+
+    assert(flags == 0);
+
+    qemu_co_mutex_lock(lock);
+    if (*wp == UINT64_MAX ||
+        *wp + qiov->size > *offset + bs->bl.zone_size) {
+        ret = -EINVAL;
+        goto out;
+    }
+
+    *offset = *wp;
+    raw_extent_cache_invalidate(s, *offset, qiov->size, true);
+    ret = raw_co_prw(bs, *offset, qiov->size, qiov, QEMU_AIO_WRITE);
+    raw_extent_cache_invalidate(s, *offset, qiov->size, true);
+
+    if (ret < 0) {
+        raw_update_wps(bs, (int64_t)index * bs->bl.zone_size, 1);
+    } else {
+        *wp += qiov->size;
+    }
+out:
+    qemu_co_mutex_unlock(lock);
+    return ret;
+}
+#endif /* CONFIG_BLKZONED */
+
 static int fd_open(BlockDriverState *bs)
 {
     BDRVRawState *s = bs->opaque;
@@ -3581,9 +4402,11 @@ static BlockDriver bdrv_host_device = {
     .bdrv_co_copy_range_from = raw_co_copy_range_from,
     .bdrv_co_copy_range_to  = raw_co_copy_range_to,
     .bdrv_refresh_limits = raw_refresh_limits,
-    .bdrv_io_plug = raw_aio_plug,
-    .bdrv_io_unplug = raw_aio_unplug,
     .bdrv_attach_aio_context = raw_aio_attach_aio_context,
+    .bdrv_detach_aio_context = raw_aio_detach_aio_context,
+    .bdrv_attach_multiqueue_context = raw_aio_attach_multiqueue_context,
+    .bdrv_detach_multiqueue_context = raw_aio_detach_multiqueue_context,
+    .supports_multiqueue = true,
 
     .bdrv_co_truncate       = raw_co_truncate,
     .bdrv_getlength	= raw_getlength,
@@ -3601,6 +4424,13 @@ static BlockDriver bdrv_host_device = {
 #ifdef __linux__
     .bdrv_co_ioctl          = hdev_co_ioctl,
 #endif
+
+    /* zoned block devices */
+#ifdef CONFIG_BLKZONED
+    .bdrv_co_zone_report    = hdev_co_zone_report,
+    .bdrv_co_zone_mgmt      = hdev_co_zone_mgmt,
+    .bdrv_co_zone_append    = hdev_co_zone_append,
+#endif
 };
 
 #if defined(__linux__) || defined(__FreeBSD__) || defined(__FreeBSD_kernel__)
@@ -3705,9 +4535,8 @@ static BlockDriver bdrv_host_cdrom = {
     .bdrv_co_pwritev        = raw_co_pwritev,
     .bdrv_co_flush_to_disk  = raw_co_flush_to_disk,
     .bdrv_refresh_limits = raw_refresh_limits,
-    .bdrv_io_plug = raw_aio_plug,
-    .bdrv_io_unplug = raw_aio_unplug,
     .bdrv_attach_aio_context = raw_aio_attach_aio_context,
+    .bdrv_detach_aio_context = raw_aio_detach_aio_context,
 
     .bdrv_co_truncate    = raw_co_truncate,
     .bdrv_getlength      = raw_getlength,
@@ -3835,9 +4664,8 @@ static BlockDriver bdrv_host_cdrom = {
     .bdrv_co_pwritev        = raw_co_pwritev,
     .bdrv_co_flush_to_disk  = raw_co_flush_to_disk,
     .bdrv_refresh_limits = raw_refresh_limits,
-    .bdrv_io_plug = raw_aio_plug,
-    .bdrv_io_unplug = raw_aio_unplug,
     .bdrv_attach_aio_context = raw_aio_attach_aio_context,
+    .bdrv_detach_aio_context = raw_aio_detach_aio_context,
 
     .bdrv_co_truncate    = raw_co_truncate,
     .bdrv_getlength      = raw_getlength,
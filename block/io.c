@@ -2028,6 +2028,7 @@ bdrv_co_write_req_finish(BdrvChild *child, int64_t offset, int64_t bytes,
     bdrv_check_request(offset, bytes, &error_abort);
 
     qatomic_inc(&bs->write_gen);
+    bdrv_alloc_index_invalidate_above(bs);
 
     /*
      * Discard cannot extend the image, but in error handling cases, such as
@@ -2562,6 +2563,9 @@ bdrv_co_common_block_status_above(BlockDriverState *bs,
     BlockDriverState *p;
     int64_t eof = 0;
     int dummy;
+    uint64_t index_gen = 0;
+    int64_t layer_bytes = 0;
+    int skip = 0, skipped = 0, queried = 0;
 
     assert(!include_base || base); /* Can't include NULL base */
 
@@ -2588,12 +2592,25 @@ bdrv_co_common_block_status_above(BlockDriverState *bs,
     assert(*pnum <= bytes);
     bytes = *pnum;
 
-    for (p = bdrv_filter_or_cow_bs(bs); include_base || p != base;
-         p = bdrv_filter_or_cow_bs(p))
-    {
+    p = bdrv_filter_or_cow_bs(bs);
+    if (bs->alloc_index) {
+        /* Go straight to the first layer that may have the data */
+        skip = bdrv_alloc_index_lookup(bs->alloc_index, offset, &bytes,
+                                       &index_gen);
+        *pnum = bytes;
+        for (; skip > 0 && p && p != base; skip--) {
+            p = bdrv_filter_or_cow_bs(p);
+            skipped++;
+            ++*depth;
+        }
+    }
+
+    for (; include_base || p != base; p = bdrv_filter_or_cow_bs(p)) {
+        layer_bytes = bytes;
         ret = bdrv_co_block_status(p, want_zero, offset, bytes, pnum, map,
                                    file);
         ++*depth;
+        queried++;
         if (ret < 0) {
             return ret;
         }
@@ -2640,6 +2657,16 @@ bdrv_co_common_block_status_above(BlockDriverState *bs,
         bytes = *pnum;
     }
 
+    /*
+     * All layers but the last one queried are unallocated over the range
+     * that was passed to the last one.  That one is always queried again,
+     * because it determines the status returned for the range.
+     */
+    if (bs->alloc_index && queried && skipped + queried > 1) {
+        bdrv_alloc_index_insert(bs->alloc_index, index_gen, offset,
+                                layer_bytes, skipped + queried - 1);
+    }
+
     if (offset + *pnum == eof) {
         ret |= BDRV_BLOCK_EOF;
     }
@@ -3110,6 +3137,110 @@ out:
     return co.ret;
 }
 
+/* Zone operations change the data like writes do, tell the same users */
+static void bdrv_zone_write_finish(BlockDriverState *bs, int64_t offset,
+                                   int64_t bytes)
+{
+    qatomic_inc(&bs->write_gen);
+    bdrv_alloc_index_invalidate_above(bs);
+    stat64_max(&bs->wr_highest_offset, offset + bytes);
+    bdrv_set_dirty(bs, offset, bytes);
+}
+
+int coroutine_fn bdrv_co_zone_report(BlockDriverState *bs, int64_t offset,
+                                     unsigned int *nr_zones,
+                                     BlockZoneDescriptor *zones)
+{
+    BlockDriver *drv = bs->drv;
+    int ret;
+
+    bdrv_inc_in_flight(bs);
+    if (!drv || !drv->bdrv_co_zone_report || bs->bl.zoned == BLK_Z_NONE) {
+        ret = -ENOTSUP;
+        goto out;
+    }
+
+    ret = bdrv_check_request(offset, 0, NULL);
+    if (ret < 0) {
+        goto out;
+    }
+
+    ret = drv->bdrv_co_zone_report(bs, offset, nr_zones, zones);
+out:
+    bdrv_dec_in_flight(bs);
+    return ret;
+}
+
+int coroutine_fn bdrv_co_zone_mgmt(BlockDriverState *bs, BlockZoneOp op,
+                                   int64_t offset, int64_t len)
+{
+    BlockDriver *drv = bs->drv;
+    int64_t capacity = bdrv_getlength(bs);
+    int ret;
+
+    bdrv_inc_in_flight(bs);
+    if (!drv || !drv->bdrv_co_zone_mgmt || bs->bl.zoned == BLK_Z_NONE) {
+        ret = -ENOTSUP;
+        goto out;
+    }
+
+    ret = bdrv_check_request(offset, len, NULL);
+    if (ret < 0) {
+        goto out;
+    }
+
+    /* The last zone may be smaller, so the range may end at the capacity */
+    if (!QEMU_IS_ALIGNED(offset, bs->bl.zone_size) ||
+        (!QEMU_IS_ALIGNED(len, bs->bl.zone_size) &&
+         offset + len != capacity)) {
+        ret = -EINVAL;
+        goto out;
+    }
+
+    ret = drv->bdrv_co_zone_mgmt(bs, op, offset, len);
+    if (ret == 0 && (op == BLK_ZO_RESET || op == BLK_ZO_FINISH)) {
+        bdrv_zone_write_finish(bs, offset, len);
+    }
+out:
+    bdrv_dec_in_flight(bs);
+    return ret;
+}
+
+int coroutine_fn bdrv_co_zone_append(BlockDriverState *bs, int64_t *offset,
+                                     QEMUIOVector *qiov,
+                                     BdrvRequestFlags flags)
+{
+    BlockDriver *drv = bs->drv;
+    int ret;
+
+    bdrv_inc_in_flight(bs);
+    if (!drv || !drv->bdrv_co_zone_append || bs->bl.zoned == BLK_Z_NONE ||
+        (flags & ~bs->supported_write_flags)) {
+        ret = -ENOTSUP;
+        goto out;
+    }
+
+    ret = bdrv_check_request(*offset, qiov->size, NULL);
+    if (ret < 0) {
+        goto out;
+    }
+
+    if (!QEMU_IS_ALIGNED(*offset, bs->bl.zone_size) ||
+        !QEMU_IS_ALIGNED(qiov->size, bs->bl.request_alignment) ||
+        qiov->size > bs->bl.max_append_bytes) {
+        ret = -EINVAL;
+        goto out;
+    }
+
+    ret = drv->bdrv_co_zone_append(bs, offset, qiov, flags);
+    if (ret == 0) {
+        bdrv_zone_write_finish(bs, *offset, qiov->size);
+    }
+out:
+    bdrv_dec_in_flight(bs);
+    return ret;
+}
+
 void *qemu_blockalign(BlockDriverState *bs, size_t size)
 {
     return qemu_memalign(bdrv_opt_mem_align(bs), size);
@@ -3170,39 +3301,6 @@ void bdrv_add_before_write_notifier(BlockDriverState *bs,
     notifier_with_return_list_add(&bs->before_write_notifiers, notifier);
 }
 
-void bdrv_io_plug(BlockDriverState *bs)
-{
-    BdrvChild *child;
-
-    QLIST_FOREACH(child, &bs->children, next) {
-        bdrv_io_plug(child->bs);
-    }
-
-    if (qatomic_fetch_inc(&bs->io_plugged) == 0) {
-        BlockDriver *drv = bs->drv;
-        if (drv && drv->bdrv_io_plug) {
-            drv->bdrv_io_plug(bs);
-        }
-    }
-}
-
-void bdrv_io_unplug(BlockDriverState *bs)
-{
-    BdrvChild *child;
-
-    assert(bs->io_plugged);
-    if (qatomic_fetch_dec(&bs->io_plugged) == 1) {
-        BlockDriver *drv = bs->drv;
-        if (drv && drv->bdrv_io_unplug) {
-            drv->bdrv_io_unplug(bs);
-        }
-    }
-
-    QLIST_FOREACH(child, &bs->children, next) {
-        bdrv_io_unplug(child->bs);
-    }
-}
-
 void bdrv_register_buf(BlockDriverState *bs, void *host, size_t size)
 {
     BdrvChild *child;
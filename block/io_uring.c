@@ -10,18 +10,34 @@
  */
 #include "qemu/osdep.h"
 #include <liburing.h>
+#include <sys/syscall.h>
 #include "qemu-common.h"
 #include "block/aio.h"
 #include "qemu/queue.h"
 #include "block/block.h"
 #include "block/raw-aio.h"
 #include "qemu/coroutine.h"
+#include "qemu/error-report.h"
+#include "qemu/units.h"
 #include "qapi/error.h"
+#include "exec/ramlist.h"
+#include "exec/cpu-common.h"
+#include "sysemu/block-backend.h"
 #include "trace.h"
 
 /* io_uring ring size */
 #define MAX_ENTRIES 128
 
+/* The kernel limits each fixed buffer to 1 GiB and the table to UIO_MAXIOV */
+#define FIXED_BUFFER_MAX_SIZE (1 * GiB)
+#define FIXED_BUFFERS_MAX 1024
+
+/* Number of slots in the fixed file table */
+#define FIXED_FILES_MAX 64
+
+/* Idle time before the SQPOLL kernel thread goes to sleep, in ms */
+#define SQPOLL_IDLE_MS 1000
+
 typedef struct LuringAIOCB {
     Coroutine *co;
     struct io_uring_sqe sqeq;
@@ -39,7 +55,6 @@ typedef struct LuringAIOCB {
 } LuringAIOCB;
 
 typedef struct LuringQueue {
-    int plugged;
     unsigned int in_queue;
     unsigned int in_flight;
     bool blocked;
@@ -56,6 +71,32 @@ typedef struct LuringState {
 
     /* I/O completion processing.  Only runs in I/O thread.  */
     QEMUBH *completion_bh;
+
+    /*
+     * Guest RAM registered as fixed buffers, sorted by address.  The
+     * table is rebuilt by buffers_bh when RAM blocks come and go.
+     * Protected by AioContext lock.
+     */
+    bool fixed_buffers;
+    RAMBlockNotifier ram_notifier;
+    QEMUBH *buffers_bh;
+    struct iovec *buffers;
+    unsigned int nr_buffers;
+
+    /*
+     * File descriptors registered as fixed files, the index is the slot
+     * in the ring's table and -1 marks a free slot.  Protected by
+     * AioContext lock.
+     */
+    bool fixed_files;
+    int fixed_fds[FIXED_FILES_MAX];
+
+    /*
+     * The ring was created with IORING_SETUP_IOPOLL: the kernel does not
+     * signal the ring fd when requests complete, completions must be
+     * reaped by polling the device with luring_iopoll().
+     */
+    bool iopoll;
 } LuringState;
 
 /**
@@ -70,6 +111,27 @@ static void luring_resubmit(LuringState *s, LuringAIOCB *luringcb)
     s->io_q.in_queue++;
 }
 
+/**
+ * luring_unfix_buffer:
+ *
+ * Turn a fixed buffer request back into a vectored one, for when its
+ * buffer index cannot be used anymore.
+ */
+static void luring_unfix_buffer(LuringAIOCB *luringcb)
+{
+    struct io_uring_sqe *sqe = &luringcb->sqeq;
+
+    if (sqe->opcode != IORING_OP_READ_FIXED &&
+        sqe->opcode != IORING_OP_WRITE_FIXED) {
+        return;
+    }
+    sqe->opcode = sqe->opcode == IORING_OP_READ_FIXED ? IORING_OP_READV :
+                                                        IORING_OP_WRITEV;
+    sqe->addr = (__u64)(uintptr_t)luringcb->qiov->iov;
+    sqe->len = luringcb->qiov->niov;
+    sqe->buf_index = 0;
+}
+
 /**
  * luring_resubmit_short_read:
  *
@@ -103,6 +165,7 @@ static void luring_resubmit_short_read(LuringState *s, LuringAIOCB *luringcb,
                       remaining);
 
     /* Update sqe */
+    luring_unfix_buffer(luringcb);
     luringcb->sqeq.off = nread;
     luringcb->sqeq.addr = (__u64)(uintptr_t)luringcb->resubmit_qiov.iov;
     luringcb->sqeq.len = luringcb->resubmit_qiov.niov;
@@ -110,6 +173,26 @@ static void luring_resubmit_short_read(LuringState *s, LuringAIOCB *luringcb,
     luring_resubmit(s, luringcb);
 }
 
+/**
+ * luring_iopoll:
+ *
+ * Ask the kernel to poll the device for completed requests, which are
+ * then posted to the completion queue.  Does not wait.
+ */
+static void luring_iopoll(LuringState *s)
+{
+    int ret;
+
+    if (!s->iopoll || !s->io_q.in_flight) {
+        return;
+    }
+    ret = syscall(__NR_io_uring_enter, s->ring.ring_fd, 0, 0,
+                  IORING_ENTER_GETEVENTS, NULL, 0);
+    if (ret < 0 && errno != EAGAIN && errno != EINTR) {
+        trace_luring_iopoll_failed(s, errno);
+    }
+}
+
 /**
  * luring_process_completions:
  * @s: AIO state
@@ -122,6 +205,10 @@ static void luring_resubmit_short_read(LuringState *s, LuringAIOCB *luringcb,
  * event loop.  When there are no events left  to complete the BH is being
  * canceled.
  *
+ * For a polled ring new completions do not wake up the event loop, so the
+ * BH stays scheduled for as long as requests are in flight and the event
+ * loop keeps polling (see luring_iopoll()) instead of blocking.
+ *
  */
 static void luring_process_completions(LuringState *s)
 {
@@ -144,6 +231,8 @@ static void luring_process_completions(LuringState *s)
      */
     qemu_bh_schedule(s->completion_bh);
 
+    luring_iopoll(s);
+
     while (io_uring_peek_cqe(&s->ring, &cqes) == 0) {
         LuringAIOCB *luringcb;
         int ret;
@@ -204,7 +293,9 @@ end:
             aio_co_wake(luringcb->co);
         }
     }
-    qemu_bh_cancel(s->completion_bh);
+    if (!s->iopoll || !s->io_q.in_flight) {
+        qemu_bh_cancel(s->completion_bh);
+    }
 }
 
 static int ioq_submit(LuringState *s)
@@ -256,7 +347,7 @@ static void luring_process_completions_and_submit(LuringState *s)
     aio_context_acquire(s->aio_context);
     luring_process_completions(s);
 
-    if (!s->io_q.plugged && s->io_q.in_queue > 0) {
+    if (s->io_q.in_queue > 0) {
         ioq_submit(s);
     }
     aio_context_release(s->aio_context);
@@ -278,6 +369,9 @@ static bool qemu_luring_poll_cb(void *opaque)
 {
     LuringState *s = opaque;
 
+    /* Called from run_poll_handlers(), reap polled completions too */
+    luring_iopoll(s);
+
     if (io_uring_cq_ready(&s->ring)) {
         luring_process_completions_and_submit(s);
         return true;
@@ -289,26 +383,104 @@ static bool qemu_luring_poll_cb(void *opaque)
 static void ioq_init(LuringQueue *io_q)
 {
     QSIMPLEQ_INIT(&io_q->submit_queue);
-    io_q->plugged = 0;
     io_q->in_queue = 0;
     io_q->in_flight = 0;
     io_q->blocked = false;
 }
 
-void luring_io_plug(BlockDriverState *bs, LuringState *s)
+static void luring_unplug_fn(void *opaque)
+{
+    LuringState *s = opaque;
+
+    trace_luring_unplug_fn(s, s->io_q.blocked, s->io_q.in_queue,
+                           s->io_q.in_flight);
+    if (!s->io_q.blocked && s->io_q.in_queue > 0) {
+        ioq_submit(s);
+    }
+}
+
+/**
+ * luring_fixed_buffer:
+ *
+ * Returns the index of the fixed buffer that contains [@base, @base + @len),
+ * or -1 if that memory is not registered.
+ */
+static int luring_fixed_buffer(LuringState *s, void *base, size_t len)
 {
-    trace_luring_io_plug(s);
-    s->io_q.plugged++;
+    uintptr_t start = (uintptr_t)base;
+    unsigned int lo = 0, hi = s->nr_buffers;
+
+    /* Find the last buffer that starts at or before @base */
+    while (lo < hi) {
+        unsigned int mid = lo + (hi - lo) / 2;
+
+        if ((uintptr_t)s->buffers[mid].iov_base <= start) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == 0) {
+        return -1;
+    }
+    lo--;
+    if (start + len > (uintptr_t)s->buffers[lo].iov_base +
+                      s->buffers[lo].iov_len) {
+        return -1;
+    }
+    return lo;
 }
 
-void luring_io_unplug(BlockDriverState *bs, LuringState *s)
+/**
+ * luring_fixed_file:
+ *
+ * Returns the fixed file slot registered for @fd, registering it in a free
+ * slot if needed, or -1 if the fixed file table cannot be used.
+ */
+static int luring_fixed_file(LuringState *s, int fd)
 {
-    assert(s->io_q.plugged);
-    trace_luring_io_unplug(s, s->io_q.blocked, s->io_q.plugged,
-                           s->io_q.in_queue, s->io_q.in_flight);
-    if (--s->io_q.plugged == 0 &&
-        !s->io_q.blocked && s->io_q.in_queue > 0) {
-        ioq_submit(s);
+    int i, free_slot = -1;
+
+    if (!s->fixed_files) {
+        return -1;
+    }
+    for (i = 0; i < FIXED_FILES_MAX; i++) {
+        if (s->fixed_fds[i] == fd) {
+            return i;
+        }
+        if (free_slot < 0 && s->fixed_fds[i] == -1) {
+            free_slot = i;
+        }
+    }
+    if (free_slot < 0 ||
+        io_uring_register_files_update(&s->ring, free_slot, &fd, 1) != 1) {
+        return -1;
+    }
+    trace_luring_register_file(s, fd, free_slot);
+    s->fixed_fds[free_slot] = fd;
+    return free_slot;
+}
+
+/**
+ * luring_unregister_fd:
+ * @s: AIO state
+ * @fd: file descriptor that is going to be closed
+ *
+ * The fixed file table keeps its own reference to the file, and a new file
+ * could reuse the descriptor number, so this must be called before closing
+ * a descriptor that was used with luring_co_submit().
+ */
+void luring_unregister_fd(LuringState *s, int fd)
+{
+    int none = -1;
+    int i;
+
+    for (i = 0; i < FIXED_FILES_MAX; i++) {
+        if (s->fixed_fds[i] == fd) {
+            trace_luring_unregister_file(s, fd, i);
+            io_uring_register_files_update(&s->ring, i, &none, 1);
+            s->fixed_fds[i] = -1;
+        }
     }
 }
 
@@ -328,15 +500,34 @@ static int luring_do_submit(int fd, LuringAIOCB *luringcb, LuringState *s,
 {
     int ret;
     struct io_uring_sqe *sqes = &luringcb->sqeq;
+    int buf_index = -1;
+    int slot;
+
+    if (luringcb->qiov && luringcb->qiov->niov == 1) {
+        buf_index = luring_fixed_buffer(s, luringcb->qiov->iov[0].iov_base,
+                                        luringcb->qiov->iov[0].iov_len);
+    }
 
     switch (type) {
     case QEMU_AIO_WRITE:
-        io_uring_prep_writev(sqes, fd, luringcb->qiov->iov,
-                             luringcb->qiov->niov, offset);
+        if (buf_index >= 0) {
+            io_uring_prep_write_fixed(sqes, fd, luringcb->qiov->iov[0].iov_base,
+                                      luringcb->qiov->iov[0].iov_len, offset,
+                                      buf_index);
+        } else {
+            io_uring_prep_writev(sqes, fd, luringcb->qiov->iov,
+                                 luringcb->qiov->niov, offset);
+        }
         break;
     case QEMU_AIO_READ:
-        io_uring_prep_readv(sqes, fd, luringcb->qiov->iov,
-                            luringcb->qiov->niov, offset);
+        if (buf_index >= 0) {
+            io_uring_prep_read_fixed(sqes, fd, luringcb->qiov->iov[0].iov_base,
+                                     luringcb->qiov->iov[0].iov_len, offset,
+                                     buf_index);
+        } else {
+            io_uring_prep_readv(sqes, fd, luringcb->qiov->iov,
+                                luringcb->qiov->niov, offset);
+        }
         break;
     case QEMU_AIO_FLUSH:
         io_uring_prep_fsync(sqes, fd, IORING_FSYNC_DATASYNC);
@@ -348,16 +539,24 @@ static int luring_do_submit(int fd, LuringAIOCB *luringcb, LuringState *s,
     }
     io_uring_sqe_set_data(sqes, luringcb);
 
+    slot = luring_fixed_file(s, fd);
+    if (slot >= 0) {
+        sqes->fd = slot;
+        sqes->flags |= IOSQE_FIXED_FILE;
+    }
+
     QSIMPLEQ_INSERT_TAIL(&s->io_q.submit_queue, luringcb, next);
     s->io_q.in_queue++;
-    trace_luring_do_submit(s, s->io_q.blocked, s->io_q.plugged,
-                           s->io_q.in_queue, s->io_q.in_flight);
-    if (!s->io_q.blocked &&
-        (!s->io_q.plugged ||
-         s->io_q.in_flight + s->io_q.in_queue >= MAX_ENTRIES)) {
-        ret = ioq_submit(s);
-        trace_luring_do_submit_done(s, ret);
-        return ret;
+    trace_luring_do_submit(s, s->io_q.blocked, s->io_q.in_queue,
+                           s->io_q.in_flight);
+    if (!s->io_q.blocked) {
+        if (s->io_q.in_flight + s->io_q.in_queue >= MAX_ENTRIES) {
+            ret = ioq_submit(s);
+            trace_luring_do_submit_done(s, ret);
+            return ret;
+        }
+
+        blk_io_plug_call(luring_unplug_fn, s);
     }
     return 0;
 }
@@ -386,11 +585,143 @@ int coroutine_fn luring_co_submit(BlockDriverState *bs, LuringState *s, int fd,
     return luringcb.ret;
 }
 
+static int luring_add_ram_block(RAMBlock *rb, void *opaque)
+{
+    GArray *buffers = opaque;
+    uint8_t *host = qemu_ram_get_host_addr(rb);
+    ram_addr_t size = qemu_ram_get_used_length(rb);
+
+    while (size && buffers->len < FIXED_BUFFERS_MAX) {
+        struct iovec iov = {
+            .iov_base = host,
+            .iov_len = MIN(size, FIXED_BUFFER_MAX_SIZE),
+        };
+
+        g_array_append_val(buffers, iov);
+        host += iov.iov_len;
+        size -= iov.iov_len;
+    }
+    return 0;
+}
+
+static gint luring_buffer_cmp(gconstpointer a, gconstpointer b)
+{
+    uintptr_t base_a = (uintptr_t)((const struct iovec *)a)->iov_base;
+    uintptr_t base_b = (uintptr_t)((const struct iovec *)b)->iov_base;
+
+    return base_a < base_b ? -1 : base_a > base_b;
+}
+
+/*
+ * Register the current RAM blocks as fixed buffers, replacing the old
+ * table.  Runs in the AioContext, so no new request can pick an index
+ * while the table changes.
+ */
+static void luring_update_buffers(LuringState *s)
+{
+    LuringAIOCB *luringcb;
+    GArray *buffers;
+    int ret = 0;
+
+    /*
+     * Entries that are already in the submission ring get their buffer
+     * looked up by the kernel when it consumes them, try again once it
+     * has.
+     */
+    if (io_uring_sq_ready(&s->ring)) {
+        qemu_bh_schedule(s->buffers_bh);
+        return;
+    }
+
+    /* Queued requests would use the indexes of the old table */
+    QSIMPLEQ_FOREACH(luringcb, &s->io_q.submit_queue, next) {
+        luring_unfix_buffer(luringcb);
+    }
+
+    if (s->nr_buffers) {
+        io_uring_unregister_buffers(&s->ring);
+        g_free(s->buffers);
+        s->buffers = NULL;
+        s->nr_buffers = 0;
+    }
+
+    buffers = g_array_new(false, false, sizeof(struct iovec));
+    qemu_ram_foreach_block(luring_add_ram_block, buffers);
+    g_array_sort(buffers, luring_buffer_cmp);
+    if (buffers->len) {
+        ret = io_uring_register_buffers(&s->ring,
+                                        (struct iovec *)buffers->data,
+                                        buffers->len);
+    }
+    trace_luring_register_buffers(s, buffers->len, ret);
+    if (ret < 0) {
+        warn_report_once("io_uring: could not register guest RAM as fixed "
+                         "buffers: %s", strerror(-ret));
+        g_array_free(buffers, true);
+        return;
+    }
+    s->nr_buffers = buffers->len;
+    s->buffers = (struct iovec *)g_array_free(buffers, false);
+}
+
+static void luring_buffers_bh(void *opaque)
+{
+    LuringState *s = opaque;
+
+    aio_context_acquire(s->aio_context);
+    luring_update_buffers(s);
+    aio_context_release(s->aio_context);
+}
+
+static void luring_ram_block_changed(RAMBlockNotifier *n, void *host,
+                                     size_t size)
+{
+    LuringState *s = container_of(n, LuringState, ram_notifier);
+
+    qemu_bh_schedule(s->buffers_bh);
+}
+
+/**
+ * luring_enable_fixed_buffers:
+ * @s: AIO state
+ * @errp: pointer to an error
+ *
+ * Register guest RAM with the ring, so that the kernel does not need to
+ * pin and unpin the pages of each request that fits in one RAM block.
+ * The pages stay pinned for the lifetime of the ring.
+ *
+ * Returns 0 for success or -errno in case of error
+ */
+int luring_enable_fixed_buffers(LuringState *s, Error **errp)
+{
+    int ret;
+
+    if (s->fixed_buffers) {
+        return 0;
+    }
+
+    /* Discarding pinned pages would not give any memory back */
+    ret = ram_block_discard_disable(true);
+    if (ret) {
+        error_setg_errno(errp, -ret, "cannot register guest RAM with "
+                         "io_uring while RAM discarding is required");
+        return ret;
+    }
+
+    s->fixed_buffers = true;
+    s->ram_notifier.ram_block_added = luring_ram_block_changed;
+    s->ram_notifier.ram_block_removed = luring_ram_block_changed;
+    ram_block_notifier_add(&s->ram_notifier);
+    qemu_bh_schedule(s->buffers_bh);
+    return 0;
+}
+
 void luring_detach_aio_context(LuringState *s, AioContext *old_context)
 {
     aio_set_fd_handler(old_context, s->ring.ring_fd, false, NULL, NULL, NULL,
                        s);
     qemu_bh_delete(s->completion_bh);
+    qemu_bh_delete(s->buffers_bh);
     s->aio_context = NULL;
 }
 
@@ -398,24 +729,50 @@ void luring_attach_aio_context(LuringState *s, AioContext *new_context)
 {
     s->aio_context = new_context;
     s->completion_bh = aio_bh_new(new_context, qemu_luring_completion_bh, s);
+    s->buffers_bh = aio_bh_new(new_context, luring_buffers_bh, s);
     aio_set_fd_handler(s->aio_context, s->ring.ring_fd, false,
                        qemu_luring_completion_cb, NULL, qemu_luring_poll_cb, s);
 }
 
-LuringState *luring_init(Error **errp)
+LuringState *luring_init(bool sqpoll, bool iopoll, Error **errp)
 {
-    int rc;
+    int rc, i;
     LuringState *s = g_new0(LuringState, 1);
     struct io_uring *ring = &s->ring;
+    unsigned int flags = iopoll ? IORING_SETUP_IOPOLL : 0;
 
     trace_luring_init_state(s, sizeof(*s));
 
-    rc = io_uring_queue_init(MAX_ENTRIES, ring, 0);
-    if (rc < 0) {
-        error_setg_errno(errp, errno, "failed to init linux io_uring ring");
-        g_free(s);
-        return NULL;
+    if (sqpoll) {
+        struct io_uring_params params = {
+            .flags = flags | IORING_SETUP_SQPOLL,
+            .sq_thread_idle = SQPOLL_IDLE_MS,
+        };
+
+        rc = io_uring_queue_init_params(MAX_ENTRIES, ring, &params);
+        if (rc < 0) {
+            warn_report("io_uring: cannot use a submission queue polling "
+                        "thread: %s", strerror(-rc));
+            sqpoll = false;
+        }
+    }
+    if (!sqpoll) {
+        rc = io_uring_queue_init(MAX_ENTRIES, ring, flags);
+        if (rc < 0) {
+            error_setg_errno(errp, errno, "failed to init linux io_uring ring");
+            g_free(s);
+            return NULL;
+        }
+    }
+
+    /* A sparse table, slots are filled as the files are used */
+    for (i = 0; i < FIXED_FILES_MAX; i++) {
+        s->fixed_fds[i] = -1;
     }
+    s->fixed_files = io_uring_register_files(ring, s->fixed_fds,
+                                             FIXED_FILES_MAX) == 0;
+    s->iopoll = iopoll;
+    trace_luring_init_features(s, sqpoll, iopoll, s->fixed_files);
 
     ioq_init(&s->io_q);
     return s;
@@ -424,6 +781,11 @@ LuringState *luring_init(Error **errp)
 
 void luring_cleanup(LuringState *s)
 {
+    if (s->fixed_buffers) {
+        ram_block_notifier_remove(&s->ram_notifier);
+        ram_block_discard_disable(false);
+        g_free(s->buffers);
+    }
     io_uring_queue_exit(&s->ring);
     trace_luring_cleanup_state(s);
     g_free(s);
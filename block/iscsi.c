@@ -62,14 +62,33 @@ QEMU_BUILD_BUG_ON((int)SCSI_XFER_NONE != (int)ISCSI_XFER_NONE);
 #include <scsi/sg.h>
 #endif
 
-typedef struct IscsiLun {
+typedef struct IscsiLun IscsiLun;
+
+/*
+ * One login to the target.  A LUN can be reached through several of them,
+ * possibly through different portals, to spread the load over several TCP
+ * connections and to keep going while a portal is unreachable.
+ */
+typedef struct IscsiSession {
     struct iscsi_context *iscsi;
+    IscsiLun *iscsilun;
+    char *portal;
+    int events;
+    bool request_timed_out;
+} IscsiSession;
+
+struct IscsiLun {
+    /* sessions[0].iscsi, also used for everything but data transfers */
+    struct iscsi_context *iscsi;
+    IscsiSession *sessions;
+    int num_sessions;
+    IscsiPathPolicy path_policy;
+    unsigned next_session;
     AioContext *aio_context;
     int lun;
     enum scsi_inquiry_peripheral_device_type type;
     int block_size;
     uint64_t num_blocks;
-    int events;
     QEMUTimer *nop_timer;
     QEMUTimer *event_timer;
     QemuMutex mutex;
@@ -101,8 +120,7 @@ typedef struct IscsiLun {
     bool lbprz;
     bool dpofua;
     bool has_write_same;
-    bool request_timed_out;
-} IscsiLun;
+};
 
 typedef struct IscsiTask {
     int status;
@@ -112,6 +130,7 @@ typedef struct IscsiTask {
     struct scsi_task *task;
     Coroutine *co;
     IscsiLun *iscsilun;
+    IscsiSession *session;
     QEMUTimer retry_timer;
     int err_code;
     char *err_str;
@@ -136,6 +155,7 @@ typedef struct IscsiAIOCB {
 #define EVENT_INTERVAL 1000
 #define NOP_INTERVAL 5000
 #define MAX_NOP_FAILURES 3
+#define MAX_SESSIONS 16
 #define ISCSI_CMD_RETRIES ARRAY_SIZE(iscsi_retry_times)
 static const unsigned iscsi_retry_times[] = {8, 32, 128, 512, 2048, 8192, 32768};
 
@@ -256,7 +276,7 @@ iscsi_co_generic_cb(struct iscsi_context *iscsi, int status,
                     /* make sure the request is rescheduled AFTER the
                      * reconnect is initiated */
                     retry_time = EVENT_INTERVAL * 2;
-                    iTask->iscsilun->request_timed_out = true;
+                    iTask->session->request_timed_out = true;
                 }
                 error_report("iSCSI Busy/TaskSetFull/TimeOut"
                              " (retry #%u in %u ms): %s",
@@ -295,9 +315,55 @@ static void iscsi_co_init_iscsitask(IscsiLun *iscsilun, struct IscsiTask *iTask)
     *iTask = (struct IscsiTask) {
         .co         = qemu_coroutine_self(),
         .iscsilun   = iscsilun,
+        .session    = &iscsilun->sessions[0],
     };
 }
 
+static bool iscsi_session_usable(IscsiSession *session)
+{
+    return !session->request_timed_out && iscsi_is_logged_in(session->iscsi);
+}
+
+/*
+ * Pick the session for a data transfer of @iTask and return its context.
+ * Sessions that timed out or are logging in again are avoided as long as
+ * another one is up, which fails commands over to the other portals.
+ *
+ * Called with QemuMutex held.
+ */
+static struct iscsi_context *iscsi_task_session(IscsiLun *iscsilun,
+                                                struct IscsiTask *iTask)
+{
+    IscsiSession *best = NULL;
+    int i, n = iscsilun->num_sessions;
+
+    for (i = 0; i < n; i++) {
+        IscsiSession *session;
+
+        session = &iscsilun->sessions[(iscsilun->next_session + i) % n];
+        if (!iscsi_session_usable(session)) {
+            continue;
+        }
+        if (iscsilun->path_policy == QAPI_ISCSI_PATH_POLICY_ROUND_ROBIN) {
+            best = session;
+            break;
+        }
+        if (!best ||
+            iscsi_queue_length(session->iscsi) <
+            iscsi_queue_length(best->iscsi)) {
+            best = session;
+        }
+    }
+    if (!best) {
+        /* every path is down, queue on the next one until it is back */
+        best = &iscsilun->sessions[iscsilun->next_session % n];
+    }
+
+    iscsilun->next_session = best - iscsilun->sessions + 1;
+    iTask->session = best;
+    return best->iscsi;
+}
+
 #ifdef __linux__
 
 /* Called (via iscsi_service) with QemuMutex held. */
@@ -353,40 +419,46 @@ static void iscsi_process_write(void *arg);
 
 /* Called with QemuMutex held.  */
 static void
-iscsi_set_events(IscsiLun *iscsilun)
+iscsi_set_events(IscsiSession *session)
 {
-    struct iscsi_context *iscsi = iscsilun->iscsi;
+    struct iscsi_context *iscsi = session->iscsi;
     int ev = iscsi_which_events(iscsi);
 
-    if (ev != iscsilun->events) {
-        aio_set_fd_handler(iscsilun->aio_context, iscsi_get_fd(iscsi),
+    if (ev != session->events) {
+        aio_set_fd_handler(session->iscsilun->aio_context,
+                           iscsi_get_fd(iscsi),
                            false,
                            (ev & POLLIN) ? iscsi_process_read : NULL,
                            (ev & POLLOUT) ? iscsi_process_write : NULL,
                            NULL,
-                           iscsilun);
-        iscsilun->events = ev;
+                           session);
+        session->events = ev;
     }
 }
 
 static void iscsi_timed_check_events(void *opaque)
 {
     IscsiLun *iscsilun = opaque;
+    int i;
 
     WITH_QEMU_LOCK_GUARD(&iscsilun->mutex) {
-        /* check for timed out requests */
-        iscsi_service(iscsilun->iscsi, 0);
+        for (i = 0; i < iscsilun->num_sessions; i++) {
+            IscsiSession *session = &iscsilun->sessions[i];
 
-        if (iscsilun->request_timed_out) {
-            iscsilun->request_timed_out = false;
-            iscsi_reconnect(iscsilun->iscsi);
-        }
+            /* check for timed out requests */
+            iscsi_service(session->iscsi, 0);
+
+            if (session->request_timed_out) {
+                session->request_timed_out = false;
+                iscsi_reconnect(session->iscsi);
+            }
 
-        /*
-         * newer versions of libiscsi may return zero events. Ensure we are
-         * able to return to service once this situation changes.
-         */
-        iscsi_set_events(iscsilun);
+            /*
+             * newer versions of libiscsi may return zero events. Ensure we
+             * are able to return to service once this situation changes.
+             */
+            iscsi_set_events(session);
+        }
     }
 
     timer_mod(iscsilun->event_timer,
@@ -396,24 +468,24 @@ static void iscsi_timed_check_events(void *opaque)
 static void
 iscsi_process_read(void *arg)
 {
-    IscsiLun *iscsilun = arg;
-    struct iscsi_context *iscsi = iscsilun->iscsi;
+    IscsiSession *session = arg;
+    IscsiLun *iscsilun = session->iscsilun;
 
     qemu_mutex_lock(&iscsilun->mutex);
-    iscsi_service(iscsi, POLLIN);
-    iscsi_set_events(iscsilun);
+    iscsi_service(session->iscsi, POLLIN);
+    iscsi_set_events(session);
     qemu_mutex_unlock(&iscsilun->mutex);
 }
 
 static void
 iscsi_process_write(void *arg)
 {
-    IscsiLun *iscsilun = arg;
-    struct iscsi_context *iscsi = iscsilun->iscsi;
+    IscsiSession *session = arg;
+    IscsiLun *iscsilun = session->iscsilun;
 
     qemu_mutex_lock(&iscsilun->mutex);
-    iscsi_service(iscsi, POLLOUT);
-    iscsi_set_events(iscsilun);
+    iscsi_service(session->iscsi, POLLOUT);
+    iscsi_set_events(session);
     qemu_mutex_unlock(&iscsilun->mutex);
 }
 
@@ -591,7 +663,7 @@ static void coroutine_fn iscsi_co_wait_for_task(IscsiTask *iTask,
                                                 IscsiLun *iscsilun)
 {
     while (!iTask->complete) {
-        iscsi_set_events(iscsilun);
+        iscsi_set_events(iTask->session);
         qemu_mutex_unlock(&iscsilun->mutex);
         qemu_coroutine_yield();
         qemu_mutex_lock(&iscsilun->mutex);
@@ -604,6 +676,7 @@ iscsi_co_writev(BlockDriverState *bs, int64_t sector_num, int nb_sectors,
 {
     IscsiLun *iscsilun = bs->opaque;
     struct IscsiTask iTask;
+    struct iscsi_context *iscsi;
     uint64_t lba;
     uint32_t num_sectors;
     bool fua = flags & BDRV_REQ_FUA;
@@ -625,27 +698,28 @@ iscsi_co_writev(BlockDriverState *bs, int64_t sector_num, int nb_sectors,
     iscsi_co_init_iscsitask(iscsilun, &iTask);
     qemu_mutex_lock(&iscsilun->mutex);
 retry:
+    iscsi = iscsi_task_session(iscsilun, &iTask);
     if (iscsilun->use_16_for_rw) {
 #if LIBISCSI_API_VERSION >= (20160603)
-        iTask.task = iscsi_write16_iov_task(iscsilun->iscsi, iscsilun->lun, lba,
+        iTask.task = iscsi_write16_iov_task(iscsi, iscsilun->lun, lba,
                                             NULL, num_sectors * iscsilun->block_size,
                                             iscsilun->block_size, 0, 0, fua, 0, 0,
                                             iscsi_co_generic_cb, &iTask,
                                             (struct scsi_iovec *)iov->iov, iov->niov);
     } else {
-        iTask.task = iscsi_write10_iov_task(iscsilun->iscsi, iscsilun->lun, lba,
+        iTask.task = iscsi_write10_iov_task(iscsi, iscsilun->lun, lba,
                                             NULL, num_sectors * iscsilun->block_size,
                                             iscsilun->block_size, 0, 0, fua, 0, 0,
                                             iscsi_co_generic_cb, &iTask,
                                             (struct scsi_iovec *)iov->iov, iov->niov);
     }
 #else
-        iTask.task = iscsi_write16_task(iscsilun->iscsi, iscsilun->lun, lba,
+        iTask.task = iscsi_write16_task(iscsi, iscsilun->lun, lba,
                                         NULL, num_sectors * iscsilun->block_size,
                                         iscsilun->block_size, 0, 0, fua, 0, 0,
                                         iscsi_co_generic_cb, &iTask);
     } else {
-        iTask.task = iscsi_write10_task(iscsilun->iscsi, iscsilun->lun, lba,
+        iTask.task = iscsi_write10_task(iscsi, iscsilun->lun, lba,
                                         NULL, num_sectors * iscsilun->block_size,
                                         iscsilun->block_size, 0, 0, fua, 0, 0,
                                         iscsi_co_generic_cb, &iTask);
@@ -701,6 +775,7 @@ static int coroutine_fn iscsi_co_block_status(BlockDriverState *bs,
     struct scsi_get_lba_status *lbas = NULL;
     struct scsi_lba_status_descriptor *lbasd = NULL;
     struct IscsiTask iTask;
+    struct iscsi_context *iscsi;
     uint64_t lba, max_bytes;
     int ret;
 
@@ -725,7 +800,8 @@ static int coroutine_fn iscsi_co_block_status(BlockDriverState *bs,
 
     qemu_mutex_lock(&iscsilun->mutex);
 retry:
-    if (iscsi_get_lba_status_task(iscsilun->iscsi, iscsilun->lun,
+    iscsi = iscsi_task_session(iscsilun, &iTask);
+    if (iscsi_get_lba_status_task(iscsi, iscsilun->lun,
                                   lba, 8 + 16, iscsi_co_generic_cb,
                                   &iTask) == NULL) {
         ret = -ENOMEM;
@@ -803,6 +879,7 @@ static int coroutine_fn iscsi_co_readv(BlockDriverState *bs,
 {
     IscsiLun *iscsilun = bs->opaque;
     struct IscsiTask iTask;
+    struct iscsi_context *iscsi;
     uint64_t lba;
     uint32_t num_sectors;
     int r = 0;
@@ -860,15 +937,16 @@ static int coroutine_fn iscsi_co_readv(BlockDriverState *bs,
     iscsi_co_init_iscsitask(iscsilun, &iTask);
     qemu_mutex_lock(&iscsilun->mutex);
 retry:
+    iscsi = iscsi_task_session(iscsilun, &iTask);
     if (iscsilun->use_16_for_rw) {
 #if LIBISCSI_API_VERSION >= (20160603)
-        iTask.task = iscsi_read16_iov_task(iscsilun->iscsi, iscsilun->lun, lba,
+        iTask.task = iscsi_read16_iov_task(iscsi, iscsilun->lun, lba,
                                            num_sectors * iscsilun->block_size,
                                            iscsilun->block_size, 0, 0, 0, 0, 0,
                                            iscsi_co_generic_cb, &iTask,
                                            (struct scsi_iovec *)iov->iov, iov->niov);
     } else {
-        iTask.task = iscsi_read10_iov_task(iscsilun->iscsi, iscsilun->lun, lba,
+        iTask.task = iscsi_read10_iov_task(iscsi, iscsilun->lun, lba,
                                            num_sectors * iscsilun->block_size,
                                            iscsilun->block_size,
                                            0, 0, 0, 0, 0,
@@ -876,12 +954,12 @@ retry:
                                            (struct scsi_iovec *)iov->iov, iov->niov);
     }
 #else
-        iTask.task = iscsi_read16_task(iscsilun->iscsi, iscsilun->lun, lba,
+        iTask.task = iscsi_read16_task(iscsi, iscsilun->lun, lba,
                                        num_sectors * iscsilun->block_size,
                                        iscsilun->block_size, 0, 0, 0, 0, 0,
                                        iscsi_co_generic_cb, &iTask);
     } else {
-        iTask.task = iscsi_read10_task(iscsilun->iscsi, iscsilun->lun, lba,
+        iTask.task = iscsi_read10_task(iscsi, iscsilun->lun, lba,
                                        num_sectors * iscsilun->block_size,
                                        iscsilun->block_size,
                                        0, 0, 0, 0, 0,
@@ -922,12 +1000,14 @@ static int coroutine_fn iscsi_co_flush(BlockDriverState *bs)
 {
     IscsiLun *iscsilun = bs->opaque;
     struct IscsiTask iTask;
+    struct iscsi_context *iscsi;
     int r = 0;
 
     iscsi_co_init_iscsitask(iscsilun, &iTask);
     qemu_mutex_lock(&iscsilun->mutex);
 retry:
-    if (iscsi_synchronizecache10_task(iscsilun->iscsi, iscsilun->lun, 0, 0, 0,
+    iscsi = iscsi_task_session(iscsilun, &iTask);
+    if (iscsi_synchronizecache10_task(iscsi, iscsilun->lun, 0, 0, 0,
                                       0, iscsi_co_generic_cb, &iTask) == NULL) {
         qemu_mutex_unlock(&iscsilun->mutex);
         return -ENOMEM;
@@ -1120,7 +1200,7 @@ static BlockAIOCB *iscsi_aio_ioctl(BlockDriverState *bs,
         }
     }
 
-    iscsi_set_events(iscsilun);
+    iscsi_set_events(&iscsilun->sessions[0]);
     qemu_mutex_unlock(&iscsilun->mutex);
 
     return &acb->common;
@@ -1145,6 +1225,7 @@ coroutine_fn iscsi_co_pdiscard(BlockDriverState *bs, int64_t offset, int bytes)
 {
     IscsiLun *iscsilun = bs->opaque;
     struct IscsiTask iTask;
+    struct iscsi_context *iscsi;
     struct unmap_list list;
     int r = 0;
 
@@ -1163,7 +1244,8 @@ coroutine_fn iscsi_co_pdiscard(BlockDriverState *bs, int64_t offset, int bytes)
     iscsi_co_init_iscsitask(iscsilun, &iTask);
     qemu_mutex_lock(&iscsilun->mutex);
 retry:
-    if (iscsi_unmap_task(iscsilun->iscsi, iscsilun->lun, 0, 0, &list, 1,
+    iscsi = iscsi_task_session(iscsilun, &iTask);
+    if (iscsi_unmap_task(iscsi, iscsilun->lun, 0, 0, &list, 1,
                          iscsi_co_generic_cb, &iTask) == NULL) {
         r = -ENOMEM;
         goto out_unlock;
@@ -1209,6 +1291,7 @@ coroutine_fn iscsi_co_pwrite_zeroes(BlockDriverState *bs, int64_t offset,
 {
     IscsiLun *iscsilun = bs->opaque;
     struct IscsiTask iTask;
+    struct iscsi_context *iscsi;
     uint64_t lba;
     uint32_t nb_blocks;
     bool use_16_for_ws = iscsilun->use_16_for_rw;
@@ -1249,13 +1332,14 @@ coroutine_fn iscsi_co_pwrite_zeroes(BlockDriverState *bs, int64_t offset,
     qemu_mutex_lock(&iscsilun->mutex);
     iscsi_co_init_iscsitask(iscsilun, &iTask);
 retry:
+    iscsi = iscsi_task_session(iscsilun, &iTask);
     if (use_16_for_ws) {
-        iTask.task = iscsi_writesame16_task(iscsilun->iscsi, iscsilun->lun, lba,
+        iTask.task = iscsi_writesame16_task(iscsi, iscsilun->lun, lba,
                                             iscsilun->zeroblock, iscsilun->block_size,
                                             nb_blocks, 0, !!(flags & BDRV_REQ_MAY_UNMAP),
                                             0, 0, iscsi_co_generic_cb, &iTask);
     } else {
-        iTask.task = iscsi_writesame10_task(iscsilun->iscsi, iscsilun->lun, lba,
+        iTask.task = iscsi_writesame10_task(iscsi, iscsilun->lun, lba,
                                             iscsilun->zeroblock, iscsilun->block_size,
                                             nb_blocks, 0, !!(flags & BDRV_REQ_MAY_UNMAP),
                                             0, 0, iscsi_co_generic_cb, &iTask);
@@ -1393,18 +1477,28 @@ static char *get_initiator_name(QemuOpts *opts)
 static void iscsi_nop_timed_event(void *opaque)
 {
     IscsiLun *iscsilun = opaque;
+    int i;
 
     QEMU_LOCK_GUARD(&iscsilun->mutex);
-    if (iscsi_get_nops_in_flight(iscsilun->iscsi) >= MAX_NOP_FAILURES) {
-        error_report("iSCSI: NOP timeout. Reconnecting...");
-        iscsilun->request_timed_out = true;
-    } else if (iscsi_nop_out_async(iscsilun->iscsi, NULL, NULL, 0, NULL) != 0) {
-        error_report("iSCSI: failed to sent NOP-Out. Disabling NOP messages.");
-        return;
+    for (i = 0; i < iscsilun->num_sessions; i++) {
+        IscsiSession *session = &iscsilun->sessions[i];
+
+        if (iscsi_get_nops_in_flight(session->iscsi) >= MAX_NOP_FAILURES) {
+            error_report("iSCSI: NOP timeout on %s. Reconnecting...",
+                         session->portal);
+            session->request_timed_out = true;
+        } else if (iscsi_nop_out_async(session->iscsi,
+                                       NULL, NULL, 0, NULL) != 0) {
+            error_report("iSCSI: failed to sent NOP-Out. "
+                         "Disabling NOP messages.");
+            return;
+        }
     }
 
     timer_mod(iscsilun->nop_timer, qemu_clock_get_ms(QEMU_CLOCK_REALTIME) + NOP_INTERVAL);
-    iscsi_set_events(iscsilun);
+    for (i = 0; i < iscsilun->num_sessions; i++) {
+        iscsi_set_events(&iscsilun->sessions[i]);
+    }
 }
 
 static void iscsi_readcapacity_sync(IscsiLun *iscsilun, Error **errp)
@@ -1518,10 +1612,15 @@ fail_with_err:
 static void iscsi_detach_aio_context(BlockDriverState *bs)
 {
     IscsiLun *iscsilun = bs->opaque;
+    int i;
+
+    for (i = 0; i < iscsilun->num_sessions; i++) {
+        IscsiSession *session = &iscsilun->sessions[i];
 
-    aio_set_fd_handler(iscsilun->aio_context, iscsi_get_fd(iscsilun->iscsi),
-                       false, NULL, NULL, NULL, NULL);
-    iscsilun->events = 0;
+        aio_set_fd_handler(iscsilun->aio_context, iscsi_get_fd(session->iscsi),
+                           false, NULL, NULL, NULL, NULL);
+        session->events = 0;
+    }
 
     if (iscsilun->nop_timer) {
         timer_free(iscsilun->nop_timer);
@@ -1537,9 +1636,12 @@ static void iscsi_attach_aio_context(BlockDriverState *bs,
                                      AioContext *new_context)
 {
     IscsiLun *iscsilun = bs->opaque;
+    int i;
 
     iscsilun->aio_context = new_context;
-    iscsi_set_events(iscsilun);
+    for (i = 0; i < iscsilun->num_sessions; i++) {
+        iscsi_set_events(&iscsilun->sessions[i]);
+    }
 
     /* Set up a timer for sending out iSCSI NOPs */
     iscsilun->nop_timer = aio_timer_new(iscsilun->aio_context,
@@ -1744,6 +1846,14 @@ static QemuOptsList runtime_opts = {
             .name = "timeout",
             .type = QEMU_OPT_NUMBER,
         },
+        {
+            .name = "sessions",
+            .type = QEMU_OPT_NUMBER,
+        },
+        {
+            .name = "path-policy",
+            .type = QEMU_OPT_STRING,
+        },
         { /* end of list */ }
     },
 };
@@ -1772,24 +1882,122 @@ static void iscsi_save_designator(IscsiLun *lun,
     }
 }
 
+/* Create a context for @portal and log in to the LUN with it */
+static struct iscsi_context *iscsi_session_connect(QemuOpts *opts,
+                                                   const char *initiator_name,
+                                                   const char *portal, int lun,
+                                                   Error **errp)
+{
+    struct iscsi_context *iscsi;
+    const char *target = qemu_opt_get(opts, "target");
+    Error *local_err = NULL;
+    int timeout;
+
+    iscsi = iscsi_create_context(initiator_name);
+    if (iscsi == NULL) {
+        error_setg(errp, "iSCSI: Failed to create iSCSI context.");
+        return NULL;
+    }
+#if LIBISCSI_API_VERSION >= (20160603)
+    if (iscsi_init_transport(iscsi,
+                             strcmp(qemu_opt_get(opts, "transport"), "iser")
+                             ? TCP_TRANSPORT : ISER_TRANSPORT)) {
+        error_setg(errp, ("Error initializing transport."));
+        goto fail;
+    }
+#endif
+    if (iscsi_set_targetname(iscsi, target)) {
+        error_setg(errp, "iSCSI: Failed to set target name.");
+        goto fail;
+    }
+
+    /* check if we got CHAP username/password via the options */
+    apply_chap(iscsi, opts, &local_err);
+    if (local_err != NULL) {
+        error_propagate(errp, local_err);
+        goto fail;
+    }
+
+    if (iscsi_set_session_type(iscsi, ISCSI_SESSION_NORMAL) != 0) {
+        error_setg(errp, "iSCSI: Failed to set session type to normal.");
+        goto fail;
+    }
+
+    /* check if we got HEADER_DIGEST via the options */
+    apply_header_digest(iscsi, opts, &local_err);
+    if (local_err != NULL) {
+        error_propagate(errp, local_err);
+        goto fail;
+    }
+
+    /* timeout handling is broken in libiscsi before 1.15.0 */
+    timeout = qemu_opt_get_number(opts, "timeout", 0);
+#if LIBISCSI_API_VERSION >= 20150621
+    iscsi_set_timeout(iscsi, timeout);
+#else
+    if (timeout) {
+        warn_report("iSCSI: ignoring timeout value for libiscsi <1.15.0");
+    }
+#endif
+
+    if (iscsi_full_connect_sync(iscsi, portal, lun) != 0) {
+        error_setg(errp, "iSCSI: Failed to connect to LUN : %s",
+            iscsi_get_error(iscsi));
+        goto fail;
+    }
+
+    return iscsi;
+
+fail:
+    iscsi_destroy_context(iscsi);
+    return NULL;
+}
+
+static void iscsi_free_sessions(IscsiLun *iscsilun)
+{
+    int i;
+
+    for (i = 0; i < iscsilun->num_sessions; i++) {
+        struct iscsi_context *iscsi = iscsilun->sessions[i].iscsi;
+
+        if (iscsi_is_logged_in(iscsi)) {
+            iscsi_logout_sync(iscsi);
+        }
+        iscsi_destroy_context(iscsi);
+        g_free(iscsilun->sessions[i].portal);
+    }
+    g_free(iscsilun->sessions);
+    iscsilun->sessions = NULL;
+    iscsilun->num_sessions = 0;
+    iscsilun->iscsi = NULL;
+}
+
 static int iscsi_open(BlockDriverState *bs, QDict *options, int flags,
                       Error **errp)
 {
     IscsiLun *iscsilun = bs->opaque;
-    struct iscsi_context *iscsi = NULL;
     struct scsi_task *task = NULL;
     struct scsi_inquiry_standard *inq = NULL;
     struct scsi_inquiry_supported_pages *inq_vpd;
     char *initiator_name = NULL;
     QemuOpts *opts;
+    QDict *portals_dict = NULL;
     Error *local_err = NULL;
     const char *transport_name, *portal, *target;
-#if LIBISCSI_API_VERSION >= (20160603)
-    enum iscsi_transport_type transport;
-#endif
-    int i, ret = 0, timeout = 0, lun;
+    const char **portals = NULL;
+    IscsiPathPolicy path_policy;
+    int i, ret = 0, lun, num_portals, num_sessions;
 
     opts = qemu_opts_create(&runtime_opts, NULL, 0, &error_abort);
+
+    qdict_extract_subqdict(options, &portals_dict, "portals.");
+    num_portals = qdict_array_entries(portals_dict, "");
+    if (num_portals < 0) {
+        error_setg(errp, "Invalid portals option");
+        ret = -EINVAL;
+        goto out;
+    }
+
     if (!qemu_opts_absorb_qdict(opts, options, errp)) {
         ret = -EINVAL;
         goto out;
@@ -1807,12 +2015,9 @@ static int iscsi_open(BlockDriverState *bs, QDict *options, int flags,
     }
 
     if (!strcmp(transport_name, "tcp")) {
+        /* TCP is what older libiscsi versions always use */
 #if LIBISCSI_API_VERSION >= (20160603)
-        transport = TCP_TRANSPORT;
     } else if (!strcmp(transport_name, "iser")) {
-        transport = ISER_TRANSPORT;
-#else
-        /* TCP is what older libiscsi versions always use */
 #endif
     } else {
         error_setg(errp, "Unknown transport: %s", transport_name);
@@ -1820,69 +2025,74 @@ static int iscsi_open(BlockDriverState *bs, QDict *options, int flags,
         goto out;
     }
 
-    memset(iscsilun, 0, sizeof(IscsiLun));
-
-    initiator_name = get_initiator_name(opts);
-
-    iscsi = iscsi_create_context(initiator_name);
-    if (iscsi == NULL) {
-        error_setg(errp, "iSCSI: Failed to create iSCSI context.");
-        ret = -ENOMEM;
-        goto out;
-    }
-#if LIBISCSI_API_VERSION >= (20160603)
-    if (iscsi_init_transport(iscsi, transport)) {
-        error_setg(errp, ("Error initializing transport."));
-        ret = -EINVAL;
-        goto out;
-    }
-#endif
-    if (iscsi_set_targetname(iscsi, target)) {
-        error_setg(errp, "iSCSI: Failed to set target name.");
-        ret = -EINVAL;
-        goto out;
-    }
+    /* portal comes first, the sessions are spread over all of them */
+    portals = g_new(const char *, num_portals + 1);
+    portals[0] = portal;
+    for (i = 0; i < num_portals; i++) {
+        char key[16];
 
-    /* check if we got CHAP username/password via the options */
-    apply_chap(iscsi, opts, &local_err);
-    if (local_err != NULL) {
-        error_propagate(errp, local_err);
-        ret = -EINVAL;
-        goto out;
+        snprintf(key, sizeof(key), "%d", i);
+        portals[i + 1] = qdict_get_try_str(portals_dict, key);
+        if (!portals[i + 1]) {
+            error_setg(errp, "Invalid portals option");
+            ret = -EINVAL;
+            goto out;
+        }
     }
+    num_portals++;
 
-    if (iscsi_set_session_type(iscsi, ISCSI_SESSION_NORMAL) != 0) {
-        error_setg(errp, "iSCSI: Failed to set session type to normal.");
+    num_sessions = qemu_opt_get_number(opts, "sessions", num_portals);
+    if (num_sessions < 1 || num_sessions > MAX_SESSIONS) {
+        error_setg(errp, "sessions must be between 1 and %d", MAX_SESSIONS);
         ret = -EINVAL;
         goto out;
     }
 
-    /* check if we got HEADER_DIGEST via the options */
-    apply_header_digest(iscsi, opts, &local_err);
-    if (local_err != NULL) {
+    path_policy = qapi_enum_parse(&IscsiPathPolicy_lookup,
+                                  qemu_opt_get(opts, "path-policy"),
+                                  QAPI_ISCSI_PATH_POLICY_ROUND_ROBIN,
+                                  &local_err);
+    if (local_err) {
         error_propagate(errp, local_err);
         ret = -EINVAL;
         goto out;
     }
 
-    /* timeout handling is broken in libiscsi before 1.15.0 */
-    timeout = qemu_opt_get_number(opts, "timeout", 0);
-#if LIBISCSI_API_VERSION >= 20150621
-    iscsi_set_timeout(iscsi, timeout);
-#else
-    if (timeout) {
-        warn_report("iSCSI: ignoring timeout value for libiscsi <1.15.0");
-    }
-#endif
+    memset(iscsilun, 0, sizeof(IscsiLun));
 
-    if (iscsi_full_connect_sync(iscsi, portal, lun) != 0) {
-        error_setg(errp, "iSCSI: Failed to connect to LUN : %s",
-            iscsi_get_error(iscsi));
-        ret = -EINVAL;
-        goto out;
+    initiator_name = get_initiator_name(opts);
+
+    /*
+     * The first session is required, it also carries the commands that
+     * are not data transfers.  The others only add bandwidth and
+     * redundancy, so a portal that cannot be reached right now is left
+     * out rather than failing the open.
+     */
+    iscsilun->sessions = g_new0(IscsiSession, num_sessions);
+    for (i = 0; i < num_sessions; i++) {
+        IscsiSession *session = &iscsilun->sessions[iscsilun->num_sessions];
+        const char *session_portal = portals[i % num_portals];
+
+        session->iscsi = iscsi_session_connect(opts, initiator_name,
+                                               session_portal, lun,
+                                               &local_err);
+        if (!session->iscsi) {
+            if (i == 0) {
+                error_propagate(errp, local_err);
+                ret = -EINVAL;
+                goto out;
+            }
+            warn_report_err(local_err);
+            local_err = NULL;
+            continue;
+        }
+        session->iscsilun = iscsilun;
+        session->portal = g_strdup(session_portal);
+        iscsilun->num_sessions++;
     }
 
-    iscsilun->iscsi = iscsi;
+    iscsilun->iscsi = iscsilun->sessions[0].iscsi;
+    iscsilun->path_policy = path_policy;
     iscsilun->aio_context = bdrv_get_aio_context(bs);
     iscsilun->lun = lun;
     iscsilun->has_write_same = true;
@@ -2004,18 +2214,15 @@ static int iscsi_open(BlockDriverState *bs, QDict *options, int flags,
 
 out:
     qemu_opts_del(opts);
+    qobject_unref(portals_dict);
+    g_free(portals);
     g_free(initiator_name);
     if (task != NULL) {
         scsi_free_scsi_task(task);
     }
 
     if (ret) {
-        if (iscsi != NULL) {
-            if (iscsi_is_logged_in(iscsi)) {
-                iscsi_logout_sync(iscsi);
-            }
-            iscsi_destroy_context(iscsi);
-        }
+        iscsi_free_sessions(iscsilun);
         memset(iscsilun, 0, sizeof(IscsiLun));
     }
 
@@ -2025,13 +2232,9 @@ out:
 static void iscsi_close(BlockDriverState *bs)
 {
     IscsiLun *iscsilun = bs->opaque;
-    struct iscsi_context *iscsi = iscsilun->iscsi;
 
     iscsi_detach_aio_context(bs);
-    if (iscsi_is_logged_in(iscsi)) {
-        iscsi_logout_sync(iscsi);
-    }
-    iscsi_destroy_context(iscsi);
+    iscsi_free_sessions(iscsilun);
     if (iscsilun->dd) {
         g_free(iscsilun->dd->designator);
         g_free(iscsilun->dd);
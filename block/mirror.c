@@ -28,6 +28,13 @@
 #define MAX_IO_BYTES (1 << 20) /* 1 Mb */
 #define DEFAULT_MIRROR_BUF_SIZE (MAX_IN_FLIGHT * MAX_IO_BYTES)
 
+/* Upper limit for the number of parallel requests with x-perf.auto-tune */
+#define MIRROR_MAX_IN_FLIGHT_LIMIT 64
+/* How often the auto-tuning limits are recomputed */
+#define MIRROR_TUNE_INTERVAL_NS BLOCK_JOB_SLICE_TIME
+/* How long the minimum request latency is remembered */
+#define MIRROR_RTT_MIN_WINDOW_NS (10 * NANOSECONDS_PER_SECOND)
+
 /* The mirroring buffer is a list of granularity-sized chunks.
  * Free chunks are organized in a list.
  */
@@ -80,10 +87,43 @@ typedef struct MirrorBlockJob {
     bool unmap;
     int target_cluster_size;
     int max_iov;
+    /*
+     * Whether to try offloading copies with bdrv_co_copy_range() before
+     * falling back to bouncing the data through s->buf.  Cleared on the
+     * first failure.
+     */
+    bool use_copy_range;
+    /* copy_range doesn't respect max_transfer, so we do it here */
+    int64_t copy_range_max_bytes;
     bool initial_zeroing_ongoing;
     int in_active_write_counter;
     bool prepared;
     bool in_drain;
+
+    /*
+     * Limits for the background copy.  With auto_tune they are adjusted
+     * to the bandwidth-delay product measured by the tune statistics, see
+     * mirror_tune().
+     */
+    int max_in_flight;
+    int64_t max_io_bytes;
+    bool auto_tune;
+    int64_t max_guest_latency_ns;
+    struct {
+        int64_t window_start_ns;
+        /* Completed background copy operations in the current window */
+        uint64_t ops;
+        uint64_t bytes;
+        int64_t latency_ns;
+        /* Completed guest requests in the current window */
+        uint64_t guest_ops;
+        int64_t guest_latency_ns;
+        /* Lowest average latency seen recently, and when it was seen */
+        int64_t rtt_min_ns;
+        int64_t rtt_min_stamp_ns;
+        /* Bytes to keep in flight */
+        int64_t target_bytes;
+    } tune;
 } MirrorBlockJob;
 
 typedef struct MirrorBDSOpaque {
@@ -105,6 +145,7 @@ struct MirrorOp {
     bool is_pseudo_op;
     bool is_active_write;
     bool is_in_flight;
+    int64_t start_ns;
     CoQueue waiting_requests;
     Coroutine *co;
 
@@ -190,6 +231,12 @@ static void coroutine_fn mirror_iteration_done(MirrorOp *op, int ret)
     bitmap_clear(s->in_flight_bitmap, chunk_num, nb_chunks);
     QTAILQ_REMOVE(&s->ops_in_flight, op, next);
     if (ret >= 0) {
+        if (s->auto_tune && !op->is_active_write) {
+            s->tune.ops++;
+            s->tune.bytes += op->bytes;
+            s->tune.latency_ns += qemu_clock_get_ns(QEMU_CLOCK_REALTIME) -
+                                  op->start_ns;
+        }
         if (s->cow_bitmap) {
             bitmap_set(s->cow_bitmap, chunk_num, nb_chunks);
         }
@@ -313,6 +360,44 @@ mirror_wait_for_free_in_flight_slot(MirrorBlockJob *s)
     mirror_wait_for_any_operation(s, false);
 }
 
+/*
+ * Try to copy op's range with bdrv_co_copy_range(), so that the data
+ * doesn't have to go through QEMU's memory.  Returns false if that is not
+ * possible, in which case the caller must copy the range itself.
+ */
+static bool coroutine_fn mirror_co_copy_range(MirrorOp *op)
+{
+    MirrorBlockJob *s = op->s;
+    int ret;
+
+    if (!s->use_copy_range || op->bytes > s->copy_range_max_bytes) {
+        return false;
+    }
+
+    s->in_flight++;
+    s->bytes_in_flight += op->bytes;
+    op->is_in_flight = true;
+    trace_mirror_one_iteration(s, op->offset, op->bytes);
+
+    ret = bdrv_co_copy_range(s->mirror_top_bs->backing, op->offset,
+                             blk_root(s->target), op->offset, op->bytes, 0, 0);
+    if (ret < 0) {
+        /*
+         * Don't bother with error handling, a buffered copy will report
+         * the error if it wasn't caused by copy offloading itself.
+         */
+        trace_mirror_copy_range_fail(s, op->offset, ret);
+        s->use_copy_range = false;
+        s->in_flight--;
+        s->bytes_in_flight -= op->bytes;
+        op->is_in_flight = false;
+        return false;
+    }
+
+    mirror_write_complete(op, ret);
+    return true;
+}
+
 /* Perform a mirror copy operation.
  *
  * *op->bytes_handled is set to the number of bytes copied after and
@@ -349,6 +434,11 @@ static void coroutine_fn mirror_co_read(void *opaque)
     assert(QEMU_IS_ALIGNED(op->offset, s->granularity));
     /* The range is sector-aligned, since bdrv_getlength() rounds up. */
     assert(QEMU_IS_ALIGNED(op->bytes, BDRV_SECTOR_SIZE));
+
+    if (mirror_co_copy_range(op)) {
+        return;
+    }
+
     nb_chunks = DIV_ROUND_UP(op->bytes, s->granularity);
 
     while (s->buf_free_count < nb_chunks) {
@@ -422,6 +512,7 @@ static unsigned mirror_perform(MirrorBlockJob *s, int64_t offset,
         .offset         = offset,
         .bytes          = bytes,
         .bytes_handled  = &bytes_handled,
+        .start_ns       = qemu_clock_get_ns(QEMU_CLOCK_REALTIME),
     };
     qemu_co_queue_init(&op->waiting_requests);
 
@@ -464,7 +555,7 @@ static uint64_t coroutine_fn mirror_iteration(MirrorBlockJob *s)
     /* At least the first dirty chunk is mirrored in one iteration. */
     int nb_chunks = 1;
     bool write_zeroes_ok = bdrv_can_write_zeroes_with_unmap(blk_bs(s->target));
-    int max_io_bytes = MAX(s->buf_size / MAX_IN_FLIGHT, MAX_IO_BYTES);
+    int64_t max_io_bytes = s->max_io_bytes;
 
     bdrv_dirty_bitmap_lock(s->dirty_bitmap);
     offset = bdrv_dirty_iter_next(s->dbi);
@@ -561,7 +652,7 @@ static uint64_t coroutine_fn mirror_iteration(MirrorBlockJob *s)
             }
         }
 
-        while (s->in_flight >= MAX_IN_FLIGHT) {
+        while (s->in_flight >= s->max_in_flight) {
             trace_mirror_yield_in_flight(s, offset, s->in_flight);
             mirror_wait_for_free_in_flight_slot(s);
         }
@@ -783,6 +874,80 @@ static void mirror_abort(Job *job)
     assert(ret == 0);
 }
 
+/*
+ * Recompute the limits for the background copy from the statistics of the
+ * last MIRROR_TUNE_INTERVAL_NS.
+ *
+ * The throughput times the lowest recent latency estimates the
+ * bandwidth-delay product of the copy, i.e. how many bytes must be in
+ * flight to keep the source and target busy.  Trying to keep a quarter
+ * more than that in flight lets the throughput grow for as long as the
+ * latency doesn't, like TCP congestion control does.  If the guest's own
+ * requests get slower than max_guest_latency_ns, the amount of data in
+ * flight is halved instead.
+ *
+ * The chunk size is scaled with the amount of data in flight so that the
+ * number of parallel requests stays around MAX_IN_FLIGHT, which makes
+ * high-latency links use larger requests.
+ */
+static void mirror_tune(MirrorBlockJob *s)
+{
+    int64_t now = qemu_clock_get_ns(QEMU_CLOCK_REALTIME);
+    int64_t elapsed = now - s->tune.window_start_ns;
+    int64_t rtt, bdp, target, chunk;
+    uint64_t throughput;
+    bool guest_slow;
+
+    if (!s->auto_tune || elapsed < MIRROR_TUNE_INTERVAL_NS) {
+        return;
+    }
+    if (!s->tune.ops) {
+        /* Nothing to learn from, keep the current limits */
+        goto restart;
+    }
+
+    rtt = s->tune.latency_ns / s->tune.ops;
+    if (!s->tune.rtt_min_ns || rtt < s->tune.rtt_min_ns ||
+        now - s->tune.rtt_min_stamp_ns > MIRROR_RTT_MIN_WINDOW_NS)
+    {
+        s->tune.rtt_min_ns = rtt;
+        s->tune.rtt_min_stamp_ns = now;
+    }
+
+    throughput = muldiv64(s->tune.bytes, NANOSECONDS_PER_SECOND, elapsed);
+    bdp = muldiv64(throughput, s->tune.rtt_min_ns, NANOSECONDS_PER_SECOND);
+
+    guest_slow = s->max_guest_latency_ns && s->tune.guest_ops &&
+                 s->tune.guest_latency_ns / s->tune.guest_ops >
+                 s->max_guest_latency_ns;
+    if (guest_slow) {
+        target = s->tune.target_bytes / 2;
+    } else {
+        /* Don't grow faster than doubling per interval */
+        target = MIN(bdp + bdp / 4, s->tune.target_bytes * 2);
+    }
+    target = MAX(MIN(target, s->buf_size), s->granularity);
+
+    chunk = QEMU_ALIGN_DOWN(target / MAX_IN_FLIGHT, s->granularity);
+    chunk = MAX(chunk, s->granularity);
+
+    s->tune.target_bytes = target;
+    s->max_io_bytes = chunk;
+    s->max_in_flight = MIN(DIV_ROUND_UP(target, chunk),
+                           MIRROR_MAX_IN_FLIGHT_LIMIT);
+
+    trace_mirror_tune(s, throughput, rtt, guest_slow, s->max_in_flight,
+                      s->max_io_bytes);
+
+restart:
+    s->tune.window_start_ns = now;
+    s->tune.ops = 0;
+    s->tune.bytes = 0;
+    s->tune.latency_ns = 0;
+    s->tune.guest_ops = 0;
+    s->tune.guest_latency_ns = 0;
+}
+
 static void coroutine_fn mirror_throttle(MirrorBlockJob *s)
 {
     int64_t now = qemu_clock_get_ns(QEMU_CLOCK_REALTIME);
@@ -821,7 +986,7 @@ static int coroutine_fn mirror_dirty_init(MirrorBlockJob *s)
                 return 0;
             }
 
-            if (s->in_flight >= MAX_IN_FLIGHT) {
+            if (s->in_flight >= s->max_in_flight) {
                 trace_mirror_yield(s, UINT64_MAX, s->buf_free_count,
                                    s->in_flight);
                 mirror_wait_for_free_in_flight_slot(s);
@@ -954,6 +1119,10 @@ static int coroutine_fn mirror_run(Job *job, Error **errp)
         s->cow_bitmap = bitmap_new(length);
     }
     s->max_iov = MIN(bs->bl.max_iov, target_bs->bl.max_iov);
+    s->use_copy_range = true;
+    s->copy_range_max_bytes =
+        MIN_NON_ZERO(INT_MAX, MIN_NON_ZERO(bs->bl.max_transfer,
+                                           target_bs->bl.max_transfer));
 
     s->buf = qemu_try_blockalign(bs, s->buf_size);
     if (s->buf == NULL) {
@@ -961,6 +1130,12 @@ static int coroutine_fn mirror_run(Job *job, Error **errp)
         goto immediate_exit;
     }
 
+    s->max_in_flight = MAX_IN_FLIGHT;
+    s->max_io_bytes = MAX(s->buf_size / MAX_IN_FLIGHT, MAX_IO_BYTES);
+    s->tune.target_bytes = MIN(s->buf_size,
+                               s->max_in_flight * s->max_io_bytes);
+    s->tune.window_start_ns = qemu_clock_get_ns(QEMU_CLOCK_REALTIME);
+
     mirror_free_init(s);
 
     s->last_pause_ns = qemu_clock_get_ns(QEMU_CLOCK_REALTIME);
@@ -990,6 +1165,7 @@ static int coroutine_fn mirror_run(Job *job, Error **errp)
         }
 
         job_pause_point(&s->common.job);
+        mirror_tune(s);
 
         cnt = bdrv_get_dirty_count(s->dirty_bitmap);
         /* cnt is the number of dirty bytes remaining and s->bytes_in_flight is
@@ -1004,7 +1180,7 @@ static int coroutine_fn mirror_run(Job *job, Error **errp)
         delta = qemu_clock_get_ns(QEMU_CLOCK_REALTIME) - s->last_pause_ns;
         if (delta < BLOCK_JOB_SLICE_TIME &&
             s->common.iostatus == BLOCK_DEVICE_IO_STATUS_OK) {
-            if (s->in_flight >= MAX_IN_FLIGHT || s->buf_free_count == 0 ||
+            if (s->in_flight >= s->max_in_flight || s->buf_free_count == 0 ||
                 (cnt == 0 && s->in_flight > 0)) {
                 trace_mirror_yield(s, cnt, s->buf_free_count, s->in_flight);
                 mirror_wait_for_free_in_flight_slot(s);
@@ -1379,10 +1555,27 @@ static void coroutine_fn active_write_settle(MirrorOp *op)
     g_free(op);
 }
 
+/* Accounts for a guest request that took since @start_ns */
+static void mirror_top_account(BlockDriverState *bs, int64_t start_ns)
+{
+    MirrorBDSOpaque *s = bs->opaque;
+
+    if (s->job && s->job->auto_tune) {
+        s->job->tune.guest_ops++;
+        s->job->tune.guest_latency_ns +=
+            qemu_clock_get_ns(QEMU_CLOCK_REALTIME) - start_ns;
+    }
+}
+
 static int coroutine_fn bdrv_mirror_top_preadv(BlockDriverState *bs,
     uint64_t offset, uint64_t bytes, QEMUIOVector *qiov, int flags)
 {
-    return bdrv_co_preadv(bs->backing, offset, bytes, qiov, flags);
+    int64_t start_ns = qemu_clock_get_ns(QEMU_CLOCK_REALTIME);
+    int ret;
+
+    ret = bdrv_co_preadv(bs->backing, offset, bytes, qiov, flags);
+    mirror_top_account(bs, start_ns);
+    return ret;
 }
 
 static int coroutine_fn bdrv_mirror_top_do_write(BlockDriverState *bs,
@@ -1391,6 +1584,7 @@ static int coroutine_fn bdrv_mirror_top_do_write(BlockDriverState *bs,
 {
     MirrorOp *op = NULL;
     MirrorBDSOpaque *s = bs->opaque;
+    int64_t start_ns = qemu_clock_get_ns(QEMU_CLOCK_REALTIME);
     int ret = 0;
     bool copy_to_target;
 
@@ -1430,6 +1624,7 @@ out:
     if (copy_to_target) {
         active_write_settle(op);
     }
+    mirror_top_account(bs, start_ns);
     return ret;
 }
 
@@ -1575,7 +1770,7 @@ static BlockJob *mirror_start_job(
                              bool is_none_mode, BlockDriverState *base,
                              bool auto_complete, const char *filter_node_name,
                              bool is_mirror, MirrorCopyMode copy_mode,
-                             Error **errp)
+                             const MirrorPerf *perf, Error **errp)
 {
     MirrorBlockJob *s;
     MirrorBDSOpaque *bs_opaque;
@@ -1729,6 +1924,10 @@ static BlockJob *mirror_start_job(
     s->backing_mode = backing_mode;
     s->zero_target = zero_target;
     s->copy_mode = copy_mode;
+    if (perf) {
+        s->auto_tune = perf->auto_tune;
+        s->max_guest_latency_ns = perf->max_guest_latency * SCALE_US;
+    }
     s->base = base;
     s->base_overlay = bdrv_find_overlay(bs, base);
     s->granularity = granularity;
@@ -1845,7 +2044,8 @@ void mirror_start(const char *job_id, BlockDriverState *bs,
                   BlockdevOnError on_source_error,
                   BlockdevOnError on_target_error,
                   bool unmap, const char *filter_node_name,
-                  MirrorCopyMode copy_mode, Error **errp)
+                  MirrorCopyMode copy_mode, const MirrorPerf *perf,
+                  Error **errp)
 {
     bool is_none_mode;
     BlockDriverState *base;
@@ -1862,7 +2062,7 @@ void mirror_start(const char *job_id, BlockDriverState *bs,
                      speed, granularity, buf_size, backing_mode, zero_target,
                      on_source_error, on_target_error, unmap, NULL, NULL,
                      &mirror_job_driver, is_none_mode, base, false,
-                     filter_node_name, true, copy_mode, errp);
+                     filter_node_name, true, copy_mode, perf, errp);
 }
 
 BlockJob *commit_active_start(const char *job_id, BlockDriverState *bs,
@@ -1889,7 +2089,7 @@ BlockJob *commit_active_start(const char *job_id, BlockDriverState *bs,
                      on_error, on_error, true, cb, opaque,
                      &commit_active_job_driver, false, base, auto_complete,
                      filter_node_name, false, MIRROR_COPY_MODE_BACKGROUND,
-                     errp);
+                     NULL, errp);
     if (!job) {
         goto error_restore_flags;
     }
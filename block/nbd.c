@@ -34,6 +34,7 @@
 #include "qemu/uri.h"
 #include "qemu/option.h"
 #include "qemu/cutils.h"
+#include "qemu/error-report.h"
 #include "qemu/main-loop.h"
 #include "qemu/atomic.h"
 
@@ -49,6 +50,7 @@
 
 #define EN_OPTSTR ":exportname="
 #define MAX_NBD_REQUESTS    16
+#define NBD_MAX_MULTI_CONN  16
 
 #define HANDLE_TO_INDEX(bs, handle) ((handle) ^ (uint64_t)(intptr_t)(bs))
 #define INDEX_TO_HANDLE(bs, index)  ((index)  ^ (uint64_t)(intptr_t)(bs))
@@ -142,14 +144,24 @@ typedef struct BDRVNBDState {
 
     bool wait_connect;
     NBDConnectThread *connect_thread;
+
+    /*
+     * With multi-conn, requests are spread across several connections to
+     * the export.  Each connection has all of the state above, so that it
+     * receives replies and reconnects on its own.  conns[0] is the node's
+     * own state, it is the only one that has the connection list.
+     */
+    uint32_t multi_conn;
+    int nb_conns;
+    unsigned next_conn;
+    struct BDRVNBDState *conns[NBD_MAX_MULTI_CONN];
 } BDRVNBDState;
 
-static int nbd_establish_connection(BlockDriverState *bs, SocketAddress *saddr,
+static int nbd_establish_connection(BDRVNBDState *s, SocketAddress *saddr,
                                     Error **errp);
-static int nbd_co_establish_connection(BlockDriverState *bs, Error **errp);
-static void nbd_co_establish_connection_cancel(BlockDriverState *bs,
-                                               bool detach);
-static int nbd_client_handshake(BlockDriverState *bs, Error **errp);
+static int nbd_co_establish_connection(BDRVNBDState *s, Error **errp);
+static void nbd_co_establish_connection_cancel(BDRVNBDState *s, bool detach);
+static int nbd_client_handshake(BDRVNBDState *s, Error **errp);
 static void nbd_yank(void *opaque);
 
 static void nbd_clear_bdrvstate(BDRVNBDState *s)
@@ -232,16 +244,21 @@ static void reconnect_delay_timer_init(BDRVNBDState *s, uint64_t expire_time_ns)
 static void nbd_client_detach_aio_context(BlockDriverState *bs)
 {
     BDRVNBDState *s = (BDRVNBDState *)bs->opaque;
+    int i;
 
-    /* Timer is deleted in nbd_client_co_drain_begin() */
-    assert(!s->reconnect_delay_timer);
-    /*
-     * If reconnect is in progress we may have no ->ioc.  It will be
-     * re-instantiated in the proper aio context once the connection is
-     * reestablished.
-     */
-    if (s->ioc) {
-        qio_channel_detach_aio_context(QIO_CHANNEL(s->ioc));
+    for (i = 0; i < s->nb_conns; i++) {
+        BDRVNBDState *c = s->conns[i];
+
+        /* Timer is deleted in nbd_client_co_drain_begin() */
+        assert(!c->reconnect_delay_timer);
+        /*
+         * If reconnect is in progress we may have no ->ioc.  It will be
+         * re-instantiated in the proper aio context once the connection is
+         * reestablished.
+         */
+        if (c->ioc) {
+            qio_channel_detach_aio_context(QIO_CHANNEL(c->ioc));
+        }
     }
 }
 
@@ -249,15 +266,20 @@ static void nbd_client_attach_aio_context_bh(void *opaque)
 {
     BlockDriverState *bs = opaque;
     BDRVNBDState *s = (BDRVNBDState *)bs->opaque;
+    int i;
 
-    if (s->connection_co) {
-        /*
-         * The node is still drained, so we know the coroutine has yielded in
-         * nbd_read_eof(), the only place where bs->in_flight can reach 0, or
-         * it is entered for the first time. Both places are safe for entering
-         * the coroutine.
-         */
-        qemu_aio_coroutine_enter(bs->aio_context, s->connection_co);
+    for (i = 0; i < s->nb_conns; i++) {
+        BDRVNBDState *c = s->conns[i];
+
+        if (c->connection_co) {
+            /*
+             * The node is still drained, so we know the coroutine has
+             * yielded in nbd_read_eof(), the only place where bs->in_flight
+             * can reach 0, or it is entered for the first time. Both places
+             * are safe for entering the coroutine.
+             */
+            qemu_aio_coroutine_enter(bs->aio_context, c->connection_co);
+        }
     }
     bdrv_dec_in_flight(bs);
 }
@@ -266,13 +288,18 @@ static void nbd_client_attach_aio_context(BlockDriverState *bs,
                                           AioContext *new_context)
 {
     BDRVNBDState *s = (BDRVNBDState *)bs->opaque;
+    int i;
 
     /*
-     * s->connection_co is either yielded from nbd_receive_reply or from
+     * connection_co is either yielded from nbd_receive_reply or from
      * nbd_co_reconnect_loop()
      */
-    if (qatomic_load_acquire(&s->state) == NBD_CLIENT_CONNECTED) {
-        qio_channel_attach_aio_context(QIO_CHANNEL(s->ioc), new_context);
+    for (i = 0; i < s->nb_conns; i++) {
+        BDRVNBDState *c = s->conns[i];
+
+        if (qatomic_load_acquire(&c->state) == NBD_CLIENT_CONNECTED) {
+            qio_channel_attach_aio_context(QIO_CHANNEL(c->ioc), new_context);
+        }
     }
 
     bdrv_inc_in_flight(bs);
@@ -287,38 +314,46 @@ static void nbd_client_attach_aio_context(BlockDriverState *bs,
 static void coroutine_fn nbd_client_co_drain_begin(BlockDriverState *bs)
 {
     BDRVNBDState *s = (BDRVNBDState *)bs->opaque;
+    int i;
 
-    s->drained = true;
-    if (s->connection_co_sleep_ns_state) {
-        qemu_co_sleep_wake(s->connection_co_sleep_ns_state);
-    }
+    for (i = 0; i < s->nb_conns; i++) {
+        BDRVNBDState *c = s->conns[i];
 
-    nbd_co_establish_connection_cancel(bs, false);
+        c->drained = true;
+        if (c->connection_co_sleep_ns_state) {
+            qemu_co_sleep_wake(c->connection_co_sleep_ns_state);
+        }
 
-    reconnect_delay_timer_del(s);
+        nbd_co_establish_connection_cancel(c, false);
 
-    if (qatomic_load_acquire(&s->state) == NBD_CLIENT_CONNECTING_WAIT) {
-        s->state = NBD_CLIENT_CONNECTING_NOWAIT;
-        qemu_co_queue_restart_all(&s->free_sema);
+        reconnect_delay_timer_del(c);
+
+        if (qatomic_load_acquire(&c->state) == NBD_CLIENT_CONNECTING_WAIT) {
+            c->state = NBD_CLIENT_CONNECTING_NOWAIT;
+            qemu_co_queue_restart_all(&c->free_sema);
+        }
     }
 }
 
 static void coroutine_fn nbd_client_co_drain_end(BlockDriverState *bs)
 {
     BDRVNBDState *s = (BDRVNBDState *)bs->opaque;
+    int i;
 
-    s->drained = false;
-    if (s->wait_drained_end) {
-        s->wait_drained_end = false;
-        aio_co_wake(s->connection_co);
+    for (i = 0; i < s->nb_conns; i++) {
+        BDRVNBDState *c = s->conns[i];
+
+        c->drained = false;
+        if (c->wait_drained_end) {
+            c->wait_drained_end = false;
+            aio_co_wake(c->connection_co);
+        }
     }
 }
 
 
-static void nbd_teardown_connection(BlockDriverState *bs)
+static void nbd_teardown_connection(BDRVNBDState *s)
 {
-    BDRVNBDState *s = (BDRVNBDState *)bs->opaque;
-
     if (s->ioc) {
         /* finish any pending coroutines */
         qio_channel_shutdown(s->ioc, QIO_CHANNEL_SHUTDOWN_BOTH, NULL);
@@ -333,7 +368,7 @@ static void nbd_teardown_connection(BlockDriverState *bs)
         if (s->connection_co_sleep_ns_state) {
             qemu_co_sleep_wake(s->connection_co_sleep_ns_state);
         }
-        nbd_co_establish_connection_cancel(bs, true);
+        nbd_co_establish_connection_cancel(s, true);
     }
     if (qemu_in_coroutine()) {
         s->teardown_co = qemu_coroutine_self();
@@ -341,7 +376,7 @@ static void nbd_teardown_connection(BlockDriverState *bs)
         qemu_coroutine_yield();
         s->teardown_co = NULL;
     } else {
-        BDRV_POLL_WHILE(bs, s->connection_co);
+        BDRV_POLL_WHILE(s->bs, s->connection_co);
     }
     assert(!s->connection_co);
 }
@@ -436,11 +471,10 @@ static void *connect_thread_func(void *opaque)
 }
 
 static int coroutine_fn
-nbd_co_establish_connection(BlockDriverState *bs, Error **errp)
+nbd_co_establish_connection(BDRVNBDState *s, Error **errp)
 {
     int ret;
     QemuThread thread;
-    BDRVNBDState *s = bs->opaque;
     NBDConnectThread *thr = s->connect_thread;
 
     if (!thr) {
@@ -464,8 +498,8 @@ nbd_co_establish_connection(BlockDriverState *bs, Error **errp)
         thr->state = CONNECT_THREAD_NONE;
         s->sioc = thr->sioc;
         thr->sioc = NULL;
-        yank_register_function(BLOCKDEV_YANK_INSTANCE(bs->node_name),
-                               nbd_yank, bs);
+        yank_register_function(BLOCKDEV_YANK_INSTANCE(s->bs->node_name),
+                               nbd_yank, s);
         qemu_mutex_unlock(&thr->mutex);
         return 0;
     case CONNECT_THREAD_RUNNING:
@@ -508,8 +542,8 @@ nbd_co_establish_connection(BlockDriverState *bs, Error **errp)
         s->sioc = thr->sioc;
         thr->sioc = NULL;
         if (s->sioc) {
-            yank_register_function(BLOCKDEV_YANK_INSTANCE(bs->node_name),
-                                   nbd_yank, bs);
+            yank_register_function(BLOCKDEV_YANK_INSTANCE(s->bs->node_name),
+                                   nbd_yank, s);
         }
         ret = (s->sioc ? 0 : -1);
         break;
@@ -549,10 +583,8 @@ nbd_co_establish_connection(BlockDriverState *bs, Error **errp)
  * to CONNECT_THREAD_RUNNING_DETACHED state). s->connect_thread becomes NULL if
  * detach is true.
  */
-static void nbd_co_establish_connection_cancel(BlockDriverState *bs,
-                                               bool detach)
+static void nbd_co_establish_connection_cancel(BDRVNBDState *s, bool detach)
 {
-    BDRVNBDState *s = bs->opaque;
     NBDConnectThread *thr = s->connect_thread;
     bool wake = false;
     bool do_free = false;
@@ -623,21 +655,21 @@ static coroutine_fn void nbd_reconnect_attempt(BDRVNBDState *s)
     if (s->ioc) {
         qio_channel_detach_aio_context(QIO_CHANNEL(s->ioc));
         yank_unregister_function(BLOCKDEV_YANK_INSTANCE(s->bs->node_name),
-                                 nbd_yank, s->bs);
+                                 nbd_yank, s);
         object_unref(OBJECT(s->sioc));
         s->sioc = NULL;
         object_unref(OBJECT(s->ioc));
         s->ioc = NULL;
     }
 
-    if (nbd_co_establish_connection(s->bs, &local_err) < 0) {
+    if (nbd_co_establish_connection(s, &local_err) < 0) {
         ret = -ECONNREFUSED;
         goto out;
     }
 
     bdrv_dec_in_flight(s->bs);
 
-    ret = nbd_client_handshake(s->bs, &local_err);
+    ret = nbd_client_handshake(s, &local_err);
 
     if (s->drained) {
         s->wait_drained_end = true;
@@ -783,7 +815,7 @@ static coroutine_fn void nbd_connection_entry(void *opaque)
     if (s->ioc) {
         qio_channel_detach_aio_context(QIO_CHANNEL(s->ioc));
         yank_unregister_function(BLOCKDEV_YANK_INSTANCE(s->bs->node_name),
-                                 nbd_yank, s->bs);
+                                 nbd_yank, s);
         object_unref(OBJECT(s->sioc));
         s->sioc = NULL;
         object_unref(OBJECT(s->ioc));
@@ -796,11 +828,10 @@ static coroutine_fn void nbd_connection_entry(void *opaque)
     aio_wait_kick();
 }
 
-static int nbd_co_send_request(BlockDriverState *bs,
+static int nbd_co_send_request(BDRVNBDState *s,
                                NBDRequest *request,
                                QEMUIOVector *qiov)
 {
-    BDRVNBDState *s = (BDRVNBDState *)bs->opaque;
     int rc, i = -1;
 
     qemu_co_mutex_lock(&s->send_mutex);
@@ -1508,12 +1539,36 @@ static int nbd_co_receive_blockstatus_reply(BDRVNBDState *s,
     return iter.ret;
 }
 
+/*
+ * Picks the connection for a request, the connected one with the fewest
+ * requests in flight.  If none is connected, the first connection decides
+ * whether the request waits for a reconnect or fails.
+ */
+static BDRVNBDState *nbd_get_conn(BDRVNBDState *s)
+{
+    BDRVNBDState *best = NULL;
+    unsigned start = s->next_conn++;
+    int i;
+
+    for (i = 0; i < s->nb_conns; i++) {
+        BDRVNBDState *c = s->conns[(start + i) % s->nb_conns];
+
+        if (qatomic_load_acquire(&c->state) == NBD_CLIENT_CONNECTED &&
+            (!best || c->in_flight < best->in_flight))
+        {
+            best = c;
+        }
+    }
+    return best ?: s;
+}
+
 static int nbd_co_request(BlockDriverState *bs, NBDRequest *request,
                           QEMUIOVector *write_qiov)
 {
     int ret, request_ret;
     Error *local_err = NULL;
     BDRVNBDState *s = (BDRVNBDState *)bs->opaque;
+    BDRVNBDState *c;
 
     assert(request->type != NBD_CMD_READ);
     if (write_qiov) {
@@ -1524,12 +1579,13 @@ static int nbd_co_request(BlockDriverState *bs, NBDRequest *request,
     }
 
     do {
-        ret = nbd_co_send_request(bs, request, write_qiov);
+        c = nbd_get_conn(s);
+        ret = nbd_co_send_request(c, request, write_qiov);
         if (ret < 0) {
             continue;
         }
 
-        ret = nbd_co_receive_return_code(s, request->handle,
+        ret = nbd_co_receive_return_code(c, request->handle,
                                          &request_ret, &local_err);
         if (local_err) {
             trace_nbd_co_request_fail(request->from, request->len,
@@ -1540,7 +1596,7 @@ static int nbd_co_request(BlockDriverState *bs, NBDRequest *request,
             error_free(local_err);
             local_err = NULL;
         }
-    } while (ret < 0 && nbd_client_connecting_wait(s));
+    } while (ret < 0 && nbd_client_connecting_wait(c));
 
     return ret ? ret : request_ret;
 }
@@ -1551,6 +1607,7 @@ static int nbd_client_co_preadv(BlockDriverState *bs, uint64_t offset,
     int ret, request_ret;
     Error *local_err = NULL;
     BDRVNBDState *s = (BDRVNBDState *)bs->opaque;
+    BDRVNBDState *c;
     NBDRequest request = {
         .type = NBD_CMD_READ,
         .from = offset,
@@ -1583,12 +1640,13 @@ static int nbd_client_co_preadv(BlockDriverState *bs, uint64_t offset,
     }
 
     do {
-        ret = nbd_co_send_request(bs, &request, NULL);
+        c = nbd_get_conn(s);
+        ret = nbd_co_send_request(c, &request, NULL);
         if (ret < 0) {
             continue;
         }
 
-        ret = nbd_co_receive_cmdread_reply(s, request.handle, offset, qiov,
+        ret = nbd_co_receive_cmdread_reply(c, request.handle, offset, qiov,
                                            &request_ret, &local_err);
         if (local_err) {
             trace_nbd_co_request_fail(request.from, request.len, request.handle,
@@ -1598,7 +1656,7 @@ static int nbd_client_co_preadv(BlockDriverState *bs, uint64_t offset,
             error_free(local_err);
             local_err = NULL;
         }
-    } while (ret < 0 && nbd_client_connecting_wait(s));
+    } while (ret < 0 && nbd_client_connecting_wait(c));
 
     return ret ? ret : request_ret;
 }
@@ -1700,6 +1758,7 @@ static int coroutine_fn nbd_client_co_block_status(
     int ret, request_ret;
     NBDExtent extent = { 0 };
     BDRVNBDState *s = (BDRVNBDState *)bs->opaque;
+    BDRVNBDState *c;
     Error *local_err = NULL;
 
     NBDRequest request = {
@@ -1735,12 +1794,13 @@ static int coroutine_fn nbd_client_co_block_status(
         assert(QEMU_IS_ALIGNED(request.len, s->info.min_block));
     }
     do {
-        ret = nbd_co_send_request(bs, &request, NULL);
+        c = nbd_get_conn(s);
+        ret = nbd_co_send_request(c, &request, NULL);
         if (ret < 0) {
             continue;
         }
 
-        ret = nbd_co_receive_blockstatus_reply(s, request.handle, bytes,
+        ret = nbd_co_receive_blockstatus_reply(c, request.handle, bytes,
                                                &extent, &request_ret,
                                                &local_err);
         if (local_err) {
@@ -1751,7 +1811,7 @@ static int coroutine_fn nbd_client_co_block_status(
             error_free(local_err);
             local_err = NULL;
         }
-    } while (ret < 0 && nbd_client_connecting_wait(s));
+    } while (ret < 0 && nbd_client_connecting_wait(c));
 
     if (ret < 0 || request_ret < 0) {
         return ret ? ret : request_ret;
@@ -1780,8 +1840,7 @@ static int nbd_client_reopen_prepare(BDRVReopenState *state,
 
 static void nbd_yank(void *opaque)
 {
-    BlockDriverState *bs = opaque;
-    BDRVNBDState *s = (BDRVNBDState *)bs->opaque;
+    BDRVNBDState *s = opaque;
 
     qatomic_store_release(&s->state, NBD_CLIENT_QUIT);
     qio_channel_shutdown(QIO_CHANNEL(s->sioc), QIO_CHANNEL_SHUTDOWN_BOTH, NULL);
@@ -1791,20 +1850,24 @@ static void nbd_client_close(BlockDriverState *bs)
 {
     BDRVNBDState *s = (BDRVNBDState *)bs->opaque;
     NBDRequest request = { .type = NBD_CMD_DISC };
+    int i;
 
-    if (s->ioc) {
-        nbd_send_request(s->ioc, &request);
-    }
+    for (i = s->nb_conns - 1; i >= 0; i--) {
+        BDRVNBDState *c = s->conns[i];
 
-    nbd_teardown_connection(bs);
+        if (c->ioc) {
+            nbd_send_request(c->ioc, &request);
+        }
+
+        nbd_teardown_connection(c);
+    }
 }
 
-static int nbd_establish_connection(BlockDriverState *bs,
+static int nbd_establish_connection(BDRVNBDState *s,
                                     SocketAddress *saddr,
                                     Error **errp)
 {
     ERRP_GUARD();
-    BDRVNBDState *s = (BDRVNBDState *)bs->opaque;
 
     s->sioc = qio_channel_socket_new();
     qio_channel_set_name(QIO_CHANNEL(s->sioc), "nbd-client");
@@ -1816,16 +1879,17 @@ static int nbd_establish_connection(BlockDriverState *bs,
         return -1;
     }
 
-    yank_register_function(BLOCKDEV_YANK_INSTANCE(bs->node_name), nbd_yank, bs);
+    yank_register_function(BLOCKDEV_YANK_INSTANCE(s->bs->node_name),
+                           nbd_yank, s);
     qio_channel_set_delay(QIO_CHANNEL(s->sioc), false);
 
     return 0;
 }
 
 /* nbd_client_handshake takes ownership on s->sioc. On failure it's unref'ed. */
-static int nbd_client_handshake(BlockDriverState *bs, Error **errp)
+static int nbd_client_handshake(BDRVNBDState *s, Error **errp)
 {
-    BDRVNBDState *s = (BDRVNBDState *)bs->opaque;
+    BlockDriverState *bs = s->bs;
     AioContext *aio_context = bdrv_get_aio_context(bs);
     int ret;
 
@@ -1844,7 +1908,7 @@ static int nbd_client_handshake(BlockDriverState *bs, Error **errp)
     g_free(s->info.name);
     if (ret < 0) {
         yank_unregister_function(BLOCKDEV_YANK_INSTANCE(bs->node_name),
-                                 nbd_yank, bs);
+                                 nbd_yank, s);
         object_unref(OBJECT(s->sioc));
         s->sioc = NULL;
         return ret;
@@ -1897,7 +1961,7 @@ static int nbd_client_handshake(BlockDriverState *bs, Error **errp)
         nbd_send_request(s->ioc ?: QIO_CHANNEL(s->sioc), &request);
 
         yank_unregister_function(BLOCKDEV_YANK_INSTANCE(bs->node_name),
-                                 nbd_yank, bs);
+                                 nbd_yank, s);
         object_unref(OBJECT(s->sioc));
         s->sioc = NULL;
 
@@ -2208,6 +2272,12 @@ static QemuOptsList nbd_runtime_opts = {
             .help = "experimental: expose named dirty bitmap in place of "
                     "block status",
         },
+        {
+            .name = "multi-conn",
+            .type = QEMU_OPT_NUMBER,
+            .help = "Number of connections to the export if the server "
+                    "allows several, default 1",
+        },
         {
             .name = "reconnect-delay",
             .type = QEMU_OPT_NUMBER,
@@ -2275,6 +2345,13 @@ static int nbd_process_options(BlockDriverState *bs, QDict *options,
 
     s->reconnect_delay = qemu_opt_get_number(opts, "reconnect-delay", 0);
 
+    s->multi_conn = qemu_opt_get_number(opts, "multi-conn", 1);
+    if (s->multi_conn < 1 || s->multi_conn > NBD_MAX_MULTI_CONN) {
+        error_setg(errp, "multi-conn must be between 1 and %d",
+                   NBD_MAX_MULTI_CONN);
+        goto error;
+    }
+
     ret = 0;
 
  error:
@@ -2285,6 +2362,74 @@ static int nbd_process_options(BlockDriverState *bs, QDict *options,
     return ret;
 }
 
+static void nbd_start_connection(BDRVNBDState *s)
+{
+    s->state = NBD_CLIENT_CONNECTED;
+
+    nbd_init_connect_thread(s);
+
+    s->connection_co = qemu_coroutine_create(nbd_connection_entry, s);
+    bdrv_inc_in_flight(s->bs);
+    aio_co_schedule(bdrv_get_aio_context(s->bs), s->connection_co);
+}
+
+/* Opens another connection to the export of @s for multi-conn */
+static int nbd_add_connection(BDRVNBDState *s, Error **errp)
+{
+    BDRVNBDState *c = g_new0(BDRVNBDState, 1);
+    int ret;
+
+    c->bs = s->bs;
+    c->saddr = QAPI_CLONE(SocketAddress, s->saddr);
+    c->export = g_strdup(s->export);
+    c->tlscredsid = g_strdup(s->tlscredsid);
+    if (s->tlscreds) {
+        c->tlscreds = s->tlscreds;
+        object_ref(OBJECT(c->tlscreds));
+        c->hostname = c->saddr->u.inet.host;
+    }
+    c->x_dirty_bitmap = g_strdup(s->x_dirty_bitmap);
+    c->reconnect_delay = s->reconnect_delay;
+    qemu_co_mutex_init(&c->send_mutex);
+    qemu_co_queue_init(&c->free_sema);
+
+    if (nbd_establish_connection(c, c->saddr, errp) < 0) {
+        ret = -ECONNREFUSED;
+        goto fail;
+    }
+
+    ret = nbd_client_handshake(c, errp);
+    if (ret < 0) {
+        goto fail;
+    }
+
+    if (c->info.size != s->info.size || c->info.flags != s->info.flags ||
+        c->info.structured_reply != s->info.structured_reply ||
+        c->info.base_allocation != s->info.base_allocation)
+    {
+        NBDRequest request = { .type = NBD_CMD_DISC };
+
+        error_setg(errp, "The server offered a different export on another "
+                   "connection");
+        nbd_send_request(c->ioc, &request);
+        yank_unregister_function(BLOCKDEV_YANK_INSTANCE(c->bs->node_name),
+                                 nbd_yank, c);
+        object_unref(OBJECT(c->sioc));
+        object_unref(OBJECT(c->ioc));
+        ret = -EINVAL;
+        goto fail;
+    }
+
+    nbd_start_connection(c);
+    s->conns[s->nb_conns++] = c;
+    return 0;
+
+fail:
+    nbd_clear_bdrvstate(c);
+    g_free(c);
+    return ret;
+}
+
 static int nbd_open(BlockDriverState *bs, QDict *options, int flags,
                     Error **errp)
 {
@@ -2297,6 +2442,8 @@ static int nbd_open(BlockDriverState *bs, QDict *options, int flags,
     }
 
     s->bs = bs;
+    s->conns[0] = s;
+    s->nb_conns = 1;
     qemu_co_mutex_init(&s->send_mutex);
     qemu_co_queue_init(&s->free_sema);
 
@@ -2308,25 +2455,39 @@ static int nbd_open(BlockDriverState *bs, QDict *options, int flags,
      * establish TCP connection, return error if it fails
      * TODO: Configurable retry-until-timeout behaviour.
      */
-    if (nbd_establish_connection(bs, s->saddr, errp) < 0) {
+    if (nbd_establish_connection(s, s->saddr, errp) < 0) {
         yank_unregister_instance(BLOCKDEV_YANK_INSTANCE(bs->node_name));
         return -ECONNREFUSED;
     }
 
-    ret = nbd_client_handshake(bs, errp);
+    ret = nbd_client_handshake(s, errp);
     if (ret < 0) {
         yank_unregister_instance(BLOCKDEV_YANK_INSTANCE(bs->node_name));
         nbd_clear_bdrvstate(s);
         return ret;
     }
     /* successfully connected */
-    s->state = NBD_CLIENT_CONNECTED;
+    nbd_start_connection(s);
 
-    nbd_init_connect_thread(s);
-
-    s->connection_co = qemu_coroutine_create(nbd_connection_entry, s);
-    bdrv_inc_in_flight(bs);
-    aio_co_schedule(bdrv_get_aio_context(bs), s->connection_co);
+    /*
+     * Without NBD_FLAG_CAN_MULTI_CONN, a flush on one connection may not
+     * cover writes completed on another one.
+     */
+    if (s->multi_conn > 1 && !(s->info.flags & NBD_FLAG_CAN_MULTI_CONN)) {
+        warn_report("nbd: The server doesn't allow multi-conn for export "
+                    "'%s', using a single connection", s->export ?: "");
+    } else {
+        while (s->nb_conns < s->multi_conn) {
+            Error *local_err = NULL;
+
+            if (nbd_add_connection(s, &local_err) < 0) {
+                warn_reportf_err(local_err, "nbd: Using %d connections "
+                                 "instead of %" PRIu32 ": ", s->nb_conns,
+                                 s->multi_conn);
+                break;
+            }
+        }
+    }
 
     return 0;
 }
@@ -2373,8 +2534,14 @@ static void nbd_refresh_limits(BlockDriverState *bs, Error **errp)
 static void nbd_close(BlockDriverState *bs)
 {
     BDRVNBDState *s = bs->opaque;
+    int i;
 
     nbd_client_close(bs);
+    for (i = 1; i < s->nb_conns; i++) {
+        nbd_clear_bdrvstate(s->conns[i]);
+        g_free(s->conns[i]);
+    }
+    s->nb_conns = 1;
     yank_unregister_instance(BLOCKDEV_YANK_INSTANCE(bs->node_name));
     nbd_clear_bdrvstate(s);
 }
@@ -2472,12 +2639,17 @@ static const char *const nbd_strong_runtime_opts[] = {
 static void nbd_cancel_in_flight(BlockDriverState *bs)
 {
     BDRVNBDState *s = (BDRVNBDState *)bs->opaque;
+    int i;
 
-    reconnect_delay_timer_del(s);
+    for (i = 0; i < s->nb_conns; i++) {
+        BDRVNBDState *c = s->conns[i];
 
-    if (s->state == NBD_CLIENT_CONNECTING_WAIT) {
-        s->state = NBD_CLIENT_CONNECTING_NOWAIT;
-        qemu_co_queue_restart_all(&s->free_sema);
+        reconnect_delay_timer_del(c);
+
+        if (c->state == NBD_CLIENT_CONNECTING_WAIT) {
+            c->state = NBD_CLIENT_CONNECTING_NOWAIT;
+            qemu_co_queue_restart_all(&c->free_sema);
+        }
     }
 }
 
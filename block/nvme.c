@@ -23,6 +23,7 @@
 #include "qemu/option.h"
 #include "qemu/vfio-helpers.h"
 #include "block/block_int.h"
+#include "sysemu/block-backend.h"
 #include "sysemu/replay.h"
 #include "trace.h"
 
@@ -33,6 +34,9 @@
 #define NVME_QUEUE_SIZE 128
 #define NVME_DOORBELL_SIZE 4096
 
+/* Number of I/O queues requested from the controller */
+#define NVME_MAX_IO_QUEUES 64
+
 /*
  * We have to leave one slot empty as that is the full queue case where
  * head == tail + 1.
@@ -45,7 +49,12 @@ typedef struct BDRVNVMeState BDRVNVMeState;
 #define INDEX_ADMIN     0
 #define INDEX_IO(n)     (1 + n)
 
-/* This driver shares a single MSIX IRQ for the admin and I/O queues */
+/*
+ * The admin queue and the I/O queue of the node's AioContext share a single
+ * MSIX IRQ.  The I/O queues of other AioContexts (see
+ * nvme_attach_multiqueue_context()) use the vector with their queue index if
+ * the device has enough vectors, and the shared one otherwise.
+ */
 enum {
     MSIX_SHARED_IRQ_IDX = 0,
     MSIX_IRQ_COUNT = 1
@@ -74,6 +83,9 @@ typedef struct {
     /* Read from I/O code path, initialized under BQL */
     BDRVNVMeState   *s;
     int             index;
+    AioContext      *aio_context; /* where completions are processed */
+    int             irq_vector;   /* -1 if completions are polled */
+    EventNotifier   irq_notifier; /* if irq_vector > 0 */
 
     /* Fields protected by BQL */
     uint8_t     *prp_list_pages;
@@ -89,6 +101,7 @@ typedef struct {
 
     /* Thread-safe, no lock necessary */
     QEMUBH      *completion_bh;
+    QEMUBH      *poll_bh; /* if irq_vector == -1 */
 } NVMeQueuePair;
 
 struct BDRVNVMeState {
@@ -111,16 +124,20 @@ struct BDRVNVMeState {
     size_t doorbell_scale;
     bool write_cache_supported;
     EventNotifier irq_notifier[MSIX_IRQ_COUNT];
+    unsigned irq_count; /* number of enabled MSIX vectors */
+    bool poll_completions;
 
     uint64_t nsze; /* Namespace size reported by identify command */
     int nsid;      /* The namespace id to read/write data. */
     int blkshift;
 
     uint64_t max_transfer;
-    bool plugged;
 
     bool supports_write_zeroes;
     bool supports_discard;
+    bool supports_copy;
+    /* Maximum number of blocks one Copy command may copy */
+    uint32_t max_copy_blocks;
 
     CoMutex dma_map_lock;
     CoQueue dma_flush_queue;
@@ -140,6 +157,7 @@ struct BDRVNVMeState {
 
 #define NVME_BLOCK_OPT_DEVICE "device"
 #define NVME_BLOCK_OPT_NAMESPACE "namespace"
+#define NVME_BLOCK_OPT_POLL_COMPLETIONS "poll-completions"
 
 static void nvme_process_completion_bh(void *opaque);
 
@@ -157,6 +175,12 @@ static QemuOptsList runtime_opts = {
             .type = QEMU_OPT_NUMBER,
             .help = "NVMe namespace",
         },
+        {
+            .name = NVME_BLOCK_OPT_POLL_COMPLETIONS,
+            .type = QEMU_OPT_BOOL,
+            .help = "Poll the I/O completion queues instead of using "
+                    "interrupts",
+        },
         { /* end of list */ }
     },
 };
@@ -187,9 +211,19 @@ static bool nvme_init_queue(BDRVNVMeState *s, NVMeQueue *q,
 static void nvme_free_queue_pair(NVMeQueuePair *q)
 {
     trace_nvme_free_queue_pair(q->index, q);
+    if (q->irq_vector > 0) {
+        aio_set_event_notifier(q->aio_context, &q->irq_notifier,
+                               false, NULL, NULL);
+        qemu_vfio_pci_set_irq_vector(q->s->vfio, VFIO_PCI_MSIX_IRQ_INDEX,
+                                     q->irq_vector, NULL, NULL);
+        event_notifier_cleanup(&q->irq_notifier);
+    }
     if (q->completion_bh) {
         qemu_bh_delete(q->completion_bh);
     }
+    if (q->poll_bh) {
+        qemu_bh_delete(q->poll_bh);
+    }
     qemu_vfree(q->prp_list_pages);
     qemu_vfree(q->sq.queue);
     qemu_vfree(q->cq.queue);
@@ -234,6 +268,7 @@ static NVMeQueuePair *nvme_create_queue_pair(BDRVNVMeState *s,
     qemu_mutex_init(&q->lock);
     q->s = s;
     q->index = idx;
+    q->aio_context = aio_context;
     qemu_co_queue_init(&q->free_req_queue);
     q->completion_bh = aio_bh_new(aio_context, nvme_process_completion_bh, q);
     r = qemu_vfio_dma_map(s->vfio, q->prp_list_pages, bytes,
@@ -272,7 +307,7 @@ static void nvme_kick(NVMeQueuePair *q)
 {
     BDRVNVMeState *s = q->s;
 
-    if (s->plugged || !q->need_kick) {
+    if (!q->need_kick) {
         return;
     }
     trace_nvme_kick(s, q->index);
@@ -282,6 +317,10 @@ static void nvme_kick(NVMeQueuePair *q)
     *q->sq.doorbell = cpu_to_le32(q->sq.tail);
     q->inflight += q->need_kick;
     q->need_kick = 0;
+
+    if (q->poll_bh) {
+        qemu_bh_schedule(q->poll_bh);
+    }
 }
 
 /* Find a free request element if any, otherwise:
@@ -323,7 +362,7 @@ static void nvme_put_free_req_locked(NVMeQueuePair *q, NVMeRequest *req)
 static void nvme_wake_free_req_locked(NVMeQueuePair *q)
 {
     if (!qemu_co_queue_empty(&q->free_req_queue)) {
-        replay_bh_schedule_oneshot_event(q->s->aio_context,
+        replay_bh_schedule_oneshot_event(q->aio_context,
                 nvme_free_req_queue_cb, q);
     }
 }
@@ -369,10 +408,6 @@ static bool nvme_process_completion(NVMeQueuePair *q)
     NvmeCqe *c;
 
     trace_nvme_process_completion(s, q->index, q->inflight);
-    if (s->plugged) {
-        trace_nvme_process_completion_queue_plugged(s, q->index);
-        return false;
-    }
 
     /*
      * Support re-entrancy when a request cb() function invokes aio_poll().
@@ -462,6 +497,16 @@ static void nvme_trace_command(const NvmeCmd *cmd)
     }
 }
 
+static void nvme_unplug_fn(void *opaque)
+{
+    NVMeQueuePair *q = opaque;
+
+    qemu_mutex_lock(&q->lock);
+    nvme_kick(q);
+    nvme_process_completion(q);
+    qemu_mutex_unlock(&q->lock);
+}
+
 static void nvme_submit_command(NVMeQueuePair *q, NVMeRequest *req,
                                 NvmeCmd *cmd, BlockCompletionFunc cb,
                                 void *opaque)
@@ -478,9 +523,9 @@ static void nvme_submit_command(NVMeQueuePair *q, NVMeRequest *req,
            q->sq.tail * NVME_SQ_ENTRY_BYTES, cmd, sizeof(*cmd));
     q->sq.tail = (q->sq.tail + 1) % NVME_QUEUE_SIZE;
     q->need_kick++;
-    nvme_kick(q);
-    nvme_process_completion(q);
     qemu_mutex_unlock(&q->lock);
+
+    blk_io_plug_call(nvme_unplug_fn, q);
 }
 
 static void nvme_admin_cmd_sync_cb(void *opaque, int ret)
@@ -558,6 +603,7 @@ static bool nvme_identify(BlockDriverState *bs, int namespace, Error **errp)
     oncs = le16_to_cpu(id->ctrl.oncs);
     s->supports_write_zeroes = !!(oncs & NVME_ONCS_WRITE_ZEROES);
     s->supports_discard = !!(oncs & NVME_ONCS_DSM);
+    s->supports_copy = !!(oncs & NVME_ONCS_COPY);
 
     memset(id, 0, id_size);
     cmd.cdw10 = 0;
@@ -570,6 +616,11 @@ static bool nvme_identify(BlockDriverState *bs, int namespace, Error **errp)
     s->nsze = le64_to_cpu(id->ns.nsze);
     lbaf = &id->ns.lbaf[NVME_ID_NS_FLBAS_INDEX(id->ns.flbas)];
 
+    /* We always send a single source range, whose NLB field is 16 bits */
+    s->max_copy_blocks = MIN_NON_ZERO(le16_to_cpu(id->ns.mssrl),
+                                      le32_to_cpu(id->ns.mcl));
+    s->max_copy_blocks = MIN_NON_ZERO(s->max_copy_blocks, 1 << 16);
+
     if (NVME_ID_NS_DLFEAT_WRITE_ZEROES(id->ns.dlfeat) &&
             NVME_ID_NS_DLFEAT_READ_BEHAVIOR(id->ns.dlfeat) ==
                     NVME_ID_NS_DLFEAT_READ_BEHAVIOR_ZEROES) {
@@ -631,13 +682,50 @@ static bool nvme_poll_queues(BDRVNVMeState *s)
     int i;
 
     for (i = 0; i < s->queue_count; i++) {
-        if (nvme_poll_queue(s->queues[i])) {
+        NVMeQueuePair *q = s->queues[i];
+
+        /* Queues with their own vector are processed in their AioContext */
+        if (q && q->irq_vector == 0 && nvme_poll_queue(q)) {
             progress = true;
         }
     }
     return progress;
 }
 
+/*
+ * Without interrupts, poll the queue from a BH for as long as there are
+ * requests in flight.  The BH keeps the event loop from blocking, so
+ * completions are noticed as soon as the device posts them.
+ */
+static void nvme_poll_bh(void *opaque)
+{
+    NVMeQueuePair *q = opaque;
+
+    nvme_poll_queue(q);
+
+    qemu_mutex_lock(&q->lock);
+    if (q->inflight) {
+        qemu_bh_schedule(q->poll_bh);
+    }
+    qemu_mutex_unlock(&q->lock);
+}
+
+static void nvme_handle_queue_event(EventNotifier *n)
+{
+    NVMeQueuePair *q = container_of(n, NVMeQueuePair, irq_notifier);
+
+    event_notifier_test_and_clear(n);
+    nvme_poll_queue(q);
+}
+
+static bool nvme_queue_poll_cb(void *opaque)
+{
+    EventNotifier *e = opaque;
+    NVMeQueuePair *q = container_of(e, NVMeQueuePair, irq_notifier);
+
+    return nvme_poll_queue(q);
+}
+
 static void nvme_handle_event(EventNotifier *n)
 {
     BDRVNVMeState *s = container_of(n, BDRVNVMeState,
@@ -648,25 +736,55 @@ static void nvme_handle_event(EventNotifier *n)
     nvme_poll_queues(s);
 }
 
-static bool nvme_add_io_queue(BlockDriverState *bs, Error **errp)
+/*
+ * Creates an I/O queue whose completions are processed in @ctx.  The queue
+ * takes the lowest free queue index.
+ */
+static NVMeQueuePair *nvme_add_io_queue(BlockDriverState *bs, AioContext *ctx,
+                                        Error **errp)
 {
     BDRVNVMeState *s = bs->opaque;
-    unsigned n = s->queue_count;
+    unsigned n;
     NVMeQueuePair *q;
     NvmeCmd cmd;
     unsigned queue_size = NVME_QUEUE_SIZE;
+    uint32_t cq_flags = NVME_CQ_PC;
+
+    for (n = INDEX_IO(0); n < s->queue_count && s->queues[n]; n++) {
+        /* Reuse the index of a deleted queue */
+    }
 
     assert(n <= UINT16_MAX);
-    q = nvme_create_queue_pair(s, bdrv_get_aio_context(bs),
-                               n, queue_size, errp);
+    q = nvme_create_queue_pair(s, ctx, n, queue_size, errp);
     if (!q) {
-        return false;
+        return NULL;
+    }
+
+    if (s->poll_completions) {
+        q->irq_vector = -1;
+        q->poll_bh = aio_bh_new(ctx, nvme_poll_bh, q);
+    } else if (ctx != s->aio_context && n < s->irq_count &&
+               event_notifier_init(&q->irq_notifier, 0) == 0) {
+        if (qemu_vfio_pci_set_irq_vector(s->vfio, VFIO_PCI_MSIX_IRQ_INDEX, n,
+                                         &q->irq_notifier, NULL) == 0) {
+            q->irq_vector = n;
+            aio_set_event_notifier(ctx, &q->irq_notifier, false,
+                                   nvme_handle_queue_event,
+                                   nvme_queue_poll_cb);
+        } else {
+            /* Fall back to the shared vector */
+            event_notifier_cleanup(&q->irq_notifier);
+        }
+    }
+    if (q->irq_vector >= 0) {
+        cq_flags |= NVME_CQ_IEN;
     }
+
     cmd = (NvmeCmd) {
         .opcode = NVME_ADM_CMD_CREATE_CQ,
         .dptr.prp1 = cpu_to_le64(q->cq.iova),
         .cdw10 = cpu_to_le32(((queue_size - 1) << 16) | n),
-        .cdw11 = cpu_to_le32(NVME_CQ_IEN | NVME_CQ_PC),
+        .cdw11 = cpu_to_le32((MAX(q->irq_vector, 0) << 16) | cq_flags),
     };
     if (nvme_admin_cmd_sync(bs, &cmd)) {
         error_setg(errp, "Failed to create CQ io queue [%u]", n);
@@ -680,15 +798,84 @@ static bool nvme_add_io_queue(BlockDriverState *bs, Error **errp)
     };
     if (nvme_admin_cmd_sync(bs, &cmd)) {
         error_setg(errp, "Failed to create SQ io queue [%u]", n);
-        goto out_error;
+        goto out_delete_cq;
+    }
+    if (n == s->queue_count) {
+        s->queues = g_renew(NVMeQueuePair *, s->queues, n + 1);
+        s->queue_count++;
     }
-    s->queues = g_renew(NVMeQueuePair *, s->queues, n + 1);
     s->queues[n] = q;
-    s->queue_count++;
-    return true;
+    return q;
+out_delete_cq:
+    cmd = (NvmeCmd) {
+        .opcode = NVME_ADM_CMD_DELETE_CQ,
+        .cdw10 = cpu_to_le32(n),
+    };
+    nvme_admin_cmd_sync(bs, &cmd);
 out_error:
     nvme_free_queue_pair(q);
-    return false;
+    return NULL;
+}
+
+/*
+ * Deletes an I/O queue created by nvme_add_io_queue().  No requests may be
+ * in flight on it.
+ */
+static void nvme_del_io_queue(BlockDriverState *bs, NVMeQueuePair *q)
+{
+    BDRVNVMeState *s = bs->opaque;
+    unsigned n = q->index;
+    NvmeCmd cmd;
+
+    assert(n > INDEX_IO(0) && s->queues[n] == q);
+    assert(!q->inflight);
+
+    cmd = (NvmeCmd) {
+        .opcode = NVME_ADM_CMD_DELETE_SQ,
+        .cdw10 = cpu_to_le32(n),
+    };
+    if (nvme_admin_cmd_sync(bs, &cmd)) {
+        warn_report("nvme: Failed to delete SQ io queue [%u]", n);
+    }
+    cmd = (NvmeCmd) {
+        .opcode = NVME_ADM_CMD_DELETE_CQ,
+        .cdw10 = cpu_to_le32(n),
+    };
+    if (nvme_admin_cmd_sync(bs, &cmd)) {
+        warn_report("nvme: Failed to delete CQ io queue [%u]", n);
+    }
+
+    s->queues[n] = NULL;
+    while (!s->queues[s->queue_count - 1]) {
+        s->queue_count--;
+    }
+    nvme_free_queue_pair(q);
+}
+
+/* The I/O queue of an AioContext other than the node's, or NULL */
+static NVMeQueuePair *nvme_find_mq_io_queue(BDRVNVMeState *s, AioContext *ctx)
+{
+    for (unsigned i = INDEX_IO(1); i < s->queue_count; i++) {
+        NVMeQueuePair *q = s->queues[i];
+
+        if (q && q->aio_context == ctx) {
+            return q;
+        }
+    }
+    return NULL;
+}
+
+/* The I/O queue for a request submitted from the current AioContext */
+static NVMeQueuePair *nvme_get_io_queue(BlockDriverState *bs)
+{
+    BDRVNVMeState *s = bs->opaque;
+    AioContext *ctx = bdrv_get_request_aio_context(bs);
+    NVMeQueuePair *q = NULL;
+
+    if (ctx != s->aio_context) {
+        q = nvme_find_mq_io_queue(s, ctx);
+    }
+    return q ?: s->queues[INDEX_IO(0)];
 }
 
 static bool nvme_poll_cb(void *opaque)
@@ -706,6 +893,7 @@ static int nvme_init(BlockDriverState *bs, const char *device, int namespace,
     BDRVNVMeState *s = bs->opaque;
     NVMeQueuePair *q;
     AioContext *aio_context = bdrv_get_aio_context(bs);
+    NvmeCmd cmd;
     int ret;
     uint64_t cap;
     uint32_t ver;
@@ -825,8 +1013,13 @@ static int nvme_init(BlockDriverState *bs, const char *device, int namespace,
         }
     }
 
+    ret = qemu_vfio_pci_get_irq_count(s->vfio, VFIO_PCI_MSIX_IRQ_INDEX, errp);
+    if (ret < 0) {
+        goto out;
+    }
+    s->irq_count = MIN(MAX(ret, 1), INDEX_IO(NVME_MAX_IO_QUEUES));
     ret = qemu_vfio_pci_init_irq(s->vfio, s->irq_notifier,
-                                 VFIO_PCI_MSIX_IRQ_INDEX, errp);
+                                 VFIO_PCI_MSIX_IRQ_INDEX, s->irq_count, errp);
     if (ret) {
         goto out;
     }
@@ -839,8 +1032,21 @@ static int nvme_init(BlockDriverState *bs, const char *device, int namespace,
         goto out;
     }
 
+    /*
+     * Ask for enough I/O queues to give each IOThread its own.  Only the
+     * first one is required, so errors are ignored here; creating the
+     * others fails if the controller doesn't have them.
+     */
+    cmd = (NvmeCmd) {
+        .opcode = NVME_ADM_CMD_SET_FEATURES,
+        .cdw10 = cpu_to_le32(NVME_NUMBER_OF_QUEUES),
+        .cdw11 = cpu_to_le32(((NVME_MAX_IO_QUEUES - 1) << 16) |
+                             (NVME_MAX_IO_QUEUES - 1)),
+    };
+    nvme_admin_cmd_sync(bs, &cmd);
+
     /* Set up command queues. */
-    if (!nvme_add_io_queue(bs, errp)) {
+    if (!nvme_add_io_queue(bs, aio_context, errp)) {
         ret = -EIO;
     }
 out:
@@ -912,7 +1118,9 @@ static void nvme_close(BlockDriverState *bs)
     BDRVNVMeState *s = bs->opaque;
 
     for (unsigned i = 0; i < s->queue_count; ++i) {
-        nvme_free_queue_pair(s->queues[i]);
+        if (s->queues[i]) {
+            nvme_free_queue_pair(s->queues[i]);
+        }
     }
     g_free(s->queues);
     aio_set_event_notifier(bdrv_get_aio_context(bs),
@@ -947,6 +1155,9 @@ static int nvme_file_open(BlockDriverState *bs, QDict *options, int flags,
     }
 
     namespace = qemu_opt_get_number(opts, NVME_BLOCK_OPT_NAMESPACE, 1);
+    s->poll_completions = qemu_opt_get_bool(opts,
+                                            NVME_BLOCK_OPT_POLL_COMPLETIONS,
+                                            false);
     ret = nvme_init(bs, device, namespace, errp);
     qemu_opts_del(opts);
     if (ret) {
@@ -1119,7 +1330,7 @@ static coroutine_fn int nvme_co_prw_aligned(BlockDriverState *bs,
 {
     int r;
     BDRVNVMeState *s = bs->opaque;
-    NVMeQueuePair *ioq = s->queues[INDEX_IO(0)];
+    NVMeQueuePair *ioq = nvme_get_io_queue(bs);
     NVMeRequest *req;
 
     uint32_t cdw12 = (((bytes >> s->blkshift) - 1) & 0xFFFF) |
@@ -1132,7 +1343,7 @@ static coroutine_fn int nvme_co_prw_aligned(BlockDriverState *bs,
         .cdw12 = cpu_to_le32(cdw12),
     };
     NVMeCoData data = {
-        .ctx = bdrv_get_aio_context(bs),
+        .ctx = bdrv_get_request_aio_context(bs),
         .ret = -EINPROGRESS,
     };
 
@@ -1237,14 +1448,14 @@ static coroutine_fn int nvme_co_pwritev(BlockDriverState *bs,
 static coroutine_fn int nvme_co_flush(BlockDriverState *bs)
 {
     BDRVNVMeState *s = bs->opaque;
-    NVMeQueuePair *ioq = s->queues[INDEX_IO(0)];
+    NVMeQueuePair *ioq = nvme_get_io_queue(bs);
     NVMeRequest *req;
     NvmeCmd cmd = {
         .opcode = NVME_CMD_FLUSH,
         .nsid = cpu_to_le32(s->nsid),
     };
     NVMeCoData data = {
-        .ctx = bdrv_get_aio_context(bs),
+        .ctx = bdrv_get_request_aio_context(bs),
         .ret = -EINPROGRESS,
     };
 
@@ -1268,7 +1479,7 @@ static coroutine_fn int nvme_co_pwrite_zeroes(BlockDriverState *bs,
                                               BdrvRequestFlags flags)
 {
     BDRVNVMeState *s = bs->opaque;
-    NVMeQueuePair *ioq = s->queues[INDEX_IO(0)];
+    NVMeQueuePair *ioq = nvme_get_io_queue(bs);
     NVMeRequest *req;
 
     uint32_t cdw12 = ((bytes >> s->blkshift) - 1) & 0xFFFF;
@@ -1285,7 +1496,7 @@ static coroutine_fn int nvme_co_pwrite_zeroes(BlockDriverState *bs,
     };
 
     NVMeCoData data = {
-        .ctx = bdrv_get_aio_context(bs),
+        .ctx = bdrv_get_request_aio_context(bs),
         .ret = -EINPROGRESS,
     };
 
@@ -1321,7 +1532,7 @@ static int coroutine_fn nvme_co_pdiscard(BlockDriverState *bs,
                                          int bytes)
 {
     BDRVNVMeState *s = bs->opaque;
-    NVMeQueuePair *ioq = s->queues[INDEX_IO(0)];
+    NVMeQueuePair *ioq = nvme_get_io_queue(bs);
     NVMeRequest *req;
     NvmeDsmRange *buf;
     QEMUIOVector local_qiov;
@@ -1335,7 +1546,7 @@ static int coroutine_fn nvme_co_pdiscard(BlockDriverState *bs,
     };
 
     NVMeCoData data = {
-        .ctx = bdrv_get_aio_context(bs),
+        .ctx = bdrv_get_request_aio_context(bs),
         .ret = -EINPROGRESS,
     };
 
@@ -1395,6 +1606,130 @@ out:
 
 }
 
+/* Copies up to s->max_copy_blocks blocks with a single Simple Copy command */
+static int coroutine_fn nvme_co_copy(BlockDriverState *bs,
+                                     uint64_t src_offset, uint64_t dst_offset,
+                                     uint64_t bytes)
+{
+    BDRVNVMeState *s = bs->opaque;
+    NVMeQueuePair *ioq = nvme_get_io_queue(bs);
+    NVMeRequest *req;
+    NvmeCopySourceRange *buf;
+    QEMUIOVector local_qiov;
+    int ret;
+
+    NvmeCmd cmd = {
+        .opcode = NVME_CMD_COPY,
+        .nsid = cpu_to_le32(s->nsid),
+        .cdw10 = cpu_to_le32((dst_offset >> s->blkshift) & 0xFFFFFFFF),
+        .cdw11 = cpu_to_le32(((dst_offset >> s->blkshift) >> 32) & 0xFFFFFFFF),
+        /* number of ranges - 0 based, and the descriptor format */
+        .cdw12 = cpu_to_le32(NVME_COPY_FORMAT_0 << 8),
+    };
+
+    NVMeCoData data = {
+        .ctx = bdrv_get_request_aio_context(bs),
+        .ret = -EINPROGRESS,
+    };
+
+    buf = qemu_try_memalign(s->page_size, s->page_size);
+    if (!buf) {
+        return -ENOMEM;
+    }
+    memset(buf, 0, s->page_size);
+    buf->slba = cpu_to_le64(src_offset >> s->blkshift);
+    buf->nlb = cpu_to_le16((bytes >> s->blkshift) - 1);
+
+    qemu_iovec_init(&local_qiov, 1);
+    qemu_iovec_add(&local_qiov, buf, 4096);
+
+    req = nvme_get_free_req(ioq);
+    assert(req);
+
+    qemu_co_mutex_lock(&s->dma_map_lock);
+    ret = nvme_cmd_map_qiov(bs, &cmd, req, &local_qiov);
+    qemu_co_mutex_unlock(&s->dma_map_lock);
+
+    if (ret) {
+        nvme_put_free_req_and_wake(ioq, req);
+        goto out;
+    }
+
+    trace_nvme_copy(s, src_offset, dst_offset, bytes);
+
+    nvme_submit_command(ioq, req, &cmd, nvme_rw_cb, &data);
+
+    data.co = qemu_coroutine_self();
+    while (data.ret == -EINPROGRESS) {
+        qemu_coroutine_yield();
+    }
+
+    qemu_co_mutex_lock(&s->dma_map_lock);
+    ret = nvme_cmd_unmap_qiov(bs, &local_qiov);
+    qemu_co_mutex_unlock(&s->dma_map_lock);
+
+    if (ret) {
+        goto out;
+    }
+
+    ret = data.ret;
+    trace_nvme_copy_done(s, src_offset, dst_offset, bytes, ret);
+out:
+    qemu_iovec_destroy(&local_qiov);
+    qemu_vfree(buf);
+    return ret;
+}
+
+static int coroutine_fn nvme_co_copy_range_from(
+        BlockDriverState *bs, BdrvChild *src, uint64_t src_offset,
+        BdrvChild *dst, uint64_t dst_offset, uint64_t bytes,
+        BdrvRequestFlags read_flags, BdrvRequestFlags write_flags)
+{
+    return bdrv_co_copy_range_to(src, src_offset, dst, dst_offset, bytes,
+                                 read_flags, write_flags);
+}
+
+static int coroutine_fn nvme_co_copy_range_to(BlockDriverState *bs,
+                                              BdrvChild *src,
+                                              uint64_t src_offset,
+                                              BdrvChild *dst,
+                                              uint64_t dst_offset,
+                                              uint64_t bytes,
+                                              BdrvRequestFlags read_flags,
+                                              BdrvRequestFlags write_flags)
+{
+    BDRVNVMeState *s = bs->opaque;
+    uint64_t max_bytes = (uint64_t)s->max_copy_blocks << s->blkshift;
+    int ret;
+
+    assert(dst->bs == bs);
+
+    /* Simple Copy only copies within a namespace */
+    if (!s->supports_copy || src->bs != bs) {
+        return -ENOTSUP;
+    }
+    if (!QEMU_IS_ALIGNED(src_offset | dst_offset | bytes, 1 << s->blkshift)) {
+        return -ENOTSUP;
+    }
+    if (write_flags & BDRV_REQ_FUA) {
+        /* The Copy command has a FUA bit, but we don't use it yet */
+        return -ENOTSUP;
+    }
+
+    while (bytes) {
+        uint64_t n = MIN(bytes, max_bytes);
+
+        ret = nvme_co_copy(bs, src_offset, dst_offset, n);
+        if (ret < 0) {
+            return ret;
+        }
+        src_offset += n;
+        dst_offset += n;
+        bytes -= n;
+    }
+    return 0;
+}
+
 static int coroutine_fn nvme_co_truncate(BlockDriverState *bs, int64_t offset,
                                          bool exact, PreallocMode prealloc,
                                          BdrvRequestFlags flags, Error **errp)
@@ -1446,11 +1781,16 @@ static void nvme_detach_aio_context(BlockDriverState *bs)
 {
     BDRVNVMeState *s = bs->opaque;
 
-    for (unsigned i = 0; i < s->queue_count; i++) {
+    /* The I/O queues of other AioContexts stay where they are */
+    for (unsigned i = INDEX_ADMIN; i <= INDEX_IO(0); i++) {
         NVMeQueuePair *q = s->queues[i];
 
         qemu_bh_delete(q->completion_bh);
         q->completion_bh = NULL;
+        if (q->poll_bh) {
+            qemu_bh_delete(q->poll_bh);
+            q->poll_bh = NULL;
+        }
     }
 
     aio_set_event_notifier(bdrv_get_aio_context(bs),
@@ -1467,32 +1807,47 @@ static void nvme_attach_aio_context(BlockDriverState *bs,
     aio_set_event_notifier(new_context, &s->irq_notifier[MSIX_SHARED_IRQ_IDX],
                            false, nvme_handle_event, nvme_poll_cb);
 
-    for (unsigned i = 0; i < s->queue_count; i++) {
+    for (unsigned i = INDEX_ADMIN; i <= INDEX_IO(0); i++) {
         NVMeQueuePair *q = s->queues[i];
 
+        q->aio_context = new_context;
         q->completion_bh =
             aio_bh_new(new_context, nvme_process_completion_bh, q);
+        if (q->irq_vector < 0) {
+            q->poll_bh = aio_bh_new(new_context, nvme_poll_bh, q);
+        }
     }
 }
 
-static void nvme_aio_plug(BlockDriverState *bs)
+/*
+ * Give requests from @ctx their own I/O queue, so that they are submitted
+ * and completed without involving the node's AioContext.  If the controller
+ * has no queue left, they share the node's I/O queue; this works because
+ * the queues are thread-safe, it just doesn't scale as well.
+ */
+static void nvme_attach_multiqueue_context(BlockDriverState *bs,
+                                           AioContext *ctx)
 {
     BDRVNVMeState *s = bs->opaque;
-    assert(!s->plugged);
-    s->plugged = true;
+    Error *local_err = NULL;
+
+    if (ctx == s->aio_context || nvme_find_mq_io_queue(s, ctx)) {
+        return;
+    }
+    if (!nvme_add_io_queue(bs, ctx, &local_err)) {
+        warn_reportf_err(local_err, "nvme: Sharing the I/O queue with "
+                         "another IOThread: ");
+    }
 }
 
-static void nvme_aio_unplug(BlockDriverState *bs)
+static void nvme_detach_multiqueue_context(BlockDriverState *bs,
+                                           AioContext *ctx)
 {
     BDRVNVMeState *s = bs->opaque;
-    assert(s->plugged);
-    s->plugged = false;
-    for (unsigned i = INDEX_IO(0); i < s->queue_count; i++) {
-        NVMeQueuePair *q = s->queues[i];
-        qemu_mutex_lock(&q->lock);
-        nvme_kick(q);
-        nvme_process_completion(q);
-        qemu_mutex_unlock(&q->lock);
+    NVMeQueuePair *q = nvme_find_mq_io_queue(s, ctx);
+
+    if (q) {
+        nvme_del_io_queue(bs, q);
     }
 }
 
@@ -1559,6 +1914,8 @@ static BlockDriver bdrv_nvme = {
 
     .bdrv_co_pwrite_zeroes    = nvme_co_pwrite_zeroes,
     .bdrv_co_pdiscard         = nvme_co_pdiscard,
+    .bdrv_co_copy_range_from  = nvme_co_copy_range_from,
+    .bdrv_co_copy_range_to    = nvme_co_copy_range_to,
 
     .bdrv_co_flush_to_disk    = nvme_co_flush,
     .bdrv_reopen_prepare      = nvme_reopen_prepare,
@@ -1571,8 +1928,10 @@ static BlockDriver bdrv_nvme = {
     .bdrv_detach_aio_context  = nvme_detach_aio_context,
     .bdrv_attach_aio_context  = nvme_attach_aio_context,
 
-    .bdrv_io_plug             = nvme_aio_plug,
-    .bdrv_io_unplug           = nvme_aio_unplug,
+    .bdrv_attach_multiqueue_context = nvme_attach_multiqueue_context,
+    .bdrv_detach_multiqueue_context = nvme_detach_multiqueue_context,
+    .supports_multiqueue      = true,
+
 
     .bdrv_register_buf        = nvme_register_buf,
     .bdrv_unregister_buf      = nvme_unregister_buf,
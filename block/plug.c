@@ -0,0 +1,155 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Block I/O plugging
+ *
+ * This API defers a function call within a blk_io_plug()/blk_io_unplug()
+ * section, allowing multiple calls to batch up. This is a performance
+ * optimization that is used in the block layer to submit several I/O requests
+ * at once instead of individually:
+ *
+ *   blk_io_plug(); <-- start of plugged region
+ *   ...
+ *   blk_io_plug_call(my_func, my_obj); <-- deferred my_func(my_obj) call
+ *   blk_io_plug_call(my_func, my_obj); <-- another
+ *   blk_io_plug_call(my_func, my_obj); <-- another
+ *   ...
+ *   blk_io_unplug(); <-- end of plugged region, my_func(my_obj) is called once
+ *
+ * The plug state lives in the calling thread rather than in a
+ * BlockDriverState, so it follows the requests through every layer of the
+ * graph (format drivers, filters) down to the protocol driver that actually
+ * submits them, as long as they are submitted before the section ends.
+ *
+ * This code is actually generic and not tied to the block layer. If another
+ * subsystem needs this functionality, it could be renamed.
+ */
+
+#include "qemu/osdep.h"
+#include "sysemu/block-backend.h"
+
+/* A function call that has been deferred until unplug() */
+typedef struct {
+    void (*fn)(void *);
+    void *opaque;
+} UnplugFn;
+
+/* Per-thread state */
+typedef struct {
+    unsigned count;       /* how many times has plug() been called? */
+    GArray *unplug_fns;   /* functions to call at unplug time */
+} Plug;
+
+static __thread Plug plug;
+
+/*
+ * Coroutines may move to another thread when they yield, so make sure the
+ * compiler does not cache the address of the thread-local variable.
+ */
+static Plug * __attribute__((noinline)) get_ptr_plug(void)
+{
+    return &plug;
+}
+
+/**
+ * blk_io_plug_call:
+ * @fn: a function pointer to be invoked
+ * @opaque: a user-defined argument to @fn()
+ *
+ * Call @fn(@opaque) immediately if not within a blk_io_plug()/blk_io_unplug()
+ * section.
+ *
+ * Otherwise defer the call until the end of the outermost
+ * blk_io_plug()/blk_io_unplug() section in this thread. If the same
+ * @fn/@opaque pair has already been deferred, it will only be called once upon
+ * blk_io_unplug() so that accumulated calls are batched into a single call.
+ *
+ * The caller must ensure that @opaque is not freed before @fn() is invoked.
+ */
+void blk_io_plug_call(void (*fn)(void *), void *opaque)
+{
+    Plug *plug = get_ptr_plug();
+    GArray *array = plug->unplug_fns;
+    UnplugFn new_fn;
+    guint i;
+
+    /* Call immediately if we're not plugged */
+    if (plug->count == 0) {
+        fn(opaque);
+        return;
+    }
+
+    if (!array) {
+        array = plug->unplug_fns = g_array_new(false, false, sizeof(UnplugFn));
+    }
+
+    for (i = 0; i < array->len; i++) {
+        UnplugFn *unplug_fn = &g_array_index(array, UnplugFn, i);
+
+        if (unplug_fn->fn == fn && unplug_fn->opaque == opaque) {
+            return; /* already deferred */
+        }
+    }
+
+    new_fn.fn = fn;
+    new_fn.opaque = opaque;
+    g_array_append_val(array, new_fn);
+}
+
+/**
+ * blk_io_plug: Defer blk_io_plug_call() functions until blk_io_unplug()
+ *
+ * blk_io_plug/unplug are thread-local operations. This means that multiple
+ * threads can simultaneously call plug/unplug, but the caller must ensure that
+ * each unplug() is called in the same thread of the matching plug().
+ *
+ * Nesting is supported. blk_io_plug_call() functions are only called at the
+ * outermost blk_io_unplug().
+ */
+void blk_io_plug(void)
+{
+    Plug *plug = get_ptr_plug();
+
+    assert(plug->count < UINT32_MAX);
+
+    plug->count++;
+}
+
+/**
+ * blk_io_unplug: Run any pending blk_io_plug_call() functions
+ *
+ * There must have been a matching blk_io_plug() call in the same thread prior
+ * to this blk_io_unplug() call.
+ */
+void blk_io_unplug(void)
+{
+    Plug *plug = get_ptr_plug();
+    GArray *array;
+    guint i;
+
+    assert(plug->count > 0);
+
+    if (--plug->count > 0 || !plug->unplug_fns) {
+        return;
+    }
+
+    /*
+     * The deferred functions may plug and defer calls again, so take the
+     * array away before calling them.
+     */
+    array = plug->unplug_fns;
+    plug->unplug_fns = NULL;
+
+    for (i = 0; i < array->len; i++) {
+        UnplugFn *unplug_fn = &g_array_index(array, UnplugFn, i);
+
+        unplug_fn->fn(unplug_fn->opaque);
+    }
+
+    /* Reuse the array unless a deferred function created a new one */
+    if (plug->unplug_fns) {
+        g_array_free(array, true);
+    } else {
+        g_array_set_size(array, 0);
+        plug->unplug_fns = array;
+    }
+}
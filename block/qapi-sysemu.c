@@ -512,6 +512,10 @@ void qmp_block_set_io_throttle(BlockIOThrottle *arg, Error **errp)
     }
 
     if (throttle_enabled(&cfg)) {
+        if (blk_is_multiqueue(blk)) {
+            error_setg(errp, "I/O throttling does not support multiqueue");
+            goto out;
+        }
         /* Enable I/O limits if they're not enabled yet, otherwise
          * just update the throttling group. */
         if (!blk_get_public(blk)->throttle_group_member.throttle_state) {
@@ -424,39 +424,90 @@ static void bdrv_latency_histogram_stats(BlockLatencyHistogram *hist,
     }
 }
 
+static BlockLatencyPercentiles *
+bdrv_latency_percentiles_one(BlockAcctStats *stats, enum BlockAcctPhase phase,
+                             enum BlockAcctType type, bool *not_null)
+{
+    static const double percentiles[] = { 50, 99, 99.9 };
+    uint64_t latencies[ARRAY_SIZE(percentiles)];
+    BlockLatencyPercentiles *p;
+    uint64_t count;
+
+    count = block_acct_latency_percentiles(stats, phase, type, percentiles,
+                                           latencies, ARRAY_SIZE(percentiles));
+    *not_null = count > 0;
+    if (!count) {
+        return NULL;
+    }
+
+    p = g_new0(BlockLatencyPercentiles, 1);
+    p->operations = count;
+    p->p50 = latencies[0];
+    p->p99 = latencies[1];
+    p->p999 = latencies[2];
+    return p;
+}
+
+static void bdrv_latency_percentiles_stats(BlockAcctStats *stats,
+                                           enum BlockAcctPhase phase,
+                                           bool *not_null,
+                                           BlockLatencyPercentilesInfo **info)
+{
+    BlockLatencyPercentilesInfo *i = g_new0(BlockLatencyPercentilesInfo, 1);
+
+    i->rd = bdrv_latency_percentiles_one(stats, phase, BLOCK_ACCT_READ,
+                                         &i->has_rd);
+    i->wr = bdrv_latency_percentiles_one(stats, phase, BLOCK_ACCT_WRITE,
+                                         &i->has_wr);
+    i->flush = bdrv_latency_percentiles_one(stats, phase, BLOCK_ACCT_FLUSH,
+                                            &i->has_flush);
+    i->unmap = bdrv_latency_percentiles_one(stats, phase, BLOCK_ACCT_UNMAP,
+                                            &i->has_unmap);
+
+    *not_null = i->has_rd || i->has_wr || i->has_flush || i->has_unmap;
+    if (*not_null) {
+        *info = i;
+    } else {
+        qapi_free_BlockLatencyPercentilesInfo(i);
+    }
+}
+
 static void bdrv_query_blk_stats(BlockDeviceStats *ds, BlockBackend *blk)
 {
     BlockAcctStats *stats = blk_get_stats(blk);
     BlockAcctTimedStats *ts = NULL;
+    BlockAcctCounters counters;
+
+    block_acct_get_counters(stats, &counters);
 
-    ds->rd_bytes = stats->nr_bytes[BLOCK_ACCT_READ];
-    ds->wr_bytes = stats->nr_bytes[BLOCK_ACCT_WRITE];
-    ds->unmap_bytes = stats->nr_bytes[BLOCK_ACCT_UNMAP];
-    ds->rd_operations = stats->nr_ops[BLOCK_ACCT_READ];
-    ds->wr_operations = stats->nr_ops[BLOCK_ACCT_WRITE];
-    ds->unmap_operations = stats->nr_ops[BLOCK_ACCT_UNMAP];
+    ds->rd_bytes = counters.nr_bytes[BLOCK_ACCT_READ];
+    ds->wr_bytes = counters.nr_bytes[BLOCK_ACCT_WRITE];
+    ds->unmap_bytes = counters.nr_bytes[BLOCK_ACCT_UNMAP];
+    ds->rd_operations = counters.nr_ops[BLOCK_ACCT_READ];
+    ds->wr_operations = counters.nr_ops[BLOCK_ACCT_WRITE];
+    ds->unmap_operations = counters.nr_ops[BLOCK_ACCT_UNMAP];
 
-    ds->failed_rd_operations = stats->failed_ops[BLOCK_ACCT_READ];
-    ds->failed_wr_operations = stats->failed_ops[BLOCK_ACCT_WRITE];
-    ds->failed_flush_operations = stats->failed_ops[BLOCK_ACCT_FLUSH];
-    ds->failed_unmap_operations = stats->failed_ops[BLOCK_ACCT_UNMAP];
+    ds->failed_rd_operations = counters.failed_ops[BLOCK_ACCT_READ];
+    ds->failed_wr_operations = counters.failed_ops[BLOCK_ACCT_WRITE];
+    ds->failed_flush_operations = counters.failed_ops[BLOCK_ACCT_FLUSH];
+    ds->failed_unmap_operations = counters.failed_ops[BLOCK_ACCT_UNMAP];
 
-    ds->invalid_rd_operations = stats->invalid_ops[BLOCK_ACCT_READ];
-    ds->invalid_wr_operations = stats->invalid_ops[BLOCK_ACCT_WRITE];
+    ds->invalid_rd_operations = counters.invalid_ops[BLOCK_ACCT_READ];
+    ds->invalid_wr_operations = counters.invalid_ops[BLOCK_ACCT_WRITE];
     ds->invalid_flush_operations =
-        stats->invalid_ops[BLOCK_ACCT_FLUSH];
-    ds->invalid_unmap_operations = stats->invalid_ops[BLOCK_ACCT_UNMAP];
-
-    ds->rd_merged = stats->merged[BLOCK_ACCT_READ];
-    ds->wr_merged = stats->merged[BLOCK_ACCT_WRITE];
-    ds->unmap_merged = stats->merged[BLOCK_ACCT_UNMAP];
-    ds->flush_operations = stats->nr_ops[BLOCK_ACCT_FLUSH];
-    ds->wr_total_time_ns = stats->total_time_ns[BLOCK_ACCT_WRITE];
-    ds->rd_total_time_ns = stats->total_time_ns[BLOCK_ACCT_READ];
-    ds->flush_total_time_ns = stats->total_time_ns[BLOCK_ACCT_FLUSH];
-    ds->unmap_total_time_ns = stats->total_time_ns[BLOCK_ACCT_UNMAP];
-
-    ds->has_idle_time_ns = stats->last_access_time_ns > 0;
+        counters.invalid_ops[BLOCK_ACCT_FLUSH];
+    ds->invalid_unmap_operations = counters.invalid_ops[BLOCK_ACCT_UNMAP];
+
+    ds->rd_merged = counters.merged[BLOCK_ACCT_READ];
+    ds->wr_merged = counters.merged[BLOCK_ACCT_WRITE];
+    ds->unmap_merged = counters.merged[BLOCK_ACCT_UNMAP];
+    ds->flush_operations = counters.nr_ops[BLOCK_ACCT_FLUSH];
+    ds->wr_total_time_ns = counters.total_time_ns[BLOCK_ACCT_WRITE];
+    ds->rd_total_time_ns = counters.total_time_ns[BLOCK_ACCT_READ];
+    ds->flush_total_time_ns = counters.total_time_ns[BLOCK_ACCT_FLUSH];
+    ds->unmap_total_time_ns = counters.total_time_ns[BLOCK_ACCT_UNMAP];
+
+    ds->has_idle_time_ns = counters.last_access_time_ns > 0;
     if (ds->has_idle_time_ns) {
         ds->idle_time_ns = block_acct_idle_time_ns(stats);
     }
@@ -502,6 +553,16 @@ static void bdrv_query_blk_stats(BlockDeviceStats *ds, BlockBackend *blk)
     bdrv_latency_histogram_stats(&stats->latency_histogram[BLOCK_ACCT_FLUSH],
                                  &ds->has_flush_latency_histogram,
                                  &ds->flush_latency_histogram);
+
+    bdrv_latency_percentiles_stats(stats, BLOCK_ACCT_PHASE_TOTAL,
+                                   &ds->has_latency_percentiles,
+                                   &ds->latency_percentiles);
+    bdrv_latency_percentiles_stats(stats, BLOCK_ACCT_PHASE_THROTTLE,
+                                   &ds->has_throttle_latency_percentiles,
+                                   &ds->throttle_latency_percentiles);
+    bdrv_latency_percentiles_stats(stats, BLOCK_ACCT_PHASE_DRIVER,
+                                   &ds->has_driver_latency_percentiles,
+                                   &ds->driver_latency_percentiles);
 }
 
 static BlockStats *bdrv_query_bds_stats(BlockDriverState *bs,
@@ -89,6 +89,7 @@ typedef struct Qcow2Bitmap {
     char *name;
 
     BdrvDirtyBitmap *dirty_bitmap;
+    bool table_current; /* table already holds the data of dirty_bitmap */
 
     QSIMPLEQ_ENTRY(Qcow2Bitmap) entry;
 } Qcow2Bitmap;
@@ -368,6 +369,7 @@ static BdrvDirtyBitmap *load_bitmap(BlockDriverState *bs,
                          bm->name);
         goto fail;
     }
+    bdrv_dirty_bitmap_set_stored(bitmap, true);
 
     g_free(bitmap_table);
     return bitmap;
@@ -1599,10 +1601,19 @@ bool qcow2_store_persistent_dirty_bitmaps(BlockDriverState *bs,
                            name);
                 goto fail;
             }
-            tb = g_memdup(&bm->table, sizeof(bm->table));
-            bm->table.offset = 0;
-            bm->table.size = 0;
-            QSIMPLEQ_INSERT_TAIL(&drop_tables, tb, entry);
+            if (bm->table.offset &&
+                bdrv_dirty_bitmap_stored_is_current(bitmap)) {
+                /*
+                 * Unchanged since it was loaded or last stored (typically
+                 * a disabled bitmap); keep the data that is in the image.
+                 */
+                bm->table_current = true;
+            } else {
+                tb = g_memdup(&bm->table, sizeof(bm->table));
+                bm->table.offset = 0;
+                bm->table.size = 0;
+                QSIMPLEQ_INSERT_TAIL(&drop_tables, tb, entry);
+            }
         }
         bm->flags = bdrv_dirty_bitmap_enabled(bitmap) ? BME_FLAG_AUTO : 0;
         bm->granularity_bits = ctz32(bdrv_dirty_bitmap_granularity(bitmap));
@@ -1622,7 +1633,8 @@ bool qcow2_store_persistent_dirty_bitmaps(BlockDriverState *bs,
     QSIMPLEQ_FOREACH(bm, bm_list, entry) {
         BdrvDirtyBitmap *bitmap = bm->dirty_bitmap;
 
-        if (bitmap == NULL || bdrv_dirty_bitmap_readonly(bitmap)) {
+        if (bitmap == NULL || bdrv_dirty_bitmap_readonly(bitmap) ||
+            bm->table_current) {
             continue;
         }
 
@@ -1645,6 +1657,13 @@ bool qcow2_store_persistent_dirty_bitmaps(BlockDriverState *bs,
         g_free(tb);
     }
 
+    QSIMPLEQ_FOREACH(bm, bm_list, entry) {
+        if (bm->dirty_bitmap &&
+            !bdrv_dirty_bitmap_readonly(bm->dirty_bitmap)) {
+            bdrv_dirty_bitmap_set_stored(bm->dirty_bitmap, true);
+        }
+    }
+
 success:
     if (release_stored) {
         QSIMPLEQ_FOREACH(bm, bm_list, entry) {
@@ -1662,6 +1681,7 @@ success:
 fail:
     QSIMPLEQ_FOREACH(bm, bm_list, entry) {
         if (bm->dirty_bitmap == NULL || bm->table.offset == 0 ||
+            bm->table_current ||
             bdrv_dirty_bitmap_readonly(bm->dirty_bitmap))
         {
             continue;
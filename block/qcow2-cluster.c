@@ -728,6 +728,120 @@ fail:
     return ret;
 }
 
+/*
+ * get_host_offset_cached
+ *
+ * Fast path of qcow2_get_host_offset() for reads that can be called
+ * without holding s->lock.  It succeeds if the mapping of @offset can be
+ * resolved without doing any I/O, i.e. if @offset is not covered by the L1
+ * table, has no L2 table, or if its L2 slice is already in the cache.  The
+ * return value is true in that case and *bytes, *host_offset and
+ * *subcluster_type are set like qcow2_get_host_offset() does.
+ *
+ * Compressed clusters, mappings that look corrupted and L2 slices that are
+ * not cached return false; the caller must then take s->lock and use
+ * qcow2_get_host_offset().
+ *
+ * This never yields, so the L2 slice cannot be evicted or change under our
+ * feet while we look at it; all modifications of the L2 tables and the L1
+ * table happen in the same AioContext.  A writer holding s->lock only makes
+ * an allocated cluster visible in the L2 table after its data has been
+ * written, so a cluster found here can be read right away.
+ */
+bool qcow2_get_host_offset_cached(BlockDriverState *bs, uint64_t offset,
+                                  unsigned int *bytes, uint64_t *host_offset,
+                                  QCow2SubclusterType *subcluster_type)
+{
+    BDRVQcow2State *s = bs->opaque;
+    unsigned int l2_index, sc_index;
+    uint64_t l1_index, l2_offset, *l2_slice, l2_entry, l2_bitmap;
+    uint64_t host_cluster_offset = 0;
+    uint64_t bytes_available, bytes_needed, nb_clusters;
+    unsigned int offset_in_cluster;
+    QCow2SubclusterType type;
+    int start_of_slice;
+    int sc;
+
+    offset_in_cluster = offset_into_cluster(s, offset);
+    bytes_needed = (uint64_t) *bytes + offset_in_cluster;
+    bytes_available =
+        ((uint64_t) (s->l2_slice_size - offset_to_l2_slice_index(s, offset)))
+        << s->cluster_bits;
+    bytes_needed = MIN(bytes_needed, bytes_available);
+
+    l1_index = offset_to_l1_index(s, offset);
+    l2_offset = l1_index < s->l1_size ?
+        s->l1_table[l1_index] & L1E_OFFSET_MASK : 0;
+    if (!l2_offset) {
+        type = QCOW2_SUBCLUSTER_UNALLOCATED_PLAIN;
+        goto out;
+    }
+    if (offset_into_cluster(s, l2_offset)) {
+        return false;
+    }
+
+    start_of_slice = l2_entry_size(s) *
+        (offset_to_l2_index(s, offset) - offset_to_l2_slice_index(s, offset));
+    l2_slice = qcow2_cache_lookup(s->l2_table_cache,
+                                  l2_offset + start_of_slice);
+    if (!l2_slice) {
+        return false;
+    }
+
+    l2_index = offset_to_l2_slice_index(s, offset);
+    sc_index = offset_to_sc_index(s, offset);
+    l2_entry = get_l2_entry(s, l2_slice, l2_index);
+    l2_bitmap = get_l2_bitmap(s, l2_slice, l2_index);
+
+    type = qcow2_get_subcluster_type(bs, l2_entry, l2_bitmap, sc_index);
+    switch (type) {
+    case QCOW2_SUBCLUSTER_ZERO_PLAIN:
+    case QCOW2_SUBCLUSTER_ZERO_ALLOC:
+        if (s->qcow_version < 3) {
+            return false;
+        }
+        break;
+    case QCOW2_SUBCLUSTER_UNALLOCATED_PLAIN:
+    case QCOW2_SUBCLUSTER_UNALLOCATED_ALLOC:
+    case QCOW2_SUBCLUSTER_NORMAL:
+        break;
+    default:
+        /* Compressed and invalid entries are left to the slow path */
+        return false;
+    }
+
+    if (type != QCOW2_SUBCLUSTER_ZERO_PLAIN &&
+        type != QCOW2_SUBCLUSTER_UNALLOCATED_PLAIN) {
+        host_cluster_offset = l2_entry & L2E_OFFSET_MASK;
+        if (offset_into_cluster(s, host_cluster_offset) ||
+            (has_data_file(bs) &&
+             host_cluster_offset != offset - offset_in_cluster)) {
+            return false;
+        }
+    }
+
+    nb_clusters = size_to_clusters(s, bytes_needed);
+    assert(nb_clusters <= INT_MAX);
+
+    sc = count_contiguous_subclusters(bs, nb_clusters, sc_index,
+                                      l2_slice, &l2_index);
+    if (sc < 0) {
+        return false;
+    }
+
+    bytes_available = ((int64_t)sc + sc_index) << s->subcluster_bits;
+
+out:
+    bytes_available = MIN(bytes_available, bytes_needed);
+    assert(bytes_available - offset_in_cluster <= UINT_MAX);
+
+    *bytes = bytes_available - offset_in_cluster;
+    *host_offset = host_cluster_offset ?
+        host_cluster_offset + offset_in_cluster : 0;
+    *subcluster_type = type;
+    return true;
+}
+
 /*
  * get_cluster_table
  *
@@ -1568,6 +1682,7 @@ static int do_alloc_cluster_offset(BlockDriverState *bs, uint64_t guest_offset,
                                    uint64_t *host_offset, uint64_t *nb_clusters)
 {
     BDRVQcow2State *s = bs->opaque;
+    int ret;
 
     trace_qcow2_do_alloc_clusters_offset(qemu_coroutine_self(), guest_offset,
                                          *host_offset, *nb_clusters);
@@ -1579,6 +1694,12 @@ static int do_alloc_cluster_offset(BlockDriverState *bs, uint64_t guest_offset,
         return 0;
     }
 
+    /* Take preallocated clusters if possible */
+    ret = qcow2_cluster_pool_alloc(bs, host_offset, nb_clusters);
+    if (ret != 0) {
+        return ret < 0 ? ret : 0;
+    }
+
     /* Allocate new clusters */
     trace_qcow2_cluster_alloc_phys(qemu_coroutine_self());
     if (*host_offset == INV_OFFSET) {
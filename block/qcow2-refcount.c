@@ -1139,6 +1139,72 @@ int64_t qcow2_alloc_bytes(BlockDriverState *bs, int size)
     return offset;
 }
 
+/*
+ * Allocates up to *nb_clusters host clusters for guest data from the
+ * cluster pool.  The pool is a contiguous range of clusters whose refcount
+ * has already been set to 1, so that allocating writes don't have to update
+ * the refcount blocks every time.  If the pool is empty and @host_offset is
+ * INV_OFFSET, s->cluster_pool_size clusters (or *nb_clusters if that is
+ * more) are allocated with a single refcount update to refill it.  If
+ * *host_offset is not INV_OFFSET, the clusters are only taken if the pool
+ * starts there.
+ *
+ * Clusters that are still in the pool when the image is closed are freed
+ * again; if QEMU crashes, they are leaked.
+ *
+ * Returns 1 if clusters were taken from the pool; *host_offset and
+ * *nb_clusters are then updated (*nb_clusters may be decreased).  Returns 0
+ * if the pool can't be used and the clusters have to be allocated normally,
+ * and -errno if refilling the pool failed.
+ */
+int qcow2_cluster_pool_alloc(BlockDriverState *bs, uint64_t *host_offset,
+                             uint64_t *nb_clusters)
+{
+    BDRVQcow2State *s = bs->opaque;
+
+    if (!s->cluster_pool_size) {
+        return 0;
+    }
+
+    if (*host_offset != INV_OFFSET) {
+        if (!s->cluster_pool_nb || *host_offset != s->cluster_pool_offset) {
+            return 0;
+        }
+    } else if (!s->cluster_pool_nb) {
+        uint64_t nb = MAX(s->cluster_pool_size, *nb_clusters);
+        int64_t offset = qcow2_alloc_clusters(bs, nb << s->cluster_bits);
+
+        if (offset < 0) {
+            return offset;
+        }
+        trace_qcow2_cluster_pool_refill(qemu_coroutine_self(), offset, nb);
+        s->cluster_pool_offset = offset;
+        s->cluster_pool_nb = nb;
+    }
+
+    *nb_clusters = MIN(*nb_clusters, s->cluster_pool_nb);
+    *host_offset = s->cluster_pool_offset;
+    s->cluster_pool_offset += *nb_clusters << s->cluster_bits;
+    s->cluster_pool_nb -= *nb_clusters;
+
+    return 1;
+}
+
+/* Frees the clusters that are left in the cluster pool */
+void qcow2_cluster_pool_release(BlockDriverState *bs)
+{
+    BDRVQcow2State *s = bs->opaque;
+
+    if (!s->cluster_pool_nb) {
+        return;
+    }
+
+    qcow2_free_clusters(bs, s->cluster_pool_offset,
+                        s->cluster_pool_nb << s->cluster_bits,
+                        QCOW2_DISCARD_NEVER);
+    s->cluster_pool_nb = 0;
+}
+
 void qcow2_free_clusters(BlockDriverState *bs,
                           int64_t offset, int64_t size,
                           enum qcow2_discard_type type)
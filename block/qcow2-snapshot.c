@@ -981,6 +981,166 @@ int qcow2_snapshot_delete(BlockDriverState *bs,
     return 0;
 }
 
+/*
+ * Move the VM state that was saved to the active L1 table after the
+ * snapshot 'name' had been taken into that snapshot.
+ *
+ * The snapshot gets a new L1 table that has its own entries for the guest
+ * disk and the active entries for the VM state area.  Referencing the new
+ * table before the snapshot table is updated and dereferencing the old one
+ * afterwards means that a failure at any point only leaks clusters.
+ */
+int qcow2_snapshot_attach_vmstate(BlockDriverState *bs,
+                                  const char *name,
+                                  uint64_t vm_state_size,
+                                  Error **errp)
+{
+    BDRVQcow2State *s = bs->opaque;
+    QCowSnapshot *sn;
+    QCowSnapshot old_sn;
+    uint64_t *l1_table = NULL;
+    int64_t l1_table_offset;
+    int l1_size, snapshot_index, i;
+    int ret;
+
+    if (has_data_file(bs)) {
+        return -ENOTSUP;
+    }
+
+    snapshot_index = find_snapshot_by_id_and_name(bs, NULL, name);
+    if (snapshot_index < 0) {
+        error_setg(errp, "Can't find the snapshot");
+        return -ENOENT;
+    }
+    sn = &s->snapshots[snapshot_index];
+
+    if (sn->vm_state_size) {
+        error_setg(errp, "Snapshot '%s' already has VM state", name);
+        return -EEXIST;
+    }
+    if (sn->disk_size != bs->total_sectors * BDRV_SECTOR_SIZE) {
+        /* The VM state would not be where the snapshot expects it */
+        error_setg(errp, "Image was resized after snapshot '%s'", name);
+        return -EINVAL;
+    }
+
+    ret = qcow2_validate_table(bs, sn->l1_table_offset, sn->l1_size,
+                               L1E_SIZE, QCOW_MAX_L1_SIZE,
+                               "Snapshot L1 table", errp);
+    if (ret < 0) {
+        return ret;
+    }
+
+    l1_size = MAX(sn->l1_size, s->l1_size);
+    l1_table = g_try_new0(uint64_t, l1_size);
+    if (l1_size && l1_table == NULL) {
+        error_setg(errp, "Failed to allocate the snapshot L1 table");
+        return -ENOMEM;
+    }
+
+    ret = bdrv_pread(bs->file, sn->l1_table_offset, l1_table,
+                     sn->l1_size * L1E_SIZE);
+    if (ret < 0) {
+        error_setg_errno(errp, -ret, "Failed to read the snapshot L1 table");
+        goto fail;
+    }
+
+    for (i = s->l1_vm_state_index; i < l1_size; i++) {
+        l1_table[i] = i < s->l1_size ? cpu_to_be64(s->l1_table[i]) : 0;
+    }
+
+    l1_table_offset = qcow2_alloc_clusters(bs, l1_size * L1E_SIZE);
+    if (l1_table_offset < 0) {
+        ret = l1_table_offset;
+        error_setg_errno(errp, -ret, "Failed to allocate the L1 table");
+        goto fail;
+    }
+
+    ret = qcow2_pre_write_overlap_check(bs, 0, l1_table_offset,
+                                        l1_size * L1E_SIZE, false);
+    if (ret < 0) {
+        error_setg_errno(errp, -ret, "Failed to write the L1 table");
+        goto fail_free_l1;
+    }
+
+    ret = bdrv_pwrite(bs->file, l1_table_offset, l1_table,
+                      l1_size * L1E_SIZE);
+    if (ret < 0) {
+        error_setg_errno(errp, -ret, "Failed to write the L1 table");
+        goto fail_free_l1;
+    }
+
+    ret = qcow2_update_snapshot_refcount(bs, l1_table_offset, l1_size, 1);
+    if (ret < 0) {
+        error_setg_errno(errp, -ret, "Failed to update the refcounts");
+        goto fail_free_l1;
+    }
+
+    /* The VM state is shared with the snapshot now */
+    ret = qcow2_update_snapshot_refcount(bs, s->l1_table_offset,
+                                         s->l1_size, 0);
+    if (ret < 0) {
+        error_setg_errno(errp, -ret, "Failed to update the refcounts");
+        goto fail_unref;
+    }
+
+    old_sn = *sn;
+    sn->l1_table_offset = l1_table_offset;
+    sn->l1_size = l1_size;
+    sn->vm_state_size = vm_state_size;
+
+    ret = qcow2_write_snapshots(bs);
+    if (ret < 0) {
+        *sn = old_sn;
+        error_setg_errno(errp, -ret, "Failed to update the snapshot table");
+        goto fail_unref;
+    }
+
+    g_free(l1_table);
+    l1_table = NULL;
+
+    /* If we fail after this point, we won't recover but just leak clusters */
+    ret = qcow2_update_snapshot_refcount(bs, old_sn.l1_table_offset,
+                                         old_sn.l1_size, -1);
+    if (ret < 0) {
+        error_setg_errno(errp, -ret, "Failed to free the old L1 table");
+        return ret;
+    }
+    qcow2_free_clusters(bs, old_sn.l1_table_offset,
+                        old_sn.l1_size * L1E_SIZE, QCOW2_DISCARD_SNAPSHOT);
+
+    /* As in qcow2_snapshot_create(), drop the VM state from the active table */
+    qcow2_cluster_discard(bs, qcow2_vm_state_offset(s),
+                          ROUND_UP(vm_state_size, s->cluster_size),
+                          QCOW2_DISCARD_NEVER, false);
+
+    /* must update the copied flag on the current cluster offsets */
+    ret = qcow2_update_snapshot_refcount(bs, s->l1_table_offset, s->l1_size, 0);
+    if (ret < 0) {
+        error_setg_errno(errp, -ret,
+                         "Failed to update snapshot status in disk");
+        return ret;
+    }
+
+#ifdef DEBUG_ALLOC
+    {
+        BdrvCheckResult result = {0};
+        qcow2_check_refcounts(bs, &result, 0);
+    }
+#endif
+    return 0;
+
+fail_unref:
+    qcow2_update_snapshot_refcount(bs, l1_table_offset, l1_size, -1);
+    qcow2_update_snapshot_refcount(bs, s->l1_table_offset, s->l1_size, 0);
+fail_free_l1:
+    qcow2_free_clusters(bs, l1_table_offset, l1_size * L1E_SIZE,
+                        QCOW2_DISCARD_ALWAYS);
+fail:
+    g_free(l1_table);
+    return ret;
+}
+
 int qcow2_snapshot_list(BlockDriverState *bs, QEMUSnapshotInfo **psn_tab)
 {
     BDRVQcow2State *s = bs->opaque;
@@ -34,24 +34,33 @@
 #endif
 
 #include "qcow2.h"
+#include "block/aio_task.h"
 #include "block/thread-pool.h"
 #include "crypto.h"
 
+/*
+ * Run @func in the image's own thread pool, so that CPU intensive work does
+ * not compete with the I/O of other nodes for the threads of the AioContext.
+ * At most @max_threads tasks of this image run at the same time.
+ */
 static int coroutine_fn
-qcow2_co_process(BlockDriverState *bs, ThreadPoolFunc *func, void *arg)
+qcow2_co_process(BlockDriverState *bs, ThreadPoolFunc *func, void *arg,
+                 int max_threads)
 {
     int ret;
     BDRVQcow2State *s = bs->opaque;
-    ThreadPool *pool = aio_get_thread_pool(bdrv_get_aio_context(bs));
 
     qemu_co_mutex_lock(&s->lock);
-    while (s->nb_threads >= QCOW2_MAX_THREADS) {
+    while (s->nb_threads >= max_threads) {
         qemu_co_queue_wait(&s->thread_task_queue, &s->lock);
     }
     s->nb_threads++;
+    if (!s->thread_pool) {
+        s->thread_pool = thread_pool_new(bdrv_get_aio_context(bs));
+    }
     qemu_co_mutex_unlock(&s->lock);
 
-    ret = thread_pool_submit_co(pool, func, arg);
+    ret = thread_pool_submit_co(s->thread_pool, func, arg);
 
     qemu_co_mutex_lock(&s->lock);
     s->nb_threads--;
@@ -339,6 +348,7 @@ static ssize_t coroutine_fn
 qcow2_co_do_compress(BlockDriverState *bs, void *dest, size_t dest_size,
                      const void *src, size_t src_size, Qcow2CompressFunc func)
 {
+    BDRVQcow2State *s = bs->opaque;
     Qcow2CompressData arg = {
         .dest = dest,
         .dest_size = dest_size,
@@ -347,7 +357,7 @@ qcow2_co_do_compress(BlockDriverState *bs, void *dest, size_t dest_size,
         .func = func,
     };
 
-    qcow2_co_process(bs, qcow2_compress_pool_func, &arg);
+    qcow2_co_process(bs, qcow2_compress_pool_func, &arg, s->compress_threads);
 
     return arg.ret;
 }
@@ -453,6 +463,64 @@ static int qcow2_encdec_pool_func(void *opaque)
     return data->func(data->block, data->offset, data->buf, data->len, NULL);
 }
 
+/*
+ * Requests of at least QCOW2_MAX_THREADS times this size have their
+ * encryption split over all the ciphers of the image.
+ */
+#define QCOW2_CRYPT_SPLIT_MIN (64 * KiB)
+
+typedef struct Qcow2EncDecTask {
+    AioTask task;
+
+    BlockDriverState *bs;
+    Qcow2EncDecData data;
+} Qcow2EncDecTask;
+
+static int coroutine_fn qcow2_co_encdec_task_entry(AioTask *task)
+{
+    Qcow2EncDecTask *t = container_of(task, Qcow2EncDecTask, task);
+
+    return qcow2_co_process(t->bs, qcow2_encdec_pool_func, &t->data,
+                            QCOW2_MAX_THREADS);
+}
+
+/*
+ * Each sector is encrypted on its own, so a large request can be cut
+ * at sector boundaries into one part per cipher, processed in parallel.
+ */
+static int coroutine_fn
+qcow2_co_encdec_split(BlockDriverState *bs, const Qcow2EncDecData *arg,
+                      uint64_t sector_size)
+{
+    AioTaskPool *aio = aio_task_pool_new(QCOW2_MAX_THREADS);
+    size_t part = ROUND_UP(DIV_ROUND_UP(arg->len, QCOW2_MAX_THREADS),
+                           sector_size);
+    size_t done = 0;
+    int ret;
+
+    while (done < arg->len && aio_task_pool_status(aio) == 0) {
+        Qcow2EncDecTask *t = g_new(Qcow2EncDecTask, 1);
+
+        *t = (Qcow2EncDecTask) {
+            .task.func = qcow2_co_encdec_task_entry,
+            .bs = bs,
+            .data = *arg,
+        };
+        t->data.offset += done;
+        t->data.buf += done;
+        t->data.len = MIN(part, arg->len - done);
+        aio_task_pool_start_task(aio, &t->task);
+
+        done += t->data.len;
+    }
+
+    aio_task_pool_wait_all(aio);
+    ret = aio_task_pool_status(aio);
+    g_free(aio);
+
+    return ret;
+}
+
 static int coroutine_fn
 qcow2_co_encdec(BlockDriverState *bs, uint64_t host_offset,
                 uint64_t guest_offset, void *buf, size_t len,
@@ -475,7 +543,17 @@ qcow2_co_encdec(BlockDriverState *bs, uint64_t host_offset,
     assert(QEMU_IS_ALIGNED(host_offset, sector_size));
     assert(QEMU_IS_ALIGNED(len, sector_size));
 
-    return len == 0 ? 0 : qcow2_co_process(bs, qcow2_encdec_pool_func, &arg);
+    if (len == 0) {
+        return 0;
+    }
+
+    if (len >= QCOW2_MAX_THREADS * QCOW2_CRYPT_SPLIT_MIN) {
+        return qcow2_co_encdec_split(bs, &arg, sector_size);
+    }
+
+    /* There are only QCOW2_MAX_THREADS ciphers, see qcrypto_block_open() */
+    return qcow2_co_process(bs, qcow2_encdec_pool_func, &arg,
+                            QCOW2_MAX_THREADS);
 }
 
 /*
@@ -525,3 +603,51 @@ qcow2_co_decrypt(BlockDriverState *bs, uint64_t host_offset,
     return qcow2_co_encdec(bs, host_offset, guest_offset, buf, len,
                            qcrypto_block_decrypt);
 }
+
+/*
+ * Encrypted I/O needs a bounce buffer, so that neither the guest sees
+ * the cipher text nor the cipher sees guest memory changing under it.
+ * The buffers of an image are recycled instead of allocated for every
+ * request; all of them have qcow2_crypt_buf_size() bytes, larger ones
+ * are allocated and freed as needed.
+ */
+static size_t qcow2_crypt_buf_size(BDRVQcow2State *s)
+{
+    return MIN((size_t)QCOW_MAX_CRYPT_CLUSTERS * s->cluster_size,
+               QCOW2_CRYPT_BUF_MAX_SIZE);
+}
+
+void *qcow2_crypt_buf_get(BlockDriverState *bs, size_t len)
+{
+    BDRVQcow2State *s = bs->opaque;
+    size_t size = qcow2_crypt_buf_size(s);
+
+    if (len > size) {
+        return qemu_try_blockalign(s->data_file->bs, len);
+    }
+    if (s->nb_crypt_bufs) {
+        return s->crypt_bufs[--s->nb_crypt_bufs];
+    }
+    return qemu_try_blockalign(s->data_file->bs, size);
+}
+
+void qcow2_crypt_buf_put(BlockDriverState *bs, void *buf, size_t len)
+{
+    BDRVQcow2State *s = bs->opaque;
+
+    if (buf && len <= qcow2_crypt_buf_size(s) &&
+        s->nb_crypt_bufs < QCOW2_MAX_CRYPT_BUFS) {
+        s->crypt_bufs[s->nb_crypt_bufs++] = buf;
+    } else {
+        qemu_vfree(buf);
+    }
+}
+
+void qcow2_crypt_bufs_free(BlockDriverState *bs)
+{
+    BDRVQcow2State *s = bs->opaque;
+
+    while (s->nb_crypt_bufs) {
+        qemu_vfree(s->crypt_bufs[--s->nb_crypt_bufs]);
+    }
+}
@@ -79,6 +79,7 @@ qcow2_co_preadv_compressed(BlockDriverState *bs,
                            uint64_t bytes,
                            QEMUIOVector *qiov,
                            size_t qiov_offset);
+static void qcow2_free_decompressed_clusters(BDRVQcow2State *s);
 
 static int qcow2_probe(const uint8_t *buf, int buf_size, const char *filename)
 {
@@ -697,6 +698,10 @@ static const char *const mutable_opts[] = {
     QCOW2_OPT_L2_CACHE_ENTRY_SIZE,
     QCOW2_OPT_REFCOUNT_CACHE_SIZE,
     QCOW2_OPT_CACHE_CLEAN_INTERVAL,
+    QCOW2_OPT_CLUSTER_POOL_SIZE,
+    QCOW2_OPT_COMPRESS_THREADS,
+    QCOW2_OPT_COMPRESS_READAHEAD,
+    QCOW2_OPT_L2_PREFETCH,
     NULL
 };
 
@@ -808,6 +813,28 @@ static QemuOptsList qcow2_runtime_opts = {
             .type = QEMU_OPT_NUMBER,
             .help = "Clean unused cache entries after this time (in seconds)",
         },
+        {
+            .name = QCOW2_OPT_CLUSTER_POOL_SIZE,
+            .type = QEMU_OPT_SIZE,
+            .help = "Host space to allocate ahead of time for guest data",
+        },
+        {
+            .name = QCOW2_OPT_COMPRESS_THREADS,
+            .type = QEMU_OPT_NUMBER,
+            .help = "Maximum number of threads for (de)compression",
+        },
+        {
+            .name = QCOW2_OPT_COMPRESS_READAHEAD,
+            .type = QEMU_OPT_NUMBER,
+            .help = "Number of compressed clusters to decompress ahead "
+                    "of sequential reads",
+        },
+        {
+            .name = QCOW2_OPT_L2_PREFETCH,
+            .type = QEMU_OPT_BOOL,
+            .help = "Load the L2 tables into the cache in the background "
+                    "after opening the image",
+        },
         BLOCK_CRYPTO_OPT_DEF_KEY_SECRET("encrypt.",
             "ID of secret providing qcow2 AES key or LUKS passphrase"),
         { /* end of list */ }
@@ -860,7 +887,14 @@ static void cache_clean_timer_del(BlockDriverState *bs)
 
 static void qcow2_detach_aio_context(BlockDriverState *bs)
 {
+    BDRVQcow2State *s = bs->opaque;
+
     cache_clean_timer_del(bs);
+
+    /* Created again in the new AioContext when it is needed */
+    thread_pool_free(s->thread_pool);
+    s->thread_pool = NULL;
+    qcow2_crypt_bufs_free(bs);
 }
 
 static void qcow2_attach_aio_context(BlockDriverState *bs,
@@ -969,6 +1003,10 @@ typedef struct Qcow2ReopenState {
     int overlap_check;
     bool discard_passthrough[QCOW2_DISCARD_MAX];
     uint64_t cache_clean_interval;
+    uint64_t cluster_pool_size;
+    int compress_threads;
+    int compress_readahead;
+    bool l2_prefetch;
     QCryptoBlockOpenOptions *crypto_opts; /* Disk encryption runtime options */
 } Qcow2ReopenState;
 
@@ -1023,6 +1061,9 @@ static int qcow2_update_options_prepare(BlockDriverState *bs,
         goto fail;
     }
 
+    /* The pool is refilled with the new settings when it is needed again */
+    qcow2_cluster_pool_release(bs);
+
     /* alloc new L2 table/refcount block cache, flush old one */
     if (s->l2_table_cache) {
         ret = qcow2_cache_flush(bs, s->l2_table_cache);
@@ -1070,6 +1111,37 @@ static int qcow2_update_options_prepare(BlockDriverState *bs,
         goto fail;
     }
 
+    r->cluster_pool_size =
+        DIV_ROUND_UP(qemu_opt_get_size(opts, QCOW2_OPT_CLUSTER_POOL_SIZE, 0),
+                     s->cluster_size);
+    if (r->cluster_pool_size > BDRV_REQUEST_MAX_BYTES >> s->cluster_bits) {
+        error_setg(errp, "Cluster pool size too big");
+        ret = -EINVAL;
+        goto fail;
+    }
+
+    r->compress_threads = qemu_opt_get_number(opts, QCOW2_OPT_COMPRESS_THREADS,
+                                              QCOW2_MAX_THREADS);
+    if (r->compress_threads < 1 ||
+        r->compress_threads > QCOW2_MAX_COMPRESS_THREADS) {
+        error_setg(errp, QCOW2_OPT_COMPRESS_THREADS " must be between 1 and %d",
+                   QCOW2_MAX_COMPRESS_THREADS);
+        ret = -EINVAL;
+        goto fail;
+    }
+
+    r->l2_prefetch = qemu_opt_get_bool(opts, QCOW2_OPT_L2_PREFETCH, false);
+
+    r->compress_readahead =
+        qemu_opt_get_number(opts, QCOW2_OPT_COMPRESS_READAHEAD, 0);
+    if (r->compress_readahead < 0 ||
+        r->compress_readahead > QCOW2_MAX_COMPRESS_THREADS) {
+        error_setg(errp, QCOW2_OPT_COMPRESS_READAHEAD
+                   " must be between 0 and %d", QCOW2_MAX_COMPRESS_THREADS);
+        ret = -EINVAL;
+        goto fail;
+    }
+
     /* lazy-refcounts; flush if going from enabled to disabled */
     r->use_lazy_refcounts = qemu_opt_get_bool(opts, QCOW2_OPT_LAZY_REFCOUNTS,
         (s->compatible_features & QCOW2_COMPAT_LAZY_REFCOUNTS));
@@ -1212,8 +1284,20 @@ static void qcow2_update_options_commit(BlockDriverState *bs,
     s->refcount_block_cache = r->refcount_block_cache;
     s->l2_slice_size = r->l2_slice_size;
 
+    /* The new cache is empty; prefetch again after the reopen */
+    s->l2_prefetch_index = 0;
+    s->l2_prefetch_slices = 0;
+
     s->overlap_check = r->overlap_check;
     s->use_lazy_refcounts = r->use_lazy_refcounts;
+    s->cluster_pool_size = r->cluster_pool_size;
+    s->compress_threads = r->compress_threads;
+    s->l2_prefetch = r->l2_prefetch;
+
+    if (s->compress_readahead != r->compress_readahead) {
+        qcow2_free_decompressed_clusters(s);
+        s->compress_readahead = r->compress_readahead;
+    }
 
     for (i = 0; i < QCOW2_DISCARD_MAX; i++) {
         s->discard_passthrough[i] = r->discard_passthrough[i];
@@ -1293,6 +1377,111 @@ static int validate_compression_type(BDRVQcow2State *s, Error **errp)
     return 0;
 }
 
+/*
+ * Loads the L2 tables referenced by the L1 table into the L2 cache, in L1
+ * order, until the cache is full.  This runs in the background so that the
+ * first access to each region of a big image doesn't have to wait for a
+ * metadata read.  Guest requests are preferred: s->lock is only held while
+ * a single slice is read, and the coroutine yields after each slice.
+ *
+ * The prefetch counts as a request in flight; it stops when the node is
+ * drained and continues where it left off afterwards.
+ */
+static void coroutine_fn qcow2_co_l2_prefetch_entry(void *opaque)
+{
+    BlockDriverState *bs = opaque;
+    BDRVQcow2State *s = bs->opaque;
+    int max_slices = qcow2_cache_get_num_tables(s->l2_table_cache);
+    int slices_per_table = s->cluster_size /
+                           (s->l2_slice_size * l2_entry_size(s));
+    int ret = 0;
+
+    while (!s->l2_prefetch_stop && ret >= 0 &&
+           !(bs->open_flags & BDRV_O_INACTIVE) &&
+           s->l2_prefetch_index < s->l1_size &&
+           s->l2_prefetch_slices < max_slices)
+    {
+        uint64_t l2_offset =
+            s->l1_table[s->l2_prefetch_index] & L1E_OFFSET_MASK;
+        int i;
+
+        for (i = 0; l2_offset && !offset_into_cluster(s, l2_offset) &&
+                    i < slices_per_table && !s->l2_prefetch_stop; i++)
+        {
+            uint64_t slice_offset =
+                l2_offset + (uint64_t) i * s->l2_slice_size * l2_entry_size(s);
+            uint64_t *l2_slice;
+
+            qemu_co_mutex_lock(&s->lock);
+            ret = qcow2_cache_get(bs, s->l2_table_cache, slice_offset,
+                                  (void **) &l2_slice);
+            if (ret == 0) {
+                qcow2_cache_put(s->l2_table_cache, (void **) &l2_slice);
+            }
+            qemu_co_mutex_unlock(&s->lock);
+            if (ret < 0) {
+                break;
+            }
+
+            if (++s->l2_prefetch_slices >= max_slices) {
+                break;
+            }
+
+            /* Let guest requests run first */
+            aio_co_schedule(bdrv_get_aio_context(bs), qemu_coroutine_self());
+            qemu_coroutine_yield();
+        }
+
+        /* An interrupted table is loaded again from its start */
+        if (!s->l2_prefetch_stop) {
+            s->l2_prefetch_index++;
+        }
+    }
+
+    if (ret < 0) {
+        /* Errors are reported when the guest accesses the image */
+        s->l2_prefetch_index = s->l1_size;
+    }
+
+    s->l2_prefetch_running = false;
+    bdrv_dec_in_flight(bs);
+}
+
+static void qcow2_start_l2_prefetch(BlockDriverState *bs)
+{
+    BDRVQcow2State *s = bs->opaque;
+    Coroutine *co;
+
+    if (!s->l2_prefetch || s->l2_prefetch_running ||
+        ((s->flags | bs->open_flags) & BDRV_O_INACTIVE) ||
+        s->l2_prefetch_index >= s->l1_size ||
+        s->l2_prefetch_slices >= qcow2_cache_get_num_tables(s->l2_table_cache))
+    {
+        return;
+    }
+
+    s->l2_prefetch_running = true;
+    s->l2_prefetch_stop = false;
+    bdrv_inc_in_flight(bs);
+    co = qemu_coroutine_create(qcow2_co_l2_prefetch_entry, bs);
+    aio_co_enter(bdrv_get_aio_context(bs), co);
+}
+
+static void coroutine_fn qcow2_co_drain_begin(BlockDriverState *bs)
+{
+    BDRVQcow2State *s = bs->opaque;
+
+    s->l2_prefetch_stop = true;
+}
+
+static void coroutine_fn qcow2_co_drain_end(BlockDriverState *bs)
+{
+    /* The counter is only decremented after this callback */
+    if (bs->quiesce_counter == 1) {
+        qcow2_start_l2_prefetch(bs);
+    }
+}
+
 /* Called with s->lock held.  */
 static int coroutine_fn qcow2_do_open(BlockDriverState *bs, QDict *options,
                                       int flags, Error **errp)
@@ -1835,6 +2024,10 @@ static int coroutine_fn qcow2_do_open(BlockDriverState *bs, QDict *options,
 
     qemu_co_queue_init(&s->thread_task_queue);
 
+    if (!bs->quiesce_counter) {
+        qcow2_start_l2_prefetch(bs);
+    }
+
     return ret;
 
  fail:
@@ -2148,7 +2341,7 @@ qcow2_co_preadv_encrypted(BlockDriverState *bs,
      * encrypted nature of the virtual disk.
      */
 
-    buf = qemu_try_blockalign(s->data_file->bs, bytes);
+    buf = qcow2_crypt_buf_get(bs, bytes);
     if (buf == NULL) {
         return -ENOMEM;
     }
@@ -2167,7 +2360,7 @@ qcow2_co_preadv_encrypted(BlockDriverState *bs,
     qemu_iovec_from_buf(qiov, qiov_offset, buf, bytes);
 
 fail:
-    qemu_vfree(buf);
+    qcow2_crypt_buf_put(bs, buf, bytes);
 
     return ret;
 }
@@ -2301,12 +2494,19 @@ static coroutine_fn int qcow2_co_preadv_part(BlockDriverState *bs,
                             QCOW_MAX_CRYPT_CLUSTERS * s->cluster_size);
         }
 
-        qemu_co_mutex_lock(&s->lock);
-        ret = qcow2_get_host_offset(bs, offset, &cur_bytes,
-                                    &host_offset, &type);
-        qemu_co_mutex_unlock(&s->lock);
-        if (ret < 0) {
-            goto out;
+        /*
+         * Most reads can be resolved from the L2 cache without waiting for
+         * allocating writers that hold s->lock across their metadata I/O.
+         */
+        if (!qcow2_get_host_offset_cached(bs, offset, &cur_bytes,
+                                          &host_offset, &type)) {
+            qemu_co_mutex_lock(&s->lock);
+            ret = qcow2_get_host_offset(bs, offset, &cur_bytes,
+                                        &host_offset, &type);
+            qemu_co_mutex_unlock(&s->lock);
+            if (ret < 0) {
+                goto out;
+            }
         }
 
         if (type == QCOW2_SUBCLUSTER_ZERO_PLAIN ||
@@ -2500,7 +2700,7 @@ static coroutine_fn int qcow2_co_pwritev_task(BlockDriverState *bs,
     if (bs->encrypted) {
         assert(s->crypto);
         assert(bytes <= QCOW_MAX_CRYPT_CLUSTERS * s->cluster_size);
-        crypt_buf = qemu_try_blockalign(bs->file->bs, bytes);
+        crypt_buf = qcow2_crypt_buf_get(bs, bytes);
         if (crypt_buf == NULL) {
             ret = -ENOMEM;
             goto out_unlocked;
@@ -2551,7 +2751,7 @@ out_locked:
     qcow2_handle_l2meta(bs, &l2meta, false);
     qemu_co_mutex_unlock(&s->lock);
 
-    qemu_vfree(crypt_buf);
+    qcow2_crypt_buf_put(bs, crypt_buf, bytes);
 
     return ret;
 }
@@ -2663,6 +2863,8 @@ static int qcow2_inactivate(BlockDriverState *bs)
                           bdrv_get_device_or_node_name(bs));
     }
 
+    qcow2_cluster_pool_release(bs);
+
     ret = qcow2_cache_flush(bs, s->l2_table_cache);
     if (ret) {
         result = ret;
@@ -2699,6 +2901,11 @@ static void qcow2_close(BlockDriverState *bs)
     qcow2_cache_destroy(s->l2_table_cache);
     qcow2_cache_destroy(s->refcount_block_cache);
 
+    thread_pool_free(s->thread_pool);
+    s->thread_pool = NULL;
+    qcow2_crypt_bufs_free(bs);
+    qcow2_free_decompressed_clusters(s);
+
     qcrypto_block_free(s->crypto);
     s->crypto = NULL;
     qapi_free_QCryptoBlockOpenOptions(s->crypto_opts);
@@ -4200,6 +4407,9 @@ static int coroutine_fn qcow2_co_truncate(BlockDriverState *bs, int64_t offset,
             goto fail;
         }
 
+        /* Don't keep clusters allocated that would prevent shrinking */
+        qcow2_cluster_pool_release(bs);
+
         ret = qcow2_cluster_discard(bs, ROUND_UP(offset, s->cluster_size),
                                     old_length - ROUND_UP(offset,
                                                           s->cluster_size),
@@ -4560,6 +4770,8 @@ qcow2_co_pwritev_compressed_task(BlockDriverState *bs,
     }
 
     qemu_co_mutex_lock(&s->lock);
+    /* The new cluster may reuse the descriptor of a freed one */
+    s->decompressed_generation++;
     ret = qcow2_alloc_compressed_cluster_offset(bs, offset, out_len,
                                                 &cluster_offset);
     if (ret < 0) {
@@ -4663,19 +4875,98 @@ qcow2_co_pwritev_compressed_part(BlockDriverState *bs,
     return ret;
 }
 
+static void qcow2_free_decompressed_clusters(BDRVQcow2State *s)
+{
+    int i;
+
+    if (!s->decompressed_clusters) {
+        return;
+    }
+
+    for (i = 0; i < 2 * s->compress_readahead; i++) {
+        assert(!s->decompressed_clusters[i].loading);
+        g_free(s->decompressed_clusters[i].data);
+    }
+    g_free(s->decompressed_clusters);
+    s->decompressed_clusters = NULL;
+    s->decompressed_next = 0;
+}
+
+static Qcow2DecompressedCluster *
+qcow2_find_decompressed_cluster(BDRVQcow2State *s, uint64_t cluster_descriptor)
+{
+    int i;
+
+    if (!s->decompressed_clusters) {
+        return NULL;
+    }
+
+    for (i = 0; i < 2 * s->compress_readahead; i++) {
+        Qcow2DecompressedCluster *dc = &s->decompressed_clusters[i];
+        if (dc->cluster_descriptor == cluster_descriptor &&
+            dc->generation == s->decompressed_generation) {
+            return dc;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Returns an entry for @cluster_descriptor that the caller can decompress
+ * the cluster into, marked as loading.  The oldest entry that is not being
+ * loaded is reused.  Returns NULL if read-ahead is disabled or no entry is
+ * available.
+ */
+static Qcow2DecompressedCluster *
+qcow2_alloc_decompressed_cluster(BDRVQcow2State *s,
+                                 uint64_t cluster_descriptor)
+{
+    int n = 2 * s->compress_readahead;
+    int i;
+
+    if (!n) {
+        return NULL;
+    }
+
+    if (!s->decompressed_clusters) {
+        s->decompressed_clusters = g_new0(Qcow2DecompressedCluster, n);
+        for (i = 0; i < n; i++) {
+            qemu_co_queue_init(&s->decompressed_clusters[i].waiters);
+        }
+    }
+
+    for (i = 0; i < n; i++) {
+        Qcow2DecompressedCluster *dc =
+            &s->decompressed_clusters[s->decompressed_next];
+
+        s->decompressed_next = (s->decompressed_next + 1) % n;
+        if (dc->loading) {
+            continue;
+        }
+        if (!dc->data) {
+            dc->data = g_try_malloc(s->cluster_size);
+            if (!dc->data) {
+                return NULL;
+            }
+        }
+        dc->cluster_descriptor = cluster_descriptor;
+        dc->generation = s->decompressed_generation;
+        dc->loading = true;
+        return dc;
+    }
+    return NULL;
+}
+
+/* Reads and decompresses a whole compressed cluster into @out_buf */
 static int coroutine_fn
-qcow2_co_preadv_compressed(BlockDriverState *bs,
-                           uint64_t cluster_descriptor,
-                           uint64_t offset,
-                           uint64_t bytes,
-                           QEMUIOVector *qiov,
-                           size_t qiov_offset)
+qcow2_co_read_compressed_cluster(BlockDriverState *bs,
+                                 uint64_t cluster_descriptor,
+                                 uint8_t *out_buf)
 {
     BDRVQcow2State *s = bs->opaque;
     int ret = 0, csize, nb_csectors;
     uint64_t coffset;
-    uint8_t *buf, *out_buf;
-    int offset_in_cluster = offset_into_cluster(s, offset);
+    uint8_t *buf;
 
     coffset = cluster_descriptor & s->cluster_offset_mask;
     nb_csectors = ((cluster_descriptor >> s->csize_shift) & s->csize_mask) + 1;
@@ -4687,8 +4978,6 @@ qcow2_co_preadv_compressed(BlockDriverState *bs,
         return -ENOMEM;
     }
 
-    out_buf = qemu_blockalign(bs, s->cluster_size);
-
     BLKDBG_EVENT(bs->file, BLKDBG_READ_COMPRESSED);
     ret = bdrv_co_pread(bs->file, coffset, csize, buf, 0);
     if (ret < 0) {
@@ -4700,15 +4989,155 @@ qcow2_co_preadv_compressed(BlockDriverState *bs,
         goto fail;
     }
 
-    qemu_iovec_from_buf(qiov, qiov_offset, out_buf + offset_in_cluster, bytes);
-
 fail:
-    qemu_vfree(out_buf);
     g_free(buf);
 
     return ret;
 }
 
+/*
+ * Decompresses @cluster_descriptor into @dc, which must come from
+ * qcow2_alloc_decompressed_cluster(), and wakes up waiting requests.
+ */
+static int coroutine_fn
+qcow2_co_load_decompressed_cluster(BlockDriverState *bs,
+                                   Qcow2DecompressedCluster *dc,
+                                   uint64_t cluster_descriptor)
+{
+    int ret;
+
+    ret = qcow2_co_read_compressed_cluster(bs, cluster_descriptor, dc->data);
+    dc->loading = false;
+    if (ret < 0) {
+        dc->cluster_descriptor = 0;
+    }
+    qemu_co_queue_restart_all(&dc->waiters);
+
+    return ret;
+}
+
+typedef struct Qcow2CompressedReadahead {
+    BlockDriverState *bs;
+    uint64_t offset;
+} Qcow2CompressedReadahead;
+
+static void coroutine_fn qcow2_co_compressed_readahead_entry(void *opaque)
+{
+    Qcow2CompressedReadahead *ra = opaque;
+    BlockDriverState *bs = ra->bs;
+    BDRVQcow2State *s = bs->opaque;
+    unsigned int bytes = s->cluster_size;
+    uint64_t cluster_descriptor;
+    QCow2SubclusterType type;
+    Qcow2DecompressedCluster *dc;
+    int ret;
+
+    qemu_co_mutex_lock(&s->lock);
+    ret = qcow2_get_host_offset(bs, ra->offset, &bytes, &cluster_descriptor,
+                                &type);
+    qemu_co_mutex_unlock(&s->lock);
+
+    if (ret == 0 && type == QCOW2_SUBCLUSTER_COMPRESSED &&
+        !qcow2_find_decompressed_cluster(s, cluster_descriptor))
+    {
+        dc = qcow2_alloc_decompressed_cluster(s, cluster_descriptor);
+        if (dc) {
+            /* Errors are reported when the guest actually reads the data */
+            qcow2_co_load_decompressed_cluster(bs, dc, cluster_descriptor);
+        }
+    }
+
+    g_free(ra);
+    bdrv_dec_in_flight(bs);
+}
+
+/*
+ * Starts decompressing the clusters following @offset in the background, so
+ * that the next compress_readahead clusters of a sequential stream are
+ * decompressed in parallel before the guest asks for them.
+ */
+static void qcow2_compressed_readahead(BlockDriverState *bs, uint64_t offset)
+{
+    BDRVQcow2State *s = bs->opaque;
+    uint64_t end = MIN(offset + (uint64_t) s->compress_readahead *
+                       s->cluster_size, bs->total_sectors * BDRV_SECTOR_SIZE);
+    uint64_t start = offset;
+
+    /* Don't start read-ahead again for clusters that were covered already */
+    if (s->compressed_ra_end >= offset && s->compressed_ra_end <= end) {
+        start = s->compressed_ra_end;
+    }
+
+    for (; start < end; start += s->cluster_size) {
+        Qcow2CompressedReadahead *ra = g_new(Qcow2CompressedReadahead, 1);
+        Coroutine *co;
+
+        *ra = (Qcow2CompressedReadahead) {
+            .bs = bs,
+            .offset = start,
+        };
+        bdrv_inc_in_flight(bs);
+        co = qemu_coroutine_create(qcow2_co_compressed_readahead_entry, ra);
+        aio_co_enter(bdrv_get_aio_context(bs), co);
+    }
+    s->compressed_ra_end = MAX(end, offset);
+}
+
+static int coroutine_fn
+qcow2_co_preadv_compressed(BlockDriverState *bs,
+                           uint64_t cluster_descriptor,
+                           uint64_t offset,
+                           uint64_t bytes,
+                           QEMUIOVector *qiov,
+                           size_t qiov_offset)
+{
+    BDRVQcow2State *s = bs->opaque;
+    int ret = 0;
+    uint8_t *out_buf;
+    uint64_t cluster_offset = start_of_cluster(s, offset);
+    int offset_in_cluster = offset_into_cluster(s, offset);
+    Qcow2DecompressedCluster *dc;
+
+    if (s->compress_readahead) {
+        if (cluster_offset == s->compressed_ra_next) {
+            qcow2_compressed_readahead(bs, cluster_offset + s->cluster_size);
+        }
+        s->compressed_ra_next = cluster_offset + s->cluster_size;
+    }
+
+    /* The cluster may have been decompressed already, or is in progress */
+    while ((dc = qcow2_find_decompressed_cluster(s, cluster_descriptor))) {
+        if (!dc->loading) {
+            qemu_iovec_from_buf(qiov, qiov_offset,
+                                dc->data + offset_in_cluster, bytes);
+            return 0;
+        }
+        qemu_co_queue_wait(&dc->waiters, NULL);
+    }
+
+    dc = qcow2_alloc_decompressed_cluster(s, cluster_descriptor);
+    if (dc) {
+        ret = qcow2_co_load_decompressed_cluster(bs, dc, cluster_descriptor);
+        if (ret == 0) {
+            qemu_iovec_from_buf(qiov, qiov_offset,
+                                dc->data + offset_in_cluster, bytes);
+        }
+        return ret;
+    }
+
+    out_buf = qemu_blockalign(bs, s->cluster_size);
+
+    ret = qcow2_co_read_compressed_cluster(bs, cluster_descriptor, out_buf);
+    if (ret == 0) {
+        qemu_iovec_from_buf(qiov, qiov_offset, out_buf + offset_in_cluster,
+                            bytes);
+    }
+
+    qemu_vfree(out_buf);
+
+    return ret;
+}
+
 static int make_completely_empty(BlockDriverState *bs)
 {
     BDRVQcow2State *s = bs->opaque;
@@ -5936,6 +6365,7 @@ BlockDriver bdrv_qcow2 = {
     .bdrv_snapshot_create   = qcow2_snapshot_create,
     .bdrv_snapshot_goto     = qcow2_snapshot_goto,
     .bdrv_snapshot_delete   = qcow2_snapshot_delete,
+    .bdrv_snapshot_attach_vmstate = qcow2_snapshot_attach_vmstate,
     .bdrv_snapshot_list     = qcow2_snapshot_list,
     .bdrv_snapshot_load_tmp = qcow2_snapshot_load_tmp,
     .bdrv_measure           = qcow2_measure,
@@ -5963,6 +6393,8 @@ BlockDriver bdrv_qcow2 = {
 
     .bdrv_detach_aio_context  = qcow2_detach_aio_context,
     .bdrv_attach_aio_context  = qcow2_attach_aio_context,
+    .bdrv_co_drain_begin      = qcow2_co_drain_begin,
+    .bdrv_co_drain_end        = qcow2_co_drain_end,
 
     .bdrv_supports_persistent_dirty_bitmap =
             qcow2_supports_persistent_dirty_bitmap,
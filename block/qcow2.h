@@ -29,6 +29,7 @@
 #include "qemu/coroutine.h"
 #include "qemu/units.h"
 #include "block/block_int.h"
+#include "block/thread-pool.h"
 
 //#define DEBUG_ALLOC
 //#define DEBUG_ALLOC2
@@ -71,6 +72,11 @@
 /* Maximum of parallel sub-request per guest request */
 #define QCOW2_MAX_WORKERS 8
 
+/* Idle bounce buffers for encrypted I/O that an image keeps around */
+#define QCOW2_MAX_CRYPT_BUFS QCOW2_MAX_THREADS
+/* Upper limit for the size of these buffers */
+#define QCOW2_CRYPT_BUF_MAX_SIZE (2 * MiB)
+
 /* indicate that the refcount of the referenced cluster is exactly one. */
 #define QCOW_OFLAG_COPIED     (1ULL << 63)
 /* indicate that the cluster is compressed (they never have the copied flag) */
@@ -150,6 +156,10 @@
 #define QCOW2_OPT_L2_CACHE_ENTRY_SIZE "l2-cache-entry-size"
 #define QCOW2_OPT_REFCOUNT_CACHE_SIZE "refcount-cache-size"
 #define QCOW2_OPT_CACHE_CLEAN_INTERVAL "cache-clean-interval"
+#define QCOW2_OPT_CLUSTER_POOL_SIZE "cluster-pool-size"
+#define QCOW2_OPT_COMPRESS_THREADS "compress-threads"
+#define QCOW2_OPT_COMPRESS_READAHEAD "compress-readahead"
+#define QCOW2_OPT_L2_PREFETCH "l2-prefetch"
 
 typedef struct QCowHeader {
     uint32_t magic;
@@ -323,6 +333,16 @@ typedef struct Qcow2BitmapHeaderExt {
 } QEMU_PACKED Qcow2BitmapHeaderExt;
 
 #define QCOW2_MAX_THREADS 4
+#define QCOW2_MAX_COMPRESS_THREADS 64
+
+/* A decompressed cluster, see qcow2_co_preadv_compressed() */
+typedef struct Qcow2DecompressedCluster {
+    uint64_t cluster_descriptor; /* 0 if the entry is unused */
+    uint64_t generation;         /* valid if equal to decompressed_generation */
+    uint8_t *data;
+    bool loading;                /* data is still being read */
+    CoQueue waiters;             /* requests waiting for the data */
+} Qcow2DecompressedCluster;
 
 typedef struct BDRVQcow2State {
     int cluster_bits;
@@ -348,6 +368,16 @@ typedef struct BDRVQcow2State {
     QEMUTimer *cache_clean_timer;
     unsigned cache_clean_interval;
 
+    /*
+     * Loading the L2 tables into the cache in the background after open,
+     * see qcow2_co_l2_prefetch_entry()
+     */
+    bool l2_prefetch;
+    bool l2_prefetch_running;
+    bool l2_prefetch_stop;
+    uint64_t l2_prefetch_index; /* next L1 index to prefetch */
+    int l2_prefetch_slices;     /* number of slices loaded so far */
+
     QLIST_HEAD(, QCowL2Meta) cluster_allocs;
 
     uint64_t *refcount_table;
@@ -357,6 +387,15 @@ typedef struct BDRVQcow2State {
     uint64_t free_cluster_index;
     uint64_t free_byte_offset;
 
+    /*
+     * Host clusters that have been allocated ahead of time for guest data,
+     * see qcow2_cluster_pool_alloc().  cluster_pool_size is the number of
+     * clusters allocated at once, 0 disables the pool.
+     */
+    uint64_t cluster_pool_size;
+    uint64_t cluster_pool_offset;
+    uint64_t cluster_pool_nb;
+
     CoMutex lock;
 
     Qcow2CryptoHeaderExtension crypto_header; /* QCow2 header extension */
@@ -408,6 +447,24 @@ typedef struct BDRVQcow2State {
 
     CoQueue thread_task_queue;
     int nb_threads;
+    int compress_threads;
+    ThreadPool *thread_pool;
+
+    /* Bounce buffers of qcow2_crypt_buf_size() bytes for encrypted I/O */
+    void *crypt_bufs[QCOW2_MAX_CRYPT_BUFS];
+    int nb_crypt_bufs;
+
+    /*
+     * Compressed clusters that have been decompressed recently or ahead of
+     * time for sequential readers.  There are 2 * compress_readahead
+     * entries; 0 disables read-ahead.
+     */
+    int compress_readahead;
+    Qcow2DecompressedCluster *decompressed_clusters;
+    int decompressed_next;
+    uint64_t decompressed_generation;
+    uint64_t compressed_ra_next; /* guest offset continuing the stream */
+    uint64_t compressed_ra_end;  /* read-ahead has been started up to here */
 
     BdrvChild *data_file;
 
@@ -864,6 +921,9 @@ int64_t qcow2_alloc_clusters(BlockDriverState *bs, uint64_t size);
 int64_t qcow2_alloc_clusters_at(BlockDriverState *bs, uint64_t offset,
                                 int64_t nb_clusters);
 int64_t qcow2_alloc_bytes(BlockDriverState *bs, int size);
+int qcow2_cluster_pool_alloc(BlockDriverState *bs, uint64_t *host_offset,
+                             uint64_t *nb_clusters);
+void qcow2_cluster_pool_release(BlockDriverState *bs);
 void qcow2_free_clusters(BlockDriverState *bs,
                           int64_t offset, int64_t size,
                           enum qcow2_discard_type type);
@@ -907,6 +967,9 @@ int qcow2_encrypt_sectors(BDRVQcow2State *s, int64_t sector_num,
 int qcow2_get_host_offset(BlockDriverState *bs, uint64_t offset,
                           unsigned int *bytes, uint64_t *host_offset,
                           QCow2SubclusterType *subcluster_type);
+bool qcow2_get_host_offset_cached(BlockDriverState *bs, uint64_t offset,
+                                  unsigned int *bytes, uint64_t *host_offset,
+                                  QCow2SubclusterType *subcluster_type);
 int qcow2_alloc_host_offset(BlockDriverState *bs, uint64_t offset,
                             unsigned int *bytes, uint64_t *host_offset,
                             QCowL2Meta **m);
@@ -934,6 +997,10 @@ int qcow2_snapshot_delete(BlockDriverState *bs,
                           const char *snapshot_id,
                           const char *name,
                           Error **errp);
+int qcow2_snapshot_attach_vmstate(BlockDriverState *bs,
+                                  const char *name,
+                                  uint64_t vm_state_size,
+                                  Error **errp);
 int qcow2_snapshot_list(BlockDriverState *bs, QEMUSnapshotInfo **psn_tab);
 int qcow2_snapshot_load_tmp(BlockDriverState *bs,
                             const char *snapshot_id,
@@ -972,6 +1039,8 @@ int qcow2_cache_get_empty(BlockDriverState *bs, Qcow2Cache *c, uint64_t offset,
     void **table);
 void qcow2_cache_put(Qcow2Cache *c, void **table);
 void *qcow2_cache_is_table_offset(Qcow2Cache *c, uint64_t offset);
+void *qcow2_cache_lookup(Qcow2Cache *c, uint64_t offset);
+int qcow2_cache_get_num_tables(Qcow2Cache *c);
 void qcow2_cache_discard(Qcow2Cache *c, void *table);
 
 /* qcow2-bitmap.c functions */
@@ -1010,5 +1079,8 @@ qcow2_co_encrypt(BlockDriverState *bs, uint64_t host_offset,
 int coroutine_fn
 qcow2_co_decrypt(BlockDriverState *bs, uint64_t host_offset,
                  uint64_t guest_offset, void *buf, size_t len);
+void *qcow2_crypt_buf_get(BlockDriverState *bs, size_t len);
+void qcow2_crypt_buf_put(BlockDriverState *bs, void *buf, size_t len);
+void qcow2_crypt_bufs_free(BlockDriverState *bs);
 
 #endif
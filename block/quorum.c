@@ -17,6 +17,7 @@
 #include "qemu/cutils.h"
 #include "qemu/module.h"
 #include "qemu/option.h"
+#include "qemu/timer.h"
 #include "block/block_int.h"
 #include "block/coroutines.h"
 #include "block/qdict.h"
@@ -36,6 +37,13 @@
 #define QUORUM_OPT_BLKVERIFY      "blkverify"
 #define QUORUM_OPT_REWRITE        "rewrite-corrupted"
 #define QUORUM_OPT_READ_PATTERN   "read-pattern"
+#define QUORUM_OPT_HEDGE_READS    "hedge-reads"
+
+/*
+ * With read-pattern=latency, one read in QUORUM_LATENCY_PROBE_INTERVAL goes
+ * to a child picked in turn, so that a child which got faster is noticed.
+ */
+#define QUORUM_LATENCY_PROBE_INTERVAL 64
 
 /* This union holds a vote hash value */
 typedef union QuorumVoteValue {
@@ -68,6 +76,15 @@ typedef struct QuorumVotes {
     bool (*compare)(QuorumVoteValue *a, QuorumVoteValue *b);
 } QuorumVotes;
 
+/*
+ * Read latency of a child, smoothed like TCP's round-trip time estimate:
+ * avg_ns + 4 * dev_ns is used as an estimate of its tail latency.
+ */
+typedef struct QuorumChildLatency {
+    int64_t avg_ns;     /* 0 until the first successful read */
+    int64_t dev_ns;
+} QuorumChildLatency;
+
 /* the following structure holds the state of one quorum instance */
 typedef struct BDRVQuorumState {
     BdrvChild **children;  /* children BlockDriverStates */
@@ -91,6 +108,11 @@ typedef struct BDRVQuorumState {
                             */
 
     QuorumReadPattern read_pattern;
+
+    /* read-pattern=latency */
+    QuorumChildLatency *latency;    /* one per child, same order */
+    uint64_t latency_reads;
+    bool hedge_reads;
 } BDRVQuorumState;
 
 typedef struct QuorumAIOCB QuorumAIOCB;
@@ -663,6 +685,243 @@ static int read_fifo_child(QuorumAIOCB *acb)
     return ret;
 }
 
+static void quorum_latency_update(QuorumChildLatency *l, int64_t ns)
+{
+    if (!l->avg_ns) {
+        l->avg_ns = ns;
+        l->dev_ns = ns / 2;
+        return;
+    }
+    l->dev_ns += (llabs(ns - l->avg_ns) - l->dev_ns) / 4;
+    l->avg_ns += (ns - l->avg_ns) / 8;
+}
+
+/* Returns 0 while the latency of the child is unknown */
+static int64_t quorum_latency_tail(QuorumChildLatency *l)
+{
+    return l->avg_ns ? l->avg_ns + 4 * l->dev_ns : 0;
+}
+
+static int coroutine_fn quorum_timed_preadv(BDRVQuorumState *s, int i,
+                                            uint64_t offset, uint64_t bytes,
+                                            QEMUIOVector *qiov)
+{
+    int64_t start = qemu_clock_get_ns(QEMU_CLOCK_REALTIME);
+    int ret;
+
+    ret = bdrv_co_preadv(s->children[i], offset, bytes, qiov, 0);
+    if (ret >= 0) {
+        quorum_latency_update(&s->latency[i],
+                              qemu_clock_get_ns(QEMU_CLOCK_REALTIME) - start);
+    }
+    return ret;
+}
+
+/*
+ * Fill @order with the child indexes by increasing average latency.
+ * Children whose latency is unknown come first, and now and then a
+ * child is moved to the front to refresh its average.
+ */
+static void quorum_latency_order(BDRVQuorumState *s, int *order)
+{
+    uint64_t reads = s->latency_reads++;
+    int i, j;
+
+    for (i = 0; i < s->num_children; i++) {
+        int64_t avg = s->latency[i].avg_ns;
+
+        for (j = i; j > 0 && s->latency[order[j - 1]].avg_ns > avg; j--) {
+            order[j] = order[j - 1];
+        }
+        order[j] = i;
+    }
+
+    if (reads % QUORUM_LATENCY_PROBE_INTERVAL == 0) {
+        int probe = (reads / QUORUM_LATENCY_PROBE_INTERVAL) % s->num_children;
+
+        i = 0;
+        while (order[i] != probe) {
+            i++;
+        }
+        memmove(&order[1], &order[0], i * sizeof(order[0]));
+        order[0] = probe;
+    }
+}
+
+/*
+ * A hedged read.  Every child that is read from gets its own buffer and
+ * a reference, so that the request can complete with the first
+ * successful read while slower ones are still in flight.
+ */
+typedef struct QuorumHedge {
+    BlockDriverState *bs;
+    uint64_t offset;
+    uint64_t bytes;
+    QEMUIOVector *qiov;         /* NULL once the request has completed */
+
+    Coroutine *co;
+    QemuCoSleepState *sleep_state;
+    bool waiting;               /* @co yielded without a timeout */
+
+    int refcnt;
+    int failed;                 /* number of reads that failed */
+    int ret;                    /* error of the last failed read */
+    bool done;                  /* a read succeeded */
+} QuorumHedge;
+
+typedef struct QuorumHedgeCo {
+    QuorumHedge *hedge;
+    int idx;
+} QuorumHedgeCo;
+
+static void quorum_hedge_unref(QuorumHedge *h)
+{
+    if (--h->refcnt == 0) {
+        g_free(h);
+    }
+}
+
+static void quorum_hedge_wake(QuorumHedge *h)
+{
+    if (h->sleep_state) {
+        qemu_co_sleep_wake(h->sleep_state);
+    } else if (h->waiting) {
+        qemu_coroutine_enter_if_inactive(h->co);
+    }
+}
+
+static void coroutine_fn quorum_hedge_read_entry(void *opaque)
+{
+    QuorumHedgeCo *co = opaque;
+    QuorumHedge *h = co->hedge;
+    BlockDriverState *bs = h->bs;
+    BDRVQuorumState *s = bs->opaque;
+    int i = co->idx;
+    QEMUIOVector qiov;
+    void *buf;
+    int ret;
+
+    buf = qemu_blockalign(s->children[i]->bs, h->bytes);
+    qemu_iovec_init_buf(&qiov, buf, h->bytes);
+    ret = quorum_timed_preadv(s, i, h->offset, h->bytes, &qiov);
+    if (ret < 0) {
+        quorum_report_bad(QUORUM_OP_TYPE_READ, h->offset, h->bytes,
+                          s->children[i]->bs->node_name, ret);
+    }
+
+    if (h->qiov && !h->done) {
+        if (ret < 0) {
+            h->failed++;
+            h->ret = ret;
+        } else {
+            qemu_iovec_from_buf(h->qiov, 0, buf, h->bytes);
+            h->done = true;
+        }
+        quorum_hedge_wake(h);
+    }
+
+    qemu_vfree(buf);
+    quorum_hedge_unref(h);
+    bdrv_dec_in_flight(bs);
+}
+
+static void quorum_hedge_issue(QuorumHedge *h, int idx)
+{
+    Coroutine *co;
+    QuorumHedgeCo data = {
+        .hedge = h,
+        .idx = idx,
+    };
+
+    /* reads may outlive the request, keep draining aware of them */
+    bdrv_inc_in_flight(h->bs);
+    h->refcnt++;
+    co = qemu_coroutine_create(quorum_hedge_read_entry, &data);
+    qemu_coroutine_enter(co);
+}
+
+/*
+ * Read from the fastest child, and also from the next one if no reply
+ * came within the estimated tail latency of the children read so far,
+ * or as soon as all of them failed.
+ */
+static int coroutine_fn read_latency_hedged(QuorumAIOCB *acb, const int *order)
+{
+    BDRVQuorumState *s = acb->bs->opaque;
+    QuorumHedge *h = g_new(QuorumHedge, 1);
+    int64_t deadline = INT64_MAX;
+    int next = 0;
+    int ret;
+
+    *h = (QuorumHedge) {
+        .bs     = acb->bs,
+        .offset = acb->offset,
+        .bytes  = acb->bytes,
+        .qiov   = acb->qiov,
+        .co     = qemu_coroutine_self(),
+        .refcnt = 1,
+        .ret    = -EIO,
+    };
+
+    while (!h->done) {
+        int64_t now = qemu_clock_get_ns(QEMU_CLOCK_REALTIME);
+
+        if (h->failed == next || (next < s->num_children && now >= deadline)) {
+            int64_t tail;
+
+            if (next == s->num_children) {
+                break;
+            }
+            tail = quorum_latency_tail(&s->latency[order[next]]);
+            deadline = tail ? now + tail : INT64_MAX;
+            quorum_hedge_issue(h, order[next++]);
+            continue;
+        }
+
+        if (next < s->num_children && deadline != INT64_MAX) {
+            qemu_co_sleep_ns_wakeable(QEMU_CLOCK_REALTIME, deadline - now,
+                                      &h->sleep_state);
+        } else {
+            h->waiting = true;
+            qemu_coroutine_yield();
+            h->waiting = false;
+        }
+    }
+
+    acb->children_read = next;
+    ret = h->done ? 0 : h->ret;
+    h->qiov = NULL;
+    quorum_hedge_unref(h);
+    return ret;
+}
+
+static int read_latency_child(QuorumAIOCB *acb)
+{
+    BDRVQuorumState *s = acb->bs->opaque;
+    g_autofree int *order = g_new(int, s->num_children);
+    int i, ret = -EIO;
+
+    quorum_latency_order(s, order);
+    if (s->hedge_reads && s->num_children > 1) {
+        return read_latency_hedged(acb, order);
+    }
+
+    /* like read_fifo_child(), in order of latency */
+    for (i = 0; i < s->num_children; i++) {
+        int n = order[i];
+
+        acb->children_read++;
+        acb->qcrs[n].bs = s->children[n]->bs;
+        ret = quorum_timed_preadv(s, n, acb->offset, acb->bytes, acb->qiov);
+        if (ret >= 0) {
+            break;
+        }
+        quorum_report_bad_acb(&acb->qcrs[n], ret);
+    }
+
+    return ret;
+}
+
 static int quorum_co_preadv(BlockDriverState *bs, uint64_t offset,
                             uint64_t bytes, QEMUIOVector *qiov, int flags)
 {
@@ -673,10 +932,16 @@ static int quorum_co_preadv(BlockDriverState *bs, uint64_t offset,
     acb->is_read = true;
     acb->children_read = 0;
 
-    if (s->read_pattern == QUORUM_READ_PATTERN_QUORUM) {
+    switch (s->read_pattern) {
+    case QUORUM_READ_PATTERN_QUORUM:
         ret = read_quorum_children(acb);
-    } else {
+        break;
+    case QUORUM_READ_PATTERN_LATENCY:
+        ret = read_latency_child(acb);
+        break;
+    default:
         ret = read_fifo_child(acb);
+        break;
     }
     quorum_aio_finalize(acb);
 
@@ -904,7 +1169,13 @@ static QemuOptsList quorum_runtime_opts = {
         {
             .name = QUORUM_OPT_READ_PATTERN,
             .type = QEMU_OPT_STRING,
-            .help = "Allowed pattern: quorum, fifo. Quorum is default",
+            .help = "Allowed pattern: quorum, fifo, latency. Quorum is default",
+        },
+        {
+            .name = QUORUM_OPT_HEDGE_READS,
+            .type = QEMU_OPT_BOOL,
+            .help = "With read-pattern=latency, also read from the next "
+                    "fastest child when a read is slow",
         },
         { /* end of list */ }
     },
@@ -971,11 +1242,19 @@ static int quorum_open(BlockDriverState *bs, QDict *options, int flags,
                               -EINVAL, NULL);
     }
     if (ret < 0) {
-        error_setg(errp, "Please set read-pattern as fifo or quorum");
+        error_setg(errp, "Please set read-pattern as fifo, quorum or latency");
         goto exit;
     }
     s->read_pattern = ret;
 
+    s->hedge_reads = qemu_opt_get_bool(opts, QUORUM_OPT_HEDGE_READS, false);
+    if (s->hedge_reads && s->read_pattern != QUORUM_READ_PATTERN_LATENCY) {
+        error_setg(errp, "hedge-reads=on can only be used with "
+                   "read-pattern=latency");
+        ret = -EINVAL;
+        goto exit;
+    }
+
     if (s->read_pattern == QUORUM_READ_PATTERN_QUORUM) {
         s->is_blkverify = qemu_opt_get_bool(opts, QUORUM_OPT_BLKVERIFY, false);
         if (s->is_blkverify && (s->num_children != 2 || s->threshold != 2)) {
@@ -997,6 +1276,7 @@ static int quorum_open(BlockDriverState *bs, QDict *options, int flags,
 
     /* allocate the children array */
     s->children = g_new0(BdrvChild *, s->num_children);
+    s->latency = g_new0(QuorumChildLatency, s->num_children);
     opened = g_new0(bool, s->num_children);
 
     for (i = 0; i < s->num_children; i++) {
@@ -1031,6 +1311,7 @@ close_exit:
         bdrv_unref_child(bs, s->children[i]);
     }
     g_free(s->children);
+    g_free(s->latency);
     g_free(opened);
 exit:
     qemu_opts_del(opts);
@@ -1047,6 +1328,7 @@ static void quorum_close(BlockDriverState *bs)
     }
 
     g_free(s->children);
+    g_free(s->latency);
 }
 
 static void quorum_add_child(BlockDriverState *bs, BlockDriverState *child_bs,
@@ -1088,6 +1370,8 @@ static void quorum_add_child(BlockDriverState *bs, BlockDriverState *child_bs,
         goto out;
     }
     s->children = g_renew(BdrvChild *, s->children, s->num_children + 1);
+    s->latency = g_renew(QuorumChildLatency, s->latency, s->num_children + 1);
+    s->latency[s->num_children] = (QuorumChildLatency) { 0 };
     s->children[s->num_children++] = child;
     quorum_refresh_flags(bs);
 
@@ -1131,7 +1415,10 @@ static void quorum_del_child(BlockDriverState *bs, BdrvChild *child,
     /* We can safely remove this child now */
     memmove(&s->children[i], &s->children[i + 1],
             (s->num_children - i - 1) * sizeof(BdrvChild *));
+    memmove(&s->latency[i], &s->latency[i + 1],
+            (s->num_children - i - 1) * sizeof(QuorumChildLatency));
     s->children = g_renew(BdrvChild *, s->children, --s->num_children);
+    s->latency = g_renew(QuorumChildLatency, s->latency, s->num_children);
     bdrv_unref_child(bs, child);
 
     quorum_refresh_flags(bs);
@@ -371,12 +371,48 @@ static int raw_get_info(BlockDriverState *bs, BlockDriverInfo *bdi)
 
 static void raw_refresh_limits(BlockDriverState *bs, Error **errp)
 {
+    BDRVRawState *s = bs->opaque;
+    const BlockLimits *file_bl = &bs->file->bs->bl;
+
     if (bs->probed) {
         /* To make it easier to protect the first sector, any probed
          * image is restricted to read-modify-write on sub-sector
          * operations. */
         bs->bl.request_alignment = BDRV_SECTOR_SIZE;
     }
+
+    /* Zones are only passed through if the whole device is visible */
+    if (!s->offset && !s->has_size) {
+        bs->bl.zoned = file_bl->zoned;
+        bs->bl.zone_size = file_bl->zone_size;
+        bs->bl.nr_zones = file_bl->nr_zones;
+        bs->bl.max_open_zones = file_bl->max_open_zones;
+        bs->bl.max_active_zones = file_bl->max_active_zones;
+        bs->bl.max_append_bytes = file_bl->max_append_bytes;
+    }
+}
+
+static int coroutine_fn raw_co_zone_report(BlockDriverState *bs,
+                                           int64_t offset,
+                                           unsigned int *nr_zones,
+                                           BlockZoneDescriptor *zones)
+{
+    return bdrv_co_zone_report(bs->file->bs, offset, nr_zones, zones);
+}
+
+static int coroutine_fn raw_co_zone_mgmt(BlockDriverState *bs,
+                                         BlockZoneOp op,
+                                         int64_t offset, int64_t len)
+{
+    return bdrv_co_zone_mgmt(bs->file->bs, op, offset, len);
+}
+
+static int coroutine_fn raw_co_zone_append(BlockDriverState *bs,
+                                           int64_t *offset,
+                                           QEMUIOVector *qiov,
+                                           BdrvRequestFlags flags)
+{
+    return bdrv_co_zone_append(bs->file->bs, offset, qiov, flags);
 }
 
 static int coroutine_fn raw_co_truncate(BlockDriverState *bs, int64_t offset,
@@ -601,6 +637,7 @@ BlockDriver bdrv_raw = {
     .bdrv_getlength       = &raw_getlength,
     .is_format            = true,
     .has_variable_length  = true,
+    .supports_multiqueue  = true,
     .bdrv_measure         = &raw_measure,
     .bdrv_get_info        = &raw_get_info,
     .bdrv_refresh_limits  = &raw_refresh_limits,
@@ -609,6 +646,9 @@ BlockDriver bdrv_raw = {
     .bdrv_eject           = &raw_eject,
     .bdrv_lock_medium     = &raw_lock_medium,
     .bdrv_co_ioctl        = &raw_co_ioctl,
+    .bdrv_co_zone_report  = &raw_co_zone_report,
+    .bdrv_co_zone_mgmt    = &raw_co_zone_mgmt,
+    .bdrv_co_zone_append  = &raw_co_zone_append,
     .create_opts          = &raw_create_opts,
     .bdrv_has_zero_init   = &raw_has_zero_init,
     .strong_runtime_opts  = raw_strong_runtime_opts,
@@ -66,12 +66,7 @@
 
 #define RBD_MAX_SNAPS 100
 
-/* The LIBRBD_SUPPORTS_IOVEC is defined in librbd.h */
-#ifdef LIBRBD_SUPPORTS_IOVEC
-#define LIBRBD_USE_IOVEC 1
-#else
-#define LIBRBD_USE_IOVEC 0
-#endif
+#define RBD_MAX_IMAGE_HANDLES 16
 
 typedef enum {
     RBD_AIO_READ,
@@ -84,28 +79,46 @@ typedef struct RBDAIOCB {
     BlockAIOCB common;
     int64_t ret;
     QEMUIOVector *qiov;
-    char *bounce;
     RBDAIOCmd cmd;
     int error;
     struct BDRVRBDState *s;
+    /* The context that submitted the request, completion runs there */
+    AioContext *ctx;
 } RBDAIOCB;
 
 typedef struct RADOSCB {
     RBDAIOCB *acb;
     struct BDRVRBDState *s;
     int64_t size;
-    char *buf;
     int64_t ret;
 } RADOSCB;
 
+/* An additional AioContext that submits requests, see supports_multiqueue */
+typedef struct RBDQueueContext {
+    AioContext *ctx;
+    rbd_image_t image;
+} RBDQueueContext;
+
 typedef struct BDRVRBDState {
     rados_t cluster;
     rados_ioctx_t io_ctx;
+    /* Requests from the node's own AioContext and everything else use this */
     rbd_image_t image;
+    /*
+     * librbd serializes requests on an image handle, so more handles can be
+     * opened to be handed out round-robin to the multiqueue contexts.
+     * images[0] is @image.
+     */
+    rbd_image_t *images;
+    int nb_images;
+    GSList *queue_contexts;
+    unsigned next_image;
     char *image_name;
     char *snap;
     char *namespace;
+    /* Protected by resize_lock, writes may come from several threads */
     uint64_t image_size;
+    QemuMutex resize_lock;
 } BDRVRBDState;
 
 static int qemu_rbd_connect(rados_t *cluster, rados_ioctx_t *io_ctx,
@@ -332,13 +345,10 @@ static int qemu_rbd_set_keypairs(rados_t cluster, const char *keypairs_json,
 
 static void qemu_rbd_memset(RADOSCB *rcb, int64_t offs)
 {
-    if (LIBRBD_USE_IOVEC) {
-        RBDAIOCB *acb = rcb->acb;
-        iov_memset(acb->qiov->iov, acb->qiov->niov, offs, 0,
-                   acb->qiov->size - offs);
-    } else {
-        memset(rcb->buf + offs, 0, rcb->size - offs);
-    }
+    RBDAIOCB *acb = rcb->acb;
+
+    iov_memset(acb->qiov->iov, acb->qiov->niov, offs, 0,
+               acb->qiov->size - offs);
 }
 
 /* FIXME Deprecate and remove keypairs or make it available in QMP. */
@@ -494,13 +504,6 @@ static void qemu_rbd_complete_aio(RADOSCB *rcb)
 
     g_free(rcb);
 
-    if (!LIBRBD_USE_IOVEC) {
-        if (acb->cmd == RBD_AIO_READ) {
-            qemu_iovec_from_buf(acb->qiov, 0, acb->bounce, acb->qiov->size);
-        }
-        qemu_vfree(acb->bounce);
-    }
-
     acb->common.cb(acb->common.opaque, (acb->ret > 0 ? 0 : acb->ret));
 
     qemu_aio_unref(acb);
@@ -739,8 +742,25 @@ static int qemu_rbd_open(BlockDriverState *bs, QDict *options, int flags,
         qdict_del(options, e->key);
     }
 
+    s->nb_images = opts->has_image_handles ? opts->image_handles : 1;
+    if (s->nb_images < 1 || s->nb_images > RBD_MAX_IMAGE_HANDLES) {
+        error_setg(errp, "image-handles must be between 1 and %d",
+                   RBD_MAX_IMAGE_HANDLES);
+        r = -EINVAL;
+        goto out;
+    }
+
+    /*
+     * The librbd cache of one handle doesn't see writes through the others,
+     * so it can't be used with several handles.
+     */
+    if (s->nb_images > 1 && !(flags & BDRV_O_NOCACHE)) {
+        warn_report("rbd: Disabling the librbd cache because several image "
+                    "handles are used");
+    }
     r = qemu_rbd_connect(&s->cluster, &s->io_ctx, opts,
-                         !(flags & BDRV_O_NOCACHE), keypairs, secretid, errp);
+                         !(flags & BDRV_O_NOCACHE) && s->nb_images == 1,
+                         keypairs, secretid, errp);
     if (r < 0) {
         goto out;
     }
@@ -774,12 +794,54 @@ static int qemu_rbd_open(BlockDriverState *bs, QDict *options, int flags,
         }
     }
 
+    s->images = g_new0(rbd_image_t, s->nb_images);
+    s->images[0] = s->image;
+    if (s->nb_images > 1) {
+        uint64_t features;
+        int i;
+
+        /*
+         * With exclusive-lock, the handles would keep taking the lock away
+         * from each other
+         */
+        r = rbd_get_features(s->image, &features);
+        if (r < 0) {
+            error_setg_errno(errp, -r, "error getting features of %s",
+                             s->image_name);
+            goto failed_images;
+        }
+        if (features & RBD_FEATURE_EXCLUSIVE_LOCK) {
+            error_setg(errp, "image-handles > 1 requires the exclusive-lock "
+                       "feature to be disabled on %s", s->image_name);
+            r = -EINVAL;
+            goto failed_images;
+        }
+
+        for (i = 1; i < s->nb_images; i++) {
+            r = rbd_open(s->io_ctx, s->image_name, &s->images[i], s->snap);
+            if (r < 0) {
+                error_setg_errno(errp, -r, "error opening handle %d of %s",
+                                 i, s->image_name);
+                goto failed_images;
+            }
+        }
+    }
+    qemu_mutex_init(&s->resize_lock);
+
     /* When extending regular files, we get zeros from the OS */
     bs->supported_truncate_flags = BDRV_REQ_ZERO_WRITE;
 
     r = 0;
     goto out;
 
+failed_images:
+    for (int i = s->nb_images - 1; i >= 0; i--) {
+        if (s->images[i]) {
+            rbd_close(s->images[i]);
+        }
+    }
+    g_free(s->images);
+    s->images = NULL;
 failed_open:
     rados_ioctx_destroy(s->io_ctx);
     g_free(s->snap);
@@ -815,30 +877,98 @@ static int qemu_rbd_reopen_prepare(BDRVReopenState *state,
 static void qemu_rbd_close(BlockDriverState *bs)
 {
     BDRVRBDState *s = bs->opaque;
+    int i;
 
-    rbd_close(s->image);
+    assert(!s->queue_contexts);
+    for (i = 0; i < s->nb_images; i++) {
+        rbd_close(s->images[i]);
+    }
+    g_free(s->images);
+    qemu_mutex_destroy(&s->resize_lock);
     rados_ioctx_destroy(s->io_ctx);
     g_free(s->snap);
     g_free(s->image_name);
     rados_shutdown(s->cluster);
 }
 
-/* Resize the RBD image and update the 'image_size' with the current size */
+/*
+ * Resize the RBD image and update the 'image_size' with the current size.
+ * The caller holds resize_lock.
+ */
 static int qemu_rbd_resize(BlockDriverState *bs, uint64_t size)
 {
     BDRVRBDState *s = bs->opaque;
-    int r;
+    uint64_t unused;
+    int i, r;
 
     r = rbd_resize(s->image, size);
     if (r < 0) {
         return r;
     }
 
+    /* Make the other handles pick up the new size before they use it */
+    for (i = 1; i < s->nb_images; i++) {
+        rbd_get_size(s->images[i], &unused);
+    }
+
     s->image_size = size;
 
     return 0;
 }
 
+/* The image handle for a request submitted from the current AioContext */
+static rbd_image_t qemu_rbd_get_image(BlockDriverState *bs)
+{
+    BDRVRBDState *s = bs->opaque;
+    AioContext *ctx = bdrv_get_request_aio_context(bs);
+    GSList *l;
+
+    if (ctx == bdrv_get_aio_context(bs)) {
+        return s->image;
+    }
+    for (l = s->queue_contexts; l; l = l->next) {
+        RBDQueueContext *q = l->data;
+
+        if (q->ctx == ctx) {
+            return q->image;
+        }
+    }
+    return s->image;
+}
+
+static void qemu_rbd_attach_multiqueue_context(BlockDriverState *bs,
+                                               AioContext *ctx)
+{
+    BDRVRBDState *s = bs->opaque;
+    RBDQueueContext *q = g_new(RBDQueueContext, 1);
+
+    /* Keep images[0] for the node's own AioContext where possible */
+    q->ctx = ctx;
+    if (s->nb_images > 1) {
+        q->image = s->images[1 + s->next_image++ % (s->nb_images - 1)];
+    } else {
+        q->image = s->image;
+    }
+    s->queue_contexts = g_slist_prepend(s->queue_contexts, q);
+}
+
+static void qemu_rbd_detach_multiqueue_context(BlockDriverState *bs,
+                                               AioContext *ctx)
+{
+    BDRVRBDState *s = bs->opaque;
+    GSList *l;
+
+    for (l = s->queue_contexts; l; l = l->next) {
+        RBDQueueContext *q = l->data;
+
+        if (q->ctx == ctx) {
+            s->queue_contexts = g_slist_remove(s->queue_contexts, q);
+            g_free(q);
+            return;
+        }
+    }
+}
+
 static const AIOCBInfo rbd_aiocb_info = {
     .aiocb_size = sizeof(RBDAIOCB),
 };
@@ -864,8 +994,7 @@ static void rbd_finish_aiocb(rbd_completion_t c, RADOSCB *rcb)
     rcb->ret = rbd_aio_get_return_value(c);
     rbd_aio_release(c);
 
-    replay_bh_schedule_oneshot_event(bdrv_get_aio_context(acb->common.bs),
-                                     rbd_finish_bh, rcb);
+    replay_bh_schedule_oneshot_event(acb->ctx, rbd_finish_bh, rcb);
 }
 
 static int rbd_aio_discard_wrapper(rbd_image_t image,
@@ -901,6 +1030,7 @@ static BlockAIOCB *rbd_start_aio(BlockDriverState *bs,
     RBDAIOCB *acb;
     RADOSCB *rcb = NULL;
     rbd_completion_t c;
+    rbd_image_t image = qemu_rbd_get_image(bs);
     int r;
 
     BDRVRBDState *s = bs->opaque;
@@ -912,24 +1042,10 @@ static BlockAIOCB *rbd_start_aio(BlockDriverState *bs,
 
     rcb = g_new(RADOSCB, 1);
 
-    if (!LIBRBD_USE_IOVEC) {
-        if (cmd == RBD_AIO_DISCARD || cmd == RBD_AIO_FLUSH) {
-            acb->bounce = NULL;
-        } else {
-            acb->bounce = qemu_try_blockalign(bs, qiov->size);
-            if (acb->bounce == NULL) {
-                goto failed;
-            }
-        }
-        if (cmd == RBD_AIO_WRITE) {
-            qemu_iovec_to_buf(acb->qiov, 0, acb->bounce, qiov->size);
-        }
-        rcb->buf = acb->bounce;
-    }
-
     acb->ret = 0;
     acb->error = 0;
     acb->s = s;
+    acb->ctx = bdrv_get_request_aio_context(bs);
 
     rcb->acb = acb;
     rcb->s = acb->s;
@@ -946,31 +1062,30 @@ static BlockAIOCB *rbd_start_aio(BlockDriverState *bs,
          * to support growing images, we resize the image before write
          * operations that exceed the current size.
          */
+        qemu_mutex_lock(&s->resize_lock);
+        r = 0;
         if (off + size > s->image_size) {
             r = qemu_rbd_resize(bs, off + size);
-            if (r < 0) {
-                goto failed_completion;
-            }
         }
-#ifdef LIBRBD_SUPPORTS_IOVEC
-            r = rbd_aio_writev(s->image, qiov->iov, qiov->niov, off, c);
-#else
-            r = rbd_aio_write(s->image, off, size, rcb->buf, c);
-#endif
+        qemu_mutex_unlock(&s->resize_lock);
+        if (r < 0) {
+            goto failed_completion;
+        }
+        r = rbd_aio_writev(image, qiov->iov, qiov->niov, off, c);
         break;
     }
     case RBD_AIO_READ:
-#ifdef LIBRBD_SUPPORTS_IOVEC
-            r = rbd_aio_readv(s->image, qiov->iov, qiov->niov, off, c);
-#else
-            r = rbd_aio_read(s->image, off, size, rcb->buf, c);
-#endif
+        r = rbd_aio_readv(image, qiov->iov, qiov->niov, off, c);
         break;
     case RBD_AIO_DISCARD:
-        r = rbd_aio_discard_wrapper(s->image, off, size, c);
+        r = rbd_aio_discard_wrapper(image, off, size, c);
         break;
     case RBD_AIO_FLUSH:
-        r = rbd_aio_flush_wrapper(s->image, c);
+        /*
+         * With several handles, the librbd cache is disabled and writes
+         * are stable when they complete, so flushing one handle is enough
+         */
+        r = rbd_aio_flush_wrapper(image, c);
         break;
     default:
         r = -EINVAL;
@@ -985,9 +1100,6 @@ failed_completion:
     rbd_aio_release(c);
 failed:
     g_free(rcb);
-    if (!LIBRBD_USE_IOVEC) {
-        qemu_vfree(acb->bounce);
-    }
 
     qemu_aio_unref(acb);
     return NULL;
@@ -1071,6 +1183,7 @@ static int coroutine_fn qemu_rbd_co_truncate(BlockDriverState *bs,
                                              BdrvRequestFlags flags,
                                              Error **errp)
 {
+    BDRVRBDState *s = bs->opaque;
     int r;
 
     if (prealloc != PREALLOC_MODE_OFF) {
@@ -1079,7 +1192,9 @@ static int coroutine_fn qemu_rbd_co_truncate(BlockDriverState *bs,
         return -ENOTSUP;
     }
 
+    qemu_mutex_lock(&s->resize_lock);
     r = qemu_rbd_resize(bs, offset);
+    qemu_mutex_unlock(&s->resize_lock);
     if (r < 0) {
         error_setg_errno(errp, -r, "Failed to resize file");
         return r;
@@ -1217,9 +1332,14 @@ static void coroutine_fn qemu_rbd_co_invalidate_cache(BlockDriverState *bs,
                                                       Error **errp)
 {
     BDRVRBDState *s = bs->opaque;
-    int r = rbd_invalidate_cache(s->image);
-    if (r < 0) {
-        error_setg_errno(errp, -r, "Failed to invalidate the cache");
+    int i, r;
+
+    for (i = 0; i < s->nb_images; i++) {
+        r = rbd_invalidate_cache(s->images[i]);
+        if (r < 0) {
+            error_setg_errno(errp, -r, "Failed to invalidate the cache");
+            return;
+        }
     }
 }
 #endif
@@ -1298,6 +1418,10 @@ static BlockDriver bdrv_rbd = {
     .bdrv_co_invalidate_cache = qemu_rbd_co_invalidate_cache,
 #endif
 
+    .bdrv_attach_multiqueue_context = qemu_rbd_attach_multiqueue_context,
+    .bdrv_detach_multiqueue_context = qemu_rbd_detach_multiqueue_context,
+    .supports_multiqueue    = true,
+
     .strong_runtime_opts    = qemu_rbd_strong_runtime_opts,
 };
 
@@ -0,0 +1,643 @@
+/*
+ * Read cache filter driver
+ *
+ * The driver keeps recently read blocks of its child in RAM, or in another
+ * node such as a file on a local SSD, so that reading them again doesn't
+ * have to go to the child.  It is meant to be inserted above protocol nodes
+ * with high read latency (rbd, nfs, nbd, ...).
+ *
+ * Writes go through to the child and invalidate the cached blocks they
+ * touch.  The cache is only coherent if all writes to the child go through
+ * the filter, so it doesn't share the write permission on the child.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+
+#include "qapi/error.h"
+#include "qemu/cutils.h"
+#include "qemu/module.h"
+#include "qemu/option.h"
+#include "qemu/units.h"
+#include "block/block_int.h"
+#include "trace.h"
+
+#define READ_CACHE_OPT_SIZE "size"
+#define READ_CACHE_OPT_BLOCK_SIZE "block-size"
+
+#define READ_CACHE_DEFAULT_SIZE (256 * MiB)
+#define READ_CACHE_DEFAULT_BLOCK_SIZE (64 * KiB)
+#define READ_CACHE_MAX_BLOCK_SIZE (2 * MiB)
+
+/* How many consecutive missing blocks are read from the child at once */
+#define READ_CACHE_MAX_FILL_BLOCKS 16
+
+typedef struct ReadCacheEntry {
+    int64_t block;      /* block number in the child, key of s->index */
+    int64_t slot;       /* where the block is stored in the cache */
+    bool valid;         /* false while the block is being read */
+    bool invalidated;   /* removed from s->index while in use */
+    int refcnt;         /* requests using the slot, entry is pinned if > 0 */
+    QTAILQ_ENTRY(ReadCacheEntry) next;
+} ReadCacheEntry;
+
+typedef struct BDRVReadCacheState {
+    /* Node that stores the cached blocks, or NULL to store them in s->ram */
+    BdrvChild *cache;
+    uint8_t *ram;
+
+    int64_t block_size;
+    int64_t nb_slots;
+
+    /* Block number -> ReadCacheEntry */
+    GHashTable *index;
+    /* Entries in s->index, least recently used first */
+    QTAILQ_HEAD(, ReadCacheEntry) lru;
+
+    int64_t *free_slots;
+    int64_t nb_free_slots;
+
+    struct {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t hit_bytes;
+        uint64_t miss_bytes;
+        uint64_t evictions;
+    } stats;
+} BDRVReadCacheState;
+
+static QemuOptsList runtime_opts = {
+    .name = "read-cache",
+    .head = QTAILQ_HEAD_INITIALIZER(runtime_opts.head),
+    .desc = {
+        {
+            .name = READ_CACHE_OPT_SIZE,
+            .type = QEMU_OPT_SIZE,
+            .help = "Size of the cache, default 256M",
+        },
+        {
+            .name = READ_CACHE_OPT_BLOCK_SIZE,
+            .type = QEMU_OPT_SIZE,
+            .help = "Granularity of the cache, default 64k",
+        },
+        { /* end of list */ }
+    },
+};
+
+static ReadCacheEntry *read_cache_find(BDRVReadCacheState *s, int64_t block)
+{
+    return g_hash_table_lookup(s->index, &block);
+}
+
+static void read_cache_free_entry(BDRVReadCacheState *s, ReadCacheEntry *e)
+{
+    s->free_slots[s->nb_free_slots++] = e->slot;
+    g_free(e);
+}
+
+/*
+ * Removes @e from the cache.  If a request is still using its slot, the
+ * slot is only freed when the request is done with it.
+ */
+static void read_cache_remove(BDRVReadCacheState *s, ReadCacheEntry *e)
+{
+    assert(!e->invalidated);
+
+    g_hash_table_remove(s->index, &e->block);
+    QTAILQ_REMOVE(&s->lru, e, next);
+
+    if (e->refcnt) {
+        e->invalidated = true;
+    } else {
+        read_cache_free_entry(s, e);
+    }
+}
+
+static void read_cache_unref(BDRVReadCacheState *s, ReadCacheEntry *e)
+{
+    assert(e->refcnt > 0);
+    if (--e->refcnt == 0 && e->invalidated) {
+        read_cache_free_entry(s, e);
+    }
+}
+
+/*
+ * Adds an entry for @block that isn't valid yet and takes a reference to
+ * it, evicting the least recently used block if the cache is full.
+ * Returns NULL if all slots are in use.
+ */
+static ReadCacheEntry *read_cache_insert(BDRVReadCacheState *s, int64_t block)
+{
+    ReadCacheEntry *e;
+
+    if (!s->nb_free_slots) {
+        QTAILQ_FOREACH(e, &s->lru, next) {
+            if (e->valid && !e->refcnt) {
+                break;
+            }
+        }
+        if (!e) {
+            return NULL;
+        }
+        s->stats.evictions++;
+        read_cache_remove(s, e);
+    }
+
+    e = g_new0(ReadCacheEntry, 1);
+    e->block = block;
+    e->slot = s->free_slots[--s->nb_free_slots];
+    e->refcnt = 1;
+    g_hash_table_insert(s->index, &e->block, e);
+    QTAILQ_INSERT_TAIL(&s->lru, e, next);
+
+    return e;
+}
+
+static void read_cache_clear(BDRVReadCacheState *s)
+{
+    ReadCacheEntry *e, *next;
+
+    QTAILQ_FOREACH_SAFE(e, &s->lru, next, next) {
+        read_cache_remove(s, e);
+    }
+}
+
+/* Drops all cached blocks that overlap with the given range */
+static void read_cache_invalidate(BDRVReadCacheState *s, int64_t offset,
+                                  int64_t bytes)
+{
+    int64_t first = offset / s->block_size;
+    int64_t last = (offset + bytes - 1) / s->block_size;
+    ReadCacheEntry *e, *next;
+
+    if (!bytes) {
+        return;
+    }
+
+    if (last - first >= g_hash_table_size(s->index)) {
+        QTAILQ_FOREACH_SAFE(e, &s->lru, next, next) {
+            if (e->block >= first && e->block <= last) {
+                read_cache_remove(s, e);
+            }
+        }
+    } else {
+        for (int64_t block = first; block <= last; block++) {
+            e = read_cache_find(s, block);
+            if (e) {
+                read_cache_remove(s, e);
+            }
+        }
+    }
+}
+
+static int coroutine_fn read_cache_co_read_hit(BlockDriverState *bs,
+                                               ReadCacheEntry *e,
+                                               int64_t offset, int64_t bytes,
+                                               QEMUIOVector *qiov,
+                                               size_t qiov_offset, int flags)
+{
+    BDRVReadCacheState *s = bs->opaque;
+    int64_t block_offset = offset - e->block * s->block_size;
+    int ret;
+
+    QTAILQ_REMOVE(&s->lru, e, next);
+    QTAILQ_INSERT_TAIL(&s->lru, e, next);
+
+    if (!s->cache) {
+        qemu_iovec_from_buf(qiov, qiov_offset,
+                            s->ram + e->slot * s->block_size + block_offset,
+                            bytes);
+        ret = 0;
+    } else {
+        e->refcnt++;
+        ret = bdrv_co_preadv_part(s->cache,
+                                  e->slot * s->block_size + block_offset,
+                                  bytes, qiov, qiov_offset, 0);
+        if (ret < 0 && !e->invalidated) {
+            read_cache_remove(s, e);
+        }
+        read_cache_unref(s, e);
+
+        if (ret < 0) {
+            /* The cache is only a copy, so read the original */
+            ret = bdrv_co_preadv_part(bs->file, offset, bytes, qiov,
+                                      qiov_offset, flags);
+        }
+    }
+
+    s->stats.hits++;
+    s->stats.hit_bytes += bytes;
+    return ret;
+}
+
+/*
+ * Reads @nb_blocks uncached blocks starting at @first_block from the child
+ * and adds them to the cache.  [@offset, @offset + @bytes) is the part of
+ * them that the request wants.
+ */
+static int coroutine_fn read_cache_co_fill(BlockDriverState *bs,
+                                           int64_t first_block,
+                                           int nb_blocks,
+                                           int64_t offset, int64_t bytes,
+                                           QEMUIOVector *qiov,
+                                           size_t qiov_offset, int flags)
+{
+    BDRVReadCacheState *s = bs->opaque;
+    ReadCacheEntry *entries[READ_CACHE_MAX_FILL_BLOCKS];
+    int64_t start = first_block * s->block_size;
+    int64_t len = nb_blocks * s->block_size;
+    uint8_t *buf;
+    int i, ret;
+
+    buf = qemu_try_blockalign(bs->file->bs, len);
+    if (!buf) {
+        return -ENOMEM;
+    }
+
+    for (i = 0; i < nb_blocks; i++) {
+        entries[i] = read_cache_insert(s, first_block + i);
+    }
+
+    /* Reads beyond the end of the child return zeroes */
+    ret = bdrv_co_pread(bs->file, start, len, buf, flags);
+    trace_read_cache_fill(bs, start, len, ret);
+    if (ret >= 0) {
+        qemu_iovec_from_buf(qiov, qiov_offset, buf + (offset - start), bytes);
+    }
+
+    for (i = 0; i < nb_blocks; i++) {
+        ReadCacheEntry *e = entries[i];
+        uint8_t *block_buf = buf + i * s->block_size;
+        int r = ret;
+
+        if (!e) {
+            continue;
+        }
+        if (r >= 0 && !e->invalidated) {
+            if (!s->cache) {
+                memcpy(s->ram + e->slot * s->block_size, block_buf,
+                       s->block_size);
+            } else {
+                r = bdrv_co_pwrite(s->cache, e->slot * s->block_size,
+                                   s->block_size, block_buf, 0);
+            }
+        }
+        /* Writes to the child invalidate the entry while it is filled */
+        if (!e->invalidated) {
+            if (r >= 0) {
+                e->valid = true;
+            } else {
+                read_cache_remove(s, e);
+            }
+        }
+        read_cache_unref(s, e);
+    }
+
+    qemu_vfree(buf);
+
+    s->stats.misses += nb_blocks;
+    s->stats.miss_bytes += bytes;
+    return ret < 0 ? ret : 0;
+}
+
+static int coroutine_fn read_cache_co_preadv_part(BlockDriverState *bs,
+                                                  uint64_t offset,
+                                                  uint64_t bytes,
+                                                  QEMUIOVector *qiov,
+                                                  size_t qiov_offset,
+                                                  int flags)
+{
+    BDRVReadCacheState *s = bs->opaque;
+    int64_t last_block = (offset + bytes - 1) / s->block_size;
+    int ret;
+
+    if (bs->open_flags & BDRV_O_INACTIVE) {
+        /* The cache is dropped on activation, so don't fill it */
+        return bdrv_co_preadv_part(bs->file, offset, bytes, qiov, qiov_offset,
+                                   flags);
+    }
+
+    while (bytes) {
+        int64_t block = offset / s->block_size;
+        int64_t end = MIN(offset + bytes, (block + 1) * s->block_size);
+        ReadCacheEntry *e = read_cache_find(s, block);
+
+        if (e && e->valid) {
+            ret = read_cache_co_read_hit(bs, e, offset, end - offset, qiov,
+                                         qiov_offset, flags);
+        } else if (e) {
+            /* Another request is reading this block, don't wait for it */
+            ret = bdrv_co_preadv_part(bs->file, offset, end - offset, qiov,
+                                      qiov_offset, flags);
+        } else {
+            int nb_blocks = 1;
+
+            while (nb_blocks < READ_CACHE_MAX_FILL_BLOCKS &&
+                   block + nb_blocks <= last_block &&
+                   !read_cache_find(s, block + nb_blocks))
+            {
+                nb_blocks++;
+            }
+            end = MIN(offset + bytes, (block + nb_blocks) * s->block_size);
+
+            ret = read_cache_co_fill(bs, block, nb_blocks, offset,
+                                     end - offset, qiov, qiov_offset, flags);
+        }
+        if (ret < 0) {
+            return ret;
+        }
+
+        qiov_offset += end - offset;
+        bytes -= end - offset;
+        offset = end;
+    }
+
+    return 0;
+}
+
+/*
+ * Invalidate both before and after the write: before, so that fills that
+ * are in flight don't add old data, and after, so that reads that started
+ * while the write was in flight don't either.
+ */
+
+static int coroutine_fn read_cache_co_pwritev_part(BlockDriverState *bs,
+                                                   uint64_t offset,
+                                                   uint64_t bytes,
+                                                   QEMUIOVector *qiov,
+                                                   size_t qiov_offset,
+                                                   int flags)
+{
+    BDRVReadCacheState *s = bs->opaque;
+    int ret;
+
+    read_cache_invalidate(s, offset, bytes);
+    ret = bdrv_co_pwritev_part(bs->file, offset, bytes, qiov, qiov_offset,
+                               flags);
+    read_cache_invalidate(s, offset, bytes);
+
+    return ret;
+}
+
+static int coroutine_fn read_cache_co_pwrite_zeroes(BlockDriverState *bs,
+                                                    int64_t offset, int bytes,
+                                                    BdrvRequestFlags flags)
+{
+    BDRVReadCacheState *s = bs->opaque;
+    int ret;
+
+    read_cache_invalidate(s, offset, bytes);
+    ret = bdrv_co_pwrite_zeroes(bs->file, offset, bytes, flags);
+    read_cache_invalidate(s, offset, bytes);
+
+    return ret;
+}
+
+static int coroutine_fn read_cache_co_pdiscard(BlockDriverState *bs,
+                                               int64_t offset, int bytes)
+{
+    BDRVReadCacheState *s = bs->opaque;
+    int ret;
+
+    read_cache_invalidate(s, offset, bytes);
+    ret = bdrv_co_pdiscard(bs->file, offset, bytes);
+    read_cache_invalidate(s, offset, bytes);
+
+    return ret;
+}
+
+static int coroutine_fn read_cache_co_truncate(BlockDriverState *bs,
+                                               int64_t offset, bool exact,
+                                               PreallocMode prealloc,
+                                               BdrvRequestFlags flags,
+                                               Error **errp)
+{
+    BDRVReadCacheState *s = bs->opaque;
+    int ret;
+
+    /* The block at the old end of the child may change either way */
+    read_cache_clear(s);
+    ret = bdrv_co_truncate(bs->file, offset, exact, prealloc, flags, errp);
+    read_cache_clear(s);
+
+    return ret;
+}
+
+static int coroutine_fn read_cache_co_flush(BlockDriverState *bs)
+{
+    return bdrv_co_flush(bs->file->bs);
+}
+
+static int64_t read_cache_getlength(BlockDriverState *bs)
+{
+    return bdrv_getlength(bs->file->bs);
+}
+
+static void coroutine_fn read_cache_co_invalidate_cache(BlockDriverState *bs,
+                                                        Error **errp)
+{
+    BDRVReadCacheState *s = bs->opaque;
+
+    /* Someone else may have written to the child while we were inactive */
+    read_cache_clear(s);
+}
+
+static BlockStatsSpecific *read_cache_get_specific_stats(BlockDriverState *bs)
+{
+    BlockStatsSpecific *stats = g_new(BlockStatsSpecific, 1);
+    BDRVReadCacheState *s = bs->opaque;
+
+    stats->driver = BLOCKDEV_DRIVER_READ_CACHE;
+    stats->u.read_cache = (BlockStatsSpecificReadCache) {
+        .hits = s->stats.hits,
+        .misses = s->stats.misses,
+        .hit_bytes = s->stats.hit_bytes,
+        .miss_bytes = s->stats.miss_bytes,
+        .evictions = s->stats.evictions,
+        .cached_bytes = g_hash_table_size(s->index) * s->block_size,
+    };
+
+    return stats;
+}
+
+static void read_cache_child_perm(BlockDriverState *bs, BdrvChild *c,
+                                  BdrvChildRole role,
+                                  BlockReopenQueue *reopen_queue,
+                                  uint64_t perm, uint64_t shared,
+                                  uint64_t *nperm, uint64_t *nshared)
+{
+    if (!(role & BDRV_CHILD_FILTERED)) {
+        /* Cache child, nobody else may change the cached blocks */
+        *nperm = BLK_PERM_CONSISTENT_READ;
+        if (!(bs->open_flags & BDRV_O_INACTIVE)) {
+            *nperm |= BLK_PERM_WRITE;
+        }
+        *nshared = BLK_PERM_CONSISTENT_READ | BLK_PERM_WRITE_UNCHANGED;
+        return;
+    }
+
+    bdrv_default_perms(bs, c, role, reopen_queue, perm, shared,
+                       nperm, nshared);
+
+    /* Writes that bypass us would leave stale data in the cache */
+    *nshared &= ~(BLK_PERM_WRITE | BLK_PERM_RESIZE);
+}
+
+static int read_cache_open(BlockDriverState *bs, QDict *options, int flags,
+                           Error **errp)
+{
+    BDRVReadCacheState *s = bs->opaque;
+    Error *local_err = NULL;
+    QemuOpts *opts = NULL;
+    int64_t size;
+    int ret;
+
+    bs->file = bdrv_open_child(NULL, options, "file", bs, &child_of_bds,
+                               BDRV_CHILD_FILTERED | BDRV_CHILD_PRIMARY,
+                               false, errp);
+    if (!bs->file) {
+        return -EINVAL;
+    }
+
+    s->cache = bdrv_open_child(NULL, options, "cache", bs, &child_of_bds,
+                               BDRV_CHILD_METADATA, true, &local_err);
+    if (local_err) {
+        error_propagate(errp, local_err);
+        ret = -EINVAL;
+        goto fail;
+    }
+
+    opts = qemu_opts_create(&runtime_opts, NULL, 0, &error_abort);
+    if (!qemu_opts_absorb_qdict(opts, options, errp)) {
+        ret = -EINVAL;
+        goto fail;
+    }
+
+    size = qemu_opt_get_size(opts, READ_CACHE_OPT_SIZE,
+                             READ_CACHE_DEFAULT_SIZE);
+    s->block_size = qemu_opt_get_size(opts, READ_CACHE_OPT_BLOCK_SIZE,
+                                      READ_CACHE_DEFAULT_BLOCK_SIZE);
+
+    if (s->block_size < BDRV_SECTOR_SIZE ||
+        s->block_size > READ_CACHE_MAX_BLOCK_SIZE ||
+        !is_power_of_2(s->block_size))
+    {
+        error_setg(errp, "block-size must be a power of two between %llu "
+                   "and %d", BDRV_SECTOR_SIZE, READ_CACHE_MAX_BLOCK_SIZE);
+        ret = -EINVAL;
+        goto fail;
+    }
+    s->nb_slots = size / s->block_size;
+    if (!s->nb_slots) {
+        error_setg(errp, "size must be at least block-size");
+        ret = -EINVAL;
+        goto fail;
+    }
+    size = s->nb_slots * s->block_size;
+
+    if (s->cache) {
+        int64_t cache_len = bdrv_getlength(s->cache->bs);
+
+        if (cache_len < 0) {
+            error_setg_errno(errp, -cache_len,
+                             "Could not get the length of the cache node");
+            ret = cache_len;
+            goto fail;
+        }
+        if (cache_len < size) {
+            error_setg(errp, "The cache node is smaller than the cache size "
+                       "of %" PRId64 " bytes", size);
+            ret = -EINVAL;
+            goto fail;
+        }
+        if (bdrv_is_read_only(s->cache->bs)) {
+            error_setg(errp, "The cache node must be writable");
+            ret = -EINVAL;
+            goto fail;
+        }
+    } else {
+        s->ram = qemu_try_blockalign(bs->file->bs, size);
+        if (!s->ram) {
+            error_setg(errp, "Could not allocate %" PRId64 " bytes for the "
+                       "cache", size);
+            ret = -ENOMEM;
+            goto fail;
+        }
+    }
+
+    s->free_slots = g_new(int64_t, s->nb_slots);
+    for (s->nb_free_slots = 0; s->nb_free_slots < s->nb_slots;
+         s->nb_free_slots++)
+    {
+        /* Hand out the slots in ascending order */
+        s->free_slots[s->nb_free_slots] = s->nb_slots - 1 - s->nb_free_slots;
+    }
+    s->index = g_hash_table_new(g_int64_hash, g_int64_equal);
+    QTAILQ_INIT(&s->lru);
+
+    bs->supported_write_flags = BDRV_REQ_WRITE_UNCHANGED |
+        (BDRV_REQ_FUA & bs->file->bs->supported_write_flags);
+
+    bs->supported_zero_flags = BDRV_REQ_WRITE_UNCHANGED |
+        ((BDRV_REQ_FUA | BDRV_REQ_MAY_UNMAP | BDRV_REQ_NO_FALLBACK) &
+            bs->file->bs->supported_zero_flags);
+
+    ret = 0;
+fail:
+    if (ret < 0) {
+        if (s->cache) {
+            bdrv_unref_child(bs, s->cache);
+            s->cache = NULL;
+        }
+        bdrv_unref_child(bs, bs->file);
+        bs->file = NULL;
+    }
+    qemu_opts_del(opts);
+    return ret;
+}
+
+static void read_cache_close(BlockDriverState *bs)
+{
+    BDRVReadCacheState *s = bs->opaque;
+
+    read_cache_clear(s);
+    g_hash_table_destroy(s->index);
+    g_free(s->free_slots);
+    qemu_vfree(s->ram);
+
+    bdrv_unref_child(bs, s->cache);
+    s->cache = NULL;
+}
+
+static BlockDriver bdrv_read_cache = {
+    .format_name                = "read-cache",
+    .instance_size              = sizeof(BDRVReadCacheState),
+
+    .bdrv_open                  = read_cache_open,
+    .bdrv_close                 = read_cache_close,
+    .bdrv_child_perm            = read_cache_child_perm,
+
+    .bdrv_getlength             = read_cache_getlength,
+
+    .bdrv_co_preadv_part        = read_cache_co_preadv_part,
+    .bdrv_co_pwritev_part       = read_cache_co_pwritev_part,
+    .bdrv_co_pwrite_zeroes      = read_cache_co_pwrite_zeroes,
+    .bdrv_co_pdiscard           = read_cache_co_pdiscard,
+    .bdrv_co_truncate           = read_cache_co_truncate,
+    .bdrv_co_flush              = read_cache_co_flush,
+
+    .bdrv_co_invalidate_cache   = read_cache_co_invalidate_cache,
+    .bdrv_get_specific_stats    = read_cache_get_specific_stats,
+
+    .has_variable_length        = true,
+    .is_filter                  = true,
+};
+
+static void bdrv_read_cache_init(void)
+{
+    bdrv_register(&bdrv_read_cache);
+}
+
+block_init(bdrv_read_cache_init);
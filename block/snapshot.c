@@ -252,6 +252,7 @@ int bdrv_snapshot_goto(BlockDriverState *bs,
 
     if (drv->bdrv_snapshot_goto) {
         ret = drv->bdrv_snapshot_goto(bs, snapshot_id);
+        bdrv_alloc_index_invalidate_above(bs);
         if (ret < 0) {
             error_setg_errno(errp, -ret, "Failed to load snapshot");
         }
@@ -363,6 +364,53 @@ int bdrv_snapshot_delete(BlockDriverState *bs,
     return ret;
 }
 
+bool bdrv_can_attach_vmstate(BlockDriverState *bs)
+{
+    BlockDriver *drv = bs->drv;
+    BlockDriverState *fallback_bs = bdrv_snapshot_fallback(bs);
+
+    if (!drv) {
+        return false;
+    }
+    if (drv->bdrv_snapshot_attach_vmstate) {
+        return true;
+    }
+    return fallback_bs && bdrv_can_attach_vmstate(fallback_bs);
+}
+
+int bdrv_snapshot_attach_vmstate(BlockDriverState *bs,
+                                 const char *name,
+                                 uint64_t vm_state_size,
+                                 Error **errp)
+{
+    BlockDriver *drv = bs->drv;
+    BlockDriverState *fallback_bs = bdrv_snapshot_fallback(bs);
+    int ret;
+
+    if (!drv) {
+        error_setg(errp, QERR_DEVICE_HAS_NO_MEDIUM, bdrv_get_device_name(bs));
+        return -ENOMEDIUM;
+    }
+
+    /* drain all pending i/o before changing the snapshot */
+    bdrv_drained_begin(bs);
+
+    if (drv->bdrv_snapshot_attach_vmstate) {
+        ret = drv->bdrv_snapshot_attach_vmstate(bs, name, vm_state_size, errp);
+    } else if (fallback_bs) {
+        ret = bdrv_snapshot_attach_vmstate(fallback_bs, name, vm_state_size,
+                                           errp);
+    } else {
+        error_setg(errp, "Block format '%s' used by device '%s' "
+                   "does not support live snapshots",
+                   drv->format_name, bdrv_get_device_name(bs));
+        ret = -ENOTSUP;
+    }
+
+    bdrv_drained_end(bs);
+    return ret;
+}
+
 int bdrv_snapshot_list(BlockDriverState *bs,
                        QEMUSnapshotInfo **psn_info)
 {
@@ -15,6 +15,7 @@
 #include "trace.h"
 #include "block/block_int.h"
 #include "block/blockjob_int.h"
+#include "block/aio_task.h"
 #include "qapi/error.h"
 #include "qapi/qmp/qerror.h"
 #include "qapi/qmp/qdict.h"
@@ -29,6 +30,16 @@ enum {
      * that populating contiguous regions of the image is efficient.
      */
     STREAM_CHUNK = 512 * 1024, /* in bytes */
+
+    /*
+     * Chunks grow up to this size while the extents to copy are
+     * contiguous, so that fully allocated backing files need fewer
+     * requests.
+     */
+    STREAM_MAX_CHUNK = 8 * 1024 * 1024, /* in bytes */
+
+    /* Number of chunks populated in parallel */
+    STREAM_MAX_WORKERS = 8,
 };
 
 typedef struct StreamBlockJob {
@@ -40,8 +51,21 @@ typedef struct StreamBlockJob {
     BlockdevOnError on_error;
     char *backing_file_str;
     bool bs_read_only;
+
+    /* First chunk that failed since the last retry, or INT64_MAX */
+    int64_t error_offset;
+    int error_ret;
+    /* Bytes of all chunks that failed since the last retry */
+    int64_t error_bytes;
 } StreamBlockJob;
 
+typedef struct StreamTask {
+    AioTask task;
+    StreamBlockJob *s;
+    int64_t offset;
+    int64_t bytes;
+} StreamTask;
+
 static int coroutine_fn stream_populate(BlockBackend *blk,
                                         int64_t offset, uint64_t bytes)
 {
@@ -102,13 +126,77 @@ static void stream_clean(Job *job)
     g_free(s->backing_file_str);
 }
 
+static void stream_chunk_failed(StreamBlockJob *s, int64_t offset,
+                                int64_t bytes, int ret)
+{
+    s->error_bytes += bytes;
+    if (offset < s->error_offset) {
+        s->error_offset = offset;
+        s->error_ret = ret;
+    }
+}
+
+static int coroutine_fn stream_task_entry(AioTask *task)
+{
+    StreamTask *t = container_of(task, StreamTask, task);
+    StreamBlockJob *s = t->s;
+    int ret;
+
+    ret = stream_populate(s->common.blk, t->offset, t->bytes);
+    if (ret < 0) {
+        stream_chunk_failed(s, t->offset, t->bytes, ret);
+        return ret;
+    }
+    job_progress_update(&s->common.job, t->bytes);
+    return 0;
+}
+
+/*
+ * Wait for the chunks in flight after a failure and apply the error
+ * action.  To retry, go back to the first chunk that failed; the chunks
+ * that were populated after it are populated again, so their size is
+ * added to the remaining work.  Ignored chunks count as done.
+ *
+ * Returns the action, and the error in *error unless it is a retry.
+ */
+static BlockErrorAction coroutine_fn stream_handle_error(StreamBlockJob *s,
+                                                         AioTaskPool **pool,
+                                                         int64_t *offset,
+                                                         int *error)
+{
+    BlockErrorAction action;
+
+    aio_task_pool_wait_all(*pool);
+    action = block_job_error_action(&s->common, s->on_error, true,
+                                    -s->error_ret);
+    if (action == BLOCK_ERROR_ACTION_STOP) {
+        job_progress_increase_remaining(&s->common.job,
+                                        *offset - s->error_offset -
+                                        s->error_bytes);
+        *offset = s->error_offset;
+    } else {
+        job_progress_update(&s->common.job, s->error_bytes);
+        if (*error == 0) {
+            *error = s->error_ret;
+        }
+    }
+    s->error_offset = INT64_MAX;
+    s->error_bytes = 0;
+
+    /* The pool remembers the error, start over with a new one */
+    aio_task_pool_free(*pool);
+    *pool = aio_task_pool_new(STREAM_MAX_WORKERS);
+    return action;
+}
+
 static int coroutine_fn stream_run(Job *job, Error **errp)
 {
     StreamBlockJob *s = container_of(job, StreamBlockJob, common.job);
-    BlockBackend *blk = s->common.blk;
     BlockDriverState *unfiltered_bs = bdrv_skip_filters(s->target_bs);
+    AioTaskPool *pool;
     int64_t len;
     int64_t offset = 0;
+    int64_t chunk = STREAM_CHUNK;
     uint64_t delay_ns = 0;
     int error = 0;
     int64_t n = 0; /* bytes */
@@ -124,10 +212,25 @@ static int coroutine_fn stream_run(Job *job, Error **errp)
     }
     job_progress_set_remaining(&s->common.job, len);
 
-    for ( ; offset < len; offset += n) {
+    pool = aio_task_pool_new(STREAM_MAX_WORKERS);
+    s->error_offset = INT64_MAX;
+
+    while (true) {
         bool copy;
         int ret;
 
+        if (offset >= len) {
+            aio_task_pool_wait_all(pool);
+        }
+        if (s->error_offset != INT64_MAX &&
+            stream_handle_error(s, &pool, &offset, &error) ==
+            BLOCK_ERROR_ACTION_REPORT) {
+            break;
+        }
+        if (offset >= len) {
+            break;
+        }
+
         /* Note that even when no rate limit is applied we need to yield
          * with no pending I/O here so that bdrv_drain_all() returns.
          */
@@ -138,7 +241,7 @@ static int coroutine_fn stream_run(Job *job, Error **errp)
 
         copy = false;
 
-        ret = bdrv_is_allocated(unfiltered_bs, offset, STREAM_CHUNK, &n);
+        ret = bdrv_is_allocated(unfiltered_bs, offset, chunk, &n);
         if (ret == 1) {
             /* Allocated in the top, no need to copy.  */
         } else if (ret >= 0) {
@@ -155,33 +258,41 @@ static int coroutine_fn stream_run(Job *job, Error **errp)
             copy = (ret > 0);
         }
         trace_stream_one_iteration(s, offset, n, ret);
-        if (copy) {
-            ret = stream_populate(blk, offset, n);
-        }
         if (ret < 0) {
-            BlockErrorAction action =
-                block_job_error_action(&s->common, s->on_error, true, -ret);
-            if (action == BLOCK_ERROR_ACTION_STOP) {
-                n = 0;
-                continue;
-            }
-            if (error == 0) {
-                error = ret;
-            }
-            if (action == BLOCK_ERROR_ACTION_REPORT) {
-                break;
-            }
+            /* n is not valid, skip or retry a chunk of the default size */
+            n = MIN(STREAM_CHUNK, len - offset);
+            stream_chunk_failed(s, offset, n, ret);
+            offset += n;
+            continue;
         }
 
-        /* Publish progress */
-        job_progress_update(&s->common.job, n);
         if (copy) {
+            StreamTask *t = g_new(StreamTask, 1);
+
+            assert(n < SIZE_MAX);
+            *t = (StreamTask) {
+                .task.func = stream_task_entry,
+                .s = s,
+                .offset = offset,
+                .bytes = n,
+            };
+            aio_task_pool_start_task(pool, &t->task);
+
+            /* Use larger chunks while the extents to copy are large */
+            chunk = n == chunk ? MIN(chunk * 2, STREAM_MAX_CHUNK)
+                               : STREAM_CHUNK;
             delay_ns = block_job_ratelimit_get_delay(&s->common, n);
         } else {
+            /* Publish progress */
+            job_progress_update(&s->common.job, n);
             delay_ns = 0;
         }
+        offset += n;
     }
 
+    aio_task_pool_wait_all(pool);
+    aio_task_pool_free(pool);
+
     /* Do not remove the backing file if an error was there but ignored. */
     return error;
 }
@@ -23,6 +23,7 @@
  */
 
 #include "qemu/osdep.h"
+#include <math.h>
 #include "sysemu/block-backend.h"
 #include "block/throttle-groups.h"
 #include "qemu/throttle-options.h"
@@ -62,6 +63,15 @@ static void timer_cb(ThrottleGroupMember *tgm, bool is_write);
  * blk_set_aio_context()). Therefore in this file a thread will
  * access some other ThrottleGroupMember's timers only after verifying that
  * that ThrottleGroupMember has throttled requests in the queue.
+ *
+ * So that members in different AioContexts don't all have to take the lock
+ * for every request, a member whose request didn't have to wait also gets
+ * a budget: a share of the I/O that the group can still do without
+ * throttling, accounted in advance. Its next requests use up the budget
+ * without taking the lock. Whenever any member takes the lock, all budgets
+ * are given back to the group first, so the decisions taken with the lock
+ * held (and the round-robin fairness between members) see the I/O that
+ * was actually done.
  */
 struct ThrottleGroup {
     Object parent_obj;
@@ -70,9 +80,10 @@ struct ThrottleGroup {
     bool is_initialized;
     char *name; /* This is constant during the lifetime of the group */
 
-    QemuMutex lock; /* This lock protects the following four fields */
+    QemuMutex lock; /* This lock protects the following five fields */
     ThrottleState ts;
     QLIST_HEAD(, ThrottleGroupMember) head;
+    unsigned nb_members;
     ThrottleGroupMember *tokens[2];
     bool any_timer_armed[2];
     QEMUClockType clock_type;
@@ -349,6 +360,101 @@ static void schedule_next_request(ThrottleGroupMember *tgm, bool is_write)
     }
 }
 
+/* Perform an I/O request with the budget of a ThrottleGroupMember if it is
+ * large enough. This does not need the ThrottleGroup lock.
+ *
+ * @tgm:       the current ThrottleGroupMember
+ * @bytes:     the number of bytes for this I/O
+ * @is_write:  the type of operation (read/write)
+ * @ret:       whether the budget was large enough
+ */
+static bool throttle_group_take_budget(ThrottleGroupMember *tgm,
+                                       int64_t bytes, bool is_write)
+{
+    double units;
+    bool ret = false;
+
+    qemu_spin_lock(&tgm->budget_lock);
+    units = throttle_op_units(tgm->budget_op_size, bytes);
+    if (tgm->budget_bytes[is_write] >= bytes &&
+        tgm->budget_units[is_write] >= units) {
+        tgm->budget_bytes[is_write] -= bytes;
+        tgm->budget_units[is_write] -= units;
+        ret = true;
+    }
+    qemu_spin_unlock(&tgm->budget_lock);
+
+    return ret;
+}
+
+static double throttle_group_budget_finite(double budget)
+{
+    return isinf(budget) ? 0 : budget;
+}
+
+/* Give the unused budgets of all members back to the group.
+ *
+ * This assumes that tg->lock is held.
+ *
+ * @tg:  the ThrottleGroup
+ */
+static void throttle_group_revoke_budgets(ThrottleGroup *tg)
+{
+    ThrottleGroupMember *tgm;
+    int i;
+
+    QLIST_FOREACH(tgm, &tg->head, round_robin) {
+        qemu_spin_lock(&tgm->budget_lock);
+        for (i = 0; i < 2; i++) {
+            double bytes = throttle_group_budget_finite(tgm->budget_bytes[i]);
+            double units = throttle_group_budget_finite(tgm->budget_units[i]);
+
+            if (bytes || units) {
+                throttle_account_units(&tg->ts, i, -bytes, -units);
+            }
+            tgm->budget_bytes[i] = 0;
+            tgm->budget_units[i] = 0;
+        }
+        qemu_spin_unlock(&tgm->budget_lock);
+    }
+}
+
+/* Give a ThrottleGroupMember a budget for its next requests if the group
+ * is not throttling this type of operation right now. Each member can get
+ * at most a share of the I/O that is left before throttling starts, so
+ * the others still find enough of it.
+ *
+ * This assumes that tg->lock is held.
+ *
+ * @tgm:       the current ThrottleGroupMember
+ * @is_write:  the type of operation (read/write)
+ */
+static void throttle_group_grant_budget(ThrottleGroupMember *tgm,
+                                        bool is_write)
+{
+    ThrottleGroup *tg = container_of(tgm->throttle_state, ThrottleGroup, ts);
+    double bytes, units;
+
+    if (qatomic_read(&tgm->io_limits_disabled) ||
+        tg->any_timer_armed[is_write] || tgm->pending_reqs[is_write]) {
+        return;
+    }
+
+    throttle_get_headroom(&tg->ts, tg->clock_type, is_write, &bytes, &units);
+    bytes /= 2 * tg->nb_members;
+    units /= 2 * tg->nb_members;
+
+    throttle_account_units(&tg->ts, is_write,
+                           throttle_group_budget_finite(bytes),
+                           throttle_group_budget_finite(units));
+
+    qemu_spin_lock(&tgm->budget_lock);
+    tgm->budget_bytes[is_write] = bytes;
+    tgm->budget_units[is_write] = units;
+    tgm->budget_op_size = tg->ts.cfg.op_size;
+    qemu_spin_unlock(&tgm->budget_lock);
+}
+
 /* Check if an I/O request needs to be throttled, wait and set a timer
  * if necessary, and schedule the next request using a round robin
  * algorithm.
@@ -367,7 +473,12 @@ void coroutine_fn throttle_group_co_io_limits_intercept(ThrottleGroupMember *tgm
 
     assert(bytes >= 0);
 
+    if (throttle_group_take_budget(tgm, bytes, is_write)) {
+        return;
+    }
+
     qemu_mutex_lock(&tg->lock);
+    throttle_group_revoke_budgets(tg);
 
     /* First we check if this I/O has to be throttled. */
     token = next_throttle_token(tgm, is_write);
@@ -383,6 +494,7 @@ void coroutine_fn throttle_group_co_io_limits_intercept(ThrottleGroupMember *tgm
         qemu_co_mutex_unlock(&tgm->throttled_reqs_lock);
         qemu_mutex_lock(&tg->lock);
         tgm->pending_reqs[is_write]--;
+        throttle_group_revoke_budgets(tg);
     }
 
     /* The I/O will be executed, so do the accounting */
@@ -391,6 +503,8 @@ void coroutine_fn throttle_group_co_io_limits_intercept(ThrottleGroupMember *tgm
     /* Schedule the next request */
     schedule_next_request(tgm, is_write);
 
+    throttle_group_grant_budget(tgm, is_write);
+
     qemu_mutex_unlock(&tg->lock);
 }
 
@@ -474,6 +588,7 @@ void throttle_group_config(ThrottleGroupMember *tgm, ThrottleConfig *cfg)
     ThrottleState *ts = tgm->throttle_state;
     ThrottleGroup *tg = container_of(ts, ThrottleGroup, ts);
     qemu_mutex_lock(&tg->lock);
+    throttle_group_revoke_budgets(tg);
     throttle_config(ts, tg->clock_type, cfg);
     qemu_mutex_unlock(&tg->lock);
 
@@ -549,6 +664,12 @@ void throttle_group_register_tgm(ThrottleGroupMember *tgm,
     tgm->aio_context = ctx;
     qatomic_set(&tgm->restart_pending, 0);
 
+    qemu_spin_init(&tgm->budget_lock);
+    for (i = 0; i < 2; i++) {
+        tgm->budget_bytes[i] = 0;
+        tgm->budget_units[i] = 0;
+    }
+
     QEMU_LOCK_GUARD(&tg->lock);
     /* If the ThrottleGroup is new set this ThrottleGroupMember as the token */
     for (i = 0; i < 2; i++) {
@@ -558,6 +679,7 @@ void throttle_group_register_tgm(ThrottleGroupMember *tgm,
     }
 
     QLIST_INSERT_HEAD(&tg->head, tgm, round_robin);
+    tg->nb_members++;
 
     throttle_timers_init(&tgm->throttle_timers,
                          tgm->aio_context,
@@ -596,6 +718,8 @@ void throttle_group_unregister_tgm(ThrottleGroupMember *tgm)
     AIO_WAIT_WHILE(tgm->aio_context, qatomic_read(&tgm->restart_pending) > 0);
 
     WITH_QEMU_LOCK_GUARD(&tg->lock) {
+        throttle_group_revoke_budgets(tg);
+
         for (i = 0; i < 2; i++) {
             assert(tgm->pending_reqs[i] == 0);
             assert(qemu_co_queue_empty(&tgm->throttled_reqs[i]));
@@ -612,6 +736,7 @@ void throttle_group_unregister_tgm(ThrottleGroupMember *tgm)
 
         /* remove the current tgm from the list */
         QLIST_REMOVE(tgm, round_robin);
+        tg->nb_members--;
         throttle_timers_destroy(&tgm->throttle_timers);
     }
 
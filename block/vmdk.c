@@ -35,6 +35,8 @@
 #include "qemu/bswap.h"
 #include "migration/blocker.h"
 #include "qemu/cutils.h"
+#include "qemu/units.h"
+#include "block/thread-pool.h"
 #include <zlib.h>
 
 #define VMDK3_MAGIC (('C' << 24) | ('O' << 16) | ('W' << 8) | 'D')
@@ -129,7 +131,14 @@ typedef struct VMDKSESparseVolatileHeader {
     uint8_t pad[480];
 } QEMU_PACKED VMDKSESparseVolatileHeader;
 
-#define L2_CACHE_SIZE 16
+/* Grain tables cached per extent by default: all of them, up to 4 MiB */
+#define VMDK_L2_CACHE_DEFAULT_SIZE (4 * MiB)
+#define VMDK_L2_CACHE_MIN_ENTRIES 16
+
+/* Maximum number of grains of an image decompressed at the same time */
+#define VMDK_MAX_THREADS 8
+
+#define VMDK_OPT_L2_CACHE_SIZE "l2-cache-size"
 
 typedef struct VmdkExtent {
     BdrvChild *file;
@@ -153,9 +162,12 @@ typedef struct VmdkExtent {
     uint32_t l1_entry_sectors;
 
     unsigned int l2_size;
+    unsigned int l2_cache_entries;
     void *l2_cache;
-    uint32_t l2_cache_offsets[L2_CACHE_SIZE];
-    uint32_t l2_cache_counts[L2_CACHE_SIZE];
+    uint32_t *l2_cache_offsets;     /* 0 if the entry is free */
+    bool *l2_cache_used;            /* used since the clock hand passed */
+    unsigned int l2_cache_hand;
+    GHashTable *l2_cache_index;     /* l2 offset -> entry index + 1 */
 
     int64_t cluster_sectors;
     int64_t next_cluster_sector;
@@ -174,6 +186,11 @@ typedef struct BDRVVmdkState {
     VmdkExtent *extents;
     Error *migration_blocker;
     char *create_type;
+    uint64_t l2_cache_size;     /* per extent, 0 for the default */
+
+    /* Decompression tasks in the thread pool */
+    int nb_threads;
+    CoQueue thread_task_queue;
 } BDRVVmdkState;
 
 typedef struct VmdkMetaData {
@@ -270,6 +287,11 @@ static void vmdk_free_extents(BlockDriverState *bs)
         e = &s->extents[i];
         g_free(e->l1_table);
         g_free(e->l2_cache);
+        g_free(e->l2_cache_offsets);
+        g_free(e->l2_cache_used);
+        if (e->l2_cache_index) {
+            g_hash_table_destroy(e->l2_cache_index);
+        }
         g_free(e->l1_backup_table);
         g_free(e->type);
         if (e->file != bs->file) {
@@ -524,8 +546,11 @@ static int vmdk_add_extent(BlockDriverState *bs,
 static int vmdk_init_tables(BlockDriverState *bs, VmdkExtent *extent,
                             Error **errp)
 {
+    BDRVVmdkState *s = bs->opaque;
     int ret;
     size_t l1_size;
+    uint64_t l2_size_bytes = extent->entry_size * extent->l2_size;
+    uint64_t entries;
     int i;
 
     /* read the L1 table */
@@ -578,8 +603,19 @@ static int vmdk_init_tables(BlockDriverState *bs, VmdkExtent *extent,
         }
     }
 
-    extent->l2_cache =
-        g_malloc(extent->entry_size * extent->l2_size * L2_CACHE_SIZE);
+    if (s->l2_cache_size) {
+        entries = s->l2_cache_size / l2_size_bytes;
+    } else {
+        entries = MAX(VMDK_L2_CACHE_DEFAULT_SIZE / l2_size_bytes,
+                      VMDK_L2_CACHE_MIN_ENTRIES);
+    }
+    entries = MAX(MIN(entries, extent->l1_size), 1);
+
+    extent->l2_cache_entries = entries;
+    extent->l2_cache = g_malloc(l2_size_bytes * entries);
+    extent->l2_cache_offsets = g_new0(uint32_t, entries);
+    extent->l2_cache_used = g_new0(bool, entries);
+    extent->l2_cache_index = g_hash_table_new(NULL, NULL);
     return 0;
  fail_l1b:
     g_free(extent->l1_backup_table);
@@ -1253,6 +1289,19 @@ exit:
     return ret;
 }
 
+static QemuOptsList vmdk_runtime_opts = {
+    .name = "vmdk",
+    .head = QTAILQ_HEAD_INITIALIZER(vmdk_runtime_opts.head),
+    .desc = {
+        {
+            .name = VMDK_OPT_L2_CACHE_SIZE,
+            .type = QEMU_OPT_SIZE,
+            .help = "Maximum grain table cache size of each extent",
+        },
+        { /* end of list */ }
+    },
+};
+
 static int vmdk_open(BlockDriverState *bs, QDict *options, int flags,
                      Error **errp)
 {
@@ -1260,6 +1309,15 @@ static int vmdk_open(BlockDriverState *bs, QDict *options, int flags,
     int ret;
     BDRVVmdkState *s = bs->opaque;
     uint32_t magic;
+    QemuOpts *opts;
+
+    opts = qemu_opts_create(&vmdk_runtime_opts, NULL, 0, &error_abort);
+    if (!qemu_opts_absorb_qdict(opts, options, errp)) {
+        qemu_opts_del(opts);
+        return -EINVAL;
+    }
+    s->l2_cache_size = qemu_opt_get_size(opts, VMDK_OPT_L2_CACHE_SIZE, 0);
+    qemu_opts_del(opts);
 
     bs->file = bdrv_open_child(NULL, options, "file", bs, &child_of_bds,
                                BDRV_CHILD_IMAGE, false, errp);
@@ -1308,6 +1366,7 @@ static int vmdk_open(BlockDriverState *bs, QDict *options, int flags,
         goto fail;
     }
     qemu_co_mutex_init(&s->lock);
+    qemu_co_queue_init(&s->thread_task_queue);
 
     /* Disable migration when VMDK images are used */
     error_setg(&s->migration_blocker, "The vmdk format used by node '%s' "
@@ -1470,6 +1529,31 @@ static int vmdk_L2update(VmdkExtent *extent, VmdkMetaData *m_data,
     return VMDK_OK;
 }
 
+/*
+ * Pick the cache entry to load a grain table into with the clock
+ * algorithm, and drop the table it holds.
+ */
+static unsigned int vmdk_l2_cache_evict(VmdkExtent *extent)
+{
+    unsigned int i;
+
+    for (;;) {
+        i = extent->l2_cache_hand;
+        extent->l2_cache_hand = (i + 1) % extent->l2_cache_entries;
+        if (!extent->l2_cache_used[i]) {
+            break;
+        }
+        extent->l2_cache_used[i] = false;
+    }
+
+    if (extent->l2_cache_offsets[i]) {
+        g_hash_table_remove(extent->l2_cache_index,
+                            GUINT_TO_POINTER(extent->l2_cache_offsets[i]));
+        extent->l2_cache_offsets[i] = 0;
+    }
+    return i;
+}
+
 /**
  * get_cluster_offset
  *
@@ -1500,8 +1584,7 @@ static int get_cluster_offset(BlockDriverState *bs,
                               uint64_t skip_end_bytes)
 {
     unsigned int l1_index, l2_offset, l2_index;
-    int min_index, i, j;
-    uint32_t min_count;
+    unsigned int i;
     void *l2_table;
     bool zeroed = false;
     int64_t ret;
@@ -1554,28 +1637,17 @@ static int get_cluster_offset(BlockDriverState *bs,
     if (!l2_offset) {
         return VMDK_UNALLOC;
     }
-    for (i = 0; i < L2_CACHE_SIZE; i++) {
-        if (l2_offset == extent->l2_cache_offsets[i]) {
-            /* increment the hit count */
-            if (++extent->l2_cache_counts[i] == 0xffffffff) {
-                for (j = 0; j < L2_CACHE_SIZE; j++) {
-                    extent->l2_cache_counts[j] >>= 1;
-                }
-            }
-            l2_table = (char *)extent->l2_cache + (i * l2_size_bytes);
-            goto found;
-        }
-    }
-    /* not found: load a new entry in the least used one */
-    min_index = 0;
-    min_count = 0xffffffff;
-    for (i = 0; i < L2_CACHE_SIZE; i++) {
-        if (extent->l2_cache_counts[i] < min_count) {
-            min_count = extent->l2_cache_counts[i];
-            min_index = i;
-        }
-    }
-    l2_table = (char *)extent->l2_cache + (min_index * l2_size_bytes);
+    i = GPOINTER_TO_UINT(g_hash_table_lookup(extent->l2_cache_index,
+                                             GUINT_TO_POINTER(l2_offset)));
+    if (i) {
+        i--;
+        extent->l2_cache_used[i] = true;
+        l2_table = (char *)extent->l2_cache + ((size_t)i * l2_size_bytes);
+        goto found;
+    }
+    /* not found: load it in place of an entry that wasn't used recently */
+    i = vmdk_l2_cache_evict(extent);
+    l2_table = (char *)extent->l2_cache + ((size_t)i * l2_size_bytes);
     BLKDBG_EVENT(extent->file, BLKDBG_L2_LOAD);
     if (bdrv_pread(extent->file,
                 (int64_t)l2_offset * 512,
@@ -1585,8 +1657,10 @@ static int get_cluster_offset(BlockDriverState *bs,
         return VMDK_ERROR;
     }
 
-    extent->l2_cache_offsets[min_index] = l2_offset;
-    extent->l2_cache_counts[min_index] = 1;
+    extent->l2_cache_offsets[i] = l2_offset;
+    extent->l2_cache_used[i] = true;
+    g_hash_table_insert(extent->l2_cache_index, GUINT_TO_POINTER(l2_offset),
+                        GUINT_TO_POINTER(i + 1));
  found:
     l2_index = ((offset >> 9) / extent->cluster_sectors) % extent->l2_size;
     if (m_data) {
@@ -1820,9 +1894,47 @@ static int vmdk_write_extent(VmdkExtent *extent, int64_t cluster_offset,
     return ret;
 }
 
-static int vmdk_read_extent(VmdkExtent *extent, int64_t cluster_offset,
-                            int64_t offset_in_cluster, QEMUIOVector *qiov,
-                            int bytes)
+typedef struct VmdkDecompressData {
+    uint8_t *dest;
+    uLongf dest_len;
+    const uint8_t *src;
+    uLong src_len;
+    int ret;
+} VmdkDecompressData;
+
+static int vmdk_decompress_func(void *opaque)
+{
+    VmdkDecompressData *d = opaque;
+
+    d->ret = uncompress(d->dest, &d->dest_len, d->src, d->src_len);
+    return 0;
+}
+
+/*
+ * Decompress a grain in the thread pool, so that the grains read by
+ * concurrent requests are decompressed in parallel.
+ */
+static int coroutine_fn vmdk_co_decompress(BlockDriverState *bs,
+                                           VmdkDecompressData *d)
+{
+    BDRVVmdkState *s = bs->opaque;
+
+    while (s->nb_threads >= VMDK_MAX_THREADS) {
+        qemu_co_queue_wait(&s->thread_task_queue, NULL);
+    }
+    s->nb_threads++;
+    thread_pool_submit_co(aio_get_thread_pool(bdrv_get_aio_context(bs)),
+                          vmdk_decompress_func, d);
+    s->nb_threads--;
+    qemu_co_queue_next(&s->thread_task_queue);
+
+    return d->ret;
+}
+
+static int coroutine_fn
+vmdk_read_extent(BlockDriverState *bs, VmdkExtent *extent,
+                 int64_t cluster_offset, int64_t offset_in_cluster,
+                 QEMUIOVector *qiov, int bytes)
 {
     int ret;
     int cluster_bytes, buf_bytes;
@@ -1830,7 +1942,7 @@ static int vmdk_read_extent(VmdkExtent *extent, int64_t cluster_offset,
     uint8_t *uncomp_buf;
     uint32_t data_len;
     VmdkGrainMarker *marker;
-    uLongf buf_len;
+    VmdkDecompressData d;
 
 
     if (!extent->compressed) {
@@ -1856,7 +1968,6 @@ static int vmdk_read_extent(VmdkExtent *extent, int64_t cluster_offset,
         goto out;
     }
     compressed_data = cluster_buf;
-    buf_len = cluster_bytes;
     data_len = cluster_bytes;
     if (extent->has_marker) {
         marker = (VmdkGrainMarker *)cluster_buf;
@@ -1867,14 +1978,20 @@ static int vmdk_read_extent(VmdkExtent *extent, int64_t cluster_offset,
         ret = -EINVAL;
         goto out;
     }
-    ret = uncompress(uncomp_buf, &buf_len, compressed_data, data_len);
+    d = (VmdkDecompressData) {
+        .dest = uncomp_buf,
+        .dest_len = cluster_bytes,
+        .src = compressed_data,
+        .src_len = data_len,
+    };
+    ret = vmdk_co_decompress(bs, &d);
     if (ret != Z_OK) {
         ret = -EINVAL;
         goto out;
 
     }
     if (offset_in_cluster < 0 ||
-            offset_in_cluster + bytes > buf_len) {
+            offset_in_cluster + bytes > d.dest_len) {
         ret = -EINVAL;
         goto out;
     }
@@ -1940,8 +2057,18 @@ vmdk_co_preadv(BlockDriverState *bs, uint64_t offset, uint64_t bytes,
             qemu_iovec_reset(&local_qiov);
             qemu_iovec_concat(&local_qiov, qiov, bytes_done, n_bytes);
 
-            ret = vmdk_read_extent(extent, cluster_offset, offset_in_cluster,
-                                   &local_qiov, n_bytes);
+            /*
+             * Compressed grains are never rewritten, so other requests can
+             * look up their grains while this one is being decompressed.
+             */
+            if (extent->compressed) {
+                qemu_co_mutex_unlock(&s->lock);
+            }
+            ret = vmdk_read_extent(bs, extent, cluster_offset,
+                                   offset_in_cluster, &local_qiov, n_bytes);
+            if (extent->compressed) {
+                qemu_co_mutex_lock(&s->lock);
+            }
             if (ret) {
                 goto fail;
             }
@@ -0,0 +1,1145 @@
+/*
+ * Writeback cache filter driver
+ *
+ * Writes to the filter are appended to a log on another node, typically on
+ * a local NVMe device, and are completed as soon as the log write is.  A
+ * background coroutine destages the logged writes to the child in log
+ * order.  Reads of data that hasn't been destaged yet are served from the
+ * log.
+ *
+ * A flush only needs to flush the log: everything that was written before
+ * is in the log, and will reach the child even after a crash, because the
+ * log is replayed when the node is opened.  Every record is checksummed and
+ * carries a sequence number, and replay stops at the first record that is
+ * missing or broken, so what is recovered is always a prefix of the writes
+ * in the order they were submitted.
+ *
+ * The cache is only coherent if all writes to the child go through the
+ * filter, so it doesn't share the write permission on the child.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+
+#include "qapi/error.h"
+#include "qemu/bswap.h"
+#include "qemu/coroutine.h"
+#include "qemu/crc32c.h"
+#include "qemu/cutils.h"
+#include "qemu/error-report.h"
+#include "qemu/module.h"
+#include "qemu/option.h"
+#include "qemu/units.h"
+#include "block/block_int.h"
+#include "trace.h"
+
+/* Disk format.  All fields are little-endian. */
+
+#define WB_CACHE_MAGIC 0x4c4342574d455151ULL /* "QQEMWBCL" */
+#define WB_CACHE_VERSION 1
+
+/* The superblock occupies the first sector of the log */
+typedef struct QEMU_PACKED WbCacheSuper {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t sector_size;
+    /* Incremented whenever the log is reset, tags the records */
+    uint64_t epoch;
+    /* First record that may not have been destaged yet */
+    uint64_t head_lsn;
+    uint64_t head_seq;
+} WbCacheSuper;
+
+enum {
+    WB_CACHE_REC_WRITE      = 1,
+    WB_CACHE_REC_ZERO       = 2,
+    WB_CACHE_REC_DISCARD    = 3,
+    /* Fills the end of the log area when the next record doesn't fit */
+    WB_CACHE_REC_PAD        = 4,
+};
+
+#define WB_CACHE_REC_FLAG_MAY_UNMAP (1 << 0)
+
+/*
+ * Each record is one sector for this header, followed by the data of
+ * WB_CACHE_REC_WRITE records padded to a multiple of the sector size.
+ */
+typedef struct QEMU_PACKED WbCacheRecordHeader {
+    uint64_t magic;
+    uint64_t epoch;
+    uint64_t seq;
+    uint32_t type;
+    uint32_t flags;
+    uint64_t offset;
+    uint64_t bytes;     /* size of the padding for WB_CACHE_REC_PAD */
+    uint32_t crc;       /* crc32c of the header with crc = 0, and the data */
+} WbCacheRecordHeader;
+
+/* End of disk format */
+
+#define WB_CACHE_OPT_LOG_SECTOR_SIZE "log-sector-size"
+
+#define WB_CACHE_MIN_LOG_SIZE (1 * MiB)
+#define WB_CACHE_MAX_RECORD_DATA (1 * MiB)
+/* Records destaged before the log head is moved forward */
+#define WB_CACHE_CHECKPOINT_RECORDS 64
+
+typedef struct WbCacheRecord {
+    uint64_t seq;
+    int64_t lsn;            /* log sequence number, i.e. virtual log offset */
+    int64_t len;            /* space used in the log */
+    uint32_t type;
+    uint32_t flags;
+    int64_t offset;
+    int64_t bytes;
+    bool logged;            /* the log write has completed */
+    bool failed;            /* the log write has failed, ignore the record */
+    bool destaged;
+    QTAILQ_ENTRY(WbCacheRecord) next;
+} WbCacheRecord;
+
+typedef struct BDRVWbCacheState {
+    BdrvChild *log;
+    uint32_t sector_size;
+    int64_t region_start;   /* offset of the circular log area in s->log */
+    int64_t region_size;
+    int64_t max_record_data;
+
+    uint64_t epoch;
+    /* In-memory head: space before it may be reused */
+    int64_t head_lsn;
+    int64_t tail_lsn;
+    uint64_t next_seq;
+
+    /* Records that haven't been freed yet, in log order */
+    QTAILQ_HEAD(, WbCacheRecord) records;
+    int nb_records;
+
+    /* Readers of the log hold this shared, freeing records exclusive */
+    CoRwlock log_lock;
+    /* Writers waiting for log space */
+    CoQueue space_queue;
+    int space_waiters;
+    /* Requests waiting for all records to be destaged */
+    CoQueue empty_queue;
+    /* Flushes waiting for earlier log writes to complete */
+    CoQueue logged_queue;
+    /* The log can't be written to any more */
+    int log_error;
+
+    /* Destaging state, it runs in s->destage_co */
+    bool destage_running;
+    bool quiesced;
+    bool destage_all;
+    int destage_error;
+
+    struct {
+        uint64_t logged_bytes;
+        uint64_t destaged_bytes;
+        uint64_t log_read_bytes;
+    } stats;
+} BDRVWbCacheState;
+
+static QemuOptsList runtime_opts = {
+    .name = "writeback-cache",
+    .head = QTAILQ_HEAD_INITIALIZER(runtime_opts.head),
+    .desc = {
+        {
+            .name = WB_CACHE_OPT_LOG_SECTOR_SIZE,
+            .type = QEMU_OPT_SIZE,
+            .help = "Log sector size, default 512",
+        },
+        { /* end of list */ }
+    },
+};
+
+static int64_t wb_cache_log_offset(BDRVWbCacheState *s, int64_t lsn)
+{
+    return s->region_start + lsn % s->region_size;
+}
+
+static uint32_t wb_cache_header_crc(WbCacheRecordHeader *hdr,
+                                    const uint8_t *data, int64_t bytes)
+{
+    uint32_t saved = hdr->crc;
+    uint32_t crc;
+
+    hdr->crc = 0;
+    crc = crc32c(0xffffffff, (const uint8_t *)hdr, sizeof(*hdr));
+    hdr->crc = saved;
+    if (data) {
+        crc = crc32c(crc, data, bytes);
+    }
+    return crc;
+}
+
+static void wb_cache_fill_header(BDRVWbCacheState *s, WbCacheRecord *rec,
+                                 WbCacheRecordHeader *hdr)
+{
+    *hdr = (WbCacheRecordHeader) {
+        .magic  = cpu_to_le64(WB_CACHE_MAGIC),
+        .epoch  = cpu_to_le64(s->epoch),
+        .seq    = cpu_to_le64(rec->seq),
+        .type   = cpu_to_le32(rec->type),
+        .flags  = cpu_to_le32(rec->flags),
+        .offset = cpu_to_le64(rec->offset),
+        .bytes  = cpu_to_le64(rec->bytes),
+    };
+}
+
+static int wb_cache_write_super(BlockDriverState *bs, int64_t head_lsn,
+                                uint64_t head_seq)
+{
+    BDRVWbCacheState *s = bs->opaque;
+    g_autofree uint8_t *buf = g_malloc0(s->sector_size);
+    WbCacheSuper *sb = (WbCacheSuper *)buf;
+    int ret;
+
+    *sb = (WbCacheSuper) {
+        .magic          = cpu_to_le64(WB_CACHE_MAGIC),
+        .version        = cpu_to_le32(WB_CACHE_VERSION),
+        .sector_size    = cpu_to_le32(s->sector_size),
+        .epoch          = cpu_to_le64(s->epoch),
+        .head_lsn       = cpu_to_le64(head_lsn),
+        .head_seq       = cpu_to_le64(head_seq),
+    };
+
+    ret = bdrv_pwrite(s->log, 0, buf, s->sector_size);
+    if (ret < 0) {
+        return ret;
+    }
+    return bdrv_flush(s->log->bs);
+}
+
+/*
+ * Destaging
+ */
+
+static int coroutine_fn wb_cache_destage_one(BlockDriverState *bs,
+                                             WbCacheRecord *rec)
+{
+    BDRVWbCacheState *s = bs->opaque;
+    int ret = 0;
+
+    assert(rec->logged);
+
+    switch (rec->failed ? WB_CACHE_REC_PAD : rec->type) {
+    case WB_CACHE_REC_WRITE: {
+        uint8_t *buf = qemu_try_blockalign(bs->file->bs, rec->bytes);
+
+        if (!buf) {
+            return -ENOMEM;
+        }
+        ret = bdrv_co_pread(s->log,
+                            wb_cache_log_offset(s, rec->lsn) + s->sector_size,
+                            rec->bytes, buf, 0);
+        if (ret >= 0) {
+            ret = bdrv_co_pwrite(bs->file, rec->offset, rec->bytes, buf, 0);
+        }
+        qemu_vfree(buf);
+        break;
+    }
+    case WB_CACHE_REC_ZERO:
+        ret = bdrv_co_pwrite_zeroes(bs->file, rec->offset, rec->bytes,
+                                    rec->flags & WB_CACHE_REC_FLAG_MAY_UNMAP ?
+                                    BDRV_REQ_MAY_UNMAP : 0);
+        break;
+    case WB_CACHE_REC_DISCARD:
+        ret = bdrv_co_pdiscard(bs->file, rec->offset, rec->bytes);
+        if (ret == -ENOTSUP) {
+            /* Discard is only a hint */
+            ret = 0;
+        }
+        break;
+    case WB_CACHE_REC_PAD:
+        break;
+    default:
+        abort();
+    }
+
+    trace_wb_cache_destage(bs, rec->seq, rec->type, rec->offset, rec->bytes,
+                           ret);
+    if (ret >= 0) {
+        rec->destaged = true;
+        if (rec->type == WB_CACHE_REC_WRITE && !rec->failed) {
+            s->stats.destaged_bytes += rec->bytes;
+        }
+    }
+    return ret < 0 ? ret : 0;
+}
+
+/*
+ * Makes the destaged records durable in the child, then moves the head of
+ * the log past them so that their space can be reused.
+ */
+static int coroutine_fn wb_cache_checkpoint(BlockDriverState *bs)
+{
+    BDRVWbCacheState *s = bs->opaque;
+    WbCacheRecord *rec, *next;
+    int64_t head_lsn = s->tail_lsn;
+    uint64_t head_seq = s->next_seq;
+    int ret;
+
+    QTAILQ_FOREACH(rec, &s->records, next) {
+        if (!rec->destaged) {
+            head_lsn = rec->lsn;
+            head_seq = rec->seq;
+            break;
+        }
+    }
+    if (head_lsn == s->head_lsn) {
+        return 0;
+    }
+
+    ret = bdrv_co_flush(bs->file->bs);
+    if (ret >= 0) {
+        ret = wb_cache_write_super(bs, head_lsn, head_seq);
+    }
+    trace_wb_cache_checkpoint(bs, head_lsn, head_seq, ret);
+    if (ret < 0) {
+        return ret;
+    }
+
+    qemu_co_rwlock_wrlock(&s->log_lock);
+    QTAILQ_FOREACH_SAFE(rec, &s->records, next, next) {
+        if (rec->lsn >= head_lsn) {
+            break;
+        }
+        QTAILQ_REMOVE(&s->records, rec, next);
+        s->nb_records--;
+        g_free(rec);
+    }
+    s->head_lsn = head_lsn;
+    qemu_co_rwlock_unlock(&s->log_lock);
+
+    qemu_co_queue_restart_all(&s->space_queue);
+    if (QTAILQ_EMPTY(&s->records)) {
+        qemu_co_queue_restart_all(&s->empty_queue);
+    }
+    return 0;
+}
+
+static WbCacheRecord *wb_cache_next_to_destage(BDRVWbCacheState *s)
+{
+    WbCacheRecord *rec;
+
+    QTAILQ_FOREACH(rec, &s->records, next) {
+        if (!rec->destaged) {
+            /* Records are destaged in order */
+            return rec->logged ? rec : NULL;
+        }
+    }
+    return NULL;
+}
+
+static void coroutine_fn wb_cache_destage_entry(void *opaque)
+{
+    BlockDriverState *bs = opaque;
+    BDRVWbCacheState *s = bs->opaque;
+    int destaged = 0;
+    int ret = 0;
+
+    /*
+     * Keep going while drained if someone is waiting for us, otherwise
+     * they could never complete.
+     */
+    while (!s->quiesced || s->destage_all || s->space_waiters) {
+        WbCacheRecord *rec = wb_cache_next_to_destage(s);
+
+        if (rec) {
+            ret = wb_cache_destage_one(bs, rec);
+            if (ret < 0) {
+                break;
+            }
+            destaged++;
+        }
+        if (destaged && (!rec || destaged >= WB_CACHE_CHECKPOINT_RECORDS ||
+                         s->space_waiters))
+        {
+            ret = wb_cache_checkpoint(bs);
+            if (ret < 0) {
+                break;
+            }
+            destaged = 0;
+        }
+        if (!rec) {
+            break;
+        }
+    }
+
+    if (ret < 0) {
+        /*
+         * The records stay in the log and are retried when the node is
+         * opened the next time.  Don't let writers wait for space forever.
+         */
+        error_report("writeback-cache: Failed to destage to '%s': %s",
+                     bdrv_get_node_name(bs->file->bs), strerror(-ret));
+        s->destage_error = ret;
+        qemu_co_queue_restart_all(&s->space_queue);
+        qemu_co_queue_restart_all(&s->empty_queue);
+    }
+
+    s->destage_running = false;
+    bdrv_dec_in_flight(bs);
+}
+
+static void wb_cache_kick_destage(BlockDriverState *bs)
+{
+    BDRVWbCacheState *s = bs->opaque;
+    Coroutine *co;
+
+    if (s->destage_running || s->destage_error ||
+        (s->quiesced && !s->destage_all && !s->space_waiters))
+    {
+        return;
+    }
+
+    s->destage_running = true;
+    bdrv_inc_in_flight(bs);
+    co = qemu_coroutine_create(wb_cache_destage_entry, bs);
+    aio_co_enter(bdrv_get_aio_context(bs), co);
+}
+
+/* Waits until all records have been destaged, must be called drained */
+static int wb_cache_destage_all(BlockDriverState *bs)
+{
+    BDRVWbCacheState *s = bs->opaque;
+
+    s->destage_all = true;
+    while (!QTAILQ_EMPTY(&s->records) && !s->destage_error) {
+        wb_cache_kick_destage(bs);
+        BDRV_POLL_WHILE(bs, s->destage_running);
+    }
+    s->destage_all = false;
+
+    return s->destage_error;
+}
+
+static int coroutine_fn wb_cache_co_wait_empty(BlockDriverState *bs)
+{
+    BDRVWbCacheState *s = bs->opaque;
+
+    while (!QTAILQ_EMPTY(&s->records) && !s->destage_error) {
+        s->space_waiters++;
+        wb_cache_kick_destage(bs);
+        qemu_co_queue_wait(&s->empty_queue, NULL);
+        s->space_waiters--;
+    }
+    return s->destage_error;
+}
+
+/*
+ * Logging
+ */
+
+static WbCacheRecord *wb_cache_add_record(BDRVWbCacheState *s, uint32_t type,
+                                          int64_t len)
+{
+    WbCacheRecord *rec = g_new0(WbCacheRecord, 1);
+
+    rec->seq = s->next_seq++;
+    rec->lsn = s->tail_lsn;
+    rec->len = len;
+    rec->type = type;
+    s->tail_lsn += len;
+
+    QTAILQ_INSERT_TAIL(&s->records, rec, next);
+    s->nb_records++;
+    return rec;
+}
+
+/*
+ * Reserves @len bytes at the tail of the log, preceded by a padding record
+ * if the space before the end of the log area isn't large enough.  Waits
+ * for space to be freed if the log is full.
+ */
+static WbCacheRecord * coroutine_fn
+wb_cache_co_alloc(BlockDriverState *bs, uint32_t type, int64_t len,
+                  WbCacheRecord **pad)
+{
+    BDRVWbCacheState *s = bs->opaque;
+    int64_t pad_len;
+
+    for (;;) {
+        int64_t pos = s->tail_lsn % s->region_size;
+
+        pad_len = pos + len > s->region_size ? s->region_size - pos : 0;
+        if (s->tail_lsn + pad_len + len - s->head_lsn <= s->region_size) {
+            break;
+        }
+        if (s->destage_error) {
+            return NULL;
+        }
+
+        s->space_waiters++;
+        wb_cache_kick_destage(bs);
+        qemu_co_queue_wait(&s->space_queue, NULL);
+        s->space_waiters--;
+    }
+
+    *pad = NULL;
+    if (pad_len) {
+        *pad = wb_cache_add_record(s, WB_CACHE_REC_PAD, pad_len);
+        (*pad)->bytes = pad_len;
+    }
+    return wb_cache_add_record(s, type, len);
+}
+
+static int coroutine_fn wb_cache_co_write_record(BlockDriverState *bs,
+                                                 WbCacheRecord *rec,
+                                                 QEMUIOVector *qiov,
+                                                 size_t qiov_offset,
+                                                 int flags)
+{
+    BDRVWbCacheState *s = bs->opaque;
+    WbCacheRecordHeader *hdr;
+    uint8_t *buf;
+    int ret;
+
+    buf = qemu_try_blockalign(s->log->bs, rec->len);
+    if (!buf) {
+        return -ENOMEM;
+    }
+    memset(buf, 0, rec->len);
+
+    hdr = (WbCacheRecordHeader *)buf;
+    wb_cache_fill_header(s, rec, hdr);
+    if (rec->type == WB_CACHE_REC_WRITE) {
+        qemu_iovec_to_buf(qiov, qiov_offset, buf + s->sector_size,
+                          rec->bytes);
+        hdr->crc = cpu_to_le32(wb_cache_header_crc(hdr, buf + s->sector_size,
+                                                   rec->bytes));
+    } else {
+        hdr->crc = cpu_to_le32(wb_cache_header_crc(hdr, NULL, 0));
+    }
+
+    /* Only the header of padding records is written */
+    ret = bdrv_co_pwrite(s->log, wb_cache_log_offset(s, rec->lsn),
+                         rec->type == WB_CACHE_REC_PAD ? s->sector_size
+                                                       : rec->len,
+                         buf, flags & BDRV_REQ_FUA);
+    qemu_vfree(buf);
+
+    if (ret < 0 && rec->type != WB_CACHE_REC_PAD) {
+        /*
+         * Replay would stop at the broken record and lose the records
+         * after it, so try to turn it into padding.  If that fails too,
+         * stop logging altogether.
+         */
+        WbCacheRecordHeader *pad = qemu_try_blockalign0(s->log->bs,
+                                                        s->sector_size);
+        int pad_ret = -ENOMEM;
+
+        if (pad) {
+            wb_cache_fill_header(s, rec, pad);
+            pad->type = cpu_to_le32(WB_CACHE_REC_PAD);
+            pad->bytes = cpu_to_le64(rec->len);
+            pad->crc = cpu_to_le32(wb_cache_header_crc(pad, NULL, 0));
+            pad_ret = bdrv_co_pwrite(s->log, wb_cache_log_offset(s, rec->lsn),
+                                     s->sector_size, pad, 0);
+            qemu_vfree(pad);
+        }
+        if (pad_ret < 0) {
+            s->log_error = pad_ret;
+        }
+    }
+
+    /* Failed records must still be destaged in order for the head to move */
+    rec->failed = ret < 0;
+    rec->logged = true;
+    qemu_co_queue_restart_all(&s->logged_queue);
+
+    return ret;
+}
+
+static int coroutine_fn wb_cache_co_log(BlockDriverState *bs, uint32_t type,
+                                        int64_t offset, int64_t bytes,
+                                        QEMUIOVector *qiov,
+                                        size_t qiov_offset, int flags)
+{
+    BDRVWbCacheState *s = bs->opaque;
+    int ret = 0;
+
+    if (s->destage_error || s->log_error) {
+        return s->destage_error ?: s->log_error;
+    }
+
+    /* Large writes are split, only sectors are atomic anyway */
+    while (bytes) {
+        int64_t n = type == WB_CACHE_REC_WRITE ?
+                    MIN(bytes, s->max_record_data) : bytes;
+        int64_t len = s->sector_size;
+        WbCacheRecord *rec, *pad;
+
+        if (type == WB_CACHE_REC_WRITE) {
+            len += QEMU_ALIGN_UP(n, s->sector_size);
+        }
+
+        rec = wb_cache_co_alloc(bs, type, len, &pad);
+        if (!rec) {
+            return s->destage_error;
+        }
+        rec->offset = offset;
+        rec->bytes = n;
+        if (type == WB_CACHE_REC_ZERO && (flags & BDRV_REQ_MAY_UNMAP)) {
+            rec->flags |= WB_CACHE_REC_FLAG_MAY_UNMAP;
+        }
+
+        if (pad) {
+            /* Padding doesn't matter even if it fails to be written */
+            wb_cache_co_write_record(bs, pad, NULL, 0, 0);
+        }
+        ret = wb_cache_co_write_record(bs, rec, qiov, qiov_offset, flags);
+        wb_cache_kick_destage(bs);
+        if (ret < 0) {
+            return ret;
+        }
+
+        if (type == WB_CACHE_REC_WRITE) {
+            s->stats.logged_bytes += n;
+            qiov_offset += n;
+        }
+        offset += n;
+        bytes -= n;
+    }
+
+    return 0;
+}
+
+/*
+ * Request callbacks
+ */
+
+static int coroutine_fn wb_cache_co_preadv_part(BlockDriverState *bs,
+                                                uint64_t offset,
+                                                uint64_t bytes,
+                                                QEMUIOVector *qiov,
+                                                size_t qiov_offset,
+                                                int flags)
+{
+    BDRVWbCacheState *s = bs->opaque;
+    int64_t end = offset + bytes;
+    int64_t pos = offset;
+    int ret = 0;
+
+    if (QTAILQ_EMPTY(&s->records)) {
+        return bdrv_co_preadv_part(bs->file, offset, bytes, qiov, qiov_offset,
+                                   flags);
+    }
+
+    qemu_co_rwlock_rdlock(&s->log_lock);
+    while (pos < end && ret >= 0) {
+        WbCacheRecord *rec, *src = NULL;
+        int64_t limit = end;
+        size_t qoff = qiov_offset + (pos - offset);
+
+        /*
+         * The newest record that covers @pos provides the data, up to the
+         * start of any newer record.  This is linear in the number of
+         * records, which the log size bounds.
+         */
+        QTAILQ_FOREACH_REVERSE(rec, &s->records, next) {
+            if (!rec->logged || rec->failed || rec->type == WB_CACHE_REC_PAD) {
+                continue;
+            }
+            if (rec->offset <= pos && pos < rec->offset + rec->bytes) {
+                src = rec;
+                limit = MIN(limit, rec->offset + rec->bytes);
+                break;
+            }
+            if (rec->offset > pos) {
+                limit = MIN(limit, rec->offset);
+            }
+        }
+
+        if (!src || src->type == WB_CACHE_REC_DISCARD) {
+            ret = bdrv_co_preadv_part(bs->file, pos, limit - pos, qiov, qoff,
+                                      flags);
+        } else if (src->type == WB_CACHE_REC_ZERO) {
+            qemu_iovec_memset(qiov, qoff, 0, limit - pos);
+        } else {
+            ret = bdrv_co_preadv_part(s->log,
+                                      wb_cache_log_offset(s, src->lsn) +
+                                      s->sector_size + (pos - src->offset),
+                                      limit - pos, qiov, qoff, 0);
+            s->stats.log_read_bytes += limit - pos;
+        }
+        pos = limit;
+    }
+    qemu_co_rwlock_unlock(&s->log_lock);
+
+    return ret < 0 ? ret : 0;
+}
+
+static int coroutine_fn wb_cache_co_pwritev_part(BlockDriverState *bs,
+                                                 uint64_t offset,
+                                                 uint64_t bytes,
+                                                 QEMUIOVector *qiov,
+                                                 size_t qiov_offset,
+                                                 int flags)
+{
+    return wb_cache_co_log(bs, WB_CACHE_REC_WRITE, offset, bytes, qiov,
+                           qiov_offset, flags);
+}
+
+static int coroutine_fn wb_cache_co_pwrite_zeroes(BlockDriverState *bs,
+                                                  int64_t offset, int bytes,
+                                                  BdrvRequestFlags flags)
+{
+    return wb_cache_co_log(bs, WB_CACHE_REC_ZERO, offset, bytes, NULL, 0,
+                           flags);
+}
+
+static int coroutine_fn wb_cache_co_pdiscard(BlockDriverState *bs,
+                                             int64_t offset, int bytes)
+{
+    return wb_cache_co_log(bs, WB_CACHE_REC_DISCARD, offset, bytes, NULL, 0, 0);
+}
+
+static bool wb_cache_logged_before(BDRVWbCacheState *s, uint64_t seq)
+{
+    WbCacheRecord *rec;
+
+    QTAILQ_FOREACH(rec, &s->records, next) {
+        if (rec->seq >= seq) {
+            break;
+        }
+        if (!rec->logged) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int coroutine_fn wb_cache_co_flush(BlockDriverState *bs)
+{
+    BDRVWbCacheState *s = bs->opaque;
+    uint64_t seq = s->next_seq;
+
+    /*
+     * Everything that has completed is in the log, but replay can only get
+     * to it if no earlier record is missing, so wait for those that are
+     * still in flight.
+     */
+    while (!wb_cache_logged_before(s, seq)) {
+        qemu_co_queue_wait(&s->logged_queue, NULL);
+    }
+    if (s->log_error) {
+        return s->log_error;
+    }
+
+    return bdrv_co_flush(s->log->bs);
+}
+
+static int coroutine_fn wb_cache_co_truncate(BlockDriverState *bs,
+                                             int64_t offset, bool exact,
+                                             PreallocMode prealloc,
+                                             BdrvRequestFlags flags,
+                                             Error **errp)
+{
+    int ret;
+
+    ret = wb_cache_co_wait_empty(bs);
+    if (ret < 0) {
+        error_setg_errno(errp, -ret, "Could not destage the writeback cache");
+        return ret;
+    }
+
+    return bdrv_co_truncate(bs->file, offset, exact, prealloc, flags, errp);
+}
+
+static int64_t wb_cache_getlength(BlockDriverState *bs)
+{
+    return bdrv_getlength(bs->file->bs);
+}
+
+static void coroutine_fn wb_cache_co_drain_begin(BlockDriverState *bs)
+{
+    BDRVWbCacheState *s = bs->opaque;
+
+    /* The destaging coroutine is counted as in flight, so drain waits */
+    s->quiesced = true;
+}
+
+static void coroutine_fn wb_cache_co_drain_end(BlockDriverState *bs)
+{
+    BDRVWbCacheState *s = bs->opaque;
+
+    s->quiesced = false;
+    wb_cache_kick_destage(bs);
+}
+
+/*
+ * Opening and recovery
+ */
+
+/* Empties the log, the child must be up to date */
+static int wb_cache_reset_log(BlockDriverState *bs)
+{
+    BDRVWbCacheState *s = bs->opaque;
+
+    s->epoch++;
+    s->head_lsn = s->tail_lsn = 0;
+    s->next_seq = 0;
+    return wb_cache_write_super(bs, 0, 0);
+}
+
+/*
+ * Applies the records found in the log to the child.  Replay stops at the
+ * first record that is not the next one, which is where logging stopped.
+ */
+static int wb_cache_replay(BlockDriverState *bs, int64_t head_lsn,
+                           uint64_t head_seq, Error **errp)
+{
+    BDRVWbCacheState *s = bs->opaque;
+    g_autofree uint8_t *hdr_buf = g_malloc(s->sector_size);
+    WbCacheRecordHeader *hdr = (WbCacheRecordHeader *)hdr_buf;
+    int64_t lsn = head_lsn;
+    uint64_t seq = head_seq;
+    uint64_t nb_records = 0;
+    int ret = 0;
+
+    while (lsn - head_lsn < s->region_size) {
+        int64_t log_offset = wb_cache_log_offset(s, lsn);
+        uint8_t *data = NULL;
+        int64_t bytes, len;
+        uint32_t type;
+
+        ret = bdrv_pread(s->log, log_offset, hdr_buf, s->sector_size);
+        if (ret < 0) {
+            error_setg_errno(errp, -ret, "Could not read the log");
+            return ret;
+        }
+        if (le64_to_cpu(hdr->magic) != WB_CACHE_MAGIC ||
+            le64_to_cpu(hdr->epoch) != s->epoch ||
+            le64_to_cpu(hdr->seq) != seq)
+        {
+            break;
+        }
+
+        type = le32_to_cpu(hdr->type);
+        bytes = le64_to_cpu(hdr->bytes);
+        if (type == WB_CACHE_REC_PAD) {
+            len = bytes;
+        } else if (type == WB_CACHE_REC_WRITE) {
+            len = s->sector_size + QEMU_ALIGN_UP(bytes, s->sector_size);
+        } else {
+            len = s->sector_size;
+        }
+        if (bytes < 0 || bytes > s->region_size || len < s->sector_size ||
+            lsn % s->region_size + len > s->region_size)
+        {
+            break;
+        }
+
+        if (type == WB_CACHE_REC_WRITE) {
+            data = qemu_try_blockalign(bs->file->bs, bytes);
+            if (!data) {
+                error_setg(errp, "Could not allocate a buffer for replay");
+                return -ENOMEM;
+            }
+            ret = bdrv_pread(s->log, log_offset + s->sector_size, data, bytes);
+            if (ret < 0) {
+                qemu_vfree(data);
+                error_setg_errno(errp, -ret, "Could not read the log");
+                return ret;
+            }
+        }
+        if (wb_cache_header_crc(hdr, data, bytes) != le32_to_cpu(hdr->crc)) {
+            qemu_vfree(data);
+            break;
+        }
+
+        switch (type) {
+        case WB_CACHE_REC_WRITE:
+            ret = bdrv_pwrite(bs->file, le64_to_cpu(hdr->offset), data, bytes);
+            break;
+        case WB_CACHE_REC_ZERO:
+            ret = bdrv_pwrite_zeroes(bs->file, le64_to_cpu(hdr->offset), bytes,
+                                     le32_to_cpu(hdr->flags) &
+                                     WB_CACHE_REC_FLAG_MAY_UNMAP ?
+                                     BDRV_REQ_MAY_UNMAP : 0);
+            break;
+        case WB_CACHE_REC_DISCARD:
+            /* Only a hint, and reads of the range are undefined anyway */
+        case WB_CACHE_REC_PAD:
+            ret = 0;
+            break;
+        default:
+            ret = -EINVAL;
+        }
+        qemu_vfree(data);
+        if (ret < 0) {
+            error_setg_errno(errp, -ret, "Could not replay the log");
+            return ret;
+        }
+
+        nb_records++;
+        lsn += len;
+        seq++;
+    }
+
+    trace_wb_cache_replay(bs, nb_records);
+    if (nb_records) {
+        ret = bdrv_flush(bs->file->bs);
+        if (ret < 0) {
+            error_setg_errno(errp, -ret, "Could not flush the replayed log");
+            return ret;
+        }
+    }
+    return 0;
+}
+
+static int wb_cache_recover(BlockDriverState *bs, Error **errp)
+{
+    BDRVWbCacheState *s = bs->opaque;
+    g_autofree uint8_t *buf = g_malloc(s->sector_size);
+    WbCacheSuper *sb = (WbCacheSuper *)buf;
+    int ret;
+
+    ret = bdrv_pread(s->log, 0, buf, s->sector_size);
+    if (ret < 0) {
+        error_setg_errno(errp, -ret, "Could not read the log superblock");
+        return ret;
+    }
+
+    if (le64_to_cpu(sb->magic) == WB_CACHE_MAGIC) {
+        if (le32_to_cpu(sb->version) != WB_CACHE_VERSION ||
+            le32_to_cpu(sb->sector_size) != s->sector_size)
+        {
+            error_setg(errp, "The log was created with a different version "
+                       "or log-sector-size");
+            return -EINVAL;
+        }
+        s->epoch = le64_to_cpu(sb->epoch);
+        ret = wb_cache_replay(bs, le64_to_cpu(sb->head_lsn),
+                              le64_to_cpu(sb->head_seq), errp);
+        if (ret < 0) {
+            return ret;
+        }
+    }
+    /* Otherwise this is a new log */
+
+    ret = wb_cache_reset_log(bs);
+    if (ret < 0) {
+        error_setg_errno(errp, -ret, "Could not write the log superblock");
+    }
+    return ret;
+}
+
+static void wb_cache_child_perm(BlockDriverState *bs, BdrvChild *c,
+                                BdrvChildRole role,
+                                BlockReopenQueue *reopen_queue,
+                                uint64_t perm, uint64_t shared,
+                                uint64_t *nperm, uint64_t *nshared)
+{
+    bool active = !(bs->open_flags & BDRV_O_INACTIVE);
+
+    if (!(role & BDRV_CHILD_FILTERED)) {
+        /* Log child */
+        *nperm = BLK_PERM_CONSISTENT_READ | (active ? BLK_PERM_WRITE : 0);
+        *nshared = BLK_PERM_CONSISTENT_READ | BLK_PERM_WRITE_UNCHANGED;
+        return;
+    }
+
+    bdrv_default_perms(bs, c, role, reopen_queue, perm, shared,
+                       nperm, nshared);
+
+    /* Destaging and replay write even if our parents don't */
+    if (active) {
+        *nperm |= BLK_PERM_WRITE;
+    }
+    /* Writes that bypass us would be overwritten by destaging */
+    *nshared &= ~(BLK_PERM_WRITE | BLK_PERM_RESIZE);
+}
+
+static int wb_cache_open(BlockDriverState *bs, QDict *options, int flags,
+                         Error **errp)
+{
+    BDRVWbCacheState *s = bs->opaque;
+    QemuOpts *opts = NULL;
+    int64_t log_len;
+    uint64_t sector_size;
+    int ret;
+
+    if (!(flags & BDRV_O_RDWR)) {
+        error_setg(errp, "The writeback-cache driver requires a writable "
+                   "node");
+        return -EINVAL;
+    }
+
+    bs->file = bdrv_open_child(NULL, options, "file", bs, &child_of_bds,
+                               BDRV_CHILD_FILTERED | BDRV_CHILD_PRIMARY,
+                               false, errp);
+    if (!bs->file) {
+        return -EINVAL;
+    }
+
+    s->log = bdrv_open_child(NULL, options, "log", bs, &child_of_bds,
+                             BDRV_CHILD_METADATA, false, errp);
+    if (!s->log) {
+        ret = -EINVAL;
+        goto fail;
+    }
+
+    opts = qemu_opts_create(&runtime_opts, NULL, 0, &error_abort);
+    if (!qemu_opts_absorb_qdict(opts, options, errp)) {
+        ret = -EINVAL;
+        goto fail;
+    }
+
+    sector_size = qemu_opt_get_size(opts, WB_CACHE_OPT_LOG_SECTOR_SIZE,
+                                    BDRV_SECTOR_SIZE);
+    if (sector_size < BDRV_SECTOR_SIZE || sector_size > 64 * KiB ||
+        !is_power_of_2(sector_size) ||
+        sector_size < s->log->bs->bl.request_alignment)
+    {
+        error_setg(errp, "log-sector-size must be a power of two between %llu "
+                   "and 64k, and at least the request alignment of the log",
+                   BDRV_SECTOR_SIZE);
+        ret = -EINVAL;
+        goto fail;
+    }
+    s->sector_size = sector_size;
+
+    log_len = bdrv_getlength(s->log->bs);
+    if (log_len < 0) {
+        error_setg_errno(errp, -log_len, "Could not get the length of the log");
+        ret = log_len;
+        goto fail;
+    }
+    if (log_len < WB_CACHE_MIN_LOG_SIZE) {
+        error_setg(errp, "The log must be at least %" PRId64 " bytes long",
+                   WB_CACHE_MIN_LOG_SIZE);
+        ret = -EINVAL;
+        goto fail;
+    }
+    s->region_start = s->sector_size;
+    s->region_size = QEMU_ALIGN_DOWN(log_len - s->region_start,
+                                     s->sector_size);
+    s->max_record_data = MIN(WB_CACHE_MAX_RECORD_DATA,
+                             QEMU_ALIGN_DOWN(s->region_size / 4,
+                                             s->sector_size));
+
+    QTAILQ_INIT(&s->records);
+    qemu_co_rwlock_init(&s->log_lock);
+    qemu_co_queue_init(&s->space_queue);
+    qemu_co_queue_init(&s->empty_queue);
+    qemu_co_queue_init(&s->logged_queue);
+
+    /* An inactive node must not write, recovery happens on activation */
+    if (!(flags & BDRV_O_INACTIVE)) {
+        ret = wb_cache_recover(bs, errp);
+        if (ret < 0) {
+            goto fail;
+        }
+    }
+
+    bs->supported_write_flags = BDRV_REQ_WRITE_UNCHANGED | BDRV_REQ_FUA;
+    bs->supported_zero_flags = BDRV_REQ_WRITE_UNCHANGED | BDRV_REQ_FUA |
+                               BDRV_REQ_MAY_UNMAP;
+
+    ret = 0;
+fail:
+    if (ret < 0) {
+        bdrv_unref_child(bs, s->log);
+        s->log = NULL;
+        bdrv_unref_child(bs, bs->file);
+        bs->file = NULL;
+    }
+    qemu_opts_del(opts);
+    return ret;
+}
+
+static void coroutine_fn wb_cache_co_invalidate_cache(BlockDriverState *bs,
+                                                      Error **errp)
+{
+    BDRVWbCacheState *s = bs->opaque;
+
+    assert(QTAILQ_EMPTY(&s->records));
+    wb_cache_recover(bs, errp);
+}
+
+static int wb_cache_inactivate(BlockDriverState *bs)
+{
+    int ret;
+
+    /* The image must be complete for whoever takes it over */
+    bdrv_drained_begin(bs);
+    ret = wb_cache_destage_all(bs);
+    bdrv_drained_end(bs);
+
+    return ret;
+}
+
+static void wb_cache_close(BlockDriverState *bs)
+{
+    BDRVWbCacheState *s = bs->opaque;
+    WbCacheRecord *rec, *next;
+
+    /* On failure, the log is replayed on the next open */
+    if (!(bs->open_flags & BDRV_O_INACTIVE)) {
+        wb_cache_destage_all(bs);
+    }
+
+    QTAILQ_FOREACH_SAFE(rec, &s->records, next, next) {
+        g_free(rec);
+    }
+
+    bdrv_unref_child(bs, s->log);
+    s->log = NULL;
+}
+
+static BlockStatsSpecific *wb_cache_get_specific_stats(BlockDriverState *bs)
+{
+    BlockStatsSpecific *stats = g_new(BlockStatsSpecific, 1);
+    BDRVWbCacheState *s = bs->opaque;
+
+    stats->driver = BLOCKDEV_DRIVER_WRITEBACK_CACHE;
+    stats->u.writeback_cache = (BlockStatsSpecificWritebackCache) {
+        .logged_bytes = s->stats.logged_bytes,
+        .destaged_bytes = s->stats.destaged_bytes,
+        .log_read_bytes = s->stats.log_read_bytes,
+        .log_used = s->tail_lsn - s->head_lsn,
+        .log_size = s->region_size,
+    };
+
+    return stats;
+}
+
+static BlockDriver bdrv_writeback_cache = {
+    .format_name                = "writeback-cache",
+    .instance_size              = sizeof(BDRVWbCacheState),
+
+    .bdrv_open                  = wb_cache_open,
+    .bdrv_close                 = wb_cache_close,
+    .bdrv_child_perm            = wb_cache_child_perm,
+
+    .bdrv_getlength             = wb_cache_getlength,
+
+    .bdrv_co_preadv_part        = wb_cache_co_preadv_part,
+    .bdrv_co_pwritev_part       = wb_cache_co_pwritev_part,
+    .bdrv_co_pwrite_zeroes      = wb_cache_co_pwrite_zeroes,
+    .bdrv_co_pdiscard           = wb_cache_co_pdiscard,
+    .bdrv_co_truncate           = wb_cache_co_truncate,
+    .bdrv_co_flush              = wb_cache_co_flush,
+
+    .bdrv_co_drain_begin        = wb_cache_co_drain_begin,
+    .bdrv_co_drain_end          = wb_cache_co_drain_end,
+
+    .bdrv_co_invalidate_cache   = wb_cache_co_invalidate_cache,
+    .bdrv_inactivate            = wb_cache_inactivate,
+    .bdrv_get_specific_stats    = wb_cache_get_specific_stats,
+
+    .has_variable_length        = true,
+    .is_filter                  = true,
+};
+
+static void bdrv_writeback_cache_init(void)
+{
+    bdrv_register(&bdrv_writeback_cache);
+}
+
+block_init(bdrv_writeback_cache_init);
@@ -38,6 +38,7 @@
 #include "block/qdict.h"
 #include "block/throttle-groups.h"
 #include "monitor/monitor.h"
+#include "monitor/stats.h"
 #include "qemu/error-report.h"
 #include "qemu/option.h"
 #include "qemu/qemu-print.h"
@@ -55,6 +56,7 @@
 #include "sysemu/sysemu.h"
 #include "sysemu/iothread.h"
 #include "block/block_int.h"
+#include "block/thread-pool.h"
 #include "block/trace.h"
 #include "sysemu/arch_init.h"
 #include "sysemu/runstate.h"
@@ -2803,7 +2805,7 @@ static BlockJob *do_backup_common(BackupCommon *backup,
 {
     BlockJob *job = NULL;
     BdrvDirtyBitmap *bmap = NULL;
-    BackupPerf perf = { .max_workers = 64 };
+    BackupPerf perf = { .use_copy_range = true, .max_workers = 64 };
     int job_flags = JOB_DEFAULT;
 
     if (!backup->has_speed) {
@@ -2974,10 +2976,12 @@ static void blockdev_mirror_common(const char *job_id, BlockDriverState *bs,
                                    bool has_copy_mode, MirrorCopyMode copy_mode,
                                    bool has_auto_finalize, bool auto_finalize,
                                    bool has_auto_dismiss, bool auto_dismiss,
+                                   MirrorPerf *x_perf,
                                    Error **errp)
 {
     BlockDriverState *unfiltered_bs;
     int job_flags = JOB_DEFAULT;
+    MirrorPerf perf = { .auto_tune = false };
 
     if (!has_speed) {
         speed = 0;
@@ -3077,11 +3081,20 @@ static void blockdev_mirror_common(const char *job_id, BlockDriverState *bs,
     /* pass the node name to replace to mirror start since it's loose coupling
      * and will allow to check whether the node still exist at mirror completion
      */
+    if (x_perf) {
+        if (x_perf->has_auto_tune) {
+            perf.auto_tune = x_perf->auto_tune;
+        }
+        if (x_perf->has_max_guest_latency) {
+            perf.max_guest_latency = x_perf->max_guest_latency;
+        }
+    }
+
     mirror_start(job_id, bs, target,
                  has_replaces ? replaces : NULL, job_flags,
                  speed, granularity, buf_size, sync, backing_mode, zero_target,
                  on_source_error, on_target_error, unmap, filter_node_name,
-                 copy_mode, errp);
+                 copy_mode, &perf, errp);
 }
 
 void qmp_drive_mirror(DriveMirror *arg, Error **errp)
@@ -3235,7 +3248,7 @@ void qmp_drive_mirror(DriveMirror *arg, Error **errp)
                            arg->has_copy_mode, arg->copy_mode,
                            arg->has_auto_finalize, arg->auto_finalize,
                            arg->has_auto_dismiss, arg->auto_dismiss,
-                           errp);
+                           arg->x_perf, errp);
     bdrv_unref(target_bs);
 out:
     aio_context_release(aio_context);
@@ -3257,6 +3270,7 @@ void qmp_blockdev_mirror(bool has_job_id, const char *job_id,
                          bool has_copy_mode, MirrorCopyMode copy_mode,
                          bool has_auto_finalize, bool auto_finalize,
                          bool has_auto_dismiss, bool auto_dismiss,
+                         bool has_x_perf, MirrorPerf *x_perf,
                          Error **errp)
 {
     BlockDriverState *bs;
@@ -3305,7 +3319,7 @@ void qmp_blockdev_mirror(bool has_job_id, const char *job_id,
                            has_copy_mode, copy_mode,
                            has_auto_finalize, auto_finalize,
                            has_auto_dismiss, auto_dismiss,
-                           errp);
+                           has_x_perf ? x_perf : NULL, errp);
 out:
     aio_context_release(aio_context);
 }
@@ -3839,3 +3853,52 @@ QemuOptsList qemu_drive_opts = {
         { /* end of list */ }
     },
 };
+
+static void block_stats_cb(StatsResultList **result, strList *names,
+                           Error **errp)
+{
+    ThreadPoolStats pool;
+    CoroutinePoolStats co;
+    StatsList *stats = NULL;
+
+    thread_pool_get_stats(&pool);
+    qemu_coroutine_get_pool_stats(&co);
+
+    stats_add(&stats, names, "coroutine-pool-frees", co.frees);
+    stats_add(&stats, names, "coroutine-pool-misses", co.misses);
+    stats_add(&stats, names, "coroutine-pool-hits", co.hits);
+    stats_add(&stats, names, "coroutine-pool-batch-size", co.batch_size);
+    stats_add(&stats, names, "thread-pool-threads", pool.threads);
+    stats_add(&stats, names, "thread-pool-queued", pool.queued);
+    stats_add(&stats, names, "thread-pool-completed", pool.completed);
+    stats_add(&stats, names, "thread-pool-submitted", pool.submitted);
+    stats_result_add(result, STATS_PROVIDER_BLOCK, NULL, stats);
+}
+
+static void block_stats_schemas_cb(StatsSchemaValueList **result)
+{
+    stats_schema_add(result, "coroutine-pool-frees", STATS_TYPE_CUMULATIVE,
+                     STATS_UNIT__MAX);
+    stats_schema_add(result, "coroutine-pool-misses", STATS_TYPE_CUMULATIVE,
+                     STATS_UNIT__MAX);
+    stats_schema_add(result, "coroutine-pool-hits", STATS_TYPE_CUMULATIVE,
+                     STATS_UNIT__MAX);
+    stats_schema_add(result, "coroutine-pool-batch-size", STATS_TYPE_INSTANT,
+                     STATS_UNIT__MAX);
+    stats_schema_add(result, "thread-pool-threads", STATS_TYPE_INSTANT,
+                     STATS_UNIT__MAX);
+    stats_schema_add(result, "thread-pool-queued", STATS_TYPE_INSTANT,
+                     STATS_UNIT__MAX);
+    stats_schema_add(result, "thread-pool-completed", STATS_TYPE_CUMULATIVE,
+                     STATS_UNIT__MAX);
+    stats_schema_add(result, "thread-pool-submitted", STATS_TYPE_CUMULATIVE,
+                     STATS_UNIT__MAX);
+}
+
+static void blockdev_stats_init(void)
+{
+    add_stats_callbacks(STATS_PROVIDER_BLOCK, block_stats_cb,
+                        block_stats_schemas_cb);
+}
+
+block_init(blockdev_stats_init);
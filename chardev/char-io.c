@@ -22,6 +22,7 @@
  * THE SOFTWARE.
  */
 #include "qemu/osdep.h"
+#include "qemu/iov.h"
 #include "chardev/char-io.h"
 
 typedef struct IOWatchPoll {
@@ -122,7 +123,7 @@ int io_channel_send_full(QIOChannel *ioc,
 
         ret = qio_channel_writev_full(
             ioc, &iov, 1,
-            fds, nfds, NULL);
+            fds, nfds, 0, NULL);
         if (ret == QIO_CHANNEL_ERR_BLOCK) {
             if (offset) {
                 return offset;
@@ -141,6 +142,40 @@ int io_channel_send_full(QIOChannel *ioc,
     return offset;
 }
 
+int io_channel_sendv_full(QIOChannel *ioc, const struct iovec *iov,
+                          size_t niov, int *fds, size_t nfds)
+{
+    g_autofree struct iovec *local_iov = g_memdup(iov, niov * sizeof(*iov));
+    struct iovec *local = local_iov;
+    unsigned int nlocal = niov;
+    size_t len = iov_size(iov, niov);
+    size_t offset = 0;
+
+    while (offset < len) {
+        ssize_t ret = qio_channel_writev_full(ioc, local, nlocal,
+                                              fds, nfds, 0, NULL);
+        if (ret == QIO_CHANNEL_ERR_BLOCK) {
+            if (offset) {
+                return offset;
+            }
+
+            errno = EAGAIN;
+            return -1;
+        } else if (ret < 0) {
+            errno = EINVAL;
+            return -1;
+        }
+
+        /* The file descriptors went out with the first bytes */
+        fds = NULL;
+        nfds = 0;
+        iov_discard_front(&local, &nlocal, ret);
+        offset += ret;
+    }
+
+    return offset;
+}
+
 int io_channel_send(QIOChannel *ioc, const void *buf, size_t len)
 {
     return io_channel_send_full(ioc, buf, len, NULL, 0);
@@ -183,6 +183,34 @@ int qemu_chr_write(Chardev *s, const uint8_t *buf, int len, bool write_all)
     return offset;
 }
 
+int qemu_chr_writev(Chardev *s, const struct iovec *iov, int iovcnt)
+{
+    ChardevClass *cc = CHARDEV_GET_CLASS(s);
+    int offset = 0;
+    int i, res;
+
+    if (!cc->chr_writev || qemu_chr_replay(s) || s->logfd >= 0) {
+        /* Write, log or record the buffers one at a time */
+        for (i = 0; i < iovcnt; i++) {
+            res = qemu_chr_write(s, iov[i].iov_base, iov[i].iov_len, false);
+            if (res < 0) {
+                return offset ? offset : res;
+            }
+            offset += res;
+            if (res < iov[i].iov_len) {
+                break;
+            }
+        }
+        return offset;
+    }
+
+    qemu_mutex_lock(&s->chr_write_lock);
+    res = cc->chr_writev(s, iov, iovcnt);
+    qemu_mutex_unlock(&s->chr_write_lock);
+
+    return res;
+}
+
 int qemu_chr_be_can_write(Chardev *s)
 {
     CharBackend *be = s->be;
@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2021, Linaro
+ *
+ * Statistical profiler: periodically samples the PC of each running
+ * vCPU and reports the results in the "collapsed stack" format used by
+ * flamegraph.pl and similar tools.
+ *
+ * License: GNU GPL, version 2 or later.
+ *   See the COPYING file in the top-level directory.
+ */
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <glib.h>
+
+#include <qemu-plugin.h>
+
+QEMU_PLUGIN_EXPORT int qemu_plugin_version = QEMU_PLUGIN_VERSION;
+
+/* Plugins need to take care of their own locking */
+static GMutex lock;
+/* guest PC -> symbol, filled in at translation time */
+static GHashTable *symbols;
+/* "cpuN;symbol" or "symbol" -> sample count */
+static GHashTable *samples;
+static uint64_t period_us = 1000;
+static bool percpu;
+
+static gint cmp_count(gconstpointer a, gconstpointer b, gpointer d)
+{
+    uint64_t ca = GPOINTER_TO_SIZE(g_hash_table_lookup(samples, a));
+    uint64_t cb = GPOINTER_TO_SIZE(g_hash_table_lookup(samples, b));
+
+    return ca > cb ? -1 : ca < cb;
+}
+
+static void plugin_exit(qemu_plugin_id_t id, void *p)
+{
+    g_autoptr(GString) report = g_string_new("");
+    GList *keys, *it;
+
+    g_mutex_lock(&lock);
+    keys = g_hash_table_get_keys(samples);
+    keys = g_list_sort_with_data(keys, cmp_count, NULL);
+    for (it = keys; it; it = it->next) {
+        g_string_append_printf(report, "%s %zu\n", (char *) it->data,
+                               GPOINTER_TO_SIZE(g_hash_table_lookup(samples,
+                                                                    it->data)));
+    }
+    g_list_free(keys);
+    g_mutex_unlock(&lock);
+
+    qemu_plugin_outs(report->str);
+}
+
+static void vcpu_sample(qemu_plugin_id_t id, unsigned int vcpu_index,
+                        uint64_t pc)
+{
+    const char *sym;
+    g_autofree char *frame = NULL;
+    gchar *key;
+    gpointer count;
+
+    g_mutex_lock(&lock);
+    sym = g_hash_table_lookup(symbols, GUINT_TO_POINTER(pc));
+    frame = sym ? g_strdup(sym) : g_strdup_printf("0x%016" PRIx64, pc);
+    key = percpu ? g_strdup_printf("cpu%u;%s", vcpu_index, frame)
+                 : g_steal_pointer(&frame);
+
+    count = g_hash_table_lookup(samples, key);
+    g_hash_table_replace(samples, key,
+                         GSIZE_TO_POINTER(GPOINTER_TO_SIZE(count) + 1));
+    g_mutex_unlock(&lock);
+}
+
+/*
+ * Resolve symbols while translating, which is when the instruction
+ * handles are available. This only costs anything for new code.
+ */
+static void vcpu_tb_trans(qemu_plugin_id_t id, struct qemu_plugin_tb *tb)
+{
+    size_t n = qemu_plugin_tb_n_insns(tb);
+    size_t i;
+
+    g_mutex_lock(&lock);
+    for (i = 0; i < n; i++) {
+        struct qemu_plugin_insn *insn = qemu_plugin_tb_get_insn(tb, i);
+        const char *sym = qemu_plugin_insn_symbol(insn);
+
+        if (sym) {
+            g_hash_table_insert(symbols,
+                                GUINT_TO_POINTER(qemu_plugin_insn_vaddr(insn)),
+                                (gpointer) sym);
+        }
+    }
+    g_mutex_unlock(&lock);
+}
+
+QEMU_PLUGIN_EXPORT
+int qemu_plugin_install(qemu_plugin_id_t id, const qemu_info_t *info,
+                        int argc, char **argv)
+{
+    int i;
+
+    for (i = 0; i < argc; i++) {
+        char *opt = argv[i];
+        if (g_strcmp0(opt, "percpu") == 0) {
+            percpu = true;
+        } else if (g_str_has_prefix(opt, "period=")) {
+            period_us = g_ascii_strtoull(opt + strlen("period="), NULL, 10);
+            if (period_us == 0) {
+                fprintf(stderr, "sampler: period must be at least 1us\n");
+                return -1;
+            }
+        } else {
+            fprintf(stderr, "option parsing failed: %s\n", opt);
+            return -1;
+        }
+    }
+
+    symbols = g_hash_table_new(NULL, g_direct_equal);
+    samples = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+    qemu_plugin_register_vcpu_tb_trans_cb(id, vcpu_tb_trans);
+    qemu_plugin_register_vcpu_sample_cb(id, period_us * 1000, vcpu_sample);
+    qemu_plugin_register_atexit_cb(id, plugin_exit, NULL);
+    return 0;
+}
@@ -32,6 +32,23 @@
 
 #include <gnutls/x509.h>
 
+#ifdef CONFIG_KTLS
+#include <netinet/tcp.h>
+#include <linux/tls.h>
+
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+
+/* Record content types, as reported by TLS_GET_RECORD_TYPE */
+#define QCRYPTO_TLS_RECORD_ALERT            21
+#define QCRYPTO_TLS_RECORD_HANDSHAKE        22
+#define QCRYPTO_TLS_RECORD_APPLICATION_DATA 23
+
+/* Handshake message type of a post-handshake session ticket */
+#define QCRYPTO_TLS_NEW_SESSION_TICKET      4
+#endif
+
 
 struct QCryptoTLSSession {
     QCryptoTLSCreds *creds;
@@ -43,6 +60,8 @@ struct QCryptoTLSSession {
     QCryptoTLSSessionReadFunc readFunc;
     void *opaque;
     char *peername;
+    int ktls;       /* QCRYPTO_TLS_KTLS_* directions run by the kernel */
+    int ktls_fd;
 };
 
 
@@ -436,7 +455,13 @@ qcrypto_tls_session_write(QCryptoTLSSession *session,
                           const char *buf,
                           size_t len)
 {
-    ssize_t ret = gnutls_record_send(session->handle, buf, len);
+    ssize_t ret;
+
+    if (session->ktls & QCRYPTO_TLS_KTLS_TX) {
+        return send(session->ktls_fd, buf, len, 0);
+    }
+
+    ret = gnutls_record_send(session->handle, buf, len);
 
     if (ret < 0) {
         switch (ret) {
@@ -457,12 +482,79 @@ qcrypto_tls_session_write(QCryptoTLSSession *session,
 }
 
 
+#ifdef CONFIG_KTLS
+/*
+ * Records other than application data are passed up with their type in
+ * a control message, and never merged with the data around them.
+ */
+static ssize_t
+qcrypto_tls_session_ktls_read(QCryptoTLSSession *session,
+                              char *buf,
+                              size_t len)
+{
+    char control[CMSG_SPACE(sizeof(unsigned char))];
+    struct iovec iov = { .iov_base = buf, .iov_len = len };
+    struct msghdr msg = { .msg_iov = &iov, .msg_iovlen = 1 };
+    struct cmsghdr *cmsg;
+    ssize_t ret;
+
+    for (;;) {
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        ret = recvmsg(session->ktls_fd, &msg, 0);
+        if (ret < 0) {
+            return -1;
+        }
+
+        cmsg = CMSG_FIRSTHDR(&msg);
+        if (!cmsg || cmsg->cmsg_level != SOL_TLS ||
+            cmsg->cmsg_type != TLS_GET_RECORD_TYPE) {
+            return ret;
+        }
+
+        switch (*CMSG_DATA(cmsg)) {
+        case QCRYPTO_TLS_RECORD_APPLICATION_DATA:
+            return ret;
+        case QCRYPTO_TLS_RECORD_HANDSHAKE:
+            /*
+             * Session tickets can be skipped, QEMU has no use for them;
+             * anything else, like a TLS 1.3 key update, would need GnuTLS.
+             */
+            if (ret > 0 && buf[0] == QCRYPTO_TLS_NEW_SESSION_TICKET) {
+                continue;
+            }
+            errno = EIO;
+            return -1;
+        case QCRYPTO_TLS_RECORD_ALERT:
+            /* The peer closed the session or gave up on it */
+            if (ret == 2 && buf[1] == GNUTLS_A_CLOSE_NOTIFY) {
+                return 0;
+            }
+            errno = ECONNABORTED;
+            return -1;
+        default:
+            errno = EIO;
+            return -1;
+        }
+    }
+}
+#endif
+
+
 ssize_t
 qcrypto_tls_session_read(QCryptoTLSSession *session,
                          char *buf,
                          size_t len)
 {
-    ssize_t ret = gnutls_record_recv(session->handle, buf, len);
+    ssize_t ret;
+
+#ifdef CONFIG_KTLS
+    if (session->ktls & QCRYPTO_TLS_KTLS_RX) {
+        return qcrypto_tls_session_ktls_read(session, buf, len);
+    }
+#endif
+
+    ret = gnutls_record_recv(session->handle, buf, len);
 
     if (ret < 0) {
         switch (ret) {
@@ -548,6 +640,108 @@ qcrypto_tls_session_get_peer_name(QCryptoTLSSession *session)
 }
 
 
+#ifdef CONFIG_KTLS
+/*
+ * Pass the keys and sequence number of one direction of the session
+ * to the kernel.  The TLS 1.2 explicit nonce is the sequence number
+ * in GnuTLS, while TLS 1.3 derives the whole nonce from the IV.
+ */
+static bool
+qcrypto_tls_session_ktls_setup(QCryptoTLSSession *session, int fd,
+                               int direction)
+{
+    union {
+        struct tls12_crypto_info_aes_gcm_128 aes128;
+        struct tls12_crypto_info_aes_gcm_256 aes256;
+    } info = {};
+    gnutls_datum_t mac_key, iv, key;
+    unsigned char seq[8];
+    uint16_t version;
+    bool tls13;
+    socklen_t len;
+
+    switch (gnutls_protocol_get_version(session->handle)) {
+    case GNUTLS_TLS1_2:
+        version = TLS_1_2_VERSION;
+        tls13 = false;
+        break;
+    case GNUTLS_TLS1_3:
+        version = TLS_1_3_VERSION;
+        tls13 = true;
+        break;
+    default:
+        return false;
+    }
+
+    if (gnutls_record_get_state(session->handle, direction == TLS_RX,
+                                &mac_key, &iv, &key, seq) < 0) {
+        return false;
+    }
+
+#define QCRYPTO_TLS_KTLS_INFO(field, CIPHER)                               \
+    do {                                                                   \
+        info.field.info.version = version;                                 \
+        info.field.info.cipher_type = TLS_CIPHER_##CIPHER;                 \
+        memcpy(info.field.salt, iv.data, TLS_CIPHER_##CIPHER##_SALT_SIZE);  \
+        memcpy(info.field.iv,                                              \
+               tls13 ? iv.data + TLS_CIPHER_##CIPHER##_SALT_SIZE : seq,     \
+               TLS_CIPHER_##CIPHER##_IV_SIZE);                              \
+        memcpy(info.field.key, key.data, TLS_CIPHER_##CIPHER##_KEY_SIZE);   \
+        memcpy(info.field.rec_seq, seq,                                    \
+               TLS_CIPHER_##CIPHER##_REC_SEQ_SIZE);                         \
+        len = sizeof(info.field);                                          \
+    } while (0)
+
+    switch (gnutls_cipher_get(session->handle)) {
+    case GNUTLS_CIPHER_AES_128_GCM:
+        QCRYPTO_TLS_KTLS_INFO(aes128, AES_GCM_128);
+        break;
+    case GNUTLS_CIPHER_AES_256_GCM:
+        QCRYPTO_TLS_KTLS_INFO(aes256, AES_GCM_256);
+        break;
+    default:
+        return false;
+    }
+
+#undef QCRYPTO_TLS_KTLS_INFO
+
+    return setsockopt(fd, SOL_TLS, direction, &info, len) == 0;
+}
+
+
+int
+qcrypto_tls_session_enable_ktls(QCryptoTLSSession *session, int fd)
+{
+    assert(session->handshakeComplete && !session->ktls);
+
+    if (setsockopt(fd, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) < 0) {
+        /* Not TCP, or the kernel has no TLS support */
+        return 0;
+    }
+
+    session->ktls_fd = fd;
+    if (qcrypto_tls_session_ktls_setup(session, fd, TLS_TX)) {
+        session->ktls |= QCRYPTO_TLS_KTLS_TX;
+    }
+
+    /* Records that GnuTLS has already read must be decrypted by it */
+    if (gnutls_record_check_pending(session->handle) == 0 &&
+        qcrypto_tls_session_ktls_setup(session, fd, TLS_RX)) {
+        session->ktls |= QCRYPTO_TLS_KTLS_RX;
+    }
+
+    trace_qcrypto_tls_session_ktls(session, fd, session->ktls);
+    return session->ktls;
+}
+#else
+int
+qcrypto_tls_session_enable_ktls(QCryptoTLSSession *session, int fd)
+{
+    return 0;
+}
+#endif
+
+
 #else /* ! CONFIG_GNUTLS */
 
 
@@ -639,4 +833,11 @@ qcrypto_tls_session_get_peer_name(QCryptoTLSSession *sess)
     return NULL;
 }
 
+
+int
+qcrypto_tls_session_enable_ktls(QCryptoTLSSession *sess, int fd)
+{
+    return 0;
+}
+
 #endif
@@ -29,6 +29,7 @@
 #include "qapi/qmp/qerror.h"
 #include "qemu/error-report.h"
 #include "qemu/main-loop.h"
+#include "qemu/thread.h"
 #include "hw/misc/vmcoreinfo.h"
 
 #ifdef TARGET_X86_64
@@ -42,6 +43,9 @@
 #ifdef CONFIG_SNAPPY
 #include <snappy-c.h>
 #endif
+#ifdef CONFIG_ZSTD
+#include <zstd.h>
+#endif
 #ifndef ELF_MACHINE_UNAME
 #define ELF_MACHINE_UNAME "Unknown"
 #endif
@@ -847,6 +851,11 @@ static void create_header32(DumpState *s, Error **errp)
     if (s->flag_compress & DUMP_DH_COMPRESSED_SNAPPY) {
         status |= DUMP_DH_COMPRESSED_SNAPPY;
     }
+#endif
+#ifdef CONFIG_ZSTD
+    if (s->flag_compress & DUMP_DH_COMPRESSED_ZSTD) {
+        status |= DUMP_DH_COMPRESSED_ZSTD;
+    }
 #endif
     dh->status = cpu_to_dump32(s, status);
 
@@ -959,6 +968,11 @@ static void create_header64(DumpState *s, Error **errp)
     if (s->flag_compress & DUMP_DH_COMPRESSED_SNAPPY) {
         status |= DUMP_DH_COMPRESSED_SNAPPY;
     }
+#endif
+#ifdef CONFIG_ZSTD
+    if (s->flag_compress & DUMP_DH_COMPRESSED_ZSTD) {
+        status |= DUMP_DH_COMPRESSED_ZSTD;
+    }
 #endif
     dh->status = cpu_to_dump32(s, status);
 
@@ -1286,6 +1300,11 @@ static size_t get_len_buf_out(size_t page_size, uint32_t flag_compress)
     case DUMP_DH_COMPRESSED_SNAPPY:
         return snappy_max_compressed_length(page_size);
 #endif
+
+#ifdef CONFIG_ZSTD
+    case DUMP_DH_COMPRESSED_ZSTD:
+        return ZSTD_compressBound(page_size);
+#endif
     }
     return 0;
 }
@@ -1298,20 +1317,217 @@ static inline bool is_zero_page(const uint8_t *buf, size_t page_size)
     return buffer_is_zero(buf, page_size);
 }
 
+/*
+ * Pages are compressed in batches of this many, spread over the
+ * compression threads, and then written out in order.
+ */
+#define DUMP_COMPRESS_BATCH         1024
+#define DUMP_MAX_COMPRESS_THREADS   16
+
+typedef struct DumpPage {
+    uint8_t *buf;               /* the guest page */
+    uint8_t *buf_out;           /* len_buf_out bytes for compressed data */
+    size_t size_out;
+    uint32_t flags;             /* DUMP_DH_COMPRESSED_*, 0 if plaintext */
+    bool zero;
+} DumpPage;
+
+typedef struct DumpCompress DumpCompress;
+
+typedef struct DumpCompressThread {
+    DumpCompress *c;
+    int index;
+    QemuThread thread;
+    QemuSemaphore sem;
+#ifdef CONFIG_LZO
+    lzo_bytep wrkmem;
+#endif
+#ifdef CONFIG_ZSTD
+    ZSTD_CCtx *zstd;
+#endif
+} DumpCompressThread;
+
+struct DumpCompress {
+    DumpState *s;
+    size_t len_buf_out;
+    DumpPage pages[DUMP_COMPRESS_BATCH];
+    int nr_pages;
+    bool quit;
+    QemuSemaphore done;
+    /* the dumping thread itself is the first of these */
+    int nr_threads;
+    DumpCompressThread threads[DUMP_MAX_COMPRESS_THREADS];
+};
+
+/*
+ * Check for a zero page and compress the page otherwise.  Only one
+ * compression format is set in s->flag_compress, but when compression
+ * fails to work or does not make the page smaller, it is saved in
+ * plaintext.
+ */
+static void dump_compress_page(DumpCompress *c, DumpCompressThread *t,
+                               DumpPage *p)
+{
+    DumpState *s = c->s;
+    size_t page_size = s->dump_info.page_size;
+    size_t size_out = c->len_buf_out;
+    bool ok = false;
+
+    p->zero = is_zero_page(p->buf, page_size);
+    if (p->zero) {
+        return;
+    }
+
+    switch (s->flag_compress) {
+    case DUMP_DH_COMPRESSED_ZLIB:
+        ok = compress2(p->buf_out, (uLongf *)&size_out, p->buf, page_size,
+                       Z_BEST_SPEED) == Z_OK;
+        break;
+#ifdef CONFIG_LZO
+    case DUMP_DH_COMPRESSED_LZO:
+        ok = lzo1x_1_compress(p->buf, page_size, p->buf_out,
+                              (lzo_uint *)&size_out, t->wrkmem) == LZO_E_OK;
+        break;
+#endif
+#ifdef CONFIG_SNAPPY
+    case DUMP_DH_COMPRESSED_SNAPPY:
+        ok = snappy_compress((char *)p->buf, page_size,
+                             (char *)p->buf_out, &size_out) == SNAPPY_OK;
+        break;
+#endif
+#ifdef CONFIG_ZSTD
+    case DUMP_DH_COMPRESSED_ZSTD:
+        size_out = ZSTD_compressCCtx(t->zstd, p->buf_out, c->len_buf_out,
+                                     p->buf, page_size, 1);
+        ok = !ZSTD_isError(size_out);
+        break;
+#endif
+    }
+
+    if (ok && size_out < page_size) {
+        p->flags = s->flag_compress;
+        p->size_out = size_out;
+    } else {
+        p->flags = 0;
+        p->size_out = page_size;
+    }
+}
+
+/* Thread @t takes every nr_threads-th page of the batch */
+static void dump_compress_batch_part(DumpCompress *c, DumpCompressThread *t)
+{
+    int i;
+
+    for (i = t->index; i < c->nr_pages; i += c->nr_threads) {
+        dump_compress_page(c, t, &c->pages[i]);
+    }
+}
+
+static void *dump_compress_thread(void *opaque)
+{
+    DumpCompressThread *t = opaque;
+    DumpCompress *c = t->c;
+
+    for (;;) {
+        qemu_sem_wait(&t->sem);
+        if (c->quit) {
+            break;
+        }
+        dump_compress_batch_part(c, t);
+        qemu_sem_post(&c->done);
+    }
+    return NULL;
+}
+
+static void dump_compress_batch(DumpCompress *c)
+{
+    int i;
+
+    for (i = 1; i < c->nr_threads; i++) {
+        qemu_sem_post(&c->threads[i].sem);
+    }
+    dump_compress_batch_part(c, &c->threads[0]);
+    for (i = 1; i < c->nr_threads; i++) {
+        qemu_sem_wait(&c->done);
+    }
+}
+
+static DumpCompress *dump_compress_new(DumpState *s, size_t len_buf_out)
+{
+    DumpCompress *c = g_new0(DumpCompress, 1);
+    int i;
+
+    c->s = s;
+    c->len_buf_out = len_buf_out;
+    c->nr_threads = MIN(g_get_num_processors(), DUMP_MAX_COMPRESS_THREADS);
+    qemu_sem_init(&c->done, 0);
+
+    for (i = 0; i < DUMP_COMPRESS_BATCH; i++) {
+        c->pages[i].buf_out = g_malloc(len_buf_out);
+    }
+
+    for (i = 0; i < c->nr_threads; i++) {
+        DumpCompressThread *t = &c->threads[i];
+
+        t->c = c;
+        t->index = i;
+#ifdef CONFIG_LZO
+        t->wrkmem = g_malloc(LZO1X_1_MEM_COMPRESS);
+#endif
+#ifdef CONFIG_ZSTD
+        t->zstd = ZSTD_createCCtx();
+#endif
+        if (i > 0) {
+            qemu_sem_init(&t->sem, 0);
+            qemu_thread_create(&t->thread, "dump-compress",
+                               dump_compress_thread, t, QEMU_THREAD_JOINABLE);
+        }
+    }
+
+    return c;
+}
+
+static void dump_compress_free(DumpCompress *c)
+{
+    int i;
+
+    c->quit = true;
+    for (i = 0; i < c->nr_threads; i++) {
+        DumpCompressThread *t = &c->threads[i];
+
+        if (i > 0) {
+            qemu_sem_post(&t->sem);
+            qemu_thread_join(&t->thread);
+            qemu_sem_destroy(&t->sem);
+        }
+#ifdef CONFIG_LZO
+        g_free(t->wrkmem);
+#endif
+#ifdef CONFIG_ZSTD
+        ZSTD_freeCCtx(t->zstd);
+#endif
+    }
+
+    for (i = 0; i < DUMP_COMPRESS_BATCH; i++) {
+        g_free(c->pages[i].buf_out);
+    }
+    qemu_sem_destroy(&c->done);
+    g_free(c);
+}
+
 static void write_dump_pages(DumpState *s, Error **errp)
 {
     int ret = 0;
     DataCache page_desc, page_data;
-    size_t len_buf_out, size_out;
-#ifdef CONFIG_LZO
-    lzo_bytep wrkmem = NULL;
-#endif
-    uint8_t *buf_out = NULL;
+    size_t len_buf_out;
+    DumpCompress *c;
     off_t offset_desc, offset_data;
     PageDescriptor pd, pd_zero;
     uint8_t *buf;
     GuestPhysBlock *block_iter = NULL;
     uint64_t pfn_iter;
+    bool more = true;
+    int i;
 
     /* get offset of page_desc and page_data in dump file */
     offset_desc = s->offset_page;
@@ -1324,11 +1540,7 @@ static void write_dump_pages(DumpState *s, Error **errp)
     len_buf_out = get_len_buf_out(s->dump_info.page_size, s->flag_compress);
     assert(len_buf_out != 0);
 
-#ifdef CONFIG_LZO
-    wrkmem = g_malloc(LZO1X_1_MEM_COMPRESS);
-#endif
-
-    buf_out = g_malloc(len_buf_out);
+    c = dump_compress_new(s, len_buf_out);
 
     /*
      * init zero page's page_desc and page_data, because every zero page
@@ -1352,97 +1564,60 @@ static void write_dump_pages(DumpState *s, Error **errp)
      * dump memory to vmcore page by page. zero page will all be resided in the
      * first page of page section
      */
-    while (get_next_page(&block_iter, &pfn_iter, &buf, s)) {
-        /* check zero page */
-        if (is_zero_page(buf, s->dump_info.page_size)) {
-            ret = write_cache(&page_desc, &pd_zero, sizeof(PageDescriptor),
-                              false);
-            if (ret < 0) {
-                error_setg(errp, "dump: failed to write page desc");
-                goto out;
+    while (more) {
+        for (c->nr_pages = 0; c->nr_pages < DUMP_COMPRESS_BATCH;
+             c->nr_pages++) {
+            more = get_next_page(&block_iter, &pfn_iter, &buf, s);
+            if (!more) {
+                break;
             }
-        } else {
+            c->pages[c->nr_pages].buf = buf;
+        }
+
+        dump_compress_batch(c);
+
+        for (i = 0; i < c->nr_pages; i++) {
+            DumpPage *p = &c->pages[i];
+
+            /* check zero page */
+            if (p->zero) {
+                ret = write_cache(&page_desc, &pd_zero, sizeof(PageDescriptor),
+                                  false);
+                if (ret < 0) {
+                    error_setg(errp, "dump: failed to write page desc");
+                    goto out;
+                }
+                s->written_size += s->dump_info.page_size;
+                continue;
+            }
+
             /*
              * not zero page, then:
-             * 1. compress the page
-             * 2. write the compressed page into the cache of page_data
-             * 3. get page desc of the compressed page and write it into the
+             * 1. write the compressed page into the cache of page_data
+             * 2. get page desc of the compressed page and write it into the
              *    cache of page_desc
-             *
-             * only one compression format will be used here, for
-             * s->flag_compress is set. But when compression fails to work,
-             * we fall back to save in plaintext.
              */
-             size_out = len_buf_out;
-             if ((s->flag_compress & DUMP_DH_COMPRESSED_ZLIB) &&
-                    (compress2(buf_out, (uLongf *)&size_out, buf,
-                               s->dump_info.page_size, Z_BEST_SPEED) == Z_OK) &&
-                    (size_out < s->dump_info.page_size)) {
-                pd.flags = cpu_to_dump32(s, DUMP_DH_COMPRESSED_ZLIB);
-                pd.size  = cpu_to_dump32(s, size_out);
-
-                ret = write_cache(&page_data, buf_out, size_out, false);
-                if (ret < 0) {
-                    error_setg(errp, "dump: failed to write page data");
-                    goto out;
-                }
-#ifdef CONFIG_LZO
-            } else if ((s->flag_compress & DUMP_DH_COMPRESSED_LZO) &&
-                    (lzo1x_1_compress(buf, s->dump_info.page_size, buf_out,
-                    (lzo_uint *)&size_out, wrkmem) == LZO_E_OK) &&
-                    (size_out < s->dump_info.page_size)) {
-                pd.flags = cpu_to_dump32(s, DUMP_DH_COMPRESSED_LZO);
-                pd.size  = cpu_to_dump32(s, size_out);
-
-                ret = write_cache(&page_data, buf_out, size_out, false);
-                if (ret < 0) {
-                    error_setg(errp, "dump: failed to write page data");
-                    goto out;
-                }
-#endif
-#ifdef CONFIG_SNAPPY
-            } else if ((s->flag_compress & DUMP_DH_COMPRESSED_SNAPPY) &&
-                    (snappy_compress((char *)buf, s->dump_info.page_size,
-                    (char *)buf_out, &size_out) == SNAPPY_OK) &&
-                    (size_out < s->dump_info.page_size)) {
-                pd.flags = cpu_to_dump32(s, DUMP_DH_COMPRESSED_SNAPPY);
-                pd.size  = cpu_to_dump32(s, size_out);
-
-                ret = write_cache(&page_data, buf_out, size_out, false);
-                if (ret < 0) {
-                    error_setg(errp, "dump: failed to write page data");
-                    goto out;
-                }
-#endif
-            } else {
-                /*
-                 * fall back to save in plaintext, size_out should be
-                 * assigned the target's page size
-                 */
-                pd.flags = cpu_to_dump32(s, 0);
-                size_out = s->dump_info.page_size;
-                pd.size = cpu_to_dump32(s, size_out);
-
-                ret = write_cache(&page_data, buf,
-                                  s->dump_info.page_size, false);
-                if (ret < 0) {
-                    error_setg(errp, "dump: failed to write page data");
-                    goto out;
-                }
+            ret = write_cache(&page_data, p->flags ? p->buf_out : p->buf,
+                              p->size_out, false);
+            if (ret < 0) {
+                error_setg(errp, "dump: failed to write page data");
+                goto out;
             }
 
             /* get and write page desc here */
+            pd.flags = cpu_to_dump32(s, p->flags);
+            pd.size = cpu_to_dump32(s, p->size_out);
             pd.page_flags = cpu_to_dump64(s, 0);
             pd.offset = cpu_to_dump64(s, offset_data);
-            offset_data += size_out;
+            offset_data += p->size_out;
 
             ret = write_cache(&page_desc, &pd, sizeof(PageDescriptor), false);
             if (ret < 0) {
                 error_setg(errp, "dump: failed to write page desc");
                 goto out;
             }
+            s->written_size += s->dump_info.page_size;
         }
-        s->written_size += s->dump_info.page_size;
     }
 
     ret = write_cache(&page_desc, NULL, 0, true);
@@ -1459,12 +1634,7 @@ static void write_dump_pages(DumpState *s, Error **errp)
 out:
     free_data_cache(&page_desc);
     free_data_cache(&page_data);
-
-#ifdef CONFIG_LZO
-    g_free(wrkmem);
-#endif
-
-    g_free(buf_out);
+    dump_compress_free(c);
 }
 
 static void create_kdump_vmcore(DumpState *s, Error **errp)
@@ -1805,6 +1975,10 @@ static void dump_init(DumpState *s, int fd, bool has_format,
             s->flag_compress = DUMP_DH_COMPRESSED_SNAPPY;
             break;
 
+        case DUMP_GUEST_MEMORY_FORMAT_KDUMP_ZSTD:
+            s->flag_compress = DUMP_DH_COMPRESSED_ZSTD;
+            break;
+
         default:
             s->flag_compress = 0;
         }
@@ -1962,7 +2136,7 @@ void qmp_dump_guest_memory(bool paging, const char *file,
         detach_p = detach;
     }
 
-    /* check whether lzo/snappy is supported */
+    /* check whether lzo/snappy/zstd is supported */
 #ifndef CONFIG_LZO
     if (has_format && format == DUMP_GUEST_MEMORY_FORMAT_KDUMP_LZO) {
         error_setg(errp, "kdump-lzo is not available now");
@@ -1977,6 +2151,13 @@ void qmp_dump_guest_memory(bool paging, const char *file,
     }
 #endif
 
+#ifndef CONFIG_ZSTD
+    if (has_format && format == DUMP_GUEST_MEMORY_FORMAT_KDUMP_ZSTD) {
+        error_setg(errp, "kdump-zstd is not available now");
+        return;
+    }
+#endif
+
 #ifndef TARGET_X86_64
     if (has_format && format == DUMP_GUEST_MEMORY_FORMAT_WIN_DMP) {
         error_setg(errp, "Windows dump is only available for x86-64");
@@ -2050,6 +2231,11 @@ DumpGuestMemoryCapability *qmp_query_dump_guest_memory_capability(Error **errp)
     QAPI_LIST_APPEND(tail, DUMP_GUEST_MEMORY_FORMAT_KDUMP_SNAPPY);
 #endif
 
+    /* add new item if kdump-zstd is available */
+#ifdef CONFIG_ZSTD
+    QAPI_LIST_APPEND(tail, DUMP_GUEST_MEMORY_FORMAT_KDUMP_ZSTD);
+#endif
+
     /* Windows dump is available only if target is x86_64 */
 #ifdef TARGET_X86_64
     QAPI_LIST_APPEND(tail, DUMP_GUEST_MEMORY_FORMAT_WIN_DMP);
@@ -0,0 +1,173 @@
+/*
+ * eBPF RSS loader
+ *
+ * The steering program is built from tools/ebpf/rss.bpf.c into an eBPF
+ * object file, which is opened, loaded into the kernel and configured
+ * through its maps here.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+
+#include <bpf/libbpf.h>
+#include <bpf/bpf.h>
+
+#include "hw/virtio/virtio-net.h" /* VIRTIO_NET_RSS_MAX_TABLE_LEN */
+
+#include "ebpf/ebpf_rss.h"
+#include "trace.h"
+
+#define EBPF_RSS_PROGRAM_NAME "tun_rss_steering_prog"
+
+void ebpf_rss_init(struct EBPFRSSContext *ctx)
+{
+    if (ctx != NULL) {
+        ctx->obj = NULL;
+    }
+}
+
+bool ebpf_rss_is_loaded(struct EBPFRSSContext *ctx)
+{
+    return ctx != NULL && ctx->obj != NULL;
+}
+
+bool ebpf_rss_load(struct EBPFRSSContext *ctx, const char *path)
+{
+    struct bpf_object *obj;
+    struct bpf_program *prog;
+
+    if (ctx == NULL) {
+        return false;
+    }
+
+    obj = bpf_object__open_file(path, NULL);
+    if (libbpf_get_error(obj)) {
+        trace_ebpf_error("eBPF RSS", "can not open eBPF RSS object");
+        return false;
+    }
+
+    if (bpf_object__load(obj)) {
+        trace_ebpf_error("eBPF RSS", "can not load RSS program");
+        goto error;
+    }
+
+    prog = bpf_object__find_program_by_name(obj, EBPF_RSS_PROGRAM_NAME);
+    if (prog == NULL) {
+        trace_ebpf_error("eBPF RSS", "no RSS program in the object");
+        goto error;
+    }
+
+    ctx->program_fd = bpf_program__fd(prog);
+    ctx->map_configuration =
+        bpf_object__find_map_fd_by_name(obj, "tap_rss_map_configurations");
+    ctx->map_toeplitz_key =
+        bpf_object__find_map_fd_by_name(obj, "tap_rss_map_toeplitz_key");
+    ctx->map_indirections_table =
+        bpf_object__find_map_fd_by_name(obj, "tap_rss_map_indirection_table");
+
+    if (ctx->program_fd < 0 || ctx->map_configuration < 0 ||
+        ctx->map_toeplitz_key < 0 || ctx->map_indirections_table < 0) {
+        trace_ebpf_error("eBPF RSS", "RSS object lacks a program or map");
+        goto error;
+    }
+
+    ctx->obj = obj;
+
+    return true;
+error:
+    bpf_object__close(obj);
+
+    return false;
+}
+
+static bool ebpf_rss_set_config(struct EBPFRSSContext *ctx,
+                                struct EBPFRSSConfig *config)
+{
+    uint32_t map_key = 0;
+
+    if (!ebpf_rss_is_loaded(ctx)) {
+        return false;
+    }
+    if (bpf_map_update_elem(ctx->map_configuration,
+                            &map_key, config, 0) < 0) {
+        return false;
+    }
+    return true;
+}
+
+static bool ebpf_rss_set_indirections_table(struct EBPFRSSContext *ctx,
+                                            uint16_t *indirections_table,
+                                            size_t len)
+{
+    uint32_t i = 0;
+
+    if (!ebpf_rss_is_loaded(ctx) || indirections_table == NULL ||
+        len > VIRTIO_NET_RSS_MAX_TABLE_LEN) {
+        return false;
+    }
+
+    for (; i < len; ++i) {
+        if (bpf_map_update_elem(ctx->map_indirections_table, &i,
+                                indirections_table + i, 0) < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool ebpf_rss_set_toeplitz_key(struct EBPFRSSContext *ctx,
+                                      uint8_t *toeplitz_key)
+{
+    uint32_t map_key = 0;
+
+    /* prepare toeplitz key */
+    uint8_t toe[VIRTIO_NET_RSS_MAX_KEY_SIZE] = {};
+
+    if (!ebpf_rss_is_loaded(ctx) || toeplitz_key == NULL) {
+        return false;
+    }
+    memcpy(toe, toeplitz_key, VIRTIO_NET_RSS_MAX_KEY_SIZE);
+    *(uint32_t *)toe = ntohl(*(uint32_t *)toe);
+
+    if (bpf_map_update_elem(ctx->map_toeplitz_key, &map_key, toe,
+                            0) < 0) {
+        return false;
+    }
+    return true;
+}
+
+bool ebpf_rss_set_all(struct EBPFRSSContext *ctx, struct EBPFRSSConfig *config,
+                      uint16_t *indirections_table, uint8_t *toeplitz_key)
+{
+    if (!ebpf_rss_is_loaded(ctx) || config == NULL ||
+        indirections_table == NULL || toeplitz_key == NULL) {
+        return false;
+    }
+
+    if (!ebpf_rss_set_config(ctx, config)) {
+        return false;
+    }
+
+    if (!ebpf_rss_set_indirections_table(ctx, indirections_table,
+                                         config->indirections_len)) {
+        return false;
+    }
+
+    if (!ebpf_rss_set_toeplitz_key(ctx, toeplitz_key)) {
+        return false;
+    }
+
+    return true;
+}
+
+void ebpf_rss_unload(struct EBPFRSSContext *ctx)
+{
+    if (!ebpf_rss_is_loaded(ctx)) {
+        return;
+    }
+
+    bpf_object__close(ctx->obj);
+    ctx->obj = NULL;
+}
@@ -0,0 +1,42 @@
+/*
+ * eBPF RSS header
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#ifndef QEMU_EBPF_RSS_H
+#define QEMU_EBPF_RSS_H
+
+typedef struct EBPFRSSContext {
+    void *obj;
+    int program_fd;
+    int map_configuration;
+    int map_toeplitz_key;
+    int map_indirections_table;
+} EBPFRSSContext;
+
+/*
+ * Layout of the single entry of the configuration map, shared with
+ * tools/ebpf/rss.bpf.c.
+ */
+struct EBPFRSSConfig {
+    uint8_t redirect;
+    uint8_t populate_hash;
+    uint32_t hash_types;
+    uint16_t indirections_len;
+    uint16_t default_queue;
+} __attribute__((packed));
+
+void ebpf_rss_init(EBPFRSSContext *ctx);
+
+bool ebpf_rss_is_loaded(EBPFRSSContext *ctx);
+
+bool ebpf_rss_load(EBPFRSSContext *ctx, const char *path);
+
+bool ebpf_rss_set_all(EBPFRSSContext *ctx, struct EBPFRSSConfig *config,
+                      uint16_t *indirections_table, uint8_t *toeplitz_key);
+
+void ebpf_rss_unload(EBPFRSSContext *ctx);
+
+#endif /* QEMU_EBPF_RSS_H */
@@ -298,6 +298,23 @@ SRST
     Show dynamic compiler opcode counters
 ERST
 
+#if defined(CONFIG_TCG)
+    {
+        .name       = "tb-list",
+        .args_type  = "count:i?,sort:s?",
+        .params     = "[count [executions|exits|spills|translations]]",
+        .help       = "show the hottest translation blocks",
+        .cmd        = hmp_info_tb_list,
+    },
+#endif
+
+SRST
+  ``info tb-list`` *[count [sort]]*
+    Show the *count* translation blocks (default 10) with the most
+    executions, or with the highest *sort* statistic.  Needs
+    ``tb_stats start``.
+ERST
+
     {
         .name       = "sync-profile",
         .args_type  = "mean:-m,no_coalesce:-n,max:i?",
@@ -324,6 +341,36 @@ SRST
     being coalesced.
 ERST
 
+    {
+        .name       = "coroutine-pool",
+        .args_type  = "",
+        .params     = "",
+        .help       = "show coroutine pool statistics",
+        .cmd        = hmp_info_coroutine_pool,
+    },
+
+SRST
+  ``info coroutine-pool``
+    Show the size of the per-thread coroutine pools, how many coroutines
+    were taken from them (hits) or had to be allocated (misses), and how
+    many were freed because the pools were full.
+ERST
+
+    {
+        .name       = "rcu",
+        .args_type  = "",
+        .params     = "",
+        .help       = "show RCU callback statistics",
+        .cmd        = hmp_info_rcu,
+    },
+
+SRST
+  ``info rcu``
+    Show how many RCU callbacks are waiting for a grace period, the largest
+    batch the call_rcu thread processed at once, and how many callbacks and
+    grace periods have completed.
+ERST
+
     {
         .name       = "kvm",
         .args_type  = "",
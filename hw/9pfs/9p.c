@@ -1394,6 +1394,7 @@ static void coroutine_fn v9fs_attach(void *opaque)
     V9fsFidState *fidp;
     size_t offset = 7;
     V9fsQID qid;
+    struct stat stbuf;
     ssize_t err;
 
     v9fs_string_init(&uname);
@@ -1417,7 +1418,13 @@ static void coroutine_fn v9fs_attach(void *opaque)
         clunk_fid(s, fid);
         goto out;
     }
-    err = fid_to_qid(pdu, fidp, &qid);
+    err = v9fs_co_lstat(pdu, &fidp->path, &stbuf);
+    if (err < 0) {
+        err = -EINVAL;
+        clunk_fid(s, fid);
+        goto out;
+    }
+    err = stat_to_qid(pdu, &stbuf, &qid);
     if (err < 0) {
         err = -EINVAL;
         clunk_fid(s, fid);
@@ -1450,6 +1457,7 @@ static void coroutine_fn v9fs_attach(void *opaque)
     err += offset;
 
     memcpy(&s->root_qid, &qid, sizeof(qid));
+    s->root_st = stbuf;
     trace_v9fs_attach_return(pdu->tag, pdu->id,
                              qid.type, qid.version, qid.path);
 out:
@@ -1700,12 +1708,49 @@ static bool name_is_illegal(const char *name)
     return !*name || strchr(name, '/') != NULL;
 }
 
-static bool not_same_qid(const V9fsQID *qid1, const V9fsQID *qid2)
+static bool same_stat_id(const struct stat *a, const struct stat *b)
+{
+    return a->st_dev == b->st_dev && a->st_ino == b->st_ino;
+}
+
+/*
+ * Runs on a worker thread: stat @dpath, then resolve and stat each of the
+ * @nwnames names in turn, so that a whole Twalk costs a single round trip
+ * to the worker.  ".." at the export root does not move and leaves its
+ * @pathes and @stbufs entries untouched.
+ */
+static int v9fs_walk_names(V9fsPDU *pdu, V9fsPath *dpath,
+                           V9fsString *wnames, uint16_t nwnames,
+                           struct stat *fidst, V9fsPath *pathes,
+                           struct stat *stbufs)
 {
-    return
-        qid1->type != qid2->type ||
-        qid1->version != qid2->version ||
-        qid1->path != qid2->path;
+    V9fsState *s = pdu->s;
+    struct stat *st = fidst;
+    int name_idx;
+
+    if (s->ops->lstat(&s->ctx, dpath, fidst) < 0) {
+        return -errno;
+    }
+    for (name_idx = 0; name_idx < nwnames; name_idx++) {
+        if (v9fs_request_cancelled(pdu)) {
+            return -EINTR;
+        }
+        if (same_stat_id(&s->root_st, st) &&
+            !strcmp("..", wnames[name_idx].data)) {
+            continue;
+        }
+        if (s->ops->name_to_path(&s->ctx, dpath, wnames[name_idx].data,
+                                 &pathes[name_idx]) < 0) {
+            return -errno;
+        }
+        if (s->ops->lstat(&s->ctx, &pathes[name_idx],
+                          &stbufs[name_idx]) < 0) {
+            return -errno;
+        }
+        st = &stbufs[name_idx];
+        v9fs_path_copy(dpath, &pathes[name_idx]);
+    }
+    return 0;
 }
 
 static void coroutine_fn v9fs_walk(void *opaque)
@@ -1713,9 +1758,9 @@ static void coroutine_fn v9fs_walk(void *opaque)
     int name_idx;
     V9fsQID *qids = NULL;
     int i, err = 0;
-    V9fsPath dpath, path;
+    V9fsPath dpath, path, *pathes = NULL;
     uint16_t nwnames;
-    struct stat stbuf;
+    struct stat fidst, *stbuf, *stbufs = NULL;
     size_t offset = 7;
     int32_t fid, newfid;
     V9fsString *wnames = NULL;
@@ -1737,6 +1782,8 @@ static void coroutine_fn v9fs_walk(void *opaque)
     if (nwnames && nwnames <= P9_MAXWELEM) {
         wnames = g_new0(V9fsString, nwnames);
         qids   = g_new0(V9fsQID, nwnames);
+        pathes = g_new0(V9fsPath, nwnames);
+        stbufs = g_new0(struct stat, nwnames);
         for (i = 0; i < nwnames; i++) {
             err = pdu_unmarshal(pdu, offset, "s", &wnames[i]);
             if (err < 0) {
@@ -1761,35 +1808,46 @@ static void coroutine_fn v9fs_walk(void *opaque)
     v9fs_path_init(&dpath);
     v9fs_path_init(&path);
 
-    err = fid_to_qid(pdu, fidp, &qid);
+    /*
+     * Look up all the names with the fs driver first, in one go on a
+     * worker thread, and only then compute the qids on the main thread.
+     */
+    v9fs_path_copy(&dpath, &fidp->path);
+    if (v9fs_request_cancelled(pdu)) {
+        err = -EINTR;
+        goto out;
+    }
+    v9fs_path_read_lock(s);
+    v9fs_co_run_in_worker(
+        {
+            err = v9fs_walk_names(pdu, &dpath, wnames, nwnames, &fidst,
+                                  pathes, stbufs);
+        });
+    v9fs_path_unlock(s);
+    if (err < 0) {
+        goto out;
+    }
+
+    err = stat_to_qid(pdu, &fidst, &qid);
     if (err < 0) {
         goto out;
     }
 
     /*
-     * Both dpath and path initially poin to fidp.
+     * path initially points to fidp.
      * Needed to handle request with nwnames == 0
      */
-    v9fs_path_copy(&dpath, &fidp->path);
     v9fs_path_copy(&path, &fidp->path);
+    stbuf = &fidst;
     for (name_idx = 0; name_idx < nwnames; name_idx++) {
-        if (not_same_qid(&pdu->s->root_qid, &qid) ||
+        if (!same_stat_id(&s->root_st, stbuf) ||
             strcmp("..", wnames[name_idx].data)) {
-            err = v9fs_co_name_to_path(pdu, &dpath, wnames[name_idx].data,
-                                       &path);
-            if (err < 0) {
-                goto out;
-            }
-
-            err = v9fs_co_lstat(pdu, &path, &stbuf);
-            if (err < 0) {
-                goto out;
-            }
-            err = stat_to_qid(pdu, &stbuf, &qid);
+            stbuf = &stbufs[name_idx];
+            err = stat_to_qid(pdu, stbuf, &qid);
             if (err < 0) {
                 goto out;
             }
-            v9fs_path_copy(&dpath, &path);
+            v9fs_path_copy(&path, &pathes[name_idx]);
         }
         memcpy(&qids[name_idx], &qid, sizeof(qid));
     }
@@ -1824,9 +1882,12 @@ out_nofid:
     if (nwnames && nwnames <= P9_MAXWELEM) {
         for (name_idx = 0; name_idx < nwnames; name_idx++) {
             v9fs_string_free(&wnames[name_idx]);
+            v9fs_path_free(&pathes[name_idx]);
         }
         g_free(wnames);
         g_free(qids);
+        g_free(pathes);
+        g_free(stbufs);
     }
 }
 
@@ -43,8 +43,26 @@ struct VirtIOBlockDataPlane {
      */
     IOThread *iothread;
     AioContext *ctx;
+
+    /*
+     * With the iothreads property, the AioContext of each virtqueue and the
+     * distinct AioContexts other than ctx.  The first IOThread is the home
+     * of the BlockBackend and is also stored in iothread/ctx.
+     */
+    IOThread **iothreads;
+    unsigned num_iothreads;
+    AioContext **vq_aio_context;
+    AioContext **mq_ctx;
+    unsigned num_mq_ctx;
+    bool multiqueue;
 };
 
+/* The AioContext that serves @vq while dataplane is running */
+static AioContext *vq_get_aio_context(VirtIOBlockDataPlane *s, unsigned i)
+{
+    return s->multiqueue ? s->vq_aio_context[i] : s->ctx;
+}
+
 /* Raise an interrupt to signal guest, if necessary */
 void virtio_blk_data_plane_notify(VirtIOBlockDataPlane *s, VirtQueue *vq)
 {
@@ -91,7 +109,7 @@ bool virtio_blk_data_plane_create(VirtIODevice *vdev, VirtIOBlkConf *conf,
 
     *dataplane = NULL;
 
-    if (conf->iothread) {
+    if (conf->iothread || conf->num_iothreads) {
         if (!k->set_guest_notifiers || !k->ioeventfd_assign) {
             error_setg(errp,
                        "device is incompatible with iothread "
@@ -120,7 +138,45 @@ bool virtio_blk_data_plane_create(VirtIODevice *vdev, VirtIOBlkConf *conf,
     s->vdev = vdev;
     s->conf = conf;
 
-    if (conf->iothread) {
+    if (conf->num_iothreads) {
+        unsigned i, j;
+
+        s->iothreads = g_new0(IOThread *, conf->num_iothreads);
+        for (i = 0; i < conf->num_iothreads; i++) {
+            s->iothreads[i] = iothread_by_id(conf->iothreads[i]);
+            if (!s->iothreads[i]) {
+                error_setg(errp, "IOThread '%s' not found",
+                           conf->iothreads[i]);
+                while (i--) {
+                    object_unref(OBJECT(s->iothreads[i]));
+                }
+                g_free(s->iothreads);
+                g_free(s);
+                return false;
+            }
+            object_ref(OBJECT(s->iothreads[i]));
+        }
+        s->num_iothreads = conf->num_iothreads;
+
+        s->iothread = s->iothreads[0];
+        object_ref(OBJECT(s->iothread));
+        s->ctx = iothread_get_aio_context(s->iothread);
+
+        s->vq_aio_context = g_new(AioContext *, conf->num_queues);
+        s->mq_ctx = g_new(AioContext *, s->num_iothreads);
+        for (i = 0; i < conf->num_queues; i++) {
+            AioContext *ctx =
+                iothread_get_aio_context(s->iothreads[i % s->num_iothreads]);
+
+            s->vq_aio_context[i] = ctx;
+            for (j = 0; j < s->num_mq_ctx && s->mq_ctx[j] != ctx; j++) {
+                /* look for a duplicate */
+            }
+            if (ctx != s->ctx && j == s->num_mq_ctx) {
+                s->mq_ctx[s->num_mq_ctx++] = ctx;
+            }
+        }
+    } else if (conf->iothread) {
         s->iothread = conf->iothread;
         object_ref(OBJECT(s->iothread));
         s->ctx = iothread_get_aio_context(s->iothread);
@@ -139,6 +195,7 @@ bool virtio_blk_data_plane_create(VirtIODevice *vdev, VirtIOBlkConf *conf,
 void virtio_blk_data_plane_destroy(VirtIOBlockDataPlane *s)
 {
     VirtIOBlock *vblk;
+    unsigned i;
 
     if (!s) {
         return;
@@ -151,6 +208,12 @@ void virtio_blk_data_plane_destroy(VirtIOBlockDataPlane *s)
     if (s->iothread) {
         object_unref(OBJECT(s->iothread));
     }
+    for (i = 0; i < s->num_iothreads; i++) {
+        object_unref(OBJECT(s->iothreads[i]));
+    }
+    g_free(s->iothreads);
+    g_free(s->vq_aio_context);
+    g_free(s->mq_ctx);
     g_free(s);
 }
 
@@ -165,6 +228,46 @@ static bool virtio_blk_data_plane_handle_output(VirtIODevice *vdev,
     return virtio_blk_handle_vq(s, vq);
 }
 
+/*
+ * Let the other IOThreads submit requests to the BlockBackend.  If the
+ * block graph cannot do that, all virtqueues fall back to the first
+ * IOThread.
+ *
+ * Context: QEMU global mutex and s->ctx held
+ */
+static void virtio_blk_data_plane_enable_multiqueue(VirtIOBlockDataPlane *s)
+{
+    BlockBackend *blk = s->conf->conf.blk;
+    Error *local_err = NULL;
+    unsigned i;
+
+    for (i = 0; i < s->num_mq_ctx; i++) {
+        if (blk_enable_multiqueue(blk, s->mq_ctx[i], &local_err) < 0) {
+            warn_reportf_err(local_err, "virtio-blk: using only IOThread "
+                             "'%s': ", s->conf->iothreads[0]);
+            while (i--) {
+                blk_disable_multiqueue(blk, s->mq_ctx[i]);
+            }
+            return;
+        }
+    }
+    s->multiqueue = s->num_mq_ctx > 0;
+}
+
+/* Context: QEMU global mutex and s->ctx held */
+static void virtio_blk_data_plane_disable_multiqueue(VirtIOBlockDataPlane *s)
+{
+    unsigned i;
+
+    if (!s->multiqueue) {
+        return;
+    }
+    for (i = 0; i < s->num_mq_ctx; i++) {
+        blk_disable_multiqueue(s->conf->conf.blk, s->mq_ctx[i]);
+    }
+    s->multiqueue = false;
+}
+
 /* Context: QEMU global mutex held */
 int virtio_blk_data_plane_start(VirtIODevice *vdev)
 {
@@ -184,6 +287,9 @@ int virtio_blk_data_plane_start(VirtIODevice *vdev)
 
     s->starting = true;
 
+    /* Coalescing timers are created again in the IOThreads */
+    virtio_blk_coalesce_flush(vblk);
+
     if (!virtio_vdev_has_feature(vdev, VIRTIO_RING_F_EVENT_IDX)) {
         s->batch_notifications = true;
     } else {
@@ -227,6 +333,17 @@ int virtio_blk_data_plane_start(VirtIODevice *vdev)
     /* Process queued requests before the ones in vring */
     virtio_blk_process_queued_requests(vblk, false);
 
+    if (s->num_mq_ctx) {
+        aio_context_acquire(s->ctx);
+        virtio_blk_data_plane_enable_multiqueue(s);
+        aio_context_release(s->ctx);
+    }
+    if (s->multiqueue) {
+        /* Completions come from several threads, notify right away */
+        s->batch_notifications = false;
+        vblk->vq_aio_context = s->vq_aio_context;
+    }
+
     /* Kick right away to begin processing requests already in vring */
     for (i = 0; i < nvqs; i++) {
         VirtQueue *vq = virtio_get_queue(s->vdev, i);
@@ -235,14 +352,15 @@ int virtio_blk_data_plane_start(VirtIODevice *vdev)
     }
 
     /* Get this show started by hooking up our callbacks */
-    aio_context_acquire(s->ctx);
     for (i = 0; i < nvqs; i++) {
         VirtQueue *vq = virtio_get_queue(s->vdev, i);
+        AioContext *ctx = vq_get_aio_context(s, i);
 
-        virtio_queue_aio_set_host_notifier_handler(vq, s->ctx,
+        aio_context_acquire(ctx);
+        virtio_queue_aio_set_host_notifier_handler(vq, ctx,
                 virtio_blk_data_plane_handle_output);
+        aio_context_release(ctx);
     }
-    aio_context_release(s->ctx);
     return 0;
 
   fail_guest_notifiers:
@@ -259,18 +377,14 @@ int virtio_blk_data_plane_start(VirtIODevice *vdev)
 
 /* Stop notifications for new requests from guest.
  *
- * Context: BH in IOThread
+ * Context: BH in the IOThread of the virtqueue
  */
 static void virtio_blk_data_plane_stop_bh(void *opaque)
 {
-    VirtIOBlockDataPlane *s = opaque;
-    unsigned i;
+    VirtQueue *vq = opaque;
 
-    for (i = 0; i < s->conf->num_queues; i++) {
-        VirtQueue *vq = virtio_get_queue(s->vdev, i);
-
-        virtio_queue_aio_set_host_notifier_handler(vq, s->ctx, NULL);
-    }
+    virtio_queue_aio_set_host_notifier_handler(vq,
+            qemu_get_current_aio_context(), NULL);
 }
 
 /* Context: QEMU global mutex held */
@@ -296,8 +410,20 @@ void virtio_blk_data_plane_stop(VirtIODevice *vdev)
     s->stopping = true;
     trace_virtio_blk_data_plane_stop(s);
 
+    for (i = 0; i < nvqs; i++) {
+        VirtQueue *vq = virtio_get_queue(s->vdev, i);
+        AioContext *ctx = vq_get_aio_context(s, i);
+
+        aio_context_acquire(ctx);
+        aio_wait_bh_oneshot(ctx, virtio_blk_data_plane_stop_bh, vq);
+        aio_context_release(ctx);
+    }
+
     aio_context_acquire(s->ctx);
-    aio_wait_bh_oneshot(s->ctx, virtio_blk_data_plane_stop_bh, s);
+
+    /* Drain the other IOThreads' requests and stop accepting them */
+    virtio_blk_data_plane_disable_multiqueue(s);
+    vblk->vq_aio_context = NULL;
 
     /* Drain and try to switch bs back to the QEMU main loop. If other users
      * keep the BlockBackend in the iothread, that's ok */
@@ -305,6 +431,9 @@ void virtio_blk_data_plane_stop(VirtIODevice *vdev)
 
     aio_context_release(s->ctx);
 
+    /* Requests are drained, raise held back interrupts while irqfds exist */
+    virtio_blk_coalesce_flush(vblk);
+
     for (i = 0; i < nvqs; i++) {
         virtio_bus_set_host_notifier(VIRTIO_BUS(qbus), i, false);
         virtio_bus_cleanup_host_notifier(VIRTIO_BUS(qbus), i);
@@ -28,6 +28,13 @@
 #include "sysemu/iothread.h"
 #include "xen-block.h"
 
+/*
+ * Maximum number of requests whose data is copied with a single grant
+ * copy operation, and whose responses are pushed with a single
+ * notification.
+ */
+#define XEN_BLOCK_BATCH_SIZE 32
+
 typedef struct XenBlockRequest {
     blkif_request_t req;
     int16_t status;
@@ -38,8 +45,12 @@ typedef struct XenBlockRequest {
     int presync;
     int aio_inflight;
     int aio_errors;
+    bool aio_done;      /* status is to be set from aio_errors */
+    bool mapped;        /* v points to persistently mapped grants */
+    bool copied;        /* the data was copied to or from the grants */
     XenBlockDataPlane *dataplane;
     QLIST_ENTRY(XenBlockRequest) list;
+    QSIMPLEQ_ENTRY(XenBlockRequest) done_next;
     BlockAcctCookie acct;
 } XenBlockRequest;
 
@@ -62,9 +73,21 @@ struct XenBlockDataPlane {
     QEMUBH *bh;
     IOThread *iothread;
     AioContext *ctx;
-};
 
-static int xen_block_send_response(XenBlockRequest *request);
+    /* Completed requests, answered together by done_bh */
+    QSIMPLEQ_HEAD(, XenBlockRequest) done;
+    QEMUBH *done_bh;
+    XenDeviceGrantCopySegment *copy_segs;
+
+    /*
+     * With persistent grants the frontend reuses the same pages for its
+     * requests, so they are mapped once and the I/O goes directly to
+     * them instead of being copied.
+     */
+    bool persistent;
+    GHashTable *persistent_gnts;    /* gref -> mapped page */
+    unsigned int max_persistent_gnts;
+};
 
 static void reset_request(XenBlockRequest *request)
 {
@@ -76,6 +99,9 @@ static void reset_request(XenBlockRequest *request)
 
     request->aio_inflight = 0;
     request->aio_errors = 0;
+    request->aio_done = false;
+    request->mapped = false;
+    request->copied = false;
 
     request->dataplane = NULL;
     memset(&request->list, 0, sizeof(request->list));
@@ -117,20 +143,20 @@ out:
     return request;
 }
 
+/* The response is sent by xen_block_done_bh() */
 static void xen_block_complete_request(XenBlockRequest *request)
 {
     XenBlockDataPlane *dataplane = request->dataplane;
 
-    if (xen_block_send_response(request)) {
-        Error *local_err = NULL;
-
-        xen_device_notify_event_channel(dataplane->xendev,
-                                        dataplane->event_channel,
-                                        &local_err);
-        if (local_err) {
-            error_report_err(local_err);
-        }
+    if (QSIMPLEQ_EMPTY(&dataplane->done)) {
+        qemu_bh_schedule(dataplane->done_bh);
     }
+    QSIMPLEQ_INSERT_TAIL(&dataplane->done, request, done_next);
+}
+
+static void xen_block_release_request(XenBlockRequest *request)
+{
+    XenBlockDataPlane *dataplane = request->dataplane;
 
     QLIST_REMOVE(request, list);
     dataplane->requests_inflight--;
@@ -204,19 +230,102 @@ err:
     return -1;
 }
 
-static int xen_block_copy_request(XenBlockRequest *request)
+/*
+ * Point the iovec of @request at the persistently mapped pages of its
+ * segments, mapping the grants that are new.  Returns false if the data
+ * must be copied through the bounce buffer instead, because the frontend
+ * doesn't use persistent grants or too many grants are mapped already.
+ */
+static bool xen_block_map_persistent(XenBlockRequest *request)
+{
+    XenBlockDataPlane *dataplane = request->dataplane;
+    uint8_t *pages[BLKIF_MAX_SEGMENTS_PER_REQUEST];
+    int i;
+
+    if (!dataplane->persistent || !request->req.nr_segments) {
+        return false;
+    }
+
+    for (i = 0; i < request->req.nr_segments; i++) {
+        uint32_t gref = request->req.seg[i].gref;
+        Error *local_err = NULL;
+
+        pages[i] = g_hash_table_lookup(dataplane->persistent_gnts,
+                                       GUINT_TO_POINTER(gref));
+        if (pages[i]) {
+            continue;
+        }
+        if (g_hash_table_size(dataplane->persistent_gnts) >=
+            dataplane->max_persistent_gnts) {
+            return false;
+        }
+        pages[i] = xen_device_map_grant_refs(dataplane->xendev, &gref, 1,
+                                             PROT_READ | PROT_WRITE,
+                                             &local_err);
+        if (!pages[i]) {
+            error_reportf_err(local_err, "disabling persistent grants: ");
+            dataplane->persistent = false;
+            return false;
+        }
+        g_hash_table_insert(dataplane->persistent_gnts,
+                            GUINT_TO_POINTER(gref), pages[i]);
+    }
+
+    for (i = 0; i < request->req.nr_segments; i++) {
+        size_t offset = request->req.seg[i].first_sect *
+                        dataplane->sector_size;
+        size_t len = (request->req.seg[i].last_sect -
+                      request->req.seg[i].first_sect + 1) *
+                     dataplane->sector_size;
+
+        qemu_iovec_add(&request->v, pages[i] + offset, len);
+    }
+    return true;
+}
+
+static void xen_block_unmap_persistent(XenBlockDataPlane *dataplane)
+{
+    GHashTableIter iter;
+    gpointer page;
+
+    g_hash_table_iter_init(&iter, dataplane->persistent_gnts);
+    while (g_hash_table_iter_next(&iter, NULL, &page)) {
+        Error *local_err = NULL;
+
+        xen_device_unmap_grant_refs(dataplane->xendev, page, 1, &local_err);
+        if (local_err) {
+            error_report_err(local_err);
+        }
+        g_hash_table_iter_remove(&iter);
+    }
+}
+
+/* Whether the data of @request must be copied in the direction @to_domain */
+static bool xen_block_needs_copy(XenBlockRequest *request, bool to_domain)
+{
+    if (!request->req.nr_segments || request->mapped || request->copied) {
+        return false;
+    }
+
+    switch (request->req.operation) {
+    case BLKIF_OP_READ:
+        return to_domain && request->aio_done && !request->aio_errors;
+    case BLKIF_OP_WRITE:
+    case BLKIF_OP_FLUSH_DISKCACHE:
+        return !to_domain;
+    default:
+        return false;
+    }
+}
+
+/* Describe the grant copy of @request in @segs and return the count */
+static int xen_block_fill_copy_segs(XenBlockRequest *request,
+                                    XenDeviceGrantCopySegment *segs)
 {
     XenBlockDataPlane *dataplane = request->dataplane;
-    XenDevice *xendev = dataplane->xendev;
-    XenDeviceGrantCopySegment segs[BLKIF_MAX_SEGMENTS_PER_REQUEST];
     int i, count;
     bool to_domain = (request->req.operation == BLKIF_OP_READ);
     void *virt = request->buf;
-    Error *local_err = NULL;
-
-    if (request->req.nr_segments == 0) {
-        return 0;
-    }
 
     count = request->req.nr_segments;
 
@@ -238,7 +347,24 @@ static int xen_block_copy_request(XenBlockRequest *request)
         virt += segs[i].len;
     }
 
-    xen_device_copy_grant_refs(xendev, to_domain, segs, count, &local_err);
+    return count;
+}
+
+static int xen_block_copy_request(XenBlockRequest *request)
+{
+    XenBlockDataPlane *dataplane = request->dataplane;
+    XenDeviceGrantCopySegment segs[BLKIF_MAX_SEGMENTS_PER_REQUEST];
+    bool to_domain = (request->req.operation == BLKIF_OP_READ);
+    Error *local_err = NULL;
+    int count;
+
+    if (request->req.nr_segments == 0) {
+        return 0;
+    }
+
+    count = xen_block_fill_copy_segs(request, segs);
+    xen_device_copy_grant_refs(dataplane->xendev, to_domain, segs, count,
+                               &local_err);
 
     if (local_err) {
         error_reportf_err(local_err, "failed to copy data: ");
@@ -247,9 +373,46 @@ static int xen_block_copy_request(XenBlockRequest *request)
         return -1;
     }
 
+    request->copied = true;
     return 0;
 }
 
+/*
+ * Copy the data of the requests that need it with a single grant copy
+ * operation.  If that fails, the requests are left to be copied one by
+ * one, so that the error is reported for the right ones.
+ */
+static void xen_block_copy_requests(XenBlockDataPlane *dataplane,
+                                    XenBlockRequest **requests,
+                                    unsigned int n, bool to_domain)
+{
+    Error *local_err = NULL;
+    unsigned int i, count = 0;
+
+    for (i = 0; i < n; i++) {
+        if (xen_block_needs_copy(requests[i], to_domain)) {
+            count += xen_block_fill_copy_segs(requests[i],
+                                              &dataplane->copy_segs[count]);
+        }
+    }
+    if (!count) {
+        return;
+    }
+
+    xen_device_copy_grant_refs(dataplane->xendev, to_domain,
+                               dataplane->copy_segs, count, &local_err);
+    if (local_err) {
+        error_free(local_err);
+        return;
+    }
+
+    for (i = 0; i < n; i++) {
+        if (xen_block_needs_copy(requests[i], to_domain)) {
+            requests[i]->copied = true;
+        }
+    }
+}
+
 static int xen_block_do_aio(XenBlockRequest *request);
 
 static void xen_block_complete_aio(void *opaque, int ret)
@@ -276,17 +439,21 @@ static void xen_block_complete_aio(void *opaque, int ret)
         goto done;
     }
 
-    switch (request->req.operation) {
-    case BLKIF_OP_READ:
-        /* in case of failure request->aio_errors is increased */
-        if (ret == 0) {
-            xen_block_copy_request(request);
-        }
-        break;
-    case BLKIF_OP_WRITE:
-    case BLKIF_OP_FLUSH_DISKCACHE:
-    default:
-        break;
+    request->aio_done = true;
+    xen_block_complete_request(request);
+
+done:
+    aio_context_release(dataplane->ctx);
+}
+
+/* Set the status of a request whose I/O is complete */
+static void xen_block_finish_aio(XenBlockRequest *request)
+{
+    XenBlockDataPlane *dataplane = request->dataplane;
+
+    /* in case of failure request->aio_errors is increased */
+    if (xen_block_needs_copy(request, true)) {
+        xen_block_copy_request(request);
     }
 
     request->status = request->aio_errors ? BLKIF_RSP_ERROR : BLKIF_RSP_OKAY;
@@ -309,15 +476,6 @@ static void xen_block_complete_aio(void *opaque, int ret)
     default:
         break;
     }
-
-    xen_block_complete_request(request);
-
-    if (dataplane->more_work) {
-        qemu_bh_schedule(dataplane->bh);
-    }
-
-done:
-    aio_context_release(dataplane->ctx);
 }
 
 static bool xen_block_split_discard(XenBlockRequest *request,
@@ -357,9 +515,7 @@ static int xen_block_do_aio(XenBlockRequest *request)
 {
     XenBlockDataPlane *dataplane = request->dataplane;
 
-    if (request->req.nr_segments &&
-        (request->req.operation == BLKIF_OP_WRITE ||
-         request->req.operation == BLKIF_OP_FLUSH_DISKCACHE) &&
+    if (xen_block_needs_copy(request, false) &&
         xen_block_copy_request(request)) {
         goto err;
     }
@@ -373,7 +529,9 @@ static int xen_block_do_aio(XenBlockRequest *request)
 
     switch (request->req.operation) {
     case BLKIF_OP_READ:
-        qemu_iovec_add(&request->v, request->buf, request->size);
+        if (!request->mapped) {
+            qemu_iovec_add(&request->v, request->buf, request->size);
+        }
         block_acct_start(blk_get_stats(dataplane->blk), &request->acct,
                          request->v.size, BLOCK_ACCT_READ);
         request->aio_inflight++;
@@ -386,7 +544,9 @@ static int xen_block_do_aio(XenBlockRequest *request)
             break;
         }
 
-        qemu_iovec_add(&request->v, request->buf, request->size);
+        if (!request->mapped) {
+            qemu_iovec_add(&request->v, request->buf, request->size);
+        }
         block_acct_start(blk_get_stats(dataplane->blk), &request->acct,
                          request->v.size,
                          request->req.operation == BLKIF_OP_WRITE ?
@@ -419,11 +579,10 @@ err:
     return -1;
 }
 
-static int xen_block_send_response(XenBlockRequest *request)
+/* Place the response on the ring, see xen_block_push_responses() */
+static void xen_block_put_response(XenBlockRequest *request)
 {
     XenBlockDataPlane *dataplane = request->dataplane;
-    int send_notify = 0;
-    int have_requests = 0;
     blkif_response_t *resp;
 
     /* Place on the response ring for the relevant domain. */
@@ -444,7 +603,7 @@ static int xen_block_send_response(XenBlockRequest *request)
             dataplane->rings.x86_64_part.rsp_prod_pvt);
         break;
     default:
-        return 0;
+        return;
     }
 
     resp->id = request->req.id;
@@ -452,6 +611,13 @@ static int xen_block_send_response(XenBlockRequest *request)
     resp->status = request->status;
 
     dataplane->rings.common.rsp_prod_pvt++;
+}
+
+/* Make the responses visible and return whether to notify the frontend */
+static int xen_block_push_responses(XenBlockDataPlane *dataplane)
+{
+    int send_notify = 0;
+    int have_requests = 0;
 
     RING_PUSH_RESPONSES_AND_CHECK_NOTIFY(&dataplane->rings.common,
                                          send_notify);
@@ -474,6 +640,62 @@ static int xen_block_send_response(XenBlockRequest *request)
     return send_notify;
 }
 
+/*
+ * Answer the completed requests.  The data of the reads is copied with as
+ * few grant copy operations as possible, and the frontend is notified
+ * once for all of them.
+ */
+static void xen_block_process_done(XenBlockDataPlane *dataplane)
+{
+    XenBlockRequest *batch[XEN_BLOCK_BATCH_SIZE];
+    Error *local_err = NULL;
+
+    if (QSIMPLEQ_EMPTY(&dataplane->done)) {
+        return;
+    }
+
+    while (!QSIMPLEQ_EMPTY(&dataplane->done)) {
+        unsigned int i, n = 0;
+
+        while (n < XEN_BLOCK_BATCH_SIZE &&
+               !QSIMPLEQ_EMPTY(&dataplane->done)) {
+            batch[n++] = QSIMPLEQ_FIRST(&dataplane->done);
+            QSIMPLEQ_REMOVE_HEAD(&dataplane->done, done_next);
+        }
+
+        xen_block_copy_requests(dataplane, batch, n, true);
+        for (i = 0; i < n; i++) {
+            if (batch[i]->aio_done) {
+                xen_block_finish_aio(batch[i]);
+            }
+            xen_block_put_response(batch[i]);
+            xen_block_release_request(batch[i]);
+        }
+    }
+
+    if (xen_block_push_responses(dataplane)) {
+        xen_device_notify_event_channel(dataplane->xendev,
+                                        dataplane->event_channel,
+                                        &local_err);
+        if (local_err) {
+            error_report_err(local_err);
+        }
+    }
+
+    if (dataplane->more_work) {
+        qemu_bh_schedule(dataplane->bh);
+    }
+}
+
+static void xen_block_done_bh(void *opaque)
+{
+    XenBlockDataPlane *dataplane = opaque;
+
+    aio_context_acquire(dataplane->ctx);
+    xen_block_process_done(dataplane);
+    aio_context_release(dataplane->ctx);
+}
+
 static int xen_block_get_request(XenBlockDataPlane *dataplane,
                                  XenBlockRequest *request, RING_IDX rc)
 {
@@ -515,9 +737,11 @@ static bool xen_block_handle_requests(XenBlockDataPlane *dataplane)
 {
     RING_IDX rc, rp;
     XenBlockRequest *request;
+    XenBlockRequest *batch[XEN_BLOCK_BATCH_SIZE];
     int inflight_atstart = dataplane->requests_inflight;
     int batched = 0;
     bool done_something = false;
+    bool stop = false;
 
     dataplane->more_work = 0;
 
@@ -535,60 +759,74 @@ static bool xen_block_handle_requests(XenBlockDataPlane *dataplane)
      * is below us.
      */
     if (inflight_atstart > IO_PLUG_THRESHOLD) {
-        blk_io_plug(dataplane->blk);
+        blk_io_plug();
     }
-    while (rc != rp) {
-        /* pull request from ring */
-        if (RING_REQUEST_CONS_OVERFLOW(&dataplane->rings.common, rc)) {
-            break;
-        }
-        request = xen_block_start_request(dataplane);
-        if (request == NULL) {
-            dataplane->more_work++;
-            break;
-        }
-        xen_block_get_request(dataplane, request, rc);
-        dataplane->rings.common.req_cons = ++rc;
-        done_something = true;
-
-        /* parse them */
-        if (xen_block_parse_request(request) != 0) {
-            switch (request->req.operation) {
-            case BLKIF_OP_READ:
-                block_acct_invalid(blk_get_stats(dataplane->blk),
-                                   BLOCK_ACCT_READ);
-                break;
-            case BLKIF_OP_WRITE:
-                block_acct_invalid(blk_get_stats(dataplane->blk),
-                                   BLOCK_ACCT_WRITE);
+    while (rc != rp && !stop) {
+        unsigned int i, n = 0;
+
+        while (rc != rp && n < XEN_BLOCK_BATCH_SIZE) {
+            /* pull request from ring */
+            if (RING_REQUEST_CONS_OVERFLOW(&dataplane->rings.common, rc)) {
+                stop = true;
                 break;
-            case BLKIF_OP_FLUSH_DISKCACHE:
-                block_acct_invalid(blk_get_stats(dataplane->blk),
-                                   BLOCK_ACCT_FLUSH);
-            default:
+            }
+            request = xen_block_start_request(dataplane);
+            if (request == NULL) {
+                dataplane->more_work++;
+                stop = true;
                 break;
-            };
+            }
+            xen_block_get_request(dataplane, request, rc);
+            dataplane->rings.common.req_cons = ++rc;
+            done_something = true;
+
+            /* parse them */
+            if (xen_block_parse_request(request) != 0) {
+                switch (request->req.operation) {
+                case BLKIF_OP_READ:
+                    block_acct_invalid(blk_get_stats(dataplane->blk),
+                                       BLOCK_ACCT_READ);
+                    break;
+                case BLKIF_OP_WRITE:
+                    block_acct_invalid(blk_get_stats(dataplane->blk),
+                                       BLOCK_ACCT_WRITE);
+                    break;
+                case BLKIF_OP_FLUSH_DISKCACHE:
+                    block_acct_invalid(blk_get_stats(dataplane->blk),
+                                       BLOCK_ACCT_FLUSH);
+                default:
+                    break;
+                };
+
+                xen_block_complete_request(request);
+                continue;
+            }
 
-            xen_block_complete_request(request);
-            continue;
+            request->mapped = xen_block_map_persistent(request);
+            batch[n++] = request;
         }
 
-        if (inflight_atstart > IO_PLUG_THRESHOLD &&
-            batched >= inflight_atstart) {
-            blk_io_unplug(dataplane->blk);
-        }
-        xen_block_do_aio(request);
-        if (inflight_atstart > IO_PLUG_THRESHOLD) {
-            if (batched >= inflight_atstart) {
-                blk_io_plug(dataplane->blk);
-                batched = 0;
-            } else {
-                batched++;
+        /* Copy the data of all writes of the batch at once */
+        xen_block_copy_requests(dataplane, batch, n, false);
+
+        for (i = 0; i < n; i++) {
+            if (inflight_atstart > IO_PLUG_THRESHOLD &&
+                batched >= inflight_atstart) {
+                blk_io_unplug();
+            }
+            xen_block_do_aio(batch[i]);
+            if (inflight_atstart > IO_PLUG_THRESHOLD) {
+                if (batched >= inflight_atstart) {
+                    blk_io_plug();
+                    batched = 0;
+                } else {
+                    batched++;
+                }
             }
         }
     }
     if (inflight_atstart > IO_PLUG_THRESHOLD) {
-        blk_io_unplug(dataplane->blk);
+        blk_io_unplug();
     }
 
     return done_something;
@@ -623,6 +861,12 @@ XenBlockDataPlane *xen_block_dataplane_create(XenDevice *xendev,
 
     QLIST_INIT(&dataplane->inflight);
     QLIST_INIT(&dataplane->freelist);
+    QSIMPLEQ_INIT(&dataplane->done);
+
+    dataplane->copy_segs = g_new(XenDeviceGrantCopySegment,
+                                 XEN_BLOCK_BATCH_SIZE *
+                                 BLKIF_MAX_SEGMENTS_PER_REQUEST);
+    dataplane->persistent_gnts = g_hash_table_new(NULL, NULL);
 
     if (iothread) {
         dataplane->iothread = iothread;
@@ -633,6 +877,8 @@ XenBlockDataPlane *xen_block_dataplane_create(XenDevice *xendev,
     }
     dataplane->bh = aio_bh_new(dataplane->ctx, xen_block_dataplane_bh,
                                dataplane);
+    dataplane->done_bh = aio_bh_new(dataplane->ctx, xen_block_done_bh,
+                                    dataplane);
 
     return dataplane;
 }
@@ -654,6 +900,9 @@ void xen_block_dataplane_destroy(XenBlockDataPlane *dataplane)
     }
 
     qemu_bh_delete(dataplane->bh);
+    qemu_bh_delete(dataplane->done_bh);
+    g_free(dataplane->copy_segs);
+    g_hash_table_destroy(dataplane->persistent_gnts);
     if (dataplane->iothread) {
         object_unref(OBJECT(dataplane->iothread));
     }
@@ -682,6 +931,10 @@ void xen_block_dataplane_stop(XenBlockDataPlane *dataplane)
     blk_set_aio_context(dataplane->blk, qemu_get_aio_context(), &error_abort);
     aio_context_release(dataplane->ctx);
 
+    /* Answer the requests that completed while draining */
+    qemu_bh_cancel(dataplane->done_bh);
+    xen_block_process_done(dataplane);
+
     /*
      * Now that the context has been moved onto the main thread, cancel
      * further processing.
@@ -700,6 +953,8 @@ void xen_block_dataplane_stop(XenBlockDataPlane *dataplane)
         }
     }
 
+    xen_block_unmap_persistent(dataplane);
+
     if (dataplane->sring) {
         Error *local_err = NULL;
 
@@ -716,11 +971,42 @@ void xen_block_dataplane_stop(XenBlockDataPlane *dataplane)
     dataplane->ring_ref = NULL;
 }
 
+static unsigned int xen_block_max_requests(unsigned int protocol,
+                                           unsigned int nr_ring_ref)
+{
+    unsigned int ring_size = XC_PAGE_SIZE * nr_ring_ref;
+
+    switch (protocol) {
+    case BLKIF_PROTOCOL_NATIVE:
+        return __CONST_RING_SIZE(blkif, ring_size);
+    case BLKIF_PROTOCOL_X86_32:
+        return __CONST_RING_SIZE(blkif_x86_32, ring_size);
+    case BLKIF_PROTOCOL_X86_64:
+        return __CONST_RING_SIZE(blkif_x86_64, ring_size);
+    default:
+        return 0;
+    }
+}
+
+unsigned int xen_block_dataplane_max_grant_refs(unsigned int nr_ring_ref,
+                                                unsigned int protocol,
+                                                bool persistent)
+{
+    unsigned int nr_refs = nr_ring_ref;
+
+    if (persistent) {
+        nr_refs += xen_block_max_requests(protocol, nr_ring_ref) *
+                   BLKIF_MAX_SEGMENTS_PER_REQUEST;
+    }
+    return nr_refs;
+}
+
 void xen_block_dataplane_start(XenBlockDataPlane *dataplane,
                                const unsigned int ring_ref[],
                                unsigned int nr_ring_ref,
                                unsigned int event_channel,
                                unsigned int protocol,
+                               bool persistent,
                                Error **errp)
 {
     ERRP_GUARD();
@@ -739,32 +1025,15 @@ void xen_block_dataplane_start(XenBlockDataPlane *dataplane,
     dataplane->protocol = protocol;
 
     ring_size = XC_PAGE_SIZE * dataplane->nr_ring_ref;
-    switch (dataplane->protocol) {
-    case BLKIF_PROTOCOL_NATIVE:
-    {
-        dataplane->max_requests = __CONST_RING_SIZE(blkif, ring_size);
-        break;
-    }
-    case BLKIF_PROTOCOL_X86_32:
-    {
-        dataplane->max_requests = __CONST_RING_SIZE(blkif_x86_32, ring_size);
-        break;
-    }
-    case BLKIF_PROTOCOL_X86_64:
-    {
-        dataplane->max_requests = __CONST_RING_SIZE(blkif_x86_64, ring_size);
-        break;
-    }
-    default:
+    dataplane->max_requests = xen_block_max_requests(protocol, nr_ring_ref);
+    if (!dataplane->max_requests) {
         error_setg(errp, "unknown protocol %u", dataplane->protocol);
         return;
     }
 
-    xen_device_set_max_grant_refs(xendev, dataplane->nr_ring_ref,
-                                  errp);
-    if (*errp) {
-        goto stop;
-    }
+    dataplane->persistent = persistent;
+    dataplane->max_persistent_gnts = dataplane->max_requests *
+                                     BLKIF_MAX_SEGMENTS_PER_REQUEST;
 
     dataplane->sring = xen_device_map_grant_refs(xendev,
                                               dataplane->ring_ref,
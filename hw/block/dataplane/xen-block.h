@@ -19,11 +19,19 @@ XenBlockDataPlane *xen_block_dataplane_create(XenDevice *xendev,
                                               unsigned int sector_size,
                                               IOThread *iothread);
 void xen_block_dataplane_destroy(XenBlockDataPlane *dataplane);
+/*
+ * The number of grants that one ring may have mapped at a time; the
+ * caller must call xen_device_set_max_grant_refs() for all its rings.
+ */
+unsigned int xen_block_dataplane_max_grant_refs(unsigned int nr_ring_ref,
+                                                unsigned int protocol,
+                                                bool persistent);
 void xen_block_dataplane_start(XenBlockDataPlane *dataplane,
                                const unsigned int ring_ref[],
                                unsigned int nr_ring_ref,
                                unsigned int event_channel,
                                unsigned int protocol,
+                               bool persistent,
                                Error **errp);
 void xen_block_dataplane_stop(XenBlockDataPlane *dataplane);
 
@@ -167,11 +167,138 @@ static int nvme_ns_init_blk(NvmeNamespace *ns, Error **errp)
     return 0;
 }
 
+/*
+ * On a host-managed zoned device, the namespace uses the zones of the
+ * device instead of emulating them: the geometry and the initial state
+ * come from the device, and writes, zone resets and zone finishes are
+ * passed through to it.
+ */
+static int nvme_ns_zoned_check_backend(NvmeNamespace *ns, Error **errp)
+{
+    BlockBackend *blk = ns->blkconf.blk;
+    uint64_t zone_size = blk_get_zone_size(blk);
+    BlockZoneDescriptor zone;
+    unsigned int nr_zones = 1;
+    int ret;
+
+    if (blk_get_zone_model(blk) != BLK_Z_HM) {
+        return 0;
+    }
+
+    if (nvme_msize(ns)) {
+        error_setg(errp, "metadata is not supported on zoned host devices");
+        return -1;
+    }
+
+    if (zone_size % nvme_lsize(ns)) {
+        error_setg(errp, "zone size %"PRIu64"B of the host device is not a "
+                   "multiple of the block size", zone_size);
+        return -1;
+    }
+
+    ret = blk_zone_report(blk, 0, &nr_zones, &zone);
+    if (ret < 0) {
+        error_setg_errno(errp, -ret, "could not report the zones");
+        return -1;
+    }
+    if (!nr_zones) {
+        error_setg(errp, "host device reported no zones");
+        return -1;
+    }
+
+    ns->params.zone_size_bs = zone_size;
+    ns->params.zone_cap_bs = zone.cap;
+    ns->params.max_open_zones = MIN_NON_ZERO(ns->params.max_open_zones,
+                                             blk_get_max_open_zones(blk));
+    ns->params.max_active_zones = MIN_NON_ZERO(ns->params.max_active_zones,
+                                               blk_get_max_active_zones(blk));
+    ns->zone_passthrough = true;
+
+    return 0;
+}
+
+/* Take the state of the zones from the host device */
+static int nvme_ns_zoned_load_state(NvmeNamespace *ns, Error **errp)
+{
+    BlockBackend *blk = ns->blkconf.blk;
+    BlockZoneDescriptor *zones = g_new(BlockZoneDescriptor, 128);
+    uint32_t lbasz = nvme_lsize(ns);
+    unsigned int i = 0, j, n;
+    int ret = 0;
+
+    while (i < ns->num_zones) {
+        n = MIN(ns->num_zones - i, 128);
+        ret = blk_zone_report(blk, nvme_l2b(ns, ns->zone_array[i].d.zslba),
+                              &n, zones);
+        if (ret < 0) {
+            error_setg_errno(errp, -ret, "could not report the zones");
+            goto out;
+        }
+        if (!n) {
+            error_setg(errp, "host device reported too few zones");
+            ret = -1;
+            goto out;
+        }
+
+        for (j = 0; j < n; j++, i++) {
+            NvmeZone *zone = &ns->zone_array[i];
+
+            zone->d.zcap = zones[j].cap / lbasz;
+
+            switch (zones[j].state) {
+            case BLK_ZS_EMPTY:
+                break;
+            case BLK_ZS_IOPEN:
+            case BLK_ZS_EOPEN:
+            case BLK_ZS_CLOSED:
+                /* Open zones are closed, as when shutting down */
+                if (ns->params.max_active_zones &&
+                    ns->nr_active_zones >= ns->params.max_active_zones) {
+                    error_setg(errp, "host device has more than %u active "
+                               "zones", ns->params.max_active_zones);
+                    ret = -1;
+                    goto out;
+                }
+                zone->d.wp = zones[j].wp / lbasz;
+                zone->w_ptr = zone->d.wp;
+                nvme_set_zone_state(zone, NVME_ZONE_STATE_CLOSED);
+                nvme_aor_inc_active(ns);
+                QTAILQ_INSERT_TAIL(&ns->closed_zones, zone, entry);
+                break;
+            case BLK_ZS_FULL:
+                zone->d.wp = zone->d.zslba + zone->d.zcap;
+                zone->w_ptr = zone->d.wp;
+                nvme_set_zone_state(zone, NVME_ZONE_STATE_FULL);
+                QTAILQ_INSERT_TAIL(&ns->full_zones, zone, entry);
+                break;
+            case BLK_ZS_RDONLY:
+                nvme_set_zone_state(zone, NVME_ZONE_STATE_READ_ONLY);
+                break;
+            case BLK_ZS_OFFLINE:
+                nvme_set_zone_state(zone, NVME_ZONE_STATE_OFFLINE);
+                break;
+            default:
+                error_setg(errp, "conventional zones are not supported");
+                ret = -1;
+                goto out;
+            }
+        }
+    }
+
+out:
+    g_free(zones);
+    return ret;
+}
+
 static int nvme_ns_zoned_check_calc_geometry(NvmeNamespace *ns, Error **errp)
 {
     uint64_t zone_size, zone_cap;
     uint32_t lbasz = nvme_lsize(ns);
 
+    if (nvme_ns_zoned_check_backend(ns, errp)) {
+        return -1;
+    }
+
     /* Make sure that the values of ZNS properties are sane */
     if (ns->params.zone_size_bs) {
         zone_size = ns->params.zone_size_bs;
@@ -442,6 +569,9 @@ int nvme_ns_setup(NvmeCtrl *n, NvmeNamespace *ns, Error **errp)
             return -1;
         }
         nvme_ns_init_zoned(ns);
+        if (ns->zone_passthrough && nvme_ns_zoned_load_state(ns, errp)) {
+            return -1;
+        }
     }
 
     return 0;
@@ -514,8 +644,8 @@ static void nvme_ns_realize(DeviceState *dev, Error **errp)
             for (i = 0; i < ARRAY_SIZE(subsys->ctrls); i++) {
                 NvmeCtrl *ctrl = subsys->ctrls[i];
 
-                if (ctrl) {
-                    nvme_attach_ns(ctrl, ns);
+                if (ctrl && nvme_attach_ns(ctrl, ns, errp)) {
+                    return;
                 }
             }
 
@@ -523,7 +653,7 @@ static void nvme_ns_realize(DeviceState *dev, Error **errp)
         }
     }
 
-    nvme_attach_ns(n, ns);
+    nvme_attach_ns(n, ns, errp);
 }
 
 static Property nvme_ns_props[] = {
@@ -78,6 +78,8 @@ typedef struct NvmeNamespace {
     uint8_t         *zd_extensions;
     int32_t         nr_open_zones;
     int32_t         nr_active_zones;
+    /* The zones are those of a zoned host device */
+    bool            zone_passthrough;
 
     NvmeNamespaceParams params;
 
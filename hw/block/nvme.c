@@ -209,6 +209,7 @@ static const uint32_t nvme_cse_acs[256] = {
     [NVME_ADM_CMD_ASYNC_EV_REQ]     = NVME_CMD_EFF_CSUPP,
     [NVME_ADM_CMD_NS_ATTACHMENT]    = NVME_CMD_EFF_CSUPP | NVME_CMD_EFF_NIC,
     [NVME_ADM_CMD_FORMAT_NVM]       = NVME_CMD_EFF_CSUPP | NVME_CMD_EFF_LBCC,
+    [NVME_ADM_CMD_DBBUF_CONFIG]     = NVME_CMD_EFF_CSUPP,
 };
 
 static const uint32_t nvme_cse_iocs_none[256];
@@ -424,6 +425,60 @@ static uint8_t nvme_sq_empty(NvmeSQueue *sq)
     return sq->head == sq->tail;
 }
 
+/*
+ * Once the host has set up the shadow doorbell buffer, it writes the new
+ * doorbell values there and only rings the doorbell registers when they
+ * pass the EventIdx that the controller published.
+ */
+static void nvme_update_sq_tail(NvmeSQueue *sq)
+{
+    uint32_t tail;
+
+    if (pci_dma_read(&sq->ctrl->parent_obj, sq->db_addr, &tail,
+                     sizeof(tail))) {
+        return;
+    }
+    tail = le32_to_cpu(tail);
+    if (likely(tail < sq->size)) {
+        sq->tail = tail;
+    }
+}
+
+static void nvme_update_sq_eventidx(NvmeSQueue *sq)
+{
+    uint32_t ei = cpu_to_le32(sq->tail);
+
+    pci_dma_write(&sq->ctrl->parent_obj, sq->ei_addr, &ei, sizeof(ei));
+}
+
+static void nvme_update_cq_head(NvmeCQueue *cq)
+{
+    uint32_t head;
+
+    if (pci_dma_read(&cq->ctrl->parent_obj, cq->db_addr, &head,
+                     sizeof(head))) {
+        return;
+    }
+    head = le32_to_cpu(head);
+    if (likely(head < cq->size)) {
+        cq->head = head;
+    }
+}
+
+static void nvme_update_cq_eventidx(NvmeCQueue *cq)
+{
+    uint32_t ei = cpu_to_le32(cq->head);
+
+    pci_dma_write(&cq->ctrl->parent_obj, cq->ei_addr, &ei, sizeof(ei));
+}
+
+/* Keep the shadow doorbell in sync with a doorbell register write */
+static void nvme_write_shadow_db(NvmeCtrl *n, uint64_t db_addr, uint32_t val)
+{
+    val = cpu_to_le32(val);
+    pci_dma_write(&n->parent_obj, db_addr, &val, sizeof(val));
+}
+
 static void nvme_irq_check(NvmeCtrl *n)
 {
     if (msix_enabled(&(n->parent_obj))) {
@@ -436,8 +491,37 @@ static void nvme_irq_check(NvmeCtrl *n)
     }
 }
 
+static void nvme_ctx_acquire(NvmeCtrl *n)
+{
+    if (n->iothread) {
+        aio_context_acquire(n->ctx);
+    }
+}
+
+static void nvme_ctx_release(NvmeCtrl *n)
+{
+    if (n->iothread) {
+        aio_context_release(n->ctx);
+    }
+}
+
+/* The admin queue stays in the main loop, where it can take the BQL */
+static QEMUTimer *nvme_queue_timer_new(NvmeCtrl *n, uint16_t qid,
+                                       QEMUTimerCB *cb, void *opaque)
+{
+    AioContext *ctx = qid ? n->ctx : qemu_get_aio_context();
+
+    return aio_timer_new(ctx, QEMU_CLOCK_VIRTUAL, SCALE_NS, cb, opaque);
+}
+
 static void nvme_irq_assert(NvmeCtrl *n, NvmeCQueue *cq)
 {
+    if (n->iothread && !qemu_mutex_iothread_locked()) {
+        cq->irq_pending = true;
+        qemu_bh_schedule(n->irq_bh);
+        return;
+    }
+
     if (cq->irq_enabled) {
         if (msix_enabled(&(n->parent_obj))) {
             trace_pci_nvme_irq_msix(cq->vector);
@@ -455,6 +539,11 @@ static void nvme_irq_assert(NvmeCtrl *n, NvmeCQueue *cq)
 
 static void nvme_irq_deassert(NvmeCtrl *n, NvmeCQueue *cq)
 {
+    if (n->iothread && !qemu_mutex_iothread_locked()) {
+        qemu_bh_schedule(n->irq_bh);
+        return;
+    }
+
     if (cq->irq_enabled) {
         if (msix_enabled(&(n->parent_obj))) {
             return;
@@ -466,6 +555,38 @@ static void nvme_irq_deassert(NvmeCtrl *n, NvmeCQueue *cq)
     }
 }
 
+/*
+ * Raising an interrupt needs the BQL, which the IOThread cannot take
+ * while it holds the AioContext lock.  It only flags the CQ instead, and
+ * this bottom half, which runs in the main loop, brings the interrupt
+ * lines up to date for all the CQs at once.
+ */
+static void nvme_irq_bh(void *opaque)
+{
+    NvmeCtrl *n = opaque;
+    int i;
+
+    aio_context_acquire(n->ctx);
+    for (i = 0; i < n->params.max_ioqpairs + 1; i++) {
+        NvmeCQueue *cq = n->cq[i];
+
+        if (!cq) {
+            continue;
+        }
+
+        if (cq->tail != cq->head) {
+            if (cq->irq_pending) {
+                cq->irq_pending = false;
+                nvme_irq_assert(n, cq);
+            }
+        } else {
+            cq->irq_pending = false;
+            nvme_irq_deassert(n, cq);
+        }
+    }
+    aio_context_release(n->ctx);
+}
+
 static void nvme_req_clear(NvmeRequest *req)
 {
     req->ns = NULL;
@@ -1255,6 +1376,13 @@ static void nvme_post_cqes(void *opaque)
     NvmeRequest *req, *next;
     int ret;
 
+    nvme_ctx_acquire(n);
+
+    if (n->dbbuf_enabled) {
+        nvme_update_cq_eventidx(cq);
+        nvme_update_cq_head(cq);
+    }
+
     QTAILQ_FOREACH_SAFE(req, &cq->req_list, entry, next) {
         NvmeSQueue *sq;
         hwaddr addr;
@@ -1284,6 +1412,8 @@ static void nvme_post_cqes(void *opaque)
     if (cq->tail != cq->head) {
         nvme_irq_assert(n, cq);
     }
+
+    nvme_ctx_release(n);
 }
 
 static void nvme_enqueue_req_completion(NvmeCQueue *cq, NvmeRequest *req)
@@ -1297,9 +1427,11 @@ static void nvme_enqueue_req_completion(NvmeCQueue *cq, NvmeRequest *req)
                                       req->status, req->cmd.opcode);
     }
 
+    nvme_ctx_acquire(cq->ctrl);
     QTAILQ_REMOVE(&req->sq->out_req_list, req, entry);
     QTAILQ_INSERT_TAIL(&cq->req_list, req, entry);
     timer_mod(cq->timer, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) + 500);
+    nvme_ctx_release(cq->ctrl);
 }
 
 static void nvme_process_aers(void *opaque)
@@ -3172,10 +3304,43 @@ static uint16_t nvme_close_zone(NvmeNamespace *ns, NvmeZone *zone,
     return nvme_zrm_close(ns, zone);
 }
 
+static void nvme_aio_zone_finish_cb(void *opaque, int ret)
+{
+    NvmeRequest *req = opaque;
+    uintptr_t *finishes = (uintptr_t *)&req->opaque;
+
+    if (ret) {
+        nvme_aio_err(req, ret);
+    }
+
+    (*finishes)--;
+
+    if (*finishes) {
+        return;
+    }
+
+    nvme_enqueue_req_completion(nvme_cq(req), req);
+}
+
 static uint16_t nvme_finish_zone(NvmeNamespace *ns, NvmeZone *zone,
                                  NvmeZoneState state, NvmeRequest *req)
 {
-    return nvme_zrm_finish(ns, zone);
+    uintptr_t *finishes = (uintptr_t *)&req->opaque;
+    uint16_t status;
+
+    status = nvme_zrm_finish(ns, zone);
+    if (status || !ns->zone_passthrough || state == NVME_ZONE_STATE_FULL) {
+        return status;
+    }
+
+    /* Finish the zone of the host device too, to release its resources */
+    (*finishes)++;
+
+    blk_aio_zone_mgmt(ns->blkconf.blk, BLK_ZO_FINISH,
+                      nvme_l2b(ns, zone->d.zslba), nvme_l2b(ns, ns->zone_size),
+                      nvme_aio_zone_finish_cb, req);
+
+    return NVME_NO_COMPLETE;
 }
 
 static uint16_t nvme_reset_zone(NvmeNamespace *ns, NvmeZone *zone,
@@ -3206,9 +3371,16 @@ static uint16_t nvme_reset_zone(NvmeNamespace *ns, NvmeZone *zone,
 
     (*resets)++;
 
-    blk_aio_pwrite_zeroes(ns->blkconf.blk, nvme_l2b(ns, zone->d.zslba),
-                          nvme_l2b(ns, ns->zone_size), BDRV_REQ_MAY_UNMAP,
+    if (ns->zone_passthrough) {
+        blk_aio_zone_mgmt(ns->blkconf.blk, BLK_ZO_RESET,
+                          nvme_l2b(ns, zone->d.zslba),
+                          nvme_l2b(ns, ns->zone_size),
                           nvme_aio_zone_reset_cb, ctx);
+    } else {
+        blk_aio_pwrite_zeroes(ns->blkconf.blk, nvme_l2b(ns, zone->d.zslba),
+                              nvme_l2b(ns, ns->zone_size), BDRV_REQ_MAY_UNMAP,
+                              nvme_aio_zone_reset_cb, ctx);
+    }
 
     return NVME_NO_COMPLETE;
 }
@@ -3397,8 +3569,25 @@ static uint16_t nvme_zone_mgmt_send(NvmeCtrl *n, NvmeRequest *req)
             proc_mask = NVME_PROC_OPENED_ZONES | NVME_PROC_CLOSED_ZONES;
         }
         trace_pci_nvme_finish_zone(slba, zone_idx, all);
+
+        if (!ns->zone_passthrough) {
+            status = nvme_do_zone_op(ns, zone, proc_mask, nvme_finish_zone,
+                                     req);
+            break;
+        }
+
+        /* Counts the zone finishes sent to the host device */
+        resets = (uintptr_t *)&req->opaque;
+        *resets = 1;
+
         status = nvme_do_zone_op(ns, zone, proc_mask, nvme_finish_zone, req);
-        break;
+        if (status && status != NVME_NO_COMPLETE) {
+            req->status = status;
+        }
+
+        (*resets)--;
+
+        return *resets ? NVME_NO_COMPLETE : req->status;
 
     case NVME_ZONE_ACTION_RESET:
         resets = (uintptr_t *)&req->opaque;
@@ -3671,10 +3860,53 @@ static uint16_t nvme_io_cmd(NvmeCtrl *n, NvmeRequest *req)
     return NVME_INVALID_OPCODE | NVME_DNR;
 }
 
+static void nvme_sq_notifier(EventNotifier *e)
+{
+    NvmeSQueue *sq = container_of(e, NvmeSQueue, notifier);
+
+    if (!event_notifier_test_and_clear(e)) {
+        return;
+    }
+
+    nvme_process_sq(sq);
+}
+
+/*
+ * With shadow doorbells, the value written to a doorbell register is
+ * also in memory, so the write itself only needs to wake the controller
+ * up.  Let KVM turn it into an eventfd signal instead of an exit to QEMU.
+ */
+static int nvme_init_sq_ioeventfd(NvmeSQueue *sq)
+{
+    NvmeCtrl *n = sq->ctrl;
+    uint16_t offset = sq->sqid << 3;
+    int ret;
+
+    ret = event_notifier_init(&sq->notifier, 0);
+    if (ret < 0) {
+        return ret;
+    }
+
+    aio_set_event_notifier(n->ctx, &sq->notifier, true, nvme_sq_notifier,
+                           NULL);
+    memory_region_add_eventfd(&n->iomem, 0x1000 + offset, 4, false, 0,
+                              &sq->notifier);
+
+    return 0;
+}
+
 static void nvme_free_sq(NvmeSQueue *sq, NvmeCtrl *n)
 {
+    uint16_t offset = sq->sqid << 3;
+
     n->sq[sq->sqid] = NULL;
     timer_free(sq->timer);
+    if (sq->ioeventfd_enabled) {
+        memory_region_del_eventfd(&n->iomem, 0x1000 + offset, 4, false, 0,
+                                  &sq->notifier);
+        aio_set_event_notifier(n->ctx, &sq->notifier, true, NULL, NULL);
+        event_notifier_cleanup(&sq->notifier);
+    }
     g_free(sq->io_req);
     if (sq->sqid) {
         g_free(sq);
@@ -3757,7 +3989,18 @@ static void nvme_init_sq(NvmeSQueue *sq, NvmeCtrl *n, uint64_t dma_addr,
         sq->io_req[i].sq = sq;
         QTAILQ_INSERT_TAIL(&(sq->req_list), &sq->io_req[i], entry);
     }
-    sq->timer = timer_new_ns(QEMU_CLOCK_VIRTUAL, nvme_process_sq, sq);
+    sq->timer = nvme_queue_timer_new(n, sqid, nvme_process_sq, sq);
+
+    if (n->dbbuf_enabled) {
+        sq->db_addr = n->dbbuf_dbs + (sqid << 3);
+        sq->ei_addr = n->dbbuf_eis + (sqid << 3);
+
+        if (n->params.ioeventfd && sq->sqid != 0) {
+            if (!nvme_init_sq_ioeventfd(sq)) {
+                sq->ioeventfd_enabled = true;
+            }
+        }
+    }
 
     assert(n->cq[cqid]);
     cq = n->cq[cqid];
@@ -3813,12 +4056,13 @@ struct nvme_stats {
 
 static void nvme_set_blk_stats(NvmeNamespace *ns, struct nvme_stats *stats)
 {
-    BlockAcctStats *s = blk_get_stats(ns->blkconf.blk);
+    BlockAcctCounters c;
 
-    stats->units_read += s->nr_bytes[BLOCK_ACCT_READ] >> BDRV_SECTOR_BITS;
-    stats->units_written += s->nr_bytes[BLOCK_ACCT_WRITE] >> BDRV_SECTOR_BITS;
-    stats->read_commands += s->nr_ops[BLOCK_ACCT_READ];
-    stats->write_commands += s->nr_ops[BLOCK_ACCT_WRITE];
+    block_acct_get_counters(blk_get_stats(ns->blkconf.blk), &c);
+    stats->units_read += c.nr_bytes[BLOCK_ACCT_READ] >> BDRV_SECTOR_BITS;
+    stats->units_written += c.nr_bytes[BLOCK_ACCT_WRITE] >> BDRV_SECTOR_BITS;
+    stats->read_commands += c.nr_ops[BLOCK_ACCT_READ];
+    stats->write_commands += c.nr_ops[BLOCK_ACCT_WRITE];
 }
 
 static uint16_t nvme_smart_info(NvmeCtrl *n, uint8_t rae, uint32_t buf_len,
@@ -4054,10 +4298,68 @@ static uint16_t nvme_get_log(NvmeCtrl *n, NvmeRequest *req)
     }
 }
 
+static void nvme_cq_notifier(EventNotifier *e)
+{
+    NvmeCQueue *cq = container_of(e, NvmeCQueue, notifier);
+    NvmeCtrl *n = cq->ctrl;
+    bool start_sqs;
+
+    if (!event_notifier_test_and_clear(e)) {
+        return;
+    }
+
+    nvme_ctx_acquire(n);
+
+    start_sqs = nvme_cq_full(cq);
+    nvme_update_cq_head(cq);
+
+    if (start_sqs) {
+        NvmeSQueue *sq;
+        QTAILQ_FOREACH(sq, &cq->sq_list, entry) {
+            timer_mod(sq->timer, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) + 500);
+        }
+    }
+
+    if (cq->tail == cq->head) {
+        nvme_irq_deassert(n, cq);
+    }
+
+    nvme_post_cqes(cq);
+
+    nvme_ctx_release(n);
+}
+
+static int nvme_init_cq_ioeventfd(NvmeCQueue *cq)
+{
+    NvmeCtrl *n = cq->ctrl;
+    uint16_t offset = (cq->cqid << 3) + (1 << 2);
+    int ret;
+
+    ret = event_notifier_init(&cq->notifier, 0);
+    if (ret < 0) {
+        return ret;
+    }
+
+    aio_set_event_notifier(n->ctx, &cq->notifier, true, nvme_cq_notifier,
+                           NULL);
+    memory_region_add_eventfd(&n->iomem, 0x1000 + offset, 4, false, 0,
+                              &cq->notifier);
+
+    return 0;
+}
+
 static void nvme_free_cq(NvmeCQueue *cq, NvmeCtrl *n)
 {
+    uint16_t offset = (cq->cqid << 3) + (1 << 2);
+
     n->cq[cq->cqid] = NULL;
     timer_free(cq->timer);
+    if (cq->ioeventfd_enabled) {
+        memory_region_del_eventfd(&n->iomem, 0x1000 + offset, 4, false, 0,
+                                  &cq->notifier);
+        aio_set_event_notifier(n->ctx, &cq->notifier, true, NULL, NULL);
+        event_notifier_cleanup(&cq->notifier);
+    }
     if (msix_enabled(&n->parent_obj)) {
         msix_vector_unuse(&n->parent_obj, cq->vector);
     }
@@ -4108,8 +4410,18 @@ static void nvme_init_cq(NvmeCQueue *cq, NvmeCtrl *n, uint64_t dma_addr,
     cq->head = cq->tail = 0;
     QTAILQ_INIT(&cq->req_list);
     QTAILQ_INIT(&cq->sq_list);
+    if (n->dbbuf_enabled) {
+        cq->db_addr = n->dbbuf_dbs + (cqid << 3) + (1 << 2);
+        cq->ei_addr = n->dbbuf_eis + (cqid << 3) + (1 << 2);
+
+        if (n->params.ioeventfd && cqid != 0) {
+            if (!nvme_init_cq_ioeventfd(cq)) {
+                cq->ioeventfd_enabled = true;
+            }
+        }
+    }
     n->cq[cqid] = cq;
-    cq->timer = timer_new_ns(QEMU_CLOCK_VIRTUAL, nvme_post_cqes, cq);
+    cq->timer = nvme_queue_timer_new(n, cqid, nvme_post_cqes, cq);
 }
 
 static uint16_t nvme_create_cq(NvmeCtrl *n, NvmeRequest *req)
@@ -4962,7 +5274,12 @@ static uint16_t nvme_ns_attachment(NvmeCtrl *n, NvmeRequest *req)
                 return NVME_NS_PRIVATE | NVME_DNR;
             }
 
-            nvme_attach_ns(ctrl, ns);
+            /* Moving a block backend to another iothread needs the BQL */
+            if (blk_get_aio_context(ns->blkconf.blk) != ctrl->ctx) {
+                return NVME_INVALID_FIELD | NVME_DNR;
+            }
+
+            nvme_attach_ns(ctrl, ns, &error_abort);
             __nvme_select_ns_iocs(ctrl, ns);
         } else {
             if (!nvme_ns(ctrl, nsid)) {
@@ -5123,6 +5440,65 @@ static uint16_t nvme_format(NvmeCtrl *n, NvmeRequest *req)
     return req->status;
 }
 
+static uint16_t nvme_dbbuf_config(NvmeCtrl *n, const NvmeRequest *req)
+{
+    uint64_t dbs_addr = le64_to_cpu(req->cmd.dptr.prp1);
+    uint64_t eis_addr = le64_to_cpu(req->cmd.dptr.prp2);
+    int i;
+
+    /* Address should be page aligned */
+    if (dbs_addr & (n->page_size - 1) || eis_addr & (n->page_size - 1)) {
+        trace_pci_nvme_err_invalid_dbbuf_config(dbs_addr, eis_addr);
+        return NVME_INVALID_FIELD | NVME_DNR;
+    }
+
+    /* Save shadow buffer base addr for use during queue creation */
+    n->dbbuf_dbs = dbs_addr;
+    n->dbbuf_eis = eis_addr;
+    n->dbbuf_enabled = true;
+
+    for (i = 0; i < n->params.max_ioqpairs + 1; i++) {
+        NvmeSQueue *sq = n->sq[i];
+        NvmeCQueue *cq = n->cq[i];
+
+        if (sq) {
+            /*
+             * CAP.DSTRD is 0, so offset of ith sq db_addr is (i<<3)
+             * nvme_process_db() uses this hard-coded way to calculate
+             * doorbell offsets. Be consistent with that here.
+             */
+            sq->db_addr = dbs_addr + (i << 3);
+            sq->ei_addr = eis_addr + (i << 3);
+            nvme_write_shadow_db(n, sq->db_addr, sq->tail);
+
+            if (n->params.ioeventfd && sq->sqid != 0 &&
+                !sq->ioeventfd_enabled) {
+                if (!nvme_init_sq_ioeventfd(sq)) {
+                    sq->ioeventfd_enabled = true;
+                }
+            }
+        }
+
+        if (cq) {
+            /* CAP.DSTRD is 0, so offset of ith cq db_addr is (i<<3)+(1<<2) */
+            cq->db_addr = dbs_addr + (i << 3) + (1 << 2);
+            cq->ei_addr = eis_addr + (i << 3) + (1 << 2);
+            nvme_write_shadow_db(n, cq->db_addr, cq->head);
+
+            if (n->params.ioeventfd && cq->cqid != 0 &&
+                !cq->ioeventfd_enabled) {
+                if (!nvme_init_cq_ioeventfd(cq)) {
+                    cq->ioeventfd_enabled = true;
+                }
+            }
+        }
+    }
+
+    trace_pci_nvme_dbbuf_config(dbs_addr, eis_addr);
+
+    return NVME_SUCCESS;
+}
+
 static uint16_t nvme_admin_cmd(NvmeCtrl *n, NvmeRequest *req)
 {
     trace_pci_nvme_admin_cmd(nvme_cid(req), nvme_sqid(req), req->cmd.opcode,
@@ -5163,6 +5539,8 @@ static uint16_t nvme_admin_cmd(NvmeCtrl *n, NvmeRequest *req)
         return nvme_ns_attachment(n, req);
     case NVME_ADM_CMD_FORMAT_NVM:
         return nvme_format(n, req);
+    case NVME_ADM_CMD_DBBUF_CONFIG:
+        return nvme_dbbuf_config(n, req);
     default:
         assert(false);
     }
@@ -5181,6 +5559,12 @@ static void nvme_process_sq(void *opaque)
     NvmeCmd cmd;
     NvmeRequest *req;
 
+    nvme_ctx_acquire(n);
+
+    if (n->dbbuf_enabled) {
+        nvme_update_sq_tail(sq);
+    }
+
     while (!(nvme_sq_empty(sq) || QTAILQ_EMPTY(&sq->req_list))) {
         addr = sq->dma_addr + sq->head * n->sqe_size;
         if (nvme_addr_read(n, addr, (void *)&cmd, sizeof(cmd))) {
@@ -5204,7 +5588,19 @@ static void nvme_process_sq(void *opaque)
             req->status = status;
             nvme_enqueue_req_completion(cq, req);
         }
+
+        if (n->dbbuf_enabled && nvme_sq_empty(sq)) {
+            /*
+             * Publish the EventIdx, then look at the shadow tail once
+             * more: the host may have added entries without ringing the
+             * doorbell before seeing the new EventIdx.
+             */
+            nvme_update_sq_eventidx(sq);
+            nvme_update_sq_tail(sq);
+        }
     }
+
+    nvme_ctx_release(n);
 }
 
 static void nvme_ctrl_reset(NvmeCtrl *n)
@@ -5242,6 +5638,10 @@ static void nvme_ctrl_reset(NvmeCtrl *n)
     n->outstanding_aers = 0;
     n->qs_created = false;
 
+    n->dbbuf_dbs = 0;
+    n->dbbuf_eis = 0;
+    n->dbbuf_enabled = false;
+
     n->bar.cc = 0;
 }
 
@@ -5746,6 +6146,14 @@ static void nvme_process_db(NvmeCtrl *n, hwaddr addr, int val)
 
         start_sqs = nvme_cq_full(cq) ? 1 : 0;
         cq->head = new_head;
+        if (!qid && n->dbbuf_enabled) {
+            /*
+             * The host only uses the shadow doorbells of I/O queues, but
+             * the admin queue is processed the same way; the spec requires
+             * the register and the shadow doorbell to match anyway.
+             */
+            nvme_write_shadow_db(n, cq->db_addr, cq->head);
+        }
         if (start_sqs) {
             NvmeSQueue *sq;
             QTAILQ_FOREACH(sq, &cq->sq_list, entry) {
@@ -5799,6 +6207,9 @@ static void nvme_process_db(NvmeCtrl *n, hwaddr addr, int val)
         trace_pci_nvme_mmio_doorbell_sq(sq->sqid, new_tail);
 
         sq->tail = new_tail;
+        if (!qid && n->dbbuf_enabled) {
+            nvme_write_shadow_db(n, sq->db_addr, sq->tail);
+        }
         timer_mod(sq->timer, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) + 500);
     }
 }
@@ -5810,11 +6221,13 @@ static void nvme_mmio_write(void *opaque, hwaddr addr, uint64_t data,
 
     trace_pci_nvme_mmio_write(addr, data, size);
 
+    nvme_ctx_acquire(n);
     if (addr < sizeof(n->bar)) {
         nvme_write_bar(n, addr, data, size);
     } else {
         nvme_process_db(n, addr, data);
     }
+    nvme_ctx_release(n);
 }
 
 static const MemoryRegionOps nvme_mmio_ops = {
@@ -5925,6 +6338,13 @@ static void nvme_init_state(NvmeCtrl *n)
     n->features.temp_thresh_hi = NVME_TEMPERATURE_WARNING;
     n->starttime_ms = qemu_clock_get_ms(QEMU_CLOCK_VIRTUAL);
     n->aer_reqs = g_new0(NvmeRequest *, n->params.aerl + 1);
+
+    if (n->iothread) {
+        n->ctx = iothread_get_aio_context(n->iothread);
+        n->irq_bh = qemu_bh_new(nvme_irq_bh, n);
+    } else {
+        n->ctx = qemu_get_aio_context();
+    }
 }
 
 static void nvme_init_cmb(NvmeCtrl *n, PCIDevice *pci_dev)
@@ -6071,7 +6491,8 @@ static void nvme_init_ctrl(NvmeCtrl *n, PCIDevice *pci_dev)
 
     id->mdts = n->params.mdts;
     id->ver = cpu_to_le32(NVME_SPEC_VER);
-    id->oacs = cpu_to_le16(NVME_OACS_NS_MGMT | NVME_OACS_FORMAT);
+    id->oacs = cpu_to_le16(NVME_OACS_NS_MGMT | NVME_OACS_FORMAT |
+                           NVME_OACS_DBBUF);
     id->cntrltype = 0x1;
 
     /*
@@ -6156,16 +6577,31 @@ static int nvme_init_subsys(NvmeCtrl *n, Error **errp)
     return 0;
 }
 
-void nvme_attach_ns(NvmeCtrl *n, NvmeNamespace *ns)
+int nvme_attach_ns(NvmeCtrl *n, NvmeNamespace *ns, Error **errp)
 {
     uint32_t nsid = ns->params.nsid;
+    BlockBackend *blk = ns->blkconf.blk;
     assert(nsid && nsid <= NVME_MAX_NAMESPACES);
 
+    /* The namespace's I/O runs in the controller's AioContext */
+    if (blk_get_aio_context(blk) != n->ctx) {
+        if (ns->attached) {
+            error_setg(errp, "namespace %"PRIu32" is attached to a "
+                       "controller with a different iothread", nsid);
+            return -1;
+        }
+        if (blk_set_aio_context(blk, n->ctx, errp) < 0) {
+            return -1;
+        }
+    }
+
     n->namespaces[nsid - 1] = ns;
     ns->attached++;
 
     n->dmrsl = MIN_NON_ZERO(n->dmrsl,
                             BDRV_REQUEST_MAX_BYTES / nvme_l2b(ns, 1));
+
+    return 0;
 }
 
 static void nvme_realize(PCIDevice *pci_dev, Error **errp)
@@ -6203,7 +6639,7 @@ static void nvme_realize(PCIDevice *pci_dev, Error **errp)
             return;
         }
 
-        nvme_attach_ns(n, ns);
+        nvme_attach_ns(n, ns, errp);
     }
 }
 
@@ -6213,7 +6649,9 @@ static void nvme_exit(PCIDevice *pci_dev)
     NvmeNamespace *ns;
     int i;
 
+    nvme_ctx_acquire(n);
     nvme_ctrl_reset(n);
+    nvme_ctx_release(n);
 
     for (i = 1; i <= n->num_namespaces; i++) {
         ns = nvme_ns(n, i);
@@ -6228,6 +6666,10 @@ static void nvme_exit(PCIDevice *pci_dev)
     g_free(n->sq);
     g_free(n->aer_reqs);
 
+    if (n->irq_bh) {
+        qemu_bh_delete(n->irq_bh);
+    }
+
     if (n->params.cmb_size_mb) {
         g_free(n->cmb.buf);
     }
@@ -6245,6 +6687,8 @@ static Property nvme_props[] = {
                      HostMemoryBackend *),
     DEFINE_PROP_LINK("subsys", NvmeCtrl, subsys, TYPE_NVME_SUBSYS,
                      NvmeSubsystem *),
+    DEFINE_PROP_LINK("iothread", NvmeCtrl, iothread, TYPE_IOTHREAD,
+                     IOThread *),
     DEFINE_PROP_STRING("serial", NvmeCtrl, params.serial),
     DEFINE_PROP_UINT32("cmb_size_mb", NvmeCtrl, params.cmb_size_mb, 0),
     DEFINE_PROP_UINT32("num_queues", NvmeCtrl, params.num_queues, 0),
@@ -6256,6 +6700,7 @@ static Property nvme_props[] = {
     DEFINE_PROP_UINT8("vsl", NvmeCtrl, params.vsl, 7),
     DEFINE_PROP_BOOL("use-intel-id", NvmeCtrl, params.use_intel_id, false),
     DEFINE_PROP_BOOL("legacy-cmb", NvmeCtrl, params.legacy_cmb, false),
+    DEFINE_PROP_BOOL("ioeventfd", NvmeCtrl, params.ioeventfd, false),
     DEFINE_PROP_UINT8("zoned.zasl", NvmeCtrl, params.zasl, 0),
     DEFINE_PROP_END_OF_LIST(),
 };
@@ -56,6 +56,19 @@ static void virtio_blk_set_config_size(VirtIOBlock *s, uint64_t host_features)
     assert(s->config_size <= sizeof(struct virtio_blk_config));
 }
 
+/* Longest time that an interrupt may be held back */
+#define VIRTIO_BLK_COALESCE_MAX_USECS 10000
+
+/* The AioContext that processes and completes the requests of @vq */
+static AioContext *virtio_blk_get_vq_aio_context(VirtIOBlock *s,
+                                                 VirtQueue *vq)
+{
+    if (s->vq_aio_context) {
+        return s->vq_aio_context[virtio_get_queue_index(vq)];
+    }
+    return blk_get_aio_context(s->blk);
+}
+
 static void virtio_blk_init_request(VirtIOBlock *s, VirtQueue *vq,
                                     VirtIOBlockReq *req)
 {
@@ -69,7 +82,128 @@ static void virtio_blk_init_request(VirtIOBlock *s, VirtQueue *vq,
 
 static void virtio_blk_free_request(VirtIOBlockReq *req)
 {
-    g_free(req);
+    virtqueue_element_free(&req->elem);
+}
+
+/*
+ * Interrupt coalescing: used buffers are signalled to the guest once
+ * coalesce_max_events of them are pending, or coalesce_max_usecs after the
+ * first of them, whichever comes first.  In adaptive mode, interrupts are
+ * raised right away when the virtqueue has no other request in flight or
+ * when completions are further apart than coalesce_max_usecs, so that
+ * coalescing only adds latency when the guest keeps a deep queue busy.
+ *
+ * The state of a virtqueue is only accessed in its AioContext.
+ */
+typedef struct VirtIOBlockCoalesce {
+    VirtIOBlock *s;
+    VirtQueue *vq;
+    QEMUTimer *timer;   /* created in ctx on first use */
+    AioContext *ctx;
+    unsigned pending;   /* used buffers the guest was not notified about */
+    unsigned in_flight; /* requests popped and not completed yet */
+    int64_t last_ns;    /* time of the previous completion */
+} VirtIOBlockCoalesce;
+
+static void virtio_blk_notify_now(VirtIOBlock *s, VirtQueue *vq)
+{
+    if (s->dataplane_started && !s->dataplane_disabled) {
+        virtio_notify_irqfd(VIRTIO_DEVICE(s), vq);
+    } else {
+        virtio_notify(VIRTIO_DEVICE(s), vq);
+    }
+}
+
+static void virtio_blk_coalesce_timer_cb(void *opaque)
+{
+    VirtIOBlockCoalesce *c = opaque;
+
+    aio_context_acquire(c->ctx);
+    if (c->pending) {
+        c->pending = 0;
+        virtio_blk_notify_now(c->s, c->vq);
+    }
+    aio_context_release(c->ctx);
+}
+
+/* Called with the AioContext of @vq held */
+static void virtio_blk_coalesce_start_request(VirtIOBlock *s, VirtQueue *vq)
+{
+    if (s->coalesce) {
+        s->coalesce[virtio_get_queue_index(vq)].in_flight++;
+    }
+}
+
+/* Called with the AioContext of @vq held */
+static void virtio_blk_coalesce_notify(VirtIOBlock *s, VirtQueue *vq)
+{
+    VirtIOBlkConf *conf = &s->conf;
+    VirtIOBlockCoalesce *c = &s->coalesce[virtio_get_queue_index(vq)];
+    AioContext *ctx = virtio_blk_get_vq_aio_context(s, vq);
+    int64_t now = qemu_clock_get_ns(QEMU_CLOCK_REALTIME);
+    int64_t max_ns = (int64_t)conf->coalesce_max_usecs * SCALE_US;
+    bool now_please;
+
+    if (c->in_flight) {
+        c->in_flight--;
+    }
+    c->pending++;
+
+    now_please = conf->coalesce_max_events &&
+                 c->pending >= conf->coalesce_max_events;
+    if (conf->coalesce_adaptive) {
+        now_please |= !c->in_flight || now - c->last_ns > max_ns;
+    }
+    c->last_ns = now;
+
+    if (now_please) {
+        c->pending = 0;
+        if (c->timer) {
+            timer_del(c->timer);
+        }
+        virtio_blk_notify_now(s, vq);
+        return;
+    }
+
+    if (c->timer && c->ctx != ctx) {
+        timer_free(c->timer);
+        c->timer = NULL;
+    }
+    if (!c->timer) {
+        c->ctx = ctx;
+        c->timer = aio_timer_new(ctx, QEMU_CLOCK_REALTIME, SCALE_NS,
+                                 virtio_blk_coalesce_timer_cb, c);
+    }
+    if (!timer_pending(c->timer)) {
+        timer_mod(c->timer, now + max_ns);
+    }
+}
+
+/*
+ * Raise the interrupts that are still held back and free the timers, so
+ * that they can be created again in the right AioContext.
+ *
+ * Context: QEMU global mutex held, no completions running in IOThreads
+ */
+void virtio_blk_coalesce_flush(VirtIOBlock *s)
+{
+    unsigned i;
+
+    if (!s->coalesce) {
+        return;
+    }
+
+    for (i = 0; i < s->conf.num_queues; i++) {
+        VirtIOBlockCoalesce *c = &s->coalesce[i];
+
+        timer_free(c->timer);
+        c->timer = NULL;
+        c->in_flight = 0;
+        if (c->pending) {
+            c->pending = 0;
+            virtio_blk_notify_now(s, c->vq);
+        }
+    }
 }
 
 static void virtio_blk_req_complete(VirtIOBlockReq *req, unsigned char status)
@@ -83,7 +217,9 @@ static void virtio_blk_req_complete(VirtIOBlockReq *req, unsigned char status)
     iov_discard_undo(&req->inhdr_undo);
     iov_discard_undo(&req->outhdr_undo);
     virtqueue_push(req->vq, &req->elem, req->in_len);
-    if (s->dataplane_started && !s->dataplane_disabled) {
+    if (s->coalesce) {
+        virtio_blk_coalesce_notify(s, req->vq);
+    } else if (s->dataplane_started && !s->dataplane_disabled) {
         virtio_blk_data_plane_notify(s->dataplane, req->vq);
     } else {
         virtio_notify(vdev, req->vq);
@@ -100,8 +236,10 @@ static int virtio_blk_handle_rw_error(VirtIOBlockReq *req, int error,
         /* Break the link as the next request is going to be parsed from the
          * ring again. Otherwise we may end up doing a double completion! */
         req->mr_next = NULL;
+        qemu_mutex_lock(&s->rq_lock);
         req->next = s->rq;
         s->rq = req;
+        qemu_mutex_unlock(&s->rq_lock);
     } else if (action == BLOCK_ERROR_ACTION_REPORT) {
         virtio_blk_req_complete(req, VIRTIO_BLK_S_IOERR);
         if (acct_failed) {
@@ -119,8 +257,9 @@ static void virtio_blk_rw_complete(void *opaque, int ret)
     VirtIOBlockReq *next = opaque;
     VirtIOBlock *s = next->dev;
     VirtIODevice *vdev = VIRTIO_DEVICE(s);
+    AioContext *ctx = virtio_blk_get_vq_aio_context(s, next->vq);
 
-    aio_context_acquire(blk_get_aio_context(s->conf.conf.blk));
+    aio_context_acquire(ctx);
     while (next) {
         VirtIOBlockReq *req = next;
         next = req->mr_next;
@@ -153,15 +292,16 @@ static void virtio_blk_rw_complete(void *opaque, int ret)
         block_acct_done(blk_get_stats(s->blk), &req->acct);
         virtio_blk_free_request(req);
     }
-    aio_context_release(blk_get_aio_context(s->conf.conf.blk));
+    aio_context_release(ctx);
 }
 
 static void virtio_blk_flush_complete(void *opaque, int ret)
 {
     VirtIOBlockReq *req = opaque;
     VirtIOBlock *s = req->dev;
+    AioContext *ctx = virtio_blk_get_vq_aio_context(s, req->vq);
 
-    aio_context_acquire(blk_get_aio_context(s->conf.conf.blk));
+    aio_context_acquire(ctx);
     if (ret) {
         if (virtio_blk_handle_rw_error(req, -ret, 0, true)) {
             goto out;
@@ -173,7 +313,7 @@ static void virtio_blk_flush_complete(void *opaque, int ret)
     virtio_blk_free_request(req);
 
 out:
-    aio_context_release(blk_get_aio_context(s->conf.conf.blk));
+    aio_context_release(ctx);
 }
 
 static void virtio_blk_discard_write_zeroes_complete(void *opaque, int ret)
@@ -182,8 +322,9 @@ static void virtio_blk_discard_write_zeroes_complete(void *opaque, int ret)
     VirtIOBlock *s = req->dev;
     bool is_write_zeroes = (virtio_ldl_p(VIRTIO_DEVICE(s), &req->out.type) &
                             ~VIRTIO_BLK_T_BARRIER) == VIRTIO_BLK_T_WRITE_ZEROES;
+    AioContext *ctx = virtio_blk_get_vq_aio_context(s, req->vq);
 
-    aio_context_acquire(blk_get_aio_context(s->conf.conf.blk));
+    aio_context_acquire(ctx);
     if (ret) {
         if (virtio_blk_handle_rw_error(req, -ret, false, is_write_zeroes)) {
             goto out;
@@ -197,7 +338,7 @@ static void virtio_blk_discard_write_zeroes_complete(void *opaque, int ret)
     virtio_blk_free_request(req);
 
 out:
-    aio_context_release(blk_get_aio_context(s->conf.conf.blk));
+    aio_context_release(ctx);
 }
 
 #ifdef __linux__
@@ -215,6 +356,7 @@ static void virtio_blk_ioctl_complete(void *opaque, int status)
     VirtIODevice *vdev = VIRTIO_DEVICE(s);
     struct virtio_scsi_inhdr *scsi;
     struct sg_io_hdr *hdr;
+    AioContext *ctx;
 
     scsi = (void *)req->elem.in_sg[req->elem.in_num - 2].iov_base;
 
@@ -244,23 +386,32 @@ static void virtio_blk_ioctl_complete(void *opaque, int status)
     virtio_stl_p(vdev, &scsi->data_len, hdr->dxfer_len);
 
 out:
-    aio_context_acquire(blk_get_aio_context(s->conf.conf.blk));
+    ctx = virtio_blk_get_vq_aio_context(s, req->vq);
+    aio_context_acquire(ctx);
     virtio_blk_req_complete(req, status);
     virtio_blk_free_request(req);
-    aio_context_release(blk_get_aio_context(s->conf.conf.blk));
+    aio_context_release(ctx);
     g_free(ioctl_req);
 }
 
 #endif
 
-static VirtIOBlockReq *virtio_blk_get_request(VirtIOBlock *s, VirtQueue *vq)
+/*
+ * Pop up to @max requests at once, this reads the avail index only once
+ * for all of them.  Returns the number of requests stored in @reqs.
+ */
+static unsigned int virtio_blk_get_requests(VirtIOBlock *s, VirtQueue *vq,
+                                            VirtIOBlockReq **reqs,
+                                            unsigned int max)
 {
-    VirtIOBlockReq *req = virtqueue_pop(vq, sizeof(VirtIOBlockReq));
+    unsigned int i, n;
 
-    if (req) {
-        virtio_blk_init_request(s, vq, req);
+    n = virtqueue_pop_batch(vq, sizeof(VirtIOBlockReq), (void **)reqs, max);
+    for (i = 0; i < n; i++) {
+        virtio_blk_init_request(s, vq, reqs[i]);
+        virtio_blk_coalesce_start_request(s, vq);
     }
-    return req;
+    return n;
 }
 
 static int virtio_blk_handle_scsi_req(VirtIOBlockReq *req)
@@ -769,24 +920,39 @@ static int virtio_blk_handle_request(VirtIOBlockReq *req, MultiReqBuffer *mrb)
 
 bool virtio_blk_handle_vq(VirtIOBlock *s, VirtQueue *vq)
 {
-    VirtIOBlockReq *req;
+    VirtIOBlockReq *reqs[VIRTQUEUE_BATCH_SIZE];
+    unsigned int i, n;
     MultiReqBuffer mrb = {};
     bool suppress_notifications = virtio_queue_get_notification(vq);
     bool progress = false;
+    AioContext *ctx = virtio_blk_get_vq_aio_context(s, vq);
 
-    aio_context_acquire(blk_get_aio_context(s->blk));
-    blk_io_plug(s->blk);
+    aio_context_acquire(ctx);
+    blk_io_plug();
 
     do {
         if (suppress_notifications) {
             virtio_queue_set_notification(vq, 0);
         }
 
-        while ((req = virtio_blk_get_request(s, vq))) {
+        while ((n = virtio_blk_get_requests(s, vq, reqs,
+                                            VIRTQUEUE_BATCH_SIZE))) {
             progress = true;
-            if (virtio_blk_handle_request(req, &mrb)) {
-                virtqueue_detach_element(req->vq, &req->elem, 0);
-                virtio_blk_free_request(req);
+            for (i = 0; i < n; i++) {
+                if (virtio_blk_handle_request(reqs[i], &mrb)) {
+                    break;
+                }
+            }
+            if (i < n) {
+                unsigned int j;
+
+                /* Give back the requests that were not looked at yet */
+                for (j = n - 1; j > i; j--) {
+                    virtqueue_unpop(vq, &reqs[j]->elem, 0);
+                    virtio_blk_free_request(reqs[j]);
+                }
+                virtqueue_detach_element(vq, &reqs[i]->elem, 0);
+                virtio_blk_free_request(reqs[i]);
                 break;
             }
         }
@@ -800,8 +966,8 @@ bool virtio_blk_handle_vq(VirtIOBlock *s, VirtQueue *vq)
         virtio_blk_submit_multireq(s->blk, &mrb);
     }
 
-    blk_io_unplug(s->blk);
-    aio_context_release(blk_get_aio_context(s->blk));
+    blk_io_unplug();
+    aio_context_release(ctx);
     return progress;
 }
 
@@ -828,14 +994,22 @@ static void virtio_blk_handle_output(VirtIODevice *vdev, VirtQueue *vq)
 
 void virtio_blk_process_queued_requests(VirtIOBlock *s, bool is_bh)
 {
-    VirtIOBlockReq *req = s->rq;
+    VirtIOBlockReq *req;
     MultiReqBuffer mrb = {};
 
+    qemu_mutex_lock(&s->rq_lock);
+    req = s->rq;
     s->rq = NULL;
+    qemu_mutex_unlock(&s->rq_lock);
 
     aio_context_acquire(blk_get_aio_context(s->conf.conf.blk));
     while (req) {
         VirtIOBlockReq *next = req->next;
+
+        /* Merged requests complete together under one virtqueue's lock */
+        if (mrb.num_reqs && mrb.reqs[0]->vq != req->vq) {
+            virtio_blk_submit_multireq(s->blk, &mrb);
+        }
         if (virtio_blk_handle_request(req, &mrb)) {
             /* Device is now broken and won't do any processing until it gets
              * reset. Already queued requests will be lost: let's purge them.
@@ -898,6 +1072,7 @@ static void virtio_blk_reset(VirtIODevice *vdev)
     VirtIOBlock *s = VIRTIO_BLK(vdev);
     AioContext *ctx;
     VirtIOBlockReq *req;
+    unsigned i;
 
     ctx = blk_get_aio_context(s->blk);
     aio_context_acquire(ctx);
@@ -914,6 +1089,14 @@ static void virtio_blk_reset(VirtIODevice *vdev)
 
     aio_context_release(ctx);
 
+    /* The guest does not look at the rings anymore */
+    if (s->coalesce) {
+        for (i = 0; i < s->conf.num_queues; i++) {
+            s->coalesce[i].pending = 0;
+        }
+        virtio_blk_coalesce_flush(s);
+    }
+
     assert(!s->dataplane_started);
     blk_set_enable_write_cache(s->blk, s->original_wce);
 }
@@ -1211,16 +1394,45 @@ static void virtio_blk_device_realize(DeviceState *dev, Error **errp)
         return;
     }
 
+    if (conf->iothread && conf->num_iothreads) {
+        error_setg(errp, "iothread and iothreads cannot be used together");
+        return;
+    }
+
+    if (conf->coalesce_max_usecs > VIRTIO_BLK_COALESCE_MAX_USECS) {
+        error_setg(errp, "invalid coalesce-max-usecs property (%" PRIu32
+                   "), must be at most %d", conf->coalesce_max_usecs,
+                   VIRTIO_BLK_COALESCE_MAX_USECS);
+        return;
+    }
+    if ((conf->coalesce_max_events || conf->coalesce_adaptive) &&
+        !conf->coalesce_max_usecs) {
+        error_setg(errp, "coalesce-max-events and coalesce-adaptive "
+                   "require coalesce-max-usecs");
+        return;
+    }
+
     virtio_blk_set_config_size(s, s->host_features);
 
     virtio_init(vdev, "virtio-blk", VIRTIO_ID_BLOCK, s->config_size);
 
     s->blk = conf->conf.blk;
+    qemu_mutex_init(&s->rq_lock);
     s->rq = NULL;
     s->sector_mask = (s->conf.conf.logical_block_size / BDRV_SECTOR_SIZE) - 1;
 
     for (i = 0; i < conf->num_queues; i++) {
-        virtio_add_queue(vdev, conf->queue_size, virtio_blk_handle_output);
+        VirtQueue *vq = virtio_add_queue(vdev, conf->queue_size,
+                                         virtio_blk_handle_output);
+
+        virtio_queue_enable_element_pool(vq, sizeof(VirtIOBlockReq));
+    }
+    if (conf->coalesce_max_usecs) {
+        s->coalesce = g_new0(VirtIOBlockCoalesce, conf->num_queues);
+        for (i = 0; i < conf->num_queues; i++) {
+            s->coalesce[i].s = s;
+            s->coalesce[i].vq = virtio_get_queue(vdev, i);
+        }
     }
     virtio_blk_data_plane_create(vdev, conf, &s->dataplane, &err);
     if (err != NULL) {
@@ -1228,6 +1440,9 @@ static void virtio_blk_device_realize(DeviceState *dev, Error **errp)
         for (i = 0; i < conf->num_queues; i++) {
             virtio_del_queue(vdev, i);
         }
+        g_free(s->coalesce);
+        s->coalesce = NULL;
+        qemu_mutex_destroy(&s->rq_lock);
         virtio_cleanup(vdev);
         return;
     }
@@ -1238,6 +1453,9 @@ static void virtio_blk_device_realize(DeviceState *dev, Error **errp)
 
     blk_iostatus_enable(s->blk);
 
+    /* Enough coroutines for half of the requests the queues can hold */
+    qemu_coroutine_inc_pool_size(conf->num_queues * conf->queue_size / 2);
+
     add_boot_device_lchs(dev, "/disk@0,0",
                          conf->conf.lcyls,
                          conf->conf.lheads,
@@ -1252,14 +1470,23 @@ static void virtio_blk_device_unrealize(DeviceState *dev)
     unsigned i;
 
     blk_drain(s->blk);
+    qemu_coroutine_dec_pool_size(conf->num_queues * conf->queue_size / 2);
     del_boot_device_lchs(dev, "/disk@0,0");
     virtio_blk_data_plane_destroy(s->dataplane);
     s->dataplane = NULL;
+    if (s->coalesce) {
+        for (i = 0; i < conf->num_queues; i++) {
+            timer_free(s->coalesce[i].timer);
+        }
+        g_free(s->coalesce);
+        s->coalesce = NULL;
+    }
     for (i = 0; i < conf->num_queues; i++) {
         virtio_del_queue(vdev, i);
     }
     qemu_del_vm_change_state_handler(s->change);
     blockdev_mark_auto_del(s->blk);
+    qemu_mutex_destroy(&s->rq_lock);
     virtio_cleanup(vdev);
 }
 
@@ -1301,6 +1528,8 @@ static Property virtio_blk_properties[] = {
     DEFINE_PROP_BOOL("seg-max-adjust", VirtIOBlock, conf.seg_max_adjust, true),
     DEFINE_PROP_LINK("iothread", VirtIOBlock, conf.iothread, TYPE_IOTHREAD,
                      IOThread *),
+    DEFINE_PROP_ARRAY("iothreads", VirtIOBlock, conf.num_iothreads,
+                      conf.iothreads, qdev_prop_string, char *),
     DEFINE_PROP_BIT64("discard", VirtIOBlock, host_features,
                       VIRTIO_BLK_F_DISCARD, true),
     DEFINE_PROP_BOOL("report-discard-granularity", VirtIOBlock,
@@ -1311,6 +1540,12 @@ static Property virtio_blk_properties[] = {
                        conf.max_discard_sectors, BDRV_REQUEST_MAX_SECTORS),
     DEFINE_PROP_UINT32("max-write-zeroes-sectors", VirtIOBlock,
                        conf.max_write_zeroes_sectors, BDRV_REQUEST_MAX_SECTORS),
+    DEFINE_PROP_UINT32("coalesce-max-events", VirtIOBlock,
+                       conf.coalesce_max_events, 0),
+    DEFINE_PROP_UINT32("coalesce-max-usecs", VirtIOBlock,
+                       conf.coalesce_max_usecs, 0),
+    DEFINE_PROP_BOOL("coalesce-adaptive", VirtIOBlock,
+                     conf.coalesce_adaptive, false),
     DEFINE_PROP_BOOL("x-enable-wce-if-config-wce", VirtIOBlock,
                      conf.x_enable_wce_if_config_wce, true),
     DEFINE_PROP_END_OF_LIST(),
@@ -44,19 +44,80 @@ static void xen_block_disconnect(XenDevice *xendev, Error **errp)
     const char *type = object_get_typename(OBJECT(blockdev));
     XenBlockVdev *vdev = &blockdev->props.vdev;
 
+    unsigned int i;
+
     trace_xen_block_disconnect(type, vdev->disk, vdev->partition);
 
-    xen_block_dataplane_stop(blockdev->dataplane);
+    for (i = 0; i < blockdev->nr_dataplanes; i++) {
+        xen_block_dataplane_stop(blockdev->dataplanes[i]);
+    }
+}
+
+/*
+ * Read the ring references and the event channel of one queue.  With
+ * more than one queue, the frontend writes them below queue-<n>/.
+ */
+static unsigned int *xen_block_read_ring(XenDevice *xendev,
+                                         const char *prefix, int order,
+                                         unsigned int *nr_ring_ref,
+                                         unsigned int *event_channel,
+                                         Error **errp)
+{
+    unsigned int *ring_ref;
+    unsigned int i;
+    char *key;
+
+    if (order < 0) {
+        *nr_ring_ref = 1;
+        ring_ref = g_new(unsigned int, 1);
+
+        key = g_strdup_printf("%sring-ref", prefix);
+        if (xen_device_frontend_scanf(xendev, key, "%u",
+                                      &ring_ref[0]) != 1) {
+            goto fail;
+        }
+        g_free(key);
+    } else {
+        *nr_ring_ref = 1 << order;
+        ring_ref = g_new(unsigned int, *nr_ring_ref);
+
+        for (i = 0; i < *nr_ring_ref; i++) {
+            key = g_strdup_printf("%sring-ref%u", prefix, i);
+            if (xen_device_frontend_scanf(xendev, key, "%u",
+                                          &ring_ref[i]) != 1) {
+                goto fail;
+            }
+            g_free(key);
+        }
+    }
+
+    key = g_strdup_printf("%sevent-channel", prefix);
+    if (xen_device_frontend_scanf(xendev, key, "%u", event_channel) != 1) {
+        goto fail;
+    }
+    g_free(key);
+
+    return ring_ref;
+
+fail:
+    error_setg(errp, "failed to read %s", key);
+    g_free(key);
+    g_free(ring_ref);
+    return NULL;
 }
 
 static void xen_block_connect(XenDevice *xendev, Error **errp)
 {
+    ERRP_GUARD();
     XenBlockDevice *blockdev = XEN_BLOCK_DEVICE(xendev);
     const char *type = object_get_typename(OBJECT(blockdev));
     XenBlockVdev *vdev = &blockdev->props.vdev;
     BlockConf *conf = &blockdev->props.conf;
-    unsigned int feature_large_sector_size;
-    unsigned int order, nr_ring_ref, *ring_ref, event_channel, protocol;
+    unsigned int feature_large_sector_size, feature_persistent;
+    unsigned int order, nr_queues, nr_ring_ref, event_channel, protocol;
+    unsigned int *ring_ref, nr_grant_refs, i;
+    int ring_order;
+    bool persistent;
     char *str;
 
     trace_xen_block_connect(type, vdev->disk, vdev->partition);
@@ -75,46 +136,30 @@ static void xen_block_connect(XenDevice *xendev, Error **errp)
 
     if (xen_device_frontend_scanf(xendev, "ring-page-order", "%u",
                                   &order) != 1) {
+        ring_order = -1;
         nr_ring_ref = 1;
-        ring_ref = g_new(unsigned int, nr_ring_ref);
-
-        if (xen_device_frontend_scanf(xendev, "ring-ref", "%u",
-                                      &ring_ref[0]) != 1) {
-            error_setg(errp, "failed to read ring-ref");
-            g_free(ring_ref);
-            return;
-        }
     } else if (order <= blockdev->props.max_ring_page_order) {
-        unsigned int i;
-
+        ring_order = order;
         nr_ring_ref = 1 << order;
-        ring_ref = g_new(unsigned int, nr_ring_ref);
-
-        for (i = 0; i < nr_ring_ref; i++) {
-            const char *key = g_strdup_printf("ring-ref%u", i);
-
-            if (xen_device_frontend_scanf(xendev, key, "%u",
-                                          &ring_ref[i]) != 1) {
-                error_setg(errp, "failed to read %s", key);
-                g_free((gpointer)key);
-                g_free(ring_ref);
-                return;
-            }
-
-            g_free((gpointer)key);
-        }
     } else {
         error_setg(errp, "invalid ring-page-order (%d)", order);
         return;
     }
 
-    if (xen_device_frontend_scanf(xendev, "event-channel", "%u",
-                                  &event_channel) != 1) {
-        error_setg(errp, "failed to read event-channel");
-        g_free(ring_ref);
+    if (xen_device_frontend_scanf(xendev, "multi-queue-num-queues", "%u",
+                                  &nr_queues) != 1) {
+        nr_queues = 1;
+    } else if (nr_queues < 1 || nr_queues > blockdev->nr_dataplanes) {
+        error_setg(errp, "invalid multi-queue-num-queues (%u)", nr_queues);
         return;
     }
 
+    if (xen_device_frontend_scanf(xendev, "feature-persistent", "%u",
+                                  &feature_persistent) != 1) {
+        feature_persistent = 0;
+    }
+    persistent = blockdev->props.persistent_grants && feature_persistent == 1;
+
     if (xen_device_frontend_scanf(xendev, "protocol", "%ms",
                                   &str) != 1) {
         protocol = BLKIF_PROTOCOL_NATIVE;
@@ -130,10 +175,36 @@ static void xen_block_connect(XenDevice *xendev, Error **errp)
         free(str);
     }
 
-    xen_block_dataplane_start(blockdev->dataplane, ring_ref, nr_ring_ref,
-                              event_channel, protocol, errp);
+    /* All the queues share the grant table handle of the device */
+    nr_grant_refs = nr_queues *
+        xen_block_dataplane_max_grant_refs(nr_ring_ref, protocol, persistent);
+    xen_device_set_max_grant_refs(xendev, nr_grant_refs, errp);
+    if (*errp) {
+        return;
+    }
+
+    for (i = 0; i < nr_queues; i++) {
+        g_autofree char *prefix = nr_queues > 1 ?
+            g_strdup_printf("queue-%u/", i) : g_strdup("");
 
-    g_free(ring_ref);
+        ring_ref = xen_block_read_ring(xendev, prefix, ring_order, &nr_ring_ref,
+                                       &event_channel, errp);
+        if (!ring_ref) {
+            break;
+        }
+
+        xen_block_dataplane_start(blockdev->dataplanes[i], ring_ref,
+                                  nr_ring_ref, event_channel, protocol,
+                                  persistent, errp);
+        g_free(ring_ref);
+        if (*errp) {
+            break;
+        }
+    }
+
+    if (*errp) {
+        xen_block_disconnect(xendev, NULL);
+    }
 }
 
 static void xen_block_unrealize(XenDevice *xendev)
@@ -143,6 +214,7 @@ static void xen_block_unrealize(XenDevice *xendev)
         XEN_BLOCK_DEVICE_GET_CLASS(xendev);
     const char *type = object_get_typename(OBJECT(blockdev));
     XenBlockVdev *vdev = &blockdev->props.vdev;
+    unsigned int i;
 
     if (vdev->type == XEN_BLOCK_VDEV_TYPE_INVALID) {
         return;
@@ -153,8 +225,12 @@ static void xen_block_unrealize(XenDevice *xendev)
     /* Disconnect from the frontend in case this has not already happened */
     xen_block_disconnect(xendev, NULL);
 
-    xen_block_dataplane_destroy(blockdev->dataplane);
-    blockdev->dataplane = NULL;
+    for (i = 0; i < blockdev->nr_dataplanes; i++) {
+        xen_block_dataplane_destroy(blockdev->dataplanes[i]);
+    }
+    g_free(blockdev->dataplanes);
+    blockdev->dataplanes = NULL;
+    blockdev->nr_dataplanes = 0;
 
     if (blockdev_class->unrealize) {
         blockdev_class->unrealize(blockdev);
@@ -203,12 +279,18 @@ static void xen_block_realize(XenDevice *xendev, Error **errp)
     XenBlockVdev *vdev = &blockdev->props.vdev;
     BlockConf *conf = &blockdev->props.conf;
     BlockBackend *blk = conf->blk;
+    unsigned int i;
 
     if (vdev->type == XEN_BLOCK_VDEV_TYPE_INVALID) {
         error_setg(errp, "vdev property not set");
         return;
     }
 
+    if (blockdev->props.max_queues < 1) {
+        error_setg(errp, "max-queues must be at least 1");
+        return;
+    }
+
     trace_xen_block_realize(type, vdev->disk, vdev->partition);
 
     if (blockdev_class->realize) {
@@ -259,6 +341,10 @@ static void xen_block_realize(XenDevice *xendev, Error **errp)
     xen_device_backend_printf(xendev, "feature-flush-cache", "%u", 1);
     xen_device_backend_printf(xendev, "max-ring-page-order", "%u",
                               blockdev->props.max_ring_page_order);
+    xen_device_backend_printf(xendev, "multi-queue-max-queues", "%u",
+                              blockdev->props.max_queues);
+    xen_device_backend_printf(xendev, "feature-persistent", "%u",
+                              blockdev->props.persistent_grants);
     xen_device_backend_printf(xendev, "info", "%u", blockdev->info);
 
     xen_device_frontend_printf(xendev, "virtual-device", "%lu",
@@ -271,9 +357,18 @@ static void xen_block_realize(XenDevice *xendev, Error **errp)
 
     xen_block_set_size(blockdev);
 
-    blockdev->dataplane =
-        xen_block_dataplane_create(xendev, blk, conf->logical_block_size,
-                                   blockdev->props.iothread);
+    /*
+     * Each queue has its own ring and event channel, but they all run in
+     * the same AioContext.
+     */
+    blockdev->nr_dataplanes = blockdev->props.max_queues;
+    blockdev->dataplanes = g_new(XenBlockDataPlane *,
+                                 blockdev->nr_dataplanes);
+    for (i = 0; i < blockdev->nr_dataplanes; i++) {
+        blockdev->dataplanes[i] =
+            xen_block_dataplane_create(xendev, blk, conf->logical_block_size,
+                                       blockdev->props.iothread);
+    }
 }
 
 static void xen_block_frontend_changed(XenDevice *xendev,
@@ -521,6 +616,9 @@ static Property xen_block_props[] = {
     DEFINE_BLOCK_PROPERTIES(XenBlockDevice, props.conf),
     DEFINE_PROP_UINT32("max-ring-page-order", XenBlockDevice,
                        props.max_ring_page_order, 4),
+    DEFINE_PROP_UINT32("max-queues", XenBlockDevice, props.max_queues, 4),
+    DEFINE_PROP_BOOL("persistent-grants", XenBlockDevice,
+                     props.persistent_grants, true),
     DEFINE_PROP_LINK("iothread", XenBlockDevice, props.iothread,
                      TYPE_IOTHREAD, IOThread *),
     DEFINE_PROP_END_OF_LIST()
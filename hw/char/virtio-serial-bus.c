@@ -158,6 +158,120 @@ static void discard_throttle_data(VirtIOSerialPort *port)
     }
 }
 
+/* Maximum number of elements handed to have_data_iov at once */
+#define VIRTIO_SERIAL_FLUSH_BATCH 64
+
+/* Append the data of @elem from buffer @idx, @offset bytes in, to @iov */
+static int flush_batch_add(struct iovec *iov, int iovcnt,
+                           VirtQueueElement *elem, unsigned int idx,
+                           size_t offset)
+{
+    unsigned int i;
+
+    for (i = idx; i < elem->out_num; i++) {
+        iov[iovcnt].iov_base = elem->out_sg[i].iov_base + offset;
+        iov[iovcnt].iov_len = elem->out_sg[i].iov_len - offset;
+        iovcnt++;
+        offset = 0;
+    }
+    return iovcnt;
+}
+
+/*
+ * Gather the data of as many elements as possible and pass it to the
+ * port at once.  Elements that were consumed completely are pushed
+ * back to the guest.  If the port throttles in the middle of an
+ * element, that element is kept in port->elem as in the unbatched
+ * case, and the elements after it are returned to the virtqueue.
+ */
+static void do_flush_queued_data_batched(VirtIOSerialPort *port,
+                                         VirtQueue *vq, VirtIODevice *vdev)
+{
+    VirtIOSerialPortClass *vsc = VIRTIO_SERIAL_PORT_GET_CLASS(port);
+    VirtQueueElement *elems[VIRTIO_SERIAL_FLUSH_BATCH];
+    g_autofree struct iovec *iov = g_new(struct iovec, VIRTQUEUE_MAX_SIZE);
+
+    while (!port->throttled) {
+        VirtQueueElement *elem;
+        unsigned int idx = 0;
+        size_t offset = 0;
+        size_t consumed;
+        int nelems = 0, iovcnt = 0;
+        ssize_t ret;
+        int i, j;
+
+        /* Start with the elem we left off mid-way, if any */
+        if (port->elem) {
+            idx = port->iov_idx;
+            offset = port->iov_offset;
+            elems[nelems++] = port->elem;
+            iovcnt = flush_batch_add(iov, iovcnt, port->elem, idx, offset);
+            port->elem = NULL;
+        }
+        while (nelems < VIRTIO_SERIAL_FLUSH_BATCH) {
+            elem = virtqueue_pop(vq, sizeof(VirtQueueElement));
+            if (!elem) {
+                break;
+            }
+            if (iovcnt + elem->out_num > VIRTQUEUE_MAX_SIZE) {
+                virtqueue_unpop(vq, elem, 0);
+                g_free(elem);
+                break;
+            }
+            elems[nelems++] = elem;
+            iovcnt = flush_batch_add(iov, iovcnt, elem, 0, 0);
+        }
+        if (!nelems) {
+            break;
+        }
+
+        ret = vsc->have_data_iov(port, iov, iovcnt);
+        if (!port->host_connected) { /* bail if we got disconnected */
+            for (i = 0; i < nelems; i++) {
+                virtqueue_detach_element(vq, elems[i], 0);
+                g_free(elems[i]);
+            }
+            return;
+        }
+
+        /* Without throttling, the data that was not taken is dropped */
+        consumed = port->throttled ? MAX(ret, 0) : SIZE_MAX;
+
+        for (i = 0; i < nelems; i++) {
+            size_t len;
+
+            elem = elems[i];
+            if (i > 0) {
+                idx = 0;
+                offset = 0;
+            }
+            len = iov_size(elem->out_sg + idx, elem->out_num - idx) - offset;
+            if (consumed >= len) {
+                consumed -= len;
+                virtqueue_push(vq, elem, 0);
+                g_free(elem);
+                continue;
+            }
+
+            offset += consumed;
+            while (offset >= elem->out_sg[idx].iov_len) {
+                offset -= elem->out_sg[idx].iov_len;
+                idx++;
+            }
+            port->elem = elem;
+            port->iov_idx = idx;
+            port->iov_offset = offset;
+
+            for (j = nelems - 1; j > i; j--) {
+                virtqueue_unpop(vq, elems[j], 0);
+                g_free(elems[j]);
+            }
+            break;
+        }
+    }
+    virtio_notify(vdev, vq);
+}
+
 static void do_flush_queued_data(VirtIOSerialPort *port, VirtQueue *vq,
                                  VirtIODevice *vdev)
 {
@@ -167,6 +281,10 @@ static void do_flush_queued_data(VirtIOSerialPort *port, VirtQueue *vq,
     assert(virtio_queue_ready(vq));
 
     vsc = VIRTIO_SERIAL_PORT_GET_CLASS(port);
+    if (vsc->have_data_iov) {
+        do_flush_queued_data_batched(port, vq, vdev);
+        return;
+    }
 
     while (!port->throttled) {
         unsigned int i;
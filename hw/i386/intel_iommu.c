@@ -21,6 +21,7 @@
 
 #include "qemu/osdep.h"
 #include "qemu/error-report.h"
+#include "qemu/host-utils.h"
 #include "qemu/main-loop.h"
 #include "qapi/error.h"
 #include "hw/sysbus.h"
@@ -200,14 +201,6 @@ static guint vtd_uint64_hash(gconstpointer v)
     return (guint)*(const uint64_t *)v;
 }
 
-static gboolean vtd_hash_remove_by_domain(gpointer key, gpointer value,
-                                          gpointer user_data)
-{
-    VTDIOTLBEntry *entry = (VTDIOTLBEntry *)value;
-    uint16_t domain_id = *(uint16_t *)user_data;
-    return entry->domain_id == domain_id;
-}
-
 /* The shift of an addr for a certain level of paging structure */
 static inline uint32_t vtd_slpt_level_shift(uint32_t level)
 {
@@ -220,11 +213,9 @@ static inline uint64_t vtd_slpt_level_page_mask(uint32_t level)
     return ~((1ULL << vtd_slpt_level_shift(level)) - 1);
 }
 
-static gboolean vtd_hash_remove_by_page(gpointer key, gpointer value,
-                                        gpointer user_data)
+static bool vtd_iotlb_entry_match_page(VTDIOTLBEntry *entry,
+                                       VTDIOTLBPageInvInfo *info)
 {
-    VTDIOTLBEntry *entry = (VTDIOTLBEntry *)value;
-    VTDIOTLBPageInvInfo *info = (VTDIOTLBPageInvInfo *)user_data;
     uint64_t gfn = (info->addr >> VTD_PAGE_SHIFT_4K) & info->mask;
     uint64_t gfn_tlb = (info->addr & entry->mask) >> VTD_PAGE_SHIFT_4K;
     return (entry->domain_id == info->domain_id) &&
@@ -263,6 +254,32 @@ static void vtd_reset_iotlb_locked(IntelIOMMUState *s)
 {
     assert(s->iotlb);
     g_hash_table_remove_all(s->iotlb);
+    g_hash_table_remove_all(s->iotlb_domains);
+    QTAILQ_INIT(&s->iotlb_lru);
+}
+
+/* Must be called with IOMMU lock held. */
+static void vtd_iotlb_remove_entry(IntelIOMMUState *s, VTDIOTLBEntry *entry)
+{
+    QTAILQ_REMOVE(&s->iotlb_lru, entry, lru);
+    QLIST_REMOVE(entry, domain_link);
+    /* Frees the entry */
+    g_hash_table_remove(s->iotlb, &entry->key);
+}
+
+/* Must be called with IOMMU lock held. */
+static VTDIOTLBDomain *vtd_iotlb_get_domain(IntelIOMMUState *s,
+                                            uint16_t domain_id, bool create)
+{
+    gpointer key = GUINT_TO_POINTER(domain_id);
+    VTDIOTLBDomain *domain = g_hash_table_lookup(s->iotlb_domains, key);
+
+    if (!domain && create) {
+        domain = g_new0(VTDIOTLBDomain, 1);
+        QLIST_INIT(&domain->entries);
+        g_hash_table_insert(s->iotlb_domains, key, domain);
+    }
+    return domain;
 }
 
 static void vtd_reset_iotlb(IntelIOMMUState *s)
@@ -305,6 +322,8 @@ static VTDIOTLBEntry *vtd_lookup_iotlb(IntelIOMMUState *s, uint16_t source_id,
                                 source_id, level);
         entry = g_hash_table_lookup(s->iotlb, &key);
         if (entry) {
+            QTAILQ_REMOVE(&s->iotlb_lru, entry, lru);
+            QTAILQ_INSERT_HEAD(&s->iotlb_lru, entry, lru);
             goto out;
         }
     }
@@ -318,23 +337,32 @@ static void vtd_update_iotlb(IntelIOMMUState *s, uint16_t source_id,
                              uint16_t domain_id, hwaddr addr, uint64_t slpte,
                              uint8_t access_flags, uint32_t level)
 {
-    VTDIOTLBEntry *entry = g_malloc(sizeof(*entry));
-    uint64_t *key = g_malloc(sizeof(*key));
+    VTDIOTLBEntry *entry;
     uint64_t gfn = vtd_get_iotlb_gfn(addr, level);
+    uint64_t key = vtd_get_iotlb_key(gfn, source_id, level);
 
     trace_vtd_iotlb_page_update(source_id, addr, slpte, domain_id);
-    if (g_hash_table_size(s->iotlb) >= VTD_IOTLB_MAX_SIZE) {
-        trace_vtd_iotlb_reset("iotlb exceeds size limit");
-        vtd_reset_iotlb_locked(s);
+    entry = g_hash_table_lookup(s->iotlb, &key);
+    if (entry) {
+        vtd_iotlb_remove_entry(s, entry);
+    } else if (g_hash_table_size(s->iotlb) >= s->iotlb_size) {
+        /* Make room by dropping the least recently used translation */
+        entry = QTAILQ_LAST(&s->iotlb_lru);
+        trace_vtd_iotlb_evict(entry->domain_id, entry->gfn);
+        vtd_iotlb_remove_entry(s, entry);
     }
 
+    entry = g_new(VTDIOTLBEntry, 1);
     entry->gfn = gfn;
     entry->domain_id = domain_id;
     entry->slpte = slpte;
     entry->access_flags = access_flags;
     entry->mask = vtd_slpt_level_page_mask(level);
-    *key = vtd_get_iotlb_key(gfn, source_id, level);
-    g_hash_table_replace(s->iotlb, key, entry);
+    entry->key = key;
+    g_hash_table_insert(s->iotlb, &entry->key, entry);
+    QTAILQ_INSERT_HEAD(&s->iotlb_lru, entry, lru);
+    QLIST_INSERT_HEAD(&vtd_iotlb_get_domain(s, domain_id, true)->entries,
+                      entry, domain_link);
 }
 
 /* Given the reg addr of both the message data and address, generate an
@@ -1962,12 +1990,18 @@ static void vtd_iotlb_domain_invalidate(IntelIOMMUState *s, uint16_t domain_id)
 {
     VTDContextEntry ce;
     VTDAddressSpace *vtd_as;
+    VTDIOTLBDomain *domain;
+    VTDIOTLBEntry *entry, *next;
 
     trace_vtd_inv_desc_iotlb_domain(domain_id);
 
     vtd_iommu_lock(s);
-    g_hash_table_foreach_remove(s->iotlb, vtd_hash_remove_by_domain,
-                                &domain_id);
+    domain = vtd_iotlb_get_domain(s, domain_id, false);
+    if (domain) {
+        QLIST_FOREACH_SAFE(entry, &domain->entries, domain_link, next) {
+            vtd_iotlb_remove_entry(s, entry);
+        }
+    }
     vtd_iommu_unlock(s);
 
     QLIST_FOREACH(vtd_as, &s->vtd_as_with_notifiers, next) {
@@ -1979,14 +2013,39 @@ static void vtd_iotlb_domain_invalidate(IntelIOMMUState *s, uint16_t domain_id)
     }
 }
 
+/* Deliver an UNMAP event for [addr, addr + size) in naturally aligned chunks */
+static void vtd_notify_unmap_range(VTDAddressSpace *vtd_as, hwaddr addr,
+                                   hwaddr size)
+{
+    while (size) {
+        hwaddr chunk = pow2floor(size);
+        IOMMUTLBEvent event = {
+            .type = IOMMU_NOTIFIER_UNMAP,
+            .entry = {
+                .target_as = &address_space_memory,
+                .translated_addr = 0,
+                .perm = IOMMU_NONE,
+            },
+        };
+
+        if (addr & (chunk - 1)) {
+            chunk = addr & -addr;
+        }
+        event.entry.iova = addr;
+        event.entry.addr_mask = chunk - 1;
+        memory_region_notify_iommu(&vtd_as->iommu, 0, event);
+        addr += chunk;
+        size -= chunk;
+    }
+}
+
 static void vtd_iotlb_page_invalidate_notify(IntelIOMMUState *s,
-                                           uint16_t domain_id, hwaddr addr,
-                                           uint8_t am)
+                                             uint16_t domain_id, hwaddr addr,
+                                             hwaddr size)
 {
     VTDAddressSpace *vtd_as;
     VTDContextEntry ce;
     int ret;
-    hwaddr size = (1 << am) * VTD_PAGE_SIZE;
 
     QLIST_FOREACH(vtd_as, &(s->vtd_as_with_notifiers), next) {
         ret = vtd_dev_to_context_entry(s, pci_bus_num(vtd_as->bus),
@@ -2005,26 +2064,36 @@ static void vtd_iotlb_page_invalidate_notify(IntelIOMMUState *s,
                  * page tables.  We just deliver the PSI down to
                  * invalidate caches.
                  */
-                IOMMUTLBEvent event = {
-                    .type = IOMMU_NOTIFIER_UNMAP,
-                    .entry = {
-                        .target_as = &address_space_memory,
-                        .iova = addr,
-                        .translated_addr = 0,
-                        .addr_mask = size - 1,
-                        .perm = IOMMU_NONE,
-                    },
-                };
-                memory_region_notify_iommu(&vtd_as->iommu, 0, event);
+                vtd_notify_unmap_range(vtd_as, addr, size);
             }
         }
     }
 }
 
+/* Notify the page invalidations queued by vtd_iotlb_page_invalidate() */
+static void vtd_iotlb_flush_pending_inv(IntelIOMMUState *s)
+{
+    if (!s->iotlb_inv_pending) {
+        return;
+    }
+    s->iotlb_inv_pending = false;
+    vtd_iotlb_page_invalidate_notify(s, s->iotlb_inv_domain,
+                                     s->iotlb_inv_addr, s->iotlb_inv_size);
+}
+
+/*
+ * With @batch, the notification to IOMMU notifiers (e.g. VFIO unmaps) is
+ * merged with those of adjacent ranges of the same domain, and delivered
+ * by vtd_iotlb_flush_pending_inv() before the next descriptor of another
+ * kind, e.g. the wait descriptor the guest uses to wait for completion.
+ */
 static void vtd_iotlb_page_invalidate(IntelIOMMUState *s, uint16_t domain_id,
-                                      hwaddr addr, uint8_t am)
+                                      hwaddr addr, uint8_t am, bool batch)
 {
     VTDIOTLBPageInvInfo info;
+    VTDIOTLBDomain *domain;
+    VTDIOTLBEntry *entry, *next;
+    hwaddr size = (1ULL << am) * VTD_PAGE_SIZE;
 
     trace_vtd_inv_desc_iotlb_pages(domain_id, addr, am);
 
@@ -2033,9 +2102,37 @@ static void vtd_iotlb_page_invalidate(IntelIOMMUState *s, uint16_t domain_id,
     info.addr = addr;
     info.mask = ~((1 << am) - 1);
     vtd_iommu_lock(s);
-    g_hash_table_foreach_remove(s->iotlb, vtd_hash_remove_by_page, &info);
+    domain = vtd_iotlb_get_domain(s, domain_id, false);
+    if (domain) {
+        QLIST_FOREACH_SAFE(entry, &domain->entries, domain_link, next) {
+            if (vtd_iotlb_entry_match_page(entry, &info)) {
+                vtd_iotlb_remove_entry(s, entry);
+            }
+        }
+    }
     vtd_iommu_unlock(s);
-    vtd_iotlb_page_invalidate_notify(s, domain_id, addr, am);
+
+    if (s->iotlb_inv_pending && s->iotlb_inv_domain == domain_id) {
+        if (addr == s->iotlb_inv_addr + s->iotlb_inv_size) {
+            s->iotlb_inv_size += size;
+            return;
+        }
+        if (addr + size == s->iotlb_inv_addr) {
+            s->iotlb_inv_addr = addr;
+            s->iotlb_inv_size += size;
+            return;
+        }
+    }
+    vtd_iotlb_flush_pending_inv(s);
+
+    if (batch) {
+        s->iotlb_inv_pending = true;
+        s->iotlb_inv_domain = domain_id;
+        s->iotlb_inv_addr = addr;
+        s->iotlb_inv_size = size;
+    } else {
+        vtd_iotlb_page_invalidate_notify(s, domain_id, addr, size);
+    }
 }
 
 /* Flush IOTLB
@@ -2074,7 +2171,7 @@ static uint64_t vtd_iotlb_flush(IntelIOMMUState *s, uint64_t val)
             break;
         }
         iaig = VTD_TLB_PSI_FLUSH_A;
-        vtd_iotlb_page_invalidate(s, domain_id, addr, am);
+        vtd_iotlb_page_invalidate(s, domain_id, addr, am, false);
         break;
 
     default:
@@ -2397,7 +2494,7 @@ static bool vtd_process_iotlb_desc(IntelIOMMUState *s, VTDInvDesc *inv_desc)
                               am, (unsigned)VTD_MAMV);
             return false;
         }
-        vtd_iotlb_page_invalidate(s, domain_id, addr, am);
+        vtd_iotlb_page_invalidate(s, domain_id, addr, am, true);
         break;
 
     default:
@@ -2502,6 +2599,12 @@ static bool vtd_process_inv_desc(IntelIOMMUState *s)
     /* FIXME: should update at first or at last? */
     s->iq_last_desc_type = desc_type;
 
+    /* Only page selective IOTLB invalidations are batched */
+    if (desc_type != VTD_INV_DESC_IOTLB ||
+        (inv_desc.lo & VTD_INV_DESC_IOTLB_G) != VTD_INV_DESC_IOTLB_PAGE) {
+        vtd_iotlb_flush_pending_inv(s);
+    }
+
     switch (desc_type) {
     case VTD_INV_DESC_CC:
         trace_vtd_inv_desc("context-cache", inv_desc.hi, inv_desc.lo);
@@ -2591,6 +2694,7 @@ static void vtd_fetch_inv_desc(IntelIOMMUState *s)
                          (((uint64_t)(s->iq_head)) << qi_shift) &
                          VTD_IQH_QH_MASK);
     }
+    vtd_iotlb_flush_pending_inv(s);
 }
 
 /* Handle write to Invalidation Queue Tail Register */
@@ -3102,6 +3206,8 @@ static Property vtd_properties[] = {
     DEFINE_PROP_BOOL("caching-mode", IntelIOMMUState, caching_mode, FALSE),
     DEFINE_PROP_BOOL("x-scalable-mode", IntelIOMMUState, scalable_mode, FALSE),
     DEFINE_PROP_BOOL("dma-drain", IntelIOMMUState, dma_drain, true),
+    DEFINE_PROP_UINT32("x-iotlb-size", IntelIOMMUState, iotlb_size,
+                       VTD_IOTLB_MAX_SIZE),
     DEFINE_PROP_END_OF_LIST(),
 };
 
@@ -3737,6 +3843,11 @@ static bool vtd_decide_config(IntelIOMMUState *s, Error **errp)
 {
     X86IOMMUState *x86_iommu = X86_IOMMU_DEVICE(s);
 
+    if (!s->iotlb_size) {
+        error_setg(errp, "x-iotlb-size must be at least 1");
+        return false;
+    }
+
     if (s->intr_eim == ON_OFF_AUTO_ON && !x86_iommu_ir_supported(x86_iommu)) {
         error_setg(errp, "eim=on cannot be selected without intremap=on");
         return false;
@@ -3839,7 +3950,10 @@ static void vtd_realize(DeviceState *dev, Error **errp)
     sysbus_init_mmio(SYS_BUS_DEVICE(s), &s->csrmem);
     /* No corresponding destroy */
     s->iotlb = g_hash_table_new_full(vtd_uint64_hash, vtd_uint64_equal,
-                                     g_free, g_free);
+                                     NULL, g_free);
+    s->iotlb_domains = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                             NULL, g_free);
+    QTAILQ_INIT(&s->iotlb_lru);
     s->vtd_as_by_busptr = g_hash_table_new_full(vtd_uint64_hash, vtd_uint64_equal,
                                               g_free, g_free);
     vtd_init(s);
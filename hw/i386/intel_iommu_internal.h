@@ -116,7 +116,7 @@
 /* The shift of source_id in the key of IOTLB hash table */
 #define VTD_IOTLB_SID_SHIFT         36
 #define VTD_IOTLB_LVL_SHIFT         52
-#define VTD_IOTLB_MAX_SIZE          1024    /* Max size of the hash table */
+#define VTD_IOTLB_MAX_SIZE          4096    /* Default max IOTLB entries */
 
 /* IOTLB_REG */
 #define VTD_TLB_GLOBAL_FLUSH        (1ULL << 60) /* Global invalidation */
@@ -416,6 +416,11 @@ struct VTDIOTLBPageInvInfo {
 };
 typedef struct VTDIOTLBPageInvInfo VTDIOTLBPageInvInfo;
 
+/* IOTLB entries of one domain, for domain and page selective flushes */
+typedef struct VTDIOTLBDomain {
+    QLIST_HEAD(, VTDIOTLBEntry) entries;
+} VTDIOTLBDomain;
+
 /* Pagesize of VTD paging structures, including root and context tables */
 #define VTD_PAGE_SHIFT              12
 #define VTD_PAGE_SIZE               (1ULL << VTD_PAGE_SHIFT)
@@ -758,6 +758,31 @@ static bool load_elfboot(const char *kernel_filename,
     return true;
 }
 
+/*
+ * Map a file handed to the guest through fw_cfg, so that fw_cfg DMA
+ * copies it straight from the page cache into guest memory instead of
+ * going through a buffer.  Start reading it ahead right away, so that
+ * it is in the page cache by the time the firmware asks for it.
+ */
+static GMappedFile *x86_map_boot_file(const char *filename, const char *what)
+{
+    GMappedFile *mapped_file;
+    GError *gerr = NULL;
+
+    mapped_file = g_mapped_file_new(filename, false, &gerr);
+    if (!mapped_file) {
+        fprintf(stderr, "qemu: error reading %s %s: %s\n",
+                what, filename, gerr->message);
+        exit(1);
+    }
+    if (g_mapped_file_get_length(mapped_file)) {
+        qemu_madvise(g_mapped_file_get_contents(mapped_file),
+                     g_mapped_file_get_length(mapped_file),
+                     QEMU_MADV_WILLNEED);
+    }
+    return mapped_file;
+}
+
 void x86_load_linux(X86MachineState *x86ms,
                     FWCfgState *fw_cfg,
                     int acpi_data_size,
@@ -837,14 +862,8 @@ void x86_load_linux(X86MachineState *x86ms,
                 GMappedFile *mapped_file;
                 gsize initrd_size;
                 gchar *initrd_data;
-                GError *gerr = NULL;
 
-                mapped_file = g_mapped_file_new(initrd_filename, false, &gerr);
-                if (!mapped_file) {
-                    fprintf(stderr, "qemu: error reading initrd %s: %s\n",
-                            initrd_filename, gerr->message);
-                    exit(1);
-                }
+                mapped_file = x86_map_boot_file(initrd_filename, "initrd");
                 x86ms->initrd_mapped_file = mapped_file;
 
                 initrd_data = g_mapped_file_get_contents(mapped_file);
@@ -976,19 +995,13 @@ void x86_load_linux(X86MachineState *x86ms,
         GMappedFile *mapped_file;
         gsize initrd_size;
         gchar *initrd_data;
-        GError *gerr = NULL;
 
         if (protocol < 0x200) {
             fprintf(stderr, "qemu: linux kernel too old to load a ram disk\n");
             exit(1);
         }
 
-        mapped_file = g_mapped_file_new(initrd_filename, false, &gerr);
-        if (!mapped_file) {
-            fprintf(stderr, "qemu: error reading initrd %s: %s\n",
-                    initrd_filename, gerr->message);
-            exit(1);
-        }
+        mapped_file = x86_map_boot_file(initrd_filename, "initrd");
         x86ms->initrd_mapped_file = mapped_file;
 
         initrd_data = g_mapped_file_get_contents(mapped_file);
@@ -1023,15 +1036,30 @@ void x86_load_linux(X86MachineState *x86ms,
     kernel_size -= setup_size;
 
     setup  = g_malloc(setup_size);
-    kernel = g_malloc(kernel_size);
     fseek(f, 0, SEEK_SET);
     if (fread(setup, 1, setup_size, f) != setup_size) {
         fprintf(stderr, "fread() failed\n");
         exit(1);
     }
-    if (fread(kernel, 1, kernel_size, f) != kernel_size) {
-        fprintf(stderr, "fread() failed\n");
-        exit(1);
+    if (dtb_filename) {
+        /* the dtb is appended, so the kernel needs a buffer of its own */
+        kernel = g_malloc(kernel_size);
+        if (fread(kernel, 1, kernel_size, f) != kernel_size) {
+            fprintf(stderr, "fread() failed\n");
+            exit(1);
+        }
+    } else {
+        GMappedFile *mapped_file;
+
+        mapped_file = x86_map_boot_file(kernel_filename, "kernel");
+        if (g_mapped_file_get_length(mapped_file) != setup_size + kernel_size) {
+            fprintf(stderr, "qemu: kernel file '%s' changed while loading\n",
+                    kernel_filename);
+            exit(1);
+        }
+        x86ms->kernel_mapped_file = mapped_file;
+        kernel = (uint8_t *)g_mapped_file_get_contents(mapped_file);
+        kernel += setup_size;
     }
     fclose(f);
 
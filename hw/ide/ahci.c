@@ -27,6 +27,7 @@
 #include "hw/qdev-properties.h"
 #include "migration/vmstate.h"
 
+#include "qapi/error.h"
 #include "qemu/error-report.h"
 #include "qemu/log.h"
 #include "qemu/main-loop.h"
@@ -50,6 +51,20 @@ static bool ahci_map_fis_address(AHCIDevice *ad);
 static void ahci_unmap_clb_address(AHCIDevice *ad);
 static void ahci_unmap_fis_address(AHCIDevice *ad);
 
+static void ahci_lock(AHCIState *s)
+{
+    if (s->ctx) {
+        aio_context_acquire(s->ctx);
+    }
+}
+
+static void ahci_unlock(AHCIState *s)
+{
+    if (s->ctx) {
+        aio_context_release(s->ctx);
+    }
+}
+
 static const char *AHCIHostReg_lookup[AHCI_HOST_REG__COUNT] = {
     [AHCI_HOST_REG_CAP]        = "CAP",
     [AHCI_HOST_REG_CTL]        = "GHC",
@@ -203,6 +218,25 @@ static void ahci_irq_lower(AHCIState *s)
     }
 }
 
+static void ahci_update_irq(AHCIState *s)
+{
+    if (s->control_regs.irqstatus &&
+        (s->control_regs.ghc & HOST_CTL_IRQ_EN)) {
+            ahci_irq_raise(s);
+    } else {
+        ahci_irq_lower(s);
+    }
+}
+
+static void ahci_irq_bh(void *opaque)
+{
+    AHCIState *s = opaque;
+
+    ahci_lock(s);
+    ahci_update_irq(s);
+    ahci_unlock(s);
+}
+
 static void ahci_check_irq(AHCIState *s)
 {
     int i;
@@ -216,12 +250,13 @@ static void ahci_check_irq(AHCIState *s)
         }
     }
     trace_ahci_check_irq(s, old_irq, s->control_regs.irqstatus);
-    if (s->control_regs.irqstatus &&
-        (s->control_regs.ghc & HOST_CTL_IRQ_EN)) {
-            ahci_irq_raise(s);
-    } else {
-        ahci_irq_lower(s);
+
+    if (s->ctx && !qemu_mutex_iothread_locked()) {
+        /* Called in the IOThread, leave the interrupt to the main loop */
+        qemu_bh_schedule(s->irq_bh);
+        return;
     }
+    ahci_update_irq(s);
 }
 
 static void ahci_trigger_irq(AHCIState *s, AHCIDevice *d,
@@ -256,6 +291,27 @@ static void map_page(AddressSpace *as, uint8_t **ptr, uint64_t addr,
     }
 }
 
+/*
+ * Move the drive of the port to the IOThread before its command list
+ * is processed there.  The check is repeated every time the engine is
+ * started, so that a medium inserted in the meantime is moved as well.
+ */
+static bool ahci_port_set_aio_context(AHCIDevice *ad)
+{
+    AHCIState *s = ad->hba;
+    BlockBackend *blk = ad->port.ifs[0].blk;
+    Error *local_err = NULL;
+
+    if (!s->ctx || !blk || blk_get_aio_context(blk) == s->ctx) {
+        return true;
+    }
+    if (blk_set_aio_context(blk, s->ctx, &local_err) < 0) {
+        error_report_err(local_err);
+        return false;
+    }
+    return true;
+}
+
 /**
  * Check the cmd register to see if we should start or stop
  * the DMA or FIS RX engines.
@@ -273,6 +329,12 @@ static int ahci_cond_start_engines(AHCIDevice *ad)
     bool fis_on    = pr->cmd & PORT_CMD_FIS_ON;
 
     if (cmd_start && !cmd_on) {
+        if (!ahci_port_set_aio_context(ad)) {
+            pr->cmd &= ~PORT_CMD_START;
+            error_report("AHCI: Failed to start DMA engine: "
+                         "cannot move the drive to the IOThread");
+            return -1;
+        }
         if (!ahci_map_clb_address(ad)) {
             pr->cmd &= ~PORT_CMD_START;
             error_report("AHCI: Failed to start DMA engine: "
@@ -297,6 +359,21 @@ static int ahci_cond_start_engines(AHCIDevice *ad)
     return 0;
 }
 
+/*
+ * Process the issued commands of a port.  With an IOThread, the vCPU
+ * only records the doorbell and the commands are fetched, parsed and
+ * submitted in the IOThread.  ioeventfd cannot be used for PxCI, as the
+ * written value says which slots were issued.
+ */
+static void ahci_kick_port(AHCIState *s, int port)
+{
+    if (s->ctx) {
+        qemu_bh_schedule(s->dev[port].doorbell_bh);
+    } else {
+        check_cmd(s, port);
+    }
+}
+
 static void ahci_port_write(AHCIState *s, int port, int offset, uint32_t val)
 {
     AHCIPortRegs *pr = &s->dev[port].port_regs;
@@ -347,7 +424,7 @@ static void ahci_port_write(AHCIState *s, int port, int offset, uint32_t val)
             ahci_init_d2h(&s->dev[port]);
         }
 
-        check_cmd(s, port);
+        ahci_kick_port(s, port);
         break;
     case AHCI_PORT_REG_TFDATA:
     case AHCI_PORT_REG_SIG:
@@ -370,7 +447,7 @@ static void ahci_port_write(AHCIState *s, int port, int offset, uint32_t val)
         break;
     case AHCI_PORT_REG_CMD_ISSUE:
         pr->cmd_issue |= val;
-        check_cmd(s, port);
+        ahci_kick_port(s, port);
         break;
     default:
         trace_ahci_port_write_unimpl(s, port, AHCIPortReg_lookup[regnum],
@@ -433,12 +510,16 @@ static uint64_t ahci_mem_read_32(void *opaque, hwaddr addr)
  */
 static uint64_t ahci_mem_read(void *opaque, hwaddr addr, unsigned size)
 {
+    AHCIState *s = opaque;
     hwaddr aligned = addr & ~0x3;
     int ofst = addr - aligned;
-    uint64_t lo = ahci_mem_read_32(opaque, aligned);
+    uint64_t lo;
     uint64_t hi;
     uint64_t val;
 
+    ahci_lock(s);
+    lo = ahci_mem_read_32(opaque, aligned);
+
     /* if < 8 byte read does not cross 4 byte boundary */
     if (ofst + size <= 4) {
         val = lo >> (ofst * 8);
@@ -450,6 +531,7 @@ static uint64_t ahci_mem_read(void *opaque, hwaddr addr, unsigned size)
         hi = ahci_mem_read_32(opaque, aligned + 4);
         val = (hi << 32 | lo) >> (ofst * 8);
     }
+    ahci_unlock(s);
 
     trace_ahci_mem_read(opaque, size, addr, val);
     return val;
@@ -471,6 +553,7 @@ static void ahci_mem_write(void *opaque, hwaddr addr,
         return;
     }
 
+    ahci_lock(s);
     if (addr < AHCI_GENERIC_HOST_CONTROL_REGS_MAX_ADDR) {
         enum AHCIHostReg regnum = addr / 4;
         assert(regnum < AHCI_HOST_REG__COUNT);
@@ -519,6 +602,7 @@ static void ahci_mem_write(void *opaque, hwaddr addr,
                       addr, val);
         trace_ahci_mem_write_unimpl(s, size, addr, val);
     }
+    ahci_unlock(s);
 }
 
 static const MemoryRegionOps ahci_mem_ops = {
@@ -607,6 +691,15 @@ static void ahci_check_cmd_bh(void *opaque)
     check_cmd(ad->hba, ad->port_no);
 }
 
+static void ahci_doorbell_bh(void *opaque)
+{
+    AHCIDevice *ad = opaque;
+
+    ahci_lock(ad->hba);
+    check_cmd(ad->hba, ad->port_no);
+    ahci_unlock(ad->hba);
+}
+
 static void ahci_init_d2h(AHCIDevice *ad)
 {
     IDEState *ide_state = &ad->port.ifs[0];
@@ -1503,7 +1596,9 @@ static void ahci_cmd_done(const IDEDMA *dma)
     /* update d2h status */
     ahci_write_fis_d2h(ad);
 
-    if (ad->port_regs.cmd_issue && !ad->check_bh) {
+    if (ad->port_regs.cmd_issue && ad->doorbell_bh) {
+        qemu_bh_schedule(ad->doorbell_bh);
+    } else if (ad->port_regs.cmd_issue && !ad->check_bh) {
         ad->check_bh = qemu_bh_new(ahci_check_cmd_bh, ad);
         qemu_bh_schedule(ad->check_bh);
     }
@@ -1543,6 +1638,10 @@ void ahci_realize(AHCIState *s, DeviceState *qdev, AddressSpace *as, int ports)
     s->as = as;
     s->ports = ports;
     s->dev = g_new0(AHCIDevice, ports);
+    if (s->iothread) {
+        s->ctx = iothread_get_aio_context(s->iothread);
+        s->irq_bh = qemu_bh_new(ahci_irq_bh, s);
+    }
     ahci_reg_init(s);
     irqs = qemu_allocate_irqs(ahci_irq_set, s, s->ports);
     for (i = 0; i < s->ports; i++) {
@@ -1555,6 +1654,9 @@ void ahci_realize(AHCIState *s, DeviceState *qdev, AddressSpace *as, int ports)
         ad->port_no = i;
         ad->port.dma = &ad->dma;
         ad->port.dma->ops = &ahci_dma_ops;
+        if (s->ctx) {
+            ad->doorbell_bh = aio_bh_new(s->ctx, ahci_doorbell_bh, ad);
+        }
         ide_register_restart_cb(&ad->port);
     }
     g_free(irqs);
@@ -1567,6 +1669,17 @@ void ahci_uninit(AHCIState *s)
     for (i = 0; i < s->ports; i++) {
         AHCIDevice *ad = &s->dev[i];
 
+        if (ad->doorbell_bh) {
+            BlockBackend *blk = ad->port.ifs[0].blk;
+
+            qemu_bh_delete(ad->doorbell_bh);
+            if (blk) {
+                aio_context_acquire(s->ctx);
+                blk_set_aio_context(blk, qemu_get_aio_context(), NULL);
+                aio_context_release(s->ctx);
+            }
+        }
+
         for (j = 0; j < 2; j++) {
             IDEState *s = &ad->port.ifs[j];
 
@@ -1575,6 +1688,9 @@ void ahci_uninit(AHCIState *s)
         object_unparent(OBJECT(&ad->port));
     }
 
+    if (s->irq_bh) {
+        qemu_bh_delete(s->irq_bh);
+    }
     g_free(s->dev);
 }
 
@@ -1585,6 +1701,7 @@ void ahci_reset(AHCIState *s)
 
     trace_ahci_reset(s);
 
+    ahci_lock(s);
     s->control_regs.irqstatus = 0;
     /* AHCI Enable (AE)
      * The implementation of this bit is dependent upon the value of the
@@ -1604,6 +1721,7 @@ void ahci_reset(AHCIState *s)
         pr->cmd = PORT_CMD_SPIN_UP | PORT_CMD_POWER_ON;
         ahci_reset_port(s, i);
     }
+    ahci_unlock(s);
 }
 
 static const VMStateDescription vmstate_ncq_tfs = {
@@ -1723,7 +1841,7 @@ static int ahci_state_post_load(void *opaque, int version_id)
          * and we should check to see if there are additional commands waiting.
          */
         if (ad->busy_slot == -1) {
-            check_cmd(s, i);
+            ahci_kick_port(s, i);
         } else {
             /* We are in the middle of a command, and may need to access
              * the command header in guest memory again. */
@@ -315,6 +315,7 @@ struct AHCIDevice {
     AHCIPortRegs port_regs;
     struct AHCIState *hba;
     QEMUBH *check_bh;
+    QEMUBH *doorbell_bh;    /* runs check_cmd() in the IOThread */
     uint8_t *lst;
     uint8_t *res_fis;
     bool done_first_drq;
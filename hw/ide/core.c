@@ -506,7 +506,7 @@ BlockAIOCB *ide_issue_trim(
 
     iocb = blk_aio_get(&trim_aiocb_info, s->blk, cb, cb_opaque);
     iocb->s = s;
-    iocb->bh = qemu_bh_new(ide_trim_bh_cb, iocb);
+    iocb->bh = aio_bh_new(blk_get_aio_context(s->blk), ide_trim_bh_cb, iocb);
     iocb->ret = 0;
     iocb->qiov = qiov;
     iocb->i = -1;
@@ -2627,16 +2627,12 @@ static void ide_restart_dma(IDEState *s, enum ide_dma_cmd dma_cmd)
     ide_start_dma(s, ide_dma_cb);
 }
 
-static void ide_restart_bh(void *opaque)
+static void ide_do_restart(IDEBus *bus)
 {
-    IDEBus *bus = opaque;
     IDEState *s;
     bool is_read;
     int error_status;
 
-    qemu_bh_delete(bus->bh);
-    bus->bh = NULL;
-
     error_status = bus->error_status;
     if (bus->error_status == 0) {
         return;
@@ -2677,6 +2673,21 @@ static void ide_restart_bh(void *opaque)
     }
 }
 
+static void ide_restart_bh(void *opaque)
+{
+    IDEBus *bus = opaque;
+    BlockBackend *blk = idebus_active_if(bus)->blk;
+    AioContext *ctx = blk ? blk_get_aio_context(blk) : qemu_get_aio_context();
+
+    qemu_bh_delete(bus->bh);
+    bus->bh = NULL;
+
+    /* The HBA may process the drive's requests in an IOThread */
+    aio_context_acquire(ctx);
+    ide_do_restart(bus);
+    aio_context_release(ctx);
+}
+
 static void ide_restart_cb(void *opaque, bool running, RunState state)
 {
     IDEBus *bus = opaque;
@@ -214,6 +214,14 @@ e1000e_nc_receive_iov(NetClientState *nc, const struct iovec *iov, int iovcnt)
     return e1000e_receive_iov(&s->core, iov, iovcnt);
 }
 
+static int
+e1000e_nc_receive_batch(NetClientState *nc, const struct iovec *iov,
+                        const int *iovcnt, int count)
+{
+    E1000EState *s = qemu_get_nic_opaque(nc);
+    return e1000e_receive_batch(&s->core, iov, iovcnt, count);
+}
+
 static ssize_t
 e1000e_nc_receive(NetClientState *nc, const uint8_t *buf, size_t size)
 {
@@ -234,6 +242,7 @@ static NetClientInfo net_e1000e_info = {
     .can_receive = e1000e_nc_can_receive,
     .receive = e1000e_nc_receive,
     .receive_iov = e1000e_nc_receive_iov,
+    .receive_iov_batch = e1000e_nc_receive_batch,
     .link_status_changed = e1000e_set_link_status,
 };
 
@@ -52,6 +52,7 @@
 #define E1000E_MIN_XITR     (500) /* No more then 7813 interrupts per
                                      second according to spec 10.2.4.2 */
 #define E1000E_MAX_TX_FRAGS (64)
+#define E1000E_RX_DESC_BATCH (32) /* descriptors per DMA on the rx path */
 
 static inline void
 e1000e_set_interrupt_cause(E1000ECore *core, uint32_t val);
@@ -1484,14 +1485,36 @@ e1000e_do_ps(E1000ECore *core, struct NetRxPkt *pkt, size_t *hdr_len)
     return true;
 }
 
+/*
+ * Number of descriptors that can be fetched from the head of the ring
+ * with a single DMA read, and written back with a single DMA write.
+ */
+static uint32_t
+e1000e_rx_descr_run(E1000ECore *core, const E1000E_RingInfo *rxi,
+                    size_t remaining)
+{
+    uint32_t unit = core->rx_desc_len / E1000_MIN_RX_DESC_LEN;
+    uint32_t to_end = core->mac[rxi->dlen] / E1000_RING_DESC_LEN -
+                      core->mac[rxi->dh];
+    uint32_t run = DIV_ROUND_UP(remaining, core->rx_desc_buf_size);
+
+    run = MIN(run, E1000E_RX_DESC_BATCH);
+    run = MIN(run, e1000e_ring_free_descr_num(core, rxi) / unit);
+    run = MIN(run, to_end / unit);
+
+    return MAX(run, 1);
+}
+
 static void
 e1000e_write_packet_to_guest(E1000ECore *core, struct NetRxPkt *pkt,
                              const E1000E_RxRing *rxr,
                              const E1000E_RSSInfo *rss_info)
 {
     PCIDevice *d = core->owner;
-    dma_addr_t base;
-    uint8_t desc[E1000_MAX_RX_DESC_LEN];
+    dma_addr_t base = 0;
+    uint8_t descs[E1000E_RX_DESC_BATCH][E1000_MAX_RX_DESC_LEN];
+    uint32_t run = 0, cur = 0;
+    uint8_t *desc;
     size_t desc_size;
     size_t desc_offset = 0;
     size_t iov_ofs = 0;
@@ -1517,15 +1540,23 @@ e1000e_write_packet_to_guest(E1000ECore *core, struct NetRxPkt *pkt,
             desc_size = core->rx_desc_buf_size;
         }
 
-        if (e1000e_ring_empty(core, rxi)) {
-            return;
-        }
+        if (!run) {
+            if (e1000e_ring_empty(core, rxi)) {
+                return;
+            }
+
+            /* Fetch as many of the descriptors this packet needs as we can */
+            base = e1000e_ring_head_descr(core, rxi);
+            run = e1000e_rx_descr_run(core, rxi, total_size - desc_offset);
+            cur = 0;
 
-        base = e1000e_ring_head_descr(core, rxi);
+            pci_dma_read(d, base, descs, run * core->rx_desc_len);
+        }
 
-        pci_dma_read(d, base, &desc, core->rx_desc_len);
+        desc = descs[cur];
 
-        trace_e1000e_rx_descr(rxi->idx, base, core->rx_desc_len);
+        trace_e1000e_rx_descr(rxi->idx, base + cur * core->rx_desc_len,
+                              core->rx_desc_len);
 
         e1000e_read_rx_descr(core, desc, &ba);
 
@@ -1599,10 +1630,14 @@ e1000e_write_packet_to_guest(E1000ECore *core, struct NetRxPkt *pkt,
 
         e1000e_write_rx_descr(core, desc, is_last ? core->rx_pkt : NULL,
                            rss_info, do_ps ? ps_hdr_len : 0, &bastate.written);
-        pci_dma_write(d, base, &desc, core->rx_desc_len);
 
-        e1000e_ring_advance(core, rxi,
-                            core->rx_desc_len / E1000_MIN_RX_DESC_LEN);
+        /* Write back the whole run once the packet data is in place */
+        if (++cur == run || is_last) {
+            pci_dma_write(d, base, descs, cur * core->rx_desc_len);
+            e1000e_ring_advance(core, rxi, cur * core->rx_desc_len /
+                                           E1000_MIN_RX_DESC_LEN);
+            run = 0;
+        }
 
     } while (desc_offset < total_size);
 
@@ -1621,8 +1656,29 @@ e1000e_rx_fix_l4_csum(E1000ECore *core, struct NetRxPkt *pkt)
     }
 }
 
-ssize_t
-e1000e_receive_iov(E1000ECore *core, const struct iovec *iov, int iovcnt)
+/*
+ * Interrupt causes collected over a batch of received packets, so that
+ * the interrupt logic and its moderation timers run once per batch.
+ */
+typedef struct E1000E_RxBatch {
+    uint32_t causes;
+    bool pending;
+} E1000E_RxBatch;
+
+static void
+e1000e_rx_raise_causes(E1000ECore *core, uint32_t n)
+{
+    if (!e1000e_intrmgr_delay_rx_causes(core, &n)) {
+        trace_e1000e_rx_interrupt_set(n);
+        e1000e_set_interrupt_cause(core, n);
+    } else {
+        trace_e1000e_rx_interrupt_delayed(n);
+    }
+}
+
+static ssize_t
+e1000e_receive_internal(E1000ECore *core, const struct iovec *iov, int iovcnt,
+                        E1000E_RxBatch *batch)
 {
     static const int maximum_ethernet_hdr_len = (14 + 4);
     /* Min. octets in an ethernet frame sans FCS */
@@ -1719,6 +1775,9 @@ e1000e_receive_iov(E1000ECore *core, const struct iovec *iov, int iovcnt)
         n |= e1000e_rx_wb_interrupt_cause(core, rxr.i->idx, rdmts_hit);
 
         trace_e1000e_rx_written_to_guest(n);
+    } else if (batch) {
+        /* Left to the single packet path, which reports the overrun */
+        return 0;
     } else {
         n |= E1000_ICS_RXO;
         retval = 0;
@@ -1726,16 +1785,43 @@ e1000e_receive_iov(E1000ECore *core, const struct iovec *iov, int iovcnt)
         trace_e1000e_rx_not_written_to_guest(n);
     }
 
-    if (!e1000e_intrmgr_delay_rx_causes(core, &n)) {
-        trace_e1000e_rx_interrupt_set(n);
-        e1000e_set_interrupt_cause(core, n);
+    if (batch) {
+        batch->causes |= n;
+        batch->pending = true;
     } else {
-        trace_e1000e_rx_interrupt_delayed(n);
+        e1000e_rx_raise_causes(core, n);
     }
 
     return retval;
 }
 
+ssize_t
+e1000e_receive_iov(E1000ECore *core, const struct iovec *iov, int iovcnt)
+{
+    return e1000e_receive_internal(core, iov, iovcnt, NULL);
+}
+
+int
+e1000e_receive_batch(E1000ECore *core, const struct iovec *iov,
+                     const int *iovcnt, int count)
+{
+    E1000E_RxBatch batch = { 0 };
+    int i;
+
+    for (i = 0; i < count; i++) {
+        if (e1000e_receive_internal(core, iov, iovcnt[i], &batch) == 0) {
+            break;
+        }
+        iov += iovcnt[i];
+    }
+
+    if (batch.pending) {
+        e1000e_rx_raise_causes(core, batch.causes);
+    }
+
+    return i;
+}
+
 static inline bool
 e1000e_have_autoneg(E1000ECore *core)
 {
@@ -152,6 +152,10 @@ e1000e_receive(E1000ECore *core, const uint8_t *buf, size_t size);
 ssize_t
 e1000e_receive_iov(E1000ECore *core, const struct iovec *iov, int iovcnt);
 
+int
+e1000e_receive_batch(E1000ECore *core, const struct iovec *iov,
+                     const int *iovcnt, int count);
+
 void
 e1000e_start_recv(E1000ECore *core);
 
@@ -511,14 +511,15 @@ enum {
 #define NET_MAX_FRAG_SG_LIST (64)
 
 static size_t net_tx_pkt_fetch_fragment(struct NetTxPkt *pkt,
-    int *src_idx, size_t *src_offset, struct iovec *dst, int *dst_idx)
+    int *src_idx, size_t *src_offset, size_t max_len,
+    struct iovec *dst, int dst_start, int *dst_idx)
 {
     size_t fetched = 0;
     struct iovec *src = pkt->vec;
 
-    *dst_idx = NET_TX_PKT_FRAGMENT_HEADER_NUM;
+    *dst_idx = dst_start;
 
-    while (fetched < IP_FRAG_ALIGN_SIZE(pkt->virt_hdr.gso_size)) {
+    while (fetched < max_len) {
 
         /* no more place in fragment iov */
         if (*dst_idx == NET_MAX_FRAG_SG_LIST) {
@@ -533,7 +534,7 @@ static size_t net_tx_pkt_fetch_fragment(struct NetTxPkt *pkt,
 
         dst[*dst_idx].iov_base = src[*src_idx].iov_base + *src_offset;
         dst[*dst_idx].iov_len = MIN(src[*src_idx].iov_len - *src_offset,
-            IP_FRAG_ALIGN_SIZE(pkt->virt_hdr.gso_size) - fetched);
+            max_len - fetched);
 
         *src_offset += dst[*dst_idx].iov_len;
         fetched += dst[*dst_idx].iov_len;
@@ -588,7 +589,8 @@ static bool net_tx_pkt_do_sw_fragmentation(struct NetTxPkt *pkt,
     /* Put as much data as possible and send */
     do {
         fragment_len = net_tx_pkt_fetch_fragment(pkt, &src_idx, &src_offset,
-            fragment, &dst_idx);
+            IP_FRAG_ALIGN_SIZE(pkt->virt_hdr.gso_size),
+            fragment, NET_TX_PKT_FRAGMENT_HEADER_NUM, &dst_idx);
 
         more_frags = (fragment_offset + fragment_len < pkt->payload_len);
 
@@ -606,12 +608,127 @@ static bool net_tx_pkt_do_sw_fragmentation(struct NetTxPkt *pkt,
     return true;
 }
 
+/*
+ * Software TSO for peers that take no virtio-net header: cut the payload
+ * into gso_size TCP segments.  The L2/L3 headers and a private copy of the
+ * TCP header are fixed up in place for each segment and sent in front of
+ * iovecs pointing straight into the guest buffers, so the payload is only
+ * touched once, by the checksum.
+ */
+static bool net_tx_pkt_do_sw_segmentation(struct NetTxPkt *pkt,
+    NetClientState *nc)
+{
+    struct iovec segment[NET_MAX_FRAG_SG_LIST];
+    uint8_t l4_hdr[ETH_MAX_TCP_HDR_LEN];
+    struct tcp_hdr *tcp = (struct tcp_hdr *)l4_hdr;
+    uint16_t l3_proto = eth_get_l3_proto(&pkt->vec[NET_TX_PKT_L2HDR_FRAG], 1,
+        pkt->vec[NET_TX_PKT_L2HDR_FRAG].iov_len);
+    void *l3_iov_base = pkt->vec[NET_TX_PKT_L3HDR_FRAG].iov_base;
+    size_t l3_iov_len = pkt->vec[NET_TX_PKT_L3HDR_FRAG].iov_len;
+    size_t l4_len;
+    size_t data_len, segment_len, data_offset = 0;
+    int src_idx = NET_TX_PKT_PL_START_FRAG, dst_idx;
+    size_t src_offset = 0;
+    uint32_t seq;
+    uint16_t ip_id = 0;
+    uint8_t flags;
+
+    if (!pkt->virt_hdr.gso_size ||
+        iov_to_buf(&pkt->vec[NET_TX_PKT_PL_START_FRAG], pkt->payload_frags,
+                   0, l4_hdr, sizeof(*tcp)) != sizeof(*tcp)) {
+        return false;
+    }
+
+    l4_len = tcp->th_off * sizeof(uint32_t);
+    if (l4_len < sizeof(*tcp) ||
+        iov_to_buf(&pkt->vec[NET_TX_PKT_PL_START_FRAG], pkt->payload_frags,
+                   0, l4_hdr, l4_len) != l4_len) {
+        return false;
+    }
+
+    /* skip the TCP header, it is sent from l4_hdr */
+    net_tx_pkt_fetch_fragment(pkt, &src_idx, &src_offset, l4_len,
+                              segment, 0, &dst_idx);
+
+    if (l3_proto == ETH_P_IP) {
+        ip_id = be16_to_cpu(((struct ip_header *)l3_iov_base)->ip_id);
+    }
+
+    seq = be32_to_cpu(tcp->th_seq);
+    flags = tcp->th_flags;
+    data_len = pkt->payload_len - l4_len;
+
+    segment[NET_TX_PKT_FRAGMENT_L2_HDR_POS] =
+        pkt->vec[NET_TX_PKT_L2HDR_FRAG];
+    segment[NET_TX_PKT_FRAGMENT_L3_HDR_POS] =
+        pkt->vec[NET_TX_PKT_L3HDR_FRAG];
+    segment[NET_TX_PKT_FRAGMENT_HEADER_NUM].iov_base = l4_hdr;
+    segment[NET_TX_PKT_FRAGMENT_HEADER_NUM].iov_len = l4_len;
+
+    do {
+        uint32_t csum_cntr, cso;
+        uint16_t csum;
+
+        segment_len = net_tx_pkt_fetch_fragment(pkt, &src_idx, &src_offset,
+            pkt->virt_hdr.gso_size, segment,
+            NET_TX_PKT_FRAGMENT_HEADER_NUM + 1, &dst_idx);
+
+        if (l3_proto == ETH_P_IP) {
+            struct ip_header *ip = l3_iov_base;
+
+            ip->ip_len = cpu_to_be16(l3_iov_len + l4_len + segment_len);
+            ip->ip_id = cpu_to_be16(ip_id++);
+            eth_fix_ip4_checksum(l3_iov_base, l3_iov_len);
+            csum_cntr = eth_calc_ip4_pseudo_hdr_csum(ip, l4_len + segment_len,
+                                                     &cso);
+        } else {
+            struct ip6_header *ip6 = l3_iov_base;
+
+            ip6->ip6_plen = cpu_to_be16(l3_iov_len - sizeof(*ip6) +
+                                        l4_len + segment_len);
+            csum_cntr = eth_calc_ip6_pseudo_hdr_csum(ip6,
+                                                     l4_len + segment_len,
+                                                     IP_PROTO_TCP, &cso);
+        }
+
+        /* FIN and PSH belong to the last segment, CWR to the first one */
+        tcp->th_seq = cpu_to_be32(seq);
+        tcp->th_flags = flags;
+        if (data_offset) {
+            tcp->th_flags &= ~TH_CWR;
+        }
+        if (data_offset + segment_len < data_len) {
+            tcp->th_flags &= ~(TH_FIN | TH_PUSH);
+        }
+        tcp->th_sum = 0;
+
+        csum_cntr += net_checksum_add_iov(
+            &segment[NET_TX_PKT_FRAGMENT_HEADER_NUM],
+            dst_idx - NET_TX_PKT_FRAGMENT_HEADER_NUM,
+            0, l4_len + segment_len, cso);
+        csum = cpu_to_be16(net_checksum_finish_nozero(csum_cntr));
+        tcp->th_sum = csum;
+
+        net_tx_pkt_sendv(pkt, nc, segment, dst_idx);
+
+        seq += segment_len;
+        data_offset += segment_len;
+    } while (segment_len && data_offset < data_len);
+
+    return true;
+}
+
 bool net_tx_pkt_send(struct NetTxPkt *pkt, NetClientState *nc)
 {
+    uint8_t gso_type = pkt->virt_hdr.gso_type & ~VIRTIO_NET_HDR_GSO_ECN;
+
     assert(pkt);
 
+    /* TCP segments are checksummed one by one while they are cut */
     if (!pkt->has_virt_hdr &&
-        pkt->virt_hdr.flags & VIRTIO_NET_HDR_F_NEEDS_CSUM) {
+        pkt->virt_hdr.flags & VIRTIO_NET_HDR_F_NEEDS_CSUM &&
+        gso_type != VIRTIO_NET_HDR_GSO_TCPV4 &&
+        gso_type != VIRTIO_NET_HDR_GSO_TCPV6) {
         net_tx_pkt_do_sw_csum(pkt);
     }
 
@@ -635,6 +752,11 @@ bool net_tx_pkt_send(struct NetTxPkt *pkt, NetClientState *nc)
         return true;
     }
 
+    if (gso_type == VIRTIO_NET_HDR_GSO_TCPV4 ||
+        gso_type == VIRTIO_NET_HDR_GSO_TCPV6) {
+        return net_tx_pkt_do_sw_segmentation(pkt, nc);
+    }
+
     return net_tx_pkt_do_sw_fragmentation(pkt, nc);
 }
 
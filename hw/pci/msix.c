@@ -20,6 +20,7 @@
 #include "hw/pci/pci.h"
 #include "hw/xen/xen.h"
 #include "sysemu/xen.h"
+#include "sysemu/kvm.h"
 #include "migration/qemu-file-types.h"
 #include "migration/vmstate.h"
 #include "qemu/range.h"
@@ -168,10 +169,12 @@ void msix_write_config(PCIDevice *dev, uint32_t addr,
         return;
     }
 
+    kvm_irqchip_begin_route_changes(kvm_state);
     for (vector = 0; vector < dev->msix_entries_nr; ++vector) {
         msix_handle_mask_update(dev, vector,
                                 msix_vector_masked(dev, vector, was_masked));
     }
+    kvm_irqchip_end_route_changes(kvm_state);
 }
 
 static uint64_t msix_table_mmio_read(void *opaque, hwaddr addr,
@@ -245,6 +248,7 @@ static void msix_mask_all(struct PCIDevice *dev, unsigned nentries)
 {
     int vector;
 
+    kvm_irqchip_begin_route_changes(kvm_state);
     for (vector = 0; vector < nentries; ++vector) {
         unsigned offset =
             vector * PCI_MSIX_ENTRY_SIZE + PCI_MSIX_ENTRY_VECTOR_CTRL;
@@ -253,6 +257,7 @@ static void msix_mask_all(struct PCIDevice *dev, unsigned nentries)
         dev->msix_table[offset] |= PCI_MSIX_ENTRY_CTRL_MASKBIT;
         msix_handle_mask_update(dev, vector, was_masked);
     }
+    kvm_irqchip_end_route_changes(kvm_state);
 }
 
 /*
@@ -465,9 +470,11 @@ void msix_load(PCIDevice *dev, QEMUFile *f)
     qemu_get_buffer(f, dev->msix_pba, DIV_ROUND_UP(n, 8));
     msix_update_function_masked(dev);
 
+    kvm_irqchip_begin_route_changes(kvm_state);
     for (vector = 0; vector < n; vector++) {
         msix_handle_mask_update(dev, vector, true);
     }
+    kvm_irqchip_end_route_changes(kvm_state);
 }
 
 /* Does device support MSI-X? */
@@ -594,12 +601,15 @@ int msix_set_vector_notifiers(PCIDevice *dev,
 
     if ((dev->config[dev->msix_cap + MSIX_CONTROL_OFFSET] &
         (MSIX_ENABLE_MASK | MSIX_MASKALL_MASK)) == MSIX_ENABLE_MASK) {
+        kvm_irqchip_begin_route_changes(kvm_state);
         for (vector = 0; vector < dev->msix_entries_nr; vector++) {
             ret = msix_set_notifier_for_vector(dev, vector);
             if (ret < 0) {
+                kvm_irqchip_end_route_changes(kvm_state);
                 goto undo;
             }
         }
+        kvm_irqchip_end_route_changes(kvm_state);
     }
     if (dev->msix_vector_poll_notifier) {
         dev->msix_vector_poll_notifier(dev, 0, dev->msix_entries_nr);
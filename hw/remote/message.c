@@ -20,15 +20,33 @@
 #include "hw/remote/memory.h"
 #include "hw/remote/iohub.h"
 #include "sysemu/reset.h"
+#include "qemu/main-loop.h"
+#include "qemu/timer.h"
+
+typedef struct RemoteIoeventfd {
+    bool memory;
+    hwaddr addr;
+    unsigned size;
+    bool match_data;
+    uint64_t data;
+    EventNotifier *e;
+    QLIST_ENTRY(RemoteIoeventfd) next;
+} RemoteIoeventfd;
 
 static void process_config_write(QIOChannel *ioc, PCIDevice *dev,
                                  MPQemuMsg *msg, Error **errp);
 static void process_config_read(QIOChannel *ioc, PCIDevice *dev,
                                 MPQemuMsg *msg, Error **errp);
-static void process_bar_write(QIOChannel *ioc, MPQemuMsg *msg, Error **errp);
-static void process_bar_read(QIOChannel *ioc, MPQemuMsg *msg, Error **errp);
+static void process_bar_access(QIOChannel *ioc, MPQemuMsg *msg, bool write,
+                               Error **errp);
 static void process_device_reset_msg(QIOChannel *ioc, PCIDevice *dev,
                                      Error **errp);
+static void process_set_shm_channel(RemoteCommDev *com, MPQemuMsg *msg,
+                                    Error **errp);
+static void process_get_ioeventfds(RemoteCommDev *com, Error **errp);
+static void remote_ioeventfd_init(RemoteCommDev *com);
+static void remote_ioeventfd_cleanup(RemoteCommDev *com);
+static void remote_shm_channel_cleanup(RemoteCommDev *com);
 
 void coroutine_fn mpqemu_remote_msg_loop_co(void *data)
 {
@@ -38,6 +56,8 @@ void coroutine_fn mpqemu_remote_msg_loop_co(void *data)
 
     assert(com->ioc);
 
+    remote_ioeventfd_init(com);
+
     pci_dev = com->dev;
     for (; !local_err;) {
         MPQemuMsg msg = {0};
@@ -61,10 +81,10 @@ void coroutine_fn mpqemu_remote_msg_loop_co(void *data)
             process_config_read(com->ioc, pci_dev, &msg, &local_err);
             break;
         case MPQEMU_CMD_BAR_WRITE:
-            process_bar_write(com->ioc, &msg, &local_err);
+            process_bar_access(com->ioc, &msg, true, &local_err);
             break;
         case MPQEMU_CMD_BAR_READ:
-            process_bar_read(com->ioc, &msg, &local_err);
+            process_bar_access(com->ioc, &msg, false, &local_err);
             break;
         case MPQEMU_CMD_SYNC_SYSMEM:
             remote_sysmem_reconfig(&msg, &local_err);
@@ -75,6 +95,12 @@ void coroutine_fn mpqemu_remote_msg_loop_co(void *data)
         case MPQEMU_CMD_DEVICE_RESET:
             process_device_reset_msg(com->ioc, pci_dev, &local_err);
             break;
+        case MPQEMU_CMD_SET_SHM_CHANNEL:
+            process_set_shm_channel(com, &msg, &local_err);
+            break;
+        case MPQEMU_CMD_GET_IOEVENTFDS:
+            process_get_ioeventfds(com, &local_err);
+            break;
         default:
             error_setg(&local_err,
                        "Unknown command (%d) received for device %s"
@@ -83,6 +109,9 @@ void coroutine_fn mpqemu_remote_msg_loop_co(void *data)
         }
     }
 
+    remote_shm_channel_cleanup(com);
+    remote_ioeventfd_cleanup(com);
+
     if (local_err) {
         error_report_err(local_err);
         qemu_system_shutdown_request(SHUTDOWN_CAUSE_HOST_ERROR);
@@ -139,35 +168,43 @@ static void process_config_read(QIOChannel *ioc, PCIDevice *dev,
     }
 }
 
-static void process_bar_write(QIOChannel *ioc, MPQemuMsg *msg, Error **errp)
+/* Perform a BAR access, returning the value read or UINT64_MAX on error */
+static uint64_t bar_access(BarAccessMsg *bar_access, bool write, Error **errp)
 {
-    ERRP_GUARD();
-    BarAccessMsg *bar_access = &msg->data.bar_access;
     AddressSpace *as =
         bar_access->memory ? &address_space_memory : &address_space_io;
-    MPQemuMsg ret = { 0 };
     MemTxResult res;
-    uint64_t val;
+    uint64_t val = 0;
 
     if (!is_power_of_2(bar_access->size) ||
        (bar_access->size > sizeof(uint64_t))) {
-        ret.data.u64 = UINT64_MAX;
-        goto fail;
+        return UINT64_MAX;
     }
 
-    val = cpu_to_le64(bar_access->val);
+    if (write) {
+        val = cpu_to_le64(bar_access->val);
+    }
 
     res = address_space_rw(as, bar_access->addr, MEMTXATTRS_UNSPECIFIED,
-                           (void *)&val, bar_access->size, true);
+                           (void *)&val, bar_access->size, write);
 
     if (res != MEMTX_OK) {
-        error_setg(errp, "Bad address %"PRIx64" for mem write, pid "FMT_pid".",
-                   bar_access->addr, getpid());
-        ret.data.u64 = -1;
+        error_setg(errp, "Bad address %"PRIx64" for mem %s, pid "FMT_pid".",
+                   bar_access->addr, write ? "write" : "read", getpid());
+        return UINT64_MAX;
     }
 
-fail:
+    return write ? 0 : le64_to_cpu(val);
+}
+
+static void process_bar_access(QIOChannel *ioc, MPQemuMsg *msg, bool write,
+                               Error **errp)
+{
+    ERRP_GUARD();
+    MPQemuMsg ret = { 0 };
+
     ret.cmd = MPQEMU_CMD_RET;
+    ret.data.u64 = bar_access(&msg->data.bar_access, write, errp);
     ret.size = sizeof(ret.data.u64);
 
     if (!mpqemu_msg_send(&ret, ioc, NULL)) {
@@ -176,55 +213,302 @@ fail:
     }
 }
 
-static void process_bar_read(QIOChannel *ioc, MPQemuMsg *msg, Error **errp)
+static void process_device_reset_msg(QIOChannel *ioc, PCIDevice *dev,
+                                     Error **errp)
 {
-    ERRP_GUARD();
-    BarAccessMsg *bar_access = &msg->data.bar_access;
+    DeviceClass *dc = DEVICE_GET_CLASS(dev);
+    DeviceState *s = DEVICE(dev);
     MPQemuMsg ret = { 0 };
-    AddressSpace *as;
-    MemTxResult res;
-    uint64_t val = 0;
 
-    as = bar_access->memory ? &address_space_memory : &address_space_io;
+    if (dc->reset) {
+        dc->reset(s);
+    }
 
-    if (!is_power_of_2(bar_access->size) ||
-       (bar_access->size > sizeof(uint64_t))) {
-        val = UINT64_MAX;
-        goto fail;
+    ret.cmd = MPQEMU_CMD_RET;
+
+    mpqemu_msg_send(&ret, ioc, errp);
+}
+
+/*
+ * Serve the shared memory channel.  Keep polling for the next request for
+ * shm_poll_ns after each one, then go idle and wait for a kick.
+ */
+static void remote_shm_kick(void *opaque)
+{
+    RemoteCommDev *com = opaque;
+    MPQemuShmChannel *shm = com->shm;
+    Error *local_err = NULL;
+    int64_t deadline;
+
+    event_notifier_test_and_clear(&com->shm_kick);
+    qatomic_set(&shm->remote_idle, 0);
+    deadline = get_clock() + com->shm_poll_ns;
+
+    for (;;) {
+        uint32_t seq = qatomic_load_acquire(&shm->req_seq);
+        BarAccessMsg req;
+        uint32_t cmd;
+
+        if (seq != com->shm_seq) {
+            /* copy the request, the proxy could change it under our feet */
+            cmd = qatomic_read(&shm->req_cmd);
+            req = shm->req;
+            if (cmd == MPQEMU_CMD_BAR_WRITE || cmd == MPQEMU_CMD_BAR_READ) {
+                shm->ret = bar_access(&req, cmd == MPQEMU_CMD_BAR_WRITE,
+                                      &local_err);
+            } else {
+                shm->ret = UINT64_MAX;
+            }
+            com->shm_seq = seq;
+            qatomic_store_release(&shm->ret_seq, seq);
+
+            /* pairs with smp_mb() in proxy_shm_access() */
+            smp_mb();
+            if (qatomic_read(&shm->proxy_waiting)) {
+                event_notifier_set(&com->shm_done);
+            }
+
+            if (local_err) {
+                error_report_err(local_err);
+                qemu_system_shutdown_request(SHUTDOWN_CAUSE_HOST_ERROR);
+                local_err = NULL;
+            }
+            deadline = get_clock() + com->shm_poll_ns;
+        } else if (get_clock() < deadline) {
+            cpu_relax();
+        } else {
+            qatomic_set(&shm->remote_idle, 1);
+            smp_mb();
+            if (qatomic_read(&shm->req_seq) == com->shm_seq) {
+                break;
+            }
+            qatomic_set(&shm->remote_idle, 0);
+        }
     }
+}
 
-    res = address_space_rw(as, bar_access->addr, MEMTXATTRS_UNSPECIFIED,
-                           (void *)&val, bar_access->size, false);
+static void remote_shm_channel_cleanup(RemoteCommDev *com)
+{
+    if (!com->shm) {
+        return;
+    }
 
-    if (res != MEMTX_OK) {
-        error_setg(errp, "Bad address %"PRIx64" for mem read, pid "FMT_pid".",
-                   bar_access->addr, getpid());
-        val = UINT64_MAX;
+    qemu_set_fd_handler(event_notifier_get_fd(&com->shm_kick),
+                        NULL, NULL, NULL);
+    event_notifier_cleanup(&com->shm_kick);
+    event_notifier_cleanup(&com->shm_done);
+    munmap(com->shm, sizeof(MPQemuShmChannel));
+    com->shm = NULL;
+}
+
+static void process_set_shm_channel(RemoteCommDev *com, MPQemuMsg *msg,
+                                    Error **errp)
+{
+    ERRP_GUARD();
+    MPQemuShmChannel *shm;
+    MPQemuMsg ret = { 0 };
+
+    remote_shm_channel_cleanup(com);
+
+    shm = mmap(NULL, sizeof(MPQemuShmChannel), PROT_READ | PROT_WRITE,
+               MAP_SHARED, msg->fds[0], 0);
+    close(msg->fds[0]);
+
+    if (shm == MAP_FAILED) {
+        /* the proxy goes on using the socket */
+        close(msg->fds[1]);
+        close(msg->fds[2]);
+        ret.data.u64 = UINT64_MAX;
+    } else {
+        com->shm = shm;
+        com->shm_seq = qatomic_read(&shm->req_seq);
+        com->shm_poll_ns = msg->data.shm_channel.poll_ns;
+        event_notifier_init_fd(&com->shm_kick, msg->fds[1]);
+        event_notifier_init_fd(&com->shm_done, msg->fds[2]);
+        qatomic_set(&shm->ioeventfd_gen, com->ioeventfd_gen);
+        qatomic_set(&shm->remote_idle, 1);
+        qemu_set_fd_handler(msg->fds[1], remote_shm_kick, NULL, com);
     }
 
-fail:
     ret.cmd = MPQEMU_CMD_RET;
-    ret.data.u64 = le64_to_cpu(val);
     ret.size = sizeof(ret.data.u64);
 
-    if (!mpqemu_msg_send(&ret, ioc, NULL)) {
+    if (!mpqemu_msg_send(&ret, com->ioc, NULL)) {
         error_prepend(errp, "Error returning code to proxy, pid "FMT_pid": ",
                       getpid());
     }
 }
 
-static void process_device_reset_msg(QIOChannel *ioc, PCIDevice *dev,
-                                     Error **errp)
+/*
+ * Track the ioeventfds that the devices register, so that the proxy can
+ * wire them to the guest accesses directly.
+ */
+static void remote_ioeventfd_changed(RemoteCommDev *com)
 {
-    DeviceClass *dc = DEVICE_GET_CLASS(dev);
-    DeviceState *s = DEVICE(dev);
-    MPQemuMsg ret = { 0 };
+    com->ioeventfd_gen++;
+    if (com->shm) {
+        qatomic_set(&com->shm->ioeventfd_gen, com->ioeventfd_gen);
+    }
+}
 
-    if (dc->reset) {
-        dc->reset(s);
+static void remote_ioeventfd_add(RemoteCommDev *com, bool memory,
+                                 MemoryRegionSection *section,
+                                 bool match_data, uint64_t data,
+                                 EventNotifier *e)
+{
+    RemoteIoeventfd *ioeventfd = g_new0(RemoteIoeventfd, 1);
+
+    ioeventfd->memory = memory;
+    ioeventfd->addr = section->offset_within_address_space;
+    ioeventfd->size = int128_get64(section->size);
+    ioeventfd->match_data = match_data;
+    ioeventfd->data = data;
+    ioeventfd->e = e;
+    QLIST_INSERT_HEAD(&com->ioeventfds, ioeventfd, next);
+    remote_ioeventfd_changed(com);
+}
+
+static void remote_ioeventfd_del(RemoteCommDev *com, bool memory,
+                                 MemoryRegionSection *section,
+                                 bool match_data, uint64_t data,
+                                 EventNotifier *e)
+{
+    RemoteIoeventfd *ioeventfd;
+
+    QLIST_FOREACH(ioeventfd, &com->ioeventfds, next) {
+        if (ioeventfd->memory == memory &&
+            ioeventfd->addr == section->offset_within_address_space &&
+            ioeventfd->match_data == match_data &&
+            ioeventfd->data == data && ioeventfd->e == e) {
+            QLIST_REMOVE(ioeventfd, next);
+            g_free(ioeventfd);
+            remote_ioeventfd_changed(com);
+            return;
+        }
+    }
+}
+
+static void remote_ioeventfd_mem_add(MemoryListener *listener,
+                                     MemoryRegionSection *section,
+                                     bool match_data, uint64_t data,
+                                     EventNotifier *e)
+{
+    RemoteCommDev *com = container_of(listener, RemoteCommDev,
+                                      ioeventfd_mem_listener);
+
+    remote_ioeventfd_add(com, true, section, match_data, data, e);
+}
+
+static void remote_ioeventfd_mem_del(MemoryListener *listener,
+                                     MemoryRegionSection *section,
+                                     bool match_data, uint64_t data,
+                                     EventNotifier *e)
+{
+    RemoteCommDev *com = container_of(listener, RemoteCommDev,
+                                      ioeventfd_mem_listener);
+
+    remote_ioeventfd_del(com, true, section, match_data, data, e);
+}
+
+static void remote_ioeventfd_io_add(MemoryListener *listener,
+                                    MemoryRegionSection *section,
+                                    bool match_data, uint64_t data,
+                                    EventNotifier *e)
+{
+    RemoteCommDev *com = container_of(listener, RemoteCommDev,
+                                      ioeventfd_io_listener);
+
+    remote_ioeventfd_add(com, false, section, match_data, data, e);
+}
+
+static void remote_ioeventfd_io_del(MemoryListener *listener,
+                                    MemoryRegionSection *section,
+                                    bool match_data, uint64_t data,
+                                    EventNotifier *e)
+{
+    RemoteCommDev *com = container_of(listener, RemoteCommDev,
+                                      ioeventfd_io_listener);
+
+    remote_ioeventfd_del(com, false, section, match_data, data, e);
+}
+
+static void remote_ioeventfd_init(RemoteCommDev *com)
+{
+    QLIST_INIT(&com->ioeventfds);
+
+    com->ioeventfd_mem_listener = (MemoryListener) {
+        .eventfd_add = remote_ioeventfd_mem_add,
+        .eventfd_del = remote_ioeventfd_mem_del,
+    };
+    com->ioeventfd_io_listener = (MemoryListener) {
+        .eventfd_add = remote_ioeventfd_io_add,
+        .eventfd_del = remote_ioeventfd_io_del,
+    };
+    memory_listener_register(&com->ioeventfd_mem_listener,
+                             &address_space_memory);
+    memory_listener_register(&com->ioeventfd_io_listener, &address_space_io);
+}
+
+static void remote_ioeventfd_cleanup(RemoteCommDev *com)
+{
+    RemoteIoeventfd *ioeventfd, *next;
+
+    memory_listener_unregister(&com->ioeventfd_mem_listener);
+    memory_listener_unregister(&com->ioeventfd_io_listener);
+    QLIST_FOREACH_SAFE(ioeventfd, &com->ioeventfds, next, next) {
+        QLIST_REMOVE(ioeventfd, next);
+        g_free(ioeventfd);
+    }
+}
+
+/*
+ * Send an MPQEMU_CMD_IOEVENTFD message for each ioeventfd in a BAR of the
+ * device, followed by MPQEMU_CMD_RET with the ioeventfd generation.
+ */
+static void process_get_ioeventfds(RemoteCommDev *com, Error **errp)
+{
+    ERRP_GUARD();
+    RemoteIoeventfd *ioeventfd;
+    MPQemuMsg ret = { 0 };
+    int i;
+
+    QLIST_FOREACH(ioeventfd, &com->ioeventfds, next) {
+        for (i = 0; i < PCI_NUM_REGIONS; i++) {
+            PCIIORegion *r = &com->dev->io_regions[i];
+            MPQemuMsg msg = { 0 };
+
+            if (!r->size || r->addr == PCI_BAR_UNMAPPED ||
+                ioeventfd->memory != !(r->type & PCI_BASE_ADDRESS_SPACE_IO) ||
+                ioeventfd->addr < r->addr ||
+                ioeventfd->addr + ioeventfd->size > r->addr + r->size) {
+                continue;
+            }
+
+            msg.cmd = MPQEMU_CMD_IOEVENTFD;
+            msg.size = sizeof(IoeventfdMsg);
+            msg.data.ioeventfd.bar = i;
+            msg.data.ioeventfd.offset = ioeventfd->addr - r->addr;
+            msg.data.ioeventfd.size = ioeventfd->size;
+            msg.data.ioeventfd.match_data = ioeventfd->match_data;
+            msg.data.ioeventfd.data = ioeventfd->data;
+            msg.num_fds = 1;
+            msg.fds[0] = event_notifier_get_fd(ioeventfd->e);
+
+            if (!mpqemu_msg_send(&msg, com->ioc, errp)) {
+                error_prepend(errp, "Error sending ioeventfd to proxy, "
+                              "pid "FMT_pid": ", getpid());
+                return;
+            }
+            break;
+        }
     }
 
     ret.cmd = MPQEMU_CMD_RET;
+    ret.data.u64 = com->ioeventfd_gen;
+    ret.size = sizeof(ret.data.u64);
 
-    mpqemu_msg_send(&ret, ioc, errp);
+    if (!mpqemu_msg_send(&ret, com->ioc, NULL)) {
+        error_prepend(errp, "Error returning code to proxy, pid "FMT_pid": ",
+                      getpid());
+    }
 }
@@ -70,7 +70,7 @@ bool mpqemu_msg_send(MPQemuMsg *msg, QIOChannel *ioc, Error **errp)
     }
 
     if (!qio_channel_writev_full_all(ioc, send, G_N_ELEMENTS(send),
-                                    fds, nfds, errp)) {
+                                    fds, nfds, 0, errp)) {
         ret = true;
     } else {
         trace_mpqemu_send_io_error(msg->cmd, msg->size, nfds);
@@ -259,6 +259,21 @@ bool mpqemu_msg_valid(MPQemuMsg *msg)
             return false;
         }
         break;
+    case MPQEMU_CMD_SET_SHM_CHANNEL:
+        if ((msg->size != sizeof(ShmChannelMsg)) || (msg->num_fds != 3)) {
+            return false;
+        }
+        break;
+    case MPQEMU_CMD_GET_IOEVENTFDS:
+        if (msg->size || msg->num_fds) {
+            return false;
+        }
+        break;
+    case MPQEMU_CMD_IOEVENTFD:
+        if ((msg->size != sizeof(IoeventfdMsg)) || (msg->num_fds != 1)) {
+            return false;
+        }
+        break;
     default:
         break;
     }
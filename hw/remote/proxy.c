@@ -22,9 +22,22 @@
 #include "hw/remote/proxy-memory-listener.h"
 #include "qom/object.h"
 #include "qemu/event_notifier.h"
+#include "qemu/main-loop.h"
+#include "qemu/memfd.h"
+#include "qemu/timer.h"
 #include "sysemu/kvm.h"
 #include "util/event_notifier-posix.c"
 
+typedef struct ProxyIoeventfd {
+    int bar;
+    hwaddr offset;
+    unsigned size;
+    bool match_data;
+    uint64_t data;
+    EventNotifier e;
+    QLIST_ENTRY(ProxyIoeventfd) next;
+} ProxyIoeventfd;
+
 static void probe_pci_info(PCIDevice *dev, Error **errp);
 static void proxy_device_reset(DeviceState *dev);
 
@@ -76,6 +89,226 @@ static void setup_irqfd(PCIProxyDev *dev)
     pci_device_set_intx_routing_notifier(pci_dev, proxy_intx_update);
 }
 
+/*
+ * Carry BAR accesses through shared memory, see MPQemuShmChannel.  If the
+ * remote process can't map it, keep using the socket.
+ */
+static void setup_shm_channel(PCIProxyDev *dev)
+{
+    MPQemuShmChannel *shm;
+    MPQemuMsg msg = { 0 };
+    Error *local_err = NULL;
+    uint64_t ret;
+    int fd;
+
+    shm = qemu_memfd_alloc("mpqemu-shm", sizeof(MPQemuShmChannel), 0, &fd,
+                           &local_err);
+    if (!shm) {
+        warn_report_err(local_err);
+        return;
+    }
+
+    event_notifier_init(&dev->shm_kick, 0);
+    event_notifier_init(&dev->shm_done, 0);
+
+    msg.cmd = MPQEMU_CMD_SET_SHM_CHANNEL;
+    msg.num_fds = 3;
+    msg.fds[0] = fd;
+    msg.fds[1] = event_notifier_get_fd(&dev->shm_kick);
+    msg.fds[2] = event_notifier_get_fd(&dev->shm_done);
+    msg.data.shm_channel.poll_ns = dev->shm_poll_ns;
+    msg.size = sizeof(ShmChannelMsg);
+
+    ret = mpqemu_msg_send_and_await_reply(&msg, dev, &local_err);
+    close(fd);
+    if (ret) {
+        if (local_err) {
+            error_report_err(local_err);
+        }
+        event_notifier_cleanup(&dev->shm_kick);
+        event_notifier_cleanup(&dev->shm_done);
+        qemu_memfd_free(shm, sizeof(MPQemuShmChannel), -1);
+        return;
+    }
+
+    dev->shm = shm;
+}
+
+/*
+ * Sleep until the remote process completes request @seq.  Returns false
+ * if the remote process went away instead.
+ */
+static bool proxy_shm_wait(PCIProxyDev *dev, uint32_t seq)
+{
+    MPQemuShmChannel *shm = dev->shm;
+    bool iolock = qemu_mutex_iothread_locked();
+    GPollFD pfd[2] = {
+        { .fd = event_notifier_get_fd(&dev->shm_done), .events = G_IO_IN },
+        /* the remote process never writes to the socket unasked */
+        { .fd = QIO_CHANNEL_SOCKET(dev->ioc)->fd, .events = G_IO_IN },
+    };
+    bool ret = true;
+
+    qatomic_set(&shm->proxy_waiting, 1);
+    /* pairs with smp_mb() in remote_shm_kick() */
+    smp_mb();
+
+    if (iolock) {
+        qemu_mutex_unlock_iothread();
+    }
+
+    while (qatomic_load_acquire(&shm->ret_seq) != seq) {
+        if (g_poll(pfd, ARRAY_SIZE(pfd), -1) < 0 && errno != EINTR) {
+            ret = false;
+            break;
+        }
+        if (pfd[1].revents) {
+            ret = false;
+            break;
+        }
+        event_notifier_test_and_clear(&dev->shm_done);
+    }
+
+    if (iolock) {
+        qemu_mutex_lock_iothread();
+    }
+
+    qatomic_set(&shm->proxy_waiting, 0);
+    return ret;
+}
+
+static uint64_t proxy_shm_access(PCIProxyDev *dev, int cmd,
+                                 BarAccessMsg *bar_access)
+{
+    MPQemuShmChannel *shm = dev->shm;
+    uint32_t seq;
+    int64_t deadline;
+
+    QEMU_LOCK_GUARD(&dev->io_mutex);
+
+    seq = shm->req_seq + 1;
+    shm->req_cmd = cmd;
+    shm->req = *bar_access;
+    qatomic_store_release(&shm->req_seq, seq);
+
+    /* pairs with smp_mb() in remote_shm_kick() */
+    smp_mb();
+    if (qatomic_read(&shm->remote_idle)) {
+        event_notifier_set(&dev->shm_kick);
+    }
+
+    deadline = get_clock() + dev->shm_poll_ns;
+    while (qatomic_load_acquire(&shm->ret_seq) != seq) {
+        if (get_clock() < deadline) {
+            cpu_relax();
+        } else if (!proxy_shm_wait(dev, seq)) {
+            error_report("proxy: remote process for %s went away",
+                         DEVICE(dev)->id);
+            return UINT64_MAX;
+        }
+    }
+
+    return shm->ret;
+}
+
+static void proxy_del_ioeventfds(PCIProxyDev *dev)
+{
+    ProxyIoeventfd *ioeventfd, *next;
+
+    memory_region_transaction_begin();
+    QLIST_FOREACH(ioeventfd, &dev->ioeventfds, next) {
+        memory_region_del_eventfd(&dev->region[ioeventfd->bar].mr,
+                                  ioeventfd->offset, ioeventfd->size,
+                                  ioeventfd->match_data, ioeventfd->data,
+                                  &ioeventfd->e);
+    }
+    memory_region_transaction_commit();
+
+    /* KVM needs the file descriptors until the commit */
+    QLIST_FOREACH_SAFE(ioeventfd, &dev->ioeventfds, next, next) {
+        QLIST_REMOVE(ioeventfd, next);
+        event_notifier_cleanup(&ioeventfd->e);
+        g_free(ioeventfd);
+    }
+}
+
+static void proxy_add_ioeventfd(PCIProxyDev *dev, MPQemuMsg *msg)
+{
+    IoeventfdMsg *m = &msg->data.ioeventfd;
+    ProxyIoeventfd *ioeventfd;
+
+    if (m->bar < 0 || m->bar >= PCI_NUM_REGIONS ||
+        !dev->region[m->bar].present ||
+        m->offset + m->size > memory_region_size(&dev->region[m->bar].mr)) {
+        close(msg->fds[0]);
+        return;
+    }
+
+    ioeventfd = g_new0(ProxyIoeventfd, 1);
+    ioeventfd->bar = m->bar;
+    ioeventfd->offset = m->offset;
+    ioeventfd->size = m->size;
+    ioeventfd->match_data = m->match_data;
+    ioeventfd->data = m->data;
+    event_notifier_init_fd(&ioeventfd->e, msg->fds[0]);
+    QLIST_INSERT_HEAD(&dev->ioeventfds, ioeventfd, next);
+
+    memory_region_add_eventfd(&dev->region[m->bar].mr, m->offset, m->size,
+                              m->match_data, m->data, &ioeventfd->e);
+}
+
+/*
+ * Wire the ioeventfds of the remote process to the BARs, so that doorbell
+ * writes of the guest signal the remote device directly.
+ */
+static void proxy_sync_ioeventfds(PCIProxyDev *dev)
+{
+    MPQemuMsg msg = { 0 };
+    Error *local_err = NULL;
+
+    proxy_del_ioeventfds(dev);
+
+    QEMU_LOCK_GUARD(&dev->io_mutex);
+
+    /* don't retry over and over on errors */
+    dev->ioeventfd_gen = qatomic_read(&dev->shm->ioeventfd_gen);
+
+    msg.cmd = MPQEMU_CMD_GET_IOEVENTFDS;
+    if (!mpqemu_msg_send(&msg, dev->ioc, &local_err)) {
+        goto fail;
+    }
+
+    memory_region_transaction_begin();
+    for (;;) {
+        MPQemuMsg reply = { 0 };
+
+        if (!mpqemu_msg_recv(&reply, dev->ioc, &local_err)) {
+            break;
+        }
+        if (!mpqemu_msg_valid(&reply)) {
+            error_setg(&local_err, "Invalid reply received for command %d",
+                       msg.cmd);
+            break;
+        }
+        if (reply.cmd == MPQEMU_CMD_RET) {
+            dev->ioeventfd_gen = reply.data.u64;
+            break;
+        }
+        if (reply.cmd != MPQEMU_CMD_IOEVENTFD) {
+            error_setg(&local_err, "Unexpected reply %d to command %d",
+                       reply.cmd, msg.cmd);
+            break;
+        }
+        proxy_add_ioeventfd(dev, &reply);
+    }
+    memory_region_transaction_commit();
+
+fail:
+    if (local_err) {
+        error_report_err(local_err);
+    }
+}
+
 static void pci_proxy_dev_realize(PCIDevice *device, Error **errp)
 {
     ERRP_GUARD();
@@ -117,6 +350,11 @@ static void pci_proxy_dev_realize(PCIDevice *device, Error **errp)
 
     setup_irqfd(dev);
 
+    QLIST_INIT(&dev->ioeventfds);
+    if (dev->shm_enabled) {
+        setup_shm_channel(dev);
+    }
+
     probe_pci_info(PCI_DEVICE(dev), errp);
 }
 
@@ -136,6 +374,14 @@ static void pci_proxy_dev_exit(PCIDevice *pdev)
 
     event_notifier_cleanup(&dev->intr);
     event_notifier_cleanup(&dev->resample);
+
+    proxy_del_ioeventfds(dev);
+    if (dev->shm) {
+        event_notifier_cleanup(&dev->shm_kick);
+        event_notifier_cleanup(&dev->shm_done);
+        qemu_memfd_free(dev->shm, sizeof(MPQemuShmChannel), -1);
+        dev->shm = NULL;
+    }
 }
 
 static void config_op_send(PCIProxyDev *pdev, uint32_t addr, uint32_t *val,
@@ -190,6 +436,8 @@ static void pci_proxy_write_config(PCIDevice *d, uint32_t addr, uint32_t val,
 
 static Property proxy_properties[] = {
     DEFINE_PROP_STRING("fd", PCIProxyDev, fd),
+    DEFINE_PROP_BOOL("x-shm-channel", PCIProxyDev, shm_enabled, true),
+    DEFINE_PROP_UINT32("x-shm-poll-ns", PCIProxyDev, shm_poll_ns, 20000),
     DEFINE_PROP_END_OF_LIST(),
 };
 
@@ -246,9 +494,16 @@ static void send_bar_access_msg(PCIProxyDev *pdev, MemoryRegion *mr,
         msg.cmd = MPQEMU_CMD_BAR_READ;
     }
 
-    ret = mpqemu_msg_send_and_await_reply(&msg, pdev, &local_err);
-    if (local_err) {
-        error_report_err(local_err);
+    if (pdev->shm) {
+        ret = proxy_shm_access(pdev, msg.cmd, &msg.data.bar_access);
+        if (qatomic_read(&pdev->shm->ioeventfd_gen) != pdev->ioeventfd_gen) {
+            proxy_sync_ioeventfds(pdev);
+        }
+    } else {
+        ret = mpqemu_msg_send_and_await_reply(&msg, pdev, &local_err);
+        if (local_err) {
+            error_report_err(local_err);
+        }
     }
 
     if (!write) {
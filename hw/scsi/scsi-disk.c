@@ -1598,71 +1598,112 @@ static inline bool check_lba_range(SCSIDiskState *s,
             sector_num + nb_sectors <= s->qdev.max_lba + 1);
 }
 
-typedef struct UnmapCBData {
-    SCSIDiskReq *r;
-    uint8_t *inbuf;
-    int count;
-} UnmapCBData;
+/* Discards submitted at the same time for one UNMAP command */
+#define SCSI_UNMAP_MAX_INFLIGHT     16
+
+typedef struct UnmapRange {
+    int64_t offset;
+    int64_t bytes;
+} UnmapRange;
 
-static void scsi_unmap_complete(void *opaque, int ret);
+/*
+ * The descriptors of an UNMAP command are sorted and merged, and the
+ * resulting ranges are discarded concurrently.  The command completes
+ * when all of them are done.
+ */
+typedef struct UnmapAIOCB {
+    BlockAIOCB common;
+    BlockBackend *blk;
+    UnmapRange *ranges;
+    int nb_ranges;
+    int next;           /* first range that was not completely submitted */
+    int inflight;
+    int ret;
+} UnmapAIOCB;
 
-static void scsi_unmap_complete_noio(UnmapCBData *data, int ret)
+static void scsi_unmap_aio_cancel(BlockAIOCB *acb)
 {
-    SCSIDiskReq *r = data->r;
-    SCSIDiskState *s = DO_UPCAST(SCSIDiskState, qdev, r->req.dev);
+    UnmapAIOCB *iocb = container_of(acb, UnmapAIOCB, common);
 
-    assert(r->req.aiocb == NULL);
+    /* Let the discards in flight finish, but don't submit any more */
+    iocb->next = iocb->nb_ranges;
+    iocb->ret = -ECANCELED;
+}
 
-    if (data->count > 0) {
-        r->sector = ldq_be_p(&data->inbuf[0])
-            * (s->qdev.blocksize / BDRV_SECTOR_SIZE);
-        r->sector_count = (ldl_be_p(&data->inbuf[8]) & 0xffffffffULL)
-            * (s->qdev.blocksize / BDRV_SECTOR_SIZE);
-        if (!check_lba_range(s, r->sector, r->sector_count)) {
-            block_acct_invalid(blk_get_stats(s->qdev.conf.blk),
-                               BLOCK_ACCT_UNMAP);
-            scsi_check_condition(r, SENSE_CODE(LBA_OUT_OF_RANGE));
-            goto done;
+static const AIOCBInfo unmap_aiocb_info = {
+    .aiocb_size         = sizeof(UnmapAIOCB),
+    .cancel_async       = scsi_unmap_aio_cancel,
+};
+
+static void scsi_unmap_range_complete(void *opaque, int ret);
+
+static void scsi_unmap_submit(UnmapAIOCB *iocb)
+{
+    while (iocb->next < iocb->nb_ranges &&
+           iocb->inflight < SCSI_UNMAP_MAX_INFLIGHT) {
+        UnmapRange *range = &iocb->ranges[iocb->next];
+        int64_t offset = range->offset;
+        int bytes = MIN(range->bytes, BDRV_REQUEST_MAX_BYTES);
+
+        range->offset += bytes;
+        range->bytes -= bytes;
+        if (!range->bytes) {
+            iocb->next++;
         }
+        iocb->inflight++;
+        blk_aio_pdiscard(iocb->blk, offset, bytes,
+                         scsi_unmap_range_complete, iocb);
+    }
+}
 
-        block_acct_start(blk_get_stats(s->qdev.conf.blk), &r->acct,
-                         r->sector_count * BDRV_SECTOR_SIZE,
-                         BLOCK_ACCT_UNMAP);
-
-        r->req.aiocb = blk_aio_pdiscard(s->qdev.conf.blk,
-                                        r->sector * BDRV_SECTOR_SIZE,
-                                        r->sector_count * BDRV_SECTOR_SIZE,
-                                        scsi_unmap_complete, data);
-        data->count--;
-        data->inbuf += 16;
-        return;
+static void scsi_unmap_range_complete(void *opaque, int ret)
+{
+    UnmapAIOCB *iocb = opaque;
+
+    iocb->inflight--;
+    if (ret < 0 && !iocb->ret) {
+        /* Report the first error and stop there */
+        iocb->ret = ret;
+        iocb->next = iocb->nb_ranges;
     }
+    scsi_unmap_submit(iocb);
 
-    scsi_req_complete(&r->req, GOOD);
+    if (!iocb->inflight) {
+        iocb->common.cb(iocb->common.opaque, iocb->ret);
+        g_free(iocb->ranges);
+        qemu_aio_unref(iocb);
+    }
+}
 
-done:
-    scsi_req_unref(&r->req);
-    g_free(data);
+static int unmap_range_cmp(const void *a, const void *b)
+{
+    const UnmapRange *ra = a;
+    const UnmapRange *rb = b;
+
+    return ra->offset < rb->offset ? -1 : ra->offset > rb->offset;
 }
 
-static void scsi_unmap_complete(void *opaque, int ret)
+/* Sort @ranges and merge the overlapping and adjacent ones */
+static int scsi_unmap_merge_ranges(UnmapRange *ranges, int nb_ranges)
 {
-    UnmapCBData *data = opaque;
-    SCSIDiskReq *r = data->r;
-    SCSIDiskState *s = DO_UPCAST(SCSIDiskState, qdev, r->req.dev);
+    int i, n = 0;
 
-    assert(r->req.aiocb != NULL);
-    r->req.aiocb = NULL;
+    if (!nb_ranges) {
+        return 0;
+    }
 
-    aio_context_acquire(blk_get_aio_context(s->qdev.conf.blk));
-    if (scsi_disk_req_check_error(r, ret, true)) {
-        scsi_req_unref(&r->req);
-        g_free(data);
-    } else {
-        block_acct_done(blk_get_stats(s->qdev.conf.blk), &r->acct);
-        scsi_unmap_complete_noio(data, ret);
+    qsort(ranges, nb_ranges, sizeof(*ranges), unmap_range_cmp);
+    for (i = 1; i < nb_ranges; i++) {
+        UnmapRange *last = &ranges[n];
+
+        if (ranges[i].offset <= last->offset + last->bytes) {
+            last->bytes = MAX(last->bytes, ranges[i].offset +
+                              ranges[i].bytes - last->offset);
+        } else {
+            ranges[++n] = ranges[i];
+        }
     }
-    aio_context_release(blk_get_aio_context(s->qdev.conf.blk));
+    return n + 1;
 }
 
 static void scsi_disk_emulate_unmap(SCSIDiskReq *r, uint8_t *inbuf)
@@ -1670,7 +1711,11 @@ static void scsi_disk_emulate_unmap(SCSIDiskReq *r, uint8_t *inbuf)
     SCSIDiskState *s = DO_UPCAST(SCSIDiskState, qdev, r->req.dev);
     uint8_t *p = inbuf;
     int len = r->req.cmd.xfer;
-    UnmapCBData *data;
+    UnmapAIOCB *iocb;
+    UnmapRange *ranges;
+    int count, nb_ranges = 0;
+    int64_t bytes = 0;
+    int i;
 
     /* Reject ANCHOR=1.  */
     if (r->req.cmd.buf[1] & 0x1) {
@@ -1696,14 +1741,50 @@ static void scsi_disk_emulate_unmap(SCSIDiskReq *r, uint8_t *inbuf)
         return;
     }
 
-    data = g_new0(UnmapCBData, 1);
-    data->r = r;
-    data->inbuf = &p[8];
-    data->count = lduw_be_p(&p[2]) >> 4;
+    count = lduw_be_p(&p[2]) >> 4;
+    ranges = g_new(UnmapRange, count);
+    for (i = 0; i < count; i++) {
+        uint8_t *desc = &p[8 + i * 16];
+        uint64_t lba = ldq_be_p(&desc[0]);
+        uint32_t nb_blocks = ldl_be_p(&desc[8]);
 
-    /* The matching unref is in scsi_unmap_complete, before data is freed.  */
+        if (!check_lba_range(s, lba, nb_blocks)) {
+            g_free(ranges);
+            block_acct_invalid(blk_get_stats(s->qdev.conf.blk),
+                               BLOCK_ACCT_UNMAP);
+            scsi_check_condition(r, SENSE_CODE(LBA_OUT_OF_RANGE));
+            return;
+        }
+        if (nb_blocks) {
+            ranges[nb_ranges].offset = lba * s->qdev.blocksize;
+            ranges[nb_ranges].bytes = (int64_t)nb_blocks * s->qdev.blocksize;
+            bytes += ranges[nb_ranges].bytes;
+            nb_ranges++;
+        }
+    }
+
+    nb_ranges = scsi_unmap_merge_ranges(ranges, nb_ranges);
+    if (!nb_ranges) {
+        g_free(ranges);
+        scsi_req_complete(&r->req, GOOD);
+        return;
+    }
+
+    iocb = blk_aio_get(&unmap_aiocb_info, s->qdev.conf.blk,
+                       scsi_aio_complete, r);
+    iocb->blk = s->qdev.conf.blk;
+    iocb->ranges = ranges;
+    iocb->nb_ranges = nb_ranges;
+    iocb->next = 0;
+    iocb->inflight = 0;
+    iocb->ret = 0;
+
+    /* The request is used as the AIO opaque value, so add a ref.  */
     scsi_req_ref(&r->req);
-    scsi_unmap_complete_noio(data, 0);
+    block_acct_start(blk_get_stats(s->qdev.conf.blk), &r->acct, bytes,
+                     BLOCK_ACCT_UNMAP);
+    r->req.aiocb = &iocb->common;
+    scsi_unmap_submit(iocb);
     return;
 
 invalid_param_len:
@@ -20,6 +20,50 @@
 #include "scsi/constants.h"
 #include "hw/virtio/virtio-bus.h"
 #include "hw/virtio/virtio-access.h"
+#include "block/aio-wait.h"
+
+/* Context: QEMU global mutex held */
+static bool virtio_scsi_dataplane_setup_iothreads(VirtIOSCSI *s, Error **errp)
+{
+    VirtIOSCSIConf *conf = &VIRTIO_SCSI_COMMON(s)->conf;
+    unsigned i, j;
+
+    s->iothreads = g_new0(IOThread *, conf->num_iothreads);
+    for (i = 0; i < conf->num_iothreads; i++) {
+        s->iothreads[i] = iothread_by_id(conf->iothreads[i]);
+        if (!s->iothreads[i]) {
+            error_setg(errp, "IOThread '%s' not found", conf->iothreads[i]);
+            while (i--) {
+                object_unref(OBJECT(s->iothreads[i]));
+            }
+            g_free(s->iothreads);
+            s->iothreads = NULL;
+            return false;
+        }
+        object_ref(OBJECT(s->iothreads[i]));
+    }
+
+    /* LUNs are spread over all IOThreads, ctxs[0] is s->ctx */
+    s->ctxs = g_new(AioContext *, conf->num_iothreads);
+    for (i = 0; i < conf->num_iothreads; i++) {
+        AioContext *ctx = iothread_get_aio_context(s->iothreads[i]);
+
+        for (j = 0; j < s->num_ctxs && s->ctxs[j] != ctx; j++) {
+            /* look for a duplicate */
+        }
+        if (j == s->num_ctxs) {
+            s->ctxs[s->num_ctxs++] = ctx;
+        }
+    }
+    s->ctx = s->ctxs[0];
+
+    s->cmd_vq_ctx = g_new(AioContext *, conf->num_queues);
+    for (i = 0; i < conf->num_queues; i++) {
+        s->cmd_vq_ctx[i] =
+            iothread_get_aio_context(s->iothreads[i % conf->num_iothreads]);
+    }
+    return true;
+}
 
 /* Context: QEMU global mutex held */
 void virtio_scsi_dataplane_setup(VirtIOSCSI *s, Error **errp)
@@ -29,7 +73,24 @@ void virtio_scsi_dataplane_setup(VirtIOSCSI *s, Error **errp)
     BusState *qbus = qdev_get_parent_bus(DEVICE(vdev));
     VirtioBusClass *k = VIRTIO_BUS_GET_CLASS(qbus);
 
-    if (vs->conf.iothread) {
+    if (vs->conf.iothread && vs->conf.num_iothreads) {
+        error_setg(errp, "iothread and iothreads cannot be used together");
+        return;
+    }
+
+    if (vs->conf.num_iothreads) {
+        if (!k->set_guest_notifiers || !k->ioeventfd_assign) {
+            error_setg(errp,
+                       "device is incompatible with iothreads "
+                       "(transport does not support notifiers)");
+            return;
+        }
+        if (!virtio_device_ioeventfd_enabled(vdev)) {
+            error_setg(errp, "ioeventfd is required for iothreads");
+            return;
+        }
+        virtio_scsi_dataplane_setup_iothreads(s, errp);
+    } else if (vs->conf.iothread) {
         if (!k->set_guest_notifiers || !k->ioeventfd_assign) {
             error_setg(errp,
                        "device is incompatible with iothread "
@@ -49,18 +110,87 @@ void virtio_scsi_dataplane_setup(VirtIOSCSI *s, Error **errp)
     }
 }
 
+/* Context: QEMU global mutex held */
+void virtio_scsi_dataplane_cleanup(VirtIOSCSI *s)
+{
+    VirtIOSCSICommon *vs = VIRTIO_SCSI_COMMON(s);
+    unsigned i;
+
+    if (s->iothreads) {
+        for (i = 0; i < vs->conf.num_iothreads; i++) {
+            object_unref(OBJECT(s->iothreads[i]));
+        }
+    }
+    g_free(s->iothreads);
+    s->iothreads = NULL;
+    g_free(s->ctxs);
+    s->ctxs = NULL;
+    s->num_ctxs = 0;
+    g_free(s->cmd_vq_ctx);
+    s->cmd_vq_ctx = NULL;
+}
+
+/* The AioContext that @vq is assigned to when dataplane runs */
+static AioContext *virtio_scsi_dataplane_vq_ctx(VirtIOSCSI *s, VirtQueue *vq)
+{
+    int i = virtio_get_queue_index(vq) - VIRTIO_SCSI_VQ_NUM_FIXED;
+
+    if (s->cmd_vq_ctx && i >= 0) {
+        return s->cmd_vq_ctx[i];
+    }
+    return s->ctx;
+}
+
+/* The AioContext that processes @vq and completes its requests */
+AioContext *virtio_scsi_get_vq_aio_context(VirtIOSCSI *s, VirtQueue *vq)
+{
+    if (!s->ctx || !s->dataplane_started || s->dataplane_fenced) {
+        return qemu_get_aio_context();
+    }
+    return virtio_scsi_dataplane_vq_ctx(s, vq);
+}
+
+/* Context: QEMU global mutex held */
+static void virtio_scsi_dataplane_acquire_all(VirtIOSCSI *s)
+{
+    unsigned i;
+
+    if (!s->ctxs) {
+        aio_context_acquire(s->ctx);
+        return;
+    }
+    for (i = 0; i < s->num_ctxs; i++) {
+        aio_context_acquire(s->ctxs[i]);
+    }
+}
+
+/* Context: QEMU global mutex held */
+static void virtio_scsi_dataplane_release_all(VirtIOSCSI *s)
+{
+    unsigned i;
+
+    if (!s->ctxs) {
+        aio_context_release(s->ctx);
+        return;
+    }
+    for (i = s->num_ctxs; i-- > 0;) {
+        aio_context_release(s->ctxs[i]);
+    }
+}
+
 static bool virtio_scsi_data_plane_handle_cmd(VirtIODevice *vdev,
                                               VirtQueue *vq)
 {
     bool progress = false;
     VirtIOSCSI *s = VIRTIO_SCSI(vdev);
+    AioContext *ctx = virtio_scsi_dataplane_vq_ctx(s, vq);
 
-    virtio_scsi_acquire(s);
+    aio_context_acquire(ctx);
     if (!s->dataplane_fenced) {
         assert(s->ctx && s->dataplane_started);
         progress = virtio_scsi_handle_cmd_vq(s, vq);
     }
-    virtio_scsi_release(s);
+    aio_context_release(ctx);
     return progress;
 }
 
@@ -109,21 +239,34 @@ static int virtio_scsi_vring_init(VirtIOSCSI *s, VirtQueue *vq, int n,
         return rc;
     }
 
-    virtio_queue_aio_set_host_notifier_handler(vq, s->ctx, fn);
+    virtio_queue_aio_set_host_notifier_handler(vq,
+            virtio_scsi_dataplane_vq_ctx(s, vq), fn);
     return 0;
 }
 
-/* Context: BH in IOThread */
-static void virtio_scsi_dataplane_stop_bh(void *opaque)
+/* Context: BH in the IOThread of the virtqueue */
+static void virtio_scsi_dataplane_stop_vq_bh(void *opaque)
+{
+    VirtQueue *vq = opaque;
+
+    virtio_queue_aio_set_host_notifier_handler(vq,
+            qemu_get_current_aio_context(), NULL);
+}
+
+/* Context: QEMU global mutex held */
+static void virtio_scsi_dataplane_stop_vqs(VirtIOSCSI *s, int count)
 {
-    VirtIOSCSI *s = opaque;
     VirtIOSCSICommon *vs = VIRTIO_SCSI_COMMON(s);
     int i;
 
-    virtio_queue_aio_set_host_notifier_handler(vs->ctrl_vq, s->ctx, NULL);
-    virtio_queue_aio_set_host_notifier_handler(vs->event_vq, s->ctx, NULL);
-    for (i = 0; i < vs->conf.num_queues; i++) {
-        virtio_queue_aio_set_host_notifier_handler(vs->cmd_vqs[i], s->ctx, NULL);
+    for (i = 0; i < count; i++) {
+        VirtQueue *vq = i == 0 ? vs->ctrl_vq :
+                        i == 1 ? vs->event_vq : vs->cmd_vqs[i - 2];
+        AioContext *ctx = virtio_scsi_dataplane_vq_ctx(s, vq);
+
+        aio_context_acquire(ctx);
+        aio_wait_bh_oneshot(ctx, virtio_scsi_dataplane_stop_vq_bh, vq);
+        aio_context_release(ctx);
     }
 }
 
@@ -154,7 +297,7 @@ int virtio_scsi_dataplane_start(VirtIODevice *vdev)
         goto fail_guest_notifiers;
     }
 
-    aio_context_acquire(s->ctx);
+    virtio_scsi_dataplane_acquire_all(s);
     rc = virtio_scsi_vring_init(s, vs->ctrl_vq, 0,
                                 virtio_scsi_data_plane_handle_ctrl);
     if (rc) {
@@ -180,12 +323,12 @@ int virtio_scsi_dataplane_start(VirtIODevice *vdev)
 
     s->dataplane_starting = false;
     s->dataplane_started = true;
-    aio_context_release(s->ctx);
+    virtio_scsi_dataplane_release_all(s);
     return 0;
 
 fail_vrings:
-    aio_wait_bh_oneshot(s->ctx, virtio_scsi_dataplane_stop_bh, s);
-    aio_context_release(s->ctx);
+    virtio_scsi_dataplane_release_all(s);
+    virtio_scsi_dataplane_stop_vqs(s, vq_init_count);
     for (i = 0; i < vq_init_count; i++) {
         virtio_bus_set_host_notifier(VIRTIO_BUS(qbus), i, false);
         virtio_bus_cleanup_host_notifier(VIRTIO_BUS(qbus), i);
@@ -219,12 +362,13 @@ void virtio_scsi_dataplane_stop(VirtIODevice *vdev)
     }
     s->dataplane_stopping = true;
 
-    aio_context_acquire(s->ctx);
-    aio_wait_bh_oneshot(s->ctx, virtio_scsi_dataplane_stop_bh, s);
-    aio_context_release(s->ctx);
+    virtio_scsi_dataplane_stop_vqs(s, vs->conf.num_queues + 2);
 
     blk_drain_all(); /* ensure there are no in-flight requests */
 
+    /* Commands completed in the IOThread of their LUN may not be pushed yet */
+    AIO_WAIT_WHILE(NULL, qatomic_read(&s->bh_in_flight) > 0);
+
     for (i = 0; i < vs->conf.num_queues + 2; i++) {
         virtio_bus_set_host_notifier(VIRTIO_BUS(qbus), i, false);
         virtio_bus_cleanup_host_notifier(VIRTIO_BUS(qbus), i);
@@ -27,6 +27,7 @@
 #include "scsi/constants.h"
 #include "hw/virtio/virtio-bus.h"
 #include "hw/virtio/virtio-access.h"
+#include "block/aio-wait.h"
 #include "trace.h"
 
 static inline int virtio_scsi_get_lun(uint8_t *lun)
@@ -62,28 +63,64 @@ void virtio_scsi_free_req(VirtIOSCSIReq *req)
 {
     qemu_iovec_destroy(&req->resp_iov);
     qemu_sglist_destroy(&req->qsgl);
-    g_free(req);
+    virtqueue_element_free(&req->elem);
 }
 
-static void virtio_scsi_complete_req(VirtIOSCSIReq *req)
+static void virtio_scsi_push_req(VirtIOSCSIReq *req)
 {
     VirtIOSCSI *s = req->dev;
     VirtQueue *vq = req->vq;
     VirtIODevice *vdev = VIRTIO_DEVICE(s);
 
-    qemu_iovec_from_buf(&req->resp_iov, 0, &req->resp, req->resp_size);
     virtqueue_push(vq, &req->elem, req->qsgl.size + req->resp_iov.size);
     if (s->dataplane_started && !s->dataplane_fenced) {
         virtio_notify_irqfd(vdev, vq);
     } else {
         virtio_notify(vdev, vq);
     }
+    virtio_scsi_free_req(req);
+}
+
+/* Context: BH in the AioContext of req->vq */
+static void virtio_scsi_complete_req_bh(void *opaque)
+{
+    VirtIOSCSIReq *req = opaque;
+    VirtIOSCSI *s = req->dev;
+    AioContext *ctx = qemu_get_current_aio_context();
+
+    aio_context_acquire(ctx);
+    virtio_scsi_push_req(req);
+    aio_context_release(ctx);
 
+    qatomic_dec(&s->bh_in_flight);
+    aio_wait_kick();
+}
+
+static void virtio_scsi_complete_req(VirtIOSCSIReq *req)
+{
+    VirtIOSCSI *s = req->dev;
+    AioContext *ctx;
+
+    qemu_iovec_from_buf(&req->resp_iov, 0, &req->resp, req->resp_size);
     if (req->sreq) {
         req->sreq->hba_private = NULL;
         scsi_req_unref(req->sreq);
+        req->sreq = NULL;
     }
-    virtio_scsi_free_req(req);
+
+    /*
+     * With several IOThreads the request may complete in the thread of its
+     * LUN; the virtqueue is only ever touched from its own thread.
+     */
+    if (s->num_ctxs > 1) {
+        ctx = virtio_scsi_get_vq_aio_context(s, req->vq);
+        if (ctx != qemu_get_current_aio_context()) {
+            qatomic_inc(&s->bh_in_flight);
+            aio_bh_schedule_oneshot(ctx, virtio_scsi_complete_req_bh, req);
+            return;
+        }
+    }
+    virtio_scsi_push_req(req);
 }
 
 static void virtio_scsi_bad_req(VirtIOSCSIReq *req)
@@ -187,6 +224,25 @@ static VirtIOSCSIReq *virtio_scsi_pop_req(VirtIOSCSI *s, VirtQueue *vq)
     return req;
 }
 
+/*
+ * Like virtio_scsi_pop_req(), but pop up to @max requests at once.  Returns
+ * the number of requests stored in @reqs.
+ */
+static unsigned int virtio_scsi_pop_reqs(VirtIOSCSI *s, VirtQueue *vq,
+                                         VirtIOSCSIReq **reqs,
+                                         unsigned int max)
+{
+    VirtIOSCSICommon *vs = (VirtIOSCSICommon *)s;
+    unsigned int i, n;
+
+    n = virtqueue_pop_batch(vq, sizeof(VirtIOSCSIReq) + vs->cdb_size,
+                            (void **)reqs, max);
+    for (i = 0; i < n; i++) {
+        virtio_scsi_init_req(s, vq, reqs[i]);
+    }
+    return n;
+}
+
 static void virtio_scsi_save_request(QEMUFile *f, SCSIRequest *sreq)
 {
     VirtIOSCSIReq *req = sreq->hba_private;
@@ -228,6 +284,13 @@ static void *virtio_scsi_load_request(QEMUFile *f, SCSIRequest *sreq)
     return req;
 }
 
+static void virtio_scsi_complete_tmf_req(VirtIOSCSIReq *req)
+{
+    trace_virtio_scsi_tmf_resp(virtio_scsi_get_lun(req->req.tmf.lun),
+                               req->req.tmf.tag, req->resp.tmf.response);
+    virtio_scsi_complete_req(req);
+}
+
 typedef struct {
     Notifier        notifier;
     VirtIOSCSIReq  *tmf_req;
@@ -240,11 +303,7 @@ static void virtio_scsi_cancel_notify(Notifier *notifier, void *data)
                                                notifier);
 
     if (--n->tmf_req->remaining == 0) {
-        VirtIOSCSIReq *req = n->tmf_req;
-
-        trace_virtio_scsi_tmf_resp(virtio_scsi_get_lun(req->req.tmf.lun),
-                                   req->req.tmf.tag, req->resp.tmf.response);
-        virtio_scsi_complete_req(req);
+        virtio_scsi_complete_tmf_req(n->tmf_req);
     }
     g_free(n);
 }
@@ -252,7 +311,7 @@ static void virtio_scsi_cancel_notify(Notifier *notifier, void *data)
 static inline void virtio_scsi_ctx_check(VirtIOSCSI *s, SCSIDevice *d)
 {
     if (s->dataplane_started && d && blk_is_available(d->conf.blk)) {
-        assert(blk_get_aio_context(d->conf.blk) == s->ctx);
+        assert(s->num_ctxs > 1 || blk_get_aio_context(d->conf.blk) == s->ctx);
     }
 }
 
@@ -264,6 +323,7 @@ static int virtio_scsi_do_tmf(VirtIOSCSI *s, VirtIOSCSIReq *req)
     SCSIDevice *d = virtio_scsi_device_get(s, req->req.tmf.lun);
     SCSIRequest *r, *next;
     BusChild *kid;
+    AioContext *lun_ctx;
     int target;
     int ret = 0;
 
@@ -290,6 +350,9 @@ static int virtio_scsi_do_tmf(VirtIOSCSI *s, VirtIOSCSIReq *req)
         if (d->lun != virtio_scsi_get_lun(req->req.tmf.lun)) {
             goto incorrect_lun;
         }
+        /* The requests of the LUN may be processed by another IOThread */
+        lun_ctx = blk_get_aio_context(d->conf.blk);
+        aio_context_acquire(lun_ctx);
         QTAILQ_FOREACH_SAFE(r, &d->requests, next, next) {
             VirtIOSCSIReq *cmd_req = r->hba_private;
             if (cmd_req && cmd_req->req.cmd.tag == req->req.tmf.tag) {
@@ -318,6 +381,7 @@ static int virtio_scsi_do_tmf(VirtIOSCSI *s, VirtIOSCSIReq *req)
                 ret = -EINPROGRESS;
             }
         }
+        aio_context_release(lun_ctx);
         break;
 
     case VIRTIO_SCSI_T_TMF_LOGICAL_UNIT_RESET:
@@ -348,6 +412,8 @@ static int virtio_scsi_do_tmf(VirtIOSCSI *s, VirtIOSCSIReq *req)
          * will not complete the TMF too early.
          */
         req->remaining = 1;
+        lun_ctx = blk_get_aio_context(d->conf.blk);
+        aio_context_acquire(lun_ctx);
         QTAILQ_FOREACH_SAFE(r, &d->requests, next, next) {
             if (r->hba_private) {
                 if (req->req.tmf.subtype == VIRTIO_SCSI_T_TMF_QUERY_TASK_SET) {
@@ -370,6 +436,7 @@ static int virtio_scsi_do_tmf(VirtIOSCSI *s, VirtIOSCSIReq *req)
         if (--req->remaining > 0) {
             ret = -EINPROGRESS;
         }
+        aio_context_release(lun_ctx);
         break;
 
     case VIRTIO_SCSI_T_TMF_I_T_NEXUS_RESET:
@@ -408,6 +475,20 @@ fail:
     return ret;
 }
 
+/* Context: BH in the main loop */
+static void virtio_scsi_tmf_bh(void *opaque)
+{
+    VirtIOSCSIReq *req = opaque;
+    VirtIOSCSI *s = req->dev;
+
+    if (virtio_scsi_do_tmf(s, req) == 0) {
+        virtio_scsi_complete_tmf_req(req);
+    }
+
+    qatomic_dec(&s->bh_in_flight);
+    aio_wait_kick();
+}
+
 static void virtio_scsi_handle_ctrl_req(VirtIOSCSI *s, VirtIOSCSIReq *req)
 {
     VirtIODevice *vdev = (VirtIODevice *)s;
@@ -426,6 +507,15 @@ static void virtio_scsi_handle_ctrl_req(VirtIOSCSI *s, VirtIOSCSIReq *req)
                     sizeof(VirtIOSCSICtrlTMFResp)) < 0) {
             virtio_scsi_bad_req(req);
             return;
+        } else if (s->num_ctxs > 1) {
+            /*
+             * The LUNs live in several IOThreads and resetting them drains
+             * their requests, which only the main loop can do.
+             */
+            qatomic_inc(&s->bh_in_flight);
+            aio_bh_schedule_oneshot(qemu_get_aio_context(),
+                                    virtio_scsi_tmf_bh, req);
+            return;
         } else {
             r = virtio_scsi_do_tmf(s, req);
         }
@@ -446,14 +536,14 @@ static void virtio_scsi_handle_ctrl_req(VirtIOSCSI *s, VirtIOSCSIReq *req)
         }
     }
     if (r == 0) {
-        if (type == VIRTIO_SCSI_T_TMF)
-            trace_virtio_scsi_tmf_resp(virtio_scsi_get_lun(req->req.tmf.lun),
-                                       req->req.tmf.tag,
-                                       req->resp.tmf.response);
-        else if (type == VIRTIO_SCSI_T_AN_QUERY ||
-                 type == VIRTIO_SCSI_T_AN_SUBSCRIBE)
+        if (type == VIRTIO_SCSI_T_TMF) {
+            virtio_scsi_complete_tmf_req(req);
+            return;
+        } else if (type == VIRTIO_SCSI_T_AN_QUERY ||
+                   type == VIRTIO_SCSI_T_AN_SUBSCRIBE) {
             trace_virtio_scsi_an_resp(virtio_scsi_get_lun(req->req.an.lun),
                                       req->resp.an.response);
+        }
         virtio_scsi_complete_req(req);
     } else {
         assert(r == -EINPROGRESS);
@@ -617,6 +707,55 @@ static void virtio_scsi_fail_cmd_req(VirtIOSCSIReq *req)
     virtio_scsi_complete_cmd_req(req);
 }
 
+static int virtio_scsi_cmd_req_new(VirtIOSCSI *s, VirtIOSCSIReq *req,
+                                   SCSIDevice *d)
+{
+    req->sreq = scsi_req_new(d, req->req.cmd.tag,
+                             virtio_scsi_get_lun(req->req.cmd.lun),
+                             req->req.cmd.cdb, req);
+
+    if (req->sreq->cmd.mode != SCSI_XFER_NONE
+        && (req->sreq->cmd.mode != req->mode ||
+            req->sreq->cmd.xfer > req->qsgl.size)) {
+        req->resp.cmd.response = VIRTIO_SCSI_S_OVERRUN;
+        virtio_scsi_complete_cmd_req(req);
+        return -ENOBUFS;
+    }
+    scsi_req_ref(req->sreq);
+    blk_io_plug();
+    return 0;
+}
+
+static void virtio_scsi_handle_cmd_req_submit(VirtIOSCSI *s, VirtIOSCSIReq *req)
+{
+    SCSIRequest *sreq = req->sreq;
+    if (scsi_req_enqueue(sreq)) {
+        scsi_req_continue(sreq);
+    }
+    blk_io_unplug();
+    scsi_req_unref(sreq);
+}
+
+/* Context: BH in the AioContext of the LUN */
+static void virtio_scsi_cmd_req_bh(void *opaque)
+{
+    VirtIOSCSIReq *req = opaque;
+    VirtIOSCSI *s = req->dev;
+    SCSIDevice *d = req->lun_dev;
+    BlockBackend *blk = d->conf.blk;
+    AioContext *ctx = qemu_get_current_aio_context();
+
+    req->lun_dev = NULL;
+    aio_context_acquire(ctx);
+    if (virtio_scsi_cmd_req_new(s, req, d) == 0) {
+        virtio_scsi_handle_cmd_req_submit(s, req);
+    }
+    aio_context_release(ctx);
+
+    blk_dec_in_flight(blk);
+    object_unref(OBJECT(d));
+}
+
 static int virtio_scsi_handle_cmd_req_prepare(VirtIOSCSI *s, VirtIOSCSIReq *req)
 {
     VirtIOSCSICommon *vs = &s->parent_obj;
@@ -644,37 +783,30 @@ static int virtio_scsi_handle_cmd_req_prepare(VirtIOSCSI *s, VirtIOSCSIReq *req)
         return -ENOENT;
     }
     virtio_scsi_ctx_check(s, d);
-    req->sreq = scsi_req_new(d, req->req.cmd.tag,
-                             virtio_scsi_get_lun(req->req.cmd.lun),
-                             req->req.cmd.cdb, req);
 
-    if (req->sreq->cmd.mode != SCSI_XFER_NONE
-        && (req->sreq->cmd.mode != req->mode ||
-            req->sreq->cmd.xfer > req->qsgl.size)) {
-        req->resp.cmd.response = VIRTIO_SCSI_S_OVERRUN;
-        virtio_scsi_complete_cmd_req(req);
-        object_unref(OBJECT(d));
-        return -ENOBUFS;
+    if (s->num_ctxs > 1 &&
+        blk_get_aio_context(d->conf.blk) != qemu_get_current_aio_context()) {
+        /*
+         * The LUN is served by another IOThread, hand the request over.
+         * The in-flight counter keeps drain waiting until it is submitted.
+         */
+        req->lun_dev = d;
+        blk_inc_in_flight(d->conf.blk);
+        aio_bh_schedule_oneshot(blk_get_aio_context(d->conf.blk),
+                                virtio_scsi_cmd_req_bh, req);
+        return -EINPROGRESS;
     }
-    scsi_req_ref(req->sreq);
-    blk_io_plug(d->conf.blk);
-    object_unref(OBJECT(d));
-    return 0;
-}
 
-static void virtio_scsi_handle_cmd_req_submit(VirtIOSCSI *s, VirtIOSCSIReq *req)
-{
-    SCSIRequest *sreq = req->sreq;
-    if (scsi_req_enqueue(sreq)) {
-        scsi_req_continue(sreq);
-    }
-    blk_io_unplug(sreq->dev->conf.blk);
-    scsi_req_unref(sreq);
+    rc = virtio_scsi_cmd_req_new(s, req, d);
+    object_unref(OBJECT(d));
+    return rc;
 }
 
 bool virtio_scsi_handle_cmd_vq(VirtIOSCSI *s, VirtQueue *vq)
 {
     VirtIOSCSIReq *req, *next;
+    VirtIOSCSIReq *batch[VIRTQUEUE_BATCH_SIZE];
+    unsigned int i, n;
     int ret = 0;
     bool suppress_notifications = virtio_queue_get_notification(vq);
     bool progress = false;
@@ -686,17 +818,29 @@ bool virtio_scsi_handle_cmd_vq(VirtIOSCSI *s, VirtQueue *vq)
             virtio_queue_set_notification(vq, 0);
         }
 
-        while ((req = virtio_scsi_pop_req(s, vq))) {
+        while (ret != -EINVAL &&
+               (n = virtio_scsi_pop_reqs(s, vq, batch,
+                                         VIRTQUEUE_BATCH_SIZE))) {
             progress = true;
-            ret = virtio_scsi_handle_cmd_req_prepare(s, req);
-            if (!ret) {
-                QTAILQ_INSERT_TAIL(&reqs, req, next);
-            } else if (ret == -EINVAL) {
+            for (i = 0; i < n; i++) {
+                ret = virtio_scsi_handle_cmd_req_prepare(s, batch[i]);
+                if (!ret) {
+                    QTAILQ_INSERT_TAIL(&reqs, batch[i], next);
+                } else if (ret == -EINVAL) {
+                    break;
+                }
+            }
+            if (ret == -EINVAL) {
                 /* The device is broken and shouldn't process any request */
+                /* Give back the requests that were not looked at yet */
+                while (--n > i) {
+                    virtqueue_unpop(vq, &batch[n]->elem, 0);
+                    virtio_scsi_free_req(batch[n]);
+                }
                 while (!QTAILQ_EMPTY(&reqs)) {
                     req = QTAILQ_FIRST(&reqs);
                     QTAILQ_REMOVE(&reqs, req, next);
-                    blk_io_unplug(req->sreq->dev->conf.blk);
+                    blk_io_unplug();
                     scsi_req_unref(req->sreq);
                     virtqueue_detach_element(req->vq, &req->elem, 0);
                     virtio_scsi_free_req(req);
@@ -893,16 +1037,19 @@ static void virtio_scsi_hotplug(HotplugHandler *hotplug_dev, DeviceState *dev,
     VirtIODevice *vdev = VIRTIO_DEVICE(hotplug_dev);
     VirtIOSCSI *s = VIRTIO_SCSI(vdev);
     SCSIDevice *sd = SCSI_DEVICE(dev);
-    AioContext *old_context;
+    AioContext *old_context, *new_context;
     int ret;
 
     if (s->ctx && !s->dataplane_fenced) {
         if (blk_op_is_blocked(sd->conf.blk, BLOCK_OP_TYPE_DATAPLANE, errp)) {
             return;
         }
+        /* Spread the LUNs over the IOThreads */
+        new_context = s->num_ctxs ?
+                      s->ctxs[s->next_lun_ctx++ % s->num_ctxs] : s->ctx;
         old_context = blk_get_aio_context(sd->conf.blk);
         aio_context_acquire(old_context);
-        ret = blk_set_aio_context(sd->conf.blk, s->ctx, errp);
+        ret = blk_set_aio_context(sd->conf.blk, new_context, errp);
         aio_context_release(old_context);
         if (ret < 0) {
             return;
@@ -925,6 +1072,8 @@ static void virtio_scsi_hotunplug(HotplugHandler *hotplug_dev, DeviceState *dev,
     VirtIOSCSI *s = VIRTIO_SCSI(vdev);
     SCSIDevice *sd = SCSI_DEVICE(dev);
     AioContext *ctx = s->ctx ?: qemu_get_aio_context();
+    AioContext *lun_ctx;
+    unsigned i;
 
     if (virtio_vdev_has_feature(vdev, VIRTIO_SCSI_F_HOTPLUG)) {
         virtio_scsi_acquire(s);
@@ -934,15 +1083,28 @@ static void virtio_scsi_hotunplug(HotplugHandler *hotplug_dev, DeviceState *dev,
         virtio_scsi_release(s);
     }
 
-    aio_disable_external(ctx);
+    if (s->num_ctxs > 1) {
+        for (i = 0; i < s->num_ctxs; i++) {
+            aio_disable_external(s->ctxs[i]);
+        }
+    } else {
+        aio_disable_external(ctx);
+    }
     qdev_simple_device_unplug_cb(hotplug_dev, dev, errp);
-    aio_enable_external(ctx);
+    if (s->num_ctxs > 1) {
+        for (i = 0; i < s->num_ctxs; i++) {
+            aio_enable_external(s->ctxs[i]);
+        }
+    } else {
+        aio_enable_external(ctx);
+    }
 
     if (s->ctx) {
-        virtio_scsi_acquire(s);
+        lun_ctx = blk_get_aio_context(sd->conf.blk);
+        aio_context_acquire(lun_ctx);
         /* If other users keep the BlockBackend in the iothread, that's ok */
         blk_set_aio_context(sd->conf.blk, qemu_get_aio_context(), NULL);
-        virtio_scsi_release(s);
+        aio_context_release(lun_ctx);
     }
 }
 
@@ -1007,7 +1169,9 @@ static void virtio_scsi_device_realize(DeviceState *dev, Error **errp)
 {
     VirtIODevice *vdev = VIRTIO_DEVICE(dev);
     VirtIOSCSI *s = VIRTIO_SCSI(dev);
+    VirtIOSCSICommon *vs = VIRTIO_SCSI_COMMON(dev);
     Error *err = NULL;
+    int i;
 
     virtio_scsi_common_realize(dev,
                                virtio_scsi_handle_ctrl,
@@ -1019,12 +1183,27 @@ static void virtio_scsi_device_realize(DeviceState *dev, Error **errp)
         return;
     }
 
+    /* The pool is sized for the default CDB size, larger ones use malloc */
+    for (i = 0; i < vs->conf.num_queues; i++) {
+        virtio_queue_enable_element_pool(vs->cmd_vqs[i],
+                                         sizeof(VirtIOSCSIReq) +
+                                         VIRTIO_SCSI_CDB_DEFAULT_SIZE);
+    }
+
     scsi_bus_new(&s->bus, sizeof(s->bus), dev,
                  &virtio_scsi_scsi_info, vdev->bus_name);
     /* override default SCSI bus hotplug-handler, with virtio-scsi's one */
     qbus_set_hotplug_handler(BUS(&s->bus), OBJECT(dev));
 
-    virtio_scsi_dataplane_setup(s, errp);
+    virtio_scsi_dataplane_setup(s, &err);
+    if (err != NULL) {
+        error_propagate(errp, err);
+        return;
+    }
+
+    /* Enough coroutines for half of the requests the queues can hold */
+    qemu_coroutine_inc_pool_size(vs->conf.num_queues *
+                                 vs->conf.virtqueue_size / 2);
 }
 
 void virtio_scsi_common_unrealize(DeviceState *dev)
@@ -1045,8 +1224,12 @@ void virtio_scsi_common_unrealize(DeviceState *dev)
 static void virtio_scsi_device_unrealize(DeviceState *dev)
 {
     VirtIOSCSI *s = VIRTIO_SCSI(dev);
+    VirtIOSCSICommon *vs = VIRTIO_SCSI_COMMON(dev);
 
+    qemu_coroutine_dec_pool_size(vs->conf.num_queues *
+                                 vs->conf.virtqueue_size / 2);
     qbus_set_hotplug_handler(BUS(&s->bus), NULL);
+    virtio_scsi_dataplane_cleanup(s);
     virtio_scsi_common_unrealize(dev);
 }
 
@@ -1067,6 +1250,8 @@ static Property virtio_scsi_properties[] = {
                                                 VIRTIO_SCSI_F_CHANGE, true),
     DEFINE_PROP_LINK("iothread", VirtIOSCSI, parent_obj.conf.iothread,
                      TYPE_IOTHREAD, IOThread *),
+    DEFINE_PROP_ARRAY("iothreads", VirtIOSCSI, parent_obj.conf.num_iothreads,
+                      parent_obj.conf.iothreads, qdev_prop_string, char *),
     DEFINE_PROP_END_OF_LIST(),
 };
 
@@ -30,6 +30,8 @@
 #include "qapi/error.h"
 #include "qemu/error-report.h"
 #include "qemu/timer.h"
+#include "qemu/seqlock.h"
+#include "qemu/main-loop.h"
 #include "hw/timer/hpet.h"
 #include "hw/sysbus.h"
 #include "hw/rtc/mc146818rtc.h"
@@ -72,6 +74,11 @@ struct HPETState {
     /*< public >*/
 
     MemoryRegion iomem;
+    /*
+     * The main counter is read without the BQL.  Writers of hpet_offset,
+     * hpet_counter and config hold the BQL and bump counter_lock.
+     */
+    QemuSeqLock counter_lock;
     uint64_t hpet_offset;
     bool hpet_offset_saved;
     qemu_irq irqs[HPET_NUM_IRQ_ROUTES];
@@ -162,6 +169,23 @@ static uint64_t hpet_get_ticks(HPETState *s)
     return ns_to_ticks(qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) + s->hpet_offset);
 }
 
+static uint64_t hpet_read_counter(HPETState *s)
+{
+    uint64_t cur_tick;
+    unsigned start;
+
+    do {
+        start = seqlock_read_begin(&s->counter_lock);
+        if (hpet_enabled(s)) {
+            cur_tick = hpet_get_ticks(s);
+        } else {
+            cur_tick = s->hpet_counter;
+        }
+    } while (seqlock_read_retry(&s->counter_lock, start));
+
+    return cur_tick;
+}
+
 /*
  * calculate diff between comparator value and current ticks
  */
@@ -226,7 +250,9 @@ static int hpet_pre_save(void *opaque)
 
     /* save current counter value */
     if (hpet_enabled(s)) {
+        seqlock_write_begin(&s->counter_lock);
         s->hpet_counter = hpet_get_ticks(s);
+        seqlock_write_end(&s->counter_lock);
     }
 
     return 0;
@@ -259,8 +285,10 @@ static int hpet_post_load(void *opaque, int version_id)
 
     /* Recalculate the offset between the main counter and guest time */
     if (!s->hpet_offset_saved) {
+        seqlock_write_begin(&s->counter_lock);
         s->hpet_offset = ticks_to_ns(s->hpet_counter)
                         - qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
+        seqlock_write_end(&s->counter_lock);
     }
 
     /* Push number of timers into capability returned via HPET_ID */
@@ -417,11 +445,9 @@ static void hpet_del_timer(HPETTimer *t)
     update_irq(t, 0);
 }
 
-static uint64_t hpet_ram_read(void *opaque, hwaddr addr,
-                              unsigned size)
+static uint64_t hpet_ram_read_locked(HPETState *s, hwaddr addr)
 {
-    HPETState *s = opaque;
-    uint64_t cur_tick, index;
+    uint64_t index;
 
     DPRINTF("qemu: Enter hpet_ram_readl at %" PRIx64 "\n", addr);
     index = addr;
@@ -463,22 +489,6 @@ static uint64_t hpet_ram_read(void *opaque, hwaddr addr,
         case HPET_CFG + 4:
             DPRINTF("qemu: invalid HPET_CFG + 4 hpet_ram_readl\n");
             return 0;
-        case HPET_COUNTER:
-            if (hpet_enabled(s)) {
-                cur_tick = hpet_get_ticks(s);
-            } else {
-                cur_tick = s->hpet_counter;
-            }
-            DPRINTF("qemu: reading counter  = %" PRIx64 "\n", cur_tick);
-            return cur_tick;
-        case HPET_COUNTER + 4:
-            if (hpet_enabled(s)) {
-                cur_tick = hpet_get_ticks(s);
-            } else {
-                cur_tick = s->hpet_counter;
-            }
-            DPRINTF("qemu: reading counter + 4  = %" PRIx64 "\n", cur_tick);
-            return cur_tick >> 32;
         case HPET_STATUS:
             return s->isr;
         default:
@@ -489,17 +499,41 @@ static uint64_t hpet_ram_read(void *opaque, hwaddr addr,
     return 0;
 }
 
-static void hpet_ram_write(void *opaque, hwaddr addr,
-                           uint64_t value, unsigned size)
+static uint64_t hpet_ram_read(void *opaque, hwaddr addr,
+                              unsigned size)
 {
-    int i;
     HPETState *s = opaque;
+    bool locked = false;
+    uint64_t val;
+
+    /* Guests poll the main counter, keep it off the BQL */
+    if (addr == HPET_COUNTER || addr == HPET_COUNTER + 4) {
+        val = hpet_read_counter(s);
+        DPRINTF("qemu: reading counter%s = %" PRIx64 "\n",
+                addr == HPET_COUNTER ? "" : " + 4", val);
+        return addr == HPET_COUNTER ? val : val >> 32;
+    }
+
+    if (!qemu_mutex_iothread_locked()) {
+        qemu_mutex_lock_iothread();
+        locked = true;
+    }
+    val = hpet_ram_read_locked(s, addr);
+    if (locked) {
+        qemu_mutex_unlock_iothread();
+    }
+    return val;
+}
+
+static void hpet_ram_write_locked(HPETState *s, hwaddr addr, uint64_t value)
+{
+    int i;
     uint64_t old_val, new_val, val, index;
 
     DPRINTF("qemu: Enter hpet_ram_writel at %" PRIx64 " = 0x%" PRIx64 "\n",
             addr, value);
     index = addr;
-    old_val = hpet_ram_read(opaque, addr, 4);
+    old_val = hpet_ram_read(s, addr, 4);
     new_val = value;
 
     /*address range of all TN regs*/
@@ -593,11 +627,17 @@ static void hpet_ram_write(void *opaque, hwaddr addr,
             return;
         case HPET_CFG:
             val = hpet_fixup_reg(new_val, old_val, HPET_CFG_WRITE_MASK);
+            seqlock_write_begin(&s->counter_lock);
             s->config = (s->config & 0xffffffff00000000ULL) | val;
             if (activating_bit(old_val, new_val, HPET_CFG_ENABLE)) {
-                /* Enable main counter and interrupt generation. */
                 s->hpet_offset =
                     ticks_to_ns(s->hpet_counter) - qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
+            } else if (deactivating_bit(old_val, new_val, HPET_CFG_ENABLE)) {
+                s->hpet_counter = hpet_get_ticks(s);
+            }
+            seqlock_write_end(&s->counter_lock);
+            if (activating_bit(old_val, new_val, HPET_CFG_ENABLE)) {
+                /* Enable main counter and interrupt generation. */
                 for (i = 0; i < s->num_timers; i++) {
                     if ((&s->timer[i])->cmp != ~0ULL) {
                         hpet_set_timer(&s->timer[i]);
@@ -605,7 +645,6 @@ static void hpet_ram_write(void *opaque, hwaddr addr,
                 }
             } else if (deactivating_bit(old_val, new_val, HPET_CFG_ENABLE)) {
                 /* Halt main counter and disable interrupt generation. */
-                s->hpet_counter = hpet_get_ticks(s);
                 for (i = 0; i < s->num_timers; i++) {
                     hpet_del_timer(&s->timer[i]);
                 }
@@ -637,8 +676,10 @@ static void hpet_ram_write(void *opaque, hwaddr addr,
             if (hpet_enabled(s)) {
                 DPRINTF("qemu: Writing counter while HPET enabled!\n");
             }
+            seqlock_write_begin(&s->counter_lock);
             s->hpet_counter =
                 (s->hpet_counter & 0xffffffff00000000ULL) | value;
+            seqlock_write_end(&s->counter_lock);
             DPRINTF("qemu: HPET counter written. ctr = 0x%" PRIx64 " -> "
                     "%" PRIx64 "\n", value, s->hpet_counter);
             break;
@@ -646,8 +687,10 @@ static void hpet_ram_write(void *opaque, hwaddr addr,
             if (hpet_enabled(s)) {
                 DPRINTF("qemu: Writing counter while HPET enabled!\n");
             }
+            seqlock_write_begin(&s->counter_lock);
             s->hpet_counter =
                 (s->hpet_counter & 0xffffffffULL) | (((uint64_t)value) << 32);
+            seqlock_write_end(&s->counter_lock);
             DPRINTF("qemu: HPET counter + 4 written. ctr = 0x%" PRIx64 " -> "
                     "%" PRIx64 "\n", value, s->hpet_counter);
             break;
@@ -658,6 +701,21 @@ static void hpet_ram_write(void *opaque, hwaddr addr,
     }
 }
 
+static void hpet_ram_write(void *opaque, hwaddr addr,
+                           uint64_t value, unsigned size)
+{
+    bool locked = false;
+
+    if (!qemu_mutex_iothread_locked()) {
+        qemu_mutex_lock_iothread();
+        locked = true;
+    }
+    hpet_ram_write_locked(opaque, addr, value);
+    if (locked) {
+        qemu_mutex_unlock_iothread();
+    }
+}
+
 static const MemoryRegionOps hpet_ram_ops = {
     .read = hpet_ram_read,
     .write = hpet_ram_write,
@@ -690,9 +748,11 @@ static void hpet_reset(DeviceState *d)
     }
 
     qemu_set_irq(s->pit_enabled, 1);
+    seqlock_write_begin(&s->counter_lock);
     s->hpet_counter = 0ULL;
     s->hpet_offset = 0ULL;
     s->config = 0ULL;
+    seqlock_write_end(&s->counter_lock);
     hpet_cfg.hpet[s->hpet_id].event_timer_block_id = (uint32_t)s->capability;
     hpet_cfg.hpet[s->hpet_id].address = sbd->mmio[0].addr;
 
@@ -722,7 +782,9 @@ static void hpet_init(Object *obj)
     HPETState *s = HPET(obj);
 
     /* HPET Area */
+    seqlock_init(&s->counter_lock);
     memory_region_init_io(&s->iomem, obj, &hpet_ram_ops, s, "hpet", HPET_LEN);
+    memory_region_clear_global_locking(&s->iomem);
     sysbus_init_mmio(sbd, &s->iomem);
 }
 
@@ -30,12 +30,15 @@
 #include "exec/address-spaces.h"
 #include "exec/memory.h"
 #include "exec/ram_addr.h"
+#include "hw/boards.h"
 #include "hw/hw.h"
 #include "qemu/error-report.h"
 #include "qemu/main-loop.h"
 #include "qemu/range.h"
+#include "qemu/units.h"
 #include "sysemu/kvm.h"
 #include "sysemu/reset.h"
+#include "sysemu/runstate.h"
 #include "trace.h"
 #include "qapi/error.h"
 #include "migration/migration.h"
@@ -496,6 +499,35 @@ static int vfio_dma_map(VFIOContainer *container, hwaddr iova,
     return -errno;
 }
 
+/* Smaller sections are not worth starting threads for */
+#define VFIO_DMA_PREFAULT_MIN_SIZE (256 * MiB)
+
+/*
+ * VFIO_IOMMU_MAP_DMA faults in the pages it pins from a single thread,
+ * which dominates the time to map a large guest.  While the VM is not
+ * running, fault in big sections beforehand with several threads, so that
+ * the kernel only has to pin pages that are already present.
+ */
+static void vfio_dma_prefault(MemoryRegion *mr, void *vaddr, ram_addr_t size)
+{
+    size_t pagesize = qemu_ram_pagesize(mr->ram_block);
+    void *start = QEMU_ALIGN_PTR_DOWN(vaddr, pagesize);
+    Error *local_err = NULL;
+
+    if (size < VFIO_DMA_PREFAULT_MIN_SIZE || runstate_is_running()) {
+        return;
+    }
+
+    size = ROUND_UP(size + (vaddr - start), pagesize);
+    trace_vfio_dma_prefault(start, size);
+    os_mem_prealloc(memory_region_get_fd(mr), start, size,
+                    current_machine->smp.cpus, NULL, 0, false, &local_err);
+    if (local_err) {
+        /* VFIO_IOMMU_MAP_DMA will do it, or report the failure */
+        warn_report_err(local_err);
+    }
+}
+
 static void vfio_host_win_add(VFIOContainer *container,
                               hwaddr min_iova, hwaddr max_iova,
                               uint64_t iova_pgsizes)
@@ -831,6 +863,10 @@ static void vfio_listener_region_add(MemoryListener *listener,
         }
     }
 
+    if (!memory_region_is_ram_device(section->mr)) {
+        vfio_dma_prefault(section->mr, vaddr, int128_get64(llsize));
+    }
+
     ret = vfio_dma_map(container, iova, int128_get64(llsize),
                        vaddr, section->readonly);
     if (ret) {
@@ -17,6 +17,7 @@
 #include "hw/vfio/vfio-common.h"
 #include "cpu.h"
 #include "migration/migration.h"
+#include "migration/savevm.h"
 #include "migration/vmstate.h"
 #include "migration/qemu-file.h"
 #include "migration/register.h"
@@ -39,14 +40,26 @@
  * The beginning of state information is marked by _DEV_CONFIG_STATE,
  * _DEV_SETUP_STATE, or _DEV_DATA_STATE, respectively. The end of a
  * certain state information is marked by _END_OF_STATE.
+ *
+ * With switchover-ack, _DEV_INIT_DATA_SENT follows the last pre-copy data
+ * of the device, so that the destination can approve the switchover once
+ * it has loaded it.
  */
 #define VFIO_MIG_FLAG_END_OF_STATE      (0xffffffffef100001ULL)
 #define VFIO_MIG_FLAG_DEV_CONFIG_STATE  (0xffffffffef100002ULL)
 #define VFIO_MIG_FLAG_DEV_SETUP_STATE   (0xffffffffef100003ULL)
 #define VFIO_MIG_FLAG_DEV_DATA_STATE    (0xffffffffef100004ULL)
+#define VFIO_MIG_FLAG_DEV_INIT_DATA_SENT (0xffffffffef100005ULL)
 
 static int64_t bytes_transferred;
 
+/* Device data read ahead during stop-and-copy, in migration stream order */
+typedef struct VFIOSaveChunk {
+    QSIMPLEQ_ENTRY(VFIOSaveChunk) next;
+    uint64_t size;
+    uint8_t data[];
+} VFIOSaveChunk;
+
 static inline int vfio_mig_access(VFIODevice *vbasedev, void *val, int count,
                                   off_t off, bool iswrite)
 {
@@ -98,6 +111,38 @@ static int vfio_mig_rw(VFIODevice *vbasedev, __u8 *buf, size_t count,
 #define vfio_mig_read(f, v, c, o)       vfio_mig_rw(f, (__u8 *)v, c, o, false)
 #define vfio_mig_write(f, v, c, o)      vfio_mig_rw(f, (__u8 *)v, c, o, true)
 
+/*
+ * Unlike the registers of struct vfio_device_migration_info, the data section
+ * does not need naturally aligned accesses: move it with as few system calls
+ * as possible.
+ */
+static int vfio_mig_data_rw(VFIODevice *vbasedev, void *buf, uint64_t count,
+                            off_t off, bool iswrite)
+{
+    uint8_t *tbuf = buf;
+
+    while (count) {
+        ssize_t ret;
+
+        ret = iswrite ? pwrite(vbasedev->fd, tbuf, count, off) :
+                        pread(vbasedev->fd, tbuf, count, off);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret <= 0) {
+            error_report("vfio_mig_%s data %s: failed at offset 0x%"
+                         HWADDR_PRIx", err: %s", iswrite ? "write" : "read",
+                         vbasedev->name, off, strerror(errno));
+            return ret < 0 ? -errno : -EINVAL;
+        }
+
+        count -= ret;
+        off += ret;
+        tbuf += ret;
+    }
+    return 0;
+}
+
 #define VFIO_MIG_STRUCT_OFFSET(f)       \
                                  offsetof(struct vfio_device_migration_info, f)
 /*
@@ -234,8 +279,8 @@ static int vfio_save_buffer(QEMUFile *f, VFIODevice *vbasedev, uint64_t *size)
             }
             buf_allocated = true;
 
-            ret = vfio_mig_read(vbasedev, buf, sec_size,
-                                region->fd_offset + data_offset);
+            ret = vfio_mig_data_rw(vbasedev, buf, sec_size,
+                                   region->fd_offset + data_offset, false);
             if (ret < 0) {
                 g_free(buf);
                 return ret;
@@ -310,8 +355,8 @@ static int vfio_load_buffer(QEMUFile *f, VFIODevice *vbasedev,
             qemu_get_buffer(f, buf, sec_size);
 
             if (buf_alloc) {
-                ret = vfio_mig_write(vbasedev, buf, sec_size,
-                        region->fd_offset + data_offset);
+                ret = vfio_mig_data_rw(vbasedev, buf, sec_size,
+                                       region->fd_offset + data_offset, true);
                 g_free(buf);
 
                 if (ret < 0) {
@@ -351,6 +396,155 @@ static int vfio_update_pending(VFIODevice *vbasedev)
     return 0;
 }
 
+static int vfio_read_data(VFIODevice *vbasedev, uint64_t data_offset,
+                          uint8_t *buf, uint64_t data_size)
+{
+    VFIORegion *region = &vbasedev->migration->region;
+    uint64_t sec_size;
+    void *ptr;
+    int ret;
+
+    while (data_size) {
+        ptr = get_data_section_size(region, data_offset, data_size, &sec_size);
+        if (ptr) {
+            memcpy(buf, ptr, sec_size);
+        } else {
+            ret = vfio_mig_data_rw(vbasedev, buf, sec_size,
+                                   region->fd_offset + data_offset, false);
+            if (ret < 0) {
+                return ret;
+            }
+        }
+        buf += sec_size;
+        data_offset += sec_size;
+        data_size -= sec_size;
+    }
+    return 0;
+}
+
+/*
+ * With x-migration-parallel-save, the stop-and-copy state of each device is
+ * drained into memory by its own thread as soon as the VM stops.  Devices
+ * are then read concurrently with each other and with the RAM still being
+ * sent, instead of one after the other from vfio_save_complete_precopy(),
+ * which only has to copy the buffers into the migration stream.
+ */
+static void *vfio_save_thread(void *opaque)
+{
+    VFIODevice *vbasedev = opaque;
+    VFIOMigration *migration = vbasedev->migration;
+    VFIORegion *region = &migration->region;
+    uint64_t data_offset, data_size, total = 0;
+    VFIOSaveChunk *chunk;
+    int ret;
+
+    for (;;) {
+        ret = vfio_update_pending(vbasedev);
+        if (ret || !migration->pending_bytes) {
+            break;
+        }
+
+        ret = vfio_mig_read(vbasedev, &data_offset, sizeof(data_offset),
+                      region->fd_offset + VFIO_MIG_STRUCT_OFFSET(data_offset));
+        if (ret < 0) {
+            break;
+        }
+        ret = vfio_mig_read(vbasedev, &data_size, sizeof(data_size),
+                        region->fd_offset + VFIO_MIG_STRUCT_OFFSET(data_size));
+        if (ret < 0) {
+            break;
+        }
+        ret = 0;
+        if (!data_size) {
+            break;
+        }
+
+        chunk = g_try_malloc(sizeof(*chunk) + data_size);
+        if (!chunk) {
+            ret = -ENOMEM;
+            break;
+        }
+        chunk->size = data_size;
+        ret = vfio_read_data(vbasedev, data_offset, chunk->data, data_size);
+        if (ret < 0) {
+            g_free(chunk);
+            break;
+        }
+
+        trace_vfio_save_thread_chunk(vbasedev->name, data_offset, data_size);
+        QSIMPLEQ_INSERT_TAIL(&migration->save_chunks, chunk, next);
+        total += data_size;
+    }
+
+    trace_vfio_save_thread_done(vbasedev->name, ret, total);
+    migration->save_thread_ret = ret;
+    return NULL;
+}
+
+static void vfio_save_thread_start(VFIODevice *vbasedev)
+{
+    VFIOMigration *migration = vbasedev->migration;
+
+    migration->save_thread_ret = 0;
+    migration->save_thread_started = true;
+    qemu_thread_create(&migration->save_thread, "vfio-save", vfio_save_thread,
+                       vbasedev, QEMU_THREAD_JOINABLE);
+}
+
+/* Wait for the save thread, if any; the data it read stays queued. */
+static int vfio_save_thread_join(VFIODevice *vbasedev)
+{
+    VFIOMigration *migration = vbasedev->migration;
+
+    if (!migration->save_thread_started) {
+        return 0;
+    }
+    qemu_thread_join(&migration->save_thread);
+    migration->save_thread_started = false;
+    return migration->save_thread_ret;
+}
+
+static void vfio_save_chunks_free(VFIOMigration *migration)
+{
+    VFIOSaveChunk *chunk;
+
+    while ((chunk = QSIMPLEQ_FIRST(&migration->save_chunks))) {
+        QSIMPLEQ_REMOVE_HEAD(&migration->save_chunks, next);
+        g_free(chunk);
+    }
+}
+
+static void vfio_save_thread_cancel(VFIODevice *vbasedev)
+{
+    vfio_save_thread_join(vbasedev);
+    vfio_save_chunks_free(vbasedev->migration);
+}
+
+static int vfio_save_prefetched(QEMUFile *f, VFIODevice *vbasedev)
+{
+    VFIOMigration *migration = vbasedev->migration;
+    VFIOSaveChunk *chunk;
+    int ret;
+
+    ret = vfio_save_thread_join(vbasedev);
+    if (ret) {
+        error_report("%s: Failed to read device state: %s", vbasedev->name,
+                     strerror(-ret));
+        vfio_save_chunks_free(migration);
+        return ret;
+    }
+
+    while ((chunk = QSIMPLEQ_FIRST(&migration->save_chunks))) {
+        QSIMPLEQ_REMOVE_HEAD(&migration->save_chunks, next);
+        qemu_put_be64(f, VFIO_MIG_FLAG_DEV_DATA_STATE);
+        qemu_put_be64(f, chunk->size);
+        qemu_put_buffer(f, chunk->data, chunk->size);
+        bytes_transferred += chunk->size;
+        g_free(chunk);
+    }
+    return 0;
+}
+
 static int vfio_save_device_config_state(QEMUFile *f, void *opaque)
 {
     VFIODevice *vbasedev = opaque;
@@ -414,6 +608,7 @@ static int vfio_save_setup(QEMUFile *f, void *opaque)
 
     trace_vfio_save_setup(vbasedev->name);
 
+    migration->initial_data_sent = false;
     qemu_put_be64(f, VFIO_MIG_FLAG_DEV_SETUP_STATE);
 
     if (migration->region.mmaps) {
@@ -453,6 +648,7 @@ static void vfio_save_cleanup(void *opaque)
 {
     VFIODevice *vbasedev = opaque;
 
+    vfio_save_thread_cancel(vbasedev);
     vfio_migration_cleanup(vbasedev);
     trace_vfio_save_cleanup(vbasedev->name);
 }
@@ -478,6 +674,18 @@ static void vfio_save_pending(QEMUFile *f, void *opaque,
                             *res_postcopy_only, *res_compatible);
 }
 
+/*
+ * The v1 migration region only reports the pre-copy data while the device
+ * is running, the size of what is left for the stop-and-copy phase comes
+ * from the x-migration-stop-copy-size property.
+ */
+static uint64_t vfio_save_stop_copy_size(void *opaque)
+{
+    VFIODevice *vbasedev = opaque;
+
+    return vbasedev->migration_stop_copy_size;
+}
+
 static int vfio_save_iterate(QEMUFile *f, void *opaque)
 {
     VFIODevice *vbasedev = opaque;
@@ -495,6 +703,10 @@ static int vfio_save_iterate(QEMUFile *f, void *opaque)
 
         if (migration->pending_bytes == 0) {
             qemu_put_be64(f, 0);
+            if (migrate_switchover_ack() && !migration->initial_data_sent) {
+                qemu_put_be64(f, VFIO_MIG_FLAG_DEV_INIT_DATA_SENT);
+                migration->initial_data_sent = true;
+            }
             qemu_put_be64(f, VFIO_MIG_FLAG_END_OF_STATE);
             /* indicates data finished, goto complete phase */
             return 1;
@@ -532,6 +744,15 @@ static int vfio_save_complete_precopy(QEMUFile *f, void *opaque)
     uint64_t data_size;
     int ret;
 
+    if (migration->save_thread_started) {
+        /* Already in the STOP and SAVING state, see vfio_vmstate_change() */
+        ret = vfio_save_prefetched(f, vbasedev);
+        if (ret) {
+            return ret;
+        }
+        goto done;
+    }
+
     ret = vfio_migration_set_state(vbasedev, ~VFIO_DEVICE_STATE_RUNNING,
                                    VFIO_DEVICE_STATE_SAVING);
     if (ret) {
@@ -563,6 +784,7 @@ static int vfio_save_complete_precopy(QEMUFile *f, void *opaque)
         }
     }
 
+done:
     qemu_put_be64(f, VFIO_MIG_FLAG_END_OF_STATE);
 
     ret = qemu_file_get_error(f);
@@ -669,6 +891,23 @@ static int vfio_load_state(QEMUFile *f, void *opaque, int version_id)
             }
             break;
         }
+        case VFIO_MIG_FLAG_DEV_INIT_DATA_SENT:
+        {
+            if (!migrate_switchover_ack()) {
+                error_report("%s: Received INIT_DATA_SENT but switchover ack "
+                             "is not used", vbasedev->name);
+                return -EINVAL;
+            }
+
+            ret = qemu_loadvm_approve_switchover();
+            if (ret) {
+                error_report("%s: qemu_loadvm_approve_switchover failed, "
+                             "err=%d (%s)", vbasedev->name, ret,
+                             strerror(-ret));
+                return ret;
+            }
+            break;
+        }
         default:
             error_report("%s: Unknown tag 0x%"PRIx64, vbasedev->name, data);
             return -EINVAL;
@@ -683,16 +922,23 @@ static int vfio_load_state(QEMUFile *f, void *opaque, int version_id)
     return ret;
 }
 
+static bool vfio_switchover_ack_needed(void *opaque)
+{
+    return true;
+}
+
 static SaveVMHandlers savevm_vfio_handlers = {
     .save_setup = vfio_save_setup,
     .save_cleanup = vfio_save_cleanup,
     .save_live_pending = vfio_save_pending,
+    .save_stop_copy_size = vfio_save_stop_copy_size,
     .save_live_iterate = vfio_save_iterate,
     .save_live_complete_precopy = vfio_save_complete_precopy,
     .save_state = vfio_save_state,
     .load_setup = vfio_load_setup,
     .load_cleanup = vfio_load_cleanup,
     .load_state = vfio_load_state,
+    .switchover_ack_needed = vfio_switchover_ack_needed,
 };
 
 /* ---------------------------------------------------------------------- */
@@ -709,6 +955,9 @@ static void vfio_vmstate_change(void *opaque, bool running, RunState state)
     }
 
     if (running) {
+        /* A failed migration may leave a save thread behind */
+        vfio_save_thread_cancel(vbasedev);
+
         /*
          * Here device state can have one of _SAVING, _RESUMING or _STOP bit.
          * Transition from _SAVING to _RUNNING can happen if there is migration
@@ -737,6 +986,10 @@ static void vfio_vmstate_change(void *opaque, bool running, RunState state)
         error_report("%s: Failed to set device state 0x%x", vbasedev->name,
                      (migration->device_state & mask) | value);
         qemu_file_set_error(migrate_get_current()->to_dst_file, ret);
+    } else if (state == RUN_STATE_FINISH_MIGRATE &&
+               vbasedev->migration_parallel_save &&
+               (migration->device_state & VFIO_DEVICE_STATE_SAVING)) {
+        vfio_save_thread_start(vbasedev);
     }
     vbasedev->migration->vm_running = running;
     trace_vfio_vmstate_change(vbasedev->name, running, RunState_str(state),
@@ -759,6 +1012,7 @@ static void vfio_migration_state_notifier(Notifier *notifier, void *data)
     case MIGRATION_STATUS_CANCELLED:
     case MIGRATION_STATUS_FAILED:
         bytes_transferred = 0;
+        vfio_save_thread_cancel(vbasedev);
         ret = vfio_migration_set_state(vbasedev,
                       ~(VFIO_DEVICE_STATE_SAVING | VFIO_DEVICE_STATE_RESUMING),
                       VFIO_DEVICE_STATE_RUNNING);
@@ -815,6 +1069,7 @@ static int vfio_migration_init(VFIODevice *vbasedev,
 
     migration = vbasedev->migration;
     migration->vbasedev = vbasedev;
+    QSIMPLEQ_INIT(&migration->save_chunks);
 
     oid = vmstate_if_get_id(VMSTATE_IF(DEVICE(obj)));
     if (oid) {
@@ -3200,6 +3200,10 @@ static Property vfio_pci_dev_properties[] = {
     DEFINE_PROP_ON_OFF_AUTO("x-pre-copy-dirty-page-tracking", VFIOPCIDevice,
                             vbasedev.pre_copy_dirty_page_tracking,
                             ON_OFF_AUTO_ON),
+    DEFINE_PROP_SIZE("x-migration-stop-copy-size", VFIOPCIDevice,
+                     vbasedev.migration_stop_copy_size, 0),
+    DEFINE_PROP_BOOL("x-migration-parallel-save", VFIOPCIDevice,
+                     vbasedev.migration_parallel_save, false),
     DEFINE_PROP_ON_OFF_AUTO("display", VFIOPCIDevice,
                             display, ON_OFF_AUTO_OFF),
     DEFINE_PROP_UINT32("xres", VFIOPCIDevice, display_xres, 0),
@@ -0,0 +1,651 @@
+/*
+ * vhost shadow virtqueue
+ *
+ * A shadow virtqueue sits between the guest's virtqueue and a vhost device.
+ * QEMU pops the guest's available buffers and exposes them to the device
+ * through a ring of its own, and returns the buffers the device used to the
+ * guest.  Since QEMU writes the used buffers back through the regular
+ * VirtQueue code, the guest pages they touch are marked dirty, which lets
+ * devices that cannot log their writes be migrated.
+ *
+ * Only split rings are supported.  The device sees every buffer as a chain
+ * of direct descriptors, whose addresses are the guest DMA addresses of the
+ * buffers.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/error-report.h"
+#include "qemu/main-loop.h"
+#include "qemu/processor.h"
+#include "standard-headers/linux/virtio_ring.h"
+#include "hw/virtio/vhost-shadow-virtqueue.h"
+
+/* How long vhost_svq_poll() waits for the device, in microseconds */
+#define VHOST_SVQ_POLL_TIMEOUT_US (30 * G_USEC_PER_SEC)
+
+typedef struct SVQDescState {
+    /* The guest element, or NULL for a buffer added by vhost_svq_inject() */
+    VirtQueueElement *elem;
+    /* Number of descriptors of the chain, 0 if the head is not in use */
+    unsigned int ndescs;
+} SVQDescState;
+
+struct VhostShadowVirtqueue {
+    /* The shadow ring exposed to the device */
+    struct vring vring;
+
+    /* Guest kicks, that is the host notifier of the guest's virtqueue */
+    EventNotifier svq_kick;
+    /* Guest call notifier, or -1 */
+    EventNotifier svq_call;
+    /* QEMU kicks the device through this one */
+    EventNotifier hdev_kick;
+    /* The device signals used buffers through this one */
+    EventNotifier hdev_call;
+
+    VirtIODevice *vdev;
+    VirtQueue *vq;
+    bool started;
+
+    const VhostShadowVirtqueueOps *ops;
+    void *ops_opaque;
+
+    /* Per descriptor chain head state */
+    SVQDescState *desc_state;
+    /* Guest element that did not fit in the shadow ring yet */
+    VirtQueueElement *next_guest_avail_elem;
+
+    uint16_t free_head;
+    unsigned int num_free;
+    /* Next available index to expose to the device */
+    uint16_t shadow_avail_idx;
+    /* Last used index read from the device */
+    uint16_t shadow_used_idx;
+    /* Next used index to process */
+    uint16_t last_used_idx;
+};
+
+int vhost_svq_get_dev_kick_notifier(const VhostShadowVirtqueue *svq)
+{
+    return event_notifier_get_fd(&svq->hdev_kick);
+}
+
+int vhost_svq_get_dev_call_notifier(const VhostShadowVirtqueue *svq)
+{
+    return event_notifier_get_fd(&svq->hdev_call);
+}
+
+/**
+ * vhost_svq_set_guest_call_notifier:
+ * @svq: The shadow virtqueue
+ * @call_fd: The guest notifier (or -1), as passed to VHOST_SET_VRING_CALL
+ *
+ * The file descriptor is owned by the caller.
+ */
+void vhost_svq_set_guest_call_notifier(VhostShadowVirtqueue *svq, int call_fd)
+{
+    event_notifier_init_fd(&svq->svq_call, call_fd);
+}
+
+size_t vhost_svq_driver_area_size(const VhostShadowVirtqueue *svq)
+{
+    size_t desc_size = sizeof(struct vring_desc) * svq->vring.num;
+    size_t avail_size = offsetof(struct vring_avail, ring) +
+                        sizeof(uint16_t) * (svq->vring.num + 1);
+
+    return ROUND_UP(desc_size + avail_size, qemu_real_host_page_size);
+}
+
+size_t vhost_svq_device_area_size(const VhostShadowVirtqueue *svq)
+{
+    size_t used_size = offsetof(struct vring_used, ring) +
+                       sizeof(struct vring_used_elem) * svq->vring.num +
+                       sizeof(uint16_t);
+
+    return ROUND_UP(used_size, qemu_real_host_page_size);
+}
+
+/**
+ * vhost_svq_get_vring_addr:
+ * @svq: The shadow virtqueue
+ * @addr: Filled with the host virtual addresses of the shadow ring areas
+ *
+ * The descriptor table and the available ring share the driver area, which
+ * the device only reads, while the device area holds the used ring.
+ */
+void vhost_svq_get_vring_addr(const VhostShadowVirtqueue *svq,
+                              struct vhost_vring_addr *addr)
+{
+    addr->desc_user_addr = (uint64_t)(uintptr_t)svq->vring.desc;
+    addr->avail_user_addr = (uint64_t)(uintptr_t)svq->vring.avail;
+    addr->used_user_addr = (uint64_t)(uintptr_t)svq->vring.used;
+}
+
+static void vhost_svq_free_rings(VhostShadowVirtqueue *svq)
+{
+    if (svq->vring.desc) {
+        qemu_vfree(svq->vring.desc);
+        qemu_vfree(svq->vring.used);
+        g_free(svq->desc_state);
+    }
+    svq->vring.desc = NULL;
+    svq->vring.avail = NULL;
+    svq->vring.used = NULL;
+    svq->desc_state = NULL;
+}
+
+/**
+ * vhost_svq_set_num:
+ * @svq: The shadow virtqueue, which must be stopped
+ * @num: Size of the guest's virtqueue
+ *
+ * Size the shadow ring like the guest ring.
+ */
+void vhost_svq_set_num(VhostShadowVirtqueue *svq, unsigned int num)
+{
+    size_t driver_size, device_size;
+
+    assert(!svq->started);
+    assert(is_power_of_2(num) && num <= VIRTQUEUE_MAX_SIZE);
+
+    if (svq->vring.desc && svq->vring.num == num) {
+        return;
+    }
+    vhost_svq_free_rings(svq);
+
+    svq->vring.num = num;
+    driver_size = vhost_svq_driver_area_size(svq);
+    device_size = vhost_svq_device_area_size(svq);
+    svq->vring.desc = qemu_memalign(qemu_real_host_page_size, driver_size);
+    svq->vring.avail = (void *)((char *)svq->vring.desc +
+                                sizeof(struct vring_desc) * num);
+    svq->vring.used = qemu_memalign(qemu_real_host_page_size, device_size);
+    svq->desc_state = g_new0(SVQDescState, num);
+}
+
+bool vhost_svq_started(const VhostShadowVirtqueue *svq)
+{
+    return svq->started;
+}
+
+static bool vhost_svq_more_used(VhostShadowVirtqueue *svq)
+{
+    if (svq->last_used_idx != svq->shadow_used_idx) {
+        return true;
+    }
+
+    svq->shadow_used_idx = le16_to_cpu(qatomic_read(&svq->vring.used->idx));
+    return svq->last_used_idx != svq->shadow_used_idx;
+}
+
+static void vhost_svq_disable_notification(VhostShadowVirtqueue *svq)
+{
+    svq->vring.avail->flags |= cpu_to_le16(VRING_AVAIL_F_NO_INTERRUPT);
+}
+
+/*
+ * Ask the device to signal the next used buffer, with or without
+ * VIRTIO_RING_F_EVENT_IDX.  Returns false if there are used buffers to
+ * process already.
+ */
+static bool vhost_svq_enable_notification(VhostShadowVirtqueue *svq)
+{
+    svq->vring.avail->flags &= ~cpu_to_le16(VRING_AVAIL_F_NO_INTERRUPT);
+    vring_used_event(&svq->vring) = cpu_to_le16(svq->last_used_idx);
+
+    /* Make sure the event is published before reading the used index */
+    smp_mb();
+    return !vhost_svq_more_used(svq);
+}
+
+static void vhost_svq_kick(VhostShadowVirtqueue *svq)
+{
+    bool needs_kick;
+
+    /* Expose the available entries before checking the device's event */
+    smp_mb();
+
+    if (virtio_vdev_has_feature(svq->vdev, VIRTIO_RING_F_EVENT_IDX)) {
+        uint16_t avail_event = le16_to_cpu(vring_avail_event(&svq->vring));
+
+        needs_kick = vring_need_event(avail_event, svq->shadow_avail_idx,
+                                      svq->shadow_avail_idx - 1);
+    } else {
+        needs_kick = !(le16_to_cpu(svq->vring.used->flags) &
+                       VRING_USED_F_NO_NOTIFY);
+    }
+
+    if (needs_kick) {
+        event_notifier_set(&svq->hdev_kick);
+    }
+}
+
+/*
+ * Expose a buffer to the device as a chain of @out_num device readable and
+ * @in_num device writable descriptors.  Only the lengths of the iovecs are
+ * used, the addresses come from @out_addr and @in_addr.
+ *
+ * Returns false if the shadow ring has not enough free descriptors.
+ */
+static bool vhost_svq_add(VhostShadowVirtqueue *svq, const hwaddr *out_addr,
+                          const struct iovec *out_sg, size_t out_num,
+                          const hwaddr *in_addr, const struct iovec *in_sg,
+                          size_t in_num, VirtQueueElement *elem)
+{
+    size_t ndescs = out_num + in_num;
+    uint16_t head, i;
+    size_t n;
+
+    if (ndescs == 0 || ndescs > svq->num_free) {
+        return false;
+    }
+
+    head = i = svq->free_head;
+    for (n = 0; n < ndescs; n++) {
+        struct vring_desc *desc = &svq->vring.desc[i];
+        bool write = n >= out_num;
+        uint16_t flags = write ? VRING_DESC_F_WRITE : 0;
+
+        if (n + 1 < ndescs) {
+            flags |= VRING_DESC_F_NEXT;
+        }
+        if (write) {
+            desc->addr = cpu_to_le64(in_addr[n - out_num]);
+            desc->len = cpu_to_le32(in_sg[n - out_num].iov_len);
+        } else {
+            desc->addr = cpu_to_le64(out_addr[n]);
+            desc->len = cpu_to_le32(out_sg[n].iov_len);
+        }
+        desc->flags = cpu_to_le16(flags);
+
+        /* The free list is chained through the next fields */
+        i = le16_to_cpu(desc->next);
+    }
+
+    svq->free_head = i;
+    svq->num_free -= ndescs;
+    svq->desc_state[head].elem = elem;
+    svq->desc_state[head].ndescs = ndescs;
+
+    svq->vring.avail->ring[svq->shadow_avail_idx & (svq->vring.num - 1)] =
+        cpu_to_le16(head);
+    svq->shadow_avail_idx++;
+
+    /* Put the entry in the ring before exposing the new index */
+    smp_wmb();
+    svq->vring.avail->idx = cpu_to_le16(svq->shadow_avail_idx);
+
+    return true;
+}
+
+/* Forward guest available buffers to the device until the ring is full */
+static void vhost_svq_process_kick(VhostShadowVirtqueue *svq)
+{
+    VirtQueue *vq = svq->vq;
+
+    do {
+        virtio_queue_set_notification(vq, false);
+
+        for (;;) {
+            VirtQueueElement *elem = svq->next_guest_avail_elem;
+
+            svq->next_guest_avail_elem = NULL;
+            if (!elem) {
+                elem = virtqueue_pop(vq, sizeof(VirtQueueElement));
+            }
+            if (!elem) {
+                break;
+            }
+
+            if (elem->out_num + elem->in_num > svq->vring.num) {
+                virtio_error(svq->vdev, "Buffer of %u descriptors does not "
+                             "fit in a shadow virtqueue of %u",
+                             elem->out_num + elem->in_num, svq->vring.num);
+                virtqueue_detach_element(vq, elem, 0);
+                virtqueue_element_free(elem);
+                return;
+            }
+
+            if (!vhost_svq_add(svq, elem->out_addr, elem->out_sg,
+                               elem->out_num, elem->in_addr, elem->in_sg,
+                               elem->in_num, elem)) {
+                /* Resumed from vhost_svq_flush() once the device used some */
+                svq->next_guest_avail_elem = elem;
+                return;
+            }
+
+            vhost_svq_kick(svq);
+        }
+
+        virtio_queue_set_notification(vq, true);
+    } while (!virtio_queue_empty(vq));
+}
+
+static void vhost_handle_guest_kick(EventNotifier *n)
+{
+    VhostShadowVirtqueue *svq = container_of(n, VhostShadowVirtqueue,
+                                             svq_kick);
+
+    event_notifier_test_and_clear(n);
+    vhost_svq_process_kick(svq);
+}
+
+/*
+ * Take the next used buffer from the device.  Returns false if there is
+ * none or the device misbehaved; *elem is NULL for an injected buffer.
+ */
+static bool vhost_svq_get_buf(VhostShadowVirtqueue *svq,
+                              VirtQueueElement **elem, uint32_t *len)
+{
+    uint16_t last_used = svq->last_used_idx & (svq->vring.num - 1);
+    uint16_t i;
+    uint32_t id;
+    unsigned int n, ndescs;
+
+    if (!vhost_svq_more_used(svq)) {
+        return false;
+    }
+
+    /* Only read the used entry after the device exposed it */
+    smp_rmb();
+    id = le32_to_cpu(svq->vring.used->ring[last_used].id);
+    *len = le32_to_cpu(svq->vring.used->ring[last_used].len);
+    svq->last_used_idx++;
+
+    if (id >= svq->vring.num || !svq->desc_state[id].ndescs) {
+        error_report("vhost shadow virtqueue: device used invalid head %u",
+                     id);
+        return false;
+    }
+
+    ndescs = svq->desc_state[id].ndescs;
+    *elem = svq->desc_state[id].elem;
+    svq->desc_state[id].ndescs = 0;
+    svq->desc_state[id].elem = NULL;
+
+    /* Return the chain to the free list */
+    for (i = id, n = 1; n < ndescs; n++) {
+        i = le16_to_cpu(svq->vring.desc[i].next);
+    }
+    svq->vring.desc[i].next = cpu_to_le16(svq->free_head);
+    svq->free_head = id;
+    svq->num_free += ndescs;
+
+    return true;
+}
+
+static void vhost_svq_notify_guest(VhostShadowVirtqueue *svq)
+{
+    if (event_notifier_get_fd(&svq->svq_call) < 0) {
+        return;
+    }
+    if (virtio_queue_should_notify(svq->vdev, svq->vq)) {
+        event_notifier_set(&svq->svq_call);
+    }
+}
+
+/* Return the buffers the device used to the guest */
+static void vhost_svq_flush(VhostShadowVirtqueue *svq,
+                            bool check_for_avail_queue)
+{
+    VirtQueue *vq = svq->vq;
+
+    do {
+        unsigned int i = 0;
+
+        vhost_svq_disable_notification(svq);
+        for (;;) {
+            VirtQueueElement *elem;
+            uint32_t len;
+
+            if (!vhost_svq_get_buf(svq, &elem, &len)) {
+                break;
+            }
+            if (!elem) {
+                /* Nobody waits for this injected buffer anymore */
+                continue;
+            }
+
+            if (svq->ops && svq->ops->used_handler) {
+                svq->ops->used_handler(svq, elem, len, svq->ops_opaque);
+            }
+            virtqueue_fill(vq, elem, len, i++);
+            virtqueue_element_free(elem);
+        }
+
+        if (i) {
+            virtqueue_flush(vq, i);
+            vhost_svq_notify_guest(svq);
+        }
+
+        if (check_for_avail_queue && svq->next_guest_avail_elem) {
+            vhost_svq_process_kick(svq);
+        }
+    } while (!vhost_svq_enable_notification(svq));
+}
+
+static void vhost_svq_handle_call(EventNotifier *n)
+{
+    VhostShadowVirtqueue *svq = container_of(n, VhostShadowVirtqueue,
+                                             hdev_call);
+
+    event_notifier_test_and_clear(n);
+    vhost_svq_flush(svq, true);
+}
+
+/**
+ * vhost_svq_inject:
+ * @svq: The shadow virtqueue, which must be started
+ * @out_iova: Device address of the device readable part of the buffer
+ * @out_len: Length of the device readable part
+ * @in_iova: Device address of the device writable part of the buffer
+ * @in_len: Length of the device writable part
+ *
+ * Expose a buffer owned by QEMU to the device, without the guest noticing.
+ * Wait for it with vhost_svq_poll().
+ *
+ * Returns 0 on success or -ENOSPC if the shadow ring is full.
+ */
+int vhost_svq_inject(VhostShadowVirtqueue *svq, hwaddr out_iova,
+                     size_t out_len, hwaddr in_iova, size_t in_len)
+{
+    const struct iovec out_sg = { .iov_len = out_len };
+    const struct iovec in_sg = { .iov_len = in_len };
+
+    assert(svq->started);
+
+    if (!vhost_svq_add(svq, &out_iova, &out_sg, 1, &in_iova, &in_sg, 1,
+                       NULL)) {
+        return -ENOSPC;
+    }
+
+    vhost_svq_kick(svq);
+    return 0;
+}
+
+/**
+ * vhost_svq_poll:
+ * @svq: The shadow virtqueue
+ *
+ * Busy wait until the device uses a buffer added with vhost_svq_inject().
+ * Guest buffers used in the meantime are returned to the guest.
+ *
+ * Returns the length the device wrote, or a negative errno.
+ */
+ssize_t vhost_svq_poll(VhostShadowVirtqueue *svq)
+{
+    int64_t start_us = g_get_monotonic_time();
+
+    for (;;) {
+        VirtQueueElement *elem;
+        uint32_t len;
+
+        if (!vhost_svq_more_used(svq)) {
+            if (g_get_monotonic_time() - start_us > VHOST_SVQ_POLL_TIMEOUT_US) {
+                return -ETIMEDOUT;
+            }
+            cpu_relax();
+            continue;
+        }
+
+        if (!vhost_svq_get_buf(svq, &elem, &len)) {
+            return -EIO;
+        }
+        if (!elem) {
+            return len;
+        }
+
+        if (svq->ops && svq->ops->used_handler) {
+            svq->ops->used_handler(svq, elem, len, svq->ops_opaque);
+        }
+        virtqueue_fill(svq->vq, elem, len, 0);
+        virtqueue_flush(svq->vq, 1);
+        virtqueue_element_free(elem);
+        vhost_svq_notify_guest(svq);
+    }
+}
+
+/**
+ * vhost_svq_start:
+ * @svq: The shadow virtqueue, sized with vhost_svq_set_num()
+ * @vdev: The virtio device
+ * @vq: The guest's virtqueue
+ * @svq_kick_fd: The guest's host notifier, as passed to VHOST_SET_VRING_KICK
+ *
+ * The device must be told to use the shadow ring and the shadow notifiers
+ * before calling this.  Buffers the guest made available while the device
+ * was stopped are forwarded right away.
+ */
+void vhost_svq_start(VhostShadowVirtqueue *svq, VirtIODevice *vdev,
+                     VirtQueue *vq, int svq_kick_fd)
+{
+    unsigned int num = svq->vring.num;
+    unsigned int i;
+
+    assert(!svq->started && svq->vring.desc);
+
+    svq->vdev = vdev;
+    svq->vq = vq;
+    svq->next_guest_avail_elem = NULL;
+    svq->shadow_avail_idx = 0;
+    svq->shadow_used_idx = 0;
+    svq->last_used_idx = 0;
+
+    memset(svq->vring.desc, 0, vhost_svq_driver_area_size(svq));
+    memset(svq->vring.used, 0, vhost_svq_device_area_size(svq));
+    memset(svq->desc_state, 0, sizeof(SVQDescState) * num);
+    for (i = 0; i < num - 1; i++) {
+        svq->vring.desc[i].next = cpu_to_le16(i + 1);
+    }
+    svq->free_head = 0;
+    svq->num_free = num;
+    svq->started = true;
+
+    event_notifier_set_handler(&svq->hdev_call, vhost_svq_handle_call);
+    event_notifier_init_fd(&svq->svq_kick, svq_kick_fd);
+    event_notifier_set(&svq->svq_kick);
+    event_notifier_set_handler(&svq->svq_kick, vhost_handle_guest_kick);
+}
+
+/**
+ * vhost_svq_stop:
+ * @svq: The shadow virtqueue
+ *
+ * Stop forwarding buffers, after the device has been stopped.  The buffers
+ * the device did not use are made available to the guest's virtqueue
+ * again, so the next user of the virtqueue processes them from scratch.
+ * This is fine for networking, where a retransmitted packet is harmless, but
+ * other kinds of devices might have a problem with it.
+ */
+void vhost_svq_stop(VhostShadowVirtqueue *svq)
+{
+    unsigned int i;
+
+    if (!svq->started) {
+        return;
+    }
+
+    event_notifier_set_handler(&svq->svq_kick, NULL);
+    event_notifier_set_handler(&svq->hdev_call, NULL);
+
+    /* Return what the device used before it was stopped */
+    vhost_svq_flush(svq, false);
+
+    for (i = 0; i < svq->vring.num; i++) {
+        VirtQueueElement *elem = svq->desc_state[i].elem;
+
+        if (elem) {
+            virtqueue_unpop(svq->vq, elem, 0);
+            virtqueue_element_free(elem);
+        }
+        svq->desc_state[i].elem = NULL;
+        svq->desc_state[i].ndescs = 0;
+    }
+    if (svq->next_guest_avail_elem) {
+        virtqueue_unpop(svq->vq, svq->next_guest_avail_elem, 0);
+        virtqueue_element_free(svq->next_guest_avail_elem);
+        svq->next_guest_avail_elem = NULL;
+    }
+
+    svq->started = false;
+    svq->vdev = NULL;
+    svq->vq = NULL;
+}
+
+/**
+ * vhost_svq_new:
+ * @ops: Optional callbacks
+ * @ops_opaque: Passed to the callbacks
+ *
+ * Create a stopped shadow virtqueue, or return NULL if its notifiers could
+ * not be created.
+ */
+VhostShadowVirtqueue *vhost_svq_new(const VhostShadowVirtqueueOps *ops,
+                                    void *ops_opaque)
+{
+    VhostShadowVirtqueue *svq = g_new0(VhostShadowVirtqueue, 1);
+    int r;
+
+    r = event_notifier_init(&svq->hdev_kick, 0);
+    if (r != 0) {
+        error_report("Couldn't create kick event notifier: %s (%d)",
+                     g_strerror(-r), -r);
+        goto err_init_hdev_kick;
+    }
+
+    r = event_notifier_init(&svq->hdev_call, 0);
+    if (r != 0) {
+        error_report("Couldn't create call event notifier: %s (%d)",
+                     g_strerror(-r), -r);
+        goto err_init_hdev_call;
+    }
+
+    event_notifier_init_fd(&svq->svq_kick, -1);
+    event_notifier_init_fd(&svq->svq_call, -1);
+    svq->ops = ops;
+    svq->ops_opaque = ops_opaque;
+    return svq;
+
+err_init_hdev_call:
+    event_notifier_cleanup(&svq->hdev_kick);
+
+err_init_hdev_kick:
+    g_free(svq);
+    return NULL;
+}
+
+void vhost_svq_free(VhostShadowVirtqueue *svq)
+{
+    if (!svq) {
+        return;
+    }
+
+    vhost_svq_stop(svq);
+    event_notifier_cleanup(&svq->hdev_kick);
+    event_notifier_cleanup(&svq->hdev_call);
+    vhost_svq_free_rings(svq);
+    g_free(svq);
+}
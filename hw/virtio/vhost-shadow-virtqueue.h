@@ -0,0 +1,50 @@
+/*
+ * vhost shadow virtqueue
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#ifndef VHOST_SHADOW_VIRTQUEUE_H
+#define VHOST_SHADOW_VIRTQUEUE_H
+
+#include "qemu/event_notifier.h"
+#include "hw/virtio/virtio.h"
+#include "standard-headers/linux/vhost_types.h"
+
+typedef struct VhostShadowVirtqueue VhostShadowVirtqueue;
+
+typedef struct VhostShadowVirtqueueOps {
+    /*
+     * Called when the device has used a guest buffer, before it is returned
+     * to the guest.  @len is the number of bytes the device wrote.
+     */
+    void (*used_handler)(VhostShadowVirtqueue *svq,
+                         const VirtQueueElement *elem, uint32_t len,
+                         void *opaque);
+} VhostShadowVirtqueueOps;
+
+VhostShadowVirtqueue *vhost_svq_new(const VhostShadowVirtqueueOps *ops,
+                                    void *ops_opaque);
+void vhost_svq_free(VhostShadowVirtqueue *svq);
+
+int vhost_svq_get_dev_kick_notifier(const VhostShadowVirtqueue *svq);
+int vhost_svq_get_dev_call_notifier(const VhostShadowVirtqueue *svq);
+void vhost_svq_set_guest_call_notifier(VhostShadowVirtqueue *svq, int call_fd);
+
+void vhost_svq_set_num(VhostShadowVirtqueue *svq, unsigned int num);
+size_t vhost_svq_driver_area_size(const VhostShadowVirtqueue *svq);
+size_t vhost_svq_device_area_size(const VhostShadowVirtqueue *svq);
+void vhost_svq_get_vring_addr(const VhostShadowVirtqueue *svq,
+                              struct vhost_vring_addr *addr);
+bool vhost_svq_started(const VhostShadowVirtqueue *svq);
+
+void vhost_svq_start(VhostShadowVirtqueue *svq, VirtIODevice *vdev,
+                     VirtQueue *vq, int svq_kick_fd);
+void vhost_svq_stop(VhostShadowVirtqueue *svq);
+
+int vhost_svq_inject(VhostShadowVirtqueue *svq, hwaddr out_iova,
+                     size_t out_len, hwaddr in_iova, size_t in_len);
+ssize_t vhost_svq_poll(VhostShadowVirtqueue *svq);
+
+#endif
@@ -13,6 +13,7 @@
 
 #include "qemu/osdep.h"
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include "standard-headers/linux/virtio_fs.h"
 #include "qapi/error.h"
 #include "hw/qdev-properties.h"
@@ -20,9 +21,11 @@
 #include "hw/virtio/virtio-bus.h"
 #include "hw/virtio/virtio-access.h"
 #include "qemu/error-report.h"
+#include "qemu/bitmap.h"
 #include "hw/virtio/vhost-user-fs.h"
 #include "monitor/monitor.h"
 #include "sysemu/sysemu.h"
+#include "trace.h"
 
 static const int user_feature_bits[] = {
     VIRTIO_F_VERSION_1,
@@ -30,6 +33,7 @@ static const int user_feature_bits[] = {
     VIRTIO_RING_F_EVENT_IDX,
     VIRTIO_F_NOTIFY_ON_EMPTY,
     VIRTIO_F_RING_PACKED,
+    VIRTIO_F_IN_ORDER,
     VIRTIO_F_IOMMU_PLATFORM,
 
     VHOST_INVALID_FEATURE_BIT
@@ -48,6 +52,189 @@ static void vuf_get_config(VirtIODevice *vdev, uint8_t *config)
     memcpy(config, &fscfg, sizeof(fscfg));
 }
 
+static VHostUserFS *vuf_from_vhost_dev(struct vhost_dev *dev)
+{
+    VHostUserFS *fs;
+
+    fs = (VHostUserFS *)object_dynamic_cast(OBJECT(dev->vdev),
+                                            TYPE_VHOST_USER_FS);
+    if (!fs) {
+        error_report("%s: slave message for a device that is not virtio-fs",
+                     __func__);
+        return NULL;
+    }
+    if (!fs->conf.cache_size) {
+        error_report("%s: virtio-fs device has no cache-size", __func__);
+        return NULL;
+    }
+    return fs;
+}
+
+/* Check that [@c_offset, @c_offset + @len) lies page aligned in the cache */
+static bool vuf_cache_range_valid(VHostUserFS *fs, uint64_t c_offset,
+                                  uint64_t len)
+{
+    uint64_t mask = qemu_real_host_page_size - 1;
+
+    return !((c_offset | len) & mask) &&
+           c_offset < fs->conf.cache_size &&
+           len <= fs->conf.cache_size - c_offset;
+}
+
+/* Track which pages of the cache have a file mapped, for the stats */
+static void vuf_cache_account(VHostUserFS *fs, uint64_t c_offset,
+                              uint64_t len, bool mapped)
+{
+    uint64_t first = c_offset / qemu_real_host_page_size;
+    uint64_t pages = len / qemu_real_host_page_size;
+    uint64_t was_mapped;
+
+    was_mapped = bitmap_count_one_with_offset(fs->cache_map, first, pages);
+    fs->cache_mapped_bytes -= was_mapped * qemu_real_host_page_size;
+    if (mapped) {
+        fs->cache_mapped_bytes += len;
+        bitmap_set(fs->cache_map, first, pages);
+    } else {
+        bitmap_clear(fs->cache_map, first, pages);
+    }
+}
+
+/*
+ * Replace [@c_offset, @c_offset + @len) of the cache with inaccessible
+ * anonymous memory; guest accesses there fault rather than read stale
+ * file contents.
+ */
+static int vuf_cache_unmap_range(VHostUserFS *fs, uint64_t c_offset,
+                                 uint64_t len)
+{
+    uint8_t *cache_host = memory_region_get_ram_ptr(&fs->cache);
+    void *ptr;
+
+    ptr = mmap(cache_host + c_offset, len, PROT_NONE,
+               MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+    if (ptr != cache_host + c_offset) {
+        return -errno;
+    }
+
+    vuf_cache_account(fs, c_offset, len, false);
+    return 0;
+}
+
+static void vuf_cache_reset(VHostUserFS *fs)
+{
+    int ret;
+
+    if (!fs->cache_mapped_bytes) {
+        return;
+    }
+    ret = vuf_cache_unmap_range(fs, 0, fs->conf.cache_size);
+    if (ret < 0) {
+        error_report("virtio-fs: cannot drop the cache mappings: %s",
+                     strerror(-ret));
+    }
+}
+
+int vhost_user_fs_slave_map(struct vhost_dev *dev, VhostUserFSSlaveMsg *sm,
+                            int fd)
+{
+    VHostUserFS *fs = vuf_from_vhost_dev(dev);
+    uint8_t *cache_host;
+    int i;
+
+    if (!fs) {
+        return -EINVAL;
+    }
+    if (fd < 0) {
+        error_report("%s: bad fd for map", __func__);
+        return -EBADF;
+    }
+
+    cache_host = memory_region_get_ram_ptr(&fs->cache);
+    for (i = 0; i < VHOST_USER_FS_SLAVE_ENTRIES; i++) {
+        uint64_t c_offset = sm->c_offset[i];
+        uint64_t len = sm->len[i];
+        int prot = 0;
+        void *ptr;
+
+        if (!len) {
+            continue;
+        }
+        if (!vuf_cache_range_valid(fs, c_offset, len)) {
+            error_report("%s: bad cache range 0x%" PRIx64 "+0x%" PRIx64,
+                         __func__, c_offset, len);
+            return -EINVAL;
+        }
+
+        if (sm->flags[i] & VHOST_USER_FS_FLAG_MAP_R) {
+            prot |= PROT_READ;
+        }
+        if (sm->flags[i] & VHOST_USER_FS_FLAG_MAP_W) {
+            prot |= PROT_WRITE;
+        }
+
+        trace_vhost_user_fs_slave_map(c_offset, len, sm->fd_offset[i],
+                                      sm->flags[i]);
+        ptr = mmap(cache_host + c_offset, len, prot, MAP_SHARED | MAP_FIXED,
+                   fd, sm->fd_offset[i]);
+        if (ptr != cache_host + c_offset) {
+            int err = errno;
+
+            error_report("%s: map failed: %s", __func__, strerror(err));
+            /* Whatever was in the range before is gone now */
+            vuf_cache_unmap_range(fs, c_offset, len);
+            return -err;
+        }
+
+        vuf_cache_account(fs, c_offset, len, true);
+        fs->cache_map_count++;
+    }
+
+    return 0;
+}
+
+/*
+ * The daemon reclaims mappings on behalf of the guest, which sends
+ * FUSE_REMOVEMAPPING when its DAX range allocator runs low; an entry
+ * of length VHOST_USER_FS_UNMAP_ALL drops the whole window at once.
+ */
+int vhost_user_fs_slave_unmap(struct vhost_dev *dev, VhostUserFSSlaveMsg *sm)
+{
+    VHostUserFS *fs = vuf_from_vhost_dev(dev);
+    int i, ret;
+
+    if (!fs) {
+        return -EINVAL;
+    }
+
+    for (i = 0; i < VHOST_USER_FS_SLAVE_ENTRIES; i++) {
+        uint64_t c_offset = sm->c_offset[i];
+        uint64_t len = sm->len[i];
+
+        if (!len) {
+            continue;
+        }
+        if (len == VHOST_USER_FS_UNMAP_ALL) {
+            c_offset = 0;
+            len = fs->conf.cache_size;
+        }
+        if (!vuf_cache_range_valid(fs, c_offset, len)) {
+            error_report("%s: bad cache range 0x%" PRIx64 "+0x%" PRIx64,
+                         __func__, c_offset, len);
+            return -EINVAL;
+        }
+
+        trace_vhost_user_fs_slave_unmap(c_offset, len);
+        ret = vuf_cache_unmap_range(fs, c_offset, len);
+        if (ret < 0) {
+            error_report("%s: unmap failed: %s", __func__, strerror(-ret));
+            return ret;
+        }
+        fs->cache_unmap_count++;
+    }
+
+    return 0;
+}
+
 static void vuf_start(VirtIODevice *vdev)
 {
     VHostUserFS *fs = VHOST_USER_FS(vdev);
@@ -148,6 +335,15 @@ static uint64_t vuf_get_features(VirtIODevice *vdev,
     return vhost_get_features(&fs->vhost_dev, user_feature_bits, features);
 }
 
+/*
+ * Mappings belong to the daemon's view of the guest driver, which is
+ * gone after a reset; the daemon forgets them too.
+ */
+static void vuf_reset(VirtIODevice *vdev)
+{
+    vuf_cache_reset(VHOST_USER_FS(vdev));
+}
+
 static void vuf_handle_output(VirtIODevice *vdev, VirtQueue *vq)
 {
     /*
@@ -171,6 +367,16 @@ static bool vuf_guest_notifier_pending(VirtIODevice *vdev, int idx)
     return vhost_virtqueue_pending(&fs->vhost_dev, idx);
 }
 
+static void vuf_cache_cleanup(VHostUserFS *fs)
+{
+    if (fs->conf.cache_size) {
+        munmap(memory_region_get_ram_ptr(&fs->cache), fs->conf.cache_size);
+        object_unparent(OBJECT(&fs->cache));
+        g_free(fs->cache_map);
+        fs->cache_map = NULL;
+    }
+}
+
 static void vuf_device_realize(DeviceState *dev, Error **errp)
 {
     VirtIODevice *vdev = VIRTIO_DEVICE(dev);
@@ -215,8 +421,33 @@ static void vuf_device_realize(DeviceState *dev, Error **errp)
         return;
     }
 
+    if (fs->conf.cache_size) {
+        void *cache_ptr;
+
+        if (fs->conf.cache_size < qemu_real_host_page_size ||
+            !is_power_of_2(fs->conf.cache_size)) {
+            error_setg(errp, "cache-size property must be a power of 2 "
+                       "no smaller than the page size");
+            return;
+        }
+
+        /* Anonymous memory as a placeholder until the daemon maps files */
+        cache_ptr = mmap(NULL, fs->conf.cache_size, PROT_NONE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (cache_ptr == MAP_FAILED) {
+            error_setg_errno(errp, errno, "Unable to mmap blank cache");
+            return;
+        }
+
+        memory_region_init_ram_ptr(&fs->cache, OBJECT(vdev),
+                                   "virtio-fs-cache", fs->conf.cache_size,
+                                   cache_ptr);
+        fs->cache_map = bitmap_new(fs->conf.cache_size /
+                                   qemu_real_host_page_size);
+    }
+
     if (!vhost_user_init(&fs->vhost_user, &fs->conf.chardev, errp)) {
-        return;
+        goto err_cache;
     }
 
     virtio_init(vdev, "vhost-user-fs", VIRTIO_ID_FS,
@@ -252,6 +483,8 @@ err_virtio:
     g_free(fs->req_vqs);
     virtio_cleanup(vdev);
     g_free(fs->vhost_dev.vqs);
+err_cache:
+    vuf_cache_cleanup(fs);
     return;
 }
 
@@ -276,6 +509,7 @@ static void vuf_device_unrealize(DeviceState *dev)
     virtio_cleanup(vdev);
     g_free(fs->vhost_dev.vqs);
     fs->vhost_dev.vqs = NULL;
+    vuf_cache_cleanup(fs);
 }
 
 static const VMStateDescription vuf_vmstate = {
@@ -289,6 +523,7 @@ static Property vuf_properties[] = {
     DEFINE_PROP_UINT16("num-request-queues", VHostUserFS,
                        conf.num_request_queues, 1),
     DEFINE_PROP_UINT16("queue-size", VHostUserFS, conf.queue_size, 128),
+    DEFINE_PROP_SIZE("cache-size", VHostUserFS, conf.cache_size, 0),
     DEFINE_PROP_END_OF_LIST(),
 };
 
@@ -298,6 +533,15 @@ static void vuf_instance_init(Object *obj)
 
     device_add_bootindex_property(obj, &fs->bootindex, "bootindex",
                                   "/filesystem@0", DEVICE(obj));
+
+    /* DAX window statistics */
+    object_property_add_uint64_ptr(obj, "cache-map-count",
+                                   &fs->cache_map_count, OBJ_PROP_FLAG_READ);
+    object_property_add_uint64_ptr(obj, "cache-unmap-count",
+                                   &fs->cache_unmap_count, OBJ_PROP_FLAG_READ);
+    object_property_add_uint64_ptr(obj, "cache-mapped-bytes",
+                                   &fs->cache_mapped_bytes,
+                                   OBJ_PROP_FLAG_READ);
 }
 
 static void vuf_class_init(ObjectClass *klass, void *data)
@@ -313,6 +557,7 @@ static void vuf_class_init(ObjectClass *klass, void *data)
     vdc->get_features = vuf_get_features;
     vdc->get_config = vuf_get_config;
     vdc->set_status = vuf_set_status;
+    vdc->reset = vuf_reset;
     vdc->guest_notifier_mask = vuf_guest_notifier_mask;
     vdc->guest_notifier_pending = vuf_guest_notifier_pending;
 }
@@ -9,17 +9,20 @@
  */
 
 #include "qemu/osdep.h"
+#include CONFIG_DEVICES
 #include "qapi/error.h"
 #include "hw/virtio/vhost.h"
 #include "hw/virtio/vhost-user.h"
 #include "hw/virtio/vhost-backend.h"
 #include "hw/virtio/virtio.h"
 #include "hw/virtio/virtio-net.h"
+#include "hw/virtio/vhost-user-fs.h"
 #include "chardev/char-fe.h"
 #include "io/channel-socket.h"
 #include "sysemu/kvm.h"
 #include "qemu/error-report.h"
 #include "qemu/main-loop.h"
+#include "qemu/memfd.h"
 #include "qemu/sockets.h"
 #include "sysemu/cryptodev.h"
 #include "migration/migration.h"
@@ -80,10 +83,14 @@ enum VhostUserProtocolFeature {
     VHOST_USER_PROTOCOL_F_RESET_DEVICE = 13,
     /* Feature 14 reserved for VHOST_USER_PROTOCOL_F_INBAND_NOTIFICATIONS. */
     VHOST_USER_PROTOCOL_F_CONFIGURE_MEM_SLOTS = 15,
+    /* Feature 16 reserved for VHOST_USER_PROTOCOL_F_STATUS. */
+    VHOST_USER_PROTOCOL_F_NOTIFICATION_AREA = 17,
     VHOST_USER_PROTOCOL_F_MAX
 };
 
-#define VHOST_USER_PROTOCOL_FEATURE_MASK ((1 << VHOST_USER_PROTOCOL_F_MAX) - 1)
+/* Feature 16 is not implemented and must not be acknowledged */
+#define VHOST_USER_PROTOCOL_FEATURE_MASK \
+    (((1ULL << VHOST_USER_PROTOCOL_F_MAX) - 1) & ~(1ULL << 16))
 
 typedef enum VhostUserRequest {
     VHOST_USER_NONE = 0,
@@ -125,6 +132,8 @@ typedef enum VhostUserRequest {
     VHOST_USER_GET_MAX_MEM_SLOTS = 36,
     VHOST_USER_ADD_MEM_REG = 37,
     VHOST_USER_REM_MEM_REG = 38,
+    /* Message numbers 39 and 40 reserved for VHOST_USER_SET/GET_STATUS. */
+    VHOST_USER_SET_NOTIFICATION_AREA = 41,
     VHOST_USER_MAX
 } VhostUserRequest;
 
@@ -133,6 +142,10 @@ typedef enum VhostUserSlaveRequest {
     VHOST_USER_SLAVE_IOTLB_MSG = 1,
     VHOST_USER_SLAVE_CONFIG_CHANGE_MSG = 2,
     VHOST_USER_SLAVE_VRING_HOST_NOTIFIER_MSG = 3,
+    VHOST_USER_SLAVE_VRING_CALL = 4,
+    VHOST_USER_SLAVE_VRING_ERR = 5,
+    VHOST_USER_SLAVE_FS_MAP = 6,
+    VHOST_USER_SLAVE_FS_UNMAP = 7,
     VHOST_USER_SLAVE_MAX
 }  VhostUserSlaveRequest;
 
@@ -195,6 +208,24 @@ typedef struct VhostUserInflight {
     uint16_t queue_size;
 } VhostUserInflight;
 
+typedef struct VhostUserNotificationArea {
+    uint64_t mmap_size;
+    uint64_t mmap_offset;
+    uint16_t first_queue;
+    uint16_t num_queues;
+    uint16_t stride;
+    uint16_t padding;
+} VhostUserNotificationArea;
+
+/*
+ * Each vring gets its own cache line in the notification area, so that
+ * slave threads polling different vrings do not share one.
+ */
+#define VHOST_USER_NOTIFICATION_AREA_STRIDE 64
+
+/* Set by the slave while it polls the vring, kicks may then be skipped */
+#define VHOST_USER_NOTIFICATION_F_POLLING   (1u << 0)
+
 typedef struct {
     VhostUserRequest request;
 
@@ -219,6 +250,8 @@ typedef union {
         VhostUserCryptoSession session;
         VhostUserVringArea area;
         VhostUserInflight inflight;
+        VhostUserNotificationArea notif_area;
+        VhostUserFSSlaveMsg fs;
 } VhostUserPayload;
 
 typedef struct VhostUserMsg {
@@ -258,6 +291,11 @@ struct vhost_user {
     /* Our current regions */
     int num_shadow_regions;
     struct vhost_memory_region shadow_regions[VHOST_USER_MAX_RAM_SLOTS];
+
+    /* Per-vring notification flags shared with the slave */
+    void *notif_area;
+    size_t notif_area_size;
+    int notif_area_fd;
 };
 
 struct scrub_regions {
@@ -1214,6 +1252,36 @@ static int vhost_user_set_vring_enable(struct vhost_dev *dev, int enable)
     return 0;
 }
 
+/*
+ * The flags word of vring @index in the notification area, or NULL if the
+ * area was not negotiated.
+ */
+static uint32_t *vhost_user_notification_flags(struct vhost_dev *dev,
+                                               int index)
+{
+    struct vhost_user *u = dev->opaque;
+
+    if (!u->notif_area) {
+        return NULL;
+    }
+    assert(index >= dev->vq_index && index < dev->vq_index + dev->nvqs);
+    return u->notif_area +
+           (index - dev->vq_index) * VHOST_USER_NOTIFICATION_AREA_STRIDE;
+}
+
+static void vhost_user_notification_attach(struct vhost_dev *dev, int index,
+                                           bool attach)
+{
+    uint32_t *flags = vhost_user_notification_flags(dev, index);
+
+    QEMU_BUILD_BUG_ON(VHOST_USER_NOTIFICATION_F_POLLING !=
+                      VIRTIO_QUEUE_HOST_NOTIFIER_POLLING);
+    if (flags && dev->vdev) {
+        virtio_queue_set_host_notifier_poll_flags(
+            virtio_get_queue(dev->vdev, index), attach ? flags : NULL);
+    }
+}
+
 static int vhost_user_get_vring_base(struct vhost_dev *dev,
                                      struct vhost_vring_state *ring)
 {
@@ -1225,6 +1293,7 @@ static int vhost_user_get_vring_base(struct vhost_dev *dev,
     };
 
     vhost_user_host_notifier_remove(dev, ring->index);
+    vhost_user_notification_attach(dev, ring->index, false);
 
     if (vhost_user_write(dev, &msg, NULL, 0) < 0) {
         return -1;
@@ -1279,6 +1348,7 @@ static int vhost_set_vring_file(struct vhost_dev *dev,
 static int vhost_user_set_vring_kick(struct vhost_dev *dev,
                                      struct vhost_vring_file *file)
 {
+    vhost_user_notification_attach(dev, file->index, true);
     return vhost_set_vring_file(dev, VHOST_USER_SET_VRING_KICK, file);
 }
 
@@ -1537,6 +1607,14 @@ static gboolean slave_read(QIOChannel *ioc, GIOCondition condition,
         ret = vhost_user_slave_handle_vring_host_notifier(dev, &payload.area,
                                                           fd ? fd[0] : -1);
         break;
+#ifdef CONFIG_VHOST_USER_FS
+    case VHOST_USER_SLAVE_FS_MAP:
+        ret = vhost_user_fs_slave_map(dev, &payload.fs, fd ? fd[0] : -1);
+        break;
+    case VHOST_USER_SLAVE_FS_UNMAP:
+        ret = vhost_user_fs_slave_unmap(dev, &payload.fs);
+        break;
+#endif
     default:
         error_report("Received unexpected msg type: %d.", hdr.request);
         ret = -EINVAL;
@@ -1856,6 +1934,44 @@ static int vhost_user_postcopy_notifier(NotifierWithReturn *notifier,
     return 0;
 }
 
+static int vhost_user_set_notification_area(struct vhost_dev *dev)
+{
+    struct vhost_user *u = dev->opaque;
+    size_t size = ROUND_UP(dev->nvqs * VHOST_USER_NOTIFICATION_AREA_STRIDE,
+                           qemu_real_host_page_size);
+    VhostUserMsg msg = {
+        .hdr.request = VHOST_USER_SET_NOTIFICATION_AREA,
+        .hdr.flags = VHOST_USER_VERSION,
+        .payload.notif_area.mmap_size = size,
+        .payload.notif_area.mmap_offset = 0,
+        .payload.notif_area.first_queue = dev->vq_index,
+        .payload.notif_area.num_queues = dev->nvqs,
+        .payload.notif_area.stride = VHOST_USER_NOTIFICATION_AREA_STRIDE,
+        .hdr.size = sizeof(msg.payload.notif_area),
+    };
+    Error *err = NULL;
+    void *addr;
+    int fd = -1;
+
+    addr = qemu_memfd_alloc("vhost-user-notif", size,
+                            F_SEAL_GROW | F_SEAL_SHRINK | F_SEAL_SEAL,
+                            &fd, &err);
+    if (err) {
+        error_report_err(err);
+        return -1;
+    }
+
+    if (vhost_user_write(dev, &msg, &fd, 1) < 0) {
+        qemu_memfd_free(addr, size, fd);
+        return -1;
+    }
+
+    u->notif_area = addr;
+    u->notif_area_size = size;
+    u->notif_area_fd = fd;
+    return 0;
+}
+
 static int vhost_user_backend_init(struct vhost_dev *dev, void *opaque)
 {
     uint64_t features, protocol_features, ram_slots;
@@ -1940,6 +2056,14 @@ static int vhost_user_backend_init(struct vhost_dev *dev, void *opaque)
 
             u->user->memory_slots = MIN(ram_slots, VHOST_USER_MAX_RAM_SLOTS);
         }
+
+        if (virtio_has_feature(dev->protocol_features,
+                               VHOST_USER_PROTOCOL_F_NOTIFICATION_AREA)) {
+            err = vhost_user_set_notification_area(dev);
+            if (err < 0) {
+                return err;
+            }
+        }
     }
 
     if (dev->migration_blocker == NULL &&
@@ -1988,6 +2112,10 @@ static int vhost_user_backend_cleanup(struct vhost_dev *dev)
     g_free(u->region_rb_offset);
     u->region_rb_offset = NULL;
     u->region_rb_len = 0;
+    if (u->notif_area) {
+        qemu_memfd_free(u->notif_area, u->notif_area_size, u->notif_area_fd);
+        u->notif_area = NULL;
+    }
     g_free(u);
     dev->opaque = 0;
 
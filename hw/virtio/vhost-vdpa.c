@@ -18,11 +18,21 @@
 #include "hw/virtio/vhost-backend.h"
 #include "hw/virtio/virtio-net.h"
 #include "hw/virtio/vhost-vdpa.h"
+#include "migration/blocker.h"
+#include "qapi/error.h"
 #include "qemu/main-loop.h"
+#include "qemu/units.h"
 #include "cpu.h"
 #include "trace.h"
 #include "qemu-common.h"
 
+/*
+ * The rings of the shadow virtqueues, and the bounce page used to inject
+ * buffers, live in a fixed window per virtqueue at the top of the device
+ * IOVA range, out of the way of the guest memory.
+ */
+#define VHOST_VDPA_SVQ_WINDOW_SIZE (256 * KiB)
+
 static bool vhost_vdpa_listener_skipped_section(MemoryRegionSection *section)
 {
     return (!memory_region_is_ram(section->mr) &&
@@ -258,6 +268,37 @@ static int vhost_vdpa_call(struct vhost_dev *dev, unsigned long int request,
     return ioctl(fd, request, arg);
 }
 
+/*
+ * Several vhost devices can share a vhost-vdpa device, one per queue pair
+ * plus one for the control virtqueue.  The first one owns the whole device,
+ * the last one to start brings it up.
+ */
+static bool vhost_vdpa_first_dev(struct vhost_dev *dev)
+{
+    return dev->vq_index == 0;
+}
+
+static bool vhost_vdpa_last_dev(struct vhost_dev *dev)
+{
+    return dev->vq_index + dev->nvqs == dev->vq_index_end;
+}
+
+static hwaddr vhost_vdpa_svq_window(struct vhost_vdpa *v, int vq_index)
+{
+    uint64_t size = (uint64_t)(vq_index + 1) * VHOST_VDPA_SVQ_WINDOW_SIZE;
+
+    return QEMU_ALIGN_DOWN(v->iova_range.last - size + 1,
+                           VHOST_VDPA_SVQ_WINDOW_SIZE);
+}
+
+static VhostShadowVirtqueue *vhost_vdpa_svq(struct vhost_dev *dev, int idx)
+{
+    struct vhost_vdpa *v = dev->opaque;
+
+    assert(idx >= dev->vq_index && idx < dev->vq_index + dev->nvqs);
+    return g_ptr_array_index(v->shadow_vqs, idx - dev->vq_index);
+}
+
 static void vhost_vdpa_add_status(struct vhost_dev *dev, uint8_t status)
 {
     uint8_t s;
@@ -272,10 +313,24 @@ static void vhost_vdpa_add_status(struct vhost_dev *dev, uint8_t status)
     vhost_vdpa_call(dev, VHOST_VDPA_SET_STATUS, &s);
 }
 
+static void vhost_vdpa_get_iova_range(struct vhost_vdpa *v)
+{
+    int ret = vhost_vdpa_call(v->dev, VHOST_VDPA_GET_IOVA_RANGE,
+                              &v->iova_range);
+    if (ret != 0) {
+        v->iova_range.first = 0;
+        v->iova_range.last = UINT64_MAX;
+    }
+
+    trace_vhost_vdpa_get_iova_range(v->dev, v->iova_range.first,
+                                    v->iova_range.last);
+}
+
 static int vhost_vdpa_init(struct vhost_dev *dev, void *opaque)
 {
     struct vhost_vdpa *v;
     uint64_t features;
+    unsigned int i;
     assert(dev->vhost_ops->backend_type == VHOST_BACKEND_TYPE_VDPA);
     trace_vhost_vdpa_init(dev, opaque);
 
@@ -286,6 +341,20 @@ static int vhost_vdpa_init(struct vhost_dev *dev, void *opaque)
     dev->backend_features = features;
     v->listener = vhost_vdpa_memory_listener;
     v->msg_type = VHOST_IOTLB_MSG_V2;
+    vhost_vdpa_get_iova_range(v);
+
+    v->shadow_vqs = g_ptr_array_new_full(dev->nvqs,
+                                         (GDestroyNotify)vhost_svq_free);
+    for (i = 0; i < dev->nvqs; i++) {
+        VhostShadowVirtqueue *svq = vhost_svq_new(v->shadow_vq_ops,
+                                                  v->shadow_vq_ops_opaque);
+        if (!svq) {
+            g_ptr_array_free(v->shadow_vqs, true);
+            v->shadow_vqs = NULL;
+            return -ENOMEM;
+        }
+        g_ptr_array_add(v->shadow_vqs, svq);
+    }
 
     vhost_vdpa_add_status(dev, VIRTIO_CONFIG_S_ACKNOWLEDGE |
                                VIRTIO_CONFIG_S_DRIVER);
@@ -301,6 +370,18 @@ static int vhost_vdpa_cleanup(struct vhost_dev *dev)
     trace_vhost_vdpa_cleanup(dev, v);
     memory_listener_unregister(&v->listener);
 
+    if (v->shadow_vqs) {
+        g_ptr_array_free(v->shadow_vqs, true);
+        v->shadow_vqs = NULL;
+    }
+    qemu_vfree(v->svq_bounce);
+    v->svq_bounce = NULL;
+    if (v->migration_blocker) {
+        migrate_del_blocker(v->migration_blocker);
+        error_free(v->migration_blocker);
+        v->migration_blocker = NULL;
+    }
+
     dev->opaque = NULL;
     return 0;
 }
@@ -333,10 +414,50 @@ static int vhost_vdpa_set_mem_table(struct vhost_dev *dev,
     return 0;
 }
 
+/*
+ * Shadow virtqueues only handle split rings, whose buffers are used in any
+ * order; a guest that negotiated anything else cannot be migrated.
+ */
+static void vhost_vdpa_update_migration_blocker(struct vhost_vdpa *v,
+                                                uint64_t features)
+{
+    bool can_shadow = !(features & ((0x1ULL << VIRTIO_F_RING_PACKED) |
+                                    (0x1ULL << VIRTIO_F_IN_ORDER)));
+    Error *local_err = NULL;
+
+    if (can_shadow == !v->migration_blocker) {
+        return;
+    }
+
+    if (can_shadow) {
+        migrate_del_blocker(v->migration_blocker);
+        error_free(v->migration_blocker);
+        v->migration_blocker = NULL;
+        return;
+    }
+
+    error_setg(&v->migration_blocker,
+               "Migration disabled: vhost-vdpa cannot shadow packed or "
+               "in-order virtqueues");
+    if (migrate_add_blocker(v->migration_blocker, &local_err) < 0) {
+        error_report_err(local_err);
+        error_free(v->migration_blocker);
+        v->migration_blocker = NULL;
+    }
+}
+
 static int vhost_vdpa_set_features(struct vhost_dev *dev,
                                    uint64_t features)
 {
+    struct vhost_vdpa *v = dev->opaque;
     int ret;
+
+    /* The device does not log its writes, shadow virtqueues do */
+    features &= ~(0x1ULL << VHOST_F_LOG_ALL);
+    if (!vhost_vdpa_first_dev(dev) || features == v->acked_features) {
+        return 0;
+    }
+
     trace_vhost_vdpa_set_features(dev, features);
     ret = vhost_vdpa_call(dev, VHOST_SET_FEATURES, &features);
     uint8_t status = 0;
@@ -345,6 +466,10 @@ static int vhost_vdpa_set_features(struct vhost_dev *dev,
     }
     vhost_vdpa_add_status(dev, VIRTIO_CONFIG_S_FEATURES_OK);
     vhost_vdpa_call(dev, VHOST_VDPA_GET_STATUS, &status);
+    if (status & VIRTIO_CONFIG_S_FEATURES_OK) {
+        v->acked_features = features;
+        vhost_vdpa_update_migration_blocker(v, features);
+    }
 
     return !(status & VIRTIO_CONFIG_S_FEATURES_OK);
 }
@@ -382,9 +507,11 @@ int vhost_vdpa_get_device_id(struct vhost_dev *dev,
 
 static int vhost_vdpa_reset_device(struct vhost_dev *dev)
 {
+    struct vhost_vdpa *v = dev->opaque;
     int ret;
     uint8_t status = 0;
 
+    v->acked_features = 0;
     ret = vhost_vdpa_call(dev, VHOST_VDPA_SET_STATUS, &status);
     trace_vhost_vdpa_reset_device(dev, status);
     return ret;
@@ -394,8 +521,9 @@ static int vhost_vdpa_get_vq_index(struct vhost_dev *dev, int idx)
 {
     assert(idx >= dev->vq_index && idx < dev->vq_index + dev->nvqs);
 
-    trace_vhost_vdpa_get_vq_index(dev, idx, idx - dev->vq_index);
-    return idx - dev->vq_index;
+    /* The vhost devices sharing the vhost-vdpa device use absolute indexes */
+    trace_vhost_vdpa_get_vq_index(dev, idx, idx);
+    return idx;
 }
 
 static int vhost_vdpa_set_vring_ready(struct vhost_dev *dev)
@@ -474,17 +602,29 @@ static int vhost_vdpa_dev_start(struct vhost_dev *dev, bool started)
     trace_vhost_vdpa_dev_start(dev, started);
     if (started) {
         uint8_t status = 0;
-        memory_listener_register(&v->listener, &address_space_memory);
         vhost_vdpa_set_vring_ready(dev);
+        if (!vhost_vdpa_last_dev(dev)) {
+            return 0;
+        }
+
+        memory_listener_register(&v->listener, &address_space_memory);
         vhost_vdpa_add_status(dev, VIRTIO_CONFIG_S_DRIVER_OK);
         vhost_vdpa_call(dev, VHOST_VDPA_GET_STATUS, &status);
 
         return !(status & VIRTIO_CONFIG_S_DRIVER_OK);
     } else {
-        vhost_vdpa_reset_device(dev);
-        vhost_vdpa_add_status(dev, VIRTIO_CONFIG_S_ACKNOWLEDGE |
-                                   VIRTIO_CONFIG_S_DRIVER);
-        memory_listener_unregister(&v->listener);
+        /*
+         * The vhost devices are stopped in order, so the first one stops
+         * the whole device before the rings of any of them are torn down.
+         */
+        if (vhost_vdpa_first_dev(dev)) {
+            vhost_vdpa_reset_device(dev);
+            vhost_vdpa_add_status(dev, VIRTIO_CONFIG_S_ACKNOWLEDGE |
+                                       VIRTIO_CONFIG_S_DRIVER);
+        }
+        if (vhost_vdpa_last_dev(dev)) {
+            memory_listener_unregister(&v->listener);
+        }
 
         return 0;
     }
@@ -493,14 +633,91 @@ static int vhost_vdpa_dev_start(struct vhost_dev *dev, bool started)
 static int vhost_vdpa_set_log_base(struct vhost_dev *dev, uint64_t base,
                                      struct vhost_log *log)
 {
+    struct vhost_vdpa *v = dev->opaque;
+
     trace_vhost_vdpa_set_log_base(dev, base, log->size, log->refcnt, log->fd,
                                   log->log);
+    if (v->shadow_vqs_enabled) {
+        /* Nothing to log, QEMU itself writes to the guest memory */
+        return 0;
+    }
     return vhost_vdpa_call(dev, VHOST_SET_LOG_BASE, &base);
 }
 
+static void vhost_vdpa_svq_unmap_rings(struct vhost_vdpa *v,
+                                       VhostShadowVirtqueue *svq, int idx)
+{
+    hwaddr iova = vhost_vdpa_svq_window(v, idx);
+
+    vhost_vdpa_dma_unmap(v, iova, vhost_svq_driver_area_size(svq) +
+                                  vhost_svq_device_area_size(svq));
+}
+
+/*
+ * Map the rings of @svq in its IOVA window and point @addr at them.  The
+ * device only reads the driver area.
+ */
+static int vhost_vdpa_svq_map_rings(struct vhost_vdpa *v,
+                                    VhostShadowVirtqueue *svq,
+                                    struct vhost_vring_addr *addr)
+{
+    size_t driver_size = vhost_svq_driver_area_size(svq);
+    size_t device_size = vhost_svq_device_area_size(svq);
+    hwaddr iova = vhost_vdpa_svq_window(v, addr->index);
+    struct vhost_vring_addr svq_addr;
+    int r;
+
+    /* The last page of the window is the bounce page */
+    assert(driver_size + device_size + qemu_real_host_page_size <=
+           VHOST_VDPA_SVQ_WINDOW_SIZE);
+
+    vhost_svq_get_vring_addr(svq, &svq_addr);
+    r = vhost_vdpa_dma_map(v, iova, driver_size,
+                           (void *)(uintptr_t)svq_addr.desc_user_addr, true);
+    if (r) {
+        return r;
+    }
+
+    r = vhost_vdpa_dma_map(v, iova + driver_size, device_size,
+                           (void *)(uintptr_t)svq_addr.used_user_addr, false);
+    if (r) {
+        vhost_vdpa_dma_unmap(v, iova, driver_size);
+        return r;
+    }
+
+    addr->desc_user_addr = iova;
+    addr->avail_user_addr = iova + svq_addr.avail_user_addr -
+                            svq_addr.desc_user_addr;
+    addr->used_user_addr = iova + driver_size;
+    addr->flags = 0;
+    return 0;
+}
+
 static int vhost_vdpa_set_vring_addr(struct vhost_dev *dev,
                                        struct vhost_vring_addr *addr)
 {
+    struct vhost_vdpa *v = dev->opaque;
+    struct vhost_vring_addr svq_addr;
+    int r;
+
+    if (v->shadow_vqs_enabled) {
+        VhostShadowVirtqueue *svq = vhost_vdpa_svq(dev, addr->index);
+
+        if (vhost_svq_started(svq)) {
+            /* The guest ring did not move, only VHOST_VRING_F_LOG changed */
+            return 0;
+        }
+
+        /* Drop the mapping of a start that failed half way, if any */
+        vhost_vdpa_svq_unmap_rings(v, svq, addr->index);
+        svq_addr.index = addr->index;
+        r = vhost_vdpa_svq_map_rings(v, svq, &svq_addr);
+        if (r) {
+            return r;
+        }
+        addr = &svq_addr;
+    }
+
     trace_vhost_vdpa_set_vring_addr(dev, addr->index, addr->flags,
                                     addr->desc_user_addr, addr->used_user_addr,
                                     addr->avail_user_addr,
@@ -511,13 +728,36 @@ static int vhost_vdpa_set_vring_addr(struct vhost_dev *dev,
 static int vhost_vdpa_set_vring_num(struct vhost_dev *dev,
                                       struct vhost_vring_state *ring)
 {
+    struct vhost_vdpa *v = dev->opaque;
+
     trace_vhost_vdpa_set_vring_num(dev, ring->index, ring->num);
+    if (v->shadow_vqs_enabled) {
+        if (virtio_vdev_has_feature(dev->vdev, VIRTIO_F_RING_PACKED) ||
+            virtio_vdev_has_feature(dev->vdev, VIRTIO_F_IN_ORDER)) {
+            error_report("vhost-vdpa: cannot shadow packed or in-order "
+                         "virtqueues");
+            errno = ENOTSUP;
+            return -1;
+        }
+        vhost_svq_set_num(vhost_vdpa_svq(dev, ring->index), ring->num);
+    }
     return vhost_vdpa_call(dev, VHOST_SET_VRING_NUM, ring);
 }
 
 static int vhost_vdpa_set_vring_base(struct vhost_dev *dev,
                                        struct vhost_vring_state *ring)
 {
+    struct vhost_vdpa *v = dev->opaque;
+    struct vhost_vring_state svq_ring = {
+        .index = ring->index,
+        .num = 0,
+    };
+
+    if (v->shadow_vqs_enabled) {
+        /* The shadow ring always starts from scratch */
+        ring = &svq_ring;
+    }
+
     trace_vhost_vdpa_set_vring_base(dev, ring->index, ring->num);
     return vhost_vdpa_call(dev, VHOST_SET_VRING_BASE, ring);
 }
@@ -525,8 +765,28 @@ static int vhost_vdpa_set_vring_base(struct vhost_dev *dev,
 static int vhost_vdpa_get_vring_base(struct vhost_dev *dev,
                                        struct vhost_vring_state *ring)
 {
+    struct vhost_vdpa *v = dev->opaque;
     int ret;
 
+    if (v->shadow_vqs_enabled) {
+        VhostShadowVirtqueue *svq = vhost_vdpa_svq(dev, ring->index);
+
+        /* The device is stopped, give the guest what it did not use back */
+        vhost_svq_stop(svq);
+        vhost_vdpa_svq_unmap_rings(v, svq, ring->index);
+        if (ring->index == dev->vq_index && v->svq_bounce_mapped) {
+            vhost_vdpa_dma_unmap(v, vhost_vdpa_svq_window(v, ring->index) +
+                                    VHOST_VDPA_SVQ_WINDOW_SIZE -
+                                    qemu_real_host_page_size,
+                                 qemu_real_host_page_size);
+            v->svq_bounce_mapped = false;
+        }
+
+        ring->num = virtio_queue_get_last_avail_idx(dev->vdev, ring->index);
+        trace_vhost_vdpa_get_vring_base(dev, ring->index, ring->num);
+        return 0;
+    }
+
     ret = vhost_vdpa_call(dev, VHOST_GET_VRING_BASE, ring);
     trace_vhost_vdpa_get_vring_base(dev, ring->index, ring->num);
     return ret;
@@ -535,14 +795,48 @@ static int vhost_vdpa_get_vring_base(struct vhost_dev *dev,
 static int vhost_vdpa_set_vring_kick(struct vhost_dev *dev,
                                        struct vhost_vring_file *file)
 {
+    struct vhost_vdpa *v = dev->opaque;
+    VhostShadowVirtqueue *svq;
+    struct vhost_vring_file svq_file = {
+        .index = file->index,
+    };
+    int r;
+
     trace_vhost_vdpa_set_vring_kick(dev, file->index, file->fd);
-    return vhost_vdpa_call(dev, VHOST_SET_VRING_KICK, file);
+    if (!v->shadow_vqs_enabled) {
+        return vhost_vdpa_call(dev, VHOST_SET_VRING_KICK, file);
+    }
+
+    /* The device talks to the shadow virtqueue only */
+    svq = vhost_vdpa_svq(dev, file->index);
+    svq_file.fd = vhost_svq_get_dev_kick_notifier(svq);
+    r = vhost_vdpa_call(dev, VHOST_SET_VRING_KICK, &svq_file);
+    if (r) {
+        return r;
+    }
+    svq_file.fd = vhost_svq_get_dev_call_notifier(svq);
+    r = vhost_vdpa_call(dev, VHOST_SET_VRING_CALL, &svq_file);
+    if (r) {
+        return r;
+    }
+
+    vhost_svq_start(svq, dev->vdev, virtio_get_queue(dev->vdev, file->index),
+                    file->fd);
+    return 0;
 }
 
 static int vhost_vdpa_set_vring_call(struct vhost_dev *dev,
                                        struct vhost_vring_file *file)
 {
+    struct vhost_vdpa *v = dev->opaque;
+
     trace_vhost_vdpa_set_vring_call(dev, file->index, file->fd);
+    vhost_svq_set_guest_call_notifier(vhost_vdpa_svq(dev, file->index),
+                                      file->fd);
+    if (v->shadow_vqs_enabled) {
+        /* The shadow virtqueue signals the guest */
+        return 0;
+    }
     return vhost_vdpa_call(dev, VHOST_SET_VRING_CALL, file);
 }
 
@@ -552,12 +846,74 @@ static int vhost_vdpa_get_features(struct vhost_dev *dev,
     int ret;
 
     ret = vhost_vdpa_call(dev, VHOST_GET_FEATURES, features);
+    /* Dirty pages are tracked by shadow virtqueues while migrating */
+    *features |= 0x1ULL << VHOST_F_LOG_ALL;
     trace_vhost_vdpa_get_features(dev, *features);
     return ret;
 }
 
+/**
+ * vhost_vdpa_svq_inject:
+ * @v: A started vhost-vdpa device whose first virtqueue is shadowed
+ * @out: Device readable part of the buffer
+ * @out_len: Length of @out
+ * @in: Filled with the device writable part of the buffer
+ * @in_len: Size of @in
+ *
+ * Send a buffer of QEMU's own through the first shadow virtqueue of @v,
+ * bounced through a page in its IOVA window, and wait for the device to use
+ * it.  This is meant for control virtqueue commands.
+ *
+ * Returns the number of bytes the device wrote to @in, or a negative errno.
+ */
+ssize_t vhost_vdpa_svq_inject(struct vhost_vdpa *v, const void *out,
+                              size_t out_len, void *in, size_t in_len)
+{
+    struct vhost_dev *dev = v->dev;
+    VhostShadowVirtqueue *svq = g_ptr_array_index(v->shadow_vqs, 0);
+    size_t page_size = qemu_real_host_page_size;
+    hwaddr iova = vhost_vdpa_svq_window(v, dev->vq_index) +
+                  VHOST_VDPA_SVQ_WINDOW_SIZE - page_size;
+    ssize_t r;
+
+    if (!v->shadow_vqs_enabled || !vhost_svq_started(svq) ||
+        out_len + in_len > page_size) {
+        return -EINVAL;
+    }
+
+    if (!v->svq_bounce) {
+        v->svq_bounce = qemu_memalign(page_size, page_size);
+    }
+    if (!v->svq_bounce_mapped) {
+        r = vhost_vdpa_dma_map(v, iova, page_size, v->svq_bounce, false);
+        if (r) {
+            return r;
+        }
+        v->svq_bounce_mapped = true;
+    }
+
+    memcpy(v->svq_bounce, out, out_len);
+    memset((char *)v->svq_bounce + out_len, 0, in_len);
+    r = vhost_svq_inject(svq, iova, out_len, iova + out_len, in_len);
+    if (r) {
+        return r;
+    }
+
+    r = vhost_svq_poll(svq);
+    if (r < 0) {
+        return r;
+    }
+    r = MIN(r, in_len);
+    memcpy(in, (char *)v->svq_bounce + out_len, r);
+    return r;
+}
+
 static int vhost_vdpa_set_owner(struct vhost_dev *dev)
 {
+    if (!vhost_vdpa_first_dev(dev)) {
+        return 0;
+    }
+
     trace_vhost_vdpa_set_owner(dev);
     return vhost_vdpa_call(dev, VHOST_SET_OWNER, NULL);
 }
@@ -324,30 +324,105 @@ static void balloon_stats_set_poll_interval(Object *obj, Visitor *v,
     balloon_stats_change_timer(s, 0);
 }
 
-static void virtio_balloon_handle_report(VirtIODevice *vdev, VirtQueue *vq)
+/* A range of guest memory reported free */
+typedef struct VirtIOBalloonReport {
+    RAMBlock *rb;
+    ram_addr_t offset;
+    size_t size;
+} VirtIOBalloonReport;
+
+static gint virtio_balloon_report_cmp(gconstpointer a, gconstpointer b)
 {
-    VirtIOBalloon *dev = VIRTIO_BALLOON(vdev);
+    const VirtIOBalloonReport *ra = a, *rb = b;
+
+    if (ra->rb != rb->rb) {
+        return (uintptr_t)ra->rb < (uintptr_t)rb->rb ? -1 : 1;
+    }
+    return ra->offset < rb->offset ? -1 : ra->offset > rb->offset;
+}
+
+/*
+ * Merge contiguous reports before discarding them, so that e.g. 2 MiB
+ * pages reported by the guest can add up to the 1 GiB pages of a hugetlbfs
+ * backend.  Whatever does not cover whole host pages is left alone.
+ */
+static void virtio_balloon_discard_reports(VirtIOBalloon *dev,
+                                           GArray *reports)
+{
+    uint64_t discarded = 0, ignored = 0;
+    guint i = 0;
+
+    g_array_sort(reports, virtio_balloon_report_cmp);
+    while (i < reports->len) {
+        VirtIOBalloonReport *r = &g_array_index(reports,
+                                                VirtIOBalloonReport, i);
+        RAMBlock *rb = r->rb;
+        size_t pagesize = qemu_ram_pagesize(rb);
+        ram_addr_t start = r->offset, end = r->offset + r->size;
+        ram_addr_t first, last;
+
+        for (i++; i < reports->len; i++) {
+            r = &g_array_index(reports, VirtIOBalloonReport, i);
+            if (r->rb != rb || r->offset > end) {
+                break;
+            }
+            end = MAX(end, r->offset + r->size);
+        }
+
+        first = ROUND_UP(start, pagesize);
+        last = QEMU_ALIGN_DOWN(end, pagesize);
+        if (first < last && !ram_block_discard_range(rb, first, last - first)) {
+            trace_virtio_balloon_report_discard(qemu_ram_get_idstr(rb), first,
+                                                last - first);
+            discarded += last - first;
+            ignored += (end - start) - (last - first);
+        } else {
+            ignored += end - start;
+        }
+    }
+
+    /* Only one thread updates them, but QOM reads them anytime */
+    qatomic_set_u64(&dev->reported_bytes,
+                    qatomic_read_u64(&dev->reported_bytes) + discarded);
+    qatomic_set_u64(&dev->reported_ignored_bytes,
+                    qatomic_read_u64(&dev->reported_ignored_bytes) + ignored);
+}
+
+static void virtio_balloon_process_reports(VirtIOBalloon *dev)
+{
+    VirtIODevice *vdev = VIRTIO_DEVICE(dev);
+    VirtQueue *vq = dev->reporting_vq;
+    g_autoptr(GPtrArray) elems = g_ptr_array_new_with_free_func(g_free);
+    g_autoptr(GArray) reports = g_array_new(false, false,
+                                            sizeof(VirtIOBalloonReport));
     VirtQueueElement *elem;
+    bool skip;
+    guint i;
 
-    while ((elem = virtqueue_pop(vq, sizeof(VirtQueueElement)))) {
-        unsigned int i;
+    /*
+     * When we discard the page it has the effect of removing the page
+     * from the hypervisor itself and causing it to be zeroed when it
+     * is returned to us. So we must not discard the page if it is
+     * accessible by another device or process, or if the guest is
+     * expecting it to retain a non-zero value.
+     */
+    skip = virtio_balloon_inhibited() || dev->poison_val;
 
-        /*
-         * When we discard the page it has the effect of removing the page
-         * from the hypervisor itself and causing it to be zeroed when it
-         * is returned to us. So we must not discard the page if it is
-         * accessible by another device or process, or if the guest is
-         * expecting it to retain a non-zero value.
-         */
-        if (virtio_balloon_inhibited() || dev->poison_val) {
-            goto skip_element;
+    /*
+     * The guest keeps reported pages isolated until their buffer is
+     * returned, so collect all queued buffers before giving any back:
+     * their ranges can then be merged into larger discards.
+     */
+    while ((elem = virtqueue_pop(vq, sizeof(VirtQueueElement)))) {
+        g_ptr_array_add(elems, elem);
+        if (skip) {
+            continue;
         }
 
         for (i = 0; i < elem->in_num; i++) {
-            void *addr = elem->in_sg[i].iov_base;
-            size_t size = elem->in_sg[i].iov_len;
-            ram_addr_t ram_offset;
-            RAMBlock *rb;
+            VirtIOBalloonReport report = {
+                .size = elem->in_sg[i].iov_len,
+            };
 
             /*
              * There is no need to check the memory section to see if
@@ -360,31 +435,56 @@ static void virtio_balloon_handle_report(VirtIODevice *vdev, VirtQueue *vq)
              * will return NULL after the first bounce buffer and fail
              * to map any resources.
              */
-            rb = qemu_ram_block_from_host(addr, false, &ram_offset);
-            if (!rb) {
+            report.rb = qemu_ram_block_from_host(elem->in_sg[i].iov_base,
+                                                 false, &report.offset);
+            if (!report.rb) {
                 trace_virtio_balloon_bad_addr(elem->in_addr[i]);
                 continue;
             }
 
-            /*
-             * For now we will simply ignore unaligned memory regions, or
-             * regions that overrun the end of the RAMBlock.
-             */
-            if (!QEMU_IS_ALIGNED(ram_offset | size, qemu_ram_pagesize(rb)) ||
-                (ram_offset + size) > qemu_ram_get_used_length(rb)) {
+            /* Ignore regions that overrun the end of the RAMBlock. */
+            if (report.offset + report.size >
+                qemu_ram_get_used_length(report.rb)) {
                 continue;
             }
-
-            ram_block_discard_range(rb, ram_offset, size);
+            g_array_append_val(reports, report);
         }
+    }
+
+    virtio_balloon_discard_reports(dev, reports);
 
-skip_element:
-        virtqueue_push(vq, elem, 0);
+    for (i = 0; i < elems->len; i++) {
+        virtqueue_push(vq, g_ptr_array_index(elems, i), 0);
+    }
+    if (elems->len) {
         virtio_notify(vdev, vq);
-        g_free(elem);
     }
 }
 
+static void virtio_balloon_reporting_bh(void *opaque)
+{
+    VirtIOBalloon *dev = opaque;
+
+    qemu_mutex_lock(&dev->free_page_lock);
+    while (dev->block_iothread) {
+        qemu_cond_wait(&dev->free_page_cond, &dev->free_page_lock);
+    }
+    virtio_balloon_process_reports(dev);
+    qemu_mutex_unlock(&dev->free_page_lock);
+}
+
+static void virtio_balloon_handle_report(VirtIODevice *vdev, VirtQueue *vq)
+{
+    VirtIOBalloon *dev = VIRTIO_BALLOON(vdev);
+
+    /* Discarding can take long, keep it off the main loop if possible */
+    if (dev->reporting_bh) {
+        qemu_bh_schedule(dev->reporting_bh);
+        return;
+    }
+    virtio_balloon_process_reports(dev);
+}
+
 static void virtio_balloon_handle_output(VirtIODevice *vdev, VirtQueue *vq)
 {
     VirtIOBalloon *s = VIRTIO_BALLOON(vdev);
@@ -922,6 +1022,11 @@ static void virtio_balloon_device_realize(DeviceState *dev, Error **errp)
     if (virtio_has_feature(s->host_features, VIRTIO_BALLOON_F_REPORTING)) {
         s->reporting_vq = virtio_add_queue(vdev, 32,
                                            virtio_balloon_handle_report);
+        if (s->iothread) {
+            object_ref(OBJECT(s->iothread));
+            s->reporting_bh = aio_bh_new(iothread_get_aio_context(s->iothread),
+                                         virtio_balloon_reporting_bh, s);
+        }
     }
 
     reset_stats(s);
@@ -938,6 +1043,10 @@ static void virtio_balloon_device_unrealize(DeviceState *dev)
         virtio_balloon_free_page_stop(s);
         precopy_remove_notifier(&s->free_page_hint_notify);
     }
+    if (s->reporting_bh) {
+        qemu_bh_delete(s->reporting_bh);
+        object_unref(OBJECT(s->iothread));
+    }
     balloon_stats_destroy_timer(s);
     qemu_remove_balloon_handler(s);
 
@@ -981,7 +1090,7 @@ static void virtio_balloon_set_status(VirtIODevice *vdev, uint8_t status)
         virtio_balloon_receive_stats(vdev, s->svq);
     }
 
-    if (virtio_balloon_free_page_support(s)) {
+    if (virtio_balloon_free_page_support(s) || s->reporting_bh) {
         /*
          * The VM is woken up and the iothread was blocked, so signal it to
          * continue.
@@ -1018,6 +1127,12 @@ static void virtio_balloon_instance_init(Object *obj)
                         balloon_stats_get_poll_interval,
                         balloon_stats_set_poll_interval,
                         NULL, s);
+
+    object_property_add_uint64_ptr(obj, "free-page-reporting-discarded",
+                                   &s->reported_bytes, OBJ_PROP_FLAG_READ);
+    object_property_add_uint64_ptr(obj, "free-page-reporting-ignored",
+                                   &s->reported_ignored_bytes,
+                                   OBJ_PROP_FLAG_READ);
 }
 
 static const VMStateDescription vmstate_virtio_balloon = {
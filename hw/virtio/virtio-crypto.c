@@ -17,6 +17,7 @@
 #include "qemu/module.h"
 #include "qapi/error.h"
 #include "qemu/error-report.h"
+#include "block/aio-wait.h"
 
 #include "hw/virtio/virtio.h"
 #include "hw/virtio/virtio-crypto.h"
@@ -336,6 +337,7 @@ static void virtio_crypto_init_request(VirtIOCrypto *vcrypto, VirtQueue *vq,
     req->vq = vq;
     req->in = NULL;
     req->in_iov = NULL;
+    req->in_iov_copy = NULL;
     req->in_num = 0;
     req->in_len = 0;
     req->flags = CRYPTODEV_BACKEND_ALG__MAX;
@@ -359,6 +361,7 @@ static void virtio_crypto_free_request(VirtIOCryptoReq *req)
             memset(op_info, 0, sizeof(*op_info) + max_len);
             g_free(op_info);
         }
+        g_free(req->in_iov_copy);
         g_free(req);
     }
 }
@@ -411,6 +414,17 @@ static void virtio_crypto_req_complete(VirtIOCryptoReq *req, uint8_t status)
     virtio_notify(vdev, req->vq);
 }
 
+static void virtio_crypto_sym_op_complete(void *opaque, int ret)
+{
+    VirtIOCryptoReq *req = opaque;
+    VirtIOCrypto *vcrypto = req->vcrypto;
+
+    /* ret is VIRTIO_CRYPTO_OK or -VIRTIO_CRYPTO_* */
+    virtio_crypto_req_complete(req, ret < 0 ? -ret : ret);
+    virtio_crypto_free_request(req);
+    vcrypto->inflight--;
+}
+
 static VirtIOCryptoReq *
 virtio_crypto_get_request(VirtIOCrypto *s, VirtQueue *vq)
 {
@@ -594,10 +608,8 @@ virtio_crypto_handle_request(VirtIOCryptoReq *request)
     unsigned in_num;
     unsigned out_num;
     uint32_t opcode;
-    uint8_t status = VIRTIO_CRYPTO_ERR;
     uint64_t session_id;
     CryptoDevBackendSymOpInfo *sym_op_info = NULL;
-    Error *local_err = NULL;
 
     if (elem->out_num < 1 || elem->in_num < 1) {
         virtio_error(vdev, "virtio-crypto dataq missing headers");
@@ -660,18 +672,12 @@ virtio_crypto_handle_request(VirtIOCryptoReq *request)
             /* Set request's parameter */
             request->flags = CRYPTODEV_BACKEND_ALG_SYM;
             request->u.sym_op_info = sym_op_info;
-            ret = cryptodev_backend_crypto_operation(vcrypto->cryptodev,
-                                    request, queue_index, &local_err);
-            if (ret < 0) {
-                status = -ret;
-                if (local_err) {
-                    error_report_err(local_err);
-                }
-            } else { /* ret == VIRTIO_CRYPTO_OK */
-                status = ret;
-            }
-            virtio_crypto_req_complete(request, status);
-            virtio_crypto_free_request(request);
+            /* The request may complete after we return */
+            request->in_iov_copy = g_steal_pointer(&in_iov_copy);
+            vcrypto->inflight++;
+            cryptodev_backend_crypto_operation_async(vcrypto->cryptodev,
+                                    request, queue_index,
+                                    virtio_crypto_sym_op_complete, request);
         }
         break;
     case VIRTIO_CRYPTO_HASH:
@@ -756,6 +762,8 @@ static uint64_t virtio_crypto_get_features(VirtIODevice *vdev,
 static void virtio_crypto_reset(VirtIODevice *vdev)
 {
     VirtIOCrypto *vcrypto = VIRTIO_CRYPTO(vdev);
+
+    AIO_WAIT_WHILE(NULL, vcrypto->inflight > 0);
     /* multiqueue is disabled by default */
     vcrypto->curr_queues = 1;
     if (!cryptodev_backend_is_ready(vcrypto->cryptodev)) {
@@ -839,6 +847,8 @@ static void virtio_crypto_device_unrealize(DeviceState *dev)
     VirtIOCryptoQueue *q;
     int i, max_queues;
 
+    AIO_WAIT_WHILE(NULL, vcrypto->inflight > 0);
+
     max_queues = vcrypto->multiqueue ? vcrypto->max_queues : 1;
     for (i = 0; i < max_queues; i++) {
         virtio_delete_queue(vcrypto->vqs[i].dataq);
@@ -937,6 +947,10 @@ static void virtio_crypto_set_status(VirtIODevice *vdev, uint8_t status)
 {
     VirtIOCrypto *vcrypto = VIRTIO_CRYPTO(vdev);
 
+    /* Finish the requests in flight before the VM stops */
+    if (!vdev->vm_running) {
+        AIO_WAIT_WHILE(NULL, vcrypto->inflight > 0);
+    }
     virtio_crypto_vhost_status(vcrypto, status);
 }
 
@@ -232,6 +232,19 @@ static int virtio_mem_set_block_state(VirtIOMEM *vmem, uint64_t start_gpa,
                          strerror(-ret));
             return -EBUSY;
         }
+    } else if (vmem->prealloc) {
+        Error *local_err = NULL;
+
+        /* The whole request at once, with the memdev's prealloc threads */
+        trace_virtio_mem_prealloc(start_gpa, size);
+        host_memory_backend_prealloc_range(vmem->memdev, offset, size,
+                                           &local_err);
+        if (local_err) {
+            error_report_err(local_err);
+            /* Don't keep a partially populated range around */
+            ram_block_discard_range(vmem->memdev->mr.ram_block, offset, size);
+            return -EBUSY;
+        }
     }
     virtio_mem_set_bitmap(vmem, start_gpa, size, plug);
     return 0;
@@ -551,6 +564,12 @@ static void virtio_mem_device_realize(DeviceState *dev, Error **errp)
         return;
     }
 
+    if (vmem->memdev->prealloc) {
+        warn_report("'prealloc' of the memdev is lost when its memory is"
+                    " discarded, set the '%s' property instead",
+                    VIRTIO_MEM_PREALLOC_PROP);
+    }
+
     if (ram_block_discard_require(true)) {
         error_setg(errp, "Discarding RAM is disabled");
         return;
@@ -935,6 +954,7 @@ static void virtio_mem_instance_init(Object *obj)
 static Property virtio_mem_properties[] = {
     DEFINE_PROP_UINT64(VIRTIO_MEM_ADDR_PROP, VirtIOMEM, addr, 0),
     DEFINE_PROP_UINT32(VIRTIO_MEM_NODE_PROP, VirtIOMEM, node, 0),
+    DEFINE_PROP_BOOL(VIRTIO_MEM_PREALLOC_PROP, VirtIOMEM, prealloc, false),
     DEFINE_PROP_LINK(VIRTIO_MEM_MEMDEV_PROP, VirtIOMEM, memdev,
                      TYPE_MEMORY_BACKEND, HostMemoryBackend *),
     DEFINE_PROP_END_OF_LIST(),
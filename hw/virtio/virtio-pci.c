@@ -723,8 +723,10 @@ static int kvm_virtio_pci_vector_use(VirtIOPCIProxy *proxy, int nvqs)
     VirtIODevice *vdev = virtio_bus_get_device(&proxy->bus);
     VirtioDeviceClass *k = VIRTIO_DEVICE_GET_CLASS(vdev);
     unsigned int vector;
-    int ret, queue_no;
+    int ret, queue_no, nr_used;
 
+    /* Add all routes first, so that KVM gets them in one go */
+    kvm_irqchip_begin_route_changes(kvm_state);
     for (queue_no = 0; queue_no < nvqs; queue_no++) {
         if (!virtio_queue_get_num(vdev, queue_no)) {
             break;
@@ -735,29 +737,44 @@ static int kvm_virtio_pci_vector_use(VirtIOPCIProxy *proxy, int nvqs)
         }
         ret = kvm_virtio_pci_vq_vector_use(proxy, queue_no, vector);
         if (ret < 0) {
-            goto undo;
+            kvm_irqchip_end_route_changes(kvm_state);
+            goto undo_routes;
         }
-        /* If guest supports masking, set up irqfd now.
-         * Otherwise, delay until unmasked in the frontend.
-         */
-        if (vdev->use_guest_notifier_mask && k->guest_notifier_mask) {
+    }
+    kvm_irqchip_end_route_changes(kvm_state);
+    nr_used = queue_no;
+
+    /* If guest supports masking, set up irqfds now.
+     * Otherwise, delay until unmasked in the frontend.
+     */
+    if (vdev->use_guest_notifier_mask && k->guest_notifier_mask) {
+        for (queue_no = 0; queue_no < nr_used; queue_no++) {
+            vector = virtio_queue_vector(vdev, queue_no);
+            if (vector >= msix_nr_vectors_allocated(dev)) {
+                continue;
+            }
             ret = kvm_virtio_pci_irqfd_use(proxy, queue_no, vector);
             if (ret < 0) {
-                kvm_virtio_pci_vq_vector_release(proxy, vector);
-                goto undo;
+                goto undo_irqfds;
             }
         }
     }
     return 0;
 
-undo:
+undo_irqfds:
     while (--queue_no >= 0) {
         vector = virtio_queue_vector(vdev, queue_no);
         if (vector >= msix_nr_vectors_allocated(dev)) {
             continue;
         }
-        if (vdev->use_guest_notifier_mask && k->guest_notifier_mask) {
-            kvm_virtio_pci_irqfd_release(proxy, queue_no, vector);
+        kvm_virtio_pci_irqfd_release(proxy, queue_no, vector);
+    }
+    queue_no = nr_used;
+undo_routes:
+    while (--queue_no >= 0) {
+        vector = virtio_queue_vector(vdev, queue_no);
+        if (vector >= msix_nr_vectors_allocated(dev)) {
+            continue;
         }
         kvm_virtio_pci_vq_vector_release(proxy, vector);
     }
@@ -822,6 +839,8 @@ static int virtio_pci_vq_vector_unmask(VirtIOPCIProxy *proxy,
         /* Test after unmasking to avoid losing events. */
         if (k->guest_notifier_pending &&
             k->guest_notifier_pending(vdev, queue_no)) {
+            /* The route updated above may still be deferred */
+            kvm_irqchip_sync_routes(kvm_state);
             event_notifier_set(n);
         }
     } else {
@@ -1138,6 +1157,25 @@ static int virtio_pci_add_mem_cap(VirtIOPCIProxy *proxy,
     return offset;
 }
 
+int virtio_pci_add_shm_cap(VirtIOPCIProxy *proxy,
+                           uint8_t bar, uint64_t offset, uint64_t length,
+                           uint8_t id)
+{
+    struct virtio_pci_cap64 cap = {
+        .cap.cap_len = sizeof cap,
+        .cap.cfg_type = VIRTIO_PCI_CAP_SHARED_MEMORY_CFG,
+    };
+
+    cap.cap.bar = bar;
+    cap.cap.id = id;
+    cap.cap.length = cpu_to_le32(length);
+    cap.length_hi = cpu_to_le32(length >> 32);
+    cap.cap.offset = cpu_to_le32(offset);
+    cap.offset_hi = cpu_to_le32(offset >> 32);
+
+    return virtio_pci_add_mem_cap(proxy, &cap.cap);
+}
+
 static uint64_t virtio_pci_common_read(void *opaque, hwaddr addr,
                                        unsigned size)
 {
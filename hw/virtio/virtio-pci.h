@@ -243,6 +243,14 @@ typedef struct VirtioPCIDeviceTypeInfo {
 /* Register virtio-pci type(s).  @t must be static. */
 void virtio_pci_types_register(const VirtioPCIDeviceTypeInfo *t);
 
+/*
+ * Describe a shared memory region of the device with id @id, found at
+ * @offset in BAR @bar; returns the offset of the capability.
+ */
+int virtio_pci_add_shm_cap(VirtIOPCIProxy *proxy,
+                           uint8_t bar, uint64_t offset, uint64_t length,
+                           uint8_t id);
+
 /**
  * virtio_pci_optimal_num_queues:
  * @fixed_queues: number of queues that are always present
@@ -18,6 +18,7 @@
 #include "exec/address-spaces.h"
 #include "qemu/error-report.h"
 #include "qemu/log.h"
+#include "qemu/iov.h"
 #include "qemu/main-loop.h"
 #include "qemu/module.h"
 #include "hw/virtio/virtio.h"
@@ -72,6 +73,21 @@ typedef struct VRingUsed
     VRingUsedElem ring[];
 } VRingUsed;
 
+/*
+ * With VIRTIO_F_IN_ORDER, buffers must be used in the order in which they
+ * were made available, but devices complete requests in any order.  Popped
+ * elements are tracked by their position in the avail ring (split) or in
+ * the descriptor ring (packed) until everything before them is complete.
+ */
+typedef struct VirtQueueInOrderElem {
+    unsigned int index;
+    unsigned int len;
+    unsigned int ndescs;
+    bool filled;
+    /* len covers all device-writable descriptors */
+    bool full;
+} VirtQueueInOrderElem;
+
 typedef struct VRingMemoryRegionCaches {
     struct rcu_head rcu;
     MemoryRegionCache desc;
@@ -131,9 +147,44 @@ struct VirtQueue
     EventNotifier guest_notifier;
     EventNotifier host_notifier;
     bool host_notifier_enabled;
+    uint32_t *host_notifier_poll_flags;
+    VirtQueueElementPool *element_pool;
+    VirtQueueInOrderElem *in_order_elems;
     QLIST_ENTRY(VirtQueue) node;
 };
 
+/*
+ * Largest number of descriptors (in_num + out_num) for which an element is
+ * taken from the pool; longer chains are rare and use g_malloc().
+ */
+#define VIRTQUEUE_ELEMENT_POOL_MAX_SG 64
+
+typedef struct VirtQueueElementSlot {
+    QSLIST_ENTRY(VirtQueueElementSlot) next;
+} VirtQueueElementSlot;
+
+/*
+ * A cache of fixed-size element allocations for one virtqueue.
+ *
+ * free_slots is only touched by the thread popping from the virtqueue,
+ * which the device already serializes.  Elements can be freed from any
+ * thread; they are pushed atomically to returned_slots, and the popping
+ * side takes the whole list over when free_slots runs out.  The number of
+ * slots therefore never exceeds the largest number of requests that were
+ * in flight at the same time.
+ *
+ * Each element taken from the pool holds a reference, so that requests that
+ * are still in flight when the virtqueue is deleted can free their element.
+ */
+struct VirtQueueElementPool {
+    size_t sz;              /* largest element size, as passed to pop */
+    unsigned int max_sg;    /* largest in_num + out_num */
+    size_t slot_size;
+    int refcnt;
+    QSLIST_HEAD(, VirtQueueElementSlot) free_slots;
+    QSLIST_HEAD(, VirtQueueElementSlot) returned_slots;
+};
+
 static void virtio_free_region_cache(VRingMemoryRegionCaches *caches)
 {
     if (!caches) {
@@ -774,6 +825,125 @@ bool virtqueue_rewind(VirtQueue *vq, unsigned int num)
     return true;
 }
 
+static bool virtio_queue_in_order(VirtQueue *vq)
+{
+    return virtio_vdev_has_feature(vq->vdev, VIRTIO_F_IN_ORDER);
+}
+
+/* Position of the oldest element that has not been used yet */
+static unsigned int virtqueue_in_order_head(VirtQueue *vq)
+{
+    if (virtio_vdev_has_feature(vq->vdev, VIRTIO_F_RING_PACKED)) {
+        return vq->used_idx;
+    }
+    return vq->used_idx % vq->vring.num;
+}
+
+/* Number of ring positions taken by elements that have not been used yet */
+static unsigned int virtqueue_in_order_pending(VirtQueue *vq)
+{
+    int pending;
+
+    if (!virtio_vdev_has_feature(vq->vdev, VIRTIO_F_RING_PACKED)) {
+        return (uint16_t)(vq->last_avail_idx - vq->used_idx);
+    }
+
+    pending = vq->last_avail_idx - vq->used_idx;
+    if (pending < 0 ||
+        (pending == 0 &&
+         vq->last_avail_wrap_counter != vq->used_wrap_counter)) {
+        pending += vq->vring.num;
+    }
+    return pending;
+}
+
+static void virtqueue_in_order_record(VirtQueue *vq, unsigned int pos,
+                                      unsigned int index, unsigned int ndescs)
+{
+    VirtQueueInOrderElem *e;
+
+    if (!vq->in_order_elems) {
+        vq->in_order_elems = g_new0(VirtQueueInOrderElem, VIRTQUEUE_MAX_SIZE);
+    }
+
+    e = &vq->in_order_elems[pos];
+    e->index = index;
+    e->ndescs = ndescs;
+    e->filled = false;
+}
+
+/*
+ * Elements that were in flight on the migration source are not tracked yet,
+ * find them again in the rings.
+ * Called within rcu_read_lock().
+ */
+static void virtqueue_in_order_restore(VirtQueue *vq)
+{
+    unsigned int head = virtqueue_in_order_head(vq);
+    unsigned int pending = virtqueue_in_order_pending(vq);
+    unsigned int offset = 0;
+    VRingMemoryRegionCaches *caches;
+
+    if (!virtio_vdev_has_feature(vq->vdev, VIRTIO_F_RING_PACKED)) {
+        for (offset = 0; offset < pending; offset++) {
+            unsigned int pos = (head + offset) % vq->vring.num;
+
+            virtqueue_in_order_record(vq, pos, vring_avail_ring(vq, pos), 1);
+        }
+        return;
+    }
+
+    caches = vring_get_region_caches(vq);
+    if (!caches) {
+        return;
+    }
+
+    while (offset < pending) {
+        unsigned int pos = (head + offset) % vq->vring.num;
+        unsigned int ndescs = 0;
+        VRingPackedDesc desc;
+
+        /* The buffer id is in the last descriptor of the chain */
+        do {
+            vring_packed_desc_read(vq->vdev, &desc, &caches->desc,
+                                   (pos + ndescs) % vq->vring.num, false);
+            ndescs++;
+        } while ((desc.flags & VRING_DESC_F_NEXT) &&
+                 offset + ndescs < pending);
+
+        virtqueue_in_order_record(vq, pos, desc.id, ndescs);
+        offset += ndescs;
+    }
+}
+
+static void virtqueue_in_order_fill(VirtQueue *vq, const VirtQueueElement *elem,
+                                    unsigned int len)
+{
+    unsigned int pos = virtqueue_in_order_head(vq);
+    unsigned int pending = virtqueue_in_order_pending(vq);
+    unsigned int steps = 0;
+
+    /* Completions mostly come in order, so this finds elem quickly */
+    while (vq->in_order_elems && steps < pending) {
+        VirtQueueInOrderElem *e = &vq->in_order_elems[pos];
+
+        if (!e->ndescs) {
+            break;
+        }
+        if (!e->filled && e->index == elem->index) {
+            e->len = len;
+            e->full = len == iov_size(elem->in_sg, elem->in_num);
+            e->filled = true;
+            return;
+        }
+        steps += e->ndescs;
+        pos = (pos + e->ndescs) % vq->vring.num;
+    }
+
+    virtio_error(vq->vdev, "Used element %u was not made available",
+                 elem->index);
+}
+
 static void virtqueue_split_fill(VirtQueue *vq, const VirtQueueElement *elem,
                     unsigned int len, unsigned int idx)
 {
@@ -848,13 +1018,84 @@ void virtqueue_fill(VirtQueue *vq, const VirtQueueElement *elem,
         return;
     }
 
-    if (virtio_vdev_has_feature(vq->vdev, VIRTIO_F_RING_PACKED)) {
+    if (virtio_queue_in_order(vq)) {
+        virtqueue_in_order_fill(vq, elem, len);
+    } else if (virtio_vdev_has_feature(vq->vdev, VIRTIO_F_RING_PACKED)) {
         virtqueue_packed_fill(vq, elem, len, idx);
     } else {
         virtqueue_split_fill(vq, elem, len, idx);
     }
 }
 
+/*
+ * Collect the run of completed elements at the head of an in-order
+ * virtqueue.  A batch of buffers is used by writing a single used entry
+ * with the id and length of its last buffer, so a batch only extends past
+ * the buffers whose whole device-writable part was written, which is what
+ * the driver assumes for them.
+ *
+ * For each batch, @fn is called with its offset from the head (in ring
+ * positions) and with its last element.  Returns the number of ring
+ * positions used and stores the number of elements in @count.
+ */
+static unsigned int virtqueue_in_order_collect(VirtQueue *vq,
+        void (*fn)(VirtQueue *vq, unsigned int offset,
+                   const VirtQueueInOrderElem *last),
+        unsigned int *count)
+{
+    unsigned int head = virtqueue_in_order_head(vq);
+    unsigned int pending = virtqueue_in_order_pending(vq);
+    unsigned int offset = 0, batch_offset = 0;
+
+    *count = 0;
+    while (vq->in_order_elems && offset < pending) {
+        VirtQueueInOrderElem *e =
+            &vq->in_order_elems[(head + offset) % vq->vring.num];
+        VirtQueueInOrderElem *next;
+
+        if (!e->filled) {
+            break;
+        }
+        e->filled = false;
+        offset += e->ndescs;
+        (*count)++;
+
+        next = &vq->in_order_elems[(head + offset) % vq->vring.num];
+        if (!e->full || offset >= pending || !next->filled) {
+            fn(vq, batch_offset, e);
+            batch_offset = offset;
+        }
+    }
+    return offset;
+}
+
+static void virtqueue_split_write_in_order(VirtQueue *vq, unsigned int offset,
+                                           const VirtQueueInOrderElem *last)
+{
+    VRingUsedElem uelem = {
+        .id = last->index,
+        .len = last->len,
+    };
+
+    vring_used_write(vq, &uelem, (vq->used_idx + offset) % vq->vring.num);
+}
+
+static void virtqueue_packed_write_in_order(VirtQueue *vq, unsigned int offset,
+                                            const VirtQueueInOrderElem *last)
+{
+    VirtQueueElement elem = {
+        .index = last->index,
+        .len = last->len,
+    };
+
+    /* The first batch is written last, see virtqueue_packed_flush() */
+    if (offset) {
+        virtqueue_packed_fill_desc(vq, &elem, offset, false);
+    } else {
+        vq->used_elems[0] = elem;
+    }
+}
+
 /* Called within rcu_read_lock().  */
 static void virtqueue_split_flush(VirtQueue *vq, unsigned int count)
 {
@@ -898,6 +1139,40 @@ static void virtqueue_packed_flush(VirtQueue *vq, unsigned int count)
     }
 }
 
+/* Called within rcu_read_lock().  */
+static void virtqueue_in_order_flush(VirtQueue *vq)
+{
+    unsigned int count, ndescs;
+
+    if (!virtio_vdev_has_feature(vq->vdev, VIRTIO_F_RING_PACKED)) {
+        if (unlikely(!vq->vring.used)) {
+            return;
+        }
+        virtqueue_in_order_collect(vq, virtqueue_split_write_in_order, &count);
+        if (count) {
+            virtqueue_split_flush(vq, count);
+        }
+        return;
+    }
+
+    if (unlikely(!vq->vring.desc)) {
+        return;
+    }
+    ndescs = virtqueue_in_order_collect(vq, virtqueue_packed_write_in_order,
+                                        &count);
+    if (!count) {
+        return;
+    }
+    virtqueue_packed_fill_desc(vq, &vq->used_elems[0], 0, true);
+
+    vq->inuse -= ndescs;
+    vq->used_idx += ndescs;
+    if (vq->used_idx >= vq->vring.num) {
+        vq->used_idx -= vq->vring.num;
+        vq->used_wrap_counter ^= 1;
+    }
+}
+
 void virtqueue_flush(VirtQueue *vq, unsigned int count)
 {
     if (virtio_device_disabled(vq->vdev)) {
@@ -905,7 +1180,10 @@ void virtqueue_flush(VirtQueue *vq, unsigned int count)
         return;
     }
 
-    if (virtio_vdev_has_feature(vq->vdev, VIRTIO_F_RING_PACKED)) {
+    if (virtio_queue_in_order(vq)) {
+        /* Uses everything that can be, not necessarily @count elements */
+        virtqueue_in_order_flush(vq);
+    } else if (virtio_vdev_has_feature(vq->vdev, VIRTIO_F_RING_PACKED)) {
         virtqueue_packed_flush(vq, count);
     } else {
         virtqueue_split_flush(vq, count);
@@ -920,6 +1198,32 @@ void virtqueue_push(VirtQueue *vq, const VirtQueueElement *elem,
     virtqueue_flush(vq, 1);
 }
 
+/*
+ * virtqueue_push_batch:
+ * @vq: The #VirtQueue
+ * @elems: The elements to return to the guest
+ * @lens: The number of bytes written into each element
+ * @count: Number of elements
+ *
+ * Like virtqueue_push() for @count elements, but the used index is only
+ * updated once.
+ */
+void virtqueue_push_batch(VirtQueue *vq, VirtQueueElement *const *elems,
+                          const unsigned int *lens, unsigned int count)
+{
+    unsigned int i;
+
+    if (!count) {
+        return;
+    }
+
+    RCU_READ_LOCK_GUARD();
+    for (i = 0; i < count; i++) {
+        virtqueue_fill(vq, elems[i], lens ? lens[i] : 0, i);
+    }
+    virtqueue_flush(vq, count);
+}
+
 /* Called within rcu_read_lock().  */
 static int virtqueue_num_heads(VirtQueue *vq, unsigned int idx)
 {
@@ -1389,7 +1693,8 @@ void virtqueue_map(VirtIODevice *vdev, VirtQueueElement *elem)
                                                                         false);
 }
 
-static void *virtqueue_alloc_element(size_t sz, unsigned out_num, unsigned in_num)
+static size_t virtqueue_element_size(size_t sz, unsigned out_num,
+                                     unsigned in_num)
 {
     VirtQueueElement *elem;
     size_t in_addr_ofs = QEMU_ALIGN_UP(sz, __alignof__(elem->in_addr[0]));
@@ -1397,11 +1702,124 @@ static void *virtqueue_alloc_element(size_t sz, unsigned out_num, unsigned in_nu
     size_t out_addr_end = out_addr_ofs + out_num * sizeof(elem->out_addr[0]);
     size_t in_sg_ofs = QEMU_ALIGN_UP(out_addr_end, __alignof__(elem->in_sg[0]));
     size_t out_sg_ofs = in_sg_ofs + in_num * sizeof(elem->in_sg[0]);
-    size_t out_sg_end = out_sg_ofs + out_num * sizeof(elem->out_sg[0]);
 
+    return out_sg_ofs + out_num * sizeof(elem->out_sg[0]);
+}
+
+static void virtqueue_element_pool_unref(VirtQueueElementPool *pool)
+{
+    VirtQueueElementSlot *slot, *next_slot;
+
+    if (qatomic_fetch_dec(&pool->refcnt) != 1) {
+        return;
+    }
+
+    QSLIST_FOREACH_SAFE(slot, &pool->free_slots, next, next_slot) {
+        g_free(slot);
+    }
+    QSLIST_FOREACH_SAFE(slot, &pool->returned_slots, next, next_slot) {
+        g_free(slot);
+    }
+    g_free(pool);
+}
+
+/* Called by the thread that pops from the virtqueue */
+static void *virtqueue_element_pool_get(VirtQueueElementPool *pool)
+{
+    VirtQueueElementSlot *slot = QSLIST_FIRST(&pool->free_slots);
+
+    if (!slot) {
+        QSLIST_MOVE_ATOMIC(&pool->free_slots, &pool->returned_slots);
+        slot = QSLIST_FIRST(&pool->free_slots);
+    }
+
+    qatomic_inc(&pool->refcnt);
+    if (slot) {
+        QSLIST_REMOVE_HEAD(&pool->free_slots, next);
+        return slot;
+    }
+    return g_malloc(pool->slot_size);
+}
+
+/**
+ * virtio_queue_enable_element_pool:
+ * @vq: The #VirtQueue
+ * @sz: Size of the device's request struct, as passed to virtqueue_pop()
+ *
+ * Recycle the memory of the elements popped from @vq instead of allocating
+ * each one with g_malloc().  The device must free the elements it pops from
+ * @vq with virtqueue_element_free().
+ */
+void virtio_queue_enable_element_pool(VirtQueue *vq, size_t sz)
+{
+    VirtQueueElementPool *pool;
+
+    assert(!vq->element_pool);
     assert(sz >= sizeof(VirtQueueElement));
-    elem = g_malloc(out_sg_end);
+
+    pool = g_new0(VirtQueueElementPool, 1);
+    pool->sz = sz;
+    pool->max_sg = MIN(vq->vring.num_default, VIRTQUEUE_ELEMENT_POOL_MAX_SG);
+    pool->slot_size = virtqueue_element_size(sz, pool->max_sg, 0);
+    pool->refcnt = 1;
+    QSLIST_INIT(&pool->free_slots);
+    QSLIST_INIT(&pool->returned_slots);
+    vq->element_pool = pool;
+}
+
+static void virtio_queue_release_element_pool(VirtQueue *vq)
+{
+    if (vq->element_pool) {
+        virtqueue_element_pool_unref(vq->element_pool);
+        vq->element_pool = NULL;
+    }
+}
+
+/**
+ * virtqueue_element_free:
+ * @elem: An element returned by virtqueue_pop() or qemu_get_virtqueue_element()
+ *
+ * Free @elem, returning it to the pool of its virtqueue if it has one.  This
+ * can be called from any thread.
+ */
+void virtqueue_element_free(VirtQueueElement *elem)
+{
+    VirtQueueElementPool *pool;
+
+    if (!elem) {
+        return;
+    }
+
+    pool = elem->pool;
+    if (!pool) {
+        g_free(elem);
+        return;
+    }
+
+    QSLIST_INSERT_HEAD_ATOMIC(&pool->returned_slots,
+                              (VirtQueueElementSlot *)elem, next);
+    virtqueue_element_pool_unref(pool);
+}
+
+static void *virtqueue_alloc_element(VirtQueueElementPool *pool, size_t sz,
+                                     unsigned out_num, unsigned in_num)
+{
+    VirtQueueElement *elem;
+    size_t in_addr_ofs = QEMU_ALIGN_UP(sz, __alignof__(elem->in_addr[0]));
+    size_t out_addr_ofs = in_addr_ofs + in_num * sizeof(elem->in_addr[0]);
+    size_t out_addr_end = out_addr_ofs + out_num * sizeof(elem->out_addr[0]);
+    size_t in_sg_ofs = QEMU_ALIGN_UP(out_addr_end, __alignof__(elem->in_sg[0]));
+    size_t out_sg_ofs = in_sg_ofs + in_num * sizeof(elem->in_sg[0]);
+
+    assert(sz >= sizeof(VirtQueueElement));
+    if (pool && sz <= pool->sz && out_num + in_num <= pool->max_sg) {
+        elem = virtqueue_element_pool_get(pool);
+    } else {
+        elem = g_malloc(virtqueue_element_size(sz, out_num, in_num));
+        pool = NULL;
+    }
     trace_virtqueue_alloc_element(elem, sz, in_num, out_num);
+    elem->pool = pool;
     elem->out_num = out_num;
     elem->in_num = in_num;
     elem->in_addr = (void *)elem + in_addr_ofs;
@@ -1411,10 +1829,16 @@ static void *virtqueue_alloc_element(size_t sz, unsigned out_num, unsigned in_nu
     return elem;
 }
 
-static void *virtqueue_split_pop(VirtQueue *vq, size_t sz)
+/*
+ * Pop the element at vq->last_avail_idx, which the caller has checked to be
+ * available.  The caller updates the avail event.
+ * Called within rcu_read_lock().
+ */
+static VirtQueueElement *
+virtqueue_split_pop_avail(VirtQueue *vq, size_t sz,
+                          VRingMemoryRegionCaches *caches)
 {
     unsigned int i, head, max;
-    VRingMemoryRegionCaches *caches;
     MemoryRegionCache indirect_desc_cache = MEMORY_REGION_CACHE_INVALID;
     MemoryRegionCache *desc_cache;
     int64_t len;
@@ -1426,14 +1850,6 @@ static void *virtqueue_split_pop(VirtQueue *vq, size_t sz)
     VRingDesc desc;
     int rc;
 
-    RCU_READ_LOCK_GUARD();
-    if (virtio_queue_empty_rcu(vq)) {
-        goto done;
-    }
-    /* Needed after virtio_queue_empty(), see comment in
-     * virtqueue_num_heads(). */
-    smp_rmb();
-
     /* When we start there are none of either input nor output. */
     out_num = in_num = elem_entries = 0;
 
@@ -1448,23 +1864,8 @@ static void *virtqueue_split_pop(VirtQueue *vq, size_t sz)
         goto done;
     }
 
-    if (virtio_vdev_has_feature(vdev, VIRTIO_RING_F_EVENT_IDX)) {
-        vring_set_avail_event(vq, vq->last_avail_idx);
-    }
-
     i = head;
 
-    caches = vring_get_region_caches(vq);
-    if (!caches) {
-        virtio_error(vdev, "Region caches not initialized");
-        goto done;
-    }
-
-    if (caches->desc.len < max * sizeof(VRingDesc)) {
-        virtio_error(vdev, "Cannot map descriptor ring");
-        goto done;
-    }
-
     desc_cache = &caches->desc;
     vring_split_desc_read(vdev, &desc, desc_cache, i);
     if (desc.flags & VRING_DESC_F_INDIRECT) {
@@ -1523,9 +1924,14 @@ static void *virtqueue_split_pop(VirtQueue *vq, size_t sz)
     }
 
     /* Now copy what we have collected and mapped */
-    elem = virtqueue_alloc_element(sz, out_num, in_num);
+    elem = virtqueue_alloc_element(vq->element_pool, sz, out_num, in_num);
     elem->index = head;
     elem->ndescs = 1;
+    if (virtio_queue_in_order(vq)) {
+        virtqueue_in_order_record(vq,
+                                  (uint16_t)(vq->last_avail_idx - 1) %
+                                  vq->vring.num, head, 1);
+    }
     for (i = 0; i < out_num; i++) {
         elem->out_addr[i] = addr[i];
         elem->out_sg[i] = iov[i];
@@ -1548,6 +1954,90 @@ err_undo_map:
     goto done;
 }
 
+/* Called within rcu_read_lock().  */
+static VRingMemoryRegionCaches *virtqueue_split_pop_caches(VirtQueue *vq)
+{
+    VRingMemoryRegionCaches *caches = vring_get_region_caches(vq);
+
+    if (!caches) {
+        virtio_error(vq->vdev, "Region caches not initialized");
+        return NULL;
+    }
+
+    if (caches->desc.len < vq->vring.num * sizeof(VRingDesc)) {
+        virtio_error(vq->vdev, "Cannot map descriptor ring");
+        return NULL;
+    }
+
+    return caches;
+}
+
+static void *virtqueue_split_pop(VirtQueue *vq, size_t sz)
+{
+    VRingMemoryRegionCaches *caches;
+    VirtQueueElement *elem;
+
+    RCU_READ_LOCK_GUARD();
+    if (virtio_queue_empty_rcu(vq)) {
+        return NULL;
+    }
+    /* Needed after virtio_queue_empty(), see comment in
+     * virtqueue_num_heads(). */
+    smp_rmb();
+
+    caches = virtqueue_split_pop_caches(vq);
+    if (!caches) {
+        return NULL;
+    }
+
+    elem = virtqueue_split_pop_avail(vq, sz, caches);
+
+    if (virtio_vdev_has_feature(vq->vdev, VIRTIO_RING_F_EVENT_IDX)) {
+        vring_set_avail_event(vq, vq->last_avail_idx);
+    }
+
+    return elem;
+}
+
+static unsigned int virtqueue_split_pop_batch(VirtQueue *vq, size_t sz,
+                                              void **elems, unsigned int max)
+{
+    VRingMemoryRegionCaches *caches;
+    unsigned int n = 0;
+    int num_heads;
+
+    RCU_READ_LOCK_GUARD();
+    if (virtio_queue_empty_rcu(vq)) {
+        return 0;
+    }
+
+    /* A single avail index read and barrier for the whole batch */
+    num_heads = virtqueue_num_heads(vq, vq->last_avail_idx);
+    if (num_heads <= 0) {
+        return 0;
+    }
+
+    caches = virtqueue_split_pop_caches(vq);
+    if (!caches) {
+        return 0;
+    }
+
+    while (n < MIN(num_heads, max)) {
+        VirtQueueElement *elem = virtqueue_split_pop_avail(vq, sz, caches);
+
+        if (!elem) {
+            break;
+        }
+        elems[n++] = elem;
+    }
+
+    if (n && virtio_vdev_has_feature(vq->vdev, VIRTIO_RING_F_EVENT_IDX)) {
+        vring_set_avail_event(vq, vq->last_avail_idx);
+    }
+
+    return n;
+}
+
 static void *virtqueue_packed_pop(VirtQueue *vq, size_t sz)
 {
     unsigned int i, max;
@@ -1649,7 +2139,7 @@ static void *virtqueue_packed_pop(VirtQueue *vq, size_t sz)
     } while (rc == VIRTQUEUE_READ_DESC_MORE);
 
     /* Now copy what we have collected and mapped */
-    elem = virtqueue_alloc_element(sz, out_num, in_num);
+    elem = virtqueue_alloc_element(vq->element_pool, sz, out_num, in_num);
     for (i = 0; i < out_num; i++) {
         elem->out_addr[i] = addr[i];
         elem->out_sg[i] = iov[i];
@@ -1661,6 +2151,9 @@ static void *virtqueue_packed_pop(VirtQueue *vq, size_t sz)
 
     elem->index = id;
     elem->ndescs = (desc_cache == &indirect_desc_cache) ? 1 : elem_entries;
+    if (virtio_queue_in_order(vq)) {
+        virtqueue_in_order_record(vq, vq->last_avail_idx, id, elem->ndescs);
+    }
     vq->last_avail_idx += elem->ndescs;
     vq->inuse += elem->ndescs;
 
@@ -1696,6 +2189,44 @@ void *virtqueue_pop(VirtQueue *vq, size_t sz)
     }
 }
 
+/*
+ * virtqueue_pop_batch:
+ * @vq: The #VirtQueue
+ * @sz: Size of each element, like for virtqueue_pop()
+ * @elems: Array that receives the popped elements
+ * @max: Maximum number of elements to pop
+ *
+ * Pop up to @max elements.  For split virtqueues, the avail index is read
+ * and the memory barrier executed only once for all of them, and the avail
+ * event is updated once at the end.
+ *
+ * Returns: the number of elements stored in @elems.
+ */
+unsigned int virtqueue_pop_batch(VirtQueue *vq, size_t sz, void **elems,
+                                 unsigned int max)
+{
+    unsigned int n = 0;
+
+    if (virtio_device_disabled(vq->vdev)) {
+        return 0;
+    }
+
+    if (!virtio_vdev_has_feature(vq->vdev, VIRTIO_F_RING_PACKED)) {
+        return virtqueue_split_pop_batch(vq, sz, elems, max);
+    }
+
+    /* Packed rings have no avail index, each descriptor is checked anyway */
+    while (n < max) {
+        void *elem = virtqueue_packed_pop(vq, sz);
+
+        if (!elem) {
+            break;
+        }
+        elems[n++] = elem;
+    }
+    return n;
+}
+
 static unsigned int virtqueue_packed_drop_all(VirtQueue *vq)
 {
     VRingMemoryRegionCaches *caches;
@@ -1829,7 +2360,7 @@ void *qemu_get_virtqueue_element(VirtIODevice *vdev, QEMUFile *f, size_t sz)
     assert(ARRAY_SIZE(data.in_addr) >= data.in_num);
     assert(ARRAY_SIZE(data.out_addr) >= data.out_num);
 
-    elem = virtqueue_alloc_element(sz, data.out_num, data.in_num);
+    elem = virtqueue_alloc_element(NULL, sz, data.out_num, data.in_num);
     elem->index = data.index;
 
     for (i = 0; i < elem->in_num; i++) {
@@ -2361,6 +2892,17 @@ void virtio_queue_notify(VirtIODevice *vdev, int n)
 
     trace_virtio_queue_notify(vdev, vq - vdev->vq, vq);
     if (vq->host_notifier_enabled) {
+        if (vq->host_notifier_poll_flags) {
+            /*
+             * Order the guest's ring update before reading the flags, pairs
+             * with the consumer clearing them before re-checking the ring.
+             */
+            smp_mb();
+            if (le32_to_cpu(qatomic_read(vq->host_notifier_poll_flags)) &
+                VIRTIO_QUEUE_HOST_NOTIFIER_POLLING) {
+                return;
+            }
+        }
         event_notifier_set(&vq->host_notifier);
     } else if (vq->handle_output) {
         vq->handle_output(vdev, vq);
@@ -2426,6 +2968,9 @@ void virtio_delete_queue(VirtQueue *vq)
     vq->handle_aio_output = NULL;
     g_free(vq->used_elems);
     vq->used_elems = NULL;
+    g_free(vq->in_order_elems);
+    vq->in_order_elems = NULL;
+    virtio_queue_release_element_pool(vq);
     virtio_virtqueue_reset_region_cache(vq);
 }
 
@@ -2525,6 +3070,20 @@ static bool virtio_should_notify(VirtIODevice *vdev, VirtQueue *vq)
     }
 }
 
+/**
+ * virtio_queue_should_notify:
+ * @vdev: The #VirtIODevice
+ * @vq: The #VirtQueue, after virtqueue_flush()
+ *
+ * Returns whether the guest wants to be notified of the buffers that were
+ * just flushed, for callers that raise the guest notifier themselves.
+ */
+bool virtio_queue_should_notify(VirtIODevice *vdev, VirtQueue *vq)
+{
+    RCU_READ_LOCK_GUARD();
+    return virtio_should_notify(vdev, vq);
+}
+
 void virtio_notify_irqfd(VirtIODevice *vdev, VirtQueue *vq)
 {
     WITH_RCU_READ_LOCK_GUARD() {
@@ -3155,6 +3714,9 @@ int virtio_load(VirtIODevice *vdev, QEMUFile *f, int version_id)
                 vdev->vq[i].shadow_avail_idx = vdev->vq[i].last_avail_idx;
                 vdev->vq[i].shadow_avail_wrap_counter =
                                         vdev->vq[i].last_avail_wrap_counter;
+                if (virtio_queue_in_order(&vdev->vq[i])) {
+                    virtqueue_in_order_restore(&vdev->vq[i]);
+                }
                 continue;
             }
 
@@ -3190,6 +3752,9 @@ int virtio_load(VirtIODevice *vdev, QEMUFile *f, int version_id)
                              vdev->vq[i].used_idx);
                 return -1;
             }
+            if (virtio_queue_in_order(&vdev->vq[i])) {
+                virtqueue_in_order_restore(&vdev->vq[i]);
+            }
         }
     }
 
@@ -3599,6 +4164,12 @@ void virtio_queue_set_host_notifier_enabled(VirtQueue *vq, bool enabled)
     vq->host_notifier_enabled = enabled;
 }
 
+void virtio_queue_set_host_notifier_poll_flags(VirtQueue *vq,
+                                               uint32_t *flags)
+{
+    vq->host_notifier_poll_flags = flags;
+}
+
 int virtio_queue_set_host_notifier_mr(VirtIODevice *vdev, int n,
                                       MemoryRegion *mr, bool assign)
 {
@@ -3702,6 +4273,8 @@ static void virtio_device_free_virtqueues(VirtIODevice *vdev)
         if (vdev->vq[i].vring.num == 0) {
             break;
         }
+        virtio_queue_release_element_pool(&vdev->vq[i]);
+        g_free(vdev->vq[i].in_order_elems);
         virtio_virtqueue_reset_region_cache(&vdev->vq[i]);
     }
     g_free(vdev->vq);
@@ -28,6 +28,7 @@
 #include "qemu/timed-average.h"
 #include "qemu/thread.h"
 #include "qapi/qapi-builtin-types.h"
+#include "qemu/stats64.h"
 
 typedef struct BlockAcctTimedStats BlockAcctTimedStats;
 typedef struct BlockAcctStats BlockAcctStats;
@@ -41,6 +42,14 @@ enum BlockAcctType {
     BLOCK_MAX_IOTYPE,
 };
 
+/* The part of a request's life whose latency is measured */
+enum BlockAcctPhase {
+    BLOCK_ACCT_PHASE_TOTAL,     /* from block_acct_start() to completion */
+    BLOCK_ACCT_PHASE_THROTTLE,  /* waiting for I/O throttling */
+    BLOCK_ACCT_PHASE_DRIVER,    /* in the block drivers below the backend */
+    BLOCK_ACCT_PHASE_MAX,
+};
+
 struct BlockAcctTimedStats {
     BlockAcctStats *stats;
     TimedAverage latency[BLOCK_MAX_IOTYPE];
@@ -78,8 +87,38 @@ typedef struct BlockLatencyHistogram {
     uint64_t *bins;
 } BlockLatencyHistogram;
 
-struct BlockAcctStats {
-    QemuMutex lock;
+/*
+ * Log-linear latency histograms, used for latency percentiles.  Latencies
+ * below 2^BLOCK_ACCT_LAT_SUB_BITS ns have one bin each; each power of two
+ * above that is split into 2^BLOCK_ACCT_LAT_SUB_BITS bins, so no bin is
+ * wider than 1/8 of its lower bound.  Latencies of 2^(BLOCK_ACCT_LAT_MAX_SHIFT
+ * + 1) ns (about two minutes) and more are counted in the last bin.
+ */
+#define BLOCK_ACCT_LAT_SUB_BITS 3
+#define BLOCK_ACCT_LAT_MAX_SHIFT 36
+#define BLOCK_ACCT_LAT_BINS \
+    ((BLOCK_ACCT_LAT_MAX_SHIFT - BLOCK_ACCT_LAT_SUB_BITS + 2) << \
+     BLOCK_ACCT_LAT_SUB_BITS)
+
+/*
+ * Number of counter shards per BlockAcctStats.  Each thread updates one
+ * shard, so threads that complete requests of the same device do not
+ * bounce the counters' cache lines between them.
+ */
+#define BLOCK_ACCT_SHARDS 16
+
+typedef struct BlockAcctShard {
+    Stat64 nr_bytes[BLOCK_MAX_IOTYPE];
+    Stat64 nr_ops[BLOCK_MAX_IOTYPE];
+    Stat64 invalid_ops[BLOCK_MAX_IOTYPE];
+    Stat64 failed_ops[BLOCK_MAX_IOTYPE];
+    Stat64 total_time_ns[BLOCK_MAX_IOTYPE];
+    Stat64 merged[BLOCK_MAX_IOTYPE];
+    Stat64 last_access_time_ns;
+} BlockAcctShard;
+
+/* The sum of all shards, see block_acct_get_counters() */
+typedef struct BlockAcctCounters {
     uint64_t nr_bytes[BLOCK_MAX_IOTYPE];
     uint64_t nr_ops[BLOCK_MAX_IOTYPE];
     uint64_t invalid_ops[BLOCK_MAX_IOTYPE];
@@ -87,10 +126,18 @@ struct BlockAcctStats {
     uint64_t total_time_ns[BLOCK_MAX_IOTYPE];
     uint64_t merged[BLOCK_MAX_IOTYPE];
     int64_t last_access_time_ns;
+} BlockAcctCounters;
+
+struct BlockAcctStats {
+    /* Protects intervals and latency_histogram; the counters are lock-free */
+    QemuMutex lock;
+    BlockAcctShard shards[BLOCK_ACCT_SHARDS];
     QSLIST_HEAD(, BlockAcctTimedStats) intervals;
     bool account_invalid;
     bool account_failed;
     BlockLatencyHistogram latency_histogram[BLOCK_MAX_IOTYPE];
+    Stat64 latency_bins[BLOCK_ACCT_PHASE_MAX][BLOCK_MAX_IOTYPE]
+                       [BLOCK_ACCT_LAT_BINS];
 };
 
 typedef struct BlockAcctCookie {
@@ -113,11 +160,21 @@ void block_acct_failed(BlockAcctStats *stats, BlockAcctCookie *cookie);
 void block_acct_invalid(BlockAcctStats *stats, enum BlockAcctType type);
 void block_acct_merge_done(BlockAcctStats *stats, enum BlockAcctType type,
                            int num_requests);
+void block_acct_get_counters(BlockAcctStats *stats,
+                             BlockAcctCounters *counters);
 int64_t block_acct_idle_time_ns(BlockAcctStats *stats);
 double block_acct_queue_depth(BlockAcctTimedStats *stats,
                               enum BlockAcctType type);
 int block_latency_histogram_set(BlockAcctStats *stats, enum BlockAcctType type,
                                 uint64List *boundaries);
 void block_latency_histograms_clear(BlockAcctStats *stats);
+int64_t block_acct_clock_ns(void);
+void block_acct_latency(BlockAcctStats *stats, enum BlockAcctPhase phase,
+                        enum BlockAcctType type, int64_t latency_ns);
+uint64_t block_acct_latency_percentiles(BlockAcctStats *stats,
+                                        enum BlockAcctPhase phase,
+                                        enum BlockAcctType type,
+                                        const double *percentiles,
+                                        uint64_t *latencies_ns, int n);
 
 #endif
@@ -196,6 +196,8 @@ struct AioContext {
      * Has its own locking.
      */
     struct ThreadPool *thread_pool;
+    /* Maximum number of threads in thread_pool */
+    int thread_pool_max;
 
 #ifdef CONFIG_LINUX_AIO
     /*
@@ -211,9 +213,16 @@ struct AioContext {
      */
     struct LuringState *linux_io_uring;
 
+    /*
+     * Polled (IORING_SETUP_IOPOLL) io_uring for O_DIRECT reads and writes,
+     * created on demand next to linux_io_uring.  Same locking.
+     */
+    struct LuringState *linux_io_uring_iopoll;
+
     /* State for file descriptor monitoring using Linux io_uring */
     struct io_uring fdmon_io_uring;
     AioHandlerSList submit_list;
+    bool fdmon_io_uring_multishot; /* IORING_POLL_ADD_MULTI supported? */
 #endif
 
     /* TimerLists for calling timers - one per clock type.  Has its own
@@ -487,11 +496,27 @@ struct LinuxAioState *aio_setup_linux_aio(AioContext *ctx, Error **errp);
 /* Return the LinuxAioState bound to this AioContext */
 struct LinuxAioState *aio_get_linux_aio(AioContext *ctx);
 
-/* Setup the LuringState bound to this AioContext */
-struct LuringState *aio_setup_linux_io_uring(AioContext *ctx, Error **errp);
+/*
+ * Setup the LuringState bound to this AioContext.  @sqpoll only matters
+ * for the first call, when the ring is created.
+ */
+struct LuringState *aio_setup_linux_io_uring(AioContext *ctx, bool sqpoll,
+                                             Error **errp);
 
 /* Return the LuringState bound to this AioContext */
 struct LuringState *aio_get_linux_io_uring(AioContext *ctx);
+
+/*
+ * Setup the polled completion LuringState bound to this AioContext.  Its
+ * completions are reaped by busy polling from the event loop rather than
+ * by an fd notification.  @sqpoll only matters for the first call.
+ */
+struct LuringState *aio_setup_linux_io_uring_iopoll(AioContext *ctx,
+                                                    bool sqpoll,
+                                                    Error **errp);
+
+/* Return the polled completion LuringState bound to this AioContext */
+struct LuringState *aio_get_linux_io_uring_iopoll(AioContext *ctx);
 /**
  * aio_timer_new_with_attrs:
  * @ctx: the aio context
@@ -727,4 +752,15 @@ void aio_context_set_poll_params(AioContext *ctx, int64_t max_ns,
                                  int64_t grow, int64_t shrink,
                                  Error **errp);
 
+/**
+ * aio_context_set_thread_pool_params:
+ * @ctx: the aio context
+ * @max: maximum number of threads in the thread pool of @ctx
+ *
+ * The thread pool keeps working through its current requests when @max is
+ * lowered; surplus threads exit as they finish.
+ */
+void aio_context_set_thread_pool_params(AioContext *ctx, int64_t max,
+                                        Error **errp);
+
 #endif
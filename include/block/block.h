@@ -45,6 +45,51 @@ typedef struct BlockFragInfo {
     uint64_t compressed_clusters;
 } BlockFragInfo;
 
+/*
+ * Zoned block devices.  Writes to the sequential zones must start at
+ * the write pointer of the zone; the zone management operations move it.
+ */
+typedef enum BlockZoneModel {
+    BLK_Z_NONE = 0x0,   /* regular block device */
+    BLK_Z_HM = 0x1,     /* host-managed, sequential writes are required */
+    BLK_Z_HA = 0x2,     /* host-aware, sequential writes are preferred */
+} BlockZoneModel;
+
+typedef enum BlockZoneOp {
+    BLK_ZO_OPEN,
+    BLK_ZO_CLOSE,
+    BLK_ZO_FINISH,
+    BLK_ZO_RESET,
+} BlockZoneOp;
+
+/* The values match those of the Linux zoned block device interface */
+typedef enum BlockZoneType {
+    BLK_ZT_CONV = 0x1,  /* conventional, random writes are allowed */
+    BLK_ZT_SWR = 0x2,   /* sequential writes required */
+    BLK_ZT_SWP = 0x3,   /* sequential writes preferred */
+} BlockZoneType;
+
+typedef enum BlockZoneState {
+    BLK_ZS_NOT_WP = 0x0,
+    BLK_ZS_EMPTY = 0x1,
+    BLK_ZS_IOPEN = 0x2,
+    BLK_ZS_EOPEN = 0x3,
+    BLK_ZS_CLOSED = 0x4,
+    BLK_ZS_RDONLY = 0xD,
+    BLK_ZS_FULL = 0xE,
+    BLK_ZS_OFFLINE = 0xF,
+} BlockZoneState;
+
+/* All offsets and lengths are in bytes */
+typedef struct BlockZoneDescriptor {
+    uint64_t start;
+    uint64_t length;
+    uint64_t cap;       /* writable part of the zone */
+    uint64_t wp;
+    BlockZoneType type;
+    BlockZoneState state;
+} BlockZoneDescriptor;
+
 typedef enum {
     BDRV_REQ_COPY_ON_READ       = 0x1,
     BDRV_REQ_ZERO_WRITE         = 0x2,
@@ -135,6 +180,7 @@ typedef struct HDGeometry {
 #define BDRV_OPT_AUTO_READ_ONLY "auto-read-only"
 #define BDRV_OPT_DISCARD        "discard"
 #define BDRV_OPT_FORCE_SHARE    "force-share"
+#define BDRV_OPT_ALLOC_INDEX    "allocation-index"
 
 
 #define BDRV_SECTOR_BITS   9
@@ -481,6 +527,28 @@ void bdrv_aio_cancel_async(BlockAIOCB *acb);
 /* sg packet commands */
 int bdrv_co_ioctl(BlockDriverState *bs, int req, void *buf);
 
+/*
+ * Zoned block devices, see bs->bl.zoned.
+ *
+ * bdrv_co_zone_report() describes at most *@nr_zones zones starting with
+ * the one that contains @offset, and sets *@nr_zones to the number of
+ * zones it described.
+ *
+ * bdrv_co_zone_mgmt() applies @op to the zones in @offset..@offset+@len,
+ * which must be zone aligned.
+ *
+ * bdrv_co_zone_append() writes @qiov at the write pointer of the zone
+ * that starts at *@offset, and sets *@offset to where the data went.
+ */
+int coroutine_fn bdrv_co_zone_report(BlockDriverState *bs, int64_t offset,
+                                     unsigned int *nr_zones,
+                                     BlockZoneDescriptor *zones);
+int coroutine_fn bdrv_co_zone_mgmt(BlockDriverState *bs, BlockZoneOp op,
+                                   int64_t offset, int64_t len);
+int coroutine_fn bdrv_co_zone_append(BlockDriverState *bs, int64_t *offset,
+                                     QEMUIOVector *qiov,
+                                     BdrvRequestFlags flags);
+
 /* Invalidate any cached metadata used by image formats */
 int generated_co_wrapper bdrv_invalidate_cache(BlockDriverState *bs,
                                                Error **errp);
@@ -654,6 +722,20 @@ bool bdrv_debug_is_suspended(BlockDriverState *bs, const char *tag);
  */
 AioContext *bdrv_get_aio_context(BlockDriverState *bs);
 
+/**
+ * bdrv_get_request_aio_context:
+ *
+ * Returns: the #AioContext in which a request to @bs submitted from the
+ * current thread runs and completes.  This is the AioContext of the calling
+ * thread if it was added with bdrv_add_multiqueue_context(), and the
+ * currently bound #AioContext otherwise.
+ */
+AioContext *bdrv_get_request_aio_context(BlockDriverState *bs);
+
+bool bdrv_supports_multiqueue(BlockDriverState *bs);
+void bdrv_add_multiqueue_context(BlockDriverState *bs, AioContext *ctx);
+void bdrv_del_multiqueue_context(BlockDriverState *bs, AioContext *ctx);
+
 /**
  * Move the current coroutine to the AioContext of @bs and return the old
  * AioContext of the coroutine. Increase bs->in_flight so that draining @bs
@@ -705,9 +787,6 @@ AioContext *bdrv_child_get_parent_aio_context(BdrvChild *c);
 int bdrv_probe_blocksizes(BlockDriverState *bs, BlockSizes *bsz);
 int bdrv_probe_geometry(BlockDriverState *bs, HDGeometry *geo);
 
-void bdrv_io_plug(BlockDriverState *bs);
-void bdrv_io_unplug(BlockDriverState *bs);
-
 /**
  * bdrv_parent_drained_begin_single:
  *
@@ -154,6 +154,14 @@ struct BlockDriver {
      */
     bool supports_backing;
 
+    /*
+     * Set to true if the driver can serve requests that are submitted
+     * concurrently from several AioContexts, each request running and
+     * completing in the thread that submitted it.  Per-thread state is set
+     * up by bdrv_attach_multiqueue_context().  See blk_enable_multiqueue().
+     */
+    bool supports_multiqueue;
+
     /* For handling image reopen for split or non-split files */
     int (*bdrv_reopen_prepare)(BDRVReopenState *reopen_state,
                                BlockReopenQueue *queue, Error **errp);
@@ -437,6 +445,14 @@ struct BlockDriver {
                                 const char *snapshot_id,
                                 const char *name,
                                 Error **errp);
+    /*
+     * Move VM state that was saved after the snapshot @name had been
+     * created into that snapshot.  Used by live internal snapshots.
+     */
+    int (*bdrv_snapshot_attach_vmstate)(BlockDriverState *bs,
+                                        const char *name,
+                                        uint64_t vm_state_size,
+                                        Error **errp);
     int (*bdrv_snapshot_list)(BlockDriverState *bs,
                               QEMUSnapshotInfo **psn_info);
     int (*bdrv_snapshot_load_tmp)(BlockDriverState *bs,
@@ -470,6 +486,19 @@ struct BlockDriver {
     int coroutine_fn (*bdrv_co_ioctl)(BlockDriverState *bs,
                                       unsigned long int req, void *buf);
 
+    /* zoned block devices, only called if bs->bl.zoned != BLK_Z_NONE */
+    int coroutine_fn (*bdrv_co_zone_report)(BlockDriverState *bs,
+                                            int64_t offset,
+                                            unsigned int *nr_zones,
+                                            BlockZoneDescriptor *zones);
+    int coroutine_fn (*bdrv_co_zone_mgmt)(BlockDriverState *bs,
+                                          BlockZoneOp op,
+                                          int64_t offset, int64_t len);
+    int coroutine_fn (*bdrv_co_zone_append)(BlockDriverState *bs,
+                                            int64_t *offset,
+                                            QEMUIOVector *qiov,
+                                            BdrvRequestFlags flags);
+
     /* List of options for creating images, terminated by name == NULL */
     QemuOptsList *create_opts;
 
@@ -524,9 +553,14 @@ struct BlockDriver {
     void (*bdrv_attach_aio_context)(BlockDriverState *bs,
                                     AioContext *new_context);
 
-    /* io queue for linux-aio */
-    void (*bdrv_io_plug)(BlockDriverState *bs);
-    void (*bdrv_io_unplug)(BlockDriverState *bs);
+    /* Set up and tear down the state needed to serve requests submitted
+     * from @ctx in addition to the node's own AioContext.  Only used by
+     * drivers with supports_multiqueue.  Called in a drained section.
+     */
+    void (*bdrv_attach_multiqueue_context)(BlockDriverState *bs,
+                                           AioContext *ctx);
+    void (*bdrv_detach_multiqueue_context)(BlockDriverState *bs,
+                                           AioContext *ctx);
 
     /**
      * Try to get @bs's logical and physical block size.
@@ -703,9 +737,29 @@ typedef struct BlockLimits {
 
     /* maximum number of iovec elements */
     int max_iov;
+
+    /*
+     * Zone model of the device.  These limits are not inherited from
+     * the children, drivers that pass zones through must copy them.
+     */
+    BlockZoneModel zoned;
+
+    /* Size of a zone in bytes, a power of 2 */
+    uint64_t zone_size;
+
+    /* Number of zones, the last one may be smaller than zone_size */
+    uint32_t nr_zones;
+
+    /* Maximum number of open and active zones, 0 for no limit */
+    uint32_t max_open_zones;
+    uint32_t max_active_zones;
+
+    /* Maximum length of a zone append request in bytes */
+    uint32_t max_append_bytes;
 } BlockLimits;
 
 typedef struct BdrvOpBlocker BdrvOpBlocker;
+typedef struct BdrvAllocIndex BdrvAllocIndex;
 
 typedef struct BdrvAioNotifier {
     void (*attached_aio_context)(AioContext *new_context, void *opaque);
@@ -860,6 +914,11 @@ struct BlockDriverState {
     QLIST_HEAD(, BdrvAioNotifier) aio_notifiers;
     bool walking_aio_notifiers; /* to make removal during iteration safe */
 
+    /* other AioContexts that may submit requests to this BDS, one entry per
+     * bdrv_add_multiqueue_context() call.  Only changed in drained sections
+     * with the BQL held. */
+    GSList *multiqueue_contexts;
+
     char filename[PATH_MAX];
     /*
      * If not empty, this image is a diff in relation to backing_file.
@@ -983,11 +1042,6 @@ struct BlockDriverState {
     unsigned int in_flight;
     unsigned int serialising_in_flight;
 
-    /* counter for nested bdrv_io_plug.
-     * Accessed with atomic ops.
-    */
-    unsigned io_plugged;
-
     /* do we need to tell the quest if we have a volatile write cache? */
     int enable_write_cache;
 
@@ -1008,6 +1062,12 @@ struct BlockDriverState {
 
     /* BdrvChild links to this node may never be frozen */
     bool never_freeze;
+
+    /*
+     * Layers of the backing chain known to be unallocated, see
+     * block/alloc-index.c.  NULL unless allocation-index=on.
+     */
+    BdrvAllocIndex *alloc_index;
 };
 
 struct BlockBackendRootState {
@@ -1031,6 +1091,24 @@ typedef enum BlockMirrorBackingMode {
 } BlockMirrorBackingMode;
 
 
+BdrvAllocIndex *bdrv_alloc_index_new(void);
+void bdrv_alloc_index_free(BdrvAllocIndex *idx);
+
+/*
+ * Return how many layers below the node are unallocated at @offset, and
+ * clamp @bytes to the range for which that is known.  @gen must be passed
+ * to bdrv_alloc_index_insert() when recording the result of the query.
+ */
+int bdrv_alloc_index_lookup(BdrvAllocIndex *idx, int64_t offset,
+                            int64_t *bytes, uint64_t *gen);
+void bdrv_alloc_index_insert(BdrvAllocIndex *idx, uint64_t gen,
+                             int64_t offset, int64_t bytes, int skip);
+
+/* Clear the allocation index of @bs and of the nodes above in the chain */
+void bdrv_alloc_index_invalidate(BlockDriverState *bs);
+/* Clear the allocation index of the nodes above @bs in the chain */
+void bdrv_alloc_index_invalidate_above(BlockDriverState *bs);
+
 /* Essential block drivers which must always be statically linked into qemu, and
  * which therefore can be accessed without using bdrv_find_format() */
 extern BlockDriver bdrv_file;
@@ -1244,6 +1322,7 @@ BlockJob *commit_active_start(const char *job_id, BlockDriverState *bs,
  * driver that the mirror job inserts into the graph above @bs. NULL means that
  * a node name should be autogenerated.
  * @copy_mode: When to trigger writes to the target.
+ * @perf: Performance options, or %NULL for the defaults.
  * @errp: Error object.
  *
  * Start a mirroring operation on @bs.  Clusters that are allocated
@@ -1260,7 +1339,8 @@ void mirror_start(const char *job_id, BlockDriverState *bs,
                   BlockdevOnError on_source_error,
                   BlockdevOnError on_target_error,
                   bool unmap, const char *filter_node_name,
-                  MirrorCopyMode copy_mode, Error **errp);
+                  MirrorCopyMode copy_mode, const MirrorPerf *perf,
+                  Error **errp);
 
 /*
  * backup_job_create:
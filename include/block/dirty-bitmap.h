@@ -80,6 +80,8 @@ void bdrv_dirty_bitmap_set_busy(BdrvDirtyBitmap *bitmap, bool busy);
 void bdrv_merge_dirty_bitmap(BdrvDirtyBitmap *dest, const BdrvDirtyBitmap *src,
                              HBitmap **backup, Error **errp);
 void bdrv_dirty_bitmap_skip_store(BdrvDirtyBitmap *bitmap, bool skip);
+void bdrv_dirty_bitmap_set_stored(BdrvDirtyBitmap *bitmap, bool stored);
+bool bdrv_dirty_bitmap_stored_is_current(BdrvDirtyBitmap *bitmap);
 bool bdrv_dirty_bitmap_get(BdrvDirtyBitmap *bitmap, int64_t offset);
 
 /* Functions that require manual locking.  */
@@ -62,6 +62,11 @@ int bdrv_snapshot_delete(BlockDriverState *bs,
                          const char *snapshot_id,
                          const char *name,
                          Error **errp);
+bool bdrv_can_attach_vmstate(BlockDriverState *bs);
+int bdrv_snapshot_attach_vmstate(BlockDriverState *bs,
+                                 const char *name,
+                                 uint64_t vm_state_size,
+                                 Error **errp);
 int bdrv_snapshot_list(BlockDriverState *bs,
                        QEMUSnapshotInfo **psn_info);
 int bdrv_snapshot_load_tmp(BlockDriverState *bs,
@@ -20,18 +20,53 @@
 
 #include "block/block.h"
 
+#define THREAD_POOL_MAX_THREADS_DEFAULT 64
+
 typedef int ThreadPoolFunc(void *opaque);
 
 typedef struct ThreadPool ThreadPool;
 
+/*
+ * Queued requests are started in priority order.  Use
+ * THREAD_POOL_PRIO_BULK for CPU-heavy work such as compression or
+ * encryption, so that it does not delay short system calls made on
+ * behalf of guest I/O.
+ */
+typedef enum ThreadPoolPriority {
+    THREAD_POOL_PRIO_NORMAL,
+    THREAD_POOL_PRIO_BULK,
+    THREAD_POOL_PRIO__MAX,
+} ThreadPoolPriority;
+
 ThreadPool *thread_pool_new(struct AioContext *ctx);
 void thread_pool_free(ThreadPool *pool);
 
+/*
+ * Take the maximum number of worker threads from @ctx again.  Extra workers
+ * exit once they finish their current request.
+ */
+void thread_pool_update_params(ThreadPool *pool, struct AioContext *ctx);
+
+BlockAIOCB *thread_pool_submit_aio_prio(ThreadPool *pool,
+        ThreadPoolPriority prio, ThreadPoolFunc *func, void *arg,
+        BlockCompletionFunc *cb, void *opaque);
 BlockAIOCB *thread_pool_submit_aio(ThreadPool *pool,
         ThreadPoolFunc *func, void *arg,
         BlockCompletionFunc *cb, void *opaque);
+int coroutine_fn thread_pool_submit_co_prio(ThreadPool *pool,
+        ThreadPoolPriority prio, ThreadPoolFunc *func, void *arg);
 int coroutine_fn thread_pool_submit_co(ThreadPool *pool,
         ThreadPoolFunc *func, void *arg);
 void thread_pool_submit(ThreadPool *pool, ThreadPoolFunc *func, void *arg);
 
+typedef struct ThreadPoolStats {
+    uint64_t submitted;     /* requests submitted to any pool */
+    uint64_t completed;     /* requests whose completion has run */
+    int queued;             /* requests waiting for a worker */
+    int threads;            /* running worker threads */
+} ThreadPoolStats;
+
+/* Get the statistics of all thread pools together */
+void thread_pool_get_stats(ThreadPoolStats *stats);
+
 #endif
@@ -57,6 +57,15 @@ typedef struct ThrottleGroupMember {
     unsigned       pending_reqs[2];
     QLIST_ENTRY(ThrottleGroupMember) round_robin;
 
+    /* I/O that the member has accounted to the group in advance and may
+     * perform without taking the ThrottleGroup lock, per type of operation.
+     * INFINITY if there is no limit. Protected by budget_lock, a leaf lock
+     * that may be taken with the ThrottleGroup lock held. */
+    QemuSpin       budget_lock;
+    double         budget_bytes[2];
+    double         budget_units[2];
+    uint64_t       budget_op_size;
+
 } ThrottleGroupMember;
 
 #define TYPE_THROTTLE_GROUP "throttle-group"
@@ -321,4 +321,31 @@ int qcrypto_tls_session_get_key_size(QCryptoTLSSession *sess,
  */
 char *qcrypto_tls_session_get_peer_name(QCryptoTLSSession *sess);
 
+#define QCRYPTO_TLS_KTLS_TX (1 << 0)
+#define QCRYPTO_TLS_KTLS_RX (1 << 1)
+
+/**
+ * qcrypto_tls_session_enable_ktls:
+ * @sess: the TLS session object
+ * @fd: the TCP socket that carries the session
+ *
+ * Try to hand the record encryption of an established
+ * session over to the kernel TLS layer of @fd, which may
+ * in turn offload it to the NIC. This is only possible on
+ * Linux, for TLS 1.2 and 1.3 with AES-GCM.
+ *
+ * qcrypto_tls_session_read() and qcrypto_tls_session_write()
+ * keep working afterwards, but use @fd directly for the
+ * offloaded directions, instead of the callbacks registered
+ * with qcrypto_tls_session_set_callbacks(). Plain data
+ * written to @fd is encrypted by the kernel.
+ *
+ * This must be called right after qcrypto_tls_session_handshake()
+ * completes, before any application data is sent or received.
+ *
+ * Returns: a mask of QCRYPTO_TLS_KTLS_TX and QCRYPTO_TLS_KTLS_RX
+ * for the offloaded directions, 0 if neither is
+ */
+int qcrypto_tls_session_enable_ktls(QCryptoTLSSession *sess, int fd);
+
 #endif /* QCRYPTO_TLSSESSION_H */
@@ -76,8 +76,15 @@ typedef uint64_t target_ulong;
 
 #if !defined(CONFIG_USER_ONLY) && defined(CONFIG_TCG)
 
-/* use a fully associative victim tlb of 8 entries */
-#define CPU_VTLB_SIZE 8
+/*
+ * The victim tlb is set associative, indexed by the low bits of the
+ * virtual page number.  Pages evicted from the fast tlb are kept there
+ * so that working sets larger than the fast tlb do not go back to
+ * tlb_fill on every conflict.
+ */
+#define CPU_VTLB_WAYS 4
+#define CPU_VTLB_SETS 16
+#define CPU_VTLB_SIZE (CPU_VTLB_SETS * CPU_VTLB_WAYS)
 
 #if HOST_LONG_BITS == 32 && TARGET_LONG_BITS == 32
 #define CPU_TLB_ENTRY_BITS 4
@@ -168,13 +175,20 @@ typedef struct CPUTLBDesc {
     /* maximum number of entries observed in the window */
     size_t window_max_entries;
     size_t n_used_entries;
-    /* The next index to use in the tlb victim table.  */
-    size_t vindex;
+    /* The next way to use in each set of the tlb victim table.  */
+    uint8_t vindex[CPU_VTLB_SETS];
     /* The tlb victim table, in two parts.  */
     CPUTLBEntry vtable[CPU_VTLB_SIZE];
     CPUIOTLBEntry viotlb[CPU_VTLB_SIZE];
     /* The iotlb.  */
     CPUIOTLBEntry *iotlb;
+    /*
+     * Statistics, updated by the owning cpu and read atomically by the
+     * monitor.  Hits in the fast path are not counted, since that would
+     * slow down the inline tlb lookup.
+     */
+    size_t victim_hit_count;
+    size_t fill_count;
 } CPUTLBDesc;
 
 /*
@@ -27,6 +27,7 @@
 #include "qemu/notify.h"
 #include "qom/object.h"
 #include "qemu/rcu.h"
+#include "qemu/thread.h"
 
 #define RAM_ADDR_INVALID (~(ram_addr_t)0)
 
@@ -55,7 +56,15 @@ static inline void fuzz_dma_read_cb(size_t addr,
 }
 #endif
 
-extern bool global_dirty_log;
+/* Dirty tracking enabled because migration is running */
+#define GLOBAL_DIRTY_MIGRATION  (1U << 0)
+
+/* Dirty tracking enabled because measuring dirty rate */
+#define GLOBAL_DIRTY_DIRTY_RATE (1U << 1)
+
+#define GLOBAL_DIRTY_MASK  (0x3)
+
+extern unsigned int global_dirty_tracking;
 
 typedef struct MemoryRegionOps MemoryRegionOps;
 
@@ -461,6 +470,7 @@ struct MemoryRegion {
     bool nonvolatile;
     bool rom_device;
     bool flush_coalesced_mmio;
+    bool global_locking;
     uint8_t dirty_log_mask;
     bool is_iommu;
     RAMBlock *ram_block;
@@ -616,6 +626,18 @@ struct MemoryListener {
      */
     void (*log_sync)(MemoryListener *listener, MemoryRegionSection *section);
 
+    /**
+     * @log_sync_global:
+     *
+     * This is the global version of @log_sync when the listener does
+     * not have a way to synchronize the log with finer granularity.
+     * When the listener registers with @log_sync_global defined, then
+     * its @log_sync must be NULL.  Vice versa.
+     *
+     * @listener: The #MemoryListener.
+     */
+    void (*log_sync_global)(MemoryListener *listener);
+
     /**
      * @log_clear:
      *
@@ -748,6 +770,16 @@ struct AddressSpace {
 
     /* Accessed via RCU.  */
     struct FlatView *current_map;
+    struct AddressSpaceXlatCache *xlat_cache;
+    bool xlat_cache_enabled;
+
+    /* Bounce buffers handed out by address_space_map(), in bytes */
+    size_t bounce_buffer_size;
+    size_t max_bounce_buffer_size;
+    /* Protects bounce_buffers and map_client_list */
+    QemuMutex map_lock;
+    QLIST_HEAD(, BounceBuffer) bounce_buffers;
+    QLIST_HEAD(, AddressSpaceMapClient) map_client_list;
 
     int ioeventfd_nb;
     struct MemoryRegionIoeventfd *ioeventfds;
@@ -755,7 +787,10 @@ struct AddressSpace {
     QTAILQ_ENTRY(AddressSpace) address_spaces_link;
 };
 
+#define DEFAULT_MAX_BOUNCE_BUFFER_SIZE (4096)
+
 typedef struct AddressSpaceDispatch AddressSpaceDispatch;
+typedef struct AddressSpaceXlatCache AddressSpaceXlatCache;
 typedef struct FlatRange FlatRange;
 
 /* Flattened global view of current active memory hierarchy.  Kept in sorted
@@ -769,6 +804,8 @@ struct FlatView {
     unsigned nr_allocated;
     struct AddressSpaceDispatch *dispatch;
     MemoryRegion *root;
+    /* Regions visited while rendering, used to skip unchanged views */
+    GHashTable *regions;
 };
 
 static inline FlatView *address_space_to_flatview(AddressSpace *as)
@@ -1833,6 +1870,33 @@ void memory_region_set_flush_coalesced(MemoryRegion *mr);
  */
 void memory_region_clear_flush_coalesced(MemoryRegion *mr);
 
+/**
+ * memory_region_set_global_locking: Declares the access processing requires
+ *                                   QEMU's global lock.
+ *
+ * When this is invoked, accesses to the memory region will be processed while
+ * holding the global lock of QEMU. This is the default behavior of memory
+ * regions.
+ *
+ * @mr: the memory region to be updated.
+ */
+void memory_region_set_global_locking(MemoryRegion *mr);
+
+/**
+ * memory_region_clear_global_locking: Declares that access processing does
+ *                                     not depend on the QEMU global lock.
+ *
+ * By clearing this property, accesses to the memory region will be processed
+ * outside of QEMU's global lock (unless the lock is held on when issuing the
+ * access request). In this case, the device model implementing the access
+ * handlers is responsible for synchronization of concurrency, and must take
+ * the global lock itself before touching state that other threads access
+ * under it, such as interrupt lines or timers.
+ *
+ * @mr: the memory region to be updated.
+ */
+void memory_region_clear_global_locking(MemoryRegion *mr);
+
 /**
  * memory_region_add_eventfd: Request an eventfd to be triggered when a word
  *                            is written to a location.
@@ -2085,13 +2149,20 @@ void memory_listener_unregister(MemoryListener *listener);
 
 /**
  * memory_global_dirty_log_start: begin dirty logging for all regions
+ *
+ * Dirty logging stays enabled until every user that started it has
+ * called memory_global_dirty_log_stop() with the same flag.
+ *
+ * @flags: purpose of starting dirty log, migration or dirty rate
  */
-void memory_global_dirty_log_start(void);
+void memory_global_dirty_log_start(unsigned int flags);
 
 /**
  * memory_global_dirty_log_stop: end dirty logging for all regions
+ *
+ * @flags: purpose of stopping dirty log, migration or dirty rate
  */
-void memory_global_dirty_log_stop(void);
+void memory_global_dirty_log_stop(unsigned int flags);
 
 void mtree_info(bool flatview, bool dispatch_tree, bool owner, bool disabled);
 
@@ -2175,6 +2246,39 @@ MemTxResult address_space_rw(AddressSpace *as, hwaddr addr,
                              MemTxAttrs attrs, void *buf,
                              hwaddr len, bool is_write);
 
+/**
+ * address_space_enable_xlat_cache: remember the last translation of
+ * address_space_rw_xlat_cached()
+ *
+ * Meant for address spaces private to a device, such as the bus master
+ * address space of a PCI device.  The contiguous RAM range hit by the last
+ * access is remembered, so that further accesses to it skip the dispatch
+ * tree walk.  The cache is dropped whenever the FlatView of @as changes;
+ * accesses that go through an IOMMU or hit MMIO are never cached.
+ *
+ * @as: #AddressSpace to be updated
+ */
+void address_space_enable_xlat_cache(AddressSpace *as);
+
+/**
+ * address_space_rw_xlat_cached: read from or write to an address space,
+ * using its translation cache if it is enabled.
+ *
+ * Return a MemTxResult indicating whether the operation succeeded
+ * or failed (eg unassigned memory, device rejected the transaction,
+ * IOMMU fault).
+ *
+ * @as: #AddressSpace to be accessed
+ * @addr: address within that address space
+ * @attrs: memory transaction attributes
+ * @buf: buffer with the data transferred
+ * @len: the number of bytes to read or write
+ * @is_write: indicates the transfer direction
+ */
+MemTxResult address_space_rw_xlat_cached(AddressSpace *as, hwaddr addr,
+                                         MemTxAttrs attrs, void *buf,
+                                         hwaddr len, bool is_write);
+
 /**
  * address_space_write: write to address space.
  *
@@ -2426,8 +2530,12 @@ bool address_space_access_valid(AddressSpace *as, hwaddr addr, hwaddr len,
  * May return %NULL and set *@plen to zero(0), if resources needed to perform
  * the mapping are exhausted.
  * Use only for reads OR writes - not for read-modify-write operations.
- * Use cpu_register_map_client() to know when retrying the map operation is
- * likely to succeed.
+ * Use address_space_register_map_client() to know when retrying the map
+ * operation is likely to succeed.
+ *
+ * If @addr is not RAM, the data goes through a bounce buffer.  Each
+ * #AddressSpace may have up to max_bounce_buffer_size bytes of bounce
+ * buffers mapped at a time.
  *
  * @as: #AddressSpace to be accessed
  * @addr: address within that address space
@@ -2438,6 +2546,27 @@ bool address_space_access_valid(AddressSpace *as, hwaddr addr, hwaddr len,
 void *address_space_map(AddressSpace *as, hwaddr addr,
                         hwaddr *plen, bool is_write, MemTxAttrs attrs);
 
+/**
+ * address_space_register_map_client: Register a callback to invoke when
+ * resources for address_space_map() become available.
+ *
+ * The bottom half is scheduled once, then unregistered; it is scheduled
+ * right away if bounce buffer space is available already.
+ *
+ * @as: #AddressSpace that address_space_map() failed on
+ * @bh: bottom half to schedule
+ */
+void address_space_register_map_client(AddressSpace *as, QEMUBH *bh);
+
+/**
+ * address_space_unregister_map_client: Unregister a callback registered
+ * with address_space_register_map_client().
+ *
+ * @as: #AddressSpace the callback was registered with
+ * @bh: bottom half that was registered
+ */
+void address_space_unregister_map_client(AddressSpace *as, QEMUBH *bh);
+
 /* address_space_unmap: Unmaps a memory region previously mapped by address_space_map()
  *
  * Will also mark the memory as dirty if @is_write == %true.  @access_len gives
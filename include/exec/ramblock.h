@@ -38,6 +38,8 @@ struct RAMBlock {
     QLIST_ENTRY(RAMBlock) next;
     QLIST_HEAD(, RAMBlockNotifier) ramblock_notifiers;
     int fd;
+    /* offset of the mapping into the file backing the block */
+    off_t fd_offset;
     size_t page_size;
     /* dirty bitmap used during migration */
     unsigned long *bmap;
@@ -59,6 +61,21 @@ struct RAMBlock {
      */
     unsigned long *clear_bmap;
     uint8_t clear_bmap_shift;
+
+    /*
+     * Second mapping of the same memory, only used on the destination
+     * of a postcopy migration to fill shared hugetlbfs pages before
+     * they are mapped into the guest with UFFDIO_CONTINUE.
+     */
+    uint8_t *host_mirror;
+
+    /*
+     * With mapped-ram: the pages present in the migration file, and
+     * where the bitmap and the pages of this block are stored in it.
+     */
+    unsigned long *file_bmap;
+    off_t bitmap_offset;
+    uint64_t pages_offset;
 };
 #endif
 #endif
@@ -34,6 +34,8 @@ struct TBContext {
 
     /* statistics */
     unsigned tb_flush_count;
+    unsigned tb_evict_count;
+    unsigned tb_gen_shared_count;
 };
 
 extern TBContext tb_ctx;
@@ -0,0 +1,65 @@
+/*
+ * Translation block statistics
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#ifndef EXEC_TB_STATS_H
+#define EXEC_TB_STATS_H
+
+#include "qapi/qapi-types-machine.h"
+
+/*
+ * Statistics for one block of guest code, identified like a TB by its
+ * physical and virtual address, cs_base and flags.  All translations
+ * of the block share the entry, so it survives invalidation, tb_flush()
+ * and the retranslation of hot TBs.  Entries are never freed, because
+ * the generated code keeps a pointer to @executions.
+ */
+typedef struct TBStatistics {
+    uint64_t phys_pc;
+    uint64_t pc;
+    uint64_t cs_base;
+    uint32_t flags;
+
+    /*
+     * Incremented without atomics by the generated code and by
+     * cpu_tb_exec(), so concurrent vCPUs may lose a few counts.
+     */
+    uint64_t executions;
+    uint64_t exits;
+
+    /* The following are protected by the tb_stats lock */
+    uint64_t translations;
+    uint64_t invalidations;
+    /* of the last translation */
+    uint32_t guest_insns;
+    uint32_t guest_bytes;
+    uint32_t tcg_ops;
+    uint32_t host_bytes;
+    uint32_t spills;
+} TBStatistics;
+
+/* New TBs get statistics while this is true, see tb_stats_control() */
+extern bool tb_stats_enabled;
+
+/* Return the statistics for a block, creating them if needed */
+TBStatistics *tb_stats_get(uint64_t phys_pc, uint64_t pc, uint64_t cs_base,
+                           uint32_t flags);
+
+void tb_stats_record_translation(TBStatistics *s, uint32_t guest_insns,
+                                 uint32_t guest_bytes, uint32_t tcg_ops,
+                                 uint32_t host_bytes, uint32_t spills);
+void tb_stats_record_invalidation(TBStatistics *s);
+
+/*
+ * Starting and stopping flush the translated code, so that every block
+ * is translated again with or without the instrumentation.
+ */
+void tb_stats_control(TBStatsAction action);
+
+/* Return the @count blocks with the highest @sort_by */
+TBStatsInfoList *tb_stats_query(int count, TBStatsSortKey sort_by);
+
+#endif /* EXEC_TB_STATS_H */
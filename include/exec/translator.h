@@ -145,6 +145,24 @@ void translator_loop(const TranslatorOps *ops, DisasContextBase *db,
 
 void translator_loop_temp_check(DisasContextBase *db);
 
+/**
+ * translator_follow_jump:
+ * @db: Disassembly context.
+ * @insn_end: Address following the jump instruction being translated.
+ * @dest: Destination of the jump.
+ *
+ * Called by #TranslatorOps::translate_insn for an unconditional direct
+ * jump.  Returns true if translation may continue at @dest within the
+ * same TB; in that case the target must not emit an exit from the TB,
+ * should leave db->is_jmp as DISAS_NEXT and must continue at @dest.
+ *
+ * Only forward jumps that stay on the page of the first instruction are
+ * followed, so that the TB still covers [pc_first, pc_next) and page
+ * based invalidation keeps working.
+ */
+bool translator_follow_jump(DisasContextBase *db, target_ulong insn_end,
+                            target_ulong dest);
+
 /*
  * Translator Load Functions
  *
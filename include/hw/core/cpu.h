@@ -243,6 +243,8 @@ typedef struct SavedIOTLB {
 
 struct KVMState;
 struct kvm_run;
+struct KVMExitStats;
+struct kvm_dirty_gfn;
 
 struct hax_vcpu_state;
 
@@ -314,6 +316,15 @@ struct qemu_work_item;
  * @opaque: User data.
  * @mem_io_pc: Host Program Counter at which the memory was accessed.
  * @kvm_fd: vCPU file descriptor for KVM.
+ * @kvm_dirty_gfns: Per-vCPU KVM dirty ring, mmap()ed from the vCPU fd when
+ *                  the dirty ring is enabled, NULL otherwise.
+ * @kvm_fetch_index: Next dirty ring entry to be collected by userspace.
+ * @dirty_pages: Number of pages collected from the KVM dirty ring.
+ * @throttle_us_per_full: Time the vCPU sleeps when its dirty ring fills up
+ *                        while a dirty page rate limit is in service.
+ * @dirtylimit_stamp: When the vCPU resumed after its dirty ring last filled
+ *                    up, in microseconds, or 0.
+ * @dirtylimit_pages: Value of @dirty_pages at @dirtylimit_stamp.
  * @work_mutex: Lock to prevent multiple access to @work_list.
  * @work_list: List of pending asynchronous work.
  * @trace_dstate_delayed: Delayed changes to trace_dstate (includes all changes
@@ -397,6 +408,13 @@ struct CPUState {
     int kvm_fd;
     struct KVMState *kvm_state;
     struct kvm_run *kvm_run;
+    struct KVMExitStats *kvm_exit_stats;
+    struct kvm_dirty_gfn *kvm_dirty_gfns;
+    uint32_t kvm_fetch_index;
+    uint64_t dirty_pages;
+    int64_t throttle_us_per_full;
+    int64_t dirtylimit_stamp;
+    uint64_t dirtylimit_pages;
 
     /* Used for events with 'vcpu' and *without* the 'disabled' properties */
     DECLARE_BITMAP(trace_dstate_delayed, CPU_TRACE_DSTATE_MAX_EVENTS);
@@ -37,6 +37,16 @@ struct TCGCPUOps {
     void (*cpu_exec_exit)(CPUState *cpu);
     /** @cpu_exec_interrupt: Callback for processing interrupts in cpu_exec */
     bool (*cpu_exec_interrupt)(CPUState *cpu, int interrupt_request);
+    /**
+     * @cpu_exec_interrupt_pending: Check if @cpu_exec_interrupt would
+     * take one of the interrupts in @interrupt_request.
+     *
+     * This must only look at state owned by the vCPU thread, because it
+     * is called without the BQL.  When it returns false, cpu_exec skips
+     * taking the BQL for a guest that runs with its interrupts masked.
+     * Optional; when NULL, the BQL is always taken.
+     */
+    bool (*cpu_exec_interrupt_pending)(CPUState *cpu, int interrupt_request);
     /**
      * @do_interrupt: Callback for interrupt handling.
      *
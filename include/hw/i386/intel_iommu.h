@@ -123,6 +123,9 @@ struct VTDIOTLBEntry {
     uint64_t slpte;
     uint64_t mask;
     uint8_t access_flags;
+    uint64_t key;                           /* Key in the IOTLB hash table */
+    QTAILQ_ENTRY(VTDIOTLBEntry) lru;        /* Most recently used first */
+    QLIST_ENTRY(VTDIOTLBEntry) domain_link; /* Entries of the same domain */
 };
 
 /* VT-d Source-ID Qualifier types */
@@ -251,6 +254,15 @@ struct IntelIOMMUState {
 
     uint32_t context_cache_gen;     /* Should be in [1,MAX] */
     GHashTable *iotlb;              /* IOTLB */
+    GHashTable *iotlb_domains;      /* IOTLB entries indexed by domain id */
+    QTAILQ_HEAD(, VTDIOTLBEntry) iotlb_lru; /* IOTLB entries in LRU order */
+    uint32_t iotlb_size;            /* Max number of IOTLB entries */
+
+    /* Queued page invalidations whose notification is still pending */
+    bool iotlb_inv_pending;
+    uint16_t iotlb_inv_domain;
+    hwaddr iotlb_inv_addr;
+    hwaddr iotlb_inv_size;
 
     GHashTable *vtd_as_by_busptr;   /* VTDBus objects indexed by PCIBus* reference */
     VTDBus *vtd_as_by_bus_num[VTD_PCI_BUS_MAX]; /* VTDBus objects indexed by bus number */
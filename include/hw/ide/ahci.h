@@ -26,6 +26,7 @@
 
 #include "hw/sysbus.h"
 #include "qom/object.h"
+#include "sysemu/iothread.h"
 
 typedef struct AHCIDevice AHCIDevice;
 
@@ -49,6 +50,16 @@ typedef struct AHCIState {
     int32_t ports;
     qemu_irq irq;
     AddressSpace *as;
+
+    /*
+     * With an IOThread, commands are fetched and processed in its
+     * AioContext, and the register accesses of the vCPUs take the
+     * AioContext lock.  The interrupt line is still updated from the
+     * main loop, because the IOThread must not take the BQL.
+     */
+    IOThread *iothread;
+    AioContext *ctx;
+    QEMUBH *irq_bh;
 } AHCIState;
 
 
@@ -28,6 +28,19 @@ struct RemoteMachineState {
 typedef struct RemoteCommDev {
     PCIDevice *dev;
     QIOChannel *ioc;
+
+    /* Shared memory channel, if the proxy set one up */
+    MPQemuShmChannel *shm;
+    EventNotifier shm_kick;
+    EventNotifier shm_done;
+    uint32_t shm_seq;
+    int64_t shm_poll_ns;
+
+    /* ioeventfds in the address spaces, to be passed on to the proxy */
+    MemoryListener ioeventfd_mem_listener;
+    MemoryListener ioeventfd_io_listener;
+    QLIST_HEAD(, RemoteIoeventfd) ioeventfds;
+    uint32_t ioeventfd_gen;
 } RemoteCommDev;
 
 #define TYPE_REMOTE_MACHINE "x-remote-machine"
@@ -41,6 +41,9 @@ typedef enum {
     MPQEMU_CMD_BAR_READ,
     MPQEMU_CMD_SET_IRQFD,
     MPQEMU_CMD_DEVICE_RESET,
+    MPQEMU_CMD_SET_SHM_CHANNEL,
+    MPQEMU_CMD_GET_IOEVENTFDS,
+    MPQEMU_CMD_IOEVENTFD,
     MPQEMU_CMD_MAX,
 } MPQemuCmd;
 
@@ -63,6 +66,22 @@ typedef struct {
     bool memory;
 } BarAccessMsg;
 
+typedef struct {
+    uint64_t poll_ns;
+} ShmChannelMsg;
+
+/*
+ * One ioeventfd of the remote device, in reply to MPQEMU_CMD_GET_IOEVENTFDS.
+ * The file descriptor comes with the message.
+ */
+typedef struct {
+    int bar;
+    uint64_t offset;
+    unsigned size;
+    bool match_data;
+    uint64_t data;
+} IoeventfdMsg;
+
 /**
  * MPQemuMsg:
  * @cmd: The remote command
@@ -83,12 +102,42 @@ typedef struct {
         PciConfDataMsg pci_conf_data;
         SyncSysmemMsg sync_sysmem;
         BarAccessMsg bar_access;
+        ShmChannelMsg shm_channel;
+        IoeventfdMsg ioeventfd;
     } data;
 
     int fds[REMOTE_MAX_FDS];
     int num_fds;
 } MPQemuMsg;
 
+/**
+ * MPQemuShmChannel:
+ *
+ * Shared memory that carries BAR accesses from the proxy to the remote
+ * process without a socket round trip, set up by MPQEMU_CMD_SET_SHM_CHANNEL.
+ * Accesses are serialized and complete in order, so there is a single
+ * request slot.  The proxy publishes a request by incrementing @req_seq,
+ * and the remote process completes it by setting @ret_seq to the same
+ * value.  Both sides poll for a while before they sleep on an eventfd;
+ * @remote_idle and @proxy_waiting tell the other side to signal it.
+ *
+ * @ioeventfd_gen changes whenever the ioeventfds of the remote process
+ * change, so that the proxy knows to fetch them again.
+ */
+typedef struct MPQemuShmChannel {
+    /* Written by the proxy */
+    uint32_t req_seq;
+    uint32_t req_cmd;
+    uint32_t proxy_waiting;
+    BarAccessMsg req;
+
+    /* Written by the remote process */
+    uint32_t ret_seq QEMU_ALIGNED(64);
+    uint32_t remote_idle;
+    uint32_t ioeventfd_gen;
+    uint64_t ret;
+} MPQemuShmChannel;
+
 bool mpqemu_msg_send(MPQemuMsg *msg, QIOChannel *ioc, Error **errp);
 bool mpqemu_msg_recv(MPQemuMsg *msg, QIOChannel *ioc, Error **errp);
 
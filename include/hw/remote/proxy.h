@@ -43,6 +43,17 @@ struct PCIProxyDev {
     EventNotifier intr;
     EventNotifier resample;
     ProxyMemoryRegion region[PCI_NUM_REGIONS];
+
+    /* Shared memory channel for BAR accesses, see MPQemuShmChannel */
+    bool shm_enabled;
+    uint32_t shm_poll_ns;
+    struct MPQemuShmChannel *shm;
+    EventNotifier shm_kick;
+    EventNotifier shm_done;
+
+    /* ioeventfds of the remote process wired to the BARs */
+    uint32_t ioeventfd_gen;
+    QLIST_HEAD(, ProxyIoeventfd) ioeventfds;
 };
 
 #endif /* PROXY_H */
@@ -24,6 +24,7 @@
 #include "exec/memory.h"
 #include "qemu/queue.h"
 #include "qemu/notify.h"
+#include "qemu/thread.h"
 #include "ui/console.h"
 #include "hw/display/ramfb.h"
 #ifdef CONFIG_LINUX
@@ -66,6 +67,12 @@ typedef struct VFIOMigration {
     int vm_running;
     Notifier migration_state;
     uint64_t pending_bytes;
+    bool initial_data_sent;
+    /* Stop-and-copy data read ahead by save_thread, see vfio_save_thread() */
+    QemuThread save_thread;
+    bool save_thread_started;
+    int save_thread_ret;
+    QSIMPLEQ_HEAD(, VFIOSaveChunk) save_chunks;
 } VFIOMigration;
 
 typedef struct VFIOAddressSpace {
@@ -131,6 +138,8 @@ typedef struct VFIODevice {
     VFIOMigration *migration;
     Error *migration_blocker;
     OnOffAuto pre_copy_dirty_page_tracking;
+    uint64_t migration_stop_copy_size;
+    bool migration_parallel_save;
 } VFIODevice;
 
 struct VFIODeviceOps {
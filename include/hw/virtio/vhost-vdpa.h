@@ -12,16 +12,32 @@
 #ifndef HW_VIRTIO_VHOST_VDPA_H
 #define HW_VIRTIO_VHOST_VDPA_H
 
+#include "hw/virtio/vhost-shadow-virtqueue.h"
 #include "hw/virtio/virtio.h"
+#include "standard-headers/linux/vhost_types.h"
 
 typedef struct vhost_vdpa {
     int device_fd;
     uint32_t msg_type;
     MemoryListener listener;
+    struct vhost_vdpa_iova_range iova_range;
+    /* Features acked by the guest, without VHOST_F_LOG_ALL */
+    uint64_t acked_features;
+    /* Forward the virtqueues of this device through shadow virtqueues */
+    bool shadow_vqs_enabled;
+    GPtrArray *shadow_vqs;
+    const VhostShadowVirtqueueOps *shadow_vq_ops;
+    void *shadow_vq_ops_opaque;
+    /* Page for the buffers of vhost_vdpa_svq_inject() */
+    void *svq_bounce;
+    bool svq_bounce_mapped;
+    Error *migration_blocker;
     struct vhost_dev *dev;
 } VhostVDPA;
 
 extern AddressSpace address_space_memory;
 extern int vhost_vdpa_get_device_id(struct vhost_dev *dev,
                                    uint32_t *device_id);
+ssize_t vhost_vdpa_svq_inject(struct vhost_vdpa *v, const void *out,
+                              size_t out_len, void *in, size_t in_len);
 #endif
@@ -65,6 +65,11 @@ struct VirtIOBalloon {
      */
     bool block_iothread;
     NotifierWithReturn free_page_hint_notify;
+    /* Processes free page reports in the iothread, if any */
+    QEMUBH *reporting_bh;
+    /* Bytes reported free and discarded, or left alone */
+    uint64_t reported_bytes;
+    uint64_t reported_ignored_bytes;
     int64_t stats_last_update;
     int64_t stats_poll_interval;
     uint32_t host_features;
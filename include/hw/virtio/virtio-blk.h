@@ -36,6 +36,9 @@ struct VirtIOBlkConf
 {
     BlockConf conf;
     IOThread *iothread;
+    /* IOThread ids, virtqueue i is served by iothreads[i % num_iothreads] */
+    uint32_t num_iothreads;
+    char **iothreads;
     char *serial;
     uint32_t request_merging;
     uint16_t num_queues;
@@ -45,14 +48,20 @@ struct VirtIOBlkConf
     uint32_t max_discard_sectors;
     uint32_t max_write_zeroes_sectors;
     bool x_enable_wce_if_config_wce;
+    /* Interrupt coalescing, disabled when coalesce_max_usecs is 0 */
+    uint32_t coalesce_max_events;
+    uint32_t coalesce_max_usecs;
+    bool coalesce_adaptive;
 };
 
 struct VirtIOBlockDataPlane;
+struct VirtIOBlockCoalesce;
 
 struct VirtIOBlockReq;
 struct VirtIOBlock {
     VirtIODevice parent_obj;
     BlockBackend *blk;
+    QemuMutex rq_lock;  /* protects rq */
     void *rq;
     QEMUBH *bh;
     VirtIOBlkConf conf;
@@ -62,6 +71,14 @@ struct VirtIOBlock {
     bool dataplane_disabled;
     bool dataplane_started;
     struct VirtIOBlockDataPlane *dataplane;
+    /*
+     * With several IOThreads, the AioContext of each virtqueue.  The
+     * requests of a virtqueue are processed and completed with its
+     * AioContext held.  NULL when all virtqueues use the BlockBackend's.
+     */
+    AioContext **vq_aio_context;
+    /* Per-virtqueue interrupt coalescing state, NULL if disabled */
+    struct VirtIOBlockCoalesce *coalesce;
     uint64_t host_features;
     size_t config_size;
 };
@@ -92,5 +109,6 @@ typedef struct MultiReqBuffer {
 
 bool virtio_blk_handle_vq(VirtIOBlock *s, VirtQueue *vq);
 void virtio_blk_process_queued_requests(VirtIOBlock *s, bool is_bh);
+void virtio_blk_coalesce_flush(VirtIOBlock *s);
 
 #endif
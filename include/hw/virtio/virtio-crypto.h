@@ -67,6 +67,7 @@ typedef struct VirtIOCryptoReq {
     uint32_t flags;
     struct virtio_crypto_inhdr *in;
     struct iovec *in_iov; /* Head address of dest iovec */
+    struct iovec *in_iov_copy; /* allocation that in_iov points into */
     unsigned int in_num; /* Number of dest iovec */
     size_t in_len;
     VirtQueue *vq;
@@ -97,6 +98,8 @@ struct VirtIOCrypto {
     uint32_t curr_queues;
     size_t config_size;
     uint8_t vhost_started;
+    /* Requests submitted to the backend that did not complete yet */
+    unsigned int inflight;
 };
 
 #endif /* QEMU_VIRTIO_CRYPTO_H */
@@ -20,6 +20,8 @@
 #include "net/announce.h"
 #include "qemu/option_int.h"
 #include "qom/object.h"
+#include "sysemu/iothread.h"
+#include "ebpf/ebpf_rss.h"
 
 #define TYPE_VIRTIO_NET "virtio-net-device"
 OBJECT_DECLARE_SIMPLE_TYPE(VirtIONet, VIRTIO_NET)
@@ -130,6 +132,7 @@ typedef struct VirtioNetRscChain {
 
 typedef struct VirtioNetRssData {
     bool    enabled;
+    bool    enabled_software_rss;
     bool    redirect;
     bool    populate_hash;
     uint32_t hash_types;
@@ -148,6 +151,8 @@ typedef struct VirtIONetQueue {
     struct {
         VirtQueueElement *elem;
     } async_tx;
+    /* used elements filled by a receive batch but not yet flushed */
+    unsigned int rx_pending;
     struct VirtIONet *n;
 } VirtIONetQueue;
 
@@ -179,6 +184,10 @@ struct VirtIONet {
     uint8_t nouni;
     uint8_t nobcast;
     uint8_t vhost_started;
+    /* userspace datapath in an IOThread instead of the main loop */
+    IOThread *iothread;
+    AioContext *ctx;
+    bool dataplane_started;
     struct {
         uint32_t in_use;
         uint32_t first_multi;
@@ -193,6 +202,8 @@ struct VirtIONet {
     int multiqueue;
     uint16_t max_queues;
     uint16_t curr_queues;
+    /* data queue pairs plus a control virtqueue client, if any */
+    uint16_t max_ncs;
     size_t config_size;
     char *netclient_name;
     char *netclient_type;
@@ -202,15 +213,23 @@ struct VirtIONet {
     AnnounceTimer announce_timer;
     bool needs_vnet_hdr_swap;
     bool mtu_bypass_backend;
+    /* inside virtio_net_receive_batch(), rx flushes are deferred */
+    bool rx_batching;
     /* primary failover device is hidden*/
     bool failover_primary_hidden;
     bool failover;
     DeviceListener primary_listener;
     Notifier migration_state;
     VirtioNetRssData rss_data;
+    EBPFRSSContext ebpf_rss;
+    char *ebpf_rss_object;
     struct NetRxPkt *rx_pkt;
 };
 
+size_t virtio_net_handle_ctrl_iov(VirtIODevice *vdev,
+                                  const struct iovec *in_sg, unsigned in_num,
+                                  const struct iovec *out_sg,
+                                  unsigned out_num);
 void virtio_net_set_netclient_name(VirtIONet *n, const char *name,
                                    const char *type);
 
@@ -62,6 +62,9 @@ struct VirtIOSCSIConf {
     CharBackend chardev;
     uint32_t boot_tpgt;
     IOThread *iothread;
+    /* IOThread ids, command queue i is served by iothreads[i % n] */
+    uint32_t num_iothreads;
+    char **iothreads;
 };
 
 struct VirtIOSCSI;
@@ -85,7 +88,20 @@ struct VirtIOSCSI {
     bool events_dropped;
 
     /* Fields for dataplane below */
-    AioContext *ctx; /* one iothread per virtio-scsi-pci for now */
+    AioContext *ctx; /* control and event queues, and first IOThread */
+
+    /*
+     * With the iothreads property, the distinct AioContexts of the
+     * controller and the one of each command queue.  Every LUN is attached
+     * to one of ctxs; commands are dispatched to the AioContext of their
+     * LUN and completed back in the one of their virtqueue.
+     */
+    IOThread **iothreads;
+    AioContext **ctxs;
+    unsigned num_ctxs;
+    AioContext **cmd_vq_ctx;
+    unsigned next_lun_ctx;
+    unsigned bh_in_flight; /* completions and TMFs on their way */
 
     bool dataplane_started;
     bool dataplane_starting;
@@ -117,6 +133,8 @@ typedef struct VirtIOSCSIReq {
     SCSIRequest *sreq;
     size_t resp_size;
     enum SCSIXferMode mode;
+    /* LUN that the command is dispatched to, see virtio_scsi_cmd_req_bh() */
+    SCSIDevice *lun_dev;
     union {
         VirtIOSCSICmdResp     cmd;
         VirtIOSCSICtrlTMFResp tmf;
@@ -160,6 +178,8 @@ void virtio_scsi_push_event(VirtIOSCSI *s, SCSIDevice *dev,
                             uint32_t event, uint32_t reason);
 
 void virtio_scsi_dataplane_setup(VirtIOSCSI *s, Error **errp);
+void virtio_scsi_dataplane_cleanup(VirtIOSCSI *s);
+AioContext *virtio_scsi_get_vq_aio_context(VirtIOSCSI *s, VirtQueue *vq);
 int virtio_scsi_dataplane_start(VirtIODevice *s);
 void virtio_scsi_dataplane_stop(VirtIODevice *s);
 
@@ -80,6 +80,13 @@ struct VirtIOSerialPortClass {
      */
     ssize_t (*have_data)(VirtIOSerialPort *port, const uint8_t *buf,
                          ssize_t len);
+    /*
+     * Optional.  Like have_data, but passes the data of several
+     * buffers, which may come from several elements of the virtqueue.
+     * If implemented, it is used instead of have_data.
+     */
+    ssize_t (*have_data_iov)(VirtIOSerialPort *port, const struct iovec *iov,
+                             int iovcnt);
 };
 
 /*
@@ -35,6 +35,8 @@ typedef struct XenBlockProperties {
     XenBlockVdev vdev;
     BlockConf conf;
     unsigned int max_ring_page_order;
+    unsigned int max_queues;
+    bool persistent_grants;
     IOThread *iothread;
 } XenBlockProperties;
 
@@ -52,7 +54,8 @@ struct XenBlockDevice {
     XenBlockProperties props;
     const char *device_type;
     unsigned int info;
-    XenBlockDataPlane *dataplane;
+    XenBlockDataPlane **dataplanes;
+    unsigned int nr_dataplanes;
     XenBlockDrive *drive;
     XenBlockIOThread *iothread;
 };
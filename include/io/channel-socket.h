@@ -47,6 +47,10 @@ struct QIOChannelSocket {
     socklen_t localAddrLen;
     struct sockaddr_storage remoteAddr;
     socklen_t remoteAddrLen;
+    /* Number of sendmsg() calls issued with MSG_ZEROCOPY */
+    ssize_t zero_copy_queued;
+    /* Number of MSG_ZEROCOPY sendmsg() calls reported as completed */
+    ssize_t zero_copy_sent;
 };
 
 
@@ -48,6 +48,7 @@ struct QIOChannelTLS {
     QIOChannel *master;
     QCryptoTLSSession *session;
     QIOChannelShutdown shutdown;
+    int ktls; /* QCRYPTO_TLS_KTLS_* directions run by the kernel */
 };
 
 /**
@@ -62,12 +62,29 @@ typedef struct SaveVMHandlers {
      * whole amount of pending data.
      */
 
+    /* save_stop_copy_size
+     * Returns the amount of state that will only be sent once the source
+     * VM is stopped, on top of what save_live_pending reports, e.g. device
+     * state that cannot be pre-copied.  It is added to the pending size in
+     * the convergence check so that the migration only switches over when
+     * the whole downtime fits in downtime-limit.
+     */
+    uint64_t (*save_stop_copy_size)(void *opaque);
+
 
     LoadStateHandler *load_state;
     int (*load_setup)(QEMUFile *f, void *opaque);
     int (*load_cleanup)(void *opaque);
     /* Called when postcopy migration wants to resume from failure */
     int (*resume_prepare)(MigrationState *s, void *opaque);
+
+    /* switchover_ack_needed
+     * Called on the destination, after load_setup, when switchover-ack is
+     * enabled.  Returning true means the handler will call
+     * qemu_loadvm_approve_switchover() once it is ready for the source to
+     * stop the VM; the ACK is only sent when all of them have approved.
+     */
+    bool (*switchover_ack_needed)(void *opaque);
 } SaveVMHandlers;
 
 int register_savevm_live(const char *idstr,
@@ -0,0 +1,47 @@
+/*
+ * Statistics for query-stats
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#ifndef MONITOR_STATS_H
+#define MONITOR_STATS_H
+
+#include "qapi/qapi-types-stats.h"
+
+/*
+ * Append a StatsResult for each instance of the provider to @result.
+ * Only the statistics named in @names are returned, or all of them if
+ * @names is NULL; stats_add() takes care of that.
+ */
+typedef void StatsCb(StatsResultList **result, strList *names, Error **errp);
+
+/* Append a description of each statistic of the provider to @result */
+typedef void StatsSchemaCb(StatsSchemaValueList **result);
+
+/*
+ * Register a statistics provider.  The callbacks run with the BQL held
+ * and should only read counters that the subsystem keeps anyway, so
+ * that query-stats can be polled often.
+ */
+void add_stats_callbacks(StatsProvider provider, StatsCb *stats_cb,
+                         StatsSchemaCb *schemas_cb);
+
+/* Add statistic @name to @stats, unless it is not in @names */
+void stats_add(StatsList **stats, strList *names, const char *name,
+               uint64_t value);
+
+/*
+ * Add the statistics @stats of @instance to @result.  @instance may be
+ * NULL for statistics that cover the whole VM.  Nothing is added if
+ * @stats is empty, e.g. because @names filtered out all statistics.
+ */
+void stats_result_add(StatsResultList **result, StatsProvider provider,
+                      const char *instance, StatsList *stats);
+
+/* Describe statistic @name; STATS_UNIT__MAX stands for no unit */
+void stats_schema_add(StatsSchemaValueList **result, const char *name,
+                      StatsType type, StatsUnit unit);
+
+#endif /* MONITOR_STATS_H */
@@ -26,7 +26,16 @@ struct iovec;
 #define CSUM_UDP    0x04
 #define CSUM_ALL    (CSUM_IP | CSUM_TCP | CSUM_UDP)
 
+/*
+ * net_checksum_add_cont: ones' complement sum of @len bytes at @buf
+ *
+ * @seq is the offset of @buf within the checksummed data; only its
+ * parity matters.  The result is folded to 16 bits, so partial sums can
+ * be added together before net_checksum_finish().  Large buffers are
+ * summed with the best SIMD implementation the host CPU supports.
+ */
 uint32_t net_checksum_add_cont(int len, uint8_t *buf, int seq);
+bool test_net_checksum_next_accel(void);
 uint16_t net_checksum_finish(uint32_t sum);
 uint16_t net_checksum_tcpudp(uint16_t length, uint16_t proto,
                              uint8_t *addrs, uint8_t *buf);
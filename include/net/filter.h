@@ -31,6 +31,18 @@ typedef ssize_t (FilterReceiveIOV)(NetFilterState *nc,
                                    int iovcnt,
                                    NetPacketSent *sent_cb);
 
+/*
+ * Observe @count packets at once, the iovecs of which are laid out back
+ * to back, @iovcnt[i] entries for packet i.  Only filters that always
+ * let packets through unmodified may implement this.
+ */
+typedef void (FilterReceiveIOVBatch)(NetFilterState *nf,
+                                     NetClientState *sender,
+                                     unsigned flags,
+                                     const struct iovec *iov,
+                                     const int *iovcnt,
+                                     int count);
+
 typedef void (FilterStatusChanged) (NetFilterState *nf, Error **errp);
 
 typedef void (FilterHandleEvent) (NetFilterState *nf, int event, Error **errp);
@@ -43,6 +55,7 @@ struct NetFilterClass {
     FilterCleanup *cleanup;
     FilterStatusChanged *status_changed;
     FilterHandleEvent *handle_event;
+    FilterReceiveIOVBatch *receive_iov_batch;
     /* mandatory */
     FilterReceiveIOV *receive_iov;
 };
@@ -70,6 +83,16 @@ ssize_t qemu_netfilter_receive(NetFilterState *nf,
                                int iovcnt,
                                NetPacketSent *sent_cb);
 
+bool qemu_netfilter_can_batch(NetClientState *nc,
+                              NetFilterDirection direction);
+void qemu_netfilter_receive_batch(NetClientState *nc,
+                                  NetFilterDirection direction,
+                                  NetClientState *sender,
+                                  unsigned flags,
+                                  const struct iovec *iov,
+                                  const int *iovcnt,
+                                  int count);
+
 /* pass the packet to the next filter */
 ssize_t qemu_netfilter_pass_to_next(NetClientState *sender,
                                     unsigned flags,
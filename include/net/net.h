@@ -2,6 +2,7 @@
 #define QEMU_NET_H
 
 #include "qemu/queue.h"
+#include "qemu/stats64.h"
 #include "qapi/qapi-types-net.h"
 #include "net/queue.h"
 #include "hw/qdev-properties-system.h"
@@ -46,6 +47,8 @@ typedef void (NetPoll)(NetClientState *, bool enable);
 typedef bool (NetCanReceive)(NetClientState *);
 typedef ssize_t (NetReceive)(NetClientState *, const uint8_t *, size_t);
 typedef ssize_t (NetReceiveIOV)(NetClientState *, const struct iovec *, int);
+typedef int (NetReceiveIOVBatch)(NetClientState *, const struct iovec *,
+                                 const int *, int);
 typedef void (NetCleanup) (NetClientState *);
 typedef void (LinkStatusChanged)(NetClientState *);
 typedef void (NetClientDestructor)(NetClientState *);
@@ -61,6 +64,9 @@ typedef int (SetVnetBE)(NetClientState *, bool);
 typedef struct SocketReadState SocketReadState;
 typedef void (SocketReadStateFinalize)(SocketReadState *rs);
 typedef void (NetAnnounce)(NetClientState *);
+typedef int (NetLoad)(NetClientState *);
+typedef bool (SetSteeringEBPF)(NetClientState *, int);
+typedef void (NetSetAioContext)(NetClientState *, AioContext *);
 
 typedef struct NetClientInfo {
     NetClientDriver type;
@@ -68,6 +74,13 @@ typedef struct NetClientInfo {
     NetReceive *receive;
     NetReceive *receive_raw;
     NetReceiveIOV *receive_iov;
+    /*
+     * Receive several packets at once.  The packets' iovecs are laid out
+     * back to back in @iov, packet i using iovcnt[i] entries.  Returns the
+     * number of packets consumed (delivered or dropped); the remaining
+     * ones are sent again one at a time through the regular path.
+     */
+    NetReceiveIOVBatch *receive_iov_batch;
     NetCanReceive *can_receive;
     NetCleanup *cleanup;
     LinkStatusChanged *link_status_changed;
@@ -82,6 +95,13 @@ typedef struct NetClientInfo {
     SetVnetLE *set_vnet_le;
     SetVnetBE *set_vnet_be;
     NetAnnounce *announce;
+    NetLoad *load;
+    SetSteeringEBPF *set_steering_ebpf;
+    /*
+     * Move the event handlers of the client to @ctx, or back to the main
+     * loop if @ctx is NULL.  Handlers running in @ctx must hold it.
+     */
+    NetSetAioContext *set_aio_context;
 } NetClientInfo;
 
 struct NetClientState {
@@ -101,9 +121,24 @@ struct NetClientState {
     int vnet_hdr_len;
     bool is_netdev;
     bool do_not_pad; /* do not pad to the minimum ethernet frame length */
+    bool is_datapath; /* false for clients that only carry control traffic */
     QTAILQ_HEAD(, NetFilterState) filters;
+    /* filters that are on, indexed by the direction they see (RX or TX) */
+    unsigned int nb_active_filters[NET_FILTER_DIRECTION__MAX];
+    /* context the datapath runs in, NULL for the main loop */
+    AioContext *ctx;
+    /* packets and bytes this client has received, for query-stats */
+    Stat64 rx_packets;
+    Stat64 rx_bytes;
 };
 
+/* Is any filter of @nc on for packets travelling in @direction? */
+static inline bool qemu_netfilter_active(NetClientState *nc,
+                                         NetFilterDirection direction)
+{
+    return nc->nb_active_filters[direction] != 0;
+}
+
 typedef struct NICState {
     NetClientState *ncs;
     NICConf *conf;
@@ -132,6 +167,10 @@ NetClientState *qemu_new_net_client(NetClientInfo *info,
                                     NetClientState *peer,
                                     const char *model,
                                     const char *name);
+NetClientState *qemu_new_net_control_client(NetClientInfo *info,
+                                            NetClientState *peer,
+                                            const char *model,
+                                            const char *name);
 NICState *qemu_new_nic(NetClientInfo *info,
                        NICConf *conf,
                        const char *model,
@@ -151,6 +190,9 @@ ssize_t qemu_sendv_packet(NetClientState *nc, const struct iovec *iov,
                           int iovcnt);
 ssize_t qemu_sendv_packet_async(NetClientState *nc, const struct iovec *iov,
                                 int iovcnt, NetPacketSent *sent_cb);
+int qemu_sendv_packets_async(NetClientState *nc, const struct iovec *iov,
+                             const int *iovcnt, int count,
+                             NetPacketSent *sent_cb);
 ssize_t qemu_send_packet(NetClientState *nc, const uint8_t *buf, int size);
 ssize_t qemu_receive_packet(NetClientState *nc, const uint8_t *buf, int size);
 ssize_t qemu_receive_packet_iov(NetClientState *nc,
@@ -161,6 +203,8 @@ ssize_t qemu_send_packet_async(NetClientState *nc, const uint8_t *buf,
                                int size, NetPacketSent *sent_cb);
 void qemu_purge_queued_packets(NetClientState *nc);
 void qemu_flush_queued_packets(NetClientState *nc);
+bool qemu_net_can_set_aio_context(NetClientState *nc);
+void qemu_net_set_aio_context(NetClientState *nc, AioContext *ctx);
 void qemu_flush_or_purge_queued_packets(NetClientState *nc, bool purge);
 void qemu_format_nic_info_str(NetClientState *nc, uint8_t macaddr[6]);
 bool qemu_has_ufo(NetClientState *nc);
@@ -65,6 +65,33 @@ typedef void coroutine_fn CoroutineEntry(void *opaque);
  */
 Coroutine *qemu_coroutine_create(CoroutineEntry *entry, void *opaque);
 
+/**
+ * Increase the number of coroutines each thread keeps around for reuse.
+ *
+ * Devices call this with the number of requests they may have in flight,
+ * so that deep queues do not allocate and free a coroutine (and its stack)
+ * per request.
+ */
+void qemu_coroutine_inc_pool_size(unsigned int additional_pool_size);
+
+/**
+ * Undo a previous qemu_coroutine_inc_pool_size()
+ */
+void qemu_coroutine_dec_pool_size(unsigned int removing_pool_size);
+
+typedef struct CoroutinePoolStats {
+    unsigned int batch_size;    /* current size of the per-thread pools */
+    uint64_t hits;              /* coroutines taken from a pool */
+    uint64_t misses;            /* coroutines allocated because none was */
+    uint64_t frees;             /* coroutines freed because the pool was full */
+} CoroutinePoolStats;
+
+/**
+ * Get coroutine pool statistics, for all threads.  Hits are only accounted
+ * in batches, so they lag behind a little.
+ */
+void qemu_coroutine_get_pool_stats(CoroutinePoolStats *stats);
+
 /**
  * Transfer control to a coroutine
  */
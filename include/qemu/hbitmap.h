@@ -115,6 +115,15 @@ int hbitmap_granularity(const HBitmap *hb);
  */
 uint64_t hbitmap_count(const HBitmap *hb);
 
+/**
+ * hbitmap_generation:
+ * @hb: HBitmap to operate on.
+ *
+ * Return a number that changes whenever the HBitmap may have been modified,
+ * including by deserialization and truncation.
+ */
+uint64_t hbitmap_generation(const HBitmap *hb);
+
 /**
  * hbitmap_set:
  * @hb: HBitmap to operate on.
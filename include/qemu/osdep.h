@@ -412,6 +412,11 @@ void qemu_anon_ram_free(void *ptr, size_t size);
 #else
 #define QEMU_MADV_REMOVE QEMU_MADV_INVALID
 #endif
+#ifdef MADV_POPULATE_WRITE
+#define QEMU_MADV_POPULATE_WRITE MADV_POPULATE_WRITE
+#else
+#define QEMU_MADV_POPULATE_WRITE QEMU_MADV_INVALID
+#endif
 
 #elif defined(CONFIG_POSIX_MADVISE)
 
@@ -425,6 +430,7 @@ void qemu_anon_ram_free(void *ptr, size_t size);
 #define QEMU_MADV_HUGEPAGE  QEMU_MADV_INVALID
 #define QEMU_MADV_NOHUGEPAGE  QEMU_MADV_INVALID
 #define QEMU_MADV_REMOVE QEMU_MADV_INVALID
+#define QEMU_MADV_POPULATE_WRITE QEMU_MADV_INVALID
 
 #else /* no-op */
 
@@ -438,6 +444,7 @@ void qemu_anon_ram_free(void *ptr, size_t size);
 #define QEMU_MADV_HUGEPAGE  QEMU_MADV_INVALID
 #define QEMU_MADV_NOHUGEPAGE  QEMU_MADV_INVALID
 #define QEMU_MADV_REMOVE QEMU_MADV_INVALID
+#define QEMU_MADV_POPULATE_WRITE QEMU_MADV_INVALID
 
 #endif
 
@@ -627,8 +634,35 @@ unsigned long qemu_getauxval(unsigned long type);
 
 void qemu_set_tty_echo(int fd, bool echo);
 
+/**
+ * os_mem_prealloc:
+ * @fd: file descriptor backing @area, or -1
+ * @area: start of the memory to preallocate
+ * @sz: size of @area
+ * @smp_cpus: maximum number of threads to use
+ * @host_nodes: bitmap of the host NUMA nodes @area is bound to, or NULL
+ * @maxnode: number of bits in @host_nodes
+ * @async: return without waiting for the preallocation, if possible
+ * @errp: pointer to a NULL-initialized error object
+ *
+ * Fault in all the pages of @area.  If @host_nodes is given, the work is
+ * done by threads running on the CPUs of those nodes.
+ *
+ * With @async, errors are reported by os_mem_prealloc_finish() instead,
+ * which must be called before @area is used.
+ */
 void os_mem_prealloc(int fd, char *area, size_t sz, int smp_cpus,
-                     Error **errp);
+                     const unsigned long *host_nodes, unsigned long maxnode,
+                     bool async, Error **errp);
+
+/**
+ * os_mem_prealloc_finish:
+ * @errp: pointer to a NULL-initialized error object
+ *
+ * Wait for all the asynchronous os_mem_prealloc() calls to complete.
+ * Returns false, with @errp set, if any of them failed.
+ */
+bool os_mem_prealloc_finish(Error **errp);
 
 /**
  * qemu_get_pid_name:
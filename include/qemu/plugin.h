@@ -24,6 +24,7 @@ enum qemu_plugin_event {
     QEMU_PLUGIN_EV_VCPU_RESUME,
     QEMU_PLUGIN_EV_VCPU_SYSCALL,
     QEMU_PLUGIN_EV_VCPU_SYSCALL_RET,
+    QEMU_PLUGIN_EV_VCPU_SAMPLE,
     QEMU_PLUGIN_EV_FLUSH,
     QEMU_PLUGIN_EV_ATEXIT,
     QEMU_PLUGIN_EV_MAX, /* total number of plugin events we support */
@@ -56,6 +57,7 @@ union qemu_plugin_cb_sig {
     qemu_plugin_vcpu_mem_cb_t        vcpu_mem;
     qemu_plugin_vcpu_syscall_cb_t    vcpu_syscall;
     qemu_plugin_vcpu_syscall_ret_cb_t vcpu_syscall_ret;
+    qemu_plugin_vcpu_sample_cb_t     vcpu_sample;
     void *generic;
 };
 
@@ -68,9 +70,40 @@ enum plugin_dyn_cb_type {
 enum plugin_dyn_cb_subtype {
     PLUGIN_CB_REGULAR,
     PLUGIN_CB_INLINE,
+    PLUGIN_CB_TRACE,
     PLUGIN_N_CB_SUBTYPES,
 };
 
+/*
+ * Per-vCPU storage.  @data holds one element per vCPU and is grown, with
+ * all vCPUs stopped, when a vCPU with a larger index is created.  Code
+ * generated for inline ops loads @data->data at run-time, so growing it
+ * does not require a TB flush.
+ */
+struct qemu_plugin_scoreboard {
+    GArray *data;
+    QLIST_ENTRY(qemu_plugin_scoreboard) entry;
+};
+
+/* Element of qemu_plugin_trace.vcpus; @ring must stay first */
+struct qemu_plugin_trace_vcpu {
+    struct qemu_plugin_trace_ring *ring;
+    int fd;
+};
+
+/*
+ * Per-vCPU trace rings.  Generated code finds the ring of the running
+ * vCPU through @vcpus, like an inline op finds its scoreboard entry.
+ */
+struct qemu_plugin_trace {
+    struct qemu_plugin_scoreboard *vcpus;
+    uint64_t size;
+    bool shared;
+    qemu_plugin_trace_drain_cb_t cb;
+    void *userdata;
+    QLIST_ENTRY(qemu_plugin_trace) entry;
+};
+
 /*
  * A dynamic callback has an insertion point that is determined at run-time.
  * Usually the insertion point is somewhere in the code cache; think for
@@ -85,10 +118,22 @@ struct qemu_plugin_dyn_cb {
     enum qemu_plugin_mem_rw rw;
     /* fields specific to each dyn_cb type go here */
     union {
+        /* inline ops update @userp if set, otherwise @entry */
         struct {
             enum qemu_plugin_op op;
             uint64_t imm;
+            qemu_plugin_u64 entry;
         } inline_insn;
+        /* regular callbacks run only if "@entry @cond @imm" holds */
+        struct {
+            enum qemu_plugin_cond cond;
+            qemu_plugin_u64 entry;
+            uint64_t imm;
+        } cond;
+        /* trace records go to @userp, a struct qemu_plugin_trace */
+        struct {
+            uint64_t pc;
+        } trace;
     };
 };
 
@@ -189,6 +234,13 @@ void qemu_plugin_atexit_cb(void);
 
 void qemu_plugin_add_dyn_cb_arr(GArray *arr);
 
+/*
+ * Make sure that @n records can be appended to the ring of @vcpu_index,
+ * draining it or waiting for the consumer if needed.
+ */
+void qemu_plugin_trace_make_room(struct qemu_plugin_trace *trace,
+                                 unsigned int vcpu_index, uint64_t n);
+
 void qemu_plugin_disable_mem_helpers(CPUState *cpu);
 
 #else /* !CONFIG_PLUGIN */
@@ -50,7 +50,7 @@ typedef uint64_t qemu_plugin_id_t;
 
 extern QEMU_PLUGIN_EXPORT int qemu_plugin_version;
 
-#define QEMU_PLUGIN_VERSION 1
+#define QEMU_PLUGIN_VERSION 2
 
 /**
  * struct qemu_info_t - system information for plugins
@@ -232,6 +232,80 @@ enum qemu_plugin_mem_rw {
     QEMU_PLUGIN_MEM_RW,
 };
 
+/**
+ * struct qemu_plugin_scoreboard - opaque handle for per-vCPU storage
+ *
+ * A scoreboard holds one element of a fixed size for every vCPU. Inline
+ * ops can update the element of the vCPU executing them without any
+ * locking, since no two vCPUs share an element.
+ */
+struct qemu_plugin_scoreboard;
+
+/**
+ * typedef qemu_plugin_u64 - uint64_t member of a scoreboard element
+ * @score: the scoreboard
+ * @offset: offset of the uint64_t within an element of @score
+ */
+typedef struct {
+    struct qemu_plugin_scoreboard *score;
+    size_t offset;
+} qemu_plugin_u64;
+
+/**
+ * qemu_plugin_scoreboard_new() - allocate a new scoreboard
+ * @element_size: size of the element kept for each vCPU
+ *
+ * Elements are zero-initialised, including those of vCPUs created
+ * later on.
+ *
+ * Returns: a new scoreboard, to be released with
+ * qemu_plugin_scoreboard_free()
+ */
+struct qemu_plugin_scoreboard *qemu_plugin_scoreboard_new(size_t element_size);
+
+/**
+ * qemu_plugin_scoreboard_free() - free a scoreboard
+ * @score: the scoreboard
+ *
+ * No inline op or conditional callback may refer to @score any more,
+ * i.e. this is only safe from the atexit callback or after a flush.
+ */
+void qemu_plugin_scoreboard_free(struct qemu_plugin_scoreboard *score);
+
+/**
+ * qemu_plugin_scoreboard_find() - get the element of a vCPU
+ * @score: the scoreboard
+ * @vcpu_index: index of the vCPU
+ *
+ * The returned pointer is only valid until the next vCPU is created.
+ *
+ * Returns: pointer to the element of @vcpu_index
+ */
+void *qemu_plugin_scoreboard_find(struct qemu_plugin_scoreboard *score,
+                                  unsigned int vcpu_index);
+
+/**
+ * qemu_plugin_u64_get() - read the entry of a vCPU
+ * @entry: the scoreboard entry
+ * @vcpu_index: index of the vCPU
+ */
+uint64_t qemu_plugin_u64_get(qemu_plugin_u64 entry, unsigned int vcpu_index);
+
+/**
+ * qemu_plugin_u64_set() - write the entry of a vCPU
+ * @entry: the scoreboard entry
+ * @vcpu_index: index of the vCPU
+ * @val: the new value
+ */
+void qemu_plugin_u64_set(qemu_plugin_u64 entry, unsigned int vcpu_index,
+                         uint64_t val);
+
+/**
+ * qemu_plugin_u64_sum() - add up the entry over all vCPUs
+ * @entry: the scoreboard entry
+ */
+uint64_t qemu_plugin_u64_sum(qemu_plugin_u64 entry);
+
 /**
  * typedef qemu_plugin_vcpu_tb_trans_cb_t - translation callback
  * @id: unique plugin id
@@ -273,12 +347,29 @@ void qemu_plugin_register_vcpu_tb_exec_cb(struct qemu_plugin_tb *tb,
  * enum qemu_plugin_op - describes an inline op
  *
  * @QEMU_PLUGIN_INLINE_ADD_U64: add an immediate value uint64_t
- *
- * Note: currently only a single inline op is supported.
+ * @QEMU_PLUGIN_INLINE_STORE_U64: store an immediate value uint64_t
  */
 
 enum qemu_plugin_op {
     QEMU_PLUGIN_INLINE_ADD_U64,
+    QEMU_PLUGIN_INLINE_STORE_U64,
+};
+
+/**
+ * enum qemu_plugin_cond - condition for a conditional callback
+ *
+ * The condition compares a scoreboard entry, as an unsigned value, with
+ * an immediate: the callback runs if "entry COND imm" holds.
+ */
+enum qemu_plugin_cond {
+    QEMU_PLUGIN_COND_NEVER,
+    QEMU_PLUGIN_COND_ALWAYS,
+    QEMU_PLUGIN_COND_EQ,
+    QEMU_PLUGIN_COND_NE,
+    QEMU_PLUGIN_COND_LT,
+    QEMU_PLUGIN_COND_LE,
+    QEMU_PLUGIN_COND_GT,
+    QEMU_PLUGIN_COND_GE,
 };
 
 /**
@@ -299,6 +390,43 @@ void qemu_plugin_register_vcpu_tb_exec_inline(struct qemu_plugin_tb *tb,
                                               enum qemu_plugin_op op,
                                               void *ptr, uint64_t imm);
 
+/**
+ * qemu_plugin_register_vcpu_tb_exec_inline_per_vcpu() - per-vCPU inline op
+ * @tb: the opaque qemu_plugin_tb handle for the translation
+ * @op: the type of qemu_plugin_op (e.g. ADD_U64)
+ * @entry: the scoreboard entry to update
+ * @imm: the op data (e.g. 1)
+ *
+ * As qemu_plugin_register_vcpu_tb_exec_inline(), but the op applies to
+ * the element of the executing vCPU, so results are exact even with
+ * several vCPUs running in parallel.
+ */
+void qemu_plugin_register_vcpu_tb_exec_inline_per_vcpu(
+    struct qemu_plugin_tb *tb, enum qemu_plugin_op op,
+    qemu_plugin_u64 entry, uint64_t imm);
+
+/**
+ * qemu_plugin_register_vcpu_tb_exec_cond_cb() - conditional execution cb
+ * @tb: the opaque qemu_plugin_tb handle for the translation
+ * @cb: callback function
+ * @flags: does the plugin read or write the CPU's registers?
+ * @cond: condition to check
+ * @entry: the scoreboard entry to compare
+ * @imm: the value to compare with
+ * @userdata: any plugin data to pass to the @cb?
+ *
+ * The @cb function is called when a translated unit executes, if the
+ * executing vCPU's @entry satisfies @cond against @imm.  The check is
+ * made inline, so the callback costs nothing while the condition fails.
+ */
+void qemu_plugin_register_vcpu_tb_exec_cond_cb(struct qemu_plugin_tb *tb,
+                                               qemu_plugin_vcpu_udata_cb_t cb,
+                                               enum qemu_plugin_cb_flags flags,
+                                               enum qemu_plugin_cond cond,
+                                               qemu_plugin_u64 entry,
+                                               uint64_t imm,
+                                               void *userdata);
+
 /**
  * qemu_plugin_register_vcpu_insn_exec_cb() - register insn execution cb
  * @insn: the opaque qemu_plugin_insn handle for an instruction
@@ -327,6 +455,37 @@ void qemu_plugin_register_vcpu_insn_exec_inline(struct qemu_plugin_insn *insn,
                                                 enum qemu_plugin_op op,
                                                 void *ptr, uint64_t imm);
 
+/**
+ * qemu_plugin_register_vcpu_insn_exec_inline_per_vcpu() - per-vCPU inline op
+ * @insn: the opaque qemu_plugin_insn handle for an instruction
+ * @op: the type of qemu_plugin_op (e.g. ADD_U64)
+ * @entry: the scoreboard entry to update
+ * @imm: the op data (e.g. 1)
+ *
+ * As qemu_plugin_register_vcpu_insn_exec_inline(), but on the element of
+ * the executing vCPU.
+ */
+void qemu_plugin_register_vcpu_insn_exec_inline_per_vcpu(
+    struct qemu_plugin_insn *insn, enum qemu_plugin_op op,
+    qemu_plugin_u64 entry, uint64_t imm);
+
+/**
+ * qemu_plugin_register_vcpu_insn_exec_cond_cb() - conditional insn cb
+ * @insn: the opaque qemu_plugin_insn handle for an instruction
+ * @cb: callback function
+ * @flags: does the plugin read or write the CPU's registers?
+ * @cond: condition to check
+ * @entry: the scoreboard entry to compare
+ * @imm: the value to compare with
+ * @userdata: any plugin data to pass to the @cb?
+ *
+ * As qemu_plugin_register_vcpu_tb_exec_cond_cb(), for an instruction.
+ */
+void qemu_plugin_register_vcpu_insn_exec_cond_cb(
+    struct qemu_plugin_insn *insn, qemu_plugin_vcpu_udata_cb_t cb,
+    enum qemu_plugin_cb_flags flags, enum qemu_plugin_cond cond,
+    qemu_plugin_u64 entry, uint64_t imm, void *userdata);
+
 /**
  * qemu_plugin_tb_n_insns() - query helper for number of insns in TB
  * @tb: opaque handle to TB passed to callback
@@ -496,6 +655,159 @@ void qemu_plugin_register_vcpu_mem_inline(struct qemu_plugin_insn *insn,
                                           enum qemu_plugin_op op, void *ptr,
                                           uint64_t imm);
 
+void qemu_plugin_register_vcpu_mem_inline_per_vcpu(
+    struct qemu_plugin_insn *insn, enum qemu_plugin_mem_rw rw,
+    enum qemu_plugin_op op, qemu_plugin_u64 entry, uint64_t imm);
+
+/**
+ * struct qemu_plugin_trace - opaque handle for a set of trace rings
+ *
+ * A trace has one ring buffer per vCPU. Translated code appends a record
+ * to the ring of the executing vCPU without calling out of the code
+ * cache; the records are consumed in batches, either by a drain callback
+ * of the plugin or by another process that maps the ring.
+ */
+struct qemu_plugin_trace;
+
+#define QEMU_PLUGIN_TRACE_INSN  (1 << 0)
+#define QEMU_PLUGIN_TRACE_MEM   (1 << 1)
+
+/**
+ * struct qemu_plugin_trace_record - an entry of a trace ring
+ * @pc: guest virtual address of the instruction
+ * @vaddr: guest virtual address of the access, 0 for instruction records
+ * @info: the access, as for memory callbacks; 0 for instruction records
+ * @flags: QEMU_PLUGIN_TRACE_INSN or QEMU_PLUGIN_TRACE_MEM
+ */
+struct qemu_plugin_trace_record {
+    uint64_t pc;
+    uint64_t vaddr;
+    qemu_plugin_meminfo_t info;
+    uint32_t flags;
+};
+
+/**
+ * struct qemu_plugin_trace_ring - the ring of a vCPU
+ * @head: number of records written so far, only written by the vCPU
+ * @tail: number of records consumed so far, only written by the consumer
+ * @size: number of slots in @records, a power of 2
+ * @vcpu_index: the vCPU writing to the ring
+ * @records: record number N is at index (N & (@size - 1))
+ *
+ * @head and @tail only ever increase. The vCPU stores a record before
+ * bumping @head; the consumer must load @head with acquire semantics and
+ * store @tail with release semantics once it is done with the records.
+ */
+struct qemu_plugin_trace_ring {
+    uint64_t head;
+    uint64_t tail;
+    uint64_t size;
+    uint32_t vcpu_index;
+    uint32_t reserved;
+    struct qemu_plugin_trace_record records[];
+};
+
+/**
+ * typedef qemu_plugin_trace_drain_cb_t - consume records of a trace ring
+ * @vcpu_index: the vCPU whose ring is drained
+ * @records: the oldest records that were not consumed yet
+ * @n: number of records at @records
+ * @userdata: user data passed to qemu_plugin_trace_new()
+ *
+ * Called from the thread of @vcpu_index, or from the thread calling
+ * qemu_plugin_trace_drain(). The records are released on return.
+ */
+typedef void
+(*qemu_plugin_trace_drain_cb_t)(unsigned int vcpu_index,
+                                const struct qemu_plugin_trace_record *records,
+                                size_t n, void *userdata);
+
+/**
+ * qemu_plugin_trace_new() - allocate the trace rings
+ * @size: number of records of each ring, rounded up to a power of 2
+ * @shared: back each ring with a file descriptor that can be mapped by
+ *          another process, see qemu_plugin_trace_fd()
+ * @cb: drain callback, or NULL
+ * @userdata: passed to @cb
+ *
+ * With @cb, a vCPU calls @cb when its ring fills up. Without @cb the
+ * records must be consumed by another thread or process, and a vCPU
+ * waits for room in its ring when it fills up.
+ *
+ * Returns: a new trace or NULL if shared memory is not available
+ */
+struct qemu_plugin_trace *
+qemu_plugin_trace_new(size_t size, bool shared,
+                      qemu_plugin_trace_drain_cb_t cb, void *userdata);
+
+/**
+ * qemu_plugin_trace_free() - drain and free the trace rings
+ * @trace: the trace
+ *
+ * As for scoreboards, this is only safe from the atexit callback or
+ * after a flush.
+ */
+void qemu_plugin_trace_free(struct qemu_plugin_trace *trace);
+
+/**
+ * qemu_plugin_trace_find() - get the ring of a vCPU
+ * @trace: the trace
+ * @vcpu_index: index of the vCPU
+ *
+ * Returns: the ring of @vcpu_index, NULL if the vCPU does not exist yet
+ */
+struct qemu_plugin_trace_ring *
+qemu_plugin_trace_find(struct qemu_plugin_trace *trace,
+                       unsigned int vcpu_index);
+
+/**
+ * qemu_plugin_trace_fd() - get the file descriptor of a shared ring
+ * @trace: the trace
+ * @vcpu_index: index of the vCPU
+ *
+ * The whole ring, starting with struct qemu_plugin_trace_ring, can be
+ * mapped from the descriptor.
+ *
+ * Returns: the file descriptor or -1
+ */
+int qemu_plugin_trace_fd(struct qemu_plugin_trace *trace,
+                         unsigned int vcpu_index);
+
+/**
+ * qemu_plugin_trace_drain() - pass the pending records to the callback
+ * @trace: the trace, which must have a drain callback
+ * @vcpu_index: index of the vCPU
+ *
+ * Must not race with the vCPU filling the ring, e.g. call it from the
+ * vCPU exit callback or from the atexit callback.
+ */
+void qemu_plugin_trace_drain(struct qemu_plugin_trace *trace,
+                             unsigned int vcpu_index);
+
+/**
+ * qemu_plugin_register_vcpu_insn_exec_trace() - trace an instruction
+ * @insn: the opaque qemu_plugin_insn handle for an instruction
+ * @trace: the trace
+ *
+ * Append a QEMU_PLUGIN_TRACE_INSN record to @trace each time @insn is
+ * executed.
+ */
+void qemu_plugin_register_vcpu_insn_exec_trace(struct qemu_plugin_insn *insn,
+                                               struct qemu_plugin_trace *trace);
+
+/**
+ * qemu_plugin_register_vcpu_mem_trace() - trace memory accesses
+ * @insn: the opaque qemu_plugin_insn handle for an instruction
+ * @rw: monitor reads, writes or both
+ * @trace: the trace
+ *
+ * Append a QEMU_PLUGIN_TRACE_MEM record to @trace for each access of
+ * @insn that matches @rw.
+ */
+void qemu_plugin_register_vcpu_mem_trace(struct qemu_plugin_insn *insn,
+                                         enum qemu_plugin_mem_rw rw,
+                                         struct qemu_plugin_trace *trace);
+
 
 
 typedef void
@@ -515,6 +827,33 @@ void
 qemu_plugin_register_vcpu_syscall_ret_cb(qemu_plugin_id_t id,
                                          qemu_plugin_vcpu_syscall_ret_cb_t cb);
 
+/**
+ * typedef qemu_plugin_vcpu_sample_cb_t - vCPU sampling callback
+ * @id: plugin ID
+ * @vcpu_index: the sampled vCPU
+ * @pc: guest virtual address of the next instruction to execute
+ */
+typedef void
+(*qemu_plugin_vcpu_sample_cb_t)(qemu_plugin_id_t id, unsigned int vcpu_index,
+                                uint64_t pc);
+
+/**
+ * qemu_plugin_register_vcpu_sample_cb() - sample running vCPUs periodically
+ * @id: plugin ID
+ * @period_ns: sampling period in host nanoseconds
+ * @cb: callback function
+ *
+ * Every @period_ns, each vCPU that is executing guest code is interrupted
+ * at the next translation block boundary and @cb is called from its thread.
+ * Unlike instrumentation callbacks this adds no cost to generated code, so
+ * it is suited to statistical profiling of long-running guests. Halted
+ * vCPUs are not sampled. If several plugins ask for different periods the
+ * shortest one is used for all of them.
+ */
+void qemu_plugin_register_vcpu_sample_cb(qemu_plugin_id_t id,
+                                         uint64_t period_ns,
+                                         qemu_plugin_vcpu_sample_cb_t cb);
+
 
 /**
  * qemu_plugin_insn_disas() - return disassembly string for instruction
@@ -525,6 +864,16 @@ qemu_plugin_register_vcpu_syscall_ret_cb(qemu_plugin_id_t id,
 
 char *qemu_plugin_insn_disas(const struct qemu_plugin_insn *insn);
 
+/**
+ * qemu_plugin_insn_symbol() - best effort symbol lookup
+ * @insn: instruction reference
+ *
+ * Return a static string referring to the symbol that contains the
+ * instruction, or NULL if there is none. This is dependent on the
+ * binary QEMU is running having provided a symbol table.
+ */
+const char *qemu_plugin_insn_symbol(const struct qemu_plugin_insn *insn);
+
 /**
  * qemu_plugin_vcpu_for_each() - iterate over the existing vCPU
  * @id: plugin ID
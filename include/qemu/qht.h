@@ -18,6 +18,7 @@ struct qht {
     qht_cmp_func_t cmp;
     QemuMutex lock; /* serializes setters of ht->map */
     unsigned int mode;
+    size_t n_resizes; /* protected by lock */
 };
 
 /**
@@ -29,6 +30,8 @@ struct qht {
  *         chain, excluding empty chains.
  * @occupancy: frequency distribution representing chain occupancy rate.
  *             Valid range: from 0.0 (empty) to 1.0 (full occupancy).
+ * @resizes: number of times the QHT has been resized, including automatic
+ *           resizes.
  *
  * An entry is a pointer-hash pair.
  * Each bucket can host several entries.
@@ -40,6 +43,7 @@ struct qht_stats {
     size_t entries;
     struct qdist chain;
     struct qdist occupancy;
+    size_t resizes;
 };
 
 typedef bool (*qht_lookup_func_t)(const void *obj, const void *userp);
@@ -19,8 +19,23 @@ enum QSPSortBy {
 void qsp_report(size_t max, enum QSPSortBy sort_by,
                 bool callsite_coalesce);
 
+/*
+ * Called for each row of the report, in order.  @obj is NULL when
+ * @n_objs objects sharing the call site were coalesced.
+ */
+typedef void QSPReportFunc(void *opaque, const char *type, const void *obj,
+                           unsigned int n_objs, const char *callsite,
+                           uint64_t wait_ns, uint64_t count);
+void qsp_report_foreach(size_t max, enum QSPSortBy sort_by,
+                        bool callsite_coalesce, QSPReportFunc *func,
+                        void *opaque);
+
 bool qsp_is_enabled(void);
+/* 1 in how many lock acquisitions are sampled; 0 if not sampling */
+unsigned int qsp_sampling_period(void);
 void qsp_enable(void);
+/* Only profile contended mutexes, in one in @period acquisitions */
+void qsp_enable_sampling(unsigned int period);
 void qsp_disable(void);
 void qsp_reset(void);
 
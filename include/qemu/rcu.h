@@ -135,6 +135,15 @@ struct rcu_head {
 extern void call_rcu1(struct rcu_head *head, RCUCBFunc *func);
 extern void drain_call_rcu(void);
 
+typedef struct RCUStats {
+    uint64_t pending;           /* callbacks waiting for a grace period */
+    uint64_t pending_max;       /* largest batch run by the call_rcu thread */
+    uint64_t callbacks;         /* callbacks run */
+    uint64_t grace_periods;     /* synchronize_rcu() calls that had readers */
+} RCUStats;
+
+extern void rcu_get_stats(RCUStats *stats);
+
 /* The operands of the minus operator must have the same type,
  * which must be the one that we specify in the cast.
  */
@@ -152,6 +152,11 @@ bool throttle_schedule_timer(ThrottleState *ts,
                              bool is_write);
 
 void throttle_account(ThrottleState *ts, bool is_write, uint64_t size);
+void throttle_account_units(ThrottleState *ts, bool is_write, double size,
+                            double units);
+double throttle_op_units(uint64_t op_size, uint64_t size);
+void throttle_get_headroom(ThrottleState *ts, QEMUClockType clock_type,
+                           bool is_write, double *size, double *units);
 void throttle_limits_to_config(ThrottleLimits *arg, ThrottleConfig *cfg,
                                Error **errp);
 void throttle_config_to_limits(ThrottleConfig *cfg, ThrottleLimits *var);
@@ -87,6 +87,8 @@ struct QEMUTimer {
     QEMUTimerCB *cb;
     void *opaque;
     QEMUTimer *next;
+    uint64_t seq;               /* orders timers with equal expire_time */
+    size_t heap_index;          /* in the active timers heap if pending */
     int attributes;
     int scale;
 };
@@ -25,6 +25,7 @@ typedef struct VuFdWatch {
     int fd; /*kick fd*/
     void *pvt;
     vu_watch_cb cb;
+    AioContext *ctx; /* NULL if monitored in VuServer->ctx */
     QTAILQ_ENTRY(VuFdWatch) next;
 } VuFdWatch;
 
@@ -48,6 +49,18 @@ typedef struct {
     QTAILQ_HEAD(, VuFdWatch) vu_fd_watches;
 
     Coroutine *co_trip; /* coroutine for processing VhostUserMsg */
+
+    /*
+     * Virtqueue i is processed in vq_ctx[i % nb_vq_ctx] instead of ctx if
+     * nb_vq_ctx is not zero, see vhost_user_server_set_queue_contexts().
+     */
+    AioContext **vq_ctx;
+    int nb_vq_ctx;
+
+    /* Kick handlers and requests in progress, accessed atomically */
+    unsigned in_flight;
+    bool queues_paused;
+    Coroutine *pause_co;
 } VuServer;
 
 bool vhost_user_server_start(VuServer *server,
@@ -59,6 +72,11 @@ bool vhost_user_server_start(VuServer *server,
 
 void vhost_user_server_stop(VuServer *server);
 
+void vhost_user_server_set_queue_contexts(VuServer *server,
+                                          AioContext **ctxs, int n);
+void vhost_user_server_inc_in_flight(VuServer *server);
+void vhost_user_server_dec_in_flight(VuServer *server);
+
 void vhost_user_server_attach_aio_context(VuServer *server, AioContext *ctx);
 void vhost_user_server_detach_aio_context(VuServer *server);
 
@@ -138,6 +138,12 @@ typedef struct CryptoDevBackendSymOpInfo {
     uint8_t data[];
 } CryptoDevBackendSymOpInfo;
 
+/*
+ * Called when an asynchronous operation completes, with
+ * VIRTIO_CRYPTO_OK or -VIRTIO_CRYPTO_* in @ret
+ */
+typedef void CryptoDevCompletionFunc(void *opaque, int ret);
+
 struct CryptoDevBackendClass {
     ObjectClass parent_class;
 
@@ -153,6 +159,14 @@ struct CryptoDevBackendClass {
     int (*do_sym_op)(CryptoDevBackend *backend,
                      CryptoDevBackendSymOpInfo *op_info,
                      uint32_t queue_index, Error **errp);
+    /*
+     * Optional.  Like do_sym_op, but may complete later; @cb is
+     * called exactly once, possibly before do_sym_op_async returns.
+     */
+    void (*do_sym_op_async)(CryptoDevBackend *backend,
+                            CryptoDevBackendSymOpInfo *op_info,
+                            uint32_t queue_index,
+                            CryptoDevCompletionFunc *cb, void *opaque);
 };
 
 typedef enum CryptoDevBackendOptionsType {
@@ -297,6 +311,26 @@ int cryptodev_backend_crypto_operation(
                  void *opaque,
                  uint32_t queue_index, Error **errp);
 
+/**
+ * cryptodev_backend_crypto_operation_async:
+ * @backend: the cryptodev backend object
+ * @opaque: pointer to a VirtIOCryptoReq object
+ * @queue_index: queue index of cryptodev backend client
+ * @cb: the function to call with the result
+ * @cb_opaque: the opaque pointer to pass to @cb
+ *
+ * Like cryptodev_backend_crypto_operation(), but lets backends
+ * that support it do the work in the background.  @cb is called
+ * exactly once, with VIRTIO_CRYPTO_OK or -VIRTIO_CRYPTO_*, in the
+ * main loop.  It may be called before this function returns.
+ * Errors are reported by the backend.
+ */
+void cryptodev_backend_crypto_operation_async(
+                 CryptoDevBackend *backend,
+                 void *opaque,
+                 uint32_t queue_index,
+                 CryptoDevCompletionFunc *cb, void *cb_opaque);
+
 /**
  * cryptodev_backend_set_used:
  * @backend: the cryptodev backend object
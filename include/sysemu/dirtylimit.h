@@ -0,0 +1,46 @@
+/*
+ * Per-vCPU dirty page rate limit
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#ifndef QEMU_DIRTYLIMIT_H
+#define QEMU_DIRTYLIMIT_H
+
+/**
+ * dirtylimit_set_quota:
+ * @quota: the dirty page rate limit for each vCPU, in MB/s, or 0 to stop
+ *
+ * Throttle the vCPUs that dirty memory faster than @quota, leaving the
+ * others alone.  This relies on the KVM dirty ring: every time the ring
+ * of a vCPU fills up, the vCPU sleeps long enough to bring its own dirty
+ * rate down to @quota.
+ */
+void dirtylimit_set_quota(uint64_t quota);
+
+/**
+ * dirtylimit_in_service:
+ *
+ * Returns: %true if a dirty page rate limit is currently applied.
+ */
+bool dirtylimit_in_service(void);
+
+/**
+ * dirtylimit_vcpu_execute:
+ * @cpu: the vCPU whose dirty ring just filled up
+ *
+ * Called by the vCPU thread, without the BQL, after its dirty ring was
+ * collected.  Sleeps for as long as needed to stay within the quota.
+ */
+void dirtylimit_vcpu_execute(CPUState *cpu);
+
+/**
+ * dirtylimit_throttle_time_max:
+ *
+ * Returns: the longest time in microseconds that a vCPU currently sleeps
+ * each time its dirty ring fills up.
+ */
+uint64_t dirtylimit_throttle_time_max(void);
+
+#endif
@@ -85,8 +85,8 @@ static inline MemTxResult dma_memory_rw_relaxed(AddressSpace *as,
                                                 void *buf, dma_addr_t len,
                                                 DMADirection dir)
 {
-    return address_space_rw(as, addr, MEMTXATTRS_UNSPECIFIED,
-                            buf, len, dir == DMA_DIRECTION_FROM_DEVICE);
+    return address_space_rw_xlat_cached(as, addr, MEMTXATTRS_UNSPECIFIED, buf,
+                                        len, dir == DMA_DIRECTION_FROM_DEVICE);
 }
 
 static inline MemTxResult dma_memory_read_relaxed(AddressSpace *as,
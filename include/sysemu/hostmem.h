@@ -80,4 +80,18 @@ bool host_memory_backend_is_mapped(HostMemoryBackend *backend);
 size_t host_memory_backend_pagesize(HostMemoryBackend *memdev);
 char *host_memory_backend_get_name(HostMemoryBackend *backend);
 
+/**
+ * host_memory_backend_prealloc_range:
+ * @backend: the memory backend
+ * @offset: start of the range within @backend
+ * @size: size of the range
+ * @errp: pointer to a NULL-initialized error object
+ *
+ * Preallocate part of @backend, independently of its "prealloc" property,
+ * using its "prealloc-threads" and host NUMA binding.
+ */
+void host_memory_backend_prealloc_range(HostMemoryBackend *backend,
+                                        uint64_t offset, uint64_t size,
+                                        Error **errp);
+
 #endif
@@ -37,6 +37,19 @@ struct IOThread {
     int64_t poll_max_ns;
     int64_t poll_grow;
     int64_t poll_shrink;
+
+    /* AioContext thread pool parameters */
+    int64_t thread_pool_max;
+
+    /*
+     * Placement and scheduling, applied by the thread itself when it
+     * starts, and inherited by the thread pool workers it creates
+     */
+    char *cpu_affinity;
+    int64_t numa_node;          /* -1 if unset */
+    int sched_policy;           /* IothreadSchedPolicy, -1 if unset */
+    int64_t sched_priority;
+    Error *init_error;
 };
 typedef struct IOThread IOThread;
 
@@ -213,6 +213,7 @@ typedef struct Notifier Notifier;
 
 bool kvm_has_free_slot(MachineState *ms);
 bool kvm_has_sync_mmu(void);
+bool kvm_dirty_ring_enabled(void);
 int kvm_has_vcpu_events(void);
 int kvm_has_robust_singlestep(void);
 int kvm_has_debugregs(void);
@@ -481,6 +482,29 @@ int kvm_irqchip_update_msi_route(KVMState *s, int virq, MSIMessage msg,
 void kvm_irqchip_commit_routes(KVMState *s);
 void kvm_irqchip_release_virq(KVMState *s, int virq);
 
+/**
+ * kvm_irqchip_begin_route_changes:
+ * kvm_irqchip_end_route_changes:
+ * @s: KVM state
+ *
+ * Route changes committed between these calls are pushed to KVM once, by
+ * the outermost kvm_irqchip_end_route_changes().  Use them around loops
+ * that update many MSI vectors.  Assigning an irqfd in between pushes the
+ * pending changes first.
+ */
+void kvm_irqchip_begin_route_changes(KVMState *s);
+void kvm_irqchip_end_route_changes(KVMState *s);
+
+/**
+ * kvm_irqchip_sync_routes:
+ * @s: KVM state
+ *
+ * Push route changes deferred by kvm_irqchip_begin_route_changes() now,
+ * e.g. before raising an interrupt through an irqfd whose route was just
+ * updated.
+ */
+void kvm_irqchip_sync_routes(KVMState *s);
+
 int kvm_irqchip_add_adapter_route(KVMState *s, AdapterInfo *adapter);
 int kvm_irqchip_add_hv_sint_route(KVMState *s, uint32_t vcpu, uint32_t sint);
 
@@ -38,6 +38,10 @@
 #include <sys/sysmacros.h>
 #endif
 
+#ifdef CONFIG_LINUX
+#include <sched.h>
+#endif
+
 void os_set_line_buffering(void);
 void os_set_proc_name(const char *s);
 void os_setup_signal_handling(void);
@@ -53,6 +57,27 @@ typedef struct timeval qemu_timeval;
 
 bool is_daemonized(void);
 
+#ifdef CONFIG_LINUX
+/**
+ * qemu_cpu_list_parse:
+ * @list: a list of CPUs and CPU ranges, such as "0-3,8", optionally followed
+ *        by a newline as in sysfs
+ * @cpus: the set to add the CPUs to
+ *
+ * Returns: false if @list is malformed.
+ */
+bool qemu_cpu_list_parse(const char *list, cpu_set_t *cpus);
+
+/**
+ * qemu_host_node_cpus:
+ * @node: a host NUMA node
+ * @cpus: the set to add the CPUs of @node to
+ *
+ * Returns: false if the CPUs of @node cannot be determined.
+ */
+bool qemu_host_node_cpus(unsigned long node, cpu_set_t *cpus);
+#endif
+
 /**
  * qemu_alloc_stack:
  * @sz: pointer to a size_t holding the requested usable stack size
@@ -279,6 +279,13 @@ DEF(last_generic, 0, 0, 0, TCG_OPF_NOT_PRESENT)
 /* These opcodes are only for use between the tci generator and interpreter. */
 DEF(tci_movi_i32, 1, 0, 1, TCG_OPF_NOT_PRESENT)
 DEF(tci_movi_i64, 1, 0, 1, TCG_OPF_64BIT | TCG_OPF_NOT_PRESENT)
+/* Fused forms of a tci_movi followed by the corresponding opcode. */
+DEF(tci_addi_i32, 1, 1, 1, TCG_OPF_NOT_PRESENT)
+DEF(tci_addi_i64, 1, 1, 1, TCG_OPF_64BIT | TCG_OPF_NOT_PRESENT)
+DEF(tci_andi_i32, 1, 1, 1, TCG_OPF_NOT_PRESENT)
+DEF(tci_andi_i64, 1, 1, 1, TCG_OPF_64BIT | TCG_OPF_NOT_PRESENT)
+DEF(tci_brcondi_i32, 0, 1, 3, TCG_OPF_NOT_PRESENT)
+DEF(tci_brcondi_i64, 0, 1, 3, TCG_OPF_64BIT | TCG_OPF_NOT_PRESENT)
 #endif
 
 #undef TLADDR_ARGS
@@ -597,6 +597,7 @@ struct TCGContext {
     int nb_temps;
     int nb_indirects;
     int nb_ops;
+    int nb_spills;      /* registers spilled by tcg_reg_free() */
 
     /* goto_tb support */
     tcg_insn_unit *code_buf;
@@ -877,6 +878,7 @@ TranslationBlock *tcg_tb_alloc(TCGContext *s);
 void tcg_region_init(void);
 void tb_destroy(TranslationBlock *tb);
 void tcg_region_reset_all(void);
+size_t tcg_region_evict(void (*invalidate)(TranslationBlock *));
 
 size_t tcg_code_size(void);
 size_t tcg_code_capacity(void);
@@ -17,9 +17,11 @@
 #include "qemu/module.h"
 #include "block/aio.h"
 #include "block/block.h"
+#include "block/thread-pool.h"
 #include "sysemu/iothread.h"
 #include "qapi/error.h"
 #include "qapi/qapi-commands-misc.h"
+#include "qapi/qapi-types-qom.h"
 #include "qemu/error-report.h"
 #include "qemu/rcu.h"
 #include "qemu/main-loop.h"
@@ -41,6 +43,48 @@ DECLARE_CLASS_CHECKERS(IOThreadClass, IOTHREAD,
 
 static __thread IOThread *my_iothread;
 
+#ifdef CONFIG_LINUX
+static const int iothread_sched_policies[IOTHREAD_SCHED_POLICY__MAX] = {
+    [IOTHREAD_SCHED_POLICY_OTHER] = SCHED_OTHER,
+    [IOTHREAD_SCHED_POLICY_BATCH] = SCHED_BATCH,
+    [IOTHREAD_SCHED_POLICY_IDLE] = SCHED_IDLE,
+    [IOTHREAD_SCHED_POLICY_FIFO] = SCHED_FIFO,
+    [IOTHREAD_SCHED_POLICY_RR] = SCHED_RR,
+};
+
+/* Runs in iothread_run() thread, before it creates any other thread */
+static void iothread_set_sched_params(IOThread *iothread, Error **errp)
+{
+    struct sched_param param = {
+        .sched_priority = iothread->sched_priority,
+    };
+    cpu_set_t cpus;
+
+    CPU_ZERO(&cpus);
+    if (iothread->cpu_affinity) {
+        /* Already validated by the property setter */
+        qemu_cpu_list_parse(iothread->cpu_affinity, &cpus);
+    }
+    if (iothread->numa_node >= 0 &&
+        !qemu_host_node_cpus(iothread->numa_node, &cpus)) {
+        error_setg(errp, "Cannot find the CPUs of host NUMA node %" PRId64,
+                   iothread->numa_node);
+        return;
+    }
+    if (CPU_COUNT(&cpus) && sched_setaffinity(0, sizeof(cpus), &cpus)) {
+        error_setg_errno(errp, errno, "Cannot set CPU affinity");
+        return;
+    }
+
+    if (iothread->sched_policy >= 0 &&
+        sched_setscheduler(0, iothread_sched_policies[iothread->sched_policy],
+                           &param)) {
+        error_setg_errno(errp, errno, "Cannot set scheduling policy %s",
+                         IothreadSchedPolicy_str(iothread->sched_policy));
+    }
+}
+#endif
+
 AioContext *qemu_get_current_aio_context(void)
 {
     return my_iothread ? my_iothread->ctx : qemu_get_aio_context();
@@ -57,6 +101,9 @@ static void *iothread_run(void *opaque)
      */
     g_main_context_push_thread_default(iothread->worker_context);
     my_iothread = iothread;
+#ifdef CONFIG_LINUX
+    iothread_set_sched_params(iothread, &iothread->init_error);
+#endif
     iothread->thread_id = qemu_get_thread_id();
     qemu_sem_post(&iothread->init_done_sem);
 
@@ -113,6 +160,9 @@ static void iothread_instance_init(Object *obj)
     IOThread *iothread = IOTHREAD(obj);
 
     iothread->poll_max_ns = IOTHREAD_POLL_MAX_NS_DEFAULT;
+    iothread->thread_pool_max = THREAD_POOL_MAX_THREADS_DEFAULT;
+    iothread->numa_node = -1;
+    iothread->sched_policy = -1;
     iothread->thread_id = -1;
     qemu_sem_init(&iothread->init_done_sem, 0);
     /* By default, we don't run gcontext */
@@ -146,6 +196,8 @@ static void iothread_instance_finalize(Object *obj)
         iothread->main_loop = NULL;
     }
     qemu_sem_destroy(&iothread->init_done_sem);
+    error_free(iothread->init_error);
+    g_free(iothread->cpu_affinity);
 }
 
 static void iothread_init_gcontext(IOThread *iothread)
@@ -165,6 +217,20 @@ static void iothread_complete(UserCreatable *obj, Error **errp)
     IOThread *iothread = IOTHREAD(obj);
     char *thread_name;
 
+#ifndef CONFIG_LINUX
+    if (iothread->cpu_affinity || iothread->numa_node >= 0 ||
+        iothread->sched_policy >= 0) {
+        error_setg(errp, "CPU affinity and scheduling policy of iothreads "
+                   "are not supported by this host");
+        return;
+    }
+#endif
+    if (iothread->cpu_affinity && iothread->numa_node >= 0) {
+        error_setg(errp, "'cpu-affinity' and 'numa-node' are mutually "
+                   "exclusive");
+        return;
+    }
+
     iothread->stopping = false;
     iothread->running = true;
     iothread->ctx = aio_context_new(errp);
@@ -183,6 +249,11 @@ static void iothread_complete(UserCreatable *obj, Error **errp)
                                 iothread->poll_grow,
                                 iothread->poll_shrink,
                                 &local_error);
+    if (!local_error) {
+        aio_context_set_thread_pool_params(iothread->ctx,
+                                           iothread->thread_pool_max,
+                                           &local_error);
+    }
     if (local_error) {
         error_propagate(errp, local_error);
         aio_context_unref(iothread->ctx);
@@ -203,6 +274,12 @@ static void iothread_complete(UserCreatable *obj, Error **errp)
     while (iothread->thread_id == -1) {
         qemu_sem_wait(&iothread->init_done_sem);
     }
+
+    /* The thread is stopped by iothread_instance_finalize() */
+    if (iothread->init_error) {
+        error_propagate(errp, iothread->init_error);
+        iothread->init_error = NULL;
+    }
 }
 
 typedef struct {
@@ -259,6 +336,121 @@ static void iothread_set_poll_param(Object *obj, Visitor *v,
     }
 }
 
+static void iothread_get_thread_pool_max(Object *obj, Visitor *v,
+        const char *name, void *opaque, Error **errp)
+{
+    IOThread *iothread = IOTHREAD(obj);
+
+    visit_type_int64(v, name, &iothread->thread_pool_max, errp);
+}
+
+static void iothread_set_thread_pool_max(Object *obj, Visitor *v,
+        const char *name, void *opaque, Error **errp)
+{
+    IOThread *iothread = IOTHREAD(obj);
+    int64_t value;
+
+    if (!visit_type_int64(v, name, &value, errp)) {
+        return;
+    }
+
+    if (value <= 0 || value > INT_MAX) {
+        error_setg(errp, "%s value must be in range [1, %d]", name, INT_MAX);
+        return;
+    }
+
+    iothread->thread_pool_max = value;
+
+    if (iothread->ctx) {
+        aio_context_set_thread_pool_params(iothread->ctx, value, errp);
+    }
+}
+
+static bool iothread_check_not_started(IOThread *iothread, const char *name,
+                                       Error **errp)
+{
+    if (iothread->ctx) {
+        error_setg(errp, "'%s' cannot be changed once the iothread runs",
+                   name);
+        return false;
+    }
+    return true;
+}
+
+static char *iothread_get_cpu_affinity(Object *obj, Error **errp)
+{
+    IOThread *iothread = IOTHREAD(obj);
+
+    return g_strdup(iothread->cpu_affinity);
+}
+
+static void iothread_set_cpu_affinity(Object *obj, const char *value,
+                                      Error **errp)
+{
+    IOThread *iothread = IOTHREAD(obj);
+
+    if (!iothread_check_not_started(iothread, "cpu-affinity", errp)) {
+        return;
+    }
+#ifdef CONFIG_LINUX
+    {
+        cpu_set_t cpus;
+
+        CPU_ZERO(&cpus);
+        if (!qemu_cpu_list_parse(value, &cpus) || !CPU_COUNT(&cpus)) {
+            error_setg(errp, "Invalid CPU list '%s'", value);
+            return;
+        }
+    }
+#endif
+    g_free(iothread->cpu_affinity);
+    iothread->cpu_affinity = g_strdup(value);
+}
+
+static void iothread_get_sched_param(Object *obj, Visitor *v,
+        const char *name, void *opaque, Error **errp)
+{
+    IOThread *iothread = IOTHREAD(obj);
+    int64_t *field = (void *)iothread + (ptrdiff_t)opaque;
+
+    visit_type_int64(v, name, field, errp);
+}
+
+static void iothread_set_sched_param(Object *obj, Visitor *v,
+        const char *name, void *opaque, Error **errp)
+{
+    IOThread *iothread = IOTHREAD(obj);
+    int64_t *field = (void *)iothread + (ptrdiff_t)opaque;
+    int64_t value;
+
+    if (!iothread_check_not_started(iothread, name, errp) ||
+        !visit_type_int64(v, name, &value, errp)) {
+        return;
+    }
+    if (value < -1 || value > INT_MAX) {
+        error_setg(errp, "%s value must be in range [-1, %d]", name, INT_MAX);
+        return;
+    }
+    *field = value;
+}
+
+static int iothread_get_sched_policy(Object *obj, Error **errp)
+{
+    IOThread *iothread = IOTHREAD(obj);
+
+    /* Report the default policy of new threads when unset */
+    return MAX(iothread->sched_policy, IOTHREAD_SCHED_POLICY_OTHER);
+}
+
+static void iothread_set_sched_policy(Object *obj, int value, Error **errp)
+{
+    IOThread *iothread = IOTHREAD(obj);
+
+    if (iothread_check_not_started(iothread, "sched-policy", errp)) {
+        iothread->sched_policy = value;
+    }
+}
+
 static void iothread_class_init(ObjectClass *klass, void *class_data)
 {
     UserCreatableClass *ucc = USER_CREATABLE_CLASS(klass);
@@ -276,6 +468,26 @@ static void iothread_class_init(ObjectClass *klass, void *class_data)
                               iothread_get_poll_param,
                               iothread_set_poll_param,
                               NULL, &poll_shrink_info);
+    object_class_property_add(klass, "thread-pool-max", "int",
+                              iothread_get_thread_pool_max,
+                              iothread_set_thread_pool_max,
+                              NULL, NULL);
+    object_class_property_add_str(klass, "cpu-affinity",
+                                  iothread_get_cpu_affinity,
+                                  iothread_set_cpu_affinity);
+    object_class_property_add(klass, "numa-node", "int",
+                              iothread_get_sched_param,
+                              iothread_set_sched_param, NULL,
+                              (void *)offsetof(IOThread, numa_node));
+    object_class_property_add_enum(klass, "sched-policy",
+                                   "IothreadSchedPolicy",
+                                   &IothreadSchedPolicy_lookup,
+                                   iothread_get_sched_policy,
+                                   iothread_set_sched_policy);
+    object_class_property_add(klass, "sched-priority", "int",
+                              iothread_get_sched_param,
+                              iothread_set_sched_param, NULL,
+                              (void *)offsetof(IOThread, sched_priority));
 }
 
 static const TypeInfo iothread_info = {
@@ -64,6 +64,8 @@ static envlist_t *envlist;
 static const char *cpu_model;
 static const char *cpu_type;
 static const char *seed_optarg;
+static const char *zygote_path;
+static const char *zygote_server_path;
 unsigned long mmap_min_addr;
 uintptr_t guest_base;
 bool have_guest_base;
@@ -406,6 +408,16 @@ static void handle_arg_abi_call0(const char *arg)
 }
 #endif
 
+static void handle_arg_zygote(const char *arg)
+{
+    zygote_path = arg;
+}
+
+static void handle_arg_zygote_server(const char *arg)
+{
+    zygote_server_path = arg;
+}
+
 static QemuPluginList plugins = QTAILQ_HEAD_INITIALIZER(plugins);
 
 #ifdef CONFIG_PLUGIN
@@ -470,6 +482,10 @@ static const struct qemu_argument arg_table[] = {
     {"plugin",     "QEMU_PLUGIN",      true,  handle_arg_plugin,
      "",           "[file=]<file>[,arg=<string>]"},
 #endif
+    {"zygote",     "QEMU_ZYGOTE",      true,  handle_arg_zygote,
+     "path",       "run the program in the zygote server at 'path', if any"},
+    {"zygote-server", "QEMU_ZYGOTE_SERVER", true, handle_arg_zygote_server,
+     "path",       "listen on 'path' and run programs for zygote clients"},
     {"version",    "QEMU_VERSION",     false, handle_arg_version,
      "",           "display version information and exit"},
 #if defined(TARGET_XTENSA)
@@ -611,6 +627,9 @@ static int parse_args(int argc, char **argv)
         }
     }
 
+    if (optind >= argc && zygote_server_path) {
+        return optind;
+    }
     if (optind >= argc) {
         (void) fprintf(stderr, "qemu: no user program specified\n");
         exit(EXIT_FAILURE);
@@ -621,6 +640,34 @@ static int parse_args(int argc, char **argv)
     return optind;
 }
 
+/*
+ * Prepare copy of argv vector for target.
+ *
+ * If argv0 is specified (using '-0' switch) we replace
+ * argv[0] pointer with the given one.
+ */
+static char **build_target_argv(int target_argc, char **argv)
+{
+    char **target_argv;
+    int i;
+
+    target_argv = calloc(target_argc + 1, sizeof (char *));
+    if (target_argv == NULL) {
+        (void) fprintf(stderr, "Unable to allocate memory for target_argv\n");
+        exit(EXIT_FAILURE);
+    }
+
+    i = 0;
+    if (argv0 != NULL) {
+        target_argv[i++] = strdup(argv0);
+    }
+    for (; i < target_argc; i++) {
+        target_argv[i] = strdup(argv[i]);
+    }
+    target_argv[target_argc] = NULL;
+    return target_argv;
+}
+
 int main(int argc, char **argv, char **envp)
 {
     struct target_pt_regs regs1, *regs = &regs1;
@@ -631,11 +678,9 @@ int main(int argc, char **argv, char **envp)
     CPUState *cpu;
     int optind;
     char **target_environ, **wrk;
-    char **target_argv;
-    int target_argc;
-    int i;
+    char **target_argv = NULL;
     int ret;
-    int execfd;
+    int execfd = 0;
     int log_mask;
     unsigned long max_reserved_va;
     bool preserve_argv0;
@@ -670,6 +715,41 @@ int main(int argc, char **argv, char **envp)
 
     optind = parse_args(argc, argv);
 
+    if (!zygote_server_path) {
+        /*
+         * Manage binfmt-misc open-binary flag
+         */
+        execfd = qemu_getauxval(AT_EXECFD);
+
+        /*
+         * get binfmt_misc flags
+         */
+        preserve_argv0 = !!(qemu_getauxval(AT_FLAGS) &
+                            AT_FLAGS_PRESERVE_ARGV0);
+
+        /*
+         * Manage binfmt-misc preserve-arg[0] flag
+         *    argv[optind]     full path to the binary
+         *    argv[optind + 1] original argv[0]
+         */
+        if (optind + 1 < argc && preserve_argv0) {
+            optind++;
+        }
+
+        target_argv = build_target_argv(argc - optind, argv + optind);
+
+        if (zygote_path) {
+            target_environ = envlist_to_environ(envlist, NULL);
+            zygote_client_run(zygote_path, execfd, exec_path,
+                              target_argv, target_environ);
+            /* No server, run the program ourselves */
+            for (wrk = target_environ; *wrk; wrk++) {
+                g_free(*wrk);
+            }
+            g_free(target_environ);
+        }
+    }
+
     log_mask = last_log_mask | (enable_strace ? LOG_STRACE : 0);
     if (log_mask) {
         qemu_log_needs_buffers();
@@ -696,67 +776,15 @@ int main(int argc, char **argv, char **envp)
     init_qemu_uname_release();
 
     /*
-     * Manage binfmt-misc open-binary flag
-     */
-    execfd = qemu_getauxval(AT_EXECFD);
-    if (execfd == 0) {
-        execfd = open(exec_path, O_RDONLY);
-        if (execfd < 0) {
-            printf("Error while loading %s: %s\n", exec_path, strerror(errno));
-            _exit(EXIT_FAILURE);
-        }
-    }
-
-    /*
-     * get binfmt_misc flags
+     * init tcg before creating CPUs and to get qemu_host_page_size.
+     * This does not depend on the program, so a zygote does it once.
      */
-    preserve_argv0 = !!(qemu_getauxval(AT_FLAGS) & AT_FLAGS_PRESERVE_ARGV0);
-
-    /*
-     * Manage binfmt-misc preserve-arg[0] flag
-     *    argv[optind]     full path to the binary
-     *    argv[optind + 1] original argv[0]
-     */
-    if (optind + 1 < argc && preserve_argv0) {
-        optind++;
-    }
-
-    if (cpu_model == NULL) {
-        cpu_model = cpu_get_model(get_elf_eflags(execfd));
-    }
-    cpu_type = parse_cpu_option(cpu_model);
-
-    /* init tcg before creating CPUs and to get qemu_host_page_size */
     {
         AccelClass *ac = ACCEL_GET_CLASS(current_accel());
 
         ac->init_machine(NULL);
         accel_init_interfaces(ac);
     }
-    cpu = cpu_create(cpu_type);
-    env = cpu->env_ptr;
-    cpu_reset(cpu);
-    thread_cpu = cpu;
-
-    /*
-     * Reserving too much vm space via mmap can run into problems
-     * with rlimits, oom due to page table creation, etc.  We will
-     * still try it, if directed by the command-line option, but
-     * not by default.
-     */
-    max_reserved_va = MAX_RESERVED_VA(cpu);
-    if (reserved_va != 0) {
-        if (max_reserved_va && reserved_va > max_reserved_va) {
-            fprintf(stderr, "Reserved virtual address too big\n");
-            exit(EXIT_FAILURE);
-        }
-    } else if (HOST_LONG_BITS == 64 && TARGET_VIRT_ADDR_SPACE_BITS <= 32) {
-        /*
-         * reserved_va must be aligned with the host page size
-         * as it is used with mmap()
-         */
-        reserved_va = max_reserved_va & qemu_host_page_mask;
-    }
 
     {
         Error *err = NULL;
@@ -771,9 +799,6 @@ int main(int argc, char **argv, char **envp)
         }
     }
 
-    target_environ = envlist_to_environ(envlist, NULL);
-    envlist_free(envlist);
-
     /*
      * Read in mmap_min_addr kernel parameter.  This value is used
      * When loading the ELF image to determine whether guest_base
@@ -804,28 +829,63 @@ int main(int argc, char **argv, char **envp)
                       mmap_min_addr);
     }
 
-    /*
-     * Prepare copy of argv vector for target.
-     */
-    target_argc = argc - optind;
-    target_argv = calloc(target_argc + 1, sizeof (char *));
-    if (target_argv == NULL) {
-        (void) fprintf(stderr, "Unable to allocate memory for target_argv\n");
-        exit(EXIT_FAILURE);
+    if (zygote_server_path) {
+        ZygoteRequest req;
+
+        /* Returns in a new process, for each client */
+        zygote_server_run(zygote_server_path, &req);
+
+        exec_path = req.exec_path;
+        execfd = req.execfd;
+        target_argv = req.argv;
+        envlist_free(envlist);
+        envlist = envlist_create();
+        for (wrk = req.envp; *wrk != NULL; wrk++) {
+            (void) envlist_setenv(envlist, *wrk);
+        }
+        (void) envlist_unsetenv(envlist, "QEMU_ZYGOTE_SERVER");
     }
 
+    if (execfd == 0) {
+        execfd = open(exec_path, O_RDONLY);
+        if (execfd < 0) {
+            printf("Error while loading %s: %s\n", exec_path, strerror(errno));
+            _exit(EXIT_FAILURE);
+        }
+    }
+
+    if (cpu_model == NULL) {
+        cpu_model = cpu_get_model(get_elf_eflags(execfd));
+    }
+    cpu_type = parse_cpu_option(cpu_model);
+
+    cpu = cpu_create(cpu_type);
+    env = cpu->env_ptr;
+    cpu_reset(cpu);
+    thread_cpu = cpu;
+
     /*
-     * If argv0 is specified (using '-0' switch) we replace
-     * argv[0] pointer with the given one.
+     * Reserving too much vm space via mmap can run into problems
+     * with rlimits, oom due to page table creation, etc.  We will
+     * still try it, if directed by the command-line option, but
+     * not by default.
      */
-    i = 0;
-    if (argv0 != NULL) {
-        target_argv[i++] = strdup(argv0);
-    }
-    for (; i < target_argc; i++) {
-        target_argv[i] = strdup(argv[optind + i]);
+    max_reserved_va = MAX_RESERVED_VA(cpu);
+    if (reserved_va != 0) {
+        if (max_reserved_va && reserved_va > max_reserved_va) {
+            fprintf(stderr, "Reserved virtual address too big\n");
+            exit(EXIT_FAILURE);
+        }
+    } else if (HOST_LONG_BITS == 64 && TARGET_VIRT_ADDR_SPACE_BITS <= 32) {
+        /*
+         * reserved_va must be aligned with the host page size
+         * as it is used with mmap()
+         */
+        reserved_va = max_reserved_va & qemu_host_page_mask;
     }
-    target_argv[target_argc] = NULL;
+
+    target_environ = envlist_to_environ(envlist, NULL);
+    envlist_free(envlist);
 
     ts = g_new0(TaskState, 1);
     init_task_state(ts);
@@ -21,19 +21,58 @@
 #include "exec/log.h"
 #include "qemu.h"
 
+/*
+ * The mmap lock has two modes.  mmap_lock() takes the whole guest
+ * address space, which is what translation and most other users need.
+ * Changes to the guest memory map that are confined to a known range
+ * take mmap_lock_range() instead, so that threads calling mprotect,
+ * munmap or mmap(MAP_FIXED) on disjoint ranges do not wait for each
+ * other.  In both modes the lock is recursive, and a nested acquisition
+ * keeps the mode of the outermost one.
+ */
+typedef struct MMapRange {
+    abi_ulong start;
+    abi_ulong last;
+    QTAILQ_ENTRY(MMapRange) entry;
+} MMapRange;
+
 static pthread_mutex_t mmap_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t mmap_cond = PTHREAD_COND_INITIALIZER;
+/* ranges currently held, at most one per thread */
+static QTAILQ_HEAD(, MMapRange) mmap_ranges =
+    QTAILQ_HEAD_INITIALIZER(mmap_ranges);
+static bool mmap_exclusive;
+/* Waiting whole-space lockers hold off new ranges, so they don't starve */
+static unsigned int mmap_exclusive_waiters;
 static __thread int mmap_lock_count;
+static __thread MMapRange mmap_range;
+static __thread bool mmap_range_held;
 
 void mmap_lock(void)
 {
     if (mmap_lock_count++ == 0) {
         pthread_mutex_lock(&mmap_mutex);
+        mmap_exclusive_waiters++;
+        while (mmap_exclusive || !QTAILQ_EMPTY(&mmap_ranges)) {
+            pthread_cond_wait(&mmap_cond, &mmap_mutex);
+        }
+        mmap_exclusive_waiters--;
+        mmap_exclusive = true;
+        pthread_mutex_unlock(&mmap_mutex);
     }
 }
 
 void mmap_unlock(void)
 {
     if (--mmap_lock_count == 0) {
+        pthread_mutex_lock(&mmap_mutex);
+        if (mmap_range_held) {
+            QTAILQ_REMOVE(&mmap_ranges, &mmap_range, entry);
+            mmap_range_held = false;
+        } else {
+            mmap_exclusive = false;
+        }
+        pthread_cond_broadcast(&mmap_cond);
         pthread_mutex_unlock(&mmap_mutex);
     }
 }
@@ -43,20 +82,72 @@ bool have_mmap_lock(void)
     return mmap_lock_count > 0 ? true : false;
 }
 
+static bool mmap_range_busy(const MMapRange *r)
+{
+    MMapRange *o;
+
+    QTAILQ_FOREACH(o, &mmap_ranges, entry) {
+        if (r->start <= o->last && o->start <= r->last) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Lock the host pages covering [@start, @start + @len) against other
+ * changes of the memory map.  The range is widened to host pages since
+ * the fragment handling looks at the flags of the neighbouring target
+ * pages.
+ *
+ * Only the exclusive lock may add TBs, so if the range holds no
+ * translated code it will not gain any while we hold it, and nobody
+ * else will touch the TB lists of its pages.  If it does hold code,
+ * invalidating it may touch pages outside the range: fall back to the
+ * exclusive lock.  Nothing has been changed yet, so dropping the range
+ * in between is fine.
+ */
+static void mmap_lock_range(abi_ulong start, abi_ulong len)
+{
+    if (mmap_lock_count++ == 0) {
+        mmap_range.start = start & qemu_host_page_mask;
+        mmap_range.last = HOST_PAGE_ALIGN(start + len) - 1;
+
+        pthread_mutex_lock(&mmap_mutex);
+        while (mmap_exclusive || mmap_exclusive_waiters ||
+               mmap_range_busy(&mmap_range)) {
+            pthread_cond_wait(&mmap_cond, &mmap_mutex);
+        }
+        QTAILQ_INSERT_TAIL(&mmap_ranges, &mmap_range, entry);
+        mmap_range_held = true;
+        pthread_mutex_unlock(&mmap_mutex);
+
+        if (page_range_has_code(mmap_range.start, mmap_range.last + 1)) {
+            mmap_unlock();
+            mmap_lock();
+        }
+    }
+}
+
 /* Grab lock to make sure things are in a consistent state after fork().  */
 void mmap_fork_start(void)
 {
     if (mmap_lock_count)
         abort();
-    pthread_mutex_lock(&mmap_mutex);
+    mmap_lock();
 }
 
 void mmap_fork_end(int child)
 {
-    if (child)
+    if (child) {
         pthread_mutex_init(&mmap_mutex, NULL);
-    else
-        pthread_mutex_unlock(&mmap_mutex);
+        pthread_cond_init(&mmap_cond, NULL);
+        mmap_exclusive_waiters = 0;
+        mmap_exclusive = false;
+        mmap_lock_count = 0;
+    } else {
+        mmap_unlock();
+    }
 }
 
 /*
@@ -132,7 +223,7 @@ int target_mprotect(abi_ulong start, abi_ulong len, int target_prot)
         return 0;
     }
 
-    mmap_lock();
+    mmap_lock_range(start, len);
     host_start = start & qemu_host_page_mask;
     host_end = HOST_PAGE_ALIGN(end);
     if (start > host_start) {
@@ -425,30 +516,39 @@ abi_long target_mmap(abi_ulong start, abi_ulong len, int target_prot,
     abi_ulong ret, end, real_start, real_end, retaddr, host_offset, host_len;
     int page_flags, host_prot;
 
-    mmap_lock();
     trace_target_mmap(start, len, target_prot, flags, fd, offset);
 
     if (!len) {
         errno = EINVAL;
-        goto fail;
+        return -1;
     }
 
     page_flags = validate_prot_to_pageflags(&host_prot, target_prot);
     if (!page_flags) {
         errno = EINVAL;
-        goto fail;
+        return -1;
     }
 
     /* Also check for overflows... */
     len = TARGET_PAGE_ALIGN(len);
     if (!len) {
         errno = ENOMEM;
-        goto fail;
+        return -1;
     }
 
     if (offset & ~TARGET_PAGE_MASK) {
         errno = EINVAL;
-        goto fail;
+        return -1;
+    }
+
+    /*
+     * A fixed mapping only changes [start, start + len).  Otherwise we
+     * have to look for a free range, which needs the whole address space.
+     */
+    if ((flags & MAP_FIXED) && start + len > start) {
+        mmap_lock_range(start, len);
+    } else {
+        mmap_lock();
     }
 
     real_start = start & qemu_host_page_mask;
@@ -679,7 +779,7 @@ int target_munmap(abi_ulong start, abi_ulong len)
         return -TARGET_EINVAL;
     }
 
-    mmap_lock();
+    mmap_lock_range(start, len);
     end = start + len;
     real_start = start & qemu_host_page_mask;
     real_end = HOST_PAGE_ALIGN(end);
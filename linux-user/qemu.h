@@ -484,6 +484,18 @@ void mmap_fork_end(int child);
 /* main.c */
 extern unsigned long guest_stack_size;
 
+/* zygote.c */
+typedef struct ZygoteRequest {
+    char *exec_path;
+    char **argv;
+    char **envp;
+    int execfd;                 /* 0 if none */
+} ZygoteRequest;
+
+void zygote_client_run(const char *path, int execfd, const char *exec_path,
+                       char **argv, char **envp);
+void zygote_server_run(const char *path, ZygoteRequest *req);
+
 /* user access */
 
 #define VERIFY_READ  PAGE_READ
@@ -0,0 +1,464 @@
+/*
+ *  Resident qemu-user that starts guest programs on behalf of clients
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * A server ("zygote") does the part of the start-up that does not depend
+ * on the program being run: it sets up the accelerator, the code buffer,
+ * crypto, path lookup and plugins.  Then it waits on a unix socket.
+ *
+ * A client is a qemu-user started with -zygote, typically by binfmt_misc.
+ * It sends the program path, argv, environment, working directory and
+ * stdio (plus the binfmt_misc exec fd, if any) to the server, then just
+ * relays signals and the exit status.
+ *
+ * For each client the server forks a monitor, which forks the guest
+ * process.  The guest returns from zygote_server_run() and continues
+ * into the normal start-up path with the client's program.  The monitor
+ * reports the guest pid and, later, its wait status to the client, and
+ * kills the guest if the client goes away.
+ */
+
+#include "qemu/osdep.h"
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#include "qemu/units.h"
+#include "qemu/cutils.h"
+#include "qemu/error-report.h"
+#include "qemu.h"
+
+#define ZYGOTE_MAGIC    0x51454d5a      /* also serves as version */
+#define ZYGOTE_MAX_FDS  4               /* stdin, stdout, stderr, execfd */
+#define ZYGOTE_MAX_LEN  (64 * MiB)
+
+/*
+ * Sent with the fds attached, followed by @len bytes of NUL terminated
+ * strings: the program path, the working directory, then @argc arguments
+ * and @envc environment entries.
+ */
+typedef struct ZygoteHeader {
+    uint32_t magic;
+    uint32_t argc;
+    uint32_t envc;
+    uint32_t len;
+} ZygoteHeader;
+
+typedef union {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE(ZYGOTE_MAX_FDS * sizeof(int))];
+} ZygoteControl;
+
+static int zygote_socket(const char *path, struct sockaddr_un *addr)
+{
+    if (strlen(path) >= sizeof(addr->sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    pstrcpy(addr->sun_path, sizeof(addr->sun_path), path);
+    return socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+}
+
+static bool zygote_write(int fd, const void *buf, size_t len)
+{
+    const char *p = buf;
+
+    while (len) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+static bool zygote_read(int fd, void *buf, size_t len)
+{
+    char *p = buf;
+
+    while (len) {
+        ssize_t n = read(fd, p, len);
+
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+/* Client side */
+
+static pid_t zygote_guest_pid;
+
+static const int zygote_forwarded_signals[] = {
+    SIGHUP, SIGINT, SIGQUIT, SIGTERM, SIGUSR1, SIGUSR2, SIGWINCH, SIGCONT,
+};
+
+static void zygote_forward_signal(int sig)
+{
+    kill(zygote_guest_pid, sig);
+}
+
+/* Exit the way the guest did */
+static void QEMU_NORETURN zygote_client_exit(int status)
+{
+    if (WIFSIGNALED(status)) {
+        int sig = WTERMSIG(status);
+        struct rlimit nodump = { 0, 0 };
+        sigset_t mask;
+
+        /* The guest already dumped core, if it was going to */
+        setrlimit(RLIMIT_CORE, &nodump);
+        signal(sig, SIG_DFL);
+        sigemptyset(&mask);
+        sigaddset(&mask, sig);
+        sigprocmask(SIG_UNBLOCK, &mask, NULL);
+        raise(sig);
+    }
+    exit(WIFEXITED(status) ? WEXITSTATUS(status) : EXIT_FAILURE);
+}
+
+/*
+ * Hand the program over to the server listening on @path.  Only returns
+ * if no server took it, in which case the caller runs it itself.
+ */
+void zygote_client_run(const char *path, int execfd, const char *exec_path,
+                       char **argv, char **envp)
+{
+    g_autoptr(GString) strings = g_string_new(NULL);
+    g_autofree char *cwd = g_get_current_dir();
+    ZygoteHeader hdr = { .magic = ZYGOTE_MAGIC };
+    int fds[ZYGOTE_MAX_FDS] = { 0, 1, 2, execfd };
+    int nfds = execfd ? 4 : 3;
+    ZygoteControl u;
+    struct sockaddr_un addr;
+    struct iovec iov = { .iov_base = &hdr, .iov_len = sizeof(hdr) };
+    struct msghdr msg = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = u.buf,
+        .msg_controllen = CMSG_SPACE(nfds * sizeof(int)),
+    };
+    struct cmsghdr *cmsg;
+    struct sigaction act;
+    int32_t reply;
+    int sock, i;
+
+    sock = zygote_socket(path, &addr);
+    if (sock < 0) {
+        return;
+    }
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(sock);
+        return;
+    }
+
+    g_string_append_len(strings, exec_path, strlen(exec_path) + 1);
+    g_string_append_len(strings, cwd, strlen(cwd) + 1);
+    for (i = 0; argv[i]; i++) {
+        g_string_append_len(strings, argv[i], strlen(argv[i]) + 1);
+    }
+    hdr.argc = i;
+    for (i = 0; envp[i]; i++) {
+        g_string_append_len(strings, envp[i], strlen(envp[i]) + 1);
+    }
+    hdr.envc = i;
+    hdr.len = strings->len;
+
+    memset(&u, 0, sizeof(u));
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(nfds * sizeof(int));
+    memcpy(CMSG_DATA(cmsg), fds, nfds * sizeof(int));
+
+    /*
+     * Until the server has answered with a pid, the guest has not been
+     * started and we can still fall back to running it ourselves.
+     */
+    if (hdr.len > ZYGOTE_MAX_LEN ||
+        sendmsg(sock, &msg, MSG_NOSIGNAL) != sizeof(hdr) ||
+        !zygote_write(sock, strings->str, strings->len) ||
+        !zygote_read(sock, &reply, sizeof(reply))) {
+        close(sock);
+        return;
+    }
+    zygote_guest_pid = reply;
+
+    memset(&act, 0, sizeof(act));
+    act.sa_handler = zygote_forward_signal;
+    act.sa_flags = SA_RESTART;
+    sigemptyset(&act.sa_mask);
+    for (i = 0; i < ARRAY_SIZE(zygote_forwarded_signals); i++) {
+        sigaction(zygote_forwarded_signals[i], &act, NULL);
+    }
+
+    if (!zygote_read(sock, &reply, sizeof(reply))) {
+        error_report("zygote: lost connection to %s", path);
+        exit(EXIT_FAILURE);
+    }
+    zygote_client_exit(reply);
+}
+
+/* Server side */
+
+static char *zygote_next_string(char **p, char *end)
+{
+    char *s = *p;
+    char *nul = memchr(s, 0, end - s);
+
+    if (!nul) {
+        return NULL;
+    }
+    *p = nul + 1;
+    return s;
+}
+
+static bool zygote_receive(int sock, ZygoteRequest *req, char **cwd,
+                           int *fds, int *nfds)
+{
+    ZygoteHeader hdr;
+    ZygoteControl u;
+    struct iovec iov = { .iov_base = &hdr, .iov_len = sizeof(hdr) };
+    struct msghdr msg = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = u.buf,
+        .msg_controllen = sizeof(u.buf),
+    };
+    struct cmsghdr *cmsg;
+    char *strings, *p, *end;
+    uint32_t i;
+
+    if (recvmsg(sock, &msg, MSG_CMSG_CLOEXEC) != sizeof(hdr) ||
+        hdr.magic != ZYGOTE_MAGIC || hdr.len > ZYGOTE_MAX_LEN) {
+        return false;
+    }
+    cmsg = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || cmsg->cmsg_level != SOL_SOCKET ||
+        cmsg->cmsg_type != SCM_RIGHTS) {
+        return false;
+    }
+    *nfds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    if (*nfds < 3 || *nfds > ZYGOTE_MAX_FDS) {
+        return false;
+    }
+    memcpy(fds, CMSG_DATA(cmsg), *nfds * sizeof(int));
+
+    strings = g_malloc(hdr.len);
+    if (!zygote_read(sock, strings, hdr.len)) {
+        return false;
+    }
+    p = strings;
+    end = strings + hdr.len;
+
+    req->exec_path = zygote_next_string(&p, end);
+    *cwd = zygote_next_string(&p, end);
+    req->argv = g_new0(char *, hdr.argc + 1);
+    for (i = 0; i < hdr.argc; i++) {
+        req->argv[i] = zygote_next_string(&p, end);
+        if (!req->argv[i]) {
+            return false;
+        }
+    }
+    req->envp = g_new0(char *, hdr.envc + 1);
+    for (i = 0; i < hdr.envc; i++) {
+        req->envp[i] = zygote_next_string(&p, end);
+        if (!req->envp[i]) {
+            return false;
+        }
+    }
+    req->execfd = *nfds > 3 ? fds[3] : 0;
+    return req->exec_path && *cwd && hdr.argc > 0;
+}
+
+/*
+ * Wait for the guest and pass its status on.  The client never sends
+ * anything after its request, so the socket only becomes readable when
+ * the client is gone, and then nobody is left to wait for the guest.
+ */
+static void QEMU_NORETURN zygote_monitor(int sock, int sigfd, pid_t pid)
+{
+    struct pollfd pfd[2] = {
+        { .fd = sock, .events = POLLIN },
+        { .fd = sigfd, .events = POLLIN },
+    };
+    struct signalfd_siginfo si;
+    pid_t ret;
+    int32_t reply = pid;
+    int status = EXIT_FAILURE << 8;
+
+    if (!zygote_write(sock, &reply, sizeof(reply))) {
+        kill(pid, SIGKILL);
+        pfd[0].fd = -1;
+    }
+
+    for (;;) {
+        if (poll(pfd, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            kill(pid, SIGKILL);
+            waitpid(pid, &status, 0);
+            break;
+        }
+        if (pfd[0].revents) {
+            kill(pid, SIGKILL);
+            pfd[0].fd = -1;
+        }
+        if (pfd[1].revents) {
+            if (read(sigfd, &si, sizeof(si)) < 0 && errno != EAGAIN) {
+                continue;
+            }
+            ret = waitpid(pid, &status, WNOHANG);
+            if (ret == pid || ret < 0) {
+                break;
+            }
+        }
+    }
+
+    reply = status;
+    if (pfd[0].fd >= 0) {
+        zygote_write(sock, &reply, sizeof(reply));
+    }
+    _exit(EXIT_SUCCESS);
+}
+
+/*
+ * Runs in the monitor process.  Returns in the guest process, with its
+ * stdio and working directory taken over from the client.
+ */
+static void zygote_start(int sock, ZygoteRequest *req)
+{
+    char *cwd = NULL;
+    int fds[ZYGOTE_MAX_FDS];
+    int nfds = 0;
+    sigset_t chld, old;
+    int sigfd, i;
+    pid_t pid;
+
+    if (!zygote_receive(sock, req, &cwd, fds, &nfds)) {
+        _exit(EXIT_FAILURE);
+    }
+
+    /* Block SIGCHLD before the fork so that an early exit is not missed */
+    sigemptyset(&chld);
+    sigaddset(&chld, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &chld, &old);
+    sigfd = signalfd(-1, &chld, SFD_CLOEXEC | SFD_NONBLOCK);
+    if (sigfd < 0) {
+        _exit(EXIT_FAILURE);
+    }
+
+    pid = fork();
+    if (pid < 0) {
+        _exit(EXIT_FAILURE);
+    }
+    if (pid > 0) {
+        zygote_monitor(sock, sigfd, pid);
+    }
+
+    close(sock);
+    close(sigfd);
+    sigprocmask(SIG_SETMASK, &old, NULL);
+
+    for (i = 0; i < 3; i++) {
+        if (fds[i] != i) {
+            dup2(fds[i], i);
+            close(fds[i]);
+        }
+    }
+    if (chdir(cwd) < 0) {
+        error_report("zygote: cannot change directory to %s: %s",
+                     cwd, strerror(errno));
+        _exit(EXIT_FAILURE);
+    }
+}
+
+/*
+ * Listen on @path and start a guest for each client.  Only returns in a
+ * guest process, with @req describing the program to run.
+ */
+void zygote_server_run(const char *path, ZygoteRequest *req)
+{
+    struct sockaddr_un addr;
+    int lsock;
+
+    lsock = zygote_socket(path, &addr);
+    if (lsock < 0) {
+        error_report("zygote: cannot create socket %s: %s",
+                     path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    unlink(path);
+    if (bind(lsock, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(lsock, SOMAXCONN) < 0) {
+        error_report("zygote: cannot listen on %s: %s",
+                     path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    /* Monitors report to their client; nobody here waits for them */
+    signal(SIGCHLD, SIG_IGN);
+
+    for (;;) {
+        struct ucred cred;
+        socklen_t len = sizeof(cred);
+        pid_t pid;
+        int sock;
+
+        sock = accept4(lsock, NULL, NULL, SOCK_CLOEXEC);
+        if (sock < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            error_report("zygote: accept failed: %s", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        /* Only serve our own user: the guest runs with our credentials */
+        if (getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0 ||
+            cred.uid != geteuid()) {
+            close(sock);
+            continue;
+        }
+
+        pid = fork();
+        if (pid == 0) {
+            close(lsock);
+            signal(SIGCHLD, SIG_DFL);
+            zygote_start(sock, req);
+            return;
+        }
+        close(sock);
+    }
+}
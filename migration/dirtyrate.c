@@ -15,14 +15,21 @@
 #include "qapi/error.h"
 #include "cpu.h"
 #include "exec/ramblock.h"
+#include "exec/ram_addr.h"
 #include "qemu/rcu_queue.h"
+#include "qemu/main-loop.h"
 #include "qapi/qapi-commands-migration.h"
+#include "sysemu/kvm.h"
+#include "migration/misc.h"
+#include "migration.h"
 #include "ram.h"
 #include "trace.h"
 #include "dirtyrate.h"
 
 static int CalculatingState = DIRTY_RATE_STATUS_UNSTARTED;
 static struct DirtyRateStat DirtyStat;
+static DirtyRateMeasureMode dirtyrate_mode =
+                DIRTY_RATE_MEASURE_MODE_PAGE_SAMPLING;
 
 static int64_t set_sample_page_period(int64_t msec, int64_t initial_time)
 {
@@ -72,6 +79,22 @@ static struct DirtyRateInfo *query_dirty_rate_info(void)
     info->status = CalculatingState;
     info->start_time = DirtyStat.start_time;
     info->calc_time = DirtyStat.calc_time;
+    info->mode = dirtyrate_mode;
+
+    if (qatomic_read(&CalculatingState) == DIRTY_RATE_STATUS_MEASURED &&
+        dirtyrate_mode == DIRTY_RATE_MEASURE_MODE_DIRTY_RING) {
+        DirtyRateVcpuList *head = NULL, **tail = &head;
+        int i;
+
+        for (i = 0; i < DirtyStat.nvcpu; i++) {
+            DirtyRateVcpu *rate = g_new0(DirtyRateVcpu, 1);
+
+            *rate = DirtyStat.vcpu_rates[i];
+            QAPI_LIST_APPEND(tail, rate);
+        }
+        info->has_vcpu_dirty_rate = true;
+        info->vcpu_dirty_rate = head;
+    }
 
     trace_query_dirty_rate_info(DirtyRateStatus_str(CalculatingState));
 
@@ -86,6 +109,9 @@ static void init_dirtyrate_stat(int64_t start_time, int64_t calc_time)
     DirtyStat.dirty_rate = -1;
     DirtyStat.start_time = start_time;
     DirtyStat.calc_time = calc_time;
+    DirtyStat.nvcpu = 0;
+    g_free(DirtyStat.vcpu_rates);
+    DirtyStat.vcpu_rates = NULL;
 }
 
 static void update_dirtyrate_stat(struct RamblockDirtyInfo *info)
@@ -322,14 +348,170 @@ static bool compare_page_hash_info(struct RamblockDirtyInfo *info,
     return true;
 }
 
-static void calculate_dirtyrate(struct DirtyRateConfig config)
+static void dirtyrate_global_dirty_log_start(void)
+{
+    qemu_mutex_lock_iothread();
+    memory_global_dirty_log_start(GLOBAL_DIRTY_DIRTY_RATE);
+    qemu_mutex_unlock_iothread();
+}
+
+/*
+ * Fetch the pages dirtied since the last sync from the dirty log, then
+ * stop dirty tracking for the measurement.
+ */
+static void dirtyrate_global_dirty_log_stop(void)
+{
+    qemu_mutex_lock_iothread();
+    memory_global_dirty_log_sync();
+    memory_global_dirty_log_stop(GLOBAL_DIRTY_DIRTY_RATE);
+    qemu_mutex_unlock_iothread();
+}
+
+/*
+ * Clear the dirty log of all migratable blocks, so that pages the
+ * kernel still reports as dirty from before the measurement started
+ * (KVM_DIRTY_LOG_MANUAL_PROTECT_ENABLE) are not counted again.
+ */
+static void dirtyrate_manual_reset_protect(void)
+{
+    RAMBlock *block = NULL;
+
+    WITH_RCU_READ_LOCK_GUARD() {
+        RAMBLOCK_FOREACH_MIGRATABLE(block) {
+            memory_region_clear_dirty_bitmap(block->mr, 0,
+                                             block->used_length);
+        }
+    }
+}
+
+/*
+ * Convert the number of pages dirtied during @msec into MB/s.
+ */
+static int64_t do_calculate_dirtyrate(DirtyPageRecord *dirty_pages,
+                                      int64_t msec)
+{
+    uint64_t increased_dirty_pages =
+        dirty_pages->end_pages - dirty_pages->start_pages;
+
+    return ((increased_dirty_pages * TARGET_PAGE_SIZE * 1000) / msec) >> 20;
+}
+
+static void calculate_dirtyrate_dirty_ring(struct DirtyRateConfig config)
+{
+    CPUState *cpu;
+    DirtyPageRecord *dirty_pages;
+    int64_t msec = 0;
+    int64_t start_time;
+    int64_t dirtyrate_sum = 0;
+    int nvcpu = 0;
+    int i;
+
+    dirtyrate_global_dirty_log_start();
+
+    qemu_mutex_lock_iothread();
+    CPU_FOREACH(cpu) {
+        nvcpu++;
+    }
+    dirty_pages = g_new0(DirtyPageRecord, nvcpu);
+    DirtyStat.vcpu_rates = g_new0(DirtyRateVcpu, nvcpu);
+    DirtyStat.nvcpu = nvcpu;
+
+    /* Reap the rings, so that the counters are up to date */
+    memory_global_dirty_log_sync();
+    i = 0;
+    CPU_FOREACH(cpu) {
+        DirtyStat.vcpu_rates[i].id = cpu->cpu_index;
+        dirty_pages[i].start_pages = cpu->dirty_pages;
+        i++;
+    }
+    qemu_mutex_unlock_iothread();
+
+    start_time = qemu_clock_get_ms(QEMU_CLOCK_REALTIME);
+    DirtyStat.start_time = start_time / 1000;
+
+    msec = config.sample_period_seconds * 1000;
+    msec = set_sample_page_period(msec, start_time);
+    DirtyStat.calc_time = msec / 1000;
+
+    qemu_mutex_lock_iothread();
+    memory_global_dirty_log_sync();
+    i = 0;
+    CPU_FOREACH(cpu) {
+        /* Skip vcpus that were hot-plugged during the measurement */
+        if (i < nvcpu && DirtyStat.vcpu_rates[i].id == cpu->cpu_index) {
+            dirty_pages[i].end_pages = cpu->dirty_pages;
+            i++;
+        }
+    }
+    memory_global_dirty_log_stop(GLOBAL_DIRTY_DIRTY_RATE);
+    qemu_mutex_unlock_iothread();
+
+    for (i = 0; i < nvcpu; i++) {
+        /* A vcpu unplugged during the measurement has no end counter */
+        if (dirty_pages[i].end_pages < dirty_pages[i].start_pages) {
+            dirty_pages[i].end_pages = dirty_pages[i].start_pages;
+        }
+        DirtyStat.vcpu_rates[i].dirty_rate =
+            do_calculate_dirtyrate(&dirty_pages[i], msec);
+        trace_dirtyrate_vcpu(DirtyStat.vcpu_rates[i].id,
+                             DirtyStat.vcpu_rates[i].dirty_rate);
+        dirtyrate_sum += DirtyStat.vcpu_rates[i].dirty_rate;
+    }
+
+    DirtyStat.dirty_rate = dirtyrate_sum;
+    g_free(dirty_pages);
+}
+
+static void calculate_dirtyrate_dirty_bitmap(struct DirtyRateConfig config)
+{
+    DirtyPageRecord dirty_pages;
+    int64_t msec = 0;
+    int64_t start_time;
+
+    dirtyrate_global_dirty_log_start();
+
+    qemu_mutex_lock_iothread();
+    /*
+     * Clearing the dirty log behind the back of migration would lose
+     * pages it has still to send.
+     */
+    if (migration_is_active(migrate_get_current())) {
+        memory_global_dirty_log_stop(GLOBAL_DIRTY_DIRTY_RATE);
+        qemu_mutex_unlock_iothread();
+        error_report("dirty-bitmap measurement aborted: migration is active");
+        return;
+    }
+
+    /*
+     * The first sync after dirty logging is enabled may report every
+     * page dirty with KVM_DIRTY_LOG_INITIALLY_SET, so skip it and only
+     * count what the next sync reports.
+     */
+    memory_global_dirty_log_sync();
+    dirtyrate_manual_reset_protect();
+    dirty_pages.start_pages = total_dirty_pages;
+    qemu_mutex_unlock_iothread();
+
+    start_time = qemu_clock_get_ms(QEMU_CLOCK_REALTIME);
+    DirtyStat.start_time = start_time / 1000;
+
+    msec = config.sample_period_seconds * 1000;
+    msec = set_sample_page_period(msec, start_time);
+    DirtyStat.calc_time = msec / 1000;
+
+    dirtyrate_global_dirty_log_stop();
+    dirty_pages.end_pages = total_dirty_pages;
+
+    DirtyStat.dirty_rate = do_calculate_dirtyrate(&dirty_pages, msec);
+}
+
+static void calculate_dirtyrate_sample_vm(struct DirtyRateConfig config)
 {
     struct RamblockDirtyInfo *block_dinfo = NULL;
     int block_count = 0;
     int64_t msec = 0;
     int64_t initial_time;
 
-    rcu_register_thread();
     rcu_read_lock();
     initial_time = qemu_clock_get_ms(QEMU_CLOCK_REALTIME);
     if (!record_ramblock_hash_info(&block_dinfo, config, &block_count)) {
@@ -352,6 +534,25 @@ static void calculate_dirtyrate(struct DirtyRateConfig config)
 out:
     rcu_read_unlock();
     free_ramblock_dirty_info(block_dinfo, block_count);
+}
+
+static void calculate_dirtyrate(struct DirtyRateConfig config)
+{
+    rcu_register_thread();
+
+    switch (config.mode) {
+    case DIRTY_RATE_MEASURE_MODE_DIRTY_RING:
+        calculate_dirtyrate_dirty_ring(config);
+        break;
+    case DIRTY_RATE_MEASURE_MODE_DIRTY_BITMAP:
+        calculate_dirtyrate_dirty_bitmap(config);
+        break;
+    default:
+        calculate_dirtyrate_sample_vm(config);
+        break;
+    }
+
+    trace_dirtyrate_calculate(DirtyStat.dirty_rate);
     rcu_unregister_thread();
 }
 
@@ -383,7 +584,8 @@ void *get_dirtyrate_thread(void *arg)
     return NULL;
 }
 
-void qmp_calc_dirty_rate(int64_t calc_time, Error **errp)
+void qmp_calc_dirty_rate(int64_t calc_time, bool has_mode,
+                         DirtyRateMeasureMode mode, Error **errp)
 {
     static struct DirtyRateConfig config;
     QemuThread thread;
@@ -404,6 +606,23 @@ void qmp_calc_dirty_rate(int64_t calc_time, Error **errp)
         return;
     }
 
+    if (!has_mode) {
+        mode = DIRTY_RATE_MEASURE_MODE_PAGE_SAMPLING;
+    }
+
+    if (mode == DIRTY_RATE_MEASURE_MODE_DIRTY_RING &&
+        !kvm_dirty_ring_enabled()) {
+        error_setg(errp, "mode dirty-ring requires the KVM dirty ring.");
+        return;
+    }
+
+    if (mode == DIRTY_RATE_MEASURE_MODE_DIRTY_BITMAP &&
+        migration_is_active(migrate_get_current())) {
+        error_setg(errp, "mode dirty-bitmap is not allowed while "
+                   "migration is active.");
+        return;
+    }
+
     /*
      * Init calculation state as unstarted.
      */
@@ -416,6 +635,8 @@ void qmp_calc_dirty_rate(int64_t calc_time, Error **errp)
 
     config.sample_period_seconds = calc_time;
     config.sample_pages_per_gigabytes = DIRTYRATE_DEFAULT_SAMPLE_PAGES;
+    config.mode = mode;
+    dirtyrate_mode = mode;
     qemu_thread_create(&thread, "get_dirtyrate", get_dirtyrate_thread,
                        (void *)&config, QEMU_THREAD_DETACHED);
 }
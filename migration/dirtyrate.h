@@ -13,6 +13,8 @@
 #ifndef QEMU_MIGRATION_DIRTYRATE_H
 #define QEMU_MIGRATION_DIRTYRATE_H
 
+#include "qapi/qapi-types-migration.h"
+
 /*
  * Sample 512 pages per GB as default.
  * TODO: Make it configurable.
@@ -38,8 +40,18 @@
 struct DirtyRateConfig {
     uint64_t sample_pages_per_gigabytes; /* sample pages per GB */
     int64_t sample_period_seconds; /* time duration between two sampling */
+    DirtyRateMeasureMode mode; /* mechanism of dirty rate measurement */
 };
 
+/*
+ * Store dirty page counters at the start and the end of a measurement,
+ * either for one vcpu (dirty-ring) or for the whole vm (dirty-bitmap).
+ */
+typedef struct DirtyPageRecord {
+    uint64_t start_pages;
+    uint64_t end_pages;
+} DirtyPageRecord;
+
 /*
  * Store dirtypage info for each ramblock.
  */
@@ -63,6 +75,8 @@ struct DirtyRateStat {
     int64_t dirty_rate; /* dirty rate in MB/s */
     int64_t start_time; /* calculation start time in units of second */
     int64_t calc_time; /* time duration of two sampling in units of second */
+    int nvcpu; /* number of vcpus measured in dirty-ring mode */
+    DirtyRateVcpu *vcpu_rates; /* dirty rate of each vcpu in MB/s */
 };
 
 void *get_dirtyrate_thread(void *arg);
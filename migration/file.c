@@ -0,0 +1,205 @@
+/*
+ * QEMU live migration to and from a file
+ *
+ * With the mapped-ram capability every RAMBlock gets a fixed region of
+ * the file, and each page is written at its offset inside that region.
+ * The multifd channels then all open the same file and write their
+ * pages in parallel, optionally bypassing the page cache with O_DIRECT.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "qapi/error.h"
+#include "channel.h"
+#include "file.h"
+#include "migration.h"
+#include "io/channel-file.h"
+#include "io/channel-util.h"
+#include "trace.h"
+
+static struct FileOutgoingArgs {
+    char *fname;
+} outgoing_args;
+
+static int file_open_flags(int flags)
+{
+#ifdef O_DIRECT
+    if (migrate_direct_io()) {
+        flags |= O_DIRECT;
+    }
+#endif
+    return flags;
+}
+
+void file_cleanup_outgoing_migration(void)
+{
+    g_free(outgoing_args.fname);
+    outgoing_args.fname = NULL;
+}
+
+/*
+ * Open one more channel on the migration file for a multifd send
+ * thread.  Only the multifd channels use O_DIRECT: they write whole
+ * pages at aligned offsets, the main channel doesn't.
+ */
+void file_send_channel_create(QIOTaskFunc f, void *data)
+{
+    QIOChannelFile *ioc;
+    QIOTask *task;
+    Error *err = NULL;
+
+    ioc = qio_channel_file_new_path(outgoing_args.fname,
+                                    file_open_flags(O_WRONLY), 0, &err);
+    if (!ioc) {
+        /* the task still needs a source object to hand the error back */
+        ioc = qio_channel_file_new_fd(-1);
+    }
+
+    task = qio_task_new(OBJECT(ioc), f, data, NULL);
+    if (err) {
+        qio_task_set_error(task, err);
+    }
+    qio_task_complete(task);
+}
+
+void file_start_outgoing_migration(MigrationState *s, const char *filename,
+                                   Error **errp)
+{
+    QIOChannelFile *fioc;
+    int flags = O_CREAT | O_WRONLY;
+
+    trace_migration_file_outgoing(filename);
+
+    if (migrate_use_multifd() && !migrate_mapped_ram()) {
+        error_setg(errp, "Multifd file migration requires mapped-ram");
+        return;
+    }
+    if (migrate_use_multifd() &&
+        migrate_multifd_compression() != MULTIFD_COMPRESSION_NONE) {
+        error_setg(errp, "Mapped-ram is not compatible with multifd "
+                   "compression");
+        return;
+    }
+    if (migrate_use_tls()) {
+        error_setg(errp, "File migration is not compatible with TLS");
+        return;
+    }
+
+    /*
+     * With mapped-ram every page has a fixed place in the file, so a
+     * new snapshot can simply overwrite the previous one in place.
+     */
+    if (!migrate_mapped_ram()) {
+        flags |= O_TRUNC;
+    }
+
+    fioc = qio_channel_file_new_path(filename, flags, 0600, errp);
+    if (!fioc) {
+        return;
+    }
+
+    if (migrate_mapped_ram() &&
+        !qio_channel_has_feature(QIO_CHANNEL(fioc),
+                                 QIO_CHANNEL_FEATURE_SEEKABLE)) {
+        error_setg(errp, "Mapped-ram requires a seekable file");
+        object_unref(OBJECT(fioc));
+        return;
+    }
+
+    g_free(outgoing_args.fname);
+    outgoing_args.fname = g_strdup(filename);
+
+    qio_channel_set_name(QIO_CHANNEL(fioc), "migration-file-outgoing");
+    migration_channel_connect(s, QIO_CHANNEL(fioc), NULL, NULL);
+    object_unref(OBJECT(fioc));
+}
+
+struct FileIncomingData {
+    QIOChannel *main;
+    QIOChannel **multifd;
+    int nchannels;
+};
+
+static gboolean file_accept_incoming_migration(QIOChannel *ioc,
+                                               GIOCondition condition,
+                                               gpointer opaque)
+{
+    struct FileIncomingData *data = opaque;
+    int i;
+
+    /* The main channel must be set up before any multifd one */
+    migration_channel_process_incoming(data->main);
+    object_unref(OBJECT(data->main));
+
+    for (i = 0; i < data->nchannels; i++) {
+        migration_channel_process_incoming(data->multifd[i]);
+        object_unref(OBJECT(data->multifd[i]));
+    }
+
+    g_free(data->multifd);
+    g_free(data);
+    return G_SOURCE_REMOVE;
+}
+
+void file_start_incoming_migration(const char *filename, Error **errp)
+{
+    struct FileIncomingData *data;
+    QIOChannelFile *fioc;
+    int i, n = 0;
+
+    trace_migration_file_incoming(filename);
+
+    if (migrate_use_multifd() && !migrate_mapped_ram()) {
+        error_setg(errp, "Multifd file migration requires mapped-ram");
+        return;
+    }
+
+    fioc = qio_channel_file_new_path(filename, O_RDONLY, 0, errp);
+    if (!fioc) {
+        return;
+    }
+
+    if (migrate_mapped_ram() &&
+        !qio_channel_has_feature(QIO_CHANNEL(fioc),
+                                 QIO_CHANNEL_FEATURE_SEEKABLE)) {
+        error_setg(errp, "Mapped-ram requires a seekable file");
+        object_unref(OBJECT(fioc));
+        return;
+    }
+
+    data = g_new0(struct FileIncomingData, 1);
+    data->main = QIO_CHANNEL(fioc);
+    qio_channel_set_name(data->main, "migration-file-incoming");
+
+    /*
+     * Open the multifd channels right away, so that a failure is
+     * reported to the caller rather than from the main loop.
+     */
+    if (migrate_use_multifd()) {
+        n = migrate_multifd_channels();
+    }
+    data->multifd = g_new0(QIOChannel *, n);
+    for (i = 0; i < n; i++) {
+        fioc = qio_channel_file_new_path(filename, file_open_flags(O_RDONLY),
+                                         0, errp);
+        if (!fioc) {
+            while (i--) {
+                object_unref(OBJECT(data->multifd[i]));
+            }
+            object_unref(OBJECT(data->main));
+            g_free(data->multifd);
+            g_free(data);
+            return;
+        }
+        data->multifd[i] = QIO_CHANNEL(fioc);
+        qio_channel_set_name(data->multifd[i], "multifd-file-incoming");
+    }
+    data->nchannels = n;
+
+    qio_channel_add_watch_full(data->main, G_IO_IN,
+                               file_accept_incoming_migration,
+                               data, NULL,
+                               g_main_context_get_thread_default());
+}
@@ -20,10 +20,13 @@
 #include "migration/blocker.h"
 #include "exec.h"
 #include "fd.h"
+#include "file.h"
 #include "socket.h"
 #include "sysemu/runstate.h"
 #include "sysemu/sysemu.h"
 #include "sysemu/cpu-throttle.h"
+#include "sysemu/dirtylimit.h"
+#include "sysemu/kvm.h"
 #include "rdma.h"
 #include "ram.h"
 #include "migration/global_state.h"
@@ -59,6 +62,7 @@
 #include "multifd.h"
 #include "qemu/yank.h"
 #include "sysemu/cpus.h"
+#include "monitor/stats.h"
 
 #ifdef CONFIG_VFIO
 #include "hw/vfio/vfio-common.h"
@@ -84,6 +88,9 @@
 /* Default decompression thread count, usually decompression is at
  * least 4 times as fast as compression.*/
 #define DEFAULT_MIGRATE_DECOMPRESS_THREAD_COUNT 2
+/* Load RAM pages from the main channel thread by default */
+#define DEFAULT_MIGRATE_LOAD_THREAD_COUNT 0
+#define DEFAULT_MIGRATE_POPULATE_THREAD_COUNT 0
 /*0: means nocompress, 1: best speed, ... 9: best compress ratio */
 #define DEFAULT_MIGRATE_COMPRESS_LEVEL 1
 /* Define default autoconverge cpu throttle migration parameters */
@@ -91,6 +98,8 @@
 #define DEFAULT_MIGRATE_CPU_THROTTLE_INITIAL 20
 #define DEFAULT_MIGRATE_CPU_THROTTLE_INCREMENT 10
 #define DEFAULT_MIGRATE_MAX_CPU_THROTTLE 99
+/* Default dirty-limit quota for each vCPU, in MB/s */
+#define DEFAULT_MIGRATE_VCPU_DIRTY_LIMIT 1
 
 /* Migration XBZRLE default cache size */
 #define DEFAULT_MIGRATE_XBZRLE_CACHE_SIZE (64 * 1024 * 1024)
@@ -131,6 +140,7 @@ enum mig_rp_message_type {
     MIG_RP_MSG_REQ_PAGES,    /* data (start: be64, len: be32) */
     MIG_RP_MSG_RECV_BITMAP,  /* send recved_bitmap back to source */
     MIG_RP_MSG_RESUME_ACK,   /* tell source that we are ready to resume */
+    MIG_RP_MSG_SWITCHOVER_ACK, /* Tell source it's OK to do switchover */
 
     MIG_RP_MSG_MAX
 };
@@ -167,6 +177,18 @@ INITIALIZE_MIGRATE_CAPS_SET(check_caps_background_snapshot,
     MIGRATION_CAPABILITY_X_COLO,
     MIGRATION_CAPABILITY_VALIDATE_UUID);
 
+/* Mapped-ram compatibility check list */
+static const
+INITIALIZE_MIGRATE_CAPS_SET(check_caps_mapped_ram,
+    MIGRATION_CAPABILITY_POSTCOPY_RAM,
+    MIGRATION_CAPABILITY_POSTCOPY_PREEMPT,
+    MIGRATION_CAPABILITY_COMPRESS,
+    MIGRATION_CAPABILITY_XBZRLE,
+    MIGRATION_CAPABILITY_X_COLO,
+    MIGRATION_CAPABILITY_RDMA_PIN_ALL,
+    MIGRATION_CAPABILITY_BLOCK,
+    MIGRATION_CAPABILITY_X_IGNORE_SHARED);
+
 /* When we add fault tolerance, we could have several
    migrations at once.  For now we don't need to add
    dynamic creation of migration */
@@ -189,6 +211,49 @@ static gint page_request_addr_cmp(gconstpointer ap, gconstpointer bp)
     return (a > b) - (a < b);
 }
 
+/*
+ * Like query-migrate, read the counters of the migration thread without
+ * synchronization; they are only ever updated by a single thread.
+ */
+static void migration_stats_cb(StatsResultList **result, strList *names,
+                               Error **errp)
+{
+    StatsList *stats = NULL;
+
+    stats_add(&stats, names, "compressed-pages", compression_counters.pages);
+    stats_add(&stats, names, "dirty-pages-rate",
+              ram_counters.dirty_pages_rate);
+    stats_add(&stats, names, "multifd-bytes", ram_counters.multifd_bytes);
+    stats_add(&stats, names, "postcopy-requests",
+              ram_counters.postcopy_requests);
+    stats_add(&stats, names, "dirty-sync-count",
+              ram_counters.dirty_sync_count);
+    stats_add(&stats, names, "normal-pages", ram_counters.normal);
+    stats_add(&stats, names, "duplicate-pages", ram_counters.duplicate);
+    stats_add(&stats, names, "transferred", ram_counters.transferred);
+    stats_result_add(result, STATS_PROVIDER_MIGRATION, NULL, stats);
+}
+
+static void migration_stats_schemas_cb(StatsSchemaValueList **result)
+{
+    stats_schema_add(result, "compressed-pages", STATS_TYPE_CUMULATIVE,
+                     STATS_UNIT_PAGES);
+    stats_schema_add(result, "dirty-pages-rate", STATS_TYPE_INSTANT,
+                     STATS_UNIT_PAGES_PER_SECOND);
+    stats_schema_add(result, "multifd-bytes", STATS_TYPE_CUMULATIVE,
+                     STATS_UNIT_BYTES);
+    stats_schema_add(result, "postcopy-requests", STATS_TYPE_CUMULATIVE,
+                     STATS_UNIT__MAX);
+    stats_schema_add(result, "dirty-sync-count", STATS_TYPE_CUMULATIVE,
+                     STATS_UNIT__MAX);
+    stats_schema_add(result, "normal-pages", STATS_TYPE_CUMULATIVE,
+                     STATS_UNIT_PAGES);
+    stats_schema_add(result, "duplicate-pages", STATS_TYPE_CUMULATIVE,
+                     STATS_UNIT_PAGES);
+    stats_schema_add(result, "transferred", STATS_TYPE_CUMULATIVE,
+                     STATS_UNIT_BYTES);
+}
+
 void migration_object_init(void)
 {
     Error *err = NULL;
@@ -221,6 +286,9 @@ void migration_object_init(void)
     blk_mig_init();
     ram_mig_init();
     dirty_bitmap_mig_init();
+
+    add_stats_callbacks(STATS_PROVIDER_MIGRATION, migration_stats_cb,
+                        migration_stats_schemas_cb);
 }
 
 void migration_shutdown(void)
@@ -275,6 +343,10 @@ void migration_incoming_state_destroy(void)
         qemu_fclose(mis->from_src_file);
         mis->from_src_file = NULL;
     }
+    if (mis->postcopy_qemufile_dst) {
+        qemu_fclose(mis->postcopy_qemufile_dst);
+        mis->postcopy_qemufile_dst = NULL;
+    }
     if (mis->postcopy_remote_fds) {
         g_array_free(mis->postcopy_remote_fds, TRUE);
         mis->postcopy_remote_fds = NULL;
@@ -448,6 +520,41 @@ void migrate_add_address(SocketAddress *address)
                       QAPI_CLONE(SocketAddress, address));
 }
 
+/*
+ * With RDMA the multifd channels write straight into the guest RAM of
+ * the destination, whose CPU never sees the pages.  Anything that needs
+ * the destination to process the data can't be used.
+ */
+static bool migrate_rdma_multifd_check(Error **errp)
+{
+    if (!migrate_use_multifd()) {
+        return true;
+    }
+    if (migrate_multifd_compression() != MULTIFD_COMPRESSION_NONE ||
+        migrate_use_compression()) {
+        error_setg(errp, "RDMA multifd is not compatible with compression");
+        return false;
+    }
+    if (migrate_use_multifd_zero_page()) {
+        error_setg(errp, "RDMA multifd is not compatible with "
+                   "multifd-zero-page");
+        return false;
+    }
+    if (migrate_postcopy()) {
+        error_setg(errp, "RDMA multifd is not compatible with postcopy");
+        return false;
+    }
+    if (migrate_use_tls()) {
+        error_setg(errp, "RDMA multifd is not compatible with TLS");
+        return false;
+    }
+    if (migrate_colo_enabled()) {
+        error_setg(errp, "RDMA multifd is not compatible with COLO");
+        return false;
+    }
+    return true;
+}
+
 static void qemu_start_incoming_migration(const char *uri, Error **errp)
 {
     const char *p = NULL;
@@ -456,6 +563,17 @@ static void qemu_start_incoming_migration(const char *uri, Error **errp)
         return;
     }
 
+    if (migrate_mapped_ram() && !strstart(uri, "file:", NULL)) {
+        yank_unregister_instance(MIGRATION_YANK_INSTANCE);
+        error_setg(errp, "Mapped-ram requires a file migration");
+        return;
+    }
+
+    if (strstart(uri, "rdma:", NULL) && !migrate_rdma_multifd_check(errp)) {
+        yank_unregister_instance(MIGRATION_YANK_INSTANCE);
+        return;
+    }
+
     qapi_event_send_migration(MIGRATION_STATUS_SETUP);
     if (strstart(uri, "tcp:", &p) ||
         strstart(uri, "unix:", NULL) ||
@@ -469,6 +587,8 @@ static void qemu_start_incoming_migration(const char *uri, Error **errp)
         exec_start_incoming_migration(p, errp);
     } else if (strstart(uri, "fd:", &p)) {
         fd_start_incoming_migration(p, errp);
+    } else if (strstart(uri, "file:", &p)) {
+        file_start_incoming_migration(p, errp);
     } else {
         yank_unregister_instance(MIGRATION_YANK_INSTANCE);
         error_setg(errp, "unknown migration protocol: %s", uri);
@@ -719,6 +839,14 @@ void migration_ioc_process_incoming(QIOChannel *ioc, Error **errp)
          * right now.  Multifd needs more than one channel, we wait.
          */
         start_migration = !migrate_use_multifd();
+    } else if (migrate_postcopy_preempt() &&
+               multifd_recv_all_channels_created()) {
+        /*
+         * The postcopy preempt channel is only connected when postcopy
+         * starts, so it comes after any multifd channel.
+         */
+        postcopy_preempt_new_channel(mis, qemu_fopen_channel_input(ioc));
+        return;
     } else {
         /* Multiple connections */
         assert(migrate_use_multifd());
@@ -747,6 +875,10 @@ bool migration_has_all_channels(void)
 
     all_channels = multifd_recv_all_channels_created();
 
+    if (migrate_postcopy_preempt()) {
+        all_channels = all_channels && mis->postcopy_qemufile_dst != NULL;
+    }
+
     return all_channels && mis->from_src_file != NULL;
 }
 
@@ -824,6 +956,14 @@ void migrate_send_rp_resume_ack(MigrationIncomingState *mis, uint32_t value)
     migrate_send_rp_message(mis, MIG_RP_MSG_RESUME_ACK, sizeof(buf), &buf);
 }
 
+int migrate_send_rp_switchover_ack(MigrationIncomingState *mis)
+{
+    uint32_t buf = 0;
+
+    return migrate_send_rp_message(mis, MIG_RP_MSG_SWITCHOVER_ACK,
+                                   sizeof(buf), &buf);
+}
+
 MigrationCapabilityStatusList *qmp_query_migrate_capabilities(Error **errp)
 {
     MigrationCapabilityStatusList *head = NULL, **tail = &head;
@@ -906,6 +1046,14 @@ MigrationParameters *qmp_query_migrate_parameters(Error **errp)
     params->announce_rounds = s->parameters.announce_rounds;
     params->has_announce_step = true;
     params->announce_step = s->parameters.announce_step;
+    params->has_vcpu_dirty_limit = true;
+    params->vcpu_dirty_limit = s->parameters.vcpu_dirty_limit;
+    params->has_direct_io = true;
+    params->direct_io = s->parameters.direct_io;
+    params->has_load_threads = true;
+    params->load_threads = s->parameters.load_threads;
+    params->has_populate_threads = true;
+    params->populate_threads = s->parameters.populate_threads;
 
     if (s->parameters.has_block_bitmap_mapping) {
         params->has_block_bitmap_mapping = true;
@@ -1012,8 +1160,10 @@ static void populate_ram_info(MigrationInfo *info, MigrationState *s)
     info->ram->page_size = qemu_target_page_size();
     info->ram->multifd_bytes = ram_counters.multifd_bytes;
     info->ram->pages_per_second = s->pages_per_second;
+    info->ram->dirty_sync_missed_zero_copy =
+        ram_counters.dirty_sync_missed_zero_copy;
 
-    if (migrate_use_xbzrle()) {
+    if (migrate_use_xbzrle() || migrate_use_multifd_xbzrle()) {
         info->has_xbzrle_cache = true;
         info->xbzrle_cache = g_malloc0(sizeof(*info->xbzrle_cache));
         info->xbzrle_cache->cache_size = migrate_xbzrle_cache_size();
@@ -1042,6 +1192,17 @@ static void populate_ram_info(MigrationInfo *info, MigrationState *s)
         info->cpu_throttle_percentage = cpu_throttle_get_percentage();
     }
 
+    if (dirtylimit_in_service()) {
+        info->has_dirty_limit_throttle_time_per_full = true;
+        info->dirty_limit_throttle_time_per_full =
+                                    dirtylimit_throttle_time_max();
+    }
+
+    if (iteration_counters.pass) {
+        info->has_last_iteration = true;
+        info->last_iteration = ram_get_iteration_stats();
+    }
+
     if (s->state != MIGRATION_STATUS_COMPLETED) {
         info->ram->remaining = ram_bytes_remaining();
         info->ram->dirty_pages_rate = ram_counters.dirty_pages_rate;
@@ -1253,6 +1414,14 @@ static bool migrate_caps_check(bool *cap_list,
          */
         for (idx = 0; idx < check_caps_background_snapshot.size; idx++) {
             int incomp_cap = check_caps_background_snapshot.caps[idx];
+            /*
+             * With mapped-ram the multifd channels release the write
+             * protection of the pages only once they are in the file.
+             */
+            if (incomp_cap == MIGRATION_CAPABILITY_MULTIFD &&
+                cap_list[MIGRATION_CAPABILITY_MAPPED_RAM]) {
+                continue;
+            }
             if (cap_list[incomp_cap]) {
                 error_setg(errp,
                         "Background-snapshot is not compatible with %s",
@@ -1262,6 +1431,83 @@ static bool migrate_caps_check(bool *cap_list,
         }
     }
 
+    if (cap_list[MIGRATION_CAPABILITY_POSTCOPY_PREEMPT] &&
+        !cap_list[MIGRATION_CAPABILITY_POSTCOPY_RAM]) {
+        error_setg(errp, "Postcopy preempt requires postcopy-ram");
+        return false;
+    }
+
+    if (cap_list[MIGRATION_CAPABILITY_POSTCOPY_PREEMPT] &&
+        cap_list[MIGRATION_CAPABILITY_COMPRESS]) {
+        error_setg(errp, "Postcopy preempt is not compatible with compression");
+        return false;
+    }
+
+    if (cap_list[MIGRATION_CAPABILITY_POSTCOPY_HUGETLB_MINOR] &&
+        !cap_list[MIGRATION_CAPABILITY_POSTCOPY_RAM]) {
+        error_setg(errp, "Postcopy hugetlb minor faults require postcopy-ram");
+        return false;
+    }
+
+    if (cap_list[MIGRATION_CAPABILITY_DIRTY_LIMIT]) {
+        if (cap_list[MIGRATION_CAPABILITY_AUTO_CONVERGE]) {
+            error_setg(errp, "dirty-limit is not compatible with "
+                       "auto-converge");
+            return false;
+        }
+        if (!kvm_enabled() || !kvm_dirty_ring_enabled()) {
+            error_setg(errp, "dirty-limit requires KVM with the dirty ring "
+                       "enabled (dirty-ring-size)");
+            return false;
+        }
+    }
+
+    if (cap_list[MIGRATION_CAPABILITY_MAPPED_RAM]) {
+        int idx;
+
+        for (idx = 0; idx < check_caps_mapped_ram.size; idx++) {
+            int incomp_cap = check_caps_mapped_ram.caps[idx];
+            if (cap_list[incomp_cap]) {
+                error_setg(errp, "Mapped-ram is not compatible with %s",
+                           MigrationCapability_str(incomp_cap));
+                return false;
+            }
+        }
+    }
+
+    if (cap_list[MIGRATION_CAPABILITY_MAPPED_RAM_PRIVATE] &&
+        !cap_list[MIGRATION_CAPABILITY_MAPPED_RAM]) {
+        error_setg(errp, "Capability 'mapped-ram-private' requires "
+                   "capability 'mapped-ram'");
+        return false;
+    }
+
+    if (cap_list[MIGRATION_CAPABILITY_SWITCHOVER_ACK] &&
+        !cap_list[MIGRATION_CAPABILITY_RETURN_PATH]) {
+        error_setg(errp, "Capability 'switchover-ack' requires capability "
+                   "'return-path'");
+        return false;
+    }
+
+    if (cap_list[MIGRATION_CAPABILITY_MULTIFD_ZERO_PAGE] &&
+        !cap_list[MIGRATION_CAPABILITY_MULTIFD]) {
+        error_setg(errp, "Multifd zero page detection requires multifd");
+        return false;
+    }
+
+#ifdef CONFIG_LINUX
+    if (cap_list[MIGRATION_CAPABILITY_ZERO_COPY_SEND] &&
+        (!cap_list[MIGRATION_CAPABILITY_MULTIFD] ||
+         cap_list[MIGRATION_CAPABILITY_COMPRESS] ||
+         cap_list[MIGRATION_CAPABILITY_XBZRLE] ||
+         migrate_multifd_compression() ||
+         migrate_use_tls())) {
+        error_setg(errp,
+                   "Zero copy only available for non-compressed non-TLS multifd migration");
+        return false;
+    }
+#endif
+
     return true;
 }
 
@@ -1477,6 +1723,20 @@ static bool migrate_params_check(MigrationParameters *params, Error **errp)
         return false;
     }
 
+    if (params->has_vcpu_dirty_limit && params->vcpu_dirty_limit < 1) {
+        error_setg(errp, QERR_INVALID_PARAMETER_VALUE,
+                   "vcpu_dirty_limit",
+                   "a value greater than 0");
+        return false;
+    }
+
+#ifndef O_DIRECT
+    if (params->has_direct_io && params->direct_io) {
+        error_setg(errp, "O_DIRECT is not supported on this host");
+        return false;
+    }
+#endif
+
     return true;
 }
 
@@ -1576,6 +1836,22 @@ static void migrate_params_test_apply(MigrateSetParameters *params,
         dest->has_block_bitmap_mapping = true;
         dest->block_bitmap_mapping = params->block_bitmap_mapping;
     }
+
+    if (params->has_vcpu_dirty_limit) {
+        dest->vcpu_dirty_limit = params->vcpu_dirty_limit;
+    }
+
+    if (params->has_direct_io) {
+        dest->direct_io = params->direct_io;
+    }
+
+    if (params->has_load_threads) {
+        dest->load_threads = params->load_threads;
+    }
+
+    if (params->has_populate_threads) {
+        dest->populate_threads = params->populate_threads;
+    }
 }
 
 static void migrate_params_apply(MigrateSetParameters *params, Error **errp)
@@ -1698,6 +1974,26 @@ static void migrate_params_apply(MigrateSetParameters *params, Error **errp)
             QAPI_CLONE(BitmapMigrationNodeAliasList,
                        params->block_bitmap_mapping);
     }
+
+    if (params->has_vcpu_dirty_limit) {
+        s->parameters.vcpu_dirty_limit = params->vcpu_dirty_limit;
+        /* Takes effect immediately if the limit is already in service */
+        if (dirtylimit_in_service()) {
+            dirtylimit_set_quota(s->parameters.vcpu_dirty_limit);
+        }
+    }
+
+    if (params->has_direct_io) {
+        s->parameters.direct_io = params->direct_io;
+    }
+
+    if (params->has_load_threads) {
+        s->parameters.load_threads = params->load_threads;
+    }
+
+    if (params->has_populate_threads) {
+        s->parameters.populate_threads = params->populate_threads;
+    }
 }
 
 void qmp_migrate_set_parameters(MigrateSetParameters *params, Error **errp)
@@ -1829,6 +2125,9 @@ static void migrate_fd_cleanup(MigrationState *s)
         qemu_fclose(tmp);
     }
 
+    /* Only left open here if the migration didn't complete */
+    postcopy_preempt_close(s, true);
+
     assert(!migration_is_active(s));
 
     if (s->state == MIGRATION_STATUS_CANCELLING) {
@@ -1842,6 +2141,7 @@ static void migrate_fd_cleanup(MigrationState *s)
     }
     notifier_list_notify(&migration_state_notifiers, s);
     block_cleanup_parameters(s);
+    file_cleanup_outgoing_migration();
     yank_unregister_instance(MIGRATION_YANK_INSTANCE);
 }
 
@@ -1912,6 +2212,13 @@ static void migrate_fd_cancel(MigrationState *s)
     if (s->state == MIGRATION_STATUS_CANCELLING && f) {
         qemu_file_shutdown(f);
     }
+    if (s->state == MIGRATION_STATUS_CANCELLING) {
+        WITH_QEMU_LOCK_GUARD(&s->qemu_file_lock) {
+            if (s->postcopy_qemufile_src) {
+                qemu_file_shutdown(s->postcopy_qemufile_src);
+            }
+        }
+    }
     if (s->state == MIGRATION_STATUS_CANCELLING && s->block_inactive) {
         Error *local_err = NULL;
 
@@ -2031,12 +2338,15 @@ void migrate_init(MigrationState *s)
     s->vm_start_bh = 0;
     s->to_dst_file = NULL;
     s->state = MIGRATION_STATUS_NONE;
+    s->rdma_migration = false;
     s->rp_state.from_dst_file = NULL;
     s->rp_state.error = false;
     s->mbps = 0.0;
     s->pages_per_second = 0.0;
     s->downtime = 0;
     s->expected_downtime = 0;
+    s->stop_copy_size = 0;
+    s->switchover_acked = false;
     s->setup_time = 0;
     s->start_postcopy = false;
     s->postcopy_after_devices = false;
@@ -2250,6 +2560,7 @@ static bool migrate_prepare(MigrationState *s, bool blk, bool blk_inc,
      * new migration
      */
     memset(&ram_counters, 0, sizeof(ram_counters));
+    memset(&iteration_counters, 0, sizeof(iteration_counters));
 
     return true;
 }
@@ -2262,6 +2573,34 @@ void qmp_migrate(const char *uri, bool has_blk, bool blk,
     MigrationState *s = migrate_get_current();
     const char *p = NULL;
 
+    if (migrate_postcopy_preempt()) {
+        if (!strstart(uri, "tcp:", NULL) && !strstart(uri, "unix:", NULL) &&
+            !strstart(uri, "vsock:", NULL)) {
+            error_setg(errp, "Postcopy preempt requires a socket migration");
+            return;
+        }
+        if (migrate_use_tls()) {
+            error_setg(errp, "Postcopy preempt is not compatible with TLS");
+            return;
+        }
+    }
+
+    if (migrate_mapped_ram() && !strstart(uri, "file:", NULL)) {
+        error_setg(errp, "Mapped-ram requires a file migration");
+        return;
+    }
+
+    if (strstart(uri, "rdma:", NULL)) {
+        if (!migrate_rdma_multifd_check(errp)) {
+            return;
+        }
+        if (migrate_use_multifd() &&
+            !s->enabled_capabilities[MIGRATION_CAPABILITY_RDMA_PIN_ALL]) {
+            error_setg(errp, "RDMA multifd requires rdma-pin-all");
+            return;
+        }
+    }
+
     if (!migrate_prepare(s, has_blk && blk, has_inc && inc,
                          has_resume && resume, errp)) {
         /* Error detected, put into errp */
@@ -2286,6 +2625,8 @@ void qmp_migrate(const char *uri, bool has_blk, bool blk,
         exec_start_outgoing_migration(s, p, &local_err);
     } else if (strstart(uri, "fd:", &p)) {
         fd_start_outgoing_migration(s, p, &local_err);
+    } else if (strstart(uri, "file:", &p)) {
+        file_start_outgoing_migration(s, p, &local_err);
     } else {
         if (!(has_resume && resume)) {
             yank_unregister_instance(MIGRATION_YANK_INSTANCE);
@@ -2308,6 +2649,40 @@ void qmp_migrate(const char *uri, bool has_blk, bool blk,
     }
 }
 
+/*
+ * Run a background snapshot into @f rather than into a migration channel.
+ * Live internal snapshots use this to save the VM state into an image.
+ * On success the migration owns @f.
+ */
+bool migrate_start_internal_snapshot(QEMUFile *f, Error **errp)
+{
+    MigrationState *s = migrate_get_current();
+
+    if (!migrate_background_snapshot()) {
+        error_setg(errp, "Live snapshots require the 'background-snapshot' "
+                   "migration capability");
+        return false;
+    }
+    if (migrate_use_multifd() || migrate_mapped_ram()) {
+        error_setg(errp, "Live snapshots are not compatible with the "
+                   "'multifd' and 'mapped-ram' migration capabilities");
+        return false;
+    }
+
+    if (!migrate_prepare(s, false, false, false, errp)) {
+        return false;
+    }
+    if (!yank_register_instance(MIGRATION_YANK_INSTANCE, errp)) {
+        return false;
+    }
+
+    qemu_mutex_lock(&s->qemu_file_lock);
+    s->to_dst_file = f;
+    qemu_mutex_unlock(&s->qemu_file_lock);
+    migrate_fd_connect(s, NULL);
+    return true;
+}
+
 void qmp_migrate_cancel(Error **errp)
 {
     migrate_fd_cancel(migrate_get_current());
@@ -2342,6 +2717,69 @@ bool migrate_postcopy_ram(void)
     return s->enabled_capabilities[MIGRATION_CAPABILITY_POSTCOPY_RAM];
 }
 
+bool migrate_postcopy_preempt(void)
+{
+    MigrationState *s;
+
+    s = migrate_get_current();
+
+    return s->enabled_capabilities[MIGRATION_CAPABILITY_POSTCOPY_PREEMPT];
+}
+
+bool migrate_postcopy_hugetlb_minor(void)
+{
+    MigrationState *s;
+
+    s = migrate_get_current();
+
+    return s->enabled_capabilities[MIGRATION_CAPABILITY_POSTCOPY_HUGETLB_MINOR];
+}
+
+bool migrate_dirty_limit(void)
+{
+    MigrationState *s;
+
+    s = migrate_get_current();
+
+    return s->enabled_capabilities[MIGRATION_CAPABILITY_DIRTY_LIMIT];
+}
+
+bool migrate_mapped_ram(void)
+{
+    MigrationState *s;
+
+    s = migrate_get_current();
+
+    return s->enabled_capabilities[MIGRATION_CAPABILITY_MAPPED_RAM];
+}
+
+bool migrate_mapped_ram_private(void)
+{
+    MigrationState *s;
+
+    s = migrate_get_current();
+
+    return s->enabled_capabilities[MIGRATION_CAPABILITY_MAPPED_RAM_PRIVATE];
+}
+
+bool migrate_switchover_ack(void)
+{
+    MigrationState *s;
+
+    s = migrate_get_current();
+
+    return s->enabled_capabilities[MIGRATION_CAPABILITY_SWITCHOVER_ACK];
+}
+
+bool migrate_rdma(void)
+{
+    MigrationState *s;
+
+    s = migrate_get_current();
+
+    return s->rdma_migration;
+}
+
 bool migrate_postcopy(void)
 {
     return migrate_postcopy_ram() || migrate_dirty_bitmaps();
@@ -2419,6 +2857,24 @@ int migrate_decompress_threads(void)
     return s->parameters.decompress_threads;
 }
 
+int migrate_load_threads(void)
+{
+    MigrationState *s;
+
+    s = migrate_get_current();
+
+    return s->parameters.load_threads;
+}
+
+int migrate_populate_threads(void)
+{
+    MigrationState *s;
+
+    s = migrate_get_current();
+
+    return s->parameters.populate_threads;
+}
+
 bool migrate_dirty_bitmaps(void)
 {
     MigrationState *s;
@@ -2492,6 +2948,52 @@ MultiFDCompression migrate_multifd_compression(void)
     return s->parameters.multifd_compression;
 }
 
+bool migrate_use_multifd_zero_page(void)
+{
+    MigrationState *s;
+
+    s = migrate_get_current();
+
+    return s->enabled_capabilities[MIGRATION_CAPABILITY_MULTIFD_ZERO_PAGE];
+}
+
+bool migrate_use_multifd_xbzrle(void)
+{
+    return migrate_use_multifd() &&
+           migrate_multifd_compression() == MULTIFD_COMPRESSION_XBZRLE;
+}
+
+bool migrate_use_zero_copy_send(void)
+{
+#ifdef CONFIG_LINUX
+    MigrationState *s;
+
+    s = migrate_get_current();
+
+    return s->enabled_capabilities[MIGRATION_CAPABILITY_ZERO_COPY_SEND];
+#else
+    return false;
+#endif
+}
+
+bool migrate_use_tls(void)
+{
+    MigrationState *s;
+
+    s = migrate_get_current();
+
+    return s->parameters.tls_creds && *s->parameters.tls_creds;
+}
+
+bool migrate_direct_io(void)
+{
+    MigrationState *s;
+
+    s = migrate_get_current();
+
+    return s->parameters.direct_io;
+}
+
 int migrate_multifd_zlib_level(void)
 {
     MigrationState *s;
@@ -2594,6 +3096,7 @@ static struct rp_cmd_args {
     [MIG_RP_MSG_REQ_PAGES_ID]   = { .len = -1, .name = "REQ_PAGES_ID" },
     [MIG_RP_MSG_RECV_BITMAP]    = { .len = -1, .name = "RECV_BITMAP" },
     [MIG_RP_MSG_RESUME_ACK]     = { .len =  4, .name = "RESUME_ACK" },
+    [MIG_RP_MSG_SWITCHOVER_ACK] = { .len =  4, .name = "SWITCHOVER_ACK" },
     [MIG_RP_MSG_MAX]            = { .len = -1, .name = "MAX" },
 };
 
@@ -2799,6 +3302,11 @@ retry:
             }
             break;
 
+        case MIG_RP_MSG_SWITCHOVER_ACK:
+            ms->switchover_acked = true;
+            trace_source_return_path_thread_switchover_acked();
+            break;
+
         default:
             break;
         }
@@ -2893,6 +3401,10 @@ static int postcopy_start(MigrationState *ms)
     int64_t bandwidth = migrate_max_postcopy_bandwidth();
     bool restart_block = false;
     int cur_state = MIGRATION_STATUS_ACTIVE;
+
+    /* Connect it before taking the BQL, the destination is still running */
+    postcopy_preempt_setup(ms);
+
     if (!migrate_pause_before_switchover()) {
         migrate_set_state(&ms->state, MIGRATION_STATUS_ACTIVE,
                           MIGRATION_STATUS_POSTCOPY_ACTIVE);
@@ -3143,6 +3655,12 @@ static void migration_completion(MigrationState *s)
         trace_migration_completion_postcopy_end();
 
         qemu_savevm_state_complete_postcopy(s->to_dst_file);
+        /*
+         * Nothing else to send on the preempt channel; close it now so
+         * that the destination preempt thread can quit before it sends
+         * the SHUT on the return path.
+         */
+        postcopy_preempt_close(s, false);
         trace_migration_completion_postcopy_end_after_complete();
     } else if (s->state == MIGRATION_STATUS_CANCELLING) {
         goto fail;
@@ -3324,6 +3842,9 @@ static MigThrError postcopy_pause(MigrationState *s)
         qemu_file_shutdown(file);
         qemu_fclose(file);
 
+        /* After recovery the requested pages go through the main channel */
+        postcopy_preempt_close(s, true);
+
         migrate_set_state(&s->state, s->state,
                           MIGRATION_STATUS_POSTCOPY_PAUSED);
 
@@ -3480,7 +4001,8 @@ static void migration_update_counters(MigrationState *s,
      * recalculate. 10000 is a small enough number for our purposes
      */
     if (ram_counters.dirty_pages_rate && transferred > 10000) {
-        s->expected_downtime = ram_counters.remaining / bandwidth;
+        s->expected_downtime = (ram_counters.remaining + s->stop_copy_size) /
+                               bandwidth;
     }
 
     qemu_file_reset_rate_limit(s->to_dst_file);
@@ -3498,6 +4020,20 @@ typedef enum {
     MIG_ITERATE_BREAK,          /* Break the loop */
 } MigIterateState;
 
+static bool migration_can_switchover(MigrationState *s)
+{
+    if (!migrate_switchover_ack()) {
+        return true;
+    }
+
+    /* No reason to wait for switchover ACK if VM is stopped */
+    if (!runstate_is_running()) {
+        return true;
+    }
+
+    return s->switchover_acked;
+}
+
 /*
  * Return true if continue to the next iteration directly, false
  * otherwise.
@@ -3506,15 +4042,27 @@ static MigIterateState migration_iteration_run(MigrationState *s)
 {
     uint64_t pending_size, pend_pre, pend_compat, pend_post;
     bool in_postcopy = s->state == MIGRATION_STATUS_POSTCOPY_ACTIVE;
+    bool can_switchover = in_postcopy || migration_can_switchover(s);
 
     qemu_savevm_state_pending(s->to_dst_file, s->threshold_size, &pend_pre,
                               &pend_compat, &pend_post);
     pending_size = pend_pre + pend_compat + pend_post;
 
+    /*
+     * Device state that can only be sent with the VM stopped adds to
+     * the downtime just as much as the remaining RAM does.
+     */
+    if (!in_postcopy) {
+        s->stop_copy_size = qemu_savevm_state_stop_copy_size();
+        pending_size += s->stop_copy_size;
+    }
+
     trace_migrate_pending(pending_size, s->threshold_size,
                           pend_pre, pend_compat, pend_post);
+    trace_migrate_pending_stop_copy(s->stop_copy_size, can_switchover);
 
-    if (pending_size && pending_size >= s->threshold_size) {
+    if ((pending_size && pending_size >= s->threshold_size) ||
+        !can_switchover) {
         /* Still a significant amount to transfer */
         if (!in_postcopy && pend_pre <= s->threshold_size &&
             qatomic_read(&s->start_postcopy)) {
@@ -3538,6 +4086,8 @@ static void migration_iteration_finish(MigrationState *s)
 {
     /* If we enabled cpu throttling for auto-converge, turn it off. */
     cpu_throttle_stop();
+    /* Same for the dirty-limit throttle */
+    dirtylimit_set_quota(0);
 
     qemu_mutex_lock_iothread();
     switch (s->state) {
@@ -3888,6 +4438,11 @@ static void *bg_migration_thread(void *opaque)
      */
     qemu_fflush(fb);
 
+    /* A live internal snapshot takes its disk snapshots at this point */
+    if (qemu_savevm_live_snapshot_disks()) {
+        goto fail;
+    }
+
     /* Now initialize UFFD context and start tracking RAM writes */
     if (ram_write_tracking_start()) {
         goto fail;
@@ -4104,6 +4659,17 @@ static Property migration_properties[] = {
     DEFINE_PROP_UINT8("max-cpu-throttle", MigrationState,
                       parameters.max_cpu_throttle,
                       DEFAULT_MIGRATE_MAX_CPU_THROTTLE),
+    DEFINE_PROP_UINT64("vcpu-dirty-limit", MigrationState,
+                      parameters.vcpu_dirty_limit,
+                      DEFAULT_MIGRATE_VCPU_DIRTY_LIMIT),
+    DEFINE_PROP_BOOL("direct-io", MigrationState,
+                      parameters.direct_io, false),
+    DEFINE_PROP_UINT8("load-threads", MigrationState,
+                      parameters.load_threads,
+                      DEFAULT_MIGRATE_LOAD_THREAD_COUNT),
+    DEFINE_PROP_UINT8("populate-threads", MigrationState,
+                      parameters.populate_threads,
+                      DEFAULT_MIGRATE_POPULATE_THREAD_COUNT),
     DEFINE_PROP_SIZE("announce-initial", MigrationState,
                       parameters.announce_initial,
                       DEFAULT_MIGRATE_ANNOUNCE_INITIAL),
@@ -4132,6 +4698,22 @@ static Property migration_properties[] = {
     DEFINE_PROP_MIG_CAP("x-multifd", MIGRATION_CAPABILITY_MULTIFD),
     DEFINE_PROP_MIG_CAP("x-background-snapshot",
             MIGRATION_CAPABILITY_BACKGROUND_SNAPSHOT),
+    DEFINE_PROP_MIG_CAP("x-multifd-zero-page",
+            MIGRATION_CAPABILITY_MULTIFD_ZERO_PAGE),
+    DEFINE_PROP_MIG_CAP("x-postcopy-preempt",
+            MIGRATION_CAPABILITY_POSTCOPY_PREEMPT),
+    DEFINE_PROP_MIG_CAP("x-postcopy-hugetlb-minor",
+            MIGRATION_CAPABILITY_POSTCOPY_HUGETLB_MINOR),
+    DEFINE_PROP_MIG_CAP("x-dirty-limit",
+            MIGRATION_CAPABILITY_DIRTY_LIMIT),
+    DEFINE_PROP_MIG_CAP("x-mapped-ram",
+            MIGRATION_CAPABILITY_MAPPED_RAM),
+    DEFINE_PROP_MIG_CAP("x-mapped-ram-private",
+            MIGRATION_CAPABILITY_MAPPED_RAM_PRIVATE),
+#ifdef CONFIG_LINUX
+    DEFINE_PROP_MIG_CAP("x-zero-copy-send",
+            MIGRATION_CAPABILITY_ZERO_COPY_SEND),
+#endif
 
     DEFINE_PROP_END_OF_LIST(),
 };
@@ -4199,6 +4781,10 @@ static void migration_instance_init(Object *obj)
     params->has_announce_max = true;
     params->has_announce_rounds = true;
     params->has_announce_step = true;
+    params->has_vcpu_dirty_limit = true;
+    params->has_direct_io = true;
+    params->has_load_threads = true;
+    params->has_populate_threads = true;
 
     qemu_sem_init(&ms->postcopy_pause_sem, 0);
     qemu_sem_init(&ms->postcopy_pause_rp_sem, 0);
@@ -45,6 +45,15 @@ struct PostcopyBlocktimeContext;
  */
 #define CLEAR_BITMAP_SHIFT_MAX            31
 
+/* Channels that carry RAM pages while in postcopy */
+typedef enum {
+    /* The main migration channel */
+    RAM_CHANNEL_PRECOPY = 0,
+    /* The postcopy preempt channel, for pages the destination asked for */
+    RAM_CHANNEL_POSTCOPY = 1,
+    RAM_CHANNEL_MAX,
+} RamChannel;
+
 /* State for the incoming migration */
 struct MigrationIncomingState {
     QEMUFile *from_src_file;
@@ -77,8 +86,16 @@ struct MigrationIncomingState {
     QemuMutex rp_mutex;    /* We send replies from multiple threads */
     /* RAMBlock of last request sent to source */
     RAMBlock *last_rb;
-    void     *postcopy_tmp_page;
+    /* Host pages are assembled here before being placed, one per channel */
+    void     *postcopy_tmp_pages[RAM_CHANNEL_MAX];
     void     *postcopy_tmp_zero_page;
+    /* RAMBlock of the last page received on each channel */
+    RAMBlock *last_recv_block[RAM_CHANNEL_MAX];
+
+    /* The postcopy preempt channel, see postcopy-preempt */
+    QEMUFile *postcopy_qemufile_dst;
+    bool      have_preempt_thread;
+    QemuThread postcopy_preempt_thread;
     /* PostCopyFD's for external userfaultfds & handlers of shared memory */
     GArray   *postcopy_remote_fds;
 
@@ -98,6 +115,9 @@ struct MigrationIncomingState {
      * */
     struct PostcopyBlocktimeContext *blocktime_ctx;
 
+    /* Number of handlers that still have to approve the switchover */
+    uint32_t switchover_ack_pending_num;
+
     /* notify PAUSED postcopy incoming migrations to try to continue */
     bool postcopy_recover_triggered;
     QemuSemaphore postcopy_pause_sem_dst;
@@ -164,6 +184,12 @@ struct MigrationState {
      */
     QemuSemaphore rate_limit_sem;
 
+    /*
+     * Channel for the pages requested by the destination during
+     * postcopy, see postcopy-preempt.  Protected by qemu_file_lock.
+     */
+    QEMUFile *postcopy_qemufile_src;
+
     /* pages already send at the beginning of current iteration */
     uint64_t iteration_initial_pages;
 
@@ -203,6 +229,10 @@ struct MigrationState {
     int64_t downtime_start;
     int64_t downtime;
     int64_t expected_downtime;
+    /* State only sent after the VM stops, as of the last iteration */
+    uint64_t stop_copy_size;
+    /* Whether the destination acked the switchover (switchover-ack) */
+    bool switchover_acked;
     bool enabled_capabilities[MIGRATION_CAPABILITY__MAX];
     int64_t setup_time;
     /*
@@ -257,6 +287,8 @@ struct MigrationState {
     bool send_configuration;
     /* Whether we send section footer during migration */
     bool send_section_footer;
+    /* Whether the migration uses an rdma: URI */
+    bool rdma_migration;
 
     /* Needed by postcopy-pause state */
     QemuSemaphore postcopy_pause_sem;
@@ -299,6 +331,7 @@ void migrate_set_error(MigrationState *s, const Error *error);
 void migrate_fd_error(MigrationState *s, const Error *error);
 
 void migrate_fd_connect(MigrationState *s, Error *error_in);
+bool migrate_start_internal_snapshot(QEMUFile *f, Error **errp);
 
 bool migration_is_setup_or_active(int state);
 bool migration_is_running(int state);
@@ -313,6 +346,13 @@ bool migrate_postcopy(void);
 
 bool migrate_release_ram(void);
 bool migrate_postcopy_ram(void);
+bool migrate_postcopy_preempt(void);
+bool migrate_postcopy_hugetlb_minor(void);
+bool migrate_dirty_limit(void);
+bool migrate_mapped_ram(void);
+bool migrate_mapped_ram_private(void);
+bool migrate_switchover_ack(void);
+bool migrate_rdma(void);
 bool migrate_zero_blocks(void);
 bool migrate_dirty_bitmaps(void);
 bool migrate_ignore_shared(void);
@@ -323,6 +363,11 @@ bool migrate_use_multifd(void);
 bool migrate_pause_before_switchover(void);
 int migrate_multifd_channels(void);
 MultiFDCompression migrate_multifd_compression(void);
+bool migrate_use_multifd_zero_page(void);
+bool migrate_use_multifd_xbzrle(void);
+bool migrate_use_zero_copy_send(void);
+bool migrate_use_tls(void);
+bool migrate_direct_io(void);
 int migrate_multifd_zlib_level(void);
 int migrate_multifd_zstd_level(void);
 
@@ -342,6 +387,8 @@ int migrate_compress_level(void);
 int migrate_compress_threads(void);
 int migrate_compress_wait_thread(void);
 int migrate_decompress_threads(void);
+int migrate_load_threads(void);
+int migrate_populate_threads(void);
 bool migrate_use_events(void);
 bool migrate_postcopy_blocktime(void);
 bool migrate_background_snapshot(void);
@@ -358,6 +405,7 @@ int migrate_send_rp_message_req_pages(MigrationIncomingState *mis,
 void migrate_send_rp_recv_bitmap(MigrationIncomingState *mis,
                                  char *block_name);
 void migrate_send_rp_resume_ack(MigrationIncomingState *mis, uint32_t value);
+int migrate_send_rp_switchover_ack(MigrationIncomingState *mis);
 
 void dirty_bitmap_mig_before_vm_start(void);
 void dirty_bitmap_mig_cancel_outgoing(void);
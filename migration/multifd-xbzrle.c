@@ -0,0 +1,520 @@
+/*
+ * Multifd xbzrle encoding implementation
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/rcu.h"
+#include "qemu/bswap.h"
+#include "qemu/thread.h"
+#include "exec/target_page.h"
+#include "exec/ramblock.h"
+#include "qapi/error.h"
+#include "migration.h"
+#include "ram.h"
+#include "page_cache.h"
+#include "xbzrle.h"
+#include "trace.h"
+#include "multifd.h"
+
+/*
+ * Every page of the packet is preceded by one of these bytes.  Raw
+ * pages are followed by the page data, encoded pages by a big endian
+ * 16 bit length and the xbzrle encoded data.
+ */
+#define XBZRLE_PAGE_RAW        0
+#define XBZRLE_PAGE_ENCODED    1
+#define XBZRLE_PAGE_UNCHANGED  2
+
+/* Worst case space needed by one page in the packet */
+#define XBZRLE_PAGE_HEADER_SIZE 3
+
+/*
+ * The cache is split in shards, each with its own lock, so that the
+ * send threads don't serialize on a single lock.  Shards are picked by
+ * chunks of guest RAM the size of a packet, that way the pages of one
+ * packet usually live in the same shard.
+ */
+#define XBZRLE_SHARDS 16
+#define XBZRLE_SHARD_GRANULE MULTIFD_PACKET_SIZE
+
+typedef struct {
+    /* protects the cache */
+    QemuMutex lock;
+    PageCache *cache;
+} XBZRLEShard;
+
+static struct {
+    XBZRLEShard *shards;
+    unsigned int nr_shards;
+    /* protects xbzrle_counters against concurrent updates */
+    QemuMutex stats_lock;
+    /* it will store a page full of zeros */
+    uint8_t *zero_target_page;
+    /* number of send channels set up */
+    unsigned int users;
+} multifd_xbzrle;
+
+struct xbzrle_data {
+    /* buffer with the pages to send */
+    uint8_t *zbuff;
+    /* size of the buffer */
+    uint32_t zbuff_len;
+    /* copy of the page being encoded */
+    uint8_t *current_buf;
+};
+
+/* Multifd xbzrle encoding */
+
+/**
+ * xbzrle_shard_get: find the cache shard of a page
+ *
+ * Returns the shard that caches @addr, and stores in @shard_addr the
+ * address of the page inside the shard.  Removing the shard index
+ * from the address keeps the shard caches densely used.
+ *
+ * @addr: ram address of the page
+ * @shard_addr: address of the page inside the shard
+ */
+static XBZRLEShard *xbzrle_shard_get(ram_addr_t addr, uint64_t *shard_addr)
+{
+    uint64_t chunk = addr / XBZRLE_SHARD_GRANULE;
+    unsigned int nr_shards = multifd_xbzrle.nr_shards;
+
+    *shard_addr = (chunk / nr_shards) * XBZRLE_SHARD_GRANULE +
+                  addr % XBZRLE_SHARD_GRANULE;
+    return &multifd_xbzrle.shards[chunk % nr_shards];
+}
+
+static void xbzrle_cache_cleanup(void)
+{
+    unsigned int i;
+
+    for (i = 0; i < multifd_xbzrle.nr_shards; i++) {
+        XBZRLEShard *shard = &multifd_xbzrle.shards[i];
+
+        if (shard->cache) {
+            cache_fini(shard->cache);
+        }
+        qemu_mutex_destroy(&shard->lock);
+    }
+    g_free(multifd_xbzrle.shards);
+    multifd_xbzrle.shards = NULL;
+    multifd_xbzrle.nr_shards = 0;
+    g_free(multifd_xbzrle.zero_target_page);
+    multifd_xbzrle.zero_target_page = NULL;
+    qemu_mutex_destroy(&multifd_xbzrle.stats_lock);
+}
+
+/**
+ * xbzrle_cache_setup: create the cache shared by all channels
+ *
+ * The cache uses xbzrle-cache-size bytes in total.
+ *
+ * Returns 0 for success or -1 for error
+ *
+ * @errp: pointer to an error
+ */
+static int xbzrle_cache_setup(Error **errp)
+{
+    size_t page_size = qemu_target_page_size();
+    uint64_t cache_size = migrate_xbzrle_cache_size();
+    unsigned int nr_shards = XBZRLE_SHARDS;
+    unsigned int i;
+
+    while (nr_shards > 1 && cache_size / nr_shards < page_size) {
+        nr_shards /= 2;
+    }
+
+    qemu_mutex_init(&multifd_xbzrle.stats_lock);
+    multifd_xbzrle.zero_target_page = g_malloc0(page_size);
+    multifd_xbzrle.shards = g_new0(XBZRLEShard, nr_shards);
+    multifd_xbzrle.nr_shards = nr_shards;
+    for (i = 0; i < nr_shards; i++) {
+        qemu_mutex_init(&multifd_xbzrle.shards[i].lock);
+    }
+    for (i = 0; i < nr_shards; i++) {
+        XBZRLEShard *shard = &multifd_xbzrle.shards[i];
+
+        shard->cache = cache_init(cache_size / nr_shards, page_size, errp);
+        if (!shard->cache) {
+            xbzrle_cache_cleanup();
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * xbzrle_send_setup: setup send side
+ *
+ * Setup each channel with xbzrle encoding.  The first channel also
+ * creates the page cache.
+ *
+ * Returns 0 for success or -1 for error
+ *
+ * @p: Params for the channel that we are using
+ * @errp: pointer to an error
+ */
+static int xbzrle_send_setup(MultiFDSendParams *p, Error **errp)
+{
+    uint32_t page_count = MULTIFD_PACKET_SIZE / qemu_target_page_size();
+    struct xbzrle_data *x;
+
+    if (!multifd_xbzrle.users && xbzrle_cache_setup(errp)) {
+        return -1;
+    }
+
+    x = g_new0(struct xbzrle_data, 1);
+    x->zbuff_len = page_count *
+                   (XBZRLE_PAGE_HEADER_SIZE + qemu_target_page_size());
+    x->zbuff = g_try_malloc(x->zbuff_len);
+    x->current_buf = g_try_malloc(qemu_target_page_size());
+    if (!x->zbuff || !x->current_buf) {
+        g_free(x->zbuff);
+        g_free(x->current_buf);
+        g_free(x);
+        if (!multifd_xbzrle.users) {
+            xbzrle_cache_cleanup();
+        }
+        error_setg(errp, "multifd %d: out of memory for zbuff", p->id);
+        return -1;
+    }
+    multifd_xbzrle.users++;
+    p->data = x;
+    return 0;
+}
+
+/**
+ * xbzrle_send_cleanup: cleanup send side
+ *
+ * Return memory.  The last channel also frees the page cache.
+ *
+ * @p: Params for the channel that we are using
+ */
+static void xbzrle_send_cleanup(MultiFDSendParams *p, Error **errp)
+{
+    struct xbzrle_data *x = p->data;
+
+    if (!x) {
+        return;
+    }
+    g_free(x->zbuff);
+    x->zbuff = NULL;
+    g_free(x->current_buf);
+    x->current_buf = NULL;
+    g_free(p->data);
+    p->data = NULL;
+
+    if (!--multifd_xbzrle.users) {
+        xbzrle_cache_cleanup();
+    }
+}
+
+/**
+ * xbzrle_send_zero_pages: update the cache with the zero pages
+ *
+ * Zero pages are not sent through xbzrle_send_prepare(), but a stale
+ * copy of them must not stay in the cache.  As a bonus, if the page
+ * wasn't in the cache it gets added.
+ *
+ * @p: Params for the channel that we are using
+ */
+static void xbzrle_send_zero_pages(MultiFDSendParams *p)
+{
+    RAMBlock *block = p->pages->block;
+    uint32_t i;
+
+    /* The first pass through RAM doesn't use the cache */
+    if (p->dirty_sync_count <= 1) {
+        return;
+    }
+
+    for (i = 0; i < p->zero_num; i++) {
+        uint64_t shard_addr;
+        XBZRLEShard *shard = xbzrle_shard_get(block->offset + p->zero[i],
+                                              &shard_addr);
+
+        qemu_mutex_lock(&shard->lock);
+        /* We don't care if this fails to allocate a new cache page */
+        cache_insert(shard->cache, shard_addr,
+                     multifd_xbzrle.zero_target_page, p->dirty_sync_count);
+        qemu_mutex_unlock(&shard->lock);
+    }
+}
+
+/**
+ * xbzrle_send_prepare: prepare date to be able to send
+ *
+ * Create a buffer with all the pages that we are going to send, xbzrle
+ * encoded against the cached copy when there is one.
+ *
+ * Returns 0 for success or -1 for error
+ *
+ * @p: Params for the channel that we are using
+ * @used: number of pages used
+ */
+static int xbzrle_send_prepare(MultiFDSendParams *p, uint32_t used,
+                               Error **errp)
+{
+    struct xbzrle_data *x = p->data;
+    RAMBlock *block = p->pages->block;
+    size_t page_size = qemu_target_page_size();
+    uint64_t age = p->dirty_sync_count;
+    uint64_t pages = 0, bytes = 0, cache_miss = 0, overflow = 0;
+    uint32_t out = 0;
+    uint32_t i;
+
+    for (i = 0; i < used; i++) {
+        uint8_t *page = p->pages->iov[i].iov_base;
+        uint8_t *hdr = x->zbuff + out;
+        uint64_t shard_addr;
+        XBZRLEShard *shard;
+        uint8_t *cached;
+        int len;
+
+        /* The first pass through RAM would only be cache misses */
+        if (age <= 1) {
+            hdr[0] = XBZRLE_PAGE_RAW;
+            memcpy(hdr + 1, page, page_size);
+            out += 1 + page_size;
+            continue;
+        }
+
+        shard = xbzrle_shard_get(block->offset + p->pages->offset[i],
+                                 &shard_addr);
+        qemu_mutex_lock(&shard->lock);
+        if (!cache_is_cached(shard->cache, shard_addr, age)) {
+            cache_miss++;
+            /*
+             * Send the same copy that goes into the cache, the guest
+             * might change the page meanwhile.
+             */
+            hdr[0] = XBZRLE_PAGE_RAW;
+            memcpy(hdr + 1, page, page_size);
+            cache_insert(shard->cache, shard_addr, hdr + 1, age);
+            qemu_mutex_unlock(&shard->lock);
+            out += 1 + page_size;
+            continue;
+        }
+
+        pages++;
+        cached = get_cached_data(shard->cache, shard_addr);
+        memcpy(x->current_buf, page, page_size);
+        len = xbzrle_encode_buffer(cached, x->current_buf, page_size,
+                                   hdr + XBZRLE_PAGE_HEADER_SIZE, page_size);
+        if (len != 0) {
+            memcpy(cached, x->current_buf, page_size);
+        }
+        qemu_mutex_unlock(&shard->lock);
+
+        if (len == 0) {
+            hdr[0] = XBZRLE_PAGE_UNCHANGED;
+            out += 1;
+        } else if (len == -1) {
+            overflow++;
+            bytes += page_size;
+            hdr[0] = XBZRLE_PAGE_RAW;
+            memcpy(hdr + 1, x->current_buf, page_size);
+            out += 1 + page_size;
+        } else {
+            hdr[0] = XBZRLE_PAGE_ENCODED;
+            stw_be_p(hdr + 1, len);
+            bytes += XBZRLE_PAGE_HEADER_SIZE + len;
+            out += XBZRLE_PAGE_HEADER_SIZE + len;
+        }
+    }
+
+    if (age > 1) {
+        qemu_mutex_lock(&multifd_xbzrle.stats_lock);
+        xbzrle_counters.pages += pages;
+        xbzrle_counters.bytes += bytes;
+        xbzrle_counters.cache_miss += cache_miss;
+        xbzrle_counters.overflow += overflow;
+        qemu_mutex_unlock(&multifd_xbzrle.stats_lock);
+    }
+
+    p->next_packet_size = out;
+    p->flags |= MULTIFD_FLAG_XBZRLE;
+
+    return 0;
+}
+
+/**
+ * xbzrle_send_write: do the actual write of the data
+ *
+ * Do the actual write of the encoded buffer.
+ *
+ * Returns 0 for success or -1 for error
+ *
+ * @p: Params for the channel that we are using
+ * @used: number of pages used
+ * @errp: pointer to an error
+ */
+static int xbzrle_send_write(MultiFDSendParams *p, uint32_t used,
+                             Error **errp)
+{
+    struct xbzrle_data *x = p->data;
+
+    return qio_channel_write_all(p->c, (void *)x->zbuff, p->next_packet_size,
+                                 errp);
+}
+
+/**
+ * xbzrle_recv_setup: setup receive side
+ *
+ * Create the receive buffer.
+ *
+ * Returns 0 for success or -1 for error
+ *
+ * @p: Params for the channel that we are using
+ * @errp: pointer to an error
+ */
+static int xbzrle_recv_setup(MultiFDRecvParams *p, Error **errp)
+{
+    uint32_t page_count = MULTIFD_PACKET_SIZE / qemu_target_page_size();
+    struct xbzrle_data *x = g_new0(struct xbzrle_data, 1);
+
+    x->zbuff_len = page_count *
+                   (XBZRLE_PAGE_HEADER_SIZE + qemu_target_page_size());
+    x->zbuff = g_try_malloc(x->zbuff_len);
+    if (!x->zbuff) {
+        g_free(x);
+        error_setg(errp, "multifd %d: out of memory for zbuff", p->id);
+        return -1;
+    }
+    p->data = x;
+    return 0;
+}
+
+/**
+ * xbzrle_recv_cleanup: cleanup receive side
+ *
+ * Return the memory used for the receive buffer.
+ *
+ * @p: Params for the channel that we are using
+ */
+static void xbzrle_recv_cleanup(MultiFDRecvParams *p)
+{
+    struct xbzrle_data *x = p->data;
+
+    g_free(x->zbuff);
+    x->zbuff = NULL;
+    g_free(p->data);
+    p->data = NULL;
+}
+
+/**
+ * xbzrle_recv_pages: read the data from the channel into actual pages
+ *
+ * Read the buffer, and decode it into the actual pages.  Encoded pages
+ * are applied over the page contents we already have.
+ *
+ * Returns 0 for success or -1 for error
+ *
+ * @p: Params for the channel that we are using
+ * @used: number of pages used
+ * @errp: pointer to an error
+ */
+static int xbzrle_recv_pages(MultiFDRecvParams *p, uint32_t used,
+                             Error **errp)
+{
+    uint32_t in_size = p->next_packet_size;
+    uint32_t in_pos = 0;
+    uint32_t flags = p->flags & MULTIFD_FLAG_COMPRESSION_MASK;
+    size_t page_size = qemu_target_page_size();
+    struct xbzrle_data *x = p->data;
+    int ret;
+    uint32_t i;
+
+    if (flags != MULTIFD_FLAG_XBZRLE) {
+        error_setg(errp, "multifd %d: flags received %x flags expected %x",
+                   p->id, flags, MULTIFD_FLAG_XBZRLE);
+        return -1;
+    }
+    if (in_size > x->zbuff_len) {
+        error_setg(errp, "multifd %d: packet size received %u size max %u",
+                   p->id, in_size, x->zbuff_len);
+        return -1;
+    }
+    ret = qio_channel_read_all(p->c, (void *)x->zbuff, in_size, errp);
+
+    if (ret != 0) {
+        return ret;
+    }
+
+    for (i = 0; i < used; i++) {
+        uint8_t *page = p->pages->iov[i].iov_base;
+        uint32_t len;
+
+        if (in_pos >= in_size) {
+            error_setg(errp, "multifd %d: truncated xbzrle packet", p->id);
+            return -1;
+        }
+
+        switch (x->zbuff[in_pos++]) {
+        case XBZRLE_PAGE_RAW:
+            if (in_size - in_pos < page_size) {
+                error_setg(errp, "multifd %d: truncated xbzrle packet",
+                           p->id);
+                return -1;
+            }
+            memcpy(page, x->zbuff + in_pos, page_size);
+            in_pos += page_size;
+            break;
+        case XBZRLE_PAGE_ENCODED:
+            if (in_size - in_pos < 2) {
+                error_setg(errp, "multifd %d: truncated xbzrle packet",
+                           p->id);
+                return -1;
+            }
+            len = lduw_be_p(x->zbuff + in_pos);
+            in_pos += 2;
+            if (len > in_size - in_pos || len > page_size) {
+                error_setg(errp, "multifd %d: xbzrle page size %u exceeds "
+                           "packet", p->id, len);
+                return -1;
+            }
+            if (xbzrle_decode_buffer(x->zbuff + in_pos, len, page,
+                                     page_size) == -1) {
+                error_setg(errp, "multifd %d: failed to decode xbzrle page",
+                           p->id);
+                return -1;
+            }
+            in_pos += len;
+            break;
+        case XBZRLE_PAGE_UNCHANGED:
+            break;
+        default:
+            error_setg(errp, "multifd %d: unknown xbzrle page type %u",
+                       p->id, x->zbuff[in_pos - 1]);
+            return -1;
+        }
+    }
+    if (in_pos != in_size) {
+        error_setg(errp, "multifd %d: packet size received %u size used %u",
+                   p->id, in_size, in_pos);
+        return -1;
+    }
+    return 0;
+}
+
+static MultiFDMethods multifd_xbzrle_ops = {
+    .send_setup = xbzrle_send_setup,
+    .send_cleanup = xbzrle_send_cleanup,
+    .send_prepare = xbzrle_send_prepare,
+    .send_write = xbzrle_send_write,
+    .send_zero_pages = xbzrle_send_zero_pages,
+    .recv_setup = xbzrle_recv_setup,
+    .recv_cleanup = xbzrle_recv_cleanup,
+    .recv_pages = xbzrle_recv_pages
+};
+
+static void multifd_xbzrle_register(void)
+{
+    multifd_register_ops(MULTIFD_COMPRESSION_XBZRLE, &multifd_xbzrle_ops);
+}
+
+migration_init(multifd_xbzrle_register);
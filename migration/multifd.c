@@ -11,7 +11,9 @@
  */
 
 #include "qemu/osdep.h"
+#include "qemu/cutils.h"
 #include "qemu/rcu.h"
+#include "qemu/timer.h"
 #include "exec/target_page.h"
 #include "sysemu/sysemu.h"
 #include "exec/ramblock.h"
@@ -19,7 +21,10 @@
 #include "qapi/error.h"
 #include "ram.h"
 #include "migration.h"
+#include "migration/colo.h"
 #include "socket.h"
+#include "file.h"
+#include "rdma.h"
 #include "tls.h"
 #include "qemu-file.h"
 #include "trace.h"
@@ -95,7 +100,9 @@ static int nocomp_send_prepare(MultiFDSendParams *p, uint32_t used,
 /**
  * nocomp_send_write: do the actual write of the data
  *
- * For no compression we just have to write the data.
+ * For no compression we just have to write the data.  With zero copy
+ * the pages are handed to the kernel by reference and are only
+ * guaranteed to be on the wire after qio_channel_flush().
  *
  * Returns 0 for success or -1 for error
  *
@@ -105,7 +112,8 @@ static int nocomp_send_prepare(MultiFDSendParams *p, uint32_t used,
  */
 static int nocomp_send_write(MultiFDSendParams *p, uint32_t used, Error **errp)
 {
-    return qio_channel_writev_all(p->c, p->pages->iov, used, errp);
+    return qio_channel_writev_full_all(p->c, p->pages->iov, used, NULL, 0,
+                                       p->write_flags, errp);
 }
 
 /**
@@ -271,6 +279,7 @@ static void multifd_send_fill_packet(MultiFDSendParams *p)
     packet->flags = cpu_to_be32(p->flags);
     packet->pages_alloc = cpu_to_be32(p->pages->allocated);
     packet->pages_used = cpu_to_be32(p->pages->used);
+    packet->zero_pages = cpu_to_be32(p->zero_num);
     packet->next_packet_size = cpu_to_be32(p->next_packet_size);
     packet->packet_num = cpu_to_be64(p->packet_num);
 
@@ -284,6 +293,25 @@ static void multifd_send_fill_packet(MultiFDSendParams *p)
 
         packet->offset[i] = cpu_to_be64(temp);
     }
+
+    for (i = 0; i < p->zero_num; i++) {
+        uint64_t temp = p->zero[i];
+
+        packet->offset[p->pages->used + i] = cpu_to_be64(temp);
+    }
+}
+
+/*
+ * Once the secondary VM is running, incoming pages belong to the
+ * checkpoint being built and go into the COLO cache instead of guest RAM.
+ */
+static uint8_t *multifd_recv_host(RAMBlock *block)
+{
+    if (migration_incoming_colo_enabled() &&
+        migration_incoming_in_colo_state()) {
+        return block->colo_cache;
+    }
+    return block->host;
 }
 
 static int multifd_recv_unfill_packet(MultiFDRecvParams *p, Error **errp)
@@ -291,6 +319,7 @@ static int multifd_recv_unfill_packet(MultiFDRecvParams *p, Error **errp)
     MultiFDPacket_t *packet = p->packet;
     uint32_t pages_max = MULTIFD_PACKET_SIZE / qemu_target_page_size();
     RAMBlock *block;
+    uint8_t *host;
     int i;
 
     packet->magic = be32_to_cpu(packet->magic);
@@ -329,20 +358,24 @@ static int multifd_recv_unfill_packet(MultiFDRecvParams *p, Error **errp)
     if (packet->pages_alloc > p->pages->allocated) {
         multifd_pages_clear(p->pages);
         p->pages = multifd_pages_init(packet->pages_alloc);
+        p->zero = g_renew(ram_addr_t, p->zero, packet->pages_alloc);
     }
 
     p->pages->used = be32_to_cpu(packet->pages_used);
-    if (p->pages->used > packet->pages_alloc) {
+    p->zero_num = be32_to_cpu(packet->zero_pages);
+    if (p->pages->used > packet->pages_alloc ||
+        p->zero_num > packet->pages_alloc - p->pages->used) {
         error_setg(errp, "multifd: received packet "
-                   "with %d pages and expected maximum pages are %d",
-                   p->pages->used, packet->pages_alloc) ;
+                   "with %d normal and %d zero pages and expected "
+                   "maximum pages are %d",
+                   p->pages->used, p->zero_num, packet->pages_alloc) ;
         return -1;
     }
 
     p->next_packet_size = be32_to_cpu(packet->next_packet_size);
     p->packet_num = be64_to_cpu(packet->packet_num);
 
-    if (p->pages->used == 0) {
+    if (p->pages->used == 0 && p->zero_num == 0) {
         return 0;
     }
 
@@ -355,6 +388,13 @@ static int multifd_recv_unfill_packet(MultiFDRecvParams *p, Error **errp)
         return -1;
     }
 
+    host = multifd_recv_host(block);
+    if (!host) {
+        error_setg(errp, "multifd: no COLO cache for ram block %s",
+                   block->idstr);
+        return -1;
+    }
+
     for (i = 0; i < p->pages->used; i++) {
         uint64_t offset = be64_to_cpu(packet->offset[i]);
 
@@ -364,13 +404,88 @@ static int multifd_recv_unfill_packet(MultiFDRecvParams *p, Error **errp)
                        offset, block->max_length);
             return -1;
         }
-        p->pages->iov[i].iov_base = block->host + offset;
+        p->pages->offset[i] = offset;
+        p->pages->iov[i].iov_base = host + offset;
         p->pages->iov[i].iov_len = qemu_target_page_size();
+        if (!migration_incoming_in_colo_state()) {
+            ramblock_recv_bitmap_set_offset(block, offset);
+        }
     }
 
+    for (i = 0; i < p->zero_num; i++) {
+        uint64_t offset = be64_to_cpu(packet->offset[p->pages->used + i]);
+
+        if (offset > (block->used_length - qemu_target_page_size())) {
+            error_setg(errp, "multifd: zero page offset too long %" PRIu64
+                       " (max " RAM_ADDR_FMT ")",
+                       offset, block->max_length);
+            return -1;
+        }
+        p->zero[i] = offset;
+    }
+    p->pages->block = block;
+
     return 0;
 }
 
+/*
+ * Zero the pages that the source found to be zero.  A page that was
+ * never received is still the zero page the destination started with,
+ * so it is left alone rather than being faulted in.
+ */
+static void multifd_recv_zero_page_process(MultiFDRecvParams *p)
+{
+    RAMBlock *block = p->pages->block;
+    uint8_t *host = multifd_recv_host(block);
+    size_t page_size = qemu_target_page_size();
+    bool colo = migration_incoming_in_colo_state();
+    uint32_t i;
+
+    for (i = 0; i < p->zero_num; i++) {
+        void *page = host + p->zero[i];
+
+        if (colo || ramblock_recv_bitmap_test_byte_offset(block, p->zero[i])) {
+            if (!buffer_is_zero(page, page_size)) {
+                memset(page, 0, page_size);
+            }
+        } else {
+            ramblock_recv_bitmap_set_offset(block, p->zero[i]);
+        }
+    }
+}
+
+/*
+ * Keep the COLO cache in step with what the channel just loaded.  Before
+ * the first checkpoint pages land in guest RAM and are mirrored into the
+ * cache; afterwards they land in the cache and are recorded in the dirty
+ * bitmap so that colo_flush_ram_cache() copies them back on commit.
+ */
+static void multifd_recv_colo_process(MultiFDRecvParams *p)
+{
+    RAMBlock *block = p->pages->block;
+    size_t page_size = qemu_target_page_size();
+    uint32_t i;
+
+    if (!block->colo_cache) {
+        return;
+    }
+
+    if (migration_incoming_in_colo_state()) {
+        colo_record_bitmap(block, p->pages->offset, p->pages->used);
+        colo_record_bitmap(block, p->zero, p->zero_num);
+        return;
+    }
+
+    for (i = 0; i < p->pages->used; i++) {
+        ram_addr_t offset = p->pages->offset[i];
+
+        memcpy(block->colo_cache + offset, block->host + offset, page_size);
+    }
+    for (i = 0; i < p->zero_num; i++) {
+        memset(block->colo_cache + p->zero[i], 0, page_size);
+    }
+}
+
 struct {
     MultiFDSendParams *params;
     /* array of pages to sent */
@@ -387,6 +502,14 @@ struct {
     int exiting;
     /* multifd ops */
     MultiFDMethods *ops;
+    /* do the send threads detect zero pages */
+    bool zero_page;
+    /* pages are written at their offset in the ramblock file region */
+    bool mapped_ram;
+    /* pages are RDMA written into the destination RAM */
+    bool rdma;
+    /* time the migration thread waited for an idle channel, in us */
+    uint64_t queue_wait_time;
 } *multifd_send_state;
 
 /*
@@ -407,6 +530,27 @@ struct {
  * false.
  */
 
+/*
+ * Zero pages are only found by the send threads, after the pages were
+ * accounted as normal ones by the migration thread.  Fix up the counters.
+ *
+ * Called from the migration thread with p->mutex held.
+ */
+static void multifd_send_account_zero_pages(MultiFDSendParams *p)
+{
+    uint64_t zero = p->zero_pages_unaccounted;
+    uint64_t bytes = zero * qemu_target_page_size();
+
+    if (!zero) {
+        return;
+    }
+    p->zero_pages_unaccounted = 0;
+    ram_counters.duplicate += zero;
+    ram_counters.normal -= zero;
+    ram_counters.multifd_bytes -= bytes;
+    ram_counters.transferred -= bytes;
+}
+
 static int multifd_send_pages(QEMUFile *f)
 {
     int i;
@@ -414,12 +558,16 @@ static int multifd_send_pages(QEMUFile *f)
     MultiFDSendParams *p = NULL; /* make happy gcc */
     MultiFDPages_t *pages = multifd_send_state->pages;
     uint64_t transferred;
+    int64_t wait_start;
 
     if (qatomic_read(&multifd_send_state->exiting)) {
         return -1;
     }
 
+    wait_start = qemu_clock_get_us(QEMU_CLOCK_REALTIME);
     qemu_sem_wait(&multifd_send_state->channels_ready);
+    multifd_send_state->queue_wait_time +=
+        qemu_clock_get_us(QEMU_CLOCK_REALTIME) - wait_start;
     /*
      * next_channel can remain from a previous migration that was
      * using more channels, so ensure it doesn't overflow if the
@@ -445,7 +593,9 @@ static int multifd_send_pages(QEMUFile *f)
     assert(!p->pages->used);
     assert(!p->pages->block);
 
+    multifd_send_account_zero_pages(p);
     p->packet_num = multifd_send_state->packet_num++;
+    p->dirty_sync_count = ram_counters.dirty_sync_count;
     multifd_send_state->pages = p->pages;
     p->pages = pages;
     transferred = ((uint64_t) pages->used) * qemu_target_page_size()
@@ -453,6 +603,7 @@ static int multifd_send_pages(QEMUFile *f)
     qemu_file_update_transfer(f, transferred);
     ram_counters.multifd_bytes += transferred;
     ram_counters.transferred += transferred;
+    p->bytes += transferred;
     qemu_mutex_unlock(&p->mutex);
     qemu_sem_post(&p->sem);
 
@@ -489,6 +640,57 @@ int multifd_queue_page(QEMUFile *f, RAMBlock *block, ram_addr_t offset)
     return 1;
 }
 
+/*
+ * Time in microseconds the migration thread spent waiting for an idle
+ * channel since the start of the migration.
+ */
+uint64_t multifd_send_queue_wait_time(void)
+{
+    if (!migrate_use_multifd() || !multifd_send_state) {
+        return 0;
+    }
+    return multifd_send_state->queue_wait_time;
+}
+
+MultiFDChannelStatsList *multifd_send_channel_stats(void)
+{
+    MultiFDChannelStatsList *list = NULL;
+    int i;
+
+    if (!migrate_use_multifd() || !multifd_send_state) {
+        return NULL;
+    }
+
+    for (i = migrate_multifd_channels() - 1; i >= 0; i--) {
+        MultiFDSendParams *p = &multifd_send_state->params[i];
+        MultiFDChannelStats *stats = g_new0(MultiFDChannelStats, 1);
+
+        stats->id = p->id;
+        WITH_QEMU_LOCK_GUARD(&p->mutex) {
+            stats->packets = p->num_packets;
+            stats->pages = p->num_pages;
+            stats->bytes = p->bytes;
+            stats->cpu_time = p->cpu_time;
+        }
+        QAPI_LIST_PREPEND(list, stats);
+    }
+
+    return list;
+}
+
+/*
+ * Hand the pages queued so far to a channel without waiting for the
+ * packet to fill up.  Used for pages a vCPU is blocked on.
+ */
+int multifd_queue_flush(QEMUFile *f)
+{
+    if (!multifd_send_state->pages->used) {
+        return 0;
+    }
+
+    return multifd_send_pages(f) < 0 ? -1 : 0;
+}
+
 static void multifd_send_terminate_threads(Error *err)
 {
     int i;
@@ -527,6 +729,15 @@ static void multifd_send_terminate_threads(Error *err)
     }
 }
 
+static void multifd_send_channel_destroy(QIOChannel *c)
+{
+    if (multifd_send_state->mapped_ram || multifd_send_state->rdma) {
+        object_unref(OBJECT(c));
+    } else {
+        socket_send_channel_destroy(c);
+    }
+}
+
 void multifd_save_cleanup(void)
 {
     int i;
@@ -546,7 +757,7 @@ void multifd_save_cleanup(void)
         MultiFDSendParams *p = &multifd_send_state->params[i];
         Error *local_err = NULL;
 
-        socket_send_channel_destroy(p->c);
+        multifd_send_channel_destroy(p->c);
         p->c = NULL;
         qemu_mutex_destroy(&p->mutex);
         qemu_sem_destroy(&p->sem);
@@ -560,6 +771,8 @@ void multifd_save_cleanup(void)
         p->packet_len = 0;
         g_free(p->packet);
         p->packet = NULL;
+        g_free(p->zero);
+        p->zero = NULL;
         multifd_send_state->ops->send_cleanup(p, &local_err);
         if (local_err) {
             migrate_set_error(migrate_get_current(), local_err);
@@ -575,6 +788,29 @@ void multifd_save_cleanup(void)
     multifd_send_state = NULL;
 }
 
+/*
+ * Wait for every page queued with QIO_CHANNEL_WRITE_FLAG_ZERO_COPY on
+ * @c to be on the wire.  Pages re-dirtied after this point can then be
+ * sent again safely in the next round.
+ */
+static int multifd_zero_copy_flush(QIOChannel *c)
+{
+    int ret;
+    Error *err = NULL;
+
+    ret = qio_channel_flush(c, &err);
+    if (ret < 0) {
+        multifd_send_terminate_threads(err);
+        error_free(err);
+        return -1;
+    }
+    if (ret == 1) {
+        ram_counters.dirty_sync_missed_zero_copy++;
+    }
+
+    return ret;
+}
+
 void multifd_send_sync_main(QEMUFile *f)
 {
     int i;
@@ -607,6 +843,7 @@ void multifd_send_sync_main(QEMUFile *f)
         qemu_file_update_transfer(f, p->packet_len);
         ram_counters.multifd_bytes += p->packet_len;
         ram_counters.transferred += p->packet_len;
+        p->bytes += p->packet_len;
         qemu_mutex_unlock(&p->mutex);
         qemu_sem_post(&p->sem);
     }
@@ -615,10 +852,116 @@ void multifd_send_sync_main(QEMUFile *f)
 
         trace_multifd_send_sync_main_wait(p->id);
         qemu_sem_wait(&p->sem_sync);
+
+        qemu_mutex_lock(&p->mutex);
+        multifd_send_account_zero_pages(p);
+        qemu_mutex_unlock(&p->mutex);
+
+        if (p->write_flags & QIO_CHANNEL_WRITE_FLAG_ZERO_COPY && p->c &&
+            multifd_zero_copy_flush(p->c) < 0) {
+            return;
+        }
     }
     trace_multifd_send_sync_main(multifd_send_state->packet_num);
 }
 
+/*
+ * Move the zero pages of the current packet out of p->pages and into
+ * p->zero, so that only their offsets go on the wire.
+ *
+ * Called with p->mutex held.
+ */
+static void multifd_send_zero_page_detect(MultiFDSendParams *p)
+{
+    MultiFDPages_t *pages = p->pages;
+    RAMBlock *block = pages->block;
+    size_t page_size = qemu_target_page_size();
+    uint32_t i, normal = 0;
+
+    for (i = 0; i < pages->used; i++) {
+        ram_addr_t offset = pages->offset[i];
+
+        if (buffer_is_zero(block->host + offset, page_size)) {
+            p->zero[p->zero_num++] = offset;
+        } else {
+            pages->offset[normal] = offset;
+            pages->iov[normal] = pages->iov[i];
+            normal++;
+        }
+    }
+    pages->used = normal;
+    p->num_zero_pages += p->zero_num;
+    p->zero_pages_unaccounted += p->zero_num;
+}
+
+/*
+ * Write the pages of the current packet at their place in the file.
+ * Runs of contiguous pages go out in a single pwritev.  Once a page is
+ * in the file its bit is set and, for a background snapshot, the vCPUs
+ * may write to it again.
+ */
+static int multifd_file_write_pages(MultiFDSendParams *p, RAMBlock *block,
+                                    uint32_t used, Error **errp)
+{
+    MultiFDPages_t *pages = p->pages;
+    size_t page_size = qemu_target_page_size();
+    uint32_t i, j, start = 0;
+    int ret;
+
+    for (i = 0; i < p->zero_num; i++) {
+        clear_bit_atomic(p->zero[i] / page_size, block->file_bmap);
+        ret = ram_write_tracking_release(block, p->zero[i], page_size);
+        if (ret < 0) {
+            error_setg_errno(errp, -ret, "multifd %d: failed to release "
+                             "write protection", p->id);
+            return -1;
+        }
+    }
+
+    for (i = 1; i <= used; i++) {
+        ram_addr_t offset = pages->offset[start];
+        uint32_t run = i - start;
+
+        if (i < used && pages->offset[i] == pages->offset[i - 1] + page_size) {
+            continue;
+        }
+
+        ret = qio_channel_pwritev_all(p->c, &pages->iov[start], run,
+                                      block->pages_offset + offset, errp);
+        if (ret != 0) {
+            return -1;
+        }
+        for (j = start; j < i; j++) {
+            set_bit_atomic(pages->offset[j] / page_size, block->file_bmap);
+        }
+        ret = ram_write_tracking_release(block, offset, run * page_size);
+        if (ret < 0) {
+            error_setg_errno(errp, -ret, "multifd %d: failed to release "
+                             "write protection", p->id);
+            return -1;
+        }
+        start = i;
+    }
+
+    return 0;
+}
+
+/*
+ * CPU time used by the calling thread in microseconds, 0 where the
+ * host doesn't report it.
+ */
+static uint64_t multifd_thread_cpu_time(void)
+{
+#ifdef CLOCK_THREAD_CPUTIME_ID
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0) {
+        return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+    }
+#endif
+    return 0;
+}
+
 static void *multifd_send_thread(void *opaque)
 {
     MultiFDSendParams *p = opaque;
@@ -629,12 +972,18 @@ static void *multifd_send_thread(void *opaque)
     trace_multifd_send_thread_start(p->id);
     rcu_register_thread();
 
-    if (multifd_send_initial_packet(p, &local_err) < 0) {
-        ret = -1;
-        goto out;
+    /*
+     * Neither the file nor RDMA have use for the handshake, there is
+     * nobody reading the channels on the other side.
+     */
+    if (!multifd_send_state->mapped_ram && !multifd_send_state->rdma) {
+        if (multifd_send_initial_packet(p, &local_err) < 0) {
+            ret = -1;
+            goto out;
+        }
+        /* initial packet */
+        p->num_packets = 1;
     }
-    /* initial packet */
-    p->num_packets = 1;
 
     while (true) {
         qemu_sem_wait(&p->sem);
@@ -645,11 +994,22 @@ static void *multifd_send_thread(void *opaque)
         qemu_mutex_lock(&p->mutex);
 
         if (p->pending_job) {
-            uint32_t used = p->pages->used;
+            RAMBlock *block = p->pages->block;
+            uint32_t used;
             uint64_t packet_num = p->packet_num;
             flags = p->flags;
 
-            if (used) {
+            p->zero_num = 0;
+            if (p->pages->used && multifd_send_state->zero_page) {
+                multifd_send_zero_page_detect(p);
+                if (p->zero_num && multifd_send_state->ops->send_zero_pages) {
+                    multifd_send_state->ops->send_zero_pages(p);
+                }
+            }
+            used = p->pages->used;
+
+            if (used && !multifd_send_state->mapped_ram &&
+                !multifd_send_state->rdma) {
                 ret = multifd_send_state->ops->send_prepare(p, used,
                                                             &local_err);
                 if (ret != 0) {
@@ -657,32 +1017,57 @@ static void *multifd_send_thread(void *opaque)
                     break;
                 }
             }
-            multifd_send_fill_packet(p);
+            if (!multifd_send_state->mapped_ram && !multifd_send_state->rdma) {
+                multifd_send_fill_packet(p);
+                p->num_packets++;
+            }
             p->flags = 0;
-            p->num_packets++;
             p->num_pages += used;
             p->pages->used = 0;
             p->pages->block = NULL;
             qemu_mutex_unlock(&p->mutex);
 
-            trace_multifd_send(p->id, packet_num, used, flags,
+            trace_multifd_send(p->id, packet_num, used, p->zero_num, flags,
                                p->next_packet_size);
 
-            ret = qio_channel_write_all(p->c, (void *)p->packet,
-                                        p->packet_len, &local_err);
-            if (ret != 0) {
-                break;
-            }
-
-            if (used) {
-                ret = multifd_send_state->ops->send_write(p, used, &local_err);
+            if (multifd_send_state->mapped_ram) {
+                if (block &&
+                    multifd_file_write_pages(p, block, used, &local_err)) {
+                    ret = -1;
+                    break;
+                }
+            } else if (multifd_send_state->rdma) {
+                if (used &&
+                    rdma_multifd_write_pages(p->c, block, p->pages->offset,
+                                             used, &local_err)) {
+                    ret = -1;
+                    break;
+                }
+                /* the pages must have landed before the round ends */
+                if ((flags & MULTIFD_FLAG_SYNC) &&
+                    rdma_multifd_flush(p->c, &local_err)) {
+                    ret = -1;
+                    break;
+                }
+            } else {
+                ret = qio_channel_write_all(p->c, (void *)p->packet,
+                                            p->packet_len, &local_err);
                 if (ret != 0) {
                     break;
                 }
+
+                if (used) {
+                    ret = multifd_send_state->ops->send_write(p, used,
+                                                              &local_err);
+                    if (ret != 0) {
+                        break;
+                    }
+                }
             }
 
             qemu_mutex_lock(&p->mutex);
             p->pending_job--;
+            p->cpu_time = multifd_thread_cpu_time();
             qemu_mutex_unlock(&p->mutex);
 
             if (flags & MULTIFD_FLAG_SYNC) {
@@ -719,7 +1104,8 @@ out:
     qemu_mutex_unlock(&p->mutex);
 
     rcu_unregister_thread();
-    trace_multifd_send_thread_end(p->id, p->num_packets, p->num_pages);
+    trace_multifd_send_thread_end(p->id, p->num_packets, p->num_pages,
+                                  p->num_zero_pages);
 
     return NULL;
 }
@@ -850,6 +1236,12 @@ static void multifd_new_send_channel_async(QIOTask *task, gpointer opaque)
     trace_multifd_new_send_channel_async(p->id);
     if (qio_task_propagate_error(task, &local_err)) {
         goto cleanup;
+    } else if ((p->write_flags & QIO_CHANNEL_WRITE_FLAG_ZERO_COPY) &&
+               !qio_channel_has_feature(sioc,
+                                        QIO_CHANNEL_FEATURE_WRITE_ZERO_COPY)) {
+        error_setg(&local_err, "multifd %d: zero copy send is not "
+                   "supported by the host", p->id);
+        goto cleanup;
     } else {
         p->c = QIO_CHANNEL(sioc);
         qio_channel_set_delay(p->c, false);
@@ -864,6 +1256,17 @@ cleanup:
     multifd_new_send_channel_cleanup(p, sioc, local_err);
 }
 
+static void multifd_send_channel_create(MultiFDSendParams *p)
+{
+    if (multifd_send_state->mapped_ram) {
+        file_send_channel_create(multifd_new_send_channel_async, p);
+    } else if (multifd_send_state->rdma) {
+        rdma_send_channel_create(multifd_new_send_channel_async, p);
+    } else {
+        socket_send_channel_create(multifd_new_send_channel_async, p);
+    }
+}
+
 int multifd_save_setup(Error **errp)
 {
     int thread_count;
@@ -882,6 +1285,11 @@ int multifd_save_setup(Error **errp)
     qemu_sem_init(&multifd_send_state->channels_ready, 0);
     qatomic_set(&multifd_send_state->exiting, 0);
     multifd_send_state->ops = multifd_ops[migrate_multifd_compression()];
+    multifd_send_state->mapped_ram = migrate_mapped_ram();
+    multifd_send_state->rdma = migrate_rdma();
+    multifd_send_state->zero_page = migrate_use_multifd_zero_page() ||
+                                    migrate_use_multifd_xbzrle() ||
+                                    multifd_send_state->mapped_ram;
 
     for (i = 0; i < thread_count; i++) {
         MultiFDSendParams *p = &multifd_send_state->params[i];
@@ -893,14 +1301,22 @@ int multifd_save_setup(Error **errp)
         p->pending_job = 0;
         p->id = i;
         p->pages = multifd_pages_init(page_count);
-        p->packet_len = sizeof(MultiFDPacket_t)
-                      + sizeof(uint64_t) * page_count;
-        p->packet = g_malloc0(p->packet_len);
-        p->packet->magic = cpu_to_be32(MULTIFD_MAGIC);
-        p->packet->version = cpu_to_be32(MULTIFD_VERSION);
+        p->zero = g_new0(ram_addr_t, page_count);
+        if (!multifd_send_state->mapped_ram && !multifd_send_state->rdma) {
+            p->packet_len = sizeof(MultiFDPacket_t)
+                          + sizeof(uint64_t) * page_count;
+            p->packet = g_malloc0(p->packet_len);
+            p->packet->magic = cpu_to_be32(MULTIFD_MAGIC);
+            p->packet->version = cpu_to_be32(MULTIFD_VERSION);
+        }
         p->name = g_strdup_printf("multifdsend_%d", i);
         p->tls_hostname = g_strdup(s->hostname);
-        socket_send_channel_create(multifd_new_send_channel_async, p);
+        if (migrate_use_zero_copy_send()) {
+            p->write_flags = QIO_CHANNEL_WRITE_FLAG_ZERO_COPY;
+        } else {
+            p->write_flags = 0;
+        }
+        multifd_send_channel_create(p);
     }
 
     for (i = 0; i < thread_count; i++) {
@@ -927,6 +1343,14 @@ struct {
     uint64_t packet_num;
     /* multifd ops */
     MultiFDMethods *ops;
+    /* pages are read from their offset in the ramblock file region */
+    bool mapped_ram;
+    /* pages are RDMA written by the source, the channels stay idle */
+    bool rdma;
+    /* array of pages to read, only used with mapped-ram */
+    MultiFDPages_t *pages;
+    /* idle recv channels, only used with mapped-ram */
+    QemuSemaphore channels_ready;
 } *multifd_recv_state;
 
 static void multifd_recv_terminate_threads(Error *err)
@@ -956,7 +1380,9 @@ static void multifd_recv_terminate_threads(Error *err)
          *  - error quit: We close the channels so the channel threads
          *    finish the qio_channel_read_all_eof()
          */
-        if (p->c) {
+        if (multifd_recv_state->mapped_ram) {
+            qemu_sem_post(&p->sem);
+        } else if (p->c) {
             qio_channel_shutdown(p->c, QIO_CHANNEL_SHUTDOWN_BOTH, NULL);
         }
         qemu_mutex_unlock(&p->mutex);
@@ -981,6 +1407,7 @@ int multifd_load_cleanup(Error **errp)
              * however try to wakeup it without harm in cleanup phase.
              */
             qemu_sem_post(&p->sem_sync);
+            qemu_sem_post(&p->sem);
             qemu_thread_join(&p->thread);
         }
     }
@@ -997,6 +1424,7 @@ int multifd_load_cleanup(Error **errp)
         object_unref(OBJECT(p->c));
         p->c = NULL;
         qemu_mutex_destroy(&p->mutex);
+        qemu_sem_destroy(&p->sem);
         qemu_sem_destroy(&p->sem_sync);
         g_free(p->name);
         p->name = NULL;
@@ -1005,9 +1433,14 @@ int multifd_load_cleanup(Error **errp)
         p->packet_len = 0;
         g_free(p->packet);
         p->packet = NULL;
+        g_free(p->zero);
+        p->zero = NULL;
         multifd_recv_state->ops->recv_cleanup(p);
     }
     qemu_sem_destroy(&multifd_recv_state->sem_sync);
+    qemu_sem_destroy(&multifd_recv_state->channels_ready);
+    multifd_pages_clear(multifd_recv_state->pages);
+    multifd_recv_state->pages = NULL;
     g_free(multifd_recv_state->params);
     multifd_recv_state->params = NULL;
     g_free(multifd_recv_state);
@@ -1020,7 +1453,12 @@ void multifd_recv_sync_main(void)
 {
     int i;
 
-    if (!migrate_use_multifd()) {
+    /*
+     * With mapped-ram the pages are read in multifd_recv_sync_pages(),
+     * with RDMA they are already in place when the source ends a round.
+     */
+    if (!migrate_use_multifd() || multifd_recv_state->mapped_ram ||
+        multifd_recv_state->rdma) {
         return;
     }
     for (i = 0; i < migrate_multifd_channels(); i++) {
@@ -1080,10 +1518,11 @@ static void *multifd_recv_thread(void *opaque)
         flags = p->flags;
         /* recv methods don't know how to handle the SYNC flag */
         p->flags &= ~MULTIFD_FLAG_SYNC;
-        trace_multifd_recv(p->id, p->packet_num, used, flags,
+        trace_multifd_recv(p->id, p->packet_num, used, p->zero_num, flags,
                            p->next_packet_size);
         p->num_packets++;
         p->num_pages += used;
+        p->num_zero_pages += p->zero_num;
         qemu_mutex_unlock(&p->mutex);
 
         if (used) {
@@ -1093,6 +1532,14 @@ static void *multifd_recv_thread(void *opaque)
             }
         }
 
+        if (p->zero_num) {
+            multifd_recv_zero_page_process(p);
+        }
+
+        if (migration_incoming_colo_enabled() && (used || p->zero_num)) {
+            multifd_recv_colo_process(p);
+        }
+
         if (flags & MULTIFD_FLAG_SYNC) {
             qemu_sem_post(&multifd_recv_state->sem_sync);
             qemu_sem_wait(&p->sem_sync);
@@ -1108,7 +1555,198 @@ static void *multifd_recv_thread(void *opaque)
     qemu_mutex_unlock(&p->mutex);
 
     rcu_unregister_thread();
-    trace_multifd_recv_thread_end(p->id, p->num_packets, p->num_pages);
+    trace_multifd_recv_thread_end(p->id, p->num_packets, p->num_pages,
+                                  p->num_zero_pages);
+
+    return NULL;
+}
+
+static int multifd_recv_pages(void)
+{
+    int i;
+    static int next_recv_channel;
+    MultiFDRecvParams *p = NULL;
+    MultiFDPages_t *pages = multifd_recv_state->pages;
+
+    qemu_sem_wait(&multifd_recv_state->channels_ready);
+    next_recv_channel %= migrate_multifd_channels();
+    for (i = next_recv_channel;; i = (i + 1) % migrate_multifd_channels()) {
+        p = &multifd_recv_state->params[i];
+
+        qemu_mutex_lock(&p->mutex);
+        if (p->quit) {
+            error_report("%s: channel %d has already quit!", __func__, i);
+            qemu_mutex_unlock(&p->mutex);
+            return -1;
+        }
+        if (!p->pending_job) {
+            p->pending_job++;
+            next_recv_channel = (i + 1) % migrate_multifd_channels();
+            break;
+        }
+        qemu_mutex_unlock(&p->mutex);
+    }
+    assert(!p->pages->used);
+    assert(!p->pages->block);
+
+    multifd_recv_state->pages = p->pages;
+    p->pages = pages;
+    qemu_mutex_unlock(&p->mutex);
+    qemu_sem_post(&p->sem);
+
+    return 0;
+}
+
+/*
+ * Queue one page to be read from the file by the recv channels.
+ *
+ * Returns 0 for success or -1 for error
+ */
+int multifd_recv_queue_page(RAMBlock *block, ram_addr_t offset)
+{
+    MultiFDPages_t *pages = multifd_recv_state->pages;
+
+    if (!pages->block) {
+        pages->block = block;
+    }
+
+    if (pages->block == block) {
+        pages->offset[pages->used] = offset;
+        pages->iov[pages->used].iov_base = block->host + offset;
+        pages->iov[pages->used].iov_len = qemu_target_page_size();
+        pages->used++;
+
+        if (pages->used < pages->allocated) {
+            return 0;
+        }
+    }
+
+    if (multifd_recv_pages() < 0) {
+        return -1;
+    }
+
+    if (pages->block != block) {
+        return multifd_recv_queue_page(block, offset);
+    }
+
+    return 0;
+}
+
+/*
+ * Wait until the recv channels have read every queued page.
+ *
+ * Returns 0 for success or -1 if a channel failed
+ */
+int multifd_recv_sync_pages(void)
+{
+    int i, ret = 0;
+
+    if (multifd_recv_state->pages->used && multifd_recv_pages() < 0) {
+        return -1;
+    }
+
+    for (i = 0; i < migrate_multifd_channels(); i++) {
+        qemu_sem_wait(&multifd_recv_state->channels_ready);
+    }
+    for (i = 0; i < migrate_multifd_channels(); i++) {
+        MultiFDRecvParams *p = &multifd_recv_state->params[i];
+
+        WITH_QEMU_LOCK_GUARD(&p->mutex) {
+            if (p->quit) {
+                ret = -1;
+            }
+        }
+        qemu_sem_post(&multifd_recv_state->channels_ready);
+    }
+
+    return ret;
+}
+
+/*
+ * Read the pages of the current job from their place in the file.
+ * Runs of contiguous pages are read with a single preadv.
+ */
+static int multifd_file_read_pages(MultiFDRecvParams *p, RAMBlock *block,
+                                   uint32_t used, Error **errp)
+{
+    MultiFDPages_t *pages = p->pages;
+    size_t page_size = qemu_target_page_size();
+    uint32_t i, start = 0;
+
+    for (i = 1; i <= used; i++) {
+        if (i < used && pages->offset[i] == pages->offset[i - 1] + page_size) {
+            continue;
+        }
+        if (qio_channel_preadv_all(p->c, &pages->iov[start], i - start,
+                                   block->pages_offset + pages->offset[start],
+                                   errp) != 0) {
+            return -1;
+        }
+        start = i;
+    }
+
+    return 0;
+}
+
+static void *multifd_file_recv_thread(void *opaque)
+{
+    MultiFDRecvParams *p = opaque;
+    Error *local_err = NULL;
+    int ret = 0;
+
+    trace_multifd_recv_thread_start(p->id);
+    rcu_register_thread();
+
+    while (true) {
+        RAMBlock *block;
+        uint32_t used;
+
+        qemu_sem_wait(&p->sem);
+
+        qemu_mutex_lock(&p->mutex);
+        if (p->quit) {
+            qemu_mutex_unlock(&p->mutex);
+            break;
+        }
+        if (!p->pending_job) {
+            /* sometimes there are spurious wakeups */
+            qemu_mutex_unlock(&p->mutex);
+            continue;
+        }
+        block = p->pages->block;
+        used = p->pages->used;
+        qemu_mutex_unlock(&p->mutex);
+
+        ret = multifd_file_read_pages(p, block, used, &local_err);
+
+        qemu_mutex_lock(&p->mutex);
+        p->num_packets++;
+        p->num_pages += used;
+        p->pages->used = 0;
+        p->pages->block = NULL;
+        p->pending_job--;
+        if (ret) {
+            p->quit = true;
+        }
+        qemu_mutex_unlock(&p->mutex);
+        qemu_sem_post(&multifd_recv_state->channels_ready);
+
+        if (ret) {
+            break;
+        }
+    }
+
+    if (local_err) {
+        multifd_recv_terminate_threads(local_err);
+        error_free(local_err);
+    }
+    qemu_mutex_lock(&p->mutex);
+    p->running = false;
+    qemu_mutex_unlock(&p->mutex);
+
+    rcu_unregister_thread();
+    trace_multifd_recv_thread_end(p->id, p->num_packets, p->num_pages,
+                                  p->num_zero_pages);
 
     return NULL;
 }
@@ -1128,15 +1766,22 @@ int multifd_load_setup(Error **errp)
     qatomic_set(&multifd_recv_state->count, 0);
     qemu_sem_init(&multifd_recv_state->sem_sync, 0);
     multifd_recv_state->ops = multifd_ops[migrate_multifd_compression()];
+    multifd_recv_state->mapped_ram = migrate_mapped_ram();
+    multifd_recv_state->rdma = migrate_rdma();
+    multifd_recv_state->pages = multifd_pages_init(page_count);
+    qemu_sem_init(&multifd_recv_state->channels_ready, thread_count);
 
     for (i = 0; i < thread_count; i++) {
         MultiFDRecvParams *p = &multifd_recv_state->params[i];
 
         qemu_mutex_init(&p->mutex);
+        qemu_sem_init(&p->sem, 0);
         qemu_sem_init(&p->sem_sync, 0);
         p->quit = false;
+        p->pending_job = 0;
         p->id = i;
         p->pages = multifd_pages_init(page_count);
+        p->zero = g_new0(ram_addr_t, page_count);
         p->packet_len = sizeof(MultiFDPacket_t)
                       + sizeof(uint64_t) * page_count;
         p->packet = g_malloc0(p->packet_len);
@@ -1180,7 +1825,12 @@ bool multifd_recv_new_channel(QIOChannel *ioc, Error **errp)
     Error *local_err = NULL;
     int id;
 
-    id = multifd_recv_initial_packet(ioc, &local_err);
+    if (multifd_recv_state->mapped_ram || multifd_recv_state->rdma) {
+        /* no handshake, the channels are numbered as they are opened */
+        id = qatomic_read(&multifd_recv_state->count);
+    } else {
+        id = multifd_recv_initial_packet(ioc, &local_err);
+    }
     if (id < 0) {
         multifd_recv_terminate_threads(local_err);
         error_propagate_prepend(errp, local_err,
@@ -1204,9 +1854,14 @@ bool multifd_recv_new_channel(QIOChannel *ioc, Error **errp)
     /* initial packet */
     p->num_packets = 1;
 
-    p->running = true;
-    qemu_thread_create(&p->thread, p->name, multifd_recv_thread, p,
-                       QEMU_THREAD_JOINABLE);
+    /* Nothing to do for an RDMA channel but keeping the connection */
+    if (!multifd_recv_state->rdma) {
+        p->running = true;
+        qemu_thread_create(&p->thread, p->name,
+                           multifd_recv_state->mapped_ram ?
+                           multifd_file_recv_thread : multifd_recv_thread,
+                           p, QEMU_THREAD_JOINABLE);
+    }
     qatomic_inc(&multifd_recv_state->count);
     return qatomic_read(&multifd_recv_state->count) ==
            migrate_multifd_channels();
@@ -22,6 +22,11 @@ bool multifd_recv_new_channel(QIOChannel *ioc, Error **errp);
 void multifd_recv_sync_main(void);
 void multifd_send_sync_main(QEMUFile *f);
 int multifd_queue_page(QEMUFile *f, RAMBlock *block, ram_addr_t offset);
+int multifd_queue_flush(QEMUFile *f);
+uint64_t multifd_send_queue_wait_time(void);
+MultiFDChannelStatsList *multifd_send_channel_stats(void);
+int multifd_recv_queue_page(RAMBlock *block, ram_addr_t offset);
+int multifd_recv_sync_pages(void);
 
 /* Multifd Compression flags */
 #define MULTIFD_FLAG_SYNC (1 << 0)
@@ -32,6 +37,8 @@ int multifd_queue_page(QEMUFile *f, RAMBlock *block, ram_addr_t offset);
 #define MULTIFD_FLAG_NOCOMP (0 << 1)
 #define MULTIFD_FLAG_ZLIB (1 << 1)
 #define MULTIFD_FLAG_ZSTD (2 << 1)
+#define MULTIFD_FLAG_LZ4 (3 << 1)
+#define MULTIFD_FLAG_XBZRLE (4 << 1)
 
 /* This value needs to be a multiple of qemu_target_page_size() */
 #define MULTIFD_PACKET_SIZE (512 * 1024)
@@ -46,7 +53,13 @@ typedef struct {
     /* size of the next packet that contains pages */
     uint32_t next_packet_size;
     uint64_t packet_num;
-    uint64_t unused[4];    /* Reserved for future use */
+    /*
+     * number of zero pages; their offsets follow the pages_used
+     * offsets of normal pages in @offset
+     */
+    uint32_t zero_pages;
+    uint32_t unused32[1];    /* Reserved for future use */
+    uint64_t unused64[3];    /* Reserved for future use */
     char ramblock[256];
     uint64_t offset[];
 } __attribute__((packed)) MultiFDPacket_t;
@@ -99,13 +112,29 @@ typedef struct {
     uint32_t next_packet_size;
     /* global number of generated multifd packets */
     uint64_t packet_num;
+    /* dirty bitmap generation the pages were queued in */
+    uint64_t dirty_sync_count;
+    /* bytes handed to this channel */
+    uint64_t bytes;
+    /* CPU time used by the channel thread, in microseconds */
+    uint64_t cpu_time;
     /* thread local variables */
     /* packets sent through this channel */
     uint64_t num_packets;
     /* pages sent through this channel */
     uint64_t num_pages;
+    /* zero pages detected by this channel */
+    uint64_t num_zero_pages;
+    /* zero pages not yet folded into the global ram counters */
+    uint64_t zero_pages_unaccounted;
+    /* offsets of the zero pages found in the current packet */
+    ram_addr_t *zero;
+    /* number of entries in @zero */
+    uint32_t zero_num;
     /* syncs main thread and channels */
     QemuSemaphore sem_sync;
+    /* QIO_CHANNEL_WRITE_FLAG_* used when sending pages */
+    int write_flags;
     /* used for compression methods */
     void *data;
 }  MultiFDSendParams;
@@ -120,12 +149,16 @@ typedef struct {
     QemuThread thread;
     /* communication channel */
     QIOChannel *c;
+    /* sem where to wait for more work, only used with mapped-ram */
+    QemuSemaphore sem;
     /* this mutex protects the following parameters */
     QemuMutex mutex;
     /* is this channel thread running */
     bool running;
     /* should this thread finish */
     bool quit;
+    /* thread has work to do, only used with mapped-ram */
+    int pending_job;
     /* array of pages to receive */
     MultiFDPages_t *pages;
     /* packet allocated len */
@@ -143,6 +176,12 @@ typedef struct {
     uint64_t num_packets;
     /* pages sent through this channel */
     uint64_t num_pages;
+    /* zero pages received through this channel */
+    uint64_t num_zero_pages;
+    /* offsets of the zero pages of the current packet */
+    ram_addr_t *zero;
+    /* number of entries in @zero */
+    uint32_t zero_num;
     /* syncs main thread and channels */
     QemuSemaphore sem_sync;
     /* used for de-compression methods */
@@ -158,6 +197,8 @@ typedef struct {
     int (*send_prepare)(MultiFDSendParams *p, uint32_t used, Error **errp);
     /* Write the send packet */
     int (*send_write)(MultiFDSendParams *p, uint32_t used, Error **errp);
+    /* Optional, told about the zero pages found in the send packet */
+    void (*send_zero_pages)(MultiFDSendParams *p);
     /* Setup for receiving side */
     int (*recv_setup)(MultiFDRecvParams *p, Error **errp);
     /* Cleanup for receiving side */
@@ -18,18 +18,23 @@
 
 #include "qemu/osdep.h"
 #include "exec/target_page.h"
+#include "exec/ramblock.h"
 #include "migration.h"
 #include "qemu-file.h"
+#include "qemu-file-channel.h"
 #include "savevm.h"
 #include "postcopy-ram.h"
 #include "ram.h"
 #include "qapi/error.h"
 #include "qemu/notify.h"
 #include "qemu/rcu.h"
+#include "qemu/yank.h"
 #include "sysemu/sysemu.h"
 #include "qemu/error-report.h"
 #include "trace.h"
 #include "hw/boards.h"
+#include "socket.h"
+#include "yank_functions.h"
 
 /* Arbitrary limit on size of each discard command,
  * keeps them around ~200 bytes
@@ -293,6 +298,11 @@ static bool ufd_check_and_apply(int ufd, MigrationIncomingState *mis)
     }
 #endif
 
+    if (migrate_postcopy_hugetlb_minor() &&
+        UFFD_FEATURE_MINOR_HUGETLBFS & supported_features) {
+        asked_features |= UFFD_FEATURE_MINOR_HUGETLBFS;
+    }
+
     /*
      * request features, even if asked_features is 0, due to
      * kernel expects UFFD_API before UFFDIO_REGISTER, per
@@ -314,6 +324,12 @@ static bool ufd_check_and_apply(int ufd, MigrationIncomingState *mis)
             error_report("Userfault on this host does not support huge pages");
             return false;
         }
+        if (migrate_postcopy_hugetlb_minor() &&
+            !(supported_features & UFFD_FEATURE_MINOR_HUGETLBFS)) {
+            error_report("Userfault on this host does not support minor "
+                         "faults on huge pages");
+            return false;
+        }
     }
     return true;
 }
@@ -499,6 +515,11 @@ static int cleanup_range(RAMBlock *rb, void *opaque)
         return -1;
     }
 
+    if (rb->host_mirror) {
+        munmap(rb->host_mirror, length);
+        rb->host_mirror = NULL;
+    }
+
     return 0;
 }
 
@@ -521,8 +542,13 @@ int postcopy_ram_incoming_init(MigrationIncomingState *mis)
  */
 int postcopy_ram_incoming_cleanup(MigrationIncomingState *mis)
 {
+    int i;
+
     trace_postcopy_ram_incoming_cleanup_entry();
 
+    /* The preempt thread places pages, so it must be gone first */
+    postcopy_preempt_thread_join(mis);
+
     if (mis->have_fault_thread) {
         Error *local_err = NULL;
 
@@ -557,9 +583,11 @@ int postcopy_ram_incoming_cleanup(MigrationIncomingState *mis)
         }
     }
 
-    if (mis->postcopy_tmp_page) {
-        munmap(mis->postcopy_tmp_page, mis->largest_page_size);
-        mis->postcopy_tmp_page = NULL;
+    for (i = 0; i < RAM_CHANNEL_MAX; i++) {
+        if (mis->postcopy_tmp_pages[i]) {
+            munmap(mis->postcopy_tmp_pages[i], mis->largest_page_size);
+            mis->postcopy_tmp_pages[i] = NULL;
+        }
     }
     if (mis->postcopy_tmp_zero_page) {
         munmap(mis->postcopy_tmp_zero_page, mis->largest_page_size);
@@ -618,15 +646,45 @@ int postcopy_ram_prepare_discard(MigrationIncomingState *mis)
  *   opaque: MigrationIncomingState pointer
  * Returns 0 on success
  */
+/*
+ * Shared hugetlbfs blocks can be filled through a second mapping of the
+ * backing file, one target page at a time as the data arrives, and then
+ * mapped into the guest with UFFDIO_CONTINUE.  That saves assembling the
+ * huge page in a bounce buffer and copying all of it with UFFDIO_COPY.
+ */
+static bool postcopy_use_minor_fault(RAMBlock *rb)
+{
+    return migrate_postcopy_hugetlb_minor() && qemu_ram_is_shared(rb) &&
+           rb->fd >= 0 && qemu_ram_pagesize(rb) != qemu_real_host_page_size;
+}
+
 static int ram_block_enable_notify(RAMBlock *rb, void *opaque)
 {
     MigrationIncomingState *mis = opaque;
     struct uffdio_register reg_struct;
+    ram_addr_t length = qemu_ram_get_used_length(rb);
 
     reg_struct.range.start = (uintptr_t)qemu_ram_get_host_addr(rb);
-    reg_struct.range.len = qemu_ram_get_used_length(rb);
+    reg_struct.range.len = length;
     reg_struct.mode = UFFDIO_REGISTER_MODE_MISSING;
 
+    if (postcopy_use_minor_fault(rb)) {
+        void *mirror = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED,
+                            rb->fd, rb->fd_offset);
+
+        if (mirror == MAP_FAILED) {
+            error_report("%s: Failed to map %s mirror: %s", __func__,
+                         qemu_ram_get_idstr(rb), strerror(errno));
+            return -1;
+        }
+        rb->host_mirror = mirror;
+        /*
+         * Pages that are in the file but not mapped in the guest yet
+         * show up as minor faults, the others as missing ones.
+         */
+        reg_struct.mode |= UFFDIO_REGISTER_MODE_MINOR;
+    }
+
     /* Now tell our userfault_fd that it's responsible for this area */
     if (ioctl(mis->userfault_fd, UFFDIO_REGISTER, &reg_struct)) {
         error_report("%s userfault register: %s", __func__, strerror(errno));
@@ -636,6 +694,14 @@ static int ram_block_enable_notify(RAMBlock *rb, void *opaque)
         error_report("%s userfault: Region doesn't support COPY", __func__);
         return -1;
     }
+    if (rb->host_mirror &&
+        !(reg_struct.ioctls & ((__u64)1 << _UFFDIO_CONTINUE))) {
+        error_report("%s userfault: Region doesn't support CONTINUE",
+                     __func__);
+        return -1;
+    }
+    trace_postcopy_ram_enable_notify_block(qemu_ram_get_idstr(rb),
+                                           !!rb->host_mirror);
     if (reg_struct.ioctls & ((__u64)1 << _UFFDIO_ZEROPAGE)) {
         qemu_ram_set_uf_zeroable(rb);
     }
@@ -1055,6 +1121,8 @@ retry:
 
 int postcopy_ram_incoming_setup(MigrationIncomingState *mis)
 {
+    int i;
+
     /* Open the fd for the kernel to give us userfaults */
     mis->userfault_fd = syscall(__NR_userfaultfd, O_CLOEXEC | O_NONBLOCK);
     if (mis->userfault_fd == -1) {
@@ -1093,14 +1161,16 @@ int postcopy_ram_incoming_setup(MigrationIncomingState *mis)
         return -1;
     }
 
-    mis->postcopy_tmp_page = mmap(NULL, mis->largest_page_size,
-                                  PROT_READ | PROT_WRITE, MAP_PRIVATE |
-                                  MAP_ANONYMOUS, -1, 0);
-    if (mis->postcopy_tmp_page == MAP_FAILED) {
-        mis->postcopy_tmp_page = NULL;
-        error_report("%s: Failed to map postcopy_tmp_page %s",
-                     __func__, strerror(errno));
-        return -1;
+    for (i = 0; i < RAM_CHANNEL_MAX; i++) {
+        void *tmp_page = mmap(NULL, mis->largest_page_size,
+                              PROT_READ | PROT_WRITE, MAP_PRIVATE |
+                              MAP_ANONYMOUS, -1, 0);
+        if (tmp_page == MAP_FAILED) {
+            error_report("%s: Failed to map postcopy_tmp_page %s",
+                         __func__, strerror(errno));
+            return -1;
+        }
+        mis->postcopy_tmp_pages[i] = tmp_page;
     }
 
     /*
@@ -1121,6 +1191,9 @@ int postcopy_ram_incoming_setup(MigrationIncomingState *mis)
 
     trace_postcopy_ram_enable_notify();
 
+    /* The preempt channel may have been connected already */
+    postcopy_preempt_thread_start(mis);
+
     return 0;
 }
 
@@ -1130,7 +1203,14 @@ static int qemu_ufd_copy_ioctl(MigrationIncomingState *mis, void *host_addr,
     int userfault_fd = mis->userfault_fd;
     int ret;
 
-    if (from_addr) {
+    if (rb->host_mirror) {
+        /* The data is already in place, we only need to map it */
+        struct uffdio_continue continue_struct;
+        continue_struct.range.start = (uint64_t)(uintptr_t)host_addr;
+        continue_struct.range.len = pagesize;
+        continue_struct.mode = 0;
+        ret = ioctl(userfault_fd, UFFDIO_CONTINUE, &continue_struct);
+    } else if (from_addr) {
         struct uffdio_copy copy_struct;
         copy_struct.dst = (uint64_t)(uintptr_t)host_addr;
         copy_struct.src = (uint64_t)(uintptr_t)from_addr;
@@ -1181,6 +1261,8 @@ int postcopy_notify_shared_wake(RAMBlock *rb, uint64_t offset)
 
 /*
  * Place a host page (from) at (host) atomically
+ * For blocks with a host_mirror, the data has already been written there
+ * and (from) is ignored.
  * returns 0 on success
  */
 int postcopy_place_page(MigrationIncomingState *mis, void *host, void *from,
@@ -1434,3 +1516,135 @@ void postcopy_unregister_shared_ufd(struct PostCopyFD *pcfd)
         }
     }
 }
+
+/*
+ * Postcopy preempt channel
+ *
+ * Pages explicitly requested by the destination are sent over their own
+ * socket, so that they don't have to queue up behind the background
+ * stream of pages on the main channel.
+ */
+
+/*
+ * Connect the preempt channel.  Called from the migration thread when
+ * postcopy starts; if we fail, requested pages go through the main
+ * channel as usual.
+ */
+void postcopy_preempt_setup(MigrationState *s)
+{
+    Error *local_err = NULL;
+    QIOChannel *ioc;
+
+    if (!migrate_postcopy_preempt()) {
+        return;
+    }
+
+    ioc = socket_send_channel_create_sync(&local_err);
+    if (!ioc) {
+        warn_reportf_err(local_err, "postcopy preempt channel not available, "
+                         "using the main channel: ");
+        return;
+    }
+
+    qio_channel_set_name(ioc, "migration-postcopy-preempt");
+    yank_register_function(MIGRATION_YANK_INSTANCE,
+                           migration_yank_iochannel, ioc);
+
+    qemu_mutex_lock(&s->qemu_file_lock);
+    s->postcopy_qemufile_src = qemu_fopen_channel_output(ioc);
+    qemu_mutex_unlock(&s->qemu_file_lock);
+    /* The QEMUFile holds its own reference */
+    object_unref(OBJECT(ioc));
+
+    trace_postcopy_preempt_setup();
+}
+
+/*
+ * Close the preempt channel on the source.  @shutdown should be set when
+ * the connection may be broken, so that closing it can't block.
+ */
+void postcopy_preempt_close(MigrationState *s, bool shutdown)
+{
+    QEMUFile *file;
+
+    qemu_mutex_lock(&s->qemu_file_lock);
+    file = s->postcopy_qemufile_src;
+    s->postcopy_qemufile_src = NULL;
+    qemu_mutex_unlock(&s->qemu_file_lock);
+
+    if (!file) {
+        return;
+    }
+    if (shutdown) {
+        qemu_file_shutdown(file);
+    }
+    qemu_fclose(file);
+    trace_postcopy_preempt_close(shutdown);
+}
+
+/* The destination got the preempt channel connection */
+void postcopy_preempt_new_channel(MigrationIncomingState *mis, QEMUFile *file)
+{
+    mis->postcopy_qemufile_dst = file;
+    trace_postcopy_preempt_new_channel();
+    postcopy_preempt_thread_start(mis);
+}
+
+static void *postcopy_preempt_thread(void *opaque)
+{
+    MigrationIncomingState *mis = opaque;
+    int ret = 0;
+
+    trace_postcopy_preempt_thread_entry();
+    rcu_register_thread();
+
+    /*
+     * Each requested host page arrives as its own section terminated by
+     * RAM_SAVE_FLAG_EOS; keep going until the source closes the channel.
+     */
+    while (!ret) {
+        WITH_RCU_READ_LOCK_GUARD() {
+            ret = ram_load_postcopy(mis->postcopy_qemufile_dst,
+                                    RAM_CHANNEL_POSTCOPY);
+        }
+    }
+
+    rcu_unregister_thread();
+    trace_postcopy_preempt_thread_exit(ret);
+    return NULL;
+}
+
+/*
+ * Start loading pages from the preempt channel; this needs both the
+ * channel and the postcopy setup done, whichever comes last starts it.
+ */
+void postcopy_preempt_thread_start(MigrationIncomingState *mis)
+{
+    if (!mis->postcopy_qemufile_dst ||
+        !mis->postcopy_tmp_pages[RAM_CHANNEL_POSTCOPY] ||
+        mis->have_preempt_thread) {
+        return;
+    }
+
+    qemu_file_set_blocking(mis->postcopy_qemufile_dst, true);
+    qemu_thread_create(&mis->postcopy_preempt_thread, "postcopy/preempt",
+                       postcopy_preempt_thread, mis, QEMU_THREAD_JOINABLE);
+    mis->have_preempt_thread = true;
+}
+
+void postcopy_preempt_thread_join(MigrationIncomingState *mis)
+{
+    if (!mis->have_preempt_thread) {
+        return;
+    }
+
+    /*
+     * The source closes the channel once it has sent everything, so we
+     * only need to kick the thread out when the main channel failed.
+     */
+    if (!mis->from_src_file || qemu_file_get_error(mis->from_src_file)) {
+        qemu_file_shutdown(mis->postcopy_qemufile_dst);
+    }
+    qemu_thread_join(&mis->postcopy_preempt_thread);
+    mis->have_preempt_thread = false;
+}
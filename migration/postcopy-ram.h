@@ -179,4 +179,11 @@ int postcopy_wake_shared(struct PostCopyFD *pcfd, uint64_t client_addr,
 int postcopy_request_shared_page(struct PostCopyFD *pcfd, RAMBlock *rb,
                                  uint64_t client_addr, uint64_t offset);
 
+/* Dedicated channel for the pages requested by the destination */
+void postcopy_preempt_setup(MigrationState *s);
+void postcopy_preempt_close(MigrationState *s, bool shutdown);
+void postcopy_preempt_new_channel(MigrationIncomingState *mis, QEMUFile *file);
+void postcopy_preempt_thread_start(MigrationIncomingState *mis);
+void postcopy_preempt_thread_join(MigrationIncomingState *mis);
+
 #endif
@@ -25,6 +25,8 @@
 #include "qemu/osdep.h"
 #include "qemu-file-channel.h"
 #include "qemu-file.h"
+#include "qapi/error.h"
+#include "io/channel-file.h"
 #include "io/channel-socket.h"
 #include "qemu/iov.h"
 #include "qemu/yank.h"
@@ -101,6 +103,87 @@ static ssize_t channel_get_buffer(void *opaque,
 }
 
 
+static ssize_t channel_writev_buffer_at(void *opaque,
+                                        struct iovec *iov,
+                                        int iovcnt,
+                                        off_t pos,
+                                        Error **errp)
+{
+    QIOChannel *ioc = QIO_CHANNEL(opaque);
+
+    if (qio_channel_pwritev_all(ioc, iov, iovcnt, pos, errp) < 0) {
+        return -EIO;
+    }
+
+    return iov_size(iov, iovcnt);
+}
+
+
+static ssize_t channel_get_buffer_at(void *opaque,
+                                     uint8_t *buf,
+                                     size_t size,
+                                     off_t pos,
+                                     Error **errp)
+{
+    QIOChannel *ioc = QIO_CHANNEL(opaque);
+    struct iovec iov = { .iov_base = buf, .iov_len = size };
+
+    if (qio_channel_preadv_all(ioc, &iov, 1, pos, errp) < 0) {
+        return -EIO;
+    }
+
+    return size;
+}
+
+
+static int channel_map_at(void *opaque,
+                          uint8_t *buf,
+                          size_t size,
+                          off_t pos,
+                          Error **errp)
+{
+#ifdef CONFIG_POSIX
+    QIOChannel *ioc = QIO_CHANNEL(opaque);
+    QIOChannelFile *fioc;
+    void *ptr;
+
+    fioc = (QIOChannelFile *)object_dynamic_cast(OBJECT(ioc),
+                                                 TYPE_QIO_CHANNEL_FILE);
+    if (!fioc) {
+        return -ENOTSUP;
+    }
+
+    ptr = mmap(buf, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+               fioc->fd, pos);
+    if (ptr == MAP_FAILED) {
+        /* MAP_FIXED may already have dropped the old mapping */
+        error_setg_errno(errp, errno, "Unable to map the migration file");
+        return -errno;
+    }
+    return 0;
+#else
+    return -ENOTSUP;
+#endif
+}
+
+
+static off_t channel_seek(void *opaque,
+                          off_t offset,
+                          int whence,
+                          Error **errp)
+{
+    QIOChannel *ioc = QIO_CHANNEL(opaque);
+    off_t ret;
+
+    ret = qio_channel_io_seek(ioc, offset, whence, errp);
+    if (ret < 0) {
+        return -EIO;
+    }
+
+    return ret;
+}
+
+
 static int channel_close(void *opaque, Error **errp)
 {
     int ret;
@@ -174,6 +257,9 @@ static const QEMUFileOps channel_input_ops = {
     .shut_down = channel_shutdown,
     .set_blocking = channel_set_blocking,
     .get_return_path = channel_get_input_return_path,
+    .get_buffer_at = channel_get_buffer_at,
+    .map_at = channel_map_at,
+    .seek = channel_seek,
 };
 
 
@@ -183,6 +269,8 @@ static const QEMUFileOps channel_output_ops = {
     .shut_down = channel_shutdown,
     .set_blocking = channel_set_blocking,
     .get_return_path = channel_get_output_return_path,
+    .writev_buffer_at = channel_writev_buffer_at,
+    .seek = channel_seek,
 };
 
 
@@ -657,6 +657,135 @@ int64_t qemu_ftell(QEMUFile *f)
     return f->pos;
 }
 
+/*
+ * Move the stream position of a seekable file.  Whatever is buffered
+ * is flushed when writing, and dropped when reading.
+ */
+void qemu_set_offset(QEMUFile *f, off_t off, int whence)
+{
+    Error *err = NULL;
+    off_t ret;
+
+    if (!f->ops->seek) {
+        qemu_file_set_error(f, -ENOTSUP);
+        return;
+    }
+
+    if (qemu_file_is_writable(f)) {
+        qemu_fflush(f);
+    } else {
+        /* Drop read buffer */
+        f->buf_index = 0;
+        f->buf_size = 0;
+    }
+
+    ret = f->ops->seek(f->opaque, off, whence, &err);
+    if (ret < 0) {
+        qemu_file_set_error_obj(f, ret, err);
+        return;
+    }
+
+    f->pos = ret;
+}
+
+/*
+ * Current stream position of the file, as seen by the caller of the
+ * qemu_put_*() and qemu_get_*() functions.
+ */
+off_t qemu_get_offset(QEMUFile *f)
+{
+    if (qemu_file_is_writable(f)) {
+        return qemu_ftell_fast(f);
+    }
+
+    return f->pos - f->buf_size + f->buf_index;
+}
+
+/*
+ * Write @buf at @pos in the file, leaving the stream position alone.
+ * Errors are reported through the file error state.
+ */
+void qemu_put_buffer_at(QEMUFile *f, const uint8_t *buf, size_t buflen,
+                        off_t pos)
+{
+    struct iovec iov = { .iov_base = (void *)buf, .iov_len = buflen };
+    Error *err = NULL;
+    ssize_t ret;
+
+    if (f->last_error) {
+        return;
+    }
+
+    if (!f->ops->writev_buffer_at) {
+        qemu_file_set_error(f, -ENOTSUP);
+        return;
+    }
+
+    ret = f->ops->writev_buffer_at(f->opaque, &iov, 1, pos, &err);
+    if (ret < 0) {
+        qemu_file_set_error_obj(f, ret, err);
+        return;
+    }
+
+    f->bytes_xfer += buflen;
+}
+
+/*
+ * Read @buflen bytes at @pos in the file into @buf, leaving the stream
+ * position alone.
+ *
+ * Returns the number of bytes read, 0 on error.
+ */
+size_t qemu_get_buffer_at(QEMUFile *f, uint8_t *buf, size_t buflen,
+                          off_t pos)
+{
+    Error *err = NULL;
+    ssize_t ret;
+
+    if (f->last_error) {
+        return 0;
+    }
+
+    if (!f->ops->get_buffer_at) {
+        qemu_file_set_error(f, -ENOTSUP);
+        return 0;
+    }
+
+    ret = f->ops->get_buffer_at(f->opaque, buf, buflen, pos, &err);
+    if (ret < 0) {
+        qemu_file_set_error_obj(f, ret, err);
+        return 0;
+    }
+
+    return ret;
+}
+
+/*
+ * Map @buflen bytes of the file at @pos over @buf, see QEMUFileMapAtFunc.
+ * Other errors than -ENOTSUP are also set on the file.
+ */
+int qemu_map_buffer_at(QEMUFile *f, uint8_t *buf, size_t buflen, off_t pos)
+{
+    Error *err = NULL;
+    int ret;
+
+    if (f->last_error) {
+        return f->last_error;
+    }
+
+    if (!f->ops->map_at) {
+        return -ENOTSUP;
+    }
+
+    ret = f->ops->map_at(f->opaque, buf, buflen, pos, &err);
+    if (ret < 0 && ret != -ENOTSUP) {
+        qemu_file_set_error_obj(f, ret, err);
+    } else {
+        error_free(err);
+    }
+    return ret;
+}
+
 int qemu_file_rate_limit(QEMUFile *f)
 {
     if (f->shutdown) {
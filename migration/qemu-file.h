@@ -103,6 +103,39 @@ typedef QEMUFile *(QEMURetPathFunc)(void *opaque);
 typedef int (QEMUFileShutdownFunc)(void *opaque, bool rd, bool wr,
                                    Error **errp);
 
+/*
+ * Write an iovec to the file at the given position, without moving
+ * the stream position.  The handler must write all of the data or
+ * return a negative errno value.
+ */
+typedef ssize_t (QEMUFileWritevAtFunc)(void *opaque, struct iovec *iov,
+                                       int iovcnt, off_t pos, Error **errp);
+
+/*
+ * Read a chunk of data from the file at the given position, without
+ * moving the stream position.  The handler must fill the whole buffer
+ * or return a negative errno value.
+ */
+typedef ssize_t (QEMUFileGetBufferAtFunc)(void *opaque, uint8_t *buf,
+                                          size_t size, off_t pos,
+                                          Error **errp);
+
+/*
+ * Replace the memory at @buf with a private, copy-on-write mapping of
+ * the file at the given position.  @buf, @size and @pos must be host
+ * page aligned.  Returns 0 or a negative errno value; -ENOTSUP means
+ * that the memory was left alone and the data must be read instead.
+ */
+typedef int (QEMUFileMapAtFunc)(void *opaque, uint8_t *buf, size_t size,
+                                off_t pos, Error **errp);
+
+/*
+ * Move the stream position of the file, as lseek() does.
+ * Returns the new position, or a negative errno value.
+ */
+typedef off_t (QEMUFileSeekFunc)(void *opaque, off_t offset, int whence,
+                                 Error **errp);
+
 typedef struct QEMUFileOps {
     QEMUFileGetBufferFunc *get_buffer;
     QEMUFileCloseFunc *close;
@@ -110,6 +143,10 @@ typedef struct QEMUFileOps {
     QEMUFileWritevBufferFunc *writev_buffer;
     QEMURetPathFunc *get_return_path;
     QEMUFileShutdownFunc *shut_down;
+    QEMUFileWritevAtFunc *writev_buffer_at;
+    QEMUFileGetBufferAtFunc *get_buffer_at;
+    QEMUFileMapAtFunc *map_at;
+    QEMUFileSeekFunc *seek;
 } QEMUFileOps;
 
 typedef struct QEMUFileHooks {
@@ -125,6 +162,13 @@ int qemu_get_fd(QEMUFile *f);
 int qemu_fclose(QEMUFile *f);
 int64_t qemu_ftell(QEMUFile *f);
 int64_t qemu_ftell_fast(QEMUFile *f);
+void qemu_set_offset(QEMUFile *f, off_t off, int whence);
+off_t qemu_get_offset(QEMUFile *f);
+void qemu_put_buffer_at(QEMUFile *f, const uint8_t *buf, size_t buflen,
+                        off_t pos);
+size_t qemu_get_buffer_at(QEMUFile *f, uint8_t *buf, size_t buflen,
+                          off_t pos);
+int qemu_map_buffer_at(QEMUFile *f, uint8_t *buf, size_t buflen, off_t pos);
 /*
  * put_buffer without copying the buffer.
  * The buffer should be available till it is sent asynchronously.
@@ -29,6 +29,7 @@
 #include "qemu/osdep.h"
 #include "cpu.h"
 #include "qemu/cutils.h"
+#include "qemu/units.h"
 #include "qemu/bitops.h"
 #include "qemu/bitmap.h"
 #include "qemu/main-loop.h"
@@ -53,6 +54,7 @@
 #include "block.h"
 #include "sysemu/sysemu.h"
 #include "sysemu/cpu-throttle.h"
+#include "sysemu/dirtylimit.h"
 #include "savevm.h"
 #include "qemu/iov.h"
 #include "multifd.h"
@@ -81,6 +83,27 @@
 /* 0x80 is reserved in migration.h start with 0x100 next */
 #define RAM_SAVE_FLAG_COMPRESS_PAGE    0x100
 
+/*
+ * With mapped-ram each RAMBlock is described in the stream by a header,
+ * followed in the file by a bitmap of the pages present and then by
+ * the pages themselves, each one at its offset inside the block.
+ */
+#define MAPPED_RAM_HDR_VERSION 1
+typedef struct {
+    uint32_t version;
+    /* target page size the bitmap is made of */
+    uint64_t page_size;
+    /* file offsets of the bitmap and of the first page */
+    uint64_t bitmap_offset;
+    uint64_t pages_offset;
+} __attribute__((packed)) MappedRamHeader;
+
+/*
+ * Align the pages region of every block, so that the multifd channels
+ * can use O_DIRECT and the file can be mmapped.
+ */
+#define MAPPED_RAM_FILE_OFFSET_ALIGNMENT 0x100000
+
 static inline bool is_zero_range(uint8_t *p, uint64_t size)
 {
     return buffer_is_zero(p, size);
@@ -215,6 +238,11 @@ void ramblock_recv_bitmap_set(RAMBlock *rb, void *host_addr)
     set_bit_atomic(ramblock_recv_bitmap_offset(host_addr, rb), rb->receivedmap);
 }
 
+void ramblock_recv_bitmap_set_offset(RAMBlock *rb, uint64_t byte_offset)
+{
+    set_bit_atomic(byte_offset >> TARGET_PAGE_BITS, rb->receivedmap);
+}
+
 void ramblock_recv_bitmap_set_range(RAMBlock *rb, void *host_addr,
                                     size_t nr)
 {
@@ -309,6 +337,8 @@ struct RAMState {
     RAMBlock *last_seen_block;
     /* Last block from where we have sent data */
     RAMBlock *last_sent_block;
+    /* Last block sent on the postcopy preempt channel */
+    RAMBlock *preempt_last_sent_block;
     /* Last dirty target page we have sent */
     ram_addr_t last_page;
     /* last ram version we have seen */
@@ -326,6 +356,10 @@ struct RAMState {
     uint64_t bytes_xfer_prev;
     /* number of dirty pages since start_time */
     uint64_t num_dirty_pages_period;
+    /* bytes transferred at the end of the last iteration */
+    uint64_t iteration_bytes_prev;
+    /* multifd wait time at the end of the last iteration */
+    uint64_t iteration_multifd_wait_prev;
     /* xbzrle misses since the beginning of the period */
     uint64_t xbzrle_cache_miss_prev;
     /* Amount of xbzrle pages since the beginning of the period */
@@ -402,6 +436,24 @@ uint64_t ram_bytes_remaining(void)
 
 MigrationStats ram_counters;
 
+/* statistics of the last iteration, the multifd channels are not kept */
+MigrationIterationStats iteration_counters;
+
+/*
+ * Returns the statistics of the last iteration, with those of the
+ * multifd channels as they are now.
+ */
+MigrationIterationStats *ram_get_iteration_stats(void)
+{
+    MigrationIterationStats *stats = g_new0(MigrationIterationStats, 1);
+
+    *stats = iteration_counters;
+    stats->multifd_channels = multifd_send_channel_stats();
+    stats->has_multifd_channels = stats->multifd_channels != NULL;
+
+    return stats;
+}
+
 /* used by the search for pages to send */
 struct PageSearchStatus {
     /* Current block being searched */
@@ -460,6 +512,37 @@ static QemuThread *decompress_threads;
 static QemuMutex decomp_done_lock;
 static QemuCond decomp_done_cond;
 
+/* Number of target pages handed to a load thread at once */
+#define LOAD_BATCH_PAGES 64
+
+/* Pages read from the main channel, waiting to be placed in guest RAM */
+typedef struct {
+    int used;
+    /* contents of the normal pages, one target page per entry */
+    uint8_t *buf;
+    /* where each page goes */
+    void **host;
+    /* fill byte of a RAM_SAVE_FLAG_ZERO page, -1 for a normal page */
+    int16_t *fill;
+} LoadBatch;
+
+struct LoadParam {
+    bool done;
+    bool quit;
+    QemuMutex mutex;
+    QemuCond cond;
+    /* owned by the thread while !done */
+    LoadBatch *batch;
+};
+typedef struct LoadParam LoadParam;
+
+static LoadParam *load_param;
+static QemuThread *load_threads;
+/* batch the main channel thread is filling */
+static LoadBatch *load_batch;
+static QemuMutex load_done_lock;
+static QemuCond load_done_cond;
+
 static bool do_compress_ram_page(QEMUFile *f, z_stream *stream, RAMBlock *block,
                                  ram_addr_t offset, uint8_t *source_buf);
 
@@ -906,7 +989,7 @@ static void migration_update_rates(RAMState *rs, int64_t end_time)
         return;
     }
 
-    if (migrate_use_xbzrle()) {
+    if (migrate_use_xbzrle() || migrate_use_multifd_xbzrle()) {
         double encoded_size, unencoded_size;
 
         xbzrle_counters.cache_miss_rate = (double)(xbzrle_counters.cache_miss -
@@ -945,6 +1028,23 @@ static void migration_update_rates(RAMState *rs, int64_t end_time)
     }
 }
 
+/*
+ * migration_dirty_limit_guest: start the per-vCPU dirty limit
+ *
+ * Unlike auto-converge there is nothing to ramp up: each vCPU adjusts
+ * its own throttle until its dirty rate is within the quota.
+ */
+static void migration_dirty_limit_guest(void)
+{
+    MigrationState *s = migrate_get_current();
+
+    if (dirtylimit_in_service()) {
+        return;
+    }
+    trace_migration_dirty_limit_guest(s->parameters.vcpu_dirty_limit);
+    dirtylimit_set_quota(s->parameters.vcpu_dirty_limit);
+}
+
 static void migration_trigger_throttle(RAMState *rs)
 {
     MigrationState *s = migrate_get_current();
@@ -957,7 +1057,8 @@ static void migration_trigger_throttle(RAMState *rs)
     /* During block migration the auto-converge logic incorrectly detects
      * that ram migration makes no progress. Avoid this by disabling the
      * throttling logic during the bulk phase of block migration. */
-    if (migrate_auto_converge() && !blk_mig_bulk_active()) {
+    if ((migrate_auto_converge() || migrate_dirty_limit()) &&
+        !blk_mig_bulk_active()) {
         /* The following detection logic can be refined later. For now:
            Check to see if the ratio between dirtied bytes and the approx.
            amount of bytes that just got transferred since the last time
@@ -966,18 +1067,59 @@ static void migration_trigger_throttle(RAMState *rs)
 
         if ((bytes_dirty_period > bytes_dirty_threshold) &&
             (++rs->dirty_rate_high_cnt >= 2)) {
-            trace_migration_throttle();
             rs->dirty_rate_high_cnt = 0;
-            mig_throttle_guest_down(bytes_dirty_period,
-                                    bytes_dirty_threshold);
+            if (migrate_dirty_limit()) {
+                migration_dirty_limit_guest();
+            } else {
+                trace_migration_throttle();
+                mig_throttle_guest_down(bytes_dirty_period,
+                                        bytes_dirty_threshold);
+            }
         }
     }
 }
 
+/*
+ * Close the iteration that the sync that just happened ended.
+ *
+ * @rs: current RAM state
+ * @sync_time: duration of the bitmap sync in microseconds
+ * @dirty_pages: number of pages the bitmap sync found dirty
+ */
+static void migration_iteration_end(RAMState *rs, uint64_t sync_time,
+                                    uint64_t dirty_pages)
+{
+    uint64_t multifd_wait = multifd_send_queue_wait_time();
+
+    iteration_counters.pass = ram_counters.dirty_sync_count;
+    iteration_counters.bitmap_sync_time = sync_time;
+    iteration_counters.dirty_pages = dirty_pages;
+    iteration_counters.transferred = ram_counters.transferred -
+                                     rs->iteration_bytes_prev;
+    iteration_counters.multifd_wait_time = multifd_wait -
+                                           rs->iteration_multifd_wait_prev;
+    rs->iteration_bytes_prev = ram_counters.transferred;
+    rs->iteration_multifd_wait_prev = multifd_wait;
+
+    trace_migration_iteration_end(iteration_counters.pass, sync_time,
+                                  dirty_pages,
+                                  iteration_counters.transferred,
+                                  iteration_counters.multifd_wait_time);
+
+    if (migrate_use_events()) {
+        MigrationIterationStats *stats = ram_get_iteration_stats();
+
+        qapi_event_send_migration_iteration(stats);
+        qapi_free_MigrationIterationStats(stats);
+    }
+}
+
 static void migration_bitmap_sync(RAMState *rs)
 {
     RAMBlock *block;
     int64_t end_time;
+    int64_t sync_time = qemu_clock_get_us(QEMU_CLOCK_REALTIME);
+    uint64_t dirty_pages = rs->num_dirty_pages_period;
 
     ram_counters.dirty_sync_count++;
 
@@ -1000,6 +1142,8 @@ static void migration_bitmap_sync(RAMState *rs)
     memory_global_after_dirty_log_sync();
     trace_migration_bitmap_sync_end(rs->num_dirty_pages_period);
 
+    sync_time = qemu_clock_get_us(QEMU_CLOCK_REALTIME) - sync_time;
+    dirty_pages = rs->num_dirty_pages_period - dirty_pages;
     end_time = qemu_clock_get_ms(QEMU_CLOCK_REALTIME);
 
     /* more than 1 second = 1000 millisecons */
@@ -1018,6 +1162,7 @@ static void migration_bitmap_sync(RAMState *rs)
     if (migrate_use_events()) {
         qapi_event_send_migration_pass(ram_counters.dirty_sync_count);
     }
+    migration_iteration_end(rs, sync_time, dirty_pages);
 }
 
 static void migration_bitmap_sync_precopy(RAMState *rs)
@@ -1076,7 +1221,19 @@ static int save_zero_page_to_file(RAMState *rs, QEMUFile *file,
  */
 static int save_zero_page(RAMState *rs, RAMBlock *block, ram_addr_t offset)
 {
-    int len = save_zero_page_to_file(rs, rs->f, block, offset);
+    int len;
+
+    if (migrate_mapped_ram()) {
+        /* A zero page is just a clear bit, nothing goes in the stream */
+        if (!is_zero_range(block->host + offset, TARGET_PAGE_SIZE)) {
+            return -1;
+        }
+        clear_bit(offset >> TARGET_PAGE_BITS, block->file_bmap);
+        ram_counters.duplicate++;
+        return 1;
+    }
+
+    len = save_zero_page_to_file(rs, rs->f, block, offset);
 
     if (len) {
         ram_counters.duplicate++;
@@ -1147,6 +1304,15 @@ static bool control_save_page(RAMState *rs, RAMBlock *block, ram_addr_t offset,
 static int save_normal_page(RAMState *rs, RAMBlock *block, ram_addr_t offset,
                             uint8_t *buf, bool async)
 {
+    if (migrate_mapped_ram()) {
+        qemu_put_buffer_at(rs->f, buf, TARGET_PAGE_SIZE,
+                           block->pages_offset + offset);
+        set_bit(offset >> TARGET_PAGE_BITS, block->file_bmap);
+        ram_counters.transferred += TARGET_PAGE_SIZE;
+        ram_counters.normal++;
+        return 1;
+    }
+
     ram_counters.transferred += save_page_header(rs, rs->f, block,
                                                  offset | RAM_SAVE_FLAG_PAGE);
     if (async) {
@@ -1503,6 +1669,27 @@ static int ram_save_release_protection(RAMState *rs, PageSearchStatus *pss,
     return res;
 }
 
+/**
+ * ram_write_tracking_release: release UFFD write protection of a range
+ *   of pages that a multifd channel has written out
+ *
+ * @block: RAMBlock the pages belong to
+ * @offset: offset of the first page inside @block
+ * @length: length of the range in bytes
+ *
+ * Returns 0 on success, negative value in case of an error
+ */
+int ram_write_tracking_release(RAMBlock *block, ram_addr_t offset,
+                               ram_addr_t length)
+{
+    if (!(block->flags & RAM_UF_WRITEPROTECT)) {
+        return 0;
+    }
+
+    return uffd_change_protection(ram_state->uffdio_fd, block->host + offset,
+                                  length, false, false);
+}
+
 /* ram_write_tracking_available: check if kernel supports required UFFD features
  *
  * Returns true if supports, false otherwise
@@ -1731,6 +1918,12 @@ static int ram_save_release_protection(RAMState *rs, PageSearchStatus *pss,
     return 0;
 }
 
+int ram_write_tracking_release(RAMBlock *block, ram_addr_t offset,
+                               ram_addr_t length)
+{
+    return 0;
+}
+
 bool ram_write_tracking_available(void)
 {
     return false;
@@ -1981,6 +2174,7 @@ static int ram_save_target_page(RAMState *rs, PageSearchStatus *pss,
 {
     RAMBlock *block = pss->block;
     ram_addr_t offset = ((ram_addr_t)pss->page) << TARGET_PAGE_BITS;
+    bool use_multifd;
     int res;
 
     if (control_save_page(rs, block, offset, &res)) {
@@ -1991,6 +2185,28 @@ static int ram_save_target_page(RAMState *rs, PageSearchStatus *pss,
         return 1;
     }
 
+    /*
+     * Do not use multifd for:
+     * 1. Compression as the first page in the new block should be posted out
+     *    before sending the compressed page
+     * 2. In postcopy as one whole host page should be placed
+     */
+    use_multifd = !save_page_use_compression(rs) && migrate_use_multifd() &&
+                  !migration_in_postcopy();
+
+    /*
+     * The multifd send threads look for zero pages themselves.  The
+     * xbzrle method needs that too, to keep its cache up to date, and
+     * so does mapped-ram, to keep the file bitmap up to date.  With RDMA
+     * no page may go through the main channel, the destination would
+     * apply it out of order with the RDMA writes.
+     */
+    if (use_multifd &&
+        (migrate_use_multifd_zero_page() || migrate_use_multifd_xbzrle() ||
+         migrate_mapped_ram() || migrate_rdma())) {
+        return ram_save_multifd_page(rs, block, offset);
+    }
+
     res = save_zero_page(rs, block, offset);
     if (res > 0) {
         /* Must let xbzrle know, otherwise a previous (now 0'd) cached
@@ -2005,14 +2221,7 @@ static int ram_save_target_page(RAMState *rs, PageSearchStatus *pss,
         return res;
     }
 
-    /*
-     * Do not use multifd for:
-     * 1. Compression as the first page in the new block should be posted out
-     *    before sending the compressed page
-     * 2. In postcopy as one whole host page should be placed
-     */
-    if (!save_page_use_compression(rs) && migrate_use_multifd()
-        && !migration_in_postcopy()) {
+    if (use_multifd) {
         return ram_save_multifd_page(rs, block, offset);
     }
 
@@ -2073,10 +2282,57 @@ static int ram_save_host_page(RAMState *rs, PageSearchStatus *pss,
     /* The offset we leave with is the last one we looked at */
     pss->page--;
 
+    /* The multifd channels release the pages once they are written */
+    if (migrate_use_multifd()) {
+        return pages;
+    }
+
     res = ram_save_release_protection(rs, pss, start_page);
     return (res < 0 ? res : pages);
 }
 
+/**
+ * ram_save_host_page_urgent: send a requested host page on the preempt channel
+ *
+ * The page goes through its own QEMUFile, so that it doesn't have to wait
+ * behind whatever the main channel has queued.  Every page is terminated
+ * with RAM_SAVE_FLAG_EOS so that the destination can place it right away.
+ *
+ * Returns the number of pages written or negative on error
+ *
+ * @rs: current RAM state
+ * @pss: data about the page we want to send
+ * @last_stage: if we are at the completion stage
+ */
+static int ram_save_host_page_urgent(RAMState *rs, PageSearchStatus *pss,
+                                     bool last_stage)
+{
+    MigrationState *s = migrate_get_current();
+    QEMUFile *main_file = rs->f;
+    RAMBlock *main_last_sent_block = rs->last_sent_block;
+    int pages, ret;
+
+    rs->f = s->postcopy_qemufile_src;
+    rs->last_sent_block = rs->preempt_last_sent_block;
+
+    pages = ram_save_host_page(rs, pss, last_stage);
+    qemu_put_be64(rs->f, RAM_SAVE_FLAG_EOS);
+    ram_counters.transferred += 8;
+    qemu_fflush(rs->f);
+    ret = qemu_file_get_error(rs->f);
+
+    rs->preempt_last_sent_block = rs->last_sent_block;
+    rs->f = main_file;
+    rs->last_sent_block = main_last_sent_block;
+
+    if (ret) {
+        /* Fail the migration the same way a main channel error would */
+        qemu_file_set_error(rs->f, ret);
+        return ret;
+    }
+    return pages;
+}
+
 /**
  * ram_find_and_save_block: finds a dirty page and sends it to f
  *
@@ -2096,7 +2352,7 @@ static int ram_find_and_save_block(RAMState *rs, bool last_stage)
 {
     PageSearchStatus pss;
     int pages = 0;
-    bool again, found;
+    bool again, found, queued;
 
     /* No dirty page as there is zero RAM */
     if (!ram_bytes_total()) {
@@ -2114,6 +2370,13 @@ static int ram_find_and_save_block(RAMState *rs, bool last_stage)
     do {
         again = true;
         found = get_queued_page(rs, &pss);
+        queued = found;
+
+        if (found && migrate_get_current()->postcopy_qemufile_src &&
+            migration_in_postcopy()) {
+            pages = ram_save_host_page_urgent(rs, &pss, last_stage);
+            continue;
+        }
 
         if (!found) {
             /* priority queue empty, so just search for something dirty */
@@ -2122,6 +2385,14 @@ static int ram_find_and_save_block(RAMState *rs, bool last_stage)
 
         if (found) {
             pages = ram_save_host_page(rs, &pss, last_stage);
+            /*
+             * Someone is waiting for a queued page, e.g. a vCPU blocked
+             * on a write fault: don't leave it in the multifd queue.
+             */
+            if (queued && pages > 0 && migrate_use_multifd() &&
+                multifd_queue_flush(rs->f) < 0) {
+                pages = -1;
+            }
         }
     } while (!pages && again);
 
@@ -2216,7 +2487,7 @@ static void ram_save_cleanup(void *opaque)
         /* caller have hold iothread lock or is in a bh, so there is
          * no writing race against the migration bitmap
          */
-        memory_global_dirty_log_stop();
+        memory_global_dirty_log_stop(GLOBAL_DIRTY_MIGRATION);
     }
 
     RAMBLOCK_FOREACH_NOT_IGNORED(block) {
@@ -2224,6 +2495,8 @@ static void ram_save_cleanup(void *opaque)
         block->clear_bmap = NULL;
         g_free(block->bmap);
         block->bmap = NULL;
+        g_free(block->file_bmap);
+        block->file_bmap = NULL;
     }
 
     xbzrle_cleanup();
@@ -2679,7 +2952,7 @@ static void ram_init_bitmaps(RAMState *rs)
         ram_list_init_bitmaps();
         /* We don't use dirty log with background snapshots */
         if (!migrate_background_snapshot()) {
-            memory_global_dirty_log_start();
+            memory_global_dirty_log_start(GLOBAL_DIRTY_MIGRATION);
             migration_bitmap_sync_precopy(rs);
         }
     }
@@ -2800,6 +3073,39 @@ void qemu_guest_free_page_hint(void *addr, size_t len)
  * @f: QEMUFile where to send the data
  * @opaque: RAMState pointer
  */
+/*
+ * Reserve the file region of @block: write its header in the stream,
+ * then leave room for its bitmap and pages before the stream goes on.
+ */
+static void mapped_ram_setup_ramblock(QEMUFile *f, RAMBlock *block)
+{
+    g_autofree MappedRamHeader *header = NULL;
+    size_t header_size, bitmap_size;
+    long num_pages;
+
+    header = g_new0(MappedRamHeader, 1);
+    header_size = sizeof(MappedRamHeader);
+
+    num_pages = block->used_length >> TARGET_PAGE_BITS;
+    bitmap_size = BITS_TO_LONGS(num_pages) * sizeof(unsigned long);
+
+    /* Multifd threads set bits of this bitmap concurrently, start clear */
+    block->file_bmap = bitmap_new(num_pages);
+    block->bitmap_offset = qemu_get_offset(f) + header_size;
+    block->pages_offset = ROUND_UP(block->bitmap_offset + bitmap_size,
+                                   MAPPED_RAM_FILE_OFFSET_ALIGNMENT);
+
+    header->version = cpu_to_be32(MAPPED_RAM_HDR_VERSION);
+    header->page_size = cpu_to_be64(TARGET_PAGE_SIZE);
+    header->bitmap_offset = cpu_to_be64(block->bitmap_offset);
+    header->pages_offset = cpu_to_be64(block->pages_offset);
+
+    qemu_put_buffer(f, (uint8_t *)header, header_size);
+
+    /* The stream continues after the pages of this block */
+    qemu_set_offset(f, block->pages_offset + block->used_length, SEEK_SET);
+}
+
 static int ram_save_setup(QEMUFile *f, void *opaque)
 {
     RAMState **rsp = opaque;
@@ -2832,6 +3138,9 @@ static int ram_save_setup(QEMUFile *f, void *opaque)
             if (migrate_ignore_shared()) {
                 qemu_put_be64(f, block->mr->addr);
             }
+            if (migrate_mapped_ram()) {
+                mapped_ram_setup_ramblock(f, block);
+            }
         }
     }
 
@@ -2962,6 +3271,27 @@ out:
  * @f: QEMUFile where to send the data
  * @opaque: RAMState pointer
  */
+/*
+ * Write the bitmap of the pages present in the file for each block.
+ * Must be called once every multifd channel is done with its pages.
+ */
+static void ram_save_file_bmap(QEMUFile *f)
+{
+    RAMBlock *block;
+
+    RCU_READ_LOCK_GUARD();
+
+    RAMBLOCK_FOREACH_MIGRATABLE(block) {
+        long num_pages = block->used_length >> TARGET_PAGE_BITS;
+        long bitmap_size = BITS_TO_LONGS(num_pages) * sizeof(unsigned long);
+        g_autofree unsigned long *le_bitmap = bitmap_new(num_pages);
+
+        bitmap_to_le(le_bitmap, block->file_bmap, num_pages);
+        qemu_put_buffer_at(f, (uint8_t *)le_bitmap, bitmap_size,
+                           block->bitmap_offset);
+    }
+}
+
 static int ram_save_complete(QEMUFile *f, void *opaque)
 {
     RAMState **temp = opaque;
@@ -2998,6 +3328,9 @@ static int ram_save_complete(QEMUFile *f, void *opaque)
 
     if (ret >= 0) {
         multifd_send_sync_main(rs->f);
+        if (migrate_mapped_ram()) {
+            ram_save_file_bmap(f);
+        }
         qemu_put_be64(f, RAM_SAVE_FLAG_EOS);
         qemu_fflush(f);
     }
@@ -3075,12 +3408,16 @@ static int load_xbzrle(QEMUFile *f, ram_addr_t addr, void *host)
  *
  * Returns a pointer from within the RCU-protected ram_list.
  *
+ * @mis: the migration incoming state pointer
  * @f: QEMUFile where to read the data from
  * @flags: Page flags (mostly to see if it's a continuation of previous block)
+ * @channel: the channel we're using, each one tracks its own last block
  */
-static inline RAMBlock *ram_block_from_stream(QEMUFile *f, int flags)
+static inline RAMBlock *ram_block_from_stream(MigrationIncomingState *mis,
+                                              QEMUFile *f, int flags,
+                                              int channel)
 {
-    static RAMBlock *block;
+    RAMBlock *block = mis->last_recv_block[channel];
     char id[256];
     uint8_t len;
 
@@ -3107,6 +3444,8 @@ static inline RAMBlock *ram_block_from_stream(QEMUFile *f, int flags)
         return NULL;
     }
 
+    mis->last_recv_block[channel] = block;
+
     return block;
 }
 
@@ -3137,13 +3476,36 @@ static inline void *colo_cache_from_block_offset(RAMBlock *block,
     * It help us to decide which pages in ram cache should be flushed
     * into VM's RAM later.
     */
-    if (record_bitmap &&
-        !test_and_set_bit(offset >> TARGET_PAGE_BITS, block->bmap)) {
-        ram_state->migration_dirty_pages++;
+    if (record_bitmap) {
+        colo_record_bitmap(block, &offset, 1);
     }
     return block->colo_cache + offset;
 }
 
+/*
+ * Record pages loaded into the COLO cache by the main thread or by the
+ * multifd receive channels, so colo_flush_ram_cache() knows which ones
+ * to copy back into SVM's memory.
+ */
+void colo_record_bitmap(RAMBlock *block, ram_addr_t *offsets, uint32_t pages)
+{
+    uint64_t dirty = 0;
+    uint32_t i;
+
+    if (!pages) {
+        return;
+    }
+
+    qemu_mutex_lock(&ram_state->bitmap_mutex);
+    for (i = 0; i < pages; i++) {
+        if (!test_and_set_bit(offsets[i] >> TARGET_PAGE_BITS, block->bmap)) {
+            dirty++;
+        }
+    }
+    ram_state->migration_dirty_pages += dirty;
+    qemu_mutex_unlock(&ram_state->bitmap_mutex);
+}
+
 /**
  * ram_handle_compressed: handle the zero page case
  *
@@ -3347,6 +3709,196 @@ static void decompress_data_with_multi_threads(QEMUFile *f,
     }
 }
 
+static LoadBatch *load_batch_new(void)
+{
+    LoadBatch *batch = g_new0(LoadBatch, 1);
+
+    batch->buf = qemu_memalign(TARGET_PAGE_SIZE,
+                               LOAD_BATCH_PAGES * TARGET_PAGE_SIZE);
+    batch->host = g_new0(void *, LOAD_BATCH_PAGES);
+    batch->fill = g_new0(int16_t, LOAD_BATCH_PAGES);
+    return batch;
+}
+
+static void load_batch_free(LoadBatch *batch)
+{
+    qemu_vfree(batch->buf);
+    g_free(batch->host);
+    g_free(batch->fill);
+    g_free(batch);
+}
+
+static void *do_data_load(void *opaque)
+{
+    LoadParam *param = opaque;
+    LoadBatch *batch;
+    int i;
+
+    qemu_mutex_lock(&param->mutex);
+    while (!param->quit) {
+        if (param->batch->used) {
+            batch = param->batch;
+            qemu_mutex_unlock(&param->mutex);
+
+            for (i = 0; i < batch->used; i++) {
+                if (batch->fill[i] < 0) {
+                    memcpy(batch->host[i], batch->buf + i * TARGET_PAGE_SIZE,
+                           TARGET_PAGE_SIZE);
+                } else {
+                    ram_handle_compressed(batch->host[i], batch->fill[i],
+                                          TARGET_PAGE_SIZE);
+                }
+            }
+            batch->used = 0;
+
+            qemu_mutex_lock(&load_done_lock);
+            param->done = true;
+            qemu_cond_signal(&load_done_cond);
+            qemu_mutex_unlock(&load_done_lock);
+
+            qemu_mutex_lock(&param->mutex);
+        } else {
+            qemu_cond_wait(&param->cond, &param->mutex);
+        }
+    }
+    qemu_mutex_unlock(&param->mutex);
+
+    return NULL;
+}
+
+/* Hand the batch being filled to the first idle load thread */
+static void load_batch_flush(void)
+{
+    int idx, thread_count;
+    LoadBatch *batch;
+
+    if (!load_batch->used) {
+        return;
+    }
+
+    thread_count = migrate_load_threads();
+    QEMU_LOCK_GUARD(&load_done_lock);
+    while (true) {
+        for (idx = 0; idx < thread_count; idx++) {
+            if (load_param[idx].done) {
+                load_param[idx].done = false;
+                qemu_mutex_lock(&load_param[idx].mutex);
+                batch = load_param[idx].batch;
+                load_param[idx].batch = load_batch;
+                load_batch = batch;
+                qemu_cond_signal(&load_param[idx].cond);
+                qemu_mutex_unlock(&load_param[idx].mutex);
+                return;
+            }
+        }
+        qemu_cond_wait(&load_done_cond, &load_done_lock);
+    }
+}
+
+/*
+ * Wait until every page read so far is in guest RAM.  A page is only
+ * sent again after a RAM_SAVE_FLAG_EOS, so it is enough to call this
+ * before returning from ram_load_precopy().
+ */
+static void wait_for_load_done(void)
+{
+    int idx, thread_count;
+
+    if (!load_param) {
+        return;
+    }
+
+    load_batch_flush();
+
+    thread_count = migrate_load_threads();
+    qemu_mutex_lock(&load_done_lock);
+    for (idx = 0; idx < thread_count; idx++) {
+        while (!load_param[idx].done) {
+            qemu_cond_wait(&load_done_cond, &load_done_lock);
+        }
+    }
+    qemu_mutex_unlock(&load_done_lock);
+}
+
+static void load_threads_cleanup(void)
+{
+    int i, thread_count;
+
+    if (!load_param) {
+        return;
+    }
+    thread_count = migrate_load_threads();
+    for (i = 0; i < thread_count; i++) {
+        qemu_mutex_lock(&load_param[i].mutex);
+        load_param[i].quit = true;
+        qemu_cond_signal(&load_param[i].cond);
+        qemu_mutex_unlock(&load_param[i].mutex);
+    }
+    for (i = 0; i < thread_count; i++) {
+        qemu_thread_join(load_threads + i);
+        qemu_mutex_destroy(&load_param[i].mutex);
+        qemu_cond_destroy(&load_param[i].cond);
+        load_batch_free(load_param[i].batch);
+    }
+    qemu_mutex_destroy(&load_done_lock);
+    qemu_cond_destroy(&load_done_cond);
+    load_batch_free(load_batch);
+    load_batch = NULL;
+    g_free(load_threads);
+    g_free(load_param);
+    load_threads = NULL;
+    load_param = NULL;
+}
+
+static void load_threads_setup(void)
+{
+    int i, thread_count;
+
+    thread_count = migrate_load_threads();
+    /* COLO backs up every page right after loading it */
+    if (!thread_count || migration_incoming_colo_enabled()) {
+        return;
+    }
+
+    load_threads = g_new0(QemuThread, thread_count);
+    load_param = g_new0(LoadParam, thread_count);
+    load_batch = load_batch_new();
+    qemu_mutex_init(&load_done_lock);
+    qemu_cond_init(&load_done_cond);
+    for (i = 0; i < thread_count; i++) {
+        load_param[i].batch = load_batch_new();
+        qemu_mutex_init(&load_param[i].mutex);
+        qemu_cond_init(&load_param[i].cond);
+        load_param[i].done = true;
+        load_param[i].quit = false;
+        qemu_thread_create(load_threads + i, "ram-load",
+                           do_data_load, load_param + i,
+                           QEMU_THREAD_JOINABLE);
+    }
+}
+
+/*
+ * Queue a page for the load threads: a normal page is read from @f
+ * right away, a zero page only records its fill byte @ch.
+ */
+static void load_page_with_threads(QEMUFile *f, void *host, bool zero,
+                                   uint8_t ch)
+{
+    int i = load_batch->used;
+
+    load_batch->host[i] = host;
+    if (zero) {
+        load_batch->fill[i] = ch;
+    } else {
+        load_batch->fill[i] = -1;
+        qemu_get_buffer(f, load_batch->buf + i * TARGET_PAGE_SIZE,
+                        TARGET_PAGE_SIZE);
+    }
+    if (++load_batch->used == LOAD_BATCH_PAGES) {
+        load_batch_flush();
+    }
+}
+
  /*
   * we must set ram_bulk_stage to false, otherwise in
   * migation_bitmap_find_dirty the bitmap will be unused and
@@ -3421,7 +3973,7 @@ void colo_incoming_start_dirty_log(void)
             /* Discard this dirty bitmap record */
             bitmap_zero(block->bmap, block->max_length >> TARGET_PAGE_BITS);
         }
-        memory_global_dirty_log_start();
+        memory_global_dirty_log_start(GLOBAL_DIRTY_MIGRATION);
     }
     ram_state->migration_dirty_pages = 0;
     qemu_mutex_unlock_ramlist();
@@ -3433,7 +3985,7 @@ void colo_release_ram_cache(void)
 {
     RAMBlock *block;
 
-    memory_global_dirty_log_stop();
+    memory_global_dirty_log_stop(GLOBAL_DIRTY_MIGRATION);
     RAMBLOCK_FOREACH_NOT_IGNORED(block) {
         g_free(block->bmap);
         block->bmap = NULL;
@@ -3458,14 +4010,114 @@ void colo_release_ram_cache(void)
  * @f: QEMUFile where to receive the data
  * @opaque: RAMState pointer
  */
+/*
+ * Populating the RAM of an incoming migration
+ *
+ * The RAMBlocks are cut in chunks that the populate threads take in
+ * turn.  MADV_POPULATE_WRITE only faults the pages in and never changes
+ * their contents, so it can race with the pages being loaded.
+ */
+#define POPULATE_CHUNK_SIZE (256 * MiB)
+
+typedef struct {
+    void *host;
+    size_t len;
+} PopulateChunk;
+
+static QemuThread *populate_threads;
+static int populate_thread_count;
+static GArray *populate_chunks;
+/* next chunk to populate */
+static unsigned int populate_next;
+static bool populate_quit;
+
+static void *do_ram_populate(void *opaque)
+{
+    while (!qatomic_read(&populate_quit)) {
+        unsigned int i = qatomic_fetch_inc(&populate_next);
+        PopulateChunk *chunk;
+
+        if (i >= populate_chunks->len) {
+            break;
+        }
+        chunk = &g_array_index(populate_chunks, PopulateChunk, i);
+        if (qemu_madvise(chunk->host, chunk->len, QEMU_MADV_POPULATE_WRITE)) {
+            if (errno == EINVAL) {
+                /* Not supported by the kernel, let the others know */
+                trace_ram_populate_unsupported();
+                qatomic_set(&populate_quit, true);
+                break;
+            }
+            /* Out of memory, or a hole in the mapping: leave it for later */
+            trace_ram_populate_failed(chunk->host, chunk->len, errno);
+        }
+    }
+    return NULL;
+}
+
+static void ram_populate_cleanup(void)
+{
+    int i;
+
+    if (!populate_threads) {
+        return;
+    }
+    qatomic_set(&populate_quit, true);
+    for (i = 0; i < populate_thread_count; i++) {
+        qemu_thread_join(populate_threads + i);
+    }
+    g_free(populate_threads);
+    populate_threads = NULL;
+    g_array_free(populate_chunks, true);
+    populate_chunks = NULL;
+}
+
+static void ram_populate_setup(void)
+{
+    RAMBlock *block;
+    int i;
+
+    populate_thread_count = migrate_populate_threads();
+    /* Postcopy needs the pages not to be there to catch the faults */
+    if (!populate_thread_count || migrate_postcopy_ram()) {
+        return;
+    }
+
+    populate_chunks = g_array_new(false, false, sizeof(PopulateChunk));
+    RAMBLOCK_FOREACH_NOT_IGNORED(block) {
+        size_t chunk_size = QEMU_ALIGN_UP(POPULATE_CHUNK_SIZE,
+                                          block->page_size);
+        ram_addr_t offset;
+
+        for (offset = 0; offset < block->used_length; offset += chunk_size) {
+            PopulateChunk chunk = {
+                .host = block->host + offset,
+                .len = MIN(chunk_size, block->used_length - offset),
+            };
+            g_array_append_val(populate_chunks, chunk);
+        }
+    }
+
+    trace_ram_populate_setup(populate_thread_count, populate_chunks->len);
+    populate_next = 0;
+    populate_quit = false;
+    populate_threads = g_new0(QemuThread, populate_thread_count);
+    for (i = 0; i < populate_thread_count; i++) {
+        qemu_thread_create(populate_threads + i, "ram-populate",
+                           do_ram_populate, NULL, QEMU_THREAD_JOINABLE);
+    }
+}
+
 static int ram_load_setup(QEMUFile *f, void *opaque)
 {
     if (compress_threads_load_setup(f)) {
         return -1;
     }
 
+    load_threads_setup();
     xbzrle_load_setup();
     ramblock_recv_map_init();
+    ram_populate_setup();
 
     return 0;
 }
@@ -3478,8 +4130,10 @@ static int ram_load_cleanup(void *opaque)
         qemu_ram_block_writeback(rb);
     }
 
+    ram_populate_cleanup();
     xbzrle_load_cleanup();
     compress_threads_load_cleanup();
+    load_threads_cleanup();
 
     RAMBLOCK_FOREACH_NOT_IGNORED(rb) {
         g_free(rb->receivedmap);
@@ -3510,19 +4164,21 @@ int ram_postcopy_incoming_init(MigrationIncomingState *mis)
  *
  * Returns 0 for success or -errno in case of error
  *
- * Called in postcopy mode by ram_load().
+ * Called in postcopy mode by ram_load(), and by the postcopy preempt
+ * thread for the pages that come on the preempt channel.
  * rcu_read_lock is taken prior to this being called.
  *
  * @f: QEMUFile where to send the data
+ * @channel: the channel to use for loading
  */
-static int ram_load_postcopy(QEMUFile *f)
+int ram_load_postcopy(QEMUFile *f, int channel)
 {
     int flags = 0, ret = 0;
     bool place_needed = false;
     bool matches_target_page_size = false;
     MigrationIncomingState *mis = migration_incoming_get_current();
     /* Temporary page that is later 'placed' */
-    void *postcopy_host_page = mis->postcopy_tmp_page;
+    void *postcopy_host_page = mis->postcopy_tmp_pages[channel];
     void *this_host = NULL;
     bool all_zero = true;
     int target_pages = 0;
@@ -3553,7 +4209,7 @@ static int ram_load_postcopy(QEMUFile *f)
         trace_ram_load_postcopy_loop((uint64_t)addr, flags);
         if (flags & (RAM_SAVE_FLAG_ZERO | RAM_SAVE_FLAG_PAGE |
                      RAM_SAVE_FLAG_COMPRESS_PAGE)) {
-            block = ram_block_from_stream(f, flags);
+            block = ram_block_from_stream(mis, f, flags, channel);
 
             host = host_from_ram_block_offset(block, addr);
             if (!host) {
@@ -3572,9 +4228,15 @@ static int ram_load_postcopy(QEMUFile *f)
              * The migration protocol uses,  possibly smaller, target-pages
              * however the source ensures it always sends all the components
              * of a host page in one chunk.
+             * Blocks with a mirror mapping are filled in place instead,
+             * and only mapped into the guest once complete.
              */
-            page_buffer = postcopy_host_page +
-                          ((uintptr_t)host & (block->page_size - 1));
+            if (block->host_mirror) {
+                page_buffer = block->host_mirror + addr;
+            } else {
+                page_buffer = postcopy_host_page +
+                              ((uintptr_t)host & (block->page_size - 1));
+            }
             if (target_pages == 1) {
                 this_host = (void *)QEMU_ALIGN_DOWN((uintptr_t)host,
                                                     block->page_size);
@@ -3645,7 +4307,9 @@ static int ram_load_postcopy(QEMUFile *f)
 
         case RAM_SAVE_FLAG_EOS:
             /* normal exit */
-            multifd_recv_sync_main();
+            if (channel == RAM_CHANNEL_PRECOPY) {
+                multifd_recv_sync_main();
+            }
             break;
         default:
             error_report("Unknown combination of migration flags: 0x%x"
@@ -3698,45 +4362,101 @@ static bool postcopy_is_running(void)
     return ps >= POSTCOPY_INCOMING_LISTENING && ps < POSTCOPY_INCOMING_END;
 }
 
+typedef struct ColoFlushWorker {
+    QemuThread thread;
+    /* range of bitmap words of each block handled by this worker */
+    unsigned int index;
+    unsigned int nr_workers;
+    /* number of pages copied back */
+    uint64_t pages;
+} ColoFlushWorker;
+
+/*
+ * Copy the dirty pages of one slice of every RAM block from the cache
+ * into SVM's memory.  Slices are whole bitmap words, so the workers
+ * never touch the same word and need no locking; the secondary does not
+ * use clear_bmap, so there is no dirty log to clear page by page.
+ *
+ * The caller holds the RCU read lock for the lifetime of the workers.
+ */
+static void *colo_flush_ram_cache_thread(void *opaque)
+{
+    ColoFlushWorker *w = opaque;
+    RAMBlock *block;
+
+    RAMBLOCK_FOREACH_NOT_IGNORED(block) {
+        unsigned long pages = block->used_length >> TARGET_PAGE_BITS;
+        unsigned long words = BITS_TO_LONGS(pages);
+        unsigned long per_worker = DIV_ROUND_UP(words, w->nr_workers);
+        unsigned long start = w->index * per_worker;
+        unsigned long end = MIN(start + per_worker, words);
+        unsigned long i;
+
+        for (i = start; i < end; i++) {
+            unsigned long word = qatomic_xchg(&block->bmap[i], 0);
+
+            w->pages += ctpopl(word);
+            while (word) {
+                unsigned long page = i * BITS_PER_LONG + ctzl(word);
+                ram_addr_t offset = ((ram_addr_t)page) << TARGET_PAGE_BITS;
+
+                memcpy(block->host + offset, block->colo_cache + offset,
+                       TARGET_PAGE_SIZE);
+                word &= word - 1;
+            }
+        }
+    }
+
+    return NULL;
+}
+
 /*
  * Flush content of RAM cache into SVM's memory.
  * Only flush the pages that be dirtied by PVM or SVM or both.
+ *
+ * The copy is spread over as many threads as there are multifd channels,
+ * since that is how much parallelism the user granted to the migration.
  */
 void colo_flush_ram_cache(void)
 {
     RAMBlock *block = NULL;
-    void *dst_host;
-    void *src_host;
-    unsigned long offset = 0;
+    unsigned int nr_workers = migrate_use_multifd() ?
+                              migrate_multifd_channels() : 1;
+    g_autofree ColoFlushWorker *workers = g_new0(ColoFlushWorker, nr_workers);
+    uint64_t flushed = 0;
+    unsigned int i;
 
     memory_global_dirty_log_sync();
+    qemu_mutex_lock(&ram_state->bitmap_mutex);
     WITH_RCU_READ_LOCK_GUARD() {
         RAMBLOCK_FOREACH_NOT_IGNORED(block) {
             ramblock_sync_dirty_bitmap(ram_state, block);
         }
     }
+    qemu_mutex_unlock(&ram_state->bitmap_mutex);
 
     trace_colo_flush_ram_cache_begin(ram_state->migration_dirty_pages);
     WITH_RCU_READ_LOCK_GUARD() {
-        block = QLIST_FIRST_RCU(&ram_list.blocks);
-
-        while (block) {
-            offset = migration_bitmap_find_dirty(ram_state, block, offset);
-
-            if (((ram_addr_t)offset) << TARGET_PAGE_BITS
-                >= block->used_length) {
-                offset = 0;
-                block = QLIST_NEXT_RCU(block, next);
-            } else {
-                migration_bitmap_clear_dirty(ram_state, block, offset);
-                dst_host = block->host
-                         + (((ram_addr_t)offset) << TARGET_PAGE_BITS);
-                src_host = block->colo_cache
-                         + (((ram_addr_t)offset) << TARGET_PAGE_BITS);
-                memcpy(dst_host, src_host, TARGET_PAGE_SIZE);
-            }
+        for (i = 0; i < nr_workers; i++) {
+            workers[i].index = i;
+            workers[i].nr_workers = nr_workers;
+        }
+        for (i = 1; i < nr_workers; i++) {
+            qemu_thread_create(&workers[i].thread, "colo-flush",
+                               colo_flush_ram_cache_thread, &workers[i],
+                               QEMU_THREAD_JOINABLE);
+        }
+        colo_flush_ram_cache_thread(&workers[0]);
+        flushed += workers[0].pages;
+        for (i = 1; i < nr_workers; i++) {
+            qemu_thread_join(&workers[i].thread);
+            flushed += workers[i].pages;
         }
     }
+
+    qemu_mutex_lock(&ram_state->bitmap_mutex);
+    ram_state->migration_dirty_pages -= flushed;
+    qemu_mutex_unlock(&ram_state->bitmap_mutex);
     trace_colo_flush_ram_cache_end();
 }
 
@@ -3750,8 +4470,126 @@ void colo_flush_ram_cache(void)
  *
  * @f: QEMUFile where to send the data
  */
+/*
+ * Whether the pages of @block can be mapped copy-on-write from the
+ * migration file: only anonymous, private memory with host-sized pages
+ * can simply be replaced by a private file mapping.
+ */
+static bool mapped_ram_can_map(RAMBlock *block)
+{
+    return migrate_mapped_ram_private() && block->fd < 0 &&
+           !qemu_ram_is_shared(block) &&
+           block->page_size == qemu_real_host_page_size;
+}
+
+/*
+ * Read the pages of @block from its region of the migration file, or
+ * map them with mapped-ram-private.  Pages missing from the file are
+ * zero and keep the anonymous memory they already have.
+ *
+ * Returns 0 for success or a negative errno
+ */
+static int parse_ramblock_mapped_ram(QEMUFile *f, RAMBlock *block,
+                                     ram_addr_t length)
+{
+    g_autofree unsigned long *bitmap = NULL;
+    MappedRamHeader header;
+    size_t bitmap_size;
+    long num_pages, first, last = 0;
+    bool can_map;
+    int ret;
+
+    qemu_get_buffer(f, (uint8_t *)&header, sizeof(header));
+    be32_to_cpus(&header.version);
+    be64_to_cpus(&header.page_size);
+    be64_to_cpus(&header.bitmap_offset);
+    be64_to_cpus(&header.pages_offset);
+
+    if (header.version > MAPPED_RAM_HDR_VERSION) {
+        error_report("Migration mapped-ram header version %" PRIu32
+                     " too new for block %s", header.version, block->idstr);
+        return -EINVAL;
+    }
+    if (header.page_size != TARGET_PAGE_SIZE) {
+        error_report("Mismatched mapped-ram page size for block %s "
+                     "(local) %" PRIu64 " != %" PRIu64, block->idstr,
+                     (uint64_t)TARGET_PAGE_SIZE, header.page_size);
+        return -EINVAL;
+    }
+    if (!QEMU_IS_ALIGNED(header.pages_offset,
+                         MAPPED_RAM_FILE_OFFSET_ALIGNMENT)) {
+        error_report("Misaligned mapped-ram pages offset for block %s",
+                     block->idstr);
+        return -EINVAL;
+    }
+
+    num_pages = length >> TARGET_PAGE_BITS;
+    bitmap_size = BITS_TO_LONGS(num_pages) * sizeof(unsigned long);
+    bitmap = bitmap_new(num_pages);
+    if (qemu_get_buffer_at(f, (uint8_t *)bitmap, bitmap_size,
+                           header.bitmap_offset) != bitmap_size) {
+        error_report("Failed to read mapped-ram bitmap of block %s",
+                     block->idstr);
+        return -EINVAL;
+    }
+    bitmap_from_le(bitmap, bitmap, num_pages);
+
+    block->pages_offset = header.pages_offset;
+    can_map = mapped_ram_can_map(block);
+
+    for (first = find_first_bit(bitmap, num_pages); first < num_pages;
+         first = find_next_bit(bitmap, num_pages, last + 1)) {
+        ram_addr_t offset = (ram_addr_t)first << TARGET_PAGE_BITS;
+        size_t run;
+
+        last = find_next_zero_bit(bitmap, num_pages, first + 1) - 1;
+        run = (last - first + 1) << TARGET_PAGE_BITS;
+
+        if (can_map && QEMU_IS_ALIGNED(offset | run,
+                                       qemu_real_host_page_size)) {
+            ret = qemu_map_buffer_at(f, block->host + offset, run,
+                                     block->pages_offset + offset);
+            if (!ret) {
+                trace_ram_load_mapped_ram_map(block->idstr, offset, run);
+                continue;
+            }
+            if (ret != -ENOTSUP) {
+                error_report("Failed to map mapped-ram pages of block %s",
+                             block->idstr);
+                return ret;
+            }
+            can_map = false;
+        }
+
+        if (migrate_use_multifd()) {
+            ram_addr_t off;
+
+            for (off = offset; off < offset + run; off += TARGET_PAGE_SIZE) {
+                if (multifd_recv_queue_page(block, off) < 0) {
+                    return -EIO;
+                }
+            }
+        } else if (qemu_get_buffer_at(f, block->host + offset, run,
+                                      block->pages_offset + offset) != run) {
+            error_report("Failed to read mapped-ram pages of block %s",
+                         block->idstr);
+            return -EIO;
+        }
+    }
+
+    if (migrate_use_multifd() && multifd_recv_sync_pages() < 0) {
+        return -EIO;
+    }
+
+    /* Skip over the region of this block, the stream goes on after it */
+    qemu_set_offset(f, block->pages_offset + length, SEEK_SET);
+
+    return qemu_file_get_error(f);
+}
+
 static int ram_load_precopy(QEMUFile *f)
 {
+    MigrationIncomingState *mis = migration_incoming_get_current();
     int flags = 0, ret = 0, invalid_flags = 0, len = 0, i = 0;
     /* ADVISE is earlier, it shows the source has the postcopy capability on */
     bool postcopy_advised = postcopy_is_advised();
@@ -3790,7 +4628,8 @@ static int ram_load_precopy(QEMUFile *f)
 
         if (flags & (RAM_SAVE_FLAG_ZERO | RAM_SAVE_FLAG_PAGE |
                      RAM_SAVE_FLAG_COMPRESS_PAGE | RAM_SAVE_FLAG_XBZRLE)) {
-            RAMBlock *block = ram_block_from_stream(f, flags);
+            RAMBlock *block = ram_block_from_stream(mis, f, flags,
+                                                    RAM_CHANNEL_PRECOPY);
 
             host = host_from_ram_block_offset(block, addr);
             /*
@@ -3879,6 +4718,9 @@ static int ram_load_precopy(QEMUFile *f)
                             ret = -EINVAL;
                         }
                     }
+                    if (!ret && migrate_mapped_ram()) {
+                        ret = parse_ramblock_mapped_ram(f, block, length);
+                    }
                     ram_control_load_hook(f, RAM_CONTROL_BLOCK_REG,
                                           block->idstr);
                 } else {
@@ -3893,11 +4735,19 @@ static int ram_load_precopy(QEMUFile *f)
 
         case RAM_SAVE_FLAG_ZERO:
             ch = qemu_get_byte(f);
-            ram_handle_compressed(host, ch, TARGET_PAGE_SIZE);
+            if (load_param && !host_bak) {
+                load_page_with_threads(f, host, true, ch);
+            } else {
+                ram_handle_compressed(host, ch, TARGET_PAGE_SIZE);
+            }
             break;
 
         case RAM_SAVE_FLAG_PAGE:
-            qemu_get_buffer(f, host, TARGET_PAGE_SIZE);
+            if (load_param && !host_bak) {
+                load_page_with_threads(f, host, false, 0);
+            } else {
+                qemu_get_buffer(f, host, TARGET_PAGE_SIZE);
+            }
             break;
 
         case RAM_SAVE_FLAG_COMPRESS_PAGE:
@@ -3939,6 +4789,7 @@ static int ram_load_precopy(QEMUFile *f)
         }
     }
 
+    wait_for_load_done();
     ret |= wait_for_decompress_done();
     return ret;
 }
@@ -3967,7 +4818,7 @@ static int ram_load(QEMUFile *f, void *opaque, int version_id)
      */
     WITH_RCU_READ_LOCK_GUARD() {
         if (postcopy_running) {
-            ret = ram_load_postcopy(f);
+            ret = ram_load_postcopy(f, RAM_CHANNEL_PRECOPY);
         } else {
             ret = ram_load_precopy(f);
         }
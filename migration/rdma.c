@@ -22,6 +22,7 @@
 #include "qemu-file.h"
 #include "ram.h"
 #include "qemu-file-channel.h"
+#include "multifd.h"
 #include "qemu/error-report.h"
 #include "qemu/main-loop.h"
 #include "qemu/module.h"
@@ -30,6 +31,7 @@
 #include "qemu/bitmap.h"
 #include "qemu/coroutine.h"
 #include "exec/memory.h"
+#include "exec/target_page.h"
 #include <sys/socket.h>
 #include <netdb.h>
 #include <arpa/inet.h>
@@ -396,6 +398,13 @@ typedef struct RDMAContext {
     /* the RDMAContext for return path */
     struct RDMAContext *return_path;
     bool is_return_path;
+
+    /*
+     * For a multifd channel, the RDMAContext of the main connection.
+     * The channel uses its protection domain and the RAM blocks it
+     * registered, so that pages can be written with the same keys.
+     */
+    struct RDMAContext *multifd_parent;
 } RDMAContext;
 
 #define TYPE_QIO_CHANNEL_RDMA "qio-channel-rdma"
@@ -1048,11 +1057,15 @@ err_resolve_create_id:
  */
 static int qemu_rdma_alloc_pd_cq(RDMAContext *rdma)
 {
-    /* allocate pd */
-    rdma->pd = ibv_alloc_pd(rdma->verbs);
-    if (!rdma->pd) {
-        error_report("failed to allocate protection domain");
-        return -1;
+    /* allocate pd, a multifd channel uses the one of its parent */
+    if (rdma->multifd_parent) {
+        rdma->pd = rdma->multifd_parent->pd;
+    } else {
+        rdma->pd = ibv_alloc_pd(rdma->verbs);
+        if (!rdma->pd) {
+            error_report("failed to allocate protection domain");
+            return -1;
+        }
     }
 
     /* create completion channel */
@@ -1076,7 +1089,7 @@ static int qemu_rdma_alloc_pd_cq(RDMAContext *rdma)
     return 0;
 
 err_alloc_pd_cq:
-    if (rdma->pd) {
+    if (rdma->pd && !rdma->multifd_parent) {
         ibv_dealloc_pd(rdma->pd);
     }
     if (rdma->comp_channel) {
@@ -2315,7 +2328,7 @@ static void qemu_rdma_cleanup(RDMAContext *rdma)
     if (rdma->cm_id && rdma->connected) {
         if ((rdma->error_state ||
              migrate_get_current()->state == MIGRATION_STATUS_CANCELLING) &&
-            !rdma->received_error) {
+            !rdma->received_error && !rdma->multifd_parent) {
             RDMAControlHeader head = { .len = 0,
                                        .type = RDMA_CONTROL_ERROR,
                                        .repeat = 1,
@@ -2362,7 +2375,9 @@ static void qemu_rdma_cleanup(RDMAContext *rdma)
         rdma->comp_channel = NULL;
     }
     if (rdma->pd) {
-        ibv_dealloc_pd(rdma->pd);
+        if (!rdma->multifd_parent) {
+            ibv_dealloc_pd(rdma->pd);
+        }
         rdma->pd = NULL;
     }
     if (rdma->cm_id) {
@@ -2410,6 +2425,12 @@ static int qemu_rdma_source_init(RDMAContext *rdma, bool pin_all, Error **errp)
         goto err_rdma_source_init;
     }
 
+    if (rdma->multifd_parent && rdma->verbs != rdma->multifd_parent->verbs) {
+        ERROR(temp, "multifd channel is not on the device of the main "
+                    "connection!");
+        goto err_rdma_source_init;
+    }
+
     ret = qemu_rdma_alloc_pd_cq(rdma);
     if (ret) {
         ERROR(temp, "rdma migration: error allocating pd and cq! Your mlock()"
@@ -2424,18 +2445,21 @@ static int qemu_rdma_source_init(RDMAContext *rdma, bool pin_all, Error **errp)
         goto err_rdma_source_init;
     }
 
-    ret = qemu_rdma_init_ram_blocks(rdma);
-    if (ret) {
-        ERROR(temp, "rdma migration: error initializing ram blocks!");
-        goto err_rdma_source_init;
-    }
+    /* A multifd channel writes from the RAM blocks of its parent */
+    if (!rdma->multifd_parent) {
+        ret = qemu_rdma_init_ram_blocks(rdma);
+        if (ret) {
+            ERROR(temp, "rdma migration: error initializing ram blocks!");
+            goto err_rdma_source_init;
+        }
 
-    /* Build the hash that maps from offset to RAMBlock */
-    rdma->blockmap = g_hash_table_new(g_direct_hash, g_direct_equal);
-    for (idx = 0; idx < rdma->local_ram_blocks.nb_blocks; idx++) {
-        g_hash_table_insert(rdma->blockmap,
+        /* Build the hash that maps from offset to RAMBlock */
+        rdma->blockmap = g_hash_table_new(g_direct_hash, g_direct_equal);
+        for (idx = 0; idx < rdma->local_ram_blocks.nb_blocks; idx++) {
+            g_hash_table_insert(rdma->blockmap,
                 (void *)(uintptr_t)rdma->local_ram_blocks.block[idx].offset,
                 &rdma->local_ram_blocks.block[idx]);
+        }
     }
 
     for (idx = 0; idx < RDMA_WRID_MAX; idx++) {
@@ -2668,6 +2692,7 @@ static ssize_t qio_channel_rdma_writev(QIOChannel *ioc,
                                        size_t niov,
                                        int *fds,
                                        size_t nfds,
+                                       int flags,
                                        Error **errp)
 {
     QIOChannelRDMA *rioc = QIO_CHANNEL_RDMA(ioc);
@@ -3140,7 +3165,8 @@ static size_t qemu_rdma_save_page(QEMUFile *f, void *opaque,
 
     CHECK_ERROR_STATE();
 
-    if (migration_in_postcopy()) {
+    /* With multifd the pages are written by the multifd channels */
+    if (migration_in_postcopy() || migrate_use_multifd()) {
         return RAM_SAVE_CONTROL_NOT_SUPP;
     }
 
@@ -3232,27 +3258,33 @@ err:
 }
 
 static void rdma_accept_incoming_migration(void *opaque);
+static void rdma_accept_incoming_multifd(void *opaque);
 
-static void rdma_cm_poll_handler(void *opaque)
+static void rdma_cm_handle_event(RDMAContext *rdma,
+                                 struct rdma_cm_event *cm_event)
 {
-    RDMAContext *rdma = opaque;
-    int ret;
-    struct rdma_cm_event *cm_event;
     MigrationIncomingState *mis = migration_incoming_get_current();
+    enum rdma_cm_event_type event = cm_event->event;
+    struct rdma_cm_id *id = cm_event->id;
 
-    ret = rdma_get_cm_event(rdma->channel, &cm_event);
-    if (ret) {
-        error_report("get_cm_event failed %d", errno);
+    rdma_ack_cm_event(cm_event);
+
+    /*
+     * The multifd channels share the event channel.  The source closes
+     * them once it is done, maybe before we are, so only the main
+     * connection and the return path decide about errors.
+     */
+    if (migrate_use_multifd() && id != rdma->cm_id &&
+        !(rdma->return_path && id == rdma->return_path->cm_id)) {
         return;
     }
-    rdma_ack_cm_event(cm_event);
 
-    if (cm_event->event == RDMA_CM_EVENT_DISCONNECTED ||
-        cm_event->event == RDMA_CM_EVENT_DEVICE_REMOVAL) {
+    if (event == RDMA_CM_EVENT_DISCONNECTED ||
+        event == RDMA_CM_EVENT_DEVICE_REMOVAL) {
         if (!rdma->error_state &&
             migration_incoming_get_current()->state !=
               MIGRATION_STATUS_COMPLETED) {
-            error_report("receive cm event, cm event is %d", cm_event->event);
+            error_report("receive cm event, cm event is %d", event);
             rdma->error_state = -EPIPE;
             if (rdma->return_path) {
                 rdma->return_path->error_state = -EPIPE;
@@ -3266,6 +3298,20 @@ static void rdma_cm_poll_handler(void *opaque)
     }
 }
 
+static void rdma_cm_poll_handler(void *opaque)
+{
+    RDMAContext *rdma = opaque;
+    int ret;
+    struct rdma_cm_event *cm_event;
+
+    ret = rdma_get_cm_event(rdma->channel, &cm_event);
+    if (ret) {
+        error_report("get_cm_event failed %d", errno);
+        return;
+    }
+    rdma_cm_handle_event(rdma, cm_event);
+}
+
 static int qemu_rdma_accept(RDMAContext *rdma)
 {
     RDMACapabilities cap;
@@ -3365,6 +3411,10 @@ static int qemu_rdma_accept(RDMAContext *rdma)
         qemu_set_fd_handler(rdma->channel->fd, rdma_accept_incoming_migration,
                             NULL,
                             (void *)(intptr_t)rdma->return_path);
+    } else if (migrate_use_multifd()) {
+        /* and the following ones for the multifd channels */
+        qemu_set_fd_handler(rdma->channel->fd, rdma_accept_incoming_multifd,
+                            NULL, rdma);
     } else {
         qemu_set_fd_handler(rdma->channel->fd, rdma_cm_poll_handler,
                             NULL, rdma);
@@ -4010,6 +4060,138 @@ static void rdma_accept_incoming_migration(void *opaque)
     }
 }
 
+/*
+ * Accept a multifd channel of the source.  The pages are RDMA written
+ * through it into the RAM blocks that the main connection registered,
+ * so it only needs a queue pair in the same protection domain.
+ */
+static RDMAContext *qemu_rdma_multifd_accept(RDMAContext *parent,
+                                             struct rdma_cm_event *cm_event,
+                                             Error **errp)
+{
+    RDMACapabilities cap;
+    struct rdma_conn_param conn_param = {
+                                            .responder_resources = 2,
+                                            .private_data = &cap,
+                                            .private_data_len = sizeof(cap),
+                                         };
+    RDMAContext *rdma;
+    int ret;
+
+    memcpy(&cap, cm_event->param.conn.private_data, sizeof(cap));
+    network_to_caps(&cap);
+
+    rdma = g_new0(RDMAContext, 1);
+    rdma->current_index = -1;
+    rdma->current_chunk = -1;
+    rdma->multifd_parent = parent;
+    rdma->cm_id = cm_event->id;
+    rdma->verbs = cm_event->id->verbs;
+
+    rdma_ack_cm_event(cm_event);
+
+    if (cap.version < 1 || cap.version > RDMA_CONTROL_VERSION_CURRENT) {
+        ERROR(errp, "Unknown source RDMA version: %d, bailing...",
+              cap.version);
+        goto err_rdma_multifd_accept;
+    }
+    cap.flags = 0;
+    caps_to_network(&cap);
+
+    if (rdma->verbs != parent->verbs) {
+        ERROR(errp, "ibv context not matching %p, %p!", parent->verbs,
+              rdma->verbs);
+        goto err_rdma_multifd_accept;
+    }
+
+    ret = qemu_rdma_alloc_pd_cq(rdma);
+    if (ret) {
+        ERROR(errp, "rdma migration: error allocating cq!");
+        goto err_rdma_multifd_accept;
+    }
+
+    ret = qemu_rdma_alloc_qp(rdma);
+    if (ret) {
+        ERROR(errp, "rdma migration: error allocating qp!");
+        goto err_rdma_multifd_accept;
+    }
+
+    ret = rdma_accept(rdma->cm_id, &conn_param);
+    if (ret) {
+        ERROR(errp, "rdma_accept returns %d", ret);
+        goto err_rdma_multifd_accept;
+    }
+
+    ret = rdma_get_cm_event(parent->channel, &cm_event);
+    if (ret) {
+        ERROR(errp, "rdma_accept get_cm_event failed %d", ret);
+        goto err_rdma_multifd_accept;
+    }
+
+    if (cm_event->event != RDMA_CM_EVENT_ESTABLISHED) {
+        ERROR(errp, "rdma_accept not event established");
+        rdma_ack_cm_event(cm_event);
+        goto err_rdma_multifd_accept;
+    }
+
+    rdma_ack_cm_event(cm_event);
+    rdma->connected = true;
+
+    qemu_rdma_dump_gid("dest_multifd_connect", rdma->cm_id);
+
+    return rdma;
+
+err_rdma_multifd_accept:
+    qemu_rdma_cleanup(rdma);
+    g_free(rdma);
+    return NULL;
+}
+
+static void rdma_accept_incoming_multifd(void *opaque)
+{
+    RDMAContext *rdma = opaque;
+    struct rdma_cm_event *cm_event;
+    QIOChannelRDMA *rioc;
+    Error *local_err = NULL;
+    RDMAContext *channel;
+    bool all_channels;
+    int ret;
+
+    ret = rdma_get_cm_event(rdma->channel, &cm_event);
+    if (ret) {
+        error_report("get_cm_event failed %d", errno);
+        return;
+    }
+
+    if (cm_event->event != RDMA_CM_EVENT_CONNECT_REQUEST) {
+        rdma_cm_handle_event(rdma, cm_event);
+        return;
+    }
+
+    trace_qemu_rdma_accept_incoming_multifd();
+    channel = qemu_rdma_multifd_accept(rdma, cm_event, &local_err);
+    if (!channel) {
+        error_reportf_err(local_err, "RDMA ERROR: multifd channel: ");
+        rdma->error_state = -EINVAL;
+        return;
+    }
+
+    rioc = QIO_CHANNEL_RDMA(object_new(TYPE_QIO_CHANNEL_RDMA));
+    rioc->rdmain = channel;
+    all_channels = multifd_recv_new_channel(QIO_CHANNEL(rioc), &local_err);
+    object_unref(OBJECT(rioc));
+    if (local_err) {
+        error_reportf_err(local_err, "RDMA ERROR:");
+        rdma->error_state = -EINVAL;
+        return;
+    }
+
+    if (all_channels) {
+        qemu_set_fd_handler(rdma->channel->fd, rdma_cm_poll_handler,
+                            NULL, rdma);
+    }
+}
+
 void rdma_start_incoming_migration(const char *host_port, Error **errp)
 {
     int ret;
@@ -4059,6 +4241,7 @@ void rdma_start_incoming_migration(const char *host_port, Error **errp)
 
     qemu_set_fd_handler(rdma->channel->fd, rdma_accept_incoming_migration,
                         NULL, (void *)(intptr_t)rdma);
+    migrate_get_current()->rdma_migration = true;
     return;
 err:
     error_propagate(errp, local_err);
@@ -4069,6 +4252,236 @@ err:
     g_free(rdma_return_path);
 }
 
+/*
+ * The multifd channels connect to the same address as the main
+ * connection and write with the RAM blocks it registered.
+ */
+static struct RDMAOutgoingArgs {
+    char *host_port;
+    RDMAContext *rdma;
+} outgoing_args;
+
+void rdma_send_channel_create(QIOTaskFunc f, void *data)
+{
+    QIOChannelRDMA *rioc;
+    RDMAContext *rdma;
+    QIOTask *task;
+    Error *err = NULL;
+
+    rioc = QIO_CHANNEL_RDMA(object_new(TYPE_QIO_CHANNEL_RDMA));
+    task = qio_task_new(OBJECT(rioc), f, data, NULL);
+
+    rdma = qemu_rdma_data_init(outgoing_args.host_port, &err);
+    if (rdma == NULL) {
+        goto out;
+    }
+    rdma->multifd_parent = outgoing_args.rdma;
+
+    if (qemu_rdma_source_init(rdma, false, &err) ||
+        qemu_rdma_connect(rdma, &err)) {
+        g_free(rdma);
+        goto out;
+    }
+    rioc->rdmaout = rdma;
+
+out:
+    if (err) {
+        qio_task_set_error(task, err);
+    }
+    qio_task_complete(task);
+}
+
+/*
+ * Poll for one RDMA write completion of a multifd channel.
+ *
+ * Returns 1 if one completed, 0 if there was none, < 0 on error.
+ */
+static int qemu_rdma_multifd_poll(RDMAContext *rdma)
+{
+    struct ibv_wc wc;
+    int ret;
+
+    ret = ibv_poll_cq(rdma->cq, 1, &wc);
+    if (ret <= 0) {
+        return ret;
+    }
+
+    if (wc.status != IBV_WC_SUCCESS) {
+        error_report("ibv_poll_cq wc.status=%d %s!", wc.status,
+                     ibv_wc_status_str(wc.status));
+        return -1;
+    }
+
+    rdma->nb_sent--;
+    return 1;
+}
+
+/*
+ * Wait until no more than @max_sent RDMA writes of a multifd channel
+ * are still in flight.
+ */
+static int qemu_rdma_multifd_wait(RDMAContext *rdma, int max_sent)
+{
+    struct ibv_cq *cq;
+    void *cq_ctx;
+    int ret;
+
+    while (rdma->nb_sent > max_sent) {
+        ret = qemu_rdma_multifd_poll(rdma);
+        if (ret) {
+            if (ret < 0) {
+                return ret;
+            }
+            continue;
+        }
+
+        if (ibv_req_notify_cq(rdma->cq, 0)) {
+            return -1;
+        }
+        /* a completion can arrive before the notification is armed */
+        ret = qemu_rdma_multifd_poll(rdma);
+        if (ret) {
+            if (ret < 0) {
+                return ret;
+            }
+            continue;
+        }
+
+        ret = qemu_rdma_wait_comp_channel(rdma);
+        if (ret) {
+            return ret;
+        }
+        if (ibv_get_cq_event(rdma->comp_channel, &cq, &cq_ctx)) {
+            return -1;
+        }
+        ibv_ack_cq_events(cq, 1);
+    }
+
+    return 0;
+}
+
+/*
+ * Post a single RDMA write of @len bytes at @offset of @block.  Both
+ * sides registered the whole block up front, so there is no
+ * registration to wait for.
+ */
+static int qemu_rdma_multifd_post(RDMAContext *rdma, RDMALocalBlock *block,
+                                  uint64_t offset, uint64_t len)
+{
+    struct ibv_sge sge = {
+        .addr = (uintptr_t)(block->local_host_addr + offset),
+        .length = len,
+        .lkey = block->mr->lkey,
+    };
+    struct ibv_send_wr send_wr = {
+        .wr_id = RDMA_WRID_RDMA_WRITE,
+        .opcode = IBV_WR_RDMA_WRITE,
+        .send_flags = IBV_SEND_SIGNALED,
+        .sg_list = &sge,
+        .num_sge = 1,
+        .wr.rdma.remote_addr = block->remote_host_addr + offset,
+        .wr.rdma.rkey = block->remote_rkey,
+    };
+    struct ibv_send_wr *bad_wr;
+    int ret;
+
+    /* make room in the send queue */
+    ret = qemu_rdma_multifd_wait(rdma, RDMA_SIGNALED_SEND_MAX - 1);
+    if (ret) {
+        return ret;
+    }
+
+    /*
+     * ibv_post_send() does not return negative error numbers,
+     * per the specification they are positive - no idea why.
+     */
+    ret = ibv_post_send(rdma->qp, &send_wr, &bad_wr);
+    if (ret > 0) {
+        return -ret;
+    }
+
+    rdma->nb_sent++;
+    rdma->total_writes++;
+    return 0;
+}
+
+/*
+ * Write the @used pages at @offset in @rb to the destination.  Runs of
+ * contiguous pages go out in a single RDMA write.  The writes are only
+ * known to be done after rdma_multifd_flush().
+ */
+int rdma_multifd_write_pages(QIOChannel *ioc, RAMBlock *rb,
+                             const ram_addr_t *offset, uint32_t used,
+                             Error **errp)
+{
+    QIOChannelRDMA *rioc = QIO_CHANNEL_RDMA(ioc);
+    size_t page_size = qemu_target_page_size();
+    RDMALocalBlock *block;
+    RDMAContext *rdma;
+    uint32_t i, start = 0;
+    int ret;
+
+    RCU_READ_LOCK_GUARD();
+    rdma = qatomic_rcu_read(&rioc->rdmaout);
+    if (!rdma || rdma->error_state) {
+        error_setg(errp, "RDMA ERROR: multifd channel is not usable");
+        return -1;
+    }
+
+    block = g_hash_table_lookup(rdma->multifd_parent->blockmap,
+                          (void *)(uintptr_t)qemu_ram_get_offset(rb));
+    if (!block || !block->mr) {
+        error_setg(errp, "RDMA ERROR: RAM block %s is not registered",
+                   qemu_ram_get_idstr(rb));
+        return -1;
+    }
+
+    for (i = 1; i <= used; i++) {
+        if (i < used && offset[i] == offset[i - 1] + page_size) {
+            continue;
+        }
+
+        ret = qemu_rdma_multifd_post(rdma, block, offset[start],
+                                     (i - start) * page_size);
+        if (ret) {
+            rdma->error_state = ret;
+            error_setg(errp, "RDMA ERROR: multifd write of %s failed",
+                       qemu_ram_get_idstr(rb));
+            return -1;
+        }
+        start = i;
+    }
+
+    return 0;
+}
+
+/*
+ * Wait for all the RDMA writes of a multifd channel to complete, that
+ * is, for the pages to be in the destination memory.
+ */
+int rdma_multifd_flush(QIOChannel *ioc, Error **errp)
+{
+    QIOChannelRDMA *rioc = QIO_CHANNEL_RDMA(ioc);
+    RDMAContext *rdma;
+    int ret;
+
+    RCU_READ_LOCK_GUARD();
+    rdma = qatomic_rcu_read(&rioc->rdmaout);
+    if (!rdma) {
+        error_setg(errp, "RDMA ERROR: multifd channel is not usable");
+        return -1;
+    }
+
+    ret = qemu_rdma_multifd_wait(rdma, 0);
+    if (ret) {
+        rdma->error_state = ret;
+        error_setg(errp, "RDMA ERROR: multifd completion polling failed");
+        return -1;
+    }
+
+    return 0;
+}
+
 void rdma_start_outgoing_migration(void *opaque,
                             const char *host_port, Error **errp)
 {
@@ -4130,6 +4543,11 @@ void rdma_start_outgoing_migration(void *opaque,
 
     trace_rdma_start_outgoing_migration_after_rdma_connect();
 
+    g_free(outgoing_args.host_port);
+    outgoing_args.host_port = g_strdup(host_port);
+    outgoing_args.rdma = rdma;
+    s->rdma_migration = true;
+
     s->to_dst_file = qemu_fopen_rdma(rdma, "wb");
     migrate_fd_connect(s, NULL);
     return;
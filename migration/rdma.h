@@ -17,9 +17,38 @@
 #ifndef QEMU_MIGRATION_RDMA_H
 #define QEMU_MIGRATION_RDMA_H
 
+#include "exec/cpu-common.h"
+#include "io/task.h"
+
 void rdma_start_outgoing_migration(void *opaque, const char *host_port,
                                    Error **errp);
 
 void rdma_start_incoming_migration(const char *host_port, Error **errp);
 
+#ifdef CONFIG_RDMA
+void rdma_send_channel_create(QIOTaskFunc f, void *data);
+int rdma_multifd_write_pages(QIOChannel *ioc, RAMBlock *rb,
+                             const ram_addr_t *offset, uint32_t used,
+                             Error **errp);
+int rdma_multifd_flush(QIOChannel *ioc, Error **errp);
+#else
+/* migrate_rdma() is never true without CONFIG_RDMA */
+static inline void rdma_send_channel_create(QIOTaskFunc f, void *data)
+{
+    g_assert_not_reached();
+}
+
+static inline int rdma_multifd_write_pages(QIOChannel *ioc, RAMBlock *rb,
+                                           const ram_addr_t *offset,
+                                           uint32_t used, Error **errp)
+{
+    g_assert_not_reached();
+}
+
+static inline int rdma_multifd_flush(QIOChannel *ioc, Error **errp)
+{
+    g_assert_not_reached();
+}
+#endif
+
 #endif
@@ -55,6 +55,7 @@
 #include "qemu/main-loop.h"
 #include "block/snapshot.h"
 #include "qemu/cutils.h"
+#include "qemu/units.h"
 #include "io/channel-buffer.h"
 #include "io/channel-file.h"
 #include "sysemu/replay.h"
@@ -65,6 +66,7 @@
 #include "qemu/bitmap.h"
 #include "net/announce.h"
 #include "qemu/yank.h"
+#include "block/aio-wait.h"
 
 const unsigned int postcopy_ram_discard_version;
 
@@ -129,21 +131,6 @@ static struct mig_cmd_args {
 /***********************************************************/
 /* savevm/loadvm support */
 
-static ssize_t block_writev_buffer(void *opaque, struct iovec *iov, int iovcnt,
-                                   int64_t pos, Error **errp)
-{
-    int ret;
-    QEMUIOVector qiov;
-
-    qemu_iovec_init_external(&qiov, iov, iovcnt);
-    ret = bdrv_writev_vmstate(opaque, &qiov, pos);
-    if (ret < 0) {
-        return ret;
-    }
-
-    return qiov.size;
-}
-
 static ssize_t block_get_buffer(void *opaque, uint8_t *buf, int64_t pos,
                                 size_t size, Error **errp)
 {
@@ -160,15 +147,241 @@ static const QEMUFileOps bdrv_read_ops = {
     .close =      bdrv_fclose
 };
 
+/*
+ * The VM state is written in chunks that are aligned in the VM state area,
+ * several of them in flight at once, instead of one synchronous write per
+ * QEMUFile buffer.
+ */
+#define BDRV_VMSTATE_CHUNK_SIZE     (1 * MiB)
+#define BDRV_VMSTATE_MAX_IN_FLIGHT  8
+/* How long the migration thread waits for a free slot, see below */
+#define BDRV_VMSTATE_WAIT_MS        10
+
+typedef struct BdrvVMStateWriter {
+    BlockDriverState *bs;
+    AioContext *ctx;
+    /* the writer is used by a live snapshot from the migration thread */
+    bool live;
+    size_t chunk_size;
+
+    /* chunk being filled, starting at @buf_pos in the VM state */
+    uint8_t *buf;
+    int64_t buf_pos;
+    size_t buf_used;
+
+    QemuMutex lock;
+    QemuCond cond;
+    unsigned int in_flight;
+    int ret;
+
+    /* if set, receives the VM state size or an error on close */
+    int64_t *vm_state_size;
+} BdrvVMStateWriter;
+
+typedef struct BdrvVMStateChunk {
+    BdrvVMStateWriter *w;
+    uint8_t *buf;
+    int64_t pos;
+    size_t len;
+} BdrvVMStateChunk;
+
+static void coroutine_fn bdrv_vmstate_write_co(void *opaque)
+{
+    BdrvVMStateChunk *c = opaque;
+    BdrvVMStateWriter *w = c->w;
+    QEMUIOVector qiov;
+    int ret;
+
+    qemu_iovec_init_buf(&qiov, c->buf, c->len);
+    ret = bdrv_writev_vmstate(w->bs, &qiov, c->pos);
+    qemu_vfree(c->buf);
+    g_free(c);
+
+    qemu_mutex_lock(&w->lock);
+    if (ret < 0 && !w->ret) {
+        w->ret = ret;
+    }
+    qatomic_dec(&w->in_flight);
+    qemu_cond_signal(&w->cond);
+    qemu_mutex_unlock(&w->lock);
+    aio_wait_kick();
+}
+
+/*
+ * Wait until at most @max writes are in flight.
+ *
+ * With the BQL held we run the event loop ourselves; savevm additionally
+ * holds the AioContext of @bs, a live snapshot closing the file doesn't.
+ *
+ * The migration thread of a live snapshot must not wait for the block
+ * layer indefinitely: the thread completing our requests may itself be
+ * blocked on a write-protected guest page that only the migration thread
+ * can release.  So it only waits a bounded time for a free slot and lets
+ * the queue grow beyond the limit otherwise.
+ */
+static void bdrv_vmstate_wait(BdrvVMStateWriter *w, unsigned int max,
+                              bool bounded)
+{
+    if (qemu_mutex_iothread_locked()) {
+        AIO_WAIT_WHILE(w->live ? NULL : w->ctx,
+                       qatomic_read(&w->in_flight) > max);
+        return;
+    }
+
+    qemu_mutex_lock(&w->lock);
+    if (bounded) {
+        if (w->in_flight > max) {
+            qemu_cond_timedwait(&w->cond, &w->lock, BDRV_VMSTATE_WAIT_MS);
+        }
+    } else {
+        while (w->in_flight > max) {
+            qemu_cond_wait(&w->cond, &w->lock);
+        }
+    }
+    qemu_mutex_unlock(&w->lock);
+}
+
+static int bdrv_vmstate_submit(BdrvVMStateWriter *w)
+{
+    BdrvVMStateChunk *c;
+    Coroutine *co;
+    int ret;
+
+    bdrv_vmstate_wait(w, BDRV_VMSTATE_MAX_IN_FLIGHT - 1, true);
+
+    qemu_mutex_lock(&w->lock);
+    ret = w->ret;
+    if (!ret) {
+        qatomic_inc(&w->in_flight);
+    }
+    qemu_mutex_unlock(&w->lock);
+    if (ret < 0) {
+        return ret;
+    }
+
+    c = g_new(BdrvVMStateChunk, 1);
+    c->w = w;
+    c->buf = w->buf;
+    c->pos = w->buf_pos;
+    c->len = w->buf_used;
+    co = qemu_coroutine_create(bdrv_vmstate_write_co, c);
+    if (qemu_mutex_iothread_locked()) {
+        aio_co_enter(w->ctx, co);
+    } else {
+        aio_co_schedule(w->ctx, co);
+    }
+
+    w->buf_pos += w->buf_used;
+    w->buf_used = 0;
+    w->buf = qemu_blockalign(w->bs, w->chunk_size);
+    return 0;
+}
+
+static ssize_t bdrv_vmstate_writev_buffer(void *opaque, struct iovec *iov,
+                                          int iovcnt, int64_t pos,
+                                          Error **errp)
+{
+    BdrvVMStateWriter *w = opaque;
+    ssize_t done = 0;
+    int i, ret;
+
+    assert(pos == w->buf_pos + w->buf_used);
+
+    for (i = 0; i < iovcnt; i++) {
+        size_t off = 0;
+
+        while (off < iov[i].iov_len) {
+            size_t n = MIN(iov[i].iov_len - off,
+                           w->chunk_size - w->buf_used);
+
+            memcpy(w->buf + w->buf_used, iov[i].iov_base + off, n);
+            w->buf_used += n;
+            off += n;
+
+            if (w->buf_used == w->chunk_size) {
+                ret = bdrv_vmstate_submit(w);
+                if (ret < 0) {
+                    error_setg_errno(errp, -ret, "Failed to save VM state");
+                    return ret;
+                }
+            }
+        }
+        done += iov[i].iov_len;
+    }
+
+    return done;
+}
+
+static int bdrv_vmstate_fclose(void *opaque, Error **errp)
+{
+    BdrvVMStateWriter *w = opaque;
+    int64_t size = w->buf_pos + w->buf_used;
+    int ret = 0;
+
+    if (w->buf_used) {
+        ret = bdrv_vmstate_submit(w);
+    }
+    bdrv_vmstate_wait(w, 0, false);
+    if (!ret) {
+        ret = w->ret;
+    }
+
+    if (!ret) {
+        if (w->live) {
+            aio_context_acquire(w->ctx);
+        }
+        ret = bdrv_flush(w->bs);
+        if (w->live) {
+            aio_context_release(w->ctx);
+        }
+    }
+
+    if (w->vm_state_size) {
+        *w->vm_state_size = ret < 0 ? ret : size;
+    }
+
+    qemu_vfree(w->buf);
+    qemu_cond_destroy(&w->cond);
+    qemu_mutex_destroy(&w->lock);
+    g_free(w);
+    return ret;
+}
+
 static const QEMUFileOps bdrv_write_ops = {
-    .writev_buffer  = block_writev_buffer,
-    .close          = bdrv_fclose
+    .writev_buffer  = bdrv_vmstate_writev_buffer,
+    .close          = bdrv_vmstate_fclose
 };
 
+/*
+ * Open the VM state of @bs for writing.  A @live writer is written to by
+ * the migration thread and closed from the main loop without holding the
+ * AioContext of @bs; otherwise the caller holds it throughout.
+ */
+static QEMUFile *qemu_fopen_bdrv_writer(BlockDriverState *bs, bool live,
+                                        int64_t *vm_state_size)
+{
+    BdrvVMStateWriter *w = g_new0(BdrvVMStateWriter, 1);
+    BlockDriverInfo bdi;
+
+    w->bs = bs;
+    w->ctx = bdrv_get_aio_context(bs);
+    w->live = live;
+    w->chunk_size = BDRV_VMSTATE_CHUNK_SIZE;
+    if (bdrv_get_info(bs, &bdi) == 0 && bdi.cluster_size > 0) {
+        w->chunk_size = ROUND_UP(w->chunk_size, bdi.cluster_size);
+    }
+    w->buf = qemu_blockalign(bs, w->chunk_size);
+    w->vm_state_size = vm_state_size;
+    qemu_mutex_init(&w->lock);
+    qemu_cond_init(&w->cond);
+
+    return qemu_fopen_ops(w, &bdrv_write_ops);
+}
+
 static QEMUFile *qemu_fopen_bdrv(BlockDriverState *bs, int is_writable)
 {
     if (is_writable) {
-        return qemu_fopen_ops(bs, &bdrv_write_ops);
+        return qemu_fopen_bdrv_writer(bs, false, NULL);
     }
     return qemu_fopen_ops(bs, &bdrv_read_ops);
 }
@@ -1531,6 +1744,26 @@ void qemu_savevm_state_pending(QEMUFile *f, uint64_t threshold_size,
     }
 }
 
+/* Amount of state that is only sent once the VM is stopped */
+uint64_t qemu_savevm_state_stop_copy_size(void)
+{
+    SaveStateEntry *se;
+    uint64_t size = 0;
+
+    QTAILQ_FOREACH(se, &savevm_state.handlers, entry) {
+        if (!se->ops || !se->ops->save_stop_copy_size) {
+            continue;
+        }
+        if (se->ops->is_active) {
+            if (!se->ops->is_active(se->opaque)) {
+                continue;
+            }
+        }
+        size += se->ops->save_stop_copy_size(se->opaque);
+    }
+    return size;
+}
+
 void qemu_savevm_state_cleanup(void)
 {
     SaveStateEntry *se;
@@ -1566,6 +1799,7 @@ static int qemu_savevm_state(QEMUFile *f, Error **errp)
 
     migrate_init(ms);
     memset(&ram_counters, 0, sizeof(ram_counters));
+    memset(&iteration_counters, 0, sizeof(iteration_counters));
     ms->to_dst_file = f;
 
     qemu_mutex_unlock_iothread();
@@ -2294,6 +2528,16 @@ static int loadvm_process_command(QEMUFile *f)
             error_report("CMD_OPEN_RETURN_PATH failed");
             return -1;
         }
+
+        /* Nobody needs to approve the switchover, ACK it right away */
+        if (migrate_switchover_ack() && !mis->switchover_ack_pending_num) {
+            int ret = migrate_send_rp_switchover_ack(mis);
+            if (ret) {
+                error_report("Could not send switchover ack RP MSG, err %d "
+                             "(%s)", ret, strerror(-ret));
+                return ret;
+            }
+        }
         break;
 
     case MIG_CMD_PING:
@@ -2546,6 +2790,48 @@ static int qemu_loadvm_state_setup(QEMUFile *f)
     return 0;
 }
 
+static void qemu_loadvm_state_switchover_ack_needed(MigrationIncomingState *mis)
+{
+    SaveStateEntry *se;
+
+    mis->switchover_ack_pending_num = 0;
+    QTAILQ_FOREACH(se, &savevm_state.handlers, entry) {
+        if (!se->ops || !se->ops->switchover_ack_needed) {
+            continue;
+        }
+        if (se->ops->is_active && !se->ops->is_active(se->opaque)) {
+            continue;
+        }
+        if (se->ops->switchover_ack_needed(se->opaque)) {
+            mis->switchover_ack_pending_num++;
+        }
+    }
+    trace_loadvm_state_switchover_ack_needed(mis->switchover_ack_pending_num);
+}
+
+/*
+ * Called by a handler that asked for switchover_ack_needed once it is
+ * ready for the source to stop the VM.  The last one sends the ACK.
+ */
+int qemu_loadvm_approve_switchover(void)
+{
+    MigrationIncomingState *mis = migration_incoming_get_current();
+
+    if (!mis->switchover_ack_pending_num) {
+        return -EINVAL;
+    }
+
+    mis->switchover_ack_pending_num--;
+    trace_loadvm_approve_switchover(mis->switchover_ack_pending_num);
+
+    /* No return path when loading a snapshot, nobody is waiting */
+    if (mis->switchover_ack_pending_num || !mis->to_src_file) {
+        return 0;
+    }
+
+    return migrate_send_rp_switchover_ack(mis);
+}
+
 void qemu_loadvm_state_cleanup(void)
 {
     SaveStateEntry *se;
@@ -2693,6 +2979,10 @@ int qemu_loadvm_state(QEMUFile *f)
         return -EINVAL;
     }
 
+    if (migrate_switchover_ack()) {
+        qemu_loadvm_state_switchover_ack_needed(mis);
+    }
+
     cpu_synchronize_all_pre_loadvm();
 
     ret = qemu_loadvm_state_main(f, mis);
@@ -2766,6 +3056,34 @@ int qemu_load_device_state(QEMUFile *f)
     return 0;
 }
 
+/* Fill in everything but the VM state size for a snapshot taken now */
+static void snapshot_init_info(QEMUSnapshotInfo *sn, const char *name)
+{
+    qemu_timeval tv;
+    struct tm tm;
+
+    memset(sn, 0, sizeof(*sn));
+
+    /* fill auxiliary fields */
+    qemu_gettimeofday(&tv);
+    sn->date_sec = tv.tv_sec;
+    sn->date_nsec = tv.tv_usec * 1000;
+    sn->vm_clock_nsec = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
+    if (replay_mode != REPLAY_MODE_NONE) {
+        sn->icount = replay_get_current_icount();
+    } else {
+        sn->icount = -1ULL;
+    }
+
+    if (name) {
+        pstrcpy(sn->name, sizeof(sn->name), name);
+    } else {
+        /* cast below needed for OpenBSD where tv_sec is still 'long' */
+        localtime_r((const time_t *)&tv.tv_sec, &tm);
+        strftime(sn->name, sizeof(sn->name), "vm-%Y%m%d%H%M%S", &tm);
+    }
+}
+
 bool save_snapshot(const char *name, bool overwrite, const char *vmstate,
                   bool has_devices, strList *devices, Error **errp)
 {
@@ -2775,8 +3093,6 @@ bool save_snapshot(const char *name, bool overwrite, const char *vmstate,
     QEMUFile *f;
     int saved_vm_running;
     uint64_t vm_state_size;
-    qemu_timeval tv;
-    struct tm tm;
     AioContext *aio_context;
 
     if (migration_is_blocked(errp)) {
@@ -2833,26 +3149,7 @@ bool save_snapshot(const char *name, bool overwrite, const char *vmstate,
 
     aio_context_acquire(aio_context);
 
-    memset(sn, 0, sizeof(*sn));
-
-    /* fill auxiliary fields */
-    qemu_gettimeofday(&tv);
-    sn->date_sec = tv.tv_sec;
-    sn->date_nsec = tv.tv_usec * 1000;
-    sn->vm_clock_nsec = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
-    if (replay_mode != REPLAY_MODE_NONE) {
-        sn->icount = replay_get_current_icount();
-    } else {
-        sn->icount = -1ULL;
-    }
-
-    if (name) {
-        pstrcpy(sn->name, sizeof(sn->name), name);
-    } else {
-        /* cast below needed for OpenBSD where tv_sec is still 'long' */
-        localtime_r((const time_t *)&tv.tv_sec, &tm);
-        strftime(sn->name, sizeof(sn->name), "vm-%Y%m%d%H%M%S", &tm);
-    }
+    snapshot_init_info(sn, name);
 
     /* save the VM state */
     f = qemu_fopen_bdrv(bs, 1);
@@ -3118,6 +3415,7 @@ typedef struct SnapshotJob {
     char *tag;
     char *vmstate;
     strList *devices;
+    bool live;
     Coroutine *co;
     Error **errp;
     bool ret;
@@ -3130,6 +3428,165 @@ static void qmp_snapshot_job_free(SnapshotJob *s)
     qapi_free_strList(s->devices);
 }
 
+/*
+ * A live snapshot saves the VM state with a background snapshot migration
+ * into the VM state area of @bs while the guest keeps running.  The disk
+ * snapshots are taken when the migration has stopped the guest to save
+ * the device state, and the VM state is attached to the snapshot of @bs
+ * once the migration has completed.
+ */
+typedef struct LiveSnapshot {
+    SnapshotJob *job;
+    BlockDriverState *bs;
+    QEMUSnapshotInfo sn;
+    bool disks_taken;
+    int64_t vm_state_size;
+    Error *err;
+    Notifier migration_state;
+} LiveSnapshot;
+
+/* There is at most one, as it runs as a migration */
+static LiveSnapshot *live_snapshot;
+
+/* Called from the migration thread with the BQL held and the guest stopped */
+int qemu_savevm_live_snapshot_disks(void)
+{
+    LiveSnapshot *ls = live_snapshot;
+    int ret;
+
+    if (!ls) {
+        return 0;
+    }
+
+    snapshot_init_info(&ls->sn, ls->job->tag);
+
+    bdrv_drain_all_begin();
+    ret = bdrv_all_create_snapshot(&ls->sn, ls->bs, 0,
+                                   true, ls->job->devices, &ls->err);
+    if (ret < 0) {
+        bdrv_all_delete_snapshot(ls->sn.name, true, ls->job->devices, NULL);
+    } else {
+        ls->disks_taken = true;
+    }
+    bdrv_drain_all_end();
+
+    return ret;
+}
+
+static void live_snapshot_migration_state(Notifier *notifier, void *data)
+{
+    LiveSnapshot *ls = container_of(notifier, LiveSnapshot, migration_state);
+    SnapshotJob *job = ls->job;
+    MigrationState *s = data;
+    AioContext *ctx;
+
+    if (!migration_has_finished(s) && !migration_has_failed(s)) {
+        return;
+    }
+
+    if (!ls->err) {
+        if (migration_has_failed(s)) {
+            if (s->error) {
+                ls->err = error_copy(s->error);
+            } else {
+                error_setg(&ls->err, "Live snapshot %s",
+                           MigrationStatus_str(s->state));
+            }
+        } else if (ls->vm_state_size < 0) {
+            error_setg_errno(&ls->err, -ls->vm_state_size,
+                             "Failed to save VM state");
+        }
+    }
+
+    if (!ls->err) {
+        ctx = bdrv_get_aio_context(ls->bs);
+        aio_context_acquire(ctx);
+        bdrv_snapshot_attach_vmstate(ls->bs, ls->sn.name, ls->vm_state_size,
+                                     &ls->err);
+        aio_context_release(ctx);
+    }
+
+    if (ls->err) {
+        if (ls->disks_taken) {
+            bdrv_all_delete_snapshot(ls->sn.name, true, job->devices, NULL);
+        }
+        /* The migration may have failed before it resumed the guest */
+        if (s->vm_was_running && runstate_check(RUN_STATE_PAUSED)) {
+            vm_start();
+        }
+    }
+
+    remove_migration_state_change_notifier(&ls->migration_state);
+    live_snapshot = NULL;
+
+    job->ret = !ls->err;
+    if (ls->err) {
+        error_propagate(job->errp, ls->err);
+    }
+    g_free(ls);
+
+    job_progress_update(&job->common, 1);
+    qmp_snapshot_job_free(job);
+    aio_co_wake(job->co);
+}
+
+/* Returns true if the job is completed by live_snapshot_migration_state() */
+static bool live_snapshot_start(SnapshotJob *job, Error **errp)
+{
+    LiveSnapshot *ls;
+    BlockDriverState *bs;
+    QEMUFile *f;
+    int ret;
+
+    if (replay_mode != REPLAY_MODE_NONE) {
+        error_setg(errp, "Record/replay does not allow live snapshots");
+        return false;
+    }
+
+    if (!bdrv_all_can_snapshot(true, job->devices, errp)) {
+        return false;
+    }
+
+    ret = bdrv_all_has_snapshot(job->tag, true, job->devices, errp);
+    if (ret < 0) {
+        return false;
+    }
+    if (ret == 1) {
+        error_setg(errp, "Snapshot '%s' already exists in one or more devices",
+                   job->tag);
+        return false;
+    }
+
+    bs = bdrv_all_find_vmstate_bs(job->vmstate, true, job->devices, errp);
+    if (bs == NULL) {
+        return false;
+    }
+    if (!bdrv_can_attach_vmstate(bs)) {
+        error_setg(errp, "Device '%s' does not support live snapshots",
+                   bdrv_get_device_or_node_name(bs));
+        return false;
+    }
+
+    ls = g_new0(LiveSnapshot, 1);
+    ls->job = job;
+    ls->bs = bs;
+    ls->vm_state_size = -EINPROGRESS;
+    ls->migration_state.notify = live_snapshot_migration_state;
+
+    f = qemu_fopen_bdrv_writer(bs, true, &ls->vm_state_size);
+    live_snapshot = ls;
+    add_migration_state_change_notifier(&ls->migration_state);
+
+    if (!migrate_start_internal_snapshot(f, errp)) {
+        remove_migration_state_change_notifier(&ls->migration_state);
+        live_snapshot = NULL;
+        qemu_fclose(f);
+        g_free(ls);
+        return false;
+    }
+    return true;
+}
+
 
 static void snapshot_load_job_bh(void *opaque)
 {
@@ -3159,8 +3616,15 @@ static void snapshot_save_job_bh(void *opaque)
     SnapshotJob *s = container_of(job, SnapshotJob, common);
 
     job_progress_set_remaining(&s->common, 1);
-    s->ret = save_snapshot(s->tag, false, s->vmstate,
-                           true, s->devices, s->errp);
+    if (s->live) {
+        if (live_snapshot_start(s, s->errp)) {
+            return;
+        }
+        s->ret = false;
+    } else {
+        s->ret = save_snapshot(s->tag, false, s->vmstate,
+                               true, s->devices, s->errp);
+    }
     job_progress_update(&s->common, 1);
 
     qmp_snapshot_job_free(s);
@@ -3237,6 +3701,7 @@ void qmp_snapshot_save(const char *job_id,
                        const char *tag,
                        const char *vmstate,
                        strList *devices,
+                       bool has_live, bool live,
                        Error **errp)
 {
     SnapshotJob *s;
@@ -3251,6 +3716,7 @@ void qmp_snapshot_save(const char *job_id,
     s->tag = g_strdup(tag);
     s->vmstate = g_strdup(vmstate);
     s->devices = QAPI_CLONE(strList, devices);
+    s->live = has_live && live;
 
     job_start(&s->common);
 }
@@ -17,7 +17,9 @@
 #include "qapi/qmp/json-writer.h"
 #include "qemu-file.h"
 #include "qemu/bitops.h"
+#include "qemu/bswap.h"
 #include "qemu/error-report.h"
+#include "qemu/thread.h"
 #include "trace.h"
 
 static int vmstate_subsection_save(QEMUFile *f, const VMStateDescription *vmsd,
@@ -75,10 +77,372 @@ static void vmstate_handle_alloc(void *ptr, const VMStateField *field,
     }
 }
 
+/*
+ * Plans
+ *
+ * Most fields are fixed-size integers or byte arrays that sit next to
+ * each other in the device struct.  Interpreting them one element at a
+ * time costs an indirect call and a QEMUFile access per element, which
+ * adds up for devices with large tables.
+ *
+ * So the first time a description is saved or loaded at its current
+ * version, its fields are compiled into a plan: a list of steps that
+ * either interpret one field the generic way, or copy a run of plain
+ * fields.  In a run, fields of the same kind that are adjacent in memory
+ * are fused into a single item that is copied in bulk, converting the
+ * byte order on the way.  Plans are keyed by the field array, which
+ * outlives any copy of the description pointing to it.
+ */
+typedef enum VMStatePlanKind {
+    VMSTATE_PLAN_BYTES,
+    VMSTATE_PLAN_BOOL,
+    VMSTATE_PLAN_BE16,
+    VMSTATE_PLAN_BE32,
+    VMSTATE_PLAN_BE64,
+} VMStatePlanKind;
+
+static const unsigned int vmstate_plan_width[] = {
+    [VMSTATE_PLAN_BYTES] = 1,
+    [VMSTATE_PLAN_BOOL] = 1,
+    [VMSTATE_PLAN_BE16] = 2,
+    [VMSTATE_PLAN_BE32] = 4,
+    [VMSTATE_PLAN_BE64] = 8,
+};
+
+/* Staging buffer for byte swapping, on the stack */
+#define VMSTATE_PLAN_CHUNK 512
+
+typedef struct VMStatePlanItem {
+    size_t offset;
+    size_t count;               /* in elements of vmstate_plan_width[kind] */
+    VMStatePlanKind kind;
+} VMStatePlanItem;
+
+typedef struct VMStatePlanStep {
+    const VMStateField *field;  /* first field of the step */
+    int nr_fields;              /* 0: interpret @field the generic way */
+    int first_item;
+    int nr_items;
+} VMStatePlanStep;
+
+typedef struct VMStatePlan {
+    int version_id;
+    int nr_steps;
+    VMStatePlanStep *steps;
+    VMStatePlanItem *items;
+} VMStatePlan;
+
+static QemuMutex vmstate_plan_lock;
+static GHashTable *vmstate_plans;
+
+static void __attribute__((__constructor__)) vmstate_plan_init(void)
+{
+    qemu_mutex_init(&vmstate_plan_lock);
+    vmstate_plans = g_hash_table_new(NULL, NULL);
+}
+
+/* Returns the kind of a field a plan can copy directly, or -1 */
+static int vmstate_plan_kind(const VMStateField *field, int version_id)
+{
+    const VMStateInfo *info = field->info;
+    int kind;
+
+    if (field->field_exists || field->version_id > version_id ||
+        (field->flags & ~(VMS_SINGLE | VMS_ARRAY | VMS_BUFFER |
+                          VMS_MUST_EXIST))) {
+        return -1;
+    }
+
+    if (info == &vmstate_info_buffer) {
+        return VMSTATE_PLAN_BYTES;
+    } else if (info == &vmstate_info_uint8 || info == &vmstate_info_int8) {
+        kind = VMSTATE_PLAN_BYTES;
+    } else if (info == &vmstate_info_bool) {
+        kind = VMSTATE_PLAN_BOOL;
+    } else if (info == &vmstate_info_uint16 || info == &vmstate_info_int16) {
+        kind = VMSTATE_PLAN_BE16;
+    } else if (info == &vmstate_info_uint32 || info == &vmstate_info_int32) {
+        kind = VMSTATE_PLAN_BE32;
+    } else if (info == &vmstate_info_uint64 || info == &vmstate_info_int64) {
+        kind = VMSTATE_PLAN_BE64;
+    } else {
+        return -1;
+    }
+
+    return field->size == vmstate_plan_width[kind] ? kind : -1;
+}
+
+static VMStatePlan *vmstate_plan_compile(const VMStateDescription *vmsd)
+{
+    GArray *steps = g_array_new(false, false, sizeof(VMStatePlanStep));
+    GArray *items = g_array_new(false, false, sizeof(VMStatePlanItem));
+    VMStatePlan *plan = g_new0(VMStatePlan, 1);
+    const VMStateField *field;
+    int nr_plain = 0;
+
+    for (field = vmsd->fields; field->name; field++) {
+        int kind = vmstate_plan_kind(field, vmsd->version_id);
+        VMStatePlanStep *step = NULL;
+        VMStatePlanItem item, *last;
+        int n_elems = field->flags & VMS_ARRAY ? field->num : 1;
+
+        if (steps->len) {
+            step = &g_array_index(steps, VMStatePlanStep, steps->len - 1);
+        }
+        if (kind < 0 || !step || !step->nr_fields) {
+            VMStatePlanStep new_step = {
+                .field = field,
+                .first_item = items->len,
+            };
+
+            g_array_append_val(steps, new_step);
+            if (kind < 0) {
+                continue;
+            }
+            step = &g_array_index(steps, VMStatePlanStep, steps->len - 1);
+        }
+        step->nr_fields++;
+        nr_plain++;
+
+        item = (VMStatePlanItem) {
+            .offset = field->offset,
+            .count = (size_t)n_elems * field->size / vmstate_plan_width[kind],
+            .kind = kind,
+        };
+        if (step->nr_items) {
+            last = &g_array_index(items, VMStatePlanItem, items->len - 1);
+            if (last->kind == item.kind &&
+                last->offset + last->count * vmstate_plan_width[kind] ==
+                item.offset) {
+                last->count += item.count;
+                continue;
+            }
+        }
+        g_array_append_val(items, item);
+        step->nr_items++;
+    }
+
+    plan->version_id = vmsd->version_id;
+    plan->nr_steps = steps->len;
+    plan->steps = (VMStatePlanStep *)g_array_free(steps, false);
+    plan->items = (VMStatePlanItem *)g_array_free(items, false);
+    trace_vmstate_plan_compile(vmsd->name, nr_plain, plan->nr_steps);
+    if (!nr_plain) {
+        /* Nothing to gain, record that the generic path is as good */
+        plan->nr_steps = 0;
+    }
+    return plan;
+}
+
+static const VMStatePlan *vmstate_get_plan(const VMStateDescription *vmsd,
+                                           int version_id)
+{
+    VMStatePlan *plan;
+
+    if (version_id != vmsd->version_id) {
+        return NULL;
+    }
+
+    qemu_mutex_lock(&vmstate_plan_lock);
+    plan = g_hash_table_lookup(vmstate_plans, vmsd->fields);
+    if (!plan) {
+        plan = vmstate_plan_compile(vmsd);
+        g_hash_table_insert(vmstate_plans, (gpointer)vmsd->fields, plan);
+    }
+    qemu_mutex_unlock(&vmstate_plan_lock);
+
+    /* Two descriptions may share fields but not version */
+    if (!plan->nr_steps || plan->version_id != version_id) {
+        return NULL;
+    }
+    return plan;
+}
+
+static void vmstate_plan_get_item(QEMUFile *f, const VMStatePlanItem *item,
+                                  void *opaque)
+{
+    uint8_t buf[VMSTATE_PLAN_CHUNK];
+    uint8_t *p = opaque + item->offset;
+    unsigned int width = vmstate_plan_width[item->kind];
+    size_t i, j, n;
+
+    if (item->kind == VMSTATE_PLAN_BYTES || item->kind == VMSTATE_PLAN_BOOL) {
+        qemu_get_buffer(f, p, item->count);
+        if (item->kind == VMSTATE_PLAN_BOOL) {
+            for (i = 0; i < item->count; i++) {
+                p[i] = !!p[i];
+            }
+        }
+        return;
+    }
+
+    for (i = 0; i < item->count; i += n, p += n * width) {
+        n = MIN(item->count - i, sizeof(buf) / width);
+        qemu_get_buffer(f, buf, n * width);
+        switch (item->kind) {
+        case VMSTATE_PLAN_BE16:
+            for (j = 0; j < n; j++) {
+                stw_he_p(p + j * 2, lduw_be_p(buf + j * 2));
+            }
+            break;
+        case VMSTATE_PLAN_BE32:
+            for (j = 0; j < n; j++) {
+                stl_he_p(p + j * 4, ldl_be_p(buf + j * 4));
+            }
+            break;
+        case VMSTATE_PLAN_BE64:
+            for (j = 0; j < n; j++) {
+                stq_he_p(p + j * 8, ldq_be_p(buf + j * 8));
+            }
+            break;
+        default:
+            g_assert_not_reached();
+        }
+    }
+}
+
+static void vmstate_plan_put_item(QEMUFile *f, const VMStatePlanItem *item,
+                                  void *opaque)
+{
+    uint8_t buf[VMSTATE_PLAN_CHUNK];
+    uint8_t *p = opaque + item->offset;
+    unsigned int width = vmstate_plan_width[item->kind];
+    size_t i, j, n;
+
+    if (item->kind == VMSTATE_PLAN_BYTES || item->kind == VMSTATE_PLAN_BOOL) {
+        qemu_put_buffer(f, p, item->count);
+        return;
+    }
+
+    for (i = 0; i < item->count; i += n, p += n * width) {
+        n = MIN(item->count - i, sizeof(buf) / width);
+        switch (item->kind) {
+        case VMSTATE_PLAN_BE16:
+            for (j = 0; j < n; j++) {
+                stw_be_p(buf + j * 2, lduw_he_p(p + j * 2));
+            }
+            break;
+        case VMSTATE_PLAN_BE32:
+            for (j = 0; j < n; j++) {
+                stl_be_p(buf + j * 4, ldl_he_p(p + j * 4));
+            }
+            break;
+        case VMSTATE_PLAN_BE64:
+            for (j = 0; j < n; j++) {
+                stq_be_p(buf + j * 8, ldq_he_p(p + j * 8));
+            }
+            break;
+        default:
+            g_assert_not_reached();
+        }
+        qemu_put_buffer(f, buf, n * width);
+    }
+}
+
+static int vmstate_load_field(QEMUFile *f, const VMStateDescription *vmsd,
+                              const VMStateField *field, void *opaque,
+                              int version_id)
+{
+    int ret = 0;
+
+    trace_vmstate_load_state_field(vmsd->name, field->name);
+    if ((field->field_exists &&
+         field->field_exists(opaque, version_id)) ||
+        (!field->field_exists &&
+         field->version_id <= version_id)) {
+        void *first_elem = opaque + field->offset;
+        int i, n_elems = vmstate_n_elems(opaque, field);
+        int size = vmstate_size(opaque, field);
+
+        vmstate_handle_alloc(first_elem, field, opaque);
+        if (field->flags & VMS_POINTER) {
+            first_elem = *(void **)first_elem;
+            assert(first_elem || !n_elems || !size);
+        }
+        for (i = 0; i < n_elems; i++) {
+            void *curr_elem = first_elem + size * i;
+
+            if (field->flags & VMS_ARRAY_OF_POINTER) {
+                curr_elem = *(void **)curr_elem;
+            }
+            if (!curr_elem && size) {
+                /* if null pointer check placeholder and do not follow */
+                assert(field->flags & VMS_ARRAY_OF_POINTER);
+                ret = vmstate_info_nullptr.get(f, curr_elem, size, NULL);
+            } else if (field->flags & VMS_STRUCT) {
+                ret = vmstate_load_state(f, field->vmsd, curr_elem,
+                                         field->vmsd->version_id);
+            } else if (field->flags & VMS_VSTRUCT) {
+                ret = vmstate_load_state(f, field->vmsd, curr_elem,
+                                         field->struct_version_id);
+            } else {
+                ret = field->info->get(f, curr_elem, size, field);
+            }
+            if (ret >= 0) {
+                ret = qemu_file_get_error(f);
+            }
+            if (ret < 0) {
+                qemu_file_set_error(f, ret);
+                error_report("Failed to load %s:%s", vmsd->name,
+                             field->name);
+                trace_vmstate_load_field_error(field->name, ret);
+                return ret;
+            }
+        }
+    } else if (field->flags & VMS_MUST_EXIST) {
+        error_report("Input validation failed: %s/%s",
+                     vmsd->name, field->name);
+        return -1;
+    }
+    return 0;
+}
+
+static int vmstate_load_fields(QEMUFile *f, const VMStateDescription *vmsd,
+                               void *opaque, int version_id)
+{
+    const VMStatePlan *plan = vmstate_get_plan(vmsd, version_id);
+    const VMStateField *field;
+    int i, j, ret;
+
+    if (!plan) {
+        for (field = vmsd->fields; field->name; field++) {
+            ret = vmstate_load_field(f, vmsd, field, opaque, version_id);
+            if (ret < 0) {
+                return ret;
+            }
+        }
+        return 0;
+    }
+
+    for (i = 0; i < plan->nr_steps; i++) {
+        const VMStatePlanStep *step = &plan->steps[i];
+
+        if (!step->nr_fields) {
+            ret = vmstate_load_field(f, vmsd, step->field, opaque, version_id);
+            if (ret < 0) {
+                return ret;
+            }
+            continue;
+        }
+
+        for (j = 0; j < step->nr_items; j++) {
+            vmstate_plan_get_item(f, &plan->items[step->first_item + j],
+                                  opaque);
+        }
+        ret = qemu_file_get_error(f);
+        if (ret < 0) {
+            error_report("Failed to load %s:%s", vmsd->name,
+                         step->field->name);
+            trace_vmstate_load_field_error(step->field->name, ret);
+            return ret;
+        }
+    }
+    return 0;
+}
+
 int vmstate_load_state(QEMUFile *f, const VMStateDescription *vmsd,
                        void *opaque, int version_id)
 {
-    const VMStateField *field = vmsd->fields;
     int ret = 0;
 
     trace_vmstate_load_state(vmsd->name, version_id);
@@ -108,57 +472,9 @@ int vmstate_load_state(QEMUFile *f, const VMStateDescription *vmsd,
             return ret;
         }
     }
-    while (field->name) {
-        trace_vmstate_load_state_field(vmsd->name, field->name);
-        if ((field->field_exists &&
-             field->field_exists(opaque, version_id)) ||
-            (!field->field_exists &&
-             field->version_id <= version_id)) {
-            void *first_elem = opaque + field->offset;
-            int i, n_elems = vmstate_n_elems(opaque, field);
-            int size = vmstate_size(opaque, field);
-
-            vmstate_handle_alloc(first_elem, field, opaque);
-            if (field->flags & VMS_POINTER) {
-                first_elem = *(void **)first_elem;
-                assert(first_elem || !n_elems || !size);
-            }
-            for (i = 0; i < n_elems; i++) {
-                void *curr_elem = first_elem + size * i;
-
-                if (field->flags & VMS_ARRAY_OF_POINTER) {
-                    curr_elem = *(void **)curr_elem;
-                }
-                if (!curr_elem && size) {
-                    /* if null pointer check placeholder and do not follow */
-                    assert(field->flags & VMS_ARRAY_OF_POINTER);
-                    ret = vmstate_info_nullptr.get(f, curr_elem, size, NULL);
-                } else if (field->flags & VMS_STRUCT) {
-                    ret = vmstate_load_state(f, field->vmsd, curr_elem,
-                                             field->vmsd->version_id);
-                } else if (field->flags & VMS_VSTRUCT) {
-                    ret = vmstate_load_state(f, field->vmsd, curr_elem,
-                                             field->struct_version_id);
-                } else {
-                    ret = field->info->get(f, curr_elem, size, field);
-                }
-                if (ret >= 0) {
-                    ret = qemu_file_get_error(f);
-                }
-                if (ret < 0) {
-                    qemu_file_set_error(f, ret);
-                    error_report("Failed to load %s:%s", vmsd->name,
-                                 field->name);
-                    trace_vmstate_load_field_error(field->name, ret);
-                    return ret;
-                }
-            }
-        } else if (field->flags & VMS_MUST_EXIST) {
-            error_report("Input validation failed: %s/%s",
-                         vmsd->name, field->name);
-            return -1;
-        }
-        field++;
+    ret = vmstate_load_fields(f, vmsd, opaque, version_id);
+    if (ret < 0) {
+        return ret;
     }
     ret = vmstate_subsection_load(f, vmsd, opaque);
     if (ret != 0) {
@@ -323,11 +639,143 @@ int vmstate_save_state(QEMUFile *f, const VMStateDescription *vmsd,
     return vmstate_save_state_v(f, vmsd, opaque, vmdesc_id, vmsd->version_id);
 }
 
+static int vmstate_save_field(QEMUFile *f, const VMStateDescription *vmsd,
+                              const VMStateField *field, void *opaque,
+                              JSONWriter *vmdesc, int version_id)
+{
+    int ret = 0;
+
+    if ((field->field_exists &&
+         field->field_exists(opaque, version_id)) ||
+        (!field->field_exists &&
+         field->version_id <= version_id)) {
+        void *first_elem = opaque + field->offset;
+        int i, n_elems = vmstate_n_elems(opaque, field);
+        int size = vmstate_size(opaque, field);
+        int64_t old_offset, written_bytes;
+        JSONWriter *vmdesc_loop = vmdesc;
+
+        trace_vmstate_save_state_loop(vmsd->name, field->name, n_elems);
+        if (field->flags & VMS_POINTER) {
+            first_elem = *(void **)first_elem;
+            assert(first_elem || !n_elems || !size);
+        }
+        for (i = 0; i < n_elems; i++) {
+            void *curr_elem = first_elem + size * i;
+
+            vmsd_desc_field_start(vmsd, vmdesc_loop, field, i, n_elems);
+            old_offset = qemu_ftell_fast(f);
+            if (field->flags & VMS_ARRAY_OF_POINTER) {
+                assert(curr_elem);
+                curr_elem = *(void **)curr_elem;
+            }
+            if (!curr_elem && size) {
+                /* if null pointer write placeholder and do not follow */
+                assert(field->flags & VMS_ARRAY_OF_POINTER);
+                ret = vmstate_info_nullptr.put(f, curr_elem, size, NULL,
+                                               NULL);
+            } else if (field->flags & VMS_STRUCT) {
+                ret = vmstate_save_state(f, field->vmsd, curr_elem,
+                                         vmdesc_loop);
+            } else if (field->flags & VMS_VSTRUCT) {
+                ret = vmstate_save_state_v(f, field->vmsd, curr_elem,
+                                           vmdesc_loop,
+                                           field->struct_version_id);
+            } else {
+                ret = field->info->put(f, curr_elem, size, field,
+                                 vmdesc_loop);
+            }
+            if (ret) {
+                error_report("Save of field %s/%s failed",
+                             vmsd->name, field->name);
+                return ret;
+            }
+
+            written_bytes = qemu_ftell_fast(f) - old_offset;
+            vmsd_desc_field_end(vmsd, vmdesc_loop, field, written_bytes, i);
+
+            /* Compressed arrays only care about the first element */
+            if (vmdesc_loop && vmsd_can_compress(field)) {
+                vmdesc_loop = NULL;
+            }
+        }
+    } else {
+        if (field->flags & VMS_MUST_EXIST) {
+            error_report("Output state validation failed: %s/%s",
+                    vmsd->name, field->name);
+            assert(!(field->flags & VMS_MUST_EXIST));
+        }
+    }
+    return 0;
+}
+
+/*
+ * Describe a run of plain fields like vmstate_save_field() does: each
+ * one can be compressed, so only its first element is listed.
+ */
+static void vmstate_plan_desc_fields(const VMStateDescription *vmsd,
+                                     JSONWriter *vmdesc,
+                                     const VMStatePlanStep *step)
+{
+    const VMStateField *field;
+
+    for (field = step->field; field < step->field + step->nr_fields;
+         field++) {
+        int n_elems = field->flags & VMS_ARRAY ? field->num : 1;
+
+        if (n_elems) {
+            vmsd_desc_field_start(vmsd, vmdesc, field, 0, n_elems);
+            vmsd_desc_field_end(vmsd, vmdesc, field, field->size, 0);
+        }
+    }
+}
+
+static int vmstate_save_fields(QEMUFile *f, const VMStateDescription *vmsd,
+                               void *opaque, JSONWriter *vmdesc,
+                               int version_id)
+{
+    const VMStatePlan *plan = vmstate_get_plan(vmsd, version_id);
+    const VMStateField *field;
+    int i, j, ret;
+
+    if (!plan) {
+        for (field = vmsd->fields; field->name; field++) {
+            ret = vmstate_save_field(f, vmsd, field, opaque, vmdesc,
+                                     version_id);
+            if (ret) {
+                return ret;
+            }
+        }
+        return 0;
+    }
+
+    for (i = 0; i < plan->nr_steps; i++) {
+        const VMStatePlanStep *step = &plan->steps[i];
+
+        if (!step->nr_fields) {
+            ret = vmstate_save_field(f, vmsd, step->field, opaque, vmdesc,
+                                     version_id);
+            if (ret) {
+                return ret;
+            }
+            continue;
+        }
+
+        if (vmdesc) {
+            vmstate_plan_desc_fields(vmsd, vmdesc, step);
+        }
+        for (j = 0; j < step->nr_items; j++) {
+            vmstate_plan_put_item(f, &plan->items[step->first_item + j],
+                                  opaque);
+        }
+    }
+    return 0;
+}
+
 int vmstate_save_state_v(QEMUFile *f, const VMStateDescription *vmsd,
                          void *opaque, JSONWriter *vmdesc, int version_id)
 {
     int ret = 0;
-    const VMStateField *field = vmsd->fields;
 
     trace_vmstate_save_state_top(vmsd->name);
 
@@ -346,72 +794,12 @@ int vmstate_save_state_v(QEMUFile *f, const VMStateDescription *vmsd,
         json_writer_start_array(vmdesc, "fields");
     }
 
-    while (field->name) {
-        if ((field->field_exists &&
-             field->field_exists(opaque, version_id)) ||
-            (!field->field_exists &&
-             field->version_id <= version_id)) {
-            void *first_elem = opaque + field->offset;
-            int i, n_elems = vmstate_n_elems(opaque, field);
-            int size = vmstate_size(opaque, field);
-            int64_t old_offset, written_bytes;
-            JSONWriter *vmdesc_loop = vmdesc;
-
-            trace_vmstate_save_state_loop(vmsd->name, field->name, n_elems);
-            if (field->flags & VMS_POINTER) {
-                first_elem = *(void **)first_elem;
-                assert(first_elem || !n_elems || !size);
-            }
-            for (i = 0; i < n_elems; i++) {
-                void *curr_elem = first_elem + size * i;
-
-                vmsd_desc_field_start(vmsd, vmdesc_loop, field, i, n_elems);
-                old_offset = qemu_ftell_fast(f);
-                if (field->flags & VMS_ARRAY_OF_POINTER) {
-                    assert(curr_elem);
-                    curr_elem = *(void **)curr_elem;
-                }
-                if (!curr_elem && size) {
-                    /* if null pointer write placeholder and do not follow */
-                    assert(field->flags & VMS_ARRAY_OF_POINTER);
-                    ret = vmstate_info_nullptr.put(f, curr_elem, size, NULL,
-                                                   NULL);
-                } else if (field->flags & VMS_STRUCT) {
-                    ret = vmstate_save_state(f, field->vmsd, curr_elem,
-                                             vmdesc_loop);
-                } else if (field->flags & VMS_VSTRUCT) {
-                    ret = vmstate_save_state_v(f, field->vmsd, curr_elem,
-                                               vmdesc_loop,
-                                               field->struct_version_id);
-                } else {
-                    ret = field->info->put(f, curr_elem, size, field,
-                                     vmdesc_loop);
-                }
-                if (ret) {
-                    error_report("Save of field %s/%s failed",
-                                 vmsd->name, field->name);
-                    if (vmsd->post_save) {
-                        vmsd->post_save(opaque);
-                    }
-                    return ret;
-                }
-
-                written_bytes = qemu_ftell_fast(f) - old_offset;
-                vmsd_desc_field_end(vmsd, vmdesc_loop, field, written_bytes, i);
-
-                /* Compressed arrays only care about the first element */
-                if (vmdesc_loop && vmsd_can_compress(field)) {
-                    vmdesc_loop = NULL;
-                }
-            }
-        } else {
-            if (field->flags & VMS_MUST_EXIST) {
-                error_report("Output state validation failed: %s/%s",
-                        vmsd->name, field->name);
-                assert(!(field->flags & VMS_MUST_EXIST));
-            }
+    ret = vmstate_save_fields(f, vmsd, opaque, vmdesc, version_id);
+    if (ret) {
+        if (vmsd->post_save) {
+            vmsd->post_save(opaque);
         }
-        field++;
+        return ret;
     }
 
     if (vmdesc) {
@@ -293,6 +293,11 @@ void hmp_info_migrate(Monitor *mon, const QDict *qdict)
             monitor_printf(mon, "postcopy request count: %" PRIu64 "\n",
                            info->ram->postcopy_requests);
         }
+        if (info->ram->dirty_sync_missed_zero_copy) {
+            monitor_printf(mon,
+                           "Zero-copy-send fallbacks happened: %" PRIu64 " times\n",
+                           info->ram->dirty_sync_missed_zero_copy);
+        }
     }
 
     if (info->has_disk) {
@@ -339,6 +344,30 @@ void hmp_info_migrate(Monitor *mon, const QDict *qdict)
                        info->cpu_throttle_percentage);
     }
 
+    if (info->has_dirty_limit_throttle_time_per_full) {
+        monitor_printf(mon, "dirty-limit throttle time: %" PRIu64 " us\n",
+                       info->dirty_limit_throttle_time_per_full);
+    }
+
+    if (info->has_last_iteration) {
+        MigrationIterationStats *it = info->last_iteration;
+        MultiFDChannelStatsList *c;
+
+        monitor_printf(mon, "last iteration: pass %" PRIu64
+                       ", bitmap sync %" PRIu64 " us, dirty pages %" PRIu64
+                       ", transferred %" PRIu64 " kbytes"
+                       ", multifd wait %" PRIu64 " us\n",
+                       it->pass, it->bitmap_sync_time, it->dirty_pages,
+                       it->transferred >> 10, it->multifd_wait_time);
+        for (c = it->multifd_channels; c; c = c->next) {
+            monitor_printf(mon, "multifd channel %" PRId64 ": packets %" PRIu64
+                           ", pages %" PRIu64 ", %" PRIu64 " kbytes"
+                           ", cpu %" PRIu64 " us\n",
+                           c->value->id, c->value->packets, c->value->pages,
+                           c->value->bytes >> 10, c->value->cpu_time);
+        }
+    }
+
     if (info->has_postcopy_blocktime) {
         monitor_printf(mon, "postcopy blocktime: %u\n",
                        info->postcopy_blocktime);
@@ -487,6 +516,22 @@ void hmp_info_migrate_parameters(Monitor *mon, const QDict *qdict)
         monitor_printf(mon, "%s: '%s'\n",
             MigrationParameter_str(MIGRATION_PARAMETER_TLS_AUTHZ),
             params->tls_authz);
+        assert(params->has_vcpu_dirty_limit);
+        monitor_printf(mon, "%s: %" PRIu64 " MB/s\n",
+            MigrationParameter_str(MIGRATION_PARAMETER_VCPU_DIRTY_LIMIT),
+            params->vcpu_dirty_limit);
+        assert(params->has_direct_io);
+        monitor_printf(mon, "%s: %s\n",
+            MigrationParameter_str(MIGRATION_PARAMETER_DIRECT_IO),
+            params->direct_io ? "on" : "off");
+        assert(params->has_load_threads);
+        monitor_printf(mon, "%s: %u\n",
+            MigrationParameter_str(MIGRATION_PARAMETER_LOAD_THREADS),
+            params->load_threads);
+        assert(params->has_populate_threads);
+        monitor_printf(mon, "%s: %u\n",
+            MigrationParameter_str(MIGRATION_PARAMETER_POPULATE_THREADS),
+            params->populate_threads);
 
         if (params->has_block_bitmap_mapping) {
             const BitmapMigrationNodeAliasList *bmnal;
@@ -965,12 +1010,26 @@ void hmp_sync_profile(Monitor *mon, const QDict *qdict)
 
     if (op == NULL) {
         bool on = qsp_is_enabled();
+        unsigned int period = qsp_sampling_period();
 
-        monitor_printf(mon, "sync-profile is %s\n", on ? "on" : "off");
+        if (period) {
+            monitor_printf(mon, "sync-profile is sampling 1 in %u "
+                           "acquisitions\n", period);
+        } else {
+            monitor_printf(mon, "sync-profile is %s\n", on ? "on" : "off");
+        }
         return;
     }
     if (!strcmp(op, "on")) {
         qsp_enable();
+    } else if (!strcmp(op, "sample")) {
+        int64_t period = qdict_get_try_int(qdict, "period", 1000);
+
+        if (period < 1 || period > UINT32_MAX) {
+            monitor_printf(mon, "Invalid sampling period\n");
+            return;
+        }
+        qsp_enable_sampling(period);
     } else if (!strcmp(op, "off")) {
         qsp_disable();
     } else if (!strcmp(op, "reset")) {
@@ -1395,6 +1454,22 @@ void hmp_migrate_set_parameter(Monitor *mon, const QDict *qdict)
         error_setg(&err, "The block-bitmap-mapping parameter can only be set "
                    "through QMP");
         break;
+    case MIGRATION_PARAMETER_VCPU_DIRTY_LIMIT:
+        p->has_vcpu_dirty_limit = true;
+        visit_type_uint64(v, param, &p->vcpu_dirty_limit, &err);
+        break;
+    case MIGRATION_PARAMETER_DIRECT_IO:
+        p->has_direct_io = true;
+        visit_type_bool(v, param, &p->direct_io, &err);
+        break;
+    case MIGRATION_PARAMETER_LOAD_THREADS:
+        p->has_load_threads = true;
+        visit_type_uint8(v, param, &p->load_threads, &err);
+        break;
+    case MIGRATION_PARAMETER_POPULATE_THREADS:
+        p->has_populate_threads = true;
+        visit_type_uint8(v, param, &p->populate_threads, &err);
+        break;
     default:
         assert(0);
     }
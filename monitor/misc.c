@@ -64,10 +64,13 @@
 #include "exec/exec-all.h"
 #include "qemu/option.h"
 #include "qemu/thread.h"
+#include "qemu/coroutine.h"
+#include "qemu/rcu.h"
 #include "block/qapi.h"
 #include "block/block-hmp-cmds.h"
 #include "qapi/qapi-commands-char.h"
 #include "qapi/qapi-commands-control.h"
+#include "qapi/qapi-commands-machine.h"
 #include "qapi/qapi-commands-migration.h"
 #include "qapi/qapi-commands-misc.h"
 #include "qapi/qapi-commands-qom.h"
@@ -337,6 +340,62 @@ static void hmp_info_opcount(Monitor *mon, const QDict *qdict)
 {
     dump_opcount_info();
 }
+
+static void hmp_tb_stats(Monitor *mon, const QDict *qdict)
+{
+    const char *action = qdict_get_str(qdict, "action");
+    Error *err = NULL;
+    int val;
+
+    val = qapi_enum_parse(&TBStatsAction_lookup, action, -1, &err);
+    if (val >= 0) {
+        qmp_x_tb_stats(val, &err);
+    }
+    hmp_handle_error(mon, err);
+}
+
+static void hmp_info_tb_list(Monitor *mon, const QDict *qdict)
+{
+    bool has_count = qdict_haskey(qdict, "count");
+    int64_t count = qdict_get_try_int(qdict, "count", 10);
+    const char *sort = qdict_get_try_str(qdict, "sort");
+    TBStatsInfoList *list, *l;
+    Error *err = NULL;
+    int sort_by = 0;
+
+    if (sort) {
+        sort_by = qapi_enum_parse(&TBStatsSortKey_lookup, sort, -1, &err);
+        if (sort_by < 0) {
+            hmp_handle_error(mon, err);
+            return;
+        }
+    }
+
+    list = qmp_x_query_tb_stats(has_count, count, !!sort, sort_by, &err);
+    if (err) {
+        hmp_handle_error(mon, err);
+        return;
+    }
+
+    monitor_printf(mon, "%-18s %-18s %12s %8s %6s %6s %6s %5s %6s\n",
+                   "pc", "phys-pc", "executions", "exits", "trans",
+                   "inval", "insns", "ops", "spills");
+    for (l = list; l; l = l->next) {
+        TBStatsInfo *info = l->value;
+
+        monitor_printf(mon, "0x%016" PRIx64 " 0x%016" PRIx64 " %12" PRIu64
+                       " %8" PRIu64 " %6" PRIu64 " %6" PRIu64
+                       " %6u %5u %6u\n",
+                       info->pc, info->phys_pc, info->executions,
+                       info->exits, info->translations, info->invalidations,
+                       info->guest_insns, info->tcg_ops, info->spills);
+        monitor_printf(mon, "%38s host code %u bytes, %.1f per guest insn\n",
+                       "", info->host_bytes,
+                       info->guest_insns ?
+                       (double)info->host_bytes / info->guest_insns : 0);
+    }
+    qapi_free_TBStatsInfoList(list);
+}
 #endif
 
 static void hmp_info_sync_profile(Monitor *mon, const QDict *qdict)
@@ -350,6 +409,28 @@ static void hmp_info_sync_profile(Monitor *mon, const QDict *qdict)
     qsp_report(max, sort_by, coalesce);
 }
 
+static void hmp_info_coroutine_pool(Monitor *mon, const QDict *qdict)
+{
+    CoroutinePoolStats stats;
+
+    qemu_coroutine_get_pool_stats(&stats);
+    monitor_printf(mon, "pool size per thread: %u\n", stats.batch_size);
+    monitor_printf(mon, "hits: %" PRIu64 "\n", stats.hits);
+    monitor_printf(mon, "misses: %" PRIu64 "\n", stats.misses);
+    monitor_printf(mon, "frees: %" PRIu64 "\n", stats.frees);
+}
+
+static void hmp_info_rcu(Monitor *mon, const QDict *qdict)
+{
+    RCUStats stats;
+
+    rcu_get_stats(&stats);
+    monitor_printf(mon, "pending callbacks: %" PRIu64 "\n", stats.pending);
+    monitor_printf(mon, "largest batch: %" PRIu64 "\n", stats.pending_max);
+    monitor_printf(mon, "callbacks: %" PRIu64 "\n", stats.callbacks);
+    monitor_printf(mon, "grace periods: %" PRIu64 "\n", stats.grace_periods);
+}
+
 static void hmp_info_history(Monitor *mon, const QDict *qdict)
 {
     MonitorHMP *hmp_mon = container_of(mon, MonitorHMP, common);
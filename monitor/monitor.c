@@ -212,23 +212,24 @@ void monitor_flush(Monitor *mon)
 /* flush at every end of line */
 int monitor_puts(Monitor *mon, const char *str)
 {
-    int i;
-    char c;
+    const char *p = str;
+    size_t len;
 
     qemu_mutex_lock(&mon->mon_lock);
-    for (i = 0; str[i]; i++) {
-        c = str[i];
-        if (c == '\n') {
-            g_string_append_c(mon->outbuf, '\r');
-        }
-        g_string_append_c(mon->outbuf, c);
-        if (c == '\n') {
+    while (*p) {
+        /* copy up to the next newline in one go */
+        len = strcspn(p, "\n");
+        g_string_append_len(mon->outbuf, p, len);
+        p += len;
+        if (*p == '\n') {
+            g_string_append(mon->outbuf, "\r\n");
             monitor_flush_locked(mon);
+            p++;
         }
     }
     qemu_mutex_unlock(&mon->mon_lock);
 
-    return i;
+    return p - str;
 }
 
 int monitor_vprintf(Monitor *mon, const char *fmt, va_list ap)
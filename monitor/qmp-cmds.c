@@ -18,9 +18,11 @@
 #include "qemu/cutils.h"
 #include "qemu/option.h"
 #include "monitor/monitor.h"
+#include "monitor/stats.h"
 #include "sysemu/sysemu.h"
 #include "qemu/config-file.h"
 #include "qemu/uuid.h"
+#include "qemu/thread.h"
 #include "chardev/char.h"
 #include "ui/qemu-spice.h"
 #include "ui/console.h"
@@ -36,6 +38,7 @@
 #include "qapi/qapi-commands-control.h"
 #include "qapi/qapi-commands-machine.h"
 #include "qapi/qapi-commands-misc.h"
+#include "qapi/qapi-commands-stats.h"
 #include "qapi/qapi-commands-ui.h"
 #include "qapi/qmp/qerror.h"
 #include "hw/mem/memory-device.h"
@@ -351,3 +354,208 @@ void qmp_display_reload(DisplayReloadOptions *arg, Error **errp)
         abort();
     }
 }
+
+typedef struct StatsCallbacks {
+    StatsProvider provider;
+    StatsCb *stats_cb;
+    StatsSchemaCb *schemas_cb;
+    QTAILQ_ENTRY(StatsCallbacks) next;
+} StatsCallbacks;
+
+static QTAILQ_HEAD(, StatsCallbacks) stats_callbacks =
+    QTAILQ_HEAD_INITIALIZER(stats_callbacks);
+
+void add_stats_callbacks(StatsProvider provider, StatsCb *stats_cb,
+                         StatsSchemaCb *schemas_cb)
+{
+    StatsCallbacks *entry = g_new(StatsCallbacks, 1);
+
+    entry->provider = provider;
+    entry->stats_cb = stats_cb;
+    entry->schemas_cb = schemas_cb;
+    QTAILQ_INSERT_TAIL(&stats_callbacks, entry, next);
+}
+
+static bool stats_name_requested(const char *name, strList *names)
+{
+    for (; names; names = names->next) {
+        if (g_str_equal(names->value, name)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void stats_add(StatsList **stats, strList *names, const char *name,
+               uint64_t value)
+{
+    Stats *entry;
+
+    if (names && !stats_name_requested(name, names)) {
+        return;
+    }
+
+    entry = g_new(Stats, 1);
+    entry->name = g_strdup(name);
+    entry->value = value;
+    QAPI_LIST_PREPEND(*stats, entry);
+}
+
+void stats_result_add(StatsResultList **result, StatsProvider provider,
+                      const char *instance, StatsList *stats)
+{
+    StatsResult *entry;
+
+    if (!stats) {
+        return;
+    }
+
+    entry = g_new0(StatsResult, 1);
+    entry->provider = provider;
+    entry->has_instance = instance != NULL;
+    entry->instance = g_strdup(instance);
+    entry->stats = stats;
+    QAPI_LIST_PREPEND(*result, entry);
+}
+
+void stats_schema_add(StatsSchemaValueList **result, const char *name,
+                      StatsType type, StatsUnit unit)
+{
+    StatsSchemaValue *entry = g_new0(StatsSchemaValue, 1);
+
+    entry->name = g_strdup(name);
+    entry->type = type;
+    entry->has_unit = unit != STATS_UNIT__MAX;
+    entry->unit = entry->has_unit ? unit : 0;
+    QAPI_LIST_PREPEND(*result, entry);
+}
+
+static bool stats_provider_requested(StatsProvider provider,
+                                     StatsProviderList *providers)
+{
+    for (; providers; providers = providers->next) {
+        if (providers->value == provider) {
+            return true;
+        }
+    }
+    return false;
+}
+
+StatsResultList *qmp_query_stats(bool has_providers,
+                                 StatsProviderList *providers,
+                                 bool has_names, strList *names,
+                                 Error **errp)
+{
+    ERRP_GUARD();
+    StatsResultList *result = NULL;
+    StatsCallbacks *entry;
+
+    QTAILQ_FOREACH(entry, &stats_callbacks, next) {
+        if (has_providers &&
+            !stats_provider_requested(entry->provider, providers)) {
+            continue;
+        }
+        entry->stats_cb(&result, has_names ? names : NULL, errp);
+        if (*errp) {
+            qapi_free_StatsResultList(result);
+            return NULL;
+        }
+    }
+
+    return result;
+}
+
+StatsSchemaList *qmp_query_stats_schemas(bool has_provider,
+                                         StatsProvider provider,
+                                         Error **errp)
+{
+    StatsSchemaList *result = NULL;
+    StatsCallbacks *entry;
+
+    QTAILQ_FOREACH(entry, &stats_callbacks, next) {
+        StatsSchema *schema;
+
+        if (has_provider && entry->provider != provider) {
+            continue;
+        }
+        schema = g_new0(StatsSchema, 1);
+        schema->provider = entry->provider;
+        entry->schemas_cb(&schema->stats);
+        QAPI_LIST_PREPEND(result, schema);
+    }
+
+    return result;
+}
+
+void qmp_x_sync_profile(SyncProfileAction action, bool has_sample_period,
+                        uint32_t sample_period, Error **errp)
+{
+    if (has_sample_period && action != SYNC_PROFILE_ACTION_SAMPLE) {
+        error_setg(errp, "Parameter 'sample-period' is only valid with "
+                   "action 'sample'");
+        return;
+    }
+
+    switch (action) {
+    case SYNC_PROFILE_ACTION_ON:
+        qsp_enable();
+        break;
+    case SYNC_PROFILE_ACTION_SAMPLE:
+        if (!has_sample_period) {
+            sample_period = 1000;
+        } else if (!sample_period) {
+            error_setg(errp, "Parameter 'sample-period' must be positive");
+            return;
+        }
+        qsp_enable_sampling(sample_period);
+        break;
+    case SYNC_PROFILE_ACTION_OFF:
+        qsp_disable();
+        break;
+    case SYNC_PROFILE_ACTION_RESET:
+        qsp_reset();
+        break;
+    default:
+        g_assert_not_reached();
+    }
+}
+
+static void sync_profile_add_info(void *opaque, const char *type,
+                                  const void *obj, unsigned int n_objs,
+                                  const char *callsite, uint64_t wait_ns,
+                                  uint64_t count)
+{
+    SyncProfileInfoList ***tail = opaque;
+    SyncProfileInfo *info = g_new0(SyncProfileInfo, 1);
+
+    info->type = g_strdup(type);
+    info->has_object = obj != NULL;
+    info->object = (uintptr_t)obj;
+    info->objects = n_objs;
+    info->call_site = g_strdup(callsite);
+    info->wait_ns = wait_ns;
+    info->count = count;
+    QAPI_LIST_APPEND(*tail, info);
+}
+
+SyncProfileInfoList *qmp_x_query_sync_profile(bool has_count, int64_t count,
+                                              bool has_mean, bool mean,
+                                              bool has_coalesce, bool coalesce,
+                                              Error **errp)
+{
+    SyncProfileInfoList *head = NULL, **tail = &head;
+
+    if (!has_count) {
+        count = 10;
+    } else if (count < 1) {
+        error_setg(errp, "Parameter 'count' must be positive");
+        return NULL;
+    }
+
+    qsp_report_foreach(MIN(count, INT_MAX),
+                       mean ? QSP_SORT_BY_AVG_WAIT_TIME
+                            : QSP_SORT_BY_TOTAL_WAIT_TIME,
+                       !has_coalesce || coalesce,
+                       sync_profile_add_info, &tail);
+    return head;
+}
@@ -25,6 +25,7 @@
 #include "trace.h"
 #include "nbd-internal.h"
 #include "qemu/units.h"
+#include "qemu/host-utils.h"
 
 #define NBD_META_ID_BASE_ALLOCATION 0
 #define NBD_META_ID_ALLOCATION_DEPTH 1
@@ -39,6 +40,16 @@
  */
 #define NBD_MAX_BLOCK_STATUS_EXTENTS (1 * MiB / 8)
 
+/*
+ * Request buffers are kept per client for reuse, so that a stream of reads
+ * or writes does not allocate and free a buffer for every request.  Buffer
+ * sizes are rounded up to a power of two, at least NBD_BUF_POOL_MIN_SIZE.
+ * Free buffers larger than NBD_BUF_POOL_MAX_SIZE are not kept.
+ */
+#define NBD_BUF_POOL_LEN 8
+#define NBD_BUF_POOL_MIN_SIZE (64 * KiB)
+#define NBD_BUF_POOL_MAX_SIZE (4 * MiB)
+
 static int system_errno_to_nbd_errno(int err)
 {
     switch (err) {
@@ -80,6 +91,7 @@ struct NBDRequestData {
     QSIMPLEQ_ENTRY(NBDRequestData) entry;
     NBDClient *client;
     uint8_t *data;
+    size_t data_size;
     bool complete;
 };
 
@@ -144,6 +156,13 @@ struct NBDClient {
     bool structured_reply;
     NBDExportMetaContexts export_meta;
 
+    /* Free request buffers, see nbd_request_alloc_data() */
+    int nb_free_bufs;
+    struct {
+        void *data;
+        size_t size;
+    } free_bufs[NBD_BUF_POOL_LEN];
+
     uint32_t opt; /* Current option being negotiated */
     uint32_t optlen; /* remaining length of data in ioc for the option being
                         negotiated now */
@@ -1448,12 +1467,18 @@ void nbd_client_get(NBDClient *client)
 
 void nbd_client_put(NBDClient *client)
 {
+    int i;
+
     if (--client->refcount == 0) {
         /* The last reference should be dropped by client->close,
          * which is called by client_close.
          */
         assert(client->closing);
 
+        for (i = 0; i < client->nb_free_bufs; i++) {
+            qemu_vfree(client->free_bufs[i].data);
+        }
+
         qio_channel_detach_aio_context(client->ioc);
         object_unref(OBJECT(client->sioc));
         object_unref(OBJECT(client->ioc));
@@ -1503,12 +1528,63 @@ static NBDRequestData *nbd_request_get(NBDClient *client)
     return req;
 }
 
+/*
+ * Gives @req a buffer of at least @len bytes, preferably the smallest
+ * fitting one from the client's free buffers.
+ */
+static int nbd_request_alloc_data(NBDRequestData *req, size_t len)
+{
+    NBDClient *client = req->client;
+    size_t size = MAX(pow2ceil(len), NBD_BUF_POOL_MIN_SIZE);
+    int best = -1;
+    int i;
+
+    for (i = 0; i < client->nb_free_bufs; i++) {
+        if (client->free_bufs[i].size >= size &&
+            (best < 0 ||
+             client->free_bufs[i].size < client->free_bufs[best].size))
+        {
+            best = i;
+        }
+    }
+
+    if (best >= 0) {
+        req->data = client->free_bufs[best].data;
+        req->data_size = client->free_bufs[best].size;
+        client->free_bufs[best] = client->free_bufs[--client->nb_free_bufs];
+        return 0;
+    }
+
+    req->data = blk_try_blockalign(client->exp->common.blk, size);
+    if (req->data == NULL) {
+        return -ENOMEM;
+    }
+    req->data_size = size;
+    return 0;
+}
+
+static void nbd_request_free_data(NBDRequestData *req)
+{
+    NBDClient *client = req->client;
+
+    if (req->data_size <= NBD_BUF_POOL_MAX_SIZE &&
+        client->nb_free_bufs < NBD_BUF_POOL_LEN)
+    {
+        client->free_bufs[client->nb_free_bufs].data = req->data;
+        client->free_bufs[client->nb_free_bufs].size = req->data_size;
+        client->nb_free_bufs++;
+    } else {
+        qemu_vfree(req->data);
+    }
+    req->data = NULL;
+}
+
 static void nbd_request_put(NBDRequestData *req)
 {
     NBDClient *client = req->client;
 
     if (req->data) {
-        qemu_vfree(req->data);
+        nbd_request_free_data(req);
     }
     g_free(req);
 
@@ -1603,7 +1679,6 @@ static int nbd_export_create(BlockExport *blk_exp, BlockExportOptions *exp_args,
     int64_t size;
     uint64_t perm, shared_perm;
     bool readonly = !exp_args->writable;
-    bool shared = !exp_args->writable;
     strList *bitmaps;
     size_t i;
     int ret;
@@ -1654,11 +1729,16 @@ static int nbd_export_create(BlockExport *blk_exp, BlockExportOptions *exp_args,
     exp->description = g_strdup(arg->description);
     exp->nbdflags = (NBD_FLAG_HAS_FLAGS | NBD_FLAG_SEND_FLUSH |
                      NBD_FLAG_SEND_FUA | NBD_FLAG_SEND_CACHE);
+    /*
+     * All connections to the export go through the same BlockBackend, so a
+     * flush on one of them also covers writes completed on the others and
+     * multi-conn is safe for writable exports, too.
+     */
+    if (!arg->has_multi_conn || arg->multi_conn != ON_OFF_AUTO_OFF) {
+        exp->nbdflags |= NBD_FLAG_CAN_MULTI_CONN;
+    }
     if (readonly) {
         exp->nbdflags |= NBD_FLAG_READ_ONLY;
-        if (shared) {
-            exp->nbdflags |= NBD_FLAG_CAN_MULTI_CONN;
-        }
     } else {
         exp->nbdflags |= (NBD_FLAG_SEND_TRIM | NBD_FLAG_SEND_WRITE_ZEROES |
                           NBD_FLAG_SEND_FAST_ZERO);
@@ -2266,9 +2346,7 @@ static int nbd_co_receive_request(NBDRequestData *req, NBDRequest *request,
         }
 
         if (request->type != NBD_CMD_CACHE) {
-            req->data = blk_try_blockalign(client->exp->common.blk,
-                                           request->len);
-            if (req->data == NULL) {
+            if (nbd_request_alloc_data(req, request->len) < 0) {
                 error_setg(errp, "No memory");
                 return -ENOMEM;
             }
@@ -19,24 +19,262 @@
 #include "net/checksum.h"
 #include "net/eth.h"
 
-uint32_t net_checksum_add_cont(int len, uint8_t *buf, int seq)
+static inline uint32_t net_checksum_fold(uint64_t sum)
+{
+    while (sum >> 16) {
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+    return sum;
+}
+
+/*
+ * All of these return the ones' complement sum of @buf, read as big endian
+ * 16-bit words, folded to 16 bits.  The vectorized versions add host order
+ * words and swap the folded result: the ones' complement sum commutes with
+ * byte swapping.
+ */
+static uint32_t net_checksum_add_int(const uint8_t *buf, size_t len)
+{
+    uint64_t sum = 0;
+
+    for (; len >= 4; buf += 4, len -= 4) {
+        sum += ldl_be_p(buf);
+    }
+    if (len >= 2) {
+        sum += lduw_be_p(buf);
+        buf += 2;
+        len -= 2;
+    }
+    if (len) {
+        sum += (uint32_t)buf[0] << 8;
+    }
+
+    return net_checksum_fold(sum);
+}
+
+/*
+ * Each iteration adds two words to every 32-bit lane, so flush the lanes
+ * before they can overflow.
+ */
+#define NET_CHECKSUM_LANE_ITERS 16384
+
+#if defined(CONFIG_AVX2_OPT) || defined(__SSE2__)
+#ifdef CONFIG_AVX2_OPT
+#pragma GCC push_options
+#pragma GCC target("sse2")
+#endif
+#include <emmintrin.h>
+
+static uint32_t net_checksum_add_sse2(const uint8_t *buf, size_t len)
 {
-    uint32_t sum1 = 0, sum2 = 0;
-    int i;
+    __m128i zero = _mm_setzero_si128();
+    uint64_t sum = 0;
+
+    while (len >= 16) {
+        size_t n = MIN(len / 16, NET_CHECKSUM_LANE_ITERS);
+        __m128i acc = zero;
+        uint32_t lanes[4];
+
+        len -= n * 16;
+        for (; n; n--, buf += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i *)buf);
+
+            acc = _mm_add_epi32(acc, _mm_unpacklo_epi16(v, zero));
+            acc = _mm_add_epi32(acc, _mm_unpackhi_epi16(v, zero));
+        }
 
-    for (i = 0; i < len - 1; i += 2) {
-        sum1 += (uint32_t)buf[i];
-        sum2 += (uint32_t)buf[i + 1];
+        _mm_storeu_si128((__m128i *)lanes, acc);
+        sum += (uint64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
     }
-    if (i < len) {
-        sum1 += (uint32_t)buf[i];
+
+    return net_checksum_fold(bswap16(net_checksum_fold(sum)) +
+                             net_checksum_add_int(buf, len));
+}
+#ifdef CONFIG_AVX2_OPT
+#pragma GCC pop_options
+#endif
+
+#ifdef CONFIG_AVX2_OPT
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#include <immintrin.h>
+
+static uint32_t net_checksum_add_avx2(const uint8_t *buf, size_t len)
+{
+    __m256i zero = _mm256_setzero_si256();
+    uint64_t sum = 0;
+
+    while (len >= 32) {
+        size_t n = MIN(len / 32, NET_CHECKSUM_LANE_ITERS);
+        __m256i acc = zero;
+        uint32_t lanes[8];
+        int i;
+
+        len -= n * 32;
+        for (; n; n--, buf += 32) {
+            __m256i v = _mm256_loadu_si256((const __m256i *)buf);
+
+            acc = _mm256_add_epi32(acc, _mm256_unpacklo_epi16(v, zero));
+            acc = _mm256_add_epi32(acc, _mm256_unpackhi_epi16(v, zero));
+        }
+
+        _mm256_storeu_si256((__m256i *)lanes, acc);
+        for (i = 0; i < 8; i++) {
+            sum += lanes[i];
+        }
     }
 
-    if (seq & 1) {
-        return sum1 + (sum2 << 8);
+    return net_checksum_fold(bswap16(net_checksum_fold(sum)) +
+                             net_checksum_add_int(buf, len));
+}
+#pragma GCC pop_options
+#endif /* CONFIG_AVX2_OPT */
+
+/* Note that for test_net_checksum_next_accel, the most preferred
+ * ISA must have the least significant bit.
+ */
+#define CACHE_AVX2    1
+#define CACHE_SSE2    2
+
+#ifdef CONFIG_AVX2_OPT
+# define INIT_CACHE 0
+# define INIT_ACCEL net_checksum_add_int
+#else
+# define INIT_CACHE CACHE_SSE2
+# define INIT_ACCEL net_checksum_add_sse2
+#endif
+
+static unsigned cpuid_cache = INIT_CACHE;
+static uint32_t (*checksum_accel)(const uint8_t *, size_t) = INIT_ACCEL;
+
+static void init_accel(unsigned cache)
+{
+    uint32_t (*fn)(const uint8_t *, size_t) = net_checksum_add_int;
+
+    if (cache & CACHE_SSE2) {
+        fn = net_checksum_add_sse2;
+    }
+#ifdef CONFIG_AVX2_OPT
+    if (cache & CACHE_AVX2) {
+        fn = net_checksum_add_avx2;
+    }
+#endif
+    checksum_accel = fn;
+}
+
+#ifdef CONFIG_AVX2_OPT
+#include "qemu/cpuid.h"
+
+static void __attribute__((constructor)) init_cpuid_cache(void)
+{
+    int max = __get_cpuid_max(0, NULL);
+    int a, b, c, d;
+    unsigned cache = 0;
+
+    if (max >= 1) {
+        __cpuid(1, a, b, c, d);
+        if (d & bit_SSE2) {
+            cache |= CACHE_SSE2;
+        }
+
+        /* We must check that AVX is not just available, but usable.  */
+        if ((c & bit_OSXSAVE) && (c & bit_AVX) && max >= 7) {
+            int bv;
+            __asm("xgetbv" : "=a"(bv), "=d"(d) : "c"(0));
+            __cpuid_count(7, 0, a, b, c, d);
+            if ((bv & 0x6) == 0x6 && (b & bit_AVX2)) {
+                cache |= CACHE_AVX2;
+            }
+        }
+    }
+    cpuid_cache = cache;
+    init_accel(cache);
+}
+#endif /* CONFIG_AVX2_OPT */
+
+bool test_net_checksum_next_accel(void)
+{
+    /* If no bits set, we just tested net_checksum_add_int, and there
+       are no more acceleration options to test.  */
+    if (cpuid_cache == 0) {
+        return false;
+    }
+    /* Disable the accelerator we used before and select a new one.  */
+    cpuid_cache &= cpuid_cache - 1;
+    init_accel(cpuid_cache);
+    return true;
+}
+
+#define select_accel_fn checksum_accel
+
+#elif defined(__aarch64__) && !defined(HOST_WORDS_BIGENDIAN)
+/* Advanced SIMD is mandatory on AArch64, no runtime check needed.  */
+#include <arm_neon.h>
+
+static uint32_t net_checksum_add_neon(const uint8_t *buf, size_t len)
+{
+    uint64_t sum = 0;
+
+    while (len >= 16) {
+        size_t n = MIN(len / 16, NET_CHECKSUM_LANE_ITERS);
+        uint32x4_t acc = vdupq_n_u32(0);
+
+        len -= n * 16;
+        for (; n; n--, buf += 16) {
+            acc = vpadalq_u16(acc, vreinterpretq_u16_u8(vld1q_u8(buf)));
+        }
+
+        sum += vaddlvq_u32(acc);
+    }
+
+    return net_checksum_fold(bswap16(net_checksum_fold(sum)) +
+                             net_checksum_add_int(buf, len));
+}
+
+static bool neon_disabled;
+
+bool test_net_checksum_next_accel(void)
+{
+    if (neon_disabled) {
+        return false;
+    }
+    neon_disabled = true;
+    return true;
+}
+
+static uint32_t select_accel_fn(const uint8_t *buf, size_t len)
+{
+    if (neon_disabled) {
+        return net_checksum_add_int(buf, len);
+    }
+    return net_checksum_add_neon(buf, len);
+}
+
+#else
+#define select_accel_fn net_checksum_add_int
+bool test_net_checksum_next_accel(void)
+{
+    return false;
+}
+#endif
+
+uint32_t net_checksum_add_cont(int len, uint8_t *buf, int seq)
+{
+    uint32_t sum;
+
+    if (len <= 0) {
+        return 0;
+    }
+
+    /* Short buffers are not worth a vector setup.  */
+    if (len < 64) {
+        sum = net_checksum_add_int(buf, len);
     } else {
-        return sum2 + (sum1 << 8);
+        sum = select_accel_fn(buf, len);
     }
+
+    /* Data that starts at an odd offset is summed with swapped bytes.  */
+    return (seq & 1) ? bswap16(sum) : sum;
 }
 
 uint16_t net_checksum_finish(uint32_t sum)
@@ -54,6 +54,7 @@ static NotifierList colo_compare_notifiers =
 
 #define REGULAR_PACKET_CHECK_MS 1000
 #define DEFAULT_TIME_OUT_MS 3000
+#define MAX_COMPARE_THREADS 64
 
 /* #define DEBUG_COLO_PACKETS */
 
@@ -103,6 +104,39 @@ typedef struct SendEntry {
     uint8_t *buf;
 } SendEntry;
 
+/*
+ * Connections are spread over shards by the hash of their ConnectionKey,
+ * so the primary and secondary packets of a connection always meet in the
+ * same shard.  With compare_threads=N each shard has a worker thread that
+ * does the comparison; the compare thread (the iothread) only parses the
+ * incoming packets and writes the released ones to outdev.  Without
+ * worker threads there is a single shard, run by the compare thread.
+ */
+typedef struct CompareShard {
+    CompareState *s;
+    QemuThread thread;
+
+    /* Protects pri_input, sec_input and quit */
+    QemuMutex input_lock;
+    QemuCond input_cond;
+    GQueue pri_input;
+    GQueue sec_input;
+    bool quit;
+
+    /*
+     * Protects the connections, held by the worker while it compares and
+     * by the compare thread when it flushes or scans them.
+     */
+    QemuMutex conn_lock;
+    /*
+     * Record the connection that through the NIC
+     * Element type: Connection
+     */
+    GQueue conn_list;
+    /* Record the connection without repetition */
+    GHashTable *connection_track_table;
+} CompareShard;
+
 struct CompareState {
     Object parent;
 
@@ -122,14 +156,20 @@ struct CompareState {
     bool vnet_hdr;
     uint64_t compare_timeout;
     uint32_t expired_scan_cycle;
+    uint32_t compare_threads;
+
+    CompareShard *shards;
+    int nb_shards;
 
     /*
-     * Record the connection that through the NIC
-     * Element type: Connection
+     * Primary packets released by the shards, in release order; they are
+     * written to outdev by release_bh in the compare thread.
      */
-    GQueue conn_list;
-    /* Record the connection without repetition */
-    GHashTable *connection_track_table;
+    QemuMutex release_lock;
+    GQueue release_list;
+    /* A shard found a mismatch, release_bh asks for a checkpoint */
+    bool inconsistent;
+    QEMUBH *release_bh;
 
     IOThread *iothread;
     GMainContext *worker_context;
@@ -239,39 +279,23 @@ static int colo_insert_packet(GQueue *queue, Packet *pkt, uint32_t *max_ack)
 }
 
 /*
- * Return 0 on success, if return -1 means the pkt
- * is unsupported(arp and ipv6) and will be sent later
+ * Called with shard->conn_lock held.  Return the connection of the packet,
+ * after queuing it there.
  */
-static int packet_enqueue(CompareState *s, int mode, Connection **con)
+static Connection *packet_enqueue(CompareShard *shard, int mode, Packet *pkt)
 {
     ConnectionKey key;
-    Packet *pkt = NULL;
     Connection *conn;
     int ret;
 
-    if (mode == PRIMARY_IN) {
-        pkt = packet_new(s->pri_rs.buf,
-                         s->pri_rs.packet_len,
-                         s->pri_rs.vnet_hdr_len);
-    } else {
-        pkt = packet_new(s->sec_rs.buf,
-                         s->sec_rs.packet_len,
-                         s->sec_rs.vnet_hdr_len);
-    }
-
-    if (parse_packet_early(pkt)) {
-        packet_destroy(pkt, NULL);
-        pkt = NULL;
-        return -1;
-    }
     fill_connection_key(pkt, &key);
 
-    conn = connection_get(s->connection_track_table,
+    conn = connection_get(shard->connection_track_table,
                           &key,
-                          &s->conn_list);
+                          &shard->conn_list);
 
     if (!conn->processing) {
-        g_queue_push_tail(&s->conn_list, conn);
+        g_queue_push_tail(&shard->conn_list, conn);
         conn->processing = true;
     }
 
@@ -285,12 +309,9 @@ static int packet_enqueue(CompareState *s, int mode, Connection **con)
         trace_colo_compare_drop_packet(colo_mode[mode],
             "queue size too big, drop packet");
         packet_destroy(pkt, NULL);
-        pkt = NULL;
     }
 
-    *con = conn;
-
-    return 0;
+    return conn;
 }
 
 static inline bool after(uint32_t seq1, uint32_t seq2)
@@ -298,20 +319,57 @@ static inline bool after(uint32_t seq1, uint32_t seq2)
         return (int32_t)(seq1 - seq2) > 0;
 }
 
+/* Hand a compared primary packet over to release_bh */
 static void colo_release_primary_pkt(CompareState *s, Packet *pkt)
 {
+    qemu_mutex_lock(&s->release_lock);
+    g_queue_push_tail(&s->release_list, pkt);
+    qemu_mutex_unlock(&s->release_lock);
+}
+
+/* Called from a shard when the primary and secondary packets differ */
+static void colo_compare_request_checkpoint(CompareState *s)
+{
+    qatomic_set(&s->inconsistent, true);
+}
+
+/*
+ * Called from the compare thread on the primary to send the
+ * packets released by the shards.
+ */
+static void colo_compare_release(CompareState *s)
+{
+    GQueue release_list;
+    Packet *pkt;
     int ret;
-    ret = compare_chr_send(s,
-                           pkt->data,
-                           pkt->size,
-                           pkt->vnet_hdr_len,
-                           false,
-                           true);
-    if (ret < 0) {
-        error_report("colo send primary packet failed");
+
+    qemu_mutex_lock(&s->release_lock);
+    release_list = s->release_list;
+    g_queue_init(&s->release_list);
+    qemu_mutex_unlock(&s->release_lock);
+
+    while ((pkt = g_queue_pop_head(&release_list))) {
+        ret = compare_chr_send(s,
+                               pkt->data,
+                               pkt->size,
+                               pkt->vnet_hdr_len,
+                               false,
+                               true);
+        if (ret < 0) {
+            error_report("colo send primary packet failed");
+        }
+        trace_colo_compare_main("packet same and release packet");
+        packet_destroy_partial(pkt, NULL);
+    }
+
+    if (qatomic_xchg(&s->inconsistent, false)) {
+        colo_compare_inconsistency_notify(s);
     }
-    trace_colo_compare_main("packet same and release packet");
-    packet_destroy_partial(pkt, NULL);
+}
+
+static void colo_compare_release_bh(void *opaque)
+{
+    colo_compare_release(opaque);
 }
 
 /*
@@ -496,7 +554,7 @@ sec:
         qemu_hexdump(stderr, "colo-compare spkt", spkt->data, spkt->size);
 #endif
 
-        colo_compare_inconsistency_notify(s);
+        colo_compare_request_checkpoint(s);
     }
 }
 
@@ -666,13 +724,24 @@ out:
 static void colo_old_packet_check(void *opaque)
 {
     CompareState *s = opaque;
+    GList *found;
+    int i;
 
     /*
      * If we find one old packet, stop finding job and notify
      * COLO frame do checkpoint.
      */
-    g_queue_find_custom(&s->conn_list, s,
-                        (GCompareFunc)colo_old_packet_check_one_conn);
+    for (i = 0; i < s->nb_shards; i++) {
+        CompareShard *shard = &s->shards[i];
+
+        qemu_mutex_lock(&shard->conn_lock);
+        found = g_queue_find_custom(&shard->conn_list, s,
+                                (GCompareFunc)colo_old_packet_check_one_conn);
+        qemu_mutex_unlock(&shard->conn_lock);
+        if (found) {
+            break;
+        }
+    }
 }
 
 static void colo_compare_packet(CompareState *s, Connection *conn,
@@ -702,14 +771,14 @@ static void colo_compare_packet(CompareState *s, Connection *conn,
             trace_colo_compare_main("packet different");
             g_queue_push_head(&conn->primary_list, pkt);
 
-            colo_compare_inconsistency_notify(s);
+            colo_compare_request_checkpoint(s);
             break;
         }
     }
 }
 
 /*
- * Called from the compare thread on the primary
+ * Called from the shard owning the connection on the primary
  * for compare packet with secondary list of the
  * specified connection when a new packet was
  * queued to it.
@@ -735,6 +804,221 @@ static void colo_compare_connection(void *opaque, void *user_data)
     }
 }
 
+/*
+ * Queue the packets the compare thread handed over to the shard into their
+ * connections, in arrival order, and compare them.
+ */
+static void colo_compare_shard_run(CompareShard *shard)
+{
+    GQueue pri_input, sec_input;
+    Packet *ppkt, *spkt;
+    Connection *conn;
+
+    qemu_mutex_lock(&shard->input_lock);
+    pri_input = shard->pri_input;
+    sec_input = shard->sec_input;
+    g_queue_init(&shard->pri_input);
+    g_queue_init(&shard->sec_input);
+    qemu_mutex_unlock(&shard->input_lock);
+
+    qemu_mutex_lock(&shard->conn_lock);
+    for (;;) {
+        ppkt = g_queue_peek_head(&pri_input);
+        spkt = g_queue_peek_head(&sec_input);
+        if (ppkt && (!spkt || ppkt->creation_ms <= spkt->creation_ms)) {
+            conn = packet_enqueue(shard, PRIMARY_IN,
+                                  g_queue_pop_head(&pri_input));
+        } else if (spkt) {
+            conn = packet_enqueue(shard, SECONDARY_IN,
+                                  g_queue_pop_head(&sec_input));
+        } else {
+            break;
+        }
+        /* compare packet in the specified connection */
+        colo_compare_connection(conn, shard->s);
+    }
+    qemu_mutex_unlock(&shard->conn_lock);
+}
+
+static void *colo_compare_shard_thread(void *opaque)
+{
+    CompareShard *shard = opaque;
+
+    qemu_mutex_lock(&shard->input_lock);
+    while (!shard->quit) {
+        if (g_queue_is_empty(&shard->pri_input) &&
+            g_queue_is_empty(&shard->sec_input)) {
+            qemu_cond_wait(&shard->input_cond, &shard->input_lock);
+            continue;
+        }
+        qemu_mutex_unlock(&shard->input_lock);
+
+        colo_compare_shard_run(shard);
+        qemu_bh_schedule(shard->s->release_bh);
+
+        qemu_mutex_lock(&shard->input_lock);
+    }
+    qemu_mutex_unlock(&shard->input_lock);
+
+    return NULL;
+}
+
+/*
+ * Called from the compare thread on the primary.
+ * Return 0 on success, if return -1 means the pkt
+ * is unsupported(arp and ipv6) and will be sent later
+ */
+static int colo_compare_dispatch(CompareState *s, int mode,
+                                 SocketReadState *rs)
+{
+    CompareShard *shard;
+    ConnectionKey key;
+    Packet *pkt;
+
+    pkt = packet_new(rs->buf, rs->packet_len, rs->vnet_hdr_len);
+
+    if (parse_packet_early(pkt)) {
+        packet_destroy(pkt, NULL);
+        return -1;
+    }
+    fill_connection_key(pkt, &key);
+    shard = &s->shards[connection_key_hash(&key) % s->nb_shards];
+
+    qemu_mutex_lock(&shard->input_lock);
+    if (mode == PRIMARY_IN) {
+        g_queue_push_tail(&shard->pri_input, pkt);
+    } else {
+        g_queue_push_tail(&shard->sec_input, pkt);
+    }
+    qemu_cond_signal(&shard->input_cond);
+    qemu_mutex_unlock(&shard->input_lock);
+
+    if (!s->compare_threads) {
+        colo_compare_shard_run(shard);
+        colo_compare_release(s);
+    }
+
+    return 0;
+}
+
+static void colo_compare_shards_init(CompareState *s)
+{
+    int i;
+
+    s->nb_shards = MAX(s->compare_threads, 1);
+    s->shards = g_new0(CompareShard, s->nb_shards);
+
+    for (i = 0; i < s->nb_shards; i++) {
+        CompareShard *shard = &s->shards[i];
+
+        shard->s = s;
+        qemu_mutex_init(&shard->input_lock);
+        qemu_cond_init(&shard->input_cond);
+        g_queue_init(&shard->pri_input);
+        g_queue_init(&shard->sec_input);
+        qemu_mutex_init(&shard->conn_lock);
+        g_queue_init(&shard->conn_list);
+        shard->connection_track_table =
+            g_hash_table_new_full(connection_key_hash,
+                                  connection_key_equal,
+                                  g_free,
+                                  connection_destroy);
+    }
+}
+
+static void colo_compare_shards_start(CompareState *s)
+{
+    int i;
+
+    for (i = 0; i < s->compare_threads; i++) {
+        char *name = g_strdup_printf("colo-compare %d", i);
+
+        qemu_thread_create(&s->shards[i].thread, name,
+                           colo_compare_shard_thread, &s->shards[i],
+                           QEMU_THREAD_JOINABLE);
+        g_free(name);
+    }
+}
+
+static void colo_compare_shards_stop(CompareState *s)
+{
+    int i;
+
+    for (i = 0; i < s->compare_threads; i++) {
+        CompareShard *shard = &s->shards[i];
+
+        qemu_mutex_lock(&shard->input_lock);
+        shard->quit = true;
+        qemu_cond_signal(&shard->input_cond);
+        qemu_mutex_unlock(&shard->input_lock);
+        qemu_thread_join(&shard->thread);
+    }
+}
+
+static void colo_compare_shards_destroy(CompareState *s)
+{
+    int i;
+
+    for (i = 0; i < s->nb_shards; i++) {
+        CompareShard *shard = &s->shards[i];
+
+        g_queue_clear(&shard->conn_list);
+        g_hash_table_destroy(shard->connection_track_table);
+        qemu_mutex_destroy(&shard->conn_lock);
+        qemu_cond_destroy(&shard->input_cond);
+        qemu_mutex_destroy(&shard->input_lock);
+    }
+    g_free(s->shards);
+    s->shards = NULL;
+}
+
+static void colo_flush_packets(void *opaque, void *user_data);
+
+/*
+ * Called from the compare thread on the primary, or from the main
+ * thread once the compare thread is gone.  Send out every primary
+ * packet and drop every secondary packet, whether already compared,
+ * still waiting in a connection or not yet picked up by a shard.
+ */
+static void colo_compare_flush_all(CompareState *s)
+{
+    Packet *pkt;
+    int i;
+
+    /* Keep the shards out of their connections while flushing */
+    for (i = 0; i < s->nb_shards; i++) {
+        qemu_mutex_lock(&s->shards[i].conn_lock);
+    }
+
+    colo_compare_release(s);
+    /* The checkpoint resolves any pending mismatch */
+    qatomic_set(&s->inconsistent, false);
+
+    for (i = 0; i < s->nb_shards; i++) {
+        CompareShard *shard = &s->shards[i];
+
+        g_queue_foreach(&shard->conn_list, colo_flush_packets, s);
+
+        qemu_mutex_lock(&shard->input_lock);
+        while ((pkt = g_queue_pop_head(&shard->pri_input))) {
+            compare_chr_send(s,
+                             pkt->data,
+                             pkt->size,
+                             pkt->vnet_hdr_len,
+                             false,
+                             true);
+            packet_destroy_partial(pkt, NULL);
+        }
+        g_queue_foreach(&shard->sec_input, packet_destroy, NULL);
+        g_queue_clear(&shard->sec_input);
+        qemu_mutex_unlock(&shard->input_lock);
+    }
+
+    for (i = s->nb_shards - 1; i >= 0; i--) {
+        qemu_mutex_unlock(&s->shards[i].conn_lock);
+    }
+}
+
 static void coroutine_fn _compare_chr_send(void *opaque)
 {
     SendCo *sendco = opaque;
@@ -957,15 +1241,13 @@ static void colo_compare_timer_del(CompareState *s)
     }
  }
 
-static void colo_flush_packets(void *opaque, void *user_data);
-
 static void colo_compare_handle_event(void *opaque)
 {
     CompareState *s = opaque;
 
     switch (s->event) {
     case COLO_EVENT_CHECKPOINT:
-        g_queue_foreach(&s->conn_list, colo_flush_packets, s);
+        colo_compare_flush_all(s);
         break;
     case COLO_EVENT_FAILOVER:
         break;
@@ -1000,6 +1282,7 @@ static void colo_compare_iothread(CompareState *s)
 
     colo_compare_timer_init(s);
     s->event_bh = aio_bh_new(ctx, colo_compare_handle_event, s);
+    s->release_bh = aio_bh_new(ctx, colo_compare_release_bh, s);
 }
 
 static char *compare_get_pri_indev(Object *obj, Error **errp)
@@ -1134,6 +1417,39 @@ static void compare_set_expired_scan_cycle(Object *obj, Visitor *v,
     s->expired_scan_cycle = value;
 }
 
+static void compare_get_threads(Object *obj, Visitor *v,
+                                const char *name, void *opaque,
+                                Error **errp)
+{
+    CompareState *s = COLO_COMPARE(obj);
+    uint32_t value = s->compare_threads;
+
+    visit_type_uint32(v, name, &value, errp);
+}
+
+static void compare_set_threads(Object *obj, Visitor *v,
+                                const char *name, void *opaque,
+                                Error **errp)
+{
+    CompareState *s = COLO_COMPARE(obj);
+    uint32_t value;
+
+    if (s->shards) {
+        error_setg(errp, "Property '%s.%s' can't be changed once created",
+                   object_get_typename(obj), name);
+        return;
+    }
+    if (!visit_type_uint32(v, name, &value, errp)) {
+        return;
+    }
+    if (value > MAX_COMPARE_THREADS) {
+        error_setg(errp, "Property '%s.%s' must be at most %d",
+                   object_get_typename(obj), name, MAX_COMPARE_THREADS);
+        return;
+    }
+    s->compare_threads = value;
+}
+
 static void get_max_queue_size(Object *obj, Visitor *v,
                                const char *name, void *opaque,
                                Error **errp)
@@ -1168,9 +1484,8 @@ out:
 static void compare_pri_rs_finalize(SocketReadState *pri_rs)
 {
     CompareState *s = container_of(pri_rs, CompareState, pri_rs);
-    Connection *conn = NULL;
 
-    if (packet_enqueue(s, PRIMARY_IN, &conn)) {
+    if (colo_compare_dispatch(s, PRIMARY_IN, pri_rs)) {
         trace_colo_compare_main("primary: unsupported packet in");
         compare_chr_send(s,
                          pri_rs->buf,
@@ -1178,22 +1493,15 @@ static void compare_pri_rs_finalize(SocketReadState *pri_rs)
                          pri_rs->vnet_hdr_len,
                          false,
                          false);
-    } else {
-        /* compare packet in the specified connection */
-        colo_compare_connection(conn, s);
     }
 }
 
 static void compare_sec_rs_finalize(SocketReadState *sec_rs)
 {
     CompareState *s = container_of(sec_rs, CompareState, sec_rs);
-    Connection *conn = NULL;
 
-    if (packet_enqueue(s, SECONDARY_IN, &conn)) {
+    if (colo_compare_dispatch(s, SECONDARY_IN, sec_rs)) {
         trace_colo_compare_main("secondary: unsupported packet in");
-    } else {
-        /* compare packet in the specified connection */
-        colo_compare_connection(conn, s);
     }
 }
 
@@ -1215,7 +1523,7 @@ static void compare_notify_rs_finalize(SocketReadState *notify_rs)
                                   notify_rs->buf,
                                   notify_rs->packet_len)) {
         /* colo-compare do checkpoint, flush pri packet and remove sec packet */
-        g_queue_foreach(&s->conn_list, colo_flush_packets, s);
+        colo_compare_flush_all(s);
     } else {
         error_report("COLO compare got unsupported instruction");
     }
@@ -1330,14 +1638,12 @@ static void colo_compare_complete(UserCreatable *uc, Error **errp)
         g_queue_init(&s->notify_sendco.send_list);
     }
 
-    g_queue_init(&s->conn_list);
-
-    s->connection_track_table = g_hash_table_new_full(connection_key_hash,
-                                                      connection_key_equal,
-                                                      g_free,
-                                                      connection_destroy);
+    qemu_mutex_init(&s->release_lock);
+    g_queue_init(&s->release_list);
+    colo_compare_shards_init(s);
 
     colo_compare_iothread(s);
+    colo_compare_shards_start(s);
 
     qemu_mutex_lock(&colo_compare_mutex);
     if (!colo_compare_active) {
@@ -1410,6 +1716,10 @@ static void colo_compare_init(Object *obj)
                         get_max_queue_size,
                         set_max_queue_size, NULL, NULL);
 
+    object_property_add(obj, "compare_threads", "uint32",
+                        compare_get_threads,
+                        compare_set_threads, NULL, NULL);
+
     s->vnet_hdr = false;
     object_property_add_bool(obj, "vnet_hdr_support", compare_get_vnet_hdr,
                              compare_set_vnet_hdr);
@@ -1443,7 +1753,12 @@ static void colo_compare_finalize(Object *obj)
 
     colo_compare_timer_del(s);
 
+    if (s->shards) {
+        colo_compare_shards_stop(s);
+    }
+
     qemu_bh_delete(s->event_bh);
+    qemu_bh_delete(s->release_bh);
 
     AioContext *ctx = iothread_get_aio_context(s->iothread);
     aio_context_acquire(ctx);
@@ -1454,17 +1769,19 @@ static void colo_compare_finalize(Object *obj)
     aio_context_release(ctx);
 
     /* Release all unhandled packets after compare thead exited */
-    g_queue_foreach(&s->conn_list, colo_flush_packets, s);
+    if (s->shards) {
+        colo_compare_flush_all(s);
+    }
     AIO_WAIT_WHILE(NULL, !s->out_sendco.done);
 
-    g_queue_clear(&s->conn_list);
     g_queue_clear(&s->out_sendco.send_list);
     if (s->notify_dev) {
         g_queue_clear(&s->notify_sendco.send_list);
     }
 
-    if (s->connection_track_table) {
-        g_hash_table_destroy(s->connection_track_table);
+    if (s->shards) {
+        colo_compare_shards_destroy(s);
+        qemu_mutex_destroy(&s->release_lock);
     }
 
     object_unref(OBJECT(s->iothread));
@@ -159,6 +159,21 @@ static ssize_t filter_dump_receive_iov(NetFilterState *nf, NetClientState *sndr,
     return 0;
 }
 
+static void filter_dump_receive_iov_batch(NetFilterState *nf,
+                                          NetClientState *sndr,
+                                          unsigned flags,
+                                          const struct iovec *iov,
+                                          const int *iovcnt, int count)
+{
+    NetFilterDumpState *nfds = FILTER_DUMP(nf);
+    int i;
+
+    for (i = 0; i < count; i++) {
+        dump_receive_iov(&nfds->ds, iov, iovcnt[i]);
+        iov += iovcnt[i];
+    }
+}
+
 static void filter_dump_cleanup(NetFilterState *nf)
 {
     NetFilterDumpState *nfds = FILTER_DUMP(nf);
@@ -245,6 +260,7 @@ static void filter_dump_class_init(ObjectClass *oc, void *data)
     nfc->setup = filter_dump_setup;
     nfc->cleanup = filter_dump_cleanup;
     nfc->receive_iov = filter_dump_receive_iov;
+    nfc->receive_iov_batch = filter_dump_receive_iov_batch;
 }
 
 static const TypeInfo filter_dump_info = {
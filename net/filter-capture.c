@@ -0,0 +1,896 @@
+/*
+ * Asynchronous packet capture filter
+ *
+ * Packets are copied into a ring buffer on the networking path and
+ * written out as pcapng by a separate thread, so that capturing costs
+ * the datapath one memcpy per packet rather than a blocking write.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or
+ * later.  See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu-common.h"
+#include "qapi/error.h"
+#include "qapi/visitor.h"
+#include "qemu/cutils.h"
+#include "qemu/error-report.h"
+#include "qemu/iov.h"
+#include "qemu/module.h"
+#include "qemu/thread.h"
+#include "qemu/timer.h"
+#include "qemu/units.h"
+#include "net/filter.h"
+#include "qom/object.h"
+
+#define TYPE_FILTER_CAPTURE "filter-capture"
+
+OBJECT_DECLARE_SIMPLE_TYPE(FilterCaptureState, FILTER_CAPTURE)
+
+/* Classic BPF, as printed by "tcpdump -ddd" */
+#define CBPF_MAXINSNS   4096
+#define CBPF_MEMWORDS   16
+
+#define CBPF_CLASS(code) ((code) & 0x07)
+#define CBPF_LD         0x00
+#define CBPF_LDX        0x01
+#define CBPF_ST         0x02
+#define CBPF_STX        0x03
+#define CBPF_ALU        0x04
+#define CBPF_JMP        0x05
+#define CBPF_RET        0x06
+#define CBPF_MISC       0x07
+
+#define CBPF_SIZE(code) ((code) & 0x18)
+#define CBPF_W          0x00
+#define CBPF_H          0x08
+#define CBPF_B          0x10
+
+#define CBPF_MODE(code) ((code) & 0xe0)
+#define CBPF_IMM        0x00
+#define CBPF_ABS        0x20
+#define CBPF_IND        0x40
+#define CBPF_MEM        0x60
+#define CBPF_LEN        0x80
+#define CBPF_MSH        0xa0
+
+#define CBPF_OP(code)   ((code) & 0xf0)
+#define CBPF_ADD        0x00
+#define CBPF_SUB        0x10
+#define CBPF_MUL        0x20
+#define CBPF_DIV        0x30
+#define CBPF_OR         0x40
+#define CBPF_AND        0x50
+#define CBPF_LSH        0x60
+#define CBPF_RSH        0x70
+#define CBPF_NEG        0x80
+#define CBPF_MOD        0x90
+#define CBPF_XOR        0xa0
+
+#define CBPF_JA         0x00
+#define CBPF_JEQ        0x10
+#define CBPF_JGT        0x20
+#define CBPF_JGE        0x30
+#define CBPF_JSET       0x40
+
+#define CBPF_SRC(code)  ((code) & 0x08)
+#define CBPF_K          0x00
+#define CBPF_X          0x08
+
+#define CBPF_RVAL(code) ((code) & 0x18)
+#define CBPF_A          0x10
+
+#define CBPF_MISCOP(code) ((code) & 0xf8)
+#define CBPF_TAX        0x00
+#define CBPF_TXA        0x80
+
+typedef struct CaptureBPFInsn {
+    uint16_t code;
+    uint8_t jt;
+    uint8_t jf;
+    uint32_t k;
+} CaptureBPFInsn;
+
+/* pcapng blocks, written in host byte order */
+#define PCAPNG_SHB_TYPE         0x0a0d0d0a
+#define PCAPNG_IDB_TYPE         0x00000001
+#define PCAPNG_EPB_TYPE         0x00000006
+#define PCAPNG_BYTE_ORDER_MAGIC 0x1a2b3c4d
+#define PCAPNG_LINKTYPE_ETHERNET 1
+
+struct pcapng_shb {
+    uint32_t type;
+    uint32_t total_len;
+    uint32_t byte_order_magic;
+    uint16_t version_major;
+    uint16_t version_minor;
+    int64_t section_len;
+    uint32_t total_len2;
+} QEMU_PACKED;
+
+struct pcapng_idb {
+    uint32_t type;
+    uint32_t total_len;
+    uint16_t linktype;
+    uint16_t reserved;
+    uint32_t snaplen;
+    uint32_t total_len2;
+} QEMU_PACKED;
+
+struct pcapng_epb {
+    uint32_t type;
+    uint32_t total_len;
+    uint32_t interface_id;
+    uint32_t ts_high;
+    uint32_t ts_low;
+    uint32_t caplen;
+    uint32_t len;
+} QEMU_PACKED;
+
+/*
+ * Ring entry header.  Entries are padded to CAPTURE_ALIGN so that the
+ * space left before the end of the ring always fits a header; an entry
+ * with len == 0 marks that space as unused and the reader wraps.
+ */
+typedef struct CaptureRecord {
+    uint32_t caplen;
+    uint32_t len;
+    uint64_t ts;            /* microseconds since the epoch */
+} CaptureRecord;
+
+#define CAPTURE_ALIGN           sizeof(CaptureRecord)
+#define CAPTURE_BATCH           64
+
+struct FilterCaptureState {
+    NetFilterState parent_obj;
+
+    char *filename;
+    char *bpf;
+    uint32_t snaplen;
+    uint32_t ring_size;
+
+    CaptureBPFInsn *prog;
+    unsigned int prog_len;
+
+    int fd;
+    uint8_t *ring;
+    /*
+     * Free running byte counters.  @head is only written by the
+     * networking path and @tail only by the writer thread.
+     */
+    uint64_t head;
+    uint64_t tail;
+    uint64_t dropped;
+    bool failed;
+    bool quit;
+    QemuEvent wakeup;
+    QemuThread thread;
+    bool thread_running;
+};
+
+static bool capture_bpf_parse(FilterCaptureState *s, Error **errp)
+{
+    const char *p = s->bpf;
+    unsigned long count;
+    unsigned int i;
+
+    if (qemu_strtoul(p, &p, 10, &count) < 0 || *p != ',' ||
+        count == 0 || count > CBPF_MAXINSNS) {
+        error_setg(errp, "filter-capture: invalid BPF program length");
+        return false;
+    }
+
+    s->prog = g_new0(CaptureBPFInsn, count);
+    s->prog_len = count;
+
+    for (i = 0; i < count; i++) {
+        unsigned long code, jt, jf, k;
+
+        if (*p != ',' ||
+            qemu_strtoul(p + 1, &p, 10, &code) < 0 || *p != ' ' ||
+            qemu_strtoul(p + 1, &p, 10, &jt) < 0 || *p != ' ' ||
+            qemu_strtoul(p + 1, &p, 10, &jf) < 0 || *p != ' ' ||
+            qemu_strtoul(p + 1, &p, 10, &k) < 0 ||
+            code > UINT16_MAX || jt > UINT8_MAX || jf > UINT8_MAX ||
+            k > UINT32_MAX) {
+            error_setg(errp, "filter-capture: malformed BPF instruction %u",
+                       i);
+            return false;
+        }
+        s->prog[i].code = code;
+        s->prog[i].jt = jt;
+        s->prog[i].jf = jf;
+        s->prog[i].k = k;
+    }
+
+    if (*p) {
+        error_setg(errp, "filter-capture: trailing data after BPF program");
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Reject anything the interpreter would have to check at run time,
+ * apart from out of bounds packet loads and division by X.
+ */
+static bool capture_bpf_check(FilterCaptureState *s, Error **errp)
+{
+    unsigned int i;
+
+    for (i = 0; i < s->prog_len; i++) {
+        const CaptureBPFInsn *insn = &s->prog[i];
+        uint16_t code = insn->code;
+        bool ok;
+
+        switch (CBPF_CLASS(code)) {
+        case CBPF_LD:
+        case CBPF_LDX:
+            switch (CBPF_MODE(code)) {
+            case CBPF_IMM:
+            case CBPF_LEN:
+                ok = true;
+                break;
+            case CBPF_MEM:
+                ok = insn->k < CBPF_MEMWORDS;
+                break;
+            case CBPF_ABS:
+            case CBPF_IND:
+                ok = CBPF_CLASS(code) == CBPF_LD &&
+                     CBPF_SIZE(code) != 0x18;
+                break;
+            case CBPF_MSH:
+                ok = CBPF_CLASS(code) == CBPF_LDX &&
+                     CBPF_SIZE(code) == CBPF_B;
+                break;
+            default:
+                ok = false;
+                break;
+            }
+            break;
+        case CBPF_ST:
+        case CBPF_STX:
+            ok = insn->k < CBPF_MEMWORDS;
+            break;
+        case CBPF_ALU:
+            switch (CBPF_OP(code)) {
+            case CBPF_DIV:
+            case CBPF_MOD:
+                ok = CBPF_SRC(code) == CBPF_X || insn->k != 0;
+                break;
+            case CBPF_ADD: case CBPF_SUB: case CBPF_MUL: case CBPF_OR:
+            case CBPF_AND: case CBPF_LSH: case CBPF_RSH: case CBPF_NEG:
+            case CBPF_XOR:
+                ok = true;
+                break;
+            default:
+                ok = false;
+                break;
+            }
+            break;
+        case CBPF_JMP:
+            switch (CBPF_OP(code)) {
+            case CBPF_JA:
+                ok = insn->k < s->prog_len - i - 1;
+                break;
+            case CBPF_JEQ: case CBPF_JGT: case CBPF_JGE: case CBPF_JSET:
+                ok = i + 1 + insn->jt < s->prog_len &&
+                     i + 1 + insn->jf < s->prog_len;
+                break;
+            default:
+                ok = false;
+                break;
+            }
+            break;
+        case CBPF_RET:
+            ok = CBPF_RVAL(code) != 0x18;
+            break;
+        case CBPF_MISC:
+            ok = CBPF_MISCOP(code) == CBPF_TAX ||
+                 CBPF_MISCOP(code) == CBPF_TXA;
+            break;
+        default:
+            ok = false;
+            break;
+        }
+
+        if (!ok) {
+            error_setg(errp, "filter-capture: invalid BPF instruction %u "
+                       "(code 0x%x)", i, code);
+            return false;
+        }
+    }
+
+    if (CBPF_CLASS(s->prog[s->prog_len - 1].code) != CBPF_RET) {
+        error_setg(errp, "filter-capture: BPF program must end with ret");
+        return false;
+    }
+
+    return true;
+}
+
+static bool capture_bpf_load(const uint8_t *pkt, uint32_t caplen,
+                             uint32_t off, uint16_t size, uint32_t *val)
+{
+    uint32_t width = size == CBPF_W ? 4 : size == CBPF_H ? 2 : 1;
+
+    if (off > caplen || caplen - off < width) {
+        return false;
+    }
+    switch (width) {
+    case 4:
+        *val = ldl_be_p(pkt + off);
+        break;
+    case 2:
+        *val = lduw_be_p(pkt + off);
+        break;
+    default:
+        *val = pkt[off];
+        break;
+    }
+    return true;
+}
+
+/*
+ * Run the filter over the captured bytes of a packet.  Returns the
+ * number of bytes to keep; 0 drops the packet.  Loads beyond the
+ * captured bytes reject the packet, as in the kernel.
+ */
+static uint32_t capture_bpf_run(const CaptureBPFInsn *prog,
+                                const uint8_t *pkt, uint32_t caplen,
+                                uint32_t len)
+{
+    uint32_t mem[CBPF_MEMWORDS] = { 0 };
+    uint32_t a = 0, x = 0, val;
+    const CaptureBPFInsn *insn;
+
+    for (insn = prog; ; insn++) {
+        uint16_t code = insn->code;
+        uint32_t src = CBPF_SRC(code) == CBPF_X ? x : insn->k;
+
+        switch (CBPF_CLASS(code)) {
+        case CBPF_LD:
+            switch (CBPF_MODE(code)) {
+            case CBPF_IMM:
+                a = insn->k;
+                break;
+            case CBPF_LEN:
+                a = len;
+                break;
+            case CBPF_MEM:
+                a = mem[insn->k];
+                break;
+            case CBPF_ABS:
+                if (!capture_bpf_load(pkt, caplen, insn->k,
+                                      CBPF_SIZE(code), &a)) {
+                    return 0;
+                }
+                break;
+            case CBPF_IND:
+                if (!capture_bpf_load(pkt, caplen, x + insn->k,
+                                      CBPF_SIZE(code), &a)) {
+                    return 0;
+                }
+                break;
+            }
+            break;
+        case CBPF_LDX:
+            switch (CBPF_MODE(code)) {
+            case CBPF_IMM:
+                x = insn->k;
+                break;
+            case CBPF_LEN:
+                x = len;
+                break;
+            case CBPF_MEM:
+                x = mem[insn->k];
+                break;
+            case CBPF_MSH:
+                if (!capture_bpf_load(pkt, caplen, insn->k, CBPF_B, &val)) {
+                    return 0;
+                }
+                x = (val & 0xf) << 2;
+                break;
+            }
+            break;
+        case CBPF_ST:
+            mem[insn->k] = a;
+            break;
+        case CBPF_STX:
+            mem[insn->k] = x;
+            break;
+        case CBPF_ALU:
+            switch (CBPF_OP(code)) {
+            case CBPF_ADD:
+                a += src;
+                break;
+            case CBPF_SUB:
+                a -= src;
+                break;
+            case CBPF_MUL:
+                a *= src;
+                break;
+            case CBPF_DIV:
+                if (!src) {
+                    return 0;
+                }
+                a /= src;
+                break;
+            case CBPF_MOD:
+                if (!src) {
+                    return 0;
+                }
+                a %= src;
+                break;
+            case CBPF_OR:
+                a |= src;
+                break;
+            case CBPF_AND:
+                a &= src;
+                break;
+            case CBPF_XOR:
+                a ^= src;
+                break;
+            case CBPF_LSH:
+                a = src < 32 ? a << src : 0;
+                break;
+            case CBPF_RSH:
+                a = src < 32 ? a >> src : 0;
+                break;
+            case CBPF_NEG:
+                a = -a;
+                break;
+            }
+            break;
+        case CBPF_JMP:
+            switch (CBPF_OP(code)) {
+            case CBPF_JA:
+                insn += insn->k;
+                break;
+            case CBPF_JEQ:
+                insn += a == src ? insn->jt : insn->jf;
+                break;
+            case CBPF_JGT:
+                insn += a > src ? insn->jt : insn->jf;
+                break;
+            case CBPF_JGE:
+                insn += a >= src ? insn->jt : insn->jf;
+                break;
+            case CBPF_JSET:
+                insn += a & src ? insn->jt : insn->jf;
+                break;
+            }
+            break;
+        case CBPF_RET:
+            return CBPF_RVAL(code) == CBPF_A ? a :
+                   CBPF_RVAL(code) == CBPF_X ? x : insn->k;
+        case CBPF_MISC:
+            if (CBPF_MISCOP(code) == CBPF_TAX) {
+                x = a;
+            } else {
+                a = x;
+            }
+            break;
+        }
+    }
+}
+
+static inline uint32_t capture_record_size(uint32_t caplen)
+{
+    return ROUND_UP(sizeof(CaptureRecord) + caplen, CAPTURE_ALIGN);
+}
+
+/*
+ * Copy one packet into the ring.  Called from the networking path of
+ * the netdev only, which makes this the single producer.  Returns true
+ * if the writer thread has something new to do.
+ */
+static bool capture_enqueue(FilterCaptureState *s, const struct iovec *iov,
+                            int iovcnt)
+{
+    size_t len = iov_size(iov, iovcnt);
+    uint32_t caplen = MIN(len, s->snaplen);
+    uint32_t need = capture_record_size(caplen);
+    uint64_t head = s->head;
+    uint32_t pos = head & (s->ring_size - 1);
+    uint32_t room = s->ring_size - pos;
+    uint32_t skip = room < need ? room : 0;
+    CaptureRecord *rec;
+
+    if (!len) {
+        return false;
+    }
+    if (s->ring_size - (head - qatomic_load_acquire(&s->tail)) <
+        skip + need) {
+        qatomic_set(&s->dropped, s->dropped + 1);
+        return false;
+    }
+
+    if (skip) {
+        rec = (CaptureRecord *)(s->ring + pos);
+        rec->caplen = 0;
+        rec->len = 0;
+        pos = 0;
+    }
+
+    rec = (CaptureRecord *)(s->ring + pos);
+    iov_to_buf(iov, iovcnt, 0, rec + 1, caplen);
+
+    if (s->prog) {
+        uint32_t keep = capture_bpf_run(s->prog, (uint8_t *)(rec + 1),
+                                        caplen, len);
+
+        if (!keep) {
+            return false;
+        }
+        caplen = MIN(caplen, keep);
+    }
+
+    rec->caplen = caplen;
+    rec->len = len;
+    rec->ts = qemu_clock_get_us(QEMU_CLOCK_HOST);
+
+    qatomic_store_release(&s->head, head + skip + capture_record_size(caplen));
+    return true;
+}
+
+static bool capture_writev(int fd, struct iovec *iov, unsigned int iovcnt)
+{
+    while (iovcnt) {
+        ssize_t ret = writev(fd, iov, MIN(iovcnt, IOV_MAX));
+
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        iov_discard_front(&iov, &iovcnt, ret);
+    }
+    return true;
+}
+
+/*
+ * Write out everything between @tail and @head.  Packet data is handed
+ * to writev() straight from the ring; the space is only given back to
+ * the producer once the write has completed.
+ */
+static bool capture_flush(FilterCaptureState *s, uint64_t head)
+{
+    static const uint8_t zero[4];
+    struct pcapng_epb epb[CAPTURE_BATCH];
+    uint32_t trailer[CAPTURE_BATCH];
+    struct iovec iov[CAPTURE_BATCH * 4];
+    uint64_t tail = s->tail;
+
+    while (tail != head) {
+        unsigned int n = 0, iovcnt = 0;
+        uint64_t end = tail;
+
+        while (end != head && n < CAPTURE_BATCH) {
+            uint32_t pos = end & (s->ring_size - 1);
+            CaptureRecord *rec = (CaptureRecord *)(s->ring + pos);
+            uint32_t pad;
+
+            if (!rec->len) {
+                end += s->ring_size - pos;
+                continue;
+            }
+
+            pad = ROUND_UP(rec->caplen, 4) - rec->caplen;
+            trailer[n] = sizeof(epb[n]) + rec->caplen + pad + 4;
+            epb[n] = (struct pcapng_epb) {
+                .type = PCAPNG_EPB_TYPE,
+                .total_len = trailer[n],
+                .interface_id = 0,
+                .ts_high = rec->ts >> 32,
+                .ts_low = rec->ts,
+                .caplen = rec->caplen,
+                .len = rec->len,
+            };
+            iov[iovcnt++] = (struct iovec) { &epb[n], sizeof(epb[n]) };
+            iov[iovcnt++] = (struct iovec) { rec + 1, rec->caplen };
+            if (pad) {
+                iov[iovcnt++] = (struct iovec) { (void *)zero, pad };
+            }
+            iov[iovcnt++] = (struct iovec) { &trailer[n], 4 };
+
+            end += capture_record_size(rec->caplen);
+            n++;
+        }
+
+        if (iovcnt && !capture_writev(s->fd, iov, iovcnt)) {
+            return false;
+        }
+        tail = end;
+        qatomic_store_release(&s->tail, tail);
+    }
+
+    return true;
+}
+
+static void *capture_writer_thread(void *opaque)
+{
+    FilterCaptureState *s = opaque;
+
+    for (;;) {
+        uint64_t head;
+
+        qemu_event_reset(&s->wakeup);
+        head = qatomic_load_acquire(&s->head);
+        if (head != s->tail) {
+            if (!capture_flush(s, head)) {
+                error_report("filter-capture: write error - stopping capture");
+                qatomic_set(&s->failed, true);
+                break;
+            }
+            continue;
+        }
+        if (qatomic_read(&s->quit)) {
+            break;
+        }
+        qemu_event_wait(&s->wakeup);
+    }
+
+    return NULL;
+}
+
+static ssize_t filter_capture_receive_iov(NetFilterState *nf,
+                                          NetClientState *sender,
+                                          unsigned flags,
+                                          const struct iovec *iov,
+                                          int iovcnt,
+                                          NetPacketSent *sent_cb)
+{
+    FilterCaptureState *s = FILTER_CAPTURE(nf);
+
+    if (!qatomic_read(&s->failed) && capture_enqueue(s, iov, iovcnt)) {
+        qemu_event_set(&s->wakeup);
+    }
+    return 0;
+}
+
+static void filter_capture_receive_iov_batch(NetFilterState *nf,
+                                             NetClientState *sender,
+                                             unsigned flags,
+                                             const struct iovec *iov,
+                                             const int *iovcnt,
+                                             int count)
+{
+    FilterCaptureState *s = FILTER_CAPTURE(nf);
+    bool kick = false;
+    int i;
+
+    if (qatomic_read(&s->failed)) {
+        return;
+    }
+    for (i = 0; i < count; i++) {
+        kick |= capture_enqueue(s, iov, iovcnt[i]);
+        iov += iovcnt[i];
+    }
+    if (kick) {
+        qemu_event_set(&s->wakeup);
+    }
+}
+
+static bool capture_write_header(FilterCaptureState *s, Error **errp)
+{
+    struct pcapng_shb shb = {
+        .type = PCAPNG_SHB_TYPE,
+        .total_len = sizeof(shb),
+        .byte_order_magic = PCAPNG_BYTE_ORDER_MAGIC,
+        .version_major = 1,
+        .version_minor = 0,
+        .section_len = -1,
+        .total_len2 = sizeof(shb),
+    };
+    struct pcapng_idb idb = {
+        .type = PCAPNG_IDB_TYPE,
+        .total_len = sizeof(idb),
+        .linktype = PCAPNG_LINKTYPE_ETHERNET,
+        .snaplen = s->snaplen,
+        .total_len2 = sizeof(idb),
+    };
+
+    if (qemu_write_full(s->fd, &shb, sizeof(shb)) != sizeof(shb) ||
+        qemu_write_full(s->fd, &idb, sizeof(idb)) != sizeof(idb)) {
+        error_setg_errno(errp, errno, "filter-capture: write error");
+        return false;
+    }
+    return true;
+}
+
+static void filter_capture_cleanup(NetFilterState *nf)
+{
+    FilterCaptureState *s = FILTER_CAPTURE(nf);
+
+    if (s->thread_running) {
+        qatomic_set(&s->quit, true);
+        qemu_event_set(&s->wakeup);
+        qemu_thread_join(&s->thread);
+        qemu_event_destroy(&s->wakeup);
+        s->thread_running = false;
+    }
+    if (s->fd >= 0) {
+        close(s->fd);
+        s->fd = -1;
+    }
+    qemu_vfree(s->ring);
+    s->ring = NULL;
+    g_free(s->prog);
+    s->prog = NULL;
+}
+
+static void filter_capture_setup(NetFilterState *nf, Error **errp)
+{
+    FilterCaptureState *s = FILTER_CAPTURE(nf);
+
+    if (!s->filename) {
+        error_setg(errp, "filter-capture needs 'file' property set!");
+        return;
+    }
+    if (!is_power_of_2(s->ring_size) ||
+        s->ring_size < 2 * capture_record_size(s->snaplen)) {
+        error_setg(errp, "filter-capture: ring-size must be a power of 2 "
+                   "and hold at least two packets of snaplen bytes");
+        return;
+    }
+    if (s->bpf &&
+        (!capture_bpf_parse(s, errp) || !capture_bpf_check(s, errp))) {
+        return;
+    }
+
+    s->fd = qemu_open_old(s->filename, O_CREAT | O_TRUNC | O_WRONLY | O_BINARY,
+                          0644);
+    if (s->fd < 0) {
+        error_setg_errno(errp, errno, "filter-capture: can't open %s",
+                         s->filename);
+        return;
+    }
+    if (!capture_write_header(s, errp)) {
+        return;
+    }
+
+    s->ring = qemu_memalign(CAPTURE_ALIGN, s->ring_size);
+    qemu_event_init(&s->wakeup, false);
+    qemu_thread_create(&s->thread, "filter-capture", capture_writer_thread,
+                       s, QEMU_THREAD_JOINABLE);
+    s->thread_running = true;
+}
+
+static char *filter_capture_get_file(Object *obj, Error **errp)
+{
+    FilterCaptureState *s = FILTER_CAPTURE(obj);
+
+    return g_strdup(s->filename);
+}
+
+static void filter_capture_set_file(Object *obj, const char *value,
+                                    Error **errp)
+{
+    FilterCaptureState *s = FILTER_CAPTURE(obj);
+
+    g_free(s->filename);
+    s->filename = g_strdup(value);
+}
+
+static char *filter_capture_get_bpf(Object *obj, Error **errp)
+{
+    FilterCaptureState *s = FILTER_CAPTURE(obj);
+
+    return g_strdup(s->bpf);
+}
+
+static void filter_capture_set_bpf(Object *obj, const char *value,
+                                   Error **errp)
+{
+    FilterCaptureState *s = FILTER_CAPTURE(obj);
+
+    if (s->ring) {
+        error_setg(errp, "filter-capture: can't change the BPF program "
+                   "of a running capture");
+        return;
+    }
+    g_free(s->bpf);
+    s->bpf = g_strdup(value);
+}
+
+static void filter_capture_get_uint32(Object *obj, Visitor *v,
+                                      const char *name, void *opaque,
+                                      Error **errp)
+{
+    uint32_t value = *(uint32_t *)opaque;
+
+    visit_type_uint32(v, name, &value, errp);
+}
+
+static void filter_capture_set_uint32(Object *obj, Visitor *v,
+                                      const char *name, void *opaque,
+                                      Error **errp)
+{
+    FilterCaptureState *s = FILTER_CAPTURE(obj);
+    uint32_t value;
+
+    if (s->ring) {
+        error_setg(errp, "Property '%s.%s' can't be changed while capturing",
+                   object_get_typename(obj), name);
+        return;
+    }
+    if (!visit_type_uint32(v, name, &value, errp)) {
+        return;
+    }
+    if (value == 0) {
+        error_setg(errp, "Property '%s.%s' doesn't take value '%u'",
+                   object_get_typename(obj), name, value);
+        return;
+    }
+    *(uint32_t *)opaque = value;
+}
+
+static void filter_capture_get_dropped(Object *obj, Visitor *v,
+                                       const char *name, void *opaque,
+                                       Error **errp)
+{
+    FilterCaptureState *s = FILTER_CAPTURE(obj);
+    uint64_t value = qatomic_read(&s->dropped);
+
+    visit_type_uint64(v, name, &value, errp);
+}
+
+static void filter_capture_instance_init(Object *obj)
+{
+    FilterCaptureState *s = FILTER_CAPTURE(obj);
+
+    s->fd = -1;
+    s->snaplen = 65536;
+    s->ring_size = 4 * MiB;
+
+    object_property_add(obj, "snaplen", "uint32",
+                        filter_capture_get_uint32, filter_capture_set_uint32,
+                        NULL, &s->snaplen);
+    object_property_add(obj, "ring-size", "uint32",
+                        filter_capture_get_uint32, filter_capture_set_uint32,
+                        NULL, &s->ring_size);
+}
+
+static void filter_capture_instance_finalize(Object *obj)
+{
+    FilterCaptureState *s = FILTER_CAPTURE(obj);
+
+    g_free(s->filename);
+    g_free(s->bpf);
+}
+
+static void filter_capture_class_init(ObjectClass *oc, void *data)
+{
+    NetFilterClass *nfc = NETFILTER_CLASS(oc);
+
+    object_class_property_add_str(oc, "file", filter_capture_get_file,
+                                  filter_capture_set_file);
+    object_class_property_add_str(oc, "bpf", filter_capture_get_bpf,
+                                  filter_capture_set_bpf);
+    object_class_property_add(oc, "dropped", "uint64",
+                              filter_capture_get_dropped, NULL, NULL, NULL);
+
+    nfc->setup = filter_capture_setup;
+    nfc->cleanup = filter_capture_cleanup;
+    nfc->receive_iov = filter_capture_receive_iov;
+    nfc->receive_iov_batch = filter_capture_receive_iov_batch;
+}
+
+static const TypeInfo filter_capture_info = {
+    .name = TYPE_FILTER_CAPTURE,
+    .parent = TYPE_NETFILTER,
+    .class_init = filter_capture_class_init,
+    .instance_init = filter_capture_instance_init,
+    .instance_finalize = filter_capture_instance_finalize,
+    .instance_size = sizeof(FilterCaptureState),
+};
+
+static void filter_capture_register_types(void)
+{
+    type_register_static(&filter_capture_info);
+}
+
+type_init(filter_capture_register_types);
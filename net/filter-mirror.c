@@ -170,6 +170,25 @@ static ssize_t filter_mirror_receive_iov(NetFilterState *nf,
     return 0;
 }
 
+static void filter_mirror_receive_iov_batch(NetFilterState *nf,
+                                            NetClientState *sender,
+                                            unsigned flags,
+                                            const struct iovec *iov,
+                                            const int *iovcnt,
+                                            int count)
+{
+    MirrorState *s = FILTER_MIRROR(nf);
+    int i, ret;
+
+    for (i = 0; i < count; i++) {
+        ret = filter_send(s, iov, iovcnt[i]);
+        if (ret) {
+            error_report("filter mirror send failed(%s)", strerror(-ret));
+        }
+        iov += iovcnt[i];
+    }
+}
+
 static ssize_t filter_redirector_receive_iov(NetFilterState *nf,
                                              NetClientState *sender,
                                              unsigned flags,
@@ -383,6 +402,7 @@ static void filter_mirror_class_init(ObjectClass *oc, void *data)
     nfc->setup = filter_mirror_setup;
     nfc->cleanup = filter_mirror_cleanup;
     nfc->receive_iov = filter_mirror_receive_iov;
+    nfc->receive_iov_batch = filter_mirror_receive_iov_batch;
 }
 
 static void filter_redirector_class_init(ObjectClass *oc, void *data)
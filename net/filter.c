@@ -17,6 +17,7 @@
 #include "qom/object_interfaces.h"
 #include "qemu/iov.h"
 #include "qemu/module.h"
+#include "block/aio.h"
 #include "net/colo.h"
 #include "migration/colo.h"
 
@@ -25,6 +26,13 @@ static inline bool qemu_can_skip_netfilter(NetFilterState *nf)
     return !nf->on;
 }
 
+static inline bool qemu_netfilter_applies(NetFilterState *nf,
+                                          NetFilterDirection direction)
+{
+    return nf->direction == direction ||
+           nf->direction == NET_FILTER_DIRECTION_ALL;
+}
+
 ssize_t qemu_netfilter_receive(NetFilterState *nf,
                                NetFilterDirection direction,
                                NetClientState *sender,
@@ -36,8 +44,7 @@ ssize_t qemu_netfilter_receive(NetFilterState *nf,
     if (qemu_can_skip_netfilter(nf)) {
         return 0;
     }
-    if (nf->direction == direction ||
-        nf->direction == NET_FILTER_DIRECTION_ALL) {
+    if (qemu_netfilter_applies(nf, direction)) {
         return NETFILTER_GET_CLASS(OBJECT(nf))->receive_iov(
                                    nf, sender, flags, iov, iovcnt, sent_cb);
     }
@@ -45,6 +52,106 @@ ssize_t qemu_netfilter_receive(NetFilterState *nf,
     return 0;
 }
 
+/*
+ * Can the filters of @nc that see packets travelling in @direction take
+ * them as a batch?  True if none of them is on.
+ */
+bool qemu_netfilter_can_batch(NetClientState *nc,
+                              NetFilterDirection direction)
+{
+    NetFilterState *nf;
+
+    if (!qemu_netfilter_active(nc, direction)) {
+        return true;
+    }
+
+    QTAILQ_FOREACH(nf, &nc->filters, next) {
+        if (!qemu_can_skip_netfilter(nf) &&
+            qemu_netfilter_applies(nf, direction) &&
+            !NETFILTER_GET_CLASS(OBJECT(nf))->receive_iov_batch) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Show a batch of packets to the filters of @nc, in the order they would
+ * have seen them one at a time.  Only valid after
+ * qemu_netfilter_can_batch() said so.
+ */
+void qemu_netfilter_receive_batch(NetClientState *nc,
+                                  NetFilterDirection direction,
+                                  NetClientState *sender,
+                                  unsigned flags,
+                                  const struct iovec *iov,
+                                  const int *iovcnt,
+                                  int count)
+{
+    NetFilterState *nf;
+
+    if (!count || !qemu_netfilter_active(nc, direction)) {
+        return;
+    }
+
+    if (direction == NET_FILTER_DIRECTION_TX) {
+        QTAILQ_FOREACH(nf, &nc->filters, next) {
+            if (!qemu_can_skip_netfilter(nf) &&
+                qemu_netfilter_applies(nf, direction)) {
+                NETFILTER_GET_CLASS(OBJECT(nf))->receive_iov_batch(
+                    nf, sender, flags, iov, iovcnt, count);
+            }
+        }
+    } else {
+        QTAILQ_FOREACH_REVERSE(nf, &nc->filters, next) {
+            if (!qemu_can_skip_netfilter(nf) &&
+                qemu_netfilter_applies(nf, direction)) {
+                NETFILTER_GET_CLASS(OBJECT(nf))->receive_iov_batch(
+                    nf, sender, flags, iov, iovcnt, count);
+            }
+        }
+    }
+}
+
+/*
+ * Keep the count of active filters of the netdev in step with @nf being
+ * attached and on.  A filter on both queues counts for each direction.
+ */
+static void netfilter_account(NetFilterState *nf, int delta)
+{
+    NetClientState *nc = nf->netdev;
+
+    if (nf->direction != NET_FILTER_DIRECTION_RX) {
+        nc->nb_active_filters[NET_FILTER_DIRECTION_TX] += delta;
+    }
+    if (nf->direction != NET_FILTER_DIRECTION_TX) {
+        nc->nb_active_filters[NET_FILTER_DIRECTION_RX] += delta;
+    }
+}
+
+/*
+ * The filter list of a netdev whose datapath runs in an IOThread is
+ * walked from that thread; changes from the monitor must hold its
+ * context.  Returns the context to pass to netfilter_unlock().
+ */
+static AioContext *netfilter_lock(NetClientState *nc)
+{
+    AioContext *ctx = nc ? nc->ctx : NULL;
+
+    if (ctx) {
+        aio_context_acquire(ctx);
+    }
+    return ctx;
+}
+
+static void netfilter_unlock(AioContext *ctx)
+{
+    if (ctx) {
+        aio_context_release(ctx);
+    }
+}
+
 static NetFilterState *netfilter_next(NetFilterState *nf,
                                       NetFilterDirection dir)
 {
@@ -142,7 +249,15 @@ static int netfilter_get_direction(Object *obj, Error **errp G_GNUC_UNUSED)
 static void netfilter_set_direction(Object *obj, int direction, Error **errp)
 {
     NetFilterState *nf = NETFILTER(obj);
+    bool active = nf->on && nf->netdev && QTAILQ_IN_USE(nf, next);
+
+    if (active) {
+        netfilter_account(nf, -1);
+    }
     nf->direction = direction;
+    if (active) {
+        netfilter_account(nf, 1);
+    }
 }
 
 static char *netfilter_get_status(Object *obj, Error **errp)
@@ -156,6 +271,7 @@ static void netfilter_set_status(Object *obj, const char *str, Error **errp)
 {
     NetFilterState *nf = NETFILTER(obj);
     NetFilterClass *nfc = NETFILTER_GET_CLASS(obj);
+    AioContext *ctx;
 
     if (strcmp(str, "on") && strcmp(str, "off")) {
         error_setg(errp, "Invalid value for netfilter status, "
@@ -165,10 +281,15 @@ static void netfilter_set_status(Object *obj, const char *str, Error **errp)
     if (nf->on == !strcmp(str, "on")) {
         return;
     }
+    ctx = netfilter_lock(nf->netdev);
     nf->on = !nf->on;
+    if (nf->netdev && QTAILQ_IN_USE(nf, next)) {
+        netfilter_account(nf, nf->on ? 1 : -1);
+    }
     if (nf->netdev && nfc->status_changed) {
         nfc->status_changed(nf, errp);
     }
+    netfilter_unlock(ctx);
 }
 
 static char *netfilter_get_position(Object *obj, Error **errp)
@@ -220,6 +341,7 @@ static void netfilter_complete(UserCreatable *uc, Error **errp)
     NetFilterState *position = NULL;
     NetClientState *ncs[MAX_QUEUE_NUM];
     NetFilterClass *nfc = NETFILTER_GET_CLASS(uc);
+    AioContext *ctx;
     int queues;
     Error *local_err = NULL;
 
@@ -290,6 +412,7 @@ static void netfilter_complete(UserCreatable *uc, Error **errp)
         }
     }
 
+    ctx = netfilter_lock(nf->netdev);
     if (position) {
         if (nf->insert_before_flag) {
             QTAILQ_INSERT_BEFORE(position, nf, next);
@@ -301,12 +424,17 @@ static void netfilter_complete(UserCreatable *uc, Error **errp)
     } else if (!strcmp(nf->position, "tail")) {
         QTAILQ_INSERT_TAIL(&nf->netdev->filters, nf, next);
     }
+    if (nf->on) {
+        netfilter_account(nf, 1);
+    }
+    netfilter_unlock(ctx);
 }
 
 static void netfilter_finalize(Object *obj)
 {
     NetFilterState *nf = NETFILTER(obj);
     NetFilterClass *nfc = NETFILTER_GET_CLASS(obj);
+    AioContext *ctx = netfilter_lock(nf->netdev);
 
     if (nfc->cleanup) {
         nfc->cleanup(nf);
@@ -315,7 +443,11 @@ static void netfilter_finalize(Object *obj)
     if (nf->netdev && !QTAILQ_EMPTY(&nf->netdev->filters) &&
         QTAILQ_IN_USE(nf, next)) {
         QTAILQ_REMOVE(&nf->netdev->filters, nf, next);
+        if (nf->on) {
+            netfilter_account(nf, -1);
+        }
     }
+    netfilter_unlock(ctx);
     g_free(nf->netdev_id);
     g_free(nf->position);
 }
@@ -55,6 +55,7 @@
 #include "sysemu/runstate.h"
 #include "sysemu/sysemu.h"
 #include "net/filter.h"
+#include "monitor/stats.h"
 #include "qapi/string-output-visitor.h"
 
 /* Net bridge is currently not supported for W32. */
@@ -238,7 +239,8 @@ static void qemu_net_client_setup(NetClientState *nc,
                                   NetClientState *peer,
                                   const char *model,
                                   const char *name,
-                                  NetClientDestructor *destructor)
+                                  NetClientDestructor *destructor,
+                                  bool is_datapath)
 {
     nc->info = info;
     nc->model = g_strdup(model);
@@ -257,6 +259,7 @@ static void qemu_net_client_setup(NetClientState *nc,
 
     nc->incoming_queue = qemu_new_net_queue(qemu_deliver_packet_iov, nc);
     nc->destructor = destructor;
+    nc->is_datapath = is_datapath;
     QTAILQ_INIT(&nc->filters);
 }
 
@@ -271,7 +274,27 @@ NetClientState *qemu_new_net_client(NetClientInfo *info,
 
     nc = g_malloc0(info->size);
     qemu_net_client_setup(nc, info, peer, model, name,
-                          qemu_net_client_destructor);
+                          qemu_net_client_destructor, true);
+
+    return nc;
+}
+
+/*
+ * Like qemu_new_net_client(), for a client that only carries control
+ * traffic (e.g. a control virtqueue) and is not counted as a data queue.
+ */
+NetClientState *qemu_new_net_control_client(NetClientInfo *info,
+                                            NetClientState *peer,
+                                            const char *model,
+                                            const char *name)
+{
+    NetClientState *nc;
+
+    assert(info->size >= sizeof(NetClientState));
+
+    nc = g_malloc0(info->size);
+    qemu_net_client_setup(nc, info, peer, model, name,
+                          qemu_net_client_destructor, false);
 
     return nc;
 }
@@ -296,7 +319,7 @@ NICState *qemu_new_nic(NetClientInfo *info,
 
     for (i = 0; i < queues; i++) {
         qemu_net_client_setup(&nic->ncs[i], info, peers[i], model, name,
-                              NULL);
+                              NULL, true);
         nic->ncs[i].queue_index = i;
     }
 
@@ -566,6 +589,11 @@ static ssize_t filter_receive_iov(NetClientState *nc,
     ssize_t ret = 0;
     NetFilterState *nf = NULL;
 
+    /* Attached filters that are all off cost no list walk */
+    if (likely(!qemu_netfilter_active(nc, direction))) {
+        return 0;
+    }
+
     if (direction == NET_FILTER_DIRECTION_TX) {
         QTAILQ_FOREACH(nf, &nc->filters, next) {
             ret = qemu_netfilter_receive(nf, direction, sender, flags, iov,
@@ -612,6 +640,16 @@ void qemu_purge_queued_packets(NetClientState *nc)
     qemu_net_queue_purge(nc->peer->incoming_queue, nc);
 }
 
+/* Wake up the event loop that polls the peer of @nc */
+static void qemu_net_notify_peer(NetClientState *nc)
+{
+    if (nc->ctx) {
+        aio_notify(nc->ctx);
+    } else {
+        qemu_notify_event();
+    }
+}
+
 void qemu_flush_or_purge_queued_packets(NetClientState *nc, bool purge)
 {
     nc->receive_disabled = 0;
@@ -625,7 +663,7 @@ void qemu_flush_or_purge_queued_packets(NetClientState *nc, bool purge)
         /* We emptied the queue successfully, signal to the IO thread to repoll
          * the file descriptor (for tap, for example).
          */
-        qemu_notify_event();
+        qemu_net_notify_peer(nc);
     } else if (purge) {
         /* Unable to empty the queue, purge remaining packets */
         qemu_net_queue_purge(nc->incoming_queue, nc->peer);
@@ -637,6 +675,34 @@ void qemu_flush_queued_packets(NetClientState *nc)
     qemu_flush_or_purge_queued_packets(nc, false);
 }
 
+/* Can the datapath between @nc and its peer leave the main loop? */
+bool qemu_net_can_set_aio_context(NetClientState *nc)
+{
+    return nc->peer && nc->peer->info->set_aio_context;
+}
+
+/**
+ * qemu_net_set_aio_context:
+ * @nc: the NIC side of the datapath
+ * @ctx: the new context, or NULL for the main loop
+ *
+ * Run the datapath between @nc and its peer in @ctx.  The caller is the
+ * NIC, which must invoke its own callbacks from @ctx with @ctx held, so
+ * that the net queues and filters of the pair are only touched by code
+ * holding @ctx; the main loop acquires it for control operations.
+ *
+ * Called from @ctx, or from the old context with @ctx held.
+ */
+void qemu_net_set_aio_context(NetClientState *nc, AioContext *ctx)
+{
+    nc->ctx = ctx;
+    if (nc->peer) {
+        assert(qemu_net_can_set_aio_context(nc));
+        nc->peer->ctx = ctx;
+        nc->peer->info->set_aio_context(nc->peer, ctx);
+    }
+}
+
 static ssize_t qemu_send_packet_async_with_flags(NetClientState *sender,
                                                  unsigned flags,
                                                  const uint8_t *buf, int size,
@@ -767,6 +833,9 @@ static ssize_t qemu_deliver_packet_iov(NetClientState *sender,
 
     if (ret == 0) {
         nc->receive_disabled = 1;
+    } else if (ret > 0) {
+        stat64_add(&nc->rx_packets, 1);
+        stat64_add(&nc->rx_bytes, ret);
     }
 
     return ret;
@@ -808,6 +877,62 @@ ssize_t qemu_sendv_packet_async(NetClientState *sender,
                                    iov, iovcnt, sent_cb);
 }
 
+/**
+ * qemu_sendv_packets_async:
+ * @sender: the sending net client
+ * @iov: the iovecs of all packets, back to back
+ * @iovcnt: number of @iov entries used by each packet
+ * @count: number of packets
+ * @sent_cb: called when a queued packet has been delivered
+ *
+ * Send @count packets to the peer of @sender.  If the peer implements
+ * receive_iov_batch, no previously queued packets have to go first and
+ * every active filter on the way can observe a batch, they are handed
+ * over in a single call; anything the peer could not take is sent one
+ * packet at a time.
+ *
+ * Returns 0 if at least one packet was queued, in which case the sender
+ * must not send more packets until @sent_cb is invoked, otherwise @count.
+ */
+int qemu_sendv_packets_async(NetClientState *sender,
+                             const struct iovec *iov, const int *iovcnt,
+                             int count, NetPacketSent *sent_cb)
+{
+    NetClientState *peer = sender->peer;
+    bool queued = false;
+    int i, done = 0;
+
+    if (sender->link_down || !peer) {
+        return count;
+    }
+
+    if (peer->info->receive_iov_batch && !peer->link_down &&
+        qemu_netfilter_can_batch(sender, NET_FILTER_DIRECTION_TX) &&
+        qemu_netfilter_can_batch(peer, NET_FILTER_DIRECTION_RX) &&
+        qemu_net_queue_idle(peer->incoming_queue) &&
+        qemu_can_send_packet(sender)) {
+        done = peer->info->receive_iov_batch(peer, iov, iovcnt, count);
+        assert(done >= 0 && done <= count);
+        /* The rest meet the filters on the per-packet path below */
+        qemu_netfilter_receive_batch(sender, NET_FILTER_DIRECTION_TX, sender,
+                                     QEMU_NET_PACKET_FLAG_NONE,
+                                     iov, iovcnt, done);
+        qemu_netfilter_receive_batch(peer, NET_FILTER_DIRECTION_RX, sender,
+                                     QEMU_NET_PACKET_FLAG_NONE,
+                                     iov, iovcnt, done);
+    }
+
+    for (i = 0; i < count; i++) {
+        if (i >= done &&
+            qemu_sendv_packet_async(sender, iov, iovcnt[i], sent_cb) == 0) {
+            queued = true;
+        }
+        iov += iovcnt[i];
+    }
+
+    return queued ? 0 : count;
+}
+
 ssize_t
 qemu_sendv_packet(NetClientState *nc, const struct iovec *iov, int iovcnt)
 {
@@ -989,6 +1114,9 @@ static int (* const net_client_init_fun[NET_CLIENT_DRIVER__MAX])(
 #ifdef CONFIG_NETMAP
         [NET_CLIENT_DRIVER_NETMAP]    = net_init_netmap,
 #endif
+#ifdef CONFIG_AF_XDP
+        [NET_CLIENT_DRIVER_AF_XDP]    = net_init_af_xdp,
+#endif
 #ifdef CONFIG_NET_BRIDGE
         [NET_CLIENT_DRIVER_BRIDGE]    = net_init_bridge,
 #endif
@@ -1082,6 +1210,9 @@ void show_netdevs(void)
 #ifdef CONFIG_NETMAP
         "netmap",
 #endif
+#ifdef CONFIG_AF_XDP
+        "af-xdp",
+#endif
 #ifdef CONFIG_POSIX
         "vhost-user",
 #endif
@@ -1529,12 +1660,36 @@ out:
     return ret;
 }
 
+static void net_stats_cb(StatsResultList **result, strList *names,
+                         Error **errp)
+{
+    NetClientState *nc;
+
+    QTAILQ_FOREACH(nc, &net_clients, next) {
+        StatsList *stats = NULL;
+
+        stats_add(&stats, names, "rx-bytes", stat64_get(&nc->rx_bytes));
+        stats_add(&stats, names, "rx-packets", stat64_get(&nc->rx_packets));
+        stats_result_add(result, STATS_PROVIDER_NET, nc->name, stats);
+    }
+}
+
+static void net_stats_schemas_cb(StatsSchemaValueList **result)
+{
+    stats_schema_add(result, "rx-bytes", STATS_TYPE_CUMULATIVE,
+                     STATS_UNIT_BYTES);
+    stats_schema_add(result, "rx-packets", STATS_TYPE_CUMULATIVE,
+                     STATS_UNIT__MAX);
+}
+
 int net_init_clients(Error **errp)
 {
     net_change_state_entry =
         qemu_add_vm_change_state_handler(net_vm_change_state_handler, NULL);
 
     QTAILQ_INIT(&net_clients);
+    add_stats_callbacks(STATS_PROVIDER_NET, net_stats_cb,
+                        net_stats_schemas_cb);
 
     if (qemu_opts_foreach(qemu_find_opts("netdev"),
                           net_init_netdev, NULL, errp)) {
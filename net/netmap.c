@@ -40,6 +40,9 @@
 #include "qemu/cutils.h"
 #include "qemu/main-loop.h"
 
+/* Maximum number of packets handed to the peer in one go. */
+#define NETMAP_BATCH_MAX 64
+
 typedef struct NetmapState {
     NetClientState      nc;
     struct nm_desc      *nmd;
@@ -48,7 +51,9 @@ typedef struct NetmapState {
     struct netmap_ring  *rx;
     bool                read_poll;
     bool                write_poll;
+    QEMUBH              *txsync_bh;    /* Deferred NIOCTXSYNC. */
     struct iovec        iov[IOV_MAX];
+    int                 iovcnt[NETMAP_BATCH_MAX];
     int                 vnet_hdr_len;  /* Current virtio-net header length. */
 } NetmapState;
 
@@ -79,22 +84,32 @@ pkt_copy(const void *_src, void *_dst, int l)
 #endif /* __FreeBSD__ */
 
 /*
- * Open a netmap device. We assume there is only one queue
- * (which is the case for the VALE bridge).
+ * Open a netmap device.  With a single queue all the rings of the port
+ * are bound and only the first pair is used (the VALE bridge has only
+ * one).  Otherwise queue @queue is bound to ring pair @queue alone, and
+ * shares the memory mapping of @parent, the descriptor of queue 0.
  */
 static struct nm_desc *netmap_open(const NetdevNetmapOptions *nm_opts,
-                                   Error **errp)
+                                   int64_t queue, int64_t queues,
+                                   struct nm_desc *parent, Error **errp)
 {
+    g_autofree char *ifname = NULL;
     struct nm_desc *nmd;
     struct nmreq req;
 
     memset(&req, 0, sizeof(req));
 
-    nmd = nm_open(nm_opts->ifname, &req, NETMAP_NO_TX_POLL,
-                  NULL);
+    if (queues > 1) {
+        ifname = g_strdup_printf("%s-%" PRIi64, nm_opts->ifname, queue);
+    } else {
+        ifname = g_strdup(nm_opts->ifname);
+    }
+
+    nmd = nm_open(ifname, &req,
+                  NETMAP_NO_TX_POLL | (parent ? NM_OPEN_NO_MMAP : 0),
+                  parent);
     if (nmd == NULL) {
-        error_setg_errno(errp, errno, "Failed to nm_open() %s",
-                         nm_opts->ifname);
+        error_setg_errno(errp, errno, "Failed to nm_open() %s", ifname);
         return NULL;
     }
 
@@ -155,6 +170,18 @@ static void netmap_writable(void *opaque)
     qemu_flush_queued_packets(&s->nc);
 }
 
+/*
+ * Let the kernel transmit the slots published so far.  The sync is
+ * deferred to a bottom half so that a burst of packets from the peer
+ * costs one ioctl instead of one per packet.
+ */
+static void netmap_txsync(void *opaque)
+{
+    NetmapState *s = opaque;
+
+    ioctl(s->nmd->fd, NIOCTXSYNC, NULL);
+}
+
 static ssize_t netmap_receive_iov(NetClientState *nc,
                     const struct iovec *iov, int iovcnt)
 {
@@ -221,7 +248,7 @@ static ssize_t netmap_receive_iov(NetClientState *nc,
      * the new wakeup point. */
     ring->head = ring->cur = i;
 
-    ioctl(s->nmd->fd, NIOCTXSYNC, NULL);
+    qemu_bh_schedule(s->txsync_bh);
 
     return totlen;
 }
@@ -256,38 +283,65 @@ static void netmap_send(void *opaque)
        RX ring and the forwarding path towards the peer is open. */
     while (ring->head != tail) {
         uint32_t i = ring->head;
+        uint32_t pkt_start = i;
         uint32_t idx;
-        bool morefrag;
+        bool morefrag = false;
+        int npkts = 0;
         int iovcnt = 0;
-        int iovsize;
-
-        /* Get a (possibly multi-slot) packet. */
-        do {
-            idx = ring->slot[i].buf_idx;
-            morefrag = (ring->slot[i].flags & NS_MOREFRAG);
-            s->iov[iovcnt].iov_base = (void *)NETMAP_BUF(ring, idx);
-            s->iov[iovcnt].iov_len = ring->slot[i].len;
-            iovcnt++;
-            i = nm_ring_next(ring, i);
-        } while (i != tail && morefrag);
+        int pkt_iovcnt;
+        int ret;
+
+        /* Get a batch of (possibly multi-slot) packets. */
+        while (i != tail && npkts < NETMAP_BATCH_MAX) {
+            pkt_start = i;
+            pkt_iovcnt = 0;
+            do {
+                idx = ring->slot[i].buf_idx;
+                morefrag = (ring->slot[i].flags & NS_MOREFRAG);
+                s->iov[iovcnt].iov_base = (void *)NETMAP_BUF(ring, idx);
+                s->iov[iovcnt].iov_len = ring->slot[i].len;
+                iovcnt++;
+                pkt_iovcnt++;
+                i = nm_ring_next(ring, i);
+            } while (i != tail && morefrag && iovcnt < IOV_MAX);
+
+            if (unlikely(morefrag)) {
+                /* Leave the incomplete packet for the next round. */
+                iovcnt -= pkt_iovcnt;
+                break;
+            }
+            s->iovcnt[npkts++] = pkt_iovcnt;
+            if (iovcnt == IOV_MAX) {
+                break;
+            }
+        }
 
         /* Advance ring->cur to tell the kernel that we have seen the slots. */
         ring->cur = i;
 
         if (unlikely(morefrag)) {
-            /* This is a truncated packet, so we can stop without releasing the
-             * incomplete slots by updating ring->head. We will hopefully
-             * re-read the complete packet the next time we are called. */
-            break;
+            i = pkt_start;
+            if (!npkts) {
+                /* This is a truncated packet, so we can stop without
+                 * releasing the incomplete slots by updating ring->head.
+                 * We will hopefully re-read the complete packet the next
+                 * time we are called. */
+                break;
+            }
         }
 
-        iovsize = qemu_sendv_packet_async(&s->nc, s->iov, iovcnt,
-                                            netmap_send_completed);
+        /*
+         * The slots are handed over without copying; whatever the peer
+         * can't take right away is copied into its queue, so all of them
+         * can be released below.
+         */
+        ret = qemu_sendv_packets_async(&s->nc, s->iov, s->iovcnt, npkts,
+                                       netmap_send_completed);
 
         /* Release the slots to the kernel. */
         ring->head = i;
 
-        if (iovsize == 0) {
+        if (ret == 0) {
             /* The peer does not receive anymore. Packet is queued, stop
              * reading from the backend until netmap_send_completed(). */
             netmap_read_poll(s, false);
@@ -304,6 +358,7 @@ static void netmap_cleanup(NetClientState *nc)
     qemu_purge_queued_packets(nc);
 
     netmap_poll(nc, false);
+    qemu_bh_delete(s->txsync_bh);
     nm_close(s->nmd);
     s->nmd = NULL;
 }
@@ -401,32 +456,61 @@ static NetClientInfo net_netmap_info = {
 
 /* The exported init function
  *
- * ... -net netmap,ifname="..."
+ * ... -net netmap,ifname="..."[,queues=n]
  */
 int net_init_netmap(const Netdev *netdev,
                     const char *name, NetClientState *peer, Error **errp)
 {
     const NetdevNetmapOptions *netmap_opts = &netdev->u.netmap;
-    struct nm_desc *nmd;
-    NetClientState *nc;
+    struct nm_desc *nmd, *parent = NULL;
+    NetClientState *nc, *nc0 = NULL;
     Error *err = NULL;
     NetmapState *s;
+    int64_t i, queues;
 
-    nmd = netmap_open(netmap_opts, &err);
-    if (err) {
-        error_propagate(errp, err);
+    queues = netmap_opts->has_queues ? netmap_opts->queues : 1;
+    if (queues < 1 || queues > MAX_QUEUE_NUM) {
+        error_setg(errp, "invalid number of queues (%" PRIi64 ") for '%s'",
+                   queues, netmap_opts->ifname);
         return -1;
     }
-    /* Create the object. */
-    nc = qemu_new_net_client(&net_netmap_info, peer, "netmap", name);
-    s = DO_UPCAST(NetmapState, nc, nc);
-    s->nmd = nmd;
-    s->tx = NETMAP_TXRING(nmd->nifp, 0);
-    s->rx = NETMAP_RXRING(nmd->nifp, 0);
-    s->vnet_hdr_len = 0;
-    pstrcpy(s->ifname, sizeof(s->ifname), netmap_opts->ifname);
-    netmap_read_poll(s, true); /* Initially only poll for reads. */
+
+    for (i = 0; i < queues; i++) {
+        nmd = netmap_open(netmap_opts, i, queues, parent, &err);
+        if (err) {
+            error_propagate(errp, err);
+            goto err;
+        }
+        if (!parent) {
+            parent = nmd;
+        }
+
+        /* Create the object. */
+        nc = qemu_new_net_client(&net_netmap_info, peer, "netmap", name);
+        nc->queue_index = i;
+        if (!nc0) {
+            nc0 = nc;
+        }
+
+        s = DO_UPCAST(NetmapState, nc, nc);
+        s->nmd = nmd;
+        s->tx = NETMAP_TXRING(nmd->nifp, nmd->first_tx_ring);
+        s->rx = NETMAP_RXRING(nmd->nifp, nmd->first_rx_ring);
+        s->txsync_bh = qemu_bh_new(netmap_txsync, s);
+        s->vnet_hdr_len = 0;
+        pstrcpy(s->ifname, sizeof(s->ifname), netmap_opts->ifname);
+        netmap_read_poll(s, true); /* Initially only poll for reads. */
+    }
 
     return 0;
+
+err:
+    if (nc0) {
+        qemu_del_net_client(nc0);
+    } else if (parent) {
+        nm_close(parent);
+    }
+
+    return -1;
 }
 
@@ -78,6 +78,9 @@ struct slirp_config_str {
     char str[1024];
 };
 
+/* Upper bound on the packets handed to the peer in one call */
+#define SLIRP_TX_BATCH 64
+
 struct GuestFwd {
     CharBackend hd;
     struct in_addr server;
@@ -95,6 +98,12 @@ typedef struct SlirpState {
     gchar *smb_dir;
 #endif
     GSList *fwd;
+    int sockbuf_size;
+    /* Packets produced while slirp_pollfds_poll() runs, sent in one go */
+    bool tx_batching;
+    int tx_batch_len;
+    struct iovec tx_batch_iov[SLIRP_TX_BATCH];
+    int tx_batch_iovcnt[SLIRP_TX_BATCH];
 } SlirpState;
 
 static struct slirp_config_str *slirp_configs;
@@ -112,6 +121,28 @@ static void slirp_smb_cleanup(SlirpState *s);
 static inline void slirp_smb_cleanup(SlirpState *s) { }
 #endif
 
+static void net_slirp_flush_batch(SlirpState *s)
+{
+    int i;
+
+    if (!s->tx_batch_len) {
+        return;
+    }
+
+    /*
+     * Nothing is waiting on a sent callback: whatever the peer cannot
+     * take right now is copied into its incoming queue, like
+     * qemu_send_packet() does.
+     */
+    qemu_sendv_packets_async(&s->nc, s->tx_batch_iov, s->tx_batch_iovcnt,
+                             s->tx_batch_len, NULL);
+
+    for (i = 0; i < s->tx_batch_len; i++) {
+        g_free(s->tx_batch_iov[i].iov_base);
+    }
+    s->tx_batch_len = 0;
+}
+
 static ssize_t net_slirp_send_packet(const void *pkt, size_t pkt_len,
                                      void *opaque)
 {
@@ -126,7 +157,19 @@ static ssize_t net_slirp_send_packet(const void *pkt, size_t pkt_len,
         }
     }
 
-    return qemu_send_packet(&s->nc, pkt, pkt_len);
+    if (!s->tx_batching) {
+        return qemu_send_packet(&s->nc, pkt, pkt_len);
+    }
+
+    if (s->tx_batch_len == SLIRP_TX_BATCH) {
+        net_slirp_flush_batch(s);
+    }
+    s->tx_batch_iov[s->tx_batch_len].iov_base = g_memdup(pkt, pkt_len);
+    s->tx_batch_iov[s->tx_batch_len].iov_len = pkt_len;
+    s->tx_batch_iovcnt[s->tx_batch_len] = 1;
+    s->tx_batch_len++;
+
+    return pkt_len;
 }
 
 static ssize_t net_slirp_receive(NetClientState *nc, const uint8_t *buf, size_t size)
@@ -205,7 +248,21 @@ static void net_slirp_timer_mod(void *timer, int64_t expire_timer,
 
 static void net_slirp_register_poll_fd(int fd, void *opaque)
 {
+    SlirpState *s = opaque;
+
     qemu_fd_register(fd);
+
+    /*
+     * Accepted sockets inherit the buffers of their listening socket, so
+     * this covers host forwards as well as the connections the guest
+     * opens.  Failing is harmless: the host default stays in effect.
+     */
+    if (s->sockbuf_size) {
+        qemu_setsockopt(fd, SOL_SOCKET, SO_SNDBUF,
+                        &s->sockbuf_size, sizeof(s->sockbuf_size));
+        qemu_setsockopt(fd, SOL_SOCKET, SO_RCVBUF,
+                        &s->sockbuf_size, sizeof(s->sockbuf_size));
+    }
 }
 
 static void net_slirp_unregister_poll_fd(int fd, void *opaque)
@@ -307,8 +364,16 @@ static void net_slirp_poll_notify(Notifier *notifier, void *data)
         break;
     case MAIN_LOOP_POLL_OK:
     case MAIN_LOOP_POLL_ERR:
+        /*
+         * A single poll typically turns the data read from many sockets
+         * into a burst of frames for the guest; hand them to the peer in
+         * one batch instead of one qemu_send_packet() each.
+         */
+        s->tx_batching = true;
         slirp_pollfds_poll(s->slirp, poll->state == MAIN_LOOP_POLL_ERR,
                            net_slirp_get_revents, poll->pollfds);
+        s->tx_batching = false;
+        net_slirp_flush_batch(s);
         break;
     default:
         g_assert_not_reached();
@@ -366,6 +431,7 @@ static int net_slirp_init(NetClientState *peer, const char *model,
                           const char *smb_export, const char *vsmbserver,
                           const char **dnssearch, const char *vdomainname,
                           const char *tftp_server_name,
+                          uint64_t sockbuf_size,
                           Error **errp)
 {
     /* default settings according to historic slirp */
@@ -393,6 +459,11 @@ static int net_slirp_init(NetClientState *peer, const char *model,
         return -1;
     }
 
+    if (sockbuf_size > INT_MAX) {
+        error_setg(errp, "sockbuf-size must not exceed %d", INT_MAX);
+        return -1;
+    }
+
     if (!ipv6 && (vprefix6 || vhost6 || vnameserver6)) {
         error_setg(errp, "IPv6 disabled but prefix/host6/dns6 provided");
         return -1;
@@ -567,6 +638,7 @@ static int net_slirp_init(NetClientState *peer, const char *model,
              restricted ? "on" : "off");
 
     s = DO_UPCAST(SlirpState, nc, nc);
+    s->sockbuf_size = sockbuf_size;
 
     s->slirp = slirp_init(restricted, ipv4, net, mask, host,
                           ipv6, ip6_prefix, vprefix6_len, ip6_host,
@@ -1109,7 +1181,7 @@ int net_init_slirp(const Netdev *netdev, const char *name,
                          user->bootfile, user->dhcpstart,
                          user->dns, user->ipv6_dns, user->smb,
                          user->smbserver, dnssearch, user->domainname,
-                         user->tftp_server_name, errp);
+                         user->tftp_server_name, user->sockbuf_size, errp);
 
     while (slirp_configs) {
         config = slirp_configs;
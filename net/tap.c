@@ -48,12 +48,20 @@
 
 #include "net/vhost_net.h"
 
+/*
+ * tap_send() reads several packets per wakeup into buf and hands them to
+ * the peer as one batch; buf always has room for one more full packet
+ * while there are fewer than TAP_BATCH_MAX of them.
+ */
+#define TAP_BATCH_MAX 32
+#define TAP_BUFSIZE (4 * NET_BUFSIZE)
+
 typedef struct TAPState {
     NetClientState nc;
     int fd;
     char down_script[1024];
     char down_script_arg[128];
-    uint8_t buf[NET_BUFSIZE];
+    uint8_t buf[TAP_BUFSIZE];
     bool read_poll;
     bool write_poll;
     bool using_vnet_hdr;
@@ -62,6 +70,7 @@ typedef struct TAPState {
     VHostNetState *vhost_net;
     unsigned host_vnet_hdr_len;
     Notifier exit;
+    AioContext *ctx;    /* NULL if polled by the main loop */
 } TAPState;
 
 static void launch_script(const char *setup_script, const char *ifname,
@@ -70,12 +79,40 @@ static void launch_script(const char *setup_script, const char *ifname,
 static void tap_send(void *opaque);
 static void tap_writable(void *opaque);
 
+static void tap_send_ctx(void *opaque)
+{
+    TAPState *s = opaque;
+
+    aio_context_acquire(s->ctx);
+    tap_send(s);
+    aio_context_release(s->ctx);
+}
+
+static void tap_writable_ctx(void *opaque)
+{
+    TAPState *s = opaque;
+
+    aio_context_acquire(s->ctx);
+    tap_writable(s);
+    aio_context_release(s->ctx);
+}
+
 static void tap_update_fd_handler(TAPState *s)
 {
-    qemu_set_fd_handler(s->fd,
-                        s->read_poll && s->enabled ? tap_send : NULL,
-                        s->write_poll && s->enabled ? tap_writable : NULL,
-                        s);
+    bool read = s->read_poll && s->enabled;
+    bool write = s->write_poll && s->enabled;
+
+    if (s->ctx) {
+        aio_set_fd_handler(s->ctx, s->fd, true,
+                           read ? tap_send_ctx : NULL,
+                           write ? tap_writable_ctx : NULL,
+                           NULL, s);
+    } else {
+        qemu_set_fd_handler(s->fd,
+                            read ? tap_send : NULL,
+                            write ? tap_writable : NULL,
+                            s);
+    }
 }
 
 static void tap_read_poll(TAPState *s, bool enable)
@@ -185,46 +222,64 @@ static void tap_send_completed(NetClientState *nc, ssize_t len)
 static void tap_send(void *opaque)
 {
     TAPState *s = opaque;
-    int size;
     int packets = 0;
+    bool drained = false;
 
-    while (true) {
-        uint8_t *buf = s->buf;
-        uint8_t min_pkt[ETH_ZLEN];
-        size_t min_pktsz = sizeof(min_pkt);
+    while (!drained) {
+        struct iovec iov[TAP_BATCH_MAX];
+        int iovcnt[TAP_BATCH_MAX];
+        uint8_t min_pkt[TAP_BATCH_MAX][ETH_ZLEN];
+        size_t offset = 0;
+        int n = 0;
 
-        size = tap_read_packet(s->fd, s->buf, sizeof(s->buf));
-        if (size <= 0) {
-            break;
-        }
+        /*
+         * When the host keeps receiving more packets while tap_send() is
+         * running we can hog the QEMU global mutex.  Limit the number of
+         * packets that are processed per tap_send() callback to prevent
+         * stalling the guest.
+         */
+        while (n < MIN(TAP_BATCH_MAX, 50 - packets) &&
+               sizeof(s->buf) - offset >= NET_BUFSIZE) {
+            uint8_t *buf = s->buf + offset;
+            size_t min_pktsz = sizeof(min_pkt[n]);
+            int size;
+
+            size = tap_read_packet(s->fd, buf, NET_BUFSIZE);
+            if (size <= 0) {
+                drained = true;
+                break;
+            }
+            offset = QEMU_ALIGN_UP(offset + size, sizeof(uint64_t));
 
-        if (s->host_vnet_hdr_len && !s->using_vnet_hdr) {
-            buf  += s->host_vnet_hdr_len;
-            size -= s->host_vnet_hdr_len;
-        }
+            if (s->host_vnet_hdr_len && !s->using_vnet_hdr) {
+                buf  += s->host_vnet_hdr_len;
+                size -= s->host_vnet_hdr_len;
+            }
 
-        if (net_peer_needs_padding(&s->nc)) {
-            if (eth_pad_short_frame(min_pkt, &min_pktsz, buf, size)) {
-                buf = min_pkt;
-                size = min_pktsz;
+            if (net_peer_needs_padding(&s->nc)) {
+                if (eth_pad_short_frame(min_pkt[n], &min_pktsz, buf, size)) {
+                    buf = min_pkt[n];
+                    size = min_pktsz;
+                }
             }
+
+            iov[n].iov_base = buf;
+            iov[n].iov_len = size;
+            iovcnt[n] = 1;
+            n++;
         }
 
-        size = qemu_send_packet_async(&s->nc, buf, size, tap_send_completed);
-        if (size == 0) {
-            tap_read_poll(s, false);
+        if (n == 0) {
             break;
-        } else if (size < 0) {
+        }
+
+        if (qemu_sendv_packets_async(&s->nc, iov, iovcnt, n,
+                                     tap_send_completed) == 0) {
+            tap_read_poll(s, false);
             break;
         }
 
-        /*
-         * When the host keeps receiving more packets while tap_send() is
-         * running we can hog the QEMU global mutex.  Limit the number of
-         * packets that are processed per tap_send() callback to prevent
-         * stalling the guest.
-         */
-        packets++;
+        packets += n;
         if (packets >= 50) {
             break;
         }
@@ -295,6 +350,13 @@ static int tap_set_vnet_be(NetClientState *nc, bool is_be)
     return tap_fd_set_vnet_be(s->fd, is_be);
 }
 
+static bool tap_set_steering_ebpf(NetClientState *nc, int prog_fd)
+{
+    TAPState *s = DO_UPCAST(TAPState, nc, nc);
+
+    return tap_fd_set_steering_ebpf(s->fd, prog_fd) == 0;
+}
+
 static void tap_set_offload(NetClientState *nc, int csum, int tso4,
                      int tso6, int ecn, int ufo)
 {
@@ -347,6 +409,19 @@ static void tap_poll(NetClientState *nc, bool enable)
     tap_write_poll(s, enable);
 }
 
+static void tap_set_aio_context(NetClientState *nc, AioContext *ctx)
+{
+    TAPState *s = DO_UPCAST(TAPState, nc, nc);
+
+    if (s->ctx) {
+        aio_set_fd_handler(s->ctx, s->fd, true, NULL, NULL, NULL, NULL);
+    } else {
+        qemu_set_fd_handler(s->fd, NULL, NULL, NULL);
+    }
+    s->ctx = ctx;
+    tap_update_fd_handler(s);
+}
+
 int tap_get_fd(NetClientState *nc)
 {
     TAPState *s = DO_UPCAST(TAPState, nc, nc);
@@ -372,6 +447,8 @@ static NetClientInfo net_tap_info = {
     .set_vnet_hdr_len = tap_set_vnet_hdr_len,
     .set_vnet_le = tap_set_vnet_le,
     .set_vnet_be = tap_set_vnet_be,
+    .set_steering_ebpf = tap_set_steering_ebpf,
+    .set_aio_context = tap_set_aio_context,
 };
 
 static TAPState *net_tap_fd_init(NetClientState *peer,
@@ -701,6 +778,7 @@ static void net_init_tap_one(const NetdevTapOptions *tap, NetClientState *peer,
 
         options.backend_type = VHOST_BACKEND_TYPE_KERNEL;
         options.net_backend = &s->nc;
+        options.nvqs = 2;
         if (tap->has_poll_us) {
             options.busyloop_timeout = tap->poll_us;
         } else {
@@ -76,6 +76,7 @@ static int vhost_user_start(int queues, NetClientState *ncs[],
     int i;
 
     options.backend_type = VHOST_BACKEND_TYPE_USER;
+    options.nvqs = 2;
 
     for (i = 0; i < queues; i++) {
         assert(ncs[i]->info->type == NET_CLIENT_DRIVER_VHOST_USER);
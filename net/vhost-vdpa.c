@@ -14,8 +14,11 @@
 #include "net/vhost_net.h"
 #include "net/vhost-vdpa.h"
 #include "hw/virtio/vhost-vdpa.h"
+#include "hw/virtio/virtio-net.h"
+#include "migration/misc.h"
 #include "qemu/config-file.h"
 #include "qemu/error-report.h"
+#include "qemu/iov.h"
 #include "qemu/option.h"
 #include "qapi/error.h"
 #include <sys/ioctl.h>
@@ -24,13 +27,19 @@
 #include "monitor/monitor.h"
 #include "hw/virtio/vhost.h"
 
-/* Todo:need to add the multiqueue support here */
+/*
+ * There is one VhostVDPAState per queue pair, plus one for the control
+ * virtqueue if the device has one.  They all share the vhost-vdpa device fd,
+ * which belongs to the first queue pair.
+ */
 typedef struct VhostVDPAState {
     NetClientState nc;
     struct vhost_vdpa vhost_vdpa;
     VHostNetState *vhost_net;
     uint64_t acked_features;
     bool started;
+    /* First queue pair only: switches to shadow virtqueues for migration */
+    Notifier migration_state;
 } VhostVDPAState;
 
 const int vdpa_feature_bits[] = {
@@ -56,6 +65,13 @@ const int vdpa_feature_bits[] = {
     VIRTIO_F_RING_PACKED,
     VIRTIO_NET_F_GUEST_ANNOUNCE,
     VIRTIO_NET_F_STATUS,
+    VIRTIO_NET_F_CTRL_VQ,
+    VIRTIO_NET_F_CTRL_RX,
+    VIRTIO_NET_F_CTRL_VLAN,
+    VIRTIO_NET_F_CTRL_RX_EXTRA,
+    VIRTIO_NET_F_CTRL_MAC_ADDR,
+    VIRTIO_NET_F_CTRL_GUEST_OFFLOADS,
+    VIRTIO_NET_F_MQ,
     VHOST_INVALID_FEATURE_BIT
 };
 
@@ -89,17 +105,7 @@ static int vhost_vdpa_net_check_device_id(struct vhost_net *net)
     return ret;
 }
 
-static void vhost_vdpa_del(NetClientState *ncs)
-{
-    VhostVDPAState *s;
-    assert(ncs->info->type == NET_CLIENT_DRIVER_VHOST_VDPA);
-    s = DO_UPCAST(VhostVDPAState, nc, ncs);
-    if (s->vhost_net) {
-        vhost_net_cleanup(s->vhost_net);
-    }
-}
-
-static int vhost_vdpa_add(NetClientState *ncs, void *be)
+static int vhost_vdpa_add(NetClientState *ncs, void *be, unsigned int nvqs)
 {
     VhostNetOptions options;
     struct vhost_net *net = NULL;
@@ -112,43 +118,38 @@ static int vhost_vdpa_add(NetClientState *ncs, void *be)
     options.net_backend = ncs;
     options.opaque      = be;
     options.busyloop_timeout = 0;
+    options.nvqs = nvqs;
 
     net = vhost_net_init(&options);
     if (!net) {
         error_report("failed to init vhost_net for queue");
-        goto err;
-    }
-    if (s->vhost_net) {
-        vhost_net_cleanup(s->vhost_net);
-        g_free(s->vhost_net);
+        return -1;
     }
+    /* Freed by vhost_vdpa_cleanup() from now on */
     s->vhost_net = net;
     ret = vhost_vdpa_net_check_device_id(net);
     if (ret) {
-        goto err;
+        return -1;
     }
     return 0;
-err:
-    if (net) {
-        vhost_net_cleanup(net);
-    }
-    vhost_vdpa_del(ncs);
-    return -1;
 }
 
 static void vhost_vdpa_cleanup(NetClientState *nc)
 {
     VhostVDPAState *s = DO_UPCAST(VhostVDPAState, nc, nc);
 
+    if (nc->queue_index == 0) {
+        remove_migration_state_change_notifier(&s->migration_state);
+    }
     if (s->vhost_net) {
         vhost_net_cleanup(s->vhost_net);
         g_free(s->vhost_net);
         s->vhost_net = NULL;
     }
-     if (s->vhost_vdpa.device_fd >= 0) {
+    if (s->vhost_vdpa.device_fd >= 0 && nc->queue_index == 0) {
         qemu_close(s->vhost_vdpa.device_fd);
-        s->vhost_vdpa.device_fd = -1;
     }
+    s->vhost_vdpa.device_fd = -1;
 }
 
 static bool vhost_vdpa_has_vnet_hdr(NetClientState *nc)
@@ -177,26 +178,229 @@ static NetClientInfo net_vhost_vdpa_info = {
         .has_ufo = vhost_vdpa_has_ufo,
 };
 
-static int net_vhost_vdpa_init(NetClientState *peer, const char *device,
-                               const char *name, const char *vhostdev)
+/*
+ * The control virtqueue is always shadowed, so that the commands the device
+ * accepted can be replayed into the virtio-net model, which migrates them.
+ */
+static void vhost_vdpa_net_cvq_used(VhostShadowVirtqueue *svq,
+                                    const VirtQueueElement *elem,
+                                    uint32_t len, void *opaque)
+{
+    VhostVDPAState *s = opaque;
+    VirtIODevice *vdev = s->vhost_vdpa.dev->vdev;
+    virtio_net_ctrl_ack status = VIRTIO_NET_ERR;
+    virtio_net_ctrl_ack model_status;
+    struct iovec model_in = {
+        .iov_base = &model_status,
+        .iov_len = sizeof(model_status),
+    };
+
+    if (len < sizeof(status) ||
+        iov_to_buf(elem->in_sg, elem->in_num, 0, &status,
+                   sizeof(status)) != sizeof(status) ||
+        status != VIRTIO_NET_OK) {
+        return;
+    }
+
+    /* The guest already got the device's answer, drop the model's one */
+    virtio_net_handle_ctrl_iov(vdev, &model_in, 1, elem->out_sg,
+                               elem->out_num);
+}
+
+static const VhostShadowVirtqueueOps vhost_vdpa_net_cvq_ops = {
+    .used_handler = vhost_vdpa_net_cvq_used,
+};
+
+static int vhost_vdpa_net_load_cmd(VhostVDPAState *s, uint8_t class,
+                                   uint8_t cmd, const void *data,
+                                   size_t data_size)
+{
+    const struct virtio_net_ctrl_hdr ctrl = {
+        .class = class,
+        .cmd = cmd,
+    };
+    g_autofree uint8_t *out = g_malloc(sizeof(ctrl) + data_size);
+    virtio_net_ctrl_ack status = VIRTIO_NET_ERR;
+    ssize_t r;
+
+    memcpy(out, &ctrl, sizeof(ctrl));
+    memcpy(out + sizeof(ctrl), data, data_size);
+    r = vhost_vdpa_svq_inject(&s->vhost_vdpa, out, sizeof(ctrl) + data_size,
+                              &status, sizeof(status));
+    if (r < 0) {
+        return r;
+    }
+    return r == sizeof(status) && status == VIRTIO_NET_OK ? 0 : -EIO;
+}
+
+/*
+ * Restore the state of the virtio-net model into a device that has just
+ * been started, such as on the destination of a migration.
+ */
+static int vhost_vdpa_net_load(NetClientState *nc)
+{
+    VhostVDPAState *s = DO_UPCAST(VhostVDPAState, nc, nc);
+    VirtIODevice *vdev = s->vhost_vdpa.dev->vdev;
+    VirtIONet *n = VIRTIO_NET(vdev);
+    int r;
+
+    assert(nc->info->type == NET_CLIENT_DRIVER_VHOST_VDPA);
+
+    if (virtio_vdev_has_feature(vdev, VIRTIO_NET_F_CTRL_MAC_ADDR)) {
+        r = vhost_vdpa_net_load_cmd(s, VIRTIO_NET_CTRL_MAC,
+                                    VIRTIO_NET_CTRL_MAC_ADDR_SET,
+                                    n->mac, sizeof(n->mac));
+        if (r < 0) {
+            error_report("vhost-vdpa: cannot restore MAC address: %d", r);
+            return r;
+        }
+    }
+
+    if (virtio_vdev_has_feature(vdev, VIRTIO_NET_F_MQ) &&
+        n->curr_queues > 1) {
+        struct virtio_net_ctrl_mq mq = {
+            .virtqueue_pairs = cpu_to_le16(n->curr_queues),
+        };
+
+        r = vhost_vdpa_net_load_cmd(s, VIRTIO_NET_CTRL_MQ,
+                                    VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET,
+                                    &mq, sizeof(mq));
+        if (r < 0) {
+            error_report("vhost-vdpa: cannot restore %u queue pairs: %d",
+                         n->curr_queues, r);
+            return r;
+        }
+    }
+
+    return 0;
+}
+
+static NetClientInfo net_vhost_vdpa_cvq_info = {
+        .type = NET_CLIENT_DRIVER_VHOST_VDPA,
+        .size = sizeof(VhostVDPAState),
+        .cleanup = vhost_vdpa_cleanup,
+        .has_vnet_hdr = vhost_vdpa_has_vnet_hdr,
+        .has_ufo = vhost_vdpa_has_ufo,
+        .load = vhost_vdpa_net_load,
+};
+
+/*
+ * Restart the data virtqueues with or without shadow virtqueues, so that
+ * QEMU sees, and dirties, every page the device writes while migrating.
+ */
+static void vhost_vdpa_net_log_global_enable(VhostVDPAState *s, bool enable)
+{
+    VirtIONet *n;
+    VirtIODevice *vdev;
+    int data_queue_pairs, cvq, i, r;
+
+    if (!s->nc.peer || s->nc.peer->info->type != NET_CLIENT_DRIVER_NIC) {
+        return;
+    }
+
+    n = qemu_get_nic_opaque(s->nc.peer);
+    vdev = VIRTIO_DEVICE(n);
+    data_queue_pairs = n->multiqueue ? n->max_queues : 1;
+    cvq = virtio_vdev_has_feature(vdev, VIRTIO_NET_F_CTRL_VQ) ?
+          n->max_ncs - n->max_queues : 0;
+
+    if (n->vhost_started) {
+        vhost_net_stop(vdev, n->nic->ncs, data_queue_pairs, cvq);
+    }
+
+    for (i = 0; i < n->max_queues; i++) {
+        NetClientState *peer = qemu_get_peer(n->nic->ncs, i);
+        VhostVDPAState *qs = DO_UPCAST(VhostVDPAState, nc, peer);
+
+        qs->vhost_vdpa.shadow_vqs_enabled = enable;
+    }
+
+    if (n->vhost_started) {
+        r = vhost_net_start(vdev, n->nic->ncs, data_queue_pairs, cvq);
+        if (r < 0) {
+            error_report("unable to restart vhost-vdpa %s shadow "
+                         "virtqueues: %d", enable ? "with" : "without", -r);
+        }
+    }
+}
+
+static void vhost_vdpa_net_migration_state_notifier(Notifier *notifier,
+                                                    void *data)
+{
+    MigrationState *migration = data;
+    VhostVDPAState *s = container_of(notifier, VhostVDPAState,
+                                     migration_state);
+
+    if (migration_in_setup(migration)) {
+        vhost_vdpa_net_log_global_enable(s, true);
+    } else if (migration_has_failed(migration)) {
+        vhost_vdpa_net_log_global_enable(s, false);
+    }
+}
+
+static NetClientState *net_vhost_vdpa_init(NetClientState *peer,
+                                           const char *device,
+                                           const char *name,
+                                           int vdpa_device_fd,
+                                           int queue_pair_index,
+                                           unsigned int nvqs,
+                                           bool is_datapath)
 {
     NetClientState *nc = NULL;
     VhostVDPAState *s;
-    int vdpa_device_fd = -1;
     int ret = 0;
     assert(name);
-    nc = qemu_new_net_client(&net_vhost_vdpa_info, peer, device, name);
+    if (is_datapath) {
+        nc = qemu_new_net_client(&net_vhost_vdpa_info, peer, device, name);
+    } else {
+        nc = qemu_new_net_control_client(&net_vhost_vdpa_cvq_info, peer,
+                                         device, name);
+    }
     snprintf(nc->info_str, sizeof(nc->info_str), TYPE_VHOST_VDPA);
-    nc->queue_index = 0;
+    nc->queue_index = queue_pair_index;
     s = DO_UPCAST(VhostVDPAState, nc, nc);
-    vdpa_device_fd = qemu_open_old(vhostdev, O_RDWR);
-    if (vdpa_device_fd == -1) {
-        return -errno;
-    }
     s->vhost_vdpa.device_fd = vdpa_device_fd;
-    ret = vhost_vdpa_add(nc, (void *)&s->vhost_vdpa);
-    assert(s->vhost_net);
-    return ret;
+    if (queue_pair_index == 0) {
+        s->migration_state.notify = vhost_vdpa_net_migration_state_notifier;
+        add_migration_state_change_notifier(&s->migration_state);
+    }
+    if (!is_datapath) {
+        s->vhost_vdpa.shadow_vqs_enabled = true;
+        s->vhost_vdpa.shadow_vq_ops = &vhost_vdpa_net_cvq_ops;
+        s->vhost_vdpa.shadow_vq_ops_opaque = s;
+    }
+    ret = vhost_vdpa_add(nc, (void *)&s->vhost_vdpa, nvqs);
+    if (ret) {
+        /* This deletes the clients created for the previous queues too */
+        qemu_del_net_client(nc);
+        return NULL;
+    }
+    return nc;
+}
+
+static int vhost_vdpa_get_max_queue_pairs(int fd, uint64_t features,
+                                          bool *has_cvq, Error **errp)
+{
+    unsigned long config_size = offsetof(struct vhost_vdpa_config, buf);
+    g_autofree struct vhost_vdpa_config *config = NULL;
+    int ret;
+
+    *has_cvq = features & (1ULL << VIRTIO_NET_F_CTRL_VQ);
+    if (!(features & (1ULL << VIRTIO_NET_F_MQ))) {
+        return 1;
+    }
+
+    config = g_malloc0(config_size + sizeof(uint16_t));
+    config->off = offsetof(struct virtio_net_config, max_virtqueue_pairs);
+    config->len = sizeof(uint16_t);
+    ret = ioctl(fd, VHOST_VDPA_GET_CONFIG, config);
+    if (ret) {
+        error_setg_errno(errp, errno,
+                         "Cannot get config from vhost-vdpa device");
+        return -1;
+    }
+
+    return lduw_le_p(config->buf);
 }
 
 static int net_vhost_check_net(void *opaque, QemuOpts *opts, Error **errp)
@@ -221,6 +425,9 @@ int net_init_vhost_vdpa(const Netdev *netdev, const char *name,
                         NetClientState *peer, Error **errp)
 {
     const NetdevVhostVDPAOptions *opts;
+    uint64_t features;
+    int vdpa_device_fd, queue_pairs, i;
+    bool has_cvq;
 
     assert(netdev->type == NET_CLIENT_DRIVER_VHOST_VDPA);
     opts = &netdev->u.vhost_vdpa;
@@ -229,5 +436,50 @@ int net_init_vhost_vdpa(const Netdev *netdev, const char *name,
                           (char *)name, errp)) {
         return -1;
     }
-    return net_vhost_vdpa_init(peer, TYPE_VHOST_VDPA, name, opts->vhostdev);
+
+    vdpa_device_fd = qemu_open(opts->vhostdev, O_RDWR, errp);
+    if (vdpa_device_fd == -1) {
+        return -errno;
+    }
+
+    if (ioctl(vdpa_device_fd, VHOST_GET_FEATURES, &features)) {
+        error_setg_errno(errp, errno,
+                         "Cannot get features of vhost-vdpa device");
+        goto err;
+    }
+
+    queue_pairs = vhost_vdpa_get_max_queue_pairs(vdpa_device_fd, features,
+                                                 &has_cvq, errp);
+    if (queue_pairs < 0) {
+        goto err;
+    }
+    if (opts->has_queues && opts->queues != queue_pairs) {
+        error_setg(errp, "vhost-vdpa device has %d queue pairs, but "
+                   "queues=%" PRId64 " was requested",
+                   queue_pairs, opts->queues);
+        goto err;
+    }
+
+    /* From now on the fd is closed with the client of the first queue */
+    for (i = 0; i < queue_pairs; i++) {
+        if (!net_vhost_vdpa_init(peer, TYPE_VHOST_VDPA, name,
+                                 vdpa_device_fd, i, 2, true)) {
+            goto err_init;
+        }
+    }
+    if (has_cvq &&
+        !net_vhost_vdpa_init(peer, TYPE_VHOST_VDPA, name,
+                             vdpa_device_fd, i, 1, false)) {
+        goto err_init;
+    }
+
+    return 0;
+
+err_init:
+    error_setg(errp, "Cannot initialize vhost-vdpa queue %d", i);
+    return -1;
+
+err:
+    qemu_close(vdpa_device_fd);
+    return -1;
 }
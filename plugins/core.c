@@ -16,10 +16,13 @@
 #include "qemu/config-file.h"
 #include "qapi/error.h"
 #include "qemu/lockable.h"
+#include "qemu/memfd.h"
 #include "qemu/option.h"
 #include "qemu/rcu_queue.h"
 #include "qemu/xxhash.h"
 #include "qemu/rcu.h"
+#include "qemu/thread.h"
+#include "qemu/timer.h"
 #include "hw/core/cpu.h"
 #include "exec/cpu-common.h"
 
@@ -27,6 +30,10 @@
 #include "exec/exec-all.h"
 #include "exec/helper-proto.h"
 #include "sysemu/sysemu.h"
+#ifndef CONFIG_USER_ONLY
+#include "sysemu/cpus.h"
+#include "sysemu/runstate.h"
+#endif
 #include "tcg/tcg.h"
 #include "tcg/tcg-op.h"
 #include "trace/mem-internal.h" /* mem_info macros */
@@ -213,11 +220,278 @@ plugin_register_cb_udata(qemu_plugin_id_t id, enum qemu_plugin_event ev,
     do_plugin_register_cb(id, ev, func, udata);
 }
 
+/*
+ * Make room for @cpu in every scoreboard.  The scoreboards may move, so
+ * any vCPU that could be running generated code that updates them must
+ * be stopped first.
+ */
+static void plugin_grow_scoreboards(CPUState *cpu)
+{
+    struct qemu_plugin_scoreboard *score;
+    bool stop;
+
+    if (cpu->cpu_index < qatomic_read(&plugin.scoreboard_alloc_size)) {
+        return;
+    }
+
+#ifdef CONFIG_USER_ONLY
+    stop = current_cpu != NULL;
+    if (stop) {
+        start_exclusive();
+    }
+#else
+    stop = runstate_is_running();
+    if (stop) {
+        pause_all_vcpus();
+    }
+#endif
+
+    qemu_rec_mutex_lock(&plugin.lock);
+    while (cpu->cpu_index >= plugin.scoreboard_alloc_size) {
+        plugin.scoreboard_alloc_size *= 2;
+    }
+    QLIST_FOREACH(score, &plugin.scoreboards, entry) {
+        g_array_set_size(score->data, plugin.scoreboard_alloc_size);
+    }
+    qemu_rec_mutex_unlock(&plugin.lock);
+
+    if (stop) {
+#ifdef CONFIG_USER_ONLY
+        end_exclusive();
+#else
+        resume_all_vcpus();
+#endif
+    }
+}
+
+struct qemu_plugin_scoreboard *plugin_scoreboard_new(size_t element_size)
+{
+    struct qemu_plugin_scoreboard *score;
+
+    score = g_new0(struct qemu_plugin_scoreboard, 1);
+    score->data = g_array_new(false, true, element_size);
+
+    qemu_rec_mutex_lock(&plugin.lock);
+    g_array_set_size(score->data, plugin.scoreboard_alloc_size);
+    QLIST_INSERT_HEAD(&plugin.scoreboards, score, entry);
+    qemu_rec_mutex_unlock(&plugin.lock);
+
+    return score;
+}
+
+void plugin_scoreboard_free(struct qemu_plugin_scoreboard *score)
+{
+    qemu_rec_mutex_lock(&plugin.lock);
+    QLIST_REMOVE(score, entry);
+    qemu_rec_mutex_unlock(&plugin.lock);
+
+    g_array_free(score->data, true);
+    g_free(score);
+}
+
+/*
+ * Trace rings are allocated when their vCPU is created, so that an
+ * external consumer can be handed one descriptor per vCPU.
+ */
+#define PLUGIN_TRACE_MIN_SIZE (1 << 16)
+
+static struct qemu_plugin_trace_vcpu *
+plugin_trace_vcpu(struct qemu_plugin_trace *trace, unsigned int vcpu_index)
+{
+    GArray *arr = trace->vcpus->data;
+
+    g_assert(vcpu_index < arr->len);
+    return &g_array_index(arr, struct qemu_plugin_trace_vcpu, vcpu_index);
+}
+
+static size_t plugin_trace_ring_size(struct qemu_plugin_trace *trace)
+{
+    return sizeof(struct qemu_plugin_trace_ring) +
+        trace->size * sizeof(struct qemu_plugin_trace_record);
+}
+
+static void plugin_trace_alloc_ring__locked(struct qemu_plugin_trace *trace,
+                                            unsigned int vcpu_index)
+{
+    struct qemu_plugin_trace_vcpu *v = plugin_trace_vcpu(trace, vcpu_index);
+    struct qemu_plugin_trace_ring *ring;
+
+    if (v->ring) {
+        return;
+    }
+    if (trace->shared) {
+        g_autofree char *name = g_strdup_printf("qemu-plugin-trace-%u",
+                                                vcpu_index);
+
+        ring = qemu_memfd_alloc(name, plugin_trace_ring_size(trace), 0,
+                                &v->fd, &error_fatal);
+    } else {
+        ring = g_malloc0(plugin_trace_ring_size(trace));
+        v->fd = -1;
+    }
+    ring->size = trace->size;
+    ring->vcpu_index = vcpu_index;
+    v->ring = ring;
+}
+
+static void plugin_trace_drain_ring(struct qemu_plugin_trace *trace,
+                                    struct qemu_plugin_trace_ring *ring)
+{
+    uint64_t mask = trace->size - 1;
+    uint64_t head = qatomic_read_u64(&ring->head);
+    uint64_t tail = ring->tail;
+
+    smp_mb_acquire();
+    while (tail != head) {
+        uint64_t n = MIN(head - tail, trace->size - (tail & mask));
+
+        trace->cb(ring->vcpu_index, &ring->records[tail & mask], n,
+                  trace->userdata);
+        tail += n;
+    }
+    smp_mb_release();
+    qatomic_set_u64(&ring->tail, tail);
+}
+
+struct qemu_plugin_trace *
+plugin_trace_new(size_t size, bool shared,
+                 qemu_plugin_trace_drain_cb_t cb, void *userdata)
+{
+    struct qemu_plugin_trace *trace;
+    GHashTableIter iter;
+    gpointer key;
+
+    if (shared && !qemu_memfd_alloc_check()) {
+        return NULL;
+    }
+
+    trace = g_new0(struct qemu_plugin_trace, 1);
+    trace->size = pow2ceil(MAX(size, PLUGIN_TRACE_MIN_SIZE));
+    trace->shared = shared;
+    trace->cb = cb;
+    trace->userdata = userdata;
+    trace->vcpus = plugin_scoreboard_new(sizeof(struct qemu_plugin_trace_vcpu));
+
+    qemu_rec_mutex_lock(&plugin.lock);
+    g_hash_table_iter_init(&iter, plugin.cpu_ht);
+    while (g_hash_table_iter_next(&iter, &key, NULL)) {
+        plugin_trace_alloc_ring__locked(trace, *(int *)key);
+    }
+    QLIST_INSERT_HEAD(&plugin.traces, trace, entry);
+    qemu_rec_mutex_unlock(&plugin.lock);
+
+    return trace;
+}
+
+void plugin_trace_free(struct qemu_plugin_trace *trace)
+{
+    GArray *arr = trace->vcpus->data;
+    size_t i;
+
+    qemu_rec_mutex_lock(&plugin.lock);
+    QLIST_REMOVE(trace, entry);
+    qemu_rec_mutex_unlock(&plugin.lock);
+
+    for (i = 0; i < arr->len; i++) {
+        struct qemu_plugin_trace_vcpu *v = plugin_trace_vcpu(trace, i);
+
+        if (!v->ring) {
+            continue;
+        }
+        if (trace->cb) {
+            plugin_trace_drain_ring(trace, v->ring);
+        }
+        if (trace->shared) {
+            qemu_memfd_free(v->ring, plugin_trace_ring_size(trace), v->fd);
+        } else {
+            g_free(v->ring);
+        }
+    }
+    plugin_scoreboard_free(trace->vcpus);
+    g_free(trace);
+}
+
+struct qemu_plugin_trace_ring *
+plugin_trace_find(struct qemu_plugin_trace *trace, unsigned int vcpu_index)
+{
+    if (vcpu_index >= trace->vcpus->data->len) {
+        return NULL;
+    }
+    return plugin_trace_vcpu(trace, vcpu_index)->ring;
+}
+
+int plugin_trace_fd(struct qemu_plugin_trace *trace, unsigned int vcpu_index)
+{
+    if (!plugin_trace_find(trace, vcpu_index)) {
+        return -1;
+    }
+    return plugin_trace_vcpu(trace, vcpu_index)->fd;
+}
+
+void plugin_trace_drain(struct qemu_plugin_trace *trace,
+                        unsigned int vcpu_index)
+{
+    struct qemu_plugin_trace_ring *ring = plugin_trace_find(trace, vcpu_index);
+
+    g_assert(trace->cb);
+    if (ring) {
+        plugin_trace_drain_ring(trace, ring);
+    }
+}
+
+void qemu_plugin_trace_make_room(struct qemu_plugin_trace *trace,
+                                 unsigned int vcpu_index, uint64_t n)
+{
+    struct qemu_plugin_trace_ring *ring = plugin_trace_find(trace, vcpu_index);
+
+    g_assert(n <= trace->size);
+    if (trace->cb) {
+        if (ring->head - ring->tail + n > trace->size) {
+            plugin_trace_drain_ring(trace, ring);
+        }
+        return;
+    }
+    /* the vCPU is the only writer of @head */
+    while (ring->head - qatomic_read_u64(&ring->tail) + n > trace->size) {
+        g_usleep(10);
+    }
+    smp_mb_acquire();
+}
+
+/*
+ * Records of accesses done by helpers.  The generated code of a TB only
+ * reserves room for its own records, so keep the ring at most half full
+ * here; a TB never appends more than half a ring, see plugin_gen_tb_trace().
+ */
+static void plugin_trace_write(struct qemu_plugin_trace *trace,
+                               unsigned int vcpu_index, uint64_t pc,
+                               uint64_t vaddr, uint32_t info, uint32_t flags)
+{
+    struct qemu_plugin_trace_ring *ring;
+    struct qemu_plugin_trace_record *rec;
+
+    qemu_plugin_trace_make_room(trace, vcpu_index, trace->size / 2 + 1);
+    ring = plugin_trace_find(trace, vcpu_index);
+    rec = &ring->records[ring->head & (trace->size - 1)];
+    rec->pc = pc;
+    rec->vaddr = vaddr;
+    rec->info = info;
+    rec->flags = flags;
+    smp_wmb();
+    qatomic_set_u64(&ring->head, ring->head + 1);
+}
+
 void qemu_plugin_vcpu_init_hook(CPUState *cpu)
 {
+    struct qemu_plugin_trace *trace;
     bool success;
 
+    plugin_grow_scoreboards(cpu);
+
     qemu_rec_mutex_lock(&plugin.lock);
+    QLIST_FOREACH(trace, &plugin.traces, entry) {
+        plugin_trace_alloc_ring__locked(trace, cpu->cpu_index);
+    }
     plugin_cpu_update__locked(&cpu->cpu_index, NULL, NULL);
     success = g_hash_table_insert(plugin.cpu_ht, &cpu->cpu_index,
                                   &cpu->cpu_index);
@@ -297,6 +571,35 @@ void plugin_register_inline_op(GArray **arr,
     dyn_cb->inline_insn.imm = imm;
 }
 
+void plugin_register_vcpu_trace(GArray **arr, enum qemu_plugin_mem_rw rw,
+                                struct qemu_plugin_trace *trace, uint64_t pc)
+{
+    struct qemu_plugin_dyn_cb *dyn_cb;
+
+    dyn_cb = plugin_get_dyn_cb(arr);
+    dyn_cb->userp = trace;
+    dyn_cb->type = PLUGIN_CB_TRACE;
+    dyn_cb->rw = rw;
+    dyn_cb->trace.pc = pc;
+}
+
+void plugin_register_inline_op_on_entry(GArray **arr,
+                                        enum qemu_plugin_mem_rw rw,
+                                        enum qemu_plugin_op op,
+                                        qemu_plugin_u64 entry,
+                                        uint64_t imm)
+{
+    struct qemu_plugin_dyn_cb *dyn_cb;
+
+    dyn_cb = plugin_get_dyn_cb(arr);
+    dyn_cb->userp = NULL;
+    dyn_cb->type = PLUGIN_CB_INLINE;
+    dyn_cb->rw = rw;
+    dyn_cb->inline_insn.op = op;
+    dyn_cb->inline_insn.imm = imm;
+    dyn_cb->inline_insn.entry = entry;
+}
+
 static inline uint32_t cb_to_tcg_flags(enum qemu_plugin_cb_flags flags)
 {
     uint32_t ret;
@@ -326,6 +629,31 @@ plugin_register_dyn_cb__udata(GArray **arr,
     dyn_cb->tcg_flags = cb_to_tcg_flags(flags);
     dyn_cb->f.vcpu_udata = cb;
     dyn_cb->type = PLUGIN_CB_REGULAR;
+    dyn_cb->cond.cond = QEMU_PLUGIN_COND_ALWAYS;
+}
+
+void
+plugin_register_dyn_cond_cb__udata(GArray **arr,
+                                   qemu_plugin_vcpu_udata_cb_t cb,
+                                   enum qemu_plugin_cb_flags flags,
+                                   enum qemu_plugin_cond cond,
+                                   qemu_plugin_u64 entry,
+                                   uint64_t imm,
+                                   void *udata)
+{
+    struct qemu_plugin_dyn_cb *dyn_cb;
+
+    if (cond == QEMU_PLUGIN_COND_NEVER) {
+        return;
+    }
+    dyn_cb = plugin_get_dyn_cb(arr);
+    dyn_cb->userp = udata;
+    dyn_cb->tcg_flags = cb_to_tcg_flags(flags);
+    dyn_cb->f.vcpu_udata = cb;
+    dyn_cb->type = PLUGIN_CB_REGULAR;
+    dyn_cb->cond.cond = cond;
+    dyn_cb->cond.entry = entry;
+    dyn_cb->cond.imm = imm;
 }
 
 void plugin_register_vcpu_mem_cb(GArray **arr,
@@ -411,6 +739,76 @@ void qemu_plugin_vcpu_syscall_ret(CPUState *cpu, int64_t num, int64_t ret)
     }
 }
 
+/*
+ * Disable CFI checks.
+ * The callback function has been loaded from an external library so we do not
+ * have type information
+ */
+QEMU_DISABLE_CFI
+static void plugin_vcpu_sample__async(CPUState *cpu, run_on_cpu_data data)
+{
+    struct qemu_plugin_cb *cb, *next;
+    enum qemu_plugin_event ev = QEMU_PLUGIN_EV_VCPU_SAMPLE;
+    target_ulong pc, cs_base;
+    uint32_t flags;
+
+    /* we run between TBs, so the guest state is up to date */
+    cpu_get_tb_cpu_state(cpu->env_ptr, &pc, &cs_base, &flags);
+
+    QLIST_FOREACH_SAFE_RCU(cb, &plugin.cb_lists[ev], entry, next) {
+        qemu_plugin_vcpu_sample_cb_t func = cb->f.vcpu_sample;
+
+        func(cb->ctx->id, cpu->cpu_index, pc);
+    }
+}
+
+/*
+ * Queue a sample on every vCPU that is running guest code. The work item
+ * kicks the vCPU out of the execution loop, which is the only cost the
+ * guest pays; no code is generated for sampling.
+ */
+static void *plugin_sample_thread(void *arg)
+{
+    enum qemu_plugin_event ev = QEMU_PLUGIN_EV_VCPU_SAMPLE;
+    CPUState *cpu;
+
+    rcu_register_thread();
+    for (;;) {
+        g_usleep(MAX(qatomic_read(&plugin.sample_period_ns) / SCALE_US, 1));
+
+        if (!test_bit(ev, plugin.mask)) {
+            continue;
+        }
+        WITH_RCU_READ_LOCK_GUARD() {
+            CPU_FOREACH(cpu) {
+                if (!qatomic_read(&cpu->halted) &&
+                    test_bit(ev, cpu->plugin_mask)) {
+                    async_run_on_cpu(cpu, plugin_vcpu_sample__async,
+                                     RUN_ON_CPU_NULL);
+                }
+            }
+        }
+    }
+    return NULL;
+}
+
+void plugin_register_vcpu_sample_cb(qemu_plugin_id_t id, uint64_t period_ns,
+                                    qemu_plugin_vcpu_sample_cb_t cb)
+{
+    period_ns = MAX(period_ns, SCALE_US);
+
+    plugin_register_cb(id, QEMU_PLUGIN_EV_VCPU_SAMPLE, cb);
+
+    QEMU_LOCK_GUARD(&plugin.lock);
+    if (plugin.sample_period_ns == 0) {
+        plugin.sample_period_ns = period_ns;
+        qemu_thread_create(&plugin.sample_thread, "plugin-sample",
+                           plugin_sample_thread, NULL, QEMU_THREAD_DETACHED);
+    } else if (period_ns < plugin.sample_period_ns) {
+        qatomic_set(&plugin.sample_period_ns, period_ns);
+    }
+}
+
 void qemu_plugin_vcpu_idle_cb(CPUState *cpu)
 {
     plugin_vcpu_cb__simple(cpu, QEMU_PLUGIN_EV_VCPU_IDLE);
@@ -453,14 +851,25 @@ void qemu_plugin_flush_cb(void)
     plugin_cb__simple(QEMU_PLUGIN_EV_FLUSH);
 }
 
-void exec_inline_op(struct qemu_plugin_dyn_cb *cb)
+void exec_inline_op(struct qemu_plugin_dyn_cb *cb, int cpu_index)
 {
     uint64_t *val = cb->userp;
 
+    if (!val) {
+        qemu_plugin_u64 entry = cb->inline_insn.entry;
+        GArray *arr = entry.score->data;
+
+        val = (uint64_t *)(arr->data + entry.offset +
+                           cpu_index * g_array_get_element_size(arr));
+    }
+
     switch (cb->inline_insn.op) {
     case QEMU_PLUGIN_INLINE_ADD_U64:
         *val += cb->inline_insn.imm;
         break;
+    case QEMU_PLUGIN_INLINE_STORE_U64:
+        *val = cb->inline_insn.imm;
+        break;
     default:
         g_assert_not_reached();
     }
@@ -487,7 +896,11 @@ void qemu_plugin_vcpu_mem_cb(CPUState *cpu, uint64_t vaddr, uint32_t info)
             cb->f.vcpu_mem(cpu->cpu_index, info, vaddr, cb->userp);
             break;
         case PLUGIN_CB_INLINE:
-            exec_inline_op(cb);
+            exec_inline_op(cb, cpu->cpu_index);
+            break;
+        case PLUGIN_CB_TRACE:
+            plugin_trace_write(cb->userp, cpu->cpu_index, cb->trace.pc,
+                               vaddr, info, QEMU_PLUGIN_TRACE_MEM);
             break;
         default:
             g_assert_not_reached();
@@ -533,6 +946,9 @@ static void __attribute__((__constructor__)) plugin_init(void)
     plugin.id_ht = g_hash_table_new(g_int64_hash, g_int64_equal);
     plugin.cpu_ht = g_hash_table_new(g_int_hash, g_int_equal);
     QTAILQ_INIT(&plugin.ctxs);
+    QLIST_INIT(&plugin.scoreboards);
+    plugin.scoreboard_alloc_size = 1;
+    QLIST_INIT(&plugin.traces);
     qht_init(&plugin.dyn_cb_arr_ht, plugin_dyn_cb_arr_cmp, 16,
              QHT_MODE_AUTO_RESIZE);
     atexit(qemu_plugin_atexit_cb);
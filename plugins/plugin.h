@@ -43,6 +43,14 @@ struct qemu_plugin_state {
      * the code cache is flushed.
      */
     struct qht dyn_cb_arr_ht;
+    /* scoreboards hold at least @scoreboard_alloc_size elements */
+    QLIST_HEAD(, qemu_plugin_scoreboard) scoreboards;
+    size_t scoreboard_alloc_size;
+    /* each trace has a ring for every vCPU in @cpu_ht */
+    QLIST_HEAD(, qemu_plugin_trace) traces;
+    /* shortest period requested by a sampling plugin; 0 if none */
+    uint64_t sample_period_ns;
+    QemuThread sample_thread;
 };
 
 
@@ -68,6 +76,15 @@ void plugin_register_inline_op(GArray **arr,
                                enum qemu_plugin_op op, void *ptr,
                                uint64_t imm);
 
+void plugin_register_inline_op_on_entry(GArray **arr,
+                                        enum qemu_plugin_mem_rw rw,
+                                        enum qemu_plugin_op op,
+                                        qemu_plugin_u64 entry,
+                                        uint64_t imm);
+
+void plugin_register_vcpu_sample_cb(qemu_plugin_id_t id, uint64_t period_ns,
+                                    qemu_plugin_vcpu_sample_cb_t cb);
+
 void plugin_reset_uninstall(qemu_plugin_id_t id,
                             qemu_plugin_simple_cb_t cb,
                             bool reset);
@@ -87,6 +104,15 @@ plugin_register_dyn_cb__udata(GArray **arr,
                               qemu_plugin_vcpu_udata_cb_t cb,
                               enum qemu_plugin_cb_flags flags, void *udata);
 
+void
+plugin_register_dyn_cond_cb__udata(GArray **arr,
+                                   qemu_plugin_vcpu_udata_cb_t cb,
+                                   enum qemu_plugin_cb_flags flags,
+                                   enum qemu_plugin_cond cond,
+                                   qemu_plugin_u64 entry,
+                                   uint64_t imm,
+                                   void *udata);
+
 
 void plugin_register_vcpu_mem_cb(GArray **arr,
                                  void *cb,
@@ -94,6 +120,27 @@ void plugin_register_vcpu_mem_cb(GArray **arr,
                                  enum qemu_plugin_mem_rw rw,
                                  void *udata);
 
-void exec_inline_op(struct qemu_plugin_dyn_cb *cb);
+void exec_inline_op(struct qemu_plugin_dyn_cb *cb, int cpu_index);
+
+struct qemu_plugin_scoreboard *plugin_scoreboard_new(size_t element_size);
+
+void plugin_scoreboard_free(struct qemu_plugin_scoreboard *score);
+
+void plugin_register_vcpu_trace(GArray **arr, enum qemu_plugin_mem_rw rw,
+                                struct qemu_plugin_trace *trace, uint64_t pc);
+
+struct qemu_plugin_trace *
+plugin_trace_new(size_t size, bool shared,
+                 qemu_plugin_trace_drain_cb_t cb, void *userdata);
+
+void plugin_trace_free(struct qemu_plugin_trace *trace);
+
+struct qemu_plugin_trace_ring *
+plugin_trace_find(struct qemu_plugin_trace *trace, unsigned int vcpu_index);
+
+int plugin_trace_fd(struct qemu_plugin_trace *trace, unsigned int vcpu_index);
+
+void plugin_trace_drain(struct qemu_plugin_trace *trace,
+                        unsigned int vcpu_index);
 
 #endif /* _PLUGIN_INTERNAL_H_ */
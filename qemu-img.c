@@ -41,12 +41,15 @@
 #include "qemu/main-loop.h"
 #include "qemu/module.h"
 #include "qemu/sockets.h"
+#include "qemu/thread.h"
 #include "qemu/units.h"
 #include "qom/object_interfaces.h"
 #include "sysemu/block-backend.h"
+#include "block/accounting.h"
 #include "block/block_int.h"
 #include "block/blockjob.h"
 #include "block/qapi.h"
+#include "crypto/hash.h"
 #include "crypto/init.h"
 #include "trace/control.h"
 #include "qemu/throttle.h"
@@ -82,6 +85,10 @@ enum {
     OPTION_MERGE = 274,
     OPTION_BITMAPS = 275,
     OPTION_FORCE = 276,
+    OPTION_RWMIX = 277,
+    OPTION_RANDOM = 278,
+    OPTION_TIME = 279,
+    OPTION_JOBS = 280,
 };
 
 typedef enum OutputFormat {
@@ -1187,6 +1194,35 @@ static int is_allocated_sectors(const uint8_t *buf, int n, int *pnum,
     return !is_zero;
 }
 
+/*
+ * Like is_allocated_sectors, but for compressed images, where only whole
+ * clusters of 'cluster_sectors' can be written.  'buf' must start at a
+ * cluster boundary; only the last cluster may be shorter.
+ */
+static int is_allocated_clusters(const uint8_t *buf, int n, int *pnum,
+                                 int cluster_sectors)
+{
+    bool is_zero;
+    int i;
+
+    if (n <= 0) {
+        *pnum = 0;
+        return 0;
+    }
+    is_zero = buffer_is_zero(buf, MIN(n, cluster_sectors) * BDRV_SECTOR_SIZE);
+    for (i = cluster_sectors; i < n; i += cluster_sectors) {
+        int len = MIN(n - i, cluster_sectors);
+
+        if (is_zero != buffer_is_zero(buf + i * BDRV_SECTOR_SIZE,
+                                      len * BDRV_SECTOR_SIZE)) {
+            break;
+        }
+    }
+
+    *pnum = MIN(i, n);
+    return !is_zero;
+}
+
 /*
  * Like is_allocated_sectors, but if the buffer starts with a used sector,
  * up to 'min' consecutive sectors containing zeros are ignored. This avoids
@@ -1262,42 +1298,198 @@ static int compare_buffers(const uint8_t *buf1, const uint8_t *buf2,
 
 #define IO_BUF_SIZE (2 * MiB)
 
+#define MAX_COROUTINES 64
+
+enum ImgCompareAction {
+    COMPARE_SKIP,
+    COMPARE_DATA,       /* compare the data of both images */
+    COMPARE_ZERO,       /* check that one image reads as zeros */
+};
+
+typedef struct ImgCompareState {
+    BlockBackend *blk[2];
+    const char *filename[2];
+    int64_t size[2];
+    int64_t common_size;        /* of the part common to both images */
+    int64_t progress_base;
+    int64_t offset;             /* start of the next chunk to compare */
+    bool strict;
+    long num_coroutines;
+    int running_coroutines;
+    CoMutex lock;
+
+    /*
+     * The difference or error found at the lowest offset.  Chunks are
+     * handed out in order, so this is the first one once all coroutines
+     * are done, as if the images had been compared sequentially.
+     */
+    int64_t fail_offset;
+    int fail_ret;
+    bool fail_is_error;
+    char *fail_msg;
+} ImgCompareState;
+
+static void GCC_FMT_ATTR(5, 6)
+compare_fail(ImgCompareState *s, int64_t offset, int ret, bool is_error,
+             const char *fmt, ...)
+{
+    va_list ap;
+
+    if (offset >= s->fail_offset) {
+        return;
+    }
+
+    g_free(s->fail_msg);
+    va_start(ap, fmt);
+    s->fail_msg = g_strdup_vprintf(fmt, ap);
+    va_end(ap);
+    s->fail_offset = offset;
+    s->fail_ret = ret;
+    s->fail_is_error = is_error;
+}
+
 /*
- * Check if passed sectors are empty (not allocated or contain only 0 bytes)
- *
- * Intended for use by 'qemu-img compare': Returns 0 in case sectors are
- * filled with 0, 1 if sectors contain non-zero data (this is a comparison
- * failure), and 4 on error (the exit status for read errors), after emitting
- * an error message.
- *
- * @param blk:  BlockBackend for the image
- * @param offset: Starting offset to check
- * @param bytes: Number of bytes to check
- * @param filename: Name of disk file we are checking (logging purpose)
- * @param buffer: Allocated buffer for storing read data
- * @param quiet: Flag for quiet mode
+ * Pick the next chunk to compare from the block status of the images.
+ * Returns an ImgCompareAction, or -1 when there is nothing left to do.
+ * For COMPARE_ZERO, @idx is the image that must read as zeros.
  */
-static int check_empty_sectors(BlockBackend *blk, int64_t offset,
-                               int64_t bytes, const char *filename,
-                               uint8_t *buffer, bool quiet)
+static int coroutine_fn compare_next_chunk(ImgCompareState *s,
+                                           int64_t *offset, int64_t *bytes,
+                                           int *idx)
 {
-    int ret = 0;
-    int64_t idx;
+    int64_t pnum[2];
+    int status[2];
+    bool allocated[2];
+    int i;
+
+    *offset = s->offset;
+    if (*offset >= s->fail_offset || *offset >= s->progress_base) {
+        return -1;
+    }
+
+    if (*offset >= s->common_size) {
+        /* the part of the larger image beyond the end of the other one */
+        i = s->size[0] > s->size[1] ? 0 : 1;
+        status[i] = bdrv_block_status_above(blk_bs(s->blk[i]), NULL, *offset,
+                                            s->progress_base - *offset,
+                                            bytes, NULL, NULL);
+        if (status[i] < 0) {
+            compare_fail(s, *offset, 3, true,
+                         "Sector allocation test failed for %s",
+                         s->filename[i]);
+            return -1;
+        }
+        if (status[i] & BDRV_BLOCK_ALLOCATED &&
+            !(status[i] & BDRV_BLOCK_ZERO)) {
+            *bytes = MIN(*bytes, IO_BUF_SIZE);
+            *idx = i;
+            s->offset += *bytes;
+            return COMPARE_ZERO;
+        }
+        s->offset += *bytes;
+        return COMPARE_SKIP;
+    }
+
+    for (i = 0; i < 2; i++) {
+        status[i] = bdrv_block_status_above(blk_bs(s->blk[i]), NULL, *offset,
+                                            s->size[i] - *offset,
+                                            &pnum[i], NULL, NULL);
+        if (status[i] < 0) {
+            compare_fail(s, *offset, 3, true,
+                         "Sector allocation test failed for %s",
+                         s->filename[i]);
+            return -1;
+        }
+        allocated[i] = status[i] & BDRV_BLOCK_ALLOCATED;
+    }
+
+    assert(pnum[0] && pnum[1]);
+    *bytes = MIN(MIN(pnum[0], pnum[1]), s->common_size - *offset);
+
+    if (s->strict && status[0] != status[1]) {
+        compare_fail(s, *offset, 1, false, "Strict mode: Offset %" PRId64
+                     " block status mismatch!", *offset);
+        return -1;
+    }
+
+    if ((status[0] & BDRV_BLOCK_ZERO) && (status[1] & BDRV_BLOCK_ZERO)) {
+        s->offset += *bytes;
+        return COMPARE_SKIP;
+    } else if (allocated[0] == allocated[1] && !allocated[0]) {
+        s->offset += *bytes;
+        return COMPARE_SKIP;
+    }
+
+    *bytes = MIN(*bytes, IO_BUF_SIZE);
+    s->offset += *bytes;
+    if (allocated[0] == allocated[1]) {
+        return COMPARE_DATA;
+    }
+    *idx = allocated[0] ? 0 : 1;
+    return COMPARE_ZERO;
+}
+
+static int coroutine_fn compare_co_read(ImgCompareState *s, int idx,
+                                        int64_t offset, int64_t bytes,
+                                        uint8_t *buf)
+{
+    int ret = blk_co_pread(s->blk[idx], offset, bytes, buf, 0);
 
-    ret = blk_pread(blk, offset, buffer, bytes);
     if (ret < 0) {
-        error_report("Error while reading offset %" PRId64 " of %s: %s",
-                     offset, filename, strerror(-ret));
-        return 4;
-    }
-    idx = find_nonzero(buffer, bytes);
-    if (idx >= 0) {
-        qprintf(quiet, "Content mismatch at offset %" PRId64 "!\n",
-                offset + idx);
-        return 1;
+        compare_fail(s, offset, 4, true,
+                     "Error while reading offset %" PRId64 " of %s: %s",
+                     offset, s->filename[idx], strerror(-ret));
     }
+    return ret;
+}
 
-    return 0;
+static void coroutine_fn compare_co_do(void *opaque)
+{
+    ImgCompareState *s = opaque;
+    uint8_t *buf1, *buf2;
+
+    s->running_coroutines++;
+    buf1 = blk_blockalign(s->blk[0], IO_BUF_SIZE);
+    buf2 = blk_blockalign(s->blk[1], IO_BUF_SIZE);
+
+    while (1) {
+        int64_t offset, bytes, pnum;
+        int action, idx, ret;
+
+        qemu_co_mutex_lock(&s->lock);
+        action = compare_next_chunk(s, &offset, &bytes, &idx);
+        qemu_co_mutex_unlock(&s->lock);
+        if (action < 0) {
+            break;
+        }
+
+        if (action == COMPARE_DATA) {
+            if (compare_co_read(s, 0, offset, bytes, buf1) == 0 &&
+                compare_co_read(s, 1, offset, bytes, buf2) == 0) {
+                ret = compare_buffers(buf1, buf2, bytes, &pnum);
+                if (ret || pnum != bytes) {
+                    offset += ret ? 0 : pnum;
+                    compare_fail(s, offset, 1, false,
+                                 "Content mismatch at offset %" PRId64 "!",
+                                 offset);
+                }
+            }
+        } else if (action == COMPARE_ZERO) {
+            if (compare_co_read(s, idx, offset, bytes, buf1) == 0) {
+                pnum = find_nonzero(buf1, bytes);
+                if (pnum >= 0) {
+                    compare_fail(s, offset + pnum, 1, false,
+                                 "Content mismatch at offset %" PRId64 "!",
+                                 offset + pnum);
+                }
+            }
+        }
+        qemu_progress_print(((float) bytes / s->progress_base) * 100, 100);
+    }
+
+    qemu_vfree(buf1);
+    qemu_vfree(buf2);
+    s->running_coroutines--;
 }
 
 /*
@@ -1311,22 +1503,16 @@ static int img_compare(int argc, char **argv)
 {
     const char *fmt1 = NULL, *fmt2 = NULL, *cache, *filename1, *filename2;
     BlockBackend *blk1, *blk2;
-    BlockDriverState *bs1, *bs2;
     int64_t total_size1, total_size2;
-    uint8_t *buf1 = NULL, *buf2 = NULL;
-    int64_t pnum1, pnum2;
-    int allocated1, allocated2;
     int ret = 0; /* return value - 0 Ident, 1 Different, >1 Error */
     bool progress = false, quiet = false, strict = false;
     int flags;
     bool writethrough;
-    int64_t total_size;
-    int64_t offset = 0;
-    int64_t chunk;
-    int c;
-    uint64_t progress_base;
+    int c, i;
     bool image_opts = false;
     bool force_share = false;
+    long num_coroutines = 8;
+    ImgCompareState s;
 
     cache = BDRV_DEFAULT_CACHE;
     for (;;) {
@@ -1337,7 +1523,7 @@ static int img_compare(int argc, char **argv)
             {"force-share", no_argument, 0, 'U'},
             {0, 0, 0, 0}
         };
-        c = getopt_long(argc, argv, ":hf:F:T:pqsU",
+        c = getopt_long(argc, argv, ":hf:F:T:m:pqsU",
                         long_options, NULL);
         if (c == -1) {
             break;
@@ -1361,6 +1547,14 @@ static int img_compare(int argc, char **argv)
         case 'T':
             cache = optarg;
             break;
+        case 'm':
+            if (qemu_strtol(optarg, NULL, 0, &num_coroutines) ||
+                num_coroutines < 1 || num_coroutines > MAX_COROUTINES) {
+                error_report("Invalid number of coroutines. Allowed number of"
+                             " coroutines is between 1 and %d", MAX_COROUTINES);
+                exit(2);
+            }
+            break;
         case 'p':
             progress = true;
             break;
@@ -1430,11 +1624,7 @@ static int img_compare(int argc, char **argv)
         ret = 2;
         goto out2;
     }
-    bs1 = blk_bs(blk1);
-    bs2 = blk_bs(blk2);
 
-    buf1 = blk_blockalign(blk1, IO_BUF_SIZE);
-    buf2 = blk_blockalign(blk2, IO_BUF_SIZE);
     total_size1 = blk_getlength(blk1);
     if (total_size1 < 0) {
         error_report("Can't get size of %s: %s",
@@ -1449,8 +1639,6 @@ static int img_compare(int argc, char **argv)
         ret = 4;
         goto out;
     }
-    total_size = MIN(total_size1, total_size2);
-    progress_base = MAX(total_size1, total_size2);
 
     qemu_progress_print(0, 100);
 
@@ -1460,136 +1648,308 @@ static int img_compare(int argc, char **argv)
         goto out;
     }
 
-    while (offset < total_size) {
-        int status1, status2;
+    s = (ImgCompareState) {
+        .blk            = { blk1, blk2 },
+        .filename       = { filename1, filename2 },
+        .size           = { total_size1, total_size2 },
+        .common_size    = MIN(total_size1, total_size2),
+        .progress_base  = MAX(total_size1, total_size2),
+        .strict         = strict,
+        .num_coroutines = num_coroutines,
+        .fail_offset    = INT64_MAX,
+    };
+    qemu_co_mutex_init(&s.lock);
 
-        status1 = bdrv_block_status_above(bs1, NULL, offset,
-                                          total_size1 - offset, &pnum1, NULL,
-                                          NULL);
-        if (status1 < 0) {
-            ret = 3;
-            error_report("Sector allocation test failed for %s", filename1);
-            goto out;
-        }
-        allocated1 = status1 & BDRV_BLOCK_ALLOCATED;
+    for (i = 0; i < s.num_coroutines; i++) {
+        qemu_coroutine_enter(qemu_coroutine_create(compare_co_do, &s));
+    }
+    while (s.running_coroutines) {
+        main_loop_wait(false);
+    }
 
-        status2 = bdrv_block_status_above(bs2, NULL, offset,
-                                          total_size2 - offset, &pnum2, NULL,
-                                          NULL);
-        if (status2 < 0) {
-            ret = 3;
-            error_report("Sector allocation test failed for %s", filename2);
-            goto out;
-        }
-        allocated2 = status2 & BDRV_BLOCK_ALLOCATED;
+    if (total_size1 != total_size2 && s.fail_offset >= s.common_size) {
+        qprintf(quiet, "Warning: Image size mismatch!\n");
+    }
 
-        assert(pnum1 && pnum2);
-        chunk = MIN(pnum1, pnum2);
+    if (!s.fail_msg) {
+        qprintf(quiet, "Images are identical.\n");
+        ret = 0;
+    } else if (s.fail_is_error) {
+        error_report("%s", s.fail_msg);
+        ret = s.fail_ret;
+    } else {
+        qprintf(quiet, "%s\n", s.fail_msg);
+        ret = s.fail_ret;
+    }
+    g_free(s.fail_msg);
 
-        if (strict) {
-            if (status1 != status2) {
-                ret = 1;
-                qprintf(quiet, "Strict mode: Offset %" PRId64
-                        " block status mismatch!\n", offset);
-                goto out;
-            }
-        }
-        if ((status1 & BDRV_BLOCK_ZERO) && (status2 & BDRV_BLOCK_ZERO)) {
-            /* nothing to do */
-        } else if (allocated1 == allocated2) {
-            if (allocated1) {
-                int64_t pnum;
+out:
+    blk_unref(blk2);
+out2:
+    blk_unref(blk1);
+out3:
+    qemu_progress_end();
+    return ret;
+}
 
-                chunk = MIN(chunk, IO_BUF_SIZE);
-                ret = blk_pread(blk1, offset, buf1, chunk);
-                if (ret < 0) {
-                    error_report("Error while reading offset %" PRId64
-                                 " of %s: %s",
-                                 offset, filename1, strerror(-ret));
-                    ret = 4;
-                    goto out;
-                }
-                ret = blk_pread(blk2, offset, buf2, chunk);
-                if (ret < 0) {
-                    error_report("Error while reading offset %" PRId64
-                                 " of %s: %s",
-                                 offset, filename2, strerror(-ret));
-                    ret = 4;
-                    goto out;
-                }
-                ret = compare_buffers(buf1, buf2, chunk, &pnum);
-                if (ret || pnum != chunk) {
-                    qprintf(quiet, "Content mismatch at offset %" PRId64 "!\n",
-                            offset + (ret ? 0 : pnum));
-                    ret = 1;
-                    goto out;
-                }
-            }
-        } else {
-            chunk = MIN(chunk, IO_BUF_SIZE);
-            if (allocated1) {
-                ret = check_empty_sectors(blk1, offset, chunk,
-                                          filename1, buf1, quiet);
-            } else {
-                ret = check_empty_sectors(blk2, offset, chunk,
-                                          filename2, buf1, quiet);
-            }
-            if (ret) {
-                goto out;
-            }
+/*
+ * The checksum of an image is the SHA-256 of the SHA-256 digests of its
+ * 4 MiB blocks, followed by the image size as a 64-bit big-endian value.
+ * It only depends on the guest-visible content, so images in different
+ * formats or with different allocation have the same checksum if they
+ * have the same content.  The blocks can be hashed in parallel, and zero
+ * blocks are not read at all.
+ */
+#define CHECKSUM_BLOCK_SIZE (4 * MiB)
+#define CHECKSUM_HASH_ALG   QCRYPTO_HASH_ALG_SHA256
+
+typedef struct ImgChecksumState {
+    BlockBackend *blk;
+    int64_t total_size;
+    int64_t nb_blocks;
+    int64_t next_block;
+    size_t digest_len;
+    uint8_t *digests;           /* of all blocks */
+    uint8_t *zero_digest;       /* of a block of zeros */
+    int running_coroutines;
+    int ret;
+} ImgChecksumState;
+
+static int checksum_hash(const uint8_t *buf, size_t len, uint8_t *digest)
+{
+    g_autofree uint8_t *result = NULL;
+    size_t result_len;
+    Error *local_err = NULL;
+
+    if (qcrypto_hash_bytes(CHECKSUM_HASH_ALG, (const char *)buf, len,
+                           &result, &result_len, &local_err) < 0) {
+        error_report_err(local_err);
+        return -EINVAL;
+    }
+    memcpy(digest, result, result_len);
+    return 0;
+}
+
+static int coroutine_fn checksum_co_block(ImgChecksumState *s, int64_t block,
+                                          uint8_t *buf)
+{
+    int64_t offset = block * CHECKSUM_BLOCK_SIZE;
+    int64_t bytes = MIN(CHECKSUM_BLOCK_SIZE, s->total_size - offset);
+    uint8_t *digest = s->digests + block * s->digest_len;
+    bool is_zero = true;
+    int64_t pos, pnum;
+    int ret;
+
+    for (pos = 0; pos < bytes; pos += pnum) {
+        ret = bdrv_block_status_above(blk_bs(s->blk), NULL, offset + pos,
+                                      bytes - pos, &pnum, NULL, NULL);
+        if (ret < 0) {
+            error_report("error while reading block status at offset %"
+                         PRId64 ": %s", offset + pos, strerror(-ret));
+            return ret;
         }
-        offset += chunk;
-        qemu_progress_print(((float) chunk / progress_base) * 100, 100);
+        if ((ret & BDRV_BLOCK_ZERO) || !(ret & BDRV_BLOCK_ALLOCATED)) {
+            memset(buf + pos, 0, pnum);
+            continue;
+        }
+        ret = blk_co_pread(s->blk, offset + pos, pnum, buf + pos, 0);
+        if (ret < 0) {
+            error_report("error while reading at byte %" PRId64 ": %s",
+                         offset + pos, strerror(-ret));
+            return ret;
+        }
+        is_zero = false;
     }
 
-    if (total_size1 != total_size2) {
-        BlockBackend *blk_over;
-        const char *filename_over;
+    if (is_zero && bytes == CHECKSUM_BLOCK_SIZE) {
+        memcpy(digest, s->zero_digest, s->digest_len);
+        return 0;
+    }
+    return checksum_hash(buf, bytes, digest);
+}
 
-        qprintf(quiet, "Warning: Image size mismatch!\n");
-        if (total_size1 > total_size2) {
-            blk_over = blk1;
-            filename_over = filename1;
-        } else {
-            blk_over = blk2;
-            filename_over = filename2;
+static void coroutine_fn checksum_co_do(void *opaque)
+{
+    ImgChecksumState *s = opaque;
+    uint8_t *buf;
+
+    s->running_coroutines++;
+    buf = blk_blockalign(s->blk, CHECKSUM_BLOCK_SIZE);
+
+    while (!s->ret && s->next_block < s->nb_blocks) {
+        int64_t block = s->next_block++;
+        int ret = checksum_co_block(s, block, buf);
+
+        if (ret < 0) {
+            s->ret = ret;
+            break;
         }
+        qemu_progress_print(100.0 / s->nb_blocks, 100);
+    }
 
-        while (offset < progress_base) {
-            ret = bdrv_block_status_above(blk_bs(blk_over), NULL, offset,
-                                          progress_base - offset, &chunk,
-                                          NULL, NULL);
-            if (ret < 0) {
-                ret = 3;
-                error_report("Sector allocation test failed for %s",
-                             filename_over);
-                goto out;
+    qemu_vfree(buf);
+    s->running_coroutines--;
+}
 
+static int img_checksum(int argc, char **argv)
+{
+    const char *fmt = NULL, *cache = BDRV_DEFAULT_CACHE, *filename;
+    bool progress = false, quiet = false;
+    bool image_opts = false, force_share = false;
+    long num_coroutines = 8;
+    BlockBackend *blk;
+    ImgChecksumState s = { 0 };
+    uint64_t size_be;
+    g_autofree uint8_t *zeros = NULL;
+    g_autofree char *hex = NULL;
+    struct iovec iov[2];
+    Error *local_err = NULL;
+    bool writethrough;
+    int c, i, flags, ret = 1;
+
+    for (;;) {
+        static const struct option long_options[] = {
+            {"help", no_argument, 0, 'h'},
+            {"object", required_argument, 0, OPTION_OBJECT},
+            {"image-opts", no_argument, 0, OPTION_IMAGE_OPTS},
+            {"force-share", no_argument, 0, 'U'},
+            {0, 0, 0, 0}
+        };
+        c = getopt_long(argc, argv, ":hf:T:m:pqU", long_options, NULL);
+        if (c == -1) {
+            break;
+        }
+        switch (c) {
+        case ':':
+            missing_argument(argv[optind - 1]);
+            break;
+        case '?':
+            unrecognized_option(argv[optind - 1]);
+            break;
+        case 'h':
+            help();
+            break;
+        case 'f':
+            fmt = optarg;
+            break;
+        case 'T':
+            cache = optarg;
+            break;
+        case 'm':
+            if (qemu_strtol(optarg, NULL, 0, &num_coroutines) ||
+                num_coroutines < 1 || num_coroutines > MAX_COROUTINES) {
+                error_report("Invalid number of coroutines. Allowed number of"
+                             " coroutines is between 1 and %d", MAX_COROUTINES);
+                return 1;
             }
-            if (ret & BDRV_BLOCK_ALLOCATED && !(ret & BDRV_BLOCK_ZERO)) {
-                chunk = MIN(chunk, IO_BUF_SIZE);
-                ret = check_empty_sectors(blk_over, offset, chunk,
-                                          filename_over, buf1, quiet);
-                if (ret) {
-                    goto out;
+            break;
+        case 'p':
+            progress = true;
+            break;
+        case 'q':
+            quiet = true;
+            break;
+        case 'U':
+            force_share = true;
+            break;
+        case OPTION_OBJECT:
+            if (!user_creatable_add_from_str(optarg, &local_err)) {
+                if (local_err) {
+                    error_report_err(local_err);
+                    return 1;
+                } else {
+                    /* Help was printed */
+                    exit(EXIT_SUCCESS);
                 }
             }
-            offset += chunk;
-            qemu_progress_print(((float) chunk / progress_base) * 100, 100);
+            break;
+        case OPTION_IMAGE_OPTS:
+            image_opts = true;
+            break;
         }
     }
 
-    qprintf(quiet, "Images are identical.\n");
+    if (quiet) {
+        progress = false;
+    }
+
+    if (optind != argc - 1) {
+        error_exit("Expecting one image file name");
+    }
+    filename = argv[optind];
+
+    flags = 0;
+    if (bdrv_parse_cache_mode(cache, &flags, &writethrough) < 0) {
+        error_report("Invalid source cache option: %s", cache);
+        return 1;
+    }
+
+    blk = img_open(image_opts, filename, fmt, flags, writethrough, quiet,
+                   force_share);
+    if (!blk) {
+        return 1;
+    }
+
+    qemu_progress_init(progress, 2.0);
+    qemu_progress_print(0, 100);
+
+    s.blk = blk;
+    s.total_size = blk_getlength(blk);
+    if (s.total_size < 0) {
+        error_report("Can't get size of %s: %s",
+                     filename, strerror(-s.total_size));
+        goto out;
+    }
+    s.nb_blocks = DIV_ROUND_UP(s.total_size, CHECKSUM_BLOCK_SIZE);
+    s.digest_len = qcrypto_hash_digest_len(CHECKSUM_HASH_ALG);
+    s.digests = g_try_malloc(MAX(s.nb_blocks, 1) * s.digest_len);
+    s.zero_digest = g_malloc(s.digest_len);
+    if (!s.digests) {
+        error_report("Not enough memory to checksum %s", filename);
+        goto out;
+    }
+
+    zeros = g_malloc0(CHECKSUM_BLOCK_SIZE);
+    if (checksum_hash(zeros, CHECKSUM_BLOCK_SIZE, s.zero_digest) < 0) {
+        goto out;
+    }
+
+    for (i = 0; i < num_coroutines; i++) {
+        qemu_coroutine_enter(qemu_coroutine_create(checksum_co_do, &s));
+    }
+    while (s.running_coroutines) {
+        main_loop_wait(false);
+    }
+    if (s.ret < 0) {
+        goto out;
+    }
+
+    size_be = cpu_to_be64(s.total_size);
+    iov[0] = (struct iovec) {
+        .iov_base = s.digests,
+        .iov_len = s.nb_blocks * s.digest_len,
+    };
+    iov[1] = (struct iovec) {
+        .iov_base = &size_be,
+        .iov_len = sizeof(size_be),
+    };
+    if (qcrypto_hash_digestv(CHECKSUM_HASH_ALG, iov, ARRAY_SIZE(iov), &hex,
+                             &local_err) < 0) {
+        error_report_err(local_err);
+        goto out;
+    }
+
+    qemu_progress_end();
+    printf("%s  %s\n", hex, filename);
     ret = 0;
 
 out:
-    qemu_vfree(buf1);
-    qemu_vfree(buf2);
-    blk_unref(blk2);
-out2:
-    blk_unref(blk1);
-out3:
-    qemu_progress_end();
+    if (ret) {
+        qemu_progress_end();
+    }
+    g_free(s.digests);
+    g_free(s.zero_digest);
+    blk_unref(blk);
     return ret;
 }
 
@@ -1616,7 +1976,6 @@ enum ImgConvertBlockStatus {
     BLK_BACKING_FILE,
 };
 
-#define MAX_COROUTINES 16
 #define CONVERT_THROTTLE_GROUP "img_convert"
 
 typedef struct ImgConvertState {
@@ -1848,14 +2207,14 @@ static int coroutine_fn convert_co_write(ImgConvertState *s, int64_t sector_num,
              * is real non-zero data, we must write it. Otherwise we can treat
              * it as zero sectors.
              * Compressed clusters need to be written as a whole, so in that
-             * case we can only save the write if the buffer is completely
-             * zeroed. */
+             * case we can only save the write for completely zeroed
+             * clusters. */
             if (!s->min_sparse ||
                 (!s->compressed &&
                  is_allocated_sectors_min(buf, n, &n, s->min_sparse,
                                           sector_num, s->alignment)) ||
                 (s->compressed &&
-                 !buffer_is_zero(buf, n * BDRV_SECTOR_SIZE)))
+                 is_allocated_clusters(buf, n, &n, s->cluster_sectors)))
             {
                 ret = blk_co_pwrite(s->target, sector_num << BDRV_SECTOR_BITS,
                                     n << BDRV_SECTOR_BITS, buf, flags);
@@ -2050,14 +2409,17 @@ static int convert_do_copy(ImgConvertState *s)
         s->has_zero_init = bdrv_has_zero_init(blk_bs(s->target));
     }
 
-    /* Allocate buffer for copied data. For compressed images, only one cluster
-     * can be copied at a time. */
+    /* Allocate buffer for copied data. For compressed images, the buffer
+     * must contain whole clusters; the format driver compresses the clusters
+     * of one request in parallel. */
     if (s->compressed) {
-        if (s->cluster_sectors <= 0 || s->cluster_sectors > s->buf_sectors) {
+        if (s->cluster_sectors <= 0) {
             error_report("invalid cluster size");
             return -EINVAL;
         }
-        s->buf_sectors = s->cluster_sectors;
+        s->buf_sectors = MAX(QEMU_ALIGN_DOWN(s->buf_sectors,
+                                             s->cluster_sectors),
+                             s->cluster_sectors);
     }
 
     while (sector_num < s->total_sectors) {
@@ -2132,6 +2494,8 @@ static int convert_copy_bitmaps(BlockDriverState *src, BlockDriverState *dst)
 }
 
 #define MAX_BUF_SECTORS 32768
+/* The maximum of the qcow2 compress-threads option */
+#define MAX_COMPRESS_THREADS 64
 
 static void set_rate_limit(BlockBackend *blk, int64_t rate_limit)
 {
@@ -2592,6 +2956,11 @@ static int img_convert(int argc, char **argv)
          * That has to wait for bdrv_create to be improved
          * to allow filenames in option syntax
          */
+        if (s.compressed && !strcmp(drv->format_name, "qcow2")) {
+            /* Let compression use all host CPUs, not only the default 4 */
+            qdict_put_int(open_opts, "compress-threads",
+                          MIN(g_get_num_processors(), MAX_COMPRESS_THREADS));
+        }
         s.target = img_open_file(out_filename, open_opts, out_fmt,
                                  flags, writethrough, s.quiet, false);
         open_opts = NULL; /* blk_new_open will have freed it */
@@ -3363,22 +3732,239 @@ static int img_snapshot(int argc, char **argv)
                 ret = 1;
             }
         }
-        break;
+        break;
+    }
+
+    /* Cleanup */
+    blk_unref(blk);
+    if (ret) {
+        return 1;
+    }
+    return 0;
+}
+
+typedef struct ImgRebaseState {
+    BlockBackend *blk;
+    BlockBackend *blk_old_backing;
+    BlockBackend *blk_new_backing;
+    BlockDriverState *unfiltered_bs;
+    BlockDriverState *prefix_chain_bs;
+    int64_t size;
+    int64_t old_backing_size;
+    int64_t new_backing_size;
+    int64_t offset;             /* start of the next chunk to look at */
+    int running_coroutines;
+    CoMutex lock;
+    int ret;
+} ImgRebaseState;
+
+/*
+ * Whether [offset, offset + *bytes) of a backing file reads as zeros.
+ * Shortens *bytes to the part with the same status.
+ */
+static int coroutine_fn rebase_backing_is_zero(BlockBackend *backing,
+                                               int64_t backing_size,
+                                               int64_t offset, int64_t *bytes)
+{
+    int64_t pnum;
+    int ret;
+
+    if (!backing || offset >= backing_size) {
+        return 1;
+    }
+
+    *bytes = MIN(*bytes, backing_size - offset);
+    ret = bdrv_block_status_above(blk_bs(backing), NULL, offset, *bytes,
+                                  &pnum, NULL, NULL);
+    if (ret < 0) {
+        return ret;
+    }
+    *bytes = pnum;
+    return (ret & BDRV_BLOCK_ZERO) || !(ret & BDRV_BLOCK_ALLOCATED);
+}
+
+/*
+ * Find the next chunk that may differ between the old and the new backing
+ * file and is visible through the COW image.  Returns 1 and sets @offset,
+ * @bytes, @old_zero and @new_zero (whether the chunk reads as zeros in the
+ * old and new backing files) if there is one, 0 at the end of the image
+ * and a negative errno value on errors.
+ */
+static int coroutine_fn rebase_next_chunk(ImgRebaseState *s, int64_t *offset,
+                                          int64_t *bytes, bool *old_zero,
+                                          bool *new_zero)
+{
+    int64_t n, pnum;
+    int ret;
+
+    while (s->ret == 0 && s->offset < s->size) {
+        *offset = s->offset;
+        n = MIN(IO_BUF_SIZE, s->size - *offset);
+
+        /* If the cluster is allocated, we don't need to take action */
+        ret = bdrv_is_allocated(s->unfiltered_bs, *offset, n, &n);
+        if (ret < 0) {
+            error_report("error while reading image metadata: %s",
+                         strerror(-ret));
+            return ret;
+        }
+        if (ret) {
+            s->offset += n;
+            continue;
+        }
+
+        if (s->prefix_chain_bs) {
+            /*
+             * If cluster wasn't changed since prefix_chain, we don't need
+             * to take action
+             */
+            ret = bdrv_is_allocated_above(bdrv_cow_bs(s->unfiltered_bs),
+                                          s->prefix_chain_bs, false,
+                                          *offset, n, &n);
+            if (ret < 0) {
+                error_report("error while reading image metadata: %s",
+                             strerror(-ret));
+                return ret;
+            }
+            if (!ret) {
+                s->offset += n;
+                continue;
+            }
+        }
+
+        /* Nothing to do if both backing files read as zeros */
+        ret = rebase_backing_is_zero(s->blk_old_backing, s->old_backing_size,
+                                     *offset, &n);
+        if (ret >= 0) {
+            *old_zero = ret;
+            pnum = n;
+            ret = rebase_backing_is_zero(s->blk_new_backing,
+                                         s->new_backing_size, *offset, &pnum);
+            *new_zero = ret;
+            n = pnum;
+        }
+        if (ret < 0) {
+            error_report("error while reading backing file metadata: %s",
+                         strerror(-ret));
+            return ret;
+        }
+
+        s->offset += n;
+        if (*old_zero && *new_zero) {
+            continue;
+        }
+        *bytes = n;
+        return 1;
+    }
+    return 0;
+}
+
+static int coroutine_fn rebase_co_chunk(ImgRebaseState *s, int64_t offset,
+                                        int64_t n, bool old_zero,
+                                        bool new_zero, uint8_t *buf_old,
+                                        uint8_t *buf_new)
+{
+    int64_t written = 0;
+    int ret;
+
+    /* Only read what the block status doesn't tell to be zeros */
+    if (old_zero) {
+        memset(buf_old, 0, n);
+    } else {
+        ret = blk_co_pread(s->blk_old_backing, offset, n, buf_old, 0);
+        if (ret < 0) {
+            error_report("error while reading from old backing file");
+            return ret;
+        }
+    }
+
+    if (new_zero) {
+        memset(buf_new, 0, n);
+    } else {
+        ret = blk_co_pread(s->blk_new_backing, offset, n, buf_new, 0);
+        if (ret < 0) {
+            error_report("error while reading from new backing file");
+            return ret;
+        }
+    }
+
+    /* If they differ, we need to write to the COW file */
+    while (written < n) {
+        int64_t pnum;
+
+        if (compare_buffers(buf_old + written, buf_new + written,
+                            n - written, &pnum))
+        {
+            /* Keep the COW image sparse */
+            if (old_zero || buffer_is_zero(buf_old + written, pnum)) {
+                ret = blk_co_pwrite_zeroes(s->blk, offset + written, pnum, 0);
+            } else {
+                ret = blk_co_pwrite(s->blk, offset + written, pnum,
+                                    buf_old + written, 0);
+            }
+            if (ret < 0) {
+                error_report("Error while writing to COW image: %s",
+                    strerror(-ret));
+                return ret;
+            }
+        }
+
+        written += pnum;
+    }
+    return 0;
+}
+
+/*
+ * Copy the data that differs between the old and the new backing file into
+ * the COW image.  Chunks are picked in order under s->lock, but read,
+ * compared and written in parallel.
+ */
+static void coroutine_fn rebase_co_do(void *opaque)
+{
+    ImgRebaseState *s = opaque;
+    uint8_t *buf_old, *buf_new;
+    int64_t offset, bytes, done = 0;
+    bool old_zero, new_zero;
+    int ret;
+
+    s->running_coroutines++;
+    buf_old = blk_blockalign(s->blk, IO_BUF_SIZE);
+    buf_new = blk_blockalign(s->blk, IO_BUF_SIZE);
+
+    while (1) {
+        qemu_co_mutex_lock(&s->lock);
+        ret = rebase_next_chunk(s, &offset, &bytes, &old_zero, &new_zero);
+        if (ret <= 0) {
+            if (ret < 0) {
+                s->ret = ret;
+            }
+            /* also account for what was skipped */
+            qemu_progress_print(100.0 * (s->offset - done) /
+                                MAX(s->size, 1), 100);
+            done = s->offset;
+            qemu_co_mutex_unlock(&s->lock);
+            break;
+        }
+        qemu_progress_print(100.0 * (s->offset - done) / s->size, 100);
+        done = s->offset;
+        qemu_co_mutex_unlock(&s->lock);
+
+        ret = rebase_co_chunk(s, offset, bytes, old_zero, new_zero,
+                              buf_old, buf_new);
+        if (ret < 0) {
+            s->ret = ret;
+            break;
+        }
     }
 
-    /* Cleanup */
-    blk_unref(blk);
-    if (ret) {
-        return 1;
-    }
-    return 0;
+    qemu_vfree(buf_old);
+    qemu_vfree(buf_new);
+    s->running_coroutines--;
 }
 
 static int img_rebase(int argc, char **argv)
 {
     BlockBackend *blk = NULL, *blk_old_backing = NULL, *blk_new_backing = NULL;
-    uint8_t *buf_old = NULL;
-    uint8_t *buf_new = NULL;
     BlockDriverState *bs = NULL, *prefix_chain_bs = NULL;
     BlockDriverState *unfiltered_bs;
     char *filename;
@@ -3391,6 +3977,7 @@ static int img_rebase(int argc, char **argv)
     bool quiet = false;
     Error *local_err = NULL;
     bool image_opts = false;
+    long num_coroutines = 8;
 
     /* Parse commandline parameters */
     fmt = NULL;
@@ -3406,7 +3993,7 @@ static int img_rebase(int argc, char **argv)
             {"force-share", no_argument, 0, 'U'},
             {0, 0, 0, 0}
         };
-        c = getopt_long(argc, argv, ":hf:F:b:upt:T:qU",
+        c = getopt_long(argc, argv, ":hf:F:b:upt:T:m:qU",
                         long_options, NULL);
         if (c == -1) {
             break;
@@ -3442,6 +4029,14 @@ static int img_rebase(int argc, char **argv)
         case 'T':
             src_cache = optarg;
             break;
+        case 'm':
+            if (qemu_strtol(optarg, NULL, 0, &num_coroutines) ||
+                num_coroutines < 1 || num_coroutines > MAX_COROUTINES) {
+                error_report("Invalid number of coroutines. Allowed number of"
+                             " coroutines is between 1 and %d", MAX_COROUTINES);
+                return 1;
+            }
+            break;
         case 'q':
             quiet = true;
             break;
@@ -3610,12 +4205,8 @@ static int img_rebase(int argc, char **argv)
         int64_t size;
         int64_t old_backing_size = 0;
         int64_t new_backing_size = 0;
-        uint64_t offset;
-        int64_t n;
-        float local_progress = 0;
-
-        buf_old = blk_blockalign(blk, IO_BUF_SIZE);
-        buf_new = blk_blockalign(blk, IO_BUF_SIZE);
+        ImgRebaseState rs;
+        int i;
 
         size = blk_getlength(blk);
         if (size < 0) {
@@ -3647,103 +4238,27 @@ static int img_rebase(int argc, char **argv)
             }
         }
 
-        if (size != 0) {
-            local_progress = (float)100 / (size / MIN(size, IO_BUF_SIZE));
-        }
-
-        for (offset = 0; offset < size; offset += n) {
-            bool buf_old_is_zero = false;
-
-            /* How many bytes can we handle with the next read? */
-            n = MIN(IO_BUF_SIZE, size - offset);
-
-            /* If the cluster is allocated, we don't need to take action */
-            ret = bdrv_is_allocated(unfiltered_bs, offset, n, &n);
-            if (ret < 0) {
-                error_report("error while reading image metadata: %s",
-                             strerror(-ret));
-                goto out;
-            }
-            if (ret) {
-                continue;
-            }
-
-            if (prefix_chain_bs) {
-                /*
-                 * If cluster wasn't changed since prefix_chain, we don't need
-                 * to take action
-                 */
-                ret = bdrv_is_allocated_above(bdrv_cow_bs(unfiltered_bs),
-                                              prefix_chain_bs, false,
-                                              offset, n, &n);
-                if (ret < 0) {
-                    error_report("error while reading image metadata: %s",
-                                 strerror(-ret));
-                    goto out;
-                }
-                if (!ret) {
-                    continue;
-                }
-            }
-
-            /*
-             * Read old and new backing file and take into consideration that
-             * backing files may be smaller than the COW image.
-             */
-            if (offset >= old_backing_size) {
-                memset(buf_old, 0, n);
-                buf_old_is_zero = true;
-            } else {
-                if (offset + n > old_backing_size) {
-                    n = old_backing_size - offset;
-                }
-
-                ret = blk_pread(blk_old_backing, offset, buf_old, n);
-                if (ret < 0) {
-                    error_report("error while reading from old backing file");
-                    goto out;
-                }
-            }
-
-            if (offset >= new_backing_size || !blk_new_backing) {
-                memset(buf_new, 0, n);
-            } else {
-                if (offset + n > new_backing_size) {
-                    n = new_backing_size - offset;
-                }
-
-                ret = blk_pread(blk_new_backing, offset, buf_new, n);
-                if (ret < 0) {
-                    error_report("error while reading from new backing file");
-                    goto out;
-                }
-            }
-
-            /* If they differ, we need to write to the COW file */
-            uint64_t written = 0;
-
-            while (written < n) {
-                int64_t pnum;
-
-                if (compare_buffers(buf_old + written, buf_new + written,
-                                    n - written, &pnum))
-                {
-                    if (buf_old_is_zero) {
-                        ret = blk_pwrite_zeroes(blk, offset + written, pnum, 0);
-                    } else {
-                        ret = blk_pwrite(blk, offset + written,
-                                         buf_old + written, pnum, 0);
-                    }
-                    if (ret < 0) {
-                        error_report("Error while writing to COW image: %s",
-                            strerror(-ret));
-                        goto out;
-                    }
-                }
+        rs = (ImgRebaseState) {
+            .blk                = blk,
+            .blk_old_backing    = blk_old_backing,
+            .blk_new_backing    = blk_new_backing,
+            .unfiltered_bs      = unfiltered_bs,
+            .prefix_chain_bs    = prefix_chain_bs,
+            .size               = size,
+            .old_backing_size   = old_backing_size,
+            .new_backing_size   = new_backing_size,
+        };
+        qemu_co_mutex_init(&rs.lock);
 
-                written += pnum;
-            }
-            qemu_progress_print(local_progress, 100);
+        for (i = 0; i < num_coroutines; i++) {
+            qemu_coroutine_enter(qemu_coroutine_create(rebase_co_do, &rs));
+        }
+        while (rs.running_coroutines) {
+            main_loop_wait(false);
+        }
+        ret = rs.ret;
+        if (ret < 0) {
+            goto out;
         }
     }
 
@@ -3781,8 +4296,6 @@ out:
         blk_unref(blk_old_backing);
         blk_unref(blk_new_backing);
     }
-    qemu_vfree(buf_old);
-    qemu_vfree(buf_new);
 
     blk_unref(blk);
     if (ret) {
@@ -4170,95 +4683,296 @@ out_no_progress:
     return 0;
 }
 
-typedef struct BenchData {
+/* Latency percentiles reported by img_bench */
+static const double bench_percentiles[] = { 50, 99, 99.9 };
+
+typedef struct BenchData BenchData;
+typedef struct BenchJob BenchJob;
+
+typedef struct BenchReq {
+    BenchJob *job;
+    QEMUIOVector qiov;
+    bool write;
+    int64_t start_ns;
+} BenchReq;
+
+/* Keeps up to depth requests in flight, in its own thread if jobs > 1 */
+struct BenchJob {
+    BenchData *b;
+    AioContext *ctx;
+    QemuThread thread;
+    GRand *rand;
+
+    BenchReq *reqs;
+    BenchReq **free_reqs;
+    int nb_free_reqs;
+
+    int in_flight;
+    int undrained_flushes;
+    bool in_flush;
+    bool flush_pending;
+    bool done;
+    int64_t submitted;
+    int64_t completed;
+    uint64_t offset;
+};
+
+struct BenchData {
     BlockBackend *blk;
     uint64_t image_size;
-    bool write;
+    int read_percent;
+    bool random;
     int bufsize;
     int step;
     int nrreq;
-    int n;
+    int64_t n;      /* requests per job, negative for time based runs */
+    int64_t end_ns; /* end of a time based run */
     int flush_interval;
     bool drain_on_flush;
     uint8_t *buf;
-    QEMUIOVector *qiov;
 
-    int in_flight;
-    bool in_flush;
-    uint64_t offset;
-} BenchData;
+    BenchJob *jobs;
+    int nb_jobs;
+    int running_jobs;
+    BlockAcctStats *stats; /* only for the latency histograms */
+};
+
+/*
+ * Jobs in their own thread run in their own AioContext.  Make it the
+ * current one, so that the block layer completes their requests there.
+ */
+static __thread AioContext *bench_thread_ctx;
+
+AioContext *qemu_get_current_aio_context(void)
+{
+    return bench_thread_ctx ?: qemu_get_aio_context();
+}
+
+static void bench_submit(BenchJob *job);
+
+static void bench_job_finish(BenchJob *job)
+{
+    job->done = true;
+    if (qatomic_fetch_dec(&job->b->running_jobs) == 1) {
+        qemu_notify_event();
+    }
+}
 
 static void bench_undrained_flush_cb(void *opaque, int ret)
 {
+    BenchJob *job = opaque;
+
+    if (ret < 0) {
+        error_report("Failed flush request: %s", strerror(-ret));
+        exit(EXIT_FAILURE);
+    }
+
+    job->undrained_flushes--;
+    bench_submit(job);
+}
+
+static void bench_flush_cb(void *opaque, int ret)
+{
+    BenchJob *job = opaque;
+
     if (ret < 0) {
         error_report("Failed flush request: %s", strerror(-ret));
         exit(EXIT_FAILURE);
     }
+
+    /* Just finished a flush with drained queue: Start next requests */
+    assert(job->in_flight == 0);
+    job->in_flush = false;
+    bench_submit(job);
 }
 
 static void bench_cb(void *opaque, int ret)
 {
-    BenchData *b = opaque;
-    BlockAIOCB *acb;
+    BenchReq *req = opaque;
+    BenchJob *job = req->job;
+    BenchData *b = job->b;
 
     if (ret < 0) {
         error_report("Failed request: %s", strerror(-ret));
         exit(EXIT_FAILURE);
     }
 
-    if (b->in_flush) {
-        /* Just finished a flush with drained queue: Start next requests */
-        assert(b->in_flight == 0);
-        b->in_flush = false;
-    } else if (b->in_flight > 0) {
-        int remaining = b->n - b->in_flight;
+    block_acct_latency(b->stats, BLOCK_ACCT_PHASE_TOTAL,
+                       req->write ? BLOCK_ACCT_WRITE : BLOCK_ACCT_READ,
+                       block_acct_clock_ns() - req->start_ns);
 
-        b->n--;
-        b->in_flight--;
+    job->free_reqs[job->nb_free_reqs++] = req;
+    job->in_flight--;
+    job->completed++;
 
-        /* Time for flush? Drain queue if requested, then flush */
-        if (b->flush_interval && remaining % b->flush_interval == 0) {
-            if (!b->in_flight || !b->drain_on_flush) {
-                BlockCompletionFunc *cb;
+    if (b->flush_interval && job->completed % b->flush_interval == 0) {
+        job->flush_pending = true;
+    }
 
-                if (b->drain_on_flush) {
-                    b->in_flush = true;
-                    cb = bench_cb;
-                } else {
-                    cb = bench_undrained_flush_cb;
-                }
+    /* Time for flush? Drain queue if requested, then flush */
+    if (job->flush_pending && (!job->in_flight || !b->drain_on_flush)) {
+        BlockCompletionFunc *cb;
+        BlockAIOCB *acb;
 
-                acb = blk_aio_flush(b->blk, cb, b);
-                if (!acb) {
-                    error_report("Failed to issue flush request");
-                    exit(EXIT_FAILURE);
-                }
-            }
-            if (b->drain_on_flush) {
-                return;
-            }
+        job->flush_pending = false;
+        if (b->drain_on_flush) {
+            job->in_flush = true;
+            cb = bench_flush_cb;
+        } else {
+            job->undrained_flushes++;
+            cb = bench_undrained_flush_cb;
+        }
+
+        acb = blk_aio_flush(b->blk, cb, job);
+        if (!acb) {
+            error_report("Failed to issue flush request");
+            exit(EXIT_FAILURE);
         }
     }
+    if (job->flush_pending || job->in_flush) {
+        return;
+    }
+
+    bench_submit(job);
+}
+
+static bool bench_job_stopping(BenchJob *job)
+{
+    BenchData *b = job->b;
+
+    if (b->n >= 0) {
+        return job->submitted >= b->n;
+    }
+    return block_acct_clock_ns() >= b->end_ns;
+}
+
+static uint64_t bench_next_offset(BenchJob *job)
+{
+    BenchData *b = job->b;
+    uint64_t offset;
+
+    if (b->random) {
+        uint64_t r = ((uint64_t)g_rand_int(job->rand) << 32) |
+                     g_rand_int(job->rand);
+
+        return (r % (b->image_size / b->bufsize)) * b->bufsize;
+    }
+
+    offset = job->offset;
+    job->offset += b->step;
+    job->offset %= b->image_size;
+    return offset;
+}
+
+static void bench_submit(BenchJob *job)
+{
+    BenchData *b = job->b;
+    BlockAIOCB *acb;
+
+    while (!job->in_flush && job->in_flight < b->nrreq &&
+           !bench_job_stopping(job))
+    {
+        BenchReq *req = job->free_reqs[--job->nb_free_reqs];
+        int64_t offset = bench_next_offset(job);
 
-    while (b->n > b->in_flight && b->in_flight < b->nrreq) {
-        int64_t offset = b->offset;
         /* blk_aio_* might look for completed I/Os and kick bench_cb
          * again, so make sure this operation is counted by in_flight
-         * and b->offset is ready for the next submission.
+         * and the offset is ready for the next submission.
          */
-        b->in_flight++;
-        b->offset += b->step;
-        b->offset %= b->image_size;
-        if (b->write) {
-            acb = blk_aio_pwritev(b->blk, offset, b->qiov, 0, bench_cb, b);
+        job->in_flight++;
+        job->submitted++;
+
+        req->write = b->read_percent == 0 ||
+                     (b->read_percent < 100 &&
+                      g_rand_int_range(job->rand, 0, 100) >= b->read_percent);
+        req->start_ns = block_acct_clock_ns();
+        if (req->write) {
+            acb = blk_aio_pwritev(b->blk, offset, &req->qiov, 0, bench_cb, req);
         } else {
-            acb = blk_aio_preadv(b->blk, offset, b->qiov, 0, bench_cb, b);
+            acb = blk_aio_preadv(b->blk, offset, &req->qiov, 0, bench_cb, req);
         }
         if (!acb) {
             error_report("Failed to issue request");
             exit(EXIT_FAILURE);
         }
     }
+
+    if (!job->done && !job->in_flight && !job->in_flush &&
+        !job->undrained_flushes && bench_job_stopping(job))
+    {
+        bench_job_finish(job);
+    }
+}
+
+static void *bench_thread(void *opaque)
+{
+    BenchJob *job = opaque;
+
+    bench_thread_ctx = job->ctx;
+    bench_submit(job);
+    while (!job->done) {
+        aio_poll(job->ctx, true);
+    }
+    return NULL;
+}
+
+static void bench_print_results(BenchData *b, int64_t run_ns,
+                                OutputFormat output_format)
+{
+    static const enum BlockAcctType types[] = {
+        BLOCK_ACCT_READ, BLOCK_ACCT_WRITE,
+    };
+    static const char *const type_names[] = { "read", "write" };
+    double seconds = (double)run_ns / NANOSECONDS_PER_SECOND;
+    QDict *results = qdict_new();
+    int i, j;
+
+    if (output_format == OFORMAT_HUMAN) {
+        printf("Run completed in %3.3f seconds.\n", seconds);
+    }
+    qdict_put_int(results, "run-time-ns", run_ns);
+
+    for (i = 0; i < ARRAY_SIZE(types); i++) {
+        uint64_t lat_ns[ARRAY_SIZE(bench_percentiles)];
+        uint64_t ops;
+        QDict *op;
+
+        ops = block_acct_latency_percentiles(b->stats, BLOCK_ACCT_PHASE_TOTAL,
+                                             types[i], bench_percentiles,
+                                             lat_ns,
+                                             ARRAY_SIZE(bench_percentiles));
+        if (!ops) {
+            continue;
+        }
+
+        if (output_format == OFORMAT_HUMAN) {
+            printf("%-5s: %" PRIu64 " ops, %.0f IOPS, %.2f MiB/s, latency",
+                   type_names[i], ops, ops / seconds,
+                   ops * b->bufsize / seconds / MiB);
+            for (j = 0; j < ARRAY_SIZE(bench_percentiles); j++) {
+                printf(" p%g %.1f us%s", bench_percentiles[j],
+                       lat_ns[j] / 1000.0,
+                       j + 1 < ARRAY_SIZE(bench_percentiles) ? "," : "\n");
+            }
+            continue;
+        }
+
+        op = qdict_new();
+        qdict_put_int(op, "operations", ops);
+        qdict_put_int(op, "bytes", ops * b->bufsize);
+        qdict_put_int(op, "p50-ns", lat_ns[0]);
+        qdict_put_int(op, "p99-ns", lat_ns[1]);
+        qdict_put_int(op, "p999-ns", lat_ns[2]);
+        qdict_put(results, type_names[i], op);
+    }
+
+    if (output_format == OFORMAT_JSON) {
+        GString *str = qobject_to_json_pretty(QOBJECT(results), true);
+
+        printf("%s\n", str->str);
+        g_string_free(str, true);
+    }
+    qobject_unref(results);
 }
 
 static int img_bench(int argc, char **argv)
@@ -4269,6 +4983,7 @@ static int img_bench(int argc, char **argv)
     bool image_opts = false;
     bool is_write = false;
     int count = 75000;
+    bool count_given = false;
     int depth = 64;
     int64_t offset = 0;
     size_t bufsize = 4096;
@@ -4276,15 +4991,22 @@ static int img_bench(int argc, char **argv)
     size_t step = 0;
     int flush_interval = 0;
     bool drain_on_flush = true;
+    int read_percent = -1;
+    bool random = false;
+    int64_t run_time = 0;
+    int nb_jobs = 1;
+    OutputFormat output_format = OFORMAT_HUMAN;
+    const char *output = NULL;
     int64_t image_size;
     BlockBackend *blk = NULL;
     BenchData data = {};
     int flags = 0;
     bool writethrough = false;
-    struct timeval t1, t2;
-    int i;
+    int64_t start_ns;
+    int i, j;
     bool force_share = false;
     size_t buf_size;
+    Error *local_err = NULL;
 
     for (;;) {
         static const struct option long_options[] = {
@@ -4294,6 +5016,11 @@ static int img_bench(int argc, char **argv)
             {"pattern", required_argument, 0, OPTION_PATTERN},
             {"no-drain", no_argument, 0, OPTION_NO_DRAIN},
             {"force-share", no_argument, 0, 'U'},
+            {"rwmix", required_argument, 0, OPTION_RWMIX},
+            {"random", no_argument, 0, OPTION_RANDOM},
+            {"time", required_argument, 0, OPTION_TIME},
+            {"jobs", required_argument, 0, OPTION_JOBS},
+            {"output", required_argument, 0, OPTION_OUTPUT},
             {0, 0, 0, 0}
         };
         c = getopt_long(argc, argv, ":hc:d:f:ni:o:qs:S:t:wU", long_options,
@@ -4321,6 +5048,7 @@ static int img_bench(int argc, char **argv)
                 return 1;
             }
             count = res;
+            count_given = true;
             break;
         }
         case 'd':
@@ -4427,6 +5155,47 @@ static int img_bench(int argc, char **argv)
         case OPTION_IMAGE_OPTS:
             image_opts = true;
             break;
+        case OPTION_RWMIX:
+        {
+            unsigned long res;
+
+            if (qemu_strtoul(optarg, NULL, 0, &res) < 0 || res > 100) {
+                error_report("Invalid read percentage specified");
+                return 1;
+            }
+            read_percent = res;
+            break;
+        }
+        case OPTION_RANDOM:
+            random = true;
+            break;
+        case OPTION_TIME:
+        {
+            unsigned long res;
+
+            if (qemu_strtoul(optarg, NULL, 0, &res) < 0 || res == 0 ||
+                res > INT_MAX) {
+                error_report("Invalid run time specified");
+                return 1;
+            }
+            run_time = res;
+            break;
+        }
+        case OPTION_JOBS:
+        {
+            unsigned long res;
+
+            if (qemu_strtoul(optarg, NULL, 0, &res) < 0 || res == 0 ||
+                res > 256) {
+                error_report("Invalid number of jobs specified");
+                return 1;
+            }
+            nb_jobs = res;
+            break;
+        }
+        case OPTION_OUTPUT:
+            output = optarg;
+            break;
         }
     }
 
@@ -4435,7 +5204,21 @@ static int img_bench(int argc, char **argv)
     }
     filename = argv[argc - 1];
 
-    if (!is_write && flush_interval) {
+    if (output && !strcmp(output, "json")) {
+        output_format = OFORMAT_JSON;
+    } else if (output && !strcmp(output, "human")) {
+        output_format = OFORMAT_HUMAN;
+    } else if (output) {
+        error_report("--output must be used with human or json as argument.");
+        return 1;
+    }
+
+    if (read_percent < 0) {
+        read_percent = is_write ? 0 : 100;
+    } else if (read_percent < 100) {
+        flags |= BDRV_O_RDWR;
+    }
+    if (read_percent == 100 && flush_interval) {
         error_report("--flush-interval is only available in write tests");
         ret = -1;
         goto out;
@@ -4445,6 +5228,16 @@ static int img_bench(int argc, char **argv)
         ret = -1;
         goto out;
     }
+    if (run_time && count_given) {
+        error_report("-c and --time cannot be used together");
+        ret = -1;
+        goto out;
+    }
+    if (depth == 0) {
+        error_report("Queue depth must be greater than 0");
+        ret = -1;
+        goto out;
+    }
 
     blk = img_open(image_opts, filename, fmt, flags, writethrough, quiet,
                    force_share);
@@ -4458,53 +5251,157 @@ static int img_bench(int argc, char **argv)
         ret = image_size;
         goto out;
     }
+    if (random && image_size < bufsize) {
+        error_report("Image is smaller than the buffer size");
+        ret = -1;
+        goto out;
+    }
 
     data = (BenchData) {
         .blk            = blk,
         .image_size     = image_size,
+        .read_percent   = read_percent,
+        .random         = random,
         .bufsize        = bufsize,
         .step           = step ?: bufsize,
         .nrreq          = depth,
-        .n              = count,
-        .offset         = offset,
-        .write          = is_write,
+        .n              = run_time ? -1 : count,
         .flush_interval = flush_interval,
         .drain_on_flush = drain_on_flush,
+        .nb_jobs        = nb_jobs,
+        .running_jobs   = nb_jobs,
     };
-    printf("Sending %d %s requests, %d bytes each, %d in parallel "
-           "(starting at offset %" PRId64 ", step size %d)\n",
-           data.n, data.write ? "write" : "read", data.bufsize, data.nrreq,
-           data.offset, data.step);
-    if (flush_interval) {
-        printf("Sending flush every %d requests\n", flush_interval);
+    if (output_format == OFORMAT_HUMAN) {
+        g_autofree char *type = NULL;
+
+        if (read_percent == 100) {
+            type = g_strdup(random ? "random read" : "read");
+        } else if (read_percent == 0) {
+            type = g_strdup(random ? "random write" : "write");
+        } else {
+            type = g_strdup_printf("%s%d%% read", random ? "random " : "",
+                                   read_percent);
+        }
+        if (run_time) {
+            printf("Sending %s requests for %" PRId64 " seconds",
+                   type, run_time);
+        } else {
+            printf("Sending %d %s requests", count, type);
+        }
+        printf(", %d bytes each, %d in parallel "
+               "(starting at offset %" PRId64 ", step size %d)\n",
+               data.bufsize, data.nrreq, offset, data.step);
+        if (nb_jobs > 1) {
+            printf("Running %d jobs in separate threads\n", nb_jobs);
+        }
+        if (flush_interval) {
+            printf("Sending flush every %d requests\n", flush_interval);
+        }
     }
 
-    buf_size = data.nrreq * data.bufsize;
+    data.stats = g_new0(BlockAcctStats, 1);
+    block_acct_init(data.stats);
+
+    buf_size = (size_t)nb_jobs * data.nrreq * data.bufsize;
     data.buf = blk_blockalign(blk, buf_size);
-    memset(data.buf, pattern, data.nrreq * data.bufsize);
+    memset(data.buf, pattern, buf_size);
 
     blk_register_buf(blk, data.buf, buf_size);
 
-    data.qiov = g_new(QEMUIOVector, data.nrreq);
-    for (i = 0; i < data.nrreq; i++) {
-        qemu_iovec_init(&data.qiov[i], 1);
-        qemu_iovec_add(&data.qiov[i],
-                       data.buf + i * data.bufsize, data.bufsize);
+    data.jobs = g_new0(BenchJob, nb_jobs);
+    for (i = 0; i < nb_jobs; i++) {
+        BenchJob *job = &data.jobs[i];
+        /* Spread sequential jobs over the image */
+        uint64_t job_offset = offset +
+            i * QEMU_ALIGN_DOWN(image_size / nb_jobs, data.bufsize);
+
+        *job = (BenchJob) {
+            .b              = &data,
+            .ctx            = qemu_get_aio_context(),
+            .rand           = g_rand_new_with_seed(i + 1),
+            .reqs           = g_new0(BenchReq, data.nrreq),
+            .free_reqs      = g_new(BenchReq *, data.nrreq),
+            .nb_free_reqs   = data.nrreq,
+            .offset         = job_offset % image_size,
+        };
+        for (j = 0; j < data.nrreq; j++) {
+            BenchReq *req = &job->reqs[j];
+
+            req->job = job;
+            qemu_iovec_init(&req->qiov, 1);
+            qemu_iovec_add(&req->qiov,
+                           data.buf + ((size_t)i * data.nrreq + j) *
+                           data.bufsize,
+                           data.bufsize);
+            job->free_reqs[j] = req;
+        }
+    }
+
+    /* All jobs but a single one run in their own thread and AioContext */
+    if (nb_jobs > 1) {
+        for (i = 0; i < nb_jobs; i++) {
+            BenchJob *job = &data.jobs[i];
+
+            job->ctx = aio_context_new(&local_err);
+            if (!job->ctx ||
+                blk_enable_multiqueue(blk, job->ctx, &local_err) < 0)
+            {
+                error_report_err(local_err);
+                if (job->ctx) {
+                    aio_context_unref(job->ctx);
+                }
+                job->ctx = NULL;
+                ret = -1;
+                goto out;
+            }
+        }
     }
 
-    gettimeofday(&t1, NULL);
-    bench_cb(&data, 0);
+    start_ns = block_acct_clock_ns();
+    data.end_ns = start_ns + run_time * NANOSECONDS_PER_SECOND;
+
+    if (nb_jobs > 1) {
+        for (i = 0; i < nb_jobs; i++) {
+            qemu_thread_create(&data.jobs[i].thread, "bench", bench_thread,
+                               &data.jobs[i], QEMU_THREAD_JOINABLE);
+        }
+    } else {
+        bench_submit(&data.jobs[0]);
+    }
 
-    while (data.n > 0) {
+    while (qatomic_read(&data.running_jobs) > 0) {
         main_loop_wait(false);
     }
-    gettimeofday(&t2, NULL);
 
-    printf("Run completed in %3.3f seconds.\n",
-           (t2.tv_sec - t1.tv_sec)
-           + ((double)(t2.tv_usec - t1.tv_usec) / 1000000));
+    if (nb_jobs > 1) {
+        for (i = 0; i < nb_jobs; i++) {
+            qemu_thread_join(&data.jobs[i].thread);
+        }
+    }
+
+    bench_print_results(&data, block_acct_clock_ns() - start_ns,
+                        output_format);
 
 out:
+    for (i = 0; data.jobs && i < data.nb_jobs; i++) {
+        BenchJob *job = &data.jobs[i];
+
+        if (job->ctx && job->ctx != qemu_get_aio_context()) {
+            blk_disable_multiqueue(blk, job->ctx);
+            aio_context_unref(job->ctx);
+        }
+        for (j = 0; j < data.nrreq; j++) {
+            qemu_iovec_destroy(&job->reqs[j].qiov);
+        }
+        g_free(job->reqs);
+        g_free(job->free_reqs);
+        g_rand_free(job->rand);
+    }
+    g_free(data.jobs);
+    if (data.stats) {
+        block_acct_cleanup(data.stats);
+        g_free(data.stats);
+    }
     if (data.buf) {
         blk_unregister_buf(blk, data.buf);
     }
@@ -16,6 +16,7 @@
 #include <sys/utsname.h>
 #include <sys/wait.h>
 #include <dirent.h>
+#include <zlib.h>
 #include "qemu-common.h"
 #include "guest-agent-core.h"
 #include "qga-qapi-commands.h"
@@ -555,6 +556,247 @@ GuestFileWrite *qmp_guest_file_write(int64_t handle, const char *buf_b64,
     return write_data;
 }
 
+/* See the documentation of guest-file-transfer for the frame format */
+#define GUEST_FILE_TRANSFER_CHUNK      (1 * MiB)
+#define GUEST_FILE_TRANSFER_COMPRESSED 1
+
+typedef struct QEMU_PACKED GuestFileTransferHeader {
+    uint32_t len;
+    uint32_t flags;
+} GuestFileTransferHeader;
+
+static bool transfer_read_full(int fd, void *buf, size_t len, Error **errp)
+{
+    while (len) {
+        ssize_t n = read(fd, buf, len);
+
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            error_setg_errno(errp, errno, "failed to read transfer port");
+            return false;
+        }
+        if (n == 0) {
+            error_setg(errp, "transfer port closed by the host");
+            return false;
+        }
+        buf += n;
+        len -= n;
+    }
+    return true;
+}
+
+static bool transfer_send_frame(int fd, const void *buf, uint32_t len,
+                                uint32_t flags, Error **errp)
+{
+    GuestFileTransferHeader hdr = {
+        .len = cpu_to_be32(len),
+        .flags = cpu_to_be32(flags),
+    };
+
+    if (qemu_write_full(fd, &hdr, sizeof(hdr)) != sizeof(hdr) ||
+        qemu_write_full(fd, buf, len) != len) {
+        error_setg_errno(errp, errno, "failed to write to transfer port");
+        return false;
+    }
+    return true;
+}
+
+static GuestFileTransfer *guest_file_transfer_read(GuestFileHandle *gfh,
+                                                   int fd, int64_t count,
+                                                   bool compress,
+                                                   Error **errp)
+{
+    g_autofree uint8_t *buf = g_malloc(GUEST_FILE_TRANSFER_CHUNK);
+    g_autofree uint8_t *zbuf = NULL;
+    GuestFileTransfer *transfer;
+    Error *local_err = NULL;
+    FILE *fh = gfh->fh;
+    size_t read_count;
+    uLongf zlen;
+
+    /* explicitly flush when switching from writing to reading */
+    if (gfh->state == RW_STATE_WRITING) {
+        int ret = fflush(fh);
+        if (ret == EOF) {
+            error_setg_errno(errp, errno, "failed to flush file");
+            return NULL;
+        }
+        gfh->state = RW_STATE_NEW;
+    }
+
+    if (compress) {
+        zbuf = g_malloc(compressBound(GUEST_FILE_TRANSFER_CHUNK));
+    }
+
+    transfer = g_new0(GuestFileTransfer, 1);
+    while (transfer->count < count) {
+        read_count = fread(buf, 1, MIN(count - transfer->count,
+                                       GUEST_FILE_TRANSFER_CHUNK), fh);
+        if (!read_count) {
+            break;
+        }
+
+        /* send the data uncompressed if compression doesn't help */
+        zlen = compressBound(read_count);
+        if (compress &&
+            compress2(zbuf, &zlen, buf, read_count, Z_BEST_SPEED) == Z_OK &&
+            zlen < read_count) {
+            if (!transfer_send_frame(fd, zbuf, zlen,
+                                     GUEST_FILE_TRANSFER_COMPRESSED,
+                                     &local_err)) {
+                break;
+            }
+        } else if (!transfer_send_frame(fd, buf, read_count, 0, &local_err)) {
+            break;
+        }
+        transfer->count += read_count;
+    }
+
+    if (!local_err && ferror(fh)) {
+        error_setg_errno(&local_err, errno, "failed to read file");
+    }
+    transfer->eof = feof(fh);
+    gfh->state = RW_STATE_READING;
+    clearerr(fh);
+
+    /* end the transfer even on errors, so that the host does not hang */
+    transfer_send_frame(fd, NULL, 0, 0, local_err ? NULL : &local_err);
+
+    if (local_err) {
+        error_propagate(errp, local_err);
+        g_free(transfer);
+        return NULL;
+    }
+    return transfer;
+}
+
+static GuestFileTransfer *guest_file_transfer_write(GuestFileHandle *gfh,
+                                                    int fd, Error **errp)
+{
+    g_autofree uint8_t *buf = g_malloc(GUEST_FILE_TRANSFER_CHUNK);
+    g_autofree uint8_t *zbuf = g_malloc(GUEST_FILE_TRANSFER_CHUNK);
+    GuestFileTransfer *transfer;
+    GuestFileTransferHeader hdr;
+    Error *local_err = NULL;
+    FILE *fh = gfh->fh;
+
+    if (gfh->state == RW_STATE_READING) {
+        int ret = fseek(fh, 0, SEEK_CUR);
+        if (ret == -1) {
+            error_setg_errno(errp, errno, "failed to seek file");
+            return NULL;
+        }
+        gfh->state = RW_STATE_NEW;
+    }
+
+    transfer = g_new0(GuestFileTransfer, 1);
+    for (;;) {
+        uint32_t len, flags;
+        uint8_t *data = zbuf;
+        uLongf data_len;
+
+        if (!transfer_read_full(fd, &hdr, sizeof(hdr), errp)) {
+            goto fail;
+        }
+        len = be32_to_cpu(hdr.len);
+        flags = be32_to_cpu(hdr.flags);
+        if (!len) {
+            break;
+        }
+        if (len > GUEST_FILE_TRANSFER_CHUNK) {
+            error_setg(errp, "transfer frame of %" PRIu32 " bytes is too big",
+                       len);
+            goto fail;
+        }
+        if (!transfer_read_full(fd, zbuf, len, errp)) {
+            goto fail;
+        }
+
+        /* after an error, consume the rest of the transfer */
+        if (local_err) {
+            continue;
+        }
+
+        data_len = len;
+        if (flags & GUEST_FILE_TRANSFER_COMPRESSED) {
+            data = buf;
+            data_len = GUEST_FILE_TRANSFER_CHUNK;
+            if (uncompress(buf, &data_len, zbuf, len) != Z_OK) {
+                error_setg(&local_err, "failed to decompress transfer frame");
+                continue;
+            }
+        }
+
+        if (fwrite(data, 1, data_len, fh) != data_len) {
+            error_setg_errno(&local_err, errno, "failed to write to file");
+            continue;
+        }
+        transfer->count += data_len;
+    }
+
+    gfh->state = RW_STATE_WRITING;
+    transfer->eof = feof(fh);
+    clearerr(fh);
+
+    if (local_err) {
+        error_propagate(errp, local_err);
+        g_free(transfer);
+        return NULL;
+    }
+    return transfer;
+
+fail:
+    gfh->state = RW_STATE_WRITING;
+    clearerr(fh);
+    error_free(local_err);
+    g_free(transfer);
+    return NULL;
+}
+
+GuestFileTransfer *qmp_guest_file_transfer(int64_t handle,
+                                           GuestFileTransferDirection direction,
+                                           bool has_count, int64_t count,
+                                           bool has_compress, bool compress,
+                                           Error **errp)
+{
+    GuestFileHandle *gfh = guest_file_handle_find(handle, errp);
+    const char *path = ga_transfer_path(ga_state);
+    GuestFileTransfer *transfer;
+    int fd;
+
+    if (!gfh) {
+        return NULL;
+    }
+    if (!has_count) {
+        count = INT64_MAX;
+    } else if (count < 0) {
+        error_setg(errp, "value '%" PRId64 "' is invalid for argument count",
+                   count);
+        return NULL;
+    }
+
+    fd = qemu_open_old(path, O_RDWR | O_NOCTTY);
+    if (fd < 0) {
+        error_setg_errno(errp, errno, "failed to open transfer port %s", path);
+        return NULL;
+    }
+
+    if (direction == GUEST_FILE_TRANSFER_DIRECTION_READ) {
+        transfer = guest_file_transfer_read(gfh, fd, count,
+                                            has_compress && compress, errp);
+    } else {
+        transfer = guest_file_transfer_write(gfh, fd, errp);
+    }
+    close(fd);
+
+    if (!transfer) {
+        slog("guest-file-transfer failed, handle: %" PRId64, handle);
+    }
+    return transfer;
+}
+
 struct GuestFileSeek *qmp_guest_file_seek(int64_t handle, int64_t offset,
                                           GuestFileWhence *whence_code,
                                           Error **errp)
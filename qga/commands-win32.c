@@ -424,6 +424,16 @@ done:
     return write_data;
 }
 
+GuestFileTransfer *qmp_guest_file_transfer(int64_t handle,
+                                           GuestFileTransferDirection direction,
+                                           bool has_count, int64_t count,
+                                           bool has_compress, bool compress,
+                                           Error **errp)
+{
+    error_setg(errp, QERR_UNSUPPORTED);
+    return NULL;
+}
+
 GuestFileSeek *qmp_guest_file_seek(int64_t handle, int64_t offset,
                                    GuestFileWhence *whence_code,
                                    Error **errp)
@@ -2012,6 +2022,7 @@ GList *ga_command_blacklist_init(GList *blacklist)
         "guest-set-vcpus",
         "guest-get-memory-blocks", "guest-set-memory-blocks",
         "guest-get-memory-block-size", "guest-get-memory-block-info",
+        "guest-file-transfer",
         NULL};
     char **p = (char **)list_unsupported;
 
@@ -47,6 +47,7 @@
 
 #ifndef _WIN32
 #define QGA_VIRTIO_PATH_DEFAULT "/dev/virtio-ports/org.qemu.guest_agent.0"
+#define QGA_TRANSFER_PATH_DEFAULT "/dev/virtio-ports/org.qemu.guest_agent.1"
 #define QGA_STATE_RELATIVE_DIR  "run"
 #define QGA_SERIAL_PATH_DEFAULT "/dev/ttyS0"
 #else
@@ -96,6 +97,9 @@ struct GAState {
     } deferred_options;
 #ifdef CONFIG_FSFREEZE
     const char *fsfreeze_hook;
+#endif
+#ifndef _WIN32
+    const char *transfer_path;
 #endif
     gchar *pstate_filepath;
     GAPersistentState pstate;
@@ -249,6 +253,11 @@ QEMU_COPYRIGHT "\n"
 "                    space.\n"
 "                    (for example: -F/var/run/fsfreezehook.sh)\n"
 #endif
+#ifndef _WIN32
+"  -T, --transfer-path\n"
+"                    device path for guest-file-transfer (default is\n"
+"                    %s)\n"
+#endif
 "  -t, --statedir    specify dir to store state information (absolute paths\n"
 "                    only, default is %s)\n"
 "  -v, --verbose     log extra debugging information\n"
@@ -272,6 +281,9 @@ QEMU_HELP_BOTTOM "\n"
     dfl_pathnames.pidfile,
 #ifdef CONFIG_FSFREEZE
     QGA_FSFREEZE_HOOK_DEFAULT,
+#endif
+#ifndef _WIN32
+    QGA_TRANSFER_PATH_DEFAULT,
 #endif
     dfl_pathnames.state_dir);
 }
@@ -479,6 +491,13 @@ const char *ga_fsfreeze_hook(GAState *s)
 }
 #endif
 
+#ifndef _WIN32
+const char *ga_transfer_path(GAState *s)
+{
+    return s->transfer_path ?: QGA_TRANSFER_PATH_DEFAULT;
+}
+#endif
+
 static void become_daemon(const char *pidfile)
 {
 #ifndef _WIN32
@@ -943,6 +962,9 @@ struct GAConfig {
     char *pid_filepath;
 #ifdef CONFIG_FSFREEZE
     char *fsfreeze_hook;
+#endif
+#ifndef _WIN32
+    char *transfer_path;
 #endif
     char *state_dir;
 #ifdef _WIN32
@@ -993,6 +1015,13 @@ static void config_load(GAConfig *config)
             g_key_file_get_string(keyfile,
                                   "general", "fsfreeze-hook", &gerr);
     }
+#endif
+#ifndef _WIN32
+    if (g_key_file_has_key(keyfile, "general", "transfer-path", NULL)) {
+        config->transfer_path =
+            g_key_file_get_string(keyfile,
+                                  "general", "transfer-path", &gerr);
+    }
 #endif
     if (g_key_file_has_key(keyfile, "general", "statedir", NULL)) {
         config->state_dir =
@@ -1064,6 +1093,12 @@ static void config_dump(GAConfig *config)
         g_key_file_set_string(keyfile, "general", "fsfreeze-hook",
                               config->fsfreeze_hook);
     }
+#endif
+#ifndef _WIN32
+    if (config->transfer_path) {
+        g_key_file_set_string(keyfile, "general", "transfer-path",
+                              config->transfer_path);
+    }
 #endif
     g_key_file_set_string(keyfile, "general", "statedir", config->state_dir);
     g_key_file_set_boolean(keyfile, "general", "verbose",
@@ -1088,7 +1123,7 @@ static void config_dump(GAConfig *config)
 
 static void config_parse(GAConfig *config, int argc, char **argv)
 {
-    const char *sopt = "hVvdm:p:l:f:F::b:s:t:Dr";
+    const char *sopt = "hVvdm:p:l:f:F::b:s:t:T:Dr";
     int opt_ind = 0, ch;
     const struct option lopt[] = {
         { "help", 0, NULL, 'h' },
@@ -1108,6 +1143,9 @@ static void config_parse(GAConfig *config, int argc, char **argv)
         { "service", 1, NULL, 's' },
 #endif
         { "statedir", 1, NULL, 't' },
+#ifndef _WIN32
+        { "transfer-path", 1, NULL, 'T' },
+#endif
         { "retry-path", 0, NULL, 'r' },
         { NULL, 0, NULL, 0 }
     };
@@ -1140,6 +1178,12 @@ static void config_parse(GAConfig *config, int argc, char **argv)
             g_free(config->state_dir);
             config->state_dir = g_strdup(optarg);
             break;
+#ifndef _WIN32
+        case 'T':
+            g_free(config->transfer_path);
+            config->transfer_path = g_strdup(optarg);
+            break;
+#endif
         case 'v':
             /* enable all log levels */
             config->log_level = G_LOG_LEVEL_MASK;
@@ -1215,6 +1259,9 @@ static void config_free(GAConfig *config)
     g_free(config->bliststr);
 #ifdef CONFIG_FSFREEZE
     g_free(config->fsfreeze_hook);
+#endif
+#ifndef _WIN32
+    g_free(config->transfer_path);
 #endif
     g_list_free_full(config->blacklist, g_free);
     g_free(config);
@@ -1263,6 +1310,9 @@ static GAState *initialize_agent(GAConfig *config, int socket_activation)
     s->log_file = stderr;
 #ifdef CONFIG_FSFREEZE
     s->fsfreeze_hook = config->fsfreeze_hook;
+#endif
+#ifndef _WIN32
+    s->transfer_path = config->transfer_path;
 #endif
     s->pstate_filepath = g_strdup_printf("%s/qga.state", config->state_dir);
     s->state_filepath_isfrozen = g_strdup_printf("%s/qga.state.isfrozen",
@@ -342,12 +342,46 @@ static void json_lexer_feed_char(JSONLexer *lexer, char ch, bool flush)
     }
 }
 
-void json_lexer_feed(JSONLexer *lexer, const char *buffer, size_t size)
+/*
+ * Return how many characters at @buffer just extend the string token
+ * being lexed.  These can be consumed in bulk instead of feeding them
+ * one by one through json_lexer_feed_char().
+ */
+static size_t json_lexer_string_span(JSONLexer *lexer, const char *buffer,
+                                     size_t size)
 {
-    size_t i;
+    const uint8_t *row;
+    size_t i, max;
+
+    if (lexer->state != IN_DQ_STRING && lexer->state != IN_SQ_STRING) {
+        return 0;
+    }
+    if (lexer->token->len >= MAX_TOKEN_SIZE) {
+        return 0;
+    }
 
-    for (i = 0; i < size; i++) {
-        json_lexer_feed_char(lexer, buffer[i], false);
+    row = json_lexer[lexer->state];
+    max = MIN(size, MAX_TOKEN_SIZE - lexer->token->len);
+    for (i = 0; i < max && row[(uint8_t)buffer[i]] == lexer->state; i++) {
+        ;
+    }
+    return i;
+}
+
+void json_lexer_feed(JSONLexer *lexer, const char *buffer, size_t size)
+{
+    size_t i, n;
+
+    for (i = 0; i < size; i += n) {
+        n = json_lexer_string_span(lexer, buffer + i, size - i);
+        if (n) {
+            /* no newlines in strings, so only x moves */
+            g_string_append_len(lexer->token, buffer + i, n);
+            lexer->x += n;
+        } else {
+            json_lexer_feed_char(lexer, buffer[i], false);
+            n = 1;
+        }
     }
 }
 
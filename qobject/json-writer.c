@@ -111,6 +111,17 @@ static void quoted_str(JSONWriter *writer, const char *str)
     g_string_append_c(writer->contents, '"');
 
     for (ptr = str; *ptr; ptr = end) {
+        /* Copy runs of printable ASCII that need no escaping at once */
+        for (end = (char *)ptr;
+             *end >= 0x20 && *end < 0x7F && *end != '"' && *end != '\\';
+             end++) {
+            ;
+        }
+        if (end != ptr) {
+            g_string_append_len(writer->contents, ptr, end - ptr);
+            continue;
+        }
+
         cp = mod_utf8_codepoint(ptr, 6, &end);
         switch (cp) {
         case '\"':
@@ -0,0 +1,262 @@
+#!/usr/bin/env python3
+#
+# Benchmark the block exports of qemu-storage-daemon
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+
+"""
+Start qemu-storage-daemon with one block node exported over NBD,
+vhost-user-blk or FUSE, and drive the export with fio at several queue
+depths and IOThread counts.  Each run reports IOPS, completion latency
+percentiles and the CPU time spent per I/O, both in the daemon and in
+fio.
+
+fio needs the nbd engine for NBD and the libblkio engine (fio 3.34 or
+newer) for vhost-user-blk.  FUSE exports are accessed with libaio.
+"""
+
+import argparse
+import json
+import os
+import shutil
+import subprocess
+import tempfile
+import time
+
+import simplebench
+from results_to_text import results_to_text
+
+
+IMAGE_SIZE = '4G'
+
+
+def node_args(node, tmpdir, qemu_img):
+    """Return the --blockdev options for one of the node types"""
+    if node == 'null-co':
+        return [f'driver=null-co,node-name=disk,size={IMAGE_SIZE},'
+                'read-zeroes=on']
+
+    fname = os.path.join(tmpdir, f'bench.{node}')
+    if node == 'file':
+        subprocess.run([qemu_img, 'create', '-f', 'raw', '-o',
+                        'preallocation=full', fname, IMAGE_SIZE],
+                       stdout=subprocess.DEVNULL, check=True)
+        return [f'driver=file,node-name=disk,filename={fname},'
+                'cache.direct=on,aio=native']
+
+    assert node == 'qcow2'
+    subprocess.run([qemu_img, 'create', '-f', 'qcow2', '-o',
+                    'preallocation=metadata', fname, IMAGE_SIZE],
+                   stdout=subprocess.DEVNULL, check=True)
+    return [f'driver=file,node-name=proto,filename={fname},'
+            'cache.direct=on,aio=native',
+            'driver=qcow2,node-name=disk,file=proto']
+
+
+def export_args(export, iothreads, tmpdir):
+    """Return the qemu-storage-daemon options for the export, the fio
+    options to access it and the path of its socket or mountpoint"""
+    iothread_list = [f'iothread{i}' for i in range(iothreads)]
+    args = []
+    for t in iothread_list:
+        args += ['--object', f'iothread,id={t}']
+
+    if export == 'nbd':
+        sock = os.path.join(tmpdir, 'nbd.sock')
+        # NBD exports run in a single IOThread; each fio job opens its
+        # own connection, which writable exports allow with multi-conn
+        args += ['--nbd-server', f'addr.type=unix,addr.path={sock}',
+                 '--export', 'type=nbd,id=exp,node-name=disk,name=exp,'
+                 f'writable=on,iothread={iothread_list[0]}']
+        fio = ['--ioengine=nbd', f'--uri=nbd+unix:///exp?socket={sock}',
+               f'--numjobs={iothreads}']
+        return args, fio, sock
+
+    if export == 'vhost-user-blk':
+        sock = os.path.join(tmpdir, 'vhost-user-blk.sock')
+        threads = ''.join(f',iothreads.{i}={t}'
+                          for i, t in enumerate(iothread_list))
+        args += ['--export', 'type=vhost-user-blk,id=exp,node-name=disk,'
+                 f'addr.type=unix,addr.path={sock},writable=on,'
+                 f'num-queues={iothreads}{threads}']
+        fio = ['--ioengine=libblkio',
+               '--libblkio_driver=virtio-blk-vhost-user',
+               f'--libblkio_path={sock}']
+        return args, fio, sock
+
+    assert export == 'fuse'
+    mountpoint = os.path.join(tmpdir, 'fuse.img')
+    open(mountpoint, 'w').close()
+    threads = ''.join(f',iothreads.{i}={t}'
+                      for i, t in enumerate(iothread_list))
+    args += ['--export', 'type=fuse,id=exp,node-name=disk,'
+             f'mountpoint={mountpoint},writable=on{threads}']
+    fio = ['--ioengine=libaio', '--direct=1', f'--filename={mountpoint}',
+           f'--numjobs={iothreads}']
+    return args, fio, mountpoint
+
+
+def proc_cpu_seconds(pid):
+    """User plus system CPU time of a process"""
+    with open(f'/proc/{pid}/stat') as f:
+        # the command name may contain spaces, skip over it
+        fields = f.read().rsplit(')', 1)[1].split()
+    return (int(fields[11]) + int(fields[12])) / os.sysconf('SC_CLK_TCK')
+
+
+def is_mounted(path):
+    with open('/proc/self/mounts') as f:
+        return any(line.split()[1] == path for line in f)
+
+
+def wait_for_export(qsd, export, path, timeout=10):
+    """Wait until the daemon listens on the socket @path, or has mounted
+    the FUSE export on @path"""
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        if qsd.poll() is not None:
+            return False
+        if is_mounted(path) if export == 'fuse' else os.path.exists(path):
+            return True
+        time.sleep(0.1)
+    return False
+
+
+def fio_summary(out, runtime):
+    """Extract the results of a fio JSON report"""
+    ios = 0
+    iops = 0.0
+    clat = {}
+    cpu = 0.0
+    for job in out['jobs']:
+        for rw in ('read', 'write'):
+            d = job[rw]
+            ios += d['total_ios']
+            iops += d['iops']
+            if d['total_ios'] and not clat:
+                clat = d['clat_ns'].get('percentile', {})
+        cpu += (job['usr_cpu'] + job['sys_cpu']) / 100 * runtime
+
+    res = {'iops': iops, 'ios': ios, 'fio-cpu-us-per-io':
+           cpu * 1e6 / ios if ios else 0}
+    for p, key in (('50.000000', 'p50'), ('99.000000', 'p99'),
+                   ('99.900000', 'p99.9')):
+        if p in clat:
+            res[f'lat-{key}-us'] = clat[p] / 1000
+    return res
+
+
+def bench_export(env, case):
+    tmpdir = tempfile.mkdtemp(prefix='bench-qsd-')
+    qsd = None
+    try:
+        blockdevs = node_args(case['node'], tmpdir, env['qemu-img'])
+        args, fio_args, path = export_args(case['export'], env['iothreads'],
+                                           tmpdir)
+        cmd = [env['qsd']]
+        for b in blockdevs:
+            cmd += ['--blockdev', b]
+        cmd += args
+
+        qsd = subprocess.Popen(cmd, stdout=subprocess.PIPE,
+                               stderr=subprocess.STDOUT,
+                               universal_newlines=True)
+        if not wait_for_export(qsd, case['export'], path):
+            qsd.kill()
+            return {'error': 'qemu-storage-daemon failed: ' +
+                    qsd.communicate()[0]}
+
+        cpu_start = proc_cpu_seconds(qsd.pid)
+        p = subprocess.run([env['fio'], '--name=bench', '--output-format=json',
+                            f"--rw={env['rw']}", f"--bs={env['bs']}",
+                            f"--iodepth={case['qd']}", '--time_based',
+                            f"--runtime={env['runtime']}",
+                            f'--size={IMAGE_SIZE}']
+                           + fio_args,
+                           stdout=subprocess.PIPE, stderr=subprocess.PIPE,
+                           universal_newlines=True)
+        qsd_cpu = proc_cpu_seconds(qsd.pid) - cpu_start
+
+        if p.returncode != 0:
+            return {'error': f'fio failed: {p.returncode}: {p.stderr}'}
+        try:
+            res = fio_summary(json.loads(p.stdout), env['runtime'])
+        except (ValueError, KeyError) as e:
+            return {'error': f'failed to parse fio output: {e}'}
+
+        if res['ios']:
+            res['qsd-cpu-us-per-io'] = qsd_cpu * 1e6 / res['ios']
+        return res
+    finally:
+        if qsd and qsd.poll() is None:
+            qsd.terminate()
+            try:
+                qsd.wait(timeout=10)
+            except subprocess.TimeoutExpired:
+                qsd.kill()
+        shutil.rmtree(tmpdir, ignore_errors=True)
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(
+        description='Benchmark qemu-storage-daemon block exports')
+    parser.add_argument('--qsd', default='storage-daemon/qemu-storage-daemon',
+                        help='qemu-storage-daemon binary')
+    parser.add_argument('--qemu-img', default='qemu-img',
+                        help='qemu-img binary, used to create the images')
+    parser.add_argument('--fio', default='fio', help='fio binary')
+    parser.add_argument('--nodes', default='null-co,file,qcow2',
+                        help='comma separated node types')
+    parser.add_argument('--exports', default='nbd,vhost-user-blk,fuse',
+                        help='comma separated export types')
+    parser.add_argument('--queue-depths', default='1,16,64',
+                        help='comma separated fio queue depths')
+    parser.add_argument('--iothreads', default='1,2,4',
+                        help='comma separated IOThread counts')
+    parser.add_argument('--rw', default='randread', help='fio I/O pattern')
+    parser.add_argument('--bs', default='4k', help='fio block size')
+    parser.add_argument('--runtime', type=int, default=10,
+                        help='seconds per run')
+    parser.add_argument('--count', type=int, default=3,
+                        help='runs per test case')
+    parser.add_argument('--json', default='results.json',
+                        help='file to write the results to')
+    opts = parser.parse_args()
+
+    envs = [{
+        'id': f'{n} iothread(s)',
+        'qsd': opts.qsd,
+        'qemu-img': opts.qemu_img,
+        'fio': opts.fio,
+        'iothreads': int(n),
+        'rw': opts.rw,
+        'bs': opts.bs,
+        'runtime': opts.runtime
+    } for n in opts.iothreads.split(',')]
+
+    cases = [{
+        'id': f'{node} {export} qd{qd}',
+        'node': node,
+        'export': export,
+        'qd': int(qd)
+    } for node in opts.nodes.split(',')
+      for export in opts.exports.split(',')
+      for qd in opts.queue_depths.split(',')]
+
+    result = simplebench.bench(bench_export, envs, cases, count=opts.count,
+                               initial_run=False)
+    print(results_to_text(result))
+    with open(opts.json, 'w') as f:
+        json.dump(result, f, indent=4)
@@ -0,0 +1,103 @@
+#!/usr/bin/env python3
+#
+# Benchmark TCG translation throughput with multi-threaded TCG
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+
+
+import sys
+import os
+import re
+import time
+
+sys.path.append(os.path.join(os.path.dirname(__file__), '..', '..', 'python'))
+from qemu.machine import QEMUMachine
+
+import simplebench
+from results_to_text import results_to_text
+
+
+def jit_stats(vm):
+    """Return the counters of "info jit" as a dict of int"""
+    out = vm.qmp('human-monitor-command', command_line='info jit')['return']
+    stats = {}
+    for key in ('TB count', 'TB shared count', 'TB flush count',
+                'TB evict count'):
+        m = re.search(r'^' + key + r'\s+(\d+)', out, re.MULTILINE)
+        if m:
+            stats[key] = int(m.group(1))
+    return stats
+
+
+def bench_tb_gen(qemu_args, seconds):
+    """Boot a guest and measure how many TBs are generated per second
+
+    qemu_args -- list of QEMU command line arguments, including the binary
+    seconds   -- how long to let the guest run
+
+    Returns {'iops': float} with the number of TBs generated per second,
+    plus the raw "info jit" counters, or {'error': str}.
+    """
+    vm = QEMUMachine(qemu_args[0], args=qemu_args[1:] + ['-S'])
+
+    try:
+        vm.launch()
+    except Exception as e:
+        return {'error': 'qemu failed: ' + str(e)}
+
+    try:
+        vm.qmp('cont')
+        start = time.monotonic()
+        time.sleep(seconds)
+        stats = jit_stats(vm)
+        elapsed = time.monotonic() - start
+    finally:
+        vm.shutdown()
+
+    if 'TB count' not in stats:
+        return {'error': 'could not parse "info jit"'}
+    if stats.get('TB flush count') or stats.get('TB evict count'):
+        # the live TB count no longer matches what was generated
+        return {'error': 'code buffer filled up, use a shorter run: ' +
+                str(stats)}
+
+    return dict(stats, iops=stats['TB count'] / elapsed)
+
+
+def bench_func(env, case):
+    return bench_tb_gen([env['qemu-binary'],
+                         '-accel', 'tcg,thread=multi',
+                         '-smp', str(case['smp'])] + env['args'],
+                        env['seconds'])
+
+
+if __name__ == '__main__':
+    if len(sys.argv) < 3:
+        print(f'USAGE: {sys.argv[0]} <seconds> <qemu binary> [qemu args...]')
+        print('Runs the guest with an increasing number of vCPUs, e.g.')
+        print(f'  {sys.argv[0]} 10 qemu-system-aarch64 -M virt '
+              '-cpu max -kernel Image -append console=ttyAMA0 -nographic')
+        exit(1)
+
+    envs = [{
+        'id': 'tb/s',
+        'seconds': float(sys.argv[1]),
+        'qemu-binary': sys.argv[2],
+        'args': sys.argv[3:]
+    }]
+    cases = [{'id': f'smp {n}', 'smp': n} for n in (1, 2, 4, 8, 16, 32)]
+
+    result = simplebench.bench(bench_func, envs, cases, count=3)
+    print(results_to_text(result))
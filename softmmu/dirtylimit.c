@@ -0,0 +1,88 @@
+/*
+ * Per-vCPU dirty page rate limit
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/atomic.h"
+#include "qemu/timer.h"
+#include "qemu/units.h"
+#include "exec/cpu-common.h"
+#include "hw/core/cpu.h"
+#include "sysemu/dirtylimit.h"
+#include "trace.h"
+
+/*
+ * Upper bound for one sleep, so that a vCPU that suddenly dirties a lot
+ * of memory gets back to work quickly once it calms down.
+ */
+#define DIRTYLIMIT_THROTTLE_MAX_US (500 * 1000)
+/* Sleep in slices so that a vCPU asked to stop doesn't keep others waiting */
+#define DIRTYLIMIT_THROTTLE_SLICE_US (10 * 1000)
+
+/* Dirty page rate limit in target pages per second, 0 if not in service */
+static unsigned long dirtylimit_quota_pages;
+
+void dirtylimit_set_quota(uint64_t quota)
+{
+    uint64_t pages = quota * MiB / TARGET_PAGE_SIZE;
+
+    trace_dirtylimit_set_quota(quota);
+    qatomic_set(&dirtylimit_quota_pages, MIN(pages, ULONG_MAX));
+}
+
+bool dirtylimit_in_service(void)
+{
+    return qatomic_read(&dirtylimit_quota_pages) != 0;
+}
+
+void dirtylimit_vcpu_execute(CPUState *cpu)
+{
+    unsigned long quota = qatomic_read(&dirtylimit_quota_pages);
+    int64_t now = qemu_clock_get_us(QEMU_CLOCK_REALTIME);
+    uint64_t pages = cpu->dirty_pages;
+    int64_t sleep_us;
+
+    if (!quota) {
+        cpu->throttle_us_per_full = 0;
+        cpu->dirtylimit_stamp = 0;
+        return;
+    }
+
+    if (cpu->dirtylimit_stamp) {
+        /*
+         * The stamp is taken after the previous sleep, so this compares
+         * the time the vCPU actually ran with the time the pages it
+         * dirtied meanwhile are allowed to take.
+         */
+        int64_t allowed = (pages - cpu->dirtylimit_pages) *
+                          G_USEC_PER_SEC / quota;
+        int64_t busy = now - cpu->dirtylimit_stamp;
+
+        cpu->throttle_us_per_full = MIN(MAX(allowed - busy, 0),
+                                        DIRTYLIMIT_THROTTLE_MAX_US);
+    }
+    trace_dirtylimit_vcpu_execute(cpu->cpu_index, cpu->throttle_us_per_full);
+
+    sleep_us = cpu->throttle_us_per_full;
+    while (sleep_us > 0 && !cpu->stop) {
+        g_usleep(MIN(sleep_us, DIRTYLIMIT_THROTTLE_SLICE_US));
+        sleep_us -= DIRTYLIMIT_THROTTLE_SLICE_US;
+    }
+
+    cpu->dirtylimit_pages = pages;
+    cpu->dirtylimit_stamp = qemu_clock_get_us(QEMU_CLOCK_REALTIME);
+}
+
+uint64_t dirtylimit_throttle_time_max(void)
+{
+    uint64_t max = 0;
+    CPUState *cpu;
+
+    CPU_FOREACH(cpu) {
+        max = MAX(max, cpu->throttle_us_per_full);
+    }
+    return max;
+}
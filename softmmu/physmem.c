@@ -87,6 +87,12 @@
  */
 RAMList ram_list = { .blocks = QLIST_HEAD_INITIALIZER(ram_list.blocks) };
 
+/*
+ * Pages reported dirty by the dirty log while GLOBAL_DIRTY_DIRTY_RATE
+ * tracking is enabled, consumed by the dirty rate measurement.
+ */
+uint64_t total_dirty_pages;
+
 static MemoryRegion *system_memory;
 static MemoryRegion *system_io;
 
@@ -1590,6 +1596,7 @@ static void *file_ram_alloc(RAMBlock *block,
     }
 
     block->fd = fd;
+    block->fd_offset = offset;
     return area;
 }
 #endif
@@ -2712,7 +2719,7 @@ static bool prepare_mmio_access(MemoryRegion *mr)
 {
     bool release_lock = false;
 
-    if (!qemu_mutex_iothread_locked()) {
+    if (mr->global_locking && !qemu_mutex_iothread_locked()) {
         qemu_mutex_lock_iothread();
         release_lock = true;
     }
@@ -2891,6 +2898,135 @@ MemTxResult address_space_rw(AddressSpace *as, hwaddr addr, MemTxAttrs attrs,
     }
 }
 
+/*
+ * One contiguous RAM range of an AddressSpace, as last seen by a DMA
+ * access.  Entries are immutable once published; they are replaced as a
+ * whole and freed after a grace period.
+ */
+struct AddressSpaceXlatCache {
+    struct rcu_head rcu;
+    FlatView *fv;           /* view the translation comes from, referenced */
+    MemoryRegion *mr;
+    hwaddr addr;            /* start of the range in the AddressSpace */
+    hwaddr len;
+    hwaddr xlat;            /* offset of @addr within @mr */
+    uint8_t *ptr;           /* host address of @addr */
+    bool writable;
+};
+
+static void address_space_xlat_cache_free(AddressSpaceXlatCache *xc)
+{
+    flatview_unref(xc->fv);
+    g_free(xc);
+}
+
+static void address_space_xlat_cache_set(AddressSpace *as,
+                                         AddressSpaceXlatCache *xc)
+{
+    AddressSpaceXlatCache *old = qatomic_xchg(&as->xlat_cache, xc);
+
+    if (old) {
+        call_rcu(old, address_space_xlat_cache_free, rcu);
+    }
+}
+
+void address_space_enable_xlat_cache(AddressSpace *as)
+{
+    as->xlat_cache_enabled = true;
+}
+
+void address_space_xlat_cache_reset(AddressSpace *as)
+{
+    if (qatomic_read(&as->xlat_cache)) {
+        address_space_xlat_cache_set(as, NULL);
+    }
+}
+
+/* Called within RCU critical section.  */
+static AddressSpaceXlatCache *address_space_xlat_cache_fill(AddressSpace *as,
+                                                            hwaddr addr,
+                                                            bool is_write)
+{
+    AddressSpaceXlatCache *xc;
+    MemoryRegionSection *section;
+    MemoryRegion *mr;
+    FlatView *fv;
+    hwaddr xlat, l = 1;
+
+    if (xen_enabled()) {
+        /* RAM is only mapped on demand through the map cache */
+        return NULL;
+    }
+
+    fv = address_space_get_flatview(as);
+    section = address_space_translate_internal(flatview_to_dispatch(fv),
+                                               addr, &xlat, &l, true);
+    mr = section->mr;
+
+    /*
+     * IOMMU mappings can change without a new FlatView, so they are not
+     * cached; neither is anything that needs a dispatch to the device.
+     */
+    if (memory_region_get_iommu(mr) || !memory_access_is_direct(mr, is_write)) {
+        flatview_unref(fv);
+        return NULL;
+    }
+
+    xc = g_new(AddressSpaceXlatCache, 1);
+    xc->fv = fv;
+    xc->mr = mr;
+    xc->addr = section->offset_within_address_space;
+    xc->xlat = section->offset_within_region;
+    xc->len = int128_get64(int128_min(section->size,
+                                      int128_make64(UINT64_MAX)));
+    xc->ptr = qemu_ram_ptr_length(mr->ram_block, xc->xlat, &xc->len, false);
+    xc->writable = memory_access_is_direct(mr, true);
+    address_space_xlat_cache_set(as, xc);
+
+    return xc;
+}
+
+static bool address_space_xlat_cache_hit(AddressSpace *as,
+                                         AddressSpaceXlatCache *xc,
+                                         hwaddr addr, hwaddr len,
+                                         bool is_write)
+{
+    return xc && xc->fv == qatomic_rcu_read(&as->current_map)
+        && addr >= xc->addr && len <= xc->len
+        && addr - xc->addr <= xc->len - len
+        && (!is_write || xc->writable);
+}
+
+MemTxResult address_space_rw_xlat_cached(AddressSpace *as, hwaddr addr,
+                                         MemTxAttrs attrs, void *buf,
+                                         hwaddr len, bool is_write)
+{
+    AddressSpaceXlatCache *xc;
+    hwaddr offset;
+
+    if (!as->xlat_cache_enabled || len == 0) {
+        return address_space_rw(as, addr, attrs, buf, len, is_write);
+    }
+
+    RCU_READ_LOCK_GUARD();
+    xc = qatomic_rcu_read(&as->xlat_cache);
+    if (!address_space_xlat_cache_hit(as, xc, addr, len, is_write)) {
+        xc = address_space_xlat_cache_fill(as, addr, is_write);
+        if (!address_space_xlat_cache_hit(as, xc, addr, len, is_write)) {
+            return address_space_rw(as, addr, attrs, buf, len, is_write);
+        }
+    }
+
+    offset = addr - xc->addr;
+    if (is_write) {
+        memcpy(xc->ptr + offset, buf, len);
+        invalidate_and_set_dirty(xc->mr, xc->xlat + offset, len);
+    } else {
+        memcpy(buf, xc->ptr + offset, len);
+    }
+    return MEMTX_OK;
+}
+
 void cpu_physical_memory_rw(hwaddr addr, void *buf,
                             hwaddr len, bool is_write)
 {
@@ -2970,53 +3106,47 @@ void cpu_flush_icache_range(hwaddr start, hwaddr len)
                                      NULL, len, FLUSH_CACHE);
 }
 
-typedef struct {
+typedef struct BounceBuffer {
     MemoryRegion *mr;
-    void *buffer;
     hwaddr addr;
-    hwaddr len;
-    bool in_use;
+    size_t len;
+    QLIST_ENTRY(BounceBuffer) link;
+    uint8_t buffer[];
 } BounceBuffer;
 
-static BounceBuffer bounce;
-
-typedef struct MapClient {
+typedef struct AddressSpaceMapClient {
     QEMUBH *bh;
-    QLIST_ENTRY(MapClient) link;
-} MapClient;
-
-QemuMutex map_client_list_lock;
-static QLIST_HEAD(, MapClient) map_client_list
-    = QLIST_HEAD_INITIALIZER(map_client_list);
+    QLIST_ENTRY(AddressSpaceMapClient) link;
+} AddressSpaceMapClient;
 
-static void cpu_unregister_map_client_do(MapClient *client)
+static void address_space_map_client_free(AddressSpaceMapClient *client)
 {
     QLIST_REMOVE(client, link);
     g_free(client);
 }
 
-static void cpu_notify_map_clients_locked(void)
+static void address_space_notify_map_clients_locked(AddressSpace *as)
 {
-    MapClient *client;
+    AddressSpaceMapClient *client;
 
-    while (!QLIST_EMPTY(&map_client_list)) {
-        client = QLIST_FIRST(&map_client_list);
+    while (!QLIST_EMPTY(&as->map_client_list)) {
+        client = QLIST_FIRST(&as->map_client_list);
         qemu_bh_schedule(client->bh);
-        cpu_unregister_map_client_do(client);
+        address_space_map_client_free(client);
     }
 }
 
-void cpu_register_map_client(QEMUBH *bh)
+void address_space_register_map_client(AddressSpace *as, QEMUBH *bh)
 {
-    MapClient *client = g_malloc(sizeof(*client));
+    AddressSpaceMapClient *client = g_malloc(sizeof(*client));
 
-    qemu_mutex_lock(&map_client_list_lock);
+    qemu_mutex_lock(&as->map_lock);
     client->bh = bh;
-    QLIST_INSERT_HEAD(&map_client_list, client, link);
-    if (!qatomic_read(&bounce.in_use)) {
-        cpu_notify_map_clients_locked();
+    QLIST_INSERT_HEAD(&as->map_client_list, client, link);
+    if (as->bounce_buffer_size < as->max_bounce_buffer_size) {
+        address_space_notify_map_clients_locked(as);
     }
-    qemu_mutex_unlock(&map_client_list_lock);
+    qemu_mutex_unlock(&as->map_lock);
 }
 
 void cpu_exec_init_all(void)
@@ -3032,28 +3162,20 @@ void cpu_exec_init_all(void)
     finalize_target_page_bits();
     io_mem_init();
     memory_map_init();
-    qemu_mutex_init(&map_client_list_lock);
 }
 
-void cpu_unregister_map_client(QEMUBH *bh)
+void address_space_unregister_map_client(AddressSpace *as, QEMUBH *bh)
 {
-    MapClient *client;
+    AddressSpaceMapClient *client;
 
-    qemu_mutex_lock(&map_client_list_lock);
-    QLIST_FOREACH(client, &map_client_list, link) {
+    qemu_mutex_lock(&as->map_lock);
+    QLIST_FOREACH(client, &as->map_client_list, link) {
         if (client->bh == bh) {
-            cpu_unregister_map_client_do(client);
+            address_space_map_client_free(client);
             break;
         }
     }
-    qemu_mutex_unlock(&map_client_list_lock);
-}
-
-static void cpu_notify_map_clients(void)
-{
-    qemu_mutex_lock(&map_client_list_lock);
-    cpu_notify_map_clients_locked();
-    qemu_mutex_unlock(&map_client_list_lock);
+    qemu_mutex_unlock(&as->map_lock);
 }
 
 static bool flatview_access_valid(FlatView *fv, hwaddr addr, hwaddr len,
@@ -3122,8 +3244,8 @@ flatview_extend_translation(FlatView *fv, hwaddr addr,
  * May map a subset of the requested range, given by and returned in *plen.
  * May return NULL if resources needed to perform the mapping are exhausted.
  * Use only for reads OR writes - not for read-modify-write operations.
- * Use cpu_register_map_client() to know when retrying the map operation is
- * likely to succeed.
+ * Use address_space_register_map_client() to know when retrying the map
+ * operation is likely to succeed.
  */
 void *address_space_map(AddressSpace *as,
                         hwaddr addr,
@@ -3147,25 +3269,32 @@ void *address_space_map(AddressSpace *as,
     mr = flatview_translate(fv, addr, &xlat, &l, is_write, attrs);
 
     if (!memory_access_is_direct(mr, is_write)) {
-        if (qatomic_xchg(&bounce.in_use, true)) {
+        BounceBuffer *bounce;
+
+        /* Avoid unbounded allocations */
+        qemu_mutex_lock(&as->map_lock);
+        if (as->bounce_buffer_size >= as->max_bounce_buffer_size) {
+            qemu_mutex_unlock(&as->map_lock);
             *plen = 0;
             return NULL;
         }
-        /* Avoid unbounded allocations */
-        l = MIN(l, TARGET_PAGE_SIZE);
-        bounce.buffer = qemu_memalign(TARGET_PAGE_SIZE, l);
-        bounce.addr = addr;
-        bounce.len = l;
+        l = MIN(l, as->max_bounce_buffer_size - as->bounce_buffer_size);
+        qatomic_set(&as->bounce_buffer_size, as->bounce_buffer_size + l);
+        bounce = g_malloc(sizeof(*bounce) + l);
+        QLIST_INSERT_HEAD(&as->bounce_buffers, bounce, link);
+        qemu_mutex_unlock(&as->map_lock);
 
+        bounce->addr = addr;
+        bounce->len = l;
         memory_region_ref(mr);
-        bounce.mr = mr;
+        bounce->mr = mr;
         if (!is_write) {
             flatview_read(fv, addr, MEMTXATTRS_UNSPECIFIED,
-                               bounce.buffer, l);
+                               bounce->buffer, l);
         }
 
         *plen = l;
-        return bounce.buffer;
+        return bounce->buffer;
     }
 
 
@@ -3182,10 +3311,32 @@ void *address_space_map(AddressSpace *as,
  * Will also mark the memory as dirty if is_write is true.  access_len gives
  * the amount of memory that was actually read or written by the caller.
  */
+static BounceBuffer *address_space_find_bounce_buffer(AddressSpace *as,
+                                                      void *buffer)
+{
+    BounceBuffer *bounce = NULL;
+
+    if (!qatomic_read(&as->bounce_buffer_size)) {
+        return NULL;
+    }
+
+    qemu_mutex_lock(&as->map_lock);
+    QLIST_FOREACH(bounce, &as->bounce_buffers, link) {
+        if (bounce->buffer == buffer) {
+            QLIST_REMOVE(bounce, link);
+            break;
+        }
+    }
+    qemu_mutex_unlock(&as->map_lock);
+    return bounce;
+}
+
 void address_space_unmap(AddressSpace *as, void *buffer, hwaddr len,
                          bool is_write, hwaddr access_len)
 {
-    if (buffer != bounce.buffer) {
+    BounceBuffer *bounce = address_space_find_bounce_buffer(as, buffer);
+
+    if (!bounce) {
         MemoryRegion *mr;
         ram_addr_t addr1;
 
@@ -3201,14 +3352,16 @@ void address_space_unmap(AddressSpace *as, void *buffer, hwaddr len,
         return;
     }
     if (is_write) {
-        address_space_write(as, bounce.addr, MEMTXATTRS_UNSPECIFIED,
-                            bounce.buffer, access_len);
-    }
-    qemu_vfree(bounce.buffer);
-    bounce.buffer = NULL;
-    memory_region_unref(bounce.mr);
-    qatomic_mb_set(&bounce.in_use, false);
-    cpu_notify_map_clients();
+        address_space_write(as, bounce->addr, MEMTXATTRS_UNSPECIFIED,
+                            bounce->buffer, access_len);
+    }
+    memory_region_unref(bounce->mr);
+
+    qemu_mutex_lock(&as->map_lock);
+    qatomic_set(&as->bounce_buffer_size, as->bounce_buffer_size - bounce->len);
+    address_space_notify_map_clients_locked(as);
+    qemu_mutex_unlock(&as->map_lock);
+    g_free(bounce);
 }
 
 void *cpu_physical_memory_map(hwaddr addr,
@@ -2564,6 +2564,9 @@ static void qemu_machine_creation_done(void)
 
     qdev_prop_check_globals();
 
+    /* Memory backends may still be preallocating in the background */
+    os_mem_prealloc_finish(&error_fatal);
+
     qdev_machine_creation_done();
 
     if (machine->cgs) {
@@ -0,0 +1,22 @@
+#include "qemu/osdep.h"
+#include "monitor/stats.h"
+
+void add_stats_callbacks(StatsProvider provider, StatsCb *stats_cb,
+                         StatsSchemaCb *schemas_cb)
+{
+}
+
+void stats_add(StatsList **stats, strList *names, const char *name,
+               uint64_t value)
+{
+}
+
+void stats_result_add(StatsResultList **result, StatsProvider provider,
+                      const char *instance, StatsList *stats)
+{
+}
+
+void stats_schema_add(StatsSchemaValueList **result, const char *name,
+                      StatsType type, StatsUnit unit)
+{
+}
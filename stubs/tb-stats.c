@@ -0,0 +1,16 @@
+#include "qemu/osdep.h"
+#include "qapi/error.h"
+#include "qapi/qapi-commands-machine.h"
+
+void qmp_x_tb_stats(TBStatsAction action, Error **errp)
+{
+    error_setg(errp, "TB statistics are only available with accel=tcg");
+}
+
+TBStatsInfoList *qmp_x_query_tb_stats(bool has_count, int64_t count,
+                                      bool has_sort_by,
+                                      TBStatsSortKey sort_by, Error **errp)
+{
+    error_setg(errp, "TB statistics are only available with accel=tcg");
+    return NULL;
+}
@@ -555,59 +555,80 @@ static inline bool arm_excp_unmasked(CPUState *cs, unsigned int excp_idx,
     return unmasked || pstate_unmasked;
 }
 
-bool arm_cpu_exec_interrupt(CPUState *cs, int interrupt_request)
+/*
+ * Return the exception to take for @interrupt_request, or -1 if all of
+ * the pending interrupts are masked.  This only looks at the CPU's own
+ * state, so it is safe to call without the BQL.
+ */
+static int arm_cpu_pending_excp(CPUState *cs, int interrupt_request,
+                                uint32_t *target_el)
 {
-    CPUClass *cc = CPU_GET_CLASS(cs);
     CPUARMState *env = cs->env_ptr;
     uint32_t cur_el = arm_current_el(env);
     bool secure = arm_is_secure(env);
     uint64_t hcr_el2 = arm_hcr_el2_eff(env);
-    uint32_t target_el;
-    uint32_t excp_idx;
 
     /* The prioritization of interrupts is IMPLEMENTATION DEFINED. */
 
     if (interrupt_request & CPU_INTERRUPT_FIQ) {
-        excp_idx = EXCP_FIQ;
-        target_el = arm_phys_excp_target_el(cs, excp_idx, cur_el, secure);
-        if (arm_excp_unmasked(cs, excp_idx, target_el,
+        *target_el = arm_phys_excp_target_el(cs, EXCP_FIQ, cur_el, secure);
+        if (arm_excp_unmasked(cs, EXCP_FIQ, *target_el,
                               cur_el, secure, hcr_el2)) {
-            goto found;
+            return EXCP_FIQ;
         }
     }
     if (interrupt_request & CPU_INTERRUPT_HARD) {
-        excp_idx = EXCP_IRQ;
-        target_el = arm_phys_excp_target_el(cs, excp_idx, cur_el, secure);
-        if (arm_excp_unmasked(cs, excp_idx, target_el,
+        *target_el = arm_phys_excp_target_el(cs, EXCP_IRQ, cur_el, secure);
+        if (arm_excp_unmasked(cs, EXCP_IRQ, *target_el,
                               cur_el, secure, hcr_el2)) {
-            goto found;
+            return EXCP_IRQ;
         }
     }
     if (interrupt_request & CPU_INTERRUPT_VIRQ) {
-        excp_idx = EXCP_VIRQ;
-        target_el = 1;
-        if (arm_excp_unmasked(cs, excp_idx, target_el,
+        *target_el = 1;
+        if (arm_excp_unmasked(cs, EXCP_VIRQ, *target_el,
                               cur_el, secure, hcr_el2)) {
-            goto found;
+            return EXCP_VIRQ;
         }
     }
     if (interrupt_request & CPU_INTERRUPT_VFIQ) {
-        excp_idx = EXCP_VFIQ;
-        target_el = 1;
-        if (arm_excp_unmasked(cs, excp_idx, target_el,
+        *target_el = 1;
+        if (arm_excp_unmasked(cs, EXCP_VFIQ, *target_el,
                               cur_el, secure, hcr_el2)) {
-            goto found;
+            return EXCP_VFIQ;
         }
     }
-    return false;
+    return -1;
+}
+
+bool arm_cpu_exec_interrupt(CPUState *cs, int interrupt_request)
+{
+    CPUClass *cc = CPU_GET_CLASS(cs);
+    CPUARMState *env = cs->env_ptr;
+    uint32_t target_el;
+    int excp_idx;
+
+    excp_idx = arm_cpu_pending_excp(cs, interrupt_request, &target_el);
+    if (excp_idx < 0) {
+        return false;
+    }
 
- found:
     cs->exception_index = excp_idx;
     env->exception.target_el = target_el;
     cc->tcg_ops->do_interrupt(cs);
     return true;
 }
 
+#ifdef CONFIG_TCG
+static bool arm_cpu_exec_interrupt_pending(CPUState *cs,
+                                           int interrupt_request)
+{
+    uint32_t target_el;
+
+    return arm_cpu_pending_excp(cs, interrupt_request, &target_el) >= 0;
+}
+#endif
+
 void arm_cpu_update_virq(ARMCPU *cpu)
 {
     /*
@@ -1948,6 +1969,7 @@ static struct TCGCPUOps arm_tcg_ops = {
     .initialize = arm_translate_init,
     .synchronize_from_tb = arm_cpu_synchronize_from_tb,
     .cpu_exec_interrupt = arm_cpu_exec_interrupt,
+    .cpu_exec_interrupt_pending = arm_cpu_exec_interrupt_pending,
     .tlb_fill = arm_cpu_tlb_fill,
     .debug_excp_handler = arm_debug_excp_handler,
 
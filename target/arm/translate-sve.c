@@ -4251,21 +4251,17 @@ static bool trans_UCVTF_dd(DisasContext *s, arg_rpr_esz *a)
  */
 
 /* Subroutine loading a vector register at VOFS of LEN bytes.
- * The load should begin at the address Rn + IMM.
+ * The load begins at CLEAN_ADDR, which is clobbered.
  */
 
-static void do_ldr(DisasContext *s, uint32_t vofs, int len, int rn, int imm)
+static void do_ldr_clean(DisasContext *s, uint32_t vofs, int len,
+                         TCGv_i64 clean_addr)
 {
     int len_align = QEMU_ALIGN_DOWN(len, 8);
     int len_remain = len % 8;
     int nparts = len / 8 + ctpop8(len_remain);
     int midx = get_mem_index(s);
-    TCGv_i64 dirty_addr, clean_addr, t0, t1;
-
-    dirty_addr = tcg_temp_new_i64();
-    tcg_gen_addi_i64(dirty_addr, cpu_reg_sp(s, rn), imm);
-    clean_addr = gen_mte_checkN(s, dirty_addr, false, rn != 31, len);
-    tcg_temp_free_i64(dirty_addr);
+    TCGv_i64 t0, t1;
 
     /*
      * Note that unpredicated load/store of vector/predicate registers
@@ -4341,19 +4337,27 @@ static void do_ldr(DisasContext *s, uint32_t vofs, int len, int rn, int imm)
     }
 }
 
-/* Similarly for stores.  */
-static void do_str(DisasContext *s, uint32_t vofs, int len, int rn, int imm)
+/* As do_ldr_clean, with the load beginning at the address Rn + IMM.  */
+static void do_ldr(DisasContext *s, uint32_t vofs, int len, int rn, int imm)
 {
-    int len_align = QEMU_ALIGN_DOWN(len, 8);
-    int len_remain = len % 8;
-    int nparts = len / 8 + ctpop8(len_remain);
-    int midx = get_mem_index(s);
-    TCGv_i64 dirty_addr, clean_addr, t0;
+    TCGv_i64 dirty_addr, clean_addr;
 
     dirty_addr = tcg_temp_new_i64();
     tcg_gen_addi_i64(dirty_addr, cpu_reg_sp(s, rn), imm);
     clean_addr = gen_mte_checkN(s, dirty_addr, false, rn != 31, len);
     tcg_temp_free_i64(dirty_addr);
+    do_ldr_clean(s, vofs, len, clean_addr);
+}
+
+/* Similarly for stores.  */
+static void do_str_clean(DisasContext *s, uint32_t vofs, int len,
+                         TCGv_i64 clean_addr)
+{
+    int len_align = QEMU_ALIGN_DOWN(len, 8);
+    int len_remain = len % 8;
+    int nparts = len / 8 + ctpop8(len_remain);
+    int midx = get_mem_index(s);
+    TCGv_i64 t0;
 
     /* Note that unpredicated load/store of vector/predicate registers
      * are defined as a stream of bytes, which equates to little-endian
@@ -4426,6 +4430,17 @@ static void do_str(DisasContext *s, uint32_t vofs, int len, int rn, int imm)
     }
 }
 
+static void do_str(DisasContext *s, uint32_t vofs, int len, int rn, int imm)
+{
+    TCGv_i64 dirty_addr, clean_addr;
+
+    dirty_addr = tcg_temp_new_i64();
+    tcg_gen_addi_i64(dirty_addr, cpu_reg_sp(s, rn), imm);
+    clean_addr = gen_mte_checkN(s, dirty_addr, false, rn != 31, len);
+    tcg_temp_free_i64(dirty_addr);
+    do_str_clean(s, vofs, len, clean_addr);
+}
+
 static bool trans_LDR_zri(DisasContext *s, arg_rri *a)
 {
     if (sve_access_check(s)) {
@@ -4526,6 +4541,61 @@ static void do_mem_zpa(DisasContext *s, int zt, int pg, TCGv_i64 addr,
     tcg_temp_free_i32(t_desc);
 }
 
+/*
+ * LD1 and ST1 without extension move a little-endian vector like LDR
+ * and STR do, as a stream of bytes.  When all elements are active and
+ * the access stays within one page, emit that inline and skip the
+ * helper, which resolves and probes each element.  *ADDR is replaced
+ * by a copy that survives the branches.  Return the label that follows
+ * the helper call, or NULL if the fast path cannot be used.
+ */
+static TCGLabel *do_ldst_fast(DisasContext *s, int zt, int pg,
+                              TCGv_i64 *addr, int esz, bool is_write)
+{
+    int vsz = vec_full_reg_size(s);
+    int psz = pred_full_reg_size(s);
+    TCGLabel *slow, *over;
+    TCGv_i64 clean_addr, t;
+    uint64_t mask;
+    int i;
+
+    if (s->mte_active[0] || (s->be_data == MO_BE && esz != MO_8)) {
+        return NULL;
+    }
+
+    t = *addr;
+    *addr = new_tmp_a64_local(s);
+    tcg_gen_mov_i64(*addr, t);
+
+    slow = gen_new_label();
+    over = gen_new_label();
+    t = tcg_temp_new_i64();
+    for (i = 0; i < psz; i += 8) {
+        mask = pred_esz_masks[esz];
+        if (psz - i < 8) {
+            mask &= MAKE_64BIT_MASK(0, (psz - i) * 8);
+        }
+        tcg_gen_ld_i64(t, cpu_env, pred_full_reg_offset(s, pg) + i);
+        tcg_gen_andi_i64(t, t, mask);
+        tcg_gen_brcondi_i64(TCG_COND_NE, t, mask, slow);
+    }
+
+    clean_addr = clean_data_tbi(s, *addr);
+    tcg_gen_andi_i64(t, clean_addr, ~TARGET_PAGE_MASK);
+    tcg_gen_brcondi_i64(TCG_COND_GTU, t, TARGET_PAGE_SIZE - vsz, slow);
+    tcg_temp_free_i64(t);
+
+    if (is_write) {
+        do_str_clean(s, vec_full_reg_offset(s, zt), vsz, clean_addr);
+    } else {
+        do_ldr_clean(s, vec_full_reg_offset(s, zt), vsz, clean_addr);
+    }
+    tcg_gen_br(over);
+
+    gen_set_label(slow);
+    return over;
+}
+
 static void do_ld_zpa(DisasContext *s, int zt, int pg,
                       TCGv_i64 addr, int dtype, int nreg)
 {
@@ -4648,13 +4718,20 @@ static void do_ld_zpa(DisasContext *s, int zt, int pg,
     };
     gen_helper_gvec_mem *fn
         = fns[s->mte_active[0]][s->be_data == MO_BE][dtype][nreg];
+    TCGLabel *over = NULL;
 
     /*
      * While there are holes in the table, they are not
      * accessible via the instruction encoding.
      */
     assert(fn != NULL);
+    if (nreg == 0 && dtype_msz(dtype) == dtype_esz[dtype]) {
+        over = do_ldst_fast(s, zt, pg, &addr, dtype_esz[dtype], false);
+    }
     do_mem_zpa(s, zt, pg, addr, dtype, nreg, false, fn);
+    if (over) {
+        gen_set_label(over);
+    }
 }
 
 static bool trans_LD_zprr(DisasContext *s, arg_rprr_load *a)
@@ -5123,11 +5200,15 @@ static void do_st_zpa(DisasContext *s, int zt, int pg, TCGv_i64 addr,
     };
     gen_helper_gvec_mem *fn;
     int be = s->be_data == MO_BE;
+    TCGLabel *over = NULL;
 
     if (nreg == 0) {
         /* ST1 */
         fn = fn_single[s->mte_active[0]][be][msz][esz];
         nreg = 1;
+        if (msz == esz) {
+            over = do_ldst_fast(s, zt, pg, &addr, esz, true);
+        }
     } else {
         /* ST2, ST3, ST4 -- msz == esz, enforced by encoding */
         assert(msz == esz);
@@ -5135,6 +5216,9 @@ static void do_st_zpa(DisasContext *s, int zt, int pg, TCGv_i64 addr,
     }
     assert(fn != NULL);
     do_mem_zpa(s, zt, pg, addr, msz_dtype(s, msz), nreg, true, fn);
+    if (over) {
+        gen_set_label(over);
+    }
 }
 
 static bool trans_ST_zprr(DisasContext *s, arg_rprr_store *a)
@@ -1026,6 +1026,27 @@ void helper_addsubpd(CPUX86State *env, ZMMReg *d, ZMMReg *s)
 #define FPU_CMPORD(size, a, b)                                          \
     (float ## size ## _unordered_quiet(a, b, &env->sse_status) ? 0 : -1)
 
+/*
+ * The additional predicates of the AVX compare instructions.  Bit 0 of
+ * a FloatRelation is set for less and greater.
+ */
+#define FPU_CMPEQU(size, a, b)                                          \
+    (float ## size ## _compare_quiet(a, b, &env->sse_status) & 1 ? 0 : -1)
+#define FPU_CMPNGE(size, a, b)                                          \
+    (float ## size ## _compare(a, b, &env->sse_status) < 0 ||           \
+     float ## size ## _unordered_quiet(a, b, &env->sse_status) ? -1 : 0)
+#define FPU_CMPNGT(size, a, b)                                          \
+    (float ## size ## _compare(a, b, &env->sse_status) ==               \
+     float_relation_greater ? 0 : -1)
+#define FPU_CMPFALSE(size, a, b) 0
+#define FPU_CMPNEQO(size, a, b)                                         \
+    (float ## size ## _compare_quiet(a, b, &env->sse_status) & 1 ? -1 : 0)
+#define FPU_CMPGE(size, a, b)                                           \
+    (float ## size ## _le(b, a, &env->sse_status) ? -1 : 0)
+#define FPU_CMPGT(size, a, b)                                           \
+    (float ## size ## _lt(b, a, &env->sse_status) ? -1 : 0)
+#define FPU_CMPTRUE(size, a, b) -1
+
 SSE_HELPER_CMP(cmpeq, FPU_CMPEQ)
 SSE_HELPER_CMP(cmplt, FPU_CMPLT)
 SSE_HELPER_CMP(cmple, FPU_CMPLE)
@@ -1034,6 +1055,14 @@ SSE_HELPER_CMP(cmpneq, FPU_CMPNEQ)
 SSE_HELPER_CMP(cmpnlt, FPU_CMPNLT)
 SSE_HELPER_CMP(cmpnle, FPU_CMPNLE)
 SSE_HELPER_CMP(cmpord, FPU_CMPORD)
+SSE_HELPER_CMP(cmpequ, FPU_CMPEQU)
+SSE_HELPER_CMP(cmpnge, FPU_CMPNGE)
+SSE_HELPER_CMP(cmpngt, FPU_CMPNGT)
+SSE_HELPER_CMP(cmpfalse, FPU_CMPFALSE)
+SSE_HELPER_CMP(cmpneqo, FPU_CMPNEQO)
+SSE_HELPER_CMP(cmpge, FPU_CMPGE)
+SSE_HELPER_CMP(cmpgt, FPU_CMPGT)
+SSE_HELPER_CMP(cmptrue, FPU_CMPTRUE)
 
 static const int comis_eflags[4] = {CC_C, CC_Z, 0, CC_Z | CC_P | CC_C};
 
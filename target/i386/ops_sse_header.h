@@ -215,6 +215,14 @@ SSE_HELPER_CMP(cmpneq, FPU_CMPNEQ)
 SSE_HELPER_CMP(cmpnlt, FPU_CMPNLT)
 SSE_HELPER_CMP(cmpnle, FPU_CMPNLE)
 SSE_HELPER_CMP(cmpord, FPU_CMPORD)
+SSE_HELPER_CMP(cmpequ, FPU_CMPEQU)
+SSE_HELPER_CMP(cmpnge, FPU_CMPNGE)
+SSE_HELPER_CMP(cmpngt, FPU_CMPNGT)
+SSE_HELPER_CMP(cmpfalse, FPU_CMPFALSE)
+SSE_HELPER_CMP(cmpneqo, FPU_CMPNEQO)
+SSE_HELPER_CMP(cmpge, FPU_CMPGE)
+SSE_HELPER_CMP(cmpgt, FPU_CMPGT)
+SSE_HELPER_CMP(cmptrue, FPU_CMPTRUE)
 
 DEF_HELPER_3(ucomiss, void, env, Reg, Reg)
 DEF_HELPER_3(comiss, void, env, Reg, Reg)
@@ -57,6 +57,12 @@ static void x86_cpu_synchronize_from_tb(CPUState *cs,
     cpu->env.eip = tb->pc - tb->cs_base;
 }
 
+static bool x86_cpu_exec_interrupt_pending(CPUState *cs,
+                                           int interrupt_request)
+{
+    return x86_cpu_pending_interrupt(cs, interrupt_request) != 0;
+}
+
 #include "hw/core/tcg-cpu-ops.h"
 
 static struct TCGCPUOps x86_tcg_ops = {
@@ -65,6 +71,7 @@ static struct TCGCPUOps x86_tcg_ops = {
     .cpu_exec_enter = x86_cpu_exec_enter,
     .cpu_exec_exit = x86_cpu_exec_exit,
     .cpu_exec_interrupt = x86_cpu_exec_interrupt,
+    .cpu_exec_interrupt_pending = x86_cpu_exec_interrupt_pending,
     .do_interrupt = x86_cpu_do_interrupt,
     .tlb_fill = x86_cpu_tlb_fill,
 #ifndef CONFIG_USER_ONLY
@@ -23,6 +23,7 @@
 #include "disas/disas.h"
 #include "exec/exec-all.h"
 #include "tcg/tcg-op.h"
+#include "tcg/tcg-op-gvec.h"
 #include "exec/cpu_ldst.h"
 #include "exec/translator.h"
 
@@ -103,6 +104,7 @@ typedef struct DisasContext {
 #endif
     int vex_l;  /* vex vector length */
     int vex_v;  /* vex vvvv register, without 1's complement.  */
+    int vex_w;  /* vex W bit */
     int ss32;   /* 32 bit stack segment */
     CCOp cc_op;  /* current CC operation */
     bool cc_op_dirty;
@@ -2673,6 +2675,32 @@ static inline void gen_sto_env_A0(DisasContext *s, int offset)
     tcg_gen_qemu_st_i64(s->tmp1_i64, s->tmp0, mem_index, MO_LEQ);
 }
 
+static inline void gen_ldy_env_A0(DisasContext *s, int offset)
+{
+    int mem_index = s->mem_index;
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        tcg_gen_addi_tl(s->tmp0, s->A0, i * 8);
+        tcg_gen_qemu_ld_i64(s->tmp1_i64, s->tmp0, mem_index, MO_LEQ);
+        tcg_gen_st_i64(s->tmp1_i64, cpu_env,
+                       offset + offsetof(ZMMReg, ZMM_Q(i)));
+    }
+}
+
+static inline void gen_sty_env_A0(DisasContext *s, int offset)
+{
+    int mem_index = s->mem_index;
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        tcg_gen_addi_tl(s->tmp0, s->A0, i * 8);
+        tcg_gen_ld_i64(s->tmp1_i64, cpu_env,
+                       offset + offsetof(ZMMReg, ZMM_Q(i)));
+        tcg_gen_qemu_st_i64(s->tmp1_i64, s->tmp0, mem_index, MO_LEQ);
+    }
+}
+
 static inline void gen_op_movo(DisasContext *s, int d_offset, int s_offset)
 {
     tcg_gen_ld_i64(s->tmp1_i64, cpu_env, s_offset + offsetof(ZMMReg, ZMM_Q(0)));
@@ -2892,7 +2920,7 @@ static const SSEFunc_l_ep sse_op_table3bq[] = {
 };
 #endif
 
-static const SSEFunc_0_epp sse_op_table4[8][4] = {
+static const SSEFunc_0_epp sse_op_table4[16][4] = {
     SSE_FOP(cmpeq),
     SSE_FOP(cmplt),
     SSE_FOP(cmple),
@@ -2901,6 +2929,15 @@ static const SSEFunc_0_epp sse_op_table4[8][4] = {
     SSE_FOP(cmpnlt),
     SSE_FOP(cmpnle),
     SSE_FOP(cmpord),
+    /* VEX only */
+    SSE_FOP(cmpequ),
+    SSE_FOP(cmpnge),
+    SSE_FOP(cmpngt),
+    SSE_FOP(cmpfalse),
+    SSE_FOP(cmpneqo),
+    SSE_FOP(cmpge),
+    SSE_FOP(cmpgt),
+    SSE_FOP(cmptrue),
 };
 
 static const SSEFunc_0_epp sse_op_table5[256] = {
@@ -3029,17 +3066,1552 @@ static const struct SSEOpHelper_eppi sse_op_table7[256] = {
     [0xdf] = AESNI_OP(aeskeygenassist),
 };
 
-static void gen_sse(CPUX86State *env, DisasContext *s, int b,
+/* AVX and AVX2 */
+
+typedef void GVecGen3Fn(unsigned, uint32_t, uint32_t,
+                        uint32_t, uint32_t, uint32_t);
+
+#define XMM_T0_OFFSET offsetof(CPUX86State, xmm_t0)
+#define XMM_T1_OFFSET offsetof(CPUX86State, xmm_t1)
+
+static inline int xmm_offset(int reg)
+{
+    return offsetof(CPUX86State, xmm_regs[reg]);
+}
+
+/* Offset of the element @i of size @ot in a ZMMReg */
+static int zmm_elem_offset(MemOp ot, int i)
+{
+    switch (ot) {
+    case MO_8:
+        return offsetof(ZMMReg, ZMM_B(i));
+    case MO_16:
+        return offsetof(ZMMReg, ZMM_W(i));
+    case MO_32:
+        return offsetof(ZMMReg, ZMM_L(i));
+    case MO_64:
+        return offsetof(ZMMReg, ZMM_Q(i));
+    default:
+        g_assert_not_reached();
+    }
+}
+
+/*
+ * The offset of the low @len bytes of a register for the gvec expanders.
+ * ZMMReg is stored in reverse on big-endian hosts, so they are at its end.
+ */
+static inline int vec_offset(int offset, int len)
+{
+#ifdef HOST_WORDS_BIGENDIAN
+    return offset + sizeof(ZMMReg) - len;
+#else
+    return offset;
+#endif
+}
+
+/* VEX.128 instructions zero bits 255:128 of their destination */
+static void gen_clear_ymmh(DisasContext *s, int offset)
+{
+    gen_op_movq_env_0(s, offset + offsetof(ZMMReg, ZMM_Q(2)));
+    gen_op_movq_env_0(s, offset + offsetof(ZMMReg, ZMM_Q(3)));
+}
+
+/* Copy the 128-bit lane @s_lane of a register to the lane @d_lane */
+static void gen_op_movo_lane(DisasContext *s, int d_offset, int d_lane,
+                             int s_offset, int s_lane)
+{
+    gen_op_movq(s, d_offset + offsetof(ZMMReg, ZMM_Q(d_lane * 2)),
+                s_offset + offsetof(ZMMReg, ZMM_Q(s_lane * 2)));
+    gen_op_movq(s, d_offset + offsetof(ZMMReg, ZMM_Q(d_lane * 2 + 1)),
+                s_offset + offsetof(ZMMReg, ZMM_Q(s_lane * 2 + 1)));
+}
+
+/* Copy the low @len bytes of a register and zero the rest of the YMM */
+static void gen_avx_mov(DisasContext *s, int d_offset, int s_offset, int len)
+{
+    if (d_offset != s_offset) {
+        tcg_gen_gvec_mov(MO_64, vec_offset(d_offset, len),
+                         vec_offset(s_offset, len), len, len);
+    }
+    if (len == 16) {
+        gen_clear_ymmh(s, d_offset);
+    }
+}
+
+/* Load the low @size bytes of a register from A0 */
+static void gen_ld_env_A0(DisasContext *s, int offset, int size)
+{
+    switch (size) {
+    case 1:
+        tcg_gen_qemu_ld_i32(s->tmp2_i32, s->A0, s->mem_index, MO_UB);
+        tcg_gen_st8_i32(s->tmp2_i32, cpu_env,
+                        offset + offsetof(ZMMReg, ZMM_B(0)));
+        break;
+    case 2:
+        tcg_gen_qemu_ld_i32(s->tmp2_i32, s->A0, s->mem_index, MO_LEUW);
+        tcg_gen_st16_i32(s->tmp2_i32, cpu_env,
+                         offset + offsetof(ZMMReg, ZMM_W(0)));
+        break;
+    case 4:
+        tcg_gen_qemu_ld_i32(s->tmp2_i32, s->A0, s->mem_index, MO_LEUL);
+        tcg_gen_st_i32(s->tmp2_i32, cpu_env,
+                       offset + offsetof(ZMMReg, ZMM_L(0)));
+        break;
+    case 8:
+        gen_ldq_env_A0(s, offset + offsetof(ZMMReg, ZMM_Q(0)));
+        break;
+    case 16:
+        gen_ldo_env_A0(s, offset);
+        break;
+    case 32:
+        gen_ldy_env_A0(s, offset);
+        break;
+    default:
+        g_assert_not_reached();
+    }
+}
+
+/* Store the low @size bytes of a register to A0 */
+static void gen_st_env_A0(DisasContext *s, int offset, int size)
+{
+    switch (size) {
+    case 4:
+        tcg_gen_ld_i32(s->tmp2_i32, cpu_env,
+                       offset + offsetof(ZMMReg, ZMM_L(0)));
+        tcg_gen_qemu_st_i32(s->tmp2_i32, s->A0, s->mem_index, MO_LEUL);
+        break;
+    case 8:
+        gen_stq_env_A0(s, offset + offsetof(ZMMReg, ZMM_Q(0)));
+        break;
+    case 16:
+        gen_sto_env_A0(s, offset);
+        break;
+    case 32:
+        gen_sty_env_A0(s, offset);
+        break;
+    default:
+        g_assert_not_reached();
+    }
+}
+
+/*
+ * Return the offset of the r/m vector operand.  A memory operand is
+ * loaded to xmm_t0, @size bytes of it.
+ */
+static int gen_avx_load_rm(CPUX86State *env, DisasContext *s, int modrm,
+                           int size)
+{
+    if ((modrm >> 6) == 3) {
+        return xmm_offset((modrm & 7) | REX_B(s));
+    }
+    gen_lea_modrm(env, s, modrm);
+    gen_ld_env_A0(s, XMM_T0_OFFSET, size);
+    return XMM_T0_OFFSET;
+}
+
+/* How gen_avx_lanes() applies a 128-bit SSE helper to the operands */
+enum {
+    AVX_LANE_3OP,       /* dst = src1 op src2 */
+    AVX_LANE_2OP,       /* dst = op src2 */
+    AVX_LANE_SHIFT,     /* dst = src1 op src2, with the same src2 per lane */
+    AVX_LANE_WIDEN,     /* lane n of dst = op the chunk n of src2 */
+    AVX_LANE_NARROW,    /* qword n of dst = op the lane n of src2 */
+};
+
+typedef struct AVXLaneOp {
+    int kind;
+    SSEFunc_0_epp fn_epp;
+    SSEFunc_0_eppi fn_eppi;
+    SSEFunc_0_ppi fn_ppi;
+    int imm;
+    int imm_shift;      /* the upper lane uses imm >> imm_shift */
+    int chunk;          /* bytes of src2 per lane, for AVX_LANE_WIDEN */
+} AVXLaneOp;
+
+/* Move the second @chunk bytes of xmm_t0 to its bottom */
+static void gen_avx_next_chunk(DisasContext *s, int chunk)
+{
+    switch (chunk) {
+    case 2:
+        tcg_gen_ld16u_i32(s->tmp2_i32, cpu_env,
+                          XMM_T0_OFFSET + offsetof(ZMMReg, ZMM_W(1)));
+        tcg_gen_st16_i32(s->tmp2_i32, cpu_env,
+                         XMM_T0_OFFSET + offsetof(ZMMReg, ZMM_W(0)));
+        break;
+    case 4:
+        gen_op_movl(s, XMM_T0_OFFSET + offsetof(ZMMReg, ZMM_L(0)),
+                    XMM_T0_OFFSET + offsetof(ZMMReg, ZMM_L(1)));
+        break;
+    case 8:
+        gen_op_movq(s, XMM_T0_OFFSET + offsetof(ZMMReg, ZMM_Q(0)),
+                    XMM_T0_OFFSET + offsetof(ZMMReg, ZMM_Q(1)));
+        break;
+    default:
+        g_assert_not_reached();
+    }
+}
+
+/*
+ * Apply an SSE helper to each 128-bit lane.  The helpers work in place
+ * on their first operand, so each lane of src1 is copied to xmm_t1 and
+ * the result copied back, unless a VEX.128 instruction can work on the
+ * destination directly.  The upper lane of src2 is passed in xmm_t0.
+ */
+static void gen_avx_lanes(DisasContext *s, const AVXLaneOp *op, int nlanes,
+                          int d_offset, int a_offset, int b_offset)
+{
+    bool has_src1 = op->kind == AVX_LANE_3OP || op->kind == AVX_LANE_SHIFT;
+    int lane, imm, t_offset, s_offset;
+
+    if (nlanes > 1 && b_offset != XMM_T0_OFFSET
+        && (op->kind == AVX_LANE_SHIFT || op->kind == AVX_LANE_WIDEN)) {
+        /* the low lane of src2 is used again after the first write */
+        gen_op_movo_lane(s, XMM_T0_OFFSET, 0, b_offset, 0);
+        b_offset = XMM_T0_OFFSET;
+    }
+
+    for (lane = 0; lane < nlanes; lane++) {
+        t_offset = XMM_T1_OFFSET;
+        s_offset = b_offset;
+        if (nlanes == 1 && (!has_src1 || a_offset == d_offset)) {
+            t_offset = d_offset;
+        } else if (has_src1) {
+            gen_op_movo_lane(s, XMM_T1_OFFSET, 0, a_offset, lane);
+        }
+        if (lane) {
+            switch (op->kind) {
+            case AVX_LANE_SHIFT:
+                break;
+            case AVX_LANE_WIDEN:
+                gen_avx_next_chunk(s, op->chunk);
+                break;
+            default:
+                gen_op_movo_lane(s, XMM_T0_OFFSET, 0, b_offset, 1);
+                s_offset = XMM_T0_OFFSET;
+                break;
+            }
+        }
+
+        imm = op->imm >> (lane * op->imm_shift);
+        tcg_gen_addi_ptr(s->ptr0, cpu_env, t_offset);
+        tcg_gen_addi_ptr(s->ptr1, cpu_env, s_offset);
+        if (op->fn_epp) {
+            op->fn_epp(cpu_env, s->ptr0, s->ptr1);
+        } else if (op->fn_eppi) {
+            op->fn_eppi(cpu_env, s->ptr0, s->ptr1, tcg_const_i32(imm));
+        } else {
+            op->fn_ppi(s->ptr0, s->ptr1, tcg_const_i32(imm));
+        }
+
+        if (t_offset == d_offset) {
+            continue;
+        }
+        if (op->kind == AVX_LANE_NARROW) {
+            gen_op_movq(s, d_offset + offsetof(ZMMReg, ZMM_Q(lane)),
+                        XMM_T1_OFFSET + offsetof(ZMMReg, ZMM_Q(0)));
+        } else {
+            gen_op_movo_lane(s, d_offset, lane, XMM_T1_OFFSET, 0);
+        }
+    }
+
+    if (nlanes == 1 || op->kind == AVX_LANE_NARROW) {
+        gen_clear_ymmh(s, d_offset);
+    }
+}
+
+typedef struct AVXGvecOp {
+    GVecGen3Fn *fn;
+    MemOp vece;
+} AVXGvecOp;
+
+static void gen_gvec_pcmpeq(unsigned vece, uint32_t dofs, uint32_t aofs,
+                            uint32_t bofs, uint32_t oprsz, uint32_t maxsz)
+{
+    tcg_gen_gvec_cmp(TCG_COND_EQ, vece, dofs, aofs, bofs, oprsz, maxsz);
+}
+
+static void gen_gvec_pcmpgt(unsigned vece, uint32_t dofs, uint32_t aofs,
+                            uint32_t bofs, uint32_t oprsz, uint32_t maxsz)
+{
+    tcg_gen_gvec_cmp(TCG_COND_GT, vece, dofs, aofs, bofs, oprsz, maxsz);
+}
+
+/* pandn and andnps compute ~src1 & src2 */
+static void gen_gvec_pandn(unsigned vece, uint32_t dofs, uint32_t aofs,
+                           uint32_t bofs, uint32_t oprsz, uint32_t maxsz)
+{
+    tcg_gen_gvec_andc(vece, dofs, bofs, aofs, oprsz, maxsz);
+}
+
+/* The VEX.0F 54-57 and VEX.66.0F instructions that map to gvec */
+static const AVXGvecOp avx_gvec_table1[256] = {
+    [0x54] = { tcg_gen_gvec_and, MO_64 },
+    [0x55] = { gen_gvec_pandn, MO_64 },
+    [0x56] = { tcg_gen_gvec_or, MO_64 },
+    [0x57] = { tcg_gen_gvec_xor, MO_64 },
+    [0x64] = { gen_gvec_pcmpgt, MO_8 },
+    [0x65] = { gen_gvec_pcmpgt, MO_16 },
+    [0x66] = { gen_gvec_pcmpgt, MO_32 },
+    [0x74] = { gen_gvec_pcmpeq, MO_8 },
+    [0x75] = { gen_gvec_pcmpeq, MO_16 },
+    [0x76] = { gen_gvec_pcmpeq, MO_32 },
+    [0xd4] = { tcg_gen_gvec_add, MO_64 },
+    [0xd5] = { tcg_gen_gvec_mul, MO_16 },
+    [0xd8] = { tcg_gen_gvec_ussub, MO_8 },
+    [0xd9] = { tcg_gen_gvec_ussub, MO_16 },
+    [0xda] = { tcg_gen_gvec_umin, MO_8 },
+    [0xdb] = { tcg_gen_gvec_and, MO_64 },
+    [0xdc] = { tcg_gen_gvec_usadd, MO_8 },
+    [0xdd] = { tcg_gen_gvec_usadd, MO_16 },
+    [0xde] = { tcg_gen_gvec_umax, MO_8 },
+    [0xdf] = { gen_gvec_pandn, MO_64 },
+    [0xe8] = { tcg_gen_gvec_sssub, MO_8 },
+    [0xe9] = { tcg_gen_gvec_sssub, MO_16 },
+    [0xea] = { tcg_gen_gvec_smin, MO_16 },
+    [0xeb] = { tcg_gen_gvec_or, MO_64 },
+    [0xec] = { tcg_gen_gvec_ssadd, MO_8 },
+    [0xed] = { tcg_gen_gvec_ssadd, MO_16 },
+    [0xee] = { tcg_gen_gvec_smax, MO_16 },
+    [0xef] = { tcg_gen_gvec_xor, MO_64 },
+    [0xf8] = { tcg_gen_gvec_sub, MO_8 },
+    [0xf9] = { tcg_gen_gvec_sub, MO_16 },
+    [0xfa] = { tcg_gen_gvec_sub, MO_32 },
+    [0xfb] = { tcg_gen_gvec_sub, MO_64 },
+    [0xfc] = { tcg_gen_gvec_add, MO_8 },
+    [0xfd] = { tcg_gen_gvec_add, MO_16 },
+    [0xfe] = { tcg_gen_gvec_add, MO_32 },
+};
+
+/* The VEX.66.0F38 instructions that map to gvec */
+static const AVXGvecOp avx_gvec_table6[256] = {
+    [0x29] = { gen_gvec_pcmpeq, MO_64 },
+    [0x37] = { gen_gvec_pcmpgt, MO_64 },
+    [0x38] = { tcg_gen_gvec_smin, MO_8 },
+    [0x39] = { tcg_gen_gvec_smin, MO_32 },
+    [0x3a] = { tcg_gen_gvec_umin, MO_16 },
+    [0x3b] = { tcg_gen_gvec_umin, MO_32 },
+    [0x3c] = { tcg_gen_gvec_smax, MO_8 },
+    [0x3d] = { tcg_gen_gvec_smax, MO_32 },
+    [0x3e] = { tcg_gen_gvec_umax, MO_16 },
+    [0x3f] = { tcg_gen_gvec_umax, MO_32 },
+    [0x40] = { tcg_gen_gvec_mul, MO_32 },
+};
+
+/* Bytes of the source per 128-bit lane for vpmovsx and vpmovzx */
+static const uint8_t avx_pmov_chunk[6] = { 8, 4, 2, 8, 4, 8 };
+
+static void gen_avx_gvec(DisasContext *s, const AVXGvecOp *op, int len,
+                         int d_offset, int a_offset, int b_offset)
+{
+    op->fn(op->vece, vec_offset(d_offset, len), vec_offset(a_offset, len),
+           vec_offset(b_offset, len), len, len);
+    if (len == 16) {
+        gen_clear_ymmh(s, d_offset);
+    }
+}
+
+/* The shifts by an immediate of the 0F 71-73 groups, /2 /4 and /6 */
+static void gen_avx_shifti(DisasContext *s, int op, MemOp vece, int len,
+                           int d_offset, int a_offset, int count)
+{
+    uint32_t dofs = vec_offset(d_offset, len);
+    uint32_t aofs = vec_offset(a_offset, len);
+    int bits = 8 << vece;
+
+    if (op == 4) {
+        tcg_gen_gvec_sari(vece, dofs, aofs, MIN(count, bits - 1), len, len);
+    } else if (count >= bits) {
+        tcg_gen_gvec_dup_imm(vece, dofs, len, len, 0);
+    } else if (op == 2) {
+        tcg_gen_gvec_shri(vece, dofs, aofs, count, len, len);
+    } else {
+        tcg_gen_gvec_shli(vece, dofs, aofs, count, len, len);
+    }
+    if (len == 16) {
+        gen_clear_ymmh(s, d_offset);
+    }
+}
+
+/*
+ * vpsrlv, vpsrav and vpsllv.  The counts are not masked: logical shifts
+ * by the element width or more give 0, arithmetic ones the sign.
+ */
+static void gen_avx_shiftv(DisasContext *s, int b, MemOp vece, int len,
+                           int d_offset, int a_offset, int b_offset)
+{
+    uint32_t dofs = vec_offset(d_offset, len);
+    uint32_t aofs = vec_offset(a_offset, len);
+    uint32_t bofs = vec_offset(b_offset, len);
+    uint32_t tofs = vec_offset(XMM_T1_OFFSET, len);
+    int bits = 8 << vece;
+
+    if (b == 0x46) {
+        tcg_gen_gvec_dup_imm(vece, tofs, len, len, bits - 1);
+        tcg_gen_gvec_umin(vece, tofs, bofs, tofs, len, len);
+        tcg_gen_gvec_sarv(vece, dofs, aofs, tofs, len, len);
+    } else {
+        tcg_gen_gvec_dup_imm(vece, tofs, len, len, bits);
+        tcg_gen_gvec_cmp(TCG_COND_GTU, vece, tofs, tofs, bofs, len, len);
+        if (b == 0x45) {
+            tcg_gen_gvec_shrv(vece, dofs, aofs, bofs, len, len);
+        } else {
+            tcg_gen_gvec_shlv(vece, dofs, aofs, bofs, len, len);
+        }
+        tcg_gen_gvec_and(vece, dofs, dofs, tofs, len, len);
+    }
+    if (len == 16) {
+        gen_clear_ymmh(s, d_offset);
+    }
+}
+
+/* vblendvps, vblendvpd and vpblendvb: select by the top bit of the mask */
+static void gen_avx_blendv(DisasContext *s, MemOp vece, int len,
+                           int d_offset, int a_offset, int b_offset,
+                           int m_offset)
+{
+    uint32_t tofs = vec_offset(XMM_T1_OFFSET, len);
+
+    tcg_gen_gvec_sari(vece, tofs, vec_offset(m_offset, len),
+                      (8 << vece) - 1, len, len);
+    tcg_gen_gvec_bitsel(MO_8, vec_offset(d_offset, len), tofs,
+                        vec_offset(b_offset, len), vec_offset(a_offset, len),
+                        len, len);
+    if (len == 16) {
+        gen_clear_ymmh(s, d_offset);
+    }
+}
+
+/*
+ * vpermilps, vpermilpd, vpermps and vpermd with variable indexes: the
+ * element i of the destination is the element of @a_offset selected by
+ * the element i of @c_offset, within the same 128-bit lane if @in_lane.
+ * vpermilpd takes the index from bit 1.
+ */
+static void gen_avx_permv(DisasContext *s, int d_offset, int a_offset,
+                          int c_offset, MemOp ot, int len, bool in_lane)
+{
+    int n = len >> ot, per_lane = 16 >> ot;
+    int step = zmm_elem_offset(ot, 1) - zmm_elem_offset(ot, 0);
+    int i;
+
+    /* both operands may be overwritten by the destination */
+    tcg_gen_gvec_mov(MO_64, vec_offset(XMM_T1_OFFSET, len),
+                     vec_offset(a_offset, len), len, len);
+    if (c_offset != XMM_T0_OFFSET) {
+        tcg_gen_gvec_mov(MO_64, vec_offset(XMM_T0_OFFSET, len),
+                         vec_offset(c_offset, len), len, len);
+    }
+
+    for (i = 0; i < n; i++) {
+        tcg_gen_ld_i32(s->tmp2_i32, cpu_env, XMM_T0_OFFSET +
+                       zmm_elem_offset(MO_32, i << (ot - MO_32)));
+        if (ot == MO_64) {
+            tcg_gen_shri_i32(s->tmp2_i32, s->tmp2_i32, 1);
+        }
+        if (in_lane) {
+            tcg_gen_andi_i32(s->tmp2_i32, s->tmp2_i32, per_lane - 1);
+            tcg_gen_addi_i32(s->tmp2_i32, s->tmp2_i32, i & -per_lane);
+        } else {
+            tcg_gen_andi_i32(s->tmp2_i32, s->tmp2_i32, n - 1);
+        }
+        tcg_gen_muli_i32(s->tmp2_i32, s->tmp2_i32, step);
+        tcg_gen_ext_i32_ptr(s->ptr0, s->tmp2_i32);
+        tcg_gen_add_ptr(s->ptr0, s->ptr0, cpu_env);
+        if (ot == MO_64) {
+            tcg_gen_ld_i64(s->tmp1_i64, s->ptr0,
+                           XMM_T1_OFFSET + zmm_elem_offset(MO_64, 0));
+            tcg_gen_st_i64(s->tmp1_i64, cpu_env,
+                           d_offset + zmm_elem_offset(MO_64, i));
+        } else {
+            tcg_gen_ld_i32(s->tmp3_i32, s->ptr0,
+                           XMM_T1_OFFSET + zmm_elem_offset(MO_32, 0));
+            tcg_gen_st_i32(s->tmp3_i32, cpu_env,
+                           d_offset + zmm_elem_offset(MO_32, i));
+        }
+    }
+    if (len == 16) {
+        gen_clear_ymmh(s, d_offset);
+    }
+}
+
+/* vptest, vtestps and vtestpd: ZF and CF from src1 & src2, ~src1 & src2 */
+static void gen_avx_ptest(DisasContext *s, int a_offset, int b_offset,
+                          int len, uint64_t mask)
+{
+    TCGv_i64 zf = tcg_temp_new_i64();
+    TCGv_i64 cf = tcg_temp_new_i64();
+    TCGv_i64 t0 = tcg_temp_new_i64();
+    TCGv_i64 t1 = tcg_temp_new_i64();
+    int i;
+
+    tcg_gen_movi_i64(zf, 0);
+    tcg_gen_movi_i64(cf, 0);
+    for (i = 0; i < len / 8; i++) {
+        tcg_gen_ld_i64(s->tmp1_i64, cpu_env,
+                       a_offset + offsetof(ZMMReg, ZMM_Q(i)));
+        tcg_gen_ld_i64(t0, cpu_env, b_offset + offsetof(ZMMReg, ZMM_Q(i)));
+        tcg_gen_and_i64(t1, s->tmp1_i64, t0);
+        tcg_gen_or_i64(zf, zf, t1);
+        tcg_gen_andc_i64(t1, t0, s->tmp1_i64);
+        tcg_gen_or_i64(cf, cf, t1);
+    }
+    tcg_gen_andi_i64(zf, zf, mask);
+    tcg_gen_andi_i64(cf, cf, mask);
+    tcg_gen_setcondi_i64(TCG_COND_EQ, zf, zf, 0);
+    tcg_gen_setcondi_i64(TCG_COND_EQ, cf, cf, 0);
+    tcg_gen_shli_i64(zf, zf, ctz32(CC_Z));
+    tcg_gen_or_i64(zf, zf, cf);
+    tcg_gen_trunc_i64_tl(cpu_cc_src, zf);
+    set_cc_op(s, CC_OP_EFLAGS);
+
+    tcg_temp_free_i64(zf);
+    tcg_temp_free_i64(cf);
+    tcg_temp_free_i64(t0);
+    tcg_temp_free_i64(t1);
+}
+
+/*
+ * vmaskmov and vpmaskmov with the address in A0.  Masked out elements are
+ * not accessed at all, so they cannot fault.
+ */
+static void gen_avx_maskmov(DisasContext *s, int reg, int mask_reg,
+                            MemOp ot, int len, bool store)
+{
+    int offset = store ? xmm_offset(reg) : XMM_T0_OFFSET;
+    TCGv addr = tcg_temp_local_new();
+    TCGLabel *skip;
+    int i;
+
+    tcg_gen_mov_tl(addr, s->A0);
+    if (!store) {
+        tcg_gen_gvec_dup_imm(MO_64, vec_offset(XMM_T0_OFFSET, 32),
+                             32, 32, 0);
+    }
+    for (i = 0; i < len >> ot; i++) {
+        skip = gen_new_label();
+        tcg_gen_ld_i32(s->tmp2_i32, cpu_env, xmm_offset(mask_reg) +
+                       zmm_elem_offset(MO_32, ot == MO_64 ? 2 * i + 1 : i));
+        tcg_gen_brcondi_i32(TCG_COND_GE, s->tmp2_i32, 0, skip);
+        tcg_gen_addi_tl(s->A0, addr, i << ot);
+        if (ot == MO_64) {
+            if (store) {
+                gen_stq_env_A0(s, offset + zmm_elem_offset(MO_64, i));
+            } else {
+                gen_ldq_env_A0(s, offset + zmm_elem_offset(MO_64, i));
+            }
+        } else if (store) {
+            tcg_gen_ld_i32(s->tmp2_i32, cpu_env,
+                           offset + zmm_elem_offset(MO_32, i));
+            tcg_gen_qemu_st_i32(s->tmp2_i32, s->A0, s->mem_index, MO_LEUL);
+        } else {
+            tcg_gen_qemu_ld_i32(s->tmp2_i32, s->A0, s->mem_index, MO_LEUL);
+            tcg_gen_st_i32(s->tmp2_i32, cpu_env,
+                           offset + zmm_elem_offset(MO_32, i));
+        }
+        gen_set_label(skip);
+    }
+    tcg_temp_free(addr);
+
+    if (!store) {
+        gen_avx_mov(s, xmm_offset(reg), XMM_T0_OFFSET, len);
+    }
+}
+
+/*
+ * vgather and vpgather.  Each element whose mask has the top bit set is
+ * loaded and its mask cleared, so that the instruction can be restarted
+ * after a fault.  Return false if the encoding is invalid.
+ */
+static bool gen_avx_gather(CPUX86State *env, DisasContext *s, int modrm,
+                           int b, int reg, int mask_reg)
+{
+    MemOp idx_ot = b & 1 ? MO_64 : MO_32;
+    MemOp ot = s->vex_w ? MO_64 : MO_32;
+    int len = s->vex_l ? 32 : 16;
+    int n = len >> MAX(idx_ot, ot);
+    int d_offset = xmm_offset(reg), m_offset = xmm_offset(mask_reg);
+    int x_offset, index, i;
+    AddressParts a;
+    TCGLabel *skip;
+    TCGv base;
+
+    /* VSIB: the SIB index selects a vector register */
+    if ((modrm >> 6) == 3 || (modrm & 7) != 4 || s->aflag == MO_16) {
+        return false;
+    }
+    index = ((translator_ldub(env, s->pc) >> 3) & 7) | REX_X(s);
+    if (reg == mask_reg || reg == index || mask_reg == index) {
+        return false;
+    }
+    x_offset = xmm_offset(index);
+
+    a = gen_lea_modrm_0(env, s, modrm);
+    a.index = -1;
+    base = tcg_temp_local_new();
+    tcg_gen_mov_tl(base, gen_lea_modrm_1(s, a));
+
+    for (i = 0; i < n; i++) {
+        skip = gen_new_label();
+        tcg_gen_ld_i32(s->tmp2_i32, cpu_env, m_offset +
+                       zmm_elem_offset(MO_32, ot == MO_64 ? 2 * i + 1 : i));
+        tcg_gen_brcondi_i32(TCG_COND_GE, s->tmp2_i32, 0, skip);
+        if (idx_ot == MO_64) {
+            tcg_gen_ld_i64(s->tmp1_i64, cpu_env,
+                           x_offset + zmm_elem_offset(MO_64, i));
+            tcg_gen_trunc_i64_tl(s->tmp0, s->tmp1_i64);
+        } else {
+            tcg_gen_ld_i32(s->tmp2_i32, cpu_env,
+                           x_offset + zmm_elem_offset(MO_32, i));
+            tcg_gen_ext_i32_tl(s->tmp0, s->tmp2_i32);
+        }
+        tcg_gen_shli_tl(s->tmp0, s->tmp0, a.scale);
+        tcg_gen_add_tl(s->tmp0, s->tmp0, base);
+        gen_lea_v_seg(s, s->aflag, s->tmp0, a.def_seg, s->override);
+        if (ot == MO_64) {
+            gen_ldq_env_A0(s, d_offset + zmm_elem_offset(MO_64, i));
+            gen_op_movq_env_0(s, m_offset + zmm_elem_offset(MO_64, i));
+        } else {
+            tcg_gen_qemu_ld_i32(s->tmp2_i32, s->A0, s->mem_index, MO_LEUL);
+            tcg_gen_st_i32(s->tmp2_i32, cpu_env,
+                           d_offset + zmm_elem_offset(MO_32, i));
+            tcg_gen_movi_i32(s->tmp2_i32, 0);
+            tcg_gen_st_i32(s->tmp2_i32, cpu_env,
+                           m_offset + zmm_elem_offset(MO_32, i));
+        }
+        gen_set_label(skip);
+    }
+    tcg_temp_free(base);
+
+    for (i = (n << ot) / 8; i < 4; i++) {
+        gen_op_movq_env_0(s, d_offset + offsetof(ZMMReg, ZMM_Q(i)));
+    }
+    tcg_gen_gvec_dup_imm(MO_64, vec_offset(m_offset, 32), 32, 32, 0);
+    return true;
+}
+
+/* The VEX forms that gen_sse() translates like the legacy instruction */
+static bool avx_is_legacy_op(DisasContext *s, int map, int b, int b1)
+{
+    switch (map) {
+    case 0:
+        switch (b) {
+        case 0x2c: /* vcvttss2si, vcvttsd2si */
+        case 0x2d: /* vcvtss2si, vcvtsd2si */
+            return b1 >= 2;
+        case 0x2e: /* vucomiss, vucomisd */
+        case 0x2f: /* vcomiss, vcomisd */
+            return b1 < 2;
+        case 0x13: /* vmovlps, vmovlpd to memory */
+        case 0x17: /* vmovhps, vmovhpd to memory */
+            return b1 < 2 && !s->vex_l;
+        case 0x7e: /* vmovd, vmovq to r/m */
+        case 0xc5: /* vpextrw */
+        case 0xf7: /* vmaskmovdqu */
+            return b1 == 1 && !s->vex_l;
+        }
+        return false;
+    case 0x3a:
+        /* vpextrb, vpextrw, vpextrd/q, vextractps */
+        return b >= 0x14 && b <= 0x17 && b1 == 1 && !s->vex_l;
+    }
+    return false;
+}
+
+/*
+ * Translate a VEX encoded instruction, other than BMI.  Return false for
+ * the forms that gen_sse() translates like the legacy instruction; their
+ * opcode bytes are not consumed then.
+ */
+static bool gen_avx(CPUX86State *env, DisasContext *s, int b,
                     target_ulong pc_start, int rex_r)
 {
-    int b1, op1_offset, op2_offset, is_xmm, val;
-    int modrm, mod, rm, reg;
+    int b1, map, modrm, mod, reg, rm, vvvv, val, len, nlanes, size, i;
+    int d_offset, a_offset, b_offset;
+    bool avx2 = s->cpuid_7_0_ebx_features & CPUID_7_0_EBX_AVX2;
+    AVXLaneOp op = { .kind = AVX_LANE_3OP };
     SSEFunc_0_epp sse_fn_epp;
-    SSEFunc_0_eppi sse_fn_eppi;
-    SSEFunc_0_ppi sse_fn_ppi;
-    SSEFunc_0_eppt sse_fn_eppt;
+    SSEFunc_i_ep sse_fn_i_ep;
     MemOp ot;
 
+    b &= 0xff;
+    if (s->prefix & PREFIX_DATA) {
+        b1 = 1;
+    } else if (s->prefix & PREFIX_REPZ) {
+        b1 = 2;
+    } else if (s->prefix & PREFIX_REPNZ) {
+        b1 = 3;
+    } else {
+        b1 = 0;
+    }
+    map = 0;
+    if (b == 0x38 || b == 0x3a) {
+        map = b;
+        b = x86_ldub_code(env, s);
+        if (b >= 0xf0 && (map == 0x38 || b == 0xf0)) {
+            /* BMI1, BMI2 */
+            s->pc--;
+            return false;
+        }
+    }
+
+    if (!(s->cpuid_ext_features & CPUID_EXT_AVX)
+        || !(s->flags & HF_AVX_EN_MASK)) {
+        goto illegal_op;
+    }
+    if (s->flags & HF_TS_MASK) {
+        gen_exception(s, EXCP07_PREX, pc_start - s->cs_base);
+        return true;
+    }
+    if (avx_is_legacy_op(s, map, b, b1)) {
+        if (s->vex_v) {
+            goto illegal_op;
+        }
+        if (map) {
+            s->pc--;
+        }
+        return false;
+    }
+
+    vvvv = CODE64(s) ? s->vex_v : s->vex_v & 7;
+    len = s->vex_l ? 32 : 16;
+    nlanes = s->vex_l + 1;
+
+    if (map == 0 && b == 0x77) {
+        /* vzeroupper, vzeroall */
+        if (b1 || vvvv) {
+            goto illegal_op;
+        }
+        for (i = 0; i < (CODE64(s) ? 16 : 8); i++) {
+            if (s->vex_l) {
+                tcg_gen_gvec_dup_imm(MO_64, vec_offset(xmm_offset(i), 32),
+                                     32, 32, 0);
+            } else {
+                gen_clear_ymmh(s, xmm_offset(i));
+            }
+        }
+        return true;
+    }
+
+    modrm = x86_ldub_code(env, s);
+    mod = (modrm >> 6) & 3;
+    reg = ((modrm >> 3) & 7) | rex_r;
+    rm = (modrm & 7) | REX_B(s);
+    d_offset = xmm_offset(reg);
+    a_offset = xmm_offset(vvvv);
+
+    if (map == 0) {
+        switch (b | (b1 << 8)) {
+        case 0x010: /* vmovups */
+        case 0x110: /* vmovupd */
+        case 0x028: /* vmovaps */
+        case 0x128: /* vmovapd */
+        case 0x16f: /* vmovdqa */
+        case 0x26f: /* vmovdqu */
+        case 0x3f0: /* vlddqu */
+            if (vvvv || (b == 0xf0 && mod == 3)) {
+                goto illegal_op;
+            }
+            if (mod != 3) {
+                gen_lea_modrm(env, s, modrm);
+                gen_ld_env_A0(s, d_offset, len);
+                if (len == 16) {
+                    gen_clear_ymmh(s, d_offset);
+                }
+            } else {
+                gen_avx_mov(s, d_offset, xmm_offset(rm), len);
+            }
+            return true;
+        case 0x011: /* vmovups */
+        case 0x111: /* vmovupd */
+        case 0x029: /* vmovaps */
+        case 0x129: /* vmovapd */
+        case 0x17f: /* vmovdqa */
+        case 0x27f: /* vmovdqu */
+        case 0x02b: /* vmovntps */
+        case 0x12b: /* vmovntpd */
+        case 0x1e7: /* vmovntdq */
+            if (vvvv || (mod == 3 && (b == 0x2b || b == 0xe7))) {
+                goto illegal_op;
+            }
+            if (mod != 3) {
+                gen_lea_modrm(env, s, modrm);
+                gen_st_env_A0(s, d_offset, len);
+            } else {
+                gen_avx_mov(s, xmm_offset(rm), d_offset, len);
+            }
+            return true;
+        case 0x210: /* vmovss */
+        case 0x310: /* vmovsd */
+        case 0x211: /* vmovss */
+        case 0x311: /* vmovsd */
+            size = b1 == 2 ? 4 : 8;
+            if (mod != 3) {
+                if (vvvv) {
+                    goto illegal_op;
+                }
+                gen_lea_modrm(env, s, modrm);
+                if (b == 0x11) {
+                    gen_st_env_A0(s, d_offset, size);
+                    return true;
+                }
+                gen_ld_env_A0(s, XMM_T0_OFFSET, size);
+                tcg_gen_gvec_dup_imm(MO_64, vec_offset(d_offset, 32),
+                                     32, 32, 0);
+                b_offset = XMM_T0_OFFSET;
+            } else {
+                /* the low element of src2 and the rest of src1 */
+                if (b == 0x11) {
+                    b_offset = d_offset;
+                    d_offset = xmm_offset(rm);
+                } else {
+                    b_offset = xmm_offset(rm);
+                }
+                gen_op_movo_lane(s, XMM_T1_OFFSET, 0, a_offset, 0);
+                if (size == 4) {
+                    gen_op_movl(s, XMM_T1_OFFSET + offsetof(ZMMReg, ZMM_L(0)),
+                                b_offset + offsetof(ZMMReg, ZMM_L(0)));
+                } else {
+                    gen_op_movq(s, XMM_T1_OFFSET + offsetof(ZMMReg, ZMM_Q(0)),
+                                b_offset + offsetof(ZMMReg, ZMM_Q(0)));
+                }
+                gen_avx_mov(s, d_offset, XMM_T1_OFFSET, 16);
+                return true;
+            }
+            if (size == 4) {
+                gen_op_movl(s, d_offset + offsetof(ZMMReg, ZMM_L(0)),
+                            b_offset + offsetof(ZMMReg, ZMM_L(0)));
+            } else {
+                gen_op_movq(s, d_offset + offsetof(ZMMReg, ZMM_Q(0)),
+                            b_offset + offsetof(ZMMReg, ZMM_Q(0)));
+            }
+            return true;
+        case 0x012: /* vmovlps, vmovhlps */
+        case 0x112: /* vmovlpd */
+        case 0x016: /* vmovhps, vmovlhps */
+        case 0x116: /* vmovhpd */
+            if (s->vex_l || (mod == 3 && b1)) {
+                goto illegal_op;
+            }
+            b_offset = gen_avx_load_rm(env, s, modrm, 8);
+            if (b == 0x12) {
+                /* vmovhlps takes the high qword of the register */
+                i = mod == 3;
+                gen_op_movq(s, XMM_T1_OFFSET + offsetof(ZMMReg, ZMM_Q(0)),
+                            b_offset + offsetof(ZMMReg, ZMM_Q(i)));
+                gen_op_movq(s, XMM_T1_OFFSET + offsetof(ZMMReg, ZMM_Q(1)),
+                            a_offset + offsetof(ZMMReg, ZMM_Q(1)));
+            } else {
+                gen_op_movq(s, XMM_T1_OFFSET + offsetof(ZMMReg, ZMM_Q(0)),
+                            a_offset + offsetof(ZMMReg, ZMM_Q(0)));
+                gen_op_movq(s, XMM_T1_OFFSET + offsetof(ZMMReg, ZMM_Q(1)),
+                            b_offset + offsetof(ZMMReg, ZMM_Q(0)));
+            }
+            gen_avx_mov(s, d_offset, XMM_T1_OFFSET, 16);
+            return true;
+        case 0x212: /* vmovsldup */
+        case 0x216: /* vmovshdup */
+            if (vvvv) {
+                goto illegal_op;
+            }
+            b_offset = gen_avx_load_rm(env, s, modrm, len);
+            for (i = 0; i < len / 8; i++) {
+                tcg_gen_ld_i32(s->tmp2_i32, cpu_env, b_offset +
+                               offsetof(ZMMReg, ZMM_L(2 * i + (b == 0x16))));
+                tcg_gen_st_i32(s->tmp2_i32, cpu_env,
+                               d_offset + offsetof(ZMMReg, ZMM_L(2 * i)));
+                tcg_gen_st_i32(s->tmp2_i32, cpu_env,
+                               d_offset + offsetof(ZMMReg, ZMM_L(2 * i + 1)));
+            }
+            if (len == 16) {
+                gen_clear_ymmh(s, d_offset);
+            }
+            return true;
+        case 0x312: /* vmovddup */
+            if (vvvv) {
+                goto illegal_op;
+            }
+            b_offset = gen_avx_load_rm(env, s, modrm, s->vex_l ? 32 : 8);
+            for (i = 0; i < len / 16; i++) {
+                tcg_gen_ld_i64(s->tmp1_i64, cpu_env,
+                               b_offset + offsetof(ZMMReg, ZMM_Q(2 * i)));
+                tcg_gen_st_i64(s->tmp1_i64, cpu_env,
+                               d_offset + offsetof(ZMMReg, ZMM_Q(2 * i)));
+                tcg_gen_st_i64(s->tmp1_i64, cpu_env,
+                               d_offset + offsetof(ZMMReg, ZMM_Q(2 * i + 1)));
+            }
+            if (len == 16) {
+                gen_clear_ymmh(s, d_offset);
+            }
+            return true;
+        case 0x050: /* vmovmskps */
+        case 0x150: /* vmovmskpd */
+        case 0x1d7: /* vpmovmskb */
+            if (mod != 3 || vvvv || (b == 0xd7 && s->vex_l && !avx2)) {
+                goto illegal_op;
+            }
+            if (b == 0xd7) {
+                sse_fn_i_ep = gen_helper_pmovmskb_xmm;
+            } else if (b1) {
+                sse_fn_i_ep = gen_helper_movmskpd;
+            } else {
+                sse_fn_i_ep = gen_helper_movmskps;
+            }
+            tcg_gen_addi_ptr(s->ptr0, cpu_env, xmm_offset(rm));
+            sse_fn_i_ep(s->tmp2_i32, cpu_env, s->ptr0);
+            if (s->vex_l) {
+                gen_op_movo_lane(s, XMM_T0_OFFSET, 0, xmm_offset(rm), 1);
+                tcg_gen_addi_ptr(s->ptr0, cpu_env, XMM_T0_OFFSET);
+                sse_fn_i_ep(s->tmp3_i32, cpu_env, s->ptr0);
+                tcg_gen_shli_i32(s->tmp3_i32, s->tmp3_i32,
+                                 b == 0xd7 ? 16 : b1 ? 2 : 4);
+                tcg_gen_or_i32(s->tmp2_i32, s->tmp2_i32, s->tmp3_i32);
+            }
+            tcg_gen_extu_i32_tl(cpu_regs[reg], s->tmp2_i32);
+            return true;
+        case 0x16e: /* vmovd, vmovq from r/m */
+            if (s->vex_l || vvvv) {
+                goto illegal_op;
+            }
+            ot = mo_64_32(s->dflag);
+            gen_ldst_modrm(env, s, modrm, ot, OR_TMP0, 0);
+            tcg_gen_gvec_dup_imm(MO_64, vec_offset(d_offset, 32), 32, 32, 0);
+            if (ot == MO_64) {
+                tcg_gen_st_tl(s->T0, cpu_env,
+                              d_offset + offsetof(ZMMReg, ZMM_Q(0)));
+            } else {
+                tcg_gen_st32_tl(s->T0, cpu_env,
+                                d_offset + offsetof(ZMMReg, ZMM_L(0)));
+            }
+            return true;
+        case 0x27e: /* vmovq xmm, xmm/m64 */
+        case 0x1d6: /* vmovq xmm/m64, xmm */
+            if (s->vex_l || vvvv) {
+                goto illegal_op;
+            }
+            if (b == 0x7e) {
+                b_offset = gen_avx_load_rm(env, s, modrm, 8);
+            } else if (mod != 3) {
+                gen_lea_modrm(env, s, modrm);
+                gen_stq_env_A0(s, d_offset + offsetof(ZMMReg, ZMM_Q(0)));
+                return true;
+            } else {
+                b_offset = d_offset;
+                d_offset = xmm_offset(rm);
+            }
+            gen_op_movq(s, d_offset + offsetof(ZMMReg, ZMM_Q(0)),
+                        b_offset + offsetof(ZMMReg, ZMM_Q(0)));
+            gen_op_movq_env_0(s, d_offset + offsetof(ZMMReg, ZMM_Q(1)));
+            gen_clear_ymmh(s, d_offset);
+            return true;
+        case 0x1c4: /* vpinsrw */
+            if (s->vex_l) {
+                goto illegal_op;
+            }
+            s->rip_offset = 1;
+            gen_ldst_modrm(env, s, modrm, MO_16, OR_TMP0, 0);
+            val = x86_ldub_code(env, s);
+            gen_op_movo_lane(s, XMM_T1_OFFSET, 0, a_offset, 0);
+            tcg_gen_st16_tl(s->T0, cpu_env,
+                            XMM_T1_OFFSET + offsetof(ZMMReg, ZMM_W(val & 7)));
+            gen_avx_mov(s, d_offset, XMM_T1_OFFSET, 16);
+            return true;
+        case 0x22a: /* vcvtsi2ss */
+        case 0x32a: /* vcvtsi2sd */
+            ot = mo_64_32(s->dflag);
+            gen_ldst_modrm(env, s, modrm, ot, OR_TMP0, 0);
+            gen_op_movo_lane(s, XMM_T1_OFFSET, 0, a_offset, 0);
+            tcg_gen_addi_ptr(s->ptr0, cpu_env, XMM_T1_OFFSET);
+            if (ot == MO_32) {
+                tcg_gen_trunc_tl_i32(s->tmp2_i32, s->T0);
+                sse_op_table3ai[b1 & 1](cpu_env, s->ptr0, s->tmp2_i32);
+            } else {
+#ifdef TARGET_X86_64
+                sse_op_table3aq[b1 & 1](cpu_env, s->ptr0, s->T0);
+#else
+                goto illegal_op;
+#endif
+            }
+            gen_avx_mov(s, d_offset, XMM_T1_OFFSET, 16);
+            return true;
+        case 0x171: /* shift by immediate */
+        case 0x172:
+        case 0x173:
+            if (mod != 3 || (s->vex_l && !avx2)) {
+                goto illegal_op;
+            }
+            i = ((b - 1) & 3) * 8 + ((modrm >> 3) & 7);
+            if (!sse_op_table2[i][1]) {
+                goto illegal_op;
+            }
+            val = x86_ldub_code(env, s);
+            if (i == 16 + 3 || i == 16 + 7) {
+                /* vpsrldq, vpslldq */
+                tcg_gen_movi_tl(s->T0, val);
+                tcg_gen_st32_tl(s->T0, cpu_env,
+                                XMM_T0_OFFSET + offsetof(ZMMReg, ZMM_L(0)));
+                tcg_gen_movi_tl(s->T0, 0);
+                tcg_gen_st32_tl(s->T0, cpu_env,
+                                XMM_T0_OFFSET + offsetof(ZMMReg, ZMM_L(1)));
+                op.kind = AVX_LANE_SHIFT;
+                op.fn_epp = sse_op_table2[i][1];
+                gen_avx_lanes(s, &op, nlanes, a_offset, xmm_offset(rm),
+                              XMM_T0_OFFSET);
+            } else {
+                gen_avx_shifti(s, (modrm >> 3) & 7, b & 3, len,
+                               a_offset, xmm_offset(rm), val);
+            }
+            return true;
+        default:
+            break;
+        }
+
+        sse_fn_epp = sse_op_table1[b][b1];
+        if (!sse_fn_epp || sse_fn_epp == SSE_SPECIAL
+            || sse_fn_epp == SSE_DUMMY || b == 0x78 || b == 0x79
+            || b == 0xf7) {
+            goto illegal_op;
+        }
+        if (b1 == 0 && !((b >= 0x10 && b <= 0x5f) || b == 0xc2 || b == 0xc6)) {
+            /* MMX */
+            goto illegal_op;
+        }
+        if (s->vex_l && !avx2
+            && !((b >= 0x10 && b <= 0x5f) || b == 0xc2 || b == 0xc6
+                 || b == 0x7c || b == 0x7d || b == 0xd0 || b == 0xe6)) {
+            goto illegal_op;
+        }
+
+        if ((b1 == 1 || (b1 == 0 && b >= 0x54 && b <= 0x57))
+            && avx_gvec_table1[b].fn) {
+            b_offset = gen_avx_load_rm(env, s, modrm, len);
+            gen_avx_gvec(s, &avx_gvec_table1[b], len,
+                         d_offset, a_offset, b_offset);
+            return true;
+        }
+
+        size = len;
+        if (b1 >= 2 && ((b >= 0x51 && b <= 0x5f && b != 0x5b) || b == 0xc2)) {
+            /* scalar */
+            nlanes = 1;
+            size = b1 == 2 ? 4 : 8;
+        } else {
+            switch (b) {
+            case 0x51: /* vsqrtps, vsqrtpd */
+            case 0x52: /* vrsqrtps */
+            case 0x53: /* vrcpps */
+            case 0x5b: /* vcvtdq2ps, vcvtps2dq, vcvttps2dq */
+            case 0x70: /* vpshufd, vpshufhw, vpshuflw */
+                op.kind = AVX_LANE_2OP;
+                break;
+            case 0x5a: /* vcvtps2pd, vcvtpd2ps */
+            case 0xe6: /* vcvttpd2dq, vcvtdq2pd, vcvtpd2dq */
+                if (b1 == (b == 0x5a ? 0 : 2)) {
+                    op.kind = AVX_LANE_WIDEN;
+                    op.chunk = 8;
+                    size = 8 * nlanes;
+                } else {
+                    op.kind = AVX_LANE_NARROW;
+                }
+                break;
+            case 0xd1: /* vpsrlw */
+            case 0xd2: /* vpsrld */
+            case 0xd3: /* vpsrlq */
+            case 0xe1: /* vpsraw */
+            case 0xe2: /* vpsrad */
+            case 0xf1: /* vpsllw */
+            case 0xf2: /* vpslld */
+            case 0xf3: /* vpsllq */
+                op.kind = AVX_LANE_SHIFT;
+                size = 16;
+                break;
+            }
+        }
+        if (vvvv && op.kind != AVX_LANE_3OP && op.kind != AVX_LANE_SHIFT) {
+            goto illegal_op;
+        }
+
+        if (b == 0x70 || b == 0xc2 || b == 0xc6) {
+            s->rip_offset = 1;
+        }
+        b_offset = gen_avx_load_rm(env, s, modrm, size);
+        if (b == 0x70 || b == 0xc6) {
+            op.fn_ppi = (SSEFunc_0_ppi)sse_fn_epp;
+            op.imm = x86_ldub_code(env, s);
+            op.imm_shift = b == 0xc6 && b1 ? 2 : 0;
+        } else if (b == 0xc2) {
+            /*
+             * Predicates 16-31 only differ from 0-15 in whether QNaN
+             * operands raise the invalid exception, which is ignored.
+             */
+            val = x86_ldub_code(env, s);
+            op.fn_epp = sse_op_table4[val & 15][b1];
+        } else {
+            op.fn_epp = sse_fn_epp;
+        }
+        gen_avx_lanes(s, &op, nlanes, d_offset, a_offset, b_offset);
+        return true;
+    }
+
+    if (b1 != 1) {
+        goto illegal_op;
+    }
+
+    if (map == 0x38) {
+        switch (b) {
+        case 0x0c: /* vpermilps */
+        case 0x0d: /* vpermilpd */
+            if (s->vex_w) {
+                goto illegal_op;
+            }
+            b_offset = gen_avx_load_rm(env, s, modrm, len);
+            gen_avx_permv(s, d_offset, a_offset, b_offset,
+                          b == 0x0c ? MO_32 : MO_64, len, true);
+            return true;
+        case 0x16: /* vpermps */
+        case 0x36: /* vpermd */
+            if (!avx2 || !s->vex_l || s->vex_w) {
+                goto illegal_op;
+            }
+            b_offset = gen_avx_load_rm(env, s, modrm, len);
+            gen_avx_permv(s, d_offset, b_offset, a_offset, MO_32, len, false);
+            return true;
+        case 0x0e: /* vtestps */
+        case 0x0f: /* vtestpd */
+        case 0x17: /* vptest */
+            if (vvvv || (b != 0x17 && s->vex_w)) {
+                goto illegal_op;
+            }
+            b_offset = gen_avx_load_rm(env, s, modrm, len);
+            gen_avx_ptest(s, d_offset, b_offset, len,
+                          b == 0x17 ? -1 : b == 0x0e ?
+                          0x8000000080000000ull : 0x8000000000000000ull);
+            return true;
+        case 0x18: /* vbroadcastss */
+        case 0x19: /* vbroadcastsd */
+        case 0x58: /* vpbroadcastd */
+        case 0x59: /* vpbroadcastq */
+        case 0x78: /* vpbroadcastb */
+        case 0x79: /* vpbroadcastw */
+            if (b == 0x78) {
+                ot = MO_8;
+            } else if (b == 0x79) {
+                ot = MO_16;
+            } else {
+                ot = b & 1 ? MO_64 : MO_32;
+            }
+            if (vvvv || s->vex_w || (b == 0x19 && !s->vex_l)
+                || ((b >= 0x58 || mod == 3) && !avx2)) {
+                goto illegal_op;
+            }
+            b_offset = gen_avx_load_rm(env, s, modrm, 1 << ot);
+            tcg_gen_gvec_dup_mem(ot, vec_offset(d_offset, len),
+                                 b_offset + zmm_elem_offset(ot, 0), len, len);
+            if (len == 16) {
+                gen_clear_ymmh(s, d_offset);
+            }
+            return true;
+        case 0x1a: /* vbroadcastf128 */
+        case 0x5a: /* vbroadcasti128 */
+            if (vvvv || s->vex_w || !s->vex_l || mod == 3
+                || (b == 0x5a && !avx2)) {
+                goto illegal_op;
+            }
+            b_offset = gen_avx_load_rm(env, s, modrm, 16);
+            gen_op_movo_lane(s, d_offset, 0, b_offset, 0);
+            gen_op_movo_lane(s, d_offset, 1, b_offset, 0);
+            return true;
+        case 0x1c: /* vpabsb */
+        case 0x1d: /* vpabsw */
+        case 0x1e: /* vpabsd */
+            if (vvvv || (s->vex_l && !avx2)) {
+                goto illegal_op;
+            }
+            b_offset = gen_avx_load_rm(env, s, modrm, len);
+            tcg_gen_gvec_abs(b - 0x1c, vec_offset(d_offset, len),
+                             vec_offset(b_offset, len), len, len);
+            if (len == 16) {
+                gen_clear_ymmh(s, d_offset);
+            }
+            return true;
+        case 0x20 ... 0x25: /* vpmovsx */
+        case 0x30 ... 0x35: /* vpmovzx */
+            if (vvvv || (s->vex_l && !avx2)) {
+                goto illegal_op;
+            }
+            op.kind = AVX_LANE_WIDEN;
+            op.chunk = avx_pmov_chunk[b & 7];
+            op.fn_epp = sse_op_table6[b].op[1];
+            b_offset = gen_avx_load_rm(env, s, modrm, op.chunk * nlanes);
+            gen_avx_lanes(s, &op, nlanes, d_offset, a_offset, b_offset);
+            return true;
+        case 0x2a: /* vmovntdqa */
+            if (vvvv || mod == 3 || (s->vex_l && !avx2)) {
+                goto illegal_op;
+            }
+            gen_lea_modrm(env, s, modrm);
+            gen_ld_env_A0(s, d_offset, len);
+            if (len == 16) {
+                gen_clear_ymmh(s, d_offset);
+            }
+            return true;
+        case 0x2c: /* vmaskmovps load */
+        case 0x2d: /* vmaskmovpd load */
+        case 0x2e: /* vmaskmovps store */
+        case 0x2f: /* vmaskmovpd store */
+        case 0x8c: /* vpmaskmovd/q load */
+        case 0x8e: /* vpmaskmovd/q store */
+            if (b & 0x80) {
+                if (!avx2) {
+                    goto illegal_op;
+                }
+                ot = s->vex_w ? MO_64 : MO_32;
+            } else {
+                if (s->vex_w) {
+                    goto illegal_op;
+                }
+                ot = b & 1 ? MO_64 : MO_32;
+            }
+            if (mod == 3) {
+                goto illegal_op;
+            }
+            gen_lea_modrm(env, s, modrm);
+            gen_avx_maskmov(s, reg, vvvv, ot, len, b & 2);
+            return true;
+        case 0x45: /* vpsrlvd/q */
+        case 0x46: /* vpsravd */
+        case 0x47: /* vpsllvd/q */
+            if (!avx2 || (b == 0x46 && s->vex_w)) {
+                goto illegal_op;
+            }
+            b_offset = gen_avx_load_rm(env, s, modrm, len);
+            gen_avx_shiftv(s, b, s->vex_w ? MO_64 : MO_32, len,
+                           d_offset, a_offset, b_offset);
+            return true;
+        case 0x90: /* vpgatherdd/q */
+        case 0x91: /* vpgatherqd/q */
+        case 0x92: /* vgatherdps/d */
+        case 0x93: /* vgatherqps/d */
+            if (!avx2 || !gen_avx_gather(env, s, modrm, b, reg, vvvv)) {
+                goto illegal_op;
+            }
+            return true;
+        default:
+            break;
+        }
+
+        /* the instructions using xmm0 implicitly have no VEX form */
+        if (!sse_op_table6[b].op[1] || b == 0x10 || b == 0x14 || b == 0x15
+            || !(s->cpuid_ext_features & sse_op_table6[b].ext_mask)) {
+            goto illegal_op;
+        }
+        if (s->vex_l && (!avx2 || b == 0x41 || b >= 0xdb)) {
+            goto illegal_op;
+        }
+        b_offset = gen_avx_load_rm(env, s, modrm, len);
+        if (avx_gvec_table6[b].fn) {
+            gen_avx_gvec(s, &avx_gvec_table6[b], len,
+                         d_offset, a_offset, b_offset);
+            return true;
+        }
+        if (b == 0x41 || b == 0xdb) {
+            /* vphminposuw, vaesimc */
+            if (vvvv) {
+                goto illegal_op;
+            }
+            op.kind = AVX_LANE_2OP;
+        }
+        op.fn_epp = sse_op_table6[b].op[1];
+        gen_avx_lanes(s, &op, nlanes, d_offset, a_offset, b_offset);
+        return true;
+    }
+
+    /* VEX.66.0F3A, all with an immediate */
+    s->rip_offset = 1;
+    switch (b) {
+    case 0x00: /* vpermq */
+    case 0x01: /* vpermpd */
+        if (!avx2 || !s->vex_l || !s->vex_w || vvvv) {
+            goto illegal_op;
+        }
+        b_offset = gen_avx_load_rm(env, s, modrm, 32);
+        val = x86_ldub_code(env, s);
+        if (b_offset != XMM_T0_OFFSET) {
+            tcg_gen_gvec_mov(MO_64, vec_offset(XMM_T0_OFFSET, 32),
+                             vec_offset(b_offset, 32), 32, 32);
+        }
+        for (i = 0; i < 4; i++) {
+            gen_op_movq(s, d_offset + offsetof(ZMMReg, ZMM_Q(i)),
+                        XMM_T0_OFFSET +
+                        offsetof(ZMMReg, ZMM_Q((val >> (2 * i)) & 3)));
+        }
+        return true;
+    case 0x04: /* vpermilps */
+        if (vvvv || s->vex_w) {
+            goto illegal_op;
+        }
+        b_offset = gen_avx_load_rm(env, s, modrm, len);
+        op.kind = AVX_LANE_2OP;
+        op.fn_ppi = gen_helper_pshufd_xmm;
+        op.imm = x86_ldub_code(env, s);
+        gen_avx_lanes(s, &op, nlanes, d_offset, a_offset, b_offset);
+        return true;
+    case 0x05: /* vpermilpd */
+        if (vvvv || s->vex_w) {
+            goto illegal_op;
+        }
+        b_offset = gen_avx_load_rm(env, s, modrm, len);
+        val = x86_ldub_code(env, s);
+        if (b_offset != XMM_T0_OFFSET) {
+            tcg_gen_gvec_mov(MO_64, vec_offset(XMM_T0_OFFSET, len),
+                             vec_offset(b_offset, len), len, len);
+        }
+        for (i = 0; i < len / 8; i++) {
+            gen_op_movq(s, d_offset + offsetof(ZMMReg, ZMM_Q(i)),
+                        XMM_T0_OFFSET +
+                        offsetof(ZMMReg, ZMM_Q((i & ~1) | ((val >> i) & 1))));
+        }
+        if (len == 16) {
+            gen_clear_ymmh(s, d_offset);
+        }
+        return true;
+    case 0x06: /* vperm2f128 */
+    case 0x46: /* vperm2i128 */
+        if (!s->vex_l || s->vex_w || (b == 0x46 && !avx2)) {
+            goto illegal_op;
+        }
+        b_offset = gen_avx_load_rm(env, s, modrm, 32);
+        val = x86_ldub_code(env, s);
+        tcg_gen_gvec_mov(MO_64, vec_offset(XMM_T1_OFFSET, 32),
+                         vec_offset(a_offset, 32), 32, 32);
+        if (b_offset != XMM_T0_OFFSET) {
+            tcg_gen_gvec_mov(MO_64, vec_offset(XMM_T0_OFFSET, 32),
+                             vec_offset(b_offset, 32), 32, 32);
+        }
+        for (i = 0; i < 2; i++) {
+            int sel = val >> (4 * i);
+
+            if (sel & 8) {
+                gen_op_movq_env_0(s, d_offset +
+                                  offsetof(ZMMReg, ZMM_Q(2 * i)));
+                gen_op_movq_env_0(s, d_offset +
+                                  offsetof(ZMMReg, ZMM_Q(2 * i + 1)));
+            } else {
+                gen_op_movo_lane(s, d_offset, i,
+                                 sel & 2 ? XMM_T0_OFFSET : XMM_T1_OFFSET,
+                                 sel & 1);
+            }
+        }
+        return true;
+    case 0x18: /* vinsertf128 */
+    case 0x38: /* vinserti128 */
+        if (!s->vex_l || s->vex_w || (b == 0x38 && !avx2)) {
+            goto illegal_op;
+        }
+        b_offset = gen_avx_load_rm(env, s, modrm, 16);
+        val = x86_ldub_code(env, s) & 1;
+        if (b_offset != XMM_T0_OFFSET) {
+            gen_op_movo_lane(s, XMM_T0_OFFSET, 0, b_offset, 0);
+        }
+        if (a_offset != d_offset) {
+            gen_op_movo_lane(s, d_offset, !val, a_offset, !val);
+        }
+        gen_op_movo_lane(s, d_offset, val, XMM_T0_OFFSET, 0);
+        return true;
+    case 0x19: /* vextractf128 */
+    case 0x39: /* vextracti128 */
+        if (!s->vex_l || s->vex_w || vvvv || (b == 0x39 && !avx2)) {
+            goto illegal_op;
+        }
+        if (mod != 3) {
+            gen_lea_modrm(env, s, modrm);
+            val = x86_ldub_code(env, s) & 1;
+            gen_op_movo_lane(s, XMM_T0_OFFSET, 0, d_offset, val);
+            gen_sto_env_A0(s, XMM_T0_OFFSET);
+        } else {
+            val = x86_ldub_code(env, s) & 1;
+            gen_op_movo_lane(s, xmm_offset(rm), 0, d_offset, val);
+            gen_clear_ymmh(s, xmm_offset(rm));
+        }
+        return true;
+    case 0x20: /* vpinsrb */
+    case 0x21: /* vinsertps */
+    case 0x22: /* vpinsrd, vpinsrq */
+        if (s->vex_l) {
+            goto illegal_op;
+        }
+        if (b == 0x21) {
+            if (mod == 3) {
+                val = x86_ldub_code(env, s);
+                tcg_gen_ld_i32(s->tmp2_i32, cpu_env, xmm_offset(rm) +
+                               offsetof(ZMMReg, ZMM_L((val >> 6) & 3)));
+            } else {
+                gen_lea_modrm(env, s, modrm);
+                tcg_gen_qemu_ld_i32(s->tmp2_i32, s->A0,
+                                    s->mem_index, MO_LEUL);
+                val = x86_ldub_code(env, s);
+            }
+        } else {
+            ot = b == 0x20 ? MO_8 : s->dflag == MO_64 ? MO_64 : MO_32;
+            if (mod == 3) {
+                gen_op_mov_v_reg(s, ot == MO_64 ? MO_64 : MO_32, s->T0, rm);
+            } else {
+                gen_lea_modrm(env, s, modrm);
+                gen_op_ld_v(s, ot, s->T0, s->A0);
+            }
+            val = x86_ldub_code(env, s);
+        }
+        gen_op_movo_lane(s, XMM_T1_OFFSET, 0, a_offset, 0);
+        if (b == 0x21) {
+            tcg_gen_st_i32(s->tmp2_i32, cpu_env, XMM_T1_OFFSET +
+                           offsetof(ZMMReg, ZMM_L((val >> 4) & 3)));
+            tcg_gen_movi_i32(s->tmp2_i32, 0);
+            for (i = 0; i < 4; i++) {
+                if ((val >> i) & 1) {
+                    tcg_gen_st_i32(s->tmp2_i32, cpu_env, XMM_T1_OFFSET +
+                                   offsetof(ZMMReg, ZMM_L(i)));
+                }
+            }
+        } else if (ot == MO_8) {
+            tcg_gen_st8_tl(s->T0, cpu_env, XMM_T1_OFFSET +
+                           offsetof(ZMMReg, ZMM_B(val & 15)));
+        } else if (ot == MO_32) {
+            tcg_gen_st32_tl(s->T0, cpu_env, XMM_T1_OFFSET +
+                            offsetof(ZMMReg, ZMM_L(val & 3)));
+        } else {
+            tcg_gen_st_tl(s->T0, cpu_env, XMM_T1_OFFSET +
+                          offsetof(ZMMReg, ZMM_Q(val & 1)));
+        }
+        gen_avx_mov(s, d_offset, XMM_T1_OFFSET, 16);
+        return true;
+    case 0x4a: /* vblendvps */
+    case 0x4b: /* vblendvpd */
+    case 0x4c: /* vpblendvb */
+        if (s->vex_w || (b == 0x4c && s->vex_l && !avx2)) {
+            goto illegal_op;
+        }
+        b_offset = gen_avx_load_rm(env, s, modrm, len);
+        val = x86_ldub_code(env, s) >> 4;
+        if (!CODE64(s)) {
+            val &= 7;
+        }
+        gen_avx_blendv(s, b == 0x4a ? MO_32 : b == 0x4b ? MO_64 : MO_8, len,
+                       d_offset, a_offset, b_offset, xmm_offset(val));
+        return true;
+    case 0x60: /* vpcmpestrm */
+    case 0x61: /* vpcmpestri */
+    case 0x62: /* vpcmpistrm */
+    case 0x63: /* vpcmpistri */
+        if (s->vex_l || vvvv
+            || !(s->cpuid_ext_features & CPUID_EXT_SSE42)) {
+            goto illegal_op;
+        }
+        b_offset = gen_avx_load_rm(env, s, modrm, 16);
+        val = x86_ldub_code(env, s);
+        if (s->dflag == MO_64) {
+            /* The helper must use entire 64-bit gp registers */
+            val |= 1 << 8;
+        }
+        set_cc_op(s, CC_OP_EFLAGS);
+        tcg_gen_addi_ptr(s->ptr0, cpu_env, d_offset);
+        tcg_gen_addi_ptr(s->ptr1, cpu_env, b_offset);
+        sse_op_table7[b].op[1](cpu_env, s->ptr0, s->ptr1, tcg_const_i32(val));
+        if (!(b & 1)) {
+            gen_clear_ymmh(s, xmm_offset(0));
+        }
+        return true;
+    default:
+        break;
+    }
+
+    if (b == 0x02) {
+        /* vpblendd */
+        if (!avx2 || s->vex_w) {
+            goto illegal_op;
+        }
+        op.fn_eppi = gen_helper_blendps_xmm;
+    } else {
+        op.fn_eppi = sse_op_table7[b].op[1];
+        if (!op.fn_eppi || op.fn_eppi == SSE_SPECIAL
+            || !(s->cpuid_ext_features & sse_op_table7[b].ext_mask)) {
+            goto illegal_op;
+        }
+    }
+    if (s->vex_l) {
+        switch (b) {
+        case 0x0e: /* vpblendw */
+        case 0x0f: /* vpalignr */
+        case 0x42: /* vmpsadbw */
+            if (!avx2) {
+                goto illegal_op;
+            }
+            break;
+        case 0x02:
+        case 0x08: /* vroundps */
+        case 0x09: /* vroundpd */
+        case 0x0c: /* vblendps */
+        case 0x0d: /* vblendpd */
+        case 0x40: /* vdpps */
+            break;
+        case 0x0a: /* vroundss */
+        case 0x0b: /* vroundsd */
+            /* LIG */
+            break;
+        default:
+            goto illegal_op;
+        }
+    }
+
+    size = len;
+    switch (b) {
+    case 0x02:
+    case 0x0c:
+        op.imm_shift = 4;
+        break;
+    case 0x0d:
+        op.imm_shift = 2;
+        break;
+    case 0x42:
+        op.imm_shift = 3;
+        break;
+    case 0x0a:
+    case 0x0b:
+        nlanes = 1;
+        size = b == 0x0a ? 4 : 8;
+        break;
+    case 0x08:
+    case 0x09:
+    case 0xdf: /* vaeskeygenassist */
+        if (vvvv) {
+            goto illegal_op;
+        }
+        op.kind = AVX_LANE_2OP;
+        break;
+    }
+    b_offset = gen_avx_load_rm(env, s, modrm, size);
+    op.imm = x86_ldub_code(env, s);
+    gen_avx_lanes(s, &op, nlanes, d_offset, a_offset, b_offset);
+    return true;
+
+ illegal_op:
+    gen_illegal_opcode(s);
+    return true;
+}
+
+static void gen_sse(CPUX86State *env, DisasContext *s, int b,
+                    target_ulong pc_start, int rex_r)
+{
+    int b1, op1_offset, op2_offset, is_xmm, val;
+    int modrm, mod, rm, reg;
+    SSEFunc_0_epp sse_fn_epp;
+    SSEFunc_0_eppi sse_fn_eppi;
+    SSEFunc_0_ppi sse_fn_ppi;
+    SSEFunc_0_eppt sse_fn_eppt;
+    MemOp ot;
+
+    if ((s->prefix & PREFIX_VEX) && gen_avx(env, s, b, pc_start, rex_r)) {
+        return;
+    }
+
     b &= 0xff;
     if (s->prefix & PREFIX_DATA)
         b1 = 1;
@@ -4497,6 +6069,7 @@ static target_ulong disas_insn(DisasContext *s, CPUState *cpu)
     s->rip_offset = 0; /* for relative ip address */
     s->vex_l = 0;
     s->vex_v = 0;
+    s->vex_w = 0;
     if (sigsetjmp(s->jmpbuf, 0) != 0) {
         gen_exception(s, EXCP0D_GPF, pc_start - s->cs_base);
         return s->pc;
@@ -4597,6 +6170,7 @@ static target_ulong disas_insn(DisasContext *s, CPUState *cpu)
 #endif
                 vex3 = x86_ldub_code(env, s);
                 rex_w = (vex3 >> 7) & 1;
+                s->vex_w = rex_w;
                 switch (vex2 & 0x1f) {
                 case 0x01: /* Implied 0f leading opcode bytes.  */
                     b = x86_ldub_code(env, s) | 0x100;
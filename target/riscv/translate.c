@@ -356,6 +356,12 @@ static void gen_jal(DisasContext *ctx, int rd, target_ulong imm)
         tcg_gen_movi_tl(cpu_gpr[rd], ctx->pc_succ_insn);
     }
 
+    /* Keep translating at the destination if it is nearby */
+    if (translator_follow_jump(&ctx->base, ctx->pc_succ_insn, next_pc)) {
+        ctx->pc_succ_insn = next_pc;
+        return;
+    }
+
     gen_goto_tb(ctx, 0, ctx->base.pc_next + imm); /* must use this for safety */
     ctx->base.is_jmp = DISAS_NORETURN;
 }
@@ -36,6 +36,7 @@
 #include "qemu/qemu-print.h"
 #include "qemu/timer.h"
 #include "qemu/cacheflush.h"
+#include "qemu/bitmap.h"
 
 /* Note: the long term plan is to reduce the dependencies on the QEMU
    CPU definitions. Currently they are used for qemu_ld/st
@@ -194,6 +195,9 @@ struct tcg_region_state {
     /* fields protected by the lock */
     size_t current; /* current region index */
     size_t agg_size_full; /* aggregate size of full regions */
+    unsigned long *evicted; /* regions emptied by tcg_region_evict */
+    uint64_t *alloc_seq; /* per-region allocation order, for LRU eviction */
+    uint64_t next_seq;
 };
 
 static struct tcg_region_state region;
@@ -516,10 +520,23 @@ static void tcg_region_trees_init(void)
     }
 }
 
-static struct tcg_region_tree *tc_ptr_to_region_tree(const void *p)
+/* @p must point into the rw view of code_gen_buffer */
+static size_t tc_ptr_to_region_idx(const void *p)
 {
-    size_t region_idx;
+    ptrdiff_t offset;
 
+    if (p < region.start_aligned) {
+        return 0;
+    }
+    offset = p - region.start_aligned;
+    if (offset > region.stride * (region.n - 1)) {
+        return region.n - 1;
+    }
+    return offset / region.stride;
+}
+
+static struct tcg_region_tree *tc_ptr_to_region_tree(const void *p)
+{
     /*
      * Like tcg_splitwx_to_rw, with no assert.  The pc may come from
      * a signal handler over which the caller has no control.
@@ -530,19 +547,7 @@ static struct tcg_region_tree *tc_ptr_to_region_tree(const void *p)
             return NULL;
         }
     }
-
-    if (p < region.start_aligned) {
-        region_idx = 0;
-    } else {
-        ptrdiff_t offset = p - region.start_aligned;
-
-        if (offset > region.stride * (region.n - 1)) {
-            region_idx = region.n - 1;
-        } else {
-            region_idx = offset / region.stride;
-        }
-    }
-    return region_trees + region_idx * tree_size;
+    return region_trees + tc_ptr_to_region_idx(p) * tree_size;
 }
 
 void tcg_tb_insert(TranslationBlock *tb)
@@ -692,11 +697,20 @@ static void tcg_region_assign(TCGContext *s, size_t curr_region)
 
 static bool tcg_region_alloc__locked(TCGContext *s)
 {
-    if (region.current == region.n) {
-        return true;
+    size_t curr_region;
+
+    if (region.current < region.n) {
+        curr_region = region.current++;
+    } else {
+        /* all regions have been handed out once; reuse an evicted one */
+        curr_region = find_first_bit(region.evicted, region.n);
+        if (curr_region == region.n) {
+            return true;
+        }
+        clear_bit(curr_region, region.evicted);
     }
-    tcg_region_assign(s, region.current);
-    region.current++;
+    region.alloc_seq[curr_region] = region.next_seq++;
+    tcg_region_assign(s, curr_region);
     return false;
 }
 
@@ -737,6 +751,8 @@ void tcg_region_reset_all(void)
     qemu_mutex_lock(&region.lock);
     region.current = 0;
     region.agg_size_full = 0;
+    region.next_seq = 0;
+    bitmap_zero(region.evicted, region.n);
 
     for (i = 0; i < n_ctxs; i++) {
         TCGContext *s = qatomic_read(&tcg_ctxs[i]);
@@ -749,6 +765,90 @@ void tcg_region_reset_all(void)
     tcg_region_tree_reset_all();
 }
 
+/* Fraction of the regions that tcg_region_evict reclaims per call */
+#define TCG_REGION_EVICT_DIV 8
+
+static gboolean tcg_region_tree_evict(gpointer k, gpointer v, gpointer data)
+{
+    void (*invalidate)(TranslationBlock *) = data;
+    TranslationBlock *tb = v;
+
+    invalidate(tb);
+    tb_destroy(tb);
+    return FALSE;
+}
+
+/* Called with region.lock held */
+static void tcg_region_evict_one(size_t curr_region,
+                                 void (*invalidate)(TranslationBlock *))
+{
+    struct tcg_region_tree *rt = region_trees + curr_region * tree_size;
+    void *start, *end;
+
+    qemu_mutex_lock(&rt->lock);
+    g_tree_foreach(rt->tree, tcg_region_tree_evict, invalidate);
+    /* Increment the refcount first so that destroy acts as a reset */
+    g_tree_ref(rt->tree);
+    g_tree_destroy(rt->tree);
+    qemu_mutex_unlock(&rt->lock);
+
+    /* the region was accounted as full when its owner moved on from it */
+    tcg_region_bounds(curr_region, &start, &end);
+    region.agg_size_full -= (end - start) - TCG_HIGHWATER;
+    set_bit(curr_region, region.evicted);
+}
+
+/*
+ * Reclaim the least recently allocated regions that are not in use by any
+ * TCG context, calling @invalidate on each of their TBs before the TB is
+ * dropped.  Up to 1/TCG_REGION_EVICT_DIV of the regions are reclaimed.
+ *
+ * Returns the number of regions now available for allocation; zero means
+ * that the caller must fall back to tcg_region_reset_all.
+ *
+ * Call from a safe-work context.
+ */
+size_t tcg_region_evict(void (*invalidate)(TranslationBlock *))
+{
+    unsigned int n_ctxs = qatomic_read(&n_tcg_ctxs);
+    unsigned long *busy = bitmap_new(region.n);
+    size_t max = MAX(region.n / TCG_REGION_EVICT_DIV, 1);
+    size_t i, j, avail;
+
+    qemu_mutex_lock(&region.lock);
+    for (i = 0; i < n_ctxs; i++) {
+        TCGContext *s = qatomic_read(&tcg_ctxs[i]);
+
+        set_bit(tc_ptr_to_region_idx(s->code_gen_buffer), busy);
+    }
+    /* never-allocated and already evicted regions hold no TBs */
+    bitmap_set(busy, region.current, region.n - region.current);
+    bitmap_or(busy, busy, region.evicted, region.n);
+
+    for (j = 0; j < max; j++) {
+        size_t oldest = region.n;
+
+        for (i = find_first_zero_bit(busy, region.n); i < region.n;
+             i = find_next_zero_bit(busy, region.n, i + 1)) {
+            if (oldest == region.n ||
+                region.alloc_seq[i] < region.alloc_seq[oldest]) {
+                oldest = i;
+            }
+        }
+        if (oldest == region.n) {
+            break;
+        }
+        tcg_region_evict_one(oldest, invalidate);
+        set_bit(oldest, busy);
+    }
+    avail = region.n - region.current +
+            bitmap_count_one(region.evicted, region.n);
+    qemu_mutex_unlock(&region.lock);
+
+    g_free(busy);
+    return avail;
+}
+
 #ifdef CONFIG_USER_ONLY
 static size_t tcg_n_regions(void)
 {
@@ -764,30 +864,31 @@ static size_t tcg_n_regions(void)
 static size_t tcg_n_regions(void)
 {
     size_t i;
-
-    /* Use a single region if all we have is one vCPU thread */
-#if !defined(CONFIG_USER_ONLY)
     MachineState *ms = MACHINE(qdev_get_machine());
-    unsigned int max_cpus = ms->smp.max_cpus;
-#endif
-    if (max_cpus == 1 || !qemu_tcg_mttcg_enabled()) {
-        return 1;
+    unsigned int n_threads = ms->smp.max_cpus;
+
+    /*
+     * A single vCPU thread still gets several regions, so that a full
+     * code_gen_buffer can be recycled a region at a time.
+     */
+    if (!qemu_tcg_mttcg_enabled()) {
+        n_threads = 1;
     }
 
-    /* Try to have more regions than max_cpus, with each region being >= 2 MB */
+    /* Try to have more regions than threads, with each region being >= 2 MB */
     for (i = 8; i > 0; i--) {
         size_t regions_per_thread = i;
         size_t region_size;
 
         region_size = tcg_init_ctx.code_gen_buffer_size;
-        region_size /= max_cpus * regions_per_thread;
+        region_size /= n_threads * regions_per_thread;
 
         if (region_size >= 2 * 1024u * 1024) {
-            return max_cpus * regions_per_thread;
+            return n_threads * regions_per_thread;
         }
     }
     /* If we can't, then just allocate one region per vCPU thread */
-    return max_cpus;
+    return n_threads;
 }
 #endif
 
@@ -802,7 +903,8 @@ static size_t tcg_n_regions(void)
  * code in parallel without synchronization.
  *
  * In softmmu the number of TCG threads is bounded by max_cpus, so we use at
- * least max_cpus regions in MTTCG. In !MTTCG we use a single region.
+ * least max_cpus regions in MTTCG. In !MTTCG the single TCG thread still
+ * gets several regions, so that tcg_region_evict can reclaim old ones.
  * Note that the TCG options from the command-line (i.e. -accel accel=tcg,[...])
  * must have been parsed before calling this function, since it calls
  * qemu_tcg_mttcg_enabled().
@@ -856,6 +958,8 @@ void tcg_region_init(void)
     region.end = QEMU_ALIGN_PTR_DOWN(buf + size, page_size);
     /* account for that last guard page */
     region.end -= page_size;
+    region.evicted = bitmap_new(region.n);
+    region.alloc_seq = g_new0(uint64_t, region.n);
 
     /*
      * Set guard pages in the rw buffer, as that's the one into which
@@ -1320,6 +1424,7 @@ void tcg_func_start(TCGContext *s)
     }
 
     s->nb_ops = 0;
+    s->nb_spills = 0;
     s->nb_labels = 0;
     s->current_frame_offset = s->frame_start;
 
@@ -3590,6 +3695,9 @@ static void tcg_reg_free(TCGContext *s, TCGReg reg, TCGRegSet allocated_regs)
 {
     TCGTemp *ts = s->reg_to_temp[reg];
     if (ts != NULL) {
+        if (!temp_readonly(ts) && !ts->mem_coherent) {
+            s->nb_spills++;
+        }
         temp_sync(s, ts, allocated_regs, 0, -1);
     }
 }
@@ -4633,7 +4741,10 @@ int tcg_gen_code(TCGContext *s, TranslationBlock *tb)
 #endif
 
 #ifdef USE_TCG_OPTIMIZATIONS
-    tcg_optimize(s);
+    /* Quick translations skip the optimizer until the TB becomes hot */
+    if (!tb->hot_countdown) {
+        tcg_optimize(s);
+    }
 #endif
 
 #ifdef CONFIG_PROFILER
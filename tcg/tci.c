@@ -237,6 +237,19 @@ static void tci_args_rrcl(const uint8_t **tb_ptr,
     check_size(start, tb_ptr);
 }
 
+static void tci_args_ricl(const uint8_t **tb_ptr, TCGReg *r0,
+                          tcg_target_ulong *i1, TCGCond *c2, void **l3)
+{
+    const uint8_t *start = *tb_ptr;
+
+    *r0 = tci_read_r(tb_ptr);
+    *i1 = tci_read_i32(tb_ptr);
+    *c2 = tci_read_b(tb_ptr);
+    *l3 = (void *)tci_read_label(tb_ptr);
+
+    check_size(start, tb_ptr);
+}
+
 static void tci_args_rrrc(const uint8_t **tb_ptr,
                           TCGReg *r0, TCGReg *r1, TCGReg *r2, TCGCond *c3)
 {
@@ -465,18 +478,25 @@ static bool tci_compare64(uint64_t u0, uint64_t u1, TCGCond condition)
     cpu_stq_be_mmuidx_ra(env, taddr, X, get_mmuidx(oi), (uintptr_t)tb_ptr)
 
 #if TCG_TARGET_REG_BITS == 64
-# define CASE_32_64(x) \
-        case glue(glue(INDEX_op_, x), _i64): \
-        case glue(glue(INDEX_op_, x), _i32):
-# define CASE_64(x) \
-        case glue(glue(INDEX_op_, x), _i64):
+# define DISPATCH_32_64(x, l) \
+        [glue(glue(INDEX_op_, x), _i64)] = &&l, \
+        [glue(glue(INDEX_op_, x), _i32)] = &&l,
+# define DISPATCH_64(x, l) \
+        [glue(glue(INDEX_op_, x), _i64)] = &&l,
 #else
-# define CASE_32_64(x) \
-        case glue(glue(INDEX_op_, x), _i32):
-# define CASE_64(x)
+# define DISPATCH_32_64(x, l) \
+        [glue(glue(INDEX_op_, x), _i32)] = &&l,
+# define DISPATCH_64(x, l)
 #endif
 
-/* Interpret pseudo code in tb. */
+/*
+ * Interpret pseudo code in tb.
+ *
+ * Opcodes are dispatched through a table of label addresses rather than
+ * a switch.  The dispatch sequence at the top of the loop is small enough
+ * for the compiler to duplicate into every handler, so each opcode gets
+ * its own indirect branch and its own branch prediction history.
+ */
 /*
  * Disable CFI checks.
  * One possible operation in the pseudo code is a call to binary code.
@@ -489,6 +509,119 @@ uintptr_t QEMU_DISABLE_CFI tcg_qemu_tb_exec(CPUArchState *env,
     tcg_target_ulong regs[TCG_TARGET_NB_REGS];
     long tcg_temps[CPU_TEMP_BUF_NLONGS];
     uintptr_t sp_value = (uintptr_t)(tcg_temps + CPU_TEMP_BUF_NLONGS);
+    static const void * const dispatch[NB_OPS] = {
+        [0 ... NB_OPS - 1] = &&op_invalid,
+        [INDEX_op_call] = &&op_call,
+        [INDEX_op_br] = &&op_br,
+        [INDEX_op_setcond_i32] = &&op_setcond_i32,
+#if TCG_TARGET_REG_BITS == 32
+        [INDEX_op_setcond2_i32] = &&op_setcond2_i32,
+#elif TCG_TARGET_REG_BITS == 64
+        [INDEX_op_setcond_i64] = &&op_setcond_i64,
+#endif
+        DISPATCH_32_64(mov, op_mov)
+        [INDEX_op_tci_movi_i32] = &&op_tci_movi_i32,
+        DISPATCH_32_64(ld8u, op_ld8u)
+        DISPATCH_32_64(ld8s, op_ld8s)
+        DISPATCH_32_64(ld16u, op_ld16u)
+        DISPATCH_32_64(ld16s, op_ld16s)
+        [INDEX_op_ld_i32] = &&op_ld_i32,
+        DISPATCH_64(ld32u, op_ld_i32)
+        DISPATCH_32_64(st8, op_st8)
+        DISPATCH_32_64(st16, op_st16)
+        [INDEX_op_st_i32] = &&op_st_i32,
+        DISPATCH_64(st32, op_st_i32)
+        DISPATCH_32_64(add, op_add)
+        DISPATCH_32_64(sub, op_sub)
+        DISPATCH_32_64(mul, op_mul)
+        DISPATCH_32_64(and, op_and)
+        DISPATCH_32_64(or, op_or)
+        DISPATCH_32_64(xor, op_xor)
+        DISPATCH_32_64(tci_addi, op_tci_addi)
+        DISPATCH_32_64(tci_andi, op_tci_andi)
+        [INDEX_op_div_i32] = &&op_div_i32,
+        [INDEX_op_divu_i32] = &&op_divu_i32,
+        [INDEX_op_rem_i32] = &&op_rem_i32,
+        [INDEX_op_remu_i32] = &&op_remu_i32,
+        [INDEX_op_shl_i32] = &&op_shl_i32,
+        [INDEX_op_shr_i32] = &&op_shr_i32,
+        [INDEX_op_sar_i32] = &&op_sar_i32,
+#if TCG_TARGET_HAS_rot_i32
+        [INDEX_op_rotl_i32] = &&op_rotl_i32,
+        [INDEX_op_rotr_i32] = &&op_rotr_i32,
+#endif
+#if TCG_TARGET_HAS_deposit_i32
+        [INDEX_op_deposit_i32] = &&op_deposit_i32,
+#endif
+        [INDEX_op_brcond_i32] = &&op_brcond_i32,
+        [INDEX_op_tci_brcondi_i32] = &&op_tci_brcondi_i32,
+#if TCG_TARGET_REG_BITS == 32
+        [INDEX_op_add2_i32] = &&op_add2_i32,
+        [INDEX_op_sub2_i32] = &&op_sub2_i32,
+        [INDEX_op_brcond2_i32] = &&op_brcond2_i32,
+        [INDEX_op_mulu2_i32] = &&op_mulu2_i32,
+#endif /* TCG_TARGET_REG_BITS == 32 */
+#if TCG_TARGET_HAS_ext8s_i32 || TCG_TARGET_HAS_ext8s_i64
+        DISPATCH_32_64(ext8s, op_ext8s)
+#endif
+#if TCG_TARGET_HAS_ext16s_i32 || TCG_TARGET_HAS_ext16s_i64
+        DISPATCH_32_64(ext16s, op_ext16s)
+#endif
+#if TCG_TARGET_HAS_ext8u_i32 || TCG_TARGET_HAS_ext8u_i64
+        DISPATCH_32_64(ext8u, op_ext8u)
+#endif
+#if TCG_TARGET_HAS_ext16u_i32 || TCG_TARGET_HAS_ext16u_i64
+        DISPATCH_32_64(ext16u, op_ext16u)
+#endif
+#if TCG_TARGET_HAS_bswap16_i32 || TCG_TARGET_HAS_bswap16_i64
+        DISPATCH_32_64(bswap16, op_bswap16)
+#endif
+#if TCG_TARGET_HAS_bswap32_i32 || TCG_TARGET_HAS_bswap32_i64
+        DISPATCH_32_64(bswap32, op_bswap32)
+#endif
+#if TCG_TARGET_HAS_not_i32 || TCG_TARGET_HAS_not_i64
+        DISPATCH_32_64(not, op_not)
+#endif
+#if TCG_TARGET_HAS_neg_i32 || TCG_TARGET_HAS_neg_i64
+        DISPATCH_32_64(neg, op_neg)
+#endif
+#if TCG_TARGET_REG_BITS == 64
+        [INDEX_op_tci_movi_i64] = &&op_tci_movi_i64,
+        [INDEX_op_ld32s_i64] = &&op_ld32s_i64,
+        [INDEX_op_ld_i64] = &&op_ld_i64,
+        [INDEX_op_st_i64] = &&op_st_i64,
+        [INDEX_op_div_i64] = &&op_div_i64,
+        [INDEX_op_divu_i64] = &&op_divu_i64,
+        [INDEX_op_rem_i64] = &&op_rem_i64,
+        [INDEX_op_remu_i64] = &&op_remu_i64,
+        [INDEX_op_shl_i64] = &&op_shl_i64,
+        [INDEX_op_shr_i64] = &&op_shr_i64,
+        [INDEX_op_sar_i64] = &&op_sar_i64,
+#if TCG_TARGET_HAS_rot_i64
+        [INDEX_op_rotl_i64] = &&op_rotl_i64,
+        [INDEX_op_rotr_i64] = &&op_rotr_i64,
+#endif
+#if TCG_TARGET_HAS_deposit_i64
+        [INDEX_op_deposit_i64] = &&op_deposit_i64,
+#endif
+        [INDEX_op_brcond_i64] = &&op_brcond_i64,
+        [INDEX_op_tci_brcondi_i64] = &&op_tci_brcondi_i64,
+        [INDEX_op_ext32s_i64] = &&op_ext32s_i64,
+        [INDEX_op_ext_i32_i64] = &&op_ext32s_i64,
+        [INDEX_op_ext32u_i64] = &&op_ext32u_i64,
+        [INDEX_op_extu_i32_i64] = &&op_ext32u_i64,
+#if TCG_TARGET_HAS_bswap64_i64
+        [INDEX_op_bswap64_i64] = &&op_bswap64_i64,
+#endif
+#endif /* TCG_TARGET_REG_BITS == 64 */
+        [INDEX_op_exit_tb] = &&op_exit_tb,
+        [INDEX_op_goto_tb] = &&op_goto_tb,
+        [INDEX_op_qemu_ld_i32] = &&op_qemu_ld_i32,
+        [INDEX_op_qemu_ld_i64] = &&op_qemu_ld_i64,
+        [INDEX_op_qemu_st_i32] = &&op_qemu_st_i32,
+        [INDEX_op_qemu_st_i64] = &&op_qemu_st_i64,
+        [INDEX_op_mb] = &&op_mb,
+    };
 
     regs[TCG_AREG0] = (tcg_target_ulong)env;
     regs[TCG_REG_CALL_STACK] = sp_value;
@@ -514,8 +647,9 @@ uintptr_t QEMU_DISABLE_CFI tcg_qemu_tb_exec(CPUArchState *env,
         /* Skip opcode and size entry. */
         tb_ptr += 2;
 
-        switch (opc) {
-        case INDEX_op_call:
+        goto *dispatch[opc];
+
+        op_call:
             tci_args_l(&tb_ptr, &ptr);
             tci_tb_ptr = (uintptr_t)tb_ptr;
 #if TCG_TARGET_REG_BITS == 32
@@ -542,178 +676,190 @@ uintptr_t QEMU_DISABLE_CFI tcg_qemu_tb_exec(CPUArchState *env,
                                            tci_read_reg(regs, TCG_REG_R5));
             tci_write_reg(regs, TCG_REG_R0, tmp64);
 #endif
-            break;
-        case INDEX_op_br:
+            continue;
+        op_br:
             tci_args_l(&tb_ptr, &ptr);
             tb_ptr = ptr;
             continue;
-        case INDEX_op_setcond_i32:
+        op_setcond_i32:
             tci_args_rrrc(&tb_ptr, &r0, &r1, &r2, &condition);
             regs[r0] = tci_compare32(regs[r1], regs[r2], condition);
-            break;
+            continue;
 #if TCG_TARGET_REG_BITS == 32
-        case INDEX_op_setcond2_i32:
+        op_setcond2_i32:
             tci_args_rrrrrc(&tb_ptr, &r0, &r1, &r2, &r3, &r4, &condition);
             T1 = tci_uint64(regs[r2], regs[r1]);
             T2 = tci_uint64(regs[r4], regs[r3]);
             regs[r0] = tci_compare64(T1, T2, condition);
-            break;
+            continue;
 #elif TCG_TARGET_REG_BITS == 64
-        case INDEX_op_setcond_i64:
+        op_setcond_i64:
             tci_args_rrrc(&tb_ptr, &r0, &r1, &r2, &condition);
             regs[r0] = tci_compare64(regs[r1], regs[r2], condition);
-            break;
+            continue;
 #endif
-        CASE_32_64(mov)
+        op_mov:
             tci_args_rr(&tb_ptr, &r0, &r1);
             regs[r0] = regs[r1];
-            break;
-        case INDEX_op_tci_movi_i32:
+            continue;
+        op_tci_movi_i32:
             tci_args_ri(&tb_ptr, &r0, &t1);
             regs[r0] = t1;
-            break;
+            continue;
 
             /* Load/store operations (32 bit). */
 
-        CASE_32_64(ld8u)
+        op_ld8u:
             tci_args_rrs(&tb_ptr, &r0, &r1, &ofs);
             ptr = (void *)(regs[r1] + ofs);
             regs[r0] = *(uint8_t *)ptr;
-            break;
-        CASE_32_64(ld8s)
+            continue;
+        op_ld8s:
             tci_args_rrs(&tb_ptr, &r0, &r1, &ofs);
             ptr = (void *)(regs[r1] + ofs);
             regs[r0] = *(int8_t *)ptr;
-            break;
-        CASE_32_64(ld16u)
+            continue;
+        op_ld16u:
             tci_args_rrs(&tb_ptr, &r0, &r1, &ofs);
             ptr = (void *)(regs[r1] + ofs);
             regs[r0] = *(uint16_t *)ptr;
-            break;
-        CASE_32_64(ld16s)
+            continue;
+        op_ld16s:
             tci_args_rrs(&tb_ptr, &r0, &r1, &ofs);
             ptr = (void *)(regs[r1] + ofs);
             regs[r0] = *(int16_t *)ptr;
-            break;
-        case INDEX_op_ld_i32:
-        CASE_64(ld32u)
+            continue;
+        op_ld_i32:
             tci_args_rrs(&tb_ptr, &r0, &r1, &ofs);
             ptr = (void *)(regs[r1] + ofs);
             regs[r0] = *(uint32_t *)ptr;
-            break;
-        CASE_32_64(st8)
+            continue;
+        op_st8:
             tci_args_rrs(&tb_ptr, &r0, &r1, &ofs);
             ptr = (void *)(regs[r1] + ofs);
             *(uint8_t *)ptr = regs[r0];
-            break;
-        CASE_32_64(st16)
+            continue;
+        op_st16:
             tci_args_rrs(&tb_ptr, &r0, &r1, &ofs);
             ptr = (void *)(regs[r1] + ofs);
             *(uint16_t *)ptr = regs[r0];
-            break;
-        case INDEX_op_st_i32:
-        CASE_64(st32)
+            continue;
+        op_st_i32:
             tci_args_rrs(&tb_ptr, &r0, &r1, &ofs);
             ptr = (void *)(regs[r1] + ofs);
             *(uint32_t *)ptr = regs[r0];
-            break;
+            continue;
 
             /* Arithmetic operations (mixed 32/64 bit). */
 
-        CASE_32_64(add)
+        op_add:
             tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
             regs[r0] = regs[r1] + regs[r2];
-            break;
-        CASE_32_64(sub)
+            continue;
+        op_sub:
             tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
             regs[r0] = regs[r1] - regs[r2];
-            break;
-        CASE_32_64(mul)
+            continue;
+        op_mul:
             tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
             regs[r0] = regs[r1] * regs[r2];
-            break;
-        CASE_32_64(and)
+            continue;
+        op_and:
             tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
             regs[r0] = regs[r1] & regs[r2];
-            break;
-        CASE_32_64(or)
+            continue;
+        op_or:
             tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
             regs[r0] = regs[r1] | regs[r2];
-            break;
-        CASE_32_64(xor)
+            continue;
+        op_xor:
             tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
             regs[r0] = regs[r1] ^ regs[r2];
-            break;
+            continue;
+        op_tci_addi:
+            tci_args_rrs(&tb_ptr, &r0, &r1, &ofs);
+            regs[r0] = regs[r1] + ofs;
+            continue;
+        op_tci_andi:
+            tci_args_rrs(&tb_ptr, &r0, &r1, &ofs);
+            regs[r0] = regs[r1] & ofs;
+            continue;
 
             /* Arithmetic operations (32 bit). */
 
-        case INDEX_op_div_i32:
+        op_div_i32:
             tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
             regs[r0] = (int32_t)regs[r1] / (int32_t)regs[r2];
-            break;
-        case INDEX_op_divu_i32:
+            continue;
+        op_divu_i32:
             tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
             regs[r0] = (uint32_t)regs[r1] / (uint32_t)regs[r2];
-            break;
-        case INDEX_op_rem_i32:
+            continue;
+        op_rem_i32:
             tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
             regs[r0] = (int32_t)regs[r1] % (int32_t)regs[r2];
-            break;
-        case INDEX_op_remu_i32:
+            continue;
+        op_remu_i32:
             tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
             regs[r0] = (uint32_t)regs[r1] % (uint32_t)regs[r2];
-            break;
+            continue;
 
             /* Shift/rotate operations (32 bit). */
 
-        case INDEX_op_shl_i32:
+        op_shl_i32:
             tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
             regs[r0] = (uint32_t)regs[r1] << (regs[r2] & 31);
-            break;
-        case INDEX_op_shr_i32:
+            continue;
+        op_shr_i32:
             tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
             regs[r0] = (uint32_t)regs[r1] >> (regs[r2] & 31);
-            break;
-        case INDEX_op_sar_i32:
+            continue;
+        op_sar_i32:
             tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
             regs[r0] = (int32_t)regs[r1] >> (regs[r2] & 31);
-            break;
+            continue;
 #if TCG_TARGET_HAS_rot_i32
-        case INDEX_op_rotl_i32:
+        op_rotl_i32:
             tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
             regs[r0] = rol32(regs[r1], regs[r2] & 31);
-            break;
-        case INDEX_op_rotr_i32:
+            continue;
+        op_rotr_i32:
             tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
             regs[r0] = ror32(regs[r1], regs[r2] & 31);
-            break;
+            continue;
 #endif
 #if TCG_TARGET_HAS_deposit_i32
-        case INDEX_op_deposit_i32:
+        op_deposit_i32:
             tci_args_rrrbb(&tb_ptr, &r0, &r1, &r2, &pos, &len);
             regs[r0] = deposit32(regs[r1], pos, len, regs[r2]);
-            break;
+            continue;
 #endif
-        case INDEX_op_brcond_i32:
+        op_brcond_i32:
             tci_args_rrcl(&tb_ptr, &r0, &r1, &condition, &ptr);
             if (tci_compare32(regs[r0], regs[r1], condition)) {
                 tb_ptr = ptr;
             }
-            break;
+            continue;
+        op_tci_brcondi_i32:
+            tci_args_ricl(&tb_ptr, &r0, &t1, &condition, &ptr);
+            if (tci_compare32(regs[r0], t1, condition)) {
+                tb_ptr = ptr;
+            }
+            continue;
 #if TCG_TARGET_REG_BITS == 32
-        case INDEX_op_add2_i32:
+        op_add2_i32:
             tci_args_rrrrrr(&tb_ptr, &r0, &r1, &r2, &r3, &r4, &r5);
             T1 = tci_uint64(regs[r3], regs[r2]);
             T2 = tci_uint64(regs[r5], regs[r4]);
             tci_write_reg64(regs, r1, r0, T1 + T2);
-            break;
-        case INDEX_op_sub2_i32:
+            continue;
+        op_sub2_i32:
             tci_args_rrrrrr(&tb_ptr, &r0, &r1, &r2, &r3, &r4, &r5);
             T1 = tci_uint64(regs[r3], regs[r2]);
             T2 = tci_uint64(regs[r5], regs[r4]);
             tci_write_reg64(regs, r1, r0, T1 - T2);
-            break;
-        case INDEX_op_brcond2_i32:
+            continue;
+        op_brcond2_i32:
             tci_args_rrrrcl(&tb_ptr, &r0, &r1, &r2, &r3, &condition, &ptr);
             T1 = tci_uint64(regs[r1], regs[r0]);
             T2 = tci_uint64(regs[r3], regs[r2]);
@@ -721,169 +867,173 @@ uintptr_t QEMU_DISABLE_CFI tcg_qemu_tb_exec(CPUArchState *env,
                 tb_ptr = ptr;
                 continue;
             }
-            break;
-        case INDEX_op_mulu2_i32:
+            continue;
+        op_mulu2_i32:
             tci_args_rrrr(&tb_ptr, &r0, &r1, &r2, &r3);
             tci_write_reg64(regs, r1, r0, (uint64_t)regs[r2] * regs[r3]);
-            break;
+            continue;
 #endif /* TCG_TARGET_REG_BITS == 32 */
 #if TCG_TARGET_HAS_ext8s_i32 || TCG_TARGET_HAS_ext8s_i64
-        CASE_32_64(ext8s)
+        op_ext8s:
             tci_args_rr(&tb_ptr, &r0, &r1);
             regs[r0] = (int8_t)regs[r1];
-            break;
+            continue;
 #endif
 #if TCG_TARGET_HAS_ext16s_i32 || TCG_TARGET_HAS_ext16s_i64
-        CASE_32_64(ext16s)
+        op_ext16s:
             tci_args_rr(&tb_ptr, &r0, &r1);
             regs[r0] = (int16_t)regs[r1];
-            break;
+            continue;
 #endif
 #if TCG_TARGET_HAS_ext8u_i32 || TCG_TARGET_HAS_ext8u_i64
-        CASE_32_64(ext8u)
+        op_ext8u:
             tci_args_rr(&tb_ptr, &r0, &r1);
             regs[r0] = (uint8_t)regs[r1];
-            break;
+            continue;
 #endif
 #if TCG_TARGET_HAS_ext16u_i32 || TCG_TARGET_HAS_ext16u_i64
-        CASE_32_64(ext16u)
+        op_ext16u:
             tci_args_rr(&tb_ptr, &r0, &r1);
             regs[r0] = (uint16_t)regs[r1];
-            break;
+            continue;
 #endif
 #if TCG_TARGET_HAS_bswap16_i32 || TCG_TARGET_HAS_bswap16_i64
-        CASE_32_64(bswap16)
+        op_bswap16:
             tci_args_rr(&tb_ptr, &r0, &r1);
             regs[r0] = bswap16(regs[r1]);
-            break;
+            continue;
 #endif
 #if TCG_TARGET_HAS_bswap32_i32 || TCG_TARGET_HAS_bswap32_i64
-        CASE_32_64(bswap32)
+        op_bswap32:
             tci_args_rr(&tb_ptr, &r0, &r1);
             regs[r0] = bswap32(regs[r1]);
-            break;
+            continue;
 #endif
 #if TCG_TARGET_HAS_not_i32 || TCG_TARGET_HAS_not_i64
-        CASE_32_64(not)
+        op_not:
             tci_args_rr(&tb_ptr, &r0, &r1);
             regs[r0] = ~regs[r1];
-            break;
+            continue;
 #endif
 #if TCG_TARGET_HAS_neg_i32 || TCG_TARGET_HAS_neg_i64
-        CASE_32_64(neg)
+        op_neg:
             tci_args_rr(&tb_ptr, &r0, &r1);
             regs[r0] = -regs[r1];
-            break;
+            continue;
 #endif
 #if TCG_TARGET_REG_BITS == 64
-        case INDEX_op_tci_movi_i64:
+        op_tci_movi_i64:
             tci_args_rI(&tb_ptr, &r0, &t1);
             regs[r0] = t1;
-            break;
+            continue;
 
             /* Load/store operations (64 bit). */
 
-        case INDEX_op_ld32s_i64:
+        op_ld32s_i64:
             tci_args_rrs(&tb_ptr, &r0, &r1, &ofs);
             ptr = (void *)(regs[r1] + ofs);
             regs[r0] = *(int32_t *)ptr;
-            break;
-        case INDEX_op_ld_i64:
+            continue;
+        op_ld_i64:
             tci_args_rrs(&tb_ptr, &r0, &r1, &ofs);
             ptr = (void *)(regs[r1] + ofs);
             regs[r0] = *(uint64_t *)ptr;
-            break;
-        case INDEX_op_st_i64:
+            continue;
+        op_st_i64:
             tci_args_rrs(&tb_ptr, &r0, &r1, &ofs);
             ptr = (void *)(regs[r1] + ofs);
             *(uint64_t *)ptr = regs[r0];
-            break;
+            continue;
 
             /* Arithmetic operations (64 bit). */
 
-        case INDEX_op_div_i64:
+        op_div_i64:
             tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
             regs[r0] = (int64_t)regs[r1] / (int64_t)regs[r2];
-            break;
-        case INDEX_op_divu_i64:
+            continue;
+        op_divu_i64:
             tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
             regs[r0] = (uint64_t)regs[r1] / (uint64_t)regs[r2];
-            break;
-        case INDEX_op_rem_i64:
+            continue;
+        op_rem_i64:
             tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
             regs[r0] = (int64_t)regs[r1] % (int64_t)regs[r2];
-            break;
-        case INDEX_op_remu_i64:
+            continue;
+        op_remu_i64:
             tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
             regs[r0] = (uint64_t)regs[r1] % (uint64_t)regs[r2];
-            break;
+            continue;
 
             /* Shift/rotate operations (64 bit). */
 
-        case INDEX_op_shl_i64:
+        op_shl_i64:
             tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
             regs[r0] = regs[r1] << (regs[r2] & 63);
-            break;
-        case INDEX_op_shr_i64:
+            continue;
+        op_shr_i64:
             tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
             regs[r0] = regs[r1] >> (regs[r2] & 63);
-            break;
-        case INDEX_op_sar_i64:
+            continue;
+        op_sar_i64:
             tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
             regs[r0] = (int64_t)regs[r1] >> (regs[r2] & 63);
-            break;
+            continue;
 #if TCG_TARGET_HAS_rot_i64
-        case INDEX_op_rotl_i64:
+        op_rotl_i64:
             tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
             regs[r0] = rol64(regs[r1], regs[r2] & 63);
-            break;
-        case INDEX_op_rotr_i64:
+            continue;
+        op_rotr_i64:
             tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
             regs[r0] = ror64(regs[r1], regs[r2] & 63);
-            break;
+            continue;
 #endif
 #if TCG_TARGET_HAS_deposit_i64
-        case INDEX_op_deposit_i64:
+        op_deposit_i64:
             tci_args_rrrbb(&tb_ptr, &r0, &r1, &r2, &pos, &len);
             regs[r0] = deposit64(regs[r1], pos, len, regs[r2]);
-            break;
+            continue;
 #endif
-        case INDEX_op_brcond_i64:
+        op_brcond_i64:
             tci_args_rrcl(&tb_ptr, &r0, &r1, &condition, &ptr);
             if (tci_compare64(regs[r0], regs[r1], condition)) {
                 tb_ptr = ptr;
             }
-            break;
-        case INDEX_op_ext32s_i64:
-        case INDEX_op_ext_i32_i64:
+            continue;
+        op_tci_brcondi_i64:
+            tci_args_ricl(&tb_ptr, &r0, &t1, &condition, &ptr);
+            if (tci_compare64(regs[r0], (int32_t)t1, condition)) {
+                tb_ptr = ptr;
+            }
+            continue;
+        op_ext32s_i64:
             tci_args_rr(&tb_ptr, &r0, &r1);
             regs[r0] = (int32_t)regs[r1];
-            break;
-        case INDEX_op_ext32u_i64:
-        case INDEX_op_extu_i32_i64:
+            continue;
+        op_ext32u_i64:
             tci_args_rr(&tb_ptr, &r0, &r1);
             regs[r0] = (uint32_t)regs[r1];
-            break;
+            continue;
 #if TCG_TARGET_HAS_bswap64_i64
-        case INDEX_op_bswap64_i64:
+        op_bswap64_i64:
             tci_args_rr(&tb_ptr, &r0, &r1);
             regs[r0] = bswap64(regs[r1]);
-            break;
+            continue;
 #endif
 #endif /* TCG_TARGET_REG_BITS == 64 */
 
             /* QEMU specific operations. */
 
-        case INDEX_op_exit_tb:
+        op_exit_tb:
             tci_args_l(&tb_ptr, &ptr);
             return (uintptr_t)ptr;
 
-        case INDEX_op_goto_tb:
+        op_goto_tb:
             tci_args_l(&tb_ptr, &ptr);
             tb_ptr = *(void **)ptr;
-            break;
+            continue;
 
-        case INDEX_op_qemu_ld_i32:
+        op_qemu_ld_i32:
             if (TARGET_LONG_BITS <= TCG_TARGET_REG_BITS) {
                 tci_args_rrm(&tb_ptr, &r0, &r1, &oi);
                 taddr = regs[r1];
@@ -920,9 +1070,9 @@ uintptr_t QEMU_DISABLE_CFI tcg_qemu_tb_exec(CPUArchState *env,
                 g_assert_not_reached();
             }
             regs[r0] = tmp32;
-            break;
+            continue;
 
-        case INDEX_op_qemu_ld_i64:
+        op_qemu_ld_i64:
             if (TCG_TARGET_REG_BITS == 64) {
                 tci_args_rrm(&tb_ptr, &r0, &r1, &oi);
                 taddr = regs[r1];
@@ -978,9 +1128,9 @@ uintptr_t QEMU_DISABLE_CFI tcg_qemu_tb_exec(CPUArchState *env,
             } else {
                 regs[r0] = tmp64;
             }
-            break;
+            continue;
 
-        case INDEX_op_qemu_st_i32:
+        op_qemu_st_i32:
             if (TARGET_LONG_BITS <= TCG_TARGET_REG_BITS) {
                 tci_args_rrm(&tb_ptr, &r0, &r1, &oi);
                 taddr = regs[r1];
@@ -1008,9 +1158,9 @@ uintptr_t QEMU_DISABLE_CFI tcg_qemu_tb_exec(CPUArchState *env,
             default:
                 g_assert_not_reached();
             }
-            break;
+            continue;
 
-        case INDEX_op_qemu_st_i64:
+        op_qemu_st_i64:
             if (TCG_TARGET_REG_BITS == 64) {
                 tci_args_rrm(&tb_ptr, &r0, &r1, &oi);
                 taddr = regs[r1];
@@ -1050,15 +1200,14 @@ uintptr_t QEMU_DISABLE_CFI tcg_qemu_tb_exec(CPUArchState *env,
             default:
                 g_assert_not_reached();
             }
-            break;
+            continue;
 
-        case INDEX_op_mb:
+        op_mb:
             /* Ensure ordering for all kinds */
             smp_mb();
-            break;
-        default:
+            continue;
+        op_invalid:
             g_assert_not_reached();
-        }
     }
 }
 
@@ -1161,6 +1310,13 @@ int print_insn_tci(bfd_vma addr, disassemble_info *info)
                            op_name, str_r(r0), str_r(r1), str_c(c), ptr);
         break;
 
+    case INDEX_op_tci_brcondi_i32:
+    case INDEX_op_tci_brcondi_i64:
+        tci_args_ricl(&tb_ptr, &r0, &i1, &c, &ptr);
+        info->fprintf_func(info->stream, "%-12s  %s, %d, %s, %p",
+                           op_name, str_r(r0), (int32_t)i1, str_c(c), ptr);
+        break;
+
     case INDEX_op_setcond_i32:
     case INDEX_op_setcond_i64:
         tci_args_rrrc(&tb_ptr, &r0, &r1, &r2, &c);
@@ -1201,6 +1357,10 @@ int print_insn_tci(bfd_vma addr, disassemble_info *info)
     case INDEX_op_st32_i64:
     case INDEX_op_st_i32:
     case INDEX_op_st_i64:
+    case INDEX_op_tci_addi_i32:
+    case INDEX_op_tci_addi_i64:
+    case INDEX_op_tci_andi_i32:
+    case INDEX_op_tci_andi_i64:
         tci_args_rrs(&tb_ptr, &r0, &r1, &s2);
         info->fprintf_func(info->stream, "%-12s  %s, %s, %d",
                            op_name, str_r(r0), str_r(r1), s2);
@@ -0,0 +1,82 @@
+/*
+ * Internet checksum speed benchmark
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or
+ * (at your option) any later version.  See the COPYING file in the
+ * top-level directory.
+ */
+#include "qemu/osdep.h"
+#include "qemu/units.h"
+#include "net/checksum.h"
+
+/* The byte by byte loop net_checksum_add_cont() used to be */
+static uint16_t checksum_ref(const uint8_t *buf, size_t len)
+{
+    uint32_t sum = 0;
+    size_t i;
+
+    for (i = 0; i + 1 < len; i += 2) {
+        sum += (buf[i] << 8) + buf[i + 1];
+    }
+    if (i < len) {
+        sum += buf[i] << 8;
+    }
+    return net_checksum_finish(sum);
+}
+
+static void test_checksum_chunk(uint8_t *buf, size_t chunk_size, int accel)
+{
+    const size_t total = 2 * GiB;
+    uint32_t sum = 0;
+    size_t remain;
+
+    g_assert_cmpuint(net_raw_checksum(buf, chunk_size), ==,
+                     checksum_ref(buf, chunk_size));
+    g_assert_cmpuint(net_raw_checksum(buf + 1, chunk_size), ==,
+                     checksum_ref(buf + 1, chunk_size));
+
+    g_test_timer_start();
+    for (remain = total; remain >= chunk_size; remain -= chunk_size) {
+        sum += net_checksum_add(chunk_size, buf);
+    }
+    g_test_timer_elapsed();
+
+    g_test_message("checksum(accel %d, sum %04x): chunk %zu bytes "
+                   "%.2f MB/sec", accel, net_checksum_finish(sum),
+                   chunk_size, total / g_test_timer_last() / MiB);
+}
+
+/*
+ * test_net_checksum_next_accel() cannot go back to a better accelerator,
+ * so all chunk sizes are measured with one accelerator before moving on.
+ */
+static void test_checksum_speed(void)
+{
+    static const size_t sizes[] = { 64, 512, 1500, 9000, 65535 };
+    size_t max_size = sizes[ARRAY_SIZE(sizes) - 1];
+    int accel = 0;
+    uint8_t *buf;
+    size_t i;
+
+    /* Leave room for misaligning the buffer by one byte */
+    buf = g_malloc(max_size + 1);
+    for (i = 0; i < max_size + 1; i++) {
+        buf[i] = g_test_rand_int();
+    }
+
+    do {
+        for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+            test_checksum_chunk(buf, sizes[i], accel);
+        }
+        accel++;
+    } while (test_net_checksum_next_accel());
+
+    g_free(buf);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/net/benchmark/checksum", test_checksum_speed);
+    return g_test_run();
+}
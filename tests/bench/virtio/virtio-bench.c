@@ -0,0 +1,504 @@
+/*
+ * Virtqueue and virtio device model microbenchmarks
+ *
+ * The benchmark is linked like a system emulator and starts a machine with
+ * the qtest accelerator, a virtio-blk device on a null-co node and a
+ * virtio-net device on a hub port.  It then plays the guest driver itself:
+ * the rings live in a RAM region that it maps at BENCH_MEM_BASE, features
+ * and rings are set up with the VirtIODevice API, and the device models are
+ * kicked with virtio_queue_notify() from the main thread, bypassing the
+ * transport.  Received packets are injected through the hub port.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/cutils.h"
+#include "qemu/error-report.h"
+#include "qemu/main-loop.h"
+#include "qemu/rcu.h"
+#include "qemu/timer.h"
+#include "qemu/units.h"
+#include "qapi/error.h"
+#include "qom/object.h"
+#include "exec/memory.h"
+#include "exec/address-spaces.h"
+#include "hw/virtio/virtio.h"
+#include "hw/virtio/virtio-blk.h"
+#include "hw/virtio/virtio-net.h"
+#include "net/eth.h"
+#include "net/net.h"
+#include "sysemu/sysemu.h"
+#include "standard-headers/linux/virtio_config.h"
+#include "vring-driver.h"
+
+#define BENCH_MEM_BASE          (1ULL << 40)
+#define BENCH_MEM_SIZE          (64 * MiB)
+#define BENCH_MAX_BATCHES       16
+
+#if defined(TARGET_I386)
+#define BENCH_DEFAULT_MACHINE   "q35"
+#elif defined(TARGET_ARM)
+#define BENCH_DEFAULT_MACHINE   "virt"
+#else
+#define BENCH_DEFAULT_MACHINE   ""
+#endif
+
+typedef struct BenchState BenchState;
+
+typedef struct BenchTest {
+    const char *name;
+    const char *unit;
+    VirtIODevice **vdev;
+    int queue;
+    unsigned int descs;         /* descriptors per request */
+    /* size of the guest memory used by one request */
+    uint64_t (*slot_size)(BenchState *s);
+    /* lay out request @slot at @gpa, filling in bufs[0..descs-1] */
+    void (*fill)(BenchState *s, uint64_t gpa, unsigned int slot,
+                 VRingBuf *bufs);
+    /* process @n requests that were just made available */
+    void (*kick)(BenchState *s, unsigned int n);
+} BenchTest;
+
+struct BenchState {
+    BenchMem mem;
+    VirtIODevice *blk;
+    VirtIODevice *net;
+    NetClientState *net_peer;
+    VRingDriver vr;
+    const BenchTest *test;
+    void *elems[VIRTQUEUE_MAX_SIZE];
+    uint8_t *pkt;
+
+    /* parameters */
+    uint64_t count;
+    uint64_t req_size;
+    uint64_t pkt_size;
+    bool blk_write;
+};
+
+static BenchState bench;
+
+static const char commands_string[] =
+    " -t = test to run: virtqueue, virtqueue-batch, blk, net-rx or net-tx\n"
+    "      (can be repeated, default all)\n"
+    " -r = ring layout: split, packed or both (default both)\n"
+    " -b = comma-separated batch sizes (default 1,8,32,64)\n"
+    " -n = number of requests per measurement (default 200000)\n"
+    " -s = size of virtio-blk requests (default 4096)\n"
+    " -p = size of packets (default 1514)\n"
+    " -w = use virtio-blk writes instead of reads\n"
+    " -M = machine type (default " BENCH_DEFAULT_MACHINE ")";
+
+static void usage_complete(int argc, char *argv[])
+{
+    fprintf(stderr, "Usage: %s [options]\n", argv[0]);
+    fprintf(stderr, "options:\n%s\n", commands_string);
+    exit(-1);
+}
+
+/* virtio-blk requests: header, data and status */
+
+static uint64_t blk_slot_size(BenchState *s)
+{
+    return 64 + s->req_size;
+}
+
+static void blk_fill(BenchState *s, uint64_t gpa, unsigned int slot,
+                     VRingBuf *bufs)
+{
+    struct virtio_blk_outhdr *hdr = bench_mem_ptr(&s->mem, gpa);
+
+    hdr->type = cpu_to_le32(s->blk_write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN);
+    hdr->sector = cpu_to_le64(slot * s->req_size / 512);
+
+    bufs[0] = (VRingBuf) { gpa, sizeof(*hdr), false };
+    bufs[1] = (VRingBuf) { gpa + 64, s->req_size, !s->blk_write };
+    bufs[2] = (VRingBuf) { gpa + sizeof(*hdr), 1, true };
+}
+
+static void blk_kick(BenchState *s, unsigned int n)
+{
+    virtio_queue_notify(s->blk, 0);
+}
+
+/* The core virtqueue operations on the virtio-blk queue, without a device */
+
+static void vq_kick(BenchState *s, unsigned int n)
+{
+    VirtQueue *vq = virtio_get_queue(s->blk, 0);
+    unsigned int i;
+
+    RCU_READ_LOCK_GUARD();
+    for (i = 0; i < n; i++) {
+        s->elems[i] = virtqueue_pop(vq, sizeof(VirtQueueElement));
+        g_assert(s->elems[i]);
+    }
+    for (i = 0; i < n; i++) {
+        virtqueue_fill(vq, s->elems[i], 0, i);
+    }
+    virtqueue_flush(vq, n);
+    virtio_notify(s->blk, vq);
+    for (i = 0; i < n; i++) {
+        virtqueue_element_free(s->elems[i]);
+    }
+}
+
+static void vq_batch_kick(BenchState *s, unsigned int n)
+{
+    VirtQueue *vq = virtio_get_queue(s->blk, 0);
+    unsigned int i, got = 0;
+
+    while (got < n) {
+        unsigned int ret;
+
+        ret = virtqueue_pop_batch(vq, sizeof(VirtQueueElement),
+                                  s->elems + got, n - got);
+        g_assert(ret);
+        got += ret;
+    }
+    virtqueue_push_batch(vq, (VirtQueueElement **)s->elems, NULL, n);
+    virtio_notify(s->blk, vq);
+    for (i = 0; i < n; i++) {
+        virtqueue_element_free(s->elems[i]);
+    }
+}
+
+/* virtio-net: one buffer with header and packet per request */
+
+static uint64_t net_slot_size(BenchState *s)
+{
+    return sizeof(struct virtio_net_hdr_mrg_rxbuf) + s->pkt_size;
+}
+
+static void net_rx_fill(BenchState *s, uint64_t gpa, unsigned int slot,
+                        VRingBuf *bufs)
+{
+    bufs[0] = (VRingBuf) { gpa, net_slot_size(s), true };
+}
+
+static void net_rx_kick(BenchState *s, unsigned int n)
+{
+    unsigned int i;
+
+    /* Like a guest that refilled the ring */
+    virtio_queue_notify(s->net, 0);
+    for (i = 0; i < n; i++) {
+        qemu_send_packet(s->net_peer, s->pkt, s->pkt_size);
+    }
+}
+
+static void net_tx_fill(BenchState *s, uint64_t gpa, unsigned int slot,
+                        VRingBuf *bufs)
+{
+    uint8_t *p = bench_mem_ptr(&s->mem, gpa);
+
+    memcpy(p + sizeof(struct virtio_net_hdr_mrg_rxbuf), s->pkt, s->pkt_size);
+    bufs[0] = (VRingBuf) { gpa, net_slot_size(s), false };
+}
+
+static void net_tx_kick(BenchState *s, unsigned int n)
+{
+    virtio_queue_notify(s->net, 1);
+}
+
+static const BenchTest bench_tests[] = {
+    {
+        .name = "virtqueue", .unit = "req",
+        .vdev = &bench.blk, .queue = 0, .descs = 3,
+        .slot_size = blk_slot_size, .fill = blk_fill,
+        .kick = vq_kick,
+    }, {
+        .name = "virtqueue-batch", .unit = "req",
+        .vdev = &bench.blk, .queue = 0, .descs = 3,
+        .slot_size = blk_slot_size, .fill = blk_fill,
+        .kick = vq_batch_kick,
+    }, {
+        .name = "blk", .unit = "req",
+        .vdev = &bench.blk, .queue = 0, .descs = 3,
+        .slot_size = blk_slot_size, .fill = blk_fill,
+        .kick = blk_kick,
+    }, {
+        .name = "net-rx", .unit = "pkt",
+        .vdev = &bench.net, .queue = 0, .descs = 1,
+        .slot_size = net_slot_size, .fill = net_rx_fill,
+        .kick = net_rx_kick,
+    }, {
+        .name = "net-tx", .unit = "pkt",
+        .vdev = &bench.net, .queue = 1, .descs = 1,
+        .slot_size = net_slot_size, .fill = net_tx_fill,
+        .kick = net_tx_kick,
+    },
+};
+
+/* Reset the device and drive @queue like a VIRTIO 1.0 driver */
+static void bench_setup_device(BenchState *s, VirtIODevice *vdev, int queue,
+                               bool packed)
+{
+    uint64_t features = 1ULL << VIRTIO_F_VERSION_1;
+    uint8_t status = VIRTIO_CONFIG_S_ACKNOWLEDGE | VIRTIO_CONFIG_S_DRIVER;
+
+    if (packed) {
+        features |= 1ULL << VIRTIO_F_RING_PACKED;
+    }
+
+    virtio_reset(vdev);
+    virtio_set_status(vdev, status);
+    if (virtio_set_features(vdev, features) < 0) {
+        error_report("%s does not support the %s ring layout",
+                     vdev->name, packed ? "packed" : "split");
+        exit(1);
+    }
+    status |= VIRTIO_CONFIG_S_FEATURES_OK;
+    virtio_set_status(vdev, status);
+
+    bench_mem_reset(&s->mem);
+    vring_driver_init(&s->vr, &s->mem, virtio_queue_get_num(vdev, queue),
+                      packed);
+    virtio_queue_set_rings(vdev, queue, s->vr.desc_gpa, s->vr.driver_gpa,
+                           s->vr.device_gpa);
+
+    virtio_set_status(vdev, status | VIRTIO_CONFIG_S_DRIVER_OK);
+}
+
+static void bench_wait_used(BenchState *s, unsigned int n)
+{
+    AioContext *ctx = qemu_get_aio_context();
+    uint32_t len;
+
+    while (n) {
+        if (vring_driver_get_used(&s->vr, &len) >= 0) {
+            n--;
+        } else if (!aio_poll(ctx, false)) {
+            error_report("%s: device stopped processing requests",
+                         s->test->name);
+            exit(1);
+        }
+    }
+}
+
+static void bench_run(BenchState *s, const BenchTest *test, bool packed,
+                      unsigned int batch)
+{
+    VirtIODevice *vdev = *test->vdev;
+    g_autofree VRingBuf *bufs = NULL;
+    uint64_t slot_size, gpa, done;
+    int64_t start, ns;
+    unsigned int i;
+
+    s->test = test;
+    bench_setup_device(s, vdev, test->queue, packed);
+    if (batch * test->descs > s->vr.num) {
+        printf("%-16s %-6s %6u  (batch too large for %u-entry queue)\n",
+               test->name, packed ? "packed" : "split", batch, s->vr.num);
+        goto out;
+    }
+
+    slot_size = ROUND_UP(test->slot_size(s), 64);
+    gpa = bench_mem_alloc(&s->mem, slot_size * batch, 4096);
+    bufs = g_new(VRingBuf, batch * test->descs);
+    for (i = 0; i < batch; i++) {
+        test->fill(s, gpa + i * slot_size, i, &bufs[i * test->descs]);
+    }
+
+    start = get_clock();
+    for (done = 0; done < s->count; done += batch) {
+        for (i = 0; i < batch; i++) {
+            int id = vring_driver_add(&s->vr, &bufs[i * test->descs],
+                                      test->descs);
+            g_assert(id >= 0);
+        }
+        vring_driver_publish(&s->vr);
+        test->kick(s, batch);
+        bench_wait_used(s, batch);
+    }
+    ns = get_clock() - start;
+
+    printf("%-16s %-6s %6u %10.1f ns/%s\n",
+           test->name, packed ? "packed" : "split", batch,
+           (double)ns / done, test->unit);
+
+out:
+    vring_driver_cleanup(&s->vr);
+    virtio_reset(vdev);
+}
+
+static void bench_init_machine(BenchState *s, const char *progname,
+                               const char *machine)
+{
+    g_autoptr(GPtrArray) args = g_ptr_array_new();
+    MemoryRegion *mr = g_new(MemoryRegion, 1);
+    VirtIONet *n;
+    unsigned int i;
+
+    g_ptr_array_add(args, (char *)progname);
+    g_ptr_array_add(args, (char *)"-machine");
+    g_ptr_array_add(args, (char *)machine);
+    g_ptr_array_add(args, (char *)"-accel");
+    g_ptr_array_add(args, (char *)"qtest");
+    g_ptr_array_add(args, (char *)"-display");
+    g_ptr_array_add(args, (char *)"none");
+    g_ptr_array_add(args, (char *)"-nodefaults");
+    g_ptr_array_add(args, (char *)"-blockdev");
+    g_ptr_array_add(args, (char *)"driver=null-co,node-name=bench-null");
+    g_ptr_array_add(args, (char *)"-device");
+    g_ptr_array_add(args, (char *)"virtio-blk-pci,drive=bench-null,"
+                                  "ioeventfd=off,packed=on");
+    g_ptr_array_add(args, (char *)"-netdev");
+    g_ptr_array_add(args, (char *)"hubport,id=bench-net,hubid=0");
+    g_ptr_array_add(args, (char *)"-device");
+    g_ptr_array_add(args, (char *)"virtio-net-pci,netdev=bench-net,"
+                                  "ioeventfd=off,packed=on");
+    g_ptr_array_add(args, NULL);
+
+    qemu_init(args->len - 1, (char **)args->pdata, NULL);
+
+    s->blk = VIRTIO_DEVICE(object_resolve_path_type("", TYPE_VIRTIO_BLK,
+                                                    NULL));
+    s->net = VIRTIO_DEVICE(object_resolve_path_type("", TYPE_VIRTIO_NET,
+                                                    NULL));
+    n = VIRTIO_NET(s->net);
+    s->net_peer = qemu_get_queue(n->nic)->peer;
+
+    /* The rings and buffers; DMA goes straight to system memory */
+    memory_region_init_ram_nomigrate(mr, NULL, "bench-ram", BENCH_MEM_SIZE,
+                                     &error_fatal);
+    memory_region_add_subregion(get_system_memory(), BENCH_MEM_BASE, mr);
+    s->mem.hva = memory_region_get_ram_ptr(mr);
+    s->mem.gpa = BENCH_MEM_BASE;
+    s->mem.size = BENCH_MEM_SIZE;
+
+    /* A broadcast frame, so that the receive filter lets it through */
+    s->pkt = g_malloc(s->pkt_size);
+    for (i = 0; i < s->pkt_size; i++) {
+        s->pkt[i] = i < ETH_ALEN ? 0xff : i;
+    }
+}
+
+static unsigned int parse_batches(const char *str, unsigned int *batches)
+{
+    g_auto(GStrv) items = g_strsplit(str, ",", 0);
+    unsigned int i;
+
+    for (i = 0; items[i]; i++) {
+        unsigned long val;
+
+        if (i == BENCH_MAX_BATCHES) {
+            error_report("At most %d batch sizes are supported",
+                         BENCH_MAX_BATCHES);
+            exit(1);
+        }
+        if (qemu_strtoul(items[i], NULL, 0, &val) || !val ||
+            val > VIRTQUEUE_MAX_SIZE) {
+            error_report("Invalid batch size '%s'", items[i]);
+            exit(1);
+        }
+        batches[i] = val;
+    }
+    return i;
+}
+
+int main(int argc, char **argv)
+{
+    BenchState *s = &bench;
+    const char *machine = BENCH_DEFAULT_MACHINE;
+    unsigned int batches[BENCH_MAX_BATCHES] = { 1, 8, 32, 64 };
+    unsigned int nr_batches = 4;
+    GPtrArray *tests = g_ptr_array_new();
+    bool split = true, packed = true;
+    unsigned int i, j;
+    int c;
+
+    s->count = 200000;
+    s->req_size = 4096;
+    s->pkt_size = 1514;
+
+    for (;;) {
+        c = getopt(argc, argv, "b:hM:n:p:r:s:t:w");
+        if (c < 0) {
+            break;
+        }
+        switch (c) {
+        case 'b':
+            nr_batches = parse_batches(optarg, batches);
+            break;
+        case 'M':
+            machine = optarg;
+            break;
+        case 'n':
+            if (qemu_strtou64(optarg, NULL, 0, &s->count) || !s->count) {
+                error_report("Invalid request count '%s'", optarg);
+                exit(1);
+            }
+            break;
+        case 'p':
+            if (qemu_strtou64(optarg, NULL, 0, &s->pkt_size) ||
+                s->pkt_size < ETH_HLEN || s->pkt_size > 9000) {
+                error_report("Invalid packet size '%s'", optarg);
+                exit(1);
+            }
+            break;
+        case 'r':
+            split = !strcmp(optarg, "split") || !strcmp(optarg, "both");
+            packed = !strcmp(optarg, "packed") || !strcmp(optarg, "both");
+            if (!split && !packed) {
+                error_report("Invalid ring layout '%s'", optarg);
+                exit(1);
+            }
+            break;
+        case 's':
+            if (qemu_strtou64(optarg, NULL, 0, &s->req_size) ||
+                !s->req_size || s->req_size % 512 || s->req_size > MiB) {
+                error_report("Invalid request size '%s'", optarg);
+                exit(1);
+            }
+            break;
+        case 't':
+            for (i = 0; i < ARRAY_SIZE(bench_tests); i++) {
+                if (!strcmp(optarg, bench_tests[i].name)) {
+                    g_ptr_array_add(tests, (gpointer)&bench_tests[i]);
+                    break;
+                }
+            }
+            if (i == ARRAY_SIZE(bench_tests)) {
+                error_report("Unknown test '%s'", optarg);
+                exit(1);
+            }
+            break;
+        case 'w':
+            s->blk_write = true;
+            break;
+        case 'h':
+        default:
+            usage_complete(argc, argv);
+        }
+    }
+    if (!*machine) {
+        error_report("No default machine for this target, please use -M");
+        exit(1);
+    }
+    if (!tests->len) {
+        for (i = 0; i < ARRAY_SIZE(bench_tests); i++) {
+            g_ptr_array_add(tests, (gpointer)&bench_tests[i]);
+        }
+    }
+
+    bench_init_machine(s, argv[0], machine);
+
+    for (i = 0; i < tests->len; i++) {
+        for (j = 0; j < nr_batches; j++) {
+            if (split) {
+                bench_run(s, g_ptr_array_index(tests, i), false, batches[j]);
+            }
+            if (packed) {
+                bench_run(s, g_ptr_array_index(tests, i), true, batches[j]);
+            }
+        }
+    }
+
+    g_ptr_array_free(tests, true);
+    qemu_cleanup();
+    return 0;
+}
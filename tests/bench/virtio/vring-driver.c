@@ -0,0 +1,234 @@
+/*
+ * Driver side of split and packed virtqueues for benchmarks
+ *
+ * The rings live in guest memory that is also mapped into the benchmark,
+ * so the driver just writes them like a guest would, in the little-endian
+ * layout of VIRTIO 1.0.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/atomic.h"
+#include "qemu/bswap.h"
+#include "vring-driver.h"
+
+uint64_t bench_mem_alloc(BenchMem *mem, uint64_t size, uint64_t align)
+{
+    uint64_t offset = ROUND_UP(mem->used, align);
+
+    g_assert(offset + size <= mem->size);
+    mem->used = offset + size;
+    memset(mem->hva + offset, 0, size);
+    return mem->gpa + offset;
+}
+
+void bench_mem_reset(BenchMem *mem)
+{
+    mem->used = 0;
+}
+
+void vring_driver_init(VRingDriver *vr, BenchMem *mem, unsigned int num,
+                       bool packed)
+{
+    unsigned int i;
+
+    memset(vr, 0, sizeof(*vr));
+    vr->packed = packed;
+    vr->num = num;
+    vr->num_free = num;
+    vr->chain_len = g_new0(uint16_t, num);
+
+    if (packed) {
+        struct vring_packed_desc_event *driver_event;
+
+        vr->desc_gpa = bench_mem_alloc(mem, num * sizeof(*vr->pdesc), 4096);
+        vr->driver_gpa = bench_mem_alloc(mem, sizeof(*driver_event), 4);
+        vr->device_gpa = bench_mem_alloc(mem, sizeof(*driver_event), 4);
+        vr->pdesc = bench_mem_ptr(mem, vr->desc_gpa);
+        driver_event = bench_mem_ptr(mem, vr->driver_gpa);
+        driver_event->flags = cpu_to_le16(VRING_PACKED_EVENT_FLAG_DISABLE);
+
+        vr->avail_wrap = true;
+        vr->used_wrap = true;
+        vr->id_next = g_new(uint16_t, num);
+        for (i = 0; i < num; i++) {
+            vr->id_next[i] = i + 1;
+        }
+    } else {
+        vr->desc_gpa = bench_mem_alloc(mem, num * sizeof(*vr->desc), 4096);
+        vr->driver_gpa = bench_mem_alloc(mem, sizeof(*vr->avail) +
+                                         (num + 1) * sizeof(uint16_t), 4096);
+        vr->device_gpa = bench_mem_alloc(mem, sizeof(*vr->used) +
+                                         num * sizeof(vring_used_elem_t) +
+                                         sizeof(uint16_t), 4096);
+        vr->desc = bench_mem_ptr(mem, vr->desc_gpa);
+        vr->avail = bench_mem_ptr(mem, vr->driver_gpa);
+        vr->used = bench_mem_ptr(mem, vr->device_gpa);
+        vr->avail->flags = cpu_to_le16(VRING_AVAIL_F_NO_INTERRUPT);
+
+        vr->free_next = g_new(uint16_t, num);
+        for (i = 0; i < num; i++) {
+            vr->free_next[i] = i + 1;
+        }
+    }
+}
+
+void vring_driver_cleanup(VRingDriver *vr)
+{
+    g_free(vr->free_next);
+    g_free(vr->id_next);
+    g_free(vr->chain_len);
+}
+
+static int vring_driver_add_split(VRingDriver *vr, const VRingBuf *bufs,
+                                  unsigned int n)
+{
+    uint16_t head = vr->free_head;
+    uint16_t i = head, last = head;
+    unsigned int j;
+
+    for (j = 0; j < n; j++) {
+        uint16_t flags = bufs[j].write ? VRING_DESC_F_WRITE : 0;
+
+        if (j < n - 1) {
+            flags |= VRING_DESC_F_NEXT;
+        }
+        vr->desc[i].addr = cpu_to_le64(bufs[j].gpa);
+        vr->desc[i].len = cpu_to_le32(bufs[j].len);
+        vr->desc[i].flags = cpu_to_le16(flags);
+        vr->desc[i].next = cpu_to_le16(vr->free_next[i]);
+        last = i;
+        i = vr->free_next[i];
+    }
+    vr->free_head = vr->free_next[last];
+
+    vr->avail->ring[vr->avail_idx % vr->num] = cpu_to_le16(head);
+    vr->avail_idx++;
+    return head;
+}
+
+static int vring_driver_add_packed(VRingDriver *vr, const VRingBuf *bufs,
+                                   unsigned int n)
+{
+    uint16_t id = vr->free_id;
+    uint16_t avail_flags = (vr->avail_wrap << VRING_PACKED_DESC_F_AVAIL) |
+                           (!vr->avail_wrap << VRING_PACKED_DESC_F_USED);
+    uint16_t head = vr->next_avail;
+    uint16_t head_flags = 0;
+    unsigned int j;
+
+    vr->free_id = vr->id_next[id];
+
+    for (j = 0; j < n; j++) {
+        uint16_t i = vr->next_avail;
+        uint16_t flags = avail_flags;
+
+        if (bufs[j].write) {
+            flags |= VRING_DESC_F_WRITE;
+        }
+        if (j < n - 1) {
+            flags |= VRING_DESC_F_NEXT;
+        }
+        vr->pdesc[i].addr = cpu_to_le64(bufs[j].gpa);
+        vr->pdesc[i].len = cpu_to_le32(bufs[j].len);
+        vr->pdesc[i].id = cpu_to_le16(id);
+        if (j == 0) {
+            head_flags = flags;
+        } else {
+            vr->pdesc[i].flags = cpu_to_le16(flags);
+        }
+
+        if (++vr->next_avail == vr->num) {
+            vr->next_avail = 0;
+            vr->avail_wrap = !vr->avail_wrap;
+            avail_flags ^= (1 << VRING_PACKED_DESC_F_AVAIL) |
+                           (1 << VRING_PACKED_DESC_F_USED);
+        }
+    }
+
+    /* The head makes the whole chain available */
+    smp_wmb();
+    qatomic_set(&vr->pdesc[head].flags, cpu_to_le16(head_flags));
+    return id;
+}
+
+int vring_driver_add(VRingDriver *vr, const VRingBuf *bufs, unsigned int n)
+{
+    int id;
+
+    g_assert(n > 0);
+    if (vr->num_free < n) {
+        return -1;
+    }
+
+    if (vr->packed) {
+        id = vring_driver_add_packed(vr, bufs, n);
+    } else {
+        id = vring_driver_add_split(vr, bufs, n);
+    }
+    vr->chain_len[id] = n;
+    vr->num_free -= n;
+    return id;
+}
+
+void vring_driver_publish(VRingDriver *vr)
+{
+    if (!vr->packed) {
+        smp_wmb();
+        qatomic_set(&vr->avail->idx, cpu_to_le16(vr->avail_idx));
+    }
+    smp_mb();
+}
+
+int vring_driver_get_used(VRingDriver *vr, uint32_t *len)
+{
+    int id;
+
+    if (vr->packed) {
+        struct vring_packed_desc *d = &vr->pdesc[vr->next_used];
+        uint16_t flags = le16_to_cpu(qatomic_read(&d->flags));
+        bool avail = flags & (1 << VRING_PACKED_DESC_F_AVAIL);
+        bool used = flags & (1 << VRING_PACKED_DESC_F_USED);
+
+        if (avail != used || used != vr->used_wrap) {
+            return -1;
+        }
+        smp_rmb();
+        id = le16_to_cpu(d->id);
+        *len = le32_to_cpu(d->len);
+
+        vr->next_used += vr->chain_len[id];
+        if (vr->next_used >= vr->num) {
+            vr->next_used -= vr->num;
+            vr->used_wrap = !vr->used_wrap;
+        }
+        vr->id_next[id] = vr->free_id;
+        vr->free_id = id;
+    } else {
+        vring_used_elem_t *e;
+        uint16_t last;
+        unsigned int j;
+
+        if (le16_to_cpu(qatomic_read(&vr->used->idx)) == vr->last_used_idx) {
+            return -1;
+        }
+        smp_rmb();
+        e = &vr->used->ring[vr->last_used_idx % vr->num];
+        id = le32_to_cpu(e->id);
+        *len = le32_to_cpu(e->len);
+        vr->last_used_idx++;
+
+        /* Put the chain back on the free list */
+        last = id;
+        for (j = 1; j < vr->chain_len[id]; j++) {
+            last = vr->free_next[last];
+        }
+        vr->free_next[last] = vr->free_head;
+        vr->free_head = id;
+    }
+
+    vr->num_free += vr->chain_len[id];
+    return id;
+}
@@ -0,0 +1,85 @@
+/*
+ * Driver side of split and packed virtqueues for benchmarks
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#ifndef TESTS_BENCH_VRING_DRIVER_H
+#define TESTS_BENCH_VRING_DRIVER_H
+
+#include "standard-headers/linux/virtio_ring.h"
+
+/* Guest memory that the driver can both address and access directly */
+typedef struct BenchMem {
+    uint8_t *hva;
+    uint64_t gpa;
+    uint64_t size;
+    uint64_t used;
+} BenchMem;
+
+/* Returns the guest physical address of a zeroed area of @size bytes */
+uint64_t bench_mem_alloc(BenchMem *mem, uint64_t size, uint64_t align);
+void bench_mem_reset(BenchMem *mem);
+
+static inline void *bench_mem_ptr(BenchMem *mem, uint64_t gpa)
+{
+    return mem->hva + (gpa - mem->gpa);
+}
+
+typedef struct VRingBuf {
+    uint64_t gpa;
+    uint32_t len;
+    bool write;         /* device-writable */
+} VRingBuf;
+
+typedef struct VRingDriver {
+    bool packed;
+    unsigned int num;
+    unsigned int num_free;
+    uint64_t desc_gpa;
+    uint64_t driver_gpa;    /* avail ring or driver event suppression */
+    uint64_t device_gpa;    /* used ring or device event suppression */
+
+    /* split */
+    struct vring_desc *desc;
+    struct vring_avail *avail;
+    struct vring_used *used;
+    uint16_t avail_idx;
+    uint16_t last_used_idx;
+    uint16_t free_head;
+    uint16_t *free_next;    /* shadow of desc[].next, never read back */
+
+    /* packed */
+    struct vring_packed_desc *pdesc;
+    uint16_t next_avail;
+    uint16_t next_used;
+    bool avail_wrap;
+    bool used_wrap;
+    uint16_t free_id;
+    uint16_t *id_next;
+
+    /* number of descriptors of the chain starting at/with each id */
+    uint16_t *chain_len;
+} VRingDriver;
+
+/*
+ * Lay out a ring of @num entries in @mem.  Interrupts are suppressed, the
+ * driver polls with vring_driver_get_used().
+ */
+void vring_driver_init(VRingDriver *vr, BenchMem *mem, unsigned int num,
+                       bool packed);
+void vring_driver_cleanup(VRingDriver *vr);
+
+/*
+ * Add a chain of @n buffers.  Returns its id or -1 if the ring is full.
+ * For split rings the chain is only visible to the device after
+ * vring_driver_publish().
+ */
+int vring_driver_add(VRingDriver *vr, const VRingBuf *bufs, unsigned int n);
+void vring_driver_publish(VRingDriver *vr);
+
+/* Returns the id of the next used chain or -1 */
+int vring_driver_get_used(VRingDriver *vr, uint32_t *len);
+
+#endif
@@ -121,4 +121,60 @@ def __init__(self, name, scenarios):
         Scenario("compr-xbzrle-cache-50",
                  compression_xbzrle=True, compression_xbzrle_cache=50),
     ]),
+
+
+    # Looking at effect of multifd with varying numbers
+    # of channels
+    Comparison("multifd", scenarios = [
+        Scenario("multifd-channels-1",
+                 multifd=True, multifd_channels=1),
+        Scenario("multifd-channels-2",
+                 multifd=True, multifd_channels=2),
+        Scenario("multifd-channels-4",
+                 multifd=True, multifd_channels=4),
+        Scenario("multifd-channels-8",
+                 multifd=True, multifd_channels=8),
+    ]),
+
+
+    # Looking at precopy convergence as the guest dirties
+    # memory faster
+    Comparison("dirty-rate", scenarios = [
+        Scenario("dirty-rate-100mbs", dirty_rate=100),
+        Scenario("dirty-rate-500mbs", dirty_rate=500),
+        Scenario("dirty-rate-1000mbs", dirty_rate=1000),
+        Scenario("dirty-rate-max", dirty_rate=0),
+    ]),
+
+
+    # Looking at effect of the size of the dirtied
+    # working set on precopy and post-copy
+    Comparison("working-set", scenarios = [
+        Scenario("working-set-10", working_set=10),
+        Scenario("working-set-50", working_set=50),
+        Scenario("working-set-100", working_set=100),
+        Scenario("working-set-10-post-copy",
+                 working_set=10, post_copy=True),
+        Scenario("working-set-100-post-copy",
+                 working_set=100, post_copy=True),
+    ]),
+
+
+    # Looking at how the content of dirtied pages works
+    # with zero page detection, xbzrle and compression
+    Comparison("page-pattern", scenarios = [
+        Scenario("page-pattern-random", page_pattern="random"),
+        Scenario("page-pattern-sparse", page_pattern="sparse"),
+        Scenario("page-pattern-zero", page_pattern="zero"),
+        Scenario("page-pattern-random-xbzrle",
+                 page_pattern="random", compression_xbzrle=True),
+        Scenario("page-pattern-sparse-xbzrle",
+                 page_pattern="sparse", compression_xbzrle=True),
+        Scenario("page-pattern-random-compr-mt",
+                 page_pattern="random", compression_mt=True,
+                 compression_mt_threads=4),
+        Scenario("page-pattern-sparse-compr-mt",
+                 page_pattern="sparse", compression_mt=True,
+                 compression_mt_threads=4),
+    ]),
 ]
@@ -53,8 +53,23 @@ def __init__(self,
         self._transport = transport
         self._sleep = sleep
 
+    def summary(self):
+        """The figures used to compare migration configurations"""
+        if len(self._progress_history) == 0:
+            return {}
+        last = self._progress_history[-1]
+        return {
+            "status": last._status,
+            "total_time": last._duration, # milliseconds
+            "downtime": last._downtime, # milliseconds
+            "setup_time": last._setup_time, # milliseconds
+            "transferred_bytes": last._ram._transferred_bytes,
+            "iterations": last._ram._iterations,
+        }
+
     def serialize(self):
         return {
+            "summary": self.summary(),
             "hardware": self._hardware.serialize(),
             "scenario": self._scenario.serialize(),
             "progress_history": [progress.serialize() for progress in self._progress_history],
@@ -29,7 +29,9 @@ def __init__(self, name,
                  post_copy=False, post_copy_iters=5,
                  auto_converge=False, auto_converge_step=10,
                  compression_mt=False, compression_mt_threads=1,
-                 compression_xbzrle=False, compression_xbzrle_cache=10):
+                 compression_xbzrle=False, compression_xbzrle_cache=10,
+                 multifd=False, multifd_channels=2,
+                 dirty_rate=0, working_set=100, page_pattern="random"):
 
         self._name = name
 
@@ -56,6 +58,14 @@ def __init__(self, name,
         self._compression_xbzrle = compression_xbzrle
         self._compression_xbzrle_cache = compression_xbzrle_cache # percentage of guest RAM
 
+        self._multifd = multifd
+        self._multifd_channels = multifd_channels
+
+        # Guest workload
+        self._dirty_rate = dirty_rate # MiB per second, 0 for unlimited
+        self._working_set = working_set # percentage of guest RAM
+        self._page_pattern = page_pattern # "random", "sparse" or "zero"
+
     def serialize(self):
         return {
             "name": self._name,
@@ -73,6 +83,11 @@ def serialize(self):
             "compression_mt_threads": self._compression_mt_threads,
             "compression_xbzrle": self._compression_xbzrle,
             "compression_xbzrle_cache": self._compression_xbzrle_cache,
+            "multifd": self._multifd,
+            "multifd_channels": self._multifd_channels,
+            "dirty_rate": self._dirty_rate,
+            "working_set": self._working_set,
+            "page_pattern": self._page_pattern,
         }
 
     @classmethod
@@ -92,4 +107,10 @@ def deserialize(cls, data):
             data["compression_mt"],
             data["compression_mt_threads"],
             data["compression_xbzrle"],
-            data["compression_xbzrle_cache"])
+            data["compression_xbzrle_cache"],
+            # Reports written before these existed lack them
+            data.get("multifd", False),
+            data.get("multifd_channels", 2),
+            data.get("dirty_rate", 0),
+            data.get("working_set", 100),
+            data.get("page_pattern", "random"))
@@ -122,6 +122,17 @@ def __init__(self):
         parser.add_argument("--compression-xbzrle", dest="compression_xbzrle", default=False, action="store_true")
         parser.add_argument("--compression-xbzrle-cache", dest="compression_xbzrle_cache", default=10, type=int)
 
+        parser.add_argument("--multifd", dest="multifd", default=False, action="store_true")
+        parser.add_argument("--multifd-channels", dest="multifd_channels", default=2, type=int)
+
+        # Guest workload args
+        parser.add_argument("--dirty-rate", dest="dirty_rate", default=0, type=int,
+                            help="MiB/s dirtied by the guest, 0 for unlimited")
+        parser.add_argument("--working-set", dest="working_set", default=100, type=int,
+                            help="percentage of guest RAM dirtied by the guest")
+        parser.add_argument("--page-pattern", dest="page_pattern", default="random",
+                            choices=["random", "sparse", "zero"])
+
     def get_scenario(self, args):
         return Scenario(name="perfreport",
                         downtime=args.downtime,
@@ -142,7 +153,14 @@ def get_scenario(self, args):
                         compression_mt_threads=args.compression_mt_threads,
 
                         compression_xbzrle=args.compression_xbzrle,
-                        compression_xbzrle_cache=args.compression_xbzrle_cache)
+                        compression_xbzrle_cache=args.compression_xbzrle_cache,
+
+                        multifd=args.multifd,
+                        multifd_channels=args.multifd_channels,
+
+                        dirty_rate=args.dirty_rate,
+                        working_set=args.working_set,
+                        page_pattern=args.page_pattern)
 
     def run(self, argv):
         args = self._parser.parse_args(argv)
@@ -210,6 +228,12 @@ def run(self, argv):
                     report = engine.run(hardware, scenario)
                     with open(filename, "w") as fh:
                         print(report.to_json(), file=fh)
+
+                    summary = report.summary()
+                    print("%s: %s, total %d ms, downtime %d ms, %d MiB sent" % (
+                        name, summary["status"], summary["total_time"],
+                        summary["downtime"],
+                        summary["transferred_bytes"] / (1024 * 1024)))
         except Exception as e:
             print("Error: %s" % str(e), file=sys.stderr)
             if args.debug:
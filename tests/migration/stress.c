@@ -29,6 +29,26 @@ const char *argv0;
 
 #define RAM_PAGE_SIZE 4096
 
+/* How each pass over the working set changes the pages */
+enum {
+    PATTERN_RANDOM,     /* XOR every word with random data */
+    PATTERN_SPARSE,     /* change one word per page */
+    PATTERN_ZERO,       /* rewrite the page with zeroes */
+};
+
+static const char *pattern_names[] = {
+    [PATTERN_RANDOM] = "random",
+    [PATTERN_SPARSE] = "sparse",
+    [PATTERN_ZERO] = "zero",
+};
+
+typedef struct StressParams {
+    unsigned long long ramsizeMB;   /* memory allocated per thread */
+    unsigned long long wssMB;       /* part of it that is dirtied */
+    unsigned long long rateMB;      /* MB/s dirtied per thread, 0 = max */
+    int pattern;
+} StressParams;
+
 #ifndef CONFIG_GETTID
 static int gettid(void)
 {
@@ -147,6 +167,21 @@ static int random_bytes(char *buf, size_t len)
 }
 
 
+static int parse_pattern(const char *name)
+{
+    int i;
+
+    for (i = 0; i < G_N_ELEMENTS(pattern_names); i++) {
+        if (!strcmp(name, pattern_names[i])) {
+            return i;
+        }
+    }
+    fprintf(stderr, "%s (%05d): ERROR: unknown page pattern %s\n",
+            argv0, gettid(), name);
+    return -1;
+}
+
+
 static unsigned long long now(void)
 {
     struct timeval tv;
@@ -156,40 +191,74 @@ static unsigned long long now(void)
     return (tv.tv_sec * 1000ull) + (tv.tv_usec / 1000ull);
 }
 
-static void stressone(unsigned long long ramsizeMB)
+static void dirty_page(char *page, const char *data, int pattern)
+{
+    size_t k;
+
+    switch (pattern) {
+    case PATTERN_RANDOM:
+        for (k = 0; k < RAM_PAGE_SIZE; k += sizeof(long long)) {
+            *(unsigned long long *)(page + k) ^=
+                *(unsigned long long *)(data + k);
+        }
+        break;
+    case PATTERN_SPARSE:
+        (*(unsigned long long *)page)++;
+        break;
+    case PATTERN_ZERO:
+        memset(page, 0, RAM_PAGE_SIZE);
+        /* keep the compiler from noticing that the page stays zero */
+        asm volatile("" : : "r" (page) : "memory");
+        break;
+    }
+}
+
+static void stressone(const StressParams *p)
 {
     size_t pagesPerMB = 1024 * 1024 / RAM_PAGE_SIZE;
-    g_autofree char *ram = g_malloc(ramsizeMB * 1024 * 1024);
+    g_autofree char *ram = g_malloc(p->ramsizeMB * 1024 * 1024);
     char *ramptr;
-    size_t i, j, k;
+    size_t i, j;
     g_autofree char *data = g_malloc(RAM_PAGE_SIZE);
-    char *dataptr;
     size_t nMB = 0;
-    unsigned long long before, after;
+    unsigned long long before, after, start, totalMB = 0;
 
     /* We don't care about initial state, but we do want
      * to fault it all into RAM, otherwise the first iter
      * of the loop below will be quite slow. We can't use
      * 0x0 as the byte as gcc optimizes that away into a
      * calloc instead :-) */
-    memset(ram, 0xfe, ramsizeMB * 1024 * 1024);
+    memset(ram, 0xfe, p->ramsizeMB * 1024 * 1024);
 
     if (random_bytes(data, RAM_PAGE_SIZE) < 0) {
         return;
     }
 
-    before = now();
+    start = before = now();
 
     while (1) {
 
         ramptr = ram;
-        for (i = 0; i < ramsizeMB; i++, nMB++) {
+        for (i = 0; i < p->wssMB; i++, nMB++) {
             for (j = 0; j < pagesPerMB; j++) {
-                dataptr = data;
-                for (k = 0; k < RAM_PAGE_SIZE; k += sizeof(long long)) {
-                    ramptr += sizeof(long long);
-                    dataptr += sizeof(long long);
-                    *(unsigned long long *)ramptr ^= *(unsigned long long *)dataptr;
+                dirty_page(ramptr, data, p->pattern);
+                ramptr += RAM_PAGE_SIZE;
+            }
+
+            /*
+             * Sleep off whatever is ahead of the requested dirty rate.
+             * If the guest was stopped for a while, do not make up for
+             * the lost time with a burst of dirtying.
+             */
+            totalMB++;
+            if (p->rateMB) {
+                unsigned long long due = start + totalMB * 1000 / p->rateMB;
+                unsigned long long t = now();
+
+                if (due > t) {
+                    g_usleep((due - t) * 1000);
+                } else if (t - due > 1000) {
+                    start += t - due;
                 }
             }
 
@@ -207,26 +276,30 @@ static void stressone(unsigned long long ramsizeMB)
 
 static void *stressthread(void *arg)
 {
-    unsigned long long ramsizeMB = *(unsigned long long *)arg;
-
-    stressone(ramsizeMB);
+    stressone(arg);
 
     return NULL;
 }
 
-static void stress(unsigned long long ramsizeGB, int ncpus)
+static void stress(StressParams *p, int ncpus)
 {
     size_t i;
-    unsigned long long ramsizeMB = ramsizeGB * 1024 / ncpus;
+
+    p->ramsizeMB /= ncpus;
+    p->wssMB /= ncpus;
+    p->rateMB = p->rateMB ? MAX(p->rateMB / ncpus, 1) : 0;
+    if (!p->wssMB) {
+        p->wssMB = 1;
+    }
     ncpus--;
 
     for (i = 0; i < ncpus; i++) {
         pthread_t thr;
         pthread_create(&thr, NULL,
-                       stressthread,   &ramsizeMB);
+                       stressthread,   p);
     }
 
-    stressone(ramsizeMB);
+    stressone(p);
 }
 
 
@@ -263,14 +336,21 @@ static int mount_all(void)
 int main(int argc, char **argv)
 {
     unsigned long long ramsizeGB = 1;
+    unsigned long long wssMB = 0;
+    unsigned long long rateMB = 0;
+    g_autofree char *pattern = NULL;
+    StressParams params = { .pattern = PATTERN_RANDOM };
     char *end;
     int ch;
     int opt_ind = 0;
-    const char *sopt = "hr:c:";
+    const char *sopt = "hr:c:w:d:p:";
     struct option lopt[] = {
         { "help", no_argument, NULL, 'h' },
         { "ramsize", required_argument, NULL, 'r' },
         { "cpus", required_argument, NULL, 'c' },
+        { "wss", required_argument, NULL, 'w' },
+        { "dirty-rate", required_argument, NULL, 'd' },
+        { "pattern", required_argument, NULL, 'p' },
         { NULL, 0, NULL, 0 }
     };
     int ret;
@@ -300,9 +380,36 @@ int main(int argc, char **argv)
             }
             break;
 
+        case 'w':
+            errno = 0;
+            wssMB = strtoll(optarg, &end, 10);
+            if (errno != 0 || *end) {
+                fprintf(stderr, "%s (%05d): ERROR: Cannot parse working set size %s\n",
+                        argv0, gettid(), optarg);
+                exit_failure();
+            }
+            break;
+
+        case 'd':
+            errno = 0;
+            rateMB = strtoll(optarg, &end, 10);
+            if (errno != 0 || *end) {
+                fprintf(stderr, "%s (%05d): ERROR: Cannot parse dirty rate %s\n",
+                        argv0, gettid(), optarg);
+                exit_failure();
+            }
+            break;
+
+        case 'p':
+            g_free(pattern);
+            pattern = g_strdup(optarg);
+            break;
+
         case '?':
         case 'h':
-            fprintf(stderr, "%s: [--help][--ramsize GB][--cpus N]\n", argv0);
+            fprintf(stderr, "%s: [--help][--ramsize GB][--cpus N]"
+                    "[--wss MB][--dirty-rate MB/s]"
+                    "[--pattern random|sparse|zero]\n", argv0);
             exit_failure();
         }
     }
@@ -314,6 +421,24 @@ int main(int argc, char **argv)
         ret = get_command_arg_ull("ramsize", &ramsizeGB);
         if (ret < 0)
             exit_failure();
+        ret = get_command_arg_ull("wss", &wssMB);
+        if (ret < 0)
+            exit_failure();
+        ret = get_command_arg_ull("dirtyrate", &rateMB);
+        if (ret < 0)
+            exit_failure();
+        ret = get_command_arg_str("pattern", &pattern);
+        if (ret < 0)
+            exit_failure();
+    }
+
+    params.ramsizeMB = ramsizeGB * 1024;
+    params.wssMB = wssMB ? MIN(wssMB, params.ramsizeMB) : params.ramsizeMB;
+    params.rateMB = rateMB;
+    if (pattern) {
+        params.pattern = parse_pattern(pattern);
+        if (params.pattern < 0)
+            exit_failure();
     }
 
     if (ncpus == 0)
@@ -321,8 +446,11 @@ int main(int argc, char **argv)
 
     fprintf(stdout, "%s (%05d): INFO: RAM %llu GiB across %d CPUs\n",
             argv0, gettid(), ramsizeGB, ncpus);
+    fprintf(stdout, "%s (%05d): INFO: dirtying %llu MiB at %llu MiB/s (0 = max) with %s pattern\n",
+            argv0, gettid(), params.wssMB, params.rateMB,
+            pattern_names[params.pattern]);
 
-    stress(ramsizeGB, ncpus);
+    stress(&params, ncpus);
 
     exit_failure();
 }
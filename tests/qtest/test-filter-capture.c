@@ -0,0 +1,173 @@
+/*
+ * QTest testcase for filter-capture
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or
+ * later.  See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu-common.h"
+#include "libqos/libqtest.h"
+#include "qapi/qmp/qdict.h"
+#include "qemu/iov.h"
+#include "qemu/sockets.h"
+
+/* TODO actually test the results and get rid of this */
+#define qmp_discard_response(qs, ...) qobject_unref(qtest_qmp(qs, __VA_ARGS__))
+
+/* Section header, interface description and one enhanced packet block */
+#define SHB_LEN 28
+#define IDB_LEN 20
+#define EPB_HDR_LEN 28
+
+static gchar *wait_for_capture(const char *path, gsize expected)
+{
+    gchar *contents = NULL;
+    gsize len = 0;
+    int i;
+
+    for (i = 0; i < 500; i++) {
+        g_free(contents);
+        g_assert(g_file_get_contents(path, &contents, &len, NULL));
+        if (len >= expected) {
+            break;
+        }
+        g_usleep(10 * 1000);
+    }
+    g_assert_cmpint(len, ==, expected);
+    return contents;
+}
+
+static const char ipv4_frame[] =
+    "\x52\x54\x00\x12\x34\x56\x52\x54\x00\x12\x34\x57\x08\x00"
+    "\x45\x00\x00\x14\x00\x00\x00\x00\x40\x06\x00\x00"
+    "\x0a\x00\x00\x01\x0a\x00\x00\x02";
+
+static const char arp_frame[] =
+    "\xff\xff\xff\xff\xff\xff\x52\x54\x00\x12\x34\x57\x08\x06"
+    "\x00\x01\x08\x00\x06\x04\x00\x01";
+
+static void send_frame(int fd, const char *buf, uint32_t len)
+{
+    uint32_t size = htonl(len);
+    struct iovec iov[] = {
+        {
+            .iov_base = &size,
+            .iov_len = sizeof(size),
+        }, {
+            .iov_base = (void *)buf,
+            .iov_len = len,
+        },
+    };
+    ssize_t ret;
+
+    ret = iov_send(fd, iov, 2, 0, sizeof(size) + len);
+    g_assert_cmpint(ret, ==, sizeof(size) + len);
+}
+
+/*
+ * Send an ARP frame, which @bpf may filter out, then an IPv4 frame, and
+ * check that exactly the IPv4 frame shows up in the capture file.
+ */
+static void test_capture(uint32_t snaplen, const char *bpf, bool send_arp)
+{
+    int send_sock[2];
+    uint32_t ret;
+    uint32_t send_len = sizeof(ipv4_frame) - 1;
+    uint32_t expect_caplen = MIN(snaplen, send_len);
+    uint32_t epb_len = EPB_HDR_LEN + ROUND_UP(expect_caplen, 4) + 4;
+    g_autofree char *tmpdir = g_dir_make_tmp("filter-capture-XXXXXX", NULL);
+    g_autofree char *path = g_strdup_printf("%s/capture.pcapng", tmpdir);
+    g_autofree gchar *contents = NULL;
+    const char *devstr = "e1000";
+    QTestState *qts;
+    QDict *response;
+    uint32_t *epb;
+
+    ret = socketpair(PF_UNIX, SOCK_STREAM, 0, send_sock);
+    g_assert_cmpint(ret, !=, -1);
+
+    qts = qtest_initf(
+        "-netdev socket,id=qtest-bn0,fd=%d "
+        "-device %s,netdev=qtest-bn0,id=qtest-e0 "
+        , send_sock[1], devstr);
+
+    if (bpf) {
+        response = qtest_qmp(qts, "{'execute': 'object-add',"
+                             " 'arguments': {"
+                             "   'qom-type': 'filter-capture',"
+                             "   'id': 'qtest-f0',"
+                             "   'netdev': 'qtest-bn0',"
+                             "   'queue': 'tx',"
+                             "   'file': %s,"
+                             "   'snaplen': %u,"
+                             "   'bpf': %s"
+                             "}}", path, snaplen, bpf);
+    } else {
+        response = qtest_qmp(qts, "{'execute': 'object-add',"
+                             " 'arguments': {"
+                             "   'qom-type': 'filter-capture',"
+                             "   'id': 'qtest-f0',"
+                             "   'netdev': 'qtest-bn0',"
+                             "   'queue': 'tx',"
+                             "   'file': %s,"
+                             "   'snaplen': %u"
+                             "}}", path, snaplen);
+    }
+    g_assert(response);
+    g_assert(!qdict_haskey(response, "error"));
+    qobject_unref(response);
+
+    /* send a qmp command to guarantee that 'connected' is setting to true. */
+    qmp_discard_response(qts, "{ 'execute' : 'query-status'}");
+    if (send_arp) {
+        send_frame(send_sock[0], arp_frame, sizeof(arp_frame) - 1);
+    }
+    send_frame(send_sock[0], ipv4_frame, send_len);
+
+    contents = wait_for_capture(path, SHB_LEN + IDB_LEN + epb_len);
+    g_assert_cmphex(*(uint32_t *)contents, ==, 0x0a0d0d0a);
+    g_assert_cmphex(*(uint32_t *)(contents + SHB_LEN), ==, 1);
+
+    epb = (uint32_t *)(contents + SHB_LEN + IDB_LEN);
+    g_assert_cmphex(epb[0], ==, 6);
+    g_assert_cmpint(epb[1], ==, epb_len);
+    g_assert_cmpint(epb[5], ==, expect_caplen);
+    g_assert_cmpint(epb[6], ==, send_len);
+    g_assert(!memcmp(&epb[7], ipv4_frame, expect_caplen));
+
+    close(send_sock[0]);
+    close(send_sock[1]);
+    qtest_quit(qts);
+    unlink(path);
+    rmdir(tmpdir);
+}
+
+/* tcpdump -ddd ip */
+#define BPF_IP "4,40 0 0 12,21 0 1 2048,6 0 0 262144,6 0 0 0"
+
+static void test_capture_all(void)
+{
+    test_capture(65536, NULL, false);
+}
+
+static void test_capture_snaplen(void)
+{
+    test_capture(14, NULL, false);
+}
+
+static void test_capture_bpf(void)
+{
+    test_capture(65536, BPF_IP, true);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    qtest_add_func("/netfilter/capture/all", test_capture_all);
+    qtest_add_func("/netfilter/capture/snaplen", test_capture_snaplen);
+    qtest_add_func("/netfilter/capture/bpf", test_capture_bpf);
+
+    return g_test_run();
+}
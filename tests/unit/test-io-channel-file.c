@@ -102,6 +102,44 @@ static void test_io_channel_fd(void)
 }
 
 
+#ifdef CONFIG_PREADV
+static void test_io_channel_file_pwritev(void)
+{
+    QIOChannel *ioc;
+    char wbuf[8] = "abcdefgh";
+    char rbuf[8];
+    struct iovec wiov[2] = {
+        { .iov_base = wbuf, .iov_len = 4 },
+        { .iov_base = wbuf + 4, .iov_len = 4 },
+    };
+    struct iovec riov = { .iov_base = rbuf, .iov_len = sizeof(rbuf) };
+
+    unlink(TEST_FILE);
+    ioc = QIO_CHANNEL(qio_channel_file_new_path(TEST_FILE,
+                                                O_RDWR | O_CREAT | O_BINARY,
+                                                0600, &error_abort));
+    g_assert(qio_channel_has_feature(ioc, QIO_CHANNEL_FEATURE_SEEKABLE));
+
+    /* Writing at an offset leaves a hole and doesn't move the file offset */
+    g_assert_cmpint(qio_channel_pwritev_all(ioc, wiov, 2, 4096,
+                                            &error_abort), ==, 0);
+    g_assert_cmpint(qio_channel_io_seek(ioc, 0, SEEK_CUR,
+                                        &error_abort), ==, 0);
+
+    g_assert_cmpint(qio_channel_preadv_all(ioc, &riov, 1, 4096,
+                                           &error_abort), ==, 0);
+    g_assert(memcmp(rbuf, wbuf, sizeof(wbuf)) == 0);
+
+    /* Reading past the end of the file is an error */
+    g_assert_cmpint(qio_channel_preadv_all(ioc, &riov, 1, 8192,
+                                           NULL), ==, -1);
+
+    unlink(TEST_FILE);
+    object_unref(OBJECT(ioc));
+}
+#endif /* CONFIG_PREADV */
+
+
 #ifndef _WIN32
 static void test_io_channel_pipe(bool async)
 {
@@ -147,6 +185,9 @@ int main(int argc, char **argv)
     g_test_add_func("/io/channel/file", test_io_channel_file);
     g_test_add_func("/io/channel/file/rdwr", test_io_channel_file_rdwr);
     g_test_add_func("/io/channel/file/fd", test_io_channel_fd);
+#ifdef CONFIG_PREADV
+    g_test_add_func("/io/channel/file/pwritev", test_io_channel_file_pwritev);
+#endif
 #ifndef _WIN32
     g_test_add_func("/io/channel/pipe/sync", test_io_channel_pipe_sync);
     g_test_add_func("/io/channel/pipe/async", test_io_channel_pipe_async);
@@ -671,6 +671,35 @@ static void test_accounting(void)
                                 (64.0 / 13)));
 }
 
+static void test_headroom(void)
+{
+    double size, units;
+
+    throttle_config_init(&cfg);
+    cfg.buckets[THROTTLE_BPS_TOTAL].avg = 1000;
+    cfg.buckets[THROTTLE_OPS_WRITE].avg = 100;
+
+    throttle_init(&ts);
+    throttle_config(&ts, QEMU_CLOCK_VIRTUAL, &cfg);
+
+    /* the bucket sizes are a tenth of the limits, as bkt.max is not set */
+    throttle_account(&ts, false, 30);
+    throttle_get_headroom(&ts, QEMU_CLOCK_VIRTUAL, false, &size, &units);
+    g_assert_cmpfloat(size, >, 69);
+    g_assert_cmpfloat(size, <=, 70);
+    g_assert(isinf(units));
+
+    throttle_get_headroom(&ts, QEMU_CLOCK_VIRTUAL, true, &size, &units);
+    g_assert_cmpfloat(size, <=, 70);
+    g_assert_cmpfloat(units, >, 9);
+    g_assert_cmpfloat(units, <=, 10);
+
+    /* give back more than was accounted, the level stays at zero */
+    throttle_account_units(&ts, false, -100, -1);
+    g_assert(double_cmp(ts.cfg.buckets[THROTTLE_BPS_TOTAL].level, 0));
+    g_assert(double_cmp(ts.cfg.buckets[THROTTLE_OPS_TOTAL].level, 0));
+}
+
 static void test_groups(void)
 {
     ThrottleConfig cfg1, cfg2;
@@ -764,6 +793,7 @@ int main(int argc, char **argv)
                     test_iops_size_is_missing_limit);
     g_test_add_func("/throttle/config_functions",   test_config_functions);
     g_test_add_func("/throttle/accounting",         test_accounting);
+    g_test_add_func("/throttle/headroom",           test_headroom);
     g_test_add_func("/throttle/groups",             test_groups);
     return g_test_run();
 }
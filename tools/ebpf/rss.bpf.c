@@ -0,0 +1,264 @@
+/*
+ * eBPF RSS program
+ *
+ * Steers packets written to a multiqueue tap through TUNSETSTEERINGEBPF:
+ * the Toeplitz hash of the packet selects an entry of the guest's
+ * indirection table, whose value is the queue the packet goes to.
+ *
+ * The maps are filled by ebpf/ebpf_rss.c with the configuration the guest
+ * set through VIRTIO_NET_CTRL_MQ_RSS_CONFIG.
+ *
+ * IPv6 extension headers are not parsed: packets that carry them are
+ * hashed on their addresses only, and the _EX hash types are treated like
+ * their plain counterparts.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * Build with tools/ebpf/Makefile.ebpf.
+ */
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <linux/bpf.h>
+
+#include <linux/in.h>
+#include <linux/if_ether.h>
+#include <linux/ip.h>
+#include <linux/ipv6.h>
+
+#include <linux/udp.h>
+#include <linux/tcp.h>
+
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_endian.h>
+#include <linux/virtio_net.h>
+
+#define INDIRECTION_TABLE_SIZE 128
+#define HASH_CALCULATION_BUFFER_SIZE 36
+
+struct rss_config_t {
+    __u8 redirect;
+    __u8 populate_hash;
+    __u32 hash_types;
+    __u16 indirections_len;
+    __u16 default_queue;
+} __attribute__((packed));
+
+struct toeplitz_key_data_t {
+    __u32 leftmost_32_bits;
+    __u8 next_byte[HASH_CALCULATION_BUFFER_SIZE];
+};
+
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __uint(key_size, sizeof(__u32));
+    __uint(value_size, sizeof(struct rss_config_t));
+    __uint(max_entries, 1);
+} tap_rss_map_configurations SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __uint(key_size, sizeof(__u32));
+    __uint(value_size, sizeof(struct toeplitz_key_data_t));
+    __uint(max_entries, 1);
+} tap_rss_map_toeplitz_key SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __uint(key_size, sizeof(__u32));
+    __uint(value_size, sizeof(__u16));
+    __uint(max_entries, INDIRECTION_TABLE_SIZE);
+} tap_rss_map_indirection_table SEC(".maps");
+
+static inline void net_rx_rss_add_chunk(__u8 *rss_input, size_t *bytes_written,
+                                        const void *ptr, size_t size)
+{
+    __builtin_memcpy(&rss_input[*bytes_written], ptr, size);
+    *bytes_written += size;
+}
+
+static inline
+void net_toeplitz_add(__u32 *result,
+                      __u8 *input,
+                      __u32 len,
+                      struct toeplitz_key_data_t *key)
+{
+    __u32 accumulator = *result;
+    __u32 leftmost_32_bits = key->leftmost_32_bits;
+    __u32 byte;
+
+    for (byte = 0; byte < HASH_CALCULATION_BUFFER_SIZE; byte++) {
+        __u8 input_byte = input[byte];
+        __u8 key_byte = key->next_byte[byte];
+        __u8 bit;
+
+        if (byte >= len) {
+            break;
+        }
+
+        for (bit = 0; bit < 8; bit++) {
+            if (input_byte & (1 << 7)) {
+                accumulator ^= leftmost_32_bits;
+            }
+
+            leftmost_32_bits =
+                (leftmost_32_bits << 1) | ((key_byte & (1 << 7)) >> 7);
+
+            input_byte <<= 1;
+            key_byte <<= 1;
+        }
+    }
+
+    *result = accumulator;
+}
+
+/* Load the L4 ports at @offset, unless the packet is too short. */
+static inline bool load_ports(struct __sk_buff *skb, size_t offset,
+                              __u16 ports[2])
+{
+    return bpf_skb_load_bytes_relative(skb, offset, ports, sizeof(__u16) * 2,
+                                       BPF_HDR_START_MAC) == 0;
+}
+
+static inline size_t parse_ipv4(struct __sk_buff *skb, __u32 hash_types,
+                                __u8 *rss_input)
+{
+    size_t bytes_written = 0;
+    struct iphdr ip;
+    __u16 ports[2];
+    size_t l4_offset;
+    bool is_fragment;
+
+    if (bpf_skb_load_bytes_relative(skb, ETH_HLEN, &ip, sizeof(ip),
+                                    BPF_HDR_START_MAC)) {
+        return 0;
+    }
+
+    is_fragment = ip.frag_off & bpf_htons(0x3fff);
+    l4_offset = ETH_HLEN + ip.ihl * 4;
+
+    if (!is_fragment &&
+        ((ip.protocol == IPPROTO_TCP &&
+          (hash_types & VIRTIO_NET_RSS_HASH_TYPE_TCPv4)) ||
+         (ip.protocol == IPPROTO_UDP &&
+          (hash_types & VIRTIO_NET_RSS_HASH_TYPE_UDPv4))) &&
+        load_ports(skb, l4_offset, ports)) {
+        net_rx_rss_add_chunk(rss_input, &bytes_written,
+                             &ip.saddr, sizeof(ip.saddr));
+        net_rx_rss_add_chunk(rss_input, &bytes_written,
+                             &ip.daddr, sizeof(ip.daddr));
+        net_rx_rss_add_chunk(rss_input, &bytes_written,
+                             ports, sizeof(ports));
+    } else if (hash_types & VIRTIO_NET_RSS_HASH_TYPE_IPv4) {
+        net_rx_rss_add_chunk(rss_input, &bytes_written,
+                             &ip.saddr, sizeof(ip.saddr));
+        net_rx_rss_add_chunk(rss_input, &bytes_written,
+                             &ip.daddr, sizeof(ip.daddr));
+    }
+
+    return bytes_written;
+}
+
+static inline size_t parse_ipv6(struct __sk_buff *skb, __u32 hash_types,
+                                __u8 *rss_input)
+{
+    const __u32 tcp_types = VIRTIO_NET_RSS_HASH_TYPE_TCPv6 |
+                            VIRTIO_NET_RSS_HASH_TYPE_TCP_EX;
+    const __u32 udp_types = VIRTIO_NET_RSS_HASH_TYPE_UDPv6 |
+                            VIRTIO_NET_RSS_HASH_TYPE_UDP_EX;
+    const __u32 ip_types = VIRTIO_NET_RSS_HASH_TYPE_IPv6 |
+                           VIRTIO_NET_RSS_HASH_TYPE_IP_EX;
+    size_t bytes_written = 0;
+    struct ipv6hdr ip6;
+    __u16 ports[2];
+
+    if (bpf_skb_load_bytes_relative(skb, ETH_HLEN, &ip6, sizeof(ip6),
+                                    BPF_HDR_START_MAC)) {
+        return 0;
+    }
+
+    if (((ip6.nexthdr == IPPROTO_TCP && (hash_types & tcp_types)) ||
+         (ip6.nexthdr == IPPROTO_UDP && (hash_types & udp_types))) &&
+        load_ports(skb, ETH_HLEN + sizeof(ip6), ports)) {
+        net_rx_rss_add_chunk(rss_input, &bytes_written,
+                             &ip6.saddr, sizeof(ip6.saddr));
+        net_rx_rss_add_chunk(rss_input, &bytes_written,
+                             &ip6.daddr, sizeof(ip6.daddr));
+        net_rx_rss_add_chunk(rss_input, &bytes_written,
+                             ports, sizeof(ports));
+    } else if (hash_types & ip_types) {
+        net_rx_rss_add_chunk(rss_input, &bytes_written,
+                             &ip6.saddr, sizeof(ip6.saddr));
+        net_rx_rss_add_chunk(rss_input, &bytes_written,
+                             &ip6.daddr, sizeof(ip6.daddr));
+    }
+
+    return bytes_written;
+}
+
+static inline bool calculate_rss_hash(struct __sk_buff *skb,
+                                      struct rss_config_t *config,
+                                      struct toeplitz_key_data_t *toe,
+                                      __u32 *result)
+{
+    __u8 rss_input[HASH_CALCULATION_BUFFER_SIZE] = {};
+    size_t bytes_written = 0;
+    struct ethhdr eth;
+
+    if (bpf_skb_load_bytes_relative(skb, 0, &eth, sizeof(eth),
+                                    BPF_HDR_START_MAC)) {
+        return false;
+    }
+
+    if (eth.h_proto == bpf_htons(ETH_P_IP)) {
+        bytes_written = parse_ipv4(skb, config->hash_types, rss_input);
+    } else if (eth.h_proto == bpf_htons(ETH_P_IPV6)) {
+        bytes_written = parse_ipv6(skb, config->hash_types, rss_input);
+    }
+
+    if (!bytes_written) {
+        return false;
+    }
+
+    *result = 0;
+    net_toeplitz_add(result, rss_input, bytes_written, toe);
+
+    return true;
+}
+
+SEC("tun_rss_steering")
+int tun_rss_steering_prog(struct __sk_buff *skb)
+{
+    struct rss_config_t *config;
+    struct toeplitz_key_data_t *toe;
+    __u32 key = 0;
+    __u32 hash = 0;
+
+    config = bpf_map_lookup_elem(&tap_rss_map_configurations, &key);
+    toe = bpf_map_lookup_elem(&tap_rss_map_toeplitz_key, &key);
+
+    if (config && toe) {
+        if (!config->redirect) {
+            return config->default_queue;
+        }
+
+        if (calculate_rss_hash(skb, config, toe, &hash)) {
+            __u32 table_idx = hash % config->indirections_len;
+            __u16 *queue;
+
+            queue = bpf_map_lookup_elem(&tap_rss_map_indirection_table,
+                                        &table_idx);
+
+            if (queue) {
+                return *queue;
+            }
+        }
+
+        return config->default_queue;
+    }
+
+    return -1;
+}
+
+char _license[] SEC("license") = "GPL v2";
@@ -30,12 +30,17 @@
 /** Records were dropped event ID */
 #define DROPPED_EVENT_ID (~(uint64_t)0 - 1)
 
-/** Trace record is valid */
-#define TRACE_RECORD_VALID ((uint64_t)1 << 63)
-
 /*
+ * Every thread that emits trace events gets its own ring buffer, so that
+ * recording an event does not write to any cache line shared with other
+ * threads.  The buffers are linked into a list when a thread records its
+ * first event; only the writeout thread removes them, once their thread
+ * has exited and their records have been written.
+ *
  * Trace records are written out by a dedicated thread.  The thread waits for
- * records to become available, writes them out, and then waits again.
+ * records to become available, or for TRACE_WRITEOUT_INTERVAL_US to pass,
+ * writes out the records of all threads in timestamp order, and then waits
+ * again.
  */
 static GMutex trace_lock;
 static GCond trace_available_cond;
@@ -45,14 +50,30 @@ static bool trace_available;
 static bool trace_writeout_enabled;
 
 enum {
-    TRACE_BUF_LEN = 4096 * 64,
+    TRACE_BUF_LEN = 4096 * 16,
     TRACE_BUF_FLUSH_THRESHOLD = TRACE_BUF_LEN / 4,
+    TRACE_WRITEOUT_INTERVAL_US = 100 * 1000,
 };
 
-uint8_t trace_buf[TRACE_BUF_LEN];
-static volatile gint trace_idx;
-static unsigned int writeout_idx;
-static volatile gint dropped_events;
+/* Indices are free running, use them modulo TRACE_BUF_LEN */
+typedef struct TraceThreadBuf {
+    struct TraceThreadBuf *next;
+    unsigned int head;          /* end of the complete records */
+    unsigned int reserved;      /* end of the records being written */
+    unsigned int tail;          /* start of the records not written out */
+    unsigned int batch_end;     /* head when the writeout batch started */
+    unsigned int nesting;       /* records being written, e.g. by signals */
+    int dropped;
+    bool exited;
+    uint8_t buf[TRACE_BUF_LEN];
+} TraceThreadBuf;
+
+static void trace_thread_exit(gpointer opaque);
+
+static TraceThreadBuf *trace_thread_bufs;
+static __thread TraceThreadBuf *trace_thread_buf;
+static GPrivate trace_thread_key = G_PRIVATE_INIT(trace_thread_exit);
+
 static uint32_t trace_pid;
 static FILE *trace_fp;
 static char *trace_file_name;
@@ -76,53 +97,78 @@ typedef struct {
 } TraceLogHeader;
 
 
-static void read_from_buffer(unsigned int idx, void *dataptr, size_t size);
-static unsigned int write_to_buffer(unsigned int idx, void *dataptr, size_t size);
+static void read_from_buffer(TraceThreadBuf *tb, unsigned int idx,
+                             void *dataptr, size_t size)
+{
+    unsigned int off = idx % TRACE_BUF_LEN;
+    size_t n = MIN(size, TRACE_BUF_LEN - off);
+
+    memcpy(dataptr, tb->buf + off, n);
+    memcpy((uint8_t *)dataptr + n, tb->buf, size - n);
+}
 
-static void clear_buffer_range(unsigned int idx, size_t len)
+static unsigned int write_to_buffer(TraceThreadBuf *tb, unsigned int idx,
+                                    const void *dataptr, size_t size)
 {
-    uint32_t num = 0;
-    while (num < len) {
-        if (idx >= TRACE_BUF_LEN) {
-            idx = idx % TRACE_BUF_LEN;
-        }
-        trace_buf[idx++] = 0;
-        num++;
+    unsigned int off = idx % TRACE_BUF_LEN;
+    size_t n = MIN(size, TRACE_BUF_LEN - off);
+
+    memcpy(tb->buf + off, dataptr, n);
+    memcpy(tb->buf, (const uint8_t *)dataptr + n, size - n);
+    return idx + size; /* most callers wants to know where to write next */
+}
+
+static void trace_thread_exit(gpointer opaque)
+{
+    TraceThreadBuf *tb = opaque;
+
+    trace_thread_buf = NULL;
+    qatomic_store_release(&tb->exited, true);
+}
+
+static TraceThreadBuf *get_trace_thread_buf(void)
+{
+    TraceThreadBuf *tb = trace_thread_buf;
+    TraceThreadBuf *first;
+
+    if (likely(tb)) {
+        return tb;
+    }
+
+    /* don't use g_malloc, can deadlock when traced */
+    tb = calloc(1, sizeof(*tb));
+    if (!tb) {
+        return NULL;
     }
+    g_private_set(&trace_thread_key, tb);
+    do {
+        first = qatomic_read(&trace_thread_bufs);
+        tb->next = first;
+    } while (qatomic_cmpxchg(&trace_thread_bufs, first, tb) != first);
+
+    trace_thread_buf = tb;
+    return tb;
 }
-/**
- * Read a trace record from the trace buffer
- *
- * @idx         Trace buffer index
- * @record      Trace record to fill
- *
- * Returns false if the record is not valid.
+
+/*
+ * Make the records of @tb visible to the writeout thread, unless the
+ * thread is still writing one that was interrupted by a signal handler.
  */
-static bool get_trace_record(unsigned int idx, TraceRecord **recordptr)
+static void trace_thread_buf_release(TraceThreadBuf *tb)
 {
-    uint64_t event_flag = 0;
-    TraceRecord record;
-    /* read the event flag to see if its a valid record */
-    read_from_buffer(idx, &record, sizeof(event_flag));
+    unsigned int head, reserved;
 
-    if (!(record.event & TRACE_RECORD_VALID)) {
-        return false;
+    if (qatomic_fetch_dec(&tb->nesting) != 1) {
+        return;
     }
 
-    smp_rmb(); /* read memory barrier before accessing record */
-    /* read the record header to know record length */
-    read_from_buffer(idx, &record, sizeof(TraceRecord));
-    *recordptr = malloc(record.length); /* don't use g_malloc, can deadlock when traced */
-    /* make a copy of record to avoid being overwritten */
-    read_from_buffer(idx, *recordptr, record.length);
-    smp_rmb(); /* memory barrier before clearing valid flag */
-    (*recordptr)->event &= ~TRACE_RECORD_VALID;
-    /* clear the trace buffer range for consumed record otherwise any byte
-     * with its MSB set may be considered as a valid event id when the writer
-     * thread crosses this range of buffer again.
-     */
-    clear_buffer_range(idx, record.length);
-    return true;
+    /* A signal handler may have published its own records meanwhile */
+    head = qatomic_read(&tb->head);
+    reserved = qatomic_read(&tb->reserved);
+    if (head != reserved) {
+        smp_wmb(); /* write barrier before publishing the records */
+        qatomic_cmpxchg(&tb->head, head, reserved);
+    }
 }
 
 /**
@@ -145,52 +191,130 @@ static void flush_trace_file(bool wait)
 
 static void wait_for_trace_records_available(void)
 {
+    gint64 end = g_get_monotonic_time() + TRACE_WRITEOUT_INTERVAL_US;
+
     g_mutex_lock(&trace_lock);
     while (!(trace_available && trace_writeout_enabled)) {
         g_cond_signal(&trace_empty_cond);
-        g_cond_wait(&trace_available_cond, &trace_lock);
+        if (!g_cond_wait_until(&trace_available_cond, &trace_lock, end)) {
+            if (trace_writeout_enabled) {
+                break;
+            }
+            end = g_get_monotonic_time() + TRACE_WRITEOUT_INTERVAL_US;
+        }
     }
     trace_available = false;
     g_mutex_unlock(&trace_lock);
 }
 
-static gpointer writeout_thread(gpointer opaque)
+static void write_dropped_record(uint64_t type)
 {
-    TraceRecord *recordptr;
     union {
         TraceRecord rec;
         uint8_t bytes[sizeof(TraceRecord) + sizeof(uint64_t)];
     } dropped;
-    unsigned int idx = 0;
-    int dropped_count;
+    TraceThreadBuf *tb;
+    uint64_t dropped_count = 0;
     size_t unused __attribute__ ((unused));
+
+    for (tb = qatomic_load_acquire(&trace_thread_bufs); tb; tb = tb->next) {
+        if (qatomic_read(&tb->dropped)) {
+            dropped_count += qatomic_xchg(&tb->dropped, 0);
+        }
+    }
+    if (!dropped_count) {
+        return;
+    }
+
+    dropped.rec.event = DROPPED_EVENT_ID;
+    dropped.rec.timestamp_ns = get_clock();
+    dropped.rec.length = sizeof(TraceRecord) + sizeof(uint64_t);
+    dropped.rec.pid = trace_pid;
+    dropped.rec.arguments[0] = dropped_count;
+    unused = fwrite(&type, sizeof(type), 1, trace_fp);
+    unused = fwrite(&dropped.rec, dropped.rec.length, 1, trace_fp);
+}
+
+/*
+ * Write out one record of @tb.  The record may wrap around the end of
+ * the buffer, so it is written in up to two pieces.
+ */
+static void write_record(TraceThreadBuf *tb, uint64_t type, uint32_t length)
+{
+    unsigned int off = tb->tail % TRACE_BUF_LEN;
+    size_t n = MIN(length, TRACE_BUF_LEN - off);
+    size_t unused __attribute__ ((unused));
+
+    unused = fwrite(&type, sizeof(type), 1, trace_fp);
+    unused = fwrite(tb->buf + off, n, 1, trace_fp);
+    if (length > n) {
+        unused = fwrite(tb->buf, length - n, 1, trace_fp);
+    }
+    qatomic_store_release(&tb->tail, tb->tail + length);
+}
+
+/*
+ * Merge the records that are available in the per-thread buffers by
+ * timestamp.  Records published after the merge started go out with the
+ * next batch.
+ */
+static void writeout_records(void)
+{
+    TraceThreadBuf *tb, *first, **prev;
     uint64_t type = TRACE_RECORD_TYPE_EVENT;
 
-    for (;;) {
-        wait_for_trace_records_available();
+    write_dropped_record(type);
 
-        if (g_atomic_int_get(&dropped_events)) {
-            dropped.rec.event = DROPPED_EVENT_ID;
-            dropped.rec.timestamp_ns = get_clock();
-            dropped.rec.length = sizeof(TraceRecord) + sizeof(uint64_t);
-            dropped.rec.pid = trace_pid;
-            do {
-                dropped_count = g_atomic_int_get(&dropped_events);
-            } while (!g_atomic_int_compare_and_exchange(&dropped_events,
-                                                        dropped_count, 0));
-            dropped.rec.arguments[0] = dropped_count;
-            unused = fwrite(&type, sizeof(type), 1, trace_fp);
-            unused = fwrite(&dropped.rec, dropped.rec.length, 1, trace_fp);
+    for (tb = qatomic_load_acquire(&trace_thread_bufs); tb; tb = tb->next) {
+        tb->batch_end = qatomic_load_acquire(&tb->head);
+    }
+
+    for (;;) {
+        TraceThreadBuf *next = NULL;
+        TraceRecord record, next_record;
+
+        for (tb = qatomic_load_acquire(&trace_thread_bufs); tb;
+             tb = tb->next) {
+            if (tb->tail == tb->batch_end) {
+                continue;
+            }
+            read_from_buffer(tb, tb->tail, &record, sizeof(record));
+            if (!next || record.timestamp_ns < next_record.timestamp_ns) {
+                next = tb;
+                next_record = record;
+            }
         }
+        if (!next) {
+            break;
+        }
+        write_record(next, type, next_record.length);
+    }
 
-        while (get_trace_record(idx, &recordptr)) {
-            unused = fwrite(&type, sizeof(type), 1, trace_fp);
-            unused = fwrite(recordptr, recordptr->length, 1, trace_fp);
-            writeout_idx += recordptr->length;
-            free(recordptr); /* don't use g_free, can deadlock when traced */
-            idx = writeout_idx % TRACE_BUF_LEN;
+    /*
+     * Free the buffers of threads that have exited.  New buffers are only
+     * ever added in front of the first one, so that one stays.
+     */
+    first = qatomic_load_acquire(&trace_thread_bufs);
+    if (!first) {
+        return;
+    }
+    prev = &first->next;
+    while ((tb = *prev) != NULL) {
+        if (qatomic_load_acquire(&tb->exited) &&
+            tb->tail == qatomic_load_acquire(&tb->head)) {
+            *prev = tb->next;
+            free(tb); /* don't use g_free, can deadlock when traced */
+        } else {
+            prev = &tb->next;
         }
+    }
+}
 
+static gpointer writeout_thread(gpointer opaque)
+{
+    for (;;) {
+        wait_for_trace_records_available();
+        writeout_records();
         fflush(trace_fp);
     }
     return NULL;
@@ -198,84 +322,70 @@ static gpointer writeout_thread(gpointer opaque)
 
 void trace_record_write_u64(TraceBufferRecord *rec, uint64_t val)
 {
-    rec->rec_off = write_to_buffer(rec->rec_off, &val, sizeof(uint64_t));
+    rec->rec_off = write_to_buffer(rec->tbuf, rec->rec_off,
+                                   &val, sizeof(uint64_t));
 }
 
 void trace_record_write_str(TraceBufferRecord *rec, const char *s, uint32_t slen)
 {
     /* Write string length first */
-    rec->rec_off = write_to_buffer(rec->rec_off, &slen, sizeof(slen));
+    rec->rec_off = write_to_buffer(rec->tbuf, rec->rec_off,
+                                   &slen, sizeof(slen));
     /* Write actual string now */
-    rec->rec_off = write_to_buffer(rec->rec_off, (void*)s, slen);
+    rec->rec_off = write_to_buffer(rec->tbuf, rec->rec_off, s, slen);
 }
 
 int trace_record_start(TraceBufferRecord *rec, uint32_t event, size_t datasize)
 {
-    unsigned int idx, rec_off, old_idx, new_idx;
+    TraceThreadBuf *tb = get_trace_thread_buf();
+    unsigned int idx, rec_off;
     uint32_t rec_len = sizeof(TraceRecord) + datasize;
     uint64_t event_u64 = event;
     uint64_t timestamp_ns = get_clock();
 
+    if (!tb) {
+        return -ENOMEM;
+    }
+
+    /*
+     * Only this thread adds records to the buffer; the atomics are here
+     * for signal handlers that trace while a record is being written.
+     */
+    qatomic_inc(&tb->nesting);
     do {
-        old_idx = g_atomic_int_get(&trace_idx);
-        smp_rmb();
-        new_idx = old_idx + rec_len;
+        idx = qatomic_read(&tb->reserved);
 
-        if (new_idx - writeout_idx > TRACE_BUF_LEN) {
+        if (idx + rec_len - qatomic_load_acquire(&tb->tail) > TRACE_BUF_LEN) {
             /* Trace Buffer Full, Event dropped ! */
-            g_atomic_int_inc(&dropped_events);
+            qatomic_inc(&tb->dropped);
+            trace_thread_buf_release(tb);
             return -ENOSPC;
         }
-    } while (!g_atomic_int_compare_and_exchange(&trace_idx, old_idx, new_idx));
-
-    idx = old_idx % TRACE_BUF_LEN;
+    } while (qatomic_cmpxchg(&tb->reserved, idx, idx + rec_len) != idx);
 
     rec_off = idx;
-    rec_off = write_to_buffer(rec_off, &event_u64, sizeof(event_u64));
-    rec_off = write_to_buffer(rec_off, &timestamp_ns, sizeof(timestamp_ns));
-    rec_off = write_to_buffer(rec_off, &rec_len, sizeof(rec_len));
-    rec_off = write_to_buffer(rec_off, &trace_pid, sizeof(trace_pid));
+    rec_off = write_to_buffer(tb, rec_off, &event_u64, sizeof(event_u64));
+    rec_off = write_to_buffer(tb, rec_off, &timestamp_ns, sizeof(timestamp_ns));
+    rec_off = write_to_buffer(tb, rec_off, &rec_len, sizeof(rec_len));
+    rec_off = write_to_buffer(tb, rec_off, &trace_pid, sizeof(trace_pid));
 
+    rec->tbuf = tb;
     rec->tbuf_idx = idx;
-    rec->rec_off  = (idx + sizeof(TraceRecord)) % TRACE_BUF_LEN;
+    rec->rec_off  = rec_off;
     return 0;
 }
 
-static void read_from_buffer(unsigned int idx, void *dataptr, size_t size)
+void trace_record_finish(TraceBufferRecord *rec)
 {
-    uint8_t *data_ptr = dataptr;
-    uint32_t x = 0;
-    while (x < size) {
-        if (idx >= TRACE_BUF_LEN) {
-            idx = idx % TRACE_BUF_LEN;
-        }
-        data_ptr[x++] = trace_buf[idx++];
-    }
-}
+    TraceThreadBuf *tb = rec->tbuf;
+    unsigned int tail;
 
-static unsigned int write_to_buffer(unsigned int idx, void *dataptr, size_t size)
-{
-    uint8_t *data_ptr = dataptr;
-    uint32_t x = 0;
-    while (x < size) {
-        if (idx >= TRACE_BUF_LEN) {
-            idx = idx % TRACE_BUF_LEN;
-        }
-        trace_buf[idx++] = data_ptr[x++];
-    }
-    return idx; /* most callers wants to know where to write next */
-}
+    trace_thread_buf_release(tb);
 
-void trace_record_finish(TraceBufferRecord *rec)
-{
-    TraceRecord record;
-    read_from_buffer(rec->tbuf_idx, &record, sizeof(TraceRecord));
-    smp_wmb(); /* write barrier before marking as valid */
-    record.event |= TRACE_RECORD_VALID;
-    write_to_buffer(rec->tbuf_idx, &record, sizeof(TraceRecord));
-
-    if (((unsigned int)g_atomic_int_get(&trace_idx) - writeout_idx)
-        > TRACE_BUF_FLUSH_THRESHOLD) {
+    /* Kick the writeout thread once, when the buffer passes the threshold */
+    tail = qatomic_read(&tb->tail);
+    if (rec->tbuf_idx - tail <= TRACE_BUF_FLUSH_THRESHOLD &&
+        rec->rec_off - tail > TRACE_BUF_FLUSH_THRESHOLD) {
         flush_trace_file(false);
     }
 }
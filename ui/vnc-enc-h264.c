@@ -0,0 +1,254 @@
+/*
+ * QEMU VNC display driver: Open H.264 encoding
+ *
+ * The frames are encoded by a GStreamer pipeline, which picks a VA-API
+ * hardware encoder when one is installed and falls back to software.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/error-report.h"
+#include "vnc.h"
+
+#include <gst/gst.h>
+#include <gst/app/gstappsrc.h>
+#include <gst/app/gstappsink.h>
+
+/* Open H.264 rectangle flags */
+#define VNC_H264_RESET_CONTEXT      1
+
+/* How long to wait for the first access unit of a frame, in ns */
+#define VNC_H264_PULL_TIMEOUT       (100 * GST_MSECOND)
+
+struct VncH264 {
+    GstElement *pipeline;
+    GstAppSrc *source;
+    GstAppSink *sink;
+    int width;
+    int height;
+    int64_t start_us;
+    bool reset;
+};
+
+/* Encoders in order of preference and the options that make them fast */
+static const struct {
+    const char *name;
+    const char *options;
+} vnc_h264_encoders[] = {
+    { "vah264lpenc", "b-frames=0" },
+    { "vah264enc", "b-frames=0" },
+    { "vaapih264enc", "max-bframes=0" },
+    { "x264enc", "tune=zerolatency speed-preset=ultrafast" },
+    { "openh264enc", "" },
+};
+
+static gpointer vnc_h264_find_encoder(gpointer data)
+{
+    g_autoptr(GError) err = NULL;
+    int i;
+
+    if (!gst_init_check(NULL, NULL, &err)) {
+        warn_report("vnc: cannot initialize GStreamer: %s", err->message);
+        return GINT_TO_POINTER(-1);
+    }
+    for (i = 0; i < ARRAY_SIZE(vnc_h264_encoders); i++) {
+        GstElementFactory *f =
+            gst_element_factory_find(vnc_h264_encoders[i].name);
+
+        if (f) {
+            gst_object_unref(f);
+            return GINT_TO_POINTER(i);
+        }
+    }
+    return GINT_TO_POINTER(-1);
+}
+
+static int vnc_h264_encoder(void)
+{
+    static GOnce once = G_ONCE_INIT;
+
+    return GPOINTER_TO_INT(g_once(&once, vnc_h264_find_encoder, NULL));
+}
+
+bool vnc_h264_available(void)
+{
+    return vnc_h264_encoder() >= 0;
+}
+
+static void vnc_h264_stop(VncH264 *h264)
+{
+    if (h264->pipeline) {
+        gst_element_set_state(h264->pipeline, GST_STATE_NULL);
+    }
+    g_clear_pointer(&h264->source, gst_object_unref);
+    g_clear_pointer(&h264->sink, gst_object_unref);
+    g_clear_pointer(&h264->pipeline, gst_object_unref);
+}
+
+/*
+ * The server surface is x8r8g8b8; 4:2:0 encoders need even dimensions,
+ * so the frame is padded and the rectangle keeps the real size.
+ *
+ * If the pipeline cannot be started, the returned state has no pipeline
+ * and the frames of this size are sent raw.
+ */
+static VncH264 *vnc_h264_new(int width, int height)
+{
+    int enc = vnc_h264_encoder();
+    g_autoptr(GError) err = NULL;
+    g_autofree char *desc = NULL;
+    GstCaps *caps;
+    VncH264 *h264;
+
+    desc = g_strdup_printf("appsrc name=src is-live=true format=time "
+                           "! videoconvert ! %s %s "
+                           "! video/x-h264,profile=constrained-baseline,"
+                           "stream-format=byte-stream,alignment=au "
+                           "! appsink name=sink sync=false",
+                           vnc_h264_encoders[enc].name,
+                           vnc_h264_encoders[enc].options);
+
+    h264 = g_new0(VncH264, 1);
+    h264->width = width;
+    h264->height = height;
+    h264->pipeline = gst_parse_launch(desc, &err);
+    if (!h264->pipeline) {
+        error_report("vnc: cannot create H.264 pipeline: %s", err->message);
+        goto fail;
+    }
+    h264->source = GST_APP_SRC(gst_bin_get_by_name(GST_BIN(h264->pipeline),
+                                                   "src"));
+    h264->sink = GST_APP_SINK(gst_bin_get_by_name(GST_BIN(h264->pipeline),
+                                                  "sink"));
+
+    caps = gst_caps_new_simple("video/x-raw",
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+                               "format", G_TYPE_STRING, "BGRx",
+#else
+                               "format", G_TYPE_STRING, "xRGB",
+#endif
+                               "width", G_TYPE_INT, ROUND_UP(width, 2),
+                               "height", G_TYPE_INT, ROUND_UP(height, 2),
+                               "framerate", GST_TYPE_FRACTION, 0, 1,
+                               NULL);
+    gst_app_src_set_caps(h264->source, caps);
+    gst_caps_unref(caps);
+
+    if (gst_element_set_state(h264->pipeline, GST_STATE_PLAYING) ==
+        GST_STATE_CHANGE_FAILURE) {
+        error_report("vnc: cannot start H.264 encoder %s",
+                     vnc_h264_encoders[enc].name);
+        goto fail;
+    }
+
+    h264->start_us = g_get_monotonic_time();
+    h264->reset = true;
+    return h264;
+
+fail:
+    vnc_h264_stop(h264);
+    return h264;
+}
+
+static GstBuffer *vnc_h264_get_frame(VncState *vs, int x, int y,
+                                     int w, int h, int64_t pts)
+{
+    pixman_image_t *server = vs->vd->server;
+    int stride = pixman_image_get_stride(server);
+    uint8_t *src = (uint8_t *)pixman_image_get_data(server) +
+                   y * stride + x * VNC_SERVER_FB_BYTES;
+    int line = ROUND_UP(w, 2) * VNC_SERVER_FB_BYTES;
+    GstBuffer *buf;
+    GstMapInfo map;
+    int i;
+
+    buf = gst_buffer_new_allocate(NULL, line * ROUND_UP(h, 2), NULL);
+    gst_buffer_map(buf, &map, GST_MAP_WRITE);
+    for (i = 0; i < h; i++) {
+        memcpy(map.data + i * line, src + i * stride,
+               w * VNC_SERVER_FB_BYTES);
+        memset(map.data + i * line + w * VNC_SERVER_FB_BYTES, 0,
+               line - w * VNC_SERVER_FB_BYTES);
+    }
+    memset(map.data + h * line, 0, (ROUND_UP(h, 2) - h) * line);
+    gst_buffer_unmap(buf, &map);
+
+    GST_BUFFER_PTS(buf) = pts;
+    return buf;
+}
+
+/* Append the data of one access unit to @out */
+static void vnc_h264_append_sample(GstSample *sample, Buffer *out)
+{
+    GstBuffer *buf = gst_sample_get_buffer(sample);
+    GstMapInfo map;
+
+    if (buf && gst_buffer_map(buf, &map, GST_MAP_READ)) {
+        buffer_reserve(out, map.size);
+        buffer_append(out, map.data, map.size);
+        gst_buffer_unmap(buf, &map);
+    }
+    gst_sample_unref(sample);
+}
+
+int vnc_h264_send_framebuffer_update(VncState *vs, int x, int y, int w, int h)
+{
+    VncH264 *h264 = vs->h264;
+    GstSample *sample;
+    GstBuffer *buf;
+    Buffer out = {};
+    int64_t pts;
+
+    if (h264 && (h264->width != w || h264->height != h)) {
+        vnc_h264_clear(vs);
+        h264 = NULL;
+    }
+    if (!h264) {
+        h264 = vs->h264 = vnc_h264_new(w, h);
+    }
+    if (!h264->pipeline) {
+        vnc_framebuffer_update(vs, x, y, w, h, VNC_ENCODING_RAW);
+        return vnc_raw_send_framebuffer_update(vs, x, y, w, h);
+    }
+
+    pts = (g_get_monotonic_time() - h264->start_us) * GST_USECOND;
+    buf = vnc_h264_get_frame(vs, x, y, w, h, pts);
+    if (gst_app_src_push_buffer(h264->source, buf) != GST_FLOW_OK) {
+        return 0;
+    }
+
+    /*
+     * Low latency encoders return the frame right away; anything that
+     * comes later is sent together with the next frame.
+     */
+    buffer_init(&out, "vnc-h264/%p", vs);
+    sample = gst_app_sink_try_pull_sample(h264->sink, VNC_H264_PULL_TIMEOUT);
+    while (sample) {
+        vnc_h264_append_sample(sample, &out);
+        sample = gst_app_sink_try_pull_sample(h264->sink, 0);
+    }
+
+    if (!out.offset) {
+        buffer_free(&out);
+        return 0;
+    }
+
+    vnc_framebuffer_update(vs, x, y, w, h, VNC_ENCODING_H264);
+    vnc_write_u32(vs, out.offset);
+    vnc_write_u32(vs, h264->reset ? VNC_H264_RESET_CONTEXT : 0);
+    vnc_write(vs, out.buffer, out.offset);
+    h264->reset = false;
+    buffer_free(&out);
+    return 1;
+}
+
+void vnc_h264_clear(VncState *vs)
+{
+    if (vs->h264) {
+        vnc_h264_stop(vs->h264);
+        g_free(vs->h264);
+        vs->h264 = NULL;
+    }
+}
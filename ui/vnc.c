@@ -980,6 +980,11 @@ int vnc_send_framebuffer_update(VncState *vs, int x, int y, int w, int h)
         case VNC_ENCODING_ZYWRLE:
             n = vnc_zywrle_send_framebuffer_update(vs, x, y, w, h);
             break;
+#ifdef CONFIG_VNC_H264
+        case VNC_ENCODING_H264:
+            n = vnc_h264_send_framebuffer_update(vs, x, y, w, h);
+            break;
+#endif
         default:
             vnc_framebuffer_update(vs, x, y, w, h, VNC_ENCODING_RAW);
             n = vnc_raw_send_framebuffer_update(vs, x, y, w, h);
@@ -1186,6 +1191,15 @@ static int vnc_update_client(VncState *vs, int has_dirty)
     height = pixman_image_get_height(vd->server);
     width = pixman_image_get_width(vd->server);
 
+#ifdef CONFIG_VNC_H264
+    if (vs->vnc_encoding == VNC_ENCODING_H264) {
+        /* Each H.264 frame covers the whole screen */
+        memset(vs->dirty, 0, sizeof(vs->dirty));
+        n = vnc_job_add_rect(job, 0, 0, width, height);
+        goto out;
+    }
+#endif
+
     y = 0;
     for (;;) {
         int x, h;
@@ -1216,6 +1230,9 @@ static int vnc_update_client(VncState *vs, int has_dirty)
         }
     }
 
+#ifdef CONFIG_VNC_H264
+out:
+#endif
     vs->job_update = vs->update;
     vs->update = VNC_STATE_UPDATE_NONE;
     vnc_job_push(job);
@@ -1337,6 +1354,9 @@ void vnc_disconnect_finish(VncState *vs)
     vnc_zlib_clear(vs);
     vnc_tight_clear(vs);
     vnc_zrle_clear(vs);
+#ifdef CONFIG_VNC_H264
+    vnc_h264_clear(vs);
+#endif
 
 #ifdef CONFIG_VNC_SASL
     vnc_sasl_client_cleanup(vs);
@@ -2189,6 +2209,14 @@ static void set_encodings(VncState *vs, int32_t *encodings, size_t n_encodings)
             vs->features |= VNC_FEATURE_ZYWRLE_MASK;
             vs->vnc_encoding = enc;
             break;
+#ifdef CONFIG_VNC_H264
+        case VNC_ENCODING_H264:
+            if (vnc_h264_available()) {
+                vs->features |= VNC_FEATURE_H264_MASK;
+                vs->vnc_encoding = enc;
+            }
+            break;
+#endif
         case VNC_ENCODING_DESKTOPRESIZE:
             vs->features |= VNC_FEATURE_RESIZE_MASK;
             break;
@@ -3069,8 +3097,9 @@ static int vnc_refresh_server_surface(VncDisplay *vd)
                     pixman_image_get_width(vd->server));
     int height = MIN(pixman_image_get_height(vd->guest.fb),
                      pixman_image_get_height(vd->server));
+    int row_bits = DIV_ROUND_UP(width, VNC_DIRTY_PIXELS_PER_BIT);
     int cmp_bytes, server_stride, line_bytes, guest_ll, guest_stride, y = 0;
-    uint8_t *guest_row0 = NULL, *server_row0;
+    uint8_t *guest_row0 = NULL, *guest_row, *server_row0;
     VncState *vs;
     int has_dirty = 0;
     pixman_image_t *tmpbuf = NULL;
@@ -3106,8 +3135,9 @@ static int vnc_refresh_server_surface(VncDisplay *vd)
     line_bytes = MIN(server_stride, guest_ll);
 
     for (;;) {
-        int x;
+        int x, first_x, last_x;
         uint8_t *guest_ptr, *server_ptr;
+        unsigned long *row;
         unsigned long offset = find_next_bit((unsigned long *) &vd->guest.dirty,
                                              height * VNC_DIRTY_BPL(&vd->guest),
                                              y * VNC_DIRTY_BPL(&vd->guest));
@@ -3117,23 +3147,35 @@ static int vnc_refresh_server_surface(VncDisplay *vd)
         }
         y = offset / VNC_DIRTY_BPL(&vd->guest);
         x = offset % VNC_DIRTY_BPL(&vd->guest);
+        if (x >= row_bits) {
+            y++;
+            continue;
+        }
 
-        server_ptr = server_row0 + y * server_stride + x * cmp_bytes;
+        /*
+         * Only visit the dirty chunks of the row, and only convert the
+         * span between the first and the last of them.
+         */
+        row = vd->guest.dirty[y];
+        first_x = x;
+        last_x = find_last_bit(row, row_bits);
 
         if (vd->guest.format != VNC_SERVER_FB_FORMAT) {
-            qemu_pixman_linebuf_fill(tmpbuf, vd->guest.fb, width, 0, y);
-            guest_ptr = (uint8_t *)pixman_image_get_data(tmpbuf);
+            int px = first_x * VNC_DIRTY_PIXELS_PER_BIT;
+            int pw = MIN((last_x + 1) * VNC_DIRTY_PIXELS_PER_BIT, width) - px;
+
+            qemu_pixman_linebuf_fill(tmpbuf, vd->guest.fb, pw, px, y);
+            guest_row = (uint8_t *)pixman_image_get_data(tmpbuf);
         } else {
-            guest_ptr = guest_row0 + y * guest_stride;
+            guest_row = guest_row0 + y * guest_stride + first_x * cmp_bytes;
         }
-        guest_ptr += x * cmp_bytes;
 
-        for (; x < DIV_ROUND_UP(width, VNC_DIRTY_PIXELS_PER_BIT);
-             x++, guest_ptr += cmp_bytes, server_ptr += cmp_bytes) {
+        for (; x <= last_x; x = find_next_bit(row, last_x + 1, x + 1)) {
             int _cmp_bytes = cmp_bytes;
-            if (!test_and_clear_bit(x, vd->guest.dirty[y])) {
-                continue;
-            }
+
+            clear_bit(x, row);
+            server_ptr = server_row0 + y * server_stride + x * cmp_bytes;
+            guest_ptr = guest_row + (x - first_x) * cmp_bytes;
             if ((x + 1) * cmp_bytes > line_bytes) {
                 _cmp_bytes = line_bytes - x * cmp_bytes;
             }
@@ -329,6 +329,58 @@ static bool select_accel_fn(const void *buf, size_t len)
     return buffer_zero_int(buf, len);
 }
 
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+
+/* Note that this requires len >= 64.  Advanced SIMD is always present.  */
+
+static bool
+buffer_zero_neon(const void *buf, size_t len)
+{
+    uint64x2_t t = vreinterpretq_u64_u8(vld1q_u8(buf));
+    const uint64x2_t *p = (uint64x2_t *)(((uintptr_t)buf + 5 * 16) & -16);
+    const uint64x2_t *e = (uint64x2_t *)(((uintptr_t)buf + len) & -16);
+
+    /* Loop over 16-byte aligned blocks of 64.  */
+    while (likely(p <= e)) {
+        __builtin_prefetch(p);
+        if (unlikely(vmaxvq_u32(vreinterpretq_u32_u64(t)))) {
+            return false;
+        }
+        t = vorrq_u64(vorrq_u64(p[-4], p[-3]), vorrq_u64(p[-2], p[-1]));
+        p += 4;
+    }
+
+    /* Finish the aligned tail.  */
+    t = vorrq_u64(t, e[-3]);
+    t = vorrq_u64(t, e[-2]);
+    t = vorrq_u64(t, e[-1]);
+
+    /* Finish the unaligned tail.  */
+    t = vorrq_u64(t, vreinterpretq_u64_u8(vld1q_u8(buf + len - 16)));
+
+    return !vmaxvq_u32(vreinterpretq_u32_u64(t));
+}
+
+static bool use_neon = true;
+
+static bool select_accel_fn(const void *buf, size_t len)
+{
+    if (likely(len >= 64) && use_neon) {
+        return buffer_zero_neon(buf, len);
+    }
+    return buffer_zero_int(buf, len);
+}
+
+bool test_buffer_is_zero_next_accel(void)
+{
+    if (use_neon) {
+        use_neon = false;
+        return true;
+    }
+    return false;
+}
+
 #else
 #define select_accel_fn  buffer_zero_int
 bool test_buffer_is_zero_next_accel(void)
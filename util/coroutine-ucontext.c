@@ -41,10 +41,27 @@
 #include <sanitizer/tsan_interface.h>
 #endif
 
+/*
+ * sigsetjmp()/siglongjmp() save and restore more than a switch between
+ * coroutines needs, and go through the fortified longjmp.  On x86-64 ELF
+ * hosts, switch stacks with a few instructions instead.  This does not
+ * know about CET shadow stacks, nor tell the sanitizers or SafeStack about
+ * the switch, so keep the generic code for those builds.
+ */
+#if defined(__x86_64__) && defined(__ELF__) && !defined(__CET__) && \
+    !defined(CONFIG_ASAN) && !defined(CONFIG_TSAN) && \
+    !defined(CONFIG_SAFESTACK)
+#define COROUTINE_FAST_SWITCH 1
+#endif
+
 typedef struct {
     Coroutine base;
     void *stack;
     size_t stack_size;
+#ifdef COROUTINE_FAST_SWITCH
+    /* Saved by qemu_co_switch_stack() while not running */
+    void *sp;
+#endif
 #ifdef CONFIG_SAFESTACK
     /* Need an unsafe stack for each coroutine */
     void *unsafe_stack;
@@ -145,6 +162,92 @@ void start_switch_fiber_tsan(void **fake_stack_save,
 #endif
 }
 
+#ifdef COROUTINE_FAST_SWITCH
+/*
+ * void *qemu_co_switch_stack(void **from_sp, void *to_sp, void *ret);
+ *
+ * Push the callee-saved registers, store the stack pointer to *from_sp,
+ * and pop the registers saved at to_sp.  The qemu_co_switch_stack() call
+ * that saved to_sp then returns ret.  Being a real call, the compiler
+ * already spills all the caller-saved registers around it.
+ *
+ * A new coroutine's stack is prepared to "return" into
+ * qemu_co_trampoline_stack(), with the coroutine in %rbx.
+ */
+void *qemu_co_switch_stack(void **from_sp, void *to_sp, void *ret);
+void qemu_co_trampoline_stack(void);
+void qemu_coroutine_fast_trampoline(CoroutineUContext *self);
+
+asm(".text\n"
+    ".p2align 4\n"
+    ".globl qemu_co_switch_stack\n"
+    ".type qemu_co_switch_stack, @function\n"
+    "qemu_co_switch_stack:\n"
+    "    push %rbp\n"
+    "    push %rbx\n"
+    "    push %r12\n"
+    "    push %r13\n"
+    "    push %r14\n"
+    "    push %r15\n"
+    "    mov %rsp, (%rdi)\n"
+    "    mov %rsi, %rsp\n"
+    "    pop %r15\n"
+    "    pop %r14\n"
+    "    pop %r13\n"
+    "    pop %r12\n"
+    "    pop %rbx\n"
+    "    pop %rbp\n"
+    "    mov %rdx, %rax\n"
+    "    ret\n"
+    ".size qemu_co_switch_stack, .-qemu_co_switch_stack\n"
+    ".globl qemu_co_trampoline_stack\n"
+    ".type qemu_co_trampoline_stack, @function\n"
+    "qemu_co_trampoline_stack:\n"
+    "    mov %rbx, %rdi\n"
+    "    and $-16, %rsp\n"
+    "    call qemu_coroutine_fast_trampoline@PLT\n"
+    "    ud2\n"
+    ".size qemu_co_trampoline_stack, .-qemu_co_trampoline_stack\n");
+
+void qemu_coroutine_fast_trampoline(CoroutineUContext *self)
+{
+    Coroutine *co = &self->base;
+
+    while (true) {
+        co->entry(co->entry_arg);
+        qemu_coroutine_switch(co, co->caller, COROUTINE_TERMINATE);
+    }
+}
+
+Coroutine *qemu_coroutine_new(void)
+{
+    CoroutineUContext *co;
+    void **sp;
+
+    co = g_malloc0(sizeof(*co));
+    co->stack_size = COROUTINE_STACK_SIZE;
+    co->stack = qemu_alloc_stack(&co->stack_size);
+
+#ifdef CONFIG_VALGRIND_H
+    co->valgrind_stack_id =
+        VALGRIND_STACK_REGISTER(co->stack, co->stack + co->stack_size);
+#endif
+
+    /* The frame popped by the first switch to the coroutine */
+    sp = co->stack + co->stack_size;
+    *--sp = NULL;                       /* keeps the trampoline ABI-aligned */
+    *--sp = (void *)qemu_co_trampoline_stack; /* return address */
+    *--sp = NULL;                       /* %rbp */
+    *--sp = co;                         /* %rbx */
+    *--sp = NULL;                       /* %r12 */
+    *--sp = NULL;                       /* %r13 */
+    *--sp = NULL;                       /* %r14 */
+    *--sp = NULL;                       /* %r15 */
+    co->sp = sp;
+
+    return &co->base;
+}
+#else
 static void coroutine_trampoline(int i0, int i1)
 {
     union cc_arg arg;
@@ -249,6 +352,7 @@ Coroutine *qemu_coroutine_new(void)
 
     return &co->base;
 }
+#endif
 
 #ifdef CONFIG_VALGRIND_H
 /* Work around an unused variable in the valgrind.h macro... */
@@ -288,6 +392,20 @@ void qemu_coroutine_delete(Coroutine *co_)
  * return in thread B, and so we might be in a different thread
  * context each time round the loop.
  */
+#ifdef COROUTINE_FAST_SWITCH
+CoroutineAction __attribute__((noinline))
+qemu_coroutine_switch(Coroutine *from_, Coroutine *to_,
+                      CoroutineAction action)
+{
+    CoroutineUContext *from = DO_UPCAST(CoroutineUContext, base, from_);
+    CoroutineUContext *to = DO_UPCAST(CoroutineUContext, base, to_);
+
+    current = to_;
+
+    return (uintptr_t)qemu_co_switch_stack(&from->sp, to->sp,
+                                           (void *)(uintptr_t)action);
+}
+#else
 CoroutineAction __attribute__((noinline))
 qemu_coroutine_switch(Coroutine *from_, Coroutine *to_,
                       CoroutineAction action)
@@ -312,6 +430,7 @@ qemu_coroutine_switch(Coroutine *from_, Coroutine *to_,
 
     return ret;
 }
+#endif
 
 Coroutine *qemu_coroutine_self(void)
 {
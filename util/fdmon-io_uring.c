@@ -25,7 +25,11 @@
  *
  * File descriptor monitoring is implemented using the following operations:
  *
- * 1. IORING_OP_POLL_ADD - adds a file descriptor to be monitored.
+ * 1. IORING_OP_POLL_ADD - adds a file descriptor to be monitored.  When the
+ *    kernel supports IORING_POLL_ADD_MULTI the request stays armed and
+ *    produces a cqe with IORING_CQE_F_MORE set for every event, so it does
+ *    not have to be resubmitted after each event.  Otherwise it is one-shot
+ *    and re-armed by process_cqe().
  * 2. IORING_OP_POLL_REMOVE - removes a file descriptor being monitored.  When
  *    the poll mask changes for a file descriptor it is first removed and then
  *    re-added with the new poll mask, so this operation is also used as part
@@ -172,9 +176,24 @@ static void add_poll_add_sqe(AioContext *ctx, AioHandler *node)
     int events = poll_events_from_pfd(node->pfd.events);
 
     io_uring_prep_poll_add(sqe, node->pfd.fd, events);
+#ifdef IORING_POLL_ADD_MULTI
+    if (ctx->fdmon_io_uring_multishot) {
+        sqe->len |= IORING_POLL_ADD_MULTI;
+    }
+#endif
     io_uring_sqe_set_data(sqe, node);
 }
 
+/* Is the IORING_OP_POLL_ADD that produced @cqe still armed? */
+static bool cqe_poll_armed(struct io_uring_cqe *cqe)
+{
+#ifdef IORING_CQE_F_MORE
+    return cqe->flags & IORING_CQE_F_MORE;
+#else
+    return false;
+#endif
+}
+
 static void add_poll_remove_sqe(AioContext *ctx, AioHandler *node)
 {
     struct io_uring_sqe *sqe = get_sqe(ctx);
@@ -228,6 +247,21 @@ static bool process_cqe(AioContext *ctx,
         return false;
     }
 
+    if (cqe_poll_armed(cqe)) {
+        /*
+         * A multishot IORING_OP_POLL_ADD keeps referencing the handler, so
+         * a deleted handler must wait for the final cqe that comes after
+         * IORING_OP_POLL_REMOVE.
+         */
+        if (qatomic_read(&node->flags) & FDMON_IO_URING_REMOVE) {
+            return false;
+        }
+
+        aio_add_ready_handler(ready_list, node,
+                              pfd_events_from_poll(cqe->res));
+        return true;
+    }
+
     /*
      * Deletion can only happen when IORING_OP_POLL_ADD completes.  If we race
      * with enqueue() here then we can safely clear the FDMON_IO_URING_REMOVE
@@ -239,11 +273,23 @@ static bool process_cqe(AioContext *ctx,
         return false;
     }
 
-    aio_add_ready_handler(ready_list, node, pfd_events_from_poll(cqe->res));
+    /* Kernels without multishot poll reject IORING_POLL_ADD_MULTI */
+    if (cqe->res == -EINVAL && ctx->fdmon_io_uring_multishot) {
+        ctx->fdmon_io_uring_multishot = false;
+        add_poll_add_sqe(ctx, node);
+        return false;
+    }
 
-    /* IORING_OP_POLL_ADD is one-shot so we must re-arm it */
+    /*
+     * One-shot IORING_OP_POLL_ADD, or a multishot one that the kernel
+     * terminated (e.g. on cq ring overflow), so we must re-arm it
+     */
+    if (cqe->res > 0) {
+        aio_add_ready_handler(ready_list, node,
+                              pfd_events_from_poll(cqe->res));
+    }
     add_poll_add_sqe(ctx, node);
-    return true;
+    return cqe->res > 0;
 }
 
 static int process_cq_ring(AioContext *ctx, AioHandlerList *ready_list)
@@ -331,6 +377,9 @@ bool fdmon_io_uring_setup(AioContext *ctx)
     }
 
     QSLIST_INIT(&ctx->submit_list);
+#ifdef IORING_POLL_ADD_MULTI
+    ctx->fdmon_io_uring_multishot = true;
+#endif
     ctx->fdmon_ops = &fdmon_io_uring_ops;
     return true;
 }
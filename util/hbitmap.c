@@ -87,6 +87,9 @@ struct HBitmap {
     /* A meta dirty bitmap to track the dirtiness of bits in this HBitmap. */
     HBitmap *meta;
 
+    /* Incremented by every operation that may modify the bitmap.  */
+    uint64_t generation;
+
     /* A number of progressively less coarse bitmaps (i.e. level 0 is the
      * coarsest).  Each bit in level N represents a word in level N+1 that
      * has a set bit, except the last level where each bit represents the
@@ -217,6 +220,24 @@ int64_t hbitmap_next_dirty(const HBitmap *hb, int64_t start, int64_t count)
     return MAX(start, first_dirty_off);
 }
 
+/* Number of words that hbitmap_next_zero() checks at a time */
+#define HBITMAP_SCAN_WORDS 8
+
+/*
+ * Check a whole cache line of the last level at a time.  There are no
+ * branches in the loop, so the compiler is free to vectorize it.
+ */
+static inline bool hb_words_all_ones(const unsigned long *words)
+{
+    unsigned long acc = (unsigned long)-1;
+    int i;
+
+    for (i = 0; i < HBITMAP_SCAN_WORDS; i++) {
+        acc &= words[i];
+    }
+    return acc == (unsigned long)-1;
+}
+
 int64_t hbitmap_next_zero(const HBitmap *hb, int64_t start, int64_t count)
 {
     size_t pos = (start >> hb->granularity) >> BITS_PER_LEVEL;
@@ -245,9 +266,14 @@ int64_t hbitmap_next_zero(const HBitmap *hb, int64_t start, int64_t count)
     assert((start >> hb->granularity) < hb->size);
 
     if (cur == (unsigned long)-1) {
-        do {
+        pos++;
+        while (pos + HBITMAP_SCAN_WORDS <= sz &&
+               hb_words_all_ones(&last_lev[pos])) {
+            pos += HBITMAP_SCAN_WORDS;
+        }
+        while (pos < sz && last_lev[pos] == (unsigned long)-1) {
             pos++;
-        } while (pos < sz && last_lev[pos] == (unsigned long)-1);
+        }
 
         if (pos >= sz) {
             return -1;
@@ -316,6 +342,11 @@ uint64_t hbitmap_count(const HBitmap *hb)
     return hb->count << hb->granularity;
 }
 
+uint64_t hbitmap_generation(const HBitmap *hb)
+{
+    return hb->generation;
+}
+
 /**
  * hbitmap_iter_next_word:
  * @hbi: HBitmapIter to operate on.
@@ -447,6 +478,7 @@ void hbitmap_set(HBitmap *hb, uint64_t start, uint64_t count)
     n = last - first + 1;
 
     hb->count += n - hb_count_between(hb, first, last);
+    hb->generation++;
     if (hb_set_between(hb, HBITMAP_LEVELS - 1, first, last) &&
         hb->meta) {
         hbitmap_set(hb->meta, start, count);
@@ -544,6 +576,7 @@ void hbitmap_reset(HBitmap *hb, uint64_t start, uint64_t count)
     assert(last < hb->size);
 
     hb->count -= hb_count_between(hb, first, last);
+    hb->generation++;
     if (hb_reset_between(hb, HBITMAP_LEVELS - 1, first, last) &&
         hb->meta) {
         hbitmap_set(hb->meta, start, count);
@@ -561,6 +594,7 @@ void hbitmap_reset_all(HBitmap *hb)
 
     hb->levels[0][0] = 1UL << (BITS_PER_LONG - 1);
     hb->count = 0;
+    hb->generation++;
 }
 
 bool hbitmap_is_serializable(const HBitmap *hb)
@@ -746,6 +780,7 @@ void hbitmap_deserialize_finish(HBitmap *bitmap)
 
     bitmap->levels[0][0] |= 1UL << (BITS_PER_LONG - 1);
     bitmap->count = hb_count_between(bitmap, 0, bitmap->size - 1);
+    bitmap->generation++;
 }
 
 void hbitmap_free(HBitmap *hb)
@@ -803,6 +838,7 @@ void hbitmap_truncate(HBitmap *hb, uint64_t size)
     shrink = size < hb->size;
 
     /* bit sizes are identical; nothing to do. */
+    hb->generation++;
     if (size == hb->size) {
         return;
     }
@@ -864,6 +900,33 @@ static void hbitmap_sparse_merge(HBitmap *dst, const HBitmap *src)
     }
 }
 
+/**
+ * hbitmap_merge_last_level: performs the last level of dst = dst | src
+ * for bitmaps with the same granularity, and updates dst->count.
+ * Only visits the words that are nonzero in src, as found in the level
+ * above.
+ */
+static void hbitmap_merge_last_level(HBitmap *dst, const HBitmap *src)
+{
+    const unsigned long *parent = src->levels[HBITMAP_LEVELS - 2];
+    const unsigned long *src_words = src->levels[HBITMAP_LEVELS - 1];
+    unsigned long *dst_words = dst->levels[HBITMAP_LEVELS - 1];
+    uint64_t i;
+
+    for (i = 0; i < src->sizes[HBITMAP_LEVELS - 2]; i++) {
+        unsigned long cur = parent[i];
+
+        while (cur) {
+            uint64_t j = (i << BITS_PER_LEVEL) + ctzl(cur);
+            unsigned long old = dst_words[j];
+
+            cur &= cur - 1;
+            dst_words[j] = old | src_words[j];
+            dst->count += ctpopl(dst_words[j]) - ctpopl(old);
+        }
+    }
+}
+
 /**
  * Given HBitmaps A and B, let R := A (BITOR) B.
  * Bitmaps A and B will not be modified,
@@ -874,6 +937,7 @@ static void hbitmap_sparse_merge(HBitmap *dst, const HBitmap *src)
  */
 bool hbitmap_merge(const HBitmap *a, const HBitmap *b, HBitmap *result)
 {
+    const HBitmap *src;
     int i;
     uint64_t j;
 
@@ -905,19 +969,31 @@ bool hbitmap_merge(const HBitmap *a, const HBitmap *b, HBitmap *result)
         return true;
     }
 
-    /* This merge is O(size), as BITS_PER_LONG and HBITMAP_LEVELS are constant.
-     * It may be possible to improve running times for sparsely populated maps
-     * by using hbitmap_iter_next, but this is suboptimal for dense maps.
+    /* Start from a copy of one operand, unless the result already is one,
+     * and OR the other one into it.  The upper levels are merged in full,
+     * as they are BITS_PER_LONG times smaller than the last one.  The
+     * last level only needs the words that are nonzero in @src, which
+     * also lets the dirty count be updated along the way.
      */
     assert(a->size == b->size);
-    for (i = HBITMAP_LEVELS - 1; i >= 0; i--) {
-        for (j = 0; j < a->sizes[i]; j++) {
-            result->levels[i][j] = a->levels[i][j] | b->levels[i][j];
+    if (result != a && result != b) {
+        for (i = HBITMAP_LEVELS - 1; i >= 0; i--) {
+            memcpy(result->levels[i], a->levels[i],
+                   a->sizes[i] * sizeof(unsigned long));
         }
+        result->count = a->count;
+        src = b;
+    } else {
+        src = result == a ? b : a;
     }
 
-    /* Recompute the dirty count */
-    result->count = hb_count_between(result, 0, result->size - 1);
+    for (i = HBITMAP_LEVELS - 2; i >= 0; i--) {
+        for (j = 0; j < src->sizes[i]; j++) {
+            result->levels[i][j] |= src->levels[i][j];
+        }
+    }
+    hbitmap_merge_last_level(result, src);
+    result->generation++;
 
     return true;
 }
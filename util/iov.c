@@ -503,14 +503,34 @@ bool qemu_iovec_is_zero(QEMUIOVector *qiov, size_t offset, size_t bytes)
     return true;
 }
 
+/*
+ * If the slice starts and ends on iovec boundaries of @source, @qiov
+ * becomes an external view of @source's iovec array and nothing is
+ * allocated or copied.  Either way, @source must not be modified while
+ * @qiov is in use, and @qiov must be passed to qemu_iovec_destroy().
+ */
 void qemu_iovec_init_slice(QEMUIOVector *qiov, QEMUIOVector *source,
                            size_t offset, size_t len)
 {
+    size_t head, tail;
+    struct iovec *iov;
+    int niov;
     int ret;
 
     assert(source->size >= len);
     assert(source->size - len >= offset);
 
+    if (len) {
+        iov = qiov_slice(source, offset, len, &head, &tail, &niov);
+        if (niov > 1 && head == 0 && tail == 0) {
+            qiov->iov = iov;
+            qiov->niov = niov;
+            qiov->nalloc = -1;
+            qiov->size = len;
+            return;
+        }
+    }
+
     /* We shrink the request, so we can't overflow neither size_t nor MAX_IOV */
     ret = qemu_iovec_init_extended(qiov, NULL, 0, source, offset, len, NULL, 0);
     assert(ret == 0);
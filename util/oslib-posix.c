@@ -39,6 +39,8 @@
 #include "qemu/thread.h"
 #include <libgen.h>
 #include "qemu/cutils.h"
+#include "qemu/bitops.h"
+#include "qemu/queue.h"
 #include "qemu/compiler.h"
 
 #ifdef CONFIG_LINUX
@@ -73,22 +75,44 @@
 
 #define MAX_MEM_PREALLOC_THREAD_COUNT 16
 
+#if defined(CONFIG_LINUX) && !defined(MADV_POPULATE_WRITE)
+#define MADV_POPULATE_WRITE 23
+#endif
+
+typedef struct MemsetContext MemsetContext;
+
 struct MemsetThread {
     char *addr;
     size_t numpages;
     size_t hpagesize;
     QemuThread pgthread;
     sigjmp_buf env;
+    MemsetContext *context;
 };
 typedef struct MemsetThread MemsetThread;
 
-static MemsetThread *memset_thread;
-static int memset_num_threads;
-static bool memset_thread_failed;
+/* One os_mem_prealloc() call */
+struct MemsetContext {
+    MemsetThread *threads;
+    int num_threads;
+    bool all_threads_created;
+    bool any_thread_failed;
+#ifdef CONFIG_LINUX
+    /* CPUs to run the threads on, NULL if unrestricted */
+    cpu_set_t *cpus;
+#endif
+    QSLIST_ENTRY(MemsetContext) next;
+};
+
+/* The context whose threads the SIGBUS handler is installed for */
+static MemsetContext *sigbus_memset_context;
+
+/* Preallocations still running in the background, protected by the BQL */
+static QSLIST_HEAD(, MemsetContext) memset_contexts =
+    QSLIST_HEAD_INITIALIZER(memset_contexts);
 
 static QemuMutex page_mutex;
 static QemuCond page_cond;
-static bool threads_created_flag;
 
 int qemu_get_thread_id(void)
 {
@@ -447,19 +471,21 @@ const char *qemu_get_exec_dir(void)
 static void sigbus_handler(int signal)
 {
     int i;
-    if (memset_thread) {
-        for (i = 0; i < memset_num_threads; i++) {
-            if (qemu_thread_is_self(&memset_thread[i].pgthread)) {
-                siglongjmp(memset_thread[i].env, 1);
+
+    if (sigbus_memset_context) {
+        for (i = 0; i < sigbus_memset_context->num_threads; i++) {
+            MemsetThread *thread = &sigbus_memset_context->threads[i];
+
+            if (qemu_thread_is_self(&thread->pgthread)) {
+                siglongjmp(thread->env, 1);
             }
         }
     }
 }
 
-static void *do_touch_pages(void *arg)
+static void memset_thread_start(MemsetThread *memset_args)
 {
-    MemsetThread *memset_args = (MemsetThread *)arg;
-    sigset_t set, oldset;
+    MemsetContext *context = memset_args->context;
 
     /*
      * On Linux, the page faults from the loop below can cause mmap_sem
@@ -467,18 +493,33 @@ static void *do_touch_pages(void *arg)
      * clearing until all threads have been created.
      */
     qemu_mutex_lock(&page_mutex);
-    while(!threads_created_flag){
+    while (!context->all_threads_created) {
         qemu_cond_wait(&page_cond, &page_mutex);
     }
     qemu_mutex_unlock(&page_mutex);
 
+#ifdef CONFIG_LINUX
+    if (context->cpus) {
+        /* Best effort, the memory is correctly placed either way */
+        sched_setaffinity(0, sizeof(*context->cpus), context->cpus);
+    }
+#endif
+}
+
+static void *do_touch_pages(void *arg)
+{
+    MemsetThread *memset_args = (MemsetThread *)arg;
+    sigset_t set, oldset;
+
+    memset_thread_start(memset_args);
+
     /* unblock SIGBUS */
     sigemptyset(&set);
     sigaddset(&set, SIGBUS);
     pthread_sigmask(SIG_UNBLOCK, &set, &oldset);
 
     if (sigsetjmp(memset_args->env, 1)) {
-        memset_thread_failed = true;
+        memset_args->context->any_thread_failed = true;
     } else {
         char *addr = memset_args->addr;
         size_t numpages = memset_args->numpages;
@@ -505,11 +546,102 @@ static void *do_touch_pages(void *arg)
     return NULL;
 }
 
-static inline int get_memset_num_threads(int smp_cpus)
+#ifdef CONFIG_LINUX
+/*
+ * MADV_POPULATE_WRITE (Linux 5.14) faults in the whole range with a
+ * single system call, without writing to the memory and without the
+ * SIGBUS dance when the backing pages run out.
+ */
+static void *do_madv_populate_write_pages(void *arg)
+{
+    MemsetThread *memset_args = (MemsetThread *)arg;
+    size_t size = memset_args->numpages * memset_args->hpagesize;
+
+    memset_thread_start(memset_args);
+
+    if (size && madvise(memset_args->addr, size, MADV_POPULATE_WRITE)) {
+        memset_args->context->any_thread_failed = true;
+    }
+    return NULL;
+}
+
+static bool madv_populate_write_possible(char *area, size_t pagesize)
+{
+    return !madvise(area, pagesize, MADV_POPULATE_WRITE) ||
+           errno != EINVAL;
+}
+
+/*
+ * Return the CPUs of the host NUMA nodes set in @host_nodes, or NULL if
+ * none of them has any CPU.  Touching the memory from these CPUs keeps
+ * the kernel from clearing the pages across the interconnect.
+ */
+static cpu_set_t *get_memset_cpus(const unsigned long *host_nodes,
+                                  unsigned long maxnode)
+{
+    g_autofree cpu_set_t *cpus = g_new0(cpu_set_t, 1);
+    unsigned long node;
+
+    for (node = find_first_bit(host_nodes, maxnode); node < maxnode;
+         node = find_next_bit(host_nodes, maxnode, node + 1)) {
+        qemu_host_node_cpus(node, cpus);
+    }
+
+    return CPU_COUNT(cpus) ? g_steal_pointer(&cpus) : NULL;
+}
+
+bool qemu_cpu_list_parse(const char *list, cpu_set_t *cpus)
+{
+    const char *p = list;
+
+    /* e.g. "0-15,32-47" */
+    while (*p && *p != '\n') {
+        unsigned long first, last;
+
+        if (qemu_strtoul(p, &p, 10, &first) < 0) {
+            return false;
+        }
+        last = first;
+        if (*p == '-' && qemu_strtoul(p + 1, &p, 10, &last) < 0) {
+            return false;
+        }
+        if (first > last || last >= CPU_SETSIZE) {
+            return false;
+        }
+        for (; first <= last; first++) {
+            CPU_SET(first, cpus);
+        }
+        if (*p == ',') {
+            p++;
+        } else if (*p && *p != '\n') {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool qemu_host_node_cpus(unsigned long node, cpu_set_t *cpus)
+{
+    g_autofree char *path = g_strdup_printf(
+        "/sys/devices/system/node/node%lu/cpulist", node);
+    g_autofree char *list = NULL;
+
+    return g_file_get_contents(path, &list, NULL, NULL) &&
+           qemu_cpu_list_parse(list, cpus);
+}
+#endif
+
+static inline int get_memset_num_threads(MemsetContext *context,
+                                         int smp_cpus)
 {
     long host_procs = sysconf(_SC_NPROCESSORS_ONLN);
     int ret = 1;
 
+#ifdef CONFIG_LINUX
+    if (context->cpus) {
+        host_procs = CPU_COUNT(context->cpus);
+    }
+#endif
     if (host_procs > 0) {
         ret = MIN(MIN(host_procs, MAX_MEM_PREALLOC_THREAD_COUNT), smp_cpus);
     }
@@ -517,8 +649,9 @@ static inline int get_memset_num_threads(int smp_cpus)
     return ret;
 }
 
-static bool touch_all_pages(char *area, size_t hpagesize, size_t numpages,
-                            int smp_cpus)
+static void touch_all_pages(MemsetContext *context, char *area,
+                            size_t hpagesize, size_t numpages, int smp_cpus,
+                            void *(*touch_fn)(void *))
 {
     static gsize initialized = 0;
     size_t numpages_per_thread, leftover;
@@ -531,67 +664,129 @@ static bool touch_all_pages(char *area, size_t hpagesize, size_t numpages,
         g_once_init_leave(&initialized, 1);
     }
 
-    memset_thread_failed = false;
-    threads_created_flag = false;
-    memset_num_threads = get_memset_num_threads(smp_cpus);
-    memset_thread = g_new0(MemsetThread, memset_num_threads);
-    numpages_per_thread = numpages / memset_num_threads;
-    leftover = numpages % memset_num_threads;
-    for (i = 0; i < memset_num_threads; i++) {
-        memset_thread[i].addr = addr;
-        memset_thread[i].numpages = numpages_per_thread + (i < leftover);
-        memset_thread[i].hpagesize = hpagesize;
-        qemu_thread_create(&memset_thread[i].pgthread, "touch_pages",
-                           do_touch_pages, &memset_thread[i],
+    context->num_threads = get_memset_num_threads(context, smp_cpus);
+    context->threads = g_new0(MemsetThread, context->num_threads);
+    numpages_per_thread = numpages / context->num_threads;
+    leftover = numpages % context->num_threads;
+    for (i = 0; i < context->num_threads; i++) {
+        context->threads[i].addr = addr;
+        context->threads[i].numpages = numpages_per_thread + (i < leftover);
+        context->threads[i].hpagesize = hpagesize;
+        context->threads[i].context = context;
+        qemu_thread_create(&context->threads[i].pgthread, "touch_pages",
+                           touch_fn, &context->threads[i],
                            QEMU_THREAD_JOINABLE);
-        addr += memset_thread[i].numpages * hpagesize;
+        addr += context->threads[i].numpages * hpagesize;
     }
 
     qemu_mutex_lock(&page_mutex);
-    threads_created_flag = true;
+    context->all_threads_created = true;
     qemu_cond_broadcast(&page_cond);
     qemu_mutex_unlock(&page_mutex);
+}
 
-    for (i = 0; i < memset_num_threads; i++) {
-        qemu_thread_join(&memset_thread[i].pgthread);
+/* Wait for the threads of @context and free it; true if all succeeded */
+static bool wait_all_pages(MemsetContext *context)
+{
+    bool ret;
+    int i;
+
+    for (i = 0; i < context->num_threads; i++) {
+        qemu_thread_join(&context->threads[i].pgthread);
     }
-    g_free(memset_thread);
-    memset_thread = NULL;
+    ret = !context->any_thread_failed;
 
-    return memset_thread_failed;
+    g_free(context->threads);
+#ifdef CONFIG_LINUX
+    g_free(context->cpus);
+#endif
+    g_free(context);
+    return ret;
 }
 
 void os_mem_prealloc(int fd, char *area, size_t memory, int smp_cpus,
-                     Error **errp)
+                     const unsigned long *host_nodes, unsigned long maxnode,
+                     bool async, Error **errp)
 {
     int ret;
     struct sigaction act, oldact;
     size_t hpagesize = qemu_fd_getpagesize(fd);
     size_t numpages = DIV_ROUND_UP(memory, hpagesize);
+    void *(*touch_fn)(void *) = do_touch_pages;
+    MemsetContext *context = g_new0(MemsetContext, 1);
 
-    memset(&act, 0, sizeof(act));
-    act.sa_handler = &sigbus_handler;
-    act.sa_flags = 0;
+#ifdef CONFIG_LINUX
+    if (maxnode) {
+        context->cpus = get_memset_cpus(host_nodes, maxnode);
+    }
 
-    ret = sigaction(SIGBUS, &act, &oldact);
-    if (ret) {
-        error_setg_errno(errp, errno,
-            "os_mem_prealloc: failed to install signal handler");
-        return;
+    /*
+     * Not every kind of mapping supports MADV_POPULATE_WRITE, so check
+     * every time.
+     */
+    if (madv_populate_write_possible(area, hpagesize)) {
+        touch_fn = do_madv_populate_write_pages;
+    }
+#endif
+
+    if (touch_fn == do_touch_pages) {
+        /*
+         * The SIGBUS handler cannot stay installed while the rest of
+         * QEMU runs, so touching the pages is always synchronous.
+         */
+        async = false;
+
+        memset(&act, 0, sizeof(act));
+        act.sa_handler = &sigbus_handler;
+        act.sa_flags = 0;
+
+        ret = sigaction(SIGBUS, &act, &oldact);
+        if (ret) {
+            error_setg_errno(errp, errno,
+                "os_mem_prealloc: failed to install signal handler");
+            g_free(context);
+            return;
+        }
+        sigbus_memset_context = context;
     }
 
     /* touch pages simultaneously */
-    if (touch_all_pages(area, hpagesize, numpages, smp_cpus)) {
+    touch_all_pages(context, area, hpagesize, numpages, smp_cpus, touch_fn);
+    if (async) {
+        QSLIST_INSERT_HEAD(&memset_contexts, context, next);
+        return;
+    }
+
+    if (!wait_all_pages(context)) {
         error_setg(errp, "os_mem_prealloc: Insufficient free host memory "
             "pages available to allocate guest RAM");
     }
 
-    ret = sigaction(SIGBUS, &oldact, NULL);
-    if (ret) {
-        /* Terminate QEMU since it can't recover from error */
-        perror("os_mem_prealloc: failed to reinstall signal handler");
-        exit(1);
+    if (touch_fn == do_touch_pages) {
+        sigbus_memset_context = NULL;
+        ret = sigaction(SIGBUS, &oldact, NULL);
+        if (ret) {
+            /* Terminate QEMU since it can't recover from error */
+            perror("os_mem_prealloc: failed to reinstall signal handler");
+            exit(1);
+        }
+    }
+}
+
+bool os_mem_prealloc_finish(Error **errp)
+{
+    MemsetContext *context;
+    bool ret = true;
+
+    while ((context = QSLIST_FIRST(&memset_contexts))) {
+        QSLIST_REMOVE_HEAD(&memset_contexts, next);
+        ret &= wait_all_pages(context);
+    }
+    if (!ret) {
+        error_setg(errp, "os_mem_prealloc: Insufficient free host memory "
+            "pages available to allocate guest RAM");
     }
+    return ret;
 }
 
 char *qemu_get_pid_name(pid_t pid)
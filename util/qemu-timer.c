@@ -63,10 +63,21 @@ static QEMUClock qemu_clocks[QEMU_CLOCK_MAX];
  * reenabling the clock can call all the notifiers.
  */
 
+/*
+ * The pending timers of a QEMUTimerList form a binary min-heap, so that
+ * arming and deleting a timer take logarithmic time in the number of
+ * timers.  Timers with the same expire_time run in the order they were
+ * armed in.  active_timers mirrors the top of the heap, so that it can
+ * be checked without taking the lock.
+ */
 struct QEMUTimerList {
     QEMUClock *clock;
     QemuMutex active_timers_lock;
     QEMUTimer *active_timers;
+    QEMUTimer **heap;
+    size_t nr_active;
+    size_t heap_size;
+    uint64_t seq;
     QLIST_ENTRY(QEMUTimerList) list;
     QEMUTimerListNotifyCB *notify_cb;
     void *notify_opaque;
@@ -117,6 +128,7 @@ void timerlist_free(QEMUTimerList *timer_list)
         QLIST_REMOVE(timer_list, list);
     }
     qemu_mutex_destroy(&timer_list->active_timers_lock);
+    g_free(timer_list->heap);
     g_free(timer_list);
 }
 
@@ -252,9 +264,10 @@ int64_t qemu_clock_deadline_ns_all(QEMUClockType type, int attr_mask)
     int64_t deadline = -1;
     int64_t delta;
     int64_t expire_time;
-    QEMUTimer *ts;
+    QEMUTimer *ts, *t;
     QEMUTimerList *timer_list;
     QEMUClock *clock = qemu_clock_ptr(type);
+    size_t i;
 
     if (!clock->enabled) {
         return -1;
@@ -263,9 +276,16 @@ int64_t qemu_clock_deadline_ns_all(QEMUClockType type, int attr_mask)
     QLIST_FOREACH(timer_list, &clock->timerlists, list) {
         qemu_mutex_lock(&timer_list->active_timers_lock);
         ts = timer_list->active_timers;
-        /* Skip all external timers */
-        while (ts && (ts->attributes & ~attr_mask)) {
-            ts = ts->next;
+        if (ts && (ts->attributes & ~attr_mask)) {
+            /* Skip all external timers, they may be anywhere in the heap */
+            ts = NULL;
+            for (i = 1; i < timer_list->nr_active; i++) {
+                t = timer_list->heap[i];
+                if (!(t->attributes & ~attr_mask) &&
+                    (!ts || t->expire_time < ts->expire_time)) {
+                    ts = t;
+                }
+            }
         }
         if (!ts) {
             qemu_mutex_unlock(&timer_list->active_timers_lock);
@@ -375,43 +395,114 @@ void timer_deinit(QEMUTimer *ts)
     ts->timer_list = NULL;
 }
 
-static void timer_del_locked(QEMUTimerList *timer_list, QEMUTimer *ts)
+static bool timer_before(QEMUTimer *a, QEMUTimer *b)
 {
-    QEMUTimer **pt, *t;
+    return a->expire_time < b->expire_time ||
+           (a->expire_time == b->expire_time && a->seq < b->seq);
+}
 
-    ts->expire_time = -1;
-    pt = &timer_list->active_timers;
-    for(;;) {
-        t = *pt;
-        if (!t)
-            break;
-        if (t == ts) {
-            qatomic_set(pt, t->next);
+static void timerlist_heap_set(QEMUTimerList *timer_list, size_t i,
+                               QEMUTimer *ts)
+{
+    timer_list->heap[i] = ts;
+    ts->heap_index = i;
+}
+
+static void timerlist_sift_up(QEMUTimerList *timer_list, size_t i)
+{
+    QEMUTimer *ts = timer_list->heap[i];
+    size_t parent;
+
+    while (i > 0) {
+        parent = (i - 1) / 2;
+        if (!timer_before(ts, timer_list->heap[parent])) {
             break;
         }
-        pt = &t->next;
+        timerlist_heap_set(timer_list, i, timer_list->heap[parent]);
+        i = parent;
     }
+    timerlist_heap_set(timer_list, i, ts);
 }
 
-static bool timer_mod_ns_locked(QEMUTimerList *timer_list,
-                                QEMUTimer *ts, int64_t expire_time)
+static void timerlist_sift_down(QEMUTimerList *timer_list, size_t i)
 {
-    QEMUTimer **pt, *t;
+    QEMUTimer *ts = timer_list->heap[i];
+    size_t child;
 
-    /* add the timer in the sorted list */
-    pt = &timer_list->active_timers;
     for (;;) {
-        t = *pt;
-        if (!timer_expired_ns(t, expire_time)) {
+        child = 2 * i + 1;
+        if (child >= timer_list->nr_active) {
+            break;
+        }
+        if (child + 1 < timer_list->nr_active &&
+            timer_before(timer_list->heap[child + 1],
+                         timer_list->heap[child])) {
+            child++;
+        }
+        if (!timer_before(timer_list->heap[child], ts)) {
             break;
         }
-        pt = &t->next;
+        timerlist_heap_set(timer_list, i, timer_list->heap[child]);
+        i = child;
     }
+    timerlist_heap_set(timer_list, i, ts);
+}
+
+static void timerlist_update_head(QEMUTimerList *timer_list)
+{
+    qatomic_set(&timer_list->active_timers,
+                timer_list->nr_active ? timer_list->heap[0] : NULL);
+}
+
+/* The earliest expire time of the timer list, or INT64_MAX if none */
+static int64_t timerlist_next_expire_locked(QEMUTimerList *timer_list)
+{
+    return timer_list->nr_active ? timer_list->heap[0]->expire_time
+                                 : INT64_MAX;
+}
+
+static void timer_del_locked(QEMUTimerList *timer_list, QEMUTimer *ts)
+{
+    QEMUTimer *last;
+    size_t i = ts->heap_index;
+
+    if (ts->expire_time == -1) {
+        return;
+    }
+    ts->expire_time = -1;
+
+    last = timer_list->heap[--timer_list->nr_active];
+    if (last != ts) {
+        timerlist_heap_set(timer_list, i, last);
+        timerlist_sift_up(timer_list, i);
+        timerlist_sift_down(timer_list, last->heap_index);
+    }
+    timerlist_update_head(timer_list);
+}
+
+/*
+ * Returns true if the timer list must be rearmed, because the timer
+ * made its earliest expire time move earlier than @old_expire.  There
+ * is no need to wake up anybody when it only moves later: waking up at
+ * the old deadline and finding nothing to run is harmless.
+ */
+static bool timer_mod_ns_locked(QEMUTimerList *timer_list,
+                                QEMUTimer *ts, int64_t expire_time,
+                                int64_t old_expire)
+{
+    if (timer_list->nr_active == timer_list->heap_size) {
+        timer_list->heap_size = MAX(timer_list->heap_size * 2, 16);
+        timer_list->heap = g_renew(QEMUTimer *, timer_list->heap,
+                                   timer_list->heap_size);
+    }
+
     ts->expire_time = MAX(expire_time, 0);
-    ts->next = *pt;
-    qatomic_set(pt, ts);
+    ts->seq = timer_list->seq++;
+    timerlist_heap_set(timer_list, timer_list->nr_active++, ts);
+    timerlist_sift_up(timer_list, ts->heap_index);
+    timerlist_update_head(timer_list);
 
-    return pt == &timer_list->active_timers;
+    return timer_list->heap[0] == ts && ts->expire_time < old_expire;
 }
 
 static void timerlist_rearm(QEMUTimerList *timer_list)
@@ -440,11 +531,13 @@ void timer_del(QEMUTimer *ts)
 void timer_mod_ns(QEMUTimer *ts, int64_t expire_time)
 {
     QEMUTimerList *timer_list = ts->timer_list;
+    int64_t old_expire;
     bool rearm;
 
     qemu_mutex_lock(&timer_list->active_timers_lock);
+    old_expire = timerlist_next_expire_locked(timer_list);
     timer_del_locked(timer_list, ts);
-    rearm = timer_mod_ns_locked(timer_list, ts, expire_time);
+    rearm = timer_mod_ns_locked(timer_list, ts, expire_time, old_expire);
     qemu_mutex_unlock(&timer_list->active_timers_lock);
 
     if (rearm) {
@@ -462,10 +555,11 @@ void timer_mod_anticipate_ns(QEMUTimer *ts, int64_t expire_time)
 
     WITH_QEMU_LOCK_GUARD(&timer_list->active_timers_lock) {
         if (ts->expire_time == -1 || ts->expire_time > expire_time) {
-            if (ts->expire_time != -1) {
-                timer_del_locked(timer_list, ts);
-            }
-            rearm = timer_mod_ns_locked(timer_list, ts, expire_time);
+            int64_t old_expire = timerlist_next_expire_locked(timer_list);
+
+            timer_del_locked(timer_list, ts);
+            rearm = timer_mod_ns_locked(timer_list, ts, expire_time,
+                                        old_expire);
         } else {
             rearm = false;
         }
@@ -562,9 +656,7 @@ bool timerlist_run_timers(QEMUTimerList *timer_list)
         }
 
         /* remove timer from the list before calling the callback */
-        timer_list->active_timers = ts->next;
-        ts->next = NULL;
-        ts->expire_time = -1;
+        timer_del_locked(timer_list, ts);
         cb = ts->cb;
         opaque = ts->opaque;
 
@@ -46,7 +46,9 @@
  * Resizing is done by taking all bucket spinlocks (so that no other writers can
  * race with us) and then copying all entries into a new hash map. Then, the
  * ht->map pointer is set, and the old map is freed once no RCU readers can see
- * it anymore.
+ * it anymore. Lookups keep using the old map during the copy, since its
+ * buckets are not modified; only writers wait, so the copy takes a fast path
+ * that skips the duplicate checks and seqlock updates of regular insertions.
  *
  * Writers check for concurrent resizes by comparing ht->map before and after
  * acquiring their bucket lock. If they don't match, a resize has occurred
@@ -403,6 +405,7 @@ void qht_init(struct qht *ht, qht_cmp_func_t cmp, size_t n_elems,
     g_assert(cmp);
     ht->cmp = cmp;
     ht->mode = mode;
+    ht->n_resizes = 0;
     qemu_mutex_init(&ht->lock);
     map = qht_map_create(n_buckets);
     qatomic_rcu_set(&ht->map, map);
@@ -831,19 +834,45 @@ void qht_iter_remove(struct qht *ht, qht_iter_bool_func_t func, void *userp)
 }
 
 struct qht_map_copy_data {
-    struct qht *ht;
     struct qht_map *new;
 };
 
+/*
+ * Append an entry to a map that no thread has seen yet, so neither locks nor
+ * the seqlock are needed. The entries come from another map, so they cannot
+ * be duplicates. Publishing the map with qatomic_rcu_set() orders the stores.
+ */
+static void qht_insert__unpublished(struct qht_map *map,
+                                    struct qht_bucket *head, void *p,
+                                    uint32_t hash)
+{
+    struct qht_bucket *b = head;
+    int i;
+
+    for (;;) {
+        for (i = 0; i < QHT_BUCKET_ENTRIES; i++) {
+            if (b->pointers[i] == NULL) {
+                b->hashes[i] = hash;
+                b->pointers[i] = p;
+                return;
+            }
+        }
+        if (b->next == NULL) {
+            b->next = qemu_memalign(QHT_BUCKET_ALIGN, sizeof(*b));
+            memset(b->next, 0, sizeof(*b));
+            map->n_added_buckets++;
+        }
+        b = b->next;
+    }
+}
+
 static void qht_map_copy(void *p, uint32_t hash, void *userp)
 {
     struct qht_map_copy_data *data = userp;
-    struct qht *ht = data->ht;
     struct qht_map *new = data->new;
     struct qht_bucket *b = qht_map_to_bucket(new, hash);
 
-    /* no need to acquire b->lock because no thread has seen this map yet */
-    qht_insert__locked(ht, new, b, p, hash, NULL);
+    qht_insert__unpublished(new, b, p, hash);
 }
 
 /*
@@ -872,11 +901,11 @@ static void qht_do_resize_reset(struct qht *ht, struct qht_map *new, bool reset)
     }
 
     g_assert(new->n_buckets != old->n_buckets);
-    data.ht = ht;
     data.new = new;
     qht_map_iter__all_locked(old, &iter, &data);
     qht_map_debug__all_locked(new);
 
+    qatomic_set(&ht->n_resizes, ht->n_resizes + 1);
     qatomic_rcu_set(&ht->map, new);
     qht_map_unlock_buckets(old);
     call_rcu(old, qht_map_destroy, rcu);
@@ -910,6 +939,7 @@ void qht_statistics_init(const struct qht *ht, struct qht_stats *stats)
 
     stats->used_head_buckets = 0;
     stats->entries = 0;
+    stats->resizes = qatomic_read(&ht->n_resizes);
     qdist_init(&stats->chain);
     qdist_init(&stats->occupancy);
     /* bail out if the qht has not yet been initialized */
@@ -50,6 +50,15 @@
  *   rcu_read_lock/unlock slows down atomic_add-bench -m by 24%. Having
  *   a snapshot that is updated on qsp_reset() avoids this overhead.
  *
+ * Sampling mode:
+ *
+ * Timing and hashing every lock acquisition is too expensive to leave on in
+ * production.  With qsp_enable_sampling(N), each thread only looks at one in
+ * N mutex and recursive mutex acquisitions.  A sampled acquisition first
+ * tries to take the lock; only if that fails, i.e. the lock is contended, is
+ * the wait timed and recorded.  All other acquisitions just pay for a
+ * thread-local countdown.  Condition variables are not profiled in this mode.
+ *
  * Related Work:
  * - Lennart Poettering's mutrace: http://0pointer.de/blog/projects/mutrace.html
  * - Lozi, David, Thomas, Lawall and Muller. "Remote Core Locking: Migrating
@@ -117,6 +126,10 @@ static struct qht qsp_ht;
 static QSPSnapshot *qsp_snapshot;
 static bool qsp_initialized, qsp_initializing;
 
+/* 1 in how many acquisitions are sampled, or 0 if not sampling */
+static unsigned int qsp_sample_period;
+static __thread unsigned int qsp_sample_countdown;
+
 static const char * const qsp_typenames[] = {
     [QSP_MUTEX]     = "mutex",
     [QSP_BQL_MUTEX] = "BQL mutex",
@@ -396,6 +409,47 @@ QSP_GEN_VOID(QemuRecMutex, QSP_REC_MUTEX, qsp_rec_mutex_lock,
 QSP_GEN_RET1(QemuRecMutex, QSP_REC_MUTEX, qsp_rec_mutex_trylock,
              qemu_rec_mutex_trylock_impl)
 
+static inline bool qsp_sample(void)
+{
+    if (likely(qsp_sample_countdown)) {
+        qsp_sample_countdown--;
+        return false;
+    }
+    qsp_sample_countdown = qatomic_read(&qsp_sample_period) - 1;
+    return true;
+}
+
+/* Only record sampled acquisitions that could not take the lock at once */
+#define QSP_GEN_SAMPLED(type_, qsp_t_, func_, impl_, trylock_impl_)     \
+    static void func_(type_ *obj, const char *file, int line)           \
+    {                                                                   \
+        QSPEntry *e;                                                    \
+        int64_t t0, t1;                                                 \
+                                                                        \
+        if (!qsp_sample()) {                                            \
+            impl_(obj, file, line);                                     \
+            return;                                                     \
+        }                                                               \
+        if (!trylock_impl_(obj, file, line)) {                          \
+            return;                                                     \
+        }                                                               \
+                                                                        \
+        t0 = get_clock();                                               \
+        impl_(obj, file, line);                                         \
+        t1 = get_clock();                                               \
+                                                                        \
+        e = qsp_entry_get(obj, file, line, qsp_t_);                     \
+        qsp_entry_record(e, t1 - t0);                                   \
+    }
+
+QSP_GEN_SAMPLED(QemuMutex, QSP_BQL_MUTEX, qsp_sampled_bql_mutex_lock,
+                qemu_mutex_lock_impl, qemu_mutex_trylock_impl)
+QSP_GEN_SAMPLED(QemuMutex, QSP_MUTEX, qsp_sampled_mutex_lock,
+                qemu_mutex_lock_impl, qemu_mutex_trylock_impl)
+QSP_GEN_SAMPLED(QemuRecMutex, QSP_REC_MUTEX, qsp_sampled_rec_mutex_lock,
+                qemu_rec_mutex_lock_impl, qemu_rec_mutex_trylock_impl)
+
+#undef QSP_GEN_SAMPLED
 #undef QSP_GEN_RET1
 #undef QSP_GEN_VOID
 
@@ -432,11 +486,19 @@ qsp_cond_timedwait(QemuCond *cond, QemuMutex *mutex, int ms,
 
 bool qsp_is_enabled(void)
 {
-    return qatomic_read(&qemu_mutex_lock_func) == qsp_mutex_lock;
+    QemuMutexLockFunc func = qatomic_read(&qemu_mutex_lock_func);
+
+    return func == qsp_mutex_lock || func == qsp_sampled_mutex_lock;
+}
+
+unsigned int qsp_sampling_period(void)
+{
+    return qsp_is_enabled() ? qatomic_read(&qsp_sample_period) : 0;
 }
 
 void qsp_enable(void)
 {
+    qatomic_set(&qsp_sample_period, 0);
     qatomic_set(&qemu_mutex_lock_func, qsp_mutex_lock);
     qatomic_set(&qemu_mutex_trylock_func, qsp_mutex_trylock);
     qatomic_set(&qemu_bql_mutex_lock_func, qsp_bql_mutex_lock);
@@ -446,6 +508,19 @@ void qsp_enable(void)
     qatomic_set(&qemu_cond_timedwait_func, qsp_cond_timedwait);
 }
 
+void qsp_enable_sampling(unsigned int period)
+{
+    assert(period);
+    qatomic_set(&qsp_sample_period, period);
+    qatomic_set(&qemu_mutex_lock_func, qsp_sampled_mutex_lock);
+    qatomic_set(&qemu_mutex_trylock_func, qemu_mutex_trylock_impl);
+    qatomic_set(&qemu_bql_mutex_lock_func, qsp_sampled_bql_mutex_lock);
+    qatomic_set(&qemu_rec_mutex_lock_func, qsp_sampled_rec_mutex_lock);
+    qatomic_set(&qemu_rec_mutex_trylock_func, qemu_rec_mutex_trylock_impl);
+    qatomic_set(&qemu_cond_wait_func, qemu_cond_wait_impl);
+    qatomic_set(&qemu_cond_timedwait_func, qemu_cond_timedwait_impl);
+}
+
 void qsp_disable(void)
 {
     qatomic_set(&qemu_mutex_lock_func, qemu_mutex_lock_impl);
@@ -662,6 +737,7 @@ struct QSPReportEntry {
     const void *obj;
     char *callsite_at;
     const char *typename;
+    uint64_t ns;
     double time_s;
     double ns_avg;
     uint64_t n_acqs;
@@ -692,6 +768,7 @@ static gboolean qsp_tree_report(gpointer key, gpointer value, gpointer udata)
     entry->n_objs = e->n_objs;
     entry->callsite_at = qsp_at(e->callsite);
     entry->typename = qsp_typenames[e->callsite->type];
+    entry->ns = e->ns;
     entry->time_s = e->ns * 1e-9;
     entry->n_acqs = e->n_acqs;
     entry->ns_avg = e->n_acqs ? e->ns / e->n_acqs : 0;
@@ -721,6 +798,11 @@ static void pr_report(const QSPReport *rep)
     /* white space to leave to the right of "Call site" */
     callsite_rspace = callsite_len - strlen("Call site");
 
+    if (qsp_sampling_period()) {
+        qemu_printf("Sampling 1 in %u acquisitions, contended ones only\n",
+                    qsp_sampling_period());
+    }
+
     qemu_printf("Type               Object  Call site%*s  Wait Time (s)  "
                 "       Count  Average (us)\n", callsite_rspace, "");
 
@@ -765,26 +847,49 @@ static void report_destroy(QSPReport *rep)
     g_free(rep->entries);
 }
 
-void qsp_report(size_t max, enum QSPSortBy sort_by,
-                bool callsite_coalesce)
+static void report_build(QSPReport *rep, size_t max, enum QSPSortBy sort_by,
+                         bool callsite_coalesce)
 {
     GTree *tree = g_tree_new_full(qsp_tree_cmp, &sort_by, g_free, NULL);
-    QSPReport rep;
 
     qsp_init();
 
-    rep.entries = g_new0(QSPReportEntry, max);
-    rep.n_entries = 0;
-    rep.max_n_entries = max;
+    rep->entries = g_new0(QSPReportEntry, max);
+    rep->n_entries = 0;
+    rep->max_n_entries = max;
 
     qsp_mktree(tree, callsite_coalesce);
-    g_tree_foreach(tree, qsp_tree_report, &rep);
+    g_tree_foreach(tree, qsp_tree_report, rep);
     g_tree_destroy(tree);
+}
 
+void qsp_report(size_t max, enum QSPSortBy sort_by,
+                bool callsite_coalesce)
+{
+    QSPReport rep;
+
+    report_build(&rep, max, sort_by, callsite_coalesce);
     pr_report(&rep);
     report_destroy(&rep);
 }
 
+void qsp_report_foreach(size_t max, enum QSPSortBy sort_by,
+                        bool callsite_coalesce, QSPReportFunc *func,
+                        void *opaque)
+{
+    QSPReport rep;
+    size_t i;
+
+    report_build(&rep, max, sort_by, callsite_coalesce);
+    for (i = 0; i < rep.n_entries; i++) {
+        const QSPReportEntry *e = &rep.entries[i];
+
+        func(opaque, e->typename, e->n_objs > 1 ? NULL : e->obj, e->n_objs,
+             e->callsite_at, e->ns, e->n_acqs);
+    }
+    report_destroy(&rep);
+}
+
 static void qsp_snapshot_destroy(QSPSnapshot *snap)
 {
     qht_iter(&snap->ht, qsp_ht_delete, NULL);
@@ -32,6 +32,7 @@
 #include "qemu/thread.h"
 #include "qemu/main-loop.h"
 #include "qemu/lockable.h"
+#include "qemu/stats64.h"
 #if defined(CONFIG_MALLOC_TRIM)
 #include <malloc.h>
 #endif
@@ -49,6 +50,10 @@ QemuEvent rcu_gp_event;
 static QemuMutex rcu_registry_lock;
 static QemuMutex rcu_sync_lock;
 
+static Stat64 rcu_grace_periods;
+static Stat64 rcu_callbacks;
+static Stat64 rcu_pending_max;
+
 /*
  * Check whether a quiescent state was crossed between the beginning of
  * update_counter_and_wait and now.
@@ -151,6 +156,8 @@ void synchronize_rcu(void)
 
     QEMU_LOCK_GUARD(&rcu_registry_lock);
     if (!QLIST_EMPTY(&registry)) {
+        stat64_add(&rcu_grace_periods, 1);
+
         /* In either case, the qatomic_mb_set below blocks stores that free
          * old RCU-protected pointers.
          */
@@ -183,6 +190,9 @@ static struct rcu_head *head = &dummy, **tail = &dummy.next;
 static int rcu_call_count;
 static QemuEvent rcu_call_ready_event;
 
+/* Number of drain_call_rcu() callers waiting for the call_rcu thread */
+static int rcu_call_expedited;
+
 static void enqueue(struct rcu_head *node)
 {
     struct rcu_head **old_tail;
@@ -242,11 +252,13 @@ static void *call_rcu_thread(void *opaque)
         int tries = 0;
         int n = qatomic_read(&rcu_call_count);
 
-        /* Heuristically wait for a decent number of callbacks to pile up.
+        /* Heuristically wait for a decent number of callbacks to pile up,
+         * unless somebody is waiting for them in drain_call_rcu().
          * Fetch rcu_call_count now, we only must process elements that were
          * added before synchronize_rcu() starts.
          */
-        while (n == 0 || (n < RCU_CALL_MIN_SIZE && ++tries <= 5)) {
+        while (n == 0 || (n < RCU_CALL_MIN_SIZE && ++tries <= 5 &&
+                          !qatomic_read(&rcu_call_expedited))) {
             g_usleep(10000);
             if (n == 0) {
                 qemu_event_reset(&rcu_call_ready_event);
@@ -262,6 +274,8 @@ static void *call_rcu_thread(void *opaque)
         }
 
         qatomic_sub(&rcu_call_count, n);
+        stat64_max(&rcu_pending_max, n);
+        stat64_add(&rcu_callbacks, n);
         synchronize_rcu();
         qemu_mutex_lock_iothread();
         while (n > 0) {
@@ -339,8 +353,10 @@ void drain_call_rcu(void)
      * assumed.
      */
 
+    qatomic_inc(&rcu_call_expedited);
     call_rcu1(&rcu_drain.rcu, drain_rcu_callback);
     qemu_event_wait(&rcu_drain.drain_complete_event);
+    qatomic_dec(&rcu_call_expedited);
 
     if (locked) {
         qemu_mutex_lock_iothread();
@@ -348,6 +364,14 @@ void drain_call_rcu(void)
 
 }
 
+void rcu_get_stats(RCUStats *stats)
+{
+    stats->pending = qatomic_read(&rcu_call_count);
+    stats->pending_max = stat64_get(&rcu_pending_max);
+    stats->callbacks = stat64_get(&rcu_callbacks);
+    stats->grace_periods = stat64_get(&rcu_grace_periods);
+}
+
 void rcu_register_thread(void)
 {
     assert(rcu_reader.ctr == 0);
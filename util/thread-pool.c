@@ -18,12 +18,19 @@
 #include "qemu/queue.h"
 #include "qemu/thread.h"
 #include "qemu/coroutine.h"
+#include "qemu/stats64.h"
 #include "trace.h"
 #include "block/thread-pool.h"
 #include "qemu/main-loop.h"
 
 static void do_spawn_thread(ThreadPool *pool);
 
+/* Shared by all pools, updated with atomics */
+static Stat64 thread_pool_submitted;
+static Stat64 thread_pool_completed;
+static int thread_pool_queued;
+static int thread_pool_threads;
+
 typedef struct ThreadPoolElement ThreadPoolElement;
 
 enum ThreadState {
@@ -44,6 +51,7 @@ struct ThreadPoolElement {
      */
     enum ThreadState state;
     int ret;
+    ThreadPoolPriority prio;
 
     /* Access to this list is protected by lock.  */
     QTAILQ_ENTRY(ThreadPoolElement) reqs;
@@ -65,7 +73,7 @@ struct ThreadPool {
     QLIST_HEAD(, ThreadPoolElement) head;
 
     /* The following variables are protected by lock.  */
-    QTAILQ_HEAD(, ThreadPoolElement) request_list;
+    QTAILQ_HEAD(, ThreadPoolElement) request_list[THREAD_POOL_PRIO__MAX];
     int cur_threads;
     int idle_threads;
     int new_threads;     /* backlog of threads we need to create */
@@ -73,6 +81,21 @@ struct ThreadPool {
     bool stopping;
 };
 
+/* Runs with lock taken.  */
+static ThreadPoolElement *thread_pool_first_request(ThreadPool *pool)
+{
+    ThreadPoolElement *req;
+    int prio;
+
+    for (prio = 0; prio < THREAD_POOL_PRIO__MAX; prio++) {
+        req = QTAILQ_FIRST(&pool->request_list[prio]);
+        if (req) {
+            return req;
+        }
+    }
+    return NULL;
+}
+
 static void *worker_thread(void *opaque)
 {
     ThreadPool *pool = opaque;
@@ -80,8 +103,13 @@ static void *worker_thread(void *opaque)
     qemu_mutex_lock(&pool->lock);
     pool->pending_threads--;
     do_spawn_thread(pool);
+    qatomic_inc(&thread_pool_threads);
 
-    while (!pool->stopping) {
+    /*
+     * Check the limit before waiting, so that an exiting worker never
+     * consumes the semaphore count of a queued request.
+     */
+    while (!pool->stopping && pool->cur_threads <= pool->max_threads) {
         ThreadPoolElement *req;
         int ret;
 
@@ -91,14 +119,15 @@ static void *worker_thread(void *opaque)
             ret = qemu_sem_timedwait(&pool->sem, 10000);
             qemu_mutex_lock(&pool->lock);
             pool->idle_threads--;
-        } while (ret == -1 && !QTAILQ_EMPTY(&pool->request_list));
+        } while (ret == -1 && thread_pool_first_request(pool));
         if (ret == -1 || pool->stopping) {
             break;
         }
 
-        req = QTAILQ_FIRST(&pool->request_list);
-        QTAILQ_REMOVE(&pool->request_list, req, reqs);
+        req = thread_pool_first_request(pool);
+        QTAILQ_REMOVE(&pool->request_list[req->prio], req, reqs);
         req->state = THREAD_ACTIVE;
+        qatomic_dec(&thread_pool_queued);
         qemu_mutex_unlock(&pool->lock);
 
         ret = req->func(req->arg);
@@ -113,6 +142,7 @@ static void *worker_thread(void *opaque)
         qemu_bh_schedule(pool->completion_bh);
     }
 
+    qatomic_dec(&thread_pool_threads);
     pool->cur_threads--;
     qemu_cond_signal(&pool->worker_stopped);
     qemu_mutex_unlock(&pool->lock);
@@ -174,6 +204,7 @@ restart:
         trace_thread_pool_complete(pool, elem, elem->common.opaque,
                                    elem->ret);
         QLIST_REMOVE(elem, all);
+        stat64_add(&thread_pool_completed, 1);
 
         if (elem->common.cb) {
             /* Read state before ret.  */
@@ -218,7 +249,8 @@ static void thread_pool_cancel(BlockAIOCB *acb)
          * the lock taken and ensure that elem will remain THREAD_QUEUED.
          */
         qemu_sem_timedwait(&pool->sem, 0) == 0) {
-        QTAILQ_REMOVE(&pool->request_list, elem, reqs);
+        QTAILQ_REMOVE(&pool->request_list[elem->prio], elem, reqs);
+        qatomic_dec(&thread_pool_queued);
         qemu_bh_schedule(pool->completion_bh);
 
         elem->state = THREAD_DONE;
@@ -240,17 +272,19 @@ static const AIOCBInfo thread_pool_aiocb_info = {
     .get_aio_context    = thread_pool_get_aio_context,
 };
 
-BlockAIOCB *thread_pool_submit_aio(ThreadPool *pool,
-        ThreadPoolFunc *func, void *arg,
+BlockAIOCB *thread_pool_submit_aio_prio(ThreadPool *pool,
+        ThreadPoolPriority prio, ThreadPoolFunc *func, void *arg,
         BlockCompletionFunc *cb, void *opaque)
 {
     ThreadPoolElement *req;
 
+    assert(prio < THREAD_POOL_PRIO__MAX);
     req = qemu_aio_get(&thread_pool_aiocb_info, NULL, cb, opaque);
     req->func = func;
     req->arg = arg;
     req->state = THREAD_QUEUED;
     req->pool = pool;
+    req->prio = prio;
 
     QLIST_INSERT_HEAD(&pool->head, req, all);
 
@@ -260,12 +294,22 @@ BlockAIOCB *thread_pool_submit_aio(ThreadPool *pool,
     if (pool->idle_threads == 0 && pool->cur_threads < pool->max_threads) {
         spawn_thread(pool);
     }
-    QTAILQ_INSERT_TAIL(&pool->request_list, req, reqs);
+    QTAILQ_INSERT_TAIL(&pool->request_list[prio], req, reqs);
+    qatomic_inc(&thread_pool_queued);
     qemu_mutex_unlock(&pool->lock);
+    stat64_add(&thread_pool_submitted, 1);
     qemu_sem_post(&pool->sem);
     return &req->common;
 }
 
+BlockAIOCB *thread_pool_submit_aio(ThreadPool *pool,
+        ThreadPoolFunc *func, void *arg,
+        BlockCompletionFunc *cb, void *opaque)
+{
+    return thread_pool_submit_aio_prio(pool, THREAD_POOL_PRIO_NORMAL,
+                                       func, arg, cb, opaque);
+}
+
 typedef struct ThreadPoolCo {
     Coroutine *co;
     int ret;
@@ -279,23 +323,42 @@ static void thread_pool_co_cb(void *opaque, int ret)
     aio_co_wake(co->co);
 }
 
-int coroutine_fn thread_pool_submit_co(ThreadPool *pool, ThreadPoolFunc *func,
-                                       void *arg)
+int coroutine_fn thread_pool_submit_co_prio(ThreadPool *pool,
+                                            ThreadPoolPriority prio,
+                                            ThreadPoolFunc *func, void *arg)
 {
     ThreadPoolCo tpc = { .co = qemu_coroutine_self(), .ret = -EINPROGRESS };
     assert(qemu_in_coroutine());
-    thread_pool_submit_aio(pool, func, arg, thread_pool_co_cb, &tpc);
+    thread_pool_submit_aio_prio(pool, prio, func, arg, thread_pool_co_cb,
+                                &tpc);
     qemu_coroutine_yield();
     return tpc.ret;
 }
 
+int coroutine_fn thread_pool_submit_co(ThreadPool *pool, ThreadPoolFunc *func,
+                                       void *arg)
+{
+    return thread_pool_submit_co_prio(pool, THREAD_POOL_PRIO_NORMAL,
+                                      func, arg);
+}
+
 void thread_pool_submit(ThreadPool *pool, ThreadPoolFunc *func, void *arg)
 {
     thread_pool_submit_aio(pool, func, arg, NULL, NULL);
 }
 
+void thread_pool_get_stats(ThreadPoolStats *stats)
+{
+    stats->submitted = stat64_get(&thread_pool_submitted);
+    stats->completed = stat64_get(&thread_pool_completed);
+    stats->queued = qatomic_read(&thread_pool_queued);
+    stats->threads = qatomic_read(&thread_pool_threads);
+}
+
 static void thread_pool_init_one(ThreadPool *pool, AioContext *ctx)
 {
+    int prio;
+
     if (!ctx) {
         ctx = qemu_get_aio_context();
     }
@@ -306,11 +369,19 @@ static void thread_pool_init_one(ThreadPool *pool, AioContext *ctx)
     qemu_mutex_init(&pool->lock);
     qemu_cond_init(&pool->worker_stopped);
     qemu_sem_init(&pool->sem, 0);
-    pool->max_threads = 64;
+    pool->max_threads = qatomic_read(&ctx->thread_pool_max);
     pool->new_thread_bh = aio_bh_new(ctx, spawn_thread_bh_fn, pool);
 
     QLIST_INIT(&pool->head);
-    QTAILQ_INIT(&pool->request_list);
+    for (prio = 0; prio < THREAD_POOL_PRIO__MAX; prio++) {
+        QTAILQ_INIT(&pool->request_list[prio]);
+    }
+}
+
+void thread_pool_update_params(ThreadPool *pool, AioContext *ctx)
+{
+    QEMU_LOCK_GUARD(&pool->lock);
+    pool->max_threads = qatomic_read(&ctx->thread_pool_max);
 }
 
 ThreadPool *thread_pool_new(AioContext *ctx)
@@ -23,6 +23,7 @@
  */
 
 #include "qemu/osdep.h"
+#include <math.h>
 #include "qapi/error.h"
 #include "qemu/throttle.h"
 #include "qemu/timer.h"
@@ -87,6 +88,28 @@ static int64_t throttle_do_compute_wait(double limit, double extra)
     return wait;
 }
 
+/* Compute the sizes of a leaky bucket that is in use
+ *
+ * @bucket_size:       I/O before throttling to bkt->avg
+ * @burst_bucket_size: I/O before throttling to bkt->max
+ */
+static void throttle_bucket_sizes(LeakyBucket *bkt, double *bucket_size,
+                                  double *burst_bucket_size)
+{
+    if (!bkt->max) {
+        /* If bkt->max is 0 we still want to allow short bursts of I/O
+         * from the guest, otherwise every other request will be throttled
+         * and performance will suffer considerably. */
+        *bucket_size = (double) bkt->avg / 10;
+        *burst_bucket_size = 0;
+    } else {
+        /* If we have a burst limit then we have to wait until all I/O
+         * at burst rate has finished before throttling to bkt->avg */
+        *bucket_size = bkt->max * bkt->burst_length;
+        *burst_bucket_size = (double) bkt->max / 10;
+    }
+}
+
 /* This function compute the wait time in ns that a leaky bucket should trigger
  *
  * @bkt: the leaky bucket we operate on
@@ -102,18 +125,7 @@ int64_t throttle_compute_wait(LeakyBucket *bkt)
         return 0;
     }
 
-    if (!bkt->max) {
-        /* If bkt->max is 0 we still want to allow short bursts of I/O
-         * from the guest, otherwise every other request will be throttled
-         * and performance will suffer considerably. */
-        bucket_size = (double) bkt->avg / 10;
-        burst_bucket_size = 0;
-    } else {
-        /* If we have a burst limit then we have to wait until all I/O
-         * at burst rate has finished before throttling to bkt->avg */
-        bucket_size = bkt->max * bkt->burst_length;
-        burst_bucket_size = (double) bkt->max / 10;
-    }
+    throttle_bucket_sizes(bkt, &bucket_size, &burst_bucket_size);
 
     /* If the main bucket is full then we have to wait */
     extra = bkt->level - bucket_size;
@@ -444,46 +456,120 @@ bool throttle_schedule_timer(ThrottleState *ts,
     return true;
 }
 
-/* do the accounting for this operation
+static const BucketType bucket_types_size[2][2] = {
+    { THROTTLE_BPS_TOTAL, THROTTLE_BPS_READ },
+    { THROTTLE_BPS_TOTAL, THROTTLE_BPS_WRITE }
+};
+static const BucketType bucket_types_units[2][2] = {
+    { THROTTLE_OPS_TOTAL, THROTTLE_OPS_READ },
+    { THROTTLE_OPS_TOTAL, THROTTLE_OPS_WRITE }
+};
+
+/* Compute how many units can be added to a leaky bucket before the next
+ * operation has to wait
  *
- * @is_write: the type of operation (read/write)
- * @size:     the size of the operation
+ * @bkt: the leaky bucket we operate on
+ * @ret: the number of units, INFINITY if the bucket isn't in use
  */
-void throttle_account(ThrottleState *ts, bool is_write, uint64_t size)
+static double throttle_bucket_headroom(LeakyBucket *bkt)
 {
-    const BucketType bucket_types_size[2][2] = {
-        { THROTTLE_BPS_TOTAL, THROTTLE_BPS_READ },
-        { THROTTLE_BPS_TOTAL, THROTTLE_BPS_WRITE }
-    };
-    const BucketType bucket_types_units[2][2] = {
-        { THROTTLE_OPS_TOTAL, THROTTLE_OPS_READ },
-        { THROTTLE_OPS_TOTAL, THROTTLE_OPS_WRITE }
-    };
-    double units = 1.0;
-    unsigned i;
+    double bucket_size, burst_bucket_size, headroom;
 
-    /* if cfg.op_size is defined and smaller than size we compute unit count */
-    if (ts->cfg.op_size && size > ts->cfg.op_size) {
-        units = (double) size / ts->cfg.op_size;
+    if (!bkt->avg) {
+        return INFINITY;
+    }
+
+    throttle_bucket_sizes(bkt, &bucket_size, &burst_bucket_size);
+
+    headroom = bucket_size - bkt->level;
+    if (bkt->burst_length > 1) {
+        headroom = MIN(headroom, burst_bucket_size - bkt->burst_level);
     }
 
+    return MAX(headroom, 0);
+}
+
+/* Compute how much I/O can be accounted now without the next operation
+ * having to wait
+ *
+ * @clock_type: the clock used by @ts
+ * @is_write:   the type of operation (read/write)
+ * @size:       the number of bytes is written here, INFINITY if unlimited
+ * @units:      the number of operations is written here, INFINITY if
+ *              unlimited
+ */
+void throttle_get_headroom(ThrottleState *ts, QEMUClockType clock_type,
+                           bool is_write, double *size, double *units)
+{
+    unsigned i;
+
+    throttle_do_leak(ts, qemu_clock_get_ns(clock_type));
+
+    *size = INFINITY;
+    *units = INFINITY;
     for (i = 0; i < 2; i++) {
-        LeakyBucket *bkt;
+        *size = MIN(*size, throttle_bucket_headroom(
+                    &ts->cfg.buckets[bucket_types_size[is_write][i]]));
+        *units = MIN(*units, throttle_bucket_headroom(
+                     &ts->cfg.buckets[bucket_types_units[is_write][i]]));
+    }
+}
 
-        bkt = &ts->cfg.buckets[bucket_types_size[is_write][i]];
-        bkt->level += size;
-        if (bkt->burst_length > 1) {
-            bkt->burst_level += size;
-        }
+static void throttle_bucket_add(LeakyBucket *bkt, double units)
+{
+    bkt->level = MAX(bkt->level + units, 0);
+    if (bkt->burst_length > 1) {
+        bkt->burst_level = MAX(bkt->burst_level + units, 0);
+    }
+}
 
-        bkt = &ts->cfg.buckets[bucket_types_units[is_write][i]];
-        bkt->level += units;
-        if (bkt->burst_length > 1) {
-            bkt->burst_level += units;
-        }
+/* do the accounting for a number of bytes and operations at once
+ *
+ * Negative values give back I/O that was accounted in advance but not
+ * performed. The bucket levels never go below zero.
+ *
+ * @is_write: the type of operation (read/write)
+ * @size:     the number of bytes
+ * @units:    the number of operations
+ */
+void throttle_account_units(ThrottleState *ts, bool is_write, double size,
+                            double units)
+{
+    unsigned i;
+
+    for (i = 0; i < 2; i++) {
+        throttle_bucket_add(&ts->cfg.buckets[bucket_types_size[is_write][i]],
+                            size);
+        throttle_bucket_add(&ts->cfg.buckets[bucket_types_units[is_write][i]],
+                            units);
     }
 }
 
+/* compute the number of operation units of a request
+ *
+ * @op_size: the size of an operation in bytes, or 0
+ * @size:    the size of the request
+ */
+double throttle_op_units(uint64_t op_size, uint64_t size)
+{
+    /* if op_size is defined and smaller than size we compute unit count */
+    if (op_size && size > op_size) {
+        return (double) size / op_size;
+    }
+    return 1.0;
+}
+
+/* do the accounting for this operation
+ *
+ * @is_write: the type of operation (read/write)
+ * @size:     the size of the operation
+ */
+void throttle_account(ThrottleState *ts, bool is_write, uint64_t size)
+{
+    throttle_account_units(ts, is_write, size,
+                           throttle_op_units(ts->cfg.op_size, size));
+}
+
 /* return a ThrottleConfig based on the options in a ThrottleLimits
  *
  * @arg:    the ThrottleLimits object to read from
@@ -191,12 +191,12 @@ void qemu_vfio_pci_unmap_bar(QEMUVFIOState *s, int index, void *bar,
 /**
  * Initialize device IRQ with @irq_type and register an event notifier.
  */
-int qemu_vfio_pci_init_irq(QEMUVFIOState *s, EventNotifier *e,
-                           int irq_type, Error **errp)
+/**
+ * Return the number of interrupt vectors of type @irq_type that the device
+ * supports, or -errno on error.
+ */
+int qemu_vfio_pci_get_irq_count(QEMUVFIOState *s, int irq_type, Error **errp)
 {
-    int r;
-    struct vfio_irq_set *irq_set;
-    size_t irq_set_size;
     struct vfio_irq_info irq_info = { .argsz = sizeof(irq_info) };
 
     irq_info.index = irq_type;
@@ -208,20 +208,29 @@ int qemu_vfio_pci_init_irq(QEMUVFIOState *s, EventNotifier *e,
         error_setg(errp, "Device interrupt doesn't support eventfd");
         return -EINVAL;
     }
+    return irq_info.count;
+}
+
+static int qemu_vfio_pci_set_irqs(QEMUVFIOState *s, int irq_type,
+                                  unsigned start, unsigned count,
+                                  const int *fds, Error **errp)
+{
+    int r;
+    struct vfio_irq_set *irq_set;
+    size_t irq_set_size;
 
-    irq_set_size = sizeof(*irq_set) + sizeof(int);
+    irq_set_size = sizeof(*irq_set) + count * sizeof(int);
     irq_set = g_malloc0(irq_set_size);
 
-    /* Get to a known IRQ state */
     *irq_set = (struct vfio_irq_set) {
         .argsz = irq_set_size,
         .flags = VFIO_IRQ_SET_DATA_EVENTFD | VFIO_IRQ_SET_ACTION_TRIGGER,
-        .index = irq_info.index,
-        .start = 0,
-        .count = 1,
+        .index = irq_type,
+        .start = start,
+        .count = count,
     };
 
-    *(int *)&irq_set->data = event_notifier_get_fd(e);
+    memcpy(&irq_set->data, fds, count * sizeof(int));
     r = ioctl(s->device, VFIO_DEVICE_SET_IRQS, irq_set);
     g_free(irq_set);
     if (r) {
@@ -231,6 +240,50 @@ int qemu_vfio_pci_init_irq(QEMUVFIOState *s, EventNotifier *e,
     return 0;
 }
 
+/**
+ * Enable @nr_vectors interrupt vectors of type @irq_type.  Vector 0 signals
+ * @e, the others are not connected until qemu_vfio_pci_set_irq_vector() is
+ * called for them.  @nr_vectors must not exceed the count returned by
+ * qemu_vfio_pci_get_irq_count().
+ */
+int qemu_vfio_pci_init_irq(QEMUVFIOState *s, EventNotifier *e,
+                           int irq_type, unsigned nr_vectors, Error **errp)
+{
+    g_autofree int *fds = NULL;
+    int count;
+    unsigned i;
+
+    assert(nr_vectors > 0);
+
+    count = qemu_vfio_pci_get_irq_count(s, irq_type, errp);
+    if (count < 0) {
+        return count;
+    }
+    assert(nr_vectors <= count);
+
+    /* Get to a known IRQ state */
+    fds = g_new(int, nr_vectors);
+    fds[0] = event_notifier_get_fd(e);
+    for (i = 1; i < nr_vectors; i++) {
+        fds[i] = -1;
+    }
+    return qemu_vfio_pci_set_irqs(s, irq_type, 0, nr_vectors, fds, errp);
+}
+
+/**
+ * Connect interrupt vector @vector, which must have been enabled by
+ * qemu_vfio_pci_init_irq(), to @e.  If @e is NULL, the vector is
+ * disconnected.
+ */
+int qemu_vfio_pci_set_irq_vector(QEMUVFIOState *s, int irq_type,
+                                 unsigned vector, EventNotifier *e,
+                                 Error **errp)
+{
+    int fd = e ? event_notifier_get_fd(e) : -1;
+
+    return qemu_vfio_pci_set_irqs(s, irq_type, vector, 1, &fd, errp);
+}
+
 static int qemu_vfio_pci_read_config(QEMUVFIOState *s, void *buf,
                                      int size, int ofs)
 {
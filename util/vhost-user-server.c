@@ -26,7 +26,17 @@
  * protocol messages over the UNIX domain socket.
  *
  * When virtqueues are set up libvhost-user calls set_watch() to monitor kick
- * fds. These fds are also handled in the VuServer->ctx AioContext.
+ * fds. These fds are also handled in the VuServer->ctx AioContext, unless
+ * vhost_user_server_set_queue_contexts() gave other AioContexts for the
+ * virtqueues. Kick fds also get a polling handler, so that an IOThread with
+ * polling enabled processes virtqueues without waiting for the guest's
+ * notification.
+ *
+ * libvhost-user is not thread-safe, but the state of different virtqueues
+ * is independent. Virtqueues in other AioContexts are therefore paused while
+ * vu_client_trip() processes a vhost-user message: their kick handlers are
+ * removed and the message is only dispatched once no kick handler and no
+ * request (see vhost_user_server_inc_in_flight()) is in progress.
  *
  * Both vu_client_trip() and kick fd monitoring can be stopped by shutting down
  * the socket connection. Shutting down the socket connection causes
@@ -136,6 +146,9 @@ vu_message_read(VuDev *vu_dev, int conn_fd, VhostUserMsg *vmsg)
         read_bytes += rc;
     } while (read_bytes != VHOST_USER_HDR_SIZE);
 
+    /* A message arrived, stop the virtqueues before it is handled */
+    vu_pause_queues(server);
+
     /* qio_channel_readv_full will make socket fds blocking, unblock them */
     vmsg_unblock_fds(vmsg);
     if (vmsg->size > sizeof(vmsg->payload)) {
@@ -168,13 +181,113 @@ fail:
     return false;
 }
 
+static void kick_handler(void *opaque);
+static bool kick_poll(void *opaque);
+
+void vhost_user_server_inc_in_flight(VuServer *server)
+{
+    qatomic_inc(&server->in_flight);
+}
+
+void vhost_user_server_dec_in_flight(VuServer *server)
+{
+    if (qatomic_fetch_dec(&server->in_flight) == 1) {
+        Coroutine *co = qatomic_xchg(&server->pause_co, NULL);
+
+        if (co) {
+            aio_co_wake(co);
+        }
+    }
+}
+
+/*
+ * Take a reference for running a kick handler. Returns false if the
+ * virtqueues are paused and the handler must not run.
+ */
+static bool vu_fd_watch_enter(VuFdWatch *vu_fd_watch)
+{
+    VuServer *server = container_of(vu_fd_watch->vu_dev, VuServer, vu_dev);
+
+    if (!vu_fd_watch->ctx) {
+        return true;
+    }
+
+    vhost_user_server_inc_in_flight(server);
+    /* Pairs with smp_mb() in vu_pause_queues() */
+    smp_mb();
+    if (qatomic_read(&server->queues_paused)) {
+        vhost_user_server_dec_in_flight(server);
+        return false;
+    }
+    return true;
+}
+
+static void vu_fd_watch_leave(VuFdWatch *vu_fd_watch)
+{
+    VuServer *server = container_of(vu_fd_watch->vu_dev, VuServer, vu_dev);
+
+    if (vu_fd_watch->ctx) {
+        vhost_user_server_dec_in_flight(server);
+    }
+}
+
+/* Wait until nothing runs in the virtqueue AioContexts */
+static void coroutine_fn vu_pause_queues(VuServer *server)
+{
+    Coroutine *self = qemu_coroutine_self();
+    VuFdWatch *vu_fd_watch;
+
+    if (!server->nb_vq_ctx) {
+        return;
+    }
+
+    qatomic_set(&server->queues_paused, true);
+    smp_mb();
+
+    QTAILQ_FOREACH(vu_fd_watch, &server->vu_fd_watches, next) {
+        if (vu_fd_watch->ctx) {
+            aio_set_fd_handler(vu_fd_watch->ctx, vu_fd_watch->fd, true,
+                               NULL, NULL, NULL, NULL);
+        }
+    }
+
+    while (qatomic_read(&server->in_flight)) {
+        qatomic_set(&server->pause_co, self);
+        smp_mb();
+        if (!qatomic_read(&server->in_flight) &&
+            qatomic_xchg(&server->pause_co, NULL) == self) {
+            break;
+        }
+        /* Woken up by vhost_user_server_dec_in_flight() */
+        qemu_coroutine_yield();
+    }
+}
+
+static void vu_resume_queues(VuServer *server)
+{
+    VuFdWatch *vu_fd_watch;
+
+    if (!server->nb_vq_ctx) {
+        return;
+    }
+
+    qatomic_set(&server->queues_paused, false);
+
+    QTAILQ_FOREACH(vu_fd_watch, &server->vu_fd_watches, next) {
+        if (vu_fd_watch->ctx) {
+            aio_set_fd_handler(vu_fd_watch->ctx, vu_fd_watch->fd, true,
+                               kick_handler, NULL, kick_poll, vu_fd_watch);
+        }
+    }
+}
+
 static coroutine_fn void vu_client_trip(void *opaque)
 {
     VuServer *server = opaque;
     VuDev *vu_dev = &server->vu_dev;
 
     while (!vu_dev->broken && vu_dispatch(vu_dev)) {
-        /* Keep running */
+        vu_resume_queues(server);
     }
 
     vu_deinit(vu_dev);
@@ -207,6 +320,10 @@ static void kick_handler(void *opaque)
     VuFdWatch *vu_fd_watch = opaque;
     VuDev *vu_dev = vu_fd_watch->vu_dev;
 
+    if (!vu_fd_watch_enter(vu_fd_watch)) {
+        return;
+    }
+
     vu_fd_watch->cb(vu_dev, 0, vu_fd_watch->pvt);
 
     /* Stop vu_client_trip() if an error occurred in vu_fd_watch->cb() */
@@ -215,6 +332,48 @@ static void kick_handler(void *opaque)
 
         qio_channel_shutdown(server->ioc, QIO_CHANNEL_SHUTDOWN_BOTH, NULL);
     }
+
+    vu_fd_watch_leave(vu_fd_watch);
+}
+
+/*
+ * Polling handler for kick fds: process the virtqueue if the guest made
+ * requests available. libvhost-user passes the virtqueue index as the
+ * private data of kick fd watches.
+ */
+static bool kick_poll(void *opaque)
+{
+    VuFdWatch *vu_fd_watch = opaque;
+    VuDev *vu_dev = vu_fd_watch->vu_dev;
+    int idx = (intptr_t)vu_fd_watch->pvt;
+    VuVirtq *vq;
+    bool progress = false;
+
+    if (!vu_fd_watch_enter(vu_fd_watch)) {
+        return false;
+    }
+
+    vq = vu_get_queue(vu_dev, idx);
+    if (!vu_dev->broken && vq->handler && !vu_queue_empty(vu_dev, vq)) {
+        vq->handler(vu_dev, idx);
+        progress = true;
+    }
+
+    vu_fd_watch_leave(vu_fd_watch);
+    return progress;
+}
+
+/* The AioContext in which a virtqueue's kick fd is monitored */
+static AioContext *vu_queue_ctx(VuServer *server, int idx)
+{
+    AioContext *ctx;
+
+    if (!server->nb_vq_ctx) {
+        return NULL;
+    }
+
+    ctx = server->vq_ctx[idx % server->nb_vq_ctx];
+    return ctx == server->ctx ? NULL : ctx;
 }
 
 static VuFdWatch *find_vu_fd_watch(VuServer *server, int fd)
@@ -248,11 +407,19 @@ set_watch(VuDev *vu_dev, int fd, int vu_evt,
 
         vu_fd_watch->fd = fd;
         vu_fd_watch->cb = cb;
-        qemu_set_nonblock(fd);
-        aio_set_fd_handler(server->ioc->ctx, fd, true, kick_handler,
-                           NULL, NULL, vu_fd_watch);
         vu_fd_watch->vu_dev = vu_dev;
         vu_fd_watch->pvt = pvt;
+        vu_fd_watch->ctx = vu_queue_ctx(server, (intptr_t)pvt);
+        qemu_set_nonblock(fd);
+
+        /* Paused virtqueues are started by vu_resume_queues() */
+        if (!vu_fd_watch->ctx) {
+            aio_set_fd_handler(server->ioc->ctx, fd, true, kick_handler,
+                               NULL, kick_poll, vu_fd_watch);
+        } else if (!qatomic_read(&server->queues_paused)) {
+            aio_set_fd_handler(vu_fd_watch->ctx, fd, true, kick_handler,
+                               NULL, kick_poll, vu_fd_watch);
+        }
     }
 }
 
@@ -270,7 +437,8 @@ static void remove_watch(VuDev *vu_dev, int fd)
     if (!vu_fd_watch) {
         return;
     }
-    aio_set_fd_handler(server->ioc->ctx, fd, true, NULL, NULL, NULL, NULL);
+    aio_set_fd_handler(vu_fd_watch->ctx ?: server->ioc->ctx, fd, true,
+                       NULL, NULL, NULL, NULL);
 
     QTAILQ_REMOVE(&server->vu_fd_watches, vu_fd_watch, next);
     g_free(vu_fd_watch);
@@ -311,6 +479,7 @@ static void vu_accept(QIONetListener *listener, QIOChannelSocket *sioc,
     qio_channel_set_name(QIO_CHANNEL(sioc), "vhost-user client");
     server->ioc = QIO_CHANNEL(sioc);
     object_ref(OBJECT(server->ioc));
+    qatomic_set(&server->queues_paused, false);
 
     /* TODO vu_message_write() spins if non-blocking! */
     qio_channel_set_blocking(server->ioc, false, NULL);
@@ -332,8 +501,10 @@ void vhost_user_server_stop(VuServer *server)
     if (server->sioc) {
         VuFdWatch *vu_fd_watch;
 
+        qatomic_set(&server->queues_paused, true);
         QTAILQ_FOREACH(vu_fd_watch, &server->vu_fd_watches, next) {
-            aio_set_fd_handler(server->ctx, vu_fd_watch->fd, true,
+            aio_set_fd_handler(vu_fd_watch->ctx ?: server->ctx,
+                               vu_fd_watch->fd, true,
                                NULL, NULL, NULL, vu_fd_watch);
         }
 
@@ -376,8 +547,10 @@ void vhost_user_server_attach_aio_context(VuServer *server, AioContext *ctx)
     qio_channel_attach_aio_context(server->ioc, ctx);
 
     QTAILQ_FOREACH(vu_fd_watch, &server->vu_fd_watches, next) {
-        aio_set_fd_handler(ctx, vu_fd_watch->fd, true, kick_handler, NULL,
-                           NULL, vu_fd_watch);
+        if (!vu_fd_watch->ctx) {
+            aio_set_fd_handler(ctx, vu_fd_watch->fd, true, kick_handler, NULL,
+                               kick_poll, vu_fd_watch);
+        }
     }
 
     aio_co_schedule(ctx, server->co_trip);
@@ -390,8 +563,10 @@ void vhost_user_server_detach_aio_context(VuServer *server)
         VuFdWatch *vu_fd_watch;
 
         QTAILQ_FOREACH(vu_fd_watch, &server->vu_fd_watches, next) {
-            aio_set_fd_handler(server->ctx, vu_fd_watch->fd, true,
-                               NULL, NULL, NULL, vu_fd_watch);
+            if (!vu_fd_watch->ctx) {
+                aio_set_fd_handler(server->ctx, vu_fd_watch->fd, true,
+                                   NULL, NULL, NULL, vu_fd_watch);
+            }
         }
 
         qio_channel_detach_aio_context(server->ioc);
@@ -400,6 +575,23 @@ void vhost_user_server_detach_aio_context(VuServer *server)
     server->ctx = NULL;
 }
 
+/*
+ * Process virtqueue i in ctxs[i % n] instead of the server's AioContext.
+ * Requests of those virtqueues run concurrently with the server's
+ * AioContext; the device must account them with
+ * vhost_user_server_inc_in_flight() and vhost_user_server_dec_in_flight().
+ * The AioContexts must stay the same while the server runs.
+ *
+ * Must be called before a client connects.
+ */
+void vhost_user_server_set_queue_contexts(VuServer *server,
+                                          AioContext **ctxs, int n)
+{
+    assert(!server->sioc);
+    server->vq_ctx = ctxs;
+    server->nb_vq_ctx = n;
+}
+
 bool vhost_user_server_start(VuServer *server,
                              SocketAddress *socket_addr,
                              AioContext *ctx,